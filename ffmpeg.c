@@ -41,8 +41,10 @@
 #include "libavutil/intreadwrite.h"
 #include "libavutil/dict.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/imgutils.h"
 #include "libavutil/avstring.h"
 #include "libavutil/libm.h"
+#include "libavutil/profile.h"
 #include "libavformat/os_support.h"
 
 #include "libavformat/ffm.h" // not public API
@@ -55,6 +57,16 @@
 # include "libavfilter/vsrc_buffer.h"
 #endif
 
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
+#if CONFIG_VAAPI && HAVE_VA_X11
+#include <X11/Xlib.h>
+#include <va/va_x11.h>
+#include "libavcodec/vaapi.h"
+#endif
+
 #if HAVE_SYS_RESOURCE_H
 #include <sys/types.h>
 #include <sys/time.h>
@@ -110,6 +122,12 @@ typedef struct AVChapterMap {
     int out_file;
 } AVChapterMap;
 
+enum HWAccelID {
+    HWACCEL_NONE = 0,
+    HWACCEL_AUTO,
+    HWACCEL_VAAPI,
+};
+
 static const OptionDef options[];
 
 #define MAX_FILES 100
@@ -162,6 +180,11 @@ static char *video_language = NULL;
 static int same_quality = 0;
 static int do_deinterlace = 0;
 static int top_field_first = -1;
+static enum HWAccelID hwaccel_id = HWACCEL_NONE;
+static char *hwaccel_device = NULL;
+/* number of packets each input may read ahead of the transcoding loop */
+#define INPUT_QUEUE_SIZE 8
+static int thread_queue_size = INPUT_QUEUE_SIZE;
 static int me_threshold = 0;
 static int intra_dc_precision = 8;
 static int loop_input = 0;
@@ -201,6 +224,7 @@ static int64_t input_ts_offset = 0;
 static int file_overwrite = 0;
 static AVDictionary *metadata;
 static int do_benchmark = 0;
+static int do_benchmark_all = 0;
 static int do_hex_dump = 0;
 static int do_pkt_dump = 0;
 static int do_psnr = 0;
@@ -218,6 +242,8 @@ static int copy_tb= 0;
 static int opt_shortest = 0;
 static char *vstats_filename;
 static FILE *vstats_file;
+static AVIOContext *progress_avio = NULL;
+static int64_t stats_period = 500000;
 static int opt_programid = 0;
 static int copy_initial_nonkeyframes = 0;
 
@@ -233,6 +259,8 @@ static int using_stdin = 0;
 static int verbose = 1;
 static int run_as_daemon  = 0;
 static int thread_count= 1;
+static int shared_threads = 0;
+static struct AVCodecThreadPool *thread_pool;
 static int q_pressed = 0;
 static int64_t video_size = 0;
 static int64_t audio_size = 0;
@@ -260,6 +288,68 @@ static AVBitStreamFilterContext *subtitle_bitstream_filters=NULL;
 
 #define DEFAULT_PASS_LOGFILENAME_PREFIX "ffmpeg2pass"
 
+static int64_t getutime(void)
+{
+#if HAVE_GETRUSAGE
+    struct rusage rusage;
+
+    getrusage(RUSAGE_SELF, &rusage);
+    return (rusage.ru_utime.tv_sec * 1000000LL) + rusage.ru_utime.tv_usec;
+#elif HAVE_GETPROCESSTIMES
+    HANDLE proc;
+    FILETIME c, e, k, u;
+    proc = GetCurrentProcess();
+    GetProcessTimes(proc, &c, &e, &k, &u);
+    return ((int64_t) u.dwHighDateTime << 32 | u.dwLowDateTime) / 10;
+#else
+    return av_gettime();
+#endif
+}
+
+/* stages of the transcoding timed with -benchmark */
+enum BenchStage {
+    BENCH_DEMUX,
+    BENCH_DECODE,
+    BENCH_FILTER,
+    BENCH_SCALE,            /* also audio resampling */
+    BENCH_ENCODE,
+    BENCH_MUX,
+    BENCH_NB
+};
+
+static const char *const bench_stage_names[BENCH_NB] = {
+    "demux", "decode", "filter", "scale", "encode", "mux",
+};
+
+/* time spent in each stage for a file or a stream, in microseconds */
+typedef struct BenchStats {
+    int64_t wall[BENCH_NB];
+    int64_t cpu[BENCH_NB];  /* user time of the whole process */
+} BenchStats;
+
+typedef struct BenchTimer {
+    int64_t wall, cpu;
+} BenchTimer;
+
+static BenchTimer bench_start(void)
+{
+    BenchTimer t = { 0, 0 };
+
+    if (do_benchmark) {
+        t.wall = av_gettime();
+        t.cpu  = getutime();
+    }
+    return t;
+}
+
+static void bench_stop(BenchTimer *t, BenchStats *stats, enum BenchStage stage)
+{
+    if (do_benchmark) {
+        stats->wall[stage] += av_gettime() - t->wall;
+        stats->cpu[stage]  += getutime()   - t->cpu;
+    }
+}
+
 struct AVInputStream;
 
 typedef struct AVOutputStream {
@@ -310,9 +400,11 @@ typedef struct AVOutputStream {
     AVFilterBufferRef *picref;
     char *avfilter;
     AVFilterGraph *graph;
+    int shared_filters;   /* fed by the filter graph of its input stream */
 #endif
 
    int sws_flags;
+   BenchStats bench;
 } AVOutputStream;
 
 static AVOutputStream **output_streams_for_file[MAX_FILES] = { NULL };
@@ -335,14 +427,633 @@ typedef struct AVInputStream {
 #if CONFIG_AVFILTER
     AVFrame *filter_frame;
     int has_filter_frame;
+    struct FrameBuffer *buffer_pool; ///< unused decoding buffers
+    /* filters shared by the outputs of the stream, run once per frame */
+    char *avfilter;
+    AVFilterGraph *graph;
+    AVFilterContext *input_video_filter;
+    AVFilterContext *output_video_filter;
 #endif
+    BenchStats bench;
+    uint8_t *deinterlace_buf;   ///< deinterlaced picture, reused from frame to frame
+    unsigned int deinterlace_buf_size;
+
+    /* hardware accelerated decoding */
+    enum HWAccelID hwaccel_id;          ///< requested with -hwaccel
+    char *hwaccel_device;
+    enum HWAccelID active_hwaccel_id;   ///< hwaccel in use, HWACCEL_NONE for software decoding
+    enum PixelFormat hwaccel_pix_fmt;   ///< format of the decoder surfaces
+    enum PixelFormat hwaccel_sw_pix_fmt;///< format of the pictures retrieved from them
+    void *hwaccel_ctx;
+    void (*hwaccel_uninit)(AVCodecContext *s);
+    int  (*hwaccel_get_buffer)(AVCodecContext *s, AVFrame *frame);
+    void (*hwaccel_release_buffer)(AVCodecContext *s, AVFrame *frame);
+    int  (*hwaccel_retrieve_data)(AVCodecContext *s, AVFrame *frame);
 } AVInputStream;
 
+typedef struct HWAccel {
+    const char *name;
+    int (*init)(AVCodecContext *s);
+    enum HWAccelID id;
+    enum PixelFormat pix_fmt;
+} HWAccel;
+
+#if CONFIG_VAAPI && HAVE_VA_X11
+/* enough for the reference frames of h264, the frame being decoded and
+   the one being retrieved */
+#define VAAPI_NB_SURFACES 20
+
+typedef struct VAAPIContext {
+    Display *x11_display;
+    struct vaapi_context va;
+    VAProfile profile;
+    int width, height;
+    VASurfaceID surfaces[VAAPI_NB_SURFACES];
+    int surface_used[VAAPI_NB_SURFACES];
+    int have_surfaces, have_config, have_context;
+    VAImageFormat image_format;
+    VAImage image;
+    int have_image;
+    uint8_t *data[4];                   ///< retrieved picture
+    int linesize[4];
+} VAAPIContext;
+
+static int vaapi_profile(AVCodecContext *s, VAProfile *profile)
+{
+    switch (s->codec_id) {
+    case CODEC_ID_MPEG2VIDEO:
+        *profile = VAProfileMPEG2Main;
+        return 0;
+    case CODEC_ID_MPEG4:
+        *profile = VAProfileMPEG4AdvancedSimple;
+        return 0;
+    case CODEC_ID_H263:
+        *profile = VAProfileH263Baseline;
+        return 0;
+    case CODEC_ID_H264:
+        switch (s->profile) {
+        case FF_PROFILE_H264_CONSTRAINED_BASELINE:
+        case FF_PROFILE_H264_MAIN:
+            *profile = VAProfileH264Main;
+            return 0;
+        case FF_PROFILE_H264_HIGH:
+            *profile = VAProfileH264High;
+            return 0;
+        }
+        break;
+    case CODEC_ID_VC1:
+    case CODEC_ID_WMV3:
+        switch (s->profile) {
+        case FF_PROFILE_VC1_SIMPLE:   *profile = VAProfileVC1Simple;   return 0;
+        case FF_PROFILE_VC1_MAIN:     *profile = VAProfileVC1Main;     return 0;
+        case FF_PROFILE_VC1_ADVANCED: *profile = VAProfileVC1Advanced; return 0;
+        }
+        break;
+    default:
+        break;
+    }
+    return AVERROR(ENOSYS);
+}
+
+static void vaapi_uninit(AVCodecContext *s)
+{
+    AVInputStream *ist = s->opaque;
+    VAAPIContext *ctx  = ist->hwaccel_ctx;
+    VADisplay dpy;
+
+    if (!ctx)
+        return;
+    dpy = ctx->va.display;
+    if (dpy) {
+        if (ctx->have_image)
+            vaDestroyImage(dpy, ctx->image.image_id);
+        if (ctx->have_context)
+            vaDestroyContext(dpy, ctx->va.context_id);
+        if (ctx->have_surfaces)
+            vaDestroySurfaces(dpy, ctx->surfaces, VAAPI_NB_SURFACES);
+        if (ctx->have_config)
+            vaDestroyConfig(dpy, ctx->va.config_id);
+        vaTerminate(dpy);
+    }
+    if (ctx->x11_display)
+        XCloseDisplay(ctx->x11_display);
+    av_freep(&ctx->data[0]);
+    av_freep(&ist->hwaccel_ctx);
+
+    ist->hwaccel_uninit         = NULL;
+    ist->hwaccel_get_buffer     = NULL;
+    ist->hwaccel_release_buffer = NULL;
+    ist->hwaccel_retrieve_data  = NULL;
+    if (s->hwaccel_context == &ctx->va)
+        s->hwaccel_context = NULL;
+}
+
+static int vaapi_get_buffer(AVCodecContext *s, AVFrame *frame)
+{
+    AVInputStream *ist = s->opaque;
+    VAAPIContext *ctx  = ist->hwaccel_ctx;
+    int i;
+
+    for (i = 0; i < VAAPI_NB_SURFACES; i++)
+        if (!ctx->surface_used[i])
+            break;
+    if (i == VAAPI_NB_SURFACES) {
+        av_log(s, AV_LOG_ERROR, "No free VA-API surface\n");
+        return AVERROR(ENOMEM);
+    }
+    ctx->surface_used[i] = 1;
+
+    frame->opaque  = &ctx->surface_used[i];
+    frame->type    = FF_BUFFER_TYPE_USER;
+    frame->age     = INT_MAX;
+    frame->pkt_pts = s->pkt ? s->pkt->pts : AV_NOPTS_VALUE;
+    frame->pkt_pos = s->pkt ? s->pkt->pos : -1;
+    frame->reordered_opaque    = s->reordered_opaque;
+    frame->sample_aspect_ratio = s->sample_aspect_ratio;
+    frame->width   = s->width;
+    frame->height  = s->height;
+    frame->format  = s->pix_fmt;
+    for (i = 0; i < 4; i++) {
+        frame->base[i]     = NULL;
+        frame->data[i]     = NULL;
+        frame->linesize[i] = 0;
+    }
+    /* libavcodec reads the surface id from data[3] */
+    frame->data[0] = frame->data[3] =
+        (uint8_t *)(uintptr_t)ctx->surfaces[(int *)frame->opaque - ctx->surface_used];
+    return 0;
+}
+
+static void vaapi_release_buffer(AVCodecContext *s, AVFrame *frame)
+{
+    int i;
+
+    *(int *)frame->opaque = 0;
+    for (i = 0; i < 4; i++)
+        frame->data[i] = NULL;
+}
+
+/* download the surface of frame into memory, as a picture in the format
+   the software decoder would have output */
+static int vaapi_retrieve_data(AVCodecContext *s, AVFrame *frame)
+{
+    AVInputStream *ist = s->opaque;
+    VAAPIContext *ctx  = ist->hwaccel_ctx;
+    VADisplay dpy      = ctx->va.display;
+    VASurfaceID surface = (uintptr_t)frame->data[3];
+    VAImage *image     = &ctx->image;
+    uint8_t *src;
+    VAStatus status;
+    int i, j;
+
+    if (!ctx->have_image) {
+        status = vaCreateImage(dpy, &ctx->image_format, ctx->width, ctx->height, image);
+        if (status != VA_STATUS_SUCCESS)
+            goto fail;
+        ctx->have_image = 1;
+    }
+    if ((status = vaSyncSurface(dpy, surface)) != VA_STATUS_SUCCESS ||
+        (status = vaGetImage(dpy, surface, 0, 0, ctx->width, ctx->height,
+                             image->image_id)) != VA_STATUS_SUCCESS ||
+        (status = vaMapBuffer(dpy, image->buf, (void **)&src)) != VA_STATUS_SUCCESS)
+        goto fail;
+
+    av_image_copy_plane(ctx->data[0], ctx->linesize[0],
+                        src + image->offsets[0], image->pitches[0],
+                        s->width, s->height);
+    if (ctx->image_format.fourcc == VA_FOURCC('N','V','1','2')) {
+        for (j = 0; j < (s->height + 1) >> 1; j++) {
+            const uint8_t *uv = src + image->offsets[1] + j * image->pitches[1];
+            uint8_t *u = ctx->data[1] + j * ctx->linesize[1];
+            uint8_t *v = ctx->data[2] + j * ctx->linesize[2];
+            for (i = 0; i < (s->width + 1) >> 1; i++) {
+                u[i] = uv[2*i];
+                v[i] = uv[2*i+1];
+            }
+        }
+    } else {
+        /* YV12 stores V before U */
+        int swap = ctx->image_format.fourcc == VA_FOURCC('Y','V','1','2');
+        for (i = 1; i < 3; i++)
+            av_image_copy_plane(ctx->data[swap ? 3 - i : i], ctx->linesize[swap ? 3 - i : i],
+                                src + image->offsets[i], image->pitches[i],
+                                (s->width + 1) >> 1, (s->height + 1) >> 1);
+    }
+    vaUnmapBuffer(dpy, image->buf);
+
+    for (i = 0; i < 4; i++) {
+        frame->data[i]     = ctx->data[i];
+        frame->linesize[i] = ctx->linesize[i];
+    }
+    frame->opaque = NULL;
+    frame->format = ist->hwaccel_sw_pix_fmt;
+    return 0;
+
+fail:
+    av_log(s, AV_LOG_ERROR, "Failed to retrieve a VA-API surface: %s\n",
+           vaErrorStr(status));
+    return AVERROR(EIO);
+}
+
+static int vaapi_init(AVCodecContext *s)
+{
+    AVInputStream *ist = s->opaque;
+    VAAPIContext *ctx  = ist->hwaccel_ctx;
+    VADisplay dpy;
+    VAProfile profile, *profiles = NULL;
+    VAEntrypoint *entrypoints = NULL;
+    VAImageFormat *formats = NULL;
+    VAConfigAttrib attrib = { VAConfigAttribRTFormat };
+    VAStatus status;
+    int major, minor, nb, i, ret = AVERROR(ENOSYS);
+
+    if (vaapi_profile(s, &profile) < 0)
+        return AVERROR(ENOSYS);
+    /* surfaces given to the decoder are released until the end, so the
+       context cannot be recreated for other parameters */
+    if (ctx)
+        return ctx->profile == profile && ctx->width == s->width &&
+               ctx->height == s->height ? 0 : AVERROR(ENOSYS);
+
+    if (!(ctx = av_mallocz(sizeof(*ctx))))
+        return AVERROR(ENOMEM);
+    ist->hwaccel_ctx    = ctx;
+    ist->hwaccel_uninit = vaapi_uninit;
+    ctx->profile        = profile;
+    ctx->width          = s->width;
+    ctx->height         = s->height;
+
+    if (!(ctx->x11_display = XOpenDisplay(ist->hwaccel_device))) {
+        av_log(s, AV_LOG_ERROR, "Cannot open the X11 display %s\n",
+               XDisplayName(ist->hwaccel_device));
+        goto fail;
+    }
+    dpy = vaGetDisplay(ctx->x11_display);
+    if (vaInitialize(dpy, &major, &minor) != VA_STATUS_SUCCESS)
+        goto fail;
+    ctx->va.display = dpy;
+
+    /* check that the driver decodes this profile */
+    profiles    = av_malloc(vaMaxNumProfiles(dpy)    * sizeof(*profiles));
+    entrypoints = av_malloc(vaMaxNumEntrypoints(dpy) * sizeof(*entrypoints));
+    formats     = av_malloc(vaMaxNumImageFormats(dpy) * sizeof(*formats));
+    if (!profiles || !entrypoints || !formats) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    if (vaQueryConfigProfiles(dpy, profiles, &nb) != VA_STATUS_SUCCESS)
+        goto fail;
+    for (i = 0; i < nb && profiles[i] != profile; i++);
+    if (i == nb)
+        goto fail;
+    if (vaQueryConfigEntrypoints(dpy, profile, entrypoints, &nb) != VA_STATUS_SUCCESS)
+        goto fail;
+    for (i = 0; i < nb && entrypoints[i] != VAEntrypointVLD; i++);
+    if (i == nb)
+        goto fail;
+    if (vaGetConfigAttributes(dpy, profile, VAEntrypointVLD, &attrib, 1) != VA_STATUS_SUCCESS ||
+        !(attrib.value & VA_RT_FORMAT_YUV420))
+        goto fail;
+
+    /* pick a format the surfaces can be read back in */
+    if (vaQueryImageFormats(dpy, formats, &nb) != VA_STATUS_SUCCESS)
+        goto fail;
+    for (i = 0; i < nb; i++)
+        if (formats[i].fourcc == VA_FOURCC('N','V','1','2') ||
+            formats[i].fourcc == VA_FOURCC('Y','V','1','2') ||
+            formats[i].fourcc == VA_FOURCC('I','4','2','0'))
+            break;
+    if (i == nb)
+        goto fail;
+    ctx->image_format = formats[i];
+
+    attrib.value = VA_RT_FORMAT_YUV420;
+    status = vaCreateConfig(dpy, profile, VAEntrypointVLD, &attrib, 1, &ctx->va.config_id);
+    if (status != VA_STATUS_SUCCESS)
+        goto fail_status;
+    ctx->have_config = 1;
+    status = vaCreateSurfaces(dpy, s->width, s->height, VA_RT_FORMAT_YUV420,
+                              VAAPI_NB_SURFACES, ctx->surfaces);
+    if (status != VA_STATUS_SUCCESS)
+        goto fail_status;
+    ctx->have_surfaces = 1;
+    status = vaCreateContext(dpy, ctx->va.config_id, s->width, s->height,
+                             VA_PROGRESSIVE, ctx->surfaces, VAAPI_NB_SURFACES,
+                             &ctx->va.context_id);
+    if (status != VA_STATUS_SUCCESS)
+        goto fail_status;
+    ctx->have_context = 1;
+
+    if ((ret = av_image_alloc(ctx->data, ctx->linesize, s->width, s->height,
+                              PIX_FMT_YUV420P, 16)) < 0)
+        goto fail;
+
+    av_free(profiles);
+    av_free(entrypoints);
+    av_free(formats);
+    s->hwaccel_context          = &ctx->va;
+    ist->hwaccel_get_buffer     = vaapi_get_buffer;
+    ist->hwaccel_release_buffer = vaapi_release_buffer;
+    ist->hwaccel_retrieve_data  = vaapi_retrieve_data;
+    return 0;
+
+fail_status:
+    av_log(s, AV_LOG_ERROR, "VA-API setup failed: %s\n", vaErrorStr(status));
+fail:
+    av_free(profiles);
+    av_free(entrypoints);
+    av_free(formats);
+    vaapi_uninit(s);
+    return ret;
+}
+#endif
+
+static const HWAccel hwaccels[] = {
+#if CONFIG_VAAPI && HAVE_VA_X11
+    { "vaapi", vaapi_init, HWACCEL_VAAPI, PIX_FMT_VAAPI_VLD },
+#endif
+    { 0 },
+};
+
+/* pick the hwaccel format offered by the decoder if its hwaccel can be set
+   up, otherwise fall back to software decoding */
+static enum PixelFormat get_format(AVCodecContext *s, const enum PixelFormat *pix_fmts)
+{
+    AVInputStream *ist = s->opaque;
+    const enum PixelFormat *p, *sw;
+    int i;
+
+    for (sw = pix_fmts; *sw != PIX_FMT_NONE; sw++)
+        if (!(av_pix_fmt_descriptors[*sw].flags & PIX_FMT_HWACCEL))
+            break;
+
+    for (p = pix_fmts; p != sw; p++) {
+        const HWAccel *hwaccel = NULL;
+
+        for (i = 0; hwaccels[i].name; i++)
+            if (hwaccels[i].pix_fmt == *p)
+                hwaccel = &hwaccels[i];
+        if (!hwaccel ||
+            (ist->hwaccel_id != HWACCEL_AUTO && ist->hwaccel_id != hwaccel->id) ||
+            (ist->active_hwaccel_id && ist->active_hwaccel_id != hwaccel->id))
+            continue;
+
+        if (hwaccel->init(s) < 0) {
+            if (verbose >= 0)
+                fprintf(stderr, "%s hwaccel cannot decode input stream #%d.%d, "
+                        "decoding in software\n",
+                        hwaccel->name, ist->file_index, ist->st->index);
+            continue;
+        }
+        ist->active_hwaccel_id  = hwaccel->id;
+        ist->hwaccel_pix_fmt    = *p;
+        ist->hwaccel_sw_pix_fmt = *sw;
+        return *p;
+    }
+    return *sw;
+}
+
+/* pixel format of the decoded pictures, once retrieved from the surfaces
+   of the hwaccel */
+static enum PixelFormat decoded_pix_fmt(AVInputStream *ist)
+{
+    if (ist->active_hwaccel_id && ist->st->codec->pix_fmt == ist->hwaccel_pix_fmt)
+        return ist->hwaccel_sw_pix_fmt;
+    return ist->st->codec->pix_fmt;
+}
+
+#if CONFIG_AVFILTER
+/**
+ * Picture buffer allocated by ffmpeg for a decoder, which can be passed
+ * to the filters without copying it. It is returned to the pool of its
+ * input stream when both the decoder and the filters released it.
+ */
+typedef struct FrameBuffer {
+    uint8_t *base[4];
+    uint8_t *data[4];
+    int  linesize[4];
+    int w, h;
+    enum PixelFormat pix_fmt;
+    int refcount;
+    AVInputStream *ist;
+    struct FrameBuffer *next;
+} FrameBuffer;
+
+static int alloc_buffer(AVInputStream *ist, AVCodecContext *s, FrameBuffer **pbuf)
+{
+    FrameBuffer *buf;
+    const int pixel_size = av_pix_fmt_descriptors[s->pix_fmt].comp[0].step_minus1+1;
+    const int edge = avcodec_get_edge_width();
+    int stride_align[4];
+    int h_chroma_shift, v_chroma_shift;
+    int w = s->width, h = s->height;
+    int i, size;
+
+    if (av_image_check_size(w, h, 0, s))
+        return AVERROR(EINVAL);
+    if (!(buf = av_mallocz(sizeof(*buf))))
+        return AVERROR(ENOMEM);
+
+    avcodec_align_dimensions2(s, &w, &h, stride_align);
+    if (!(s->flags & CODEC_FLAG_EMU_EDGE)) {
+        w += 2*edge;
+        h += 2*edge;
+    }
+
+    if ((size = av_image_alloc(buf->base, buf->linesize, w, h, s->pix_fmt, 32)) < 0) {
+        av_free(buf);
+        return size;
+    }
+    /* some decoders rely on the initial content of the buffer, as is the
+     * case with the default get_buffer() */
+    memset(buf->base[0], 128, size);
+
+    avcodec_get_chroma_sub_sample(s->pix_fmt, &h_chroma_shift, &v_chroma_shift);
+    for (i = 0; i < 4; i++) {
+        const int h_shift = i==0 ? 0 : h_chroma_shift;
+        const int v_shift = i==0 ? 0 : v_chroma_shift;
+
+        // no edge if EDGE EMU or not planar YUV
+        if ((s->flags & CODEC_FLAG_EMU_EDGE) || !buf->linesize[2] || !buf->linesize[i])
+            buf->data[i] = buf->base[i];
+        else
+            buf->data[i] = buf->base[i] +
+                           FFALIGN((buf->linesize[i]*edge >> v_shift) +
+                                   (pixel_size*edge >> h_shift), stride_align[i]);
+    }
+    buf->w       = s->width;
+    buf->h       = s->height;
+    buf->pix_fmt = s->pix_fmt;
+    buf->ist     = ist;
+
+    *pbuf = buf;
+    return 0;
+}
+
+static void free_buffer_pool(AVInputStream *ist)
+{
+    FrameBuffer *buf;
+
+    while ((buf = ist->buffer_pool)) {
+        ist->buffer_pool = buf->next;
+        av_freep(&buf->base[0]);
+        av_free(buf);
+    }
+}
+
+static void unref_buffer(AVInputStream *ist, FrameBuffer *buf)
+{
+    av_assert0(buf->refcount);
+    if (!--buf->refcount) {
+        buf->next = ist->buffer_pool;
+        ist->buffer_pool = buf;
+    }
+}
+
+static int codec_get_buffer(AVCodecContext *s, AVFrame *frame)
+{
+    AVInputStream *ist = s->opaque;
+    FrameBuffer *buf;
+    int ret, i;
+
+    if (ist->active_hwaccel_id && s->pix_fmt == ist->hwaccel_pix_fmt)
+        return ist->hwaccel_get_buffer(s, frame);
+
+    if (!ist->buffer_pool && (ret = alloc_buffer(ist, s, &ist->buffer_pool)) < 0)
+        return ret;
+
+    buf              = ist->buffer_pool;
+    ist->buffer_pool = buf->next;
+    buf->next        = NULL;
+    if (buf->w != s->width || buf->h != s->height || buf->pix_fmt != s->pix_fmt) {
+        av_freep(&buf->base[0]);
+        av_free(buf);
+        if ((ret = alloc_buffer(ist, s, &buf)) < 0)
+            return ret;
+    }
+    buf->refcount++;
+
+    frame->opaque              = buf;
+    frame->type                = FF_BUFFER_TYPE_USER;
+    frame->age                 = INT_MAX;
+    frame->pkt_pts             = s->pkt ? s->pkt->pts : AV_NOPTS_VALUE;
+    frame->pkt_pos             = s->pkt ? s->pkt->pos : -1;
+    frame->reordered_opaque    = s->reordered_opaque;
+    frame->sample_aspect_ratio = s->sample_aspect_ratio;
+    frame->width               = s->width;
+    frame->height              = s->height;
+    frame->format              = s->pix_fmt;
+
+    for (i = 0; i < 4; i++) {
+        frame->base[i]     = buf->base[i];
+        frame->data[i]     = buf->data[i];
+        frame->linesize[i] = buf->linesize[i];
+    }
+
+    return 0;
+}
+
+static void codec_release_buffer(AVCodecContext *s, AVFrame *frame)
+{
+    AVInputStream *ist = s->opaque;
+    FrameBuffer *buf = frame->opaque;
+    int i;
+
+    if (ist->active_hwaccel_id && frame->format == ist->hwaccel_pix_fmt) {
+        ist->hwaccel_release_buffer(s, frame);
+        return;
+    }
+
+    for (i = 0; i < 4; i++)
+        frame->data[i] = NULL;
+
+    unref_buffer(ist, buf);
+}
+
+static void filter_release_buffer(AVFilterBuffer *fb)
+{
+    FrameBuffer *buf = fb->priv;
+
+    av_free(fb);
+    unref_buffer(buf->ist, buf);
+}
+
+/* pass a decoded picture to a buffer source, by reference when it was
+   allocated from the buffer pool of the stream */
+static int add_decoded_frame(AVInputStream *ist, AVFilterContext *src,
+                             AVFrame *picture, int no_copy)
+{
+    if (no_copy) {
+        FrameBuffer      *buf = picture->opaque;
+        AVFilterBufferRef *fb = avfilter_get_video_buffer_ref_from_arrays(
+                                    picture->data, picture->linesize,
+                                    AV_PERM_READ | AV_PERM_PRESERVE,
+                                    ist->st->codec->width, ist->st->codec->height,
+                                    ist->st->codec->pix_fmt);
+        if (!fb)
+            return AVERROR(ENOMEM);
+        avfilter_copy_frame_props(fb, picture);
+        fb->buf->priv = buf;
+        fb->buf->free = filter_release_buffer;
+        buf->refcount++;
+
+        av_vsrc_buffer_add_video_buffer_ref(src, fb,
+                                            AV_VSRC_BUF_FLAG_OVERWRITE |
+                                            AV_VSRC_BUF_FLAG_NO_COPY);
+        avfilter_unref_buffer(fb);
+    } else
+        av_vsrc_buffer_add_frame(src, picture, AV_VSRC_BUF_FLAG_OVERWRITE);
+    return 0;
+}
+
+/* pass the next output of the filters of the input stream to all the
+   output streams sharing them, returns 0 if there was none */
+static int add_shared_frame(AVInputStream *ist, int ist_index,
+                            AVOutputStream **ost_table, int nb_ostreams)
+{
+    AVFilterBufferRef *picref, *ref;
+    int i;
+
+    if (avfilter_poll_frame(ist->output_video_filter->inputs[0]) <= 0 ||
+        av_vsink_buffer_get_video_buffer_ref(ist->output_video_filter, &picref, 0) < 0)
+        return 0;
+
+    /* the frame is read by several graphs, none of them may modify it */
+    if (!(ref = avfilter_ref_buffer(picref, ~AV_PERM_WRITE))) {
+        avfilter_unref_buffer(picref);
+        return AVERROR(ENOMEM);
+    }
+    ref->pts = av_rescale_q(picref->pts, ist->output_video_filter->inputs[0]->time_base,
+                            AV_TIME_BASE_Q);
+    for (i = 0; i < nb_ostreams; i++) {
+        AVOutputStream *ost = ost_table[i];
+        if (ost->source_index == ist_index && ost->shared_filters)
+            av_vsrc_buffer_add_video_buffer_ref(ost->input_video_filter, ref,
+                                                AV_VSRC_BUF_FLAG_OVERWRITE |
+                                                AV_VSRC_BUF_FLAG_NO_COPY);
+    }
+    avfilter_unref_buffer(ref);
+    avfilter_unref_buffer(picref);
+    return 1;
+}
+#endif
+
 typedef struct AVInputFile {
     AVFormatContext *ctx;
     int eof_reached;      /* true if eof reached */
     int ist_index;        /* index of first stream in ist_table */
     int buffer_size;      /* current total buffer size */
+    int thread_queue_size; /* maximum number of packets read ahead */
+#if HAVE_PTHREADS
+    pthread_t thread;     /* demuxing thread, reads ahead into fifo */
+    AVFifoBuffer *fifo;   /* packets read by the thread, NULL if none */
+    pthread_mutex_t fifo_lock;
+    pthread_cond_t fifo_cond;
+    int thread_ret;       /* error or EOF that stopped the thread, 0 while running */
+    int abort_request;    /* set to make the thread stop */
+    int non_blocking;     /* return EAGAIN instead of waiting for the thread */
+#endif
+    BenchStats bench;
 } AVInputFile;
 
 #if HAVE_TERMIOS_H
@@ -358,6 +1069,126 @@ static int         nb_input_files   = 0;
 
 #if CONFIG_AVFILTER
 
+/**
+ * Find the filters that all the encoded video outputs of an input stream
+ * start with. They are moved to the filter graph of the input stream, so
+ * that e.g. a deinterlacer runs once for all the renditions of a source,
+ * before they are scaled to their own size.
+ * Only plain chains of filters are considered, not labeled graphs.
+ */
+static void share_video_filters(AVOutputStream **ost_table, int nb_ostreams)
+{
+    int i, j, k;
+
+    for (i = 0; i < nb_input_streams; i++) {
+        AVInputStream *ist = &input_streams[i];
+        const char *first = NULL;
+        int nb_shared = 0, len = 0;
+
+        for (j = 0; j < nb_ostreams; j++) {
+            AVOutputStream *ost = ost_table[j];
+            const char *chain = ost->avfilter;
+
+            if (ost->source_index != i || ost->st->stream_copy ||
+                ost->st->codec->codec_type != AVMEDIA_TYPE_VIDEO || !chain ||
+                strpbrk(chain, "[];'\\"))
+                continue;
+            if (!first) {
+                first = chain;
+                len   = strlen(chain);
+            }
+            for (k = 0; k < len && chain[k] == first[k]; k++)
+                ;
+            len = k;
+            ost->shared_filters = 1;
+            nb_shared++;
+        }
+        if (nb_shared < 2)
+            len = 0;
+
+        /* the common part must end on a filter boundary in every chain */
+        for (j = 0; len && j < nb_ostreams; j++) {
+            AVOutputStream *ost = ost_table[j];
+            if (ost->source_index == i && ost->shared_filters &&
+                ost->avfilter[len] != ',' && ost->avfilter[len]) {
+                while (len > 0 && first[len] != ',')
+                    len--;
+                break;
+            }
+        }
+
+        for (j = 0; j < nb_ostreams; j++) {
+            AVOutputStream *ost = ost_table[j];
+            char *rest;
+
+            if (ost->source_index != i || !ost->shared_filters)
+                continue;
+            if (!len) {
+                ost->shared_filters = 0;
+                continue;
+            }
+            if (!ist->avfilter && (ist->avfilter = av_malloc(len + 1)))
+                av_strlcpy(ist->avfilter, ost->avfilter, len + 1);
+            rest = ost->avfilter[len] ? av_strdup(ost->avfilter + len + 1) : NULL;
+            av_freep(&ost->avfilter);
+            ost->avfilter = rest;
+        }
+    }
+}
+
+static int configure_input_filters(AVInputStream *ist)
+{
+    AVCodecContext *icodec = ist->st->codec;
+    enum PixelFormat pix_fmts[] = { icodec->pix_fmt, PIX_FMT_NONE };
+    AVFilterInOut *outputs, *inputs;
+    AVRational sample_aspect_ratio;
+    char args[255];
+    int ret;
+
+    if (!(ist->graph = avfilter_graph_alloc()))
+        return AVERROR(ENOMEM);
+    ist->graph->thread_count = thread_count;
+    ist->graph->thread_pool  = avcodec_thread_pool_get(thread_pool);
+    avfilter_graph_enable_stats(ist->graph, do_benchmark);
+
+    if (ist->st->sample_aspect_ratio.num){
+        sample_aspect_ratio = ist->st->sample_aspect_ratio;
+    }else
+        sample_aspect_ratio = icodec->sample_aspect_ratio;
+
+    snprintf(args, 255, "%d:%d:%d:%d:%d:%d:%d", icodec->width,
+             icodec->height, icodec->pix_fmt, 1, AV_TIME_BASE,
+             sample_aspect_ratio.num, sample_aspect_ratio.den);
+
+    ret = avfilter_graph_create_filter(&ist->input_video_filter, avfilter_get_by_name("buffer"),
+                                       "src", args, NULL, ist->graph);
+    if (ret < 0)
+        return ret;
+    ret = avfilter_graph_create_filter(&ist->output_video_filter, avfilter_get_by_name("buffersink"),
+                                       "out", NULL, pix_fmts, ist->graph);
+    if (ret < 0)
+        return ret;
+
+    outputs = avfilter_inout_alloc();
+    inputs  = avfilter_inout_alloc();
+
+    outputs->name    = av_strdup("in");
+    outputs->filter_ctx = ist->input_video_filter;
+    outputs->pad_idx = 0;
+    outputs->next    = NULL;
+
+    inputs->name    = av_strdup("out");
+    inputs->filter_ctx = ist->output_video_filter;
+    inputs->pad_idx = 0;
+    inputs->next    = NULL;
+
+    if ((ret = avfilter_graph_parse(ist->graph, ist->avfilter, &inputs, &outputs, NULL)) < 0)
+        return ret;
+    av_freep(&ist->avfilter);
+
+    return avfilter_graph_config(ist->graph, NULL);
+}
+
 static int configure_video_filters(AVInputStream *ist, AVOutputStream *ost)
 {
     AVFilterContext *last_filter, *filter;
@@ -369,16 +1200,31 @@ static int configure_video_filters(AVInputStream *ist, AVOutputStream *ost)
     char args[255];
     int ret;
 
-    ost->graph = avfilter_graph_alloc();
+    if (ost->shared_filters && !ist->graph &&
+        (ret = configure_input_filters(ist)) < 0)
+        return ret;
 
-    if (ist->st->sample_aspect_ratio.num){
-        sample_aspect_ratio = ist->st->sample_aspect_ratio;
-    }else
-        sample_aspect_ratio = ist->st->codec->sample_aspect_ratio;
+    ost->graph = avfilter_graph_alloc();
+    ost->graph->thread_count = thread_count;
+    ost->graph->thread_pool  = avcodec_thread_pool_get(thread_pool);
+    avfilter_graph_enable_stats(ost->graph, do_benchmark);
+
+    if (ost->shared_filters) {
+        /* the input is what the filters of the input stream output */
+        AVFilterLink *inlink = ist->output_video_filter->inputs[0];
+        snprintf(args, 255, "%d:%d:%d:%d:%d:%d:%d", inlink->w, inlink->h,
+                 inlink->format, 1, AV_TIME_BASE,
+                 inlink->sample_aspect_ratio.num, inlink->sample_aspect_ratio.den);
+    } else {
+        if (ist->st->sample_aspect_ratio.num){
+            sample_aspect_ratio = ist->st->sample_aspect_ratio;
+        }else
+            sample_aspect_ratio = ist->st->codec->sample_aspect_ratio;
 
-    snprintf(args, 255, "%d:%d:%d:%d:%d:%d:%d", ist->st->codec->width,
-             ist->st->codec->height, ist->st->codec->pix_fmt, 1, AV_TIME_BASE,
-             sample_aspect_ratio.num, sample_aspect_ratio.den);
+        snprintf(args, 255, "%d:%d:%d:%d:%d:%d:%d", ist->st->codec->width,
+                 ist->st->codec->height, ist->st->codec->pix_fmt, 1, AV_TIME_BASE,
+                 sample_aspect_ratio.num, sample_aspect_ratio.den);
+    }
 
     ret = avfilter_graph_create_filter(&ost->input_video_filter, avfilter_get_by_name("buffer"),
                                        "src", args, NULL, ost->graph);
@@ -523,12 +1369,25 @@ static int read_key(void)
     return -1;
 }
 
+#if HAVE_PTHREADS
+static pthread_t main_thread;
+static volatile int input_threads_abort;
+#endif
+
 static int decode_interrupt_cb(void)
 {
+#if HAVE_PTHREADS
+    /* the terminal is only read by the main thread, the input threads
+       just follow it and are interrupted when they must stop */
+    if (!pthread_equal(pthread_self(), main_thread))
+        return input_threads_abort || q_pressed > 1;
+#endif
     q_pressed += read_key() == 'q';
     return q_pressed > 1;
 }
 
+static void free_input_threads(AVInputFile *input_files, int nb_input_files);
+
 static int ffmpeg_exit(int ret)
 {
     int i;
@@ -541,6 +1400,7 @@ static int ffmpeg_exit(int ret)
         avformat_free_context(s);
         av_free(output_streams_for_file[i]);
     }
+    free_input_threads(input_files, nb_input_files);
     for(i=0;i<nb_input_files;i++) {
         av_close_input_file(input_files[i].ctx);
         av_free(input_files_ts_scale[i]);
@@ -549,17 +1409,25 @@ static int ffmpeg_exit(int ret)
     av_free(intra_matrix);
     av_free(inter_matrix);
 
+    avcodec_thread_pool_unref(&thread_pool);
+
     if (vstats_file)
         fclose(vstats_file);
     av_free(vstats_filename);
 
+    if (progress_avio)
+        avio_close(progress_avio);
+
     av_free(streamid_map);
     av_free(input_codecs);
     av_free(stream_maps);
     av_free(meta_data_maps);
 
+    for (i = 0; i < nb_input_streams; i++)
+        av_free(input_streams[i].hwaccel_device);
     av_freep(&input_streams);
     av_freep(&input_files);
+    av_freep(&hwaccel_device);
 
     av_free(video_codec_name);
     av_free(audio_codec_name);
@@ -752,6 +1620,8 @@ static int read_ffserver_streams(AVFormatContext *s, const char *filename)
 
     if (!nopts)
         s->timestamp = av_gettime();
+    /* write the feed with the packet size ffserver expects */
+    s->packet_size = ic->packet_size;
 
     av_close_input_file(ic);
     return 0;
@@ -764,19 +1634,15 @@ get_sync_ipts(const AVOutputStream *ost)
     return (double)(ist->pts - start_time)/AV_TIME_BASE;
 }
 
-static void write_frame(AVFormatContext *s, AVPacket *pkt, AVCodecContext *avctx, AVBitStreamFilterContext *bsfc){
+static void write_frame(AVFormatContext *s, AVPacket *pkt, AVOutputStream *ost){
+    AVCodecContext *avctx = ost->st->codec;
+    AVBitStreamFilterContext *bsfc = ost->bitstream_filters;
+    BenchTimer t;
     int ret;
 
     while(bsfc){
-        AVPacket new_pkt= *pkt;
-        int a= av_bitstream_filter_filter(bsfc, avctx, NULL,
-                                          &new_pkt.data, &new_pkt.size,
-                                          pkt->data, pkt->size,
-                                          pkt->flags & AV_PKT_FLAG_KEY);
-        if(a>0){
-            av_free_packet(pkt);
-            new_pkt.destruct= av_destruct_packet;
-        } else if(a<0){
+        int a= av_bitstream_filter_filter_packet(bsfc, avctx, NULL, pkt);
+        if(a<0){
             fprintf(stderr, "%s failed for stream %d, codec %s",
                     bsfc->filter->name, pkt->stream_index,
                     avctx->codec ? avctx->codec->name : "copy");
@@ -784,12 +1650,13 @@ static void write_frame(AVFormatContext *s, AVPacket *pkt, AVCodecContext *avctx
             if (exit_on_error)
                 ffmpeg_exit(1);
         }
-        *pkt= new_pkt;
 
         bsfc= bsfc->next;
     }
 
+    t = bench_start();
     ret= av_interleaved_write_frame(s, pkt);
+    bench_stop(&t, &ost->bench, BENCH_MUX);
     if(ret < 0){
         print_error("av_interleaved_write_frame()", ret);
         ffmpeg_exit(1);
@@ -798,6 +1665,26 @@ static void write_frame(AVFormatContext *s, AVPacket *pkt, AVCodecContext *avctx
 
 #define MAX_AUDIO_PACKET_SIZE (128 * 1024)
 
+#define INTERLEAVE(type)                                                \
+    for (ch = 0; ch < channels; ch++) {                                 \
+        const type *src = (const type *)frame->extended_data[ch];      \
+        for (i = 0; i < frame->nb_samples; i++)                         \
+            ((type *)dst)[i * channels + ch] = src[i];                  \
+    }
+
+static void interleave_audio_frame(uint8_t *dst, const AVFrame *frame,
+                                   int channels, int bps)
+{
+    int ch, i;
+
+    switch (bps) {
+    case 1:  INTERLEAVE(uint8_t);  break;
+    case 2:  INTERLEAVE(int16_t);  break;
+    case 4:  INTERLEAVE(int32_t);  break;
+    default: INTERLEAVE(uint64_t); break;
+    }
+}
+
 static void do_audio_out(AVFormatContext *s,
                          AVOutputStream *ost,
                          AVInputStream *ist,
@@ -945,11 +1832,13 @@ need_realloc:
                         - av_fifo_size(ost->fifo)/(enc->channels * 2); //FIXME wrong
 
     if (ost->audio_resample) {
+        BenchTimer t = bench_start();
         buftmp = audio_buf;
         size_out = audio_resample(ost->resample,
                                   (short *)buftmp, (short *)buf,
                                   size / (dec->channels * isize));
         size_out = size_out * enc->channels * osize;
+        bench_stop(&t, &ost->bench, BENCH_SCALE);
     } else {
         buftmp = buf;
         size_out = size;
@@ -973,25 +1862,47 @@ need_realloc:
 
     /* now encode as many frames as possible */
     if (enc->frame_size > 1) {
-        /* output resampled raw samples */
-        if (av_fifo_realloc2(ost->fifo, av_fifo_size(ost->fifo) + size_out) < 0) {
+        frame_bytes = enc->frame_size * osize * enc->channels;
+
+        /* the fifo only ever holds the start of one frame */
+        if (av_fifo_realloc2(ost->fifo, frame_bytes) < 0) {
             fprintf(stderr, "av_fifo_realloc2() failed\n");
             ffmpeg_exit(1);
         }
-        av_fifo_generic_write(ost->fifo, buftmp, size_out, NULL);
 
-        frame_bytes = enc->frame_size * osize * enc->channels;
-
-        while (av_fifo_size(ost->fifo) >= frame_bytes) {
+        while (size_out > 0) {
             AVPacket pkt;
+            BenchTimer t;
+            const uint8_t *frame;
+            int fifo_bytes = av_fifo_size(ost->fifo);
+
+            if (!fifo_bytes && size_out >= frame_bytes) {
+                /* whole frames are encoded from the samples in place */
+                frame = buftmp;
+                buftmp   += frame_bytes;
+                size_out -= frame_bytes;
+            } else {
+                /* a frame split between calls is gathered in the fifo,
+                   from its start so that it is contiguous */
+                int len = FFMIN(size_out, frame_bytes - fifo_bytes);
+                if (!fifo_bytes)
+                    av_fifo_reset(ost->fifo);
+                av_fifo_generic_write(ost->fifo, buftmp, len, NULL);
+                buftmp   += len;
+                size_out -= len;
+                if (av_fifo_size(ost->fifo) < frame_bytes)
+                    break;
+                frame = ost->fifo->rptr;
+                av_fifo_drain(ost->fifo, frame_bytes);
+            }
             av_init_packet(&pkt);
 
-            av_fifo_generic_read(ost->fifo, audio_buf, frame_bytes, NULL);
-
             //FIXME pass ost->sync_opts as AVFrame.pts in avcodec_encode_audio()
 
+            t = bench_start();
             ret = avcodec_encode_audio(enc, audio_out, audio_out_size,
-                                       (short *)audio_buf);
+                                       (const short *)frame);
+            bench_stop(&t, &ost->bench, BENCH_ENCODE);
             if (ret < 0) {
                 fprintf(stderr, "Audio encoding failed\n");
                 ffmpeg_exit(1);
@@ -1003,12 +1914,13 @@ need_realloc:
             if(enc->coded_frame && enc->coded_frame->pts != AV_NOPTS_VALUE)
                 pkt.pts= av_rescale_q(enc->coded_frame->pts, enc->time_base, ost->st->time_base);
             pkt.flags |= AV_PKT_FLAG_KEY;
-            write_frame(s, &pkt, enc, ost->bitstream_filters);
+            write_frame(s, &pkt, ost);
 
             ost->sync_opts += enc->frame_size;
         }
     } else {
         AVPacket pkt;
+        BenchTimer t;
         av_init_packet(&pkt);
 
         ost->sync_opts += size_out / (osize * enc->channels);
@@ -1025,8 +1937,10 @@ need_realloc:
         }
 
         //FIXME pass ost->sync_opts as AVFrame.pts in avcodec_encode_audio()
+        t = bench_start();
         ret = avcodec_encode_audio(enc, audio_out, size_out,
                                    (short *)buftmp);
+        bench_stop(&t, &ost->bench, BENCH_ENCODE);
         if (ret < 0) {
             fprintf(stderr, "Audio encoding failed\n");
             ffmpeg_exit(1);
@@ -1038,16 +1952,17 @@ need_realloc:
         if(enc->coded_frame && enc->coded_frame->pts != AV_NOPTS_VALUE)
             pkt.pts= av_rescale_q(enc->coded_frame->pts, enc->time_base, ost->st->time_base);
         pkt.flags |= AV_PKT_FLAG_KEY;
-        write_frame(s, &pkt, enc, ost->bitstream_filters);
+        write_frame(s, &pkt, ost);
     }
 }
 
-static void pre_process_video_frame(AVInputStream *ist, AVPicture *picture, void **bufp)
+/* return 1 if picture was replaced by a picture in the deinterlacing
+   buffer of the stream, which is overwritten by the next frame */
+static int pre_process_video_frame(AVInputStream *ist, AVPicture *picture)
 {
     AVCodecContext *dec;
-    AVPicture *picture2;
     AVPicture picture_tmp;
-    uint8_t *buf = 0;
+    enum PixelFormat pix_fmt = decoded_pix_fmt(ist);
 
     dec = ist->st->codec;
 
@@ -1055,30 +1970,26 @@ static void pre_process_video_frame(AVInputStream *ist, AVPicture *picture, void
     if (do_deinterlace) {
         int size;
 
-        /* create temporary picture */
-        size = avpicture_get_size(dec->pix_fmt, dec->width, dec->height);
-        buf = av_malloc(size);
-        if (!buf)
-            return;
+        /* the buffer is kept from frame to frame */
+        size = avpicture_get_size(pix_fmt, dec->width, dec->height);
+        if (size < 0)
+            return 0;
+        av_fast_malloc(&ist->deinterlace_buf, &ist->deinterlace_buf_size, size);
+        if (!ist->deinterlace_buf)
+            return 0;
 
-        picture2 = &picture_tmp;
-        avpicture_fill(picture2, buf, dec->pix_fmt, dec->width, dec->height);
+        avpicture_fill(&picture_tmp, ist->deinterlace_buf, pix_fmt, dec->width, dec->height);
 
-        if(avpicture_deinterlace(picture2, picture,
-                                 dec->pix_fmt, dec->width, dec->height) < 0) {
+        if(avpicture_deinterlace(&picture_tmp, picture,
+                                 pix_fmt, dec->width, dec->height) < 0) {
             /* if error, do not deinterlace */
             fprintf(stderr, "Deinterlacing failed\n");
-            av_free(buf);
-            buf = NULL;
-            picture2 = picture;
+            return 0;
         }
-    } else {
-        picture2 = picture;
+        *picture = picture_tmp;
+        return 1;
     }
-
-    if (picture != picture2)
-        *picture = *picture2;
-    *bufp = buf;
+    return 0;
 }
 
 /* we begin to correct av delay at this threshold */
@@ -1095,6 +2006,7 @@ static void do_subtitle_out(AVFormatContext *s,
     int subtitle_out_size, nb, i;
     AVCodecContext *enc;
     AVPacket pkt;
+    BenchTimer t;
 
     if (pts == AV_NOPTS_VALUE) {
         fprintf(stderr, "Subtitle packets must have a pts\n");
@@ -1123,8 +2035,10 @@ static void do_subtitle_out(AVFormatContext *s,
         sub->pts              += av_rescale_q(sub->start_display_time, (AVRational){1, 1000}, AV_TIME_BASE_Q);
         sub->end_display_time -= sub->start_display_time;
         sub->start_display_time = 0;
+        t = bench_start();
         subtitle_out_size = avcodec_encode_subtitle(enc, subtitle_out,
                                                     subtitle_out_max_size, sub);
+        bench_stop(&t, &ost->bench, BENCH_ENCODE);
         if (subtitle_out_size < 0) {
             fprintf(stderr, "Subtitle encoding failed\n");
             ffmpeg_exit(1);
@@ -1143,7 +2057,7 @@ static void do_subtitle_out(AVFormatContext *s,
             else
                 pkt.pts += 90 * sub->end_display_time;
         }
-        write_frame(s, &pkt, ost->st->codec, ost->bitstream_filters);
+        write_frame(s, &pkt, ost);
     }
 }
 
@@ -1160,6 +2074,7 @@ static void do_video_out(AVFormatContext *s,
     AVFrame *final_picture, *formatted_picture;
     AVCodecContext *enc, *dec;
     double sync_ipts;
+    BenchTimer t;
 
     enc = ost->st->codec;
     dec = ist->st->codec;
@@ -1244,9 +2159,13 @@ static void do_video_out(AVFormatContext *s,
                 fprintf(stderr, "Cannot get resampling context\n");
                 ffmpeg_exit(1);
             }
+            av_set_int(ost->img_resample_ctx, "threads", FFMAX(thread_count, 1));
+            sws_set_thread_pool(ost->img_resample_ctx, avcodec_thread_pool_get(thread_pool));
         }
+        t = bench_start();
         sws_scale(ost->img_resample_ctx, formatted_picture->data, formatted_picture->linesize,
               0, ost->resample_height, final_picture->data, final_picture->linesize);
+        bench_stop(&t, &ost->bench, BENCH_SCALE);
     }
 #endif
 
@@ -1267,7 +2186,7 @@ static void do_video_out(AVFormatContext *s,
             pkt.pts= av_rescale_q(ost->sync_opts, enc->time_base, ost->st->time_base);
             pkt.flags |= AV_PKT_FLAG_KEY;
 
-            write_frame(s, &pkt, ost->st->codec, ost->bitstream_filters);
+            write_frame(s, &pkt, ost);
             enc->coded_frame = old_frame;
         } else {
             AVFrame big_picture;
@@ -1297,9 +2216,11 @@ static void do_video_out(AVFormatContext *s,
                 big_picture.pict_type = AV_PICTURE_TYPE_I;
                 ost->forced_kf_index++;
             }
+            t = bench_start();
             ret = avcodec_encode_video(enc,
                                        bit_buffer, bit_buffer_size,
                                        &big_picture);
+            bench_stop(&t, &ost->bench, BENCH_ENCODE);
             if (ret < 0) {
                 fprintf(stderr, "Video encoding failed\n");
                 ffmpeg_exit(1);
@@ -1316,7 +2237,7 @@ static void do_video_out(AVFormatContext *s,
 
                 if(enc->coded_frame->key_frame)
                     pkt.flags |= AV_PKT_FLAG_KEY;
-                write_frame(s, &pkt, ost->st->codec, ost->bitstream_filters);
+                write_frame(s, &pkt, ost);
                 *frame_size = ret;
                 video_size += ret;
                 //fprintf(stderr,"\nFrame: %3d size: %5d type: %d",
@@ -1373,30 +2294,90 @@ static void do_video_stats(AVFormatContext *os, AVOutputStream *ost,
     }
 }
 
+static void print_bench_stats(const char *name, const BenchStats *stats)
+{
+    int i;
+
+    for (i = 0; i < BENCH_NB; i++)
+        if (stats->wall[i] || stats->cpu[i])
+            printf("bench: %-12s %-6s wall=%0.3fs cpu=%0.3fs\n", name,
+                   bench_stage_names[i], stats->wall[i] / 1000000.0,
+                   stats->cpu[i] / 1000000.0);
+}
+
+/**
+ * Print the time spent in each stage: for every file and stream at the
+ * end, summed over all of them during the transcoding.
+ */
+static void print_bench(AVOutputStream **ost_table, int nb_ostreams,
+                        int is_last_report)
+{
+    BenchStats total = { { 0 } };
+    const BenchStats *stats;
+    char name[32];
+    int i, j;
+
+    for (i = 0; i < nb_input_files + nb_input_streams + nb_ostreams; i++) {
+        if (i < nb_input_files) {
+            stats = &input_files[i].bench;
+            snprintf(name, sizeof(name), "input #%d", i);
+        } else if (i < nb_input_files + nb_input_streams) {
+            AVInputStream *ist = &input_streams[i - nb_input_files];
+            stats = &ist->bench;
+            snprintf(name, sizeof(name), "input #%d.%d",
+                     ist->file_index, ist->st->index);
+        } else {
+            AVOutputStream *ost = ost_table[i - nb_input_files - nb_input_streams];
+            stats = &ost->bench;
+            snprintf(name, sizeof(name), "output #%d.%d",
+                     ost->file_index, ost->index);
+        }
+        if (is_last_report)
+            print_bench_stats(name, stats);
+        for (j = 0; j < BENCH_NB; j++) {
+            total.wall[j] += stats->wall[j];
+            total.cpu[j]  += stats->cpu[j];
+        }
+    }
+
+    if (is_last_report) {
+        print_bench_stats("total", &total);
+    } else {
+        fprintf(stderr, "\nbench:");
+        for (j = 0; j < BENCH_NB; j++)
+            fprintf(stderr, " %s=%0.2fs/%0.2fs", bench_stage_names[j],
+                    total.wall[j] / 1000000.0, total.cpu[j] / 1000000.0);
+        fprintf(stderr, "\n");
+    }
+}
+
 static void print_report(AVFormatContext **output_files,
                          AVOutputStream **ost_table, int nb_ostreams,
                          int is_last_report)
 {
     char buf[1024];
+    char buf_script[1024];
     AVOutputStream *ost;
     AVFormatContext *oc;
     int64_t total_size;
     AVCodecContext *enc;
     int frame_number, vid, i;
-    double bitrate;
+    double bitrate, speed;
     int64_t pts = INT64_MAX;
     static int64_t last_time = -1;
     static int qp_histogram[52];
+    int hours, mins, secs, us;
+    float t = (av_gettime()-timer_start) / 1000000.0;
 
     if (!is_last_report) {
         int64_t cur_time;
-        /* display the report every 0.5 seconds */
+        /* display the report every stats_period, 0.5 seconds by default */
         cur_time = av_gettime();
         if (last_time == -1) {
             last_time = cur_time;
             return;
         }
-        if ((cur_time - last_time) < 500000)
+        if ((cur_time - last_time) < stats_period)
             return;
         last_time = cur_time;
     }
@@ -1409,6 +2390,7 @@ static void print_report(AVFormatContext **output_files,
         total_size= avio_tell(oc->pb);
 
     buf[0] = '\0';
+    buf_script[0] = '\0';
     vid = 0;
     for(i=0;i<nb_ostreams;i++) {
         float q = -1;
@@ -1419,12 +2401,15 @@ static void print_report(AVFormatContext **output_files,
         if (vid && enc->codec_type == AVMEDIA_TYPE_VIDEO) {
             snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "q=%2.1f ", q);
         }
+        if (enc->codec_type == AVMEDIA_TYPE_VIDEO)
+            snprintf(buf_script + strlen(buf_script), sizeof(buf_script) - strlen(buf_script),
+                     "stream_%d_%d_q=%.1f\n", ost->file_index, ost->index, q);
         if (!vid && enc->codec_type == AVMEDIA_TYPE_VIDEO) {
-            float t = (av_gettime()-timer_start) / 1000000.0;
-
             frame_number = ost->frame_number;
             snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "frame=%5d fps=%3d q=%3.1f ",
                      frame_number, (t>1)?(int)(frame_number/t+0.5) : 0, q);
+            snprintf(buf_script + strlen(buf_script), sizeof(buf_script) - strlen(buf_script),
+                     "frame=%d\nfps=%.2f\n", frame_number, t > 0 ? frame_number / t : 0);
             if(is_last_report)
                 snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "L");
             if(qp_hist){
@@ -1463,17 +2448,29 @@ static void print_report(AVFormatContext **output_files,
                                       ost->st->time_base, AV_TIME_BASE_Q));
     }
 
-    if (verbose > 0 || is_last_report) {
-        int hours, mins, secs, us;
-        secs = pts / AV_TIME_BASE;
-        us = pts % AV_TIME_BASE;
-        mins = secs / 60;
-        secs %= 60;
-        hours = mins / 60;
-        mins %= 60;
+    secs = pts / AV_TIME_BASE;
+    us = pts % AV_TIME_BASE;
+    mins = secs / 60;
+    secs %= 60;
+    hours = mins / 60;
+    mins %= 60;
+
+    bitrate = pts ? total_size * 8 / (pts / 1000.0) : 0;
+    speed   = t > 0 ? pts / (t * AV_TIME_BASE) : 0;
 
-        bitrate = pts ? total_size * 8 / (pts / 1000.0) : 0;
+    if (progress_avio) {
+        snprintf(buf_script + strlen(buf_script), sizeof(buf_script) - strlen(buf_script),
+                 "bitrate=%.1fkbits/s\ntotal_size=%"PRId64"\n"
+                 "out_time_us=%"PRId64"\nout_time=%02d:%02d:%02d.%06d\n"
+                 "dup_frames=%d\ndrop_frames=%d\nspeed=%.3gx\nprogress=%s\n",
+                 bitrate, total_size, pts, hours, mins, secs, us,
+                 nb_frames_dup, nb_frames_drop, speed,
+                 is_last_report ? "end" : "continue");
+        avio_write(progress_avio, buf_script, strlen(buf_script));
+        avio_flush(progress_avio);
+    }
 
+    if (verbose > 0 || is_last_report) {
         snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf),
                  "size=%8.0fkB time=", total_size / 1024.0);
         snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf),
@@ -1492,6 +2489,9 @@ static void print_report(AVFormatContext **output_files,
         fflush(stderr);
     }
 
+    if (do_benchmark_all && !is_last_report && verbose >= 0)
+        print_bench(ost_table, nb_ostreams, 0);
+
     if (is_last_report && verbose >= 0){
         int64_t raw= audio_size + video_size + extra_size;
         fprintf(stderr, "\n");
@@ -1522,12 +2522,14 @@ static int output_packet(AVInputStream *ist, int ist_index,
     int ret, i;
     int got_output;
     AVFrame picture;
-    void *buffer_to_free = NULL;
+    int picture_copied = 0;
     static unsigned int samples_size= 0;
     AVSubtitle subtitle, *subtitle_to_free;
+    AVFrame audio_frame, *audio_frame_to_free;
     int64_t pkt_pts = AV_NOPTS_VALUE;
+    BenchTimer t;
 #if CONFIG_AVFILTER
-    int frame_available;
+    int frame_available, shared_pass;
 #endif
 
     AVPacket avpkt;
@@ -1570,34 +2572,44 @@ static int output_packet(AVInputStream *ist, int ist_index,
         data_buf  = avpkt.data;
         data_size = avpkt.size;
         subtitle_to_free = NULL;
+        audio_frame_to_free = NULL;
         if (ist->decoding_needed) {
             switch(ist->st->codec->codec_type) {
             case AVMEDIA_TYPE_AUDIO:{
-                if(pkt && samples_size < FFMAX(pkt->size*sizeof(*samples), AVCODEC_MAX_AUDIO_FRAME_SIZE)) {
-                    samples_size = FFMAX(pkt->size*sizeof(*samples), AVCODEC_MAX_AUDIO_FRAME_SIZE);
-                    av_free(samples);
-                    samples= av_malloc(samples_size);
-                }
-                decoded_data_size= samples_size;
-                    /* XXX: could avoid copy if PCM 16 bits with same
-                       endianness as CPU */
-                ret = avcodec_decode_audio3(ist->st->codec, samples, &decoded_data_size,
-                                            &avpkt);
+                AVCodecContext *dec = ist->st->codec;
+
+                avcodec_get_frame_defaults(&audio_frame);
+                t = bench_start();
+                ret = avcodec_decode_audio4(dec, &audio_frame, &got_output, &avpkt);
+                bench_stop(&t, &ist->bench, BENCH_DECODE);
                 if (ret < 0)
                     goto fail_decode;
                 avpkt.data += ret;
                 avpkt.size -= ret;
                 data_size   = ret;
-                got_output  = decoded_data_size > 0;
-                /* Some bug in mpeg audio decoder gives */
-                /* decoded_data_size < 0, it seems they are overflows */
                 if (!got_output) {
                     /* no audio frame */
                     continue;
                 }
-                decoded_data_buf = (uint8_t *)samples;
+                bps = av_get_bytes_per_sample(dec->sample_fmt);
+                decoded_data_size = audio_frame.nb_samples * dec->channels * bps;
+                if (audio_frame.planar && dec->channels > 1) {
+                    /* the resampler and the encoders take interleaved samples */
+                    av_fast_malloc(&samples, &samples_size, decoded_data_size);
+                    if (!samples) {
+                        fprintf(stderr, "Out of memory for decoded samples\n");
+                        ffmpeg_exit(1);
+                    }
+                    interleave_audio_frame((uint8_t *)samples, &audio_frame,
+                                           dec->channels, bps);
+                    dec->release_buffer(dec, &audio_frame);
+                    decoded_data_buf = (uint8_t *)samples;
+                } else {
+                    decoded_data_buf = audio_frame.extended_data[0];
+                    audio_frame_to_free = &audio_frame;
+                }
                 ist->next_pts += ((int64_t)AV_TIME_BASE/bps * decoded_data_size) /
-                    (ist->st->codec->sample_rate * ist->st->codec->channels);
+                    (dec->sample_rate * dec->channels);
                 break;}
             case AVMEDIA_TYPE_VIDEO:
                     decoded_data_size = (ist->st->codec->width * ist->st->codec->height * 3) / 2;
@@ -1607,8 +2619,10 @@ static int output_packet(AVInputStream *ist, int ist_index,
                     avpkt.dts = ist->pts;
                     pkt_pts = AV_NOPTS_VALUE;
 
+                    t = bench_start();
                     ret = avcodec_decode_video2(ist->st->codec,
                                                 &picture, &got_output, &avpkt);
+                    bench_stop(&t, &ist->bench, BENCH_DECODE);
                     ist->st->quality= picture.quality;
                     if (ret < 0)
                         goto fail_decode;
@@ -1616,6 +2630,13 @@ static int output_packet(AVInputStream *ist, int ist_index,
                         /* no picture yet */
                         goto discard_packet;
                     }
+                    if (ist->active_hwaccel_id && picture.format == ist->hwaccel_pix_fmt) {
+                        t = bench_start();
+                        ret = ist->hwaccel_retrieve_data(ist->st->codec, &picture);
+                        bench_stop(&t, &ist->bench, BENCH_DECODE);
+                        if (ret < 0)
+                            goto fail_decode;
+                    }
                     ist->next_pts = ist->pts = picture.best_effort_timestamp;
                     if (ist->st->codec->time_base.num != 0) {
                         int ticks= ist->st->parser ? ist->st->parser->repeat_pict+1 : ist->st->codec->ticks_per_frame;
@@ -1624,12 +2645,13 @@ static int output_packet(AVInputStream *ist, int ist_index,
                             ist->st->codec->time_base.den;
                     }
                     avpkt.size = 0;
-                    buffer_to_free = NULL;
-                    pre_process_video_frame(ist, (AVPicture *)&picture, &buffer_to_free);
+                    picture_copied = pre_process_video_frame(ist, (AVPicture *)&picture);
                     break;
             case AVMEDIA_TYPE_SUBTITLE:
+                t = bench_start();
                 ret = avcodec_decode_subtitle2(ist->st->codec,
                                                &subtitle, &got_output, &avpkt);
+                bench_stop(&t, &ist->bench, BENCH_DECODE);
                 if (ret < 0)
                     goto fail_decode;
                 if (!got_output) {
@@ -1661,17 +2683,25 @@ static int output_packet(AVInputStream *ist, int ist_index,
         }
 
 #if CONFIG_AVFILTER
+        shared_pass = 0;
         if(ist->st->codec->codec_type == AVMEDIA_TYPE_VIDEO)
         if (start_time == 0 || ist->pts >= start_time) {
+            int no_copy = ist->st->codec->get_buffer == codec_get_buffer && !picture_copied &&
+                          picture.opaque;
+
+            if (!picture.sample_aspect_ratio.num)
+                picture.sample_aspect_ratio = ist->st->sample_aspect_ratio;
+            picture.pts = ist->pts;
+
+            if (ist->graph &&
+                add_decoded_frame(ist, ist->input_video_filter, &picture, no_copy) < 0)
+                goto fail_decode;
             for(i=0;i<nb_ostreams;i++) {
                 ost = ost_table[i];
-                if (ost->input_video_filter && ost->source_index == ist_index) {
-                    if (!picture.sample_aspect_ratio.num)
-                        picture.sample_aspect_ratio = ist->st->sample_aspect_ratio;
-                    picture.pts = ist->pts;
-
-                    av_vsrc_buffer_add_frame(ost->input_video_filter, &picture, AV_VSRC_BUF_FLAG_OVERWRITE);
-                }
+                if (ost->input_video_filter && ost->source_index == ist_index &&
+                    !ost->shared_filters &&
+                    add_decoded_frame(ist, ost->input_video_filter, &picture, no_copy) < 0)
+                    goto fail_decode;
             }
         }
 #endif
@@ -1680,7 +2710,7 @@ static int output_packet(AVInputStream *ist, int ist_index,
         if (ist->st->codec->codec_type == AVMEDIA_TYPE_AUDIO) {
             if (audio_volume != 256) {
                 short *volp;
-                volp = samples;
+                volp = (short *)decoded_data_buf;
                 for(i=0;i<(decoded_data_size / sizeof(short));i++) {
                     int v = ((*volp) * audio_volume + 128) >> 8;
                     if (v < -32768) v = -32768;
@@ -1697,6 +2727,19 @@ static int output_packet(AVInputStream *ist, int ist_index,
             if (pts > now)
                 usleep(pts - now);
         }
+#if CONFIG_AVFILTER
+        /* the shared filters may output several frames, each of them
+           goes through the filters and encoders of the outputs */
+    next_shared_frame:
+        if (ist->graph && ist->st->codec->codec_type == AVMEDIA_TYPE_VIDEO &&
+            (start_time == 0 || ist->pts >= start_time)) {
+            t = bench_start();
+            ret = add_shared_frame(ist, ist_index, ost_table, nb_ostreams);
+            bench_stop(&t, &ist->bench, BENCH_FILTER);
+            if (ret < 0)
+                goto fail_decode;
+        }
+#endif
         /* if output time reached then transcode raw format,
            encode packets and output them */
         if (start_time == 0 || ist->pts >= start_time)
@@ -1704,6 +2747,10 @@ static int output_packet(AVInputStream *ist, int ist_index,
                 int frame_size;
 
                 ost = ost_table[i];
+#if CONFIG_AVFILTER
+                if (shared_pass && !ost->shared_filters)
+                    continue;
+#endif
                 if (ost->source_index == ist_index) {
 #if CONFIG_AVFILTER
                 frame_available = ist->st->codec->codec_type != AVMEDIA_TYPE_VIDEO ||
@@ -1711,7 +2758,10 @@ static int output_packet(AVInputStream *ist, int ist_index,
                 while (frame_available) {
                     if (ist->st->codec->codec_type == AVMEDIA_TYPE_VIDEO && ost->output_video_filter) {
                         AVRational ist_pts_tb = ost->output_video_filter->inputs[0]->time_base;
-                        if (av_vsink_buffer_get_video_buffer_ref(ost->output_video_filter, &ost->picref, 0) < 0)
+                        t = bench_start();
+                        ret = av_vsink_buffer_get_video_buffer_ref(ost->output_video_filter, &ost->picref, 0);
+                        bench_stop(&t, &ost->bench, BENCH_FILTER);
+                        if (ret < 0)
                             goto cont;
                         if (ost->picref) {
                             avfilter_fill_frame_from_video_buffer_ref(&picture, ost->picref);
@@ -1802,6 +2852,15 @@ static int output_packet(AVInputStream *ist, int ist_index,
                             opkt.size = data_size;
                         }
 
+                        /* share the input payload instead of letting the
+                         * muxer copy it for every output */
+                        if (!opkt.destruct && opkt.data == pkt->data && opkt.size == pkt->size &&
+                            pkt->destruct == av_destruct_packet && pkt->buf &&
+                            !(os->oformat->flags & AVFMT_RAWPICTURE)) {
+                            if ((opkt.buf = av_buffer_ref(pkt->buf)))
+                                opkt.destruct = av_destruct_packet;
+                        }
+
                         if (os->oformat->flags & AVFMT_RAWPICTURE) {
                             /* store AVPicture in AVPacket, as expected by the output format */
                             avpicture_fill(&pict, opkt.data, ost->st->codec->pix_fmt, ost->st->codec->width, ost->st->codec->height);
@@ -1809,7 +2868,7 @@ static int output_packet(AVInputStream *ist, int ist_index,
                             opkt.size = sizeof(AVPicture);
                             opkt.flags |= AV_PKT_FLAG_KEY;
                         }
-                        write_frame(os, &opkt, ost->st->codec, ost->bitstream_filters);
+                        write_frame(os, &opkt, ost);
                         ost->st->codec->frame_number++;
                         ost->frame_number++;
                         av_free_packet(&opkt);
@@ -1824,12 +2883,20 @@ static int output_packet(AVInputStream *ist, int ist_index,
                 }
             }
 
-        av_free(buffer_to_free);
+#if CONFIG_AVFILTER
+        if (ist->graph && ist->st->codec->codec_type == AVMEDIA_TYPE_VIDEO &&
+            avfilter_poll_frame(ist->output_video_filter->inputs[0]) > 0) {
+            shared_pass = 1;
+            goto next_shared_frame;
+        }
+#endif
         /* XXX: allocate the subtitles in the codec ? */
         if (subtitle_to_free) {
             avsubtitle_free(subtitle_to_free);
             subtitle_to_free = NULL;
         }
+        if (audio_frame_to_free)
+            ist->st->codec->release_buffer(ist->st->codec, audio_frame_to_free);
     }
  discard_packet:
     if (pkt == NULL) {
@@ -1853,6 +2920,7 @@ static int output_packet(AVInputStream *ist, int ist_index,
                         av_init_packet(&pkt);
                         pkt.stream_index= ost->index;
 
+                        t = bench_start();
                         switch(ost->st->codec->codec_type) {
                         case AVMEDIA_TYPE_AUDIO:
                             fifo_bytes = av_fifo_size(ost->fifo);
@@ -1903,6 +2971,7 @@ static int output_packet(AVInputStream *ist, int ist_index,
                         default:
                             ret=-1;
                         }
+                        bench_stop(&t, &ost->bench, BENCH_ENCODE);
 
                         if(ret<=0)
                             break;
@@ -1910,7 +2979,7 @@ static int output_packet(AVInputStream *ist, int ist_index,
                         pkt.size= ret;
                         if(enc->coded_frame && enc->coded_frame->pts != AV_NOPTS_VALUE)
                             pkt.pts= av_rescale_q(enc->coded_frame->pts, enc->time_base, ost->st->time_base);
-                        write_frame(os, &pkt, ost->st->codec, ost->bitstream_filters);
+                        write_frame(os, &pkt, ost);
                     }
                 }
             }
@@ -1997,6 +3066,137 @@ static void parse_forced_key_frames(char *kf, AVOutputStream *ost,
 /*
  * The following code is the main loop of the file converter
  */
+#if HAVE_PTHREADS
+/* Demuxing runs in one thread per input file, so that reading and parsing
+   overlap with decoding and encoding. The packets are handed over in the
+   order they were read, the transcoding loop still decides which input to
+   take the next packet from. With several inputs, an input whose thread has
+   nothing queued is skipped for a while instead of being waited for, so a
+   slow or live input does not hold up the others. */
+static void *input_thread(void *arg)
+{
+    AVInputFile *f = arg;
+    AVPacket pkt;
+    int ret;
+
+    for (;;) {
+        ret = av_read_frame(f->ctx, &pkt);
+        if (ret == AVERROR(EAGAIN)) {
+            usleep(10000);
+            continue;
+        }
+        /* the data of a packet may point into the demuxer buffers */
+        if (ret >= 0 && (ret = av_dup_packet(&pkt)) < 0)
+            av_free_packet(&pkt);
+
+        pthread_mutex_lock(&f->fifo_lock);
+        while (ret >= 0 && !f->abort_request && !av_fifo_space(f->fifo))
+            pthread_cond_wait(&f->fifo_cond, &f->fifo_lock);
+        if (ret >= 0 && f->abort_request) {
+            av_free_packet(&pkt);
+            ret = AVERROR_EXIT;
+        }
+        if (ret >= 0)
+            av_fifo_generic_write(f->fifo, &pkt, sizeof(pkt), NULL);
+        else
+            f->thread_ret = ret;
+        pthread_cond_signal(&f->fifo_cond);
+        pthread_mutex_unlock(&f->fifo_lock);
+        if (ret < 0)
+            break;
+    }
+    return NULL;
+}
+
+static void free_input_threads(AVInputFile *input_files, int nb_input_files)
+{
+    AVPacket pkt;
+    int i;
+
+    for (i = 0; i < nb_input_files; i++) {
+        AVInputFile *f = &input_files[i];
+
+        if (!f->fifo)
+            continue;
+        input_threads_abort = 1;
+        pthread_mutex_lock(&f->fifo_lock);
+        f->abort_request = 1;
+        pthread_cond_signal(&f->fifo_cond);
+        pthread_mutex_unlock(&f->fifo_lock);
+        pthread_join(f->thread, NULL);
+
+        while (av_fifo_size(f->fifo)) {
+            av_fifo_generic_read(f->fifo, &pkt, sizeof(pkt), NULL);
+            av_free_packet(&pkt);
+        }
+        av_fifo_free(f->fifo);
+        f->fifo = NULL;
+        pthread_mutex_destroy(&f->fifo_lock);
+        pthread_cond_destroy(&f->fifo_cond);
+    }
+}
+
+static int init_input_threads(AVInputFile *input_files, int nb_input_files)
+{
+    int i;
+
+    main_thread = pthread_self();
+    input_threads_abort = 0;
+    for (i = 0; i < nb_input_files; i++) {
+        AVInputFile *f = &input_files[i];
+
+        if (!(f->fifo = av_fifo_alloc(FFMAX(f->thread_queue_size, 1) * sizeof(AVPacket))))
+            return AVERROR(ENOMEM);
+        f->thread_ret    = 0;
+        f->abort_request = 0;
+        f->non_blocking  = nb_input_files > 1;
+        pthread_mutex_init(&f->fifo_lock, NULL);
+        pthread_cond_init(&f->fifo_cond, NULL);
+        if (pthread_create(&f->thread, NULL, input_thread, f)) {
+            pthread_mutex_destroy(&f->fifo_lock);
+            pthread_cond_destroy(&f->fifo_cond);
+            av_fifo_free(f->fifo);
+            f->fifo = NULL;
+            return AVERROR(EAGAIN);
+        }
+    }
+    return 0;
+}
+
+static int get_input_packet(AVInputFile *f, AVPacket *pkt)
+{
+    int ret = 0;
+
+    if (!f->fifo)
+        return av_read_frame(f->ctx, pkt);
+
+    pthread_mutex_lock(&f->fifo_lock);
+    while (!av_fifo_size(f->fifo) && !f->thread_ret && !f->non_blocking)
+        pthread_cond_wait(&f->fifo_cond, &f->fifo_lock);
+    if (av_fifo_size(f->fifo))
+        av_fifo_generic_read(f->fifo, pkt, sizeof(*pkt), NULL);
+    else
+        ret = f->thread_ret ? f->thread_ret : AVERROR(EAGAIN);
+    pthread_cond_signal(&f->fifo_cond);
+    pthread_mutex_unlock(&f->fifo_lock);
+    return ret;
+}
+#else
+static void free_input_threads(AVInputFile *input_files, int nb_input_files)
+{
+}
+
+static int init_input_threads(AVInputFile *input_files, int nb_input_files)
+{
+    return 0;
+}
+
+static int get_input_packet(AVInputFile *f, AVPacket *pkt)
+{
+    return av_read_frame(f->ctx, pkt);
+}
+#endif
+
 static int transcode(AVFormatContext **output_files,
                      int nb_output_files,
                      AVInputFile *input_files,
@@ -2021,6 +3221,10 @@ static int transcode(AVFormatContext **output_files,
         for (i = 0; i < nb_input_streams; i++)
             input_streams[i].start = av_gettime();
 
+    /* the filters and scalers set up below share the pool too */
+    if (shared_threads && thread_count > 1 && !thread_pool)
+        thread_pool = avcodec_thread_pool_alloc(thread_count);
+
     /* output stream init */
     nb_ostreams = 0;
     for(i=0;i<nb_output_files;i++) {
@@ -2178,6 +3382,10 @@ static int transcode(AVFormatContext **output_files,
         }
     }
 
+#if CONFIG_AVFILTER
+    share_video_filters(ost_table, nb_ostreams);
+#endif
+
     /* for each output stream, we compute the right encoding parameters */
     for(i=0;i<nb_ostreams;i++) {
         ost = ost_table[i];
@@ -2411,6 +3619,7 @@ static int transcode(AVFormatContext **output_files,
                 memcpy(ost->st->codec->subtitle_header, dec->subtitle_header, dec->subtitle_header_size);
                 ost->st->codec->subtitle_header_size = dec->subtitle_header_size;
             }
+            ost->st->codec->thread_pool = thread_pool;
             if (avcodec_open(ost->st->codec, codec) < 0) {
                 snprintf(error, sizeof(error), "Error while opening encoder for output stream #%d.%d - maybe incorrect parameters such as bit_rate, rate, width or height",
                         ost->file_index, ost->index);
@@ -2434,6 +3643,20 @@ static int transcode(AVFormatContext **output_files,
                 ret = AVERROR(EINVAL);
                 goto dump_format;
             }
+            ist->st->codec->thread_pool = thread_pool;
+#if CONFIG_AVFILTER
+            /* decode into buffers the filters can keep a reference to */
+            if (codec->type == AVMEDIA_TYPE_VIDEO && codec->capabilities & CODEC_CAP_DR1) {
+                ist->st->codec->get_buffer     = codec_get_buffer;
+                ist->st->codec->release_buffer = codec_release_buffer;
+                ist->st->codec->opaque         = ist;
+                if (ist->hwaccel_id != HWACCEL_NONE) {
+                    ist->st->codec->get_format   = get_format;
+                    /* the decoding runs on the hardware, in a single thread */
+                    ist->st->codec->thread_count = 1;
+                }
+            }
+#endif
             if (avcodec_open(ist->st->codec, codec) < 0) {
                 snprintf(error, sizeof(error), "Error while opening decoder for input stream #%d.%d",
                         ist->file_index, ist->st->index);
@@ -2598,11 +3821,17 @@ static int transcode(AVFormatContext **output_files,
     }
     term_init();
 
+    if ((ret = init_input_threads(input_files, nb_input_files)) < 0) {
+        fprintf(stderr, "Could not start the input threads\n");
+        goto fail;
+    }
+
     timer_start = av_gettime();
 
     for(; received_sigterm == 0;) {
         int file_index, ist_index;
         AVPacket pkt;
+        BenchTimer t;
         double ipts_min;
         double opts_min;
 
@@ -2705,7 +3934,9 @@ static int transcode(AVFormatContext **output_files,
 
         /* read a frame from it and output it in the fifo */
         is = input_files[file_index].ctx;
-        ret= av_read_frame(is, &pkt);
+        t = bench_start();
+        ret= get_input_packet(&input_files[file_index], &pkt);
+        bench_stop(&t, &input_files[file_index].bench, BENCH_DEMUX);
         if(ret == AVERROR(EAGAIN)){
             no_packet[file_index]=1;
             no_packet_count++;
@@ -2793,6 +4024,8 @@ static int transcode(AVFormatContext **output_files,
         print_report(output_files, ost_table, nb_ostreams, 0);
     }
 
+    free_input_threads(input_files, nb_input_files);
+
     /* at the end of stream, we must flush the decoder buffers */
     for (i = 0; i < nb_input_streams; i++) {
         ist = &input_streams[i];
@@ -2812,6 +4045,9 @@ static int transcode(AVFormatContext **output_files,
     /* dump report by using the first video and audio streams */
     print_report(output_files, ost_table, nb_ostreams, 1);
 
+    if (do_benchmark)
+        print_bench(ost_table, nb_ostreams, 1);
+
     /* close each encoder */
     for(i=0;i<nb_ostreams;i++) {
         ost = ost_table[i];
@@ -2820,6 +4056,11 @@ static int transcode(AVFormatContext **output_files,
             avcodec_close(ost->st->codec);
         }
 #if CONFIG_AVFILTER
+        if (do_benchmark && ost->graph) {
+            av_log(NULL, AV_LOG_INFO, "filters of output #%d.%d:\n",
+                   ost->file_index, ost->index);
+            avfilter_graph_dump_stats(ost->graph, NULL, AV_LOG_INFO);
+        }
         avfilter_graph_free(&ost->graph);
 #endif
     }
@@ -2829,13 +4070,27 @@ static int transcode(AVFormatContext **output_files,
         ist = &input_streams[i];
         if (ist->decoding_needed) {
             avcodec_close(ist->st->codec);
+            if (ist->hwaccel_uninit)
+                ist->hwaccel_uninit(ist->st->codec);
+        }
+#if CONFIG_AVFILTER
+        if (do_benchmark && ist->graph) {
+            av_log(NULL, AV_LOG_INFO, "filters of input #%d.%d:\n",
+                   ist->file_index, ist->st->index);
+            avfilter_graph_dump_stats(ist->graph, NULL, AV_LOG_INFO);
         }
+        avfilter_graph_free(&ist->graph);
+        av_freep(&ist->avfilter);
+        free_buffer_pool(ist);
+#endif
+        av_freep(&ist->deinterlace_buf);
     }
 
     /* finished ! */
     ret = 0;
 
  fail:
+    free_input_threads(input_files, nb_input_files);
     av_freep(&bit_buffer);
 
     if (ost_table) {
@@ -3399,6 +4654,8 @@ static int opt_input_file(const char *opt, const char *filename)
         ist->st = st;
         ist->file_index = nb_input_files;
         ist->discard = 1;
+        ist->hwaccel_pix_fmt    = PIX_FMT_NONE;
+        ist->hwaccel_sw_pix_fmt = PIX_FMT_NONE;
 
         switch (dec->codec_type) {
         case AVMEDIA_TYPE_AUDIO:
@@ -3425,6 +4682,9 @@ static int opt_input_file(const char *opt, const char *filename)
             }
             if(me_threshold)
                 dec->debug |= FF_DEBUG_MV;
+            ist->hwaccel_id     = hwaccel_id;
+            if (hwaccel_device)
+                ist->hwaccel_device = av_strdup(hwaccel_device);
 
             if (dec->time_base.den != rfps*dec->ticks_per_frame || dec->time_base.num != rfps_base) {
 
@@ -3465,9 +4725,13 @@ static int opt_input_file(const char *opt, const char *filename)
     input_files = grow_array(input_files, sizeof(*input_files), &nb_input_files, nb_input_files + 1);
     input_files[nb_input_files - 1].ctx        = ic;
     input_files[nb_input_files - 1].ist_index  = nb_input_streams - ic->nb_streams;
+    input_files[nb_input_files - 1].thread_queue_size = thread_queue_size;
 
     top_field_first = -1;
     video_channel = 0;
+    hwaccel_id = HWACCEL_NONE;
+    av_freep(&hwaccel_device);
+    thread_queue_size = INPUT_QUEUE_SIZE;
     frame_rate    = (AVRational){0, 0};
     frame_pix_fmt = PIX_FMT_NONE;
     frame_height = 0;
@@ -3878,7 +5142,6 @@ static int opt_output_file(const char *opt, const char *filename)
     AVFormatContext *oc;
     int err, use_video, use_audio, use_subtitle, use_data;
     int input_has_video, input_has_audio, input_has_subtitle, input_has_data;
-    AVFormatParameters params, *ap = &params;
     AVOutputFormat *file_oformat;
 
     if(nb_output_files >= FF_ARRAY_ELEMS(output_files)){
@@ -3957,6 +5220,8 @@ static int opt_output_file(const char *opt, const char *filename)
         }
     }
 
+    set_context_opts(oc, avformat_opts, AV_OPT_FLAG_ENCODING_PARAM, NULL);
+
     if (!(oc->oformat->flags & AVFMT_NOFILE)) {
         /* test if it already exists to avoid loosing precious files */
         if (!file_overwrite &&
@@ -3980,25 +5245,17 @@ static int opt_output_file(const char *opt, const char *filename)
         }
 
         /* open the file */
-        if ((err = avio_open(&oc->pb, filename, AVIO_FLAG_WRITE)) < 0) {
+        if ((err = avio_open(&oc->pb, filename, AVIO_FLAG_WRITE |
+                             (oc->flags & AVFMT_FLAG_DIRECT ? AVIO_FLAG_DIRECT : 0))) < 0) {
             print_error(filename, err);
             ffmpeg_exit(1);
         }
     }
 
-    memset(ap, 0, sizeof(*ap));
-    if (av_set_parameters(oc, ap) < 0) {
-        fprintf(stderr, "%s: Invalid encoding parameters\n",
-                oc->filename);
-        ffmpeg_exit(1);
-    }
-
     oc->preload= (int)(mux_preload*AV_TIME_BASE);
     oc->max_delay= (int)(mux_max_delay*AV_TIME_BASE);
     oc->loop_output = loop_output;
 
-    set_context_opts(oc, avformat_opts, AV_OPT_FLAG_ENCODING_PARAM, NULL);
-
     frame_rate    = (AVRational){0, 0};
     frame_width   = 0;
     frame_height  = 0;
@@ -4018,24 +5275,6 @@ static int opt_pass(const char *opt, const char *arg)
     return 0;
 }
 
-static int64_t getutime(void)
-{
-#if HAVE_GETRUSAGE
-    struct rusage rusage;
-
-    getrusage(RUSAGE_SELF, &rusage);
-    return (rusage.ru_utime.tv_sec * 1000000LL) + rusage.ru_utime.tv_usec;
-#elif HAVE_GETPROCESSTIMES
-    HANDLE proc;
-    FILETIME c, e, k, u;
-    proc = GetCurrentProcess();
-    GetProcessTimes(proc, &c, &e, &k, &u);
-    return ((int64_t) u.dwHighDateTime << 32 | u.dwLowDateTime) / 10;
-#else
-    return av_gettime();
-#endif
-}
-
 static int64_t getmaxrss(void)
 {
 #if HAVE_GETRUSAGE && HAVE_STRUCT_RUSAGE_RU_MAXRSS
@@ -4301,6 +5540,59 @@ static int opt_vstats_file(const char *opt, const char *arg)
     return 0;
 }
 
+static int opt_hwaccel(const char *opt, const char *arg)
+{
+    int i;
+
+    if (!strcmp(arg, "none")) {
+        hwaccel_id = HWACCEL_NONE;
+        return 0;
+    }
+    if (!strcmp(arg, "auto")) {
+        hwaccel_id = HWACCEL_AUTO;
+        return 0;
+    }
+    for (i = 0; hwaccels[i].name; i++)
+        if (!strcmp(arg, hwaccels[i].name)) {
+            hwaccel_id = hwaccels[i].id;
+            return 0;
+        }
+
+    fprintf(stderr, "Unrecognized hwaccel: %s.\nSupported hwaccels:", arg);
+    for (i = 0; hwaccels[i].name; i++)
+        fprintf(stderr, " %s", hwaccels[i].name);
+    fprintf(stderr, "\n");
+    ffmpeg_exit(1);
+    return AVERROR(EINVAL);
+}
+
+static int opt_hwaccel_device(const char *opt, const char *arg)
+{
+    av_free(hwaccel_device);
+    hwaccel_device = av_strdup(arg);
+    return 0;
+}
+
+static int opt_progress(const char *opt, const char *arg)
+{
+    int ret;
+
+    if (progress_avio)
+        avio_close(progress_avio);
+    if ((ret = avio_open(&progress_avio, arg, AVIO_FLAG_WRITE)) < 0) {
+        fprintf(stderr, "Failed to open progress URL \"%s\"\n", arg);
+        print_error(arg, ret);
+        ffmpeg_exit(1);
+    }
+    return 0;
+}
+
+static int opt_stats_period(const char *opt, const char *arg)
+{
+    stats_period = parse_number_or_die(opt, arg, OPT_FLOAT, 0.001, 3600) * 1000000;
+    return 0;
+}
+
 static int opt_vstats(const char *opt, const char *arg)
 {
     char filename[40];
@@ -4397,12 +5689,19 @@ static const OptionDef options[] = {
     { "fs", HAS_ARG | OPT_INT64, {(void*)&limit_filesize}, "set the limit file size in bytes", "limit_size" }, //
     { "ss", HAS_ARG, {(void*)opt_start_time}, "set the start time offset", "time_off" },
     { "itsoffset", HAS_ARG, {(void*)opt_input_ts_offset}, "set the input ts offset", "time_off" },
+    { "thread_queue_size", HAS_ARG | OPT_INT | OPT_EXPERT, {(void*)&thread_queue_size}, "set the number of packets read ahead from the next input file", "n" },
     { "itsscale", HAS_ARG, {(void*)opt_input_ts_scale}, "set the input ts scale", "stream:scale" },
     { "timestamp", HAS_ARG, {(void*)opt_recording_timestamp}, "set the recording timestamp ('now' to set the current time)", "time" },
     { "metadata", HAS_ARG, {(void*)opt_metadata}, "add metadata", "string=string" },
     { "dframes", OPT_INT | HAS_ARG, {(void*)&max_frames[AVMEDIA_TYPE_DATA]}, "set the number of data frames to record", "number" },
     { "benchmark", OPT_BOOL | OPT_EXPERT, {(void*)&do_benchmark},
       "add timings for benchmarking" },
+    { "benchmark_all", OPT_BOOL | OPT_EXPERT, {(void*)&do_benchmark_all},
+      "add timings for benchmarking, also during the transcoding" },
+    { "progress", HAS_ARG | OPT_EXPERT, {(void*)opt_progress},
+      "write program-readable progress information", "url" },
+    { "stats_period", HAS_ARG | OPT_EXPERT, {(void*)opt_stats_period},
+      "set the period at which progress is reported", "seconds" },
     { "timelimit", HAS_ARG, {(void*)opt_timelimit}, "set max runtime in seconds", "limit" },
     { "dump", OPT_BOOL | OPT_EXPERT, {(void*)&do_pkt_dump},
       "dump each input packet" },
@@ -4414,6 +5713,7 @@ static const OptionDef options[] = {
     { "v", HAS_ARG, {(void*)opt_verbose}, "set ffmpeg verbosity level", "number" },
     { "target", HAS_ARG, {(void*)opt_target}, "specify target file type (\"vcd\", \"svcd\", \"dvd\", \"dv\", \"dv50\", \"pal-vcd\", \"ntsc-svcd\", ...)", "type" },
     { "threads",  HAS_ARG | OPT_EXPERT, {(void*)opt_thread_count}, "thread count", "count" },
+    { "shared_threads", OPT_BOOL | OPT_EXPERT, {(void*)&shared_threads}, "run the threads of all codecs, filters and scalers on one pool of -threads threads" },
     { "vsync", HAS_ARG | OPT_INT | OPT_EXPERT, {(void*)&video_sync_method}, "video sync method", "" },
     { "async", HAS_ARG | OPT_INT | OPT_EXPERT, {(void*)&audio_sync_method}, "audio sync method", "" },
     { "adrift_threshold", HAS_ARG | OPT_FLOAT | OPT_EXPERT, {(void*)&audio_drift_threshold}, "audio drift threshold", "threshold" },
@@ -4458,6 +5758,8 @@ static const OptionDef options[] = {
       "deinterlace pictures" },
     { "psnr", OPT_BOOL | OPT_EXPERT | OPT_VIDEO, {(void*)&do_psnr}, "calculate PSNR of compressed frames" },
     { "vstats", OPT_EXPERT | OPT_VIDEO, {(void*)&opt_vstats}, "dump video coding statistics to file" },
+    { "hwaccel", HAS_ARG | OPT_EXPERT | OPT_VIDEO, {(void*)opt_hwaccel}, "use a hardware accelerated decoder for the video streams of the next input file, 'auto' for any available", "hwaccel name" },
+    { "hwaccel_device", HAS_ARG | OPT_EXPERT | OPT_VIDEO, {(void*)opt_hwaccel_device}, "select the device used by the hwaccel, the X11 display for vaapi", "device" },
     { "vstats_file", HAS_ARG | OPT_EXPERT | OPT_VIDEO, {(void*)opt_vstats_file}, "dump video coding statistics to file", "file" },
 #if CONFIG_AVFILTER
     { "vf", OPT_STRING | HAS_ARG, {(void*)&vfilters}, "video filters", "filter list" },
@@ -4572,6 +5874,10 @@ int main(int argc, char **argv)
         ffmpeg_exit(1);
     }
 
+    if (do_benchmark_all)
+        do_benchmark = 1;
+    if (do_benchmark)
+        av_profile_enable(1);
     ti = getutime();
     if (transcode(output_files, nb_output_files, input_files, nb_input_files,
                   stream_maps, nb_stream_maps) < 0)
@@ -4580,6 +5886,8 @@ int main(int argc, char **argv)
     if (do_benchmark) {
         int maxrss = getmaxrss() / 1024;
         printf("bench: utime=%0.3fs maxrss=%ikB\n", ti / 1000000.0, maxrss);
+        av_profile_dump(NULL, AV_LOG_INFO);
+        av_mem_dump(NULL, AV_LOG_INFO);
     }
 
     return ffmpeg_exit(0);
@@ -31,6 +31,7 @@
 #include "libavutil/parseutils.h"
 #include "libavutil/samplefmt.h"
 #include "libavutil/avassert.h"
+#include "libavutil/cpu.h"
 #include "libavformat/avformat.h"
 #include "libavdevice/avdevice.h"
 #include "libswscale/swscale.h"
@@ -239,7 +240,7 @@ static int av_sync_type = AV_SYNC_AUDIO_MASTER;
 static int64_t start_time = AV_NOPTS_VALUE;
 static int64_t duration = AV_NOPTS_VALUE;
 static int step = 0;
-static int thread_count = 1;
+static int thread_count = 0;
 static int workaround_bugs = 1;
 static int fast = 0;
 static int genpts = 0;
@@ -256,6 +257,7 @@ static int exit_on_keydown;
 static int exit_on_mousedown;
 static int loop=1;
 static int framedrop=-1;
+static int adaptive_skip = 0;
 static enum ShowMode show_mode = SHOW_MODE_NONE;
 
 static int rdftspeed=20;
@@ -1399,16 +1401,23 @@ static int queue_picture(VideoState *is, AVFrame *src_frame, double pts1, int64_
         av_picture_copy(&pict, (AVPicture *)src_frame,
                         vp->pix_fmt, vp->width, vp->height);
 #else
-        sws_flags = av_get_int(sws_opts, "sws_flags", NULL);
-        is->img_convert_ctx = sws_getCachedContext(is->img_convert_ctx,
-            vp->width, vp->height, vp->pix_fmt, vp->width, vp->height,
-            PIX_FMT_YUV420P, sws_flags, NULL, NULL, NULL);
-        if (is->img_convert_ctx == NULL) {
-            fprintf(stderr, "Cannot initialize the conversion context\n");
-            exit(1);
+        if (vp->pix_fmt == PIX_FMT_YUV420P) {
+            /* the overlay has the format of the frame, a copy is enough */
+            av_image_copy(pict.data, pict.linesize,
+                          (const uint8_t **)src_frame->data, src_frame->linesize,
+                          vp->pix_fmt, vp->width, vp->height);
+        } else {
+            sws_flags = av_get_int(sws_opts, "sws_flags", NULL);
+            is->img_convert_ctx = sws_getCachedContext(is->img_convert_ctx,
+                vp->width, vp->height, vp->pix_fmt, vp->width, vp->height,
+                PIX_FMT_YUV420P, sws_flags, NULL, NULL, NULL);
+            if (is->img_convert_ctx == NULL) {
+                fprintf(stderr, "Cannot initialize the conversion context\n");
+                exit(1);
+            }
+            sws_scale(is->img_convert_ctx, src_frame->data, src_frame->linesize,
+                      0, vp->height, pict.data, pict.linesize);
         }
-        sws_scale(is->img_convert_ctx, src_frame->data, src_frame->linesize,
-                  0, vp->height, pict.data, pict.linesize);
 #endif
         /* update the bitmap content */
         SDL_UnlockYUVOverlay(vp->bmp);
@@ -1428,6 +1437,26 @@ static int queue_picture(VideoState *is, AVFrame *src_frame, double pts1, int64_
     return 0;
 }
 
+/* skip_frames grows while the pictures are displayed late and shrinks when
+   the decoder gets ahead: past some lateness, lower the decoding quality
+   rather than decode frames only to drop them */
+static void update_skip_mode(VideoState *is)
+{
+    AVCodecContext *avctx = is->video_st->codec;
+    enum AVDiscard loop_filter = skip_loop_filter, frame = skip_frame;
+
+    if (is->skip_frames > 1.2)
+        loop_filter = FFMAX(loop_filter, AVDISCARD_NONREF);
+    if (is->skip_frames > 1.5) {
+        loop_filter = FFMAX(loop_filter, AVDISCARD_ALL);
+        /* the next picture would be dropped after decoding */
+        if (is->skip_frames_index + 1 < is->skip_frames)
+            frame = FFMAX(frame, AVDISCARD_NONREF);
+    }
+    avctx->skip_loop_filter = loop_filter;
+    avctx->skip_frame       = frame;
+}
+
 static int get_video_frame(VideoState *is, AVFrame *frame, int64_t *pts, AVPacket *pkt)
 {
     int len1 av_unused, got_picture, i;
@@ -1457,6 +1486,9 @@ static int get_video_frame(VideoState *is, AVFrame *frame, int64_t *pts, AVPacke
         return 0;
     }
 
+    if (adaptive_skip)
+        update_skip_mode(is);
+
     len1 = avcodec_decode_video2(is->video_st->codec,
                                  frame, &got_picture,
                                  pkt);
@@ -2141,7 +2173,7 @@ static int stream_component_open(VideoState *is, int stream_index)
     avctx->skip_loop_filter= skip_loop_filter;
     avctx->error_recognition= error_recognition;
     avctx->error_concealment= error_concealment;
-    avctx->thread_count= thread_count;
+    avctx->thread_count= thread_count ? thread_count : av_cpu_count();
 
     set_context_opts(avctx, avcodec_opts[avctx->codec_type], 0, codec);
 
@@ -2926,12 +2958,13 @@ static const OptionDef options[] = {
     { "er", OPT_INT | HAS_ARG | OPT_EXPERT, {(void*)&error_recognition}, "set error detection threshold (0-4)",  "threshold" },
     { "ec", OPT_INT | HAS_ARG | OPT_EXPERT, {(void*)&error_concealment}, "set error concealment options",  "bit_mask" },
     { "sync", HAS_ARG | OPT_EXPERT, {(void*)opt_sync}, "set audio-video sync. type (type=audio/video/ext)", "type" },
-    { "threads", HAS_ARG | OPT_EXPERT, {(void*)opt_thread_count}, "thread count", "count" },
+    { "threads", HAS_ARG | OPT_EXPERT, {(void*)opt_thread_count}, "thread count, 0 for one per cpu", "count" },
     { "autoexit", OPT_BOOL | OPT_EXPERT, {(void*)&autoexit}, "exit at the end", "" },
     { "exitonkeydown", OPT_BOOL | OPT_EXPERT, {(void*)&exit_on_keydown}, "exit on key down", "" },
     { "exitonmousedown", OPT_BOOL | OPT_EXPERT, {(void*)&exit_on_mousedown}, "exit on mouse down", "" },
     { "loop", OPT_INT | HAS_ARG | OPT_EXPERT, {(void*)&loop}, "set number of times the playback shall be looped", "loop count" },
     { "framedrop", OPT_BOOL | OPT_EXPERT, {(void*)&framedrop}, "drop frames when cpu is too slow", "" },
+    { "adaptive_skip", OPT_BOOL | OPT_EXPERT, {(void*)&adaptive_skip}, "skip the loop filter and non-reference frames when cpu is too slow", "" },
     { "window_title", OPT_STRING | HAS_ARG, {(void*)&window_title}, "set window title", "window title" },
 #if CONFIG_AVFILTER
     { "vf", OPT_STRING | HAS_ARG, {(void*)&vfilters}, "video filters", "filter list" },
@@ -36,6 +36,10 @@ static int do_show_format  = 0;
 static int do_show_packets = 0;
 static int do_show_streams = 0;
 
+static int skip_stream_info = 0;
+static int64_t read_duration = 0;
+static int64_t read_bytes    = 0;
+
 static int show_value_unit              = 0;
 static int use_value_prefix             = 0;
 static int use_byte_value_binary_prefix = 0;
@@ -148,11 +152,31 @@ static void show_packet(AVFormatContext *fmt_ctx, AVPacket *pkt)
 static void show_packets(AVFormatContext *fmt_ctx)
 {
     AVPacket pkt;
+    int64_t start_time = AV_NOPTS_VALUE;
 
     av_init_packet(&pkt);
 
-    while (!av_read_frame(fmt_ctx, &pkt))
+    while (!av_read_frame(fmt_ctx, &pkt)) {
+        AVStream *st = fmt_ctx->streams[pkt.stream_index];
+        int64_t ts = pkt.dts != AV_NOPTS_VALUE ? pkt.dts : pkt.pts;
+
+        /* stop at the end of the read window, if one was given */
+        if (read_duration && ts != AV_NOPTS_VALUE) {
+            ts = av_rescale_q(ts, st->time_base, AV_TIME_BASE_Q);
+            if (start_time == AV_NOPTS_VALUE)
+                start_time = ts;
+            else if (ts - start_time >= read_duration) {
+                av_free_packet(&pkt);
+                break;
+            }
+        }
+        if (read_bytes && pkt.pos >= read_bytes) {
+            av_free_packet(&pkt);
+            break;
+        }
         show_packet(fmt_ctx, &pkt);
+        av_free_packet(&pkt);
+    }
 }
 
 static void show_stream(AVFormatContext *fmt_ctx, int stream_idx)
@@ -275,6 +299,13 @@ static int open_input_file(AVFormatContext **fmt_ctx_ptr, const char *filename)
     }
 
 
+    /* only the container is looked at, no frame gets decoded */
+    if (skip_stream_info) {
+        av_dump_format(fmt_ctx, 0, filename, 0);
+        *fmt_ctx_ptr = fmt_ctx;
+        return 0;
+    }
+
     /* fill the streams in the format context */
     if ((err = av_find_stream_info(fmt_ctx)) < 0) {
         print_error(filename, err);
@@ -353,6 +384,18 @@ static int opt_input_file(const char *opt, const char *arg)
     return 0;
 }
 
+static int opt_read_duration(const char *opt, const char *arg)
+{
+    read_duration = parse_time_or_die(opt, arg, 1);
+    return 0;
+}
+
+static int opt_read_bytes(const char *opt, const char *arg)
+{
+    read_bytes = parse_number_or_die(opt, arg, OPT_INT64, 0, INT64_MAX);
+    return 0;
+}
+
 static void show_help(void)
 {
     av_log_set_callback(log_callback_help);
@@ -385,6 +428,12 @@ static const OptionDef options[] = {
     { "show_format",  OPT_BOOL, {(void*)&do_show_format} , "show format/container info" },
     { "show_packets", OPT_BOOL, {(void*)&do_show_packets}, "show packets info" },
     { "show_streams", OPT_BOOL, {(void*)&do_show_streams}, "show streams info" },
+    { "skip_stream_info", OPT_BOOL, {(void*)&skip_stream_info},
+      "do not decode frames to probe the streams, only read the container" },
+    { "read_duration", HAS_ARG, {(void*)opt_read_duration},
+      "stop showing packets after this much time", "duration" },
+    { "read_bytes", HAS_ARG, {(void*)opt_read_bytes},
+      "stop showing packets after this many bytes of input", "bytes" },
     { "default", HAS_ARG | OPT_AUDIO | OPT_VIDEO | OPT_EXPERT, {(void*)opt_default}, "generic catch all option", "" },
     { "i", HAS_ARG, {(void *)opt_input_file}, "read specified file", "input_file"},
     { NULL, },
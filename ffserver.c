@@ -32,9 +32,11 @@
 #include "libavformat/os_support.h"
 #include "libavformat/rtpdec.h"
 #include "libavformat/rtsp.h"
+#include "libavformat/rtpenc.h"
 // XXX for ffio_open_dyn_packet_buffer, to be removed
 #include "libavformat/avio_internal.h"
 #include "libavutil/avstring.h"
+#include "libavutil/intreadwrite.h"
 #include "libavutil/lfg.h"
 #include "libavutil/dict.h"
 #include "libavutil/random_seed.h"
@@ -47,10 +49,25 @@
 #if HAVE_POLL_H
 #include <poll.h>
 #endif
+#if HAVE_EPOLL_CREATE
+#include <sys/epoll.h>
+#elif HAVE_KQUEUE
+#include <sys/event.h>
+#endif
 #include <errno.h>
 #include <sys/time.h>
 #include <time.h>
 #include <sys/wait.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#if HAVE_PTHREADS && CONFIG_AVFILTER
+#include <pthread.h>
+#include "libavutil/fifo.h"
+#include "libavfilter/avcodec.h"
+#include "libavfilter/avfiltergraph.h"
+#include "libavfilter/vsink_buffer.h"
+#endif
 #include <signal.h>
 #if HAVE_DLFCN_H
 #include <dlfcn.h>
@@ -114,12 +131,29 @@ typedef struct {
     int64_t time1, time2;
 } DataRateData;
 
+#define HISTOGRAM_BUCKETS 11
+
+/* durations in microseconds, bucket i counts the ones below 4^(i+1),
+   the last one everything else */
+typedef struct Histogram {
+    int64_t count;
+    int64_t sum;
+    int64_t buckets[HISTOGRAM_BUCKETS];
+} Histogram;
+
+/* socket watched by the main loop, events use the poll() flags */
+typedef struct EventWatch {
+    int fd;
+    int events;  /* events currently watched */
+    int revents; /* events reported by the last wait */
+} EventWatch;
+
 /* context associated with one connection */
 typedef struct HTTPContext {
     enum HTTPState state;
     int fd; /* socket file descriptor */
     struct sockaddr_in from_addr; /* origin */
-    struct pollfd *poll_entry; /* used when polling */
+    EventWatch watch; /* used when polling */
     int64_t timeout;
     uint8_t *buffer_ptr, *buffer_end;
     int http_error;
@@ -150,6 +184,10 @@ typedef struct HTTPContext {
     int switch_pending;
     AVFormatContext fmt_ctx; /* instance of FFStream for one user */
     int last_packet_sent; /* true if last data packet was sent */
+    int can_share;        /* live client starting from the current position */
+    struct HTTPSharedStream *shared;
+    int64_t shared_seq;   /* next chunk to send, -1 if not chosen yet */
+    int64_t dropped;      /* shared chunks skipped because we were too slow */
     int suppress_log;
     DataRateData datarate;
     int wmp_client_id;
@@ -199,6 +237,57 @@ typedef struct IPAddressACL {
     struct in_addr last;
 } IPAddressACL;
 
+#define RTP_SHARED_FRAMES 32
+
+/* RTP packets of a recently sent frame */
+typedef struct RTPSharedFrame {
+    int64_t dts;
+    int size;             /* size of the source packet */
+    uint8_t *data;        /* RTP packets, each preceded by its size */
+    int len;
+} RTPSharedFrame;
+
+/* RTP packetization shared by all the RTP sessions of a stream */
+typedef struct RTPSharedStream {
+    AVFormatContext *ctx; /* muxer doing the packetization */
+    int max_packet_size;
+    int64_t last_dts;     /* dts of the newest frame packetized */
+    RTPSharedFrame frames[RTP_SHARED_FRAMES];
+    int next_frame;       /* oldest entry, reused next */
+} RTPSharedStream;
+
+#define HTTP_SHARED_CHUNKS 256
+#define HTTP_SHARED_IOV    32   /* chunks sent by a single writev() */
+
+/* muxer output following one packet of a shared HTTP stream */
+typedef struct HTTPSharedChunk {
+    int key;              /* clients may start receiving the stream here */
+    int64_t dts;          /* in AV_TIME_BASE units */
+    uint8_t *data;
+    int len;
+} HTTPSharedChunk;
+
+/* feed reading and muxing shared by the HTTP clients of a live stream,
+   each of them only keeps its position in the chunks */
+typedef struct HTTPSharedStream {
+    AVFormatContext *fmt_in;
+    AVFormatContext fmt_ctx;
+    uint8_t *header;      /* sent to each client before the chunks */
+    int header_len;
+    int key_pending;      /* a keyframe was muxed but did not output data yet */
+    HTTPSharedChunk chunks[HTTP_SHARED_CHUNKS];
+    int64_t nb_chunks;    /* chunks muxed so far, the last ones are kept */
+    int nb_clients;
+} HTTPSharedStream;
+
+/* storage of an InMemory feed: it is laid out like a feed file and
+   mapped before the workers are started, so that they all share it */
+typedef struct FeedMemory {
+    int64_t size;         /* bytes stored, like the size of a feed file */
+    int writer;           /* set while a feeder connection is writing */
+    uint8_t data[1];
+} FeedMemory;
+
 /* description of each stream of the ffserver.conf file */
 typedef struct FFStream {
     enum StreamType stream_type;
@@ -235,17 +324,30 @@ typedef struct FFStream {
     int multicast_port; /* first port used for multicast */
     int multicast_ttl;
     int loop; /* if true, send the stream in loops (only meaningful if file) */
+    RTPSharedStream *rtp_shared[MAX_STREAMS];
+    HTTPSharedStream *http_shared;
 
     /* feed specific */
     int feed_opened;     /* true if someone is writing to the feed */
     int is_feed;         /* true if it is a feed */
     int readonly;        /* True if writing is prohibited to the file */
     int truncate;        /* True if feeder connection truncate the feed file */
+    int in_memory;       /* True if the feed is not stored in a file */
+    FeedMemory *feed_mem;
     int conns_served;
     int64_t bytes_served;
+    int64_t dropped;            /* shared chunks skipped by slow clients */
+    int64_t bytes_received;     /* feed data written by the feeders */
+    DataRateData recv_datarate;
     int64_t feed_max_size;      /* maximum storage size, zero means unlimited */
+    int feed_packet_size;       /* size of the FFM packets stored in the feed */
     int64_t feed_write_index;   /* current write position in feed (it wraps around) */
     int64_t feed_size;          /* current size of feed */
+    int feed_index_fd;          /* used to follow a feed received by another worker */
+    char source_url[1024];      /* input transcoded by ffserver itself */
+    AVInputFormat *source_ifmt;
+    AVDictionary *source_opts;
+    struct FeedSource *source;
     struct FFStream *next_feed;
 } FFStream;
 
@@ -270,7 +372,9 @@ static int handle_connection(HTTPContext *c);
 static int http_parse_request(HTTPContext *c);
 static int http_send_data(HTTPContext *c);
 static void compute_status(HTTPContext *c);
+static void compute_metrics(HTTPContext *c, int json);
 static int open_input_stream(HTTPContext *c, const char *info);
+static void http_shared_leave(HTTPContext *c);
 static int http_start_receive_data(HTTPContext *c);
 static int http_receive_data(HTTPContext *c);
 
@@ -294,10 +398,16 @@ static HTTPContext *rtp_new_connection(struct sockaddr_in *from_addr,
 static int rtp_new_av_stream(HTTPContext *c,
                              int stream_index, struct sockaddr_in *dest_addr,
                              HTTPContext *rtsp_c);
+static int rtp_write_shared(HTTPContext *c, AVFormatContext *ctx,
+                            AVPacket *pkt, int max_packet_size);
 
 static const char *my_program_name;
 static const char *my_program_dir;
 
+static int source_pipe[2] = { -1, -1 }; /* wakes up the main loop for the sources */
+static void start_sources(void);
+static void check_sources(void);
+
 static const char *config_filename = "/etc/ffserver.conf";
 
 static int ffserver_debug;
@@ -305,6 +415,11 @@ static int ffserver_daemon;
 static int no_launch;
 static int need_to_start_children;
 
+/* number of processes accepting connections, the master is worker 0 */
+static int nb_workers = 1;
+static int worker_index;
+static pid_t master_pid;
+
 /* maximum number of simultaneous HTTP connections */
 static unsigned int nb_max_http_connections = 2000;
 static unsigned int nb_max_connections = 5;
@@ -315,6 +430,10 @@ static uint64_t current_bandwidth;
 
 static int64_t cur_time;           // Making this global saves on passing it around everywhere
 
+static time_t server_start_time;
+static Histogram loop_histogram;   /* work done by each main loop iteration */
+static Histogram send_histogram;   /* each http_send_data() call */
+
 static AVLFG random_state;
 
 static FILE *logfile = NULL;
@@ -439,6 +558,15 @@ static int compute_datarate(DataRateData *drd, int64_t count)
     return ((count - drd->count1) * 1000) / (cur_time - drd->time1);
 }
 
+static void histogram_add(Histogram *h, int64_t us)
+{
+    int i = us > 0 ? av_log2(FFMIN(us, INT_MAX)) >> 1 : 0;
+
+    h->count++;
+    h->sum += us;
+    h->buckets[FFMIN(i, HISTOGRAM_BUCKETS - 1)]++;
+}
+
 
 static void start_children(FFStream *feed)
 {
@@ -589,19 +717,204 @@ static void start_multicast(void)
     }
 }
 
+/* Readiness notification: epoll and kqueue keep the watched sockets in
+   the kernel, so that a wait only costs as much as the sockets that are
+   ready. poll() is the fallback, its table is rebuilt for every wait. */
+#if HAVE_EPOLL_CREATE
+static int event_fd;
+static struct epoll_event *event_table;
+#elif HAVE_KQUEUE
+static int event_fd;
+static struct kevent *event_table;
+#else
+static struct pollfd *poll_table, *poll_entry;
+static EventWatch **poll_watches;
+#endif
+static int event_table_size;
+
+static int event_init(int max_watches)
+{
+    event_table_size = max_watches;
+#if HAVE_EPOLL_CREATE
+    if ((event_fd = epoll_create(max_watches)) < 0)
+        return -1;
+    fcntl(event_fd, F_SETFD, FD_CLOEXEC);
+    event_table = av_malloc(event_table_size * sizeof(*event_table));
+    return event_table ? 0 : -1;
+#elif HAVE_KQUEUE
+    if ((event_fd = kqueue()) < 0)
+        return -1;
+    fcntl(event_fd, F_SETFD, FD_CLOEXEC);
+    /* read and write readiness are reported separately */
+    event_table_size = 2 * max_watches;
+    event_table = av_malloc(event_table_size * sizeof(*event_table));
+    return event_table ? 0 : -1;
+#else
+    poll_table   = av_mallocz(max_watches * sizeof(*poll_table));
+    poll_watches = av_mallocz(max_watches * sizeof(*poll_watches));
+    return poll_table && poll_watches ? 0 : -1;
+#endif
+}
+
+/* start a new round of event_watch() calls */
+static void event_begin(void)
+{
+#if !HAVE_EPOLL_CREATE && !HAVE_KQUEUE
+    poll_entry = poll_table;
+#endif
+}
+
+/* set the events watched on fd, 0 to stop watching it */
+static void event_watch(EventWatch *w, int fd, int events)
+{
+#if HAVE_EPOLL_CREATE
+    struct epoll_event ev = { 0 };
+    int op;
+
+    if (fd < 0 || events == w->events)
+        return;
+    op = !w->events ? EPOLL_CTL_ADD : events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
+    ev.events = (events & POLLIN  ? EPOLLIN  : 0) |
+                (events & POLLOUT ? EPOLLOUT : 0);
+    ev.data.ptr = w;
+    if (epoll_ctl(event_fd, op, fd, &ev) < 0)
+        http_log("epoll_ctl failed on fd %d: %s\n", fd, strerror(errno));
+#elif HAVE_KQUEUE
+    struct kevent changes[2];
+    int nb_changes = 0;
+
+    if (fd < 0 || events == w->events)
+        return;
+    if ((events ^ w->events) & POLLIN)
+        EV_SET(&changes[nb_changes++], fd, EVFILT_READ,
+               events & POLLIN ? EV_ADD : EV_DELETE, 0, 0, w);
+    if ((events ^ w->events) & POLLOUT)
+        EV_SET(&changes[nb_changes++], fd, EVFILT_WRITE,
+               events & POLLOUT ? EV_ADD : EV_DELETE, 0, 0, w);
+    if (kevent(event_fd, changes, nb_changes, NULL, 0, NULL) < 0)
+        http_log("kevent failed on fd %d: %s\n", fd, strerror(errno));
+#else
+    if (fd >= 0 && events) {
+        poll_watches[poll_entry - poll_table] = w;
+        poll_entry->fd = fd;
+        poll_entry->events = events;
+        poll_entry++;
+    }
+#endif
+    w->fd = fd;
+    w->events = events;
+}
+
+/* wait for events and report them in the revents of the watches */
+static int event_wait(int timeout)
+{
+    int i, ret;
+#if HAVE_EPOLL_CREATE
+    ret = epoll_wait(event_fd, event_table, event_table_size, timeout);
+    for (i = 0; i < ret; i++) {
+        EventWatch *w = event_table[i].data.ptr;
+        int e = event_table[i].events;
+        w->revents = (e & EPOLLIN  ? POLLIN  : 0) | (e & EPOLLOUT ? POLLOUT : 0) |
+                     (e & EPOLLERR ? POLLERR : 0) | (e & EPOLLHUP ? POLLHUP : 0);
+    }
+#elif HAVE_KQUEUE
+    struct timespec ts = { timeout / 1000, timeout % 1000 * 1000000 };
+
+    ret = kevent(event_fd, NULL, 0, event_table, event_table_size, &ts);
+    for (i = 0; i < ret; i++) {
+        EventWatch *w = (EventWatch *)event_table[i].udata;
+        w->revents |= event_table[i].filter == EVFILT_READ ? POLLIN : POLLOUT;
+        if (event_table[i].flags & EV_EOF)
+            w->revents |= POLLHUP;
+        if (event_table[i].flags & EV_ERROR)
+            w->revents |= POLLERR;
+    }
+#else
+    ret = poll(poll_table, poll_entry - poll_table, timeout);
+    for (i = 0; ret > 0 && i < poll_entry - poll_table; i++)
+        poll_watches[i]->revents = poll_table[i].revents;
+#endif
+    return ret;
+}
+
+/* Fork the extra workers. They share the listening sockets and each runs
+   its own main loop, with the configuration inherited from the master. */
+static int start_workers(void)
+{
+    int i;
+    pid_t pid;
+
+    master_pid = getpid();
+    for (i = 1; i < nb_workers; i++) {
+        pid = fork();
+        if (pid < 0) {
+            http_log("Unable to create worker %d: %s\n", i, strerror(errno));
+            return -1;
+        }
+        if (!pid) {
+            worker_index = i;
+            /* keep RTSP session ids distinct between workers */
+            av_lfg_init(&random_state, av_get_random_seed());
+            break;
+        }
+    }
+
+    /* the limits are given for the whole server */
+    nb_max_http_connections = (nb_max_http_connections + nb_workers - 1) / nb_workers;
+    nb_max_connections      = (nb_max_connections      + nb_workers - 1) / nb_workers;
+    max_bandwidth           = (max_bandwidth           + nb_workers - 1) / nb_workers;
+    return 0;
+}
+
+/* A feed may be received by another worker or written by a Source
+   thread: follow it through the write index stored in the feed file and
+   wake up the connections waiting for it. */
+static void follow_feeds(void)
+{
+    FFStream *feed;
+    HTTPContext *c;
+    int64_t write_index, received;
+
+    for (feed = first_feed; feed; feed = feed->next_feed) {
+        if (feed->feed_opened)
+            continue;
+        if (feed->feed_mem) {
+            write_index = AV_RB64(feed->feed_mem->data + 8);
+            if (write_index == feed->feed_write_index)
+                continue;
+            received = write_index - feed->feed_write_index;
+            feed->feed_write_index = write_index;
+            feed->feed_size = feed->feed_mem->size;
+        } else {
+            if (feed->feed_index_fd < 0 &&
+                (feed->feed_index_fd = open(feed->feed_filename, O_RDONLY)) < 0)
+                continue;
+            write_index = ffm_read_write_index(feed->feed_index_fd);
+            if (write_index < 0 || write_index == feed->feed_write_index)
+                continue;
+            received = write_index - feed->feed_write_index;
+            feed->feed_write_index = write_index;
+            feed->feed_size = lseek(feed->feed_index_fd, 0, SEEK_END);
+        }
+        if (received < 0)
+            received += feed->feed_size - feed->feed_packet_size;
+        feed->bytes_received += received;
+        update_datarate(&feed->recv_datarate, feed->bytes_received);
+        for (c = first_http_ctx; c; c = c->next)
+            if (c->state == HTTPSTATE_WAIT_FEED && c->stream->feed == feed)
+                c->state = HTTPSTATE_SEND_DATA;
+    }
+}
+
 /* main loop of the http server */
 static int http_server(void)
 {
     int server_fd = 0, rtsp_server_fd = 0;
     int ret, delay, delay1;
-    struct pollfd *poll_table, *poll_entry;
+    int64_t loop_start;
+    EventWatch server_watch = { 0 }, rtsp_server_watch = { 0 }, source_watch = { 0 };
     HTTPContext *c, *c_next;
 
-    if(!(poll_table = av_mallocz((nb_max_http_connections + 2)*sizeof(*poll_table)))) {
-        http_log("Impossible to allocate a poll table handling %d connections.\n", nb_max_http_connections);
-        return -1;
-    }
-
     if (my_http_addr.sin_port) {
         server_fd = socket_open_listen(&my_http_addr);
         if (server_fd < 0)
@@ -623,45 +936,46 @@ static int http_server(void)
 
     start_children(first_feed);
 
-    start_multicast();
+    if (nb_workers > 1 && start_workers() < 0)
+        return -1;
+
+    /* after the fork: the workers must not share an epoll or kqueue */
+    if (event_init(nb_max_http_connections + 2) < 0) {
+        http_log("Impossible to allocate a poll table handling %d connections.\n", nb_max_http_connections);
+        return -1;
+    }
+
+    if (!worker_index) {
+        start_multicast();
+        start_sources();
+    }
 
     for(;;) {
-        poll_entry = poll_table;
-        if (server_fd) {
-            poll_entry->fd = server_fd;
-            poll_entry->events = POLLIN;
-            poll_entry++;
-        }
-        if (rtsp_server_fd) {
-            poll_entry->fd = rtsp_server_fd;
-            poll_entry->events = POLLIN;
-            poll_entry++;
-        }
+        event_begin();
+        if (server_fd)
+            event_watch(&server_watch, server_fd, POLLIN);
+        if (rtsp_server_fd)
+            event_watch(&rtsp_server_watch, rtsp_server_fd, POLLIN);
+        if (source_pipe[0] >= 0)
+            event_watch(&source_watch, source_pipe[0], POLLIN);
 
         /* wait for events on each HTTP handle */
         c = first_http_ctx;
         delay = 1000;
         while (c != NULL) {
-            int fd;
-            fd = c->fd;
+            int events = 0;
             switch(c->state) {
             case HTTPSTATE_SEND_HEADER:
             case RTSPSTATE_SEND_REPLY:
             case RTSPSTATE_SEND_PACKET:
-                c->poll_entry = poll_entry;
-                poll_entry->fd = fd;
-                poll_entry->events = POLLOUT;
-                poll_entry++;
+                events = POLLOUT;
                 break;
             case HTTPSTATE_SEND_DATA_HEADER:
             case HTTPSTATE_SEND_DATA:
             case HTTPSTATE_SEND_DATA_TRAILER:
                 if (!c->is_packetized) {
                     /* for TCP, we output as much as we can (may need to put a limit) */
-                    c->poll_entry = poll_entry;
-                    poll_entry->fd = fd;
-                    poll_entry->events = POLLOUT;
-                    poll_entry++;
+                    events = POLLOUT;
                 } else {
                     /* when ffserver is doing the timing, we work by
                        looking at which packet need to be sent every
@@ -671,33 +985,52 @@ static int http_server(void)
                         delay = delay1;
                 }
                 break;
+            case HTTPSTATE_WAIT_FEED:
+                /* the feeder may be served by another worker, which we
+                   only notice by looking at the feed file */
+                if (nb_workers > 1 && delay > 10)
+                    delay = 10;
             case HTTPSTATE_WAIT_REQUEST:
             case HTTPSTATE_RECEIVE_DATA:
-            case HTTPSTATE_WAIT_FEED:
             case RTSPSTATE_WAIT_REQUEST:
                 /* need to catch errors */
-                c->poll_entry = poll_entry;
-                poll_entry->fd = fd;
-                poll_entry->events = POLLIN;/* Maybe this will work */
-                poll_entry++;
+                events = POLLIN;/* Maybe this will work */
                 break;
             default:
-                c->poll_entry = NULL;
                 break;
             }
+            /* with epoll and kqueue, only changes reach the kernel */
+            event_watch(&c->watch, c->fd, events);
             c = c->next;
         }
 
         /* wait for an event on one connection. We poll at least every
            second to handle timeouts */
         do {
-            ret = poll(poll_table, poll_entry - poll_table, delay);
+            ret = event_wait(delay);
             if (ret < 0 && ff_neterrno() != AVERROR(EAGAIN) &&
                 ff_neterrno() != AVERROR(EINTR))
                 return -1;
         } while (ret < 0);
 
-        cur_time = av_gettime() / 1000;
+        loop_start = av_gettime();
+        cur_time = loop_start / 1000;
+
+        if (nb_workers > 1) {
+            /* the master owns the feeders, do not outlive it */
+            if (worker_index && getppid() != master_pid)
+                exit(0);
+            follow_feeds();
+        }
+
+        /* a Source stored data or stopped */
+        if (source_watch.revents & POLLIN) {
+            char buf[256];
+            while (read(source_pipe[0], buf, sizeof(buf)) > 0);
+            follow_feeds();
+            check_sources();
+        }
+        source_watch.revents = 0;
 
         if (need_to_start_children) {
             need_to_start_children = 0;
@@ -711,21 +1044,19 @@ static int http_server(void)
                 /* close and free the connection */
                 log_connection(c);
                 close_connection(c);
-            }
+            } else
+                c->watch.revents = 0;
         }
 
-        poll_entry = poll_table;
-        if (server_fd) {
-            /* new HTTP connection request ? */
-            if (poll_entry->revents & POLLIN)
-                new_connection(server_fd, 0);
-            poll_entry++;
-        }
-        if (rtsp_server_fd) {
-            /* new RTSP connection request ? */
-            if (poll_entry->revents & POLLIN)
-                new_connection(rtsp_server_fd, 1);
-        }
+        /* new HTTP connection request ? */
+        if (server_watch.revents & POLLIN)
+            new_connection(server_fd, 0);
+        /* new RTSP connection request ? */
+        if (rtsp_server_watch.revents & POLLIN)
+            new_connection(rtsp_server_fd, 1);
+        server_watch.revents = rtsp_server_watch.revents = 0;
+
+        histogram_add(&loop_histogram, av_gettime() - loop_start);
     }
 }
 
@@ -770,7 +1101,9 @@ static void new_connection(int server_fd, int is_rtsp)
     fd = accept(server_fd, (struct sockaddr *)&from_addr,
                 &len);
     if (fd < 0) {
-        http_log("error during accept %s\n", strerror(errno));
+        /* with several workers, another one may have taken it */
+        if (nb_workers == 1 || ff_neterrno() != AVERROR(EAGAIN))
+            http_log("error during accept %s\n", strerror(errno));
         return;
     }
     ff_socket_nonblock(fd, 1);
@@ -786,7 +1119,6 @@ static void new_connection(int server_fd, int is_rtsp)
         goto fail;
 
     c->fd = fd;
-    c->poll_entry = NULL;
     c->from_addr = from_addr;
     c->buffer_size = IOBUFFER_INIT_SIZE;
     c->buffer = av_malloc(c->buffer_size);
@@ -809,13 +1141,212 @@ static void new_connection(int server_fd, int is_rtsp)
     closesocket(fd);
 }
 
+typedef struct FeedMemoryReader {
+    FeedMemory *mem;
+    int64_t pos;
+} FeedMemoryReader;
+
+static int feed_memory_read(void *opaque, uint8_t *buf, int buf_size)
+{
+    FeedMemoryReader *r = opaque;
+    int64_t write_index = AV_RB64(r->mem->data + 8);
+    /* past the write index, only the data of the previous round is left */
+    int64_t end = r->pos < write_index ? write_index : r->mem->size;
+    int len = FFMIN(buf_size, end - r->pos);
+
+    if (len <= 0)
+        return 0;
+    memcpy(buf, r->mem->data + r->pos, len);
+    r->pos += len;
+    return len;
+}
+
+static int64_t feed_memory_seek(void *opaque, int64_t offset, int whence)
+{
+    FeedMemoryReader *r = opaque;
+
+    switch (whence) {
+    case AVSEEK_SIZE:
+        return r->mem->size;
+    case SEEK_SET:
+        break;
+    case SEEK_CUR:
+        offset += r->pos;
+        break;
+    case SEEK_END:
+        offset += r->mem->size;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+    if (offset < 0 || offset > r->mem->size)
+        return AVERROR(EINVAL);
+    return r->pos = offset;
+}
+
+/* Return a context reading an InMemory feed. Its buffer holds a single
+   packet, so that nothing is read ahead of the write index. */
+static AVIOContext *feed_memory_open(FFStream *feed)
+{
+    FeedMemoryReader *r = av_mallocz(sizeof(*r));
+    uint8_t *buf = av_malloc(feed->feed_packet_size);
+    AVIOContext *pb = NULL;
+
+    if (r && buf)
+        pb = avio_alloc_context(buf, feed->feed_packet_size, 0, r,
+                                feed_memory_read, NULL, feed_memory_seek);
+    if (!pb) {
+        av_free(r);
+        av_free(buf);
+        return NULL;
+    }
+    r->mem = feed->feed_mem;
+    return pb;
+}
+
+static void feed_memory_close(AVIOContext *pb)
+{
+    av_free(pb->opaque);
+    av_free(pb->buffer);
+    av_free(pb);
+}
+
+static void close_input_stream(AVFormatContext *s)
+{
+    AVIOContext *pb = s->flags & AVFMT_FLAG_CUSTOM_IO ? s->pb : NULL;
+    int i;
+
+    /* close each frame parser */
+    for(i=0;i<s->nb_streams;i++) {
+        AVStream *st = s->streams[i];
+        if (st->codec->codec)
+            avcodec_close(st->codec);
+    }
+    av_close_input_file(s);
+    /* reader of an InMemory feed */
+    if (pb)
+        feed_memory_close(pb);
+}
+
+/* Become the writer of the feed store, returns the file descriptor to
+   write a feed file with, 0 for an InMemory feed, or -1 if the feed is
+   already being written. */
+static int feed_store_open(FFStream *feed)
+{
+    int fd;
+
+    if (feed->feed_mem) {
+        FeedMemory *mem = feed->feed_mem;
+
+        /* another worker may already be receiving this feed */
+        if (!__sync_bool_compare_and_swap(&mem->writer, 0, 1)) {
+            http_log("Feed '%s' already being received\n", feed->feed_filename);
+            return -1;
+        }
+        if (feed->truncate) {
+            AV_WB64(mem->data + 8, feed->feed_packet_size);
+            mem->size = feed->feed_packet_size;
+        }
+        feed->feed_write_index = FFMAX(AV_RB64(mem->data + 8), feed->feed_packet_size);
+        feed->feed_size = mem->size;
+        return 0;
+    }
+
+    /* open feed */
+    fd = open(feed->feed_filename, O_RDWR);
+    if (fd < 0) {
+        http_log("Error opening feeder file: %s\n", strerror(errno));
+        return -1;
+    }
+
+    /* another worker may already be receiving this feed */
+    if (flock(fd, LOCK_EX | LOCK_NB) < 0) {
+        http_log("Feed '%s' already being received\n", feed->feed_filename);
+        close(fd);
+        return -1;
+    }
+
+    if (feed->truncate) {
+        /* truncate feed file */
+        ffm_write_write_index(fd, feed->feed_packet_size);
+        ftruncate(fd, feed->feed_packet_size);
+        http_log("Truncating feed file '%s'\n", feed->feed_filename);
+    } else {
+        if ((feed->feed_write_index = ffm_read_write_index(fd)) < 0) {
+            http_log("Error reading write index from feed file: %s\n", strerror(errno));
+            close(fd);
+            return -1;
+        }
+    }
+
+    feed->feed_write_index = FFMAX(ffm_read_write_index(fd), feed->feed_packet_size);
+    feed->feed_size = lseek(fd, 0, SEEK_END);
+    lseek(fd, 0, SEEK_SET);
+    return fd;
+}
+
+static void feed_store_close(FFStream *feed, int fd)
+{
+    if (feed->feed_mem)
+        feed->feed_mem->writer = 0;
+    else
+        close(fd);
+}
+
+/* Store one packet of the feed at *write_index and publish the new write
+   index to the readers. The writer keeps its own copies of the write
+   index and size, as it does not always run in the main loop. */
+static int feed_store_write(FFStream *feed, int fd, int64_t *write_index,
+                            int64_t *size, const uint8_t *buf)
+{
+    if (feed->feed_mem) {
+        memcpy(feed->feed_mem->data + *write_index, buf, feed->feed_packet_size);
+    } else {
+        /* XXX: use llseek or url_seek */
+        lseek(fd, *write_index, SEEK_SET);
+        if (write(fd, buf, feed->feed_packet_size) < 0) {
+            http_log("Error writing to feed file: %s\n", strerror(errno));
+            return -1;
+        }
+    }
+
+    *write_index += feed->feed_packet_size;
+    /* update file size */
+    if (*write_index > *size)
+        *size = *write_index;
+
+    /* handle wrap around if max file size reached */
+    if (feed->feed_max_size && *write_index >= feed->feed_max_size)
+        *write_index = feed->feed_packet_size;
+
+    /* write index */
+    if (feed->feed_mem) {
+        feed->feed_mem->size = *size;
+        /* readers in other workers must see the data first */
+        __sync_synchronize();
+        AV_WB64(feed->feed_mem->data + 8, *write_index);
+    } else if (ffm_write_write_index(fd, *write_index) < 0) {
+        http_log("Error writing index to feed file: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/* the feeder connection c stops writing to its feed */
+static void close_feed(HTTPContext *c)
+{
+    if (!c->stream->feed_opened)
+        return;
+    c->stream->feed_opened = 0;
+    feed_store_close(c->stream, c->feed_fd);
+}
+
 static void close_connection(HTTPContext *c)
 {
     HTTPContext **cp, *c1;
     int i, nb_streams;
     AVFormatContext *ctx;
     URLContext *h;
-    AVStream *st;
 
     /* remove connection from list */
     cp = &first_http_ctx;
@@ -834,17 +1365,14 @@ static void close_connection(HTTPContext *c)
     }
 
     /* remove connection associated resources */
-    if (c->fd >= 0)
+    if (c->fd >= 0) {
+        event_watch(&c->watch, c->fd, 0);
         closesocket(c->fd);
-    if (c->fmt_in) {
-        /* close each frame parser */
-        for(i=0;i<c->fmt_in->nb_streams;i++) {
-            st = c->fmt_in->streams[i];
-            if (st->codec->codec)
-                avcodec_close(st->codec);
-        }
-        av_close_input_file(c->fmt_in);
     }
+    if (c->fmt_in)
+        close_input_stream(c->fmt_in);
+    if (c->shared)
+        http_shared_leave(c);
 
     /* free RTP output streams if any */
     nb_streams = 0;
@@ -884,10 +1412,8 @@ static void close_connection(HTTPContext *c)
         current_bandwidth -= c->stream->bandwidth;
 
     /* signal that there is no feed if we are the feeder socket */
-    if (c->state == HTTPSTATE_RECEIVE_DATA && c->stream) {
-        c->stream->feed_opened = 0;
-        close(c->feed_fd);
-    }
+    if (c->state == HTTPSTATE_RECEIVE_DATA && c->stream)
+        close_feed(c);
 
     av_freep(&c->pb_buffer);
     av_freep(&c->packet_buffer);
@@ -899,6 +1425,7 @@ static void close_connection(HTTPContext *c)
 static int handle_connection(HTTPContext *c)
 {
     int len, ret;
+    int64_t send_start;
 
     switch(c->state) {
     case HTTPSTATE_WAIT_REQUEST:
@@ -906,11 +1433,11 @@ static int handle_connection(HTTPContext *c)
         /* timeout ? */
         if ((c->timeout - cur_time) < 0)
             return -1;
-        if (c->poll_entry->revents & (POLLERR | POLLHUP))
+        if (c->watch.revents & (POLLERR | POLLHUP))
             return -1;
 
         /* no need to read if no events */
-        if (!(c->poll_entry->revents & POLLIN))
+        if (!(c->watch.revents & POLLIN))
             return 0;
         /* read the data */
     read_loop:
@@ -944,11 +1471,11 @@ static int handle_connection(HTTPContext *c)
         break;
 
     case HTTPSTATE_SEND_HEADER:
-        if (c->poll_entry->revents & (POLLERR | POLLHUP))
+        if (c->watch.revents & (POLLERR | POLLHUP))
             return -1;
 
         /* no need to write if no events */
-        if (!(c->poll_entry->revents & POLLOUT))
+        if (!(c->watch.revents & POLLOUT))
             return 0;
         len = send(c->fd, c->buffer_ptr, c->buffer_end - c->buffer_ptr, 0);
         if (len < 0) {
@@ -982,14 +1509,17 @@ static int handle_connection(HTTPContext *c)
            input streams sets the speed). It may be better to verify
            that we do not rely too much on the kernel queues */
         if (!c->is_packetized) {
-            if (c->poll_entry->revents & (POLLERR | POLLHUP))
+            if (c->watch.revents & (POLLERR | POLLHUP))
                 return -1;
 
             /* no need to read if no events */
-            if (!(c->poll_entry->revents & POLLOUT))
+            if (!(c->watch.revents & POLLOUT))
                 return 0;
         }
-        if (http_send_data(c) < 0)
+        send_start = av_gettime();
+        ret = http_send_data(c);
+        histogram_add(&send_histogram, av_gettime() - send_start);
+        if (ret < 0)
             return -1;
         /* close connection if trailer sent */
         if (c->state == HTTPSTATE_SEND_DATA_TRAILER)
@@ -997,28 +1527,28 @@ static int handle_connection(HTTPContext *c)
         break;
     case HTTPSTATE_RECEIVE_DATA:
         /* no need to read if no events */
-        if (c->poll_entry->revents & (POLLERR | POLLHUP))
+        if (c->watch.revents & (POLLERR | POLLHUP))
             return -1;
-        if (!(c->poll_entry->revents & POLLIN))
+        if (!(c->watch.revents & POLLIN))
             return 0;
         if (http_receive_data(c) < 0)
             return -1;
         break;
     case HTTPSTATE_WAIT_FEED:
         /* no need to read if no events */
-        if (c->poll_entry->revents & (POLLIN | POLLERR | POLLHUP))
+        if (c->watch.revents & (POLLIN | POLLERR | POLLHUP))
             return -1;
 
         /* nothing to do, we'll be waken up by incoming feed packets */
         break;
 
     case RTSPSTATE_SEND_REPLY:
-        if (c->poll_entry->revents & (POLLERR | POLLHUP)) {
+        if (c->watch.revents & (POLLERR | POLLHUP)) {
             av_freep(&c->pb_buffer);
             return -1;
         }
         /* no need to write if no events */
-        if (!(c->poll_entry->revents & POLLOUT))
+        if (!(c->watch.revents & POLLOUT))
             return 0;
         len = send(c->fd, c->buffer_ptr, c->buffer_end - c->buffer_ptr, 0);
         if (len < 0) {
@@ -1039,12 +1569,12 @@ static int handle_connection(HTTPContext *c)
         }
         break;
     case RTSPSTATE_SEND_PACKET:
-        if (c->poll_entry->revents & (POLLERR | POLLHUP)) {
+        if (c->watch.revents & (POLLERR | POLLHUP)) {
             av_freep(&c->packet_buffer);
             return -1;
         }
         /* no need to write if no events */
-        if (!(c->poll_entry->revents & POLLOUT))
+        if (!(c->watch.revents & POLLOUT))
             return 0;
         len = send(c->fd, c->packet_buffer_ptr,
                     c->packet_buffer_end - c->packet_buffer_ptr, 0);
@@ -1847,7 +2377,10 @@ static int http_parse_request(HTTPContext *c)
     c->state = HTTPSTATE_SEND_HEADER;
     return 0;
  send_status:
-    compute_status(c);
+    if (av_match_ext(c->stream->filename, "json,txt"))
+        compute_metrics(c, av_match_ext(c->stream->filename, "json"));
+    else
+        compute_status(c);
     c->http_error = 200; /* horrible : we use this value to avoid
                             going to the send data state */
     c->state = HTTPSTATE_SEND_HEADER;
@@ -1864,26 +2397,288 @@ static void fmt_bytecount(AVIOContext *pb, int64_t count)
     avio_printf(pb, "%"PRId64"%c", count, *s);
 }
 
-static void compute_status(HTTPContext *c)
+/* sum of the bit rates of the streams sent to c */
+static int connection_bitrate(HTTPContext *c)
+{
+    int j, bitrate = 0;
+
+    if (c->stream) {
+        for (j = 0; j < c->stream->nb_streams; j++) {
+            if (!c->stream->feed)
+                bitrate += c->stream->streams[j]->codec->bit_rate;
+            else if (c->feed_streams[j] >= 0)
+                bitrate += c->stream->feed->streams[c->feed_streams[j]]->codec->bit_rate;
+        }
+    }
+    return bitrate;
+}
+
+/* Machine readable status, printed either as JSON or as the plain text
+   format of Prometheus, one 'name{labels} value' line per value. Both
+   are produced by the same calls so that they always match. */
+typedef struct MetricsContext {
+    AVIOContext *pb;
+    int json;
+    int depth;
+    int nb_items[4];         /* items already printed at each JSON depth */
+    const char *prefix;      /* of the text names */
+    char labels[1024];       /* of the text lines, without braces */
+} MetricsContext;
+
+/* print s as a double quoted string, escaped for JSON and text labels */
+static void metrics_quote(char *buf, int buf_size, const char *s)
+{
+    char *q = buf, *end = buf + buf_size - 2;
+
+    *q++ = '"';
+    for (; *s && q < end - 1; s++) {
+        if (*s == '"' || *s == '\\') {
+            *q++ = '\\';
+            *q++ = *s;
+        } else if ((uint8_t)*s >= ' ')
+            *q++ = *s;
+    }
+    *q++ = '"';
+    *q = 0;
+}
+
+/* start a JSON item of the current object or list */
+static void metrics_item(MetricsContext *m, const char *name)
+{
+    if (m->nb_items[m->depth]++)
+        avio_printf(m->pb, ",");
+    avio_printf(m->pb, "\n%*s", 2 * m->depth, "");
+    if (name)
+        avio_printf(m->pb, "\"%s\": ", name);
+}
+
+static void metrics_value(MetricsContext *m, const char *name, int64_t value)
+{
+    if (m->json) {
+        metrics_item(m, name);
+        avio_printf(m->pb, "%"PRId64, value);
+    } else {
+        avio_printf(m->pb, "%s_%s%s%s%s %"PRId64"\n", m->prefix, name,
+                    m->labels[0] ? "{" : "", m->labels, m->labels[0] ? "}" : "",
+                    value);
+    }
+}
+
+/* a string value, only printed in JSON: the text format has it in the labels */
+static void metrics_string(MetricsContext *m, const char *name, const char *value)
+{
+    char quoted[1024];
+
+    if (m->json) {
+        metrics_quote(quoted, sizeof(quoted), value);
+        metrics_item(m, name);
+        avio_printf(m->pb, "%s", quoted);
+    }
+}
+
+/* open an object, in a list if name is NULL */
+static void metrics_open(MetricsContext *m, const char *name, const char *prefix)
+{
+    if (m->json) {
+        if (m->depth)
+            metrics_item(m, name);
+        avio_printf(m->pb, "{");
+        m->nb_items[++m->depth] = 0;
+    }
+    m->prefix = prefix;
+}
+
+static void metrics_close(MetricsContext *m)
+{
+    if (m->json) {
+        avio_printf(m->pb, "\n%*s}", 2 * --m->depth, "");
+        if (!m->depth)
+            avio_printf(m->pb, "\n");
+    }
+    m->labels[0] = 0;
+}
+
+static void metrics_open_list(MetricsContext *m, const char *name)
+{
+    if (m->json) {
+        metrics_item(m, name);
+        avio_printf(m->pb, "[");
+        m->nb_items[++m->depth] = 0;
+    }
+}
+
+static void metrics_close_list(MetricsContext *m)
 {
+    if (m->json)
+        avio_printf(m->pb, "\n%*s]", 2 * --m->depth, "");
+}
+
+/* add a label to the text lines of the current object */
+static void metrics_label(MetricsContext *m, const char *name, const char *value)
+{
+    char quoted[256];
+
+    metrics_quote(quoted, sizeof(quoted), value);
+    av_strlcatf(m->labels, sizeof(m->labels), "%s%s=%s",
+                m->labels[0] ? "," : "", name, quoted);
+}
+
+/* histograms are cumulative, like in Prometheus */
+static void metrics_histogram(MetricsContext *m, const char *name, Histogram *h)
+{
+    int64_t count = 0;
+    char le[32];
+    int i;
+
+    if (m->json) {
+        metrics_item(m, name);
+        avio_printf(m->pb, "{ \"count\": %"PRId64", \"sum\": %"PRId64", \"buckets\": {",
+                    h->count, h->sum);
+    }
+    for (i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        count += h->buckets[i];
+        if (i < HISTOGRAM_BUCKETS - 1)
+            snprintf(le, sizeof(le), "%"PRId64, (int64_t)1 << 2 * (i + 1));
+        else
+            av_strlcpy(le, "+Inf", sizeof(le));
+        if (m->json)
+            avio_printf(m->pb, "%s\"%s\": %"PRId64, i ? ", " : " ", le, count);
+        else
+            avio_printf(m->pb, "%s_%s_bucket{%s%sle=\"%s\"} %"PRId64"\n",
+                        m->prefix, name, m->labels, m->labels[0] ? "," : "",
+                        le, count);
+    }
+    if (m->json) {
+        avio_printf(m->pb, " } }");
+    } else {
+        avio_printf(m->pb, "%s_%s_sum %"PRId64"\n", m->prefix, name, h->sum);
+        avio_printf(m->pb, "%s_%s_count %"PRId64"\n", m->prefix, name, h->count);
+    }
+}
+
+/* status streams named *.json or *.txt get the machine readable status */
+static void compute_metrics(HTTPContext *c, int json)
+{
+    MetricsContext m = { 0 };
     HTTPContext *c1;
     FFStream *stream;
-    char *p;
-    time_t ti;
-    int i, len;
-    AVIOContext *pb;
+    int len, nb_clients;
 
-    if (avio_open_dyn_buf(&pb) < 0) {
-        /* XXX: return an error ? */
+    if (avio_open_dyn_buf(&m.pb) < 0) {
         c->buffer_ptr = c->buffer;
         c->buffer_end = c->buffer;
         return;
     }
+    m.json = json;
+
+    avio_printf(m.pb, "HTTP/1.0 200 OK\r\n");
+    avio_printf(m.pb, "Content-type: %s\r\n",
+                json ? "application/json" : "text/plain; version=0.0.4");
+    avio_printf(m.pb, "Pragma: no-cache\r\n");
+    avio_printf(m.pb, "\r\n");
+
+    metrics_open(&m, NULL, "ffserver");
+    metrics_value(&m, "uptime_seconds", time(NULL) - server_start_time);
+    metrics_value(&m, "worker", worker_index + 1);
+    metrics_value(&m, "workers", nb_workers);
+    metrics_value(&m, "connections", nb_connections);
+    metrics_value(&m, "max_connections", nb_max_connections);
+    metrics_value(&m, "bandwidth_kbits", current_bandwidth);
+    metrics_value(&m, "max_bandwidth_kbits", max_bandwidth);
+    metrics_histogram(&m, "loop_time_us", &loop_histogram);
+    metrics_histogram(&m, "send_time_us", &send_histogram);
+
+    metrics_open_list(&m, "streams");
+    for (stream = first_stream; stream; stream = stream->next) {
+        if (stream->feed == stream || stream->stream_type != STREAM_TYPE_LIVE)
+            continue;
+        nb_clients = 0;
+        for (c1 = first_http_ctx; c1; c1 = c1->next)
+            nb_clients += c1->stream == stream && c1->state != HTTPSTATE_RECEIVE_DATA;
+
+        metrics_open(&m, NULL, "ffserver_stream");
+        metrics_label(&m, "stream", stream->filename);
+        metrics_string(&m, "stream", stream->filename);
+        metrics_string(&m, "format", stream->fmt ? stream->fmt->name : "");
+        metrics_value(&m, "clients", nb_clients);
+        metrics_value(&m, "shared_clients",
+                      stream->http_shared ? stream->http_shared->nb_clients : 0);
+        metrics_value(&m, "connections_served", stream->conns_served);
+        metrics_value(&m, "bytes_served", stream->bytes_served);
+        metrics_value(&m, "dropped_chunks", stream->dropped);
+        metrics_close(&m);
+    }
+    metrics_close_list(&m);
+
+    metrics_open_list(&m, "feeds");
+    for (stream = first_feed; stream; stream = stream->next_feed) {
+        metrics_open(&m, NULL, "ffserver_feed");
+        metrics_label(&m, "feed", stream->filename);
+        metrics_string(&m, "feed", stream->filename);
+        metrics_value(&m, "receiving", stream->feed_opened);
+        metrics_value(&m, "bytes_received", stream->bytes_received);
+        metrics_value(&m, "receive_rate_bytes",
+                      compute_datarate(&stream->recv_datarate, stream->bytes_received));
+        metrics_value(&m, "write_index", stream->feed_write_index);
+        metrics_value(&m, "size_bytes", stream->feed_size);
+        metrics_value(&m, "max_size_bytes", stream->feed_max_size);
+        metrics_close(&m);
+    }
+    metrics_close_list(&m);
+
+    metrics_open_list(&m, "clients");
+    for (c1 = first_http_ctx; c1; c1 = c1->next) {
+        char id[16];
+
+        snprintf(id, sizeof(id), "%d", c1->fd);
+        metrics_open(&m, NULL, "ffserver_client");
+        metrics_label(&m, "fd", id);
+        metrics_label(&m, "stream", c1->stream ? c1->stream->filename : "");
+        metrics_label(&m, "ip", inet_ntoa(c1->from_addr.sin_addr));
+        metrics_label(&m, "state", http_state[c1->state]);
+        metrics_value(&m, "fd", c1->fd);
+        metrics_string(&m, "stream", c1->stream ? c1->stream->filename : "");
+        metrics_string(&m, "ip", inet_ntoa(c1->from_addr.sin_addr));
+        metrics_string(&m, "protocol", c1->protocol);
+        metrics_string(&m, "state", http_state[c1->state]);
+        metrics_value(&m, "target_bits", connection_bitrate(c1));
+        metrics_value(&m, "rate_bits", compute_datarate(&c1->datarate, c1->data_count) * 8);
+        metrics_value(&m, "bytes", c1->data_count);
+        metrics_value(&m, "pending_bytes",
+                      c1->state == HTTPSTATE_SEND_DATA ? c1->buffer_end - c1->buffer_ptr : 0);
+        metrics_value(&m, "shared_lag_chunks",
+                      c1->shared && c1->shared_seq >= 0 ? c1->shared->nb_chunks - c1->shared_seq : 0);
+        metrics_value(&m, "dropped_chunks", c1->dropped);
+        metrics_close(&m);
+    }
+    metrics_close_list(&m);
+    metrics_close(&m);
 
-    avio_printf(pb, "HTTP/1.0 200 OK\r\n");
-    avio_printf(pb, "Content-type: %s\r\n", "text/html");
-    avio_printf(pb, "Pragma: no-cache\r\n");
-    avio_printf(pb, "\r\n");
+    len = avio_close_dyn_buf(m.pb, &c->pb_buffer);
+    c->buffer_ptr = c->pb_buffer;
+    c->buffer_end = c->pb_buffer + len;
+}
+
+static void compute_status(HTTPContext *c)
+{
+    HTTPContext *c1;
+    FFStream *stream;
+    char *p;
+    time_t ti;
+    int i, len;
+    AVIOContext *pb;
+
+    if (avio_open_dyn_buf(&pb) < 0) {
+        /* XXX: return an error ? */
+        c->buffer_ptr = c->buffer;
+        c->buffer_end = c->buffer;
+        return;
+    }
+
+    avio_printf(pb, "HTTP/1.0 200 OK\r\n");
+    avio_printf(pb, "Content-type: %s\r\n", "text/html");
+    avio_printf(pb, "Pragma: no-cache\r\n");
+    avio_printf(pb, "\r\n");
 
     avio_printf(pb, "<html><head><title>%s Status</title>\n", program_name);
     if (c->stream->feed_filename[0])
@@ -1987,6 +2782,8 @@ static void compute_status(HTTPContext *c)
     while (stream != NULL) {
         if (stream->feed == stream) {
             avio_printf(pb, "<h2>Feed %s</h2>", stream->filename);
+            if (stream->source)
+                avio_printf(pb, "Transcoded from %s.\n", stream->source_url);
             if (stream->pid) {
                 avio_printf(pb, "Running as pid %d.\n", stream->pid);
 
@@ -2052,6 +2849,9 @@ static void compute_status(HTTPContext *c)
     /* connection status */
     avio_printf(pb, "<h2>Connection Status</h2>\n");
 
+    if (nb_workers > 1)
+        avio_printf(pb, "Worker %d of %d<br>\n", worker_index + 1, nb_workers);
+
     avio_printf(pb, "Number of connections: %d / %d<br>\n",
                  nb_connections, nb_max_connections);
 
@@ -2063,18 +2863,7 @@ static void compute_status(HTTPContext *c)
     c1 = first_http_ctx;
     i = 0;
     while (c1 != NULL) {
-        int bitrate;
-        int j;
-
-        bitrate = 0;
-        if (c1->stream) {
-            for (j = 0; j < c1->stream->nb_streams; j++) {
-                if (!c1->stream->feed)
-                    bitrate += c1->stream->streams[j]->codec->bit_rate;
-                else if (c1->feed_streams[j] >= 0)
-                    bitrate += c1->stream->feed->streams[c1->feed_streams[j]]->codec->bit_rate;
-            }
-        }
+        int bitrate = connection_bitrate(c1);
 
         i++;
         p = inet_ntoa(c1->from_addr.sin_addr);
@@ -2122,18 +2911,35 @@ static void open_parser(AVFormatContext *s, int i)
     }
 }
 
+/* muxers which output each packet as soon as they get it, so that the
+   data following a keyframe is a place where new clients can start */
+static int http_format_is_shareable(AVOutputFormat *fmt)
+{
+    static const char * const names[] = {
+        "asf", "asf_stream", "flv", "mpegts", "mpjpeg", NULL
+    };
+    int i;
+
+    for (i = 0; names[i]; i++)
+        if (!strcmp(fmt->name, names[i]))
+            return 1;
+    return 0;
+}
+
 static int open_input_stream(HTTPContext *c, const char *info)
 {
     char buf[128];
     char input_filename[1024];
     AVFormatContext *s = NULL;
+    AVInputFormat *ifmt = c->stream->ifmt;
+    AVIOContext *pb = NULL;
     int buf_size, i, ret;
     int64_t stream_pos;
 
     /* find file name */
     if (c->stream->feed) {
         strcpy(input_filename, c->stream->feed->feed_filename);
-        buf_size = FFM_PACKET_SIZE;
+        buf_size = c->stream->feed->feed_packet_size;
         /* compute position (absolute time) */
         if (av_find_info_tag(buf, sizeof(buf), "date", info)) {
             if ((ret = av_parse_time(&stream_pos, buf, 0)) < 0)
@@ -2141,8 +2947,11 @@ static int open_input_stream(HTTPContext *c, const char *info)
         } else if (av_find_info_tag(buf, sizeof(buf), "buffer", info)) {
             int prebuffer = strtol(buf, 0, 10);
             stream_pos = av_gettime() - prebuffer * (int64_t)1000000;
-        } else
+        } else {
             stream_pos = av_gettime() - c->stream->prebuffer * (int64_t)1000;
+            c->can_share = c->stream->feed != c->stream &&
+                           http_format_is_shareable(c->stream->fmt);
+        }
     } else {
         strcpy(input_filename, c->stream->feed_filename);
         buf_size = 0;
@@ -2157,8 +2966,19 @@ static int open_input_stream(HTTPContext *c, const char *info)
         return -1;
 
     /* open stream */
-    if ((ret = avformat_open_input(&s, input_filename, c->stream->ifmt, &c->stream->in_opts)) < 0) {
+    if (c->stream->feed && c->stream->feed->feed_mem) {
+        if (!(s = avformat_alloc_context()))
+            return -1;
+        if (!(s->pb = pb = feed_memory_open(c->stream->feed))) {
+            avformat_free_context(s);
+            return -1;
+        }
+        ifmt = av_find_input_format("ffm");
+    }
+    if ((ret = avformat_open_input(&s, input_filename, ifmt, &c->stream->in_opts)) < 0) {
         http_log("could not open %s: %d\n", input_filename, ret);
+        if (pb)
+            feed_memory_close(pb);
         return -1;
     }
     s->flags |= AVFMT_FLAG_GENPTS;
@@ -2214,6 +3034,300 @@ static int64_t get_packet_send_clock(HTTPContext *c)
     }
 }
 
+/* set up the muxer of stream in ctx and return the size of the header it
+   writes in *pheader */
+static int open_output_stream(FFStream *stream, AVFormatContext *ctx,
+                              uint8_t **pheader)
+{
+    int i, len;
+
+    memset(ctx, 0, sizeof(*ctx));
+    av_dict_set(&ctx->metadata, "author"   , stream->author   , 0);
+    av_dict_set(&ctx->metadata, "comment"  , stream->comment  , 0);
+    av_dict_set(&ctx->metadata, "copyright", stream->copyright, 0);
+    av_dict_set(&ctx->metadata, "title"    , stream->title    , 0);
+
+    ctx->streams = av_mallocz(sizeof(AVStream *) * stream->nb_streams);
+
+    for(i=0;i<stream->nb_streams;i++) {
+        AVStream *src;
+        ctx->streams[i] = av_mallocz(sizeof(AVStream));
+        /* if file or feed, then just take streams from FFStream struct */
+        if (!stream->feed ||
+            stream->feed == stream)
+            src = stream->streams[i];
+        else
+            src = stream->feed->streams[stream->feed_streams[i]];
+
+        *(ctx->streams[i]) = *src;
+        ctx->streams[i]->priv_data = 0;
+        ctx->streams[i]->codec->frame_number = 0; /* XXX: should be done in
+                                       AVStream, not in codec */
+    }
+    /* set output format parameters */
+    ctx->oformat = stream->fmt;
+    ctx->nb_streams = stream->nb_streams;
+    /* feeders reading the feed header use its packet size */
+    if (stream->is_feed)
+        ctx->packet_size = stream->feed_packet_size;
+
+    /* prepare header and save header data in a stream */
+    if (avio_open_dyn_buf(&ctx->pb) < 0) {
+        /* XXX: potential leak */
+        return -1;
+    }
+    ctx->pb->seekable = 0;
+
+    /*
+     * HACK to avoid mpeg ps muxer to spit many underflow errors
+     * Default value from FFmpeg
+     * Try to set it use configuration option
+     */
+    ctx->preload   = (int)(0.5*AV_TIME_BASE);
+    ctx->max_delay = (int)(0.7*AV_TIME_BASE);
+
+    if (avformat_write_header(ctx, NULL) < 0) {
+        http_log("Error writing output header\n");
+        return -1;
+    }
+    av_dict_free(&ctx->metadata);
+
+    len = avio_close_dyn_buf(ctx->pb, pheader);
+    return len;
+}
+
+static void http_shared_free(FFStream *stream)
+{
+    HTTPSharedStream *sh = stream->http_shared;
+    uint8_t *dummy_buf;
+    int i;
+
+    if (sh->fmt_ctx.oformat && avio_open_dyn_buf(&sh->fmt_ctx.pb) >= 0) {
+        av_write_trailer(&sh->fmt_ctx);
+        avio_close_dyn_buf(sh->fmt_ctx.pb, &dummy_buf);
+        av_free(dummy_buf);
+    }
+    for (i = 0; i < sh->fmt_ctx.nb_streams; i++)
+        av_free(sh->fmt_ctx.streams[i]);
+    av_free(sh->fmt_ctx.streams);
+    if (sh->fmt_in)
+        close_input_stream(sh->fmt_in);
+    for (i = 0; i < HTTP_SHARED_CHUNKS; i++)
+        av_free(sh->chunks[i].data);
+    av_free(sh->header);
+    av_freep(&stream->http_shared);
+}
+
+/* Attach c to the shared muxing of its stream, created from the input
+   c has just opened if it is the first client. */
+static int http_shared_join(HTTPContext *c)
+{
+    HTTPSharedStream *sh = c->stream->http_shared;
+
+    if (!sh) {
+        sh = av_mallocz(sizeof(*sh));
+        if (!sh)
+            return -1;
+        c->stream->http_shared = sh;
+        sh->header_len = open_output_stream(c->stream, &sh->fmt_ctx, &sh->header);
+        if (sh->header_len < 0) {
+            sh->fmt_ctx.oformat = NULL;
+            http_shared_free(c->stream);
+            return -1;
+        }
+        sh->fmt_in = c->fmt_in;
+    } else {
+        close_input_stream(c->fmt_in);
+    }
+    c->fmt_in = NULL;
+
+    sh->nb_clients++;
+    c->shared     = sh;
+    c->shared_seq = -1;
+    c->buffer_ptr = sh->header;
+    c->buffer_end = sh->header + sh->header_len;
+    return 0;
+}
+
+static void http_shared_leave(HTTPContext *c)
+{
+    if (!--c->shared->nb_clients)
+        http_shared_free(c->stream);
+    c->shared = NULL;
+}
+
+/* Read a packet from the feed and store its muxer output in a new chunk.
+   Return < 0 if the feed has no more data for now. */
+static int http_shared_read(FFStream *stream)
+{
+    HTTPSharedStream *sh = stream->http_shared;
+    HTTPSharedChunk *chunk;
+    HTTPContext *c;
+    AVStream *ist, *ost;
+    AVPacket pkt;
+    int64_t dropped;
+    int i, ret;
+
+    ffm_set_write_index(sh->fmt_in, stream->feed->feed_write_index,
+                        stream->feed->feed_size);
+ redo:
+    if (av_read_frame(sh->fmt_in, &pkt) < 0)
+        return -1;
+    for (i = 0; i < stream->nb_streams; i++)
+        if (stream->feed_streams[i] == pkt.stream_index)
+            break;
+    if (i == stream->nb_streams) {
+        av_free_packet(&pkt);
+        goto redo;
+    }
+    ist = sh->fmt_in->streams[pkt.stream_index];
+    ost = sh->fmt_ctx.streams[i];
+    if (pkt.flags & AV_PKT_FLAG_KEY &&
+        (ist->codec->codec_type == AVMEDIA_TYPE_VIDEO || stream->nb_streams == 1))
+        sh->key_pending = 1;
+
+    chunk = &sh->chunks[sh->nb_chunks % HTTP_SHARED_CHUNKS];
+    if (pkt.dts != AV_NOPTS_VALUE)
+        chunk->dts = av_rescale_q(pkt.dts, ist->time_base, AV_TIME_BASE_Q);
+    else if (sh->nb_chunks)
+        chunk->dts = sh->chunks[(sh->nb_chunks - 1) % HTTP_SHARED_CHUNKS].dts;
+
+    if (avio_open_dyn_buf(&sh->fmt_ctx.pb) < 0) {
+        av_free_packet(&pkt);
+        return -1;
+    }
+    sh->fmt_ctx.pb->seekable = 0;
+    pkt.stream_index = i;
+    if (pkt.dts != AV_NOPTS_VALUE)
+        pkt.dts = av_rescale_q(pkt.dts, ist->time_base, ost->time_base);
+    if (pkt.pts != AV_NOPTS_VALUE)
+        pkt.pts = av_rescale_q(pkt.pts, ist->time_base, ost->time_base);
+    pkt.duration = av_rescale_q(pkt.duration, ist->time_base, ost->time_base);
+    ret = av_write_frame(&sh->fmt_ctx, &pkt);
+    av_free_packet(&pkt);
+    if (ret < 0)
+        http_log("Error writing frame to output\n");
+
+    /* clients still sending the chunk about to be dropped get a copy */
+    dropped = sh->nb_chunks - HTTP_SHARED_CHUNKS;
+    for (c = first_http_ctx; dropped >= 0 && c; c = c->next) {
+        if (c->shared == sh && c->shared_seq == dropped + 1 && !c->pb_buffer &&
+            c->buffer_ptr < c->buffer_end) {
+            c->pb_buffer = av_malloc(c->buffer_end - c->buffer_ptr);
+            if (!c->pb_buffer)
+                continue;
+            memcpy(c->pb_buffer, c->buffer_ptr, c->buffer_end - c->buffer_ptr);
+            c->buffer_end = c->pb_buffer + (c->buffer_end - c->buffer_ptr);
+            c->buffer_ptr = c->pb_buffer;
+        }
+    }
+    av_freep(&chunk->data);
+    chunk->len = avio_close_dyn_buf(sh->fmt_ctx.pb, &chunk->data);
+    if (!chunk->len)
+        goto redo;
+    chunk->key = sh->key_pending;
+    sh->key_pending = 0;
+    sh->nb_chunks++;
+    return 0;
+}
+
+/* return the oldest chunk starting at a keyframe at most max_age us older
+   than the newest chunk, or the newest keyframe chunk if none is */
+static int64_t http_shared_key_chunk(HTTPSharedStream *sh, int64_t max_age)
+{
+    int64_t i, first = FFMAX(sh->nb_chunks - HTTP_SHARED_CHUNKS, 0);
+    int64_t newest, ret = -1;
+
+    if (!sh->nb_chunks)
+        return -1;
+    newest = sh->chunks[(sh->nb_chunks - 1) % HTTP_SHARED_CHUNKS].dts;
+    for (i = sh->nb_chunks - 1; i >= first; i--) {
+        HTTPSharedChunk *chunk = &sh->chunks[i % HTTP_SHARED_CHUNKS];
+        if (ret >= 0 && newest - chunk->dts > max_age)
+            break;
+        if (chunk->key)
+            ret = i;
+    }
+    return ret;
+}
+
+/* point the output buffer of c at the next chunk to send */
+static int http_shared_prepare(HTTPContext *c)
+{
+    HTTPSharedStream *sh = c->shared;
+    HTTPSharedChunk *chunk;
+
+    for (;;) {
+        if (c->shared_seq < 0) {
+            /* new clients start at a keyframe, prebuffer ms in the past */
+            c->shared_seq = http_shared_key_chunk(sh, c->stream->prebuffer * (int64_t)1000);
+        } else if (c->shared_seq < sh->nb_chunks - HTTP_SHARED_CHUNKS) {
+            /* the client is too slow, skip to the oldest keyframe kept */
+            int64_t seq = http_shared_key_chunk(sh, INT64_MAX);
+            if (seq >= 0) {
+                c->dropped         += seq - c->shared_seq;
+                c->stream->dropped += seq - c->shared_seq;
+            }
+            c->shared_seq = seq;
+        }
+        if (c->shared_seq >= 0 && c->shared_seq < sh->nb_chunks)
+            break;
+        if (http_shared_read(c->stream) < 0) {
+            /* must wait for more data from the feed */
+            c->state = HTTPSTATE_WAIT_FEED;
+            return 1; /* state changed */
+        }
+    }
+    chunk = &sh->chunks[c->shared_seq++ % HTTP_SHARED_CHUNKS];
+    c->buffer_ptr = chunk->data;
+    c->buffer_end = chunk->data + chunk->len;
+    return 0;
+}
+
+/* Send the output buffer of c along with the chunks which follow it in
+   the shared stream, straight from where they are stored, and move the
+   output buffer to where the data sent ends. */
+static int http_send_shared(HTTPContext *c)
+{
+    HTTPSharedStream *sh = c->shared;
+    HTTPSharedChunk *chunk;
+    struct iovec iov[HTTP_SHARED_IOV];
+    int64_t seq = c->shared_seq;
+    int i, n = 1, len, left;
+
+    iov[0].iov_base = c->buffer_ptr;
+    iov[0].iov_len  = c->buffer_end - c->buffer_ptr;
+    /* a client lagging behind the chunks kept resyncs in http_shared_prepare() */
+    if (seq >= 0 && seq >= sh->nb_chunks - HTTP_SHARED_CHUNKS) {
+        for (; seq < sh->nb_chunks && n < HTTP_SHARED_IOV; seq++, n++) {
+            chunk = &sh->chunks[seq % HTTP_SHARED_CHUNKS];
+            iov[n].iov_base = chunk->data;
+            iov[n].iov_len  = chunk->len;
+        }
+    }
+
+    len = writev(c->fd, iov, n);
+    if (len <= 0)
+        return len;
+
+    left = len - iov[0].iov_len;
+    if (left < 0) {
+        c->buffer_ptr += len;
+        return len;
+    }
+    c->buffer_ptr = c->buffer_end;
+    /* the buffer now points into the chunks: a copy made when one of them
+       was dropped is not needed any more */
+    if (left > 0)
+        av_freep(&c->pb_buffer);
+    for (i = 1; i < n && left > 0; i++) {
+        chunk = &sh->chunks[c->shared_seq++ % HTTP_SHARED_CHUNKS];
+        c->buffer_ptr = chunk->data + FFMIN(left, chunk->len);
+        c->buffer_end = chunk->data + chunk->len;
+        left -= chunk->len;
+    }
+    return len;
+}
 
 static int http_prepare_data(HTTPContext *c)
 {
@@ -2223,59 +3337,19 @@ static int http_prepare_data(HTTPContext *c)
     av_freep(&c->pb_buffer);
     switch(c->state) {
     case HTTPSTATE_SEND_DATA_HEADER:
-        memset(&c->fmt_ctx, 0, sizeof(c->fmt_ctx));
-        av_dict_set(&c->fmt_ctx.metadata, "author"   , c->stream->author   , 0);
-        av_dict_set(&c->fmt_ctx.metadata, "comment"  , c->stream->comment  , 0);
-        av_dict_set(&c->fmt_ctx.metadata, "copyright", c->stream->copyright, 0);
-        av_dict_set(&c->fmt_ctx.metadata, "title"    , c->stream->title    , 0);
-
-        c->fmt_ctx.streams = av_mallocz(sizeof(AVStream *) * c->stream->nb_streams);
-
-        for(i=0;i<c->stream->nb_streams;i++) {
-            AVStream *src;
-            c->fmt_ctx.streams[i] = av_mallocz(sizeof(AVStream));
-            /* if file or feed, then just take streams from FFStream struct */
-            if (!c->stream->feed ||
-                c->stream->feed == c->stream)
-                src = c->stream->streams[i];
-            else
-                src = c->stream->feed->streams[c->stream->feed_streams[i]];
-
-            *(c->fmt_ctx.streams[i]) = *src;
-            c->fmt_ctx.streams[i]->priv_data = 0;
-            c->fmt_ctx.streams[i]->codec->frame_number = 0; /* XXX: should be done in
-                                           AVStream, not in codec */
-        }
-        /* set output format parameters */
-        c->fmt_ctx.oformat = c->stream->fmt;
-        c->fmt_ctx.nb_streams = c->stream->nb_streams;
-
         c->got_key_frame = 0;
 
-        /* prepare header and save header data in a stream */
-        if (avio_open_dyn_buf(&c->fmt_ctx.pb) < 0) {
-            /* XXX: potential leak */
-            return -1;
-        }
-        c->fmt_ctx.pb->seekable = 0;
-
-        /*
-         * HACK to avoid mpeg ps muxer to spit many underflow errors
-         * Default value from FFmpeg
-         * Try to set it use configuration option
-         */
-        c->fmt_ctx.preload   = (int)(0.5*AV_TIME_BASE);
-        c->fmt_ctx.max_delay = (int)(0.7*AV_TIME_BASE);
-
-        if (avformat_write_header(&c->fmt_ctx, NULL) < 0) {
-            http_log("Error writing output header\n");
-            return -1;
+        /* live clients share the reading and muxing of the feed */
+        if (c->can_share && !c->is_packetized) {
+            if (http_shared_join(c) < 0)
+                return -1;
+        } else {
+            len = open_output_stream(c->stream, &c->fmt_ctx, &c->pb_buffer);
+            if (len < 0)
+                return -1;
+            c->buffer_ptr = c->pb_buffer;
+            c->buffer_end = c->pb_buffer + len;
         }
-        av_dict_free(&c->fmt_ctx.metadata);
-
-        len = avio_close_dyn_buf(c->fmt_ctx.pb, &c->pb_buffer);
-        c->buffer_ptr = c->pb_buffer;
-        c->buffer_end = c->pb_buffer + len;
 
         c->state = HTTPSTATE_SEND_DATA;
         c->last_packet_sent = 0;
@@ -2283,7 +3357,7 @@ static int http_prepare_data(HTTPContext *c)
     case HTTPSTATE_SEND_DATA:
         /* find a new packet */
         /* read a packet from the input stream */
-        if (c->stream->feed)
+        if (c->stream->feed && !c->shared)
             ffm_set_write_index(c->fmt_in,
                                 c->stream->feed->feed_write_index,
                                 c->stream->feed->feed_size);
@@ -2292,6 +3366,8 @@ static int http_prepare_data(HTTPContext *c)
             c->stream->max_time + c->start_time - cur_time < 0)
             /* We have timed out */
             c->state = HTTPSTATE_SEND_DATA_TRAILER;
+        else if (c->shared)
+            return http_shared_prepare(c);
         else {
             AVPacket pkt;
         redo:
@@ -2401,9 +3477,12 @@ static int http_prepare_data(HTTPContext *c)
                     if (pkt.pts != AV_NOPTS_VALUE)
                         pkt.pts = av_rescale_q(pkt.pts, ist->time_base, ost->time_base);
                     pkt.duration = av_rescale_q(pkt.duration, ist->time_base, ost->time_base);
-                    if (av_write_frame(ctx, &pkt) < 0) {
-                        http_log("Error writing frame to output\n");
-                        c->state = HTTPSTATE_SEND_DATA_TRAILER;
+                    if (!c->is_packetized ||
+                        rtp_write_shared(c, ctx, &pkt, ctx->pb->max_packet_size) < 0) {
+                        if (av_write_frame(ctx, &pkt) < 0) {
+                            http_log("Error writing frame to output\n");
+                            c->state = HTTPSTATE_SEND_DATA_TRAILER;
+                        }
                     }
 
                     len = avio_close_dyn_buf(ctx->pb, &c->pb_buffer);
@@ -2424,7 +3503,7 @@ static int http_prepare_data(HTTPContext *c)
     default:
     case HTTPSTATE_SEND_DATA_TRAILER:
         /* last packet test ? */
-        if (c->last_packet_sent || c->is_packetized)
+        if (c->last_packet_sent || c->is_packetized || c->shared)
             return -1;
         ctx = &c->fmt_ctx;
         /* prepare header */
@@ -2544,7 +3623,10 @@ static int http_send_data(HTTPContext *c)
                 }
             } else {
                 /* TCP data output */
-                len = send(c->fd, c->buffer_ptr, c->buffer_end - c->buffer_ptr, 0);
+                if (c->shared)
+                    len = http_send_shared(c);
+                else
+                    len = send(c->fd, c->buffer_ptr, c->buffer_end - c->buffer_ptr, 0);
                 if (len < 0) {
                     if (ff_neterrno() != AVERROR(EAGAIN) &&
                         ff_neterrno() != AVERROR(EINTR))
@@ -2552,7 +3634,7 @@ static int http_send_data(HTTPContext *c)
                         return -1;
                     else
                         return 0;
-                } else
+                } else if (!c->shared)
                     c->buffer_ptr += len;
 
                 c->data_count += len;
@@ -2568,7 +3650,7 @@ static int http_send_data(HTTPContext *c)
 
 static int http_start_receive_data(HTTPContext *c)
 {
-    int fd;
+    FFStream *feed = c->stream;
 
     if (c->stream->feed_opened)
         return -1;
@@ -2577,33 +3659,21 @@ static int http_start_receive_data(HTTPContext *c)
     if (c->stream->readonly)
         return -1;
 
-    /* open feed */
-    fd = open(c->stream->feed_filename, O_RDWR);
-    if (fd < 0) {
-        http_log("Error opening feeder file: %s\n", strerror(errno));
+    if ((c->feed_fd = feed_store_open(feed)) < 0)
         return -1;
-    }
-    c->feed_fd = fd;
 
-    if (c->stream->truncate) {
-        /* truncate feed file */
-        ffm_write_write_index(c->feed_fd, FFM_PACKET_SIZE);
-        ftruncate(c->feed_fd, FFM_PACKET_SIZE);
-        http_log("Truncating feed file '%s'\n", c->stream->feed_filename);
-    } else {
-        if ((c->stream->feed_write_index = ffm_read_write_index(fd)) < 0) {
-            http_log("Error reading write index from feed file: %s\n", strerror(errno));
+    /* the whole packet is received before being stored */
+    if (c->buffer_size < feed->feed_packet_size) {
+        uint8_t *buffer = av_realloc(c->buffer, feed->feed_packet_size);
+        if (!buffer)
             return -1;
-        }
+        c->buffer      = buffer;
+        c->buffer_size = feed->feed_packet_size;
     }
 
-    c->stream->feed_write_index = FFMAX(ffm_read_write_index(fd), FFM_PACKET_SIZE);
-    c->stream->feed_size = lseek(fd, 0, SEEK_END);
-    lseek(fd, 0, SEEK_SET);
-
     /* init buffer input */
     c->buffer_ptr = c->buffer;
-    c->buffer_end = c->buffer + FFM_PACKET_SIZE;
+    c->buffer_end = c->buffer + feed->feed_packet_size;
     c->stream->feed_opened = 1;
     c->chunked_encoding = !!av_stristr(c->buffer, "Transfer-Encoding: chunked");
     return 0;
@@ -2662,7 +3732,16 @@ static int http_receive_data(HTTPContext *c)
         }
     }
 
-    if (c->buffer_ptr - c->buffer >= 2 && c->data_count > FFM_PACKET_SIZE) {
+    /* the header carries the packet size the feeder writes with */
+    if (c->buffer_ptr - c->buffer >= 8 && c->data_count <= c->stream->feed_packet_size &&
+        AV_RB32(c->buffer + 4) != c->stream->feed_packet_size) {
+        http_log("Feed '%s' packet size does not match registered feed (%d != %d)\n",
+                 c->stream->feed_filename, AV_RB32(c->buffer + 4),
+                 c->stream->feed_packet_size);
+        goto fail;
+    }
+
+    if (c->buffer_ptr - c->buffer >= 2 && c->data_count > c->stream->feed_packet_size) {
         if (c->buffer[0] != 'f' ||
             c->buffer[1] != 'm') {
             http_log("Feed stream has become desynchronized -- disconnecting\n");
@@ -2674,30 +3753,13 @@ static int http_receive_data(HTTPContext *c)
         FFStream *feed = c->stream;
         /* a packet has been received : write it in the store, except
            if header */
-        if (c->data_count > FFM_PACKET_SIZE) {
+        if (c->data_count > feed->feed_packet_size) {
 
-            //            printf("writing pos=0x%"PRIx64" size=0x%"PRIx64"\n", feed->feed_write_index, feed->feed_size);
-            /* XXX: use llseek or url_seek */
-            lseek(c->feed_fd, feed->feed_write_index, SEEK_SET);
-            if (write(c->feed_fd, c->buffer, FFM_PACKET_SIZE) < 0) {
-                http_log("Error writing to feed file: %s\n", strerror(errno));
+            if (feed_store_write(feed, c->feed_fd, &feed->feed_write_index,
+                                 &feed->feed_size, c->buffer) < 0)
                 goto fail;
-            }
-
-            feed->feed_write_index += FFM_PACKET_SIZE;
-            /* update file size */
-            if (feed->feed_write_index > c->stream->feed_size)
-                feed->feed_size = feed->feed_write_index;
-
-            /* handle wrap around if max file size reached */
-            if (c->stream->feed_max_size && feed->feed_write_index >= c->stream->feed_max_size)
-                feed->feed_write_index = FFM_PACKET_SIZE;
-
-            /* write index */
-            if (ffm_write_write_index(c->feed_fd, feed->feed_write_index) < 0) {
-                http_log("Error writing index to feed file: %s\n", strerror(errno));
-                goto fail;
-            }
+            feed->bytes_received += feed->feed_packet_size;
+            update_datarate(&feed->recv_datarate, feed->bytes_received);
 
             /* wake up any waiting connections */
             for(c1 = first_http_ctx; c1 != NULL; c1 = c1->next) {
@@ -2753,8 +3815,7 @@ static int http_receive_data(HTTPContext *c)
 
     return 0;
  fail:
-    c->stream->feed_opened = 0;
-    close(c->feed_fd);
+    close_feed(c);
     /* wake up any waiting connections to stop waiting for feed */
     for(c1 = first_http_ctx; c1 != NULL; c1 = c1->next) {
         if (c1->state == HTTPSTATE_WAIT_FEED &&
@@ -2764,6 +3825,587 @@ static int http_receive_data(HTTPContext *c)
     return -1;
 }
 
+/********************************************************************/
+/* in-process feed sources */
+
+#if HAVE_PTHREADS && CONFIG_AVFILTER
+
+/* one stream of a feed, encoded from a stream of the source */
+typedef struct SourceOutput {
+    AVCodecContext *enc;        /* opened copy of the codec of the feed stream */
+    int input;                  /* index of the source stream it is made from */
+    AVFilterGraph *graph;       /* video scaling and pixel format conversion */
+    AVFilterContext *buffer_src, *buffer_sink;
+    ReSampleContext *resample;  /* audio conversion, if needed */
+    AVFifoBuffer *fifo;         /* audio samples waiting for a whole frame */
+    int64_t next_pts;           /* in the time base of the encoder */
+} SourceOutput;
+
+/* A feed decoded, filtered and encoded from its Source by a thread of
+   ffserver, instead of a Launch child posting it over HTTP. The thread
+   stores the FFM packets itself and only wakes up the main loop, which
+   follows the feed like one received by another worker. */
+typedef struct FeedSource {
+    FFStream *feed;
+    pthread_t thread;
+    volatile int done;          /* the thread has finished */
+    time_t start;
+    int fd;                     /* see feed_store_open() */
+    int64_t write_index;        /* of the feed store, owned by the thread */
+    int64_t size;
+    int header_done;            /* the muxer has written the FFM header */
+    AVFormatContext *ic;
+    AVFormatContext *oc;        /* FFM muxer writing to the feed store */
+    SourceOutput outputs[MAX_STREAMS];
+    int64_t start_dts;          /* of the source, in AV_TIME_BASE units */
+    int64_t start_clock;        /* av_gettime() when start_dts was read */
+    uint8_t *samples, *resampled, *frame, *bit_buffer;
+    unsigned int samples_size, resampled_size, frame_size;
+    int bit_buffer_size;
+} FeedSource;
+
+static int ffserver_lockmgr(void **mutex, enum AVLockOp op)
+{
+    switch (op) {
+    case AV_LOCK_CREATE:
+        *mutex = av_malloc(sizeof(pthread_mutex_t));
+        if (!*mutex || pthread_mutex_init(*mutex, NULL)) {
+            av_freep(mutex);
+            return 1;
+        }
+        return 0;
+    case AV_LOCK_OBTAIN:
+        return !!pthread_mutex_lock(*mutex);
+    case AV_LOCK_RELEASE:
+        return !!pthread_mutex_unlock(*mutex);
+    case AV_LOCK_DESTROY:
+        pthread_mutex_destroy(*mutex);
+        av_freep(mutex);
+        return 0;
+    }
+    return 1;
+}
+
+static void source_wakeup(void)
+{
+    /* a full pipe already wakes up the main loop */
+    if (write(source_pipe[1], "", 1) < 0 && errno != EAGAIN)
+        http_log("Cannot wake up the main loop: %s\n", strerror(errno));
+}
+
+/* the output of the FFM muxer, one feed packet at a time */
+static int feed_source_write(void *opaque, uint8_t *buf, int size)
+{
+    FeedSource *src = opaque;
+    FFStream *feed = src->feed;
+
+    /* the feed store already starts with the header */
+    if (!src->header_done)
+        return size;
+    if (size != feed->feed_packet_size ||
+        feed_store_write(feed, src->fd, &src->write_index, &src->size, buf) < 0)
+        return -1;
+    source_wakeup();
+    return size;
+}
+
+static int source_open_encoder(SourceOutput *out, AVCodecContext *codec_ctx)
+{
+    AVCodec *codec = avcodec_find_encoder(codec_ctx->codec_id);
+    AVCodecContext *enc;
+
+    if (!codec || !(out->enc = enc = avcodec_alloc_context()) ||
+        avcodec_copy_context(enc, codec_ctx) < 0)
+        return -1;
+
+    if (enc->codec_type == AVMEDIA_TYPE_VIDEO) {
+        const enum PixelFormat *p = codec->pix_fmts;
+        while (p && *p != PIX_FMT_NONE && *p != enc->pix_fmt)
+            p++;
+        if (p && *p == PIX_FMT_NONE)
+            enc->pix_fmt = codec->pix_fmts[0];
+        else if (enc->pix_fmt == PIX_FMT_NONE)
+            enc->pix_fmt = PIX_FMT_YUV420P;
+    } else {
+        const enum AVSampleFormat *p = codec->sample_fmts;
+        while (p && *p != AV_SAMPLE_FMT_NONE && *p != enc->sample_fmt)
+            p++;
+        if (p && *p == AV_SAMPLE_FMT_NONE)
+            enc->sample_fmt = codec->sample_fmts[0];
+        else if (enc->sample_fmt == AV_SAMPLE_FMT_NONE)
+            enc->sample_fmt = AV_SAMPLE_FMT_S16;
+    }
+
+    if (avcodec_open(enc, codec) < 0)
+        return -1;
+    if (enc->codec_type == AVMEDIA_TYPE_AUDIO && enc->frame_size <= 1) {
+        http_log("Audio codec '%s' cannot be used by a Source\n", codec->name);
+        return -1;
+    }
+    return 0;
+}
+
+/* scale and convert the decoded frames for the encoder */
+static int source_open_filters(SourceOutput *out, AVStream *st)
+{
+    AVCodecContext *dec = st->codec, *enc = out->enc;
+    enum PixelFormat pix_fmts[] = { enc->pix_fmt, PIX_FMT_NONE };
+    AVRational sar = st->sample_aspect_ratio.num ? st->sample_aspect_ratio :
+                                                   dec->sample_aspect_ratio;
+    AVFilterContext *filter, *last_filter;
+    char args[256];
+
+    if (!(out->graph = avfilter_graph_alloc()))
+        return AVERROR(ENOMEM);
+
+    snprintf(args, sizeof(args), "%d:%d:%d:%d:%d:%d:%d", dec->width, dec->height,
+             dec->pix_fmt, 1, AV_TIME_BASE, sar.num, sar.den);
+    if (avfilter_graph_create_filter(&out->buffer_src, avfilter_get_by_name("buffer"),
+                                     "src", args, NULL, out->graph) < 0 ||
+        avfilter_graph_create_filter(&out->buffer_sink, avfilter_get_by_name("buffersink"),
+                                     "out", NULL, pix_fmts, out->graph) < 0)
+        return -1;
+    last_filter = out->buffer_src;
+
+    if (enc->width != dec->width || enc->height != dec->height) {
+        snprintf(args, sizeof(args), "%d:%d", enc->width, enc->height);
+        if (avfilter_graph_create_filter(&filter, avfilter_get_by_name("scale"),
+                                         NULL, args, NULL, out->graph) < 0 ||
+            avfilter_link(last_filter, 0, filter, 0) < 0)
+            return -1;
+        last_filter = filter;
+    }
+
+    if (avfilter_link(last_filter, 0, out->buffer_sink, 0) < 0)
+        return -1;
+    return avfilter_graph_config(out->graph, NULL);
+}
+
+static int source_write_packet(FeedSource *src, int i, int size, int64_t pts,
+                               AVRational time_base, int key)
+{
+    AVPacket pkt;
+
+    av_init_packet(&pkt);
+    pkt.stream_index = i;
+    pkt.data = src->bit_buffer;
+    pkt.size = size;
+    if (pts != AV_NOPTS_VALUE)
+        pkt.pts = av_rescale_q(pts, time_base, src->oc->streams[i]->time_base);
+    if (key)
+        pkt.flags |= AV_PKT_FLAG_KEY;
+    return av_interleaved_write_frame(src->oc, &pkt);
+}
+
+static int source_encode_video(FeedSource *src, int i, AVFilterBufferRef *picref)
+{
+    SourceOutput *out = &src->outputs[i];
+    AVCodecContext *enc = out->enc;
+    AVFrame picture;
+    int64_t pts;
+    int size;
+
+    /* the frames come at the rate of the source: drop the extra ones */
+    pts = av_rescale_q(picref->pts, out->buffer_sink->inputs[0]->time_base,
+                       enc->time_base);
+    if (pts < out->next_pts)
+        return 0;
+    out->next_pts = pts + 1;
+
+    avcodec_get_frame_defaults(&picture);
+    avfilter_fill_frame_from_video_buffer_ref(&picture, picref);
+    picture.pts = pts;
+
+    size = avcodec_encode_video(enc, src->bit_buffer, src->bit_buffer_size, &picture);
+    if (size <= 0)
+        return size;
+    return source_write_packet(src, i, size, enc->coded_frame->pts, enc->time_base,
+                               enc->coded_frame->key_frame);
+}
+
+static int source_decode_video(FeedSource *src, AVStream *st, AVPacket *pkt)
+{
+    AVFilterBufferRef *picref;
+    AVFrame frame;
+    int i, got_picture, ret;
+
+    avcodec_get_frame_defaults(&frame);
+    if (avcodec_decode_video2(st->codec, &frame, &got_picture, pkt) < 0 ||
+        !got_picture || frame.best_effort_timestamp == AV_NOPTS_VALUE)
+        return 0;
+    frame.pts = av_rescale_q(frame.best_effort_timestamp, st->time_base,
+                             AV_TIME_BASE_Q) - src->start_dts;
+    if (!frame.sample_aspect_ratio.num)
+        frame.sample_aspect_ratio = st->sample_aspect_ratio;
+
+    for (i = 0; i < src->feed->nb_streams; i++) {
+        SourceOutput *out = &src->outputs[i];
+
+        if (out->input != st->index)
+            continue;
+        if ((ret = av_vsrc_buffer_add_frame(out->buffer_src, &frame, 0)) < 0)
+            return ret;
+        while (avfilter_poll_frame(out->buffer_sink->inputs[0]) > 0) {
+            if ((ret = av_vsink_buffer_get_video_buffer_ref(out->buffer_sink, &picref, 0)) < 0)
+                return ret;
+            ret = source_encode_video(src, i, picref);
+            avfilter_unref_buffer(picref);
+            if (ret < 0)
+                return ret;
+        }
+    }
+    return 0;
+}
+
+static int source_encode_audio(FeedSource *src, int i, AVCodecContext *dec,
+                               uint8_t *buf, int size, int64_t dts)
+{
+    SourceOutput *out = &src->outputs[i];
+    AVCodecContext *enc = out->enc;
+    AVRational time_base = { 1, enc->sample_rate };
+    int isize = av_get_bytes_per_sample(dec->sample_fmt);
+    int osize = av_get_bytes_per_sample(enc->sample_fmt);
+    int frame_bytes = enc->frame_size * enc->channels * osize;
+    int nb_samples, ret;
+
+    if (!out->fifo) {
+        if (!(out->fifo = av_fifo_alloc(frame_bytes)))
+            return AVERROR(ENOMEM);
+        if (dec->channels != enc->channels || dec->sample_rate != enc->sample_rate ||
+            dec->sample_fmt != enc->sample_fmt) {
+            out->resample = av_audio_resample_init(enc->channels, dec->channels,
+                                                   enc->sample_rate, dec->sample_rate,
+                                                   enc->sample_fmt, dec->sample_fmt,
+                                                   16, 10, 0, 0.8);
+            if (!out->resample)
+                return -1;
+        }
+        out->next_pts = av_rescale_q(dts, AV_TIME_BASE_Q, time_base);
+    }
+
+    if (out->resample) {
+        nb_samples = size / (dec->channels * isize);
+        av_fast_malloc(&src->resampled, &src->resampled_size,
+                       ((int64_t)nb_samples * enc->sample_rate / dec->sample_rate + 256) *
+                       enc->channels * osize);
+        if (!src->resampled)
+            return AVERROR(ENOMEM);
+        nb_samples = audio_resample(out->resample, (short *)src->resampled,
+                                    (short *)buf, nb_samples);
+        buf  = src->resampled;
+        size = nb_samples * enc->channels * osize;
+    }
+
+    if (av_fifo_realloc2(out->fifo, av_fifo_size(out->fifo) + size) < 0)
+        return AVERROR(ENOMEM);
+    av_fifo_generic_write(out->fifo, buf, size, NULL);
+
+    av_fast_malloc(&src->frame, &src->frame_size, frame_bytes);
+    if (!src->frame)
+        return AVERROR(ENOMEM);
+    while (av_fifo_size(out->fifo) >= frame_bytes) {
+        av_fifo_generic_read(out->fifo, src->frame, frame_bytes, NULL);
+        size = avcodec_encode_audio(enc, src->bit_buffer, src->bit_buffer_size,
+                                    (short *)src->frame);
+        if (size < 0)
+            return size;
+        if (size > 0 &&
+            (ret = source_write_packet(src, i, size, out->next_pts, time_base, 1)) < 0)
+            return ret;
+        out->next_pts += enc->frame_size;
+    }
+    return 0;
+}
+
+static int source_decode_audio(FeedSource *src, AVStream *st, AVPacket *pkt)
+{
+    AVPacket avpkt = *pkt;
+    int64_t dts = 0;
+    int i, len, size, ret;
+
+    if (pkt->dts != AV_NOPTS_VALUE)
+        dts = av_rescale_q(pkt->dts, st->time_base, AV_TIME_BASE_Q) - src->start_dts;
+
+    while (avpkt.size > 0) {
+        av_fast_malloc(&src->samples, &src->samples_size, AVCODEC_MAX_AUDIO_FRAME_SIZE);
+        if (!src->samples)
+            return AVERROR(ENOMEM);
+        size = src->samples_size;
+        if ((len = avcodec_decode_audio3(st->codec, (int16_t *)src->samples, &size, &avpkt)) < 0)
+            return 0;
+        avpkt.data += len;
+        avpkt.size -= len;
+        if (size <= 0)
+            continue;
+        for (i = 0; i < src->feed->nb_streams; i++)
+            if (src->outputs[i].input == st->index &&
+                (ret = source_encode_audio(src, i, st->codec, src->samples, size, dts)) < 0)
+                return ret;
+    }
+    return 0;
+}
+
+static void *feed_source_thread(void *opaque)
+{
+    FeedSource *src = opaque;
+    FFStream *feed = src->feed;
+    AVDictionary *opts = NULL;
+    AVPacket pkt;
+    int i, ret;
+
+    av_dict_copy(&opts, feed->source_opts, 0);
+    ret = avformat_open_input(&src->ic, feed->source_url, feed->source_ifmt, &opts);
+    av_dict_free(&opts);
+    if (ret < 0 || av_find_stream_info(src->ic) < 0) {
+        http_log("Could not open source '%s' of feed '%s'\n",
+                 feed->source_url, feed->filename);
+        goto end;
+    }
+
+    /* the streams of the feed are made from the best source stream of
+       their type */
+    for (i = 0; i < feed->nb_streams; i++) {
+        SourceOutput *out = &src->outputs[i];
+        AVStream *st;
+
+        out->input = av_find_best_stream(src->ic, out->enc->codec_type, -1, -1, NULL, 0);
+        if (out->input < 0) {
+            http_log("Source '%s' has no %s stream for feed '%s'\n", feed->source_url,
+                     out->enc->codec_type == AVMEDIA_TYPE_VIDEO ? "video" : "audio",
+                     feed->filename);
+            goto end;
+        }
+        st = src->ic->streams[out->input];
+        if (!st->codec->codec &&
+            avcodec_open(st->codec, avcodec_find_decoder(st->codec->codec_id)) < 0) {
+            http_log("Could not open the decoder of stream %d of source '%s'\n",
+                     out->input, feed->source_url);
+            goto end;
+        }
+        if (st->codec->codec_type == AVMEDIA_TYPE_VIDEO &&
+            source_open_filters(out, st) < 0) {
+            http_log("Could not convert the video of source '%s'\n", feed->source_url);
+            goto end;
+        }
+    }
+
+    src->start_dts = AV_NOPTS_VALUE;
+    while (av_read_frame(src->ic, &pkt) >= 0) {
+        AVStream *st = src->ic->streams[pkt.stream_index];
+
+        /* the source is read at its own pace, like ffmpeg -re does */
+        if (pkt.dts != AV_NOPTS_VALUE) {
+            int64_t dts = av_rescale_q(pkt.dts, st->time_base, AV_TIME_BASE_Q);
+            int64_t delay;
+
+            if (src->start_dts == AV_NOPTS_VALUE) {
+                src->start_dts   = dts;
+                src->start_clock = av_gettime();
+                src->oc->timestamp = src->start_clock;
+            }
+            delay = src->start_clock + dts - src->start_dts - av_gettime();
+            if (delay > 0)
+                usleep(FFMIN(delay, 1000000));
+        }
+        if (src->start_dts == AV_NOPTS_VALUE) {
+            ret = 0;
+        } else if (st->codec->codec_type == AVMEDIA_TYPE_VIDEO) {
+            ret = source_decode_video(src, st, &pkt);
+        } else if (st->codec->codec_type == AVMEDIA_TYPE_AUDIO) {
+            ret = source_decode_audio(src, st, &pkt);
+        } else
+            ret = 0;
+        av_free_packet(&pkt);
+        if (ret < 0) {
+            http_log("Error while transcoding source '%s'\n", feed->source_url);
+            break;
+        }
+    }
+    av_write_trailer(src->oc);
+
+ end:
+    src->done = 1;
+    source_wakeup();
+    return NULL;
+}
+
+static void feed_source_free(FeedSource *src)
+{
+    int i;
+
+    for (i = 0; i < MAX_STREAMS; i++) {
+        SourceOutput *out = &src->outputs[i];
+
+        if (out->enc) {
+            avcodec_close(out->enc);
+            av_freep(&out->enc->rc_eq);
+            av_freep(&out->enc->extradata);
+            av_freep(&out->enc);
+        }
+        avfilter_graph_free(&out->graph);
+        if (out->resample)
+            audio_resample_close(out->resample);
+        av_fifo_free(out->fifo);
+    }
+    if (src->ic) {
+        for (i = 0; i < src->ic->nb_streams; i++)
+            if (src->ic->streams[i]->codec->codec)
+                avcodec_close(src->ic->streams[i]->codec);
+        av_close_input_file(src->ic);
+    }
+    if (src->oc) {
+        if (src->oc->pb) {
+            av_free(src->oc->pb->buffer);
+            av_free(src->oc->pb);
+        }
+        for (i = 0; i < src->oc->nb_streams; i++)
+            av_freep(&src->oc->streams[i]->codec->rc_eq);
+        avformat_free_context(src->oc);
+    }
+    av_free(src->samples);
+    av_free(src->resampled);
+    av_free(src->frame);
+    av_free(src->bit_buffer);
+    if (src->fd >= 0)
+        feed_store_close(src->feed, src->fd);
+    av_free(src);
+}
+
+/* open the encoders and the muxer, then let a thread do the rest */
+static int feed_source_start(FFStream *feed)
+{
+    FeedSource *src = av_mallocz(sizeof(*src));
+    uint8_t *buffer;
+    int i;
+
+    if (!src)
+        return -1;
+    src->feed = feed;
+    if ((src->fd = feed_store_open(feed)) < 0)
+        goto fail;
+    src->write_index = feed->feed_write_index;
+    src->size        = feed->feed_size;
+
+    if (!(src->oc = avformat_alloc_context()))
+        goto fail;
+    src->oc->oformat     = feed->fmt;
+    src->oc->packet_size = feed->feed_packet_size;
+    src->bit_buffer_size = 256 * 1024;
+    for (i = 0; i < feed->nb_streams; i++) {
+        AVCodecContext *codec = feed->streams[i]->codec;
+        SourceOutput *out = &src->outputs[i];
+        AVStream *st;
+
+        if (source_open_encoder(out, codec) < 0) {
+            http_log("Could not open the encoder of stream %d of feed '%s'\n",
+                     i, feed->filename);
+            goto fail;
+        }
+        if (!(st = av_new_stream(src->oc, i)) ||
+            avcodec_copy_context(st->codec, out->enc) < 0)
+            goto fail;
+        /* the streams are sent with the global headers of the encoders */
+        if (out->enc->extradata_size && !codec->extradata_size) {
+            codec->extradata = av_mallocz(out->enc->extradata_size +
+                                          FF_INPUT_BUFFER_PADDING_SIZE);
+            if (!codec->extradata)
+                goto fail;
+            memcpy(codec->extradata, out->enc->extradata, out->enc->extradata_size);
+            codec->extradata_size = out->enc->extradata_size;
+        }
+        if (codec->codec_type == AVMEDIA_TYPE_VIDEO)
+            src->bit_buffer_size = FFMAX(src->bit_buffer_size,
+                                         6 * codec->width * codec->height + 200);
+    }
+    if (!(src->bit_buffer = av_malloc(src->bit_buffer_size)))
+        goto fail;
+
+    if (!(buffer = av_malloc(feed->feed_packet_size)))
+        goto fail;
+    src->oc->pb = avio_alloc_context(buffer, feed->feed_packet_size, 1, src,
+                                     NULL, feed_source_write, NULL);
+    if (!src->oc->pb) {
+        av_free(buffer);
+        goto fail;
+    }
+    src->oc->pb->seekable = 0;
+    if (avformat_write_header(src->oc, NULL) < 0)
+        goto fail;
+    src->header_done = 1;
+
+    src->start = time(NULL);
+    if (pthread_create(&src->thread, NULL, feed_source_thread, src)) {
+        http_log("Unable to create the thread of feed '%s'\n", feed->filename);
+        goto fail;
+    }
+    feed->source = src;
+    return 0;
+ fail:
+    feed_source_free(src);
+    return -1;
+}
+
+static void start_sources(void)
+{
+    FFStream *feed;
+    int i;
+
+    if (no_launch)
+        return;
+    for (feed = first_feed; feed; feed = feed->next_feed)
+        if (feed->source_url[0])
+            break;
+    if (!feed)
+        return;
+
+    /* libavcodec is now used by several threads */
+    if (av_lockmgr_register(ffserver_lockmgr) < 0 || pipe(source_pipe) < 0) {
+        http_log("Cannot start the Source threads\n");
+        return;
+    }
+    for (i = 0; i < 2; i++) {
+        fcntl(source_pipe[i], F_SETFL, O_NONBLOCK);
+        fcntl(source_pipe[i], F_SETFD, FD_CLOEXEC);
+    }
+    avfilter_register_all();
+
+    for (feed = first_feed; feed; feed = feed->next_feed)
+        if (feed->source_url[0] && feed_source_start(feed) < 0)
+            http_log("Could not start the Source of feed '%s'\n", feed->filename);
+}
+
+/* restart the sources which stopped, unless they did not last long, as
+   it is done for the Launch children */
+static void check_sources(void)
+{
+    FFStream *feed;
+    int uptime;
+
+    for (feed = first_feed; feed; feed = feed->next_feed) {
+        if (!feed->source || !feed->source->done)
+            continue;
+        pthread_join(feed->source->thread, NULL);
+        uptime = time(NULL) - feed->source->start;
+        http_log("%s: Source '%s' stopped after %d seconds\n",
+                 feed->filename, feed->source_url, uptime);
+        feed_source_free(feed->source);
+        feed->source = NULL;
+
+        if (uptime < 30)
+            /* Turn off any more restarts */
+            feed->source_url[0] = 0;
+        else if (feed_source_start(feed) < 0)
+            http_log("Could not start the Source of feed '%s'\n", feed->filename);
+    }
+}
+
+#else
+
+static void start_sources(void) {}
+static void check_sources(void) {}
+
+#endif /* HAVE_PTHREADS && CONFIG_AVFILTER */
+
 /********************************************************************/
 /* RTSP handling */
 
@@ -3316,7 +4958,6 @@ static HTTPContext *rtp_new_connection(struct sockaddr_in *from_addr,
         goto fail;
 
     c->fd = -1;
-    c->poll_entry = NULL;
     c->from_addr = *from_addr;
     c->buffer_size = IOBUFFER_INIT_SIZE;
     c->buffer = av_malloc(c->buffer_size);
@@ -3364,21 +5005,15 @@ static HTTPContext *rtp_new_connection(struct sockaddr_in *from_addr,
 /* add a new RTP stream in an RTP connection (used in RTSP SETUP
    command). If RTP/TCP protocol is used, TCP connection 'rtsp_c' is
    used. */
-static int rtp_new_av_stream(HTTPContext *c,
-                             int stream_index, struct sockaddr_in *dest_addr,
-                             HTTPContext *rtsp_c)
+/* allocate an RTP muxer for one stream of an FFStream */
+static AVFormatContext *rtp_alloc_muxer(FFStream *stream, int stream_index)
 {
     AVFormatContext *ctx;
     AVStream *st;
-    char *ipaddr;
-    URLContext *h = NULL;
-    uint8_t *dummy_buf;
-    int max_packet_size;
 
-    /* now we can open the relevant output stream */
     ctx = avformat_alloc_context();
     if (!ctx)
-        return -1;
+        return NULL;
     ctx->oformat = av_guess_format("rtp", NULL, NULL);
 
     st = av_mallocz(sizeof(AVStream));
@@ -3387,17 +5022,38 @@ static int rtp_new_av_stream(HTTPContext *c,
     ctx->nb_streams = 1;
     ctx->streams = av_mallocz(sizeof(AVStream *) * ctx->nb_streams);
     if (!ctx->streams)
-      goto fail;
+        goto fail;
     ctx->streams[0] = st;
 
-    if (!c->stream->feed ||
-        c->stream->feed == c->stream)
-        memcpy(st, c->stream->streams[stream_index], sizeof(AVStream));
+    if (!stream->feed ||
+        stream->feed == stream)
+        memcpy(st, stream->streams[stream_index], sizeof(AVStream));
     else
         memcpy(st,
-               c->stream->feed->streams[c->stream->feed_streams[stream_index]],
+               stream->feed->streams[stream->feed_streams[stream_index]],
                sizeof(AVStream));
     st->priv_data = NULL;
+    return ctx;
+ fail:
+    av_free(st);
+    av_free(ctx);
+    return NULL;
+}
+
+static int rtp_new_av_stream(HTTPContext *c,
+                             int stream_index, struct sockaddr_in *dest_addr,
+                             HTTPContext *rtsp_c)
+{
+    AVFormatContext *ctx;
+    char *ipaddr;
+    URLContext *h = NULL;
+    uint8_t *dummy_buf;
+    int max_packet_size;
+
+    /* now we can open the relevant output stream */
+    ctx = rtp_alloc_muxer(c->stream, stream_index);
+    if (!ctx)
+        return -1;
 
     /* build destination RTP address */
     ipaddr = inet_ntoa(dest_addr->sin_addr);
@@ -3458,6 +5114,100 @@ static int rtp_new_av_stream(HTTPContext *c,
     return 0;
 }
 
+/* packetizers which keep no state from one frame to the next, so that
+   their output for a frame does not depend on the frames sent before */
+static int rtp_codec_is_stateless(enum CodecID codec_id)
+{
+    switch (codec_id) {
+    case CODEC_ID_MPEG1VIDEO:
+    case CODEC_ID_MPEG2VIDEO:
+    case CODEC_ID_H263:
+    case CODEC_ID_H263P:
+    case CODEC_ID_H264:
+    case CODEC_ID_VP8:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* Send pkt on the RTP session c using the packets of the packetizer
+   shared by all the sessions of the stream, so that a frame is packetized
+   only once however many clients receive it. Return < 0 if the session
+   has to packetize the frame itself. */
+static int rtp_write_shared(HTTPContext *c, AVFormatContext *ctx,
+                            AVPacket *pkt, int max_packet_size)
+{
+    RTPSharedStream *sh = c->stream->rtp_shared[c->packet_stream_index];
+    RTPSharedFrame *frame = NULL;
+    AVPacket pkt1;
+    uint8_t *dummy_buf;
+    int i, ret;
+
+    if (!rtp_codec_is_stateless(ctx->streams[0]->codec->codec_id) ||
+        pkt->dts == AV_NOPTS_VALUE)
+        return -1;
+
+    if (!sh) {
+        sh = av_mallocz(sizeof(*sh));
+        if (!sh)
+            return -1;
+        sh->ctx = rtp_alloc_muxer(c->stream, c->packet_stream_index);
+        if (!sh->ctx || ffio_open_dyn_packet_buf(&sh->ctx->pb, max_packet_size) < 0) {
+            av_free(sh->ctx);
+            av_free(sh);
+            return -1;
+        }
+        ret = avformat_write_header(sh->ctx, NULL);
+        avio_close_dyn_buf(sh->ctx->pb, &dummy_buf);
+        av_free(dummy_buf);
+        if (ret < 0) {
+            av_free(sh->ctx);
+            av_free(sh);
+            return -1;
+        }
+        sh->max_packet_size = max_packet_size;
+        sh->last_dts        = AV_NOPTS_VALUE;
+        c->stream->rtp_shared[c->packet_stream_index] = sh;
+    }
+    if (sh->max_packet_size != max_packet_size)
+        return -1;
+
+    for (i = 0; i < RTP_SHARED_FRAMES; i++) {
+        if (sh->frames[i].data && sh->frames[i].dts == pkt->dts &&
+            sh->frames[i].size == pkt->size) {
+            frame = &sh->frames[i];
+            break;
+        }
+    }
+
+    if (!frame) {
+        /* a session lagging behind the cached frames sends on its own */
+        if (sh->last_dts != AV_NOPTS_VALUE && pkt->dts <= sh->last_dts)
+            return -1;
+        if (ffio_open_dyn_packet_buf(&sh->ctx->pb, max_packet_size) < 0)
+            return -1;
+        pkt1 = *pkt;
+        ret = av_write_frame(sh->ctx, &pkt1);
+
+        frame = &sh->frames[sh->next_frame];
+        sh->next_frame = (sh->next_frame + 1) % RTP_SHARED_FRAMES;
+        av_freep(&frame->data);
+        frame->len = avio_close_dyn_buf(sh->ctx->pb, &frame->data);
+        if (ret < 0) {
+            av_freep(&frame->data);
+            return -1;
+        }
+        frame->dts   = pkt->dts;
+        frame->size  = pkt->size;
+        sh->last_dts = pkt->dts;
+    }
+
+    ff_rtp_send_packetized(ctx, frame->data, frame->len,
+                           ((RTPMuxContext *)sh->ctx->priv_data)->base_timestamp);
+    return 0;
+}
+
 /********************************************************************/
 /* ffserver initialization */
 
@@ -3642,6 +5392,48 @@ static void build_file_streams(void)
 }
 
 /* compute the needed AVStream for each feed */
+/* map the storage of an InMemory feed and write the feed header in it */
+static int create_feed_memory(FFStream *feed)
+{
+    AVFormatContext s1 = {0}, *s = &s1;
+    FeedMemory *mem;
+    uint8_t *header;
+    int fd, len;
+
+    /* a shared mapping of /dev/zero stays shared after fork(); the last
+       packet may start just before the maximum size */
+    if ((fd = open("/dev/zero", O_RDWR)) < 0)
+        return -1;
+    mem = mmap(NULL, sizeof(*mem) + feed->feed_max_size + feed->feed_packet_size,
+               PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED)
+        return -1;
+
+    /* only write the header of the ffm file */
+    if (avio_open_dyn_buf(&s->pb) < 0)
+        return -1;
+    s->oformat = feed->fmt;
+    s->packet_size = feed->feed_packet_size;
+    s->nb_streams = feed->nb_streams;
+    s->streams = feed->streams;
+    if (avformat_write_header(s, NULL) < 0) {
+        http_log("Container doesn't supports the required parameters\n");
+        exit(1);
+    }
+    /* XXX: need better api */
+    av_freep(&s->priv_data);
+    len = avio_close_dyn_buf(s->pb, &header);
+    memcpy(mem->data, header, FFMIN(len, feed->feed_max_size));
+    av_free(header);
+
+    mem->size = FFMIN(len, feed->feed_max_size);
+    feed->feed_mem = mem;
+    feed->feed_write_index = FFMAX(AV_RB64(mem->data + 8), feed->feed_packet_size);
+    feed->feed_size = mem->size;
+    return 0;
+}
+
 static void build_feed_streams(void)
 {
     FFStream *stream, *feed;
@@ -3674,6 +5466,15 @@ static void build_feed_streams(void)
     for(feed = first_feed; feed != NULL; feed = feed->next_feed) {
         int fd;
 
+        if (feed->in_memory) {
+            if (create_feed_memory(feed) < 0) {
+                http_log("Could not allocate the memory of feed '%s'\n",
+                         feed->filename);
+                exit(1);
+            }
+            continue;
+        }
+
         if (avio_check(feed->feed_filename, AVIO_FLAG_READ) > 0) {
             /* See if it matches */
             AVFormatContext *s = NULL;
@@ -3681,7 +5482,10 @@ static void build_feed_streams(void)
 
             if (avformat_open_input(&s, feed->feed_filename, NULL, NULL) >= 0) {
                 /* Now see if it matches */
-                if (s->nb_streams == feed->nb_streams) {
+                if (s->packet_size != feed->feed_packet_size) {
+                    http_log("Deleting feed file '%s' as packet sizes differ (%d != %d)\n",
+                        feed->feed_filename, s->packet_size, feed->feed_packet_size);
+                } else if (s->nb_streams == feed->nb_streams) {
                     matches = 1;
                     for(i=0;i<s->nb_streams;i++) {
                         AVStream *sf, *ss;
@@ -3763,6 +5567,7 @@ static void build_feed_streams(void)
                 exit(1);
             }
             s->oformat = feed->fmt;
+            s->packet_size = feed->feed_packet_size;
             s->nb_streams = feed->nb_streams;
             s->streams = feed->streams;
             if (avformat_write_header(s, NULL) < 0) {
@@ -3781,8 +5586,9 @@ static void build_feed_streams(void)
             exit(1);
         }
 
-        feed->feed_write_index = FFMAX(ffm_read_write_index(fd), FFM_PACKET_SIZE);
+        feed->feed_write_index = FFMAX(ffm_read_write_index(fd), feed->feed_packet_size);
         feed->feed_size = lseek(fd, 0, SEEK_END);
+        feed->feed_index_fd = -1;
         /* ensure that we do not wrap before the end of file */
         if (feed->feed_max_size && feed->feed_max_size < feed->feed_size)
             feed->feed_max_size = feed->feed_size;
@@ -4105,6 +5911,13 @@ static int parse_ffconfig(const char *filename)
             } else {
                 nb_max_connections = val;
             }
+        } else if (!strcasecmp(cmd, "Workers")) {
+            get_arg(arg, sizeof(arg), &p);
+            val = atoi(arg);
+            if (val < 1 || val > 256) {
+                ERROR("Invalid Workers: %s\n", arg);
+            } else
+                nb_workers = val;
         } else if (!strcasecmp(cmd, "MaxBandwidth")) {
             int64_t llval;
             get_arg(arg, sizeof(arg), &p);
@@ -4140,6 +5953,7 @@ static int parse_ffconfig(const char *filename)
                 snprintf(feed->feed_filename, sizeof(feed->feed_filename),
                          "/tmp/%s.ffm", feed->filename);
                 feed->feed_max_size = 5 * 1024 * 1024;
+                feed->feed_packet_size = FFM_PACKET_SIZE;
                 feed->is_feed = 1;
                 feed->feed = feed; /* self feeding :-) */
 
@@ -4172,6 +5986,27 @@ static int parse_ffconfig(const char *filename)
                     inet_ntoa(my_http_addr.sin_addr),
                     ntohs(my_http_addr.sin_port), feed->filename);
             }
+        } else if (!strcasecmp(cmd, "Source")) {
+            if (feed) {
+#if HAVE_PTHREADS && CONFIG_AVFILTER
+                get_arg(feed->source_url, sizeof(feed->source_url), &p);
+#else
+                ERROR("Source requires pthreads and libavfilter\n");
+#endif
+            }
+        } else if (!strcasecmp(cmd, "SourceFormat")) {
+            get_arg(arg, sizeof(arg), &p);
+            if (feed) {
+                feed->source_ifmt = av_find_input_format(arg);
+                if (!feed->source_ifmt)
+                    ERROR("Unknown input format: %s\n", arg);
+            }
+        } else if (!strcasecmp(cmd, "SourceOption")) {
+            char arg2[1024];
+            get_arg(arg, sizeof(arg), &p);
+            get_arg(arg2, sizeof(arg2), &p);
+            if (feed)
+                av_dict_set(&feed->source_opts, arg, arg2, 0);
         } else if (!strcasecmp(cmd, "ReadOnlyFile")) {
             if (feed) {
                 get_arg(feed->feed_filename, sizeof(feed->feed_filename), &p);
@@ -4184,6 +6019,9 @@ static int parse_ffconfig(const char *filename)
                 get_arg(feed->feed_filename, sizeof(feed->feed_filename), &p);
             } else if (stream)
                 get_arg(stream->feed_filename, sizeof(stream->feed_filename), &p);
+        } else if (!strcasecmp(cmd, "InMemory")) {
+            if (feed)
+                feed->in_memory = 1;
         } else if (!strcasecmp(cmd, "Truncate")) {
             if (feed) {
                 get_arg(arg, sizeof(arg), &p);
@@ -4209,13 +6047,25 @@ static int parse_ffconfig(const char *filename)
                     break;
                 }
                 feed->feed_max_size = (int64_t)fsize;
-                if (feed->feed_max_size < FFM_PACKET_SIZE*4) {
-                    ERROR("Feed max file size is too small, must be at least %d\n", FFM_PACKET_SIZE*4);
+                if (feed->feed_max_size < feed->feed_packet_size*4) {
+                    ERROR("Feed max file size is too small, must be at least %d\n", feed->feed_packet_size*4);
+                }
+            }
+        } else if (!strcasecmp(cmd, "PacketSize")) {
+            if (feed) {
+                get_arg(arg, sizeof(arg), &p);
+                feed->feed_packet_size = atoi(arg);
+                if (feed->feed_packet_size < FFM_PACKET_SIZE ||
+                    feed->feed_packet_size > FFM_MAX_PACKET_SIZE) {
+                    ERROR("Feed packet size must be between %d and %d\n",
+                          FFM_PACKET_SIZE, FFM_MAX_PACKET_SIZE);
                 }
             }
         } else if (!strcasecmp(cmd, "</Feed>")) {
             if (!feed) {
                 ERROR("No corresponding <Feed> for </Feed>\n");
+            } else if (feed->child_argv && feed->source_url[0]) {
+                ERROR("Feed '%s' cannot have both Launch and Source\n", feed->filename);
             }
             feed = NULL;
         } else if (!strcasecmp(cmd, "<Stream")) {
@@ -4687,6 +6537,7 @@ int main(int argc, char **argv)
     unsetenv("http_proxy");             /* Kill the http_proxy */
 
     av_lfg_init(&random_state, av_get_random_seed());
+    server_start_time = time(NULL);
 
     memset(&sigact, 0, sizeof(sigact));
     sigact.sa_handler = handle_child_exit;
@@ -1848,12 +1848,10 @@ static void imdct_and_windowing(AACContext *ac, SingleChannelElement *sce)
     const float *swindow_prev = ics->use_kb_window[1] ? ff_aac_kbd_short_128 : ff_sine_128;
     float *buf  = ac->buf_mdct;
     float *temp = ac->temp;
-    int i;
 
     // imdct
     if (ics->window_sequence[0] == EIGHT_SHORT_SEQUENCE) {
-        for (i = 0; i < 1024; i += 128)
-            ac->mdct_small.imdct_half(&ac->mdct_small, buf + i, in + i);
+        ac->mdct_small.imdct_half_batch(&ac->mdct_small, buf, 128, in, 128, 8);
     } else
         ac->mdct.imdct_half(&ac->mdct, buf, in);
 
@@ -2072,14 +2070,17 @@ static int parse_adts_frame_header(AACContext *ac, GetBitContext *gb)
 }
 
 static int aac_decode_frame_int(AVCodecContext *avctx, void *data,
-                                int *data_size, GetBitContext *gb)
+                                int *got_frame_ptr, GetBitContext *gb)
 {
     AACContext *ac = avctx->priv_data;
+    AVFrame *frame = data;
     ChannelElement *che = NULL, *che_prev = NULL;
     enum RawDataBlockType elem_type, elem_type_prev = TYPE_END;
-    int err, elem_id, data_size_tmp;
+    int err, elem_id, ch;
     int samples = 0, multiplier;
 
+    *got_frame_ptr = 0;
+
     if (show_bits(gb, 12) == 0xfff) {
         if (parse_adts_frame_header(ac, gb) < 0) {
             av_log(avctx, AV_LOG_ERROR, "Error decoding AAC frame header.\n");
@@ -2178,23 +2179,22 @@ static int aac_decode_frame_int(AVCodecContext *avctx, void *data,
         avctx->frame_size = samples;
     }
 
-    data_size_tmp = samples * avctx->channels *
-                    av_get_bytes_per_sample(avctx->sample_fmt);
-    if (*data_size < data_size_tmp) {
-        av_log(avctx, AV_LOG_ERROR,
-               "Output buffer too small (%d) or trying to output too many samples (%d) for this frame.\n",
-               *data_size, data_size_tmp);
-        return -1;
-    }
-    *data_size = data_size_tmp;
-
-    if (samples) {
-        if (avctx->sample_fmt == AV_SAMPLE_FMT_FLT)
-            ac->fmt_conv.float_interleave(data, (const float **)ac->output_data,
-                                          samples, avctx->channels);
-        else
-            ac->fmt_conv.float_to_int16_interleave(data, (const float **)ac->output_data,
-                                                   samples, avctx->channels);
+    if (samples && avctx->channels) {
+        frame->nb_samples = samples;
+        frame->planar     = 1;
+        if ((err = avctx->get_buffer(avctx, frame)) < 0) {
+            av_log(avctx, AV_LOG_ERROR, "get_buffer() failed\n");
+            return err;
+        }
+        for (ch = 0; ch < avctx->channels; ch++) {
+            if (avctx->sample_fmt == AV_SAMPLE_FMT_FLT)
+                memcpy(frame->extended_data[ch], ac->output_data[ch],
+                       samples * sizeof(float));
+            else
+                ac->fmt_conv.float_to_int16((int16_t *)frame->extended_data[ch],
+                                            ac->output_data[ch], samples);
+        }
+        *got_frame_ptr = 1;
     }
 
     if (ac->output_configured)
@@ -2204,7 +2204,7 @@ static int aac_decode_frame_int(AVCodecContext *avctx, void *data,
 }
 
 static int aac_decode_frame(AVCodecContext *avctx, void *data,
-                            int *data_size, AVPacket *avpkt)
+                            int *got_frame_ptr, AVPacket *avpkt)
 {
     const uint8_t *buf = avpkt->data;
     int buf_size = avpkt->size;
@@ -2215,7 +2215,7 @@ static int aac_decode_frame(AVCodecContext *avctx, void *data,
 
     init_get_bits(&gb, buf, buf_size * 8);
 
-    if ((err = aac_decode_frame_int(avctx, data, data_size, &gb)) < 0)
+    if ((err = aac_decode_frame_int(avctx, data, got_frame_ptr, &gb)) < 0)
         return err;
 
     buf_consumed = (get_bits_count(&gb) + 7) >> 3;
@@ -2437,7 +2437,7 @@ static int read_audio_mux_element(struct LATMContext *latmctx,
 }
 
 
-static int latm_decode_frame(AVCodecContext *avctx, void *out, int *out_size,
+static int latm_decode_frame(AVCodecContext *avctx, void *out, int *got_frame_ptr,
                              AVPacket *avpkt)
 {
     struct LATMContext *latmctx = avctx->priv_data;
@@ -2463,7 +2463,7 @@ static int latm_decode_frame(AVCodecContext *avctx, void *out, int *out_size,
 
     if (!latmctx->initialized) {
         if (!avctx->extradata) {
-            *out_size = 0;
+            *got_frame_ptr = 0;
             return avpkt->size;
         } else {
             aac_decode_close(avctx);
@@ -2480,7 +2480,7 @@ static int latm_decode_frame(AVCodecContext *avctx, void *out, int *out_size,
         return AVERROR_INVALIDDATA;
     }
 
-    if ((err = aac_decode_frame_int(avctx, out, out_size, &gb)) < 0)
+    if ((err = aac_decode_frame_int(avctx, out, got_frame_ptr, &gb)) < 0)
         return err;
 
     return muxlength;
@@ -2512,6 +2512,7 @@ AVCodec ff_aac_decoder = {
     NULL,
     aac_decode_close,
     aac_decode_frame,
+    .capabilities = CODEC_CAP_AUDIO_FRAME,
     .long_name = NULL_IF_CONFIG_SMALL("Advanced Audio Coding"),
     .sample_fmts = (const enum AVSampleFormat[]) {
         AV_SAMPLE_FMT_FLT, AV_SAMPLE_FMT_S16, AV_SAMPLE_FMT_NONE
@@ -2532,6 +2533,7 @@ AVCodec ff_aac_latm_decoder = {
     .init   = latm_decode_init,
     .close  = aac_decode_close,
     .decode = latm_decode_frame,
+    .capabilities = CODEC_CAP_AUDIO_FRAME,
     .long_name = NULL_IF_CONFIG_SMALL("AAC LATM (Advanced Audio Codec LATM syntax)"),
     .sample_fmts = (const enum AVSampleFormat[]) {
         AV_SAMPLE_FMT_FLT, AV_SAMPLE_FMT_S16, AV_SAMPLE_FMT_NONE
@@ -210,6 +210,7 @@ static av_cold int aac_encode_init(AVCodecContext *avctx)
 
     s->samples            = av_malloc(2 * 1024 * avctx->channels * sizeof(s->samples[0]));
     s->cpe                = av_mallocz(sizeof(ChannelElement) * aac_chan_configs[avctx->channels-1][0]);
+    s->element_ctx        = av_malloc(sizeof(AACEncContext) * aac_chan_configs[avctx->channels-1][0]);
     avctx->extradata      = av_mallocz(5 + FF_INPUT_BUFFER_PADDING_SIZE);
     avctx->extradata_size = 5;
     put_audio_specific_config(avctx);
@@ -493,16 +494,150 @@ static void put_bitstream_info(AVCodecContext *avctx, AACEncContext *s,
     put_bits(&s->pb, 12 - padbits, 0);
 }
 
+/** state of the current frame, shared by the channel element jobs */
+typedef struct AACElementJobArgs {
+    FFPsyWindowInfo *windows;           ///< window information of all channels
+    int16_t *samples;
+    int lookahead;                      ///< 0 for the last frame, which has no new samples
+    int buf_size;                       ///< size of the bitstream buffer of an element
+    int element_bits[AAC_MAX_CHANNELS]; ///< length of the bitstream of each element
+} AACElementJobArgs;
+
+static int element_start_channel(const uint8_t *chan_map, int elem)
+{
+    int i, start_ch = 0;
+
+    for (i = 0; i < elem; i++)
+        start_ch += chan_map[i+1] == TYPE_CPE ? 2 : 1;
+    return start_ch;
+}
+
+/**
+ * Choose the window sequence of the channels of a channel element and
+ * apply the MDCT.
+ */
+static int analyze_element_job(AVCodecContext *avctx, void *arg, int elem, int threadnr)
+{
+    AACEncContext *s = avctx->priv_data;
+    AACElementJobArgs *args = arg;
+    const uint8_t *chan_map = aac_chan_configs[avctx->channels-1];
+    int tag      = chan_map[elem+1];
+    int chans    = tag == TYPE_CPE ? 2 : 1;
+    int start_ch = element_start_channel(chan_map, elem);
+    FFPsyWindowInfo *wi = args->windows + start_ch;
+    ChannelElement *cpe = &s->cpe[elem];
+    int ch, w;
+
+    for (ch = 0; ch < chans; ch++) {
+        IndividualChannelStream *ics = &cpe->ch[ch].ics;
+        int cur_channel = start_ch + ch;
+        int16_t *samples2 = args->samples + cur_channel;
+        int16_t *la       = samples2 + (448+64) * avctx->channels;
+        if (!args->lookahead)
+            la = NULL;
+        if (tag == TYPE_LFE) {
+            wi[ch].window_type[0] = ONLY_LONG_SEQUENCE;
+            wi[ch].window_shape   = 0;
+            wi[ch].num_windows    = 1;
+            wi[ch].grouping[0]    = 1;
+        } else {
+            wi[ch] = s->psy.model->window(&s->psy, samples2, la, cur_channel,
+                                          ics->window_sequence[0]);
+        }
+        ics->window_sequence[1] = ics->window_sequence[0];
+        ics->window_sequence[0] = wi[ch].window_type[0];
+        ics->use_kb_window[1]   = ics->use_kb_window[0];
+        ics->use_kb_window[0]   = wi[ch].window_shape;
+        ics->num_windows        = wi[ch].num_windows;
+        ics->swb_sizes          = s->psy.bands    [ics->num_windows == 8];
+        ics->num_swb            = tag == TYPE_LFE ? 12 : s->psy.num_bands[ics->num_windows == 8];
+        for (w = 0; w < ics->num_windows; w++)
+            ics->group_len[w] = wi[ch].grouping[w];
+
+        apply_window_and_mdct(avctx, s, &cpe->ch[ch], samples2);
+    }
+    return 0;
+}
+
+/**
+ * Search the quantizers of a channel element and write it to its own
+ * bitstream buffer. Each element uses its own copy of the encoder context
+ * for the scratch buffers and the bit writer.
+ */
+static int encode_element_job(AVCodecContext *avctx, void *arg, int elem, int threadnr)
+{
+    AACEncContext *s  = avctx->priv_data;
+    AACEncContext *es = &s->element_ctx[elem];
+    AACElementJobArgs *args = arg;
+    const uint8_t *chan_map = aac_chan_configs[avctx->channels-1];
+    int tag      = chan_map[elem+1];
+    int chans    = tag == TYPE_CPE ? 2 : 1;
+    int start_ch = element_start_channel(chan_map, elem);
+    FFPsyWindowInfo *wi = args->windows + start_ch;
+    ChannelElement *cpe = &s->cpe[elem];
+    int i, ch, w, g, tag_counter = 0;
+
+    for (i = 0; i < elem; i++)
+        tag_counter += chan_map[i+1] == tag;
+
+    memcpy(es, s, offsetof(AACEncContext, qcoefs));
+    init_put_bits(&es->pb, s->element_buf + elem * args->buf_size, args->buf_size * 8);
+    put_bits(&es->pb, 3, tag);
+    put_bits(&es->pb, 4, tag_counter);
+    for (ch = 0; ch < chans; ch++) {
+        es->cur_channel = start_ch + ch;
+        es->coder->search_for_quantizers(avctx, es, &cpe->ch[ch], es->lambda);
+    }
+    cpe->common_window = 0;
+    if (chans > 1
+        && wi[0].window_type[0] == wi[1].window_type[0]
+        && wi[0].window_shape   == wi[1].window_shape) {
+
+        cpe->common_window = 1;
+        for (w = 0; w < wi[0].num_windows; w++) {
+            if (wi[0].grouping[w] != wi[1].grouping[w]) {
+                cpe->common_window = 0;
+                break;
+            }
+        }
+    }
+    es->cur_channel = start_ch;
+    if (es->options.stereo_mode && cpe->common_window) {
+        if (es->options.stereo_mode > 0) {
+            IndividualChannelStream *ics = &cpe->ch[0].ics;
+            for (w = 0; w < ics->num_windows; w += ics->group_len[w])
+                for (g = 0;  g < ics->num_swb; g++)
+                    cpe->ms_mask[w*16+g] = 1;
+        } else if (es->coder->search_for_ms) {
+            es->coder->search_for_ms(es, cpe, es->lambda);
+        }
+    }
+    adjust_frame_information(es, cpe, chans);
+    if (chans == 2) {
+        put_bits(&es->pb, 1, cpe->common_window);
+        if (cpe->common_window) {
+            put_ics_info(es, &cpe->ch[0].ics);
+            encode_ms_info(&es->pb, cpe);
+        }
+    }
+    for (ch = 0; ch < chans; ch++) {
+        es->cur_channel = start_ch + ch;
+        encode_individual_channel(avctx, es, &cpe->ch[ch], cpe->common_window);
+    }
+    args->element_bits[elem] = put_bits_count(&es->pb);
+    flush_put_bits(&es->pb);
+    return 0;
+}
+
 static int aac_encode_frame(AVCodecContext *avctx,
                             uint8_t *frame, int buf_size, void *data)
 {
     AACEncContext *s = avctx->priv_data;
-    int16_t *samples = s->samples, *samples2, *la;
-    ChannelElement *cpe;
-    int i, ch, w, g, chans, tag, start_ch;
+    int16_t *samples = s->samples, *samples2;
+    int i, ch, chans, tag, start_ch;
     const uint8_t *chan_map = aac_chan_configs[avctx->channels-1];
-    int chan_el_counter[4];
     FFPsyWindowInfo windows[AAC_MAX_CHANNELS];
+    AACElementJobArgs args;
 
     if (s->last_frame)
         return 0;
@@ -537,99 +672,37 @@ static int aac_encode_frame(AVCodecContext *avctx,
         return 0;
     }
 
-    start_ch = 0;
-    for (i = 0; i < chan_map[0]; i++) {
-        FFPsyWindowInfo* wi = windows + start_ch;
-        tag      = chan_map[i+1];
-        chans    = tag == TYPE_CPE ? 2 : 1;
-        cpe      = &s->cpe[i];
-        for (ch = 0; ch < chans; ch++) {
-            IndividualChannelStream *ics = &cpe->ch[ch].ics;
-            int cur_channel = start_ch + ch;
-            samples2 = samples + cur_channel;
-            la       = samples2 + (448+64) * avctx->channels;
-            if (!data)
-                la = NULL;
-            if (tag == TYPE_LFE) {
-                wi[ch].window_type[0] = ONLY_LONG_SEQUENCE;
-                wi[ch].window_shape   = 0;
-                wi[ch].num_windows    = 1;
-                wi[ch].grouping[0]    = 1;
-            } else {
-                wi[ch] = s->psy.model->window(&s->psy, samples2, la, cur_channel,
-                                              ics->window_sequence[0]);
-            }
-            ics->window_sequence[1] = ics->window_sequence[0];
-            ics->window_sequence[0] = wi[ch].window_type[0];
-            ics->use_kb_window[1]   = ics->use_kb_window[0];
-            ics->use_kb_window[0]   = wi[ch].window_shape;
-            ics->num_windows        = wi[ch].num_windows;
-            ics->swb_sizes          = s->psy.bands    [ics->num_windows == 8];
-            ics->num_swb            = tag == TYPE_LFE ? 12 : s->psy.num_bands[ics->num_windows == 8];
-            for (w = 0; w < ics->num_windows; w++)
-                ics->group_len[w] = wi[ch].grouping[w];
-
-            apply_window_and_mdct(avctx, s, &cpe->ch[ch], samples2);
-        }
-        start_ch += chans;
-    }
+    args.windows   = windows;
+    args.samples   = samples;
+    args.lookahead = !!data;
+    avctx->execute2(avctx, analyze_element_job, &args, NULL, chan_map[0]);
+
+    /* every channel element may take as many bytes as the whole frame */
+    av_fast_malloc(&s->element_buf, &s->element_buf_size, chan_map[0] * buf_size);
+    if (!s->element_buf)
+        return AVERROR(ENOMEM);
+    args.buf_size = buf_size;
+
     do {
         int frame_bits;
-        init_put_bits(&s->pb, frame, buf_size*8);
-        if ((avctx->frame_number & 0xFF)==1 && !(avctx->flags & CODEC_FLAG_BITEXACT))
-            put_bitstream_info(avctx, s, LIBAVCODEC_IDENT);
+
+        /* The psychoacoustic model carries state from one channel to the
+         * next, so it stays serial and in channel order. */
         start_ch = 0;
-        memset(chan_el_counter, 0, sizeof(chan_el_counter));
         for (i = 0; i < chan_map[0]; i++) {
-            FFPsyWindowInfo* wi = windows + start_ch;
-            tag      = chan_map[i+1];
-            chans    = tag == TYPE_CPE ? 2 : 1;
-            cpe      = &s->cpe[i];
-            put_bits(&s->pb, 3, tag);
-            put_bits(&s->pb, 4, chan_el_counter[tag]++);
-            for (ch = 0; ch < chans; ch++) {
-                s->cur_channel = start_ch + ch;
-                s->psy.model->analyze(&s->psy, s->cur_channel, cpe->ch[ch].coeffs, &wi[ch]);
-                s->coder->search_for_quantizers(avctx, s, &cpe->ch[ch], s->lambda);
-            }
-            cpe->common_window = 0;
-            if (chans > 1
-                && wi[0].window_type[0] == wi[1].window_type[0]
-                && wi[0].window_shape   == wi[1].window_shape) {
-
-                cpe->common_window = 1;
-                for (w = 0; w < wi[0].num_windows; w++) {
-                    if (wi[0].grouping[w] != wi[1].grouping[w]) {
-                        cpe->common_window = 0;
-                        break;
-                    }
-                }
-            }
-            s->cur_channel = start_ch;
-            if (s->options.stereo_mode && cpe->common_window) {
-                if (s->options.stereo_mode > 0) {
-                    IndividualChannelStream *ics = &cpe->ch[0].ics;
-                    for (w = 0; w < ics->num_windows; w += ics->group_len[w])
-                        for (g = 0;  g < ics->num_swb; g++)
-                            cpe->ms_mask[w*16+g] = 1;
-                } else if (s->coder->search_for_ms) {
-                    s->coder->search_for_ms(s, cpe, s->lambda);
-                }
-            }
-            adjust_frame_information(s, cpe, chans);
-            if (chans == 2) {
-                put_bits(&s->pb, 1, cpe->common_window);
-                if (cpe->common_window) {
-                    put_ics_info(s, &cpe->ch[0].ics);
-                    encode_ms_info(&s->pb, cpe);
-                }
-            }
-            for (ch = 0; ch < chans; ch++) {
-                s->cur_channel = start_ch + ch;
-                encode_individual_channel(avctx, s, &cpe->ch[ch], cpe->common_window);
-            }
+            chans = chan_map[i+1] == TYPE_CPE ? 2 : 1;
+            for (ch = 0; ch < chans; ch++)
+                s->psy.model->analyze(&s->psy, start_ch + ch, s->cpe[i].ch[ch].coeffs,
+                                      &windows[start_ch + ch]);
             start_ch += chans;
         }
+        avctx->execute2(avctx, encode_element_job, &args, NULL, chan_map[0]);
+
+        init_put_bits(&s->pb, frame, buf_size*8);
+        if ((avctx->frame_number & 0xFF)==1 && !(avctx->flags & CODEC_FLAG_BITEXACT))
+            put_bitstream_info(avctx, s, LIBAVCODEC_IDENT);
+        for (i = 0; i < chan_map[0]; i++)
+            ff_copy_bits(&s->pb, s->element_buf + i * buf_size, args.element_bits[i]);
 
         frame_bits = put_bits_count(&s->pb);
         if (frame_bits <= 6144 * avctx->channels - 3) {
@@ -669,6 +742,8 @@ static av_cold int aac_encode_end(AVCodecContext *avctx)
     ff_psy_preprocess_end(s->psypp);
     av_freep(&s->samples);
     av_freep(&s->cpe);
+    av_freep(&s->element_ctx);
+    av_freep(&s->element_buf);
     return 0;
 }
 
@@ -696,7 +771,8 @@ AVCodec ff_aac_encoder = {
     aac_encode_init,
     aac_encode_frame,
     aac_encode_end,
-    .capabilities = CODEC_CAP_SMALL_LAST_FRAME | CODEC_CAP_DELAY | CODEC_CAP_EXPERIMENTAL,
+    .capabilities = CODEC_CAP_SMALL_LAST_FRAME | CODEC_CAP_DELAY | CODEC_CAP_EXPERIMENTAL |
+                    CODEC_CAP_SLICE_THREADS,
     .sample_fmts = (const enum AVSampleFormat[]){AV_SAMPLE_FMT_S16,AV_SAMPLE_FMT_NONE},
     .long_name = NULL_IF_CONFIG_SMALL("Advanced Audio Coding"),
     .priv_class = &aacenc_class,
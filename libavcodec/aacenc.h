@@ -69,6 +69,12 @@ typedef struct AACEncContext {
     int cur_channel;
     int last_frame;
     float lambda;
+    struct AACEncContext *element_ctx;           ///< copies of this context, one per channel element
+    uint8_t *element_buf;                        ///< bitstream buffers of the channel elements
+    unsigned int element_buf_size;
+
+    /* the fields below are scratch space of each channel element context
+     * and are not copied from the main context */
     DECLARE_ALIGNED(16, int,   qcoefs)[96];      ///< quantized coefficients
     DECLARE_ALIGNED(32, float, scoefs)[1024];    ///< scaled coefficients
 } AACEncContext;
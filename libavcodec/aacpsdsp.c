@@ -0,0 +1,132 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+
+#include "config.h"
+#include "aacpsdsp.h"
+
+static void ps_add_squares_c(float *dst, const float (*src)[2], int n)
+{
+    int i;
+    for (i = 0; i < n; i++)
+        dst[i] += src[i][0] * src[i][0] + src[i][1] * src[i][1];
+}
+
+static void ps_mul_pair_single_c(float (*dst)[2], float (*src0)[2], float *src1,
+                                 int n)
+{
+    int i;
+    for (i = 0; i < n; i++) {
+        dst[i][0] = src1[i] * src0[i][0];
+        dst[i][1] = src1[i] * src0[i][1];
+    }
+}
+
+static void ps_hybrid_analysis_c(float (*out)[2], float (*in)[2],
+                                 const float (*filter)[7][2], int stride, int n)
+{
+    int i, j;
+
+    for (i = 0; i < n; i++) {
+        float sum_re = filter[i][6][0] * in[6][0];
+        float sum_im = filter[i][6][0] * in[6][1];
+
+        for (j = 0; j < 6; j++) {
+            float in0_re = in[j][0];
+            float in0_im = in[j][1];
+            float in1_re = in[12-j][0];
+            float in1_im = in[12-j][1];
+            sum_re += filter[i][j][0] * (in0_re + in1_re) -
+                      filter[i][j][1] * (in0_im - in1_im);
+            sum_im += filter[i][j][0] * (in0_im + in1_im) +
+                      filter[i][j][1] * (in0_re - in1_re);
+        }
+        out[i * stride][0] = sum_re;
+        out[i * stride][1] = sum_im;
+    }
+}
+
+static void ps_stereo_interpolate_c(float (*l)[2], float (*r)[2],
+                                    float h[2][4], float h_step[2][4], int len)
+{
+    float h11 = h[0][0], h12 = h[0][1], h21 = h[0][2], h22 = h[0][3];
+    float hs11 = h_step[0][0], hs12 = h_step[0][1],
+          hs21 = h_step[0][2], hs22 = h_step[0][3];
+    int n;
+
+    for (n = 0; n < len; n++) {
+        //l is s, r is d
+        float l_re = l[n][0];
+        float l_im = l[n][1];
+        float r_re = r[n][0];
+        float r_im = r[n][1];
+        h11 += hs11;
+        h12 += hs12;
+        h21 += hs21;
+        h22 += hs22;
+        l[n][0] = h11*l_re + h21*r_re;
+        l[n][1] = h11*l_im + h21*r_im;
+        r[n][0] = h12*l_re + h22*r_re;
+        r[n][1] = h12*l_im + h22*r_im;
+    }
+}
+
+static void ps_stereo_interpolate_ipdopd_c(float (*l)[2], float (*r)[2],
+                                           float h[2][4], float h_step[2][4],
+                                           int len)
+{
+    float h11r = h[0][0], h12r = h[0][1], h21r = h[0][2], h22r = h[0][3];
+    float h11i = h[1][0], h12i = h[1][1], h21i = h[1][2], h22i = h[1][3];
+    float hs11r = h_step[0][0], hs12r = h_step[0][1],
+          hs21r = h_step[0][2], hs22r = h_step[0][3];
+    float hs11i = h_step[1][0], hs12i = h_step[1][1],
+          hs21i = h_step[1][2], hs22i = h_step[1][3];
+    int n;
+
+    for (n = 0; n < len; n++) {
+        //l is s, r is d
+        float l_re = l[n][0];
+        float l_im = l[n][1];
+        float r_re = r[n][0];
+        float r_im = r[n][1];
+        h11r += hs11r;
+        h12r += hs12r;
+        h21r += hs21r;
+        h22r += hs22r;
+        h11i += hs11i;
+        h12i += hs12i;
+        h21i += hs21i;
+        h22i += hs22i;
+
+        l[n][0] = h11r*l_re + h21r*r_re - h11i*l_im - h21i*r_im;
+        l[n][1] = h11r*l_im + h21r*r_im + h11i*l_re + h21i*r_re;
+        r[n][0] = h12r*l_re + h22r*r_re - h12i*l_im - h22i*r_im;
+        r[n][1] = h12r*l_im + h22r*r_im + h12i*l_re + h22i*r_re;
+    }
+}
+
+void ff_psdsp_init(PSDSPContext *s)
+{
+    s->add_squares            = ps_add_squares_c;
+    s->mul_pair_single        = ps_mul_pair_single_c;
+    s->hybrid_analysis        = ps_hybrid_analysis_c;
+    s->stereo_interpolate[0]  = ps_stereo_interpolate_c;
+    s->stereo_interpolate[1]  = ps_stereo_interpolate_ipdopd_c;
+
+    if (HAVE_MMX) ff_psdsp_init_mmx(s);
+}
@@ -0,0 +1,54 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+
+#ifndef AVCODEC_AACPSDSP_H
+#define AVCODEC_AACPSDSP_H
+
+/**
+ * Parametric Stereo DSP functions.
+ * The lengths n and len may be any positive value for the C versions; the
+ * SIMD versions of add_squares and mul_pair_single need a multiple of 4 and
+ * those of hybrid_analysis an even number of filters.
+ */
+typedef struct PSDSPContext {
+    /** dst[i] += src[i][0]^2 + src[i][1]^2, dst and src 16-byte aligned */
+    void (*add_squares)(float *dst, const float (*src)[2], int n);
+    /** dst[i] = src0[i] * src1[i], dst and src1 16-byte aligned */
+    void (*mul_pair_single)(float (*dst)[2], float (*src0)[2], float *src1,
+                            int n);
+    /**
+     * Filter the 13 complex samples at in with each of the n filters,
+     * writing the result of filter i to out[i * stride].
+     */
+    void (*hybrid_analysis)(float (*out)[2], float (*in)[2],
+                            const float (*filter)[7][2], int stride, int n);
+    /**
+     * Mix len samples of l and r with the mixing matrix h, which is stepped
+     * by h_step before each sample; h[0] holds the real parts of h11, h12,
+     * h21 and h22, h[1] the imaginary parts, which only the second function
+     * (for IPD/OPD) uses.
+     */
+    void (*stereo_interpolate[2])(float (*l)[2], float (*r)[2],
+                                  float h[2][4], float h_step[2][4], int len);
+} PSDSPContext;
+
+void ff_psdsp_init(PSDSPContext *s);
+void ff_psdsp_init_mmx(PSDSPContext *s);
+
+#endif /* AVCODEC_AACPSDSP_H */
@@ -608,23 +608,28 @@ static void do_rematrixing(AC3DecodeContext *s)
  */
 static inline void do_imdct(AC3DecodeContext *s, int channels)
 {
-    int ch;
+    int ch, i, n;
 
     for (ch=1; ch<=channels; ch++) {
         if (s->block_switch[ch]) {
-            int i;
-            float *x = s->tmp_output+128;
+            float *x = s->tmp_output[0]+128;
             for(i=0; i<128; i++)
                 x[i] = s->transform_coeffs[ch][2*i];
-            s->imdct_256.imdct_half(&s->imdct_256, s->tmp_output, x);
-            s->dsp.vector_fmul_window(s->output[ch-1], s->delay[ch-1], s->tmp_output, s->window, 128);
+            s->imdct_256.imdct_half(&s->imdct_256, s->tmp_output[0], x);
+            s->dsp.vector_fmul_window(s->output[ch-1], s->delay[ch-1], s->tmp_output[0], s->window, 128);
             for(i=0; i<128; i++)
                 x[i] = s->transform_coeffs[ch][2*i+1];
             s->imdct_256.imdct_half(&s->imdct_256, s->delay[ch-1], x);
         } else {
-            s->imdct_512.imdct_half(&s->imdct_512, s->tmp_output, s->transform_coeffs[ch]);
-            s->dsp.vector_fmul_window(s->output[ch-1], s->delay[ch-1], s->tmp_output, s->window, 128);
-            memcpy(s->delay[ch-1], s->tmp_output+128, 128*sizeof(float));
+            /* transform the following channels with long blocks together */
+            for (n = 1; ch + n <= channels && !s->block_switch[ch + n]; n++);
+            s->imdct_512.imdct_half_batch(&s->imdct_512, s->tmp_output[0], AC3_BLOCK_SIZE,
+                                          s->transform_coeffs[ch], AC3_MAX_COEFS, n);
+            for (i = 0; i < n; i++) {
+                s->dsp.vector_fmul_window(s->output[ch+i-1], s->delay[ch+i-1], s->tmp_output[i], s->window, 128);
+                memcpy(s->delay[ch+i-1], s->tmp_output[i]+128, 128*sizeof(float));
+            }
+            ch += n - 1;
         }
     }
 }
@@ -1290,16 +1295,14 @@ static int decode_audio_block(AC3DecodeContext *s, int blk)
 /**
  * Decode a single AC-3 frame.
  */
-static int ac3_decode_frame(AVCodecContext * avctx, void *data, int *data_size,
+static int ac3_decode_frame(AVCodecContext * avctx, void *data, int *got_frame_ptr,
                             AVPacket *avpkt)
 {
+    AVFrame *frame = data;
     const uint8_t *buf = avpkt->data;
     int buf_size = avpkt->size;
     AC3DecodeContext *s = avctx->priv_data;
-    float   *out_samples_flt = data;
-    int16_t *out_samples_s16 = data;
-    int blk, ch, err;
-    int data_size_orig, data_size_tmp;
+    int blk, ch, err, ret;
     const uint8_t *channel_map;
     const float *output[AC3_MAX_CHANNELS];
 
@@ -1316,8 +1319,7 @@ static int ac3_decode_frame(AVCodecContext * avctx, void *data, int *data_size,
     init_get_bits(&s->gbc, buf, buf_size * 8);
 
     /* parse the syncinfo */
-    data_size_orig = *data_size;
-    *data_size = 0;
+    *got_frame_ptr = 0;
     err = parse_frame_header(s);
 
     if (err) {
@@ -1400,29 +1402,33 @@ static int ac3_decode_frame(AVCodecContext * avctx, void *data, int *data_size,
     channel_map = ff_ac3_dec_channel_map[s->output_mode & ~AC3_OUTPUT_LFEON][s->lfe_on];
     for (ch = 0; ch < s->out_channels; ch++)
         output[ch] = s->output[channel_map[ch]];
-    data_size_tmp = s->num_blocks * 256 * avctx->channels;
-    data_size_tmp *= avctx->sample_fmt == AV_SAMPLE_FMT_FLT ? sizeof(*out_samples_flt) : sizeof(*out_samples_s16);
-    if (data_size_orig < data_size_tmp)
-        return -1;
-    *data_size = data_size_tmp;
+    if (!s->out_channels)
+        return FFMIN(buf_size, s->frame_size);
+
+    /* the blocks are written to the channel planes of the frame as they
+       are decoded */
+    frame->nb_samples = s->num_blocks * 256;
+    frame->planar     = 1;
+    if ((ret = avctx->get_buffer(avctx, frame)) < 0) {
+        av_log(avctx, AV_LOG_ERROR, "get_buffer() failed\n");
+        return ret;
+    }
     for (blk = 0; blk < s->num_blocks; blk++) {
         if (!err && decode_audio_block(s, blk)) {
             av_log(avctx, AV_LOG_ERROR, "error decoding the audio block\n");
             err = 1;
         }
 
-        if (avctx->sample_fmt == AV_SAMPLE_FMT_FLT) {
-            s->fmt_conv.float_interleave(out_samples_flt, output, 256,
-                                         s->out_channels);
-            out_samples_flt += 256 * s->out_channels;
-        } else {
-            s->fmt_conv.float_to_int16_interleave(out_samples_s16, output, 256,
-                                                  s->out_channels);
-            out_samples_s16 += 256 * s->out_channels;
+        for (ch = 0; ch < s->out_channels; ch++) {
+            if (avctx->sample_fmt == AV_SAMPLE_FMT_FLT)
+                memcpy((float *)frame->extended_data[ch] + blk * 256,
+                       output[ch], 256 * sizeof(**output));
+            else
+                s->fmt_conv.float_to_int16((int16_t *)frame->extended_data[ch] + blk * 256,
+                                           output[ch], 256);
         }
     }
-    *data_size = s->num_blocks * 256 * avctx->channels *
-                 av_get_bytes_per_sample(avctx->sample_fmt);
+    *got_frame_ptr = 1;
     return FFMIN(buf_size, s->frame_size);
 }
 
@@ -1446,6 +1452,7 @@ AVCodec ff_ac3_decoder = {
     .init = ac3_decode_init,
     .close = ac3_decode_end,
     .decode = ac3_decode_frame,
+    .capabilities = CODEC_CAP_AUDIO_FRAME,
     .long_name = NULL_IF_CONFIG_SMALL("ATSC A/52A (AC-3)"),
     .sample_fmts = (const enum AVSampleFormat[]) {
         AV_SAMPLE_FMT_FLT, AV_SAMPLE_FMT_S16, AV_SAMPLE_FMT_NONE
@@ -1461,6 +1468,7 @@ AVCodec ff_eac3_decoder = {
     .init = ac3_decode_init,
     .close = ac3_decode_end,
     .decode = ac3_decode_frame,
+    .capabilities = CODEC_CAP_AUDIO_FRAME,
     .long_name = NULL_IF_CONFIG_SMALL("ATSC A/52B (AC-3, E-AC-3)"),
     .sample_fmts = (const enum AVSampleFormat[]) {
         AV_SAMPLE_FMT_FLT, AV_SAMPLE_FMT_S16, AV_SAMPLE_FMT_NONE
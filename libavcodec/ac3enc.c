@@ -305,17 +305,16 @@ static av_cold void exponent_init(AC3EncodeContext *s)
 
 
 /**
- * Extract exponents from the MDCT coefficients.
+ * Extract exponents from the MDCT coefficients of all blocks in 1 channel.
  * This takes into account the normalization that was done to the input samples
  * by adjusting the exponents by the exponent shift values.
  */
-static void extract_exponents(AC3EncodeContext *s)
+static void extract_exponents_ch(AC3EncodeContext *s, int ch)
 {
-    int ch        = !s->cpl_on;
-    int chan_size = AC3_MAX_COEFS * AC3_MAX_BLOCKS * (s->channels - ch + 1);
     AC3Block *block = &s->blocks[0];
 
-    s->ac3dsp.extract_exponents(block->exp[ch], block->fixed_coef[ch], chan_size);
+    s->ac3dsp.extract_exponents(block->exp[ch], block->fixed_coef[ch],
+                                AC3_MAX_COEFS * AC3_MAX_BLOCKS);
 }
 
 
@@ -327,14 +326,18 @@ static void extract_exponents(AC3EncodeContext *s)
 
 
 /**
- * Calculate exponent strategies for all channels.
+ * Calculate exponent strategies for 1 channel.
  * Array arrangement is reversed to simplify the per-channel calculation.
  */
-static void compute_exp_strategy(AC3EncodeContext *s)
+static void compute_exp_strategy_ch(AC3EncodeContext *s, int ch)
 {
-    int ch, blk, blk1;
+    int blk, blk1;
 
-    for (ch = !s->cpl_on; ch <= s->fbw_channels; ch++) {
+    if (ch == s->lfe_channel) {
+        s->exp_strategy[ch][0] = EXP_D15;
+        for (blk = 1; blk < AC3_MAX_BLOCKS; blk++)
+            s->exp_strategy[ch][blk] = EXP_REUSE;
+    } else {
         uint8_t *exp_strategy = s->exp_strategy[ch];
         uint8_t *exp          = s->blocks[0].exp[ch];
         int exp_diff;
@@ -373,12 +376,6 @@ static void compute_exp_strategy(AC3EncodeContext *s)
             blk = blk1;
         }
     }
-    if (s->lfe_on) {
-        ch = s->lfe_channel;
-        s->exp_strategy[ch][0] = EXP_D15;
-        for (blk = 1; blk < AC3_MAX_BLOCKS; blk++)
-            s->exp_strategy[ch][blk] = EXP_REUSE;
-    }
 }
 
 
@@ -453,52 +450,86 @@ static void encode_exponents_blk_ch(uint8_t *exp, int nb_exps, int exp_strategy,
 
 
 /**
- * Encode exponents from original extracted form to what the decoder will see.
+ * Encode the exponents of 1 channel from original extracted form to what the
+ * decoder will see.
  * This copies and groups exponents based on exponent strategy and reduces
  * deltas between adjacent exponent groups so that they can be differentially
  * encoded.
  */
-static void encode_exponents(AC3EncodeContext *s)
+static void encode_exponents_ch(AC3EncodeContext *s, int ch)
 {
-    int blk, blk1, ch, cpl;
+    int blk, blk1, cpl;
     uint8_t *exp, *exp_strategy;
     int nb_coefs, num_reuse_blocks;
 
-    for (ch = !s->cpl_on; ch <= s->channels; ch++) {
-        exp          = s->blocks[0].exp[ch] + s->start_freq[ch];
-        exp_strategy = s->exp_strategy[ch];
+    exp          = s->blocks[0].exp[ch] + s->start_freq[ch];
+    exp_strategy = s->exp_strategy[ch];
 
-        cpl = (ch == CPL_CH);
-        blk = 0;
-        while (blk < AC3_MAX_BLOCKS) {
-            AC3Block *block = &s->blocks[blk];
-            if (cpl && !block->cpl_in_use) {
-                exp += AC3_MAX_COEFS;
-                blk++;
-                continue;
-            }
-            nb_coefs = block->end_freq[ch] - s->start_freq[ch];
-            blk1 = blk + 1;
-
-            /* count the number of EXP_REUSE blocks after the current block
-               and set exponent reference block numbers */
-            s->exp_ref_block[ch][blk] = blk;
-            while (blk1 < AC3_MAX_BLOCKS && exp_strategy[blk1] == EXP_REUSE) {
-                s->exp_ref_block[ch][blk1] = blk;
-                blk1++;
-            }
-            num_reuse_blocks = blk1 - blk - 1;
+    cpl = (ch == CPL_CH);
+    blk = 0;
+    while (blk < AC3_MAX_BLOCKS) {
+        AC3Block *block = &s->blocks[blk];
+        if (cpl && !block->cpl_in_use) {
+            exp += AC3_MAX_COEFS;
+            blk++;
+            continue;
+        }
+        nb_coefs = block->end_freq[ch] - s->start_freq[ch];
+        blk1 = blk + 1;
+
+        /* count the number of EXP_REUSE blocks after the current block
+           and set exponent reference block numbers */
+        s->exp_ref_block[ch][blk] = blk;
+        while (blk1 < AC3_MAX_BLOCKS && exp_strategy[blk1] == EXP_REUSE) {
+            s->exp_ref_block[ch][blk1] = blk;
+            blk1++;
+        }
+        num_reuse_blocks = blk1 - blk - 1;
 
-            /* for the EXP_REUSE case we select the min of the exponents */
-            s->ac3dsp.ac3_exponent_min(exp-s->start_freq[ch], num_reuse_blocks,
-                                       AC3_MAX_COEFS);
+        /* for the EXP_REUSE case we select the min of the exponents */
+        s->ac3dsp.ac3_exponent_min(exp-s->start_freq[ch], num_reuse_blocks,
+                                   AC3_MAX_COEFS);
 
-            encode_exponents_blk_ch(exp, nb_coefs, exp_strategy[blk], cpl);
+        encode_exponents_blk_ch(exp, nb_coefs, exp_strategy[blk], cpl);
 
-            exp += AC3_MAX_COEFS * (num_reuse_blocks + 1);
-            blk = blk1;
-        }
+        exp += AC3_MAX_COEFS * (num_reuse_blocks + 1);
+        blk = blk1;
     }
+}
+
+
+/**
+ * Per-channel exponent processing, run for each channel by execute2().
+ * arg points to a flag telling whether the exponent strategies have to be
+ * calculated as well or were already chosen.
+ */
+static int process_exponents_ch(AVCodecContext *avctx, void *arg, int jobnr,
+                                int threadnr)
+{
+    AC3EncodeContext *s = avctx->priv_data;
+    int compute_strategy = *(int *)arg;
+    int ch = !s->cpl_on + jobnr;
+
+    extract_exponents_ch(s, ch);
+
+    if (compute_strategy)
+        compute_exp_strategy_ch(s, ch);
+
+    encode_exponents_ch(s, ch);
+
+    emms_c();
+    return 0;
+}
+
+
+/**
+ * Extract and encode the exponents of all channels, spreading the channels
+ * over the encoder threads.
+ */
+static void encode_exponents(AC3EncodeContext *s, int compute_strategy)
+{
+    s->avctx->execute2(s->avctx, process_exponents_ch, &compute_strategy, NULL,
+                       s->channels + s->cpl_on);
 
     /* reference block numbers have been changed, so reset ref_bap_set */
     s->ref_bap_set = 0;
@@ -572,15 +603,9 @@ static void group_exponents(AC3EncodeContext *s)
  */
 static void process_exponents(AC3EncodeContext *s)
 {
-    extract_exponents(s);
-
-    compute_exp_strategy(s);
-
-    encode_exponents(s);
+    encode_exponents(s, 1);
 
     group_exponents(s);
-
-    emms_c();
 }
 
 
@@ -831,32 +856,48 @@ static void count_frame_bits(AC3EncodeContext *s)
 
 
 /**
- * Calculate masking curve based on the final exponents.
+ * Calculate masking curve of 1 channel based on the final exponents, run for
+ * each channel by execute2().
  * Also calculate the power spectral densities to use in future calculations.
  */
-static void bit_alloc_masking(AC3EncodeContext *s)
+static int bit_alloc_masking_ch(AVCodecContext *avctx, void *arg, int jobnr,
+                                int threadnr)
 {
-    int blk, ch;
+    AC3EncodeContext *s = avctx->priv_data;
+    int ch = !s->cpl_on + jobnr;
+    int blk;
 
     for (blk = 0; blk < AC3_MAX_BLOCKS; blk++) {
         AC3Block *block = &s->blocks[blk];
-        for (ch = !block->cpl_in_use; ch <= s->channels; ch++) {
-            /* We only need psd and mask for calculating bap.
-               Since we currently do not calculate bap when exponent
-               strategy is EXP_REUSE we do not need to calculate psd or mask. */
-            if (s->exp_strategy[ch][blk] != EXP_REUSE) {
-                ff_ac3_bit_alloc_calc_psd(block->exp[ch], s->start_freq[ch],
-                                          block->end_freq[ch], block->psd[ch],
-                                          block->band_psd[ch]);
-                ff_ac3_bit_alloc_calc_mask(&s->bit_alloc, block->band_psd[ch],
-                                           s->start_freq[ch], block->end_freq[ch],
-                                           ff_ac3_fast_gain_tab[s->fast_gain_code[ch]],
-                                           ch == s->lfe_channel,
-                                           DBA_NONE, 0, NULL, NULL, NULL,
-                                           block->mask[ch]);
-            }
+        if (ch == CPL_CH && !block->cpl_in_use)
+            continue;
+        /* We only need psd and mask for calculating bap.
+           Since we currently do not calculate bap when exponent
+           strategy is EXP_REUSE we do not need to calculate psd or mask. */
+        if (s->exp_strategy[ch][blk] != EXP_REUSE) {
+            ff_ac3_bit_alloc_calc_psd(block->exp[ch], s->start_freq[ch],
+                                      block->end_freq[ch], block->psd[ch],
+                                      block->band_psd[ch]);
+            ff_ac3_bit_alloc_calc_mask(&s->bit_alloc, block->band_psd[ch],
+                                       s->start_freq[ch], block->end_freq[ch],
+                                       ff_ac3_fast_gain_tab[s->fast_gain_code[ch]],
+                                       ch == s->lfe_channel,
+                                       DBA_NONE, 0, NULL, NULL, NULL,
+                                       block->mask[ch]);
         }
     }
+    return 0;
+}
+
+
+/**
+ * Calculate masking curves of all channels, spreading the channels over the
+ * encoder threads.
+ */
+static void bit_alloc_masking(AC3EncodeContext *s)
+{
+    s->avctx->execute2(s->avctx, bit_alloc_masking_ch, NULL, NULL,
+                       s->channels + s->cpl_on);
 }
 
 
@@ -982,6 +1023,7 @@ static int cbr_bit_allocation(AC3EncodeContext *s)
     int ch;
     int bits_left;
     int snr_offset, snr_incr;
+    int fail_offset = 1024; /* lowest SNR offset known not to fit */
 
     bits_left = 8 * s->frame_size - (s->frame_bits + s->exponent_bits);
     if (bits_left < 0)
@@ -994,19 +1036,27 @@ static int cbr_bit_allocation(AC3EncodeContext *s)
     if ((snr_offset | s->fine_snr_offset[1]) == 1023) {
         if (bit_alloc(s, 1023) <= bits_left)
             return 0;
+        fail_offset = 1023;
     }
 
     while (snr_offset >= 0 &&
            bit_alloc(s, snr_offset) > bits_left) {
+        fail_offset = snr_offset;
         snr_offset -= 64;
     }
     if (snr_offset < 0)
         return AVERROR(EINVAL);
 
+    /* Offsets which already failed are not tried again; each refinement step
+       would otherwise end by re-evaluating the one which stopped the previous
+       step. */
     FFSWAP(uint8_t *, s->bap_buffer, s->bap1_buffer);
     for (snr_incr = 64; snr_incr > 0; snr_incr >>= 2) {
-        while (snr_offset + snr_incr <= 1023 &&
-               bit_alloc(s, snr_offset + snr_incr) <= bits_left) {
+        while (snr_offset + snr_incr < fail_offset) {
+            if (bit_alloc(s, snr_offset + snr_incr) > bits_left) {
+                fail_offset = snr_offset + snr_incr;
+                break;
+            }
             snr_offset += snr_incr;
             FFSWAP(uint8_t *, s->bap_buffer, s->bap1_buffer);
         }
@@ -1092,8 +1142,7 @@ static int compute_bit_allocation(AC3EncodeContext *s)
 
         /* fallback 2: downgrade exponents */
         if (!downgrade_exponents(s)) {
-            extract_exponents(s);
-            encode_exponents(s);
+            encode_exponents(s, 0);
             group_exponents(s);
             ret = compute_bit_allocation(s);
             continue;
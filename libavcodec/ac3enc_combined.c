@@ -86,6 +86,7 @@ AVCodec ff_ac3_encoder = {
     encode_frame,
     encode_close,
     NULL,
+    .capabilities = CODEC_CAP_SLICE_THREADS,
     .sample_fmts = (const enum AVSampleFormat[]){
 #if CONFIG_AC3_FLOAT_ENCODER
         AV_SAMPLE_FMT_FLT,
@@ -134,6 +134,7 @@ AVCodec ff_ac3_fixed_encoder = {
     ff_ac3_encode_frame,
     ff_ac3_encode_close,
     NULL,
+    .capabilities = CODEC_CAP_SLICE_THREADS,
     .sample_fmts = (const enum AVSampleFormat[]){AV_SAMPLE_FMT_S16,AV_SAMPLE_FMT_NONE},
     .long_name = NULL_IF_CONFIG_SMALL("ATSC A/52A (AC-3)"),
     .priv_class = &ac3enc_class,
@@ -85,6 +85,21 @@ int64_t avcodec_guess_channel_layout(int nb_channels, enum CodecID codec_id, con
 struct AVAudioConvert;
 typedef struct AVAudioConvert AVAudioConvert;
 
+struct AVAudioConvert {
+    int in_channels, out_channels;
+    int fmt_pair;
+    int in_size, out_size;      ///< bytes per input and output sample
+    /**
+     * Convert contiguous samples of the format pair, NULL if there is no
+     * optimized version for it. There are no alignment constraints.
+     * @return number of samples converted; the remaining ones are
+     *         converted by the generic code
+     */
+    int (*conv_contiguous)(uint8_t *out, const uint8_t *in, int len);
+};
+
+void ff_audio_convert_init_x86(AVAudioConvert *ctx);
+
 /**
  * Create an audio sample format converter context
  * @param out_fmt Output sample format
@@ -29,6 +29,7 @@
 #include <errno.h>
 #include "libavutil/samplefmt.h"
 #include "libavutil/avutil.h"
+#include "libavutil/buffer.h"
 #include "libavutil/cpu.h"
 
 #include "libavcodec/version.h"
@@ -619,6 +620,7 @@ typedef struct RcOverride{
 #define CODEC_FLAG2_PSY           0x00080000 ///< Use psycho visual optimizations.
 #define CODEC_FLAG2_SSIM          0x00100000 ///< Compute SSIM during encoding, error[] values are undefined.
 #define CODEC_FLAG2_INTRA_REFRESH 0x00200000 ///< Use periodic insertion of intra blocks instead of keyframes.
+#define CODEC_FLAG2_BALANCED_SLICES 0x00400000 ///< Place the slices of the encoding threads by the cost of the last picture.
 
 /* Unsupported options :
  *              Syntax Arithmetic coding (SAC)
@@ -688,6 +690,11 @@ typedef struct RcOverride{
  * Codec supports slice-based (or partition-based) multithreading.
  */
 #define CODEC_CAP_SLICE_THREADS    0x2000
+/**
+ * Audio decoder returns AVFrames allocated with get_buffer(), the native
+ * way of avcodec_decode_audio4(). avcodec_decode_audio3() copies them.
+ */
+#define CODEC_CAP_AUDIO_FRAME      0x4000
 /**
  * Codec is lossless.
  */
@@ -1042,6 +1049,30 @@ typedef struct AVPanScan{
      * - decoding: Read by user.\
      */\
     int format;\
+\
+    /**\
+     * number of audio samples per channel of the frame\
+     * - encoding: unused\
+     * - decoding: Set by libavcodec before calling get_buffer(), read by user.\
+     */\
+    int nb_samples;\
+\
+    /**\
+     * 1 if the audio samples of each channel are stored in a separate\
+     * plane, 0 if they are interleaved in extended_data[0]\
+     * - encoding: unused\
+     * - decoding: Set by libavcodec before calling get_buffer(), read by user.\
+     */\
+    int planar;\
+\
+    /**\
+     * pointers to the audio samples, one per channel for planar audio,\
+     * only the first one is used for packed audio\
+     * data holds the first 4 of them as well. Unused for video.\
+     * - encoding: unused\
+     * - decoding: Set by get_buffer(), read by user.\
+     */\
+    uint8_t **extended_data;\
 
 
 #define FF_QSCALE_TYPE_MPEG1 0
@@ -1133,6 +1164,15 @@ typedef struct AVPacket {
      * subtitles are correctly displayed after seeking.
      */
     int64_t convergence_duration;
+
+    /**
+     * Reference to the buffer data points into, or NULL if the payload is
+     * not reference-counted. Only meaningful while data is set and destruct
+     * is av_destruct_packet, which then drops this reference instead of
+     * freeing data. The payload of a shared buffer is read-only, use
+     * av_packet_make_writable() before modifying it.
+     */
+    AVBufferRef *buf;
 } AVPacket;
 #define AV_PKT_FLAG_KEY   0x0001
 
@@ -1506,6 +1546,11 @@ typedef struct AVCodecContext {
      * If frame multithreading is used and thread_safe_callbacks is set,
      * it may be called from a different thread, but not from more than one at once.
      * Does not need to be reentrant.
+     *
+     * For audio, pic.nb_samples and pic.planar are set before the call,
+     * the buffer must hold that many samples of channels and sample_fmt
+     * and get_buffer() must set pic.extended_data and pic.linesize[0],
+     * the size of each plane in bytes.
      * - encoding: unused
      * - decoding: Set by libavcodec, user can override.
      */
@@ -2288,7 +2333,11 @@ typedef struct AVCodecContext {
 #define FF_LEVEL_UNKNOWN -99
 
     /**
-     * low resolution decoding, 1-> 1/2 size, 2->1/4 size
+     * low resolution decoding, 1-> 1/2 size, 2->1/4 size, 3->1/8 size
+     * Only supported up to AVCodec.max_lowres. The H.264 decoder skips the
+     * loop filter and approximates prediction at lowres, so its output
+     * only approximates a scaled down full size decode and drifts over
+     * each GOP.
      * - encoding: unused
      * - decoding: Set by user.
      */
@@ -2902,6 +2951,96 @@ typedef struct AVCodecContext {
     int64_t pts_correction_last_pts;       /// PTS of the last frame
     int64_t pts_correction_last_dts;       /// DTS of the last frame
 
+    /**
+     * Number of slice threads each frame thread may use.
+     * If greater than 1 and the codec supports both frame and slice
+     * threading, every frame thread gets its own pool of this many
+     * threads for execute() and execute2(), in addition to the
+     * thread_count frame threads.
+     * - encoding: unused
+     * - decoding: Set by user.
+     */
+    int slice_thread_count;
+
+    /**
+     * Shared pool of worker threads to run slice threading on.
+     * If set, execute() and execute2() jobs of this context are queued on
+     * the pool instead of private threads, with at most thread_count of
+     * them running at once. Frame threading is not used with a pool, as
+     * frame threads block waiting for the progress of each other and
+     * could leave every worker of the pool waiting; codecs supporting
+     * both fall back to slice threading, others run single threaded.
+     * The context holds a reference to the pool while it is open.
+     * @see avcodec_thread_pool_alloc()
+     * - encoding: Set by user.
+     * - decoding: Set by user.
+     */
+    struct AVCodecThreadPool *thread_pool;
+
+    /**
+     * Maximum number of frames of delay frame threading may add, or -1
+     * for no limit. With a limit of K, at most K+1 frame threads are
+     * used; if the codec also supports slice threading and
+     * slice_thread_count is not set, the remaining threads become slice
+     * threads inside each frame thread. A limit of 0 disables frame
+     * threading. thread_count and slice_thread_count are updated to
+     * the numbers actually used.
+     * - encoding: Set by user.
+     * - decoding: Set by user.
+     */
+    int max_thread_delay;
+
+    /**
+     * List of CPUs like "0-3,8" that the threads started by libavcodec
+     * may run on, or NULL for no restriction.
+     * - encoding: Set by user.
+     * - decoding: Set by user.
+     */
+    char *thread_affinity;
+
+    /**
+     * NUMA node whose CPUs the threads started by libavcodec may run on,
+     * or -1 for no restriction. If thread_affinity is also set, only the
+     * CPUs in both are used.
+     * Frame buffers from avcodec_default_get_buffer() are then usually
+     * allocated on that node as well.
+     * - encoding: Set by user.
+     * - decoding: Set by user.
+     */
+    int thread_numa_node;
+
+    /**
+     * If set, run the loop filter on a separate thread, a few macroblock
+     * rows behind the decoding. Progress and draw_horiz_band() then follow
+     * the deblocked rows, so draw_horiz_band() is called from that thread.
+     * Currently only used by the H.264 decoder, for progressive pictures
+     * decoded without slice threads.
+     * - encoding: unused
+     * - decoding: Set by user.
+     */
+    int deblock_thread;
+
+    /**
+     * Number of levels of the low resolution motion pre-search, 0 to
+     * disable it. The pre-search is done once per picture and reference
+     * on a pyramid of half (and quarter) resolution luma. Its vectors are
+     * an additional candidate of the motion search, which helps with
+     * motion larger than the predictors and the diamond can find.
+     * - encoding: Set by user.
+     * - decoding: unused
+     */
+    int me_presearch;
+
+    /**
+     * Number of decoded pictures kept queued, in addition to the reordering
+     * delay, before a picture decoded with a hwaccel is returned. The GPU
+     * decodes the queued pictures while the application waits for the
+     * returned surface. The application must allocate as many additional
+     * surfaces. Currently only used by the H.264 decoder.
+     * - encoding: unused
+     * - decoding: Set by user.
+     */
+    int hwaccel_async_depth;
 
 } AVCodecContext;
 
@@ -3204,6 +3343,23 @@ int av_grow_packet(AVPacket *pkt, int grow_by);
  */
 int av_dup_packet(AVPacket *pkt);
 
+/**
+ * Set dst to a new reference to the packet src. If the payload of src is
+ * reference-counted, dst shares it without copying, otherwise it is copied
+ * into a new buffer. The side data are always copied.
+ *
+ * @return 0 on success, a negative AVERROR on failure
+ */
+int av_packet_ref(AVPacket *dst, const AVPacket *src);
+
+/**
+ * Ensure the payload of pkt is owned by the packet alone and may be
+ * modified, copying it if it is shared with other packets or not owned.
+ *
+ * @return 0 on success, a negative AVERROR on failure
+ */
+int av_packet_make_writable(AVPacket *pkt);
+
 /**
  * Free a packet.
  *
@@ -3680,6 +3836,31 @@ attribute_deprecated
 int avcodec_thread_init(AVCodecContext *s, int thread_count);
 #endif
 
+/**
+ * Allocate a pool of worker threads which can be shared by several
+ * codec contexts through AVCodecContext.thread_pool.
+ *
+ * @param thread_count number of worker threads to start
+ * @return the pool with one reference owned by the caller,
+ *         or NULL on failure or if threads are not supported
+ */
+struct AVCodecThreadPool *avcodec_thread_pool_alloc(int thread_count);
+
+/**
+ * Release a reference to a thread pool and set the pointer to NULL.
+ * The threads are stopped once the last context using the pool is closed.
+ */
+void avcodec_thread_pool_unref(struct AVCodecThreadPool **pool);
+
+/**
+ * Get the AVThreadPool the codecs using pool run on, to share its
+ * threads with other libraries, e.g. through AVFilterGraph.thread_pool
+ * or sws_set_thread_pool().
+ *
+ * @return the pool, without a new reference, or NULL if pool is NULL
+ */
+struct AVThreadPool *avcodec_thread_pool_get(struct AVCodecThreadPool *pool);
+
 int avcodec_default_execute(AVCodecContext *c, int (*func)(AVCodecContext *c2, void *arg2),void *arg, int *ret, int count, int size);
 int avcodec_default_execute2(AVCodecContext *c, int (*func)(AVCodecContext *c2, void *arg2, int, int),void *arg, int *ret, int count);
 //FIXME func typedef
@@ -3756,6 +3937,32 @@ int avcodec_decode_audio3(AVCodecContext *avctx, int16_t *samples,
                          int *frame_size_ptr,
                          AVPacket *avpkt);
 
+/**
+ * Decode the audio frame of size avpkt->size from avpkt->data into frame.
+ * Like avcodec_decode_audio3(), only the first frame of a packet holding
+ * several is decoded and the function has to be called again with the
+ * rest of the packet.
+ *
+ * The samples are in the native format of the decoder, avctx->sample_fmt,
+ * and are stored in frame->extended_data, one plane per channel if
+ * frame->planar is set. The buffer is allocated with avctx->get_buffer(),
+ * so no fixed size output buffer is needed; it must be released with
+ * avctx->release_buffer() once the samples are no longer used.
+ *
+ * @warning The input buffer requirements of avcodec_decode_audio3() apply.
+ *
+ * @param avctx the codec context
+ * @param[out] frame the AVFrame in which the samples are returned,
+ *             reset with avcodec_get_frame_defaults() before each call
+ * @param[out] got_frame_ptr zero if no frame could be decoded, otherwise
+ *             nonzero
+ * @param[in] avpkt The input AVPacket containing the input buffer.
+ * @return On error a negative value is returned, otherwise the number of bytes
+ * used or zero if no frame data was decompressed (used) from the input AVPacket.
+ */
+int avcodec_decode_audio4(AVCodecContext *avctx, AVFrame *frame,
+                          int *got_frame_ptr, AVPacket *avpkt);
+
 /**
  * Decode the video frame of size avpkt->size from avpkt->data into picture.
  * Some decoders may support multiple frames in a single AVPacket, such
@@ -4127,6 +4334,15 @@ typedef struct AVBitStreamFilter {
                   const uint8_t *buf, int buf_size, int keyframe);
     void (*close)(AVBitStreamFilterContext *bsfc);
     struct AVBitStreamFilter *next;
+    /**
+     * Filter buf in place, for filters which only rewrite headers and
+     * keep the size of the data. Optional.
+     * @return 1 if buf was filtered, 0 if the packet needs the filter()
+     * callback, a negative error code on failure
+     */
+    int (*filter_inplace)(AVBitStreamFilterContext *bsfc,
+                          AVCodecContext *avctx, const char *args,
+                          uint8_t *buf, int buf_size, int keyframe);
 } AVBitStreamFilter;
 
 void av_register_bitstream_filter(AVBitStreamFilter *bsf);
@@ -4135,6 +4351,22 @@ int av_bitstream_filter_filter(AVBitStreamFilterContext *bsfc,
                                AVCodecContext *avctx, const char *args,
                                uint8_t **poutbuf, int *poutbuf_size,
                                const uint8_t *buf, int buf_size, int keyframe);
+
+/**
+ * Filter the payload of a packet, replacing it with the filtered data.
+ *
+ * The payload is filtered in place when the filter supports it and the
+ * packet is writable, it is not copied at all then. Otherwise, the output
+ * goes to a reference-counted buffer, taken from a small pool kept by the
+ * filter context and reused once the packets using it have been freed.
+ * The side data of the packet are kept.
+ *
+ * @return 0 on success, a negative error code on failure, pkt is left
+ * unchanged then
+ */
+int av_bitstream_filter_filter_packet(AVBitStreamFilterContext *bsfc,
+                                      AVCodecContext *avctx, const char *args,
+                                      AVPacket *pkt);
 void av_bitstream_filter_close(AVBitStreamFilterContext *bsf);
 
 AVBitStreamFilter *av_bitstream_filter_next(AVBitStreamFilter *f);
@@ -21,11 +21,24 @@
 
 #include "avcodec.h"
 #include "libavutil/avassert.h"
+#include "libavutil/buffer.h"
 #include "bytestream.h"
 
+/**
+ * @return 1 if the packet owns a reference to the buffer data belongs to
+ *
+ * Packets are commonly handed over by copying the struct and clearing data
+ * in the original, so buf is ignored when data is not set.
+ */
+static int packet_has_buf(const AVPacket *pkt)
+{
+    return pkt->buf && pkt->data && pkt->destruct == av_destruct_packet;
+}
+
 void av_destruct_packet_nofree(AVPacket *pkt)
 {
     pkt->data = NULL; pkt->size = 0;
+    pkt->buf  = NULL;
     pkt->side_data       = NULL;
     pkt->side_data_elems = 0;
 }
@@ -34,7 +47,11 @@ void av_destruct_packet(AVPacket *pkt)
 {
     int i;
 
-    av_free(pkt->data);
+    if (pkt->buf && pkt->data)
+        av_buffer_unref(&pkt->buf);
+    else
+        av_free(pkt->data);
+    pkt->buf  = NULL;
     pkt->data = NULL; pkt->size = 0;
 
     for (i = 0; i < pkt->side_data_elems; i++)
@@ -53,25 +70,50 @@ void av_init_packet(AVPacket *pkt)
     pkt->flags = 0;
     pkt->stream_index = 0;
     pkt->destruct= NULL;
+    pkt->buf     = NULL;
     pkt->side_data       = NULL;
     pkt->side_data_elems = 0;
 }
 
+/**
+ * Allocate a padded buffer for size bytes of payload.
+ */
+static AVBufferRef *packet_alloc(int size)
+{
+    AVBufferRef *buf;
+    if ((unsigned)size >= (unsigned)size + FF_INPUT_BUFFER_PADDING_SIZE)
+        return NULL;
+    buf = av_buffer_alloc(size + FF_INPUT_BUFFER_PADDING_SIZE);
+    if (buf)
+        memset(buf->data + size, 0, FF_INPUT_BUFFER_PADDING_SIZE);
+    return buf;
+}
+
+/**
+ * Point pkt to a new padded buffer holding a copy of data.
+ * pkt is left untouched on failure.
+ */
+static int copy_data(AVPacket *pkt, const uint8_t *data, int size)
+{
+    AVBufferRef *buf = packet_alloc(size);
+    if (!buf)
+        return AVERROR(ENOMEM);
+    memcpy(buf->data, data, size);
+    pkt->buf  = buf;
+    pkt->data = buf->data;
+    return 0;
+}
+
 int av_new_packet(AVPacket *pkt, int size)
 {
-    uint8_t *data= NULL;
-    if((unsigned)size < (unsigned)size + FF_INPUT_BUFFER_PADDING_SIZE)
-        data = av_malloc(size + FF_INPUT_BUFFER_PADDING_SIZE);
-    if (data){
-        memset(data + size, 0, FF_INPUT_BUFFER_PADDING_SIZE);
-    }else
-        size=0;
+    AVBufferRef *buf = packet_alloc(size);
 
     av_init_packet(pkt);
-    pkt->data = data;
-    pkt->size = size;
+    pkt->buf  = buf;
+    pkt->data = buf ? buf->data : NULL;
+    pkt->size = buf ? size : 0;
     pkt->destruct = av_destruct_packet;
-    if(!data)
+    if(!buf)
         return AVERROR(ENOMEM);
     return 0;
 }
@@ -80,6 +122,9 @@ void av_shrink_packet(AVPacket *pkt, int size)
 {
     if (pkt->size <= size) return;
     pkt->size = size;
+    /* do not clobber the payload other references still see */
+    if (packet_has_buf(pkt) && av_packet_make_writable(pkt) < 0)
+        return;
     memset(pkt->data + size, 0, FF_INPUT_BUFFER_PADDING_SIZE);
 }
 
@@ -91,6 +136,23 @@ int av_grow_packet(AVPacket *pkt, int grow_by)
         return av_new_packet(pkt, grow_by);
     if ((unsigned)grow_by > INT_MAX - (pkt->size + FF_INPUT_BUFFER_PADDING_SIZE))
         return -1;
+    if (packet_has_buf(pkt)) {
+        int ret;
+        if (pkt->data != pkt->buf->data) {
+            /* only the buffer start can be reallocated */
+            AVBufferRef *old_buf = pkt->buf;
+            if ((ret = copy_data(pkt, pkt->data, pkt->size)) < 0)
+                return ret;
+            av_buffer_unref(&old_buf);
+        }
+        ret = av_buffer_realloc(&pkt->buf, pkt->size + grow_by + FF_INPUT_BUFFER_PADDING_SIZE);
+        if (ret < 0)
+            return ret;
+        pkt->data  = pkt->buf->data;
+        pkt->size += grow_by;
+        memset(pkt->data + pkt->size, 0, FF_INPUT_BUFFER_PADDING_SIZE);
+        return 0;
+    }
     new_ptr = av_realloc(pkt->data, pkt->size + grow_by + FF_INPUT_BUFFER_PADDING_SIZE);
     if (!new_ptr)
         return AVERROR(ENOMEM);
@@ -118,6 +180,34 @@ int av_grow_packet(AVPacket *pkt, int grow_by)
         dst = data; \
     } while(0)
 
+/**
+ * Replace the side data of pkt, which are shared with src, by copies.
+ * On failure, the side data copied so far are left in pkt.
+ */
+static int copy_side_data(AVPacket *pkt, const AVPacket *src)
+{
+    int i;
+
+    pkt->side_data = NULL;
+    if (!pkt->side_data_elems)
+        return 0;
+
+    DUP_DATA(pkt->side_data, src->side_data,
+             pkt->side_data_elems * sizeof(*pkt->side_data), 0);
+    memset(pkt->side_data, 0, pkt->side_data_elems * sizeof(*pkt->side_data));
+    for (i = 0; i < pkt->side_data_elems; i++) {
+        DUP_DATA(pkt->side_data[i].data, src->side_data[i].data,
+                 src->side_data[i].size, 1);
+        pkt->side_data[i].size = src->side_data[i].size;
+        pkt->side_data[i].type = src->side_data[i].type;
+    }
+    return 0;
+failed_alloc:
+    if (!pkt->side_data)
+        pkt->side_data_elems = 0;
+    return AVERROR(ENOMEM);
+}
+
 int av_dup_packet(AVPacket *pkt)
 {
     AVPacket tmp_pkt;
@@ -126,33 +216,80 @@ int av_dup_packet(AVPacket *pkt)
         tmp_pkt = *pkt;
 
         pkt->data      = NULL;
+        pkt->buf       = NULL;
         pkt->side_data = NULL;
-        DUP_DATA(pkt->data, tmp_pkt.data, pkt->size, 1);
-        pkt->destruct = av_destruct_packet;
+        pkt->destruct  = av_destruct_packet;
+        if (copy_data(pkt, tmp_pkt.data, pkt->size) < 0 ||
+            copy_side_data(pkt, &tmp_pkt) < 0)
+            goto failed_alloc;
+    }
+    return 0;
+failed_alloc:
+    av_destruct_packet(pkt);
+    return AVERROR(ENOMEM);
+}
 
-        if (pkt->side_data_elems) {
-            int i;
+int av_packet_ref(AVPacket *dst, const AVPacket *src)
+{
+    *dst = *src;
+    dst->side_data = NULL;
+    dst->destruct  = av_destruct_packet;
 
-            DUP_DATA(pkt->side_data, tmp_pkt.side_data,
-                     pkt->side_data_elems * sizeof(*pkt->side_data), 0);
-            memset(pkt->side_data, 0, pkt->side_data_elems * sizeof(*pkt->side_data));
-            for (i = 0; i < pkt->side_data_elems; i++) {
-                DUP_DATA(pkt->side_data[i].data, tmp_pkt.side_data[i].data,
-                         pkt->side_data[i].size, 1);
-            }
+    if (packet_has_buf(src)) {
+        if (!(dst->buf = av_buffer_ref(src->buf))) {
+            dst->data = NULL;
+            goto failed_alloc;
         }
+    } else {
+        dst->data = NULL;
+        dst->buf  = NULL;
+        if (src->data && copy_data(dst, src->data, src->size) < 0)
+            goto failed_alloc;
     }
+    if (copy_side_data(dst, src) < 0)
+        goto failed_alloc;
     return 0;
 failed_alloc:
-    av_destruct_packet(pkt);
+    av_destruct_packet(dst);
+    dst->destruct = NULL;
     return AVERROR(ENOMEM);
 }
 
+int av_packet_make_writable(AVPacket *pkt)
+{
+    AVBufferRef *old_buf = packet_has_buf(pkt) ? pkt->buf : NULL;
+
+    if (old_buf ? av_buffer_is_writable(old_buf) :
+                  pkt->destruct == av_destruct_packet)
+        return 0;
+    if (!pkt->data)
+        return 0;
+
+    if (old_buf) {
+        if (copy_data(pkt, pkt->data, pkt->size) < 0)
+            return AVERROR(ENOMEM);
+        av_buffer_unref(&old_buf);
+    } else {
+        /* the data is not owned, or owned through a custom destruct */
+        AVPacket old = *pkt;
+        if (copy_data(pkt, old.data, old.size) < 0)
+            return AVERROR(ENOMEM);
+        pkt->destruct = av_destruct_packet;
+
+        /* release the old data only, the side data now belong to pkt */
+        old.side_data       = NULL;
+        old.side_data_elems = 0;
+        av_free_packet(&old);
+    }
+    return 0;
+}
+
 void av_free_packet(AVPacket *pkt)
 {
     if (pkt) {
         if (pkt->destruct) pkt->destruct(pkt);
         pkt->data = NULL; pkt->size = 0;
+        pkt->buf  = NULL;
         pkt->side_data       = NULL;
         pkt->side_data_elems = 0;
     }
@@ -210,10 +347,12 @@ int av_packet_merge_side_data(AVPacket *pkt){
         }
         if (size > INT_MAX)
             return AVERROR(EINVAL);
-        p = av_malloc(size);
-        if (!p)
+        pkt->buf = av_buffer_alloc(size);
+        if (!pkt->buf) {
+            pkt->buf = old.buf;
             return AVERROR(ENOMEM);
-        pkt->data = p;
+        }
+        pkt->data = p = pkt->buf->data;
         pkt->destruct = av_destruct_packet;
         pkt->size = size - FF_INPUT_BUFFER_PADDING_SIZE;
         bytestream_put_buffer(&p, old.data, old.size);
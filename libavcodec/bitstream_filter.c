@@ -19,6 +19,17 @@
  */
 
 #include "avcodec.h"
+#include "internal.h"
+#include "libavutil/buffer.h"
+
+#define BSF_POOL_SIZE 8
+
+typedef struct BSFInternal {
+    AVBitStreamFilterContext ctx;      ///< public context, must be first
+    AVBufferRef *pool[BSF_POOL_SIZE];  ///< output buffers, free once the pool holds their only reference
+    AVBufferRef *out_buf;              ///< buffer last returned by ff_bsf_get_buffer()
+    int packet_mode;                   ///< set while av_bitstream_filter_filter_packet() runs the filter
+} BSFInternal;
 
 static AVBitStreamFilter *first_bitstream_filter= NULL;
 
@@ -37,7 +48,8 @@ AVBitStreamFilterContext *av_bitstream_filter_init(const char *name){
 
     while(bsf){
         if(!strcmp(name, bsf->name)){
-            AVBitStreamFilterContext *bsfc= av_mallocz(sizeof(AVBitStreamFilterContext));
+            BSFInternal *bsfi= av_mallocz(sizeof(BSFInternal));
+            AVBitStreamFilterContext *bsfc= &bsfi->ctx;
             bsfc->filter= bsf;
             bsfc->priv_data= av_mallocz(bsf->priv_data_size);
             return bsfc;
@@ -48,8 +60,15 @@ AVBitStreamFilterContext *av_bitstream_filter_init(const char *name){
 }
 
 void av_bitstream_filter_close(AVBitStreamFilterContext *bsfc){
+    BSFInternal *bsfi= (BSFInternal *)bsfc;
+    int i;
+
     if(bsfc->filter->close)
         bsfc->filter->close(bsfc);
+    /* buffers still used by packets are freed with them */
+    for(i=0; i<BSF_POOL_SIZE; i++)
+        av_buffer_unref(&bsfi->pool[i]);
+    av_buffer_unref(&bsfi->out_buf);
     av_freep(&bsfc->priv_data);
     av_parser_close(bsfc->parser);
     av_free(bsfc);
@@ -63,3 +82,145 @@ int av_bitstream_filter_filter(AVBitStreamFilterContext *bsfc,
     *poutbuf_size= buf_size;
     return bsfc->filter->filter(bsfc, avctx, args, poutbuf, poutbuf_size, buf, buf_size, keyframe);
 }
+
+uint8_t *ff_bsf_get_buffer(AVBitStreamFilterContext *bsfc, int size){
+    BSFInternal *bsfi= (BSFInternal *)bsfc;
+    int total= size + FF_INPUT_BUFFER_PADDING_SIZE;
+    int i, found= -1, spare= -1;
+    uint8_t *buf;
+
+    if(size < 0 || size > INT_MAX - FF_INPUT_BUFFER_PADDING_SIZE)
+        return NULL;
+
+    if(!bsfi->packet_mode){
+        buf= av_malloc(total);
+        if(buf)
+            memset(buf + size, 0, FF_INPUT_BUFFER_PADDING_SIZE);
+        return buf;
+    }
+
+    av_buffer_unref(&bsfi->out_buf);
+    for(i=0; i<BSF_POOL_SIZE; i++){
+        AVBufferRef *b= bsfi->pool[i];
+        if(b && !av_buffer_is_writable(b))
+            continue; /* still used by a packet */
+        if(b && b->size >= total){
+            found= i;
+            break;
+        }
+        spare= i;
+    }
+    if(found < 0){
+        AVBufferRef *b= av_buffer_alloc(total);
+        if(!b)
+            return NULL;
+        if(spare < 0){
+            /* every pooled buffer is in use, this one is not kept */
+            bsfi->out_buf= b;
+            goto done;
+        }
+        av_buffer_unref(&bsfi->pool[spare]);
+        bsfi->pool[spare]= b;
+        found= spare;
+    }
+    if(!(bsfi->out_buf= av_buffer_ref(bsfi->pool[found])))
+        return NULL;
+done:
+    memset(bsfi->out_buf->data + size, 0, FF_INPUT_BUFFER_PADDING_SIZE);
+    return bsfi->out_buf->data;
+}
+
+static int packet_is_writable(const AVPacket *pkt){
+    if(pkt->destruct != av_destruct_packet)
+        return 0;
+    return !pkt->buf || av_buffer_is_writable(pkt->buf);
+}
+
+/* replace the payload of pkt, keeping its side data */
+static void packet_set_payload(AVPacket *pkt, AVBufferRef *buf,
+                               uint8_t *data, int size){
+    AVPacket old= *pkt;
+
+    old.side_data      = NULL;
+    old.side_data_elems= 0;
+    av_free_packet(&old);
+
+    pkt->buf     = buf;
+    pkt->data    = data;
+    pkt->size    = size;
+    pkt->destruct= av_destruct_packet;
+}
+
+int av_bitstream_filter_filter_packet(AVBitStreamFilterContext *bsfc,
+                                      AVCodecContext *avctx, const char *args,
+                                      AVPacket *pkt){
+    BSFInternal *bsfi= (BSFInternal *)bsfc;
+    AVBitStreamFilter *filter= bsfc->filter;
+    int keyframe= pkt->flags & AV_PKT_FLAG_KEY;
+    AVBufferRef *buf;
+    uint8_t *out;
+    int out_size, ret;
+
+    if(filter->filter_inplace && pkt->data){
+        if(packet_is_writable(pkt)){
+            ret= filter->filter_inplace(bsfc, avctx, args, pkt->data, pkt->size, keyframe);
+            if(ret)
+                return FFMIN(ret, 0);
+        }else{
+            /* a pooled copy is still cheaper than what filter() allocates */
+            bsfi->packet_mode= 1;
+            out= ff_bsf_get_buffer(bsfc, pkt->size);
+            bsfi->packet_mode= 0;
+            if(!out)
+                return AVERROR(ENOMEM);
+            memcpy(out, pkt->data, pkt->size);
+            ret= filter->filter_inplace(bsfc, avctx, args, out, pkt->size, keyframe);
+            if(ret > 0){
+                packet_set_payload(pkt, bsfi->out_buf, out, pkt->size);
+                bsfi->out_buf= NULL;
+                return 0;
+            }
+            av_buffer_unref(&bsfi->out_buf);
+            if(ret < 0)
+                return ret;
+        }
+    }
+
+    bsfi->packet_mode= 1;
+    ret= av_bitstream_filter_filter(bsfc, avctx, args, &out, &out_size,
+                                    pkt->data, pkt->size, keyframe);
+    bsfi->packet_mode= 0;
+    if(ret < 0){
+        av_buffer_unref(&bsfi->out_buf);
+        return ret;
+    }
+
+    if(ret > 0){
+        if(bsfi->out_buf && out == bsfi->out_buf->data){
+            buf= bsfi->out_buf;
+            bsfi->out_buf= NULL;
+        }else{
+            av_buffer_unref(&bsfi->out_buf);
+            buf= av_buffer_create(out, out_size, NULL, NULL, 0);
+            if(!buf){
+                av_free(out);
+                return AVERROR(ENOMEM);
+            }
+        }
+        packet_set_payload(pkt, buf, out, out_size);
+    }else if(out != pkt->data || out_size != pkt->size){
+        /* the output points into the input, e.g. with a header stripped */
+        if(pkt->buf && pkt->destruct == av_destruct_packet &&
+           out >= pkt->buf->data && out + out_size <= pkt->buf->data + pkt->buf->size){
+            pkt->data= out;
+            pkt->size= out_size;
+        }else{
+            if(!(buf= av_buffer_alloc(out_size + FF_INPUT_BUFFER_PADDING_SIZE)))
+                return AVERROR(ENOMEM);
+            memcpy(buf->data, out, out_size);
+            memset(buf->data + out_size, 0, FF_INPUT_BUFFER_PADDING_SIZE);
+            packet_set_payload(pkt, buf, buf->data, out_size);
+        }
+    }
+    return 0;
+}
@@ -294,7 +294,11 @@ static void refill2(CABACContext *c){
     int i, x;
 
     x= c->low ^ (c->low-1);
+#if HAVE_FAST_CLZ
+    i= av_log2(x) - CABAC_BITS;
+#else
     i= 7 - ff_h264_norm_shift[x>>(CABAC_BITS-1)];
+#endif
 
     x= -CABAC_MASK;
 
@@ -323,7 +327,11 @@ static av_always_inline int get_cabac_inline(CABACContext *c, uint8_t * const st
     *state= (ff_h264_mlps_state+128)[s];
     bit= s&1;
 
+#if HAVE_FAST_CLZ
+    lps_mask= 8 - av_log2(c->range);
+#else
     lps_mask= ff_h264_norm_shift[c->range];
+#endif
     c->range<<= lps_mask;
     c->low  <<= lps_mask;
     if(!(c->low & CABAC_MASK))
@@ -341,19 +349,18 @@ static int av_unused get_cabac(CABACContext *c, uint8_t * const state){
 }
 
 static int av_unused get_cabac_bypass(CABACContext *c){
-    int range;
+    int range, mask;
     c->low += c->low;
 
     if(!(c->low & CABAC_MASK))
         refill(c);
 
+    /* bypass bits are close to random, so do not branch on them */
     range= c->range<<(CABAC_BITS+1);
-    if(c->low < range){
-        return 0;
-    }else{
-        c->low -= range;
-        return 1;
-    }
+    c->low -= range;
+    mask= c->low >> 31;
+    c->low += range & mask;
+    return mask + 1;
 }
 
 
@@ -885,10 +885,8 @@ static void qmf_32_subbands(DCAContext * s, int chans,
                             float scale)
 {
     const float *prCoeff;
-    int i;
 
     int sb_act = s->subband_activity[chans];
-    int subindex;
 
     scale *= sqrt(1/8.0);
 
@@ -898,23 +896,10 @@ static void qmf_32_subbands(DCAContext * s, int chans,
     else                        /* Perfect reconstruction */
         prCoeff = fir_32bands_perfect;
 
-    /* Reconstructed channel sample index */
-    for (subindex = 0; subindex < 8; subindex++) {
-        /* Load in one sample from each subband and clear inactive subbands */
-        for (i = 0; i < sb_act; i++){
-            uint32_t v = AV_RN32A(&samples_in[i][subindex]) ^ ((i-1)&2)<<30;
-            AV_WN32A(&s->raXin[i], v);
-        }
-        for (; i < 32; i++)
-            s->raXin[i] = 0.0;
-
-        s->synth.synth_filter_float(&s->imdct,
+    s->dcadsp.qmf_32_subbands(samples_in, sb_act, &s->synth, &s->imdct,
                               s->subband_fir_hist[chans], &s->hist_index[chans],
                               s->subband_fir_noidea[chans], prCoeff,
                               samples_out, s->raXin, scale);
-        samples_out+= 32;
-
-    }
 }
 
 static void lfe_interpolation_fir(DCAContext *s, int decimation_select,
@@ -1615,23 +1600,22 @@ static void dca_exss_parse_header(DCAContext *s)
  * FIXME add arguments
  */
 static int dca_decode_frame(AVCodecContext * avctx,
-                            void *data, int *data_size,
+                            void *data, int *got_frame_ptr,
                             AVPacket *avpkt)
 {
+    AVFrame *frame = data;
     const uint8_t *buf = avpkt->data;
     int buf_size = avpkt->size;
 
     int lfe_samples;
     int num_core_channels = 0;
-    int i;
-    float   *samples_flt = data;
-    int16_t *samples_s16 = data;
-    int out_size;
+    int i, ch, ret;
     DCAContext *s = avctx->priv_data;
     int channels;
     int core_ss_end;
 
 
+    *got_frame_ptr = 0;
     s->xch_present = 0;
 
     s->dca_buffer_size = dca_convert_bitstream(buf, buf_size, s->dca_buffer,
@@ -1644,7 +1628,6 @@ static int dca_decode_frame(AVCodecContext * avctx,
     init_get_bits(&s->gb, s->dca_buffer, s->dca_buffer_size * 8);
     if (dca_parse_frame_header(s) < 0) {
         //seems like the frame is corrupt, try with the next one
-        *data_size=0;
         return buf_size;
     }
     //set AVCodec values with parsed data
@@ -1816,11 +1799,12 @@ static int dca_decode_frame(AVCodecContext * avctx,
         return -1;
     }
 
-    out_size = 256 / 8 * s->sample_blocks * channels *
-               av_get_bytes_per_sample(avctx->sample_fmt);
-    if (*data_size < out_size)
-        return -1;
-    *data_size = out_size;
+    frame->nb_samples = 256 / 8 * s->sample_blocks;
+    frame->planar     = 1;
+    if ((ret = avctx->get_buffer(avctx, frame)) < 0) {
+        av_log(avctx, AV_LOG_ERROR, "get_buffer() failed\n");
+        return ret;
+    }
 
     /* filter to get final output */
     for (i = 0; i < (s->sample_blocks / 8); i++) {
@@ -1839,17 +1823,16 @@ static int dca_decode_frame(AVCodecContext * avctx,
             }
         }
 
-        if (avctx->sample_fmt == AV_SAMPLE_FMT_FLT) {
-            s->fmt_conv.float_interleave(samples_flt, s->samples_chanptr, 256,
-                                         channels);
-            samples_flt += 256 * channels;
-        } else {
-            s->fmt_conv.float_to_int16_interleave(samples_s16,
-                                                  s->samples_chanptr, 256,
-                                                  channels);
-            samples_s16 += 256 * channels;
+        for (ch = 0; ch < channels; ch++) {
+            if (avctx->sample_fmt == AV_SAMPLE_FMT_FLT)
+                memcpy((float *)frame->extended_data[ch] + i * 256,
+                       s->samples_chanptr[ch], 256 * sizeof(float));
+            else
+                s->fmt_conv.float_to_int16((int16_t *)frame->extended_data[ch] + i * 256,
+                                           s->samples_chanptr[ch], 256);
         }
     }
+    *got_frame_ptr = 1;
 
     /* update lfe history */
     lfe_samples = 2 * s->lfe * (s->sample_blocks / 8);
@@ -1927,7 +1910,7 @@ AVCodec ff_dca_decoder = {
     .decode = dca_decode_frame,
     .close = dca_decode_end,
     .long_name = NULL_IF_CONFIG_SMALL("DCA (DTS Coherent Acoustics)"),
-    .capabilities = CODEC_CAP_CHANNEL_CONF,
+    .capabilities = CODEC_CAP_CHANNEL_CONF | CODEC_CAP_AUDIO_FRAME,
     .sample_fmts = (const enum AVSampleFormat[]) {
         AV_SAMPLE_FMT_FLT, AV_SAMPLE_FMT_S16, AV_SAMPLE_FMT_NONE
     },
@@ -72,7 +72,7 @@ struct algo {
   enum { FDCT, IDCT } is_idct;
   void (* func) (DCTELEM *block);
   void (* ref)  (DCTELEM *block);
-  enum formattag { NO_PERM,MMX_PERM, MMX_SIMPLE_PERM, SCALE_PERM, SSE2_PERM, PARTTRANS_PERM } format;
+  enum formattag { NO_PERM,MMX_PERM, MMX_SIMPLE_PERM, SCALE_PERM, SSE2_PERM, PARTTRANS_PERM, TRANSPOSE_PERM } format;
   int  mm_support;
 };
 
@@ -106,6 +106,7 @@ struct algo algos[] = {
   {"LIBMPEG2-MMX2",   1, ff_mmxext_idct,     ff_ref_idct, MMX_PERM, AV_CPU_FLAG_MMX2},
 #endif
   {"SIMPLE-MMX",      1, ff_simple_idct_mmx, ff_ref_idct, MMX_SIMPLE_PERM, AV_CPU_FLAG_MMX},
+  {"SIMPLE-SSE2",     1, ff_simple_idct_sse2, ff_ref_idct, TRANSPOSE_PERM, AV_CPU_FLAG_SSE2},
   {"XVID-MMX",        1, ff_idct_xvid_mmx,   ff_ref_idct, NO_PERM, AV_CPU_FLAG_MMX},
   {"XVID-MMX2",       1, ff_idct_xvid_mmx2,  ff_ref_idct, NO_PERM, AV_CPU_FLAG_MMX2},
   {"XVID-SSE2",       1, ff_idct_xvid_sse2,  ff_ref_idct, SSE2_PERM, AV_CPU_FLAG_SSE2},
@@ -261,6 +262,9 @@ static void dct_error(const char *name, int is_idct,
         } else if (form == PARTTRANS_PERM) {
             for(i=0; i<64; i++)
                 block[(i&0x24) | ((i&3)<<3) | ((i>>3)&3)] = block1[i];
+        } else if (form == TRANSPOSE_PERM) {
+            for(i=0; i<64; i++)
+                block[((i&7)<<3) | (i>>3)] = block1[i];
         } else {
             for(i=0; i<64; i++)
                 block[i]= block1[i];
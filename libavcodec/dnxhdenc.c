@@ -23,6 +23,7 @@
 
 //#define DEBUG
 #define RC_VARIANCE 1 // use variance or ssd for fast rc
+#define BITSTREAM_WRITER_64
 
 #include "libavutil/opt.h"
 #include "avcodec.h"
@@ -869,7 +870,7 @@ AVCodec ff_dnxhd_encoder = {
     dnxhd_encode_init,
     dnxhd_encode_picture,
     dnxhd_encode_end,
-    .capabilities = CODEC_CAP_SLICE_THREADS,
+    .capabilities = CODEC_CAP_SLICE_THREADS | CODEC_CAP_FRAME_THREADS,
     .pix_fmts = (const enum PixelFormat[]){PIX_FMT_YUV422P, PIX_FMT_NONE},
     .long_name = NULL_IF_CONFIG_SMALL("VC3/DNxHD"),
     .priv_class = &class,
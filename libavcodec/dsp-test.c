@@ -0,0 +1,1699 @@
+/*
+ * DSP function tables test and benchmark
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * DSP function tables test and benchmark.
+ * Each function of the tables is initialized once per CPU flag level; every
+ * version that differs from the C one is checked against it on random data
+ * and, with -b, timed.
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "libavutil/cpu.h"
+#include "libavutil/internal.h"
+#include "libavutil/lfg.h"
+#include "libavutil/timer.h"
+#include "avcodec.h"
+#include "dsputil.h"
+#include "fmtconvert.h"
+#include "ac3dsp.h"
+#include "h264dsp.h"
+#include "h264pred.h"
+#include "vp8dsp.h"
+
+#undef printf
+#undef exit
+
+#define CHECK_RUNS  16
+#define BENCH_RUNS  64
+#define BENCH_CALLS 16
+
+#define STRIDE  64
+#define BUF_SIZE (STRIDE * 64)
+/* offset of the blocks in the pixel buffers, with room for the edges the
+ * functions read or write around them, 16-byte aligned */
+#define PIX_OFFSET (16 * STRIDE + 16)
+
+#ifdef AV_READ_TIME
+#define READ_TIME  AV_READ_TIME
+#define TIME_UNIT "cycles"
+#else
+static int64_t gettime(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+#define READ_TIME  gettime
+#define TIME_UNIT "us"
+#endif
+
+typedef struct DSPTestContexts {
+    DSPContext        dsp;
+    FmtConvertContext fmt_conv;
+#if CONFIG_AC3DSP
+    AC3DSPContext     ac3dsp;
+#endif
+#if CONFIG_H264DSP
+    H264DSPContext    h264dsp;
+#endif
+#if CONFIG_H264PRED
+    H264PredContext   h264pred;
+#endif
+#if CONFIG_VP8_DECODER
+    VP8DSPContext     vp8dsp;
+#endif
+} DSPTestContexts;
+
+typedef void (*generic_func)(void);
+
+struct DSPTestEntry;
+
+/**
+ * Check a function against the reference one.
+ * @param t_ref,t_new if not NULL, set to the time per call of each function
+ * @return 0 if the results are the same, nonzero otherwise
+ */
+typedef int (*check_func)(const struct DSPTestEntry *e, generic_func ref,
+                          generic_func new, double *t_ref, double *t_new);
+
+typedef struct DSPTestEntry {
+    char name[32];
+    size_t offset;              ///< offset of the function in DSPTestContexts
+    size_t ref_offset;          ///< offset of the C function it is checked against
+    check_func check;
+    int p[3];                   ///< parameters given to the check function
+} DSPTestEntry;
+
+typedef struct CPUVariant {
+    const char *name;
+    int flag;
+} CPUVariant;
+
+static const CPUVariant cpu_variants[] = {
+#if ARCH_X86
+    { "MMX",      AV_CPU_FLAG_MMX      },
+    { "MMX2",     AV_CPU_FLAG_MMX2     },
+    { "3DNow",    AV_CPU_FLAG_3DNOW    },
+    { "3DNowExt", AV_CPU_FLAG_3DNOWEXT },
+    { "SSE",      AV_CPU_FLAG_SSE      },
+    { "SSE2",     AV_CPU_FLAG_SSE2     },
+    { "SSE3",     AV_CPU_FLAG_SSE3     },
+    { "SSSE3",    AV_CPU_FLAG_SSSE3    },
+    { "SSE4.1",   AV_CPU_FLAG_SSE4     },
+    { "SSE4.2",   AV_CPU_FLAG_SSE42    },
+    { "AVX",      AV_CPU_FLAG_AVX      },
+    { "AVX2",     AV_CPU_FLAG_AVX2     },
+#elif ARCH_ARM
+    { "IWMMXT",   AV_CPU_FLAG_IWMMXT   },
+#elif ARCH_PPC
+    { "AltiVec",  AV_CPU_FLAG_ALTIVEC  },
+#else
+    { "none",     0 },
+#endif
+};
+
+#define NB_VARIANTS FF_ARRAY_ELEMS(cpu_variants)
+
+/* flags which only tune the choice between versions */
+#if ARCH_X86
+#define CPU_FLAGS_MODIFIERS (AV_CPU_FLAG_SSE2SLOW | AV_CPU_FLAG_SSE3SLOW | \
+                             AV_CPU_FLAG_ATOM)
+#else
+#define CPU_FLAGS_MODIFIERS 0
+#endif
+
+static DSPTestContexts contexts[NB_VARIANTS + 1];
+
+static DSPTestEntry *entries;
+static int nb_entries;
+
+static AVLFG prng;
+
+/* results of the benchmarked calls, so that they are not optimized out */
+static volatile int sink;
+static volatile float fsink;
+
+DECLARE_ALIGNED(32, static uint8_t, src0)[BUF_SIZE];
+DECLARE_ALIGNED(32, static uint8_t, src1)[BUF_SIZE];
+DECLARE_ALIGNED(32, static uint8_t, src2)[BUF_SIZE];
+DECLARE_ALIGNED(32, static uint8_t, dst_ref)[BUF_SIZE];
+DECLARE_ALIGNED(32, static uint8_t, dst_new)[BUF_SIZE];
+DECLARE_ALIGNED(32, static uint8_t, dst_org)[BUF_SIZE];
+
+#define BENCH(t, call)                                          \
+    do {                                                        \
+        uint64_t start, best = UINT64_MAX;                      \
+        int run, n;                                             \
+        for (run = 0; run < BENCH_RUNS; run++) {                \
+            start = READ_TIME();                                \
+            for (n = 0; n < BENCH_CALLS; n++) {                 \
+                call;                                           \
+            }                                                   \
+            best = FFMIN(best, READ_TIME() - start);            \
+        }                                                       \
+        emms_c();                                               \
+        *(t) = (double)best / BENCH_CALLS;                      \
+    } while (0)
+
+/* benchmark the two calls, which differ by the function and the output */
+#define BENCH_BOTH(call_ref, call_new)                          \
+    do {                                                        \
+        if (t_ref) {                                            \
+            BENCH(t_ref, call_ref);                             \
+            BENCH(t_new, call_new);                             \
+        }                                                       \
+    } while (0)
+
+static void fill_random(uint8_t *buf, int size)
+{
+    int i;
+    for (i = 0; i < size; i++)
+        buf[i] = av_lfg_get(&prng);
+}
+
+/* pixels of little amplitude around 128, so that the loop filters apply */
+static void fill_smooth(uint8_t *buf, int size)
+{
+    int i;
+    for (i = 0; i < size; i++)
+        buf[i] = 128 + av_lfg_get(&prng) % 17 - 8;
+}
+
+static void fill_int16(int16_t *buf, int n, int min, int max)
+{
+    int i;
+    for (i = 0; i < n; i++)
+        buf[i] = min + (int)(av_lfg_get(&prng) % (max - min + 1));
+}
+
+static void fill_int32(int32_t *buf, int n, int min, int max)
+{
+    unsigned range = (unsigned)max - min + 1;
+    int i;
+    for (i = 0; i < n; i++)
+        buf[i] = min + (int)(range ? av_lfg_get(&prng) % range : av_lfg_get(&prng));
+}
+
+static void fill_float(float *buf, int n, float min, float max)
+{
+    int i;
+    for (i = 0; i < n; i++)
+        buf[i] = min + (max - min) * (av_lfg_get(&prng) / 4294967296.0);
+}
+
+static int compare_float(const float *a, const float *b, int n, float eps)
+{
+    int i;
+    for (i = 0; i < n; i++)
+        if (fabsf(a[i] - b[i]) > eps * FFMAX(1.0f, fabsf(a[i])))
+            return 1;
+    return 0;
+}
+
+static void prepare_dst(void)
+{
+    memcpy(dst_ref, dst_org, BUF_SIZE);
+    memcpy(dst_new, dst_org, BUF_SIZE);
+}
+
+static int compare_dst(void)
+{
+    return memcmp(dst_ref, dst_new, BUF_SIZE);
+}
+
+/* DSPContext pixel functions */
+
+static int check_pixels(const DSPTestEntry *e, generic_func ref,
+                        generic_func new, double *t_ref, double *t_new)
+{
+    op_pixels_func f_ref = (op_pixels_func)ref, f_new = (op_pixels_func)new;
+    uint8_t *src = src0 + PIX_OFFSET + 1;
+    int h = e->p[0], i;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        fill_random(src0, BUF_SIZE);
+        fill_random(dst_org, BUF_SIZE);
+        prepare_dst();
+        f_ref(dst_ref + PIX_OFFSET, src, STRIDE, h);
+        f_new(dst_new + PIX_OFFSET, src, STRIDE, h);
+        emms_c();
+        if (compare_dst())
+            return 1;
+    }
+    BENCH_BOTH(f_ref(dst_ref + PIX_OFFSET, src, STRIDE, h),
+               f_new(dst_new + PIX_OFFSET, src, STRIDE, h));
+    return 0;
+}
+
+static int check_qpel(const DSPTestEntry *e, generic_func ref,
+                      generic_func new, double *t_ref, double *t_new)
+{
+    qpel_mc_func f_ref = (qpel_mc_func)ref, f_new = (qpel_mc_func)new;
+    uint8_t *src = src0 + PIX_OFFSET + 1;
+    int i;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        fill_random(src0, BUF_SIZE);
+        fill_random(dst_org, BUF_SIZE);
+        prepare_dst();
+        f_ref(dst_ref + PIX_OFFSET, src, STRIDE);
+        f_new(dst_new + PIX_OFFSET, src, STRIDE);
+        emms_c();
+        if (compare_dst())
+            return 1;
+    }
+    BENCH_BOTH(f_ref(dst_ref + PIX_OFFSET, src, STRIDE),
+               f_new(dst_new + PIX_OFFSET, src, STRIDE));
+    return 0;
+}
+
+static int check_chroma_mc(const DSPTestEntry *e, generic_func ref,
+                           generic_func new, double *t_ref, double *t_new)
+{
+    h264_chroma_mc_func f_ref = (h264_chroma_mc_func)ref;
+    h264_chroma_mc_func f_new = (h264_chroma_mc_func)new;
+    uint8_t *src = src0 + PIX_OFFSET + 1;
+    int h = e->p[0], i, x, y;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        fill_random(src0, BUF_SIZE);
+        fill_random(dst_org, BUF_SIZE);
+        prepare_dst();
+        x = i & 7;
+        y = av_lfg_get(&prng) & 7;
+        f_ref(dst_ref + PIX_OFFSET, src, STRIDE, h, x, y);
+        f_new(dst_new + PIX_OFFSET, src, STRIDE, h, x, y);
+        emms_c();
+        if (compare_dst())
+            return 1;
+    }
+    BENCH_BOTH(f_ref(dst_ref + PIX_OFFSET, src, STRIDE, h, 3, 5),
+               f_new(dst_new + PIX_OFFSET, src, STRIDE, h, 3, 5));
+    return 0;
+}
+
+static int check_me_cmp(const DSPTestEntry *e, generic_func ref,
+                        generic_func new, double *t_ref, double *t_new)
+{
+    me_cmp_func f_ref = (me_cmp_func)ref, f_new = (me_cmp_func)new;
+    uint8_t *blk1 = src0 + PIX_OFFSET, *blk2 = src1 + PIX_OFFSET + 1;
+    int h = e->p[0], i, r_ref, r_new;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        fill_random(src0, BUF_SIZE);
+        fill_random(src1, BUF_SIZE);
+        r_ref = f_ref(NULL, blk1, blk2, STRIDE, h);
+        r_new = f_new(NULL, blk1, blk2, STRIDE, h);
+        emms_c();
+        if (r_ref != r_new)
+            return 1;
+    }
+    BENCH_BOTH(sink = f_ref(NULL, blk1, blk2, STRIDE, h),
+               sink = f_new(NULL, blk1, blk2, STRIDE, h));
+    return 0;
+}
+
+/* sad_x4[] has no C version, so it is checked against 4 calls of sad[] */
+static int check_sad_x4(const DSPTestEntry *e, generic_func ref,
+                        generic_func new, double *t_ref, double *t_new)
+{
+    me_cmp_func f_ref = (me_cmp_func)ref;
+    me_cmp_x4_func f_new = (me_cmp_x4_func)new;
+    uint8_t *blk1 = src0 + PIX_OFFSET, *blk2 = src1 + PIX_OFFSET;
+    uint8_t * const cand[4] = { blk2 - 1, blk2 + 1, blk2 - STRIDE, blk2 + STRIDE };
+    int i, j, h, r_ref[4], r_new[4];
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        /* sad_x4[0] is used for both 16x16 and 16x8 blocks */
+        h = e->p[0] == 16 && i & 1 ? 8 : e->p[0];
+        fill_random(src0, BUF_SIZE);
+        fill_random(src1, BUF_SIZE);
+        for (j = 0; j < 4; j++)
+            r_ref[j] = f_ref(NULL, blk1, cand[j], STRIDE, h);
+        f_new(NULL, blk1, cand, STRIDE, h, r_new);
+        emms_c();
+        if (memcmp(r_ref, r_new, sizeof(r_ref)))
+            return 1;
+    }
+    h = e->p[0];
+    BENCH_BOTH(for (j = 0; j < 4; j++) r_ref[j] = f_ref(NULL, blk1, cand[j], STRIDE, h),
+               f_new(NULL, blk1, cand, STRIDE, h, r_new));
+    return 0;
+}
+
+typedef void (*pixels_clamped_func)(const DCTELEM *block, uint8_t *pixels,
+                                    int line_size);
+
+static int check_pixels_clamped(const DSPTestEntry *e, generic_func ref,
+                                generic_func new, double *t_ref, double *t_new)
+{
+    pixels_clamped_func f_ref = (pixels_clamped_func)ref;
+    pixels_clamped_func f_new = (pixels_clamped_func)new;
+    DCTELEM *block = (DCTELEM *)src0;
+    int i;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        fill_int16(block, 64, -300, 300);
+        fill_random(dst_org, BUF_SIZE);
+        prepare_dst();
+        f_ref(block, dst_ref + PIX_OFFSET, STRIDE);
+        f_new(block, dst_new + PIX_OFFSET, STRIDE);
+        emms_c();
+        if (compare_dst())
+            return 1;
+    }
+    BENCH_BOTH(f_ref(block, dst_ref + PIX_OFFSET, STRIDE),
+               f_new(block, dst_new + PIX_OFFSET, STRIDE));
+    return 0;
+}
+
+typedef void (*add_bytes_func)(uint8_t *dst, uint8_t *src, int w);
+typedef void (*diff_bytes_func)(uint8_t *dst, uint8_t *src1, uint8_t *src2,
+                                int w);
+typedef void (*bswap_buf_func)(uint32_t *dst, const uint32_t *src, int w);
+
+static int check_add_bytes(const DSPTestEntry *e, generic_func ref,
+                           generic_func new, double *t_ref, double *t_new)
+{
+    add_bytes_func f_ref = (add_bytes_func)ref, f_new = (add_bytes_func)new;
+    int w = e->p[0], i;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        fill_random(src0, BUF_SIZE);
+        fill_random(dst_org, BUF_SIZE);
+        prepare_dst();
+        f_ref(dst_ref, src0, w);
+        f_new(dst_new, src0, w);
+        emms_c();
+        if (compare_dst())
+            return 1;
+    }
+    BENCH_BOTH(f_ref(dst_ref, src0, w), f_new(dst_new, src0, w));
+    return 0;
+}
+
+static int check_diff_bytes(const DSPTestEntry *e, generic_func ref,
+                            generic_func new, double *t_ref, double *t_new)
+{
+    diff_bytes_func f_ref = (diff_bytes_func)ref, f_new = (diff_bytes_func)new;
+    int w = e->p[0], i;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        fill_random(src0, BUF_SIZE);
+        fill_random(src1, BUF_SIZE);
+        fill_random(dst_org, BUF_SIZE);
+        prepare_dst();
+        f_ref(dst_ref, src0, src1 + 1, w);
+        f_new(dst_new, src0, src1 + 1, w);
+        emms_c();
+        if (compare_dst())
+            return 1;
+    }
+    BENCH_BOTH(f_ref(dst_ref, src0, src1 + 1, w),
+               f_new(dst_new, src0, src1 + 1, w));
+    return 0;
+}
+
+static int check_bswap_buf(const DSPTestEntry *e, generic_func ref,
+                           generic_func new, double *t_ref, double *t_new)
+{
+    bswap_buf_func f_ref = (bswap_buf_func)ref, f_new = (bswap_buf_func)new;
+    int w = e->p[0], i;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        fill_random(src0, BUF_SIZE);
+        fill_random(dst_org, BUF_SIZE);
+        prepare_dst();
+        f_ref((uint32_t *)dst_ref, (uint32_t *)src0, w);
+        f_new((uint32_t *)dst_new, (uint32_t *)src0, w);
+        emms_c();
+        if (compare_dst())
+            return 1;
+    }
+    BENCH_BOTH(f_ref((uint32_t *)dst_ref, (uint32_t *)src0, w),
+               f_new((uint32_t *)dst_new, (uint32_t *)src0, w));
+    return 0;
+}
+
+/* DSPContext float and int16 vector functions */
+
+#define VEC_LEN 256
+
+typedef void (*vector_fmul_func)(float *dst, const float *src0,
+                                 const float *src1, int len);
+typedef void (*vector_fmul_add_func)(float *dst, const float *src0,
+                                     const float *src1, const float *src2,
+                                     int len);
+typedef void (*vector_fmul_window_func)(float *dst, const float *src0,
+                                        const float *src1, const float *win,
+                                        int len);
+typedef void (*vector_clipf_func)(float *dst, const float *src,
+                                  float min, float max, int len);
+typedef void (*vector_fmul_scalar_func)(float *dst, const float *src,
+                                        float mul, int len);
+typedef float (*scalarproduct_float_func)(const float *v1, const float *v2,
+                                          int len);
+typedef void (*butterflies_float_func)(float *v1, float *v2, int len);
+typedef int32_t (*scalarproduct_int16_func)(const int16_t *v1,
+                                            const int16_t *v2,
+                                            int len, int shift);
+typedef int32_t (*scalarproduct_and_madd_int16_func)(int16_t *v1,
+                                                     const int16_t *v2,
+                                                     const int16_t *v3,
+                                                     int len, int mul);
+
+#define FSRC0 ((float *)src0)
+#define FSRC1 ((float *)src1)
+#define FSRC2 ((float *)src2)
+#define FDST_REF ((float *)dst_ref)
+#define FDST_NEW ((float *)dst_new)
+
+static int check_vector_fmul(const DSPTestEntry *e, generic_func ref,
+                             generic_func new, double *t_ref, double *t_new)
+{
+    vector_fmul_func f_ref = (vector_fmul_func)ref;
+    vector_fmul_func f_new = (vector_fmul_func)new;
+    int i;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        fill_float(FSRC0, VEC_LEN, -1.0, 1.0);
+        fill_float(FSRC1, VEC_LEN, -1.0, 1.0);
+        f_ref(FDST_REF, FSRC0, FSRC1, VEC_LEN);
+        f_new(FDST_NEW, FSRC0, FSRC1, VEC_LEN);
+        emms_c();
+        if (compare_float(FDST_REF, FDST_NEW, VEC_LEN, 1e-6))
+            return 1;
+    }
+    BENCH_BOTH(f_ref(FDST_REF, FSRC0, FSRC1, VEC_LEN),
+               f_new(FDST_NEW, FSRC0, FSRC1, VEC_LEN));
+    return 0;
+}
+
+static int check_vector_fmul_add(const DSPTestEntry *e, generic_func ref,
+                                 generic_func new, double *t_ref, double *t_new)
+{
+    vector_fmul_add_func f_ref = (vector_fmul_add_func)ref;
+    vector_fmul_add_func f_new = (vector_fmul_add_func)new;
+    int i;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        fill_float(FSRC0, VEC_LEN, -1.0, 1.0);
+        fill_float(FSRC1, VEC_LEN, -1.0, 1.0);
+        fill_float(FSRC2, VEC_LEN, -1.0, 1.0);
+        f_ref(FDST_REF, FSRC0, FSRC1, FSRC2, VEC_LEN);
+        f_new(FDST_NEW, FSRC0, FSRC1, FSRC2, VEC_LEN);
+        emms_c();
+        if (compare_float(FDST_REF, FDST_NEW, VEC_LEN, 1e-6))
+            return 1;
+    }
+    BENCH_BOTH(f_ref(FDST_REF, FSRC0, FSRC1, FSRC2, VEC_LEN),
+               f_new(FDST_NEW, FSRC0, FSRC1, FSRC2, VEC_LEN));
+    return 0;
+}
+
+static int check_vector_fmul_window(const DSPTestEntry *e, generic_func ref,
+                                    generic_func new, double *t_ref,
+                                    double *t_new)
+{
+    vector_fmul_window_func f_ref = (vector_fmul_window_func)ref;
+    vector_fmul_window_func f_new = (vector_fmul_window_func)new;
+    int len = VEC_LEN / 2, i;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        fill_float(FSRC0, len, -1.0, 1.0);
+        fill_float(FSRC1, len, -1.0, 1.0);
+        fill_float(FSRC2, VEC_LEN, 0.0, 1.0);
+        f_ref(FDST_REF, FSRC0, FSRC1, FSRC2, len);
+        f_new(FDST_NEW, FSRC0, FSRC1, FSRC2, len);
+        emms_c();
+        if (compare_float(FDST_REF, FDST_NEW, VEC_LEN, 1e-6))
+            return 1;
+    }
+    BENCH_BOTH(f_ref(FDST_REF, FSRC0, FSRC1, FSRC2, len),
+               f_new(FDST_NEW, FSRC0, FSRC1, FSRC2, len));
+    return 0;
+}
+
+static int check_vector_clipf(const DSPTestEntry *e, generic_func ref,
+                              generic_func new, double *t_ref, double *t_new)
+{
+    vector_clipf_func f_ref = (vector_clipf_func)ref;
+    vector_clipf_func f_new = (vector_clipf_func)new;
+    int i;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        fill_float(FSRC0, VEC_LEN, -2.0, 2.0);
+        f_ref(FDST_REF, FSRC0, -0.5, 1.0, VEC_LEN);
+        f_new(FDST_NEW, FSRC0, -0.5, 1.0, VEC_LEN);
+        emms_c();
+        if (compare_float(FDST_REF, FDST_NEW, VEC_LEN, 0))
+            return 1;
+    }
+    BENCH_BOTH(f_ref(FDST_REF, FSRC0, -0.5, 1.0, VEC_LEN),
+               f_new(FDST_NEW, FSRC0, -0.5, 1.0, VEC_LEN));
+    return 0;
+}
+
+static int check_vector_fmul_scalar(const DSPTestEntry *e, generic_func ref,
+                                    generic_func new, double *t_ref,
+                                    double *t_new)
+{
+    vector_fmul_scalar_func f_ref = (vector_fmul_scalar_func)ref;
+    vector_fmul_scalar_func f_new = (vector_fmul_scalar_func)new;
+    int i;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        fill_float(FSRC0, VEC_LEN, -1.0, 1.0);
+        f_ref(FDST_REF, FSRC0, 0.3, VEC_LEN);
+        f_new(FDST_NEW, FSRC0, 0.3, VEC_LEN);
+        emms_c();
+        if (compare_float(FDST_REF, FDST_NEW, VEC_LEN, 1e-6))
+            return 1;
+    }
+    BENCH_BOTH(f_ref(FDST_REF, FSRC0, 0.3, VEC_LEN),
+               f_new(FDST_NEW, FSRC0, 0.3, VEC_LEN));
+    return 0;
+}
+
+static int check_scalarproduct_float(const DSPTestEntry *e, generic_func ref,
+                                     generic_func new, double *t_ref,
+                                     double *t_new)
+{
+    scalarproduct_float_func f_ref = (scalarproduct_float_func)ref;
+    scalarproduct_float_func f_new = (scalarproduct_float_func)new;
+    float r_ref, r_new;
+    int i;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        fill_float(FSRC0, VEC_LEN, -1.0, 1.0);
+        fill_float(FSRC1, VEC_LEN, -1.0, 1.0);
+        r_ref = f_ref(FSRC0, FSRC1, VEC_LEN);
+        r_new = f_new(FSRC0, FSRC1, VEC_LEN);
+        emms_c();
+        /* the sums are not done in the same order */
+        if (fabsf(r_ref - r_new) > 1e-4)
+            return 1;
+    }
+    BENCH_BOTH(fsink = f_ref(FSRC0, FSRC1, VEC_LEN),
+               fsink = f_new(FSRC0, FSRC1, VEC_LEN));
+    return 0;
+}
+
+static int check_butterflies_float(const DSPTestEntry *e, generic_func ref,
+                                   generic_func new, double *t_ref,
+                                   double *t_new)
+{
+    butterflies_float_func f_ref = (butterflies_float_func)ref;
+    butterflies_float_func f_new = (butterflies_float_func)new;
+    int i;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        fill_float(FSRC0, 2 * VEC_LEN, -1.0, 1.0);
+        memcpy(FDST_REF, FSRC0, 2 * VEC_LEN * sizeof(float));
+        memcpy(FDST_NEW, FSRC0, 2 * VEC_LEN * sizeof(float));
+        f_ref(FDST_REF, FDST_REF + VEC_LEN, VEC_LEN);
+        f_new(FDST_NEW, FDST_NEW + VEC_LEN, VEC_LEN);
+        emms_c();
+        if (compare_float(FDST_REF, FDST_NEW, 2 * VEC_LEN, 1e-6))
+            return 1;
+    }
+    BENCH_BOTH(f_ref(FDST_REF, FDST_REF + VEC_LEN, VEC_LEN),
+               f_new(FDST_NEW, FDST_NEW + VEC_LEN, VEC_LEN));
+    return 0;
+}
+
+static int check_inverse_coupling(const DSPTestEntry *e, generic_func ref,
+                                  generic_func new, double *t_ref,
+                                  double *t_new)
+{
+    butterflies_float_func f_ref = (butterflies_float_func)ref;
+    butterflies_float_func f_new = (butterflies_float_func)new;
+    int i;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        fill_float(FSRC0, 2 * VEC_LEN, -1.0, 1.0);
+        memcpy(FDST_REF, FSRC0, 2 * VEC_LEN * sizeof(float));
+        memcpy(FDST_NEW, FSRC0, 2 * VEC_LEN * sizeof(float));
+        f_ref(FDST_REF, FDST_REF + VEC_LEN, VEC_LEN);
+        f_new(FDST_NEW, FDST_NEW + VEC_LEN, VEC_LEN);
+        emms_c();
+        if (compare_float(FDST_REF, FDST_NEW, 2 * VEC_LEN, 0))
+            return 1;
+    }
+    BENCH_BOTH(f_ref(FDST_REF, FDST_REF + VEC_LEN, VEC_LEN),
+               f_new(FDST_NEW, FDST_NEW + VEC_LEN, VEC_LEN));
+    return 0;
+}
+
+static int check_scalarproduct_int16(const DSPTestEntry *e, generic_func ref,
+                                     generic_func new, double *t_ref,
+                                     double *t_new)
+{
+    scalarproduct_int16_func f_ref = (scalarproduct_int16_func)ref;
+    scalarproduct_int16_func f_new = (scalarproduct_int16_func)new;
+    int16_t *v1 = (int16_t *)src0, *v2 = (int16_t *)src1;
+    int i;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        fill_int16(v1, VEC_LEN, -4096, 4096);
+        fill_int16(v2, VEC_LEN, -4096, 4096);
+        if (f_ref(v1, v2, VEC_LEN, 0) != f_new(v1, v2, VEC_LEN, 0))
+            return 1;
+        emms_c();
+    }
+    BENCH_BOTH(sink = f_ref(v1, v2, VEC_LEN, 0),
+               sink = f_new(v1, v2, VEC_LEN, 0));
+    return 0;
+}
+
+static int check_scalarproduct_and_madd_int16(const DSPTestEntry *e,
+                                              generic_func ref,
+                                              generic_func new,
+                                              double *t_ref, double *t_new)
+{
+    scalarproduct_and_madd_int16_func f_ref = (scalarproduct_and_madd_int16_func)ref;
+    scalarproduct_and_madd_int16_func f_new = (scalarproduct_and_madd_int16_func)new;
+    int16_t *v2 = (int16_t *)src1, *v3 = (int16_t *)src2;
+    int32_t r_ref, r_new;
+    int i;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        fill_int16((int16_t *)dst_org, VEC_LEN, -4096, 4096);
+        fill_int16(v2, VEC_LEN, -4096, 4096);
+        fill_int16(v3, VEC_LEN, -4096, 4096);
+        prepare_dst();
+        r_ref = f_ref((int16_t *)dst_ref, v2, v3, VEC_LEN, 3);
+        r_new = f_new((int16_t *)dst_new, v2, v3, VEC_LEN, 3);
+        emms_c();
+        if (r_ref != r_new || compare_dst())
+            return 1;
+    }
+    BENCH_BOTH(sink = f_ref((int16_t *)dst_ref, v2, v3, VEC_LEN, 3),
+               sink = f_new((int16_t *)dst_new, v2, v3, VEC_LEN, 3));
+    return 0;
+}
+
+/* FmtConvertContext */
+
+typedef void (*int32_to_float_fmul_scalar_func)(float *dst, const int *src,
+                                                float mul, int len);
+typedef void (*float_to_int16_func)(int16_t *dst, const float *src, long len);
+typedef void (*float_to_int16_interleave_func)(int16_t *dst, const float **src,
+                                               long len, int channels);
+typedef void (*float_interleave_func)(float *dst, const float **src,
+                                      unsigned int len, int channels);
+
+static int check_int32_to_float_fmul_scalar(const DSPTestEntry *e,
+                                            generic_func ref, generic_func new,
+                                            double *t_ref, double *t_new)
+{
+    int32_to_float_fmul_scalar_func f_ref = (int32_to_float_fmul_scalar_func)ref;
+    int32_to_float_fmul_scalar_func f_new = (int32_to_float_fmul_scalar_func)new;
+    int *src = (int *)src0;
+    int i;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        fill_int32(src, VEC_LEN, INT_MIN, INT_MAX);
+        f_ref(FDST_REF, src, 1.0 / (1 << 15), VEC_LEN);
+        f_new(FDST_NEW, src, 1.0 / (1 << 15), VEC_LEN);
+        emms_c();
+        if (compare_float(FDST_REF, FDST_NEW, VEC_LEN, 1e-6))
+            return 1;
+    }
+    BENCH_BOTH(f_ref(FDST_REF, src, 1.0 / (1 << 15), VEC_LEN),
+               f_new(FDST_NEW, src, 1.0 / (1 << 15), VEC_LEN));
+    return 0;
+}
+
+static int check_float_to_int16(const DSPTestEntry *e, generic_func ref,
+                                generic_func new, double *t_ref, double *t_new)
+{
+    float_to_int16_func f_ref = (float_to_int16_func)ref;
+    float_to_int16_func f_new = (float_to_int16_func)new;
+    int i;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        fill_float(FSRC0, VEC_LEN, -32768.0, 32767.0);
+        prepare_dst();
+        f_ref((int16_t *)dst_ref, FSRC0, VEC_LEN);
+        f_new((int16_t *)dst_new, FSRC0, VEC_LEN);
+        emms_c();
+        if (compare_dst())
+            return 1;
+    }
+    BENCH_BOTH(f_ref((int16_t *)dst_ref, FSRC0, VEC_LEN),
+               f_new((int16_t *)dst_new, FSRC0, VEC_LEN));
+    return 0;
+}
+
+static int check_float_to_int16_interleave(const DSPTestEntry *e,
+                                           generic_func ref, generic_func new,
+                                           double *t_ref, double *t_new)
+{
+    float_to_int16_interleave_func f_ref = (float_to_int16_interleave_func)ref;
+    float_to_int16_interleave_func f_new = (float_to_int16_interleave_func)new;
+    const float *src[6];
+    int channels = e->p[0], len = VEC_LEN / 2, i;
+
+    for (i = 0; i < channels; i++)
+        src[i] = FSRC0 + i * len;
+    for (i = 0; i < CHECK_RUNS; i++) {
+        fill_float(FSRC0, channels * len, -32768.0, 32767.0);
+        prepare_dst();
+        f_ref((int16_t *)dst_ref, src, len, channels);
+        f_new((int16_t *)dst_new, src, len, channels);
+        emms_c();
+        if (compare_dst())
+            return 1;
+    }
+    BENCH_BOTH(f_ref((int16_t *)dst_ref, src, len, channels),
+               f_new((int16_t *)dst_new, src, len, channels));
+    return 0;
+}
+
+static int check_float_interleave(const DSPTestEntry *e, generic_func ref,
+                                  generic_func new, double *t_ref,
+                                  double *t_new)
+{
+    float_interleave_func f_ref = (float_interleave_func)ref;
+    float_interleave_func f_new = (float_interleave_func)new;
+    const float *src[6];
+    int channels = e->p[0], len = VEC_LEN / 2, i;
+
+    for (i = 0; i < channels; i++)
+        src[i] = FSRC0 + i * len;
+    for (i = 0; i < CHECK_RUNS; i++) {
+        fill_float(FSRC0, channels * len, -1.0, 1.0);
+        prepare_dst();
+        f_ref(FDST_REF, src, len, channels);
+        f_new(FDST_NEW, src, len, channels);
+        emms_c();
+        if (compare_dst())
+            return 1;
+    }
+    BENCH_BOTH(f_ref(FDST_REF, src, len, channels),
+               f_new(FDST_NEW, src, len, channels));
+    return 0;
+}
+
+#if CONFIG_AC3DSP
+/* AC3DSPContext */
+
+typedef void (*ac3_exponent_min_func)(uint8_t *exp, int num_reuse_blocks,
+                                      int nb_coefs);
+typedef int (*ac3_max_msb_abs_int16_func)(const int16_t *src, int len);
+typedef void (*ac3_lshift_int16_func)(int16_t *src, unsigned int len,
+                                      unsigned int shift);
+typedef void (*ac3_rshift_int32_func)(int32_t *src, unsigned int len,
+                                      unsigned int shift);
+typedef void (*float_to_fixed24_func)(int32_t *dst, const float *src,
+                                      unsigned int len);
+typedef void (*update_bap_counts_func)(uint16_t mant_cnt[16], uint8_t *bap,
+                                       int len);
+typedef int (*compute_mantissa_size_func)(uint16_t mant_cnt[6][16]);
+typedef void (*extract_exponents_func)(uint8_t *exp, int32_t *coef,
+                                       int nb_coefs);
+
+static int check_ac3_exponent_min(const DSPTestEntry *e, generic_func ref,
+                                  generic_func new, double *t_ref,
+                                  double *t_new)
+{
+    ac3_exponent_min_func f_ref = (ac3_exponent_min_func)ref;
+    ac3_exponent_min_func f_new = (ac3_exponent_min_func)new;
+    int i, j;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        for (j = 0; j < 6 * 256; j++)
+            dst_org[j] = av_lfg_get(&prng) % 25;
+        prepare_dst();
+        f_ref(dst_ref, i % 6, 256);
+        f_new(dst_new, i % 6, 256);
+        emms_c();
+        if (compare_dst())
+            return 1;
+    }
+    BENCH_BOTH(f_ref(dst_ref, 5, 256), f_new(dst_new, 5, 256));
+    return 0;
+}
+
+static int check_ac3_max_msb_abs_int16(const DSPTestEntry *e, generic_func ref,
+                                       generic_func new, double *t_ref,
+                                       double *t_new)
+{
+    ac3_max_msb_abs_int16_func f_ref = (ac3_max_msb_abs_int16_func)ref;
+    ac3_max_msb_abs_int16_func f_new = (ac3_max_msb_abs_int16_func)new;
+    int16_t *src = (int16_t *)src0;
+    int i, r_ref, r_new;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        fill_int16(src, VEC_LEN, -(1 << (i % 15)), 1 << (i % 15));
+        r_ref = f_ref(src, VEC_LEN);
+        r_new = f_new(src, VEC_LEN);
+        emms_c();
+        if (r_ref != r_new)
+            return 1;
+    }
+    BENCH_BOTH(sink = f_ref(src, VEC_LEN), sink = f_new(src, VEC_LEN));
+    return 0;
+}
+
+static int check_ac3_lshift_int16(const DSPTestEntry *e, generic_func ref,
+                                  generic_func new, double *t_ref,
+                                  double *t_new)
+{
+    ac3_lshift_int16_func f_ref = (ac3_lshift_int16_func)ref;
+    ac3_lshift_int16_func f_new = (ac3_lshift_int16_func)new;
+    int i;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        fill_int16((int16_t *)dst_org, VEC_LEN, -256, 255);
+        prepare_dst();
+        f_ref((int16_t *)dst_ref, VEC_LEN, i % 8);
+        f_new((int16_t *)dst_new, VEC_LEN, i % 8);
+        emms_c();
+        if (compare_dst())
+            return 1;
+    }
+    BENCH_BOTH(f_ref((int16_t *)dst_ref, VEC_LEN, 0),
+               f_new((int16_t *)dst_new, VEC_LEN, 0));
+    return 0;
+}
+
+static int check_ac3_rshift_int32(const DSPTestEntry *e, generic_func ref,
+                                  generic_func new, double *t_ref,
+                                  double *t_new)
+{
+    ac3_rshift_int32_func f_ref = (ac3_rshift_int32_func)ref;
+    ac3_rshift_int32_func f_new = (ac3_rshift_int32_func)new;
+    int i;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        fill_int32((int32_t *)dst_org, VEC_LEN, INT_MIN, INT_MAX);
+        prepare_dst();
+        f_ref((int32_t *)dst_ref, VEC_LEN, i % 24);
+        f_new((int32_t *)dst_new, VEC_LEN, i % 24);
+        emms_c();
+        if (compare_dst())
+            return 1;
+    }
+    BENCH_BOTH(f_ref((int32_t *)dst_ref, VEC_LEN, 0),
+               f_new((int32_t *)dst_new, VEC_LEN, 0));
+    return 0;
+}
+
+static int check_float_to_fixed24(const DSPTestEntry *e, generic_func ref,
+                                  generic_func new, double *t_ref,
+                                  double *t_new)
+{
+    float_to_fixed24_func f_ref = (float_to_fixed24_func)ref;
+    float_to_fixed24_func f_new = (float_to_fixed24_func)new;
+    int i;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        fill_float(FSRC0, VEC_LEN, -1.0, 1.0);
+        prepare_dst();
+        f_ref((int32_t *)dst_ref, FSRC0, VEC_LEN);
+        f_new((int32_t *)dst_new, FSRC0, VEC_LEN);
+        emms_c();
+        if (compare_dst())
+            return 1;
+    }
+    BENCH_BOTH(f_ref((int32_t *)dst_ref, FSRC0, VEC_LEN),
+               f_new((int32_t *)dst_new, FSRC0, VEC_LEN));
+    return 0;
+}
+
+static int check_update_bap_counts(const DSPTestEntry *e, generic_func ref,
+                                   generic_func new, double *t_ref,
+                                   double *t_new)
+{
+    update_bap_counts_func f_ref = (update_bap_counts_func)ref;
+    update_bap_counts_func f_new = (update_bap_counts_func)new;
+    int i, j;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        for (j = 0; j < VEC_LEN; j++)
+            src0[j] = av_lfg_get(&prng) % 16;
+        memset(dst_org, 0, BUF_SIZE);
+        prepare_dst();
+        f_ref((uint16_t *)dst_ref, src0, VEC_LEN - i);
+        f_new((uint16_t *)dst_new, src0, VEC_LEN - i);
+        emms_c();
+        if (compare_dst())
+            return 1;
+    }
+    BENCH_BOTH(f_ref((uint16_t *)dst_ref, src0, VEC_LEN),
+               f_new((uint16_t *)dst_new, src0, VEC_LEN));
+    return 0;
+}
+
+static int check_compute_mantissa_size(const DSPTestEntry *e, generic_func ref,
+                                       generic_func new, double *t_ref,
+                                       double *t_new)
+{
+    compute_mantissa_size_func f_ref = (compute_mantissa_size_func)ref;
+    compute_mantissa_size_func f_new = (compute_mantissa_size_func)new;
+    uint16_t (*mant_cnt)[16] = (uint16_t (*)[16])src0;
+    int i, j;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        for (j = 0; j < 6 * 16; j++)
+            mant_cnt[0][j] = av_lfg_get(&prng) % 256;
+        if (f_ref(mant_cnt) != f_new(mant_cnt))
+            return 1;
+        emms_c();
+    }
+    BENCH_BOTH(sink = f_ref(mant_cnt), sink = f_new(mant_cnt));
+    return 0;
+}
+
+static int check_extract_exponents(const DSPTestEntry *e, generic_func ref,
+                                   generic_func new, double *t_ref,
+                                   double *t_new)
+{
+    extract_exponents_func f_ref = (extract_exponents_func)ref;
+    extract_exponents_func f_new = (extract_exponents_func)new;
+    int32_t *coef = (int32_t *)src0;
+    int i;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        fill_int32(coef, VEC_LEN, -(1 << 24) + 1, (1 << 24) - 1);
+        prepare_dst();
+        f_ref(dst_ref, coef, VEC_LEN);
+        f_new(dst_new, coef, VEC_LEN);
+        emms_c();
+        if (compare_dst())
+            return 1;
+    }
+    BENCH_BOTH(f_ref(dst_ref, coef, VEC_LEN), f_new(dst_new, coef, VEC_LEN));
+    return 0;
+}
+#endif /* CONFIG_AC3DSP */
+
+#if CONFIG_H264DSP
+/* H264DSPContext */
+
+typedef void (*h264_idct_func)(uint8_t *dst, DCTELEM *block, int stride);
+typedef void (*h264_loop_filter_func)(uint8_t *pix, int stride, int alpha,
+                                      int beta, int8_t *tc0);
+typedef void (*h264_loop_filter_intra_func)(uint8_t *pix, int stride,
+                                            int alpha, int beta);
+
+static int check_h264_idct(const DSPTestEntry *e, generic_func ref,
+                           generic_func new, double *t_ref, double *t_new)
+{
+    h264_idct_func f_ref = (h264_idct_func)ref, f_new = (h264_idct_func)new;
+    DCTELEM *block_org = (DCTELEM *)src0, *block = (DCTELEM *)src1;
+    int i;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        fill_int16(block_org, 64, -128, 128);
+        fill_random(dst_org, BUF_SIZE);
+        prepare_dst();
+        memcpy(block, block_org, 64 * sizeof(DCTELEM));
+        f_ref(dst_ref + PIX_OFFSET, block, STRIDE);
+        memcpy(block, block_org, 64 * sizeof(DCTELEM));
+        f_new(dst_new + PIX_OFFSET, block, STRIDE);
+        emms_c();
+        if (compare_dst())
+            return 1;
+    }
+    BENCH_BOTH(f_ref(dst_ref + PIX_OFFSET, block, STRIDE),
+               f_new(dst_new + PIX_OFFSET, block, STRIDE));
+    return 0;
+}
+
+static void h264_loop_filter_params(int *alpha, int *beta, int8_t tc0[4])
+{
+    int i;
+    *alpha = 8 + av_lfg_get(&prng) % 40;
+    *beta  = 2 + av_lfg_get(&prng) % 16;
+    for (i = 0; i < 4; i++)
+        tc0[i] = av_lfg_get(&prng) % 6 - 1;
+}
+
+static int check_h264_loop_filter(const DSPTestEntry *e, generic_func ref,
+                                  generic_func new, double *t_ref,
+                                  double *t_new)
+{
+    h264_loop_filter_func f_ref = (h264_loop_filter_func)ref;
+    h264_loop_filter_func f_new = (h264_loop_filter_func)new;
+    int alpha, beta, i;
+    int8_t tc0[4];
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        h264_loop_filter_params(&alpha, &beta, tc0);
+        fill_smooth(dst_org, BUF_SIZE);
+        prepare_dst();
+        f_ref(dst_ref + PIX_OFFSET, STRIDE, alpha, beta, tc0);
+        f_new(dst_new + PIX_OFFSET, STRIDE, alpha, beta, tc0);
+        emms_c();
+        if (compare_dst())
+            return 1;
+    }
+    BENCH_BOTH(f_ref(dst_ref + PIX_OFFSET, STRIDE, alpha, beta, tc0),
+               f_new(dst_new + PIX_OFFSET, STRIDE, alpha, beta, tc0));
+    return 0;
+}
+
+static int check_h264_loop_filter_intra(const DSPTestEntry *e,
+                                        generic_func ref, generic_func new,
+                                        double *t_ref, double *t_new)
+{
+    h264_loop_filter_intra_func f_ref = (h264_loop_filter_intra_func)ref;
+    h264_loop_filter_intra_func f_new = (h264_loop_filter_intra_func)new;
+    int alpha, beta, i;
+    int8_t tc0[4];
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        h264_loop_filter_params(&alpha, &beta, tc0);
+        fill_smooth(dst_org, BUF_SIZE);
+        prepare_dst();
+        f_ref(dst_ref + PIX_OFFSET, STRIDE, alpha, beta);
+        f_new(dst_new + PIX_OFFSET, STRIDE, alpha, beta);
+        emms_c();
+        if (compare_dst())
+            return 1;
+    }
+    BENCH_BOTH(f_ref(dst_ref + PIX_OFFSET, STRIDE, alpha, beta),
+               f_new(dst_new + PIX_OFFSET, STRIDE, alpha, beta));
+    return 0;
+}
+
+static int check_h264_weight(const DSPTestEntry *e, generic_func ref,
+                             generic_func new, double *t_ref, double *t_new)
+{
+    h264_weight_func f_ref = (h264_weight_func)ref;
+    h264_weight_func f_new = (h264_weight_func)new;
+    int log2_denom, weight, offset, i;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        log2_denom = av_lfg_get(&prng) % 8;
+        weight     = av_lfg_get(&prng) % 256 - 128;
+        offset     = av_lfg_get(&prng) % 256 - 128;
+        fill_random(dst_org, BUF_SIZE);
+        prepare_dst();
+        f_ref(dst_ref + PIX_OFFSET, STRIDE, log2_denom, weight, offset);
+        f_new(dst_new + PIX_OFFSET, STRIDE, log2_denom, weight, offset);
+        emms_c();
+        if (compare_dst())
+            return 1;
+    }
+    BENCH_BOTH(f_ref(dst_ref + PIX_OFFSET, STRIDE, 5, 40, 3),
+               f_new(dst_new + PIX_OFFSET, STRIDE, 5, 40, 3));
+    return 0;
+}
+
+static int check_h264_biweight(const DSPTestEntry *e, generic_func ref,
+                               generic_func new, double *t_ref, double *t_new)
+{
+    h264_biweight_func f_ref = (h264_biweight_func)ref;
+    h264_biweight_func f_new = (h264_biweight_func)new;
+    uint8_t *src = src0 + PIX_OFFSET;
+    int log2_denom, weightd, weights, offset, i;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        log2_denom = av_lfg_get(&prng) % 8;
+        weightd    = av_lfg_get(&prng) % 256 - 128;
+        weights    = av_lfg_get(&prng) % 256 - 128;
+        offset     = av_lfg_get(&prng) % 256 - 128;
+        fill_random(src0, BUF_SIZE);
+        fill_random(dst_org, BUF_SIZE);
+        prepare_dst();
+        f_ref(dst_ref + PIX_OFFSET, src, STRIDE, log2_denom, weightd, weights, offset);
+        f_new(dst_new + PIX_OFFSET, src, STRIDE, log2_denom, weightd, weights, offset);
+        emms_c();
+        if (compare_dst())
+            return 1;
+    }
+    BENCH_BOTH(f_ref(dst_ref + PIX_OFFSET, src, STRIDE, 5, 20, 44, 3),
+               f_new(dst_new + PIX_OFFSET, src, STRIDE, 5, 20, 44, 3));
+    return 0;
+}
+#endif /* CONFIG_H264DSP */
+
+#if CONFIG_H264PRED
+/* H264PredContext */
+
+typedef void (*pred4x4_func)(uint8_t *src, const uint8_t *topright, int stride);
+typedef void (*pred8x8l_func)(uint8_t *src, int topleft, int topright,
+                              int stride);
+typedef void (*pred_func)(uint8_t *src, int stride);
+
+static int check_pred4x4(const DSPTestEntry *e, generic_func ref,
+                         generic_func new, double *t_ref, double *t_new)
+{
+    pred4x4_func f_ref = (pred4x4_func)ref, f_new = (pred4x4_func)new;
+    int i;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        fill_random(dst_org, BUF_SIZE);
+        prepare_dst();
+        f_ref(dst_ref + PIX_OFFSET, dst_ref + PIX_OFFSET - STRIDE + 4, STRIDE);
+        f_new(dst_new + PIX_OFFSET, dst_new + PIX_OFFSET - STRIDE + 4, STRIDE);
+        emms_c();
+        if (compare_dst())
+            return 1;
+    }
+    BENCH_BOTH(f_ref(dst_ref + PIX_OFFSET, dst_ref + PIX_OFFSET - STRIDE + 4, STRIDE),
+               f_new(dst_new + PIX_OFFSET, dst_new + PIX_OFFSET - STRIDE + 4, STRIDE));
+    return 0;
+}
+
+static int check_pred8x8l(const DSPTestEntry *e, generic_func ref,
+                          generic_func new, double *t_ref, double *t_new)
+{
+    pred8x8l_func f_ref = (pred8x8l_func)ref, f_new = (pred8x8l_func)new;
+    int i, topleft, topright;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        topleft  = i & 1;
+        topright = i >> 1 & 1;
+        fill_random(dst_org, BUF_SIZE);
+        prepare_dst();
+        f_ref(dst_ref + PIX_OFFSET, topleft, topright, STRIDE);
+        f_new(dst_new + PIX_OFFSET, topleft, topright, STRIDE);
+        emms_c();
+        if (compare_dst())
+            return 1;
+    }
+    BENCH_BOTH(f_ref(dst_ref + PIX_OFFSET, 1, 1, STRIDE),
+               f_new(dst_new + PIX_OFFSET, 1, 1, STRIDE));
+    return 0;
+}
+
+static int check_pred(const DSPTestEntry *e, generic_func ref,
+                      generic_func new, double *t_ref, double *t_new)
+{
+    pred_func f_ref = (pred_func)ref, f_new = (pred_func)new;
+    int i;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        fill_random(dst_org, BUF_SIZE);
+        prepare_dst();
+        f_ref(dst_ref + PIX_OFFSET, STRIDE);
+        f_new(dst_new + PIX_OFFSET, STRIDE);
+        emms_c();
+        if (compare_dst())
+            return 1;
+    }
+    BENCH_BOTH(f_ref(dst_ref + PIX_OFFSET, STRIDE),
+               f_new(dst_new + PIX_OFFSET, STRIDE));
+    return 0;
+}
+#endif /* CONFIG_H264PRED */
+
+#if CONFIG_VP8_DECODER
+/* VP8DSPContext */
+
+typedef void (*vp8_idct_func)(uint8_t *dst, DCTELEM *block, int stride);
+typedef void (*vp8_luma_dc_wht_func)(DCTELEM block[4][4][16], DCTELEM dc[16]);
+typedef void (*vp8_loop_filter_func)(uint8_t *dst, int stride,
+                                     int flim_E, int flim_I, int hev_thresh);
+typedef void (*vp8_loop_filter_uv_func)(uint8_t *dstU, uint8_t *dstV,
+                                        int stride, int flim_E, int flim_I,
+                                        int hev_thresh);
+typedef void (*vp8_loop_filter_simple_func)(uint8_t *dst, int stride, int flim);
+
+static int check_vp8_idct(const DSPTestEntry *e, generic_func ref,
+                          generic_func new, double *t_ref, double *t_new)
+{
+    vp8_idct_func f_ref = (vp8_idct_func)ref, f_new = (vp8_idct_func)new;
+    DCTELEM *block_org = (DCTELEM *)src0, *block = (DCTELEM *)src1;
+    int i;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        fill_int16(block_org, 64, -512, 512);
+        fill_random(dst_org, BUF_SIZE);
+        prepare_dst();
+        memcpy(block, block_org, 64 * sizeof(DCTELEM));
+        f_ref(dst_ref + PIX_OFFSET, block, STRIDE);
+        memcpy(block, block_org, 64 * sizeof(DCTELEM));
+        f_new(dst_new + PIX_OFFSET, block, STRIDE);
+        emms_c();
+        if (compare_dst())
+            return 1;
+    }
+    BENCH_BOTH(f_ref(dst_ref + PIX_OFFSET, block, STRIDE),
+               f_new(dst_new + PIX_OFFSET, block, STRIDE));
+    return 0;
+}
+
+static int check_vp8_luma_dc_wht(const DSPTestEntry *e, generic_func ref,
+                                 generic_func new, double *t_ref,
+                                 double *t_new)
+{
+    vp8_luma_dc_wht_func f_ref = (vp8_luma_dc_wht_func)ref;
+    vp8_luma_dc_wht_func f_new = (vp8_luma_dc_wht_func)new;
+    DCTELEM *dc_org = (DCTELEM *)src0, *dc = (DCTELEM *)src1;
+    int i;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        fill_int16(dc_org, 16, -2048, 2048);
+        memset(dst_org, 0, BUF_SIZE);
+        prepare_dst();
+        memcpy(dc, dc_org, 16 * sizeof(DCTELEM));
+        f_ref((DCTELEM (*)[4][16])dst_ref, dc);
+        memcpy(dc, dc_org, 16 * sizeof(DCTELEM));
+        f_new((DCTELEM (*)[4][16])dst_new, dc);
+        emms_c();
+        if (compare_dst())
+            return 1;
+    }
+    BENCH_BOTH(f_ref((DCTELEM (*)[4][16])dst_ref, dc),
+               f_new((DCTELEM (*)[4][16])dst_new, dc));
+    return 0;
+}
+
+static int check_vp8_loop_filter(const DSPTestEntry *e, generic_func ref,
+                                 generic_func new, double *t_ref,
+                                 double *t_new)
+{
+    vp8_loop_filter_func f_ref = (vp8_loop_filter_func)ref;
+    vp8_loop_filter_func f_new = (vp8_loop_filter_func)new;
+    int flim_E, flim_I, hev_thresh, i;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        flim_E     = 10 + av_lfg_get(&prng) % 40;
+        flim_I     =  2 + av_lfg_get(&prng) % 16;
+        hev_thresh = av_lfg_get(&prng) % 8;
+        fill_smooth(dst_org, BUF_SIZE);
+        prepare_dst();
+        f_ref(dst_ref + PIX_OFFSET, STRIDE, flim_E, flim_I, hev_thresh);
+        f_new(dst_new + PIX_OFFSET, STRIDE, flim_E, flim_I, hev_thresh);
+        emms_c();
+        if (compare_dst())
+            return 1;
+    }
+    BENCH_BOTH(f_ref(dst_ref + PIX_OFFSET, STRIDE, 30, 10, 3),
+               f_new(dst_new + PIX_OFFSET, STRIDE, 30, 10, 3));
+    return 0;
+}
+
+static int check_vp8_loop_filter_uv(const DSPTestEntry *e, generic_func ref,
+                                    generic_func new, double *t_ref,
+                                    double *t_new)
+{
+    vp8_loop_filter_uv_func f_ref = (vp8_loop_filter_uv_func)ref;
+    vp8_loop_filter_uv_func f_new = (vp8_loop_filter_uv_func)new;
+    int flim_E, flim_I, hev_thresh, i;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        flim_E     = 10 + av_lfg_get(&prng) % 40;
+        flim_I     =  2 + av_lfg_get(&prng) % 16;
+        hev_thresh = av_lfg_get(&prng) % 8;
+        fill_smooth(dst_org, BUF_SIZE);
+        prepare_dst();
+        f_ref(dst_ref + PIX_OFFSET, dst_ref + PIX_OFFSET + 24, STRIDE,
+              flim_E, flim_I, hev_thresh);
+        f_new(dst_new + PIX_OFFSET, dst_new + PIX_OFFSET + 24, STRIDE,
+              flim_E, flim_I, hev_thresh);
+        emms_c();
+        if (compare_dst())
+            return 1;
+    }
+    BENCH_BOTH(f_ref(dst_ref + PIX_OFFSET, dst_ref + PIX_OFFSET + 24, STRIDE, 30, 10, 3),
+               f_new(dst_new + PIX_OFFSET, dst_new + PIX_OFFSET + 24, STRIDE, 30, 10, 3));
+    return 0;
+}
+
+static int check_vp8_loop_filter_simple(const DSPTestEntry *e,
+                                        generic_func ref, generic_func new,
+                                        double *t_ref, double *t_new)
+{
+    vp8_loop_filter_simple_func f_ref = (vp8_loop_filter_simple_func)ref;
+    vp8_loop_filter_simple_func f_new = (vp8_loop_filter_simple_func)new;
+    int flim, i;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        flim = 10 + av_lfg_get(&prng) % 40;
+        fill_smooth(dst_org, BUF_SIZE);
+        prepare_dst();
+        f_ref(dst_ref + PIX_OFFSET, STRIDE, flim);
+        f_new(dst_new + PIX_OFFSET, STRIDE, flim);
+        emms_c();
+        if (compare_dst())
+            return 1;
+    }
+    BENCH_BOTH(f_ref(dst_ref + PIX_OFFSET, STRIDE, 30),
+               f_new(dst_new + PIX_OFFSET, STRIDE, 30));
+    return 0;
+}
+
+/* p[0]: block width, p[1]: vertical filter, p[2]: horizontal filter,
+ * as indexes of put_vp8_epel_pixels_tab */
+static int check_vp8_mc(const DSPTestEntry *e, generic_func ref,
+                        generic_func new, double *t_ref, double *t_new)
+{
+    vp8_mc_func f_ref = (vp8_mc_func)ref, f_new = (vp8_mc_func)new;
+    uint8_t *src = src0 + PIX_OFFSET + 1;
+    int w = e->p[0], i, mx, my;
+
+    for (i = 0; i < CHECK_RUNS; i++) {
+        /* odd positions use the 4-tap filters, even ones the 6-tap ones */
+        mx = e->p[2] ? (2 * (av_lfg_get(&prng) % 3) + e->p[2]) : 0;
+        my = e->p[1] ? (2 * (av_lfg_get(&prng) % 3) + e->p[1]) : 0;
+        mx = e->p[2] == 1 ? mx | 1 : mx;
+        my = e->p[1] == 1 ? my | 1 : my;
+        fill_random(src0, BUF_SIZE);
+        fill_random(dst_org, BUF_SIZE);
+        prepare_dst();
+        f_ref(dst_ref + PIX_OFFSET, STRIDE, src, STRIDE, w, mx, my);
+        f_new(dst_new + PIX_OFFSET, STRIDE, src, STRIDE, w, mx, my);
+        emms_c();
+        if (compare_dst())
+            return 1;
+    }
+    mx = e->p[2] ? 4 - e->p[2] : 0;
+    my = e->p[1] ? 4 - e->p[1] : 0;
+    BENCH_BOTH(f_ref(dst_ref + PIX_OFFSET, STRIDE, src, STRIDE, w, mx, my),
+               f_new(dst_new + PIX_OFFSET, STRIDE, src, STRIDE, w, mx, my));
+    return 0;
+}
+#endif /* CONFIG_VP8_DECODER */
+
+static void add_test(check_func check, size_t offset, int p0, int p1, int p2,
+                     const char *fmt, ...) av_printf_format(6, 7);
+
+static void add_test(check_func check, size_t offset, int p0, int p1, int p2,
+                     const char *fmt, ...)
+{
+    DSPTestEntry *e;
+    va_list ap;
+
+    entries = av_realloc(entries, (nb_entries + 1) * sizeof(*entries));
+    if (!entries) {
+        av_log(NULL, AV_LOG_ERROR, "out of memory\n");
+        exit(1);
+    }
+    e = &entries[nb_entries++];
+    va_start(ap, fmt);
+    vsnprintf(e->name, sizeof(e->name), fmt, ap);
+    va_end(ap);
+    e->check  = check;
+    e->offset = e->ref_offset = offset;
+    e->p[0]   = p0;
+    e->p[1]   = p1;
+    e->p[2]   = p2;
+}
+
+#define OFFSET(field) offsetof(DSPTestContexts, field)
+#define ADD_TEST(ctx, field, check, p0) \
+    add_test(check, OFFSET(ctx.field), p0, 0, 0, "%s", #field)
+
+static void register_tests(void)
+{
+    static const char * const pixels_suffix[4] = { "", "_x2", "_y2", "_xy2" };
+    static const int weight_h[10] = { 16, 8, 16, 8, 4, 8, 4, 2, 4, 2 };
+    int i, j, k;
+
+    for (i = 0; i < 4; i++) {
+        for (j = 0; j < 4; j++) {
+            int w = 16 >> i, idx = 4 * i + j;
+            add_test(check_pixels, OFFSET(dsp.put_pixels_tab) + idx * sizeof(op_pixels_func),
+                     w, 0, 0, "put_pixels%d%s", w, pixels_suffix[j]);
+            add_test(check_pixels, OFFSET(dsp.avg_pixels_tab) + idx * sizeof(op_pixels_func),
+                     w, 0, 0, "avg_pixels%d%s", w, pixels_suffix[j]);
+            add_test(check_pixels, OFFSET(dsp.put_no_rnd_pixels_tab) + idx * sizeof(op_pixels_func),
+                     w, 0, 0, "put_no_rnd_pixels%d%s", w, pixels_suffix[j]);
+        }
+    }
+    for (i = 0; i < 3; i++) {
+        for (j = 0; j < 16; j++) {
+            int idx = 16 * i + j;
+            add_test(check_qpel, OFFSET(dsp.put_h264_qpel_pixels_tab) + idx * sizeof(qpel_mc_func),
+                     0, 0, 0, "put_h264_qpel%d_mc%d%d", 16 >> i, j & 3, j >> 2);
+            add_test(check_qpel, OFFSET(dsp.avg_h264_qpel_pixels_tab) + idx * sizeof(qpel_mc_func),
+                     0, 0, 0, "avg_h264_qpel%d_mc%d%d", 16 >> i, j & 3, j >> 2);
+        }
+    }
+    for (i = 0; i < 3; i++) {
+        add_test(check_chroma_mc, OFFSET(dsp.put_h264_chroma_pixels_tab) + i * sizeof(h264_chroma_mc_func),
+                 8 >> i, 0, 0, "put_h264_chroma_mc%d", 8 >> i);
+        add_test(check_chroma_mc, OFFSET(dsp.avg_h264_chroma_pixels_tab) + i * sizeof(h264_chroma_mc_func),
+                 8 >> i, 0, 0, "avg_h264_chroma_mc%d", 8 >> i);
+    }
+    for (i = 0; i < 2; i++) {
+        add_test(check_me_cmp, OFFSET(dsp.sad) + i * sizeof(me_cmp_func),
+                 16 >> i, 0, 0, "sad%d", 16 >> i);
+        add_test(check_me_cmp, OFFSET(dsp.sse) + i * sizeof(me_cmp_func),
+                 16 >> i, 0, 0, "sse%d", 16 >> i);
+        add_test(check_me_cmp, OFFSET(dsp.hadamard8_diff) + i * sizeof(me_cmp_func),
+                 16 >> i, 0, 0, "hadamard8_diff%d", 16 >> i);
+        add_test(check_sad_x4, OFFSET(dsp.sad_x4) + i * sizeof(me_cmp_x4_func),
+                 16 >> i, 0, 0, "sad_x4_%d", 16 >> i);
+        entries[nb_entries - 1].ref_offset = OFFSET(dsp.sad) + i * sizeof(me_cmp_func);
+        for (j = 0; j < 4; j++)
+            add_test(check_me_cmp, OFFSET(dsp.pix_abs) + (4 * i + j) * sizeof(me_cmp_func),
+                     16 >> i, 0, 0, "pix_abs%d%s", 16 >> i, pixels_suffix[j]);
+    }
+    ADD_TEST(dsp, put_pixels_clamped,         check_pixels_clamped, 0);
+    ADD_TEST(dsp, put_signed_pixels_clamped,  check_pixels_clamped, 0);
+    ADD_TEST(dsp, add_pixels_clamped,         check_pixels_clamped, 0);
+    ADD_TEST(dsp, add_bytes,                  check_add_bytes,   1029);
+    ADD_TEST(dsp, diff_bytes,                 check_diff_bytes,  1029);
+    ADD_TEST(dsp, bswap_buf,                  check_bswap_buf,    257);
+    ADD_TEST(dsp, vector_fmul,                check_vector_fmul,        0);
+    ADD_TEST(dsp, vector_fmul_reverse,        check_vector_fmul,        0);
+    ADD_TEST(dsp, vector_fmul_add,            check_vector_fmul_add,    0);
+    ADD_TEST(dsp, vector_fmul_window,         check_vector_fmul_window, 0);
+    ADD_TEST(dsp, vector_clipf,               check_vector_clipf,       0);
+    ADD_TEST(dsp, vector_fmul_scalar,         check_vector_fmul_scalar, 0);
+    ADD_TEST(dsp, scalarproduct_float,        check_scalarproduct_float, 0);
+    ADD_TEST(dsp, butterflies_float,          check_butterflies_float,  0);
+    ADD_TEST(dsp, vorbis_inverse_coupling,    check_inverse_coupling,   0);
+    ADD_TEST(dsp, scalarproduct_int16,        check_scalarproduct_int16, 0);
+    ADD_TEST(dsp, scalarproduct_and_madd_int16, check_scalarproduct_and_madd_int16, 0);
+
+    ADD_TEST(fmt_conv, int32_to_float_fmul_scalar, check_int32_to_float_fmul_scalar, 0);
+    ADD_TEST(fmt_conv, float_to_int16,             check_float_to_int16, 0);
+    for (i = 1; i <= 6; i++) {
+        add_test(check_float_to_int16_interleave, OFFSET(fmt_conv.float_to_int16_interleave),
+                 i, 0, 0, "float_to_int16_interleave_%dch", i);
+        add_test(check_float_interleave, OFFSET(fmt_conv.float_interleave),
+                 i, 0, 0, "float_interleave_%dch", i);
+    }
+
+#if CONFIG_AC3DSP
+    ADD_TEST(ac3dsp, ac3_exponent_min,       check_ac3_exponent_min,      0);
+    ADD_TEST(ac3dsp, ac3_max_msb_abs_int16,  check_ac3_max_msb_abs_int16, 0);
+    ADD_TEST(ac3dsp, ac3_lshift_int16,       check_ac3_lshift_int16,      0);
+    ADD_TEST(ac3dsp, ac3_rshift_int32,       check_ac3_rshift_int32,      0);
+    ADD_TEST(ac3dsp, float_to_fixed24,       check_float_to_fixed24,      0);
+    ADD_TEST(ac3dsp, update_bap_counts,      check_update_bap_counts,     0);
+    ADD_TEST(ac3dsp, compute_mantissa_size,  check_compute_mantissa_size, 0);
+    ADD_TEST(ac3dsp, extract_exponents,      check_extract_exponents,     0);
+#endif
+
+#if CONFIG_H264DSP
+    for (i = 0; i < 10; i++) {
+        add_test(check_h264_weight, OFFSET(h264dsp.weight_h264_pixels_tab) + i * sizeof(h264_weight_func),
+                 0, 0, 0, "h264_weight%dx%d", 16 >> (i > 1) >> (i > 3) >> (i > 6) >> (i == 8), weight_h[i]);
+        add_test(check_h264_biweight, OFFSET(h264dsp.biweight_h264_pixels_tab) + i * sizeof(h264_biweight_func),
+                 0, 0, 0, "h264_biweight%dx%d", 16 >> (i > 1) >> (i > 3) >> (i > 6) >> (i == 8), weight_h[i]);
+    }
+    ADD_TEST(h264dsp, h264_idct_add,                   check_h264_idct, 0);
+    ADD_TEST(h264dsp, h264_idct8_add,                  check_h264_idct, 0);
+    ADD_TEST(h264dsp, h264_idct_dc_add,                check_h264_idct, 0);
+    ADD_TEST(h264dsp, h264_idct8_dc_add,               check_h264_idct, 0);
+    ADD_TEST(h264dsp, h264_v_loop_filter_luma,         check_h264_loop_filter, 0);
+    ADD_TEST(h264dsp, h264_h_loop_filter_luma,         check_h264_loop_filter, 0);
+    ADD_TEST(h264dsp, h264_v_loop_filter_chroma,       check_h264_loop_filter, 0);
+    ADD_TEST(h264dsp, h264_h_loop_filter_chroma,       check_h264_loop_filter, 0);
+    ADD_TEST(h264dsp, h264_v_loop_filter_luma_intra,   check_h264_loop_filter_intra, 0);
+    ADD_TEST(h264dsp, h264_h_loop_filter_luma_intra,   check_h264_loop_filter_intra, 0);
+    ADD_TEST(h264dsp, h264_v_loop_filter_chroma_intra, check_h264_loop_filter_intra, 0);
+    ADD_TEST(h264dsp, h264_h_loop_filter_chroma_intra, check_h264_loop_filter_intra, 0);
+#endif
+
+#if CONFIG_H264PRED
+    for (i = 0; i < 9 + 3 + 3; i++)
+        add_test(check_pred4x4, OFFSET(h264pred.pred4x4) + i * sizeof(pred4x4_func),
+                 0, 0, 0, "pred4x4_mode%d", i);
+    for (i = 0; i < 9 + 3; i++)
+        add_test(check_pred8x8l, OFFSET(h264pred.pred8x8l) + i * sizeof(pred8x8l_func),
+                 0, 0, 0, "pred8x8l_mode%d", i);
+    for (i = 0; i < 4 + 3 + 4; i++)
+        add_test(check_pred, OFFSET(h264pred.pred8x8) + i * sizeof(pred_func),
+                 0, 0, 0, "pred8x8_mode%d", i);
+    for (i = 0; i < 4 + 3 + 2; i++)
+        add_test(check_pred, OFFSET(h264pred.pred16x16) + i * sizeof(pred_func),
+                 0, 0, 0, "pred16x16_mode%d", i);
+#endif
+
+#if CONFIG_VP8_DECODER
+    ADD_TEST(vp8dsp, vp8_luma_dc_wht,            check_vp8_luma_dc_wht, 0);
+    ADD_TEST(vp8dsp, vp8_idct_add,               check_vp8_idct, 0);
+    ADD_TEST(vp8dsp, vp8_idct_dc_add,            check_vp8_idct, 0);
+    ADD_TEST(vp8dsp, vp8_idct_dc_add4y,          check_vp8_idct, 0);
+    ADD_TEST(vp8dsp, vp8_idct_dc_add4uv,         check_vp8_idct, 0);
+    ADD_TEST(vp8dsp, vp8_v_loop_filter16y,       check_vp8_loop_filter, 0);
+    ADD_TEST(vp8dsp, vp8_h_loop_filter16y,       check_vp8_loop_filter, 0);
+    ADD_TEST(vp8dsp, vp8_v_loop_filter16y_inner, check_vp8_loop_filter, 0);
+    ADD_TEST(vp8dsp, vp8_h_loop_filter16y_inner, check_vp8_loop_filter, 0);
+    ADD_TEST(vp8dsp, vp8_v_loop_filter8uv,       check_vp8_loop_filter_uv, 0);
+    ADD_TEST(vp8dsp, vp8_h_loop_filter8uv,       check_vp8_loop_filter_uv, 0);
+    ADD_TEST(vp8dsp, vp8_v_loop_filter8uv_inner, check_vp8_loop_filter_uv, 0);
+    ADD_TEST(vp8dsp, vp8_h_loop_filter8uv_inner, check_vp8_loop_filter_uv, 0);
+    ADD_TEST(vp8dsp, vp8_v_loop_filter_simple,   check_vp8_loop_filter_simple, 0);
+    ADD_TEST(vp8dsp, vp8_h_loop_filter_simple,   check_vp8_loop_filter_simple, 0);
+    for (i = 0; i < 3; i++) {
+        for (j = 0; j < 3; j++) {
+            for (k = 0; k < 3; k++) {
+                int idx = 9 * i + 3 * j + k;
+                add_test(check_vp8_mc, OFFSET(vp8dsp.put_vp8_epel_pixels_tab) + idx * sizeof(vp8_mc_func),
+                         16 >> i, j, k, "put_vp8_epel%d_h%dv%d", 16 >> i, 2 * k, 2 * j);
+                add_test(check_vp8_mc, OFFSET(vp8dsp.put_vp8_bilinear_pixels_tab) + idx * sizeof(vp8_mc_func),
+                         16 >> i, j, k, "put_vp8_bilinear%d_h%dv%d", 16 >> i, !!k, !!j);
+            }
+        }
+    }
+#endif
+}
+
+static void init_contexts(DSPTestContexts *c, AVCodecContext *avctx, int flags)
+{
+    av_force_cpu_flags(flags);
+    dsputil_init(&c->dsp, avctx);
+    ff_fmt_convert_init(&c->fmt_conv, avctx);
+#if CONFIG_AC3DSP
+    ff_ac3dsp_init(&c->ac3dsp, 1);
+#endif
+#if CONFIG_H264DSP
+    ff_h264dsp_init(&c->h264dsp, 8);
+#endif
+#if CONFIG_H264PRED
+    ff_h264_pred_init(&c->h264pred, CODEC_ID_H264, 8);
+#endif
+#if CONFIG_VP8_DECODER
+    ff_vp8dsp_init(&c->vp8dsp);
+#endif
+}
+
+static generic_func get_func(const DSPTestContexts *c, size_t offset)
+{
+    generic_func f;
+    memcpy(&f, (const uint8_t *)c + offset, sizeof(f));
+    return f;
+}
+
+static void help(void)
+{
+    printf("dsp-test [-b] [-t <name>]\n"
+           "check the optimized versions of the DSP functions against the C ones\n"
+           "-b        also benchmark them\n"
+           "-t <name> only test the functions whose name starts with <name>\n");
+}
+
+int main(int argc, char **argv)
+{
+    AVCodecContext *avctx;
+    int variant_flags[NB_VARIANTS];
+    int host_flags, flags = 0, bench = 0, nb_failed = 0, nb_tested = 0;
+    const char *filter = NULL;
+    int c, i, v;
+
+    for (;;) {
+        c = getopt(argc, argv, "bt:h");
+        if (c == -1)
+            break;
+        switch (c) {
+        case 'b':
+            bench = 1;
+            break;
+        case 't':
+            filter = optarg;
+            break;
+        default:
+            help();
+            return 1;
+        }
+    }
+
+    avcodec_init();
+    av_lfg_init(&prng, 1);
+    avctx = avcodec_alloc_context();
+    if (!avctx)
+        return 1;
+    avctx->flags |= CODEC_FLAG_BITEXACT;
+
+    host_flags = av_get_cpu_flags();
+    init_contexts(&contexts[0], avctx, 0);
+    for (v = 0; v < NB_VARIANTS; v++) {
+        flags |= cpu_variants[v].flag;
+        variant_flags[v] = host_flags & (flags | CPU_FLAGS_MODIFIERS);
+        if (host_flags & cpu_variants[v].flag)
+            init_contexts(&contexts[v + 1], avctx, variant_flags[v]);
+    }
+
+    register_tests();
+
+    if (bench)
+        printf("%-32s %-8s %10s %10s %7s\n", "function", "cpu",
+               "C " TIME_UNIT, "new " TIME_UNIT, "speedup");
+
+    for (i = 0; i < nb_entries; i++) {
+        const DSPTestEntry *e = &entries[i];
+        generic_func ref = get_func(&contexts[0], e->ref_offset), prev = ref;
+
+        if (!ref || (filter && strncmp(e->name, filter, strlen(filter))))
+            continue;
+        for (v = 0; v < NB_VARIANTS; v++) {
+            generic_func new;
+            double t_ref, t_new;
+
+            if (!(host_flags & cpu_variants[v].flag))
+                continue;
+            new = get_func(&contexts[v + 1], e->offset);
+            if (!new || new == ref || new == prev)
+                continue;
+            prev = new;
+            nb_tested++;
+
+            av_force_cpu_flags(variant_flags[v]);
+            if (e->check(e, ref, new, bench ? &t_ref : NULL, &t_new)) {
+                av_log(NULL, AV_LOG_ERROR, "%s %s: FAILED\n",
+                       e->name, cpu_variants[v].name);
+                nb_failed++;
+            } else if (bench) {
+                printf("%-32s %-8s %10.1f %10.1f %6.2fx\n",
+                       e->name, cpu_variants[v].name, t_ref, t_new,
+                       t_new > 0 ? t_ref / t_new : 0);
+            }
+        }
+    }
+
+    av_log(NULL, AV_LOG_INFO, "%d functions tested, %d failed\n",
+           nb_tested, nb_failed);
+
+    av_free(avctx);
+    av_free(entries);
+    return !!nb_failed;
+}
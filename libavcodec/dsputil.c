@@ -1965,6 +1965,30 @@ static void add_hfyu_median_prediction_c(uint8_t *dst, const uint8_t *src1, cons
     *left_top= lt;
 }
 
+static void add_lag_median_prediction_c(uint8_t *dst, const uint8_t *src1,
+                                        const uint8_t *diff, int w, int *left,
+                                        int *left_top)
+{
+    /* This is almost identical to add_hfyu_median_prediction.
+     * However the &0xFF on the gradient predictor yealds incorrect output
+     * for lagarith.
+     */
+    int i;
+    uint8_t l, lt;
+
+    l  = *left;
+    lt = *left_top;
+
+    for (i = 0; i < w; i++) {
+        l = mid_pred(l, src1[i], l + src1[i] - lt) + diff[i];
+        lt = src1[i];
+        dst[i] = l;
+    }
+
+    *left     = l;
+    *left_top = lt;
+}
+
 static void sub_hfyu_median_prediction_c(uint8_t *dst, const uint8_t *src1, const uint8_t *src2, int w, int *left, int *left_top){
     int i;
     uint8_t l, lt;
@@ -1983,6 +2007,33 @@ static void sub_hfyu_median_prediction_c(uint8_t *dst, const uint8_t *src1, cons
     *left_top= lt;
 }
 
+static void sub_png_paeth_prediction_c(uint8_t *dst, uint8_t *src, uint8_t *top, int w, int bpp)
+{
+    int i;
+    for(i = 0; i < w; i++) {
+        int a, b, c, p, pa, pb, pc;
+
+        a = src[i - bpp];
+        b = top[i];
+        c = top[i - bpp];
+
+        p = b - c;
+        pc = a - c;
+
+        pa = abs(p);
+        pb = abs(pc);
+        pc = abs(p + pc);
+
+        if (pa <= pb && pa <= pc)
+            p = a;
+        else if (pb <= pc)
+            p = b;
+        else
+            p = c;
+        dst[i] = src[i] - p;
+    }
+}
+
 static int add_hfyu_left_prediction_c(uint8_t *dst, const uint8_t *src, int w, int acc){
     int i;
 
@@ -2586,6 +2637,29 @@ static float scalarproduct_float_c(const float *v1, const float *v2, int len)
     return p;
 }
 
+static void aac_abs_pow34_c(float *out, const float *in, int size)
+{
+    int i;
+    for (i = 0; i < size; i++) {
+        float a = fabsf(in[i]);
+        out[i] = sqrtf(a * sqrtf(a));
+    }
+}
+
+static void aac_quantize_bands_c(int *out, const float *in, const float *scaled,
+                                 int size, float Q34, int is_signed, int maxval)
+{
+    int i;
+    double qc;
+    for (i = 0; i < size; i++) {
+        qc = scaled[i] * Q34;
+        out[i] = (int)FFMIN(qc + 0.4054, (double)maxval);
+        if (is_signed && in[i] < 0.0f) {
+            out[i] = -out[i];
+        }
+    }
+}
+
 static inline uint32_t clipf_c_one(uint32_t a, uint32_t mini,
                    uint32_t maxi, uint32_t maxisign)
 {
@@ -3047,6 +3121,7 @@ av_cold void dsputil_init(DSPContext* c, AVCodecContext *avctx)
 #endif
     c->sad[0]= pix_abs16_c;
     c->sad[1]= pix_abs8_c;
+    c->sad_x4[0]= c->sad_x4[1]= NULL;
     c->sse[0]= sse16_c;
     c->sse[1]= sse8_c;
     c->sse[2]= sse4_c;
@@ -3071,8 +3146,10 @@ av_cold void dsputil_init(DSPContext* c, AVCodecContext *avctx)
     c->diff_bytes= diff_bytes_c;
     c->add_hfyu_median_prediction= add_hfyu_median_prediction_c;
     c->sub_hfyu_median_prediction= sub_hfyu_median_prediction_c;
+    c->add_lag_median_prediction = add_lag_median_prediction_c;
     c->add_hfyu_left_prediction  = add_hfyu_left_prediction_c;
     c->add_hfyu_left_prediction_bgr32 = add_hfyu_left_prediction_bgr32_c;
+    c->sub_png_paeth_prediction = sub_png_paeth_prediction_c;
     c->bswap_buf= bswap_buf;
     c->bswap16_buf = bswap16_buf;
 
@@ -3108,6 +3185,8 @@ av_cold void dsputil_init(DSPContext* c, AVCodecContext *avctx)
     c->apply_window_int16 = apply_window_int16_c;
     c->scalarproduct_float = scalarproduct_float_c;
     c->butterflies_float = butterflies_float_c;
+    c->aac_abs_pow34 = aac_abs_pow34_c;
+    c->aac_quantize_bands = aac_quantize_bands_c;
     c->vector_fmul_scalar = vector_fmul_scalar_c;
 
     c->vector_fmul_sv_scalar[0] = vector_fmul_sv_scalar_2_c;
@@ -186,6 +186,8 @@ static void a(uint8_t *block, const uint8_t *pixels, int line_size, int h){\
 // h is limited to {width/2, width, 2*width} but never larger than 16 and never smaller then 2
 // although currently h<4 is not used as functions with width <8 are neither used nor implemented
 typedef int (*me_cmp_func)(void /*MpegEncContext*/ *s, uint8_t *blk1/*align width (8 or 16)*/, uint8_t *blk2/*align 1*/, int line_size, int h)/* __attribute__ ((const))*/;
+/* compares blk1 against the 4 candidates blk2[0..3] in one call, score[i] is the result for blk2[i] */
+typedef void (*me_cmp_x4_func)(void /*MpegEncContext*/ *s, uint8_t *blk1/*align 1*/, uint8_t * const blk2[4]/*align 1*/, int line_size, int h, int score[4]);
 
 /**
  * Scantable.
@@ -262,6 +264,7 @@ typedef struct DSPContext {
 // 16x16 8x8 4x4 2x2 16x8 8x4 4x2 8x16 4x8 2x4
 
     me_cmp_func sad[6]; /* identical to pix_absAxA except additional void * */
+    me_cmp_x4_func sad_x4[2]; /* sad[] of one block against 4 candidates, 16x16/16x8 and 8x8, NULL if there is no SIMD version */
     me_cmp_func sse[6];
     me_cmp_func hadamard8_diff[6];
     me_cmp_func dct_sad[6];
@@ -378,8 +381,18 @@ typedef struct DSPContext {
      */
     void (*sub_hfyu_median_prediction)(uint8_t *dst, const uint8_t *src1, const uint8_t *src2, int w, int *left, int *left_top);
     void (*add_hfyu_median_prediction)(uint8_t *dst, const uint8_t *top, const uint8_t *diff, int w, int *left, int *left_top);
+    /**
+     * add lagarith's variant of median prediction, whose gradient is
+     * clipped instead of wrapped around
+     */
+    void (*add_lag_median_prediction)(uint8_t *dst, const uint8_t *top, const uint8_t *diff, int w, int *left, int *left_top);
     int  (*add_hfyu_left_prediction)(uint8_t *dst, const uint8_t *src, int w, int left);
     void (*add_hfyu_left_prediction_bgr32)(uint8_t *dst, const uint8_t *src, int w, int *red, int *green, int *blue, int *alpha);
+    /**
+     * subtract the png paeth prediction
+     * note, this reads from src[-bpp] and top[-bpp]
+     */
+    void (*sub_png_paeth_prediction)(uint8_t *dst, uint8_t *src, uint8_t *top, int w, int bpp);
     /* this might write to dst[w] */
     void (*bswap_buf)(uint32_t *dst, const uint32_t *src, int w);
     void (*bswap16_buf)(uint16_t *dst, const uint16_t *src, int len);
@@ -458,6 +471,23 @@ typedef struct DSPContext {
      * @param len length of vectors, multiple of 4
      */
     void (*butterflies_float)(float *restrict v1, float *restrict v2, int len);
+    /**
+     * Calculate |x|^(3/4) of a vector of floats, for the AAC quantizer.
+     * @param out output vector
+     * @param in  input vector
+     * @param size length of vectors, multiple of 4
+     */
+    void (*aac_abs_pow34)(float *out, const float *in, int size);
+    /**
+     * Quantize AAC coefficients: out = min(scaled * Q34 + 0.4054, maxval),
+     * negated where in is negative if is_signed is set.
+     * @param out    quantized coefficients
+     * @param in     coefficients, only their signs are used
+     * @param scaled |in|^(3/4) as calculated by aac_abs_pow34()
+     * @param size   length of vectors, multiple of 4
+     */
+    void (*aac_quantize_bands)(int *out, const float *in, const float *scaled,
+                               int size, float Q34, int is_signed, int maxval);
 
     /* (I)DCT */
     void (*fdct)(DCTELEM *block/* align 16*/);
@@ -46,6 +46,7 @@
 #include "simple_idct.h"
 #include "dvdata.h"
 #include "dv_tablegen.h"
+#include "thread.h"
 
 //#undef NDEBUG
 //#include <assert.h>
@@ -639,6 +640,24 @@ static int dv_decode_video_segment(AVCodecContext *avctx, void *arg)
     return 0;
 }
 
+/**
+ * Decode a contiguous run of video segments, so that the job count of a
+ * frame follows the thread count instead of the number of segments.
+ */
+static int dv_decode_video_segments(AVCodecContext *avctx, void *arg,
+                                    int jobnr, int threadnr)
+{
+    DVVideoContext *s = avctx->priv_data;
+    int nb_jobs  = *(int*)arg;
+    int nb_segs  = dv_work_pool_size(s->sys);
+    int seg_end  = nb_segs * (jobnr + 1) / nb_jobs;
+    int seg;
+
+    for (seg = nb_segs * jobnr / nb_jobs; seg < seg_end; seg++)
+        dv_decode_video_segment(avctx, &s->sys->work_chunks[seg]);
+    return 0;
+}
+
 #if CONFIG_SMALL
 /* Converts run and level (where level != 0) pair into vlc, returning bit size */
 static av_always_inline int dv_rl2vlc(int run, int level, int sign, uint32_t* vlc)
@@ -1069,7 +1088,7 @@ static int dvvideo_decode_frame(AVCodecContext *avctx,
     int buf_size = avpkt->size;
     DVVideoContext *s = avctx->priv_data;
     const uint8_t* vsc_pack;
-    int apt, is16_9;
+    int apt, is16_9, nb_jobs;
 
     s->sys = ff_dv_frame_profile(s->sys, buf, buf_size);
     if (!s->sys || buf_size < s->sys->frame_size || dv_init_dynamic_tables(s->sys)) {
@@ -1078,7 +1097,7 @@ static int dvvideo_decode_frame(AVCodecContext *avctx,
     }
 
     if (s->picture.data[0])
-        avctx->release_buffer(avctx, &s->picture);
+        ff_thread_release_buffer(avctx, &s->picture);
 
     avcodec_get_frame_defaults(&s->picture);
     s->picture.reference = 0;
@@ -1087,23 +1106,13 @@ static int dvvideo_decode_frame(AVCodecContext *avctx,
     avctx->pix_fmt   = s->sys->pix_fmt;
     avctx->time_base = s->sys->time_base;
     avcodec_set_dimensions(avctx, s->sys->width, s->sys->height);
-    if (avctx->get_buffer(avctx, &s->picture) < 0) {
+    if (ff_thread_get_buffer(avctx, &s->picture) < 0) {
         av_log(avctx, AV_LOG_ERROR, "get_buffer() failed\n");
         return -1;
     }
     s->picture.interlaced_frame = 1;
     s->picture.top_field_first  = 0;
 
-    s->buf = buf;
-    avctx->execute(avctx, dv_decode_video_segment, s->sys->work_chunks, NULL,
-                   dv_work_pool_size(s->sys), sizeof(DVwork_chunk));
-
-    emms_c();
-
-    /* return image */
-    *data_size = sizeof(AVFrame);
-    *(AVFrame*)data = s->picture;
-
     /* Determine the codec's sample_aspect ratio from the packet */
     vsc_pack = buf + 80*5 + 48 + 5;
     if ( *vsc_pack == dv_video_control ) {
@@ -1112,6 +1121,22 @@ static int dvvideo_decode_frame(AVCodecContext *avctx,
         avctx->sample_aspect_ratio = s->sys->sar[is16_9];
     }
 
+    /* Every frame is intra and the profile tables are set up above, so the
+     * next frame thread can start. */
+    ff_thread_finish_setup(avctx);
+
+    /* a few jobs per thread even out the differences between segments */
+    s->buf  = buf;
+    nb_jobs = avctx->active_thread_type & FF_THREAD_SLICE ?
+              FFMIN(avctx->thread_count * 4, dv_work_pool_size(s->sys)) : 1;
+    avctx->execute2(avctx, dv_decode_video_segments, &nb_jobs, NULL, nb_jobs);
+
+    emms_c();
+
+    /* return image */
+    *data_size = sizeof(AVFrame);
+    *(AVFrame*)data = s->picture;
+
     return s->sys->frame_size;
 }
 #endif /* CONFIG_DVVIDEO_DECODER */
@@ -1266,6 +1291,18 @@ static int dvvideo_encode_frame(AVCodecContext *c, uint8_t *buf, int buf_size,
 }
 #endif
 
+#if CONFIG_DVVIDEO_DECODER
+static av_cold int dvvideo_init_thread_copy(AVCodecContext *avctx)
+{
+    DVVideoContext *s = avctx->priv_data;
+
+    avctx->coded_frame = &s->picture;
+    s->avctx = avctx;
+
+    return 0;
+}
+#endif
+
 static int dvvideo_close(AVCodecContext *c)
 {
     DVVideoContext *s = c->priv_data;
@@ -1301,9 +1338,10 @@ AVCodec ff_dvvideo_decoder = {
     NULL,
     dvvideo_close,
     dvvideo_decode_frame,
-    CODEC_CAP_DR1 | CODEC_CAP_SLICE_THREADS,
+    CODEC_CAP_DR1 | CODEC_CAP_SLICE_THREADS | CODEC_CAP_FRAME_THREADS,
     NULL,
     .max_lowres = 3,
     .long_name = NULL_IF_CONFIG_SMALL("DV (Digital Video)"),
+    .init_thread_copy = ONLY_IF_THREADS_ENABLED(dvvideo_init_thread_copy),
 };
 #endif
@@ -163,7 +163,7 @@ static inline void decode_block_intra(MadContext * t, DCTELEM * block)
                 }
             }
             if (i > 63) {
-                av_log(s->avctx, AV_LOG_ERROR, "ac-tex damaged at %d %d\n", s->mb_x, s->mb_y);
+                av_log_ratelimited(s->avctx, AV_LOG_ERROR, "ac-tex damaged at %d %d\n", s->mb_x, s->mb_y);
                 return;
             }
 
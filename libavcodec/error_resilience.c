@@ -148,86 +148,85 @@ static void filter181(int16_t *data, int width, int height, int stride){
 }
 
 /**
- * guess the dc of blocks which do not have an undamaged dc
+ * guess the dc of the blocks of a row which do not have an undamaged dc
  * @param w     width in 8 pixel blocks
  * @param h     height in 8 pixel blocks
+ * @param b_y   row of blocks
  */
-static void guess_dc(MpegEncContext *s, int16_t *dc, int w, int h, int stride, int is_luma){
-    int b_x, b_y;
-
-    for(b_y=0; b_y<h; b_y++){
-        for(b_x=0; b_x<w; b_x++){
-            int color[4]={1024,1024,1024,1024};
-            int distance[4]={9999,9999,9999,9999};
-            int mb_index, error, j;
-            int64_t guess, weight_sum;
-
-            mb_index= (b_x>>is_luma) + (b_y>>is_luma)*s->mb_stride;
-
-            error= s->error_status_table[mb_index];
-
-            if(IS_INTER(s->current_picture.mb_type[mb_index])) continue; //inter
-            if(!(error&DC_ERROR)) continue;           //dc-ok
-
-            /* right block */
-            for(j=b_x+1; j<w; j++){
-                int mb_index_j= (j>>is_luma) + (b_y>>is_luma)*s->mb_stride;
-                int error_j= s->error_status_table[mb_index_j];
-                int intra_j= IS_INTRA(s->current_picture.mb_type[mb_index_j]);
-                if(intra_j==0 || !(error_j&DC_ERROR)){
-                    color[0]= dc[j + b_y*stride];
-                    distance[0]= j-b_x;
-                    break;
-                }
-            }
-
-            /* left block */
-            for(j=b_x-1; j>=0; j--){
-                int mb_index_j= (j>>is_luma) + (b_y>>is_luma)*s->mb_stride;
-                int error_j= s->error_status_table[mb_index_j];
-                int intra_j= IS_INTRA(s->current_picture.mb_type[mb_index_j]);
-                if(intra_j==0 || !(error_j&DC_ERROR)){
-                    color[1]= dc[j + b_y*stride];
-                    distance[1]= b_x-j;
-                    break;
-                }
+static void guess_dc(MpegEncContext *s, int16_t *dc, int w, int h, int stride, int is_luma, int b_y){
+    int b_x;
+
+    for(b_x=0; b_x<w; b_x++){
+        int color[4]={1024,1024,1024,1024};
+        int distance[4]={9999,9999,9999,9999};
+        int mb_index, error, j;
+        int64_t guess, weight_sum;
+
+        mb_index= (b_x>>is_luma) + (b_y>>is_luma)*s->mb_stride;
+
+        error= s->error_status_table[mb_index];
+
+        if(IS_INTER(s->current_picture.mb_type[mb_index])) continue; //inter
+        if(!(error&DC_ERROR)) continue;           //dc-ok
+
+        /* right block */
+        for(j=b_x+1; j<w; j++){
+            int mb_index_j= (j>>is_luma) + (b_y>>is_luma)*s->mb_stride;
+            int error_j= s->error_status_table[mb_index_j];
+            int intra_j= IS_INTRA(s->current_picture.mb_type[mb_index_j]);
+            if(intra_j==0 || !(error_j&DC_ERROR)){
+                color[0]= dc[j + b_y*stride];
+                distance[0]= j-b_x;
+                break;
             }
+        }
 
-            /* bottom block */
-            for(j=b_y+1; j<h; j++){
-                int mb_index_j= (b_x>>is_luma) + (j>>is_luma)*s->mb_stride;
-                int error_j= s->error_status_table[mb_index_j];
-                int intra_j= IS_INTRA(s->current_picture.mb_type[mb_index_j]);
-                if(intra_j==0 || !(error_j&DC_ERROR)){
-                    color[2]= dc[b_x + j*stride];
-                    distance[2]= j-b_y;
-                    break;
-                }
+        /* left block */
+        for(j=b_x-1; j>=0; j--){
+            int mb_index_j= (j>>is_luma) + (b_y>>is_luma)*s->mb_stride;
+            int error_j= s->error_status_table[mb_index_j];
+            int intra_j= IS_INTRA(s->current_picture.mb_type[mb_index_j]);
+            if(intra_j==0 || !(error_j&DC_ERROR)){
+                color[1]= dc[j + b_y*stride];
+                distance[1]= b_x-j;
+                break;
             }
+        }
 
-            /* top block */
-            for(j=b_y-1; j>=0; j--){
-                int mb_index_j= (b_x>>is_luma) + (j>>is_luma)*s->mb_stride;
-                int error_j= s->error_status_table[mb_index_j];
-                int intra_j= IS_INTRA(s->current_picture.mb_type[mb_index_j]);
-                if(intra_j==0 || !(error_j&DC_ERROR)){
-                    color[3]= dc[b_x + j*stride];
-                    distance[3]= b_y-j;
-                    break;
-                }
+        /* bottom block */
+        for(j=b_y+1; j<h; j++){
+            int mb_index_j= (b_x>>is_luma) + (j>>is_luma)*s->mb_stride;
+            int error_j= s->error_status_table[mb_index_j];
+            int intra_j= IS_INTRA(s->current_picture.mb_type[mb_index_j]);
+            if(intra_j==0 || !(error_j&DC_ERROR)){
+                color[2]= dc[b_x + j*stride];
+                distance[2]= j-b_y;
+                break;
             }
+        }
 
-            weight_sum=0;
-            guess=0;
-            for(j=0; j<4; j++){
-                int64_t weight= 256*256*256*16/distance[j];
-                guess+= weight*(int64_t)color[j];
-                weight_sum+= weight;
+        /* top block */
+        for(j=b_y-1; j>=0; j--){
+            int mb_index_j= (b_x>>is_luma) + (j>>is_luma)*s->mb_stride;
+            int error_j= s->error_status_table[mb_index_j];
+            int intra_j= IS_INTRA(s->current_picture.mb_type[mb_index_j]);
+            if(intra_j==0 || !(error_j&DC_ERROR)){
+                color[3]= dc[b_x + j*stride];
+                distance[3]= b_y-j;
+                break;
             }
-            guess= (guess + weight_sum/2) / weight_sum;
+        }
 
-            dc[b_x + b_y*stride]= guess;
+        weight_sum=0;
+        guess=0;
+        for(j=0; j<4; j++){
+            int64_t weight= 256*256*256*16/distance[j];
+            guess+= weight*(int64_t)color[j];
+            weight_sum+= weight;
         }
+        guess= (guess + weight_sum/2) / weight_sum;
+
+        dc[b_x + b_y*stride]= guess;
     }
 }
 
@@ -235,60 +234,59 @@ static void guess_dc(MpegEncContext *s, int16_t *dc, int w, int h, int stride, i
  * simple horizontal deblocking filter used for error resilience
  * @param w     width in 8 pixel blocks
  * @param h     height in 8 pixel blocks
+ * @param b_y   row of blocks to filter
  */
-static void h_block_filter(MpegEncContext *s, uint8_t *dst, int w, int h, int stride, int is_luma){
-    int b_x, b_y, mvx_stride, mvy_stride;
+static void h_block_filter(MpegEncContext *s, uint8_t *dst, int w, int h, int stride, int is_luma, int b_y){
+    int b_x, mvx_stride, mvy_stride;
     uint8_t *cm = ff_cropTbl + MAX_NEG_CROP;
     set_mv_strides(s, &mvx_stride, &mvy_stride);
     mvx_stride >>= is_luma;
     mvy_stride *= mvx_stride;
 
-    for(b_y=0; b_y<h; b_y++){
-        for(b_x=0; b_x<w-1; b_x++){
-            int y;
-            int left_status = s->error_status_table[( b_x   >>is_luma) + (b_y>>is_luma)*s->mb_stride];
-            int right_status= s->error_status_table[((b_x+1)>>is_luma) + (b_y>>is_luma)*s->mb_stride];
-            int left_intra=   IS_INTRA(s->current_picture.mb_type      [( b_x   >>is_luma) + (b_y>>is_luma)*s->mb_stride]);
-            int right_intra=  IS_INTRA(s->current_picture.mb_type      [((b_x+1)>>is_luma) + (b_y>>is_luma)*s->mb_stride]);
-            int left_damage =  left_status&(DC_ERROR|AC_ERROR|MV_ERROR);
-            int right_damage= right_status&(DC_ERROR|AC_ERROR|MV_ERROR);
-            int offset= b_x*8 + b_y*stride*8;
-            int16_t *left_mv=  s->current_picture.motion_val[0][mvy_stride*b_y + mvx_stride* b_x   ];
-            int16_t *right_mv= s->current_picture.motion_val[0][mvy_stride*b_y + mvx_stride*(b_x+1)];
+    for(b_x=0; b_x<w-1; b_x++){
+        int y;
+        int left_status = s->error_status_table[( b_x   >>is_luma) + (b_y>>is_luma)*s->mb_stride];
+        int right_status= s->error_status_table[((b_x+1)>>is_luma) + (b_y>>is_luma)*s->mb_stride];
+        int left_intra=   IS_INTRA(s->current_picture.mb_type      [( b_x   >>is_luma) + (b_y>>is_luma)*s->mb_stride]);
+        int right_intra=  IS_INTRA(s->current_picture.mb_type      [((b_x+1)>>is_luma) + (b_y>>is_luma)*s->mb_stride]);
+        int left_damage =  left_status&(DC_ERROR|AC_ERROR|MV_ERROR);
+        int right_damage= right_status&(DC_ERROR|AC_ERROR|MV_ERROR);
+        int offset= b_x*8 + b_y*stride*8;
+        int16_t *left_mv=  s->current_picture.motion_val[0][mvy_stride*b_y + mvx_stride* b_x   ];
+        int16_t *right_mv= s->current_picture.motion_val[0][mvy_stride*b_y + mvx_stride*(b_x+1)];
 
-            if(!(left_damage||right_damage)) continue; // both undamaged
+        if(!(left_damage||right_damage)) continue; // both undamaged
 
-            if(   (!left_intra) && (!right_intra)
-               && FFABS(left_mv[0]-right_mv[0]) + FFABS(left_mv[1]+right_mv[1]) < 2) continue;
+        if(   (!left_intra) && (!right_intra)
+           && FFABS(left_mv[0]-right_mv[0]) + FFABS(left_mv[1]+right_mv[1]) < 2) continue;
 
-            for(y=0; y<8; y++){
-                int a,b,c,d;
+        for(y=0; y<8; y++){
+            int a,b,c,d;
 
-                a= dst[offset + 7 + y*stride] - dst[offset + 6 + y*stride];
-                b= dst[offset + 8 + y*stride] - dst[offset + 7 + y*stride];
-                c= dst[offset + 9 + y*stride] - dst[offset + 8 + y*stride];
+            a= dst[offset + 7 + y*stride] - dst[offset + 6 + y*stride];
+            b= dst[offset + 8 + y*stride] - dst[offset + 7 + y*stride];
+            c= dst[offset + 9 + y*stride] - dst[offset + 8 + y*stride];
 
-                d= FFABS(b) - ((FFABS(a) + FFABS(c) + 1)>>1);
-                d= FFMAX(d, 0);
-                if(b<0) d= -d;
+            d= FFABS(b) - ((FFABS(a) + FFABS(c) + 1)>>1);
+            d= FFMAX(d, 0);
+            if(b<0) d= -d;
 
-                if(d==0) continue;
+            if(d==0) continue;
 
-                if(!(left_damage && right_damage))
-                    d= d*16/9;
+            if(!(left_damage && right_damage))
+                d= d*16/9;
 
-                if(left_damage){
-                    dst[offset + 7 + y*stride] = cm[dst[offset + 7 + y*stride] + ((d*7)>>4)];
-                    dst[offset + 6 + y*stride] = cm[dst[offset + 6 + y*stride] + ((d*5)>>4)];
-                    dst[offset + 5 + y*stride] = cm[dst[offset + 5 + y*stride] + ((d*3)>>4)];
-                    dst[offset + 4 + y*stride] = cm[dst[offset + 4 + y*stride] + ((d*1)>>4)];
-                }
-                if(right_damage){
-                    dst[offset + 8 + y*stride] = cm[dst[offset + 8 + y*stride] - ((d*7)>>4)];
-                    dst[offset + 9 + y*stride] = cm[dst[offset + 9 + y*stride] - ((d*5)>>4)];
-                    dst[offset + 10+ y*stride] = cm[dst[offset +10 + y*stride] - ((d*3)>>4)];
-                    dst[offset + 11+ y*stride] = cm[dst[offset +11 + y*stride] - ((d*1)>>4)];
-                }
+            if(left_damage){
+                dst[offset + 7 + y*stride] = cm[dst[offset + 7 + y*stride] + ((d*7)>>4)];
+                dst[offset + 6 + y*stride] = cm[dst[offset + 6 + y*stride] + ((d*5)>>4)];
+                dst[offset + 5 + y*stride] = cm[dst[offset + 5 + y*stride] + ((d*3)>>4)];
+                dst[offset + 4 + y*stride] = cm[dst[offset + 4 + y*stride] + ((d*1)>>4)];
+            }
+            if(right_damage){
+                dst[offset + 8 + y*stride] = cm[dst[offset + 8 + y*stride] - ((d*7)>>4)];
+                dst[offset + 9 + y*stride] = cm[dst[offset + 9 + y*stride] - ((d*5)>>4)];
+                dst[offset + 10+ y*stride] = cm[dst[offset +10 + y*stride] - ((d*3)>>4)];
+                dst[offset + 11+ y*stride] = cm[dst[offset +11 + y*stride] - ((d*1)>>4)];
             }
         }
     }
@@ -298,60 +296,60 @@ static void h_block_filter(MpegEncContext *s, uint8_t *dst, int w, int h, int st
  * simple vertical deblocking filter used for error resilience
  * @param w     width in 8 pixel blocks
  * @param h     height in 8 pixel blocks
+ * @param b_y   filter the edges between the rows of blocks b_y and b_y+1,
+ *              which only change the 4 lines of pixels on each side
  */
-static void v_block_filter(MpegEncContext *s, uint8_t *dst, int w, int h, int stride, int is_luma){
-    int b_x, b_y, mvx_stride, mvy_stride;
+static void v_block_filter(MpegEncContext *s, uint8_t *dst, int w, int h, int stride, int is_luma, int b_y){
+    int b_x, mvx_stride, mvy_stride;
     uint8_t *cm = ff_cropTbl + MAX_NEG_CROP;
     set_mv_strides(s, &mvx_stride, &mvy_stride);
     mvx_stride >>= is_luma;
     mvy_stride *= mvx_stride;
 
-    for(b_y=0; b_y<h-1; b_y++){
-        for(b_x=0; b_x<w; b_x++){
-            int x;
-            int top_status   = s->error_status_table[(b_x>>is_luma) + ( b_y   >>is_luma)*s->mb_stride];
-            int bottom_status= s->error_status_table[(b_x>>is_luma) + ((b_y+1)>>is_luma)*s->mb_stride];
-            int top_intra=     IS_INTRA(s->current_picture.mb_type      [(b_x>>is_luma) + ( b_y   >>is_luma)*s->mb_stride]);
-            int bottom_intra=  IS_INTRA(s->current_picture.mb_type      [(b_x>>is_luma) + ((b_y+1)>>is_luma)*s->mb_stride]);
-            int top_damage =      top_status&(DC_ERROR|AC_ERROR|MV_ERROR);
-            int bottom_damage= bottom_status&(DC_ERROR|AC_ERROR|MV_ERROR);
-            int offset= b_x*8 + b_y*stride*8;
-            int16_t *top_mv=    s->current_picture.motion_val[0][mvy_stride* b_y    + mvx_stride*b_x];
-            int16_t *bottom_mv= s->current_picture.motion_val[0][mvy_stride*(b_y+1) + mvx_stride*b_x];
+    for(b_x=0; b_x<w; b_x++){
+        int x;
+        int top_status   = s->error_status_table[(b_x>>is_luma) + ( b_y   >>is_luma)*s->mb_stride];
+        int bottom_status= s->error_status_table[(b_x>>is_luma) + ((b_y+1)>>is_luma)*s->mb_stride];
+        int top_intra=     IS_INTRA(s->current_picture.mb_type      [(b_x>>is_luma) + ( b_y   >>is_luma)*s->mb_stride]);
+        int bottom_intra=  IS_INTRA(s->current_picture.mb_type      [(b_x>>is_luma) + ((b_y+1)>>is_luma)*s->mb_stride]);
+        int top_damage =      top_status&(DC_ERROR|AC_ERROR|MV_ERROR);
+        int bottom_damage= bottom_status&(DC_ERROR|AC_ERROR|MV_ERROR);
+        int offset= b_x*8 + b_y*stride*8;
+        int16_t *top_mv=    s->current_picture.motion_val[0][mvy_stride* b_y    + mvx_stride*b_x];
+        int16_t *bottom_mv= s->current_picture.motion_val[0][mvy_stride*(b_y+1) + mvx_stride*b_x];
 
-            if(!(top_damage||bottom_damage)) continue; // both undamaged
+        if(!(top_damage||bottom_damage)) continue; // both undamaged
 
-            if(   (!top_intra) && (!bottom_intra)
-               && FFABS(top_mv[0]-bottom_mv[0]) + FFABS(top_mv[1]+bottom_mv[1]) < 2) continue;
+        if(   (!top_intra) && (!bottom_intra)
+           && FFABS(top_mv[0]-bottom_mv[0]) + FFABS(top_mv[1]+bottom_mv[1]) < 2) continue;
 
-            for(x=0; x<8; x++){
-                int a,b,c,d;
+        for(x=0; x<8; x++){
+            int a,b,c,d;
 
-                a= dst[offset + x + 7*stride] - dst[offset + x + 6*stride];
-                b= dst[offset + x + 8*stride] - dst[offset + x + 7*stride];
-                c= dst[offset + x + 9*stride] - dst[offset + x + 8*stride];
+            a= dst[offset + x + 7*stride] - dst[offset + x + 6*stride];
+            b= dst[offset + x + 8*stride] - dst[offset + x + 7*stride];
+            c= dst[offset + x + 9*stride] - dst[offset + x + 8*stride];
 
-                d= FFABS(b) - ((FFABS(a) + FFABS(c)+1)>>1);
-                d= FFMAX(d, 0);
-                if(b<0) d= -d;
+            d= FFABS(b) - ((FFABS(a) + FFABS(c)+1)>>1);
+            d= FFMAX(d, 0);
+            if(b<0) d= -d;
 
-                if(d==0) continue;
+            if(d==0) continue;
 
-                if(!(top_damage && bottom_damage))
-                    d= d*16/9;
+            if(!(top_damage && bottom_damage))
+                d= d*16/9;
 
-                if(top_damage){
-                    dst[offset + x +  7*stride] = cm[dst[offset + x +  7*stride] + ((d*7)>>4)];
-                    dst[offset + x +  6*stride] = cm[dst[offset + x +  6*stride] + ((d*5)>>4)];
-                    dst[offset + x +  5*stride] = cm[dst[offset + x +  5*stride] + ((d*3)>>4)];
-                    dst[offset + x +  4*stride] = cm[dst[offset + x +  4*stride] + ((d*1)>>4)];
-                }
-                if(bottom_damage){
-                    dst[offset + x +  8*stride] = cm[dst[offset + x +  8*stride] - ((d*7)>>4)];
-                    dst[offset + x +  9*stride] = cm[dst[offset + x +  9*stride] - ((d*5)>>4)];
-                    dst[offset + x + 10*stride] = cm[dst[offset + x + 10*stride] - ((d*3)>>4)];
-                    dst[offset + x + 11*stride] = cm[dst[offset + x + 11*stride] - ((d*1)>>4)];
-                }
+            if(top_damage){
+                dst[offset + x +  7*stride] = cm[dst[offset + x +  7*stride] + ((d*7)>>4)];
+                dst[offset + x +  6*stride] = cm[dst[offset + x +  6*stride] + ((d*5)>>4)];
+                dst[offset + x +  5*stride] = cm[dst[offset + x +  5*stride] + ((d*3)>>4)];
+                dst[offset + x +  4*stride] = cm[dst[offset + x +  4*stride] + ((d*1)>>4)];
+            }
+            if(bottom_damage){
+                dst[offset + x +  8*stride] = cm[dst[offset + x +  8*stride] - ((d*7)>>4)];
+                dst[offset + x +  9*stride] = cm[dst[offset + x +  9*stride] - ((d*5)>>4)];
+                dst[offset + x + 10*stride] = cm[dst[offset + x + 10*stride] - ((d*3)>>4)];
+                dst[offset + x + 11*stride] = cm[dst[offset + x + 11*stride] - ((d*1)>>4)];
             }
         }
     }
@@ -787,6 +785,110 @@ void ff_er_add_slice(MpegEncContext *s, int startx, int starty, int endx, int en
     }
 }
 
+/* The passes below only depend on the rows they change, and are run as
+ * one job per macroblock row by execute2(), on the slice threads if any. */
+
+static int fill_dc_row(AVCodecContext *avctx, void *arg, int mb_y, int threadnr){
+    MpegEncContext *s= arg;
+    int mb_x;
+
+    for(mb_x=0; mb_x<s->mb_width; mb_x++){
+        int dc, dcu, dcv, y, n;
+        int16_t *dc_ptr;
+        uint8_t *dest_y, *dest_cb, *dest_cr;
+        const int mb_xy= mb_x + mb_y * s->mb_stride;
+        const int mb_type= s->current_picture.mb_type[mb_xy];
+
+        if(IS_INTRA(mb_type) && s->partitioned_frame) continue;
+//        if(error&MV_ERROR) continue; //inter data damaged FIXME is this good?
+
+        dest_y = s->current_picture.data[0] + mb_x*16 + mb_y*16*s->linesize;
+        dest_cb= s->current_picture.data[1] + mb_x*8  + mb_y*8 *s->uvlinesize;
+        dest_cr= s->current_picture.data[2] + mb_x*8  + mb_y*8 *s->uvlinesize;
+
+        dc_ptr= &s->dc_val[0][mb_x*2 + mb_y*2*s->b8_stride];
+        for(n=0; n<4; n++){
+            dc=0;
+            for(y=0; y<8; y++){
+                int x;
+                for(x=0; x<8; x++){
+                   dc+= dest_y[x + (n&1)*8 + (y + (n>>1)*8)*s->linesize];
+                }
+            }
+            dc_ptr[(n&1) + (n>>1)*s->b8_stride]= (dc+4)>>3;
+        }
+
+        dcu=dcv=0;
+        for(y=0; y<8; y++){
+            int x;
+            for(x=0; x<8; x++){
+                dcu+=dest_cb[x + y*(s->uvlinesize)];
+                dcv+=dest_cr[x + y*(s->uvlinesize)];
+            }
+        }
+        s->dc_val[1][mb_x + mb_y*s->mb_stride]= (dcu+4)>>3;
+        s->dc_val[2][mb_x + mb_y*s->mb_stride]= (dcv+4)>>3;
+    }
+    return 0;
+}
+
+/* guess_dc() only reads the dc of blocks it does not write */
+static int guess_dc_row(AVCodecContext *avctx, void *arg, int mb_y, int threadnr){
+    MpegEncContext *s= arg;
+
+    guess_dc(s, s->dc_val[0], s->mb_width*2, s->mb_height*2, s->b8_stride, 1, 2*mb_y  );
+    guess_dc(s, s->dc_val[0], s->mb_width*2, s->mb_height*2, s->b8_stride, 1, 2*mb_y+1);
+    guess_dc(s, s->dc_val[1], s->mb_width  , s->mb_height  , s->mb_stride, 0, mb_y);
+    guess_dc(s, s->dc_val[2], s->mb_width  , s->mb_height  , s->mb_stride, 0, mb_y);
+    return 0;
+}
+
+static int put_dc_row(AVCodecContext *avctx, void *arg, int mb_y, int threadnr){
+    MpegEncContext *s= arg;
+    int mb_x;
+
+    for(mb_x=0; mb_x<s->mb_width; mb_x++){
+        uint8_t *dest_y, *dest_cb, *dest_cr;
+        const int mb_xy= mb_x + mb_y * s->mb_stride;
+        const int mb_type= s->current_picture.mb_type[mb_xy];
+        int error= s->error_status_table[mb_xy];
+
+        if(IS_INTER(mb_type)) continue;
+        if(!(error&AC_ERROR)) continue;              //undamaged
+
+        dest_y = s->current_picture.data[0] + mb_x*16 + mb_y*16*s->linesize;
+        dest_cb= s->current_picture.data[1] + mb_x*8  + mb_y*8 *s->uvlinesize;
+        dest_cr= s->current_picture.data[2] + mb_x*8  + mb_y*8 *s->uvlinesize;
+
+        put_dc(s, dest_y, dest_cb, dest_cr, mb_x, mb_y);
+    }
+    return 0;
+}
+
+static int h_block_filter_row(AVCodecContext *avctx, void *arg, int mb_y, int threadnr){
+    MpegEncContext *s= arg;
+
+    h_block_filter(s, s->current_picture.data[0], s->mb_width*2, s->mb_height*2, s->linesize  , 1, 2*mb_y  );
+    h_block_filter(s, s->current_picture.data[0], s->mb_width*2, s->mb_height*2, s->linesize  , 1, 2*mb_y+1);
+    h_block_filter(s, s->current_picture.data[1], s->mb_width  , s->mb_height  , s->uvlinesize, 0, mb_y);
+    h_block_filter(s, s->current_picture.data[2], s->mb_width  , s->mb_height  , s->uvlinesize, 0, mb_y);
+    return 0;
+}
+
+/* the edges below the rows of a macroblock row, which do not change the
+ * pixels used by the edges of the other rows */
+static int v_block_filter_row(AVCodecContext *avctx, void *arg, int mb_y, int threadnr){
+    MpegEncContext *s= arg;
+
+    v_block_filter(s, s->current_picture.data[0], s->mb_width*2, s->mb_height*2, s->linesize  , 1, 2*mb_y);
+    if(mb_y == s->mb_height-1)
+        return 0;
+    v_block_filter(s, s->current_picture.data[0], s->mb_width*2, s->mb_height*2, s->linesize  , 1, 2*mb_y+1);
+    v_block_filter(s, s->current_picture.data[1], s->mb_width  , s->mb_height  , s->uvlinesize, 0, mb_y);
+    v_block_filter(s, s->current_picture.data[2], s->mb_width  , s->mb_height  , s->uvlinesize, 0, mb_y);
+    return 0;
+}
+
 void ff_er_frame_end(MpegEncContext *s){
     int i, mb_x, mb_y, error, error_type, dc_error, mv_error, ac_error;
     int distance;
@@ -803,7 +905,7 @@ void ff_er_frame_end(MpegEncContext *s){
        s->error_count==3*s->mb_width*(s->avctx->skip_top + s->avctx->skip_bottom)) return;
 
     if(s->current_picture.motion_val[0] == NULL){
-        av_log(s->avctx, AV_LOG_ERROR, "Warning MVs not available\n");
+        av_log_ratelimited(s->avctx, AV_LOG_ERROR, "Warning MVs not available\n");
 
         for(i=0; i<2; i++){
             pic->ref_index[i]= av_mallocz(s->mb_stride * s->mb_height * 4 * sizeof(uint8_t));
@@ -953,7 +1055,7 @@ void ff_er_frame_end(MpegEncContext *s){
         if(error&AC_ERROR) ac_error ++;
         if(error&MV_ERROR) mv_error ++;
     }
-    av_log(s->avctx, AV_LOG_INFO, "concealing %d DC, %d AC, %d MV errors\n", dc_error, ac_error, mv_error);
+    av_log_ratelimited(s->avctx, AV_LOG_INFO, "concealing %d DC, %d AC, %d MV errors\n", dc_error, ac_error, mv_error);
 
     is_intra_likely= is_intra_more_likely(s);
 
@@ -1069,88 +1171,25 @@ void ff_er_frame_end(MpegEncContext *s){
     if(CONFIG_MPEG_XVMC_DECODER && s->avctx->xvmc_acceleration)
         goto ec_clean;
     /* fill DC for inter blocks */
-    for(mb_y=0; mb_y<s->mb_height; mb_y++){
-        for(mb_x=0; mb_x<s->mb_width; mb_x++){
-            int dc, dcu, dcv, y, n;
-            int16_t *dc_ptr;
-            uint8_t *dest_y, *dest_cb, *dest_cr;
-            const int mb_xy= mb_x + mb_y * s->mb_stride;
-            const int mb_type= s->current_picture.mb_type[mb_xy];
-
-            error= s->error_status_table[mb_xy];
-
-            if(IS_INTRA(mb_type) && s->partitioned_frame) continue;
-//            if(error&MV_ERROR) continue; //inter data damaged FIXME is this good?
-
-            dest_y = s->current_picture.data[0] + mb_x*16 + mb_y*16*s->linesize;
-            dest_cb= s->current_picture.data[1] + mb_x*8  + mb_y*8 *s->uvlinesize;
-            dest_cr= s->current_picture.data[2] + mb_x*8  + mb_y*8 *s->uvlinesize;
-
-            dc_ptr= &s->dc_val[0][mb_x*2 + mb_y*2*s->b8_stride];
-            for(n=0; n<4; n++){
-                dc=0;
-                for(y=0; y<8; y++){
-                    int x;
-                    for(x=0; x<8; x++){
-                       dc+= dest_y[x + (n&1)*8 + (y + (n>>1)*8)*s->linesize];
-                    }
-                }
-                dc_ptr[(n&1) + (n>>1)*s->b8_stride]= (dc+4)>>3;
-            }
-
-            dcu=dcv=0;
-            for(y=0; y<8; y++){
-                int x;
-                for(x=0; x<8; x++){
-                    dcu+=dest_cb[x + y*(s->uvlinesize)];
-                    dcv+=dest_cr[x + y*(s->uvlinesize)];
-                }
-            }
-            s->dc_val[1][mb_x + mb_y*s->mb_stride]= (dcu+4)>>3;
-            s->dc_val[2][mb_x + mb_y*s->mb_stride]= (dcv+4)>>3;
-        }
-    }
+    s->avctx->execute2(s->avctx, fill_dc_row, s, NULL, s->mb_height);
 #if 1
     /* guess DC for damaged blocks */
-    guess_dc(s, s->dc_val[0], s->mb_width*2, s->mb_height*2, s->b8_stride, 1);
-    guess_dc(s, s->dc_val[1], s->mb_width  , s->mb_height  , s->mb_stride, 0);
-    guess_dc(s, s->dc_val[2], s->mb_width  , s->mb_height  , s->mb_stride, 0);
+    s->avctx->execute2(s->avctx, guess_dc_row, s, NULL, s->mb_height);
 #endif
     /* filter luma DC */
     filter181(s->dc_val[0], s->mb_width*2, s->mb_height*2, s->b8_stride);
 
 #if 1
     /* render DC only intra */
-    for(mb_y=0; mb_y<s->mb_height; mb_y++){
-        for(mb_x=0; mb_x<s->mb_width; mb_x++){
-            uint8_t *dest_y, *dest_cb, *dest_cr;
-            const int mb_xy= mb_x + mb_y * s->mb_stride;
-            const int mb_type= s->current_picture.mb_type[mb_xy];
-
-            error= s->error_status_table[mb_xy];
-
-            if(IS_INTER(mb_type)) continue;
-            if(!(error&AC_ERROR)) continue;              //undamaged
-
-            dest_y = s->current_picture.data[0] + mb_x*16 + mb_y*16*s->linesize;
-            dest_cb= s->current_picture.data[1] + mb_x*8  + mb_y*8 *s->uvlinesize;
-            dest_cr= s->current_picture.data[2] + mb_x*8  + mb_y*8 *s->uvlinesize;
-
-            put_dc(s, dest_y, dest_cb, dest_cr, mb_x, mb_y);
-        }
-    }
+    s->avctx->execute2(s->avctx, put_dc_row, s, NULL, s->mb_height);
 #endif
 
     if(s->avctx->error_concealment&FF_EC_DEBLOCK){
         /* filter horizontal block boundaries */
-        h_block_filter(s, s->current_picture.data[0], s->mb_width*2, s->mb_height*2, s->linesize  , 1);
-        h_block_filter(s, s->current_picture.data[1], s->mb_width  , s->mb_height  , s->uvlinesize, 0);
-        h_block_filter(s, s->current_picture.data[2], s->mb_width  , s->mb_height  , s->uvlinesize, 0);
+        s->avctx->execute2(s->avctx, h_block_filter_row, s, NULL, s->mb_height);
 
         /* filter vertical block boundaries */
-        v_block_filter(s, s->current_picture.data[0], s->mb_width*2, s->mb_height*2, s->linesize  , 1);
-        v_block_filter(s, s->current_picture.data[1], s->mb_width  , s->mb_height  , s->uvlinesize, 0);
-        v_block_filter(s, s->current_picture.data[2], s->mb_width  , s->mb_height  , s->uvlinesize, 0);
+        s->avctx->execute2(s->avctx, v_block_filter_row, s, NULL, s->mb_height);
     }
 
 ec_clean:
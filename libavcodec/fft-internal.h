@@ -67,9 +67,12 @@ void ff_mdct_calcw_c(FFTContext *s, FFTDouble *output, const FFTSample *input);
 #define ff_imdct_calc_c FFT_NAME(ff_imdct_calc_c)
 #define ff_imdct_half_c FFT_NAME(ff_imdct_half_c)
 #define ff_mdct_calc_c  FFT_NAME(ff_mdct_calc_c)
+#define ff_imdct_half_batch_c FFT_NAME(ff_imdct_half_batch_c)
 
 void ff_imdct_calc_c(FFTContext *s, FFTSample *output, const FFTSample *input);
 void ff_imdct_half_c(FFTContext *s, FFTSample *output, const FFTSample *input);
 void ff_mdct_calc_c(FFTContext *s, FFTSample *output, const FFTSample *input);
+void ff_imdct_half_batch_c(FFTContext *s, FFTSample *output, int out_stride,
+                           const FFTSample *input, int in_stride, int count);
 
 #endif /* AVCODEC_FFT_INTERNAL_H */
@@ -155,7 +155,9 @@ av_cold int ff_fft_init(FFTContext *s, int nbits, int inverse)
     s->imdct_calc  = ff_imdct_calc_c;
     s->imdct_half  = ff_imdct_half_c;
     s->mdct_calc   = ff_mdct_calc_c;
+    s->imdct_half_batch = ff_imdct_half_batch_c;
 #endif
+    s->batch_buf = NULL;
 
 #if CONFIG_FFT_FLOAT
     if (ARCH_ARM)     ff_fft_init_arm(s);
@@ -165,6 +167,7 @@ av_cold int ff_fft_init(FFTContext *s, int nbits, int inverse)
 #else
     if (CONFIG_MDCT)  s->mdct_calcw = ff_mdct_calcw_c;
     if (ARCH_ARM)     ff_fft_fixed_init_arm(s);
+    if (HAVE_MMX)     ff_fft_fixed_init_mmx(s);
 #endif
 
     for(j=4; j<=nbits; j++) {
@@ -203,6 +206,7 @@ av_cold void ff_fft_end(FFTContext *s)
 {
     av_freep(&s->revtab);
     av_freep(&s->tmp_buf);
+    av_freep(&s->batch_buf);
 }
 
 #define BUTTERFLIES(a0,a1,a2,a3) {\
@@ -351,3 +355,6 @@ static void ff_fft_calc_c(FFTContext *s, FFTComplex *z)
     fft_dispatch[s->nbits-2](z);
 }
 
+#if !CONFIG_FFT_FLOAT
+void (* const ff_fft_fixed_small[3])(FFTComplex *z) = { fft4, fft8, fft16 };
+#endif
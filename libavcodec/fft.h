@@ -82,6 +82,15 @@ struct FFTContext {
     void (*imdct_half)(struct FFTContext *s, FFTSample *output, const FFTSample *input);
     void (*mdct_calc)(struct FFTContext *s, FFTSample *output, const FFTSample *input);
     void (*mdct_calcw)(struct FFTContext *s, FFTDouble *output, const FFTSample *input);
+    /**
+     * Do imdct_half() on count blocks of the same size, block i being read
+     * from input + i * in_stride and written to output + i * out_stride.
+     * The transforms of several blocks may be done together, which is faster
+     * than calling imdct_half() for each one, so the output of a block must
+     * not overlap the input of another one.
+     */
+    void (*imdct_half_batch)(struct FFTContext *s, FFTSample *output, int out_stride,
+                             const FFTSample *input, int in_stride, int count);
     int fft_permutation;
 #define FF_FFT_PERM_DEFAULT   0
 #define FF_FFT_PERM_SWAP_LSBS 1
@@ -89,6 +98,7 @@ struct FFTContext {
     int mdct_permutation;
 #define FF_MDCT_PERM_NONE       0
 #define FF_MDCT_PERM_INTERLEAVE 1
+    FFTSample *batch_buf; ///< work buffer of the optimized imdct_half_batch()
 };
 
 #if CONFIG_HARDCODED_TABLES
@@ -137,8 +147,16 @@ int ff_fft_init(FFTContext *s, int nbits, int inverse);
 void ff_fft_init_altivec(FFTContext *s);
 void ff_fft_init_mmx(FFTContext *s);
 void ff_fft_init_arm(FFTContext *s);
+void ff_mdct_init_mmx(FFTContext *s);
 #else
 void ff_fft_fixed_init_arm(FFTContext *s);
+void ff_fft_fixed_init_mmx(FFTContext *s);
+
+/**
+ * The C FFTs of 4, 8 and 16 points, for the optimized versions which only
+ * replace the passes of the bigger transforms.
+ */
+extern void (* const ff_fft_fixed_small[3])(FFTComplex *z);
 #endif
 
 void ff_fft_end(FFTContext *s);
@@ -25,6 +25,7 @@
  * FF Video Codec 1 (a lossless codec)
  */
 
+#define BITSTREAM_WRITER_64
 #include "avcodec.h"
 #include "get_bits.h"
 #include "put_bits.h"
@@ -32,6 +33,7 @@
 #include "rangecoder.h"
 #include "golomb.h"
 #include "mathops.h"
+#include "thread.h"
 #include "libavutil/avassert.h"
 
 #define MAX_PLANES 4
@@ -266,6 +268,8 @@ typedef struct FFV1Context{
     int slice_height;
     int slice_x;
     int slice_y;
+
+    struct FFV1Context *fsrc;            ///< context of the previous frame, whose states a non keyframe continues with (frame threading)
 }FFV1Context;
 
 static av_always_inline int fold(int diff, int bits){
@@ -1295,7 +1299,7 @@ static av_cold int common_end(AVCodecContext *avctx){
     int i, j;
 
     if (avctx->codec->decode && s->picture.data[0])
-        avctx->release_buffer(avctx, &s->picture);
+        ff_thread_release_buffer(avctx, &s->picture);
 
     for(j=0; j<s->slice_count; j++){
         FFV1Context *fs= s->slice_context[j];
@@ -1752,21 +1756,123 @@ static av_cold int decode_init(AVCodecContext *avctx)
     return 0;
 }
 
+/**
+ * Continue a non keyframe with the header and the adapted states the
+ * previous frame, decoded by another frame thread, ended with.
+ */
+static int copy_decode_state(FFV1Context *f, FFV1Context *fsrc){
+    int i, j;
+
+    if(fsrc->picture.data[0])
+        ff_thread_await_progress(&fsrc->picture, INT_MAX, 0);
+
+    f->version       = fsrc->version;
+    f->ac            = fsrc->ac;
+    f->colorspace    = fsrc->colorspace;
+    f->chroma_h_shift= fsrc->chroma_h_shift;
+    f->chroma_v_shift= fsrc->chroma_v_shift;
+    f->plane_count   = fsrc->plane_count;
+    f->packed_at_lsb = fsrc->packed_at_lsb;
+    f->slice_count   = fsrc->slice_count;
+    memcpy(f->state_transition, fsrc->state_transition, sizeof(f->state_transition));
+    memcpy(f->quant_table, fsrc->quant_table, sizeof(f->quant_table));
+
+    for(j=0; j<f->slice_count; j++){
+        FFV1Context *fs= f->slice_context[j];
+        const FFV1Context *fss= fsrc->slice_context[j];
+
+        fs->ac           = fss->ac;
+        fs->packed_at_lsb= fss->packed_at_lsb;
+        fs->slice_x      = fss->slice_x;
+        fs->slice_y      = fss->slice_y;
+        fs->slice_width  = fss->slice_width;
+        fs->slice_height = fss->slice_height;
+        for(i=0; i<f->plane_count; i++){
+            PlaneContext * const p= &fs->plane[i];
+            const PlaneContext * const ps= &fss->plane[i];
+
+            if(p->context_count < ps->context_count){
+                av_freep(&p->state);
+                av_freep(&p->vlc_state);
+            }
+            memcpy(p->quant_table, ps->quant_table, sizeof(p->quant_table));
+            p->quant_table_index= ps->quant_table_index;
+            p->context_count    = ps->context_count;
+            memcpy(p->interlace_bit_state, ps->interlace_bit_state, sizeof(p->interlace_bit_state));
+        }
+    }
+
+    if(init_slice_state(f) < 0)
+        return AVERROR(ENOMEM);
+
+    for(j=0; j<f->slice_count; j++){
+        FFV1Context *fs= f->slice_context[j];
+        const FFV1Context *fss= fsrc->slice_context[j];
+
+        for(i=0; i<f->plane_count; i++){
+            PlaneContext * const p= &fs->plane[i];
+            const PlaneContext * const ps= &fss->plane[i];
+
+            if(fs->ac && ps->state)
+                memcpy(p->state, ps->state, CONTEXT_SIZE*p->context_count);
+            else if(!fs->ac && ps->vlc_state)
+                memcpy(p->vlc_state, ps->vlc_state, p->context_count*sizeof(VlcState));
+        }
+    }
+
+    return 0;
+}
+
+static av_cold int init_thread_copy(AVCodecContext *avctx)
+{
+    FFV1Context *f = avctx->priv_data;
+    int i;
+
+    f->avctx= avctx;
+    f->fsrc = NULL;
+    avcodec_get_frame_defaults(&f->picture);
+
+    for(i=0; i<f->quant_table_count; i++){
+        const void *initial_states= f->initial_states[i];
+
+        f->initial_states[i]= av_malloc(f->context_count[i]*sizeof(*f->initial_states[i]));
+        if(!f->initial_states[i])
+            return AVERROR(ENOMEM);
+        memcpy(f->initial_states[i], initial_states, f->context_count[i]*sizeof(*f->initial_states[i]));
+    }
+
+    return init_slice_contexts(f);
+}
+
+static int update_thread_context(AVCodecContext *dst, const AVCodecContext *src)
+{
+    FFV1Context *fdst = dst->priv_data;
+
+    if (dst == src)
+        return 0;
+
+    fdst->fsrc = src->priv_data;
+    return 0;
+}
+
 static int decode_frame(AVCodecContext *avctx, void *data, int *data_size, AVPacket *avpkt){
     const uint8_t *buf = avpkt->data;
     int buf_size = avpkt->size;
     FFV1Context *f = avctx->priv_data;
     RangeCoder * const c= &f->slice_context[0]->c;
     AVFrame * const p= &f->picture;
+    FFV1Context *fsrc= f->fsrc;
     int bytes_read, i;
     uint8_t keystate= 128;
     const uint8_t *buf_p;
 
     AVFrame *picture = data;
 
+    f->fsrc= NULL;
+
     /* release previously stored data */
     if (p->data[0])
-        avctx->release_buffer(avctx, p);
+        ff_thread_release_buffer(avctx, p);
 
     ff_init_range_decoder(c, buf, buf_size);
     ff_build_rac_states(c, 0.05*(1LL<<32), 256-8);
@@ -1783,6 +1889,10 @@ static int decode_frame(AVCodecContext *avctx, void *data, int *data_size, AVPac
         clear_state(f);
     }else{
         p->key_frame= 0;
+        /* the frame thread of the previous frame has the states to go on with,
+         * it cannot start another frame before this one finished its setup */
+        if(fsrc && copy_decode_state(f, fsrc) < 0)
+            return AVERROR(ENOMEM);
     }
     if(f->ac>1){
         int i;
@@ -1793,10 +1903,11 @@ static int decode_frame(AVCodecContext *avctx, void *data, int *data_size, AVPac
     }
 
     p->reference= 0;
-    if(avctx->get_buffer(avctx, p) < 0){
+    if(ff_thread_get_buffer(avctx, p) < 0){
         av_log(avctx, AV_LOG_ERROR, "get_buffer() failed\n");
         return -1;
     }
+    ff_thread_finish_setup(avctx);
 
     if(avctx->debug&FF_DEBUG_PICT_INFO)
         av_log(avctx, AV_LOG_ERROR, "keyframe:%d coder:%d\n", p->key_frame, f->ac);
@@ -1816,6 +1927,7 @@ static int decode_frame(AVCodecContext *avctx, void *data, int *data_size, AVPac
         int v= AV_RB24(buf_p-3)+3;
         if(buf_p - buf <= v){
             av_log(avctx, AV_LOG_ERROR, "Slice pointer chain broken\n");
+            ff_thread_report_progress(p, INT_MAX, 0);
             return -1;
         }
         buf_p -= v;
@@ -1827,6 +1939,7 @@ static int decode_frame(AVCodecContext *avctx, void *data, int *data_size, AVPac
     }
 
     avctx->execute(avctx, decode_slice, &f->slice_context[0], NULL, f->slice_count, sizeof(void*));
+    ff_thread_report_progress(p, INT_MAX, 0);
     f->picture_number++;
 
     *picture= *p;
@@ -1844,8 +1957,10 @@ AVCodec ff_ffv1_decoder = {
     NULL,
     common_end,
     decode_frame,
-    CODEC_CAP_DR1 /*| CODEC_CAP_DRAW_HORIZ_BAND*/ | CODEC_CAP_SLICE_THREADS,
+    CODEC_CAP_DR1 /*| CODEC_CAP_DRAW_HORIZ_BAND*/ | CODEC_CAP_SLICE_THREADS | CODEC_CAP_FRAME_THREADS,
     NULL,
+    .init_thread_copy= ONLY_IF_THREADS_ENABLED(init_thread_copy),
+    .update_thread_context= ONLY_IF_THREADS_ENABLED(update_thread_context),
     .long_name= NULL_IF_CONFIG_SMALL("FFmpeg video codec #1"),
 };
 
@@ -1858,7 +1973,7 @@ AVCodec ff_ffv1_encoder = {
     encode_init,
     encode_frame,
     common_end,
-    .capabilities = CODEC_CAP_SLICE_THREADS,
+    .capabilities = CODEC_CAP_SLICE_THREADS | CODEC_CAP_FRAME_THREADS,
     .pix_fmts= (const enum PixelFormat[]){PIX_FMT_YUV420P, PIX_FMT_YUV444P, PIX_FMT_YUV422P, PIX_FMT_YUV411P, PIX_FMT_YUV410P, PIX_FMT_RGB32, PIX_FMT_YUV420P16, PIX_FMT_YUV422P16, PIX_FMT_YUV444P16, PIX_FMT_YUV420P9, PIX_FMT_YUV420P10, PIX_FMT_YUV422P10, PIX_FMT_NONE},
     .long_name= NULL_IF_CONFIG_SMALL("FFmpeg video codec #1"),
 };
@@ -19,6 +19,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#define BITSTREAM_WRITER_64
 #include "libavutil/crc.h"
 #include "libavutil/md5.h"
 #include "libavutil/opt.h"
@@ -78,11 +79,15 @@ typedef struct FlacFrame {
     uint8_t crc8;
     int ch_mode;
     int verbatim_only;
+    uint32_t frame_number;
+    int64_t pts;
+    PutBitContext pb;
+    uint8_t *buf;                   ///< encoded frame, max_framesize bytes
+    int buf_size;                   ///< size of the encoded frame
 } FlacFrame;
 
 typedef struct FlacEncodeContext {
     AVClass *class;
-    PutBitContext pb;
     int channels;
     int samplerate;
     int sr_code[2];
@@ -93,11 +98,20 @@ typedef struct FlacEncodeContext {
     uint32_t frame_count;
     uint64_t sample_count;
     uint8_t md5sum[16];
-    FlacFrame frame;
     CompressionOptions options;
     AVCodecContext *avctx;
-    LPCContext lpc_ctx;
     struct AVMD5 *md5ctx;
+
+    /**
+     * With slice threads, blocks are queued until there is one per thread
+     * and then encoded in parallel; the frames are returned in order.
+     */
+    FlacFrame *frames;
+    int nb_frames;                  ///< number of frames encoded at once
+    int nb_queued;                  ///< number of frames waiting to be encoded
+    int nb_encoded;                 ///< number of frames encoded together last
+    int next_output;                ///< index of the next encoded frame to return
+    LPCContext *lpc_ctx;            ///< one per thread
 } FlacEncodeContext;
 
 
@@ -461,21 +475,31 @@ static av_cold int flac_encode_init(AVCodecContext *avctx)
         }
     }
 
-    ret = ff_lpc_init(&s->lpc_ctx, avctx->frame_size,
-                      s->options.max_prediction_order, FF_LPC_TYPE_LEVINSON);
+    s->nb_frames = avctx->active_thread_type & FF_THREAD_SLICE ?
+                   avctx->thread_count : 1;
+    s->frames    = av_mallocz(s->nb_frames * sizeof(*s->frames));
+    s->lpc_ctx   = av_mallocz(s->nb_frames * sizeof(*s->lpc_ctx));
+    if (!s->frames || !s->lpc_ctx)
+        return AVERROR(ENOMEM);
+    for (i = 0; i < s->nb_frames; i++) {
+        s->frames[i].buf = av_malloc(s->max_framesize);
+        if (!s->frames[i].buf)
+            return AVERROR(ENOMEM);
+        ret = ff_lpc_init(&s->lpc_ctx[i], avctx->frame_size,
+                          s->options.max_prediction_order, FF_LPC_TYPE_LEVINSON);
+        if (ret < 0)
+            return ret;
+    }
 
     dprint_compression_options(s);
 
-    return ret;
+    return 0;
 }
 
 
-static void init_frame(FlacEncodeContext *s)
+static void init_frame(FlacEncodeContext *s, FlacFrame *frame)
 {
     int i, ch;
-    FlacFrame *frame;
-
-    frame = &s->frame;
 
     for (i = 0; i < 16; i++) {
         if (s->avctx->frame_size == ff_flac_blocksize_table[i]) {
@@ -506,12 +530,10 @@ static void init_frame(FlacEncodeContext *s)
 /**
  * Copy channel-interleaved input samples into separate subframes.
  */
-static void copy_samples(FlacEncodeContext *s, const int16_t *samples)
+static void copy_samples(FlacEncodeContext *s, FlacFrame *frame,
+                         const int16_t *samples)
 {
     int i, j, ch;
-    FlacFrame *frame;
-
-    frame = &s->frame;
     for (i = 0, j = 0; i < frame->blocksize; i++)
         for (ch = 0; ch < s->channels; ch++, j++)
             frame->subframes[ch].samples[i] = samples[j];
@@ -532,8 +554,8 @@ static int rice_count_exact(int32_t *res, int n, int k)
 }
 
 
-static int subframe_count_exact(FlacEncodeContext *s, FlacSubframe *sub,
-                                int pred_order)
+static int subframe_count_exact(FlacEncodeContext *s, FlacFrame *frame,
+                                FlacSubframe *sub, int pred_order)
 {
     int p, porder, psize;
     int i, part_end;
@@ -546,7 +568,7 @@ static int subframe_count_exact(FlacEncodeContext *s, FlacSubframe *sub,
     if (sub->type == FLAC_SUBFRAME_CONSTANT) {
         count += sub->obits;
     } else if (sub->type == FLAC_SUBFRAME_VERBATIM) {
-        count += s->frame.blocksize * sub->obits;
+        count += frame->blocksize * sub->obits;
     } else {
         /* warm-up samples */
         count += pred_order * sub->obits;
@@ -560,7 +582,7 @@ static int subframe_count_exact(FlacEncodeContext *s, FlacSubframe *sub,
 
         /* partition order */
         porder = sub->rc.porder;
-        psize  = s->frame.blocksize >> porder;
+        psize  = frame->blocksize >> porder;
         count += 4;
 
         /* residual */
@@ -571,7 +593,7 @@ static int subframe_count_exact(FlacEncodeContext *s, FlacSubframe *sub,
             count += 4;
             count += rice_count_exact(&sub->residual[i], part_end - i, k);
             i = part_end;
-            part_end = FFMIN(s->frame.blocksize, part_end + psize);
+            part_end = FFMIN(frame->blocksize, part_end + psize);
         }
     }
 
@@ -693,18 +715,19 @@ static int get_max_p_order(int max_porder, int n, int order)
 
 
 static uint32_t find_subframe_rice_params(FlacEncodeContext *s,
+                                          FlacFrame *frame,
                                           FlacSubframe *sub, int pred_order)
 {
     int pmin = get_max_p_order(s->options.min_partition_order,
-                               s->frame.blocksize, pred_order);
+                               frame->blocksize, pred_order);
     int pmax = get_max_p_order(s->options.max_partition_order,
-                               s->frame.blocksize, pred_order);
+                               frame->blocksize, pred_order);
 
     uint32_t bits = 8 + pred_order * sub->obits + 2 + 4;
     if (sub->type == FLAC_SUBFRAME_LPC)
         bits += 4 + 5 + pred_order * s->options.lpc_coeff_precision;
     bits += calc_rice_params(&sub->rc, pmin, pmax, sub->residual,
-                             s->frame.blocksize, pred_order);
+                             frame->blocksize, pred_order);
     return bits;
 }
 
@@ -864,17 +887,16 @@ static void encode_residual_lpc(int32_t *res, const int32_t *smp, int n,
 }
 
 
-static int encode_residual_ch(FlacEncodeContext *s, int ch)
+static int encode_residual_ch(FlacEncodeContext *s, FlacFrame *frame,
+                              LPCContext *lpc_ctx, int ch)
 {
     int i, n;
     int min_order, max_order, opt_order, omethod;
-    FlacFrame *frame;
     FlacSubframe *sub;
     int32_t coefs[MAX_LPC_ORDER][MAX_LPC_ORDER];
     int shift[MAX_LPC_ORDER];
     int32_t *res, *smp;
 
-    frame = &s->frame;
     sub   = &frame->subframes[ch];
     res   = sub->residual;
     smp   = sub->samples;
@@ -887,14 +909,14 @@ static int encode_residual_ch(FlacEncodeContext *s, int ch)
     if (i == n) {
         sub->type = sub->type_code = FLAC_SUBFRAME_CONSTANT;
         res[0] = smp[0];
-        return subframe_count_exact(s, sub, 0);
+        return subframe_count_exact(s, frame, sub, 0);
     }
 
     /* VERBATIM */
     if (frame->verbatim_only || n < 5) {
         sub->type = sub->type_code = FLAC_SUBFRAME_VERBATIM;
         memcpy(res, smp, n * sizeof(int32_t));
-        return subframe_count_exact(s, sub, 0);
+        return subframe_count_exact(s, frame, sub, 0);
     }
 
     min_order  = s->options.min_prediction_order;
@@ -912,7 +934,7 @@ static int encode_residual_ch(FlacEncodeContext *s, int ch)
         bits[0]   = UINT32_MAX;
         for (i = min_order; i <= max_order; i++) {
             encode_residual_fixed(res, smp, n, i);
-            bits[i] = find_subframe_rice_params(s, sub, i);
+            bits[i] = find_subframe_rice_params(s, frame, sub, i);
             if (bits[i] < bits[opt_order])
                 opt_order = i;
         }
@@ -920,14 +942,14 @@ static int encode_residual_ch(FlacEncodeContext *s, int ch)
         sub->type_code = sub->type | sub->order;
         if (sub->order != max_order) {
             encode_residual_fixed(res, smp, n, sub->order);
-            find_subframe_rice_params(s, sub, sub->order);
+            find_subframe_rice_params(s, frame, sub, sub->order);
         }
-        return subframe_count_exact(s, sub, sub->order);
+        return subframe_count_exact(s, frame, sub, sub->order);
     }
 
     /* LPC */
     sub->type = FLAC_SUBFRAME_LPC;
-    opt_order = ff_lpc_calc_coefs(&s->lpc_ctx, smp, n, min_order, max_order,
+    opt_order = ff_lpc_calc_coefs(lpc_ctx, smp, n, min_order, max_order,
                                   s->options.lpc_coeff_precision, coefs, shift, s->options.lpc_type,
                                   s->options.lpc_passes, omethod,
                                   MAX_LPC_SHIFT, 0);
@@ -946,7 +968,7 @@ static int encode_residual_ch(FlacEncodeContext *s, int ch)
             if (order < 0)
                 order = 0;
             encode_residual_lpc(res, smp, n, order+1, coefs[order], shift[order]);
-            bits[i] = find_subframe_rice_params(s, sub, order+1);
+            bits[i] = find_subframe_rice_params(s, frame, sub, order+1);
             if (bits[i] < bits[opt_index]) {
                 opt_index = i;
                 opt_order = order;
@@ -960,7 +982,7 @@ static int encode_residual_ch(FlacEncodeContext *s, int ch)
         bits[0]   = UINT32_MAX;
         for (i = min_order-1; i < max_order; i++) {
             encode_residual_lpc(res, smp, n, i+1, coefs[i], shift[i]);
-            bits[i] = find_subframe_rice_params(s, sub, i+1);
+            bits[i] = find_subframe_rice_params(s, frame, sub, i+1);
             if (bits[i] < bits[opt_order])
                 opt_order = i;
         }
@@ -978,7 +1000,7 @@ static int encode_residual_ch(FlacEncodeContext *s, int ch)
                 if (i < min_order-1 || i >= max_order || bits[i] < UINT32_MAX)
                     continue;
                 encode_residual_lpc(res, smp, n, i+1, coefs[i], shift[i]);
-                bits[i] = find_subframe_rice_params(s, sub, i+1);
+                bits[i] = find_subframe_rice_params(s, frame, sub, i+1);
                 if (bits[i] < bits[opt_order])
                     opt_order = i;
             }
@@ -994,13 +1016,13 @@ static int encode_residual_ch(FlacEncodeContext *s, int ch)
 
     encode_residual_lpc(res, smp, n, sub->order, sub->coefs, sub->shift);
 
-    find_subframe_rice_params(s, sub, sub->order);
+    find_subframe_rice_params(s, frame, sub, sub->order);
 
-    return subframe_count_exact(s, sub, sub->order);
+    return subframe_count_exact(s, frame, sub, sub->order);
 }
 
 
-static int count_frame_header(FlacEncodeContext *s)
+static int count_frame_header(FlacEncodeContext *s, FlacFrame *frame)
 {
     uint8_t av_unused tmp;
     int count;
@@ -1018,12 +1040,12 @@ static int count_frame_header(FlacEncodeContext *s)
     count = 32;
 
     /* coded frame number */
-    PUT_UTF8(s->frame_count, tmp, count += 8;)
+    PUT_UTF8(frame->frame_number, tmp, count += 8;)
 
     /* explicit block size */
-    if (s->frame.bs_code[0] == 6)
+    if (frame->bs_code[0] == 6)
         count += 8;
-    else if (s->frame.bs_code[0] == 7)
+    else if (frame->bs_code[0] == 7)
         count += 16;
 
     /* explicit sample rate */
@@ -1036,14 +1058,15 @@ static int count_frame_header(FlacEncodeContext *s)
 }
 
 
-static int encode_frame(FlacEncodeContext *s)
+static int encode_frame(FlacEncodeContext *s, FlacFrame *frame,
+                        LPCContext *lpc_ctx)
 {
     int ch, count;
 
-    count = count_frame_header(s);
+    count = count_frame_header(s, frame);
 
     for (ch = 0; ch < s->channels; ch++)
-        count += encode_residual_ch(s, ch);
+        count += encode_residual_ch(s, frame, lpc_ctx, ch);
 
     count += (8 - (count & 7)) & 7; // byte alignment
     count += 16;                    // CRC-16
@@ -1102,13 +1125,11 @@ static int estimate_stereo_mode(int32_t *left_ch, int32_t *right_ch, int n)
 /**
  * Perform stereo channel decorrelation.
  */
-static void channel_decorrelation(FlacEncodeContext *s)
+static void channel_decorrelation(FlacEncodeContext *s, FlacFrame *frame)
 {
-    FlacFrame *frame;
     int32_t *left, *right;
     int i, n;
 
-    frame = &s->frame;
     n     = frame->blocksize;
     left  = frame->subframes[0].samples;
     right = frame->subframes[1].samples;
@@ -1150,94 +1171,91 @@ static void write_utf8(PutBitContext *pb, uint32_t val)
 }
 
 
-static void write_frame_header(FlacEncodeContext *s)
+static void write_frame_header(FlacEncodeContext *s, FlacFrame *frame)
 {
-    FlacFrame *frame;
     int crc;
 
-    frame = &s->frame;
-
-    put_bits(&s->pb, 16, 0xFFF8);
-    put_bits(&s->pb, 4, frame->bs_code[0]);
-    put_bits(&s->pb, 4, s->sr_code[0]);
+    put_bits(&frame->pb, 16, 0xFFF8);
+    put_bits(&frame->pb, 4, frame->bs_code[0]);
+    put_bits(&frame->pb, 4, s->sr_code[0]);
 
     if (frame->ch_mode == FLAC_CHMODE_INDEPENDENT)
-        put_bits(&s->pb, 4, s->channels-1);
+        put_bits(&frame->pb, 4, s->channels-1);
     else
-        put_bits(&s->pb, 4, frame->ch_mode);
+        put_bits(&frame->pb, 4, frame->ch_mode);
 
-    put_bits(&s->pb, 3, 4); /* bits-per-sample code */
-    put_bits(&s->pb, 1, 0);
-    write_utf8(&s->pb, s->frame_count);
+    put_bits(&frame->pb, 3, 4); /* bits-per-sample code */
+    put_bits(&frame->pb, 1, 0);
+    write_utf8(&frame->pb, frame->frame_number);
 
     if (frame->bs_code[0] == 6)
-        put_bits(&s->pb, 8, frame->bs_code[1]);
+        put_bits(&frame->pb, 8, frame->bs_code[1]);
     else if (frame->bs_code[0] == 7)
-        put_bits(&s->pb, 16, frame->bs_code[1]);
+        put_bits(&frame->pb, 16, frame->bs_code[1]);
 
     if (s->sr_code[0] == 12)
-        put_bits(&s->pb, 8, s->sr_code[1]);
+        put_bits(&frame->pb, 8, s->sr_code[1]);
     else if (s->sr_code[0] > 12)
-        put_bits(&s->pb, 16, s->sr_code[1]);
+        put_bits(&frame->pb, 16, s->sr_code[1]);
 
-    flush_put_bits(&s->pb);
-    crc = av_crc(av_crc_get_table(AV_CRC_8_ATM), 0, s->pb.buf,
-                 put_bits_count(&s->pb) >> 3);
-    put_bits(&s->pb, 8, crc);
+    flush_put_bits(&frame->pb);
+    crc = av_crc(av_crc_get_table(AV_CRC_8_ATM), 0, frame->pb.buf,
+                 put_bits_count(&frame->pb) >> 3);
+    put_bits(&frame->pb, 8, crc);
 }
 
 
-static void write_subframes(FlacEncodeContext *s)
+static void write_subframes(FlacEncodeContext *s, FlacFrame *frame)
 {
     int ch;
 
     for (ch = 0; ch < s->channels; ch++) {
-        FlacSubframe *sub = &s->frame.subframes[ch];
+        FlacSubframe *sub = &frame->subframes[ch];
         int i, p, porder, psize;
         int32_t *part_end;
         int32_t *res       =  sub->residual;
-        int32_t *frame_end = &sub->residual[s->frame.blocksize];
+        int32_t *frame_end = &sub->residual[frame->blocksize];
 
         /* subframe header */
-        put_bits(&s->pb, 1, 0);
-        put_bits(&s->pb, 6, sub->type_code);
-        put_bits(&s->pb, 1, 0); /* no wasted bits */
+        put_bits(&frame->pb, 1, 0);
+        put_bits(&frame->pb, 6, sub->type_code);
+        put_bits(&frame->pb, 1, 0); /* no wasted bits */
 
         /* subframe */
         if (sub->type == FLAC_SUBFRAME_CONSTANT) {
-            put_sbits(&s->pb, sub->obits, res[0]);
+            put_sbits(&frame->pb, sub->obits, res[0]);
         } else if (sub->type == FLAC_SUBFRAME_VERBATIM) {
             while (res < frame_end)
-                put_sbits(&s->pb, sub->obits, *res++);
+                put_sbits(&frame->pb, sub->obits, *res++);
         } else {
             /* warm-up samples */
             for (i = 0; i < sub->order; i++)
-                put_sbits(&s->pb, sub->obits, *res++);
+                put_sbits(&frame->pb, sub->obits, *res++);
 
             /* LPC coefficients */
             if (sub->type == FLAC_SUBFRAME_LPC) {
                 int cbits = s->options.lpc_coeff_precision;
-                put_bits( &s->pb, 4, cbits-1);
-                put_sbits(&s->pb, 5, sub->shift);
+                put_bits( &frame->pb, 4, cbits-1);
+                put_sbits(&frame->pb, 5, sub->shift);
                 for (i = 0; i < sub->order; i++)
-                    put_sbits(&s->pb, cbits, sub->coefs[i]);
+                    put_sbits(&frame->pb, cbits, sub->coefs[i]);
             }
 
             /* rice-encoded block */
-            put_bits(&s->pb, 2, 0);
+            put_bits(&frame->pb, 2, 0);
 
             /* partition order */
             porder  = sub->rc.porder;
-            psize   = s->frame.blocksize >> porder;
-            put_bits(&s->pb, 4, porder);
+            psize   = frame->blocksize >> porder;
+            put_bits(&frame->pb, 4, porder);
 
             /* residual */
             part_end  = &sub->residual[psize];
             for (p = 0; p < 1 << porder; p++) {
                 int k = sub->rc.params[p];
-                put_bits(&s->pb, 4, k);
+                put_bits(&frame->pb, 4, k);
                 while (res < part_end)
-                    set_sr_golomb_flac(&s->pb, *res++, k, INT32_MAX, 0);
+                    set_sr_golomb_flac(&frame->pb, *res++, k, INT32_MAX, 0);
                 part_end = FFMIN(frame_end, part_end + psize);
             }
         }
@@ -1245,89 +1263,123 @@ static void write_subframes(FlacEncodeContext *s)
 }
 
 
-static void write_frame_footer(FlacEncodeContext *s)
+static void write_frame_footer(FlacFrame *frame)
 {
     int crc;
-    flush_put_bits(&s->pb);
-    crc = av_bswap16(av_crc(av_crc_get_table(AV_CRC_16_ANSI), 0, s->pb.buf,
-                            put_bits_count(&s->pb)>>3));
-    put_bits(&s->pb, 16, crc);
-    flush_put_bits(&s->pb);
+    flush_put_bits(&frame->pb);
+    crc = av_bswap16(av_crc(av_crc_get_table(AV_CRC_16_ANSI), 0, frame->pb.buf,
+                            put_bits_count(&frame->pb)>>3));
+    put_bits(&frame->pb, 16, crc);
+    flush_put_bits(&frame->pb);
 }
 
 
-static int write_frame(FlacEncodeContext *s, uint8_t *frame, int buf_size)
+static int write_frame(FlacEncodeContext *s, FlacFrame *frame, uint8_t *buf,
+                       int buf_size)
 {
-    init_put_bits(&s->pb, frame, buf_size);
-    write_frame_header(s);
-    write_subframes(s);
-    write_frame_footer(s);
-    return put_bits_count(&s->pb) >> 3;
+    init_put_bits(&frame->pb, buf, buf_size);
+    write_frame_header(s, frame);
+    write_subframes(s, frame);
+    write_frame_footer(frame);
+    return put_bits_count(&frame->pb) >> 3;
 }
 
 
-static void update_md5_sum(FlacEncodeContext *s, const int16_t *samples)
+static void update_md5_sum(FlacEncodeContext *s, FlacFrame *frame,
+                           const int16_t *samples)
 {
 #if HAVE_BIGENDIAN
     int i;
-    for (i = 0; i < s->frame.blocksize * s->channels; i++) {
+    for (i = 0; i < frame->blocksize * s->channels; i++) {
         int16_t smp = av_le2ne16(samples[i]);
         av_md5_update(s->md5ctx, (uint8_t *)&smp, 2);
     }
 #else
-    av_md5_update(s->md5ctx, (const uint8_t *)samples, s->frame.blocksize*s->channels*2);
+    av_md5_update(s->md5ctx, (const uint8_t *)samples, frame->blocksize*s->channels*2);
 #endif
 }
 
 
+/**
+ * Encode one queued frame, run for each of them by execute2().
+ */
+static int encode_frame_thread(AVCodecContext *avctx, void *arg, int jobnr,
+                               int threadnr)
+{
+    FlacEncodeContext *s = avctx->priv_data;
+    FlacFrame *frame     = &s->frames[jobnr];
+    int frame_bytes;
+    /* smaller for the small final frame */
+    int max_framesize    = ff_flac_get_max_frame_size(frame->blocksize,
+                                                      s->channels, 16);
+
+    channel_decorrelation(s, frame);
+
+    frame_bytes = encode_frame(s, frame, &s->lpc_ctx[threadnr]);
+
+    /* fallback to verbatim mode if the compressed frame is larger than it
+       would be if encoded uncompressed. */
+    if (frame_bytes > max_framesize) {
+        frame->verbatim_only = 1;
+        frame_bytes = encode_frame(s, frame, &s->lpc_ctx[threadnr]);
+    }
+
+    frame->buf_size = write_frame(s, frame, frame->buf, max_framesize);
+    return 0;
+}
+
+
 static int flac_encode_frame(AVCodecContext *avctx, uint8_t *frame,
                              int buf_size, void *data)
 {
     FlacEncodeContext *s;
     const int16_t *samples = data;
-    int frame_bytes, out_bytes;
+    FlacFrame *f;
+    int out_bytes;
 
     s = avctx->priv_data;
 
-    /* when the last block is reached, update the header in extradata */
-    if (!data) {
-        s->max_framesize = s->max_encoded_framesize;
-        av_md5_final(s->md5ctx, s->md5sum);
-        write_streaminfo(s, avctx->extradata);
-        return 0;
-    }
+    /* The frames of the last batch are returned before the next batch is
+       full, so a queued frame never overwrites one still to be returned. */
+    if (data) {
+        f = &s->frames[s->nb_queued++];
 
-    /* change max_framesize for small final frame */
-    if (avctx->frame_size < s->frame.blocksize) {
-        s->max_framesize = ff_flac_get_max_frame_size(avctx->frame_size,
-                                                      s->channels, 16);
-    }
-
-    init_frame(s);
-
-    copy_samples(s, samples);
+        init_frame(s, f);
+        copy_samples(s, f, samples);
 
-    channel_decorrelation(s);
+        f->frame_number = s->frame_count++;
+        f->pts          = s->sample_count;
+        s->sample_count += avctx->frame_size;
+        update_md5_sum(s, f, samples);
+    }
 
-    frame_bytes = encode_frame(s);
+    if (s->nb_queued && s->next_output == s->nb_encoded &&
+        (s->nb_queued == s->nb_frames || !data)) {
+        avctx->execute2(avctx, encode_frame_thread, NULL, NULL, s->nb_queued);
+        s->nb_encoded  = s->nb_queued;
+        s->nb_queued   = 0;
+        s->next_output = 0;
+    }
 
-    /* fallback to verbatim mode if the compressed frame is larger than it
-       would be if encoded uncompressed. */
-    if (frame_bytes > s->max_framesize) {
-        s->frame.verbatim_only = 1;
-        frame_bytes = encode_frame(s);
+    if (s->next_output == s->nb_encoded) {
+        /* when the last block is reached, update the header in extradata */
+        if (!data) {
+            s->max_framesize = s->max_encoded_framesize;
+            av_md5_final(s->md5ctx, s->md5sum);
+            write_streaminfo(s, avctx->extradata);
+        }
+        return 0;
     }
 
-    if (buf_size < frame_bytes) {
+    f = &s->frames[s->next_output++];
+    out_bytes = f->buf_size;
+    if (buf_size < out_bytes) {
         av_log(avctx, AV_LOG_ERROR, "output buffer too small\n");
         return 0;
     }
-    out_bytes = write_frame(s, frame, buf_size);
+    memcpy(frame, f->buf, out_bytes);
 
-    s->frame_count++;
-    avctx->coded_frame->pts = s->sample_count;
-    s->sample_count += avctx->frame_size;
-    update_md5_sum(s, samples);
+    avctx->coded_frame->pts = f->pts;
     if (out_bytes > s->max_encoded_framesize)
         s->max_encoded_framesize = out_bytes;
     if (out_bytes < s->min_framesize)
@@ -1341,8 +1393,16 @@ static av_cold int flac_encode_close(AVCodecContext *avctx)
 {
     if (avctx->priv_data) {
         FlacEncodeContext *s = avctx->priv_data;
+        int i;
         av_freep(&s->md5ctx);
-        ff_lpc_end(&s->lpc_ctx);
+        if (s->frames)
+            for (i = 0; i < s->nb_frames; i++)
+                av_freep(&s->frames[i].buf);
+        if (s->lpc_ctx)
+            for (i = 0; i < s->nb_frames; i++)
+                ff_lpc_end(&s->lpc_ctx[i]);
+        av_freep(&s->frames);
+        av_freep(&s->lpc_ctx);
     }
     av_freep(&avctx->extradata);
     avctx->extradata_size = 0;
@@ -1387,7 +1447,8 @@ AVCodec ff_flac_encoder = {
     flac_encode_frame,
     flac_encode_close,
     NULL,
-    .capabilities = CODEC_CAP_SMALL_LAST_FRAME | CODEC_CAP_DELAY | CODEC_CAP_LOSSLESS,
+    .capabilities = CODEC_CAP_SMALL_LAST_FRAME | CODEC_CAP_DELAY | CODEC_CAP_LOSSLESS |
+                    CODEC_CAP_SLICE_THREADS,
     .sample_fmts = (const enum AVSampleFormat[]){AV_SAMPLE_FMT_S16,AV_SAMPLE_FMT_NONE},
     .long_name = NULL_IF_CONFIG_SMALL("FLAC (Free Lossless Audio Codec)"),
     .priv_class = &flac_encoder_class,
@@ -35,7 +35,12 @@
 #include "libavutil/log.h"
 #include "mathops.h"
 
-#if defined(ALT_BITSTREAM_READER_LE) && !defined(ALT_BITSTREAM_READER)
+#if defined(ALT_BITSTREAM_READER_64) && !HAVE_FAST_64BIT
+#   undef ALT_BITSTREAM_READER_64
+#endif
+
+#if (defined(ALT_BITSTREAM_READER_LE) || defined(ALT_BITSTREAM_READER_64)) && \
+    !defined(ALT_BITSTREAM_READER)
 #   define ALT_BITSTREAM_READER
 #endif
 
@@ -48,6 +53,11 @@
 #   endif
 #endif
 
+/* ALT_BITSTREAM_READER_64 can be defined before including this header to
+ * refill the cache of the ALT reader with 64 bits instead of 32 on 64-bit
+ * CPUs. The GetBitContext is the same, so a context may be shared with code
+ * using the 32-bit cache. */
+
 /* bit input */
 /* buffer, buffer_end and size_in_bits must be present and used by every reader */
 typedef struct GetBitContext {
@@ -95,7 +105,7 @@ UPDATE_CACHE(name, gb)
     after this call at least MIN_CACHE_BITS will be available,
 
 GET_CACHE(name, gb)
-    will output the contents of the internal cache, next bit is MSB of 32 or 64 bit (FIXME 64bit)
+    will output the first 32 bits of the internal cache, next bit is MSB
 
 SHOW_UBITS(name, gb, num)
     will return the next num bits
@@ -119,26 +129,46 @@ LAST_SKIP_CACHE(name, gb, num)
 LAST_SKIP_BITS(name, gb, num)
     is equivalent to LAST_SKIP_CACHE; SKIP_COUNTER
 
+SKIP_AND_UPDATE_CACHE(name, gb, num)
+    is equivalent to LAST_SKIP_BITS; UPDATE_CACHE, for skipping the first part
+    of a code of at most 32 bits read after the last UPDATE_CACHE;
+    at least 25 bits will then be available, which readers with a large
+    enough cache provide without refilling it
+
 for examples see get_bits, show_bits, skip_bits, get_vlc
 */
 
 #ifdef ALT_BITSTREAM_READER
+# ifdef ALT_BITSTREAM_READER_64
+#   define MIN_CACHE_BITS 32
+# else
 #   define MIN_CACHE_BITS 25
+# endif
 
 #   define OPEN_READER(name, gb)                \
     unsigned int name##_index = (gb)->index;    \
-    av_unused unsigned int name##_cache
+    av_unused CACHE_TYPE name##_cache
 
 #   define CLOSE_READER(name, gb) (gb)->index = name##_index
 
+# ifdef ALT_BITSTREAM_READER_64
+#   define CACHE_TYPE uint64_t
+#   define CACHE_RB AV_RB64
+#   define CACHE_RL AV_RL64
+# else
+#   define CACHE_TYPE unsigned int
+#   define CACHE_RB AV_RB32
+#   define CACHE_RL AV_RL32
+# endif
+
 # ifdef ALT_BITSTREAM_READER_LE
 #   define UPDATE_CACHE(name, gb) \
-    name##_cache = AV_RL32(((const uint8_t *)(gb)->buffer)+(name##_index>>3)) >> (name##_index&0x07)
+    name##_cache = CACHE_RL(((const uint8_t *)(gb)->buffer)+(name##_index>>3)) >> (name##_index&0x07)
 
 #   define SKIP_CACHE(name, gb, num) name##_cache >>= (num)
 # else
 #   define UPDATE_CACHE(name, gb) \
-    name##_cache = AV_RB32(((const uint8_t *)(gb)->buffer)+(name##_index>>3)) << (name##_index&0x07)
+    name##_cache = CACHE_RB(((const uint8_t *)(gb)->buffer)+(name##_index>>3)) << (name##_index&0x07)
 
 #   define SKIP_CACHE(name, gb, num) name##_cache <<= (num)
 # endif
@@ -154,17 +184,37 @@ for examples see get_bits, show_bits, skip_bits, get_vlc
 #   define LAST_SKIP_BITS(name, gb, num) SKIP_COUNTER(name, gb, num)
 #   define LAST_SKIP_CACHE(name, gb, num)
 
+# ifdef ALT_BITSTREAM_READER_64
+/* a refill leaves at least 57 bits in the cache */
+#   define SKIP_AND_UPDATE_CACHE(name, gb, num) SKIP_BITS(name, gb, num)
+# else
+#   define SKIP_AND_UPDATE_CACHE(name, gb, num) do {    \
+        LAST_SKIP_BITS(name, gb, num);                  \
+        UPDATE_CACHE(name, gb);                         \
+    } while (0)
+# endif
+
 # ifdef ALT_BITSTREAM_READER_LE
 #   define SHOW_UBITS(name, gb, num) zero_extend(name##_cache, num)
 
 #   define SHOW_SBITS(name, gb, num) sign_extend(name##_cache, num)
+
+#   define GET_CACHE(name, gb) ((uint32_t)name##_cache)
+# elif defined ALT_BITSTREAM_READER_64
+#   define SHOW_UBITS(name, gb, num) \
+    ((unsigned int)(name##_cache >> ((64 - (num)) & 63)))
+
+#   define SHOW_SBITS(name, gb, num) \
+    ((int)((int64_t)name##_cache >> ((64 - (num)) & 63)))
+
+#   define GET_CACHE(name, gb) ((uint32_t)(name##_cache >> 32))
 # else
 #   define SHOW_UBITS(name, gb, num) NEG_USR32(name##_cache, num)
 
 #   define SHOW_SBITS(name, gb, num) NEG_SSR32(name##_cache, num)
-# endif
 
 #   define GET_CACHE(name, gb) ((uint32_t)name##_cache)
+# endif
 
 static inline int get_bits_count(const GetBitContext *s){
     return s->index;
@@ -225,6 +275,11 @@ static inline void skip_bits_long(GetBitContext *s, int n){
 #   define LAST_SKIP_BITS(name, gb, num)  SKIP_BITS(name, gb, num)
 #   define LAST_SKIP_CACHE(name, gb, num) SKIP_CACHE(name, gb, num)
 
+#   define SKIP_AND_UPDATE_CACHE(name, gb, num) do {    \
+        LAST_SKIP_BITS(name, gb, num);                  \
+        UPDATE_CACHE(name, gb);                         \
+    } while (0)
+
 #   define SHOW_UBITS(name, gb, num) NEG_USR32(name##_cache0, num)
 
 #   define SHOW_SBITS(name, gb, num) NEG_SSR32(name##_cache0, num)
@@ -456,8 +511,7 @@ void free_vlc(VLC *vlc);
         n     = table[index][1];                                \
                                                                 \
         if (max_depth > 1 && n < 0) {                           \
-            LAST_SKIP_BITS(name, gb, bits);                     \
-            UPDATE_CACHE(name, gb);                             \
+            SKIP_AND_UPDATE_CACHE(name, gb, bits);              \
                                                                 \
             nb_bits = -n;                                       \
                                                                 \
@@ -465,8 +519,7 @@ void free_vlc(VLC *vlc);
             code  = table[index][0];                            \
             n     = table[index][1];                            \
             if (max_depth > 2 && n < 0) {                       \
-                LAST_SKIP_BITS(name, gb, nb_bits);              \
-                UPDATE_CACHE(name, gb);                         \
+                SKIP_AND_UPDATE_CACHE(name, gb, nb_bits);       \
                                                                 \
                 nb_bits = -n;                                   \
                                                                 \
@@ -487,9 +540,10 @@ void free_vlc(VLC *vlc);
         n     = table[index].len;                                       \
                                                                         \
         if (max_depth > 1 && n < 0) {                                   \
-            SKIP_BITS(name, gb, bits);                                  \
             if (need_update) {                                          \
-                UPDATE_CACHE(name, gb);                                 \
+                SKIP_AND_UPDATE_CACHE(name, gb, bits);                  \
+            } else {                                                    \
+                SKIP_BITS(name, gb, bits);                              \
             }                                                           \
                                                                         \
             nb_bits = -n;                                               \
@@ -36,15 +36,21 @@
 #include "golomb.h"
 #include "mathops.h"
 #include "rectangle.h"
+#include "startcode.h"
 #include "thread.h"
 #include "vdpau_internal.h"
 #include "libavutil/avassert.h"
+#include "libavutil/timer.h"
 
 #include "cabac.h"
 
 //#undef NDEBUG
 #include <assert.h>
 
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
 static const uint8_t rem6[QP_MAX_NUM+1]={
 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3,
 };
@@ -154,33 +160,15 @@ const uint8_t *ff_h264_decode_nal(H264Context *h, const uint8_t *src, int *dst_l
 
     src++; length--;
 
-#if HAVE_FAST_UNALIGNED
-# if HAVE_FAST_64BIT
-#   define RS 7
-    for(i=0; i+1<length; i+=9){
-        if(!((~AV_RN64A(src+i) & (AV_RN64A(src+i) - 0x0100010001000101ULL)) & 0x8000800080008080ULL))
-# else
-#   define RS 3
-    for(i=0; i+1<length; i+=5){
-        if(!((~AV_RN32A(src+i) & (AV_RN32A(src+i) - 0x01000101U)) & 0x80008080U))
-# endif
-            continue;
-        if(i>0 && !src[i]) i--;
-        while(src[i]) i++;
-#else
-#   define RS 0
-    for(i=0; i+1<length; i+=2){
-        if(src[i]) continue;
-        if(i>0 && src[i-1]==0) i--;
-#endif
-        if(i+2<length && src[i+1]==0 && src[i+2]<=3){
+    for(i=0; i+2<length; i++){
+        i+= ff_startcode_find_zero_pair(src+i, length-i-1);
+        if(i+2<length && src[i+2]<=3){
             if(src[i+2]!=3){
                 /* startcode, so we must be past the end */
                 length=i;
             }
             break;
         }
-        i-= RS;
     }
 
     if(i>=length-1){ //no escaped 0
@@ -805,10 +793,15 @@ static av_always_inline void hl_motion_ ## bits(H264Context *h, \
 hl_motion_fn(0, 8);
 hl_motion_fn(1, 16);
 
+static void deblock_flush(H264Context *h);
+static void deblock_uninit(H264Context *h);
+
 static void free_tables(H264Context *h, int free_rbsp){
     int i;
     H264Context *hx;
 
+    deblock_uninit(h);
+
     av_freep(&h->intra4x4_pred_mode);
     av_freep(&h->chroma_pred_mode_table);
     av_freep(&h->cbp_table);
@@ -910,7 +903,7 @@ static void init_dequant_tables(H264Context *h){
 int ff_h264_alloc_tables(H264Context *h){
     MpegEncContext * const s = &h->s;
     const int big_mb_num= s->mb_stride * (s->mb_height+1);
-    const int row_mb_num= 2*s->mb_stride*s->avctx->thread_count;
+    const int row_mb_num= 2*s->mb_stride*FFMAX(s->avctx->thread_count, ff_thread_slice_count(s->avctx));
     int x,y;
 
     FF_ALLOCZ_OR_GOTO(h->s.avctx, h->intra4x4_pred_mode, row_mb_num * 8  * sizeof(uint8_t), fail)
@@ -989,6 +982,7 @@ fail:
 }
 
 static int decode_nal_units(H264Context *h, const uint8_t *buf, int buf_size);
+static int init_thread_contexts(H264Context *h);
 
 static av_cold void common_init(H264Context *h){
     MpegEncContext * const s = &h->s;
@@ -1165,8 +1159,9 @@ static int decode_update_thread_context(AVCodecContext *dst, const AVCodecContex
         memcpy(&h->s + 1, &h1->s + 1, sizeof(H264Context) - sizeof(MpegEncContext)); //copy all fields after MpegEnc
         memset(h->sps_buffers, 0, sizeof(h->sps_buffers));
         memset(h->pps_buffers, 0, sizeof(h->pps_buffers));
+        h->deblock_ctx      = NULL;
+        h->deblock_deferred = 0;
         ff_h264_alloc_tables(h);
-        context_init(h);
 
         for(i=0; i<2; i++){
             h->rbsp_buffer[i] = NULL;
@@ -1174,6 +1169,13 @@ static int decode_update_thread_context(AVCodecContext *dst, const AVCodecContex
         }
 
         h->thread_context[0] = h;
+        if (HAVE_THREADS && (s->avctx->active_thread_type&FF_THREAD_SLICE)) {
+            // the slice contexts of the source thread must not be shared
+            memset(h->thread_context + 1, 0, sizeof(h->thread_context) - sizeof(h->thread_context[0]));
+            if (init_thread_contexts(h) < 0)
+                return -1;
+        } else
+            context_init(h);
 
         // frame_start may not be called for the next thread (if it's decoding a bottom field)
         // so this has to be allocated here
@@ -1236,8 +1238,9 @@ int ff_h264_frame_start(H264Context *h){
     MpegEncContext * const s = &h->s;
     int i;
     const int pixel_shift = h->pixel_shift;
-    int thread_count = (s->avctx->active_thread_type & FF_THREAD_SLICE) ? s->avctx->thread_count : 1;
+    int thread_count = ff_thread_slice_count(s->avctx);
 
+    deblock_flush(h);
     if(MPV_frame_start(s, s->avctx) < 0)
         return -1;
     ff_er_frame_start(s);
@@ -1305,7 +1308,7 @@ static void decode_postinit(H264Context *h, int setup_finished){
     MpegEncContext * const s = &h->s;
     Picture *out = s->current_picture_ptr;
     Picture *cur = s->current_picture_ptr;
-    int i, pics, out_of_order, out_idx;
+    int i, pics, out_of_order, out_idx, async_depth = 0;
 
     s->current_picture_ptr->qscale_type= FF_QSCALE_TYPE_H264;
     s->current_picture_ptr->pict_type= s->pict_type;
@@ -1400,6 +1403,12 @@ static void decode_postinit(H264Context *h, int setup_finished){
         s->low_delay= 0;
     }
 
+    /* keep more hwaccel pictures queued so that the GPU still has work
+     * while the application waits for the one which is returned */
+    if (s->avctx->hwaccel)
+        async_depth = av_clip(s->avctx->hwaccel_async_depth, 0,
+                              MAX_DELAYED_PIC_COUNT - s->avctx->has_b_frames);
+
     pics = 0;
     while(h->delayed_pic[pics]) pics++;
 
@@ -1422,7 +1431,7 @@ static void decode_postinit(H264Context *h, int setup_finished){
 
     if(h->sps.bitstream_restriction_flag && s->avctx->has_b_frames >= h->sps.num_reorder_frames)
         { }
-    else if((out_of_order && pics-1 == s->avctx->has_b_frames && s->avctx->has_b_frames < MAX_DELAYED_PIC_COUNT)
+    else if((out_of_order && pics-1-async_depth == s->avctx->has_b_frames && s->avctx->has_b_frames < MAX_DELAYED_PIC_COUNT)
        || (s->low_delay &&
         ((h->next_outputed_poc != INT_MIN && out->poc > h->next_outputed_poc + 2)
          || cur->pict_type == AV_PICTURE_TYPE_B)))
@@ -1431,14 +1440,14 @@ static void decode_postinit(H264Context *h, int setup_finished){
         s->avctx->has_b_frames++;
     }
 
-    if(out_of_order || pics > s->avctx->has_b_frames){
+    if(out_of_order || pics > s->avctx->has_b_frames + async_depth){
         out->reference &= ~DELAYED_PIC_REF;
         out->owner2 = s; // for frame threading, the owner must be the second field's thread
                          // or else the first thread can release the picture and reuse it unsafely
         for(i=out_idx; h->delayed_pic[i]; i++)
             h->delayed_pic[i] = h->delayed_pic[i+1];
     }
-    if(!out_of_order && pics > s->avctx->has_b_frames){
+    if(!out_of_order && pics > s->avctx->has_b_frames + async_depth){
         h->next_output_pic = out;
         if(out_idx==0 && h->delayed_pic[0] && (h->delayed_pic[0]->key_frame || h->delayed_pic[0]->mmco_reset)) {
             h->next_outputed_poc = INT_MIN;
@@ -1872,7 +1881,7 @@ static av_always_inline void hl_decode_mb_internal(H264Context *h, int simple, i
         }
     } else {
         if(IS_INTRA(mb_type)){
-            if(h->deblocking_filter)
+            if(h->deblocking_filter && !h->deblock_deferred)
                 xchg_mb_border(h, dest_y, dest_cb, dest_cr, linesize, uvlinesize, 1, 0, simple, pixel_shift);
 
             if(simple || !CONFIG_GRAY || !(s->flags&CODEC_FLAG_GRAY)){
@@ -1882,7 +1891,7 @@ static av_always_inline void hl_decode_mb_internal(H264Context *h, int simple, i
 
             hl_decode_mb_predict_luma(h, mb_type, is_h264, simple, transform_bypass, pixel_shift, block_offset, linesize, dest_y, 0);
 
-            if(h->deblocking_filter)
+            if(h->deblocking_filter && !h->deblock_deferred)
                 xchg_mb_border(h, dest_y, dest_cb, dest_cr, linesize, uvlinesize, 0, 0, simple, pixel_shift);
         }else if(is_h264){
             if (pixel_shift) {
@@ -2020,13 +2029,13 @@ static av_always_inline void hl_decode_mb_444_internal(H264Context *h, int simpl
         }
     } else {
         if(IS_INTRA(mb_type)){
-            if(h->deblocking_filter)
+            if(h->deblocking_filter && !h->deblock_deferred)
                 xchg_mb_border(h, dest[0], dest[1], dest[2], linesize, linesize, 1, 1, simple, pixel_shift);
 
             for (p = 0; p < plane_count; p++)
                 hl_decode_mb_predict_luma(h, mb_type, 1, simple, transform_bypass, pixel_shift, block_offset, linesize, dest[p], p);
 
-            if(h->deblocking_filter)
+            if(h->deblocking_filter && !h->deblock_deferred)
                 xchg_mb_border(h, dest[0], dest[1], dest[2], linesize, linesize, 0, 1, simple, pixel_shift);
         }else{
             if (pixel_shift) {
@@ -2078,13 +2087,598 @@ static void av_noinline hl_decode_mb_444_simple(H264Context *h){
     hl_decode_mb_444_internal(h, 1, 0);
 }
 
+/* Reduced resolution decoding: the MBs are reconstructed at 1/2^lowres of
+ * their size without deblocking, so the result drifts from the real
+ * pictures over the GOP; this is meant for previews and thumbnails. */
+
+#define LOWRES_LUMA   1
+#define LOWRES_CHROMA 2
+
+static void put_h264_chroma_mc1_lowres(uint8_t *dst, uint8_t *src, int stride, int h, int x, int y){
+    const int A = (8-x)*(8-y);
+    const int B = (  x)*(8-y);
+    const int C = (8-x)*(  y);
+    const int D = (  x)*(  y);
+    int i;
+
+    for(i=0; i<h; i++){
+        dst[0] = (A*src[0] + B*src[1] + C*src[stride] + D*src[stride+1] + 32) >> 6;
+        dst += stride;
+        src += stride;
+    }
+}
+
+static void avg_h264_chroma_mc1_lowres(uint8_t *dst, uint8_t *src, int stride, int h, int x, int y){
+    const int A = (8-x)*(8-y);
+    const int B = (  x)*(8-y);
+    const int C = (8-x)*(  y);
+    const int D = (  x)*(  y);
+    int i;
+
+    for(i=0; i<h; i++){
+        dst[0] = (dst[0] + ((A*src[0] + B*src[1] + C*src[stride] + D*src[stride+1] + 32) >> 6) + 1) >> 1;
+        dst += stride;
+        src += stride;
+    }
+}
+
+/**
+ * Predict a w x h block of one plane with the bilinear chroma filter.
+ * @param sx, sy   position of the block in the reference plane
+ * @param fx, fy   eighth pel fraction of the position
+ * @param pw, ph   size of the decoded part of the plane
+ */
+static void mc_plane_lowres(MpegEncContext *s, uint8_t *dst, uint8_t *ref, int stride,
+                            int sx, int sy, int fx, int fy, int w, int h,
+                            int pw, int ph, int avg){
+    uint8_t *src = ref + sy*stride + sx;
+
+    if(sx < 0 || sy < 0 || sx + w + 1 > pw || sy + h + 1 > ph){
+        s->dsp.emulated_edge_mc(s->edge_emu_buffer, src, stride, w+1, h+1, sx, sy, pw, ph);
+        src = s->edge_emu_buffer;
+    }
+
+    if(w == 1){
+        if(avg) avg_h264_chroma_mc1_lowres(dst, src, stride, h, fx, fy);
+        else    put_h264_chroma_mc1_lowres(dst, src, stride, h, fx, fy);
+    }else if(avg){
+        s->dsp.avg_h264_chroma_pixels_tab[3 - av_log2(w)](dst, src, stride, h, fx, fy);
+    }else
+        s->dsp.put_h264_chroma_pixels_tab[3 - av_log2(w)](dst, src, stride, h, fx, fy);
+}
+
+/**
+ * Motion compensate the planes of a partition from one list.
+ * @param x, y, w, height partition position and size in full size luma pixels
+ */
+static void mc_dir_part_lowres(H264Context *h, Picture *pic, int n, int list,
+                               int x, int y, int w, int height, int planes,
+                               uint8_t *dest_y, uint8_t *dest_cb, uint8_t *dest_cr, int avg){
+    MpegEncContext * const s = &h->s;
+    const int lowres = s->avctx->lowres;
+    const int mx = h->mv_cache[list][ scan8[n] ][0];
+    const int my = h->mv_cache[list][ scan8[n] ][1];
+    const int pic_width  = 16*s->mb_width  >> lowres;
+    const int pic_height = 16*s->mb_height >> lowres;
+
+    if(planes & LOWRES_LUMA){
+        const int qx = ((16*s->mb_x + x) << 2) + mx;
+        const int qy = ((16*s->mb_y + y) << 2) + my;
+        const int mask = (4 << lowres) - 1;
+
+        mc_plane_lowres(s, dest_y + (x >> lowres) + (y >> lowres)*s->linesize, pic->data[0], s->linesize,
+                        qx >> (lowres+2), qy >> (lowres+2), ((qx & mask) << 1) >> lowres, ((qy & mask) << 1) >> lowres,
+                        w >> lowres, height >> lowres, pic_width, pic_height, avg);
+    }
+
+    if((planes & LOWRES_CHROMA) && !(CONFIG_GRAY && s->flags&CODEC_FLAG_GRAY)){
+        const int ex = ((8*s->mb_x + (x >> 1)) << 3) + mx;
+        const int ey = ((8*s->mb_y + (y >> 1)) << 3) + my;
+        const int mask = (8 << lowres) - 1;
+        const int offset = (x >> (lowres+1)) + (y >> (lowres+1))*s->uvlinesize;
+
+        mc_plane_lowres(s, dest_cb + offset, pic->data[1], s->uvlinesize,
+                        ex >> (lowres+3), ey >> (lowres+3), (ex & mask) >> lowres, (ey & mask) >> lowres,
+                        w >> (lowres+1), height >> (lowres+1), pic_width >> 1, pic_height >> 1, avg);
+        mc_plane_lowres(s, dest_cr + offset, pic->data[2], s->uvlinesize,
+                        ex >> (lowres+3), ey >> (lowres+3), (ex & mask) >> lowres, (ey & mask) >> lowres,
+                        w >> (lowres+1), height >> (lowres+1), pic_width >> 1, pic_height >> 1, avg);
+    }
+}
+
+static void weight_lowres(uint8_t *block, int stride, int w, int h, int log2_denom, int weight, int offset){
+    int x, y;
+
+    offset <<= log2_denom;
+    if(log2_denom) offset += 1<<(log2_denom-1);
+    for(y=0; y<h; y++, block += stride)
+        for(x=0; x<w; x++)
+            block[x] = av_clip_uint8((block[x]*weight + offset) >> log2_denom);
+}
+
+static void biweight_lowres(uint8_t *dst, uint8_t *src, int stride, int w, int h, int log2_denom, int weightd, int weights, int offset){
+    int x, y;
+
+    offset = ((offset + 1) | 1) << log2_denom;
+    for(y=0; y<h; y++, dst += stride, src += stride)
+        for(x=0; x<w; x++)
+            dst[x] = av_clip_uint8((src[x]*weights + dst[x]*weightd + offset) >> (log2_denom+1));
+}
+
+static void mc_part_lowres(H264Context *h, int n, int x, int y, int w, int height,
+                           int list0, int list1, int planes,
+                           uint8_t *dest_y, uint8_t *dest_cb, uint8_t *dest_cr){
+    MpegEncContext * const s = &h->s;
+    const int lowres = s->avctx->lowres;
+    const int refn0 = h->ref_cache[0][ scan8[n] ];
+    const int refn1 = h->ref_cache[1][ scan8[n] ];
+    const int lw = w >> lowres, lh = height >> lowres;
+    const int luma_offset = (x >> lowres) + (y >> lowres)*s->linesize;
+    const int cw = w >> (lowres+1), ch = height >> (lowres+1);
+    const int chroma_offset = (x >> (lowres+1)) + (y >> (lowres+1))*s->uvlinesize;
+    const int chroma = (planes & LOWRES_CHROMA) && !(CONFIG_GRAY && s->flags&CODEC_FLAG_GRAY);
+
+    if(!(h->use_weight == 1 || (h->use_weight == 2 && list0 && list1
+                                && h->implicit_weight[refn0][refn1][s->mb_y&1] != 32))){
+        if(list0)
+            mc_dir_part_lowres(h, &h->ref_list[0][refn0], n, 0, x, y, w, height, planes,
+                               dest_y, dest_cb, dest_cr, 0);
+        if(list1)
+            mc_dir_part_lowres(h, &h->ref_list[1][refn1], n, 1, x, y, w, height, planes,
+                               dest_y, dest_cb, dest_cr, list0);
+        return;
+    }
+
+    if(list0 && list1){
+        uint8_t *tmp_cb = s->obmc_scratchpad;
+        uint8_t *tmp_cr = s->obmc_scratchpad + 8;
+        uint8_t *tmp_y  = s->obmc_scratchpad + 8*s->uvlinesize;
+
+        mc_dir_part_lowres(h, &h->ref_list[0][refn0], n, 0, x, y, w, height, planes,
+                           dest_y, dest_cb, dest_cr, 0);
+        mc_dir_part_lowres(h, &h->ref_list[1][refn1], n, 1, x, y, w, height, planes,
+                           tmp_y, tmp_cb, tmp_cr, 0);
+
+        if(h->use_weight == 2){
+            int weight0 = h->implicit_weight[refn0][refn1][s->mb_y&1];
+            int weight1 = 64 - weight0;
+            if(planes & LOWRES_LUMA)
+                biweight_lowres(dest_y + luma_offset, tmp_y + luma_offset, s->linesize, lw, lh, 5, weight0, weight1, 0);
+            if(chroma){
+                biweight_lowres(dest_cb + chroma_offset, tmp_cb + chroma_offset, s->uvlinesize, cw, ch, 5, weight0, weight1, 0);
+                biweight_lowres(dest_cr + chroma_offset, tmp_cr + chroma_offset, s->uvlinesize, cw, ch, 5, weight0, weight1, 0);
+            }
+        }else{
+            if(planes & LOWRES_LUMA)
+                biweight_lowres(dest_y + luma_offset, tmp_y + luma_offset, s->linesize, lw, lh, h->luma_log2_weight_denom,
+                                h->luma_weight[refn0][0][0], h->luma_weight[refn1][1][0],
+                                h->luma_weight[refn0][0][1] + h->luma_weight[refn1][1][1]);
+            if(chroma){
+                biweight_lowres(dest_cb + chroma_offset, tmp_cb + chroma_offset, s->uvlinesize, cw, ch, h->chroma_log2_weight_denom,
+                                h->chroma_weight[refn0][0][0][0], h->chroma_weight[refn1][1][0][0],
+                                h->chroma_weight[refn0][0][0][1] + h->chroma_weight[refn1][1][0][1]);
+                biweight_lowres(dest_cr + chroma_offset, tmp_cr + chroma_offset, s->uvlinesize, cw, ch, h->chroma_log2_weight_denom,
+                                h->chroma_weight[refn0][0][1][0], h->chroma_weight[refn1][1][1][0],
+                                h->chroma_weight[refn0][0][1][1] + h->chroma_weight[refn1][1][1][1]);
+            }
+        }
+    }else{
+        const int list = list1 ? 1 : 0;
+        const int refn = list1 ? refn1 : refn0;
+
+        mc_dir_part_lowres(h, &h->ref_list[list][refn], n, list, x, y, w, height, planes,
+                           dest_y, dest_cb, dest_cr, 0);
+
+        if(planes & LOWRES_LUMA)
+            weight_lowres(dest_y + luma_offset, s->linesize, lw, lh, h->luma_log2_weight_denom,
+                          h->luma_weight[refn][list][0], h->luma_weight[refn][list][1]);
+        if(chroma && h->use_weight_chroma){
+            weight_lowres(dest_cb + chroma_offset, s->uvlinesize, cw, ch, h->chroma_log2_weight_denom,
+                          h->chroma_weight[refn][list][0][0], h->chroma_weight[refn][list][0][1]);
+            weight_lowres(dest_cr + chroma_offset, s->uvlinesize, cw, ch, h->chroma_log2_weight_denom,
+                          h->chroma_weight[refn][list][1][0], h->chroma_weight[refn][list][1][1]);
+        }
+    }
+}
+
+/**
+ * @return the planes a partition of size min_size is large enough to be
+ *         predicted on by itself; the others are predicted from the motion
+ *         of the enclosing partition
+ */
+static int lowres_planes(int lowres, int min_size){
+    return (min_size >= 1 << lowres ? LOWRES_LUMA   : 0) |
+           (min_size >= 2 << lowres ? LOWRES_CHROMA : 0);
+}
+
+static void hl_motion_lowres(H264Context *h, uint8_t *dest_y, uint8_t *dest_cb, uint8_t *dest_cr){
+    MpegEncContext * const s = &h->s;
+    const int lowres = s->avctx->lowres;
+    const int mb_type = s->current_picture.mb_type[h->mb_xy];
+    const int all = LOWRES_LUMA | LOWRES_CHROMA;
+    int planes, i;
+
+    if(HAVE_PTHREADS && (s->avctx->active_thread_type & FF_THREAD_FRAME))
+        await_references(h);
+
+    if(IS_16X16(mb_type)){
+        mc_part_lowres(h, 0, 0, 0, 16, 16, IS_DIR(mb_type, 0, 0), IS_DIR(mb_type, 0, 1), all,
+                       dest_y, dest_cb, dest_cr);
+    }else if(IS_16X8(mb_type) || IS_8X16(mb_type)){
+        const int w = IS_16X8(mb_type) ? 16 : 8;
+
+        planes = lowres_planes(lowres, 8);
+        if(planes != all)
+            mc_part_lowres(h, 0, 0, 0, 16, 16, IS_DIR(mb_type, 0, 0), IS_DIR(mb_type, 0, 1), all & ~planes,
+                           dest_y, dest_cb, dest_cr);
+        mc_part_lowres(h, 0, 0, 0, w, 24 - w, IS_DIR(mb_type, 0, 0), IS_DIR(mb_type, 0, 1), planes,
+                       dest_y, dest_cb, dest_cr);
+        if(w == 16)
+            mc_part_lowres(h, 8, 0, 8, 16, 8, IS_DIR(mb_type, 1, 0), IS_DIR(mb_type, 1, 1), planes,
+                           dest_y, dest_cb, dest_cr);
+        else
+            mc_part_lowres(h, 4, 8, 0, 8, 16, IS_DIR(mb_type, 1, 0), IS_DIR(mb_type, 1, 1), planes,
+                           dest_y, dest_cb, dest_cr);
+    }else{
+        assert(IS_8X8(mb_type));
+
+        planes = lowres_planes(lowres, 8);
+        if(planes != all)
+            mc_part_lowres(h, 0, 0, 0, 16, 16, IS_DIR(h->sub_mb_type[0], 0, 0), IS_DIR(h->sub_mb_type[0], 0, 1),
+                           all & ~planes, dest_y, dest_cb, dest_cr);
+
+        for(i=0; i<4; i++){
+            const int sub_mb_type = h->sub_mb_type[i];
+            const int list0 = IS_DIR(sub_mb_type, 0, 0);
+            const int list1 = IS_DIR(sub_mb_type, 0, 1);
+            const int n = 4*i;
+            const int x = (i&1)<<3;
+            const int y = (i&2)<<2;
+            int sub_planes = IS_SUB_8X8(sub_mb_type) ? planes : planes & lowres_planes(lowres, 4);
+            int j;
+
+            if(sub_planes != planes)
+                mc_part_lowres(h, n, x, y, 8, 8, list0, list1, planes & ~sub_planes,
+                               dest_y, dest_cb, dest_cr);
+            if(!sub_planes)
+                continue;
+
+            if(IS_SUB_8X8(sub_mb_type)){
+                mc_part_lowres(h, n, x, y, 8, 8, list0, list1, sub_planes, dest_y, dest_cb, dest_cr);
+            }else if(IS_SUB_8X4(sub_mb_type)){
+                mc_part_lowres(h, n  , x, y  , 8, 4, list0, list1, sub_planes, dest_y, dest_cb, dest_cr);
+                mc_part_lowres(h, n+2, x, y+4, 8, 4, list0, list1, sub_planes, dest_y, dest_cb, dest_cr);
+            }else if(IS_SUB_4X8(sub_mb_type)){
+                mc_part_lowres(h, n  , x  , y, 4, 8, list0, list1, sub_planes, dest_y, dest_cb, dest_cr);
+                mc_part_lowres(h, n+1, x+4, y, 4, 8, list0, list1, sub_planes, dest_y, dest_cb, dest_cr);
+            }else{
+                assert(IS_SUB_4X4(sub_mb_type));
+                for(j=0; j<4; j++)
+                    mc_part_lowres(h, n+j, x + 4*(j&1), y + 2*(j&2), 4, 4, list0, list1, sub_planes,
+                                   dest_y, dest_cb, dest_cr);
+            }
+        }
+    }
+}
+
+enum {
+    LOWRES_PRED_DC,
+    LOWRES_PRED_LEFT_DC,
+    LOWRES_PRED_TOP_DC,
+    LOWRES_PRED_DC_128,
+    LOWRES_PRED_VERT,
+    LOWRES_PRED_HOR,
+    LOWRES_PRED_DIAG,  ///< average of the top and left neighbours
+    LOWRES_PRED_PLANE, ///< approximated by the VP8 "true motion" prediction
+};
+
+/* the directional modes are replaced by the closest of the simple ones */
+static const uint8_t lowres_pred4x4_mode[12] = {
+    LOWRES_PRED_VERT,    LOWRES_PRED_HOR,    LOWRES_PRED_DC,
+    LOWRES_PRED_VERT,    LOWRES_PRED_DIAG,   LOWRES_PRED_DIAG,
+    LOWRES_PRED_DIAG,    LOWRES_PRED_VERT,   LOWRES_PRED_HOR,
+    LOWRES_PRED_LEFT_DC, LOWRES_PRED_TOP_DC, LOWRES_PRED_DC_128,
+};
+
+static const uint8_t lowres_pred8x8_mode[11] = {
+    LOWRES_PRED_DC,      LOWRES_PRED_HOR,    LOWRES_PRED_VERT,
+    LOWRES_PRED_PLANE,   LOWRES_PRED_LEFT_DC, LOWRES_PRED_TOP_DC,
+    LOWRES_PRED_DC_128,  LOWRES_PRED_DC,     LOWRES_PRED_DC,
+    LOWRES_PRED_DC,      LOWRES_PRED_DC,
+};
+
+static void pred_lowres(uint8_t *dst, int stride, int size, int mode){
+    const uint8_t *top = dst - stride;
+    const int log2_size = av_log2(size);
+    int x, y, dc = 0;
+
+    switch(mode){
+    case LOWRES_PRED_VERT:
+        for(y=0; y<size; y++)
+            memcpy(dst + y*stride, top, size);
+        return;
+    case LOWRES_PRED_HOR:
+        for(y=0; y<size; y++)
+            memset(dst + y*stride, dst[y*stride - 1], size);
+        return;
+    case LOWRES_PRED_DIAG:
+        for(y=0; y<size; y++)
+            for(x=0; x<size; x++)
+                dst[y*stride + x] = (top[x] + dst[y*stride - 1] + 1) >> 1;
+        return;
+    case LOWRES_PRED_PLANE:
+        for(y=0; y<size; y++)
+            for(x=0; x<size; x++)
+                dst[y*stride + x] = av_clip_uint8(top[x] + dst[y*stride - 1] - top[-1]);
+        return;
+    case LOWRES_PRED_DC:
+        for(x=0; x<size; x++)
+            dc += top[x] + dst[x*stride - 1];
+        dc = (dc + size) >> (log2_size + 1);
+        break;
+    case LOWRES_PRED_LEFT_DC:
+        for(y=0; y<size; y++)
+            dc += dst[y*stride - 1];
+        dc = (dc + (size >> 1)) >> log2_size;
+        break;
+    case LOWRES_PRED_TOP_DC:
+        for(x=0; x<size; x++)
+            dc += top[x];
+        dc = (dc + (size >> 1)) >> log2_size;
+        break;
+    default:
+        dc = 128;
+    }
+    for(y=0; y<size; y++)
+        memset(dst + y*stride, dc, size);
+}
+
+/**
+ * Sum the outputs of the 1-D inverse transform of n coefficients in groups
+ * of g.
+ */
+static void idct_1d_sum_lowres(int *sum, const int *c, int n, int g){
+    int o[8], i, j;
+
+    if(n == 4){
+        const int z0=  c[0]     +  c[2];
+        const int z1=  c[0]     -  c[2];
+        const int z2= (c[1]>>1) -  c[3];
+        const int z3=  c[1]     + (c[3]>>1);
+
+        o[0]= z0 + z3;
+        o[1]= z1 + z2;
+        o[2]= z1 - z2;
+        o[3]= z0 - z3;
+    }else{
+        const int a0 =  c[0] + c[4];
+        const int a2 =  c[0] - c[4];
+        const int a4 = (c[2]>>1) - c[6];
+        const int a6 = (c[6]>>1) + c[2];
+
+        const int b0 = a0 + a6;
+        const int b2 = a2 + a4;
+        const int b4 = a2 - a4;
+        const int b6 = a0 - a6;
+
+        const int a1 = -c[3] + c[5] - c[7] - (c[7]>>1);
+        const int a3 =  c[1] + c[7] - c[3] - (c[3]>>1);
+        const int a5 = -c[1] + c[7] + c[5] + (c[5]>>1);
+        const int a7 =  c[3] + c[5] + c[1] + (c[1]>>1);
+
+        const int b1 = (a7>>2) + a1;
+        const int b3 =  a3 + (a5>>2);
+        const int b5 = (a3>>2) - a5;
+        const int b7 =  a7 - (a1>>2);
+
+        o[0] = b0 + b7;
+        o[7] = b0 - b7;
+        o[1] = b2 + b5;
+        o[6] = b2 - b5;
+        o[2] = b4 + b3;
+        o[5] = b4 - b3;
+        o[3] = b6 + b1;
+        o[4] = b6 - b1;
+    }
+
+    for(i=0; i<n/g; i++){
+        sum[i] = 0;
+        for(j=0; j<g; j++)
+            sum[i] += o[i*g + j];
+    }
+}
+
+/**
+ * Add the residual of a 2^log2_size square block at (x, y) of a region to
+ * the sums of the region pixels at reduced size. Only the sums of the
+ * outputs of the inverse transform over each pixel are computed, blocks
+ * smaller than a pixel add to the pixel they are part of.
+ * @param sum sums of the region, with a stride of size >> lowres
+ */
+static void add_residual_sum_lowres(int *sum, int size, const DCTELEM *block,
+                                    int x, int y, int log2_size, int lowres){
+    const int n = 1 << log2_size;
+    const int g = FFMIN(n, 1 << lowres);
+    const int out = n / g;
+    const int stride = FFMAX(size >> lowres, 1);
+    int tmp[8][8], c[8], col[8];
+    int i, j;
+
+    sum += (y >> lowres)*stride + (x >> lowres);
+
+    for(i=1; i<n*n && !block[i]; i++);
+    if(i == n*n){
+        /* every output of a DC only block is the DC */
+        for(i=0; i<out; i++)
+            for(j=0; j<out; j++)
+                sum[i*stride + j] += block[0]*g*g;
+        return;
+    }
+
+    /* the coefficients are stored transposed */
+    for(i=0; i<n; i++){
+        for(j=0; j<n; j++)
+            c[j] = block[j*n + i];
+        idct_1d_sum_lowres(tmp[i], c, n, g);
+    }
+    for(j=0; j<out; j++){
+        for(i=0; i<n; i++)
+            c[i] = tmp[i][j];
+        idct_1d_sum_lowres(col, c, n, g);
+        for(i=0; i<out; i++)
+            sum[i*stride + j] += col[i];
+    }
+}
+
+/**
+ * Add the residual summed over the full size region of each pixel to the
+ * pixels, and reset the sums.
+ */
+static void put_residual_sum_lowres(uint8_t *dst, int stride, int *sum, int size, int lowres){
+    const int shift = 6 + 2*lowres;
+    const int w = FFMAX(size >> lowres, 1);
+    int x, y;
+
+    for(y=0; y<w; y++, dst += stride, sum += w)
+        for(x=0; x<w; x++){
+            dst[x] = av_clip_uint8(dst[x] + ((sum[x] + (1 << (shift-1))) >> shift));
+            sum[x] = 0;
+        }
+}
+
+static void pcm_lowres(uint8_t *dst, int stride, const uint8_t *src, int size, int lowres){
+    const int w = size >> lowres;
+    const int n = 1 << lowres;
+    int x, y, i, j;
+
+    for(y=0; y<w; y++)
+        for(x=0; x<w; x++){
+            int sum = 0;
+            for(i=0; i<n; i++)
+                for(j=0; j<n; j++)
+                    sum += src[(y*n + i)*size + x*n + j];
+            dst[y*stride + x] = (sum + (n*n >> 1)) >> (2*lowres);
+        }
+}
+
+/**
+ * Process a macroblock at 1/2^lowres of its size. Only 8 bit 4:2:0 frames
+ * without MBAFF and transform bypass get here.
+ */
+static void av_noinline hl_decode_mb_lowres(H264Context *h){
+    MpegEncContext * const s = &h->s;
+    const int lowres = s->avctx->lowres;
+    const int mb_size = 16 >> lowres;
+    const int mb_xy = h->mb_xy;
+    const int mb_type = s->current_picture.mb_type[mb_xy];
+    const int gray = CONFIG_GRAY && s->flags&CODEC_FLAG_GRAY;
+    const int linesize = s->linesize, uvlinesize = s->uvlinesize;
+    uint8_t *dest_y, *dest_cb, *dest_cr;
+    int sum[64] = { 0 };
+    int i, j;
+
+    dest_y  = s->current_picture.data[0] + (s->mb_x + s->mb_y*linesize  )*mb_size;
+    dest_cb = s->current_picture.data[1] + (s->mb_x + s->mb_y*uvlinesize)*(mb_size >> 1);
+    dest_cr = s->current_picture.data[2] + (s->mb_x + s->mb_y*uvlinesize)*(mb_size >> 1);
+
+    h->list_counts[mb_xy]= h->list_count;
+    h->mb_linesize   = linesize;
+    h->mb_uvlinesize = uvlinesize;
+
+    if(IS_INTRA_PCM(mb_type)){
+        const uint8_t *pcm = (const uint8_t*)h->mb;
+        pcm_lowres(dest_y, linesize, pcm, 16, lowres);
+        if(!gray){
+            pcm_lowres(dest_cb, uvlinesize, pcm + 256, 8, lowres);
+            pcm_lowres(dest_cr, uvlinesize, pcm + 320, 8, lowres);
+        }
+    }else{
+        if(IS_INTRA(mb_type)){
+            if(!gray){
+                pred_lowres(dest_cb, uvlinesize, mb_size >> 1, lowres_pred8x8_mode[h->chroma_pred_mode]);
+                pred_lowres(dest_cr, uvlinesize, mb_size >> 1, lowres_pred8x8_mode[h->chroma_pred_mode]);
+            }
+
+            if(IS_INTRA4x4(mb_type)){
+                /* blocks smaller than 2x2 pixels are predicted by groups of 4 */
+                const int di = IS_8x8DCT(mb_type) || lowres > 1 ? 4 : 1;
+                const int region = 4*(di == 4 ? 2 : 1);
+
+                for(i=0; i<16; i+=di){
+                    const int x = 4*((scan8[i] - scan8[0])&7);
+                    const int y = 4*((scan8[i] - scan8[0])>>3);
+                    uint8_t * const ptr = dest_y + (x >> lowres) + (y >> lowres)*linesize;
+
+                    pred_lowres(ptr, linesize, region >> lowres,
+                                lowres_pred4x4_mode[ h->intra4x4_pred_mode_cache[ scan8[i] ] ]);
+                    if(IS_8x8DCT(mb_type)){
+                        if(h->non_zero_count_cache[ scan8[i] ])
+                            add_residual_sum_lowres(sum, 8, h->mb + i*16, 0, 0, 3, lowres);
+                    }else{
+                        for(j=i; j<i+di; j++)
+                            if(h->non_zero_count_cache[ scan8[j] ] || h->mb[j*16])
+                                add_residual_sum_lowres(sum, region, h->mb + j*16,
+                                                        4*((scan8[j] - scan8[0])&7) - x,
+                                                        4*((scan8[j] - scan8[0])>>3) - y, 2, lowres);
+                    }
+                    put_residual_sum_lowres(ptr, linesize, sum, region, lowres);
+                }
+            }else{
+                pred_lowres(dest_y, linesize, mb_size, lowres_pred8x8_mode[h->intra16x16_pred_mode]);
+                if(h->non_zero_count_cache[ scan8[LUMA_DC_BLOCK_INDEX] ])
+                    h->h264dsp.h264_luma_dc_dequant_idct(h->mb, h->mb_luma_dc[0], h->dequant4_coeff[0][s->qscale][0]);
+            }
+        }else{
+            hl_motion_lowres(h, dest_y, dest_cb, dest_cr);
+        }
+
+        if(!IS_INTRA4x4(mb_type) && (IS_INTRA16x16(mb_type) || (h->cbp&15))){
+            if(IS_8x8DCT(mb_type)){
+                for(i=0; i<16; i+=4)
+                    if(h->non_zero_count_cache[ scan8[i] ])
+                        add_residual_sum_lowres(sum, 16, h->mb + i*16, 4*((scan8[i] - scan8[0])&7),
+                                                4*((scan8[i] - scan8[0])>>3), 3, lowres);
+            }else{
+                for(i=0; i<16; i++)
+                    if(h->non_zero_count_cache[ scan8[i] ] || h->mb[i*16])
+                        add_residual_sum_lowres(sum, 16, h->mb + i*16, 4*((scan8[i] - scan8[0])&7),
+                                                4*((scan8[i] - scan8[0])>>3), 2, lowres);
+            }
+            put_residual_sum_lowres(dest_y, linesize, sum, 16, lowres);
+        }
+
+        if(!gray && (h->cbp&0x30)){
+            uint8_t *dest[2] = {dest_cb, dest_cr};
+
+            if(h->non_zero_count_cache[ scan8[CHROMA_DC_BLOCK_INDEX+0] ])
+                h->h264dsp.h264_chroma_dc_dequant_idct(h->mb + 16*16*1, h->dequant4_coeff[IS_INTRA(mb_type) ? 1:4][h->chroma_qp[0]][0]);
+            if(h->non_zero_count_cache[ scan8[CHROMA_DC_BLOCK_INDEX+1] ])
+                h->h264dsp.h264_chroma_dc_dequant_idct(h->mb + 16*16*2, h->dequant4_coeff[IS_INTRA(mb_type) ? 2:5][h->chroma_qp[1]][0]);
+            for(j=1; j<3; j++){
+                for(i=j*16; i<j*16+4; i++)
+                    if(h->non_zero_count_cache[ scan8[i] ] || h->mb[i*16])
+                        add_residual_sum_lowres(sum, 8, h->mb + i*16, 4*((scan8[i-j*16] - scan8[0])&7),
+                                                4*((scan8[i-j*16] - scan8[0])>>3), 2, lowres);
+                put_residual_sum_lowres(dest[j-1], uvlinesize, sum, 8, lowres);
+            }
+        }
+    }
+
+    if(h->cbp || IS_INTRA(mb_type)){
+        s->dsp.clear_blocks(h->mb);
+        s->dsp.clear_blocks(h->mb+24*16);
+    }
+}
+
 void ff_h264_hl_decode_mb(H264Context *h){
     MpegEncContext * const s = &h->s;
     const int mb_xy= h->mb_xy;
     const int mb_type= s->current_picture.mb_type[mb_xy];
     int is_complex = CONFIG_SMALL || h->is_complex || IS_INTRA_PCM(mb_type) || s->qscale == 0;
 
-    if (CHROMA444) {
+    if (s->avctx->lowres) {
+        hl_decode_mb_lowres(h);
+    } else if (CHROMA444) {
         if(is_complex || h->pixel_shift)
             hl_decode_mb_444_complex(h);
         else
@@ -2233,6 +2827,8 @@ static void idr(H264Context *h){
 static void flush_dpb(AVCodecContext *avctx){
     H264Context *h= avctx->priv_data;
     int i;
+
+    deblock_flush(h);
     for(i=0; i<MAX_DELAYED_PIC_COUNT; i++) {
         if(h->delayed_pic[i])
             h->delayed_pic[i]->reference= 0;
@@ -2362,9 +2958,40 @@ static void init_scan_tables(H264Context *h){
     }
 }
 
+/**
+ * Allocate and initialize the slice thread contexts of the master context.
+ */
+static int init_thread_contexts(H264Context *h){
+    MpegEncContext * const s = &h->s;
+    int i, thread_count = ff_thread_slice_count(s->avctx);
+
+    for(i = 1; i < thread_count; i++) {
+        H264Context *c;
+        c = h->thread_context[i] = av_malloc(sizeof(H264Context));
+        memcpy(c, h->s.thread_context[i], sizeof(MpegEncContext));
+        memset(&c->s + 1, 0, sizeof(H264Context) - sizeof(MpegEncContext));
+        c->h264dsp = h->h264dsp;
+        c->sps = h->sps;
+        c->pps = h->pps;
+        c->pixel_shift = h->pixel_shift;
+        init_scan_tables(c);
+        clone_tables(c, h, i);
+    }
+
+    for(i = 0; i < thread_count; i++)
+        if (context_init(h->thread_context[i]) < 0) {
+            av_log(h->s.avctx, AV_LOG_ERROR, "context_init() failed.\n");
+            return -1;
+        }
+
+    return 0;
+}
+
 static void field_end(H264Context *h, int in_setup){
     MpegEncContext * const s = &h->s;
     AVCodecContext * const avctx= s->avctx;
+
+    deblock_flush(h);
     s->mb_y= 0;
 
     if (!in_setup && !s->dropable)
@@ -2556,6 +3183,12 @@ static int decode_slice_header(H264Context *h, H264Context *h0){
         init_dequant_tables(h);
     }
 
+    if(s->avctx->lowres && (h->sps.bit_depth_luma > 8 || h->sps.chroma_format_idc != 1 ||
+                            !h->sps.frame_mbs_only_flag || h->sps.transform_bypass)){
+        av_log_missing_feature(s->avctx, "Lowres decoding of high bit depth, non 4:2:0, interlaced or lossless H.264 is", 0);
+        return -1;
+    }
+
     s->mb_width= h->sps.mb_width;
     s->mb_height= h->sps.mb_height * (2 - h->sps.frame_mbs_only_flag);
 
@@ -2568,7 +3201,8 @@ static int decode_slice_header(H264Context *h, H264Context *h0){
         s->height= 16*s->mb_height - (4>>CHROMA444)*FFMIN(h->sps.crop_bottom, (8<<CHROMA444)-1);
 
     if (s->context_initialized
-        && (   s->width != s->avctx->width || s->height != s->avctx->height
+        && (   -((-s->width )>>s->avctx->lowres) != s->avctx->width
+            || -((-s->height)>>s->avctx->lowres) != s->avctx->height
             || av_cmp_q(h->sps.sar, s->avctx->sample_aspect_ratio))) {
         if(h != h0) {
             av_log_missing_feature(s->avctx, "Width/height changing with threads is", 0);
@@ -2646,24 +3280,8 @@ static int decode_slice_header(H264Context *h, H264Context *h0){
                 return -1;
             }
         } else {
-            for(i = 1; i < s->avctx->thread_count; i++) {
-                H264Context *c;
-                c = h->thread_context[i] = av_malloc(sizeof(H264Context));
-                memcpy(c, h->s.thread_context[i], sizeof(MpegEncContext));
-                memset(&c->s + 1, 0, sizeof(H264Context) - sizeof(MpegEncContext));
-                c->h264dsp = h->h264dsp;
-                c->sps = h->sps;
-                c->pps = h->pps;
-                c->pixel_shift = h->pixel_shift;
-                init_scan_tables(c);
-                clone_tables(c, h, i);
-            }
-
-            for(i = 0; i < s->avctx->thread_count; i++)
-                if (context_init(h->thread_context[i]) < 0) {
-                    av_log(h->s.avctx, AV_LOG_ERROR, "context_init() failed.\n");
-                    return -1;
-                }
+            if (init_thread_contexts(h) < 0)
+                return -1;
         }
     }
 
@@ -2958,6 +3576,10 @@ static int decode_slice_header(H264Context *h, H264Context *h0){
        ||(s->avctx->skip_loop_filter >= AVDISCARD_NONREF && h->nal_ref_idc == 0))
         h->deblocking_filter= 0;
 
+    /* the filter does not work at reduced size */
+    if(s->avctx->lowres)
+        h->deblocking_filter= 0;
+
     if(h->deblocking_filter == 1 && h0->max_contexts > 1) {
         if(s->avctx->flags2 & CODEC_FLAG2_FAST) {
             /* Cheat slightly for speed:
@@ -3377,7 +3999,301 @@ static void decode_finish_row(H264Context *h){
                              s->picture_structure==PICT_BOTTOM_FIELD);
 }
 
-static int decode_slice(struct AVCodecContext *avctx, void *arg){
+#if HAVE_PTHREADS
+/**
+ * Maximum number of MB rows the decoding may run ahead of the deblocking.
+ * A row is only filtered once the row below it has been decoded, as the
+ * intra prediction of that row needs the unfiltered pixels, so this must be
+ * at least 2.
+ */
+#define DEBLOCK_MAX_LAG 3
+
+typedef struct H264DeblockJob {
+    int mb_y;
+    int start_x, end_x;         ///< MBs to filter, end_x < 0 to finish the row
+    /* state of the slice the MBs belong to */
+    int slice_num;
+    int slice_type;
+    int deblocking_filter;
+    int slice_alpha_c0_offset;
+    int slice_beta_offset;
+    int qp_thresh;
+    int ref2frm[2][64];
+    PPS pps;
+} H264DeblockJob;
+
+typedef struct H264DeblockContext {
+    H264Context *h;             ///< copy of the decoding context made at the start of each picture
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;        ///< signaled whenever one of the fields below changes
+    H264DeblockJob *jobs;       ///< FIFO of pending jobs
+    int first_job, nb_jobs, nb_jobs_max;
+    int busy_row;               ///< row of the job being run, -1 if none
+    int rows_done;              ///< MB rows of the current picture decoded so far
+    int next_mb;                ///< MB following the last queued one, in raster order
+    int flush;                  ///< run the jobs without waiting for the rows below
+    int exit;
+} H264DeblockContext;
+
+static int deblock_job_ready(H264DeblockContext *d, const H264DeblockJob *job)
+{
+    return d->flush || job->end_x < 0 || job->mb_y + 1 < d->rows_done ||
+           d->rows_done >= d->h->s.mb_height;
+}
+
+static void run_deblock_job(H264Context *h, const H264DeblockJob *job)
+{
+    h->s.mb_y = job->mb_y;
+    if (job->end_x < 0) {
+        decode_finish_row(h);
+        return;
+    }
+    h->slice_type            = job->slice_type;
+    h->deblocking_filter     = job->deblocking_filter;
+    h->slice_alpha_c0_offset = job->slice_alpha_c0_offset;
+    h->slice_beta_offset     = job->slice_beta_offset;
+    h->qp_thresh             = job->qp_thresh;
+    h->pps                   = job->pps;
+    memcpy(h->ref2frm[job->slice_num & (MAX_SLICES-1)], job->ref2frm, sizeof(job->ref2frm));
+    loop_filter(h, job->start_x, job->end_x);
+}
+
+static void *deblock_worker(void *arg)
+{
+    H264DeblockContext *d = arg;
+    H264DeblockJob job;
+
+    pthread_mutex_lock(&d->lock);
+    for (;;) {
+        while (!d->exit && !(d->nb_jobs && deblock_job_ready(d, &d->jobs[d->first_job])))
+            pthread_cond_wait(&d->cond, &d->lock);
+        if (!d->nb_jobs)
+            break;
+
+        job = d->jobs[d->first_job];
+        d->first_job = (d->first_job + 1) % d->nb_jobs_max;
+        d->nb_jobs--;
+        d->busy_row = job.mb_y;
+        pthread_mutex_unlock(&d->lock);
+
+        run_deblock_job(d->h, &job);
+
+        pthread_mutex_lock(&d->lock);
+        d->busy_row = -1;
+        pthread_cond_broadcast(&d->cond);
+    }
+    pthread_mutex_unlock(&d->lock);
+
+    return NULL;
+}
+
+/**
+ * Wait until all queued jobs have been run; the loop filter of the
+ * following pictures runs inline again until deblock_start_picture().
+ */
+static void deblock_flush(H264Context *h)
+{
+    H264DeblockContext *d = h->deblock_ctx;
+
+    if (!h->deblock_deferred)
+        return;
+
+    pthread_mutex_lock(&d->lock);
+    d->flush = 1;
+    pthread_cond_broadcast(&d->cond);
+    while (d->nb_jobs || d->busy_row >= 0)
+        pthread_cond_wait(&d->cond, &d->lock);
+    d->flush = 0;
+    pthread_mutex_unlock(&d->lock);
+
+    h->deblock_deferred = 0;
+}
+
+static void deblock_uninit(H264Context *h)
+{
+    H264DeblockContext *d = h->deblock_ctx;
+
+    if (!d)
+        return;
+    deblock_flush(h);
+
+    pthread_mutex_lock(&d->lock);
+    d->exit = 1;
+    pthread_cond_broadcast(&d->cond);
+    pthread_mutex_unlock(&d->lock);
+    pthread_join(d->thread, NULL);
+
+    pthread_mutex_destroy(&d->lock);
+    pthread_cond_destroy(&d->cond);
+    av_free(d->jobs);
+    av_free(d->h);
+    av_freep(&h->deblock_ctx);
+}
+
+static int deblock_init(H264Context *h)
+{
+    H264DeblockContext *d = av_mallocz(sizeof(H264DeblockContext));
+
+    if (!d)
+        return AVERROR(ENOMEM);
+    /* enough for the jobs of the rows the decoding may run ahead, each
+     * with one job per slice and one to finish the row; more are
+     * allocated if rows are left incomplete */
+    d->nb_jobs_max = (DEBLOCK_MAX_LAG + 2) * 4;
+    d->jobs        = av_malloc(d->nb_jobs_max * sizeof(*d->jobs));
+    d->h           = av_malloc(sizeof(H264Context));
+    d->busy_row    = -1;
+    if (!d->jobs || !d->h) {
+        av_free(d->jobs);
+        av_free(d->h);
+        av_free(d);
+        return AVERROR(ENOMEM);
+    }
+    pthread_mutex_init(&d->lock, NULL);
+    pthread_cond_init(&d->cond, NULL);
+    if (pthread_create(&d->thread, NULL, deblock_worker, d)) {
+        pthread_mutex_destroy(&d->lock);
+        pthread_cond_destroy(&d->cond);
+        av_free(d->jobs);
+        av_free(d->h);
+        av_free(d);
+        return -1;
+    }
+    h->deblock_ctx = d;
+    return 0;
+}
+
+/**
+ * Decide whether the loop filter of the picture starting with the current
+ * slice runs on the deblocking thread.
+ */
+static void deblock_start_picture(H264Context *h)
+{
+    MpegEncContext * const s = &h->s;
+    H264DeblockContext *d;
+
+    deblock_flush(h);
+    if (!s->avctx->deblock_thread || s->picture_structure != PICT_FRAME || FRAME_MBAFF ||
+        (s->avctx->active_thread_type & FF_THREAD_SLICE))
+        return;
+    if (!h->deblock_ctx && deblock_init(h) < 0) {
+        av_log(s->avctx, AV_LOG_ERROR, "Cannot start the deblocking thread\n");
+        return;
+    }
+    d = h->deblock_ctx;
+
+    /* the worker is idle */
+    h->deblock_deferred = 1;
+    memcpy(d->h, h, sizeof(H264Context));
+    d->rows_done = 0;
+    d->next_mb   = 0;
+}
+
+/**
+ * @return 0 on success, <0 if the job could not be queued, in which case
+ * the other jobs have been run and the caller has to run it inline
+ */
+static int deblock_queue_job(H264Context *h, const H264DeblockJob *job)
+{
+    H264DeblockContext *d = h->deblock_ctx;
+
+    pthread_mutex_lock(&d->lock);
+    if (d->nb_jobs == d->nb_jobs_max) {
+        int max = d->nb_jobs_max * 2, i;
+        H264DeblockJob *jobs = av_malloc(max * sizeof(*jobs));
+
+        if (!jobs) {
+            pthread_mutex_unlock(&d->lock);
+            deblock_flush(h);
+            return AVERROR(ENOMEM);
+        }
+        for (i = 0; i < d->nb_jobs; i++)
+            jobs[i] = d->jobs[(d->first_job + i) % d->nb_jobs_max];
+        av_free(d->jobs);
+        d->jobs        = jobs;
+        d->first_job   = 0;
+        d->nb_jobs_max = max;
+    }
+    d->jobs[(d->first_job + d->nb_jobs++) % d->nb_jobs_max] = *job;
+    if (job->end_x >= 0)
+        d->next_mb = FFMAX(d->next_mb, job->mb_y * h->s.mb_width + job->end_x);
+    else
+        d->rows_done = FFMAX(d->rows_done, job->mb_y + 1);
+    pthread_cond_broadcast(&d->cond);
+
+    /* keep the decoding from running too far ahead */
+    while (d->nb_jobs && d->jobs[d->first_job].mb_y + DEBLOCK_MAX_LAG < d->rows_done)
+        pthread_cond_wait(&d->cond, &d->lock);
+    pthread_mutex_unlock(&d->lock);
+    return 0;
+}
+
+/**
+ * Called at the start of every slice but the first one of a picture.
+ */
+static void deblock_start_slice(H264Context *h)
+{
+    H264DeblockContext *d = h->deblock_ctx;
+
+    /* The slice overwrites MBs which have been queued already, but must be
+     * filtered as they were decoded; finish them and filter the rest of
+     * the picture inline. */
+    if (h->deblock_deferred && h->s.mb_y * h->s.mb_width + h->s.mb_x < d->next_mb)
+        deblock_flush(h);
+}
+#else
+static void deblock_flush(H264Context *h) {}
+static void deblock_uninit(H264Context *h) {}
+static void deblock_start_picture(H264Context *h) {}
+static void deblock_start_slice(H264Context *h) {}
+#endif
+
+/**
+ * Filter the MBs start_x to end_x-1 of the current row, or queue them for
+ * the deblocking thread.
+ */
+static void queue_loop_filter(H264Context *h, int start_x, int end_x){
+#if HAVE_PTHREADS
+    if (h->deblock_deferred) {
+        H264DeblockJob job;
+
+        job.mb_y                  = h->s.mb_y;
+        job.start_x               = start_x;
+        job.end_x                 = end_x;
+        job.slice_num             = h->slice_num;
+        job.slice_type            = h->slice_type;
+        job.deblocking_filter     = h->deblocking_filter;
+        job.slice_alpha_c0_offset = h->slice_alpha_c0_offset;
+        job.slice_beta_offset     = h->slice_beta_offset;
+        job.qp_thresh             = h->qp_thresh;
+        job.pps                   = h->pps;
+        memcpy(job.ref2frm, h->ref2frm[h->slice_num & (MAX_SLICES-1)], sizeof(job.ref2frm));
+        if (deblock_queue_job(h, &job) >= 0)
+            return;
+    }
+#endif
+    loop_filter(h, start_x, end_x);
+}
+
+/**
+ * Finish the current row, or queue it for the deblocking thread.
+ */
+static void queue_finish_row(H264Context *h){
+#if HAVE_PTHREADS
+    if (h->deblock_deferred) {
+        H264DeblockJob job;
+
+        job.mb_y  = h->s.mb_y;
+        job.end_x = -1;
+        if (deblock_queue_job(h, &job) >= 0)
+            return;
+    }
+#endif
+    decode_finish_row(h);
+}
+
+static int decode_slice_internal(struct AVCodecContext *avctx, void *arg){
     H264Context *h = *(void**)arg;
     MpegEncContext * const s = &h->s;
     const int part_mask= s->partitioned_frame ? (AC_END|AC_ERROR) : 0x7F;
@@ -3385,6 +4301,11 @@ static int decode_slice(struct AVCodecContext *avctx, void *arg){
 
     s->mb_skip_run= -1;
 
+    if (h->slice_num == 1)
+        deblock_start_picture(h);
+    else
+        deblock_start_slice(h);
+
     h->is_complex = FRAME_MBAFF || s->picture_structure != PICT_FRAME || s->codec_id != CODEC_ID_H264 ||
                     (CONFIG_GRAY && (s->flags&CODEC_FLAG_GRAY));
 
@@ -3420,19 +4341,19 @@ static int decode_slice(struct AVCodecContext *avctx, void *arg){
 
             if((s->workaround_bugs & FF_BUG_TRUNCATED) && h->cabac.bytestream > h->cabac.bytestream_end + 2){
                 ff_er_add_slice(s, s->resync_mb_x, s->resync_mb_y, s->mb_x-1, s->mb_y, (AC_END|DC_END|MV_END)&part_mask);
-                if (s->mb_x >= lf_x_start) loop_filter(h, lf_x_start, s->mb_x + 1);
+                if (s->mb_x >= lf_x_start) queue_loop_filter(h, lf_x_start, s->mb_x + 1);
                 return 0;
             }
             if( ret < 0 || h->cabac.bytestream > h->cabac.bytestream_end + 2) {
-                av_log(h->s.avctx, AV_LOG_ERROR, "error while decoding MB %d %d, bytestream (%td)\n", s->mb_x, s->mb_y, h->cabac.bytestream_end - h->cabac.bytestream);
+                av_log_ratelimited(h->s.avctx, AV_LOG_ERROR, "error while decoding MB %d %d, bytestream (%td)\n", s->mb_x, s->mb_y, h->cabac.bytestream_end - h->cabac.bytestream);
                 ff_er_add_slice(s, s->resync_mb_x, s->resync_mb_y, s->mb_x, s->mb_y, (AC_ERROR|DC_ERROR|MV_ERROR)&part_mask);
                 return -1;
             }
 
             if( ++s->mb_x >= s->mb_width ) {
-                loop_filter(h, lf_x_start, s->mb_x);
+                queue_loop_filter(h, lf_x_start, s->mb_x);
                 s->mb_x = lf_x_start = 0;
-                decode_finish_row(h);
+                queue_finish_row(h);
                 ++s->mb_y;
                 if(FIELD_OR_MBAFF_PICTURE) {
                     ++s->mb_y;
@@ -3444,7 +4365,7 @@ static int decode_slice(struct AVCodecContext *avctx, void *arg){
             if( eos || s->mb_y >= s->mb_height ) {
                 tprintf(s->avctx, "slice end %d %d\n", get_bits_count(&s->gb), s->gb.size_in_bits);
                 ff_er_add_slice(s, s->resync_mb_x, s->resync_mb_y, s->mb_x-1, s->mb_y, (AC_END|DC_END|MV_END)&part_mask);
-                if (s->mb_x > lf_x_start) loop_filter(h, lf_x_start, s->mb_x);
+                if (s->mb_x > lf_x_start) queue_loop_filter(h, lf_x_start, s->mb_x);
                 return 0;
             }
         }
@@ -3464,15 +4385,15 @@ static int decode_slice(struct AVCodecContext *avctx, void *arg){
             }
 
             if(ret<0){
-                av_log(h->s.avctx, AV_LOG_ERROR, "error while decoding MB %d %d\n", s->mb_x, s->mb_y);
+                av_log_ratelimited(h->s.avctx, AV_LOG_ERROR, "error while decoding MB %d %d\n", s->mb_x, s->mb_y);
                 ff_er_add_slice(s, s->resync_mb_x, s->resync_mb_y, s->mb_x, s->mb_y, (AC_ERROR|DC_ERROR|MV_ERROR)&part_mask);
                 return -1;
             }
 
             if(++s->mb_x >= s->mb_width){
-                loop_filter(h, lf_x_start, s->mb_x);
+                queue_loop_filter(h, lf_x_start, s->mb_x);
                 s->mb_x = lf_x_start = 0;
-                decode_finish_row(h);
+                queue_finish_row(h);
                 ++s->mb_y;
                 if(FIELD_OR_MBAFF_PICTURE) {
                     ++s->mb_y;
@@ -3499,7 +4420,7 @@ static int decode_slice(struct AVCodecContext *avctx, void *arg){
                 tprintf(s->avctx, "slice end %d %d\n", get_bits_count(&s->gb), s->gb.size_in_bits);
                 if(get_bits_count(&s->gb) == s->gb.size_in_bits ){
                     ff_er_add_slice(s, s->resync_mb_x, s->resync_mb_y, s->mb_x-1, s->mb_y, (AC_END|DC_END|MV_END)&part_mask);
-                    if (s->mb_x > lf_x_start) loop_filter(h, lf_x_start, s->mb_x);
+                    if (s->mb_x > lf_x_start) queue_loop_filter(h, lf_x_start, s->mb_x);
 
                     return 0;
                 }else{
@@ -3519,7 +4440,7 @@ static int decode_slice(struct AVCodecContext *avctx, void *arg){
             ff_h264_hl_decode_mb(h);
 
             if(ret<0){
-                av_log(s->avctx, AV_LOG_ERROR, "error while decoding MB %d %d\n", s->mb_x, s->mb_y);
+                av_log_ratelimited(s->avctx, AV_LOG_ERROR, "error while decoding MB %d %d\n", s->mb_x, s->mb_y);
                 ff_er_add_slice(s, s->resync_mb_x, s->resync_mb_y, s->mb_x, s->mb_y, (AC_ERROR|DC_ERROR|MV_ERROR)&part_mask);
 
                 return -1;
@@ -3559,6 +4480,149 @@ static int decode_slice(struct AVCodecContext *avctx, void *arg){
     return -1; //not reached
 }
 
+static int decode_slice(struct AVCodecContext *avctx, void *arg){
+    int ret;
+    AV_PROFILE_START(decode_slice);
+    ret = decode_slice_internal(avctx, arg);
+    AV_PROFILE_STOP(decode_slice, "h264_decode_slice");
+    return ret;
+}
+
+/**
+ * Check whether the picture started by a non-IDR slice is dropped entirely
+ * with skip_frame >= AVDISCARD_NONKEY, before any picture is allocated.
+ * The frame number and POC state are updated as decoding the picture would,
+ * so that neither frame num gaps nor wrong POCs appear at the next picture
+ * which is decoded. Reference pictures with an MMCO reset are decoded, as
+ * they restart the frame number and POC.
+ *
+ * @param hx context holding the slice NAL
+ * @return 1 if the picture is skipped, 0 if it has to be decoded
+ */
+static int skip_non_key_picture(H264Context *h, H264Context *hx){
+    MpegEncContext * const s = &h->s;
+    GetBitContext gb = hx->s.gb;
+    unsigned int slice_type, pps_id;
+    int frame_num, poc_lsb = 0, max_frame_num, field_pic = 0;
+    PPS *pps;
+    SPS *sps;
+
+    get_ue_golomb(&gb); // first_mb_in_slice
+    slice_type = get_ue_golomb_31(&gb);
+    if (slice_type > 9)
+        return 0;
+    slice_type = golomb_to_pict_type[slice_type % 5];
+    if (slice_type == AV_PICTURE_TYPE_I || slice_type == AV_PICTURE_TYPE_SI)
+        return 0;
+
+    pps_id = get_ue_golomb(&gb);
+    if (pps_id >= MAX_PPS_COUNT || !(pps = h->pps_buffers[pps_id]) ||
+        !(sps = h->sps_buffers[pps->sps_id]))
+        return 0;
+    /* nothing to keep track of before the first decoded picture, or if the
+     * slice would activate another SPS */
+    if (!s->context_initialized || pps->sps_id != h->pps.sps_id)
+        return 1;
+
+    frame_num = get_bits(&gb, sps->log2_max_frame_num);
+    if (!sps->frame_mbs_only_flag && (field_pic = get_bits1(&gb)))
+        get_bits1(&gb); // bottom_field_flag
+    if (sps->poc_type == 0)
+        poc_lsb = get_bits(&gb, sps->log2_max_poc_lsb);
+
+    if (hx->nal_ref_idc) {
+        int ref_count[2] = { pps->ref_count[0], pps->ref_count[1] };
+        int list, list_count = slice_type == AV_PICTURE_TYPE_B ? 2 : 1;
+        int i, j;
+
+        /* skip the rest of the slice header up to dec_ref_pic_marking() */
+        if (sps->poc_type == 0 && pps->pic_order_present && !field_pic)
+            get_se_golomb(&gb); // delta_pic_order_cnt_bottom
+        if (sps->poc_type == 1 && !sps->delta_pic_order_always_zero_flag) {
+            get_se_golomb(&gb); // delta_pic_order_cnt[0]
+            if (pps->pic_order_present && !field_pic)
+                get_se_golomb(&gb); // delta_pic_order_cnt[1]
+        }
+        if (pps->redundant_pic_cnt_present)
+            get_ue_golomb(&gb);
+        if (slice_type == AV_PICTURE_TYPE_B)
+            get_bits1(&gb); // direct_spatial_mv_pred_flag
+        if (get_bits1(&gb)) { // num_ref_idx_active_override_flag
+            for (list = 0; list < list_count; list++)
+                ref_count[list] = get_ue_golomb(&gb) + 1;
+            if (ref_count[0] - 1U > 31 || ref_count[1] - 1U > 31)
+                return 0;
+        }
+        for (list = 0; list < list_count; list++) {
+            if (!get_bits1(&gb)) // ref_pic_list_modification_flag
+                continue;
+            for (i = 0; ; i++) {
+                unsigned int idc = get_ue_golomb_31(&gb);
+                if (idc == 3)
+                    break;
+                if (idc > 3 || i >= ref_count[list])
+                    return 0;
+                get_ue_golomb(&gb);
+            }
+        }
+        if ((pps->weighted_pred && (slice_type == AV_PICTURE_TYPE_P ||
+                                    slice_type == AV_PICTURE_TYPE_SP)) ||
+            (pps->weighted_bipred_idc == 1 && slice_type == AV_PICTURE_TYPE_B)) {
+            get_ue_golomb(&gb); // luma_log2_weight_denom
+            if (sps->chroma_format_idc)
+                get_ue_golomb(&gb);
+            for (list = 0; list < list_count; list++) {
+                for (i = 0; i < ref_count[list]; i++) {
+                    if (get_bits1(&gb)) {
+                        get_se_golomb(&gb);
+                        get_se_golomb(&gb);
+                    }
+                    if (sps->chroma_format_idc && get_bits1(&gb))
+                        for (j = 0; j < 4; j++)
+                            get_se_golomb(&gb);
+                }
+            }
+        }
+
+        /* dec_ref_pic_marking() */
+        if (get_bits1(&gb)) { // adaptive_ref_pic_marking_mode_flag
+            for (i = 0; i < MAX_MMCO_COUNT; i++) {
+                MMCOOpcode opcode = get_ue_golomb_31(&gb);
+                if (opcode == MMCO_END)
+                    break;
+                if (opcode == MMCO_RESET || opcode > MMCO_LONG)
+                    return 0;
+                if (opcode == MMCO_SHORT2UNUSED || opcode == MMCO_SHORT2LONG)
+                    get_ue_golomb(&gb); // difference_of_pic_nums_minus1
+                if (opcode == MMCO_LONG2UNUSED)
+                    get_ue_golomb_31(&gb); // long_term_pic_num
+                if (opcode == MMCO_SHORT2LONG || opcode == MMCO_LONG ||
+                    opcode == MMCO_SET_MAX_LONG)
+                    get_ue_golomb_31(&gb); // long_term_frame_idx
+            }
+        }
+    }
+
+    max_frame_num = 1 << sps->log2_max_frame_num;
+    h->frame_num_offset = h->prev_frame_num_offset;
+    if (frame_num < h->prev_frame_num)
+        h->frame_num_offset += max_frame_num;
+
+    if (sps->poc_type == 0 && hx->nal_ref_idc) {
+        const int max_poc_lsb = 1 << sps->log2_max_poc_lsb;
+
+        if     (poc_lsb < h->prev_poc_lsb && h->prev_poc_lsb - poc_lsb >= max_poc_lsb/2)
+            h->prev_poc_msb += max_poc_lsb;
+        else if(poc_lsb > h->prev_poc_lsb && h->prev_poc_lsb - poc_lsb < -max_poc_lsb/2)
+            h->prev_poc_msb -= max_poc_lsb;
+        h->prev_poc_lsb = poc_lsb;
+    }
+    h->prev_frame_num_offset = h->frame_num_offset;
+    h->prev_frame_num        = frame_num;
+
+    return 1;
+}
+
 /**
  * Call decode_slice() for each context.
  *
@@ -3611,7 +4675,7 @@ static int decode_nal_units(H264Context *h, const uint8_t *buf, int buf_size){
     int nals_needed=0; ///< number of NALs that need decoding before the next frame thread starts
     int nal_index;
 
-    h->max_contexts = (HAVE_THREADS && (s->avctx->active_thread_type&FF_THREAD_SLICE)) ? avctx->thread_count : 1;
+    h->max_contexts = HAVE_THREADS ? ff_thread_slice_count(avctx) : 1;
     if(!(s->flags2 & CODEC_FLAG2_CHUNKS)){
         h->current_slice = 0;
         if (!s->first_field)
@@ -3717,6 +4781,10 @@ static int decode_nal_units(H264Context *h, const uint8_t *buf, int buf_size){
             hx->inter_gb_ptr= &hx->s.gb;
             hx->s.data_partitioning = 0;
 
+            if (hx->nal_unit_type == NAL_SLICE && avctx->skip_frame >= AVDISCARD_NONKEY &&
+                !h->current_slice && !s->first_field && skip_non_key_picture(h, hx))
+                break;
+
             if((err = decode_slice_header(hx, h)))
                break;
 
@@ -3872,6 +4940,9 @@ static int decode_frame(AVCodecContext *avctx,
 
     s->flags= avctx->flags;
     s->flags2= avctx->flags2;
+    /* the edges are not drawn at reduced size, MC emulates them instead */
+    if(avctx->lowres)
+        s->flags |= CODEC_FLAG_EMU_EDGE;
 
    /* end of stream, output what is still in the buffers */
  out:
@@ -4192,6 +5263,7 @@ AVCodec ff_h264_decoder = {
         CODEC_CAP_SLICE_THREADS | CODEC_CAP_FRAME_THREADS,
     .flush= flush_dpb,
     .long_name = NULL_IF_CONFIG_SMALL("H.264 / AVC / MPEG-4 AVC / MPEG-4 part 10"),
+    .max_lowres = 3,
     .init_thread_copy      = ONLY_IF_THREADS_ENABLED(decode_init_thread_copy),
     .update_thread_context = ONLY_IF_THREADS_ENABLED(decode_update_thread_context),
     .profiles = NULL_IF_CONFIG_SMALL(profiles),
@@ -36,9 +36,6 @@
 #include "golomb.h"
 
 #include "cabac.h"
-#if ARCH_X86
-#include "x86/h264_i386.h"
-#endif
 
 //#undef NDEBUG
 #include <assert.h>
@@ -1565,6 +1562,11 @@ DECLARE_ASM_CONST(1, uint8_t, last_coeff_flag_offset_8x8)[63] = {
     5, 5, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7, 8, 8, 8
 };
 
+/* after last_coeff_flag_offset_8x8, which the x86-64 PIC asm refers to */
+#if ARCH_X86
+#include "x86/h264_i386.h"
+#endif
+
 static av_always_inline void decode_cabac_residual_internal( H264Context *h, DCTELEM *block, int cat, int n, const uint8_t *scantable, const uint32_t *qmul, int max_coeff, int is_dc ) {
     static const int significant_coeff_flag_offset[2][14] = {
       { 105+0, 105+15, 105+29, 105+44, 105+47, 402, 484+0, 484+15, 484+29, 660, 528+0, 528+15, 528+29, 718 },
@@ -1647,7 +1649,7 @@ static av_always_inline void decode_cabac_residual_internal( H264Context *h, DCT
             index[coeff_count++] = last;\
         }
         const uint8_t *sig_off = significant_coeff_flag_offset_8x8[MB_FIELD];
-#if ARCH_X86 && HAVE_7REGS && HAVE_EBX_AVAILABLE && !defined(BROKEN_RELOCATIONS) && HAVE_TEN_OPERANDS
+#if ARCH_X86 && HAVE_7REGS && HAVE_EBX_AVAILABLE && HAVE_TEN_OPERANDS
         coeff_count= decode_significance_8x8_x86(CC, significant_coeff_ctx_base, index,
                                                  last_coeff_ctx_base-significant_coeff_ctx_base, sig_off);
     } else {
@@ -0,0 +1,51 @@
+/*
+ * Generate a header file for hardcoded H.264 CAVLC VLC tables
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+/* get_bits.h includes config.h, which enables the hardcoded tables that
+ * this program generates */
+#include "config.h"
+#undef CONFIG_HARDCODED_TABLES
+#define CONFIG_HARDCODED_TABLES 0
+#include "vlc_tablegen.h"
+#include "h264_cavlc_tablegen.h"
+
+int main(void)
+{
+    h264_cavlc_tableinit();
+
+    write_fileheader();
+
+    WRITE_VLC_TABLE("static const", coeff_token_vlc_tables);
+    WRITE_VLC_TABLE("static const", chroma_dc_coeff_token_vlc_table);
+    WRITE_VLC_TABLE("static const", total_zeros_vlc_tables);
+    WRITE_VLC_TABLE("static const", chroma_dc_total_zeros_vlc_tables);
+    WRITE_VLC_TABLE("static const", run_vlc_tables);
+    WRITE_VLC_TABLE("static const", run7_vlc_table);
+
+    WRITE_VLC_ARRAY("static", coeff_token_vlc, coeff_token_vlc_tables);
+    WRITE_VLC      ("static", chroma_dc_coeff_token_vlc, chroma_dc_coeff_token_vlc_table);
+    WRITE_VLC_ARRAY("static", total_zeros_vlc, total_zeros_vlc_tables);
+    WRITE_VLC_ARRAY("static", chroma_dc_total_zeros_vlc, chroma_dc_total_zeros_vlc_tables);
+    WRITE_VLC_ARRAY("static", run_vlc, run_vlc_tables);
+    WRITE_VLC      ("static", run7_vlc, run7_vlc_table);
+
+    return 0;
+}
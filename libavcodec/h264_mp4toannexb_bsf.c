@@ -21,6 +21,7 @@
 
 #include "libavutil/intreadwrite.h"
 #include "avcodec.h"
+#include "internal.h"
 
 typedef struct H264BSFContext {
     uint8_t  length_size;
@@ -28,29 +29,70 @@ typedef struct H264BSFContext {
     int      extradata_parsed;
 } H264BSFContext;
 
-static int alloc_and_copy(uint8_t **poutbuf,          int *poutbuf_size,
-                          const uint8_t *sps_pps, uint32_t sps_pps_size,
-                          const uint8_t *in,      uint32_t in_size) {
-    uint32_t offset = *poutbuf_size;
-    uint8_t nal_header_size = offset ? 3 : 4;
-    void *tmp;
-
-    *poutbuf_size += sps_pps_size+in_size+nal_header_size;
-    tmp = av_realloc(*poutbuf, *poutbuf_size);
-    if (!tmp)
-        return AVERROR(ENOMEM);
-    *poutbuf = tmp;
-    if (sps_pps)
-        memcpy(*poutbuf+offset, sps_pps, sps_pps_size);
-    memcpy(*poutbuf+sps_pps_size+nal_header_size+offset, in, in_size);
-    if (!offset) {
-        AV_WB32(*poutbuf+sps_pps_size, 1);
-    } else {
-        (*poutbuf+offset+sps_pps_size)[0] = (*poutbuf+offset+sps_pps_size)[1] = 0;
-        (*poutbuf+offset+sps_pps_size)[2] = 1;
-    }
+/**
+ * Convert the NAL units of buf to Annex B, prepending sps and pps to the
+ * first IDR picture. With out NULL, only compute the size of the output.
+ * @return the size of the output, a negative error code if buf is invalid
+ */
+static int convert_nal_units(H264BSFContext *ctx, AVCodecContext *avctx,
+                             uint8_t *out, const uint8_t *buf, int buf_size)
+{
+    const uint8_t *buf_end = buf + buf_size;
+    uint8_t first_idr = ctx->first_idr;
+    uint32_t cumul_size = 0;
+    int64_t out_size = 0;
+
+    do {
+        uint8_t unit_type, nal_header_size;
+        uint32_t sps_pps_size = 0;
+        int32_t nal_size;
+
+        if (buf + ctx->length_size > buf_end)
+            return AVERROR(EINVAL);
+
+        if (ctx->length_size == 1) {
+            nal_size = buf[0];
+        } else if (ctx->length_size == 2) {
+            nal_size = AV_RB16(buf);
+        } else
+            nal_size = AV_RB32(buf);
 
-    return 0;
+        buf += ctx->length_size;
+        unit_type = *buf & 0x1f;
+
+        if (buf + nal_size > buf_end || nal_size < 0)
+            return AVERROR(EINVAL);
+
+        /* prepend only to the first type 5 NAL unit of an IDR picture */
+        if (first_idr && unit_type == 5) {
+            sps_pps_size = avctx->extradata_size;
+            first_idr    = 0;
+        } else if (!first_idr && unit_type == 1)
+            first_idr = 1;
+
+        nal_header_size = out_size ? 3 : 4;
+        if (out) {
+            uint8_t *p = out + out_size;
+            if (sps_pps_size)
+                memcpy(p, avctx->extradata, sps_pps_size);
+            p += sps_pps_size;
+            if (nal_header_size == 4)
+                AV_WB32(p, 1);
+            else
+                AV_WB24(p, 1);
+            memcpy(p + nal_header_size, buf, nal_size);
+        }
+        out_size += sps_pps_size + nal_header_size + nal_size;
+        if (out_size > INT_MAX - FF_INPUT_BUFFER_PADDING_SIZE)
+            return AVERROR(EINVAL);
+
+        buf += nal_size;
+        cumul_size += nal_size + ctx->length_size;
+    } while (cumul_size < buf_size);
+
+    if (out)
+        ctx->first_idr = first_idr;
+    return out_size;
 }
 
 static int h264_mp4toannexb_filter(AVBitStreamFilterContext *bsfc,
@@ -59,10 +101,8 @@ static int h264_mp4toannexb_filter(AVBitStreamFilterContext *bsfc,
                                    const uint8_t *buf, int      buf_size,
                                    int keyframe) {
     H264BSFContext *ctx = bsfc->priv_data;
-    uint8_t unit_type;
-    int32_t nal_size;
-    uint32_t cumul_size = 0;
-    const uint8_t *buf_end = buf + buf_size;
+    uint8_t *out;
+    int size;
 
     /* nothing to filter */
     if (!avctx->extradata || avctx->extradata_size < 6) {
@@ -134,56 +174,75 @@ pps:
         ctx->extradata_parsed = 1;
     }
 
-    *poutbuf_size = 0;
-    *poutbuf = NULL;
-    do {
-        if (buf + ctx->length_size > buf_end)
-            goto fail;
+    /* size the output first, so that it is allocated only once */
+    if ((size = convert_nal_units(ctx, avctx, NULL, buf, buf_size)) < 0)
+        goto fail;
+    if (!(out = ff_bsf_get_buffer(bsfc, size))) {
+        size = AVERROR(ENOMEM);
+        goto fail;
+    }
+    convert_nal_units(ctx, avctx, out, buf, buf_size);
 
-        if (ctx->length_size == 1) {
-            nal_size = buf[0];
-        } else if (ctx->length_size == 2) {
-            nal_size = AV_RB16(buf);
-        } else
-            nal_size = AV_RB32(buf);
+    *poutbuf      = out;
+    *poutbuf_size = size;
+    return 1;
 
-        buf += ctx->length_size;
-        unit_type = *buf & 0x1f;
+fail:
+    *poutbuf      = NULL;
+    *poutbuf_size = 0;
+    return size;
+}
 
-        if (buf + nal_size > buf_end || nal_size < 0)
-            goto fail;
+/* With 4 byte lengths, each length field can be overwritten by a start
+ * code. The sps and pps in front of an IDR picture do not fit, such
+ * packets go through h264_mp4toannexb_filter(). */
+static int h264_mp4toannexb_filter_inplace(AVBitStreamFilterContext *bsfc,
+                                           AVCodecContext *avctx, const char *args,
+                                           uint8_t *buf, int buf_size,
+                                           int keyframe)
+{
+    H264BSFContext *ctx = bsfc->priv_data;
+    uint8_t *p = buf, *buf_end = buf + buf_size;
+    uint8_t first_idr = ctx->first_idr;
+    uint32_t nal_size;
 
-        /* prepend only to the first type 5 NAL unit of an IDR picture */
-        if (ctx->first_idr && unit_type == 5) {
-            if (alloc_and_copy(poutbuf, poutbuf_size,
-                               avctx->extradata, avctx->extradata_size,
-                               buf, nal_size) < 0)
-                goto fail;
-            ctx->first_idr = 0;
-        } else {
-            if (alloc_and_copy(poutbuf, poutbuf_size,
-                               NULL, 0,
-                               buf, nal_size) < 0)
-                goto fail;
-            if (!ctx->first_idr && unit_type == 1)
-                ctx->first_idr = 1;
-        }
+    /* nothing to filter */
+    if (!avctx->extradata || avctx->extradata_size < 6)
+        return 1;
 
-        buf += nal_size;
-        cumul_size += nal_size + ctx->length_size;
-    } while (cumul_size < buf_size);
+    if (!ctx->extradata_parsed || ctx->length_size != 4 || !buf_size)
+        return 0;
 
+    do {
+        uint8_t unit_type;
+
+        if (buf_end - p < 4)
+            return 0;
+        nal_size = AV_RB32(p);
+        p += 4;
+        if (nal_size > buf_end - p)
+            return 0;
+        unit_type = *p & 0x1f;
+
+        if (first_idr && unit_type == 5)
+            return 0;
+        if (!first_idr && unit_type == 1)
+            first_idr = 1;
+        p += nal_size;
+    } while (p < buf_end);
+
+    for (p = buf; p < buf_end; p += 4 + nal_size) {
+        nal_size = AV_RB32(p);
+        AV_WB32(p, 1);
+    }
+    ctx->first_idr = first_idr;
     return 1;
-
-fail:
-    av_freep(poutbuf);
-    *poutbuf_size = 0;
-    return AVERROR(EINVAL);
 }
 
 AVBitStreamFilter ff_h264_mp4toannexb_bsf = {
     "h264_mp4toannexb",
     sizeof(H264BSFContext),
     h264_mp4toannexb_filter,
+    .filter_inplace = h264_mp4toannexb_filter_inplace,
 };
 
@@ -28,6 +28,7 @@
 #include "parser.h"
 #include "h264data.h"
 #include "golomb.h"
+#include "startcode.h"
 
 #include <assert.h>
 
@@ -45,23 +46,12 @@ static int ff_h264_find_frame_end(H264Context *h, const uint8_t *buf, int buf_si
 
     for(i=0; i<buf_size; i++){
         if(state==7){
-#if HAVE_FAST_UNALIGNED
-        /* we check i<buf_size instead of i+3/7 because its simpler
-         * and there should be FF_INPUT_BUFFER_PADDING_SIZE bytes at the end
-         */
-#    if HAVE_FAST_64BIT
-            while(i<buf_size && !((~*(const uint64_t*)(buf+i) & (*(const uint64_t*)(buf+i) - 0x0101010101010101ULL)) & 0x8080808080808080ULL))
-                i+=8;
-#    else
-            while(i<buf_size && !((~*(const uint32_t*)(buf+i) & (*(const uint32_t*)(buf+i) - 0x01010101U)) & 0x80808080U))
-                i+=4;
-#    endif
-#endif
-            for(; i<buf_size; i++){
-                if(!buf[i]){
-                    state=2;
-                    break;
-                }
+            i+= ff_startcode_find_zero_pair(buf+i, buf_size-i);
+            if(i<buf_size){
+                state=2;
+            }else if(!buf[buf_size-1]){
+                i=buf_size-1;
+                state=2;
             }
         }else if(state<=2){
             if(buf[i]==1)   state^= 5; //2->7, 1->4, 0->5
@@ -28,6 +28,7 @@
  * huffyuv codec for libavcodec.
  */
 
+#define BITSTREAM_WRITER_64
 #include "avcodec.h"
 #include "get_bits.h"
 #include "put_bits.h"
@@ -777,27 +778,37 @@ static int encode_422_bitstream(HYuvContext *s, int offset, int count){
     }
     if(s->avctx->flags2&CODEC_FLAG2_NO_OUTPUT)
         return 0;
+/* Write two codes with a single put_bits64() when they fit in the bit buffer,
+ * which they nearly always do. */
+#define PUT2(plane0, a, plane1, b)\
+            {\
+                int len0 = s->len[plane0][a], len1 = s->len[plane1][b];\
+                if(len0 + len1 < BIT_BUF_SIZE){\
+                    put_bits64(&s->pb, len0 + len1, ((uint64_t)s->bits[plane0][a] << len1) | s->bits[plane1][b]);\
+                }else{\
+                    put_bits(&s->pb, len0, s->bits[plane0][a]);\
+                    put_bits(&s->pb, len1, s->bits[plane1][b]);\
+                }\
+            }
+
     if(s->context){
         for(i=0; i<count; i++){
             LOAD4;
             s->stats[0][y0]++;
-            put_bits(&s->pb, s->len[0][y0], s->bits[0][y0]);
             s->stats[1][u0]++;
-            put_bits(&s->pb, s->len[1][u0], s->bits[1][u0]);
             s->stats[0][y1]++;
-            put_bits(&s->pb, s->len[0][y1], s->bits[0][y1]);
             s->stats[2][v0]++;
-            put_bits(&s->pb, s->len[2][v0], s->bits[2][v0]);
+            PUT2(0, y0, 1, u0);
+            PUT2(0, y1, 2, v0);
         }
     }else{
         for(i=0; i<count; i++){
             LOAD4;
-            put_bits(&s->pb, s->len[0][y0], s->bits[0][y0]);
-            put_bits(&s->pb, s->len[1][u0], s->bits[1][u0]);
-            put_bits(&s->pb, s->len[0][y1], s->bits[0][y1]);
-            put_bits(&s->pb, s->len[2][v0], s->bits[2][v0]);
+            PUT2(0, y0, 1, u0);
+            PUT2(0, y1, 2, v0);
         }
     }
+#undef PUT2
     return 0;
 }
 
@@ -1478,6 +1489,7 @@ AVCodec ff_huffyuv_encoder = {
     encode_frame,
     encode_end,
     .pix_fmts= (const enum PixelFormat[]){PIX_FMT_YUV422P, PIX_FMT_RGB32, PIX_FMT_NONE},
+    .capabilities = CODEC_CAP_FRAME_THREADS,
     .long_name = NULL_IF_CONFIG_SMALL("Huffyuv / HuffYUV"),
 };
 #endif
@@ -1492,6 +1504,7 @@ AVCodec ff_ffvhuff_encoder = {
     encode_frame,
     encode_end,
     .pix_fmts= (const enum PixelFormat[]){PIX_FMT_YUV420P, PIX_FMT_YUV422P, PIX_FMT_RGB32, PIX_FMT_NONE},
+    .capabilities = CODEC_CAP_FRAME_THREADS,
     .long_name = NULL_IF_CONFIG_SMALL("Huffyuv FFmpeg variant"),
 };
 #endif
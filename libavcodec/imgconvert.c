@@ -37,6 +37,7 @@
 #include "libavutil/colorspace.h"
 #include "libavutil/pixdesc.h"
 #include "libavutil/imgutils.h"
+#include "libavutil/cpu.h"
 
 #if HAVE_MMX && HAVE_YASM
 #include "x86/dsputil_mmx.h"
@@ -54,14 +55,6 @@
 #define FF_PIXEL_PACKED   1 /**< only one components containing all the channels */
 #define FF_PIXEL_PALETTE  2  /**< one components containing indexes for a palette */
 
-#if HAVE_MMX && HAVE_YASM
-#define deinterlace_line_inplace ff_deinterlace_line_inplace_mmx
-#define deinterlace_line         ff_deinterlace_line_mmx
-#else
-#define deinterlace_line_inplace deinterlace_line_inplace_c
-#define deinterlace_line         deinterlace_line_c
-#endif
-
 typedef struct PixFmtInfo {
     uint8_t nb_channels;     /**< number of channels (including alpha) */
     uint8_t color_type;      /**< color type (see FF_COLOR_xxx constants) */
@@ -920,7 +913,14 @@ int img_get_alpha_info(const AVPicture *src,
     return ret;
 }
 
-#if !(HAVE_MMX && HAVE_YASM)
+typedef void (*DeinterlaceLineFunc)(uint8_t *dst,
+                                    const uint8_t *lum_m4, const uint8_t *lum_m3,
+                                    const uint8_t *lum_m2, const uint8_t *lum_m1,
+                                    const uint8_t *lum, int size);
+typedef void (*DeinterlaceLineInplaceFunc)(uint8_t *lum_m4, const uint8_t *lum_m3,
+                                           uint8_t *lum_m2, const uint8_t *lum_m1,
+                                           const uint8_t *lum, int size);
+
 /* filter parameters: [-1 4 2 4 -1] // 8 */
 static void deinterlace_line_c(uint8_t *dst,
                              const uint8_t *lum_m4, const uint8_t *lum_m3,
@@ -947,9 +947,9 @@ static void deinterlace_line_c(uint8_t *dst,
     }
 }
 
-static void deinterlace_line_inplace_c(uint8_t *lum_m4, uint8_t *lum_m3,
-                                       uint8_t *lum_m2, uint8_t *lum_m1,
-                                       uint8_t *lum, int size)
+static void deinterlace_line_inplace_c(uint8_t *lum_m4, const uint8_t *lum_m3,
+                                       uint8_t *lum_m2, const uint8_t *lum_m1,
+                                       const uint8_t *lum, int size)
 {
     uint8_t *cm = ff_cropTbl + MAX_NEG_CROP;
     int sum;
@@ -969,14 +969,14 @@ static void deinterlace_line_inplace_c(uint8_t *lum_m4, uint8_t *lum_m3,
         lum++;
     }
 }
-#endif
 
 /* deinterlacing : 2 temporal taps, 3 spatial taps linear filter. The
    top field is copied as is, but the bottom field is deinterlaced
    against the top field. */
 static void deinterlace_bottom_field(uint8_t *dst, int dst_wrap,
                                     const uint8_t *src1, int src_wrap,
-                                    int width, int height)
+                                    int width, int height,
+                                    DeinterlaceLineFunc deinterlace_line)
 {
     const uint8_t *src_m2, *src_m1, *src_0, *src_p1, *src_p2;
     int y;
@@ -1003,35 +1003,56 @@ static void deinterlace_bottom_field(uint8_t *dst, int dst_wrap,
     deinterlace_line(dst,src_m2,src_m1,src_0,src_0,src_0,width);
 }
 
+/* the picture is processed in strips of columns, so that the line kept
+   from the previous field fits on the stack */
+#define DEINTERLACE_STRIP_WIDTH 1024
+
 static void deinterlace_bottom_field_inplace(uint8_t *src1, int src_wrap,
-                                             int width, int height)
+                                             int width, int height,
+                                             DeinterlaceLineInplaceFunc deinterlace_line_inplace)
 {
     uint8_t *src_m1, *src_0, *src_p1, *src_p2;
-    int y;
-    uint8_t *buf;
-    buf = (uint8_t*)av_malloc(width);
-
-    src_m1 = src1;
-    memcpy(buf,src_m1,width);
-    src_0=&src_m1[src_wrap];
-    src_p1=&src_0[src_wrap];
-    src_p2=&src_p1[src_wrap];
-    for(y=0;y<(height-2);y+=2) {
-        deinterlace_line_inplace(buf,src_m1,src_0,src_p1,src_p2,width);
-        src_m1 = src_p1;
-        src_0 = src_p2;
-        src_p1 += 2*src_wrap;
-        src_p2 += 2*src_wrap;
+    int x, y, w;
+    /* the SIMD versions write up to 3 bytes past the end of the line */
+    DECLARE_ALIGNED(16, uint8_t, buf)[DEINTERLACE_STRIP_WIDTH + 16];
+
+    for (x = 0; x < width; x += DEINTERLACE_STRIP_WIDTH) {
+        w = FFMIN(width - x, DEINTERLACE_STRIP_WIDTH);
+        src_m1 = src1 + x;
+        memcpy(buf,src_m1,w);
+        src_0=&src_m1[src_wrap];
+        src_p1=&src_0[src_wrap];
+        src_p2=&src_p1[src_wrap];
+        for(y=0;y<(height-2);y+=2) {
+            deinterlace_line_inplace(buf,src_m1,src_0,src_p1,src_p2,w);
+            src_m1 = src_p1;
+            src_0 = src_p2;
+            src_p1 += 2*src_wrap;
+            src_p2 += 2*src_wrap;
+        }
+        /* do last line */
+        deinterlace_line_inplace(buf,src_m1,src_0,src_0,src_0,w);
     }
-    /* do last line */
-    deinterlace_line_inplace(buf,src_m1,src_0,src_0,src_0,width);
-    av_free(buf);
 }
 
 int avpicture_deinterlace(AVPicture *dst, const AVPicture *src,
                           enum PixelFormat pix_fmt, int width, int height)
 {
+    DeinterlaceLineFunc        deinterlace_line         = deinterlace_line_c;
+    DeinterlaceLineInplaceFunc deinterlace_line_inplace = deinterlace_line_inplace_c;
     int i;
+#if HAVE_MMX && HAVE_YASM
+    int cpu_flags = av_get_cpu_flags();
+
+    if (cpu_flags & AV_CPU_FLAG_MMX) {
+        deinterlace_line         = ff_deinterlace_line_mmx;
+        deinterlace_line_inplace = ff_deinterlace_line_inplace_mmx;
+    }
+    if (cpu_flags & AV_CPU_FLAG_SSE2) {
+        deinterlace_line         = ff_deinterlace_line_sse2;
+        deinterlace_line_inplace = ff_deinterlace_line_inplace_sse2;
+    }
+#endif
 
     if (pix_fmt != PIX_FMT_YUV420P &&
         pix_fmt != PIX_FMT_YUVJ420P &&
@@ -1068,11 +1089,11 @@ int avpicture_deinterlace(AVPicture *dst, const AVPicture *src,
         }
         if (src == dst) {
             deinterlace_bottom_field_inplace(dst->data[i], dst->linesize[i],
-                                 width, height);
+                                 width, height, deinterlace_line_inplace);
         } else {
             deinterlace_bottom_field(dst->data[i],dst->linesize[i],
                                         src->data[i], src->linesize[i],
-                                        width, height);
+                                        width, height, deinterlace_line);
         }
     }
     emms_c();
@@ -50,4 +50,20 @@ int ff_match_2uint16(const uint16_t (*tab)[2], int size, int a, int b);
 
 unsigned int ff_toupper4(unsigned int x);
 
+/**
+ * Allocate the output of a bitstream filter, with FF_INPUT_BUFFER_PADDING_SIZE
+ * zeroed bytes at the end. The buffer is returned by the filter() callback
+ * as *poutbuf, with a return value of 1.
+ * When the filter is run by av_bitstream_filter_filter_packet(), the
+ * buffer comes from the pool of the filter context and is not copied into
+ * the packet.
+ */
+uint8_t *ff_bsf_get_buffer(AVBitStreamFilterContext *bsfc, int size);
+
+/**
+ * Make the default get_buffer() of dst take its buffers from the same
+ * pool as src. Used for the frame threads of a codec.
+ */
+int ff_share_frame_pool(AVCodecContext *dst, AVCodecContext *src);
+
 #endif /* AVCODEC_INTERNAL_H */
@@ -29,22 +29,33 @@
 
 const static float scale97[] = {1.625786, 1.230174};
 
-static inline void extend53(int *p, int i0, int i1)
+/* The vertical passes of the decoder transform DWT_COLS adjacent columns at
+ * once: the samples of n <= DWT_COLS columns are interleaved in the line
+ * buffer, p[n*i + k] being sample i of column k, so that each lifting step
+ * reads whole cache lines of the tile and runs over consecutive memory. */
+#define DWT_COLS 16
+
+static av_always_inline void extend53(int *p, int i0, int i1, int n)
 {
-    p[i0 - 1] = p[i0 + 1];
-    p[i1    ] = p[i1 - 2];
-    p[i0 - 2] = p[i0 + 2];
-    p[i1 + 1] = p[i1 - 3];
+    int k;
+
+    for (k = 0; k < n; k++){
+        p[n*(i0 - 1) + k] = p[n*(i0 + 1) + k];
+        p[n* i1      + k] = p[n*(i1 - 2) + k];
+        p[n*(i0 - 2) + k] = p[n*(i0 + 2) + k];
+        p[n*(i1 + 1) + k] = p[n*(i1 - 3) + k];
+    }
 }
 
-static inline void extend97(float *p, int i0, int i1)
+static av_always_inline void extend97(float *p, int i0, int i1, int n)
 {
-    int i;
+    int i, k;
 
-    for (i = 1; i <= 4; i++){
-        p[i0 - i] = p[i0 + i];
-        p[i1 + i - 1] = p[i1 - i - 1];
-    }
+    for (i = 1; i <= 4; i++)
+        for (k = 0; k < n; k++){
+            p[n*(i0 - i)     + k] = p[n*(i0 + i)     + k];
+            p[n*(i1 + i - 1) + k] = p[n*(i1 - i - 1) + k];
+        }
 }
 
 static void sd_1d53(int *p, int i0, int i1)
@@ -54,7 +65,7 @@ static void sd_1d53(int *p, int i0, int i1)
     if (i1 == i0 + 1)
         return;
 
-    extend53(p, i0, i1);
+    extend53(p, i0, i1, 1);
 
     for (i = (i0+1)/2 - 1; i < (i1+1)/2; i++)
         p[2*i+1] -= (p[2*i] + p[2*i+2]) >> 1;
@@ -120,7 +131,7 @@ static void sd_1d97(float *p, int i0, int i1)
     if (i1 == i0 + 1)
         return;
 
-    extend97(p, i0, i1);
+    extend97(p, i0, i1, 1);
     i0++; i1++;
 
     for (i = i0/2 - 2; i < i1/2 + 1; i++)
@@ -184,19 +195,21 @@ static void dwt_encode97(DWTContext *s, int *t)
     }
 }
 
-static void sr_1d53(int *p, int i0, int i1)
+static av_always_inline void sr_1d53(int *p, int i0, int i1, int n)
 {
-    int i;
+    int i, k;
 
     if (i1 == i0 + 1)
         return;
 
-    extend53(p, i0, i1);
+    extend53(p, i0, i1, n);
 
     for (i = i0/2; i < i1/2 + 1; i++)
-        p[2*i] -= (p[2*i-1] + p[2*i+1] + 2) >> 2;
+        for (k = 0; k < n; k++)
+            p[n*2*i + k] -= (p[n*(2*i-1) + k] + p[n*(2*i+1) + k] + 2) >> 2;
     for (i = i0/2; i < i1/2; i++)
-        p[2*i+1] += (p[2*i] + p[2*i+2]) >> 1;
+        for (k = 0; k < n; k++)
+            p[n*(2*i+1) + k] += (p[n*2*i + k] + p[n*(2*i+2) + k]) >> 1;
 }
 
 static void dwt_decode53(DWTContext *s, int *t)
@@ -204,7 +217,7 @@ static void dwt_decode53(DWTContext *s, int *t)
     int lev,
         w = s->linelen[s->ndeclevels-1][0];
     int *line = s->linebuf;
-    line += 3;
+    line += 3 * DWT_COLS;
 
     for (lev = 0; lev < s->ndeclevels; lev++){
         int lh = s->linelen[lev][0],
@@ -224,47 +237,54 @@ static void dwt_decode53(DWTContext *s, int *t)
             for (i = 1-mh; i < lh; i+=2, j++)
                 l[i] = t[w*lp + j];
 
-            sr_1d53(line, mh, mh + lh);
+            sr_1d53(line, mh, mh + lh, 1);
 
             for (i = 0; i < lh; i++)
                 t[w*lp + i] = l[i];
         }
 
         // VER_SD
-        l = line + mv;
-        for (lp = 0; lp < lh; lp++){
-            int i, j = 0;
+        for (lp = 0; lp < lh; lp += DWT_COLS){
+            int i, j = 0, k, n = FFMIN(DWT_COLS, lh - lp);
+            l = line + n*mv;
             // copy with interleaving
             for (i =   mv; i < lv; i+=2, j++)
-                l[i] = t[w*j + lp];
+                for (k = 0; k < n; k++)
+                    l[n*i + k] = t[w*j + lp + k];
             for (i = 1-mv; i < lv; i+=2, j++)
-                l[i] = t[w*j + lp];
+                for (k = 0; k < n; k++)
+                    l[n*i + k] = t[w*j + lp + k];
 
-            sr_1d53(line, mv, mv + lv);
+            sr_1d53(line, mv, mv + lv, n);
 
             for (i = 0; i < lv; i++)
-                t[w*i + lp] = l[i];
+                for (k = 0; k < n; k++)
+                    t[w*i + lp + k] = l[n*i + k];
         }
     }
 }
 
-static void sr_1d97(float *p, int i0, int i1)
+static av_always_inline void sr_1d97(float *p, int i0, int i1, int n)
 {
-    int i;
+    int i, k;
 
     if (i1 == i0 + 1)
         return;
 
-    extend97(p, i0, i1);
+    extend97(p, i0, i1, n);
 
     for (i = i0/2 - 1; i < i1/2 + 2; i++)
-        p[2*i] -= 0.443506 * (p[2*i-1] + p[2*i+1]);
+        for (k = 0; k < n; k++)
+            p[n*2*i + k] -= 0.443506 * (p[n*(2*i-1) + k] + p[n*(2*i+1) + k]);
     for (i = i0/2 - 1; i < i1/2 + 1; i++)
-        p[2*i+1] -= 0.882911 * (p[2*i] + p[2*i+2]);
+        for (k = 0; k < n; k++)
+            p[n*(2*i+1) + k] -= 0.882911 * (p[n*2*i + k] + p[n*(2*i+2) + k]);
     for (i = i0/2; i < i1/2 + 1; i++)
-        p[2*i] += 0.052980 * (p[2*i-1] + p[2*i+1]);
+        for (k = 0; k < n; k++)
+            p[n*2*i + k] += 0.052980 * (p[n*(2*i-1) + k] + p[n*(2*i+1) + k]);
     for (i = i0/2; i < i1/2; i++)
-        p[2*i+1] += 1.586134 * (p[2*i] + p[2*i+2]);
+        for (k = 0; k < n; k++)
+            p[n*(2*i+1) + k] += 1.586134 * (p[n*2*i + k] + p[n*(2*i+2) + k]);
 }
 
 static void dwt_decode97(DWTContext *s, int *t)
@@ -272,7 +292,7 @@ static void dwt_decode97(DWTContext *s, int *t)
     int lev,
         w = s->linelen[s->ndeclevels-1][0];
     float *line = s->linebuf;
-    line += 5;
+    line += 5 * DWT_COLS;
 
     for (lev = 0; lev < s->ndeclevels; lev++){
         int lh = s->linelen[lev][0],
@@ -292,26 +312,29 @@ static void dwt_decode97(DWTContext *s, int *t)
             for (i = 1-mh; i < lh; i+=2, j++)
                 l[i] = scale97[1-mh] * t[w*lp + j];
 
-            sr_1d97(line, mh, mh + lh);
+            sr_1d97(line, mh, mh + lh, 1);
 
             for (i = 0; i < lh; i++)
                 t[w*lp + i] = l[i];
         }
 
         // VER_SD
-        l = line + mv;
-        for (lp = 0; lp < lh; lp++){
-            int i, j = 0;
+        for (lp = 0; lp < lh; lp += DWT_COLS){
+            int i, j = 0, k, n = FFMIN(DWT_COLS, lh - lp);
+            l = line + n*mv;
             // copy with interleaving
             for (i =   mv; i < lv; i+=2, j++)
-                l[i] = scale97[1-mv] * t[w*j + lp];
+                for (k = 0; k < n; k++)
+                    l[n*i + k] = scale97[1-mv] * t[w*j + lp + k];
             for (i = 1-mv; i < lv; i+=2, j++)
-                l[i] = scale97[1-mv] * t[w*j + lp];
+                for (k = 0; k < n; k++)
+                    l[n*i + k] = scale97[1-mv] * t[w*j + lp + k];
 
-            sr_1d97(line, mv, mv + lv);
+            sr_1d97(line, mv, mv + lv, n);
 
             for (i = 0; i < lv; i++)
-                t[w*i + lp] = l[i];
+                for (k = 0; k < n; k++)
+                    t[w*i + lp + k] = l[n*i + k];
         }
     }
 }
@@ -340,9 +363,9 @@ int ff_j2k_dwt_init(DWTContext *s, uint16_t border[2][2], int decomp_levels, int
         }
     }
     if (type == FF_DWT97)
-        s->linebuf = av_malloc((maxlen + 12) * sizeof(float));
+        s->linebuf = av_malloc((maxlen + 12) * DWT_COLS * sizeof(float));
     else if (type == FF_DWT53)
-        s->linebuf = av_malloc((maxlen + 6) * sizeof(int));
+        s->linebuf = av_malloc((maxlen + 6) * DWT_COLS * sizeof(int));
     else
         return -1;
 
@@ -28,6 +28,7 @@
 #include "avcodec.h"
 #include "bytestream.h"
 #include "j2k.h"
+#include "thread.h"
 #include "libavutil/common.h"
 
 #define JP2_SIG_TYPE    0x6A502020
@@ -44,6 +45,16 @@ typedef struct {
    J2kQuantStyle  qntsty[4];
 } J2kTile;
 
+typedef struct {
+    J2kComponent   *comp;
+    J2kCodingStyle *codsty;
+    J2kBand        *band;
+    J2kCblk        *cblk;
+    int compno;
+    int bandpos;
+    int x0, x1, y0, y1; ///< area of the code block in the component data
+} J2kCblkJob;
+
 typedef struct {
     AVCodecContext *avctx;
     AVFrame picture;
@@ -72,6 +83,11 @@ typedef struct {
     int16_t curtileno;
 
     J2kTile *tile;
+
+    J2kT1Context *t1;           ///< tier-1 contexts, one per slice thread
+    J2kCblkJob *cblk_jobs;      ///< code blocks of all tiles of the picture
+    unsigned int cblk_jobs_size;
+    int nb_cblk_jobs;
 } J2kDecoderContext;
 
 static int get_bits(J2kDecoderContext *s, int n)
@@ -762,12 +778,9 @@ static void mct_decode(J2kDecoderContext *s, J2kTile *tile)
     }
 }
 
-static int decode_tile(J2kDecoderContext *s, J2kTile *tile)
+static int add_cblk_jobs(J2kDecoderContext *s, J2kTile *tile)
 {
     int compno, reslevelno, bandno;
-    int x, y, *src[4];
-    uint8_t *line;
-    J2kT1Context t1;
 
     for (compno = 0; compno < s->ncomponents; compno++){
         J2kComponent *comp = tile->comp + compno;
@@ -799,25 +812,24 @@ static int decode_tile(J2kDecoderContext *s, J2kTile *tile)
                                 band->coord[0][1]) - band->coord[0][0] + xx0;
 
                     for (cblkx = 0; cblkx < band->cblknx; cblkx++, cblkno++){
-                        int y, x;
-                        decode_cblk(s, codsty, &t1, band->cblk + cblkno, xx1 - xx0, yy1 - yy0, bandpos);
-                        if (codsty->transform == FF_DWT53){
-                            for (y = yy0; y < yy1; y+=s->cdy[compno]){
-                                int *ptr = t1.data[y-yy0];
-                                for (x = xx0; x < xx1; x+=s->cdx[compno]){
-                                    comp->data[(comp->coord[0][1] - comp->coord[0][0]) * y + x] = *ptr++ >> 1;
-                                }
-                            }
-                        } else{
-                            for (y = yy0; y < yy1; y+=s->cdy[compno]){
-                                int *ptr = t1.data[y-yy0];
-                                for (x = xx0; x < xx1; x+=s->cdx[compno]){
-                                    int tmp = ((int64_t)*ptr++) * ((int64_t)band->stepsize) >> 13, tmp2;
-                                    tmp2 = FFABS(tmp>>1) + FFABS(tmp&1);
-                                    comp->data[(comp->coord[0][1] - comp->coord[0][0]) * y + x] = tmp < 0 ? -tmp2 : tmp2;
-                                }
-                            }
-                        }
+                        J2kCblkJob *job = av_fast_realloc(s->cblk_jobs, &s->cblk_jobs_size,
+                                                          (s->nb_cblk_jobs + 1) * sizeof(*s->cblk_jobs));
+                        if (!job)
+                            return AVERROR(ENOMEM);
+                        s->cblk_jobs = job;
+                        job += s->nb_cblk_jobs++;
+
+                        job->comp    = comp;
+                        job->codsty  = codsty;
+                        job->band    = band;
+                        job->cblk    = band->cblk + cblkno;
+                        job->compno  = compno;
+                        job->bandpos = bandpos;
+                        job->x0      = xx0;
+                        job->x1      = xx1;
+                        job->y0      = yy0;
+                        job->y1      = yy1;
+
                         xx0 = xx1;
                         xx1 = FFMIN(xx1 + band->codeblock_width, band->coord[0][1] - band->coord[0][0] + x0);
                     }
@@ -826,9 +838,69 @@ static int decode_tile(J2kDecoderContext *s, J2kTile *tile)
                 }
             }
         }
-        ff_j2k_dwt_decode(&comp->dwt, comp->data);
-        src[compno] = comp->data;
     }
+    return 0;
+}
+
+/**
+ * Decode a code block with the tier-1 context of the thread and write its
+ * dequantized coefficients into the component.
+ */
+static int decode_cblk_job(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    J2kDecoderContext *s = avctx->priv_data;
+    J2kCblkJob *job = s->cblk_jobs + jobnr;
+    J2kComponent *comp = job->comp;
+    J2kT1Context *t1 = s->t1 + threadnr;
+    int compno = job->compno, w = comp->coord[0][1] - comp->coord[0][0];
+    int x, y;
+
+    decode_cblk(s, job->codsty, t1, job->cblk, job->x1 - job->x0, job->y1 - job->y0, job->bandpos);
+    if (job->codsty->transform == FF_DWT53){
+        for (y = job->y0; y < job->y1; y+=s->cdy[compno]){
+            int *ptr = t1->data[y-job->y0];
+            for (x = job->x0; x < job->x1; x+=s->cdx[compno]){
+                comp->data[w * y + x] = *ptr++ >> 1;
+            }
+        }
+    } else{
+        for (y = job->y0; y < job->y1; y+=s->cdy[compno]){
+            int *ptr = t1->data[y-job->y0];
+            for (x = job->x0; x < job->x1; x+=s->cdx[compno]){
+                int tmp = ((int64_t)*ptr++) * ((int64_t)job->band->stepsize) >> 13, tmp2;
+                tmp2 = FFABS(tmp>>1) + FFABS(tmp&1);
+                comp->data[w * y + x] = tmp < 0 ? -tmp2 : tmp2;
+            }
+        }
+    }
+    return 0;
+}
+
+/** inverse transform of the component jobnr % ncomponents of tile jobnr / ncomponents */
+static int dwt_job(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    J2kDecoderContext *s = avctx->priv_data;
+    J2kComponent *comp = s->tile[jobnr / s->ncomponents].comp + jobnr % s->ncomponents;
+
+    if (comp->data)
+        ff_j2k_dwt_decode(&comp->dwt, comp->data);
+    return 0;
+}
+
+/** inverse component transform and output of tile jobnr */
+static int output_tile_job(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    J2kDecoderContext *s = avctx->priv_data;
+    J2kTile *tile = s->tile + jobnr;
+    int compno, x, y, *src[4];
+    uint8_t *line;
+
+    if (!tile->comp[0].data)
+        return 0;
+
+    for (compno = 0; compno < s->ncomponents; compno++)
+        src[compno] = tile->comp[compno].data;
+
     if (tile->codsty[0].mct)
         mct_decode(s, tile);
 
@@ -1020,9 +1092,15 @@ static int decode_frame(AVCodecContext *avctx,
     if (ret = decode_codestream(s))
         return ret;
 
+    /* The code blocks, then the components and the tiles are independent of
+     * each other and decoded in parallel with slice threads. */
+    s->nb_cblk_jobs = 0;
     for (tileno = 0; tileno < s->numXtiles * s->numYtiles; tileno++)
-        if (ret = decode_tile(s, s->tile + tileno))
+        if (s->tile[tileno].comp[0].data && (ret = add_cblk_jobs(s, s->tile + tileno)))
             return ret;
+    avctx->execute2(avctx, decode_cblk_job, NULL, NULL, s->nb_cblk_jobs);
+    avctx->execute2(avctx, dwt_job, NULL, NULL, s->numXtiles * s->numYtiles * s->ncomponents);
+    avctx->execute2(avctx, output_tile_job, NULL, NULL, s->numXtiles * s->numYtiles);
 
     cleanup(s);
     av_log(s->avctx, AV_LOG_DEBUG, "end\n");
@@ -1039,6 +1117,10 @@ static av_cold int j2kdec_init(AVCodecContext *avctx)
 
     avcodec_get_frame_defaults((AVFrame*)&s->picture);
     avctx->coded_frame = (AVFrame*)&s->picture;
+
+    s->t1 = av_malloc(ff_thread_slice_count(avctx) * sizeof(*s->t1));
+    if (!s->t1)
+        return AVERROR(ENOMEM);
     return 0;
 }
 
@@ -1049,6 +1131,8 @@ static av_cold int decode_end(AVCodecContext *avctx)
     if (s->picture.data[0])
         avctx->release_buffer(avctx, &s->picture);
 
+    av_freep(&s->t1);
+    av_freep(&s->cblk_jobs);
     return 0;
 }
 
@@ -1061,7 +1145,7 @@ AVCodec ff_jpeg2000_decoder = {
     NULL,
     decode_end,
     decode_frame,
-    .capabilities = CODEC_CAP_EXPERIMENTAL,
+    .capabilities = CODEC_CAP_EXPERIMENTAL | CODEC_CAP_SLICE_THREADS,
     .pix_fmts =
         (enum PixelFormat[]) {PIX_FMT_GRAY8, PIX_FMT_RGB24, -1}
 };
@@ -30,6 +30,7 @@
 #include "mathops.h"
 #include "dsputil.h"
 #include "lagarithrac.h"
+#include "thread.h"
 
 enum LagarithFrameType {
     FRAME_RAW           = 1,    /**< uncompressed */
@@ -45,12 +46,23 @@ enum LagarithFrameType {
     FRAME_REDUCED_RES   = 11,   /**< reduced resolution YV12 frame */
 };
 
+/**
+ * A plane of the frame, decoded independently of the others.
+ */
+typedef struct LagarithPlane {
+    uint8_t *dst;
+    int width, height, stride;
+    const uint8_t *src;
+    int src_size;
+    int zeros;                  /**< number of consecutive zero bytes encountered */
+    int zeros_rem;              /**< number of zero bytes remaining to output */
+} LagarithPlane;
+
 typedef struct LagarithContext {
     AVCodecContext *avctx;
     AVFrame picture;
     DSPContext dsp;
-    int zeros;                  /**< number of consecutive zero bytes encountered */
-    int zeros_rem;              /**< number of zero bytes remaining to output */
+    LagarithPlane planes[3];
 } LagarithContext;
 
 /**
@@ -216,30 +228,6 @@ static int lag_read_prob_header(lag_rac *rac, GetBitContext *gb)
     return 0;
 }
 
-static void add_lag_median_prediction(uint8_t *dst, uint8_t *src1,
-                                      uint8_t *diff, int w, int *left,
-                                      int *left_top)
-{
-    /* This is almost identical to add_hfyu_median_prediction in dsputil.h.
-     * However the &0xFF on the gradient predictor yealds incorrect output
-     * for lagarith.
-     */
-    int i;
-    uint8_t l, lt;
-
-    l  = *left;
-    lt = *left_top;
-
-    for (i = 0; i < w; i++) {
-        l = mid_pred(l, src1[i], l + src1[i] - lt) + diff[i];
-        lt = src1[i];
-        dst[i] = l;
-    }
-
-    *left     = l;
-    *left_top = lt;
-}
-
 static void lag_pred_line(LagarithContext *l, uint8_t *buf,
                           int width, int stride, int line)
 {
@@ -261,11 +249,11 @@ static void lag_pred_line(LagarithContext *l, uint8_t *buf,
     /* Left pixel is actually prev_row[width] */
     L = buf[width - stride - 1];
 
-    add_lag_median_prediction(buf, buf - stride, buf,
-                              width, &L, &TL);
+    l->dsp.add_lag_median_prediction(buf, buf - stride, buf,
+                                     width, &L, &TL);
 }
 
-static int lag_decode_line(LagarithContext *l, lag_rac *rac,
+static int lag_decode_line(LagarithPlane *l, lag_rac *rac,
                            uint8_t *dst, int width, int stride,
                            int esc_count)
 {
@@ -307,7 +295,7 @@ handle_zeros:
     return ret;
 }
 
-static int lag_decode_zero_run_line(LagarithContext *l, uint8_t *dst,
+static int lag_decode_zero_run_line(LagarithPlane *l, uint8_t *dst,
                                     const uint8_t *src, int width,
                                     int esc_count)
 {
@@ -353,10 +341,12 @@ output_zeros:
 
 
 
-static int lag_decode_arith_plane(LagarithContext *l, uint8_t *dst,
-                                  int width, int height, int stride,
-                                  const uint8_t *src, int src_size)
+static int lag_decode_arith_plane(LagarithContext *l, LagarithPlane *plane)
 {
+    uint8_t *dst = plane->dst;
+    int width = plane->width, height = plane->height, stride = plane->stride;
+    const uint8_t *src = plane->src;
+    int src_size = plane->src_size;
     int i = 0;
     int read = 0;
     uint32_t length;
@@ -366,7 +356,8 @@ static int lag_decode_arith_plane(LagarithContext *l, uint8_t *dst,
     lag_rac rac;
 
     rac.avctx = l->avctx;
-    l->zeros = 0;
+    plane->zeros     = 0;
+    plane->zeros_rem = 0;
 
     if (esc_count < 4) {
         length = width * height;
@@ -383,7 +374,7 @@ static int lag_decode_arith_plane(LagarithContext *l, uint8_t *dst,
         lag_rac_init(&rac, &gb, length - stride);
 
         for (i = 0; i < height; i++)
-            read += lag_decode_line(l, &rac, dst + (i * stride), width,
+            read += lag_decode_line(plane, &rac, dst + (i * stride), width,
                                     stride, esc_count);
 
         if (read > length)
@@ -395,7 +386,7 @@ static int lag_decode_arith_plane(LagarithContext *l, uint8_t *dst,
         if (esc_count > 0) {
             /* Zero run coding only, no range coding. */
             for (i = 0; i < height; i++)
-                src += lag_decode_zero_run_line(l, dst + (i * stride), src,
+                src += lag_decode_zero_run_line(plane, dst + (i * stride), src,
                                                 width, esc_count);
         } else {
             /* Plane is stored uncompressed */
@@ -426,6 +417,25 @@ static int lag_decode_arith_plane(LagarithContext *l, uint8_t *dst,
     return 0;
 }
 
+static int lag_decode_plane(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    LagarithContext *l = avctx->priv_data;
+
+    return lag_decode_arith_plane(l, l->planes + jobnr);
+}
+
+static void lag_init_plane(LagarithPlane *plane, uint8_t *dst, int width,
+                           int height, int stride, const uint8_t *buf,
+                           int buf_size, uint32_t offset)
+{
+    plane->dst      = dst;
+    plane->width    = width;
+    plane->height   = height;
+    plane->stride   = stride;
+    plane->src      = buf + offset;
+    plane->src_size = buf_size - offset;
+}
+
 /**
  * Decode a frame.
  * @param avctx codec context
@@ -447,7 +457,7 @@ static int lag_decode_frame(AVCodecContext *avctx,
     AVFrame *picture = data;
 
     if (p->data[0])
-        avctx->release_buffer(avctx, p);
+        ff_thread_release_buffer(avctx, p);
 
     p->reference = 0;
     p->key_frame = 1;
@@ -461,20 +471,24 @@ static int lag_decode_frame(AVCodecContext *avctx,
     case FRAME_ARITH_YV12:
         avctx->pix_fmt = PIX_FMT_YUV420P;
 
-        if (avctx->get_buffer(avctx, p) < 0) {
+        if (offset_gu >= buf_size || offset_bv >= buf_size) {
+            av_log(avctx, AV_LOG_ERROR, "Invalid plane offsets\n");
+            return -1;
+        }
+
+        if (ff_thread_get_buffer(avctx, p) < 0) {
             av_log(avctx, AV_LOG_ERROR, "get_buffer() failed\n");
             return -1;
         }
 
-        lag_decode_arith_plane(l, p->data[0], avctx->width, avctx->height,
-                               p->linesize[0], buf + offset_ry,
-                               buf_size);
-        lag_decode_arith_plane(l, p->data[2], avctx->width / 2,
-                               avctx->height / 2, p->linesize[2],
-                               buf + offset_gu, buf_size);
-        lag_decode_arith_plane(l, p->data[1], avctx->width / 2,
-                               avctx->height / 2, p->linesize[1],
-                               buf + offset_bv, buf_size);
+        /* The planes are coded independently and decoded in parallel. */
+        lag_init_plane(&l->planes[0], p->data[0], avctx->width, avctx->height,
+                       p->linesize[0], buf, buf_size, offset_ry);
+        lag_init_plane(&l->planes[1], p->data[2], avctx->width / 2,
+                       avctx->height / 2, p->linesize[2], buf, buf_size, offset_gu);
+        lag_init_plane(&l->planes[2], p->data[1], avctx->width / 2,
+                       avctx->height / 2, p->linesize[1], buf, buf_size, offset_bv);
+        avctx->execute2(avctx, lag_decode_plane, NULL, NULL, 3);
         break;
     default:
         av_log(avctx, AV_LOG_ERROR,
@@ -498,12 +512,20 @@ static av_cold int lag_decode_init(AVCodecContext *avctx)
     return 0;
 }
 
+static av_cold int lag_decode_init_thread_copy(AVCodecContext *avctx)
+{
+    LagarithContext *l = avctx->priv_data;
+    l->avctx = avctx;
+
+    return 0;
+}
+
 static av_cold int lag_decode_end(AVCodecContext *avctx)
 {
     LagarithContext *l = avctx->priv_data;
 
     if (l->picture.data[0])
-        avctx->release_buffer(avctx, &l->picture);
+        ff_thread_release_buffer(avctx, &l->picture);
 
     return 0;
 }
@@ -517,6 +539,7 @@ AVCodec ff_lagarith_decoder = {
     NULL,
     lag_decode_end,
     lag_decode_frame,
-    CODEC_CAP_DR1,
+    CODEC_CAP_DR1 | CODEC_CAP_SLICE_THREADS | CODEC_CAP_FRAME_THREADS,
+    .init_thread_copy = ONLY_IF_THREADS_ENABLED(lag_decode_init_thread_copy),
     .long_name = NULL_IF_CONFIG_SMALL("Lagarith lossless"),
 };
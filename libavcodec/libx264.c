@@ -43,6 +43,9 @@ typedef struct X264Context {
     char *stats;
     char *weightp;
     char *x264opts;
+    int sliced_threads;
+    int sync_lookahead;
+    int lookahead_threads;
 } X264Context;
 
 static void X264_log(void *p, int level, const char *fmt, va_list args)
@@ -66,7 +69,17 @@ static int encode_nals(AVCodecContext *ctx, uint8_t *buf, int size,
 {
     X264Context *x4 = ctx->priv_data;
     uint8_t *p = buf;
-    int i;
+    int i, payload = 0, contiguous = 1;
+
+    for (i = 0; i < nnal; i++) {
+        payload += nals[i].i_payload;
+        if (i && nals[i].p_payload != nals[i-1].p_payload + nals[i-1].i_payload)
+            contiguous = 0;
+    }
+    if (nnal > 0 && x4->sei_size + payload > size) {
+        av_log(ctx, AV_LOG_ERROR, "Output buffer too small for the encoded frame\n");
+        return -1;
+    }
 
     /* Write the SEI as part of the first frame. */
     if (x4->sei_size > 0 && nnal > 0) {
@@ -75,6 +88,12 @@ static int encode_nals(AVCodecContext *ctx, uint8_t *buf, int size,
         x4->sei_size = 0;
     }
 
+    /* x264 outputs the NALs of a frame back to back, copy them at once */
+    if (!skip_sei && contiguous && nnal > 0) {
+        memcpy(p, nals[0].p_payload, payload);
+        return p + payload - buf;
+    }
+
     for (i = 0; i < nnal; i++){
         /* Don't put the SEI in extradata. */
         if (skip_sei && nals[i].i_type == NAL_SEI) {
@@ -96,7 +115,7 @@ static int X264_frame(AVCodecContext *ctx, uint8_t *buf,
     X264Context *x4 = ctx->priv_data;
     AVFrame *frame = data;
     x264_nal_t *nal;
-    int nnal, i;
+    int nnal, i, ret;
     x264_picture_t pic_out;
 
     x264_picture_init( &x4->pic );
@@ -131,10 +150,10 @@ static int X264_frame(AVCodecContext *ctx, uint8_t *buf,
     if (x264_encoder_encode(x4->enc, &nal, &nnal, frame? &x4->pic: NULL, &pic_out) < 0)
         return -1;
 
-    bufsize = encode_nals(ctx, buf, bufsize, nal, nnal, 0);
-    if (bufsize < 0)
+    ret = encode_nals(ctx, buf, bufsize, nal, nnal, 0);
+    if (ret < 0)
         return -1;
-    } while (!bufsize && !frame && x264_encoder_delayed_frames(x4->enc));
+    } while (!ret && !frame && x264_encoder_delayed_frames(x4->enc));
 
     /* FIXME: libx264 now provides DTS, but AVFrame doesn't have a field for it. */
     x4->out_pic.pts = pic_out.i_pts;
@@ -154,10 +173,10 @@ static int X264_frame(AVCodecContext *ctx, uint8_t *buf,
     }
 
     x4->out_pic.key_frame = pic_out.b_keyframe;
-    if (bufsize)
+    if (ret)
         x4->out_pic.quality = (pic_out.i_qpplus1 - 1) * FF_QP2LAMBDA;
 
-    return bufsize;
+    return ret;
 }
 
 static av_cold int X264_close(AVCodecContext *avctx)
@@ -343,6 +362,15 @@ static av_cold int X264_init(AVCodecContext *avctx)
 
     OPT_STR("level", x4->level);
 
+    if (x4->sliced_threads >= 0)
+        x4->params.b_sliced_threads    = x4->sliced_threads;
+    if (x4->sync_lookahead >= 0)
+        x4->params.i_sync_lookahead    = x4->sync_lookahead;
+#if X264_BUILD >= 128
+    if (x4->lookahead_threads >= 0)
+        x4->params.i_lookahead_threads = x4->lookahead_threads;
+#endif
+
     if(x4->x264opts){
         const char *p= x4->x264opts;
         while(p){
@@ -427,6 +455,11 @@ static const AVOption options[] = {
     {"passlogfile", "Filename for 2 pass stats", OFFSET(stats), FF_OPT_TYPE_STRING, {.str=NULL}, 0, 0, VE},
     {"wpredp", "Weighted prediction for P-frames", OFFSET(weightp), FF_OPT_TYPE_STRING, {.str=NULL}, 0, 0, VE},
     {"x264opts", "x264 options", OFFSET(x264opts), FF_OPT_TYPE_STRING, {.str=NULL}, 0, 0, VE},
+    {"sliced_threads", "Use slice-based threading, which adds no latency", OFFSET(sliced_threads), FF_OPT_TYPE_INT, {.dbl=-1}, -1, 1, VE},
+    {"sync_lookahead", "Number of buffer frames for the threaded lookahead, 0 for none", OFFSET(sync_lookahead), FF_OPT_TYPE_INT, {.dbl=-1}, -1, INT_MAX, VE},
+#if X264_BUILD >= 128
+    {"lookahead_threads", "Number of threads used by the lookahead", OFFSET(lookahead_threads), FF_OPT_TYPE_INT, {.dbl=-1}, -1, INT_MAX, VE},
+#endif
     { NULL },
 };
 
@@ -80,6 +80,9 @@ av_cold int ff_mdct_init(FFTContext *s, int nbits, int inverse, double scale)
         s->tcos[i*tstep] = FIX15(-cos(alpha) * scale);
         s->tsin[i*tstep] = FIX15(-sin(alpha) * scale);
     }
+#if CONFIG_FFT_FLOAT
+    if (HAVE_MMX) ff_mdct_init_mmx(s);
+#endif
     return 0;
  fail:
     ff_mdct_end(s);
@@ -129,6 +132,15 @@ void ff_imdct_half_c(FFTContext *s, FFTSample *output, const FFTSample *input)
     }
 }
 
+void ff_imdct_half_batch_c(FFTContext *s, FFTSample *output, int out_stride,
+                           const FFTSample *input, int in_stride, int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+        s->imdct_half(s, output + i * out_stride, input + i * in_stride);
+}
+
 /**
  * Compute inverse MDCT of size N = 2^nbits
  * @param output N samples
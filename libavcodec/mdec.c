@@ -107,7 +107,7 @@ static inline int mdec_decode_block_intra(MDECContext *a, DCTELEM *block, int n)
                 }
             }
             if (i > 63){
-                av_log(a->avctx, AV_LOG_ERROR, "ac-tex damaged at %d %d\n", a->mb_x, a->mb_y);
+                av_log_ratelimited(a->avctx, AV_LOG_ERROR, "ac-tex damaged at %d %d\n", a->mb_x, a->mb_y);
                 return -1;
             }
 
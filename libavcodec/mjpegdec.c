@@ -40,6 +40,7 @@
 #include "mjpeg.h"
 #include "mjpegdec.h"
 #include "jpeglsdec.h"
+#include "thread.h"
 
 
 static int build_vlc(VLC *vlc, const uint8_t *bits_table, const uint8_t *val_table,
@@ -117,6 +118,13 @@ av_cold int ff_mjpeg_decode_init(AVCodecContext *avctx)
     if (avctx->codec->id == CODEC_ID_AMV)
         s->flipped = 1;
 
+    if (ff_thread_slice_count(avctx) > 1) {
+        s->slice_ctx = av_malloc(ff_thread_slice_count(avctx) * sizeof(*s->slice_ctx));
+        if (!s->slice_ctx)
+            return AVERROR(ENOMEM);
+        s->nb_slice_ctx = ff_thread_slice_count(avctx);
+    }
+
     return 0;
 }
 
@@ -790,28 +798,29 @@ static av_always_inline void mjpeg_copy_block(uint8_t *dst, const uint8_t *src,
     }
 }
 
-static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah, int Al,
-                             const uint8_t *mb_bitmask, const AVFrame *reference){
+/**
+ * Decode nb_mbs macroblocks of a sequential or progressive DC scan in raster
+ * order, starting with the macroblock first_mb.
+ */
+static int mjpeg_decode_mbs(MJpegDecodeContext *s, int nb_components, int Ah, int Al,
+                            const uint8_t *mb_bitmask, const AVFrame *reference,
+                            int first_mb, int nb_mbs){
     int i, mb_x, mb_y;
     uint8_t* data[MAX_COMPONENTS];
     const uint8_t *reference_data[MAX_COMPONENTS];
     int linesize[MAX_COMPONENTS];
-    GetBitContext mb_bitmask_gb;
+    GetBitContext mb_bitmask_gb = {0}; // initialize to silence gcc warning
 
     if (mb_bitmask) {
         init_get_bits(&mb_bitmask_gb, mb_bitmask, s->mb_width*s->mb_height);
+        skip_bits_long(&mb_bitmask_gb, first_mb);
     }
 
-    if(s->flipped && s->avctx->flags & CODEC_FLAG_EMU_EDGE) {
-        av_log(s->avctx, AV_LOG_ERROR, "Can not flip image with CODEC_FLAG_EMU_EDGE set!\n");
-        s->flipped = 0;
-    }
     for(i=0; i < nb_components; i++) {
         int c = s->comp_index[i];
         data[c] = s->picture_ptr->data[c];
         reference_data[c] = reference ? reference->data[c] : NULL;
         linesize[c]=s->linesize[c];
-        s->coefs_finished[c] |= 1;
         if(s->flipped) {
             //picture should be flipped upside-down for this codec
             int offset = (linesize[c] * (s->v_scount[i] * (8 * s->mb_height -((s->height/s->v_max)&7)) - 1 ));
@@ -821,9 +830,15 @@ static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah, i
         }
     }
 
-    for(mb_y = 0; mb_y < s->mb_height; mb_y++) {
-        for(mb_x = 0; mb_x < s->mb_width; mb_x++) {
-            const int copy_mb = mb_bitmask && !get_bits1(&mb_bitmask_gb);
+    mb_y = first_mb / s->mb_width;
+    mb_x = first_mb % s->mb_width;
+    for(; mb_y < s->mb_height; mb_y++, mb_x = 0) {
+        for(; mb_x < s->mb_width; mb_x++) {
+            int copy_mb;
+
+            if (nb_mbs-- <= 0)
+                return 0;
+            copy_mb = mb_bitmask && !get_bits1(&mb_bitmask_gb);
 
             if (s->restart_interval && !s->restart_count)
                 s->restart_count = s->restart_interval;
@@ -895,6 +910,81 @@ static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah, i
     return 0;
 }
 
+typedef struct RestartIntervalArgs {
+    MJpegDecodeContext *s;
+    int nb_components, Ah, Al;
+    const uint8_t *mb_bitmask;
+    const AVFrame *reference;
+    int nb_intervals;
+    int end_bits;           ///< position in the scan after the last interval
+} RestartIntervalArgs;
+
+/**
+ * Decode the restart interval jobnr of the current scan with the slice copy of
+ * the thread.
+ */
+static int decode_restart_interval(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    RestartIntervalArgs *a = arg;
+    MJpegDecodeContext *s = a->s;
+    MJpegDecodeContext *t = &s->slice_ctx[threadnr];
+    int i;
+
+    if (jobnr) {
+        const uint8_t *ptr = s->buffer + s->restart_offsets[jobnr - 1];
+        init_get_bits(&t->gb, ptr, s->gb.size_in_bits - 8 * (ptr - s->gb.buffer));
+    } else
+        t->gb = s->gb;
+    for (i = 0; i < a->nb_components; i++)
+        t->last_dc[i] = 1024;
+
+    if (mjpeg_decode_mbs(t, a->nb_components, a->Ah, a->Al, a->mb_bitmask, a->reference,
+                         jobnr * s->restart_interval, s->restart_interval) < 0)
+        t->error_count++;
+    if (jobnr == a->nb_intervals - 1)
+        a->end_bits = 8 * (t->gb.buffer - s->gb.buffer) + get_bits_count(&t->gb);
+    return 0;
+}
+
+static int mjpeg_decode_scan(MJpegDecodeContext *s, int nb_components, int Ah, int Al,
+                             const uint8_t *mb_bitmask, const AVFrame *reference){
+    int i, nb_intervals = 0;
+
+    if(s->flipped && s->avctx->flags & CODEC_FLAG_EMU_EDGE) {
+        av_log(s->avctx, AV_LOG_ERROR, "Can not flip image with CODEC_FLAG_EMU_EDGE set!\n");
+        s->flipped = 0;
+    }
+    for(i=0; i < nb_components; i++)
+        s->coefs_finished[s->comp_index[i]] |= 1;
+
+    /* The restart intervals start with a reset DC prediction on a byte
+     * boundary, so they can be decoded independently once the markers
+     * were found while unescaping the scan. */
+    if (s->restart_interval)
+        nb_intervals = (s->mb_width * s->mb_height + s->restart_interval - 1) / s->restart_interval;
+    if (s->nb_slice_ctx > 1 && nb_intervals > 1 &&
+        s->nb_restart_offsets == nb_intervals - 1 && s->gb.buffer == s->buffer &&
+        s->restart_offsets[0] > get_bits_count(&s->gb) >> 3) {
+        RestartIntervalArgs args = { s, nb_components, Ah, Al, mb_bitmask, reference,
+                                     nb_intervals };
+        int error_count = 0;
+
+        for (i = 0; i < s->nb_slice_ctx; i++) {
+            memcpy(&s->slice_ctx[i], s, sizeof(*s));
+            s->slice_ctx[i].error_count = 0;
+        }
+        s->avctx->execute2(s->avctx, decode_restart_interval, &args, NULL, nb_intervals);
+        for (i = 0; i < s->nb_slice_ctx; i++)
+            error_count += s->slice_ctx[i].error_count;
+        /* leave the reader at the end of the scan, as the serial path does */
+        skip_bits_long(&s->gb, args.end_bits - get_bits_count(&s->gb));
+        return error_count ? -1 : 0;
+    }
+
+    return mjpeg_decode_mbs(s, nb_components, Ah, Al, mb_bitmask, reference,
+                            0, s->mb_width * s->mb_height);
+}
+
 static int mjpeg_decode_scan_progressive_ac(MJpegDecodeContext *s, int ss, int se, int Ah, int Al){
     int mb_x, mb_y;
     int EOBRUN = 0;
@@ -1329,6 +1419,7 @@ int ff_mjpeg_find_marker(MJpegDecodeContext *s,
                     const uint8_t *src = *buf_ptr;
                     uint8_t *dst = s->buffer;
 
+                    s->nb_restart_offsets = 0;
                     while (src<buf_end)
                     {
                         uint8_t x = *(src++);
@@ -1340,9 +1431,19 @@ int ff_mjpeg_find_marker(MJpegDecodeContext *s,
                                 while (src < buf_end && x == 0xff)
                                     x = *(src++);
 
-                                if (x >= 0xd0 && x <= 0xd7)
+                                if (x >= 0xd0 && x <= 0xd7) {
                                     *(dst++) = x;
-                                else if (x)
+                                    /* remember where the restart intervals start
+                                     * to decode them in parallel */
+                                    if (s->nb_slice_ctx > 1) {
+                                        int *offsets = av_fast_realloc(s->restart_offsets, &s->restart_offsets_size,
+                                                                       (s->nb_restart_offsets + 1) * sizeof(*offsets));
+                                        if (offsets) {
+                                            s->restart_offsets = offsets;
+                                            s->restart_offsets[s->nb_restart_offsets++] = dst - s->buffer;
+                                        }
+                                    }
+                                } else if (x)
                                     break;
                             }
                         }
@@ -1589,6 +1690,8 @@ av_cold int ff_mjpeg_decode_end(AVCodecContext *avctx)
 
     av_free(s->buffer);
     av_free(s->qscale_table);
+    av_freep(&s->restart_offsets);
+    av_freep(&s->slice_ctx);
     av_freep(&s->ljpeg_buffer);
     s->ljpeg_buffer_size=0;
 
@@ -1612,7 +1715,7 @@ AVCodec ff_mjpeg_decoder = {
     NULL,
     ff_mjpeg_decode_end,
     ff_mjpeg_decode_frame,
-    CODEC_CAP_DR1,
+    CODEC_CAP_DR1 | CODEC_CAP_SLICE_THREADS,
     NULL,
     .max_lowres = 3,
     .long_name = NULL_IF_CONFIG_SMALL("MJPEG (Motion JPEG)"),
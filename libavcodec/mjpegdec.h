@@ -106,6 +106,13 @@ typedef struct MJpegDecodeContext {
 
     uint16_t (*ljpeg_buffer)[4];
     unsigned int ljpeg_buffer_size;
+
+    struct MJpegDecodeContext *slice_ctx; ///< copies decoding the restart intervals, one per slice thread
+    int nb_slice_ctx;
+    int error_count;                     ///< restart intervals which failed to decode with this copy
+    int *restart_offsets;                ///< offsets in buffer of the restart intervals after the first one
+    unsigned int restart_offsets_size;
+    int nb_restart_offsets;
 } MJpegDecodeContext;
 
 int ff_mjpeg_decode_init(AVCodecContext *avctx);
@@ -454,5 +454,6 @@ AVCodec ff_mjpeg_encoder = {
     MPV_encode_picture,
     MPV_encode_end,
     .pix_fmts= (const enum PixelFormat[]){PIX_FMT_YUVJ420P, PIX_FMT_YUVJ422P, PIX_FMT_NONE},
+    .capabilities = CODEC_CAP_FRAME_THREADS,
     .long_name= NULL_IF_CONFIG_SMALL("MJPEG (Motion JPEG)"),
 };
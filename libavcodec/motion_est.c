@@ -324,6 +324,7 @@ int ff_init_me(MpegEncContext *s){
     c->flags    = get_flags(c, 0, c->avctx->me_cmp    &FF_CMP_CHROMA);
     c->sub_flags= get_flags(c, 0, c->avctx->me_sub_cmp&FF_CMP_CHROMA);
     c->mb_flags = get_flags(c, 0, c->avctx->mb_cmp    &FF_CMP_CHROMA);
+    c->me_cmp_x4= c->avctx->me_cmp == FF_CMP_SAD && s->dsp.sad_x4[0] ? s->dsp.sad_x4 : NULL;
 
 /*FIXME s->no_rounding b_type*/
     if(s->flags&CODEC_FLAG_QPEL){
@@ -1309,6 +1310,166 @@ int ff_pre_estimate_p_frame_motion(MpegEncContext * s,
     return dmin;
 }
 
+/* search range of the coarsest level of the pre-search pyramid */
+#define PRESEARCH_RANGE 8
+
+static inline int presearch_score(MpegEncContext *s, uint8_t *src, uint8_t *ref,
+                                  int stride, int mx, int my)
+{
+    return s->dsp.sad[1](s, src, ref + my*stride + mx, stride, 8) + FFABS(mx) + FFABS(my);
+}
+
+/**
+ * Search the 8x8 blocks of one level of the pre-search pyramid.
+ * @param parent vectors of the lower resolution level, NULL to search
+ *               around the zero vector instead
+ */
+static void presearch_level(MpegEncContext *s, int16_t (*mv)[2], int16_t (*parent)[2],
+                            uint8_t *src, uint8_t *ref, int stride, int w, int h,
+                            int bw, int bh, int parent_bw)
+{
+    int bx, by;
+
+    for(by=0; by<bh; by++){
+        for(bx=0; bx<bw; bx++){
+            const int x= 8*bx, y= 8*by;
+            const int xmin= -x, xmax= FFMAX(w - 8 - x, 0);
+            const int ymin= -y, ymax= FFMAX(h - 8 - y, 0);
+            uint8_t *blk    = src + y*stride + x;
+            uint8_t *blk_ref= ref + y*stride + x;
+            int best[2]= {0, 0};
+            int dmin= presearch_score(s, blk, blk_ref, stride, 0, 0);
+            int d, i, mx, my;
+
+            if(!parent){
+                for(my=FFMAX(ymin, -PRESEARCH_RANGE); my<=FFMIN(ymax, PRESEARCH_RANGE); my++){
+                    for(mx=FFMAX(xmin, -PRESEARCH_RANGE); mx<=FFMIN(xmax, PRESEARCH_RANGE); mx++){
+                        d= presearch_score(s, blk, blk_ref, stride, mx, my);
+                        if(d < dmin){
+                            dmin= d;
+                            best[0]= mx;
+                            best[1]= my;
+                        }
+                    }
+                }
+            }else{
+                int cand[3][2], nb_cand= 0;
+
+                cand[nb_cand  ][0]= 2*parent[(by>>1)*parent_bw + (bx>>1)][0];
+                cand[nb_cand++][1]= 2*parent[(by>>1)*parent_bw + (bx>>1)][1];
+                if(bx){
+                    cand[nb_cand  ][0]= mv[by*bw + bx - 1][0];
+                    cand[nb_cand++][1]= mv[by*bw + bx - 1][1];
+                }
+                if(by){
+                    cand[nb_cand  ][0]= mv[(by-1)*bw + bx][0];
+                    cand[nb_cand++][1]= mv[(by-1)*bw + bx][1];
+                }
+                for(i=0; i<nb_cand; i++){
+                    mx= av_clip(cand[i][0], xmin, xmax);
+                    my= av_clip(cand[i][1], ymin, ymax);
+                    d= presearch_score(s, blk, blk_ref, stride, mx, my);
+                    if(d < dmin){
+                        dmin= d;
+                        best[0]= mx;
+                        best[1]= my;
+                    }
+                }
+
+                /* small diamond around the best candidate */
+                for(i=0; i<PRESEARCH_RANGE; i++){
+                    static const int8_t dir[4][2]= {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+                    int j, center[2]= {best[0], best[1]};
+
+                    for(j=0; j<4; j++){
+                        mx= center[0] + dir[j][0];
+                        my= center[1] + dir[j][1];
+                        if(mx < xmin || mx > xmax || my < ymin || my > ymax)
+                            continue;
+                        d= presearch_score(s, blk, blk_ref, stride, mx, my);
+                        if(d < dmin){
+                            dmin= d;
+                            best[0]= mx;
+                            best[1]= my;
+                        }
+                    }
+                    if(best[0] == center[0] && best[1] == center[1])
+                        break;
+                }
+            }
+            mv[by*bw + bx][0]= best[0];
+            mv[by*bw + bx][1]= best[1];
+        }
+    }
+}
+
+/**
+ * Search the motion of every MB against one reference on the downscaled
+ * luma and store the full-pel vectors in mv_table.
+ */
+static void presearch_ref(MpegEncContext *s, int16_t (*mv_table)[2], uint8_t *cur[2], uint8_t *ref_pic)
+{
+    const int levels= s->avctx->me_presearch;
+    const int stride[2]= { s->mb_width*8, ((s->mb_width+1)>>1)*8 };
+    const int bw[2]= { s->mb_width , (s->mb_width +1)>>1 };
+    const int bh[2]= { s->mb_height, (s->mb_height+1)>>1 };
+    int16_t (*level_mv[2])[2]= { s->presearch_level_mv, s->presearch_level_mv + s->mb_num };
+    uint8_t *ref[2];
+    int l, x, y;
+
+    ref[0]= s->presearch_buf +   stride[0]*bh[0]*8;
+    ref[1]= s->presearch_buf + 2*stride[0]*bh[0]*8 + stride[1]*bh[1]*8;
+    for(l=0; l<levels; l++)
+        s->dsp.shrink[l+1](ref[l], stride[l], ref_pic, s->linesize,
+                           s->width >> (l+1), s->height >> (l+1));
+
+    for(l=levels-1; l>=0; l--)
+        presearch_level(s, level_mv[l], l == levels-1 ? NULL : level_mv[l+1],
+                        cur[l], ref[l], stride[l], s->width >> (l+1), s->height >> (l+1),
+                        bw[l], bh[l], bw[1]);
+
+    for(y=0; y<s->mb_height; y++){
+        for(x=0; x<s->mb_width; x++){
+            mv_table[x + y*s->mb_stride][0]= 2*level_mv[0][x + y*s->mb_width][0];
+            mv_table[x + y*s->mb_stride][1]= 2*level_mv[0][x + y*s->mb_width][1];
+        }
+    }
+}
+
+/**
+ * Do the low resolution motion pre-search of the current picture against
+ * its references, which makes the vectors a candidate of the later
+ * motion searches.
+ */
+void ff_me_presearch(MpegEncContext *s)
+{
+    MotionEstContext * const c= &s->me;
+    const int levels= s->avctx->me_presearch;
+    const int stride[2]= { s->mb_width*8, ((s->mb_width+1)>>1)*8 };
+    uint8_t *cur[2];
+    int l;
+
+    c->presearch_mv[0]=
+    c->presearch_mv[1]= NULL;
+    if(!levels || s->pict_type == AV_PICTURE_TYPE_I ||
+       (s->width >> levels) < 8 || (s->height >> levels) < 8)
+        return;
+
+    cur[0]= s->presearch_buf;
+    cur[1]= s->presearch_buf + 2*stride[0]*s->mb_height*8;
+    for(l=0; l<levels; l++)
+        s->dsp.shrink[l+1](cur[l], stride[l], s->new_picture.data[0], s->linesize,
+                           s->width >> (l+1), s->height >> (l+1));
+
+    presearch_ref(s, s->presearch_mv_table[0], cur, s->last_picture.data[0]);
+    c->presearch_mv[0]= s->presearch_mv_table[0];
+    if(s->pict_type == AV_PICTURE_TYPE_B){
+        presearch_ref(s, s->presearch_mv_table[1], cur, s->next_picture.data[0]);
+        c->presearch_mv[1]= s->presearch_mv_table[1];
+    }
+    emms_c();
+}
+
 static int ff_estimate_motion_b(MpegEncContext * s,
                        int mb_x, int mb_y, int16_t (*mv_table)[2], int ref_index, int f_code)
 {
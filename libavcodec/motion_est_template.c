@@ -524,12 +524,15 @@ static int qpel_motion_search(MpegEncContext * s,
 }
 
 #define CHECK_MV_DIR(x,y,new_dir)\
+    CHECK_MV_DIR_SCORE(x, y, new_dir, cmp(s, x, y, 0, 0, size, h, ref_index, src_index, cmpf, chroma_cmpf, flags))
+
+#define CHECK_MV_DIR_SCORE(x,y,new_dir,score)\
 {\
     const int key= ((y)<<ME_MAP_MV_BITS) + (x) + map_generation;\
     const int index= (((y)<<ME_MAP_SHIFT) + (x))&(ME_MAP_SIZE-1);\
 /*printf("check_mv_dir %d %d %d\n", x, y, new_dir);*/\
     if(map[index]!=key){\
-        d= cmp(s, x, y, 0, 0, size, h, ref_index, src_index, cmpf, chroma_cmpf, flags);\
+        d= score;\
         map[index]= key;\
         score_map[index]= d;\
         d += (mv_penalty[((x)<<shift)-pred_x] + mv_penalty[((y)<<shift)-pred_y])*penalty_factor;\
@@ -560,6 +563,7 @@ static av_always_inline int small_diamond_search(MpegEncContext * s, int *best,
 {
     MotionEstContext * const c= &s->me;
     me_cmp_func cmpf, chroma_cmpf;
+    me_cmp_x4_func cmpf_x4= NULL;
     int next_dir=-1;
     LOAD_COMMON
     LOAD_COMMON2
@@ -567,6 +571,9 @@ static av_always_inline int small_diamond_search(MpegEncContext * s, int *best,
 
     cmpf= s->dsp.me_cmp[size];
     chroma_cmpf= s->dsp.me_cmp[size+1];
+    /* the fullpel luma only compare can score all 4 neighbours in one call */
+    if(c->me_cmp_x4 && !(flags&(FLAG_CHROMA|FLAG_DIRECT)))
+        cmpf_x4= c->me_cmp_x4[size];
 
     { /* ensure that the best point is in the MAP as h/qpel refinement needs it */
         const int key= (best[1]<<ME_MAP_MV_BITS) + best[0] + map_generation;
@@ -585,10 +592,23 @@ static av_always_inline int small_diamond_search(MpegEncContext * s, int *best,
         next_dir=-1;
 
 //printf("%d", dir);
-        if(dir!=2 && x>xmin) CHECK_MV_DIR(x-1, y  , 0)
-        if(dir!=3 && y>ymin) CHECK_MV_DIR(x  , y-1, 1)
-        if(dir!=0 && x<xmax) CHECK_MV_DIR(x+1, y  , 2)
-        if(dir!=1 && y<ymax) CHECK_MV_DIR(x  , y+1, 3)
+        if(cmpf_x4 && x>xmin && x<xmax && y>ymin && y<ymax){
+            const int stride= c->stride;
+            uint8_t * const ref= c->ref[ref_index][0] + x + y*stride;
+            uint8_t * const cand[4]= { ref - 1, ref - stride, ref + 1, ref + stride };
+            int score[4];
+
+            cmpf_x4(s, c->src[src_index][0], cand, stride, h, score);
+            if(dir!=2) CHECK_MV_DIR_SCORE(x-1, y  , 0, score[0])
+            if(dir!=3) CHECK_MV_DIR_SCORE(x  , y-1, 1, score[1])
+            if(dir!=0) CHECK_MV_DIR_SCORE(x+1, y  , 2, score[2])
+            if(dir!=1) CHECK_MV_DIR_SCORE(x  , y+1, 3, score[3])
+        }else{
+            if(dir!=2 && x>xmin) CHECK_MV_DIR(x-1, y  , 0)
+            if(dir!=3 && y>ymin) CHECK_MV_DIR(x  , y-1, 1)
+            if(dir!=0 && x<xmax) CHECK_MV_DIR(x+1, y  , 2)
+            if(dir!=1 && y<ymax) CHECK_MV_DIR(x  , y+1, 3)
+        }
 
         if(next_dir==-1){
             return dmin;
@@ -1082,6 +1102,11 @@ static av_always_inline int epzs_motion_search_internal(MpegEncContext * s, int
         }
     }
 
+    /* the low resolution pre-search is only done for frame MBs */
+    if(c->presearch_mv[ref_index>>1] && size == 0 && h == 16)
+        CHECK_CLIPPED_MV(c->presearch_mv[ref_index>>1][ref_mv_xy][0],
+                         c->presearch_mv[ref_index>>1][ref_mv_xy][1])
+
     if(c->avctx->last_predictor_count){
         const int count= c->avctx->last_predictor_count;
         const int xstart= FFMAX(0, s->mb_x - count);
@@ -35,10 +35,9 @@ int ff_mpeg4_find_frame_end(ParseContext *pc, const uint8_t *buf, int buf_size){
 
     i=0;
     if(!vop_found){
-        for(i=0; i<buf_size; i++){
-            state= (state<<8) | buf[i];
+        while(i<buf_size){
+            i= ff_find_start_code(buf+i, buf+buf_size, &state) - buf;
             if(state == 0x1B6){
-                i++;
                 vop_found=1;
                 break;
             }
@@ -49,12 +48,12 @@ int ff_mpeg4_find_frame_end(ParseContext *pc, const uint8_t *buf, int buf_size){
         /* EOF considered as end of frame */
         if (buf_size == 0)
             return 0;
-        for(; i<buf_size; i++){
-            state= (state<<8) | buf[i];
+        while(i<buf_size){
+            i= ff_find_start_code(buf+i, buf+buf_size, &state) - buf;
             if((state&0xFFFFFF00) == 0x100){
                 pc->frame_start_found=0;
                 pc->state=-1;
-                return i-3;
+                return i-4;
             }
         }
     }
@@ -28,6 +28,22 @@ typedef struct MPADSPContext {
                                int *dither_state, int16_t *samples, int incr);
     void (*dct32_float)(float *dst, const float *src);
     void (*dct32_fixed)(int *dst, const int *src);
+
+    /**
+     * Windowed IMDCT of count consecutive long blocks, overlapped with the
+     * previous granule. buf holds the overlap of 4 subbands interleaved per
+     * group of 4 subbands (72 values per group, buf[4*i + (sb & 3)]).
+     */
+    void (*imdct36_blocks_float)(float *out, float *buf, float *in,
+                                 int count, int switch_point, int block_type);
+    void (*imdct36_blocks_fixed)(int *out, int *buf, int *in,
+                                 int count, int switch_point, int block_type);
+
+    /**
+     * Alias reduction butterflies of n subband boundaries;
+     * ptr points to the first sample of the second subband.
+     */
+    void (*antialias_float)(float *ptr, int n, float csa_table[8][4]);
 } MPADSPContext;
 
 void ff_mpadsp_init(MPADSPContext *s);
@@ -35,6 +51,9 @@ void ff_mpadsp_init(MPADSPContext *s);
 extern int32_t ff_mpa_synth_window_fixed[];
 extern float   ff_mpa_synth_window_float[];
 
+extern int     ff_mdct_win_fixed[8][36];
+extern float   ff_mdct_win_float[8][36];
+
 void ff_mpa_synth_filter_fixed(MPADSPContext *s,
                                int32_t *synth_buf_ptr, int *synth_buf_offset,
                                int32_t *window, int *dither_state,
@@ -54,6 +73,9 @@ void ff_mpadsp_init_altivec(MPADSPContext *s);
 void ff_mpa_synth_init_float(float *window);
 void ff_mpa_synth_init_fixed(int32_t *window);
 
+void ff_init_mpadsp_tabs_float(void);
+void ff_init_mpadsp_tabs_fixed(void);
+
 void ff_mpadsp_apply_window_float(float *synth_buf, float *window,
                                   int *dither_state, float *samples,
                                   int incr);
@@ -61,4 +83,11 @@ void ff_mpadsp_apply_window_fixed(int32_t *synth_buf, int32_t *window,
                                   int *dither_state, int16_t *samples,
                                   int incr);
 
+void ff_imdct36_blocks_float(float *out, float *buf, float *in,
+                             int count, int switch_point, int block_type);
+void ff_imdct36_blocks_fixed(int *out, int *buf, int *in,
+                             int count, int switch_point, int block_type);
+
+void ff_mpadsp_antialias_float(float *ptr, int n, float csa_table[8][4]);
+
 #endif /* AVCODEC_MPEGAUDIODSP_H */
@@ -21,6 +21,7 @@
 #include <stdint.h>
 
 #include "libavutil/mem.h"
+#include "libavutil/mathematics.h"
 #include "dct32.h"
 #include "mathops.h"
 #include "mpegaudiodsp.h"
@@ -203,3 +204,215 @@ void av_cold RENAME(ff_mpa_synth_init)(MPA_INT *window)
         for(j=0; j < 16; j++)
             window[512+128+16*i+j] = window[64*i+48-j];
 }
+
+#if CONFIG_FLOAT
+#   define SHR(a,b)       ((a)*(1.0f/(1<<(b))))
+#   define FIXR(x)        ((float)(x))
+#   define FIXHR(x)       ((float)(x))
+#   define MULH3(x, y, s) ((s)*(y)*(x))
+#   define MULLx(x, y, s) ((y)*(x))
+#else
+#   define SHR(a,b)       ((a)>>(b))
+#   define FIXR(a)        ((int)((a) * FRAC_ONE + 0.5))
+#   define FIXHR(a)       ((int)((a) * (1LL<<32) + 0.5))
+#   define MULH3(x, y, s) MULH((s)*(x), y)
+#   define MULLx(x, y, s) MULL(x,y,s)
+#endif
+
+INTFLOAT RENAME(ff_mdct_win)[8][36];
+
+void av_cold RENAME(ff_init_mpadsp_tabs)(void)
+{
+    int i, j;
+
+    /* compute mdct windows */
+    for(i=0;i<36;i++) {
+        for(j=0; j<4; j++){
+            double d;
+
+            if(j==2 && i%3 != 1)
+                continue;
+
+            d= sin(M_PI * (i + 0.5) / 36.0);
+            if(j==1){
+                if     (i>=30) d= 0;
+                else if(i>=24) d= sin(M_PI * (i - 18 + 0.5) / 12.0);
+                else if(i>=18) d= 1;
+            }else if(j==3){
+                if     (i<  6) d= 0;
+                else if(i< 12) d= sin(M_PI * (i -  6 + 0.5) / 12.0);
+                else if(i< 18) d= 1;
+            }
+            //merge last stage of imdct into the window coefficients
+            d*= 0.5 / cos(M_PI*(2*i + 19)/72);
+
+            if(j==2)
+                RENAME(ff_mdct_win)[j][i/3] = FIXHR((d / (1<<5)));
+            else
+                RENAME(ff_mdct_win)[j][i  ] = FIXHR((d / (1<<5)));
+        }
+    }
+
+    /* NOTE: we do frequency inversion adter the MDCT by changing
+       the sign of the right window coefs */
+    for(j=0;j<4;j++) {
+        for(i=0;i<36;i+=2) {
+            RENAME(ff_mdct_win)[j + 4][i] = RENAME(ff_mdct_win)[j][i];
+            RENAME(ff_mdct_win)[j + 4][i + 1] = -RENAME(ff_mdct_win)[j][i + 1];
+        }
+    }
+}
+
+/* cos(pi*i/18) */
+#define C1 FIXHR(0.98480775301220805936/2)
+#define C2 FIXHR(0.93969262078590838405/2)
+#define C3 FIXHR(0.86602540378443864676/2)
+#define C4 FIXHR(0.76604444311897803520/2)
+#define C5 FIXHR(0.64278760968653932632/2)
+#define C6 FIXHR(0.5/2)
+#define C7 FIXHR(0.34202014332566873304/2)
+#define C8 FIXHR(0.17364817766693034885/2)
+
+/* 0.5 / cos(pi*(2*i+1)/36) */
+static const INTFLOAT icos36[9] = {
+    FIXR(0.50190991877167369479),
+    FIXR(0.51763809020504152469), //0
+    FIXR(0.55168895948124587824),
+    FIXR(0.61038729438072803416),
+    FIXR(0.70710678118654752439), //1
+    FIXR(0.87172339781054900991),
+    FIXR(1.18310079157624925896),
+    FIXR(1.93185165257813657349), //2
+    FIXR(5.73685662283492756461),
+};
+
+/* 0.5 / cos(pi*(2*i+1)/36) */
+static const INTFLOAT icos36h[9] = {
+    FIXHR(0.50190991877167369479/2),
+    FIXHR(0.51763809020504152469/2), //0
+    FIXHR(0.55168895948124587824/2),
+    FIXHR(0.61038729438072803416/2),
+    FIXHR(0.70710678118654752439/2), //1
+    FIXHR(0.87172339781054900991/2),
+    FIXHR(1.18310079157624925896/4),
+    FIXHR(1.93185165257813657349/4), //2
+//    FIXHR(5.73685662283492756461),
+};
+
+/* using Lee like decomposition followed by hand coded 9 points DCT */
+static void imdct36(INTFLOAT *out, INTFLOAT *buf, INTFLOAT *in, INTFLOAT *win)
+{
+    int i, j;
+    INTFLOAT t0, t1, t2, t3, s0, s1, s2, s3;
+    INTFLOAT tmp[18], *tmp1, *in1;
+
+    for(i=17;i>=1;i--)
+        in[i] += in[i-1];
+    for(i=17;i>=3;i-=2)
+        in[i] += in[i-2];
+
+    for(j=0;j<2;j++) {
+        tmp1 = tmp + j;
+        in1 = in + j;
+
+        t2 = in1[2*4] + in1[2*8] - in1[2*2];
+
+        t3 = in1[2*0] + SHR(in1[2*6],1);
+        t1 = in1[2*0] - in1[2*6];
+        tmp1[ 6] = t1 - SHR(t2,1);
+        tmp1[16] = t1 + t2;
+
+        t0 = MULH3(in1[2*2] + in1[2*4] ,    C2, 2);
+        t1 = MULH3(in1[2*4] - in1[2*8] , -2*C8, 1);
+        t2 = MULH3(in1[2*2] + in1[2*8] ,   -C4, 2);
+
+        tmp1[10] = t3 - t0 - t2;
+        tmp1[ 2] = t3 + t0 + t1;
+        tmp1[14] = t3 + t2 - t1;
+
+        tmp1[ 4] = MULH3(in1[2*5] + in1[2*7] - in1[2*1], -C3, 2);
+        t2 = MULH3(in1[2*1] + in1[2*5],    C1, 2);
+        t3 = MULH3(in1[2*5] - in1[2*7], -2*C7, 1);
+        t0 = MULH3(in1[2*3], C3, 2);
+
+        t1 = MULH3(in1[2*1] + in1[2*7],   -C5, 2);
+
+        tmp1[ 0] = t2 + t3 + t0;
+        tmp1[12] = t2 + t1 - t0;
+        tmp1[ 8] = t3 - t1 - t0;
+    }
+
+    i = 0;
+    for(j=0;j<4;j++) {
+        t0 = tmp[i];
+        t1 = tmp[i + 2];
+        s0 = t1 + t0;
+        s2 = t1 - t0;
+
+        t2 = tmp[i + 1];
+        t3 = tmp[i + 3];
+        s1 = MULH3(t3 + t2, icos36h[j], 2);
+        s3 = MULLx(t3 - t2, icos36[8 - j], FRAC_BITS);
+
+        t0 = s0 + s1;
+        t1 = s0 - s1;
+        out[(9 + j)*SBLIMIT] =  MULH3(t1, win[9 + j], 1) + buf[4*(9 + j)];
+        out[(8 - j)*SBLIMIT] =  MULH3(t1, win[8 - j], 1) + buf[4*(8 - j)];
+        buf[4*(9 + j)] = MULH3(t0, win[18 + 9 + j], 1);
+        buf[4*(8 - j)] = MULH3(t0, win[18 + 8 - j], 1);
+
+        t0 = s2 + s3;
+        t1 = s2 - s3;
+        out[(9 + 8 - j)*SBLIMIT] =  MULH3(t1, win[9 + 8 - j], 1) + buf[4*(9 + 8 - j)];
+        out[(        j)*SBLIMIT] =  MULH3(t1, win[        j], 1) + buf[4*(        j)];
+        buf[4*(9 + 8 - j)] = MULH3(t0, win[18 + 9 + 8 - j], 1);
+        buf[4*(      + j)] = MULH3(t0, win[18         + j], 1);
+        i += 4;
+    }
+
+    s0 = tmp[16];
+    s1 = MULH3(tmp[17], icos36h[4], 2);
+    t0 = s0 + s1;
+    t1 = s0 - s1;
+    out[(9 + 4)*SBLIMIT] =  MULH3(t1, win[9 + 4], 1) + buf[4*(9 + 4)];
+    out[(8 - 4)*SBLIMIT] =  MULH3(t1, win[8 - 4], 1) + buf[4*(8 - 4)];
+    buf[4*(9 + 4)] = MULH3(t0, win[18 + 9 + 4], 1);
+    buf[4*(8 - 4)] = MULH3(t0, win[18 + 8 - 4], 1);
+}
+
+void RENAME(ff_imdct36_blocks)(INTFLOAT *out, INTFLOAT *buf, INTFLOAT *in,
+                               int count, int switch_point, int block_type)
+{
+    int j;
+    for (j=0 ; j < count; j++) {
+        /* apply window & overlap with previous buffer */
+
+        /* select window */
+        int win_idx = (switch_point && j < 2) ? 0 : block_type;
+        /* select frequency inversion */
+        INTFLOAT *win = RENAME(ff_mdct_win)[win_idx + (4 & -(j & 1))];
+
+        imdct36(out, buf, in, win);
+
+        in  += 18;
+        buf += ((j&3) != 3 ? 1 : (72-3));
+        out++;
+    }
+}
+
+#if CONFIG_FLOAT
+void ff_mpadsp_antialias_float(float *ptr, int n, float csa_table[8][4])
+{
+    int i, j;
+
+    for (i = n; i > 0; i--) {
+        for (j = 0; j < 8; j++) {
+            float tmp0 = ptr[-1-j];
+            float tmp1 = ptr[   j];
+            ptr[-1-j] = tmp0 * csa_table[j][0] - tmp1 * csa_table[j][1];
+            ptr[   j] = tmp0 * csa_table[j][1] + tmp1 * csa_table[j][0];
+        }
+        ptr += 18;
+    }
+}
+#endif
@@ -34,6 +34,7 @@
 #include "internal.h"
 #include "mpegvideo.h"
 #include "mpegvideo_common.h"
+#include "startcode.h"
 #include "mjpegenc.h"
 #include "msmpeg4.h"
 #include "faandct.h"
@@ -136,14 +137,19 @@ const uint8_t *ff_find_start_code(const uint8_t * restrict p, const uint8_t *end
             return p;
     }
 
-    while(p<end){
-        if     (p[-1] > 1      ) p+= 3;
-        else if(p[-2]          ) p+= 2;
-        else if(p[-3]|(p[-1]-1)) p++;
-        else{
-            p++;
+    /* the start codes ending in the first 3 bytes have been found above */
+    for(p-= 3;;){
+        int n= end - p - 1;
+        int i= ff_startcode_find_zero_pair(p, n);
+        if(i == n){
+            p= end;
+            break;
+        }
+        if(p[i+2] == 1){
+            p+= i + 4;
             break;
         }
+        p+= i + 1;
     }
 
     p= FFMIN(p, end)-4;
@@ -251,16 +257,105 @@ static int alloc_frame_buffer(MpegEncContext *s, Picture *pic)
     return 0;
 }
 
+/**
+ * Detach the pooled tables from a Picture and give them back to the pool.
+ */
+static void release_picture_tables(Picture *pic)
+{
+    PictureTables *t = pic->tables;
+    int i;
+
+    if (!t)
+        return;
+    pic->mbskip_table = NULL;
+    pic->qscale_table = NULL;
+    pic->mb_type_base = NULL;
+    pic->mb_type      = NULL;
+    if (t->has_mv) {
+        for (i = 0; i < 2; i++) {
+            pic->motion_val_base[i] = NULL;
+            pic->motion_val[i]      = NULL;
+            pic->ref_index[i]       = NULL;
+        }
+    }
+    t->in_use   = 0;
+    pic->tables = NULL;
+}
+
+/**
+ * Attach tables from the pool to a Picture, reusing the ones of the
+ * pictures of this context which are not in use anymore.
+ * @param mv_log2 motion_subsample_log2 of the motion vectors to attach,
+ *                0 for none
+ */
+static int alloc_picture_tables(MpegEncContext *s, Picture *pic, int mv_log2)
+{
+    PictureTablePool *pool = s->table_pool;
+    const int big_mb_num    = s->mb_stride*(s->mb_height+1) + 1; //the +1 is needed so memset(,,stride*height) does not sig11
+    const int mb_array_size = s->mb_stride*s->mb_height;
+    const int mv_array_size = mv_log2 == 2 ? s->b4_stride*s->mb_height*4 :
+                                             s->b8_stride*s->mb_height*2;
+    const int mbskip_size   = FFALIGN(mb_array_size * sizeof(uint8_t) + 2, 16); //the +2 is for the slice end check
+    const int qscale_size   = FFALIGN(mb_array_size * sizeof(uint8_t), 16);
+    const int mb_type_size  = FFALIGN((big_mb_num + s->mb_stride) * sizeof(uint32_t), 16);
+    const int mv_size       = FFALIGN(2 * (mv_array_size + 4) * sizeof(int16_t), 16);
+    const int ref_size      = FFALIGN(4 * mb_array_size * sizeof(uint8_t), 16);
+    int size = mbskip_size + qscale_size + mb_type_size + (mv_log2 ? 2 * (mv_size + ref_size) : 0);
+    PictureTables *t = NULL;
+    uint8_t *buf;
+    int i;
+
+    for (i = s->picture_range_start; i < s->picture_range_end; i++)
+        if (!s->picture[i].data[0] && &s->picture[i] != pic)
+            release_picture_tables(&s->picture[i]);
+    release_picture_tables(pic);
+
+    for (i = 0; i < pool->nb_tables; i++) {
+        if (!pool->tables[i].in_use && pool->tables[i].size >= size) {
+            t = &pool->tables[i];
+            break;
+        }
+    }
+    if (!t) {
+        if (pool->nb_tables == pool->max_tables)
+            return -1;
+        t = &pool->tables[pool->nb_tables];
+        FF_ALLOCZ_OR_GOTO(s->avctx, t->buf, size, fail)
+        t->size = size;
+        pool->nb_tables++;
+    }
+    t->in_use = 1;
+    t->has_mv = mv_log2 != 0;
+    pic->tables = t;
+
+    buf = t->buf;
+    pic->mbskip_table = buf;             buf += mbskip_size;
+    pic->qscale_table = buf;             buf += qscale_size;
+    pic->mb_type_base = (uint32_t *)buf; buf += mb_type_size;
+    pic->mb_type      = pic->mb_type_base + 2*s->mb_stride+1;
+    if (mv_log2) {
+        for (i = 0; i < 2; i++) {
+            /* the ones error concealment allocated are not pooled */
+            av_freep(&pic->motion_val_base[i]);
+            av_freep(&pic->ref_index[i]);
+            pic->motion_val_base[i] = (int16_t (*)[2])buf; buf += mv_size;
+            pic->motion_val[i]      = pic->motion_val_base[i]+4;
+            pic->ref_index[i]       = buf;                 buf += ref_size;
+        }
+        pic->motion_subsample_log2 = mv_log2;
+    }
+    return 0;
+fail:
+    return -1;
+}
+
 /**
  * allocates a Picture
  * The pixels are allocated/set by calling get_buffer() if shared=0
  */
 int ff_alloc_picture(MpegEncContext *s, Picture *pic, int shared){
-    const int big_mb_num= s->mb_stride*(s->mb_height+1) + 1; //the +1 is needed so memset(,,stride*height) does not sig11
     const int mb_array_size= s->mb_stride*s->mb_height;
-    const int b8_array_size= s->b8_stride*s->mb_height*2;
-    const int b4_array_size= s->b4_stride*s->mb_height*4;
-    int i;
+    int mv_log2 = 0;
     int r= -1;
 
     if(shared){
@@ -277,38 +372,29 @@ int ff_alloc_picture(MpegEncContext *s, Picture *pic, int shared){
         s->uvlinesize= pic->linesize[1];
     }
 
-    if(pic->qscale_table==NULL){
-        if (s->encoding) {
-            FF_ALLOCZ_OR_GOTO(s->avctx, pic->mb_var   , mb_array_size * sizeof(int16_t)  , fail)
-            FF_ALLOCZ_OR_GOTO(s->avctx, pic->mc_mb_var, mb_array_size * sizeof(int16_t)  , fail)
-            FF_ALLOCZ_OR_GOTO(s->avctx, pic->mb_mean  , mb_array_size * sizeof(int8_t )  , fail)
-        }
+    if (s->encoding && !pic->mb_var) {
+        FF_ALLOCZ_OR_GOTO(s->avctx, pic->mb_var   , mb_array_size * sizeof(int16_t)  , fail)
+        FF_ALLOCZ_OR_GOTO(s->avctx, pic->mc_mb_var, mb_array_size * sizeof(int16_t)  , fail)
+        FF_ALLOCZ_OR_GOTO(s->avctx, pic->mb_mean  , mb_array_size * sizeof(int8_t )  , fail)
+    }
 
-        FF_ALLOCZ_OR_GOTO(s->avctx, pic->mbskip_table , mb_array_size * sizeof(uint8_t)+2, fail) //the +2 is for the slice end check
-        FF_ALLOCZ_OR_GOTO(s->avctx, pic->qscale_table , mb_array_size * sizeof(uint8_t)  , fail)
-        FF_ALLOCZ_OR_GOTO(s->avctx, pic->mb_type_base , (big_mb_num + s->mb_stride) * sizeof(uint32_t), fail)
-        pic->mb_type= pic->mb_type_base + 2*s->mb_stride+1;
-        if(s->out_format == FMT_H264){
-            for(i=0; i<2; i++){
-                FF_ALLOCZ_OR_GOTO(s->avctx, pic->motion_val_base[i], 2 * (b4_array_size+4)  * sizeof(int16_t), fail)
-                pic->motion_val[i]= pic->motion_val_base[i]+4;
-                FF_ALLOCZ_OR_GOTO(s->avctx, pic->ref_index[i], 4*mb_array_size * sizeof(uint8_t), fail)
-            }
-            pic->motion_subsample_log2= 2;
-        }else if(s->out_format == FMT_H263 || s->encoding || (s->avctx->debug&FF_DEBUG_MV) || (s->avctx->debug_mv)){
-            for(i=0; i<2; i++){
-                FF_ALLOCZ_OR_GOTO(s->avctx, pic->motion_val_base[i], 2 * (b8_array_size+4) * sizeof(int16_t), fail)
-                pic->motion_val[i]= pic->motion_val_base[i]+4;
-                FF_ALLOCZ_OR_GOTO(s->avctx, pic->ref_index[i], 4*mb_array_size * sizeof(uint8_t), fail)
-            }
-            pic->motion_subsample_log2= 3;
-        }
-        if(s->avctx->debug&FF_DEBUG_DCT_COEFF) {
-            FF_ALLOCZ_OR_GOTO(s->avctx, pic->dct_coeff, 64 * mb_array_size * sizeof(DCTELEM)*6, fail)
-        }
-        pic->qstride= s->mb_stride;
-        FF_ALLOCZ_OR_GOTO(s->avctx, pic->pan_scan , 1 * sizeof(AVPanScan), fail)
+    /* The motion vectors of hardware decoded H.264 pictures are not
+     * needed unless they are to be visualized. */
+    if(s->out_format == FMT_H264){
+        if (!(s->avctx->hwaccel || s->avctx->codec->capabilities&CODEC_CAP_HWACCEL_VDPAU) ||
+            s->avctx->debug&FF_DEBUG_MV || s->avctx->debug_mv)
+            mv_log2 = 2;
+    }else if(s->out_format == FMT_H263 || s->encoding || (s->avctx->debug&FF_DEBUG_MV) || (s->avctx->debug_mv)){
+        mv_log2 = 3;
     }
+    if (alloc_picture_tables(s, pic, mv_log2) < 0)
+        goto fail;
+    if(s->avctx->debug&FF_DEBUG_DCT_COEFF && !pic->dct_coeff) {
+        FF_ALLOCZ_OR_GOTO(s->avctx, pic->dct_coeff, 64 * mb_array_size * sizeof(DCTELEM)*6, fail)
+    }
+    pic->qstride= s->mb_stride;
+    if (!pic->pan_scan)
+        FF_ALLOCZ_OR_GOTO(s->avctx, pic->pan_scan , 1 * sizeof(AVPanScan), fail)
 
     /* It might be nicer if the application would keep track of these
      * but it would require an API change. */
@@ -316,7 +402,10 @@ int ff_alloc_picture(MpegEncContext *s, Picture *pic, int shared){
     s->prev_pict_types[0]= s->dropable ? AV_PICTURE_TYPE_B : s->pict_type;
     if(pic->age < PREV_PICT_TYPES_BUFFER_SIZE && s->prev_pict_types[pic->age] == AV_PICTURE_TYPE_B)
         pic->age= INT_MAX; // Skipped MBs in B-frames are quite rare in MPEG-1/2 and it is a bit tricky to skip them anyway.
-    pic->owner2 = NULL;
+    /* with frame threading, a non-reference picture is still being returned
+     * to the user while other threads start decoding, so only the thread
+     * which allocated it may release it */
+    pic->owner2 = s;
 
     return 0;
 fail: //for the FF_ALLOCZ_OR_GOTO macro
@@ -335,12 +424,12 @@ static void free_picture(MpegEncContext *s, Picture *pic){
         free_frame_buffer(s, pic);
     }
 
+    /* the pool frees its tables itself */
+    release_picture_tables(pic);
+
     av_freep(&pic->mb_var);
     av_freep(&pic->mc_mb_var);
     av_freep(&pic->mb_mean);
-    av_freep(&pic->mbskip_table);
-    av_freep(&pic->qscale_table);
-    av_freep(&pic->mb_type_base);
     av_freep(&pic->dct_coeff);
     av_freep(&pic->pan_scan);
     pic->mb_type= NULL;
@@ -586,8 +675,10 @@ av_cold int MPV_common_init(MpegEncContext *s)
         return -1;
     }
 
+    threads = s->encoding ? s->avctx->thread_count : ff_thread_slice_count(s->avctx);
+
     if((s->encoding || (s->avctx->active_thread_type & FF_THREAD_SLICE)) &&
-       (s->avctx->thread_count > MAX_THREADS || (s->avctx->thread_count > s->mb_height && s->mb_height))){
+       (threads > MAX_THREADS || (threads > s->mb_height && s->mb_height))){
         av_log(s->avctx, AV_LOG_ERROR, "too many threads\n");
         return -1;
     }
@@ -659,6 +750,19 @@ av_cold int MPV_common_init(MpegEncContext *s)
         s->b_bidir_back_mv_table= s->b_bidir_back_mv_table_base + s->mb_stride + 1;
         s->b_direct_mv_table    = s->b_direct_mv_table_base     + s->mb_stride + 1;
 
+        FF_ALLOCZ_OR_GOTO(s->avctx, s->row_cost, s->mb_height * sizeof(int), fail)
+
+        if(s->avctx->me_presearch){
+            int l1_size= s->mb_width*8 * s->mb_height*8;
+            int l2_size= ((s->mb_width+1)>>1)*8 * ((s->mb_height+1)>>1)*8;
+            for(i=0; i<2; i++){
+                FF_ALLOCZ_OR_GOTO(s->avctx, s->presearch_mv_table_base[i], mv_table_size * 2 * sizeof(int16_t), fail)
+                s->presearch_mv_table[i]= s->presearch_mv_table_base[i] + s->mb_stride + 1;
+            }
+            FF_ALLOCZ_OR_GOTO(s->avctx, s->presearch_level_mv, (s->mb_num + l2_size/64) * 2 * sizeof(int16_t), fail)
+            FF_ALLOCZ_OR_GOTO(s->avctx, s->presearch_buf, 2 * (l1_size + l2_size), fail)
+        }
+
         if(s->msmpeg4_version){
             FF_ALLOCZ_OR_GOTO(s->avctx, s->ac_stats, 2*2*(MAX_LEVEL+1)*(MAX_RUN+1)*2*sizeof(int), fail);
         }
@@ -686,6 +790,13 @@ av_cold int MPV_common_init(MpegEncContext *s)
     for(i = 0; i < s->picture_count; i++) {
         avcodec_get_frame_defaults((AVFrame *)&s->picture[i]);
     }
+    /* frame thread contexts keep the pool copied from the first one */
+    if (!s->table_pool) {
+        FF_ALLOCZ_OR_GOTO(s->avctx, s->table_pool, sizeof(PictureTablePool), fail)
+        s->table_pool->owner = s;
+        FF_ALLOCZ_OR_GOTO(s->avctx, s->table_pool->tables, s->picture_count * sizeof(PictureTables), fail)
+        s->table_pool->max_tables = s->picture_count;
+    }
 
     FF_ALLOCZ_OR_GOTO(s->avctx, s->error_status_table, mb_array_size*sizeof(uint8_t), fail)
 
@@ -746,8 +857,6 @@ av_cold int MPV_common_init(MpegEncContext *s)
     s->thread_context[0]= s;
 
     if (s->encoding || (HAVE_THREADS && s->avctx->active_thread_type&FF_THREAD_SLICE)) {
-        threads = s->avctx->thread_count;
-
         for(i=1; i<threads; i++){
             s->thread_context[i]= av_malloc(sizeof(MpegEncContext));
             memcpy(s->thread_context[i], s, sizeof(MpegEncContext));
@@ -756,8 +865,8 @@ av_cold int MPV_common_init(MpegEncContext *s)
         for(i=0; i<threads; i++){
             if(init_duplicate_context(s->thread_context[i], s) < 0)
                 goto fail;
-            s->thread_context[i]->start_mb_y= (s->mb_height*(i  ) + s->avctx->thread_count/2) / s->avctx->thread_count;
-            s->thread_context[i]->end_mb_y  = (s->mb_height*(i+1) + s->avctx->thread_count/2) / s->avctx->thread_count;
+            s->thread_context[i]->start_mb_y= (s->mb_height*(i  ) + threads/2) / threads;
+            s->thread_context[i]->end_mb_y  = (s->mb_height*(i+1) + threads/2) / threads;
         }
     } else {
         if(init_duplicate_context(s, s) < 0) goto fail;
@@ -778,10 +887,12 @@ void MPV_common_end(MpegEncContext *s)
     int i, j, k;
 
     if (s->encoding || (HAVE_THREADS && s->avctx->active_thread_type&FF_THREAD_SLICE)) {
-        for(i=0; i<s->avctx->thread_count; i++){
+        int threads = s->encoding ? s->avctx->thread_count : ff_thread_slice_count(s->avctx);
+
+        for(i=0; i<threads; i++){
             free_duplicate_context(s->thread_context[i]);
         }
-        for(i=1; i<s->avctx->thread_count; i++){
+        for(i=1; i<threads; i++){
             av_freep(&s->thread_context[i]);
         }
     } else free_duplicate_context(s);
@@ -796,6 +907,14 @@ void MPV_common_end(MpegEncContext *s)
     av_freep(&s->b_bidir_forw_mv_table_base);
     av_freep(&s->b_bidir_back_mv_table_base);
     av_freep(&s->b_direct_mv_table_base);
+    for(i=0; i<2; i++){
+        av_freep(&s->presearch_mv_table_base[i]);
+        s->presearch_mv_table[i]= NULL;
+        s->me.presearch_mv[i]= NULL;
+    }
+    av_freep(&s->presearch_level_mv);
+    av_freep(&s->presearch_buf);
+    av_freep(&s->row_cost);
     s->p_mv_table= NULL;
     s->b_forw_mv_table= NULL;
     s->b_back_mv_table= NULL;
@@ -845,6 +964,13 @@ void MPV_common_end(MpegEncContext *s)
         }
     }
     av_freep(&s->picture);
+    if (s->table_pool && s->table_pool->owner == s) {
+        for (i = 0; i < s->table_pool->nb_tables; i++)
+            av_free(s->table_pool->tables[i].buf);
+        av_free(s->table_pool->tables);
+        av_free(s->table_pool);
+    }
+    s->table_pool = NULL;
     s->context_initialized = 0;
     s->last_picture_ptr=
     s->next_picture_ptr=
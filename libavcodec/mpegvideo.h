@@ -78,6 +78,30 @@ enum OutputFormat {
 
 struct MpegEncContext;
 
+/**
+ * One block holding the per-MB tables of a Picture (mbskip_table,
+ * qscale_table, mb_type and optionally motion_val and ref_index).
+ * The blocks are recycled between the pictures through PictureTablePool.
+ */
+typedef struct PictureTables {
+    uint8_t *buf;
+    int size;                   ///< size of buf
+    int in_use;                 ///< attached to a Picture
+    int has_mv;                 ///< motion_val and ref_index are attached
+} PictureTables;
+
+/**
+ * Pool of PictureTables, shared by the frame thread contexts of a decoder.
+ * Tables are only attached and released while a context sets up a frame,
+ * which the frame threads do one after the other.
+ */
+typedef struct PictureTablePool {
+    PictureTables *tables;
+    int nb_tables;
+    int max_tables;
+    struct MpegEncContext *owner; ///< context which allocated the pool and frees it
+} PictureTablePool;
+
 /**
  * Picture.
  */
@@ -135,6 +159,7 @@ typedef struct Picture{
     int32_t *mb_cmp_score;      ///< Table for MB cmp scores, for mb decision FIXME remove
     int b_frame_score;          /* */
     struct MpegEncContext *owner2; ///< pointer to the MpegEncContext that allocated this picture
+    PictureTables *tables;      ///< tables from the pool, NULL if not attached
 } Picture;
 
 /**
@@ -165,7 +190,9 @@ typedef struct MotionEstContext{
     int sub_flags;
     int mb_flags;
     int pre_pass;                      ///< = 1 for the pre pass
+    int16_t (*presearch_mv[2])[2];     ///< full-pel MVs of the low resolution pre-search for the forward and backward reference, NULL if not done
     int dia_size;
+    me_cmp_x4_func *me_cmp_x4;         ///< dsp.sad_x4 if me_cmp is plain SAD, NULL otherwise
     int xmin;
     int xmax;
     int ymin;
@@ -296,6 +323,7 @@ typedef struct MpegEncContext {
     Picture *current_picture_ptr;  ///< pointer to the current picture
     int picture_count;             ///< number of allocated pictures (MAX_PICTURE_COUNT * avctx->thread_count)
     int picture_range_start, picture_range_end; ///< the part of picture that this context can allocate in
+    PictureTablePool *table_pool;  ///< per-MB tables of the pictures, shared with the frame thread contexts
     uint8_t *visualization_buffer[3]; //< temporary buffer vor MV visualization
     int last_dc[3];                ///< last DC values for MPEG1
     int16_t *dc_val_base;
@@ -360,6 +388,11 @@ typedef struct MpegEncContext {
     int16_t (*b_bidir_forw_mv_table)[2]; ///< MV table (1MV per MB) bidir mode b-frame encoding
     int16_t (*b_bidir_back_mv_table)[2]; ///< MV table (1MV per MB) bidir mode b-frame encoding
     int16_t (*b_direct_mv_table)[2];     ///< MV table (1MV per MB) direct mode b-frame encoding
+    int16_t (*presearch_mv_table_base[2])[2];
+    int16_t (*presearch_mv_table[2])[2]; ///< MV table (1MV per MB) of the low resolution pre-search
+    int16_t (*presearch_level_mv)[2];    ///< MVs of the blocks of the pyramid levels
+    uint8_t *presearch_buf;              ///< downscaled luma of the current picture and a reference
+    int *row_cost;                       ///< bits and work of each MB row of the last coded picture
     int16_t (*p_field_mv_table[2][2])[2];   ///< MV table (2MV per MB) interlaced p-frame encoding
     int16_t (*b_field_mv_table[2][2][2])[2];///< MV table (4MV per MB) interlaced b-frame encoding
     uint8_t (*p_field_select_table[2]);
@@ -780,6 +813,7 @@ void ff_fix_long_mvs(MpegEncContext * s, uint8_t *field_select_table, int field_
                      int16_t (*mv_table)[2], int f_code, int type, int truncate);
 int ff_init_me(MpegEncContext *s);
 int ff_pre_estimate_p_frame_motion(MpegEncContext * s, int mb_x, int mb_y);
+void ff_me_presearch(MpegEncContext *s);
 int ff_epzs_motion_search(MpegEncContext * s, int *mx_ptr, int *my_ptr,
                              int P[10][2], int src_index, int ref_index, int16_t (*last_mv)[2],
                              int ref_mv_scale, int size, int h);
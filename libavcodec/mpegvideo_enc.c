@@ -57,6 +57,10 @@ static int dct_quantize_trellis_c(MpegEncContext *s, DCTELEM *block, int n, int
 
 //#define DEBUG
 
+/* cost of a MB besides its bits, mostly motion estimation, for balancing
+ * the slices of the threads */
+#define ROW_COST_PER_MB 64
+
 static uint8_t default_mv_penalty[MAX_FCODE+1][MAX_MV*2+1];
 static uint8_t default_fcode_tab[MAX_MV*2+1];
 
@@ -941,14 +945,70 @@ static int skip_check(MpegEncContext *s, Picture *p, Picture *ref){
     return 0;
 }
 
+typedef struct BCountCandidate {
+    AVCodecContext *c;
+    AVFrame input[FF_MAX_B_FRAMES+2];
+    uint8_t *outbuf;
+    int outbuf_size;
+    int b_count;
+    int max_b_frames;
+    int p_lambda, b_lambda, lambda2;
+    int64_t rd;
+} BCountCandidate;
+
+/**
+ * Encode the downscaled pictures with b_count B-frames between the
+ * P-frames and compute the rate distortion of that structure.
+ */
+static int estimate_b_count_thread(AVCodecContext *avctx, void *arg){
+    BCountCandidate *b= arg;
+    AVCodecContext *c= b->c;
+    AVFrame *input= b->input;
+    int i, out_size;
+    int64_t rd=0;
+
+    c->error[0]= c->error[1]= c->error[2]= 0;
+
+    input[0].pict_type= AV_PICTURE_TYPE_I;
+    input[0].quality= 1 * FF_QP2LAMBDA;
+    out_size = avcodec_encode_video(c, b->outbuf, b->outbuf_size, &input[0]);
+//    rd += (out_size * b->lambda2) >> FF_LAMBDA_SHIFT;
+
+    for(i=0; i<b->max_b_frames+1; i++){
+        int is_p= i % (b->b_count+1) == b->b_count || i==b->max_b_frames;
+
+        input[i+1].pict_type= is_p ? AV_PICTURE_TYPE_P : AV_PICTURE_TYPE_B;
+        input[i+1].quality= is_p ? b->p_lambda : b->b_lambda;
+        out_size = avcodec_encode_video(c, b->outbuf, b->outbuf_size, &input[i+1]);
+        rd += (out_size * b->lambda2) >> (FF_LAMBDA_SHIFT - 3);
+    }
+
+    /* get the delayed frames */
+    while(out_size){
+        out_size = avcodec_encode_video(c, b->outbuf, b->outbuf_size, NULL);
+        rd += (out_size * b->lambda2) >> (FF_LAMBDA_SHIFT - 3);
+    }
+
+    rd += c->error[0] + c->error[1] + c->error[2];
+    b->rd= rd;
+
+    return 0;
+}
+
+/**
+ * Choose the number of B-frames by encoding the downscaled input pictures
+ * with every candidate count. Each candidate has its own encoder, so the
+ * candidates are encoded in parallel on the slice threads.
+ * @return the best number of B-frames or -1 on error
+ */
 static int estimate_best_b_count(MpegEncContext *s){
     AVCodec *codec= avcodec_find_encoder(s->avctx->codec_id);
-    AVCodecContext *c= avcodec_alloc_context();
     AVFrame input[FF_MAX_B_FRAMES+2];
+    BCountCandidate *cand;
     const int scale= s->avctx->brd_scale;
-    int i, j, out_size, p_lambda, b_lambda, lambda2;
-    int outbuf_size= s->width * s->height; //FIXME
-    uint8_t *outbuf= av_malloc(outbuf_size);
+    const int width = s->width >> scale;
+    const int height= s->height>> scale;
+    int i, j, p_lambda, b_lambda, lambda2, nb_cand;
     int64_t best_rd= INT64_MAX;
     int best_b_count= -1;
 
@@ -960,33 +1020,30 @@ static int estimate_best_b_count(MpegEncContext *s){
     if(!b_lambda) b_lambda= p_lambda; //FIXME we should do this somewhere else
     lambda2= (b_lambda*b_lambda + (1<<FF_LAMBDA_SHIFT)/2 ) >> FF_LAMBDA_SHIFT;
 
-    c->width = s->width >> scale;
-    c->height= s->height>> scale;
-    c->flags= CODEC_FLAG_QSCALE | CODEC_FLAG_PSNR | CODEC_FLAG_INPUT_PRESERVED /*| CODEC_FLAG_EMU_EDGE*/;
-    c->flags|= s->avctx->flags & CODEC_FLAG_QPEL;
-    c->mb_decision= s->avctx->mb_decision;
-    c->me_cmp= s->avctx->me_cmp;
-    c->mb_cmp= s->avctx->mb_cmp;
-    c->me_sub_cmp= s->avctx->me_sub_cmp;
-    c->pix_fmt = PIX_FMT_YUV420P;
-    c->time_base= s->avctx->time_base;
-    c->max_b_frames= s->max_b_frames;
-
-    if (avcodec_open(c, codec) < 0)
+    for(nb_cand=0; nb_cand<s->max_b_frames+1; nb_cand++)
+        if(!s->input_picture[nb_cand])
+            break;
+    if(!nb_cand)
+        return -1;
+
+    cand= av_mallocz(nb_cand * sizeof(*cand));
+    if(!cand)
         return -1;
 
     for(i=0; i<s->max_b_frames+2; i++){
-        int ysize= c->width*c->height;
-        int csize= (c->width/2)*(c->height/2);
+        int ysize= width*height;
+        int csize= (width/2)*(height/2);
         Picture pre_input, *pre_input_ptr= i ? s->input_picture[i-1] : s->next_picture_ptr;
 
         avcodec_get_frame_defaults(&input[i]);
-        input[i].data[0]= av_malloc(ysize + 2*csize);
+        input[i].data[0]= av_mallocz(ysize + 2*csize);
+        if(!input[i].data[0])
+            goto end;
         input[i].data[1]= input[i].data[0] + ysize;
         input[i].data[2]= input[i].data[1] + csize;
-        input[i].linesize[0]= c->width;
+        input[i].linesize[0]= width;
         input[i].linesize[1]=
-        input[i].linesize[2]= c->width/2;
+        input[i].linesize[2]= width/2;
 
         if(pre_input_ptr && (!i || s->input_picture[i-1])) {
             pre_input= *pre_input_ptr;
@@ -997,54 +1054,70 @@ static int estimate_best_b_count(MpegEncContext *s){
                 pre_input.data[2]+=INPLACE_OFFSET;
             }
 
-            s->dsp.shrink[scale](input[i].data[0], input[i].linesize[0], pre_input.data[0], pre_input.linesize[0], c->width, c->height);
-            s->dsp.shrink[scale](input[i].data[1], input[i].linesize[1], pre_input.data[1], pre_input.linesize[1], c->width>>1, c->height>>1);
-            s->dsp.shrink[scale](input[i].data[2], input[i].linesize[2], pre_input.data[2], pre_input.linesize[2], c->width>>1, c->height>>1);
+            s->dsp.shrink[scale](input[i].data[0], input[i].linesize[0], pre_input.data[0], pre_input.linesize[0], width, height);
+            s->dsp.shrink[scale](input[i].data[1], input[i].linesize[1], pre_input.data[1], pre_input.linesize[1], width>>1, height>>1);
+            s->dsp.shrink[scale](input[i].data[2], input[i].linesize[2], pre_input.data[2], pre_input.linesize[2], width>>1, height>>1);
+        }
+    }
+
+    /* the encoders are opened here, avcodec_open() must not run in parallel */
+    for(j=0; j<nb_cand; j++){
+        BCountCandidate *b= &cand[j];
+        AVCodecContext *c;
+
+        b->c= c= avcodec_alloc_context();
+        if(!c)
+            goto end;
+        c->width = width;
+        c->height= height;
+        c->flags= CODEC_FLAG_QSCALE | CODEC_FLAG_PSNR | CODEC_FLAG_INPUT_PRESERVED /*| CODEC_FLAG_EMU_EDGE*/;
+        c->flags|= s->avctx->flags & CODEC_FLAG_QPEL;
+        c->mb_decision= s->avctx->mb_decision;
+        c->me_cmp= s->avctx->me_cmp;
+        c->mb_cmp= s->avctx->mb_cmp;
+        c->me_sub_cmp= s->avctx->me_sub_cmp;
+        c->pix_fmt = PIX_FMT_YUV420P;
+        c->time_base= s->avctx->time_base;
+        c->max_b_frames= s->max_b_frames;
+        c->me_presearch= s->avctx->me_presearch;
+
+        if (avcodec_open(c, codec) < 0)
+            goto end;
+
+        b->outbuf_size= s->width * s->height; //FIXME
+        b->outbuf= av_malloc(b->outbuf_size);
+        if(!b->outbuf)
+            goto end;
+        /* the frames share the picture data, only the types differ */
+        memcpy(b->input, input, sizeof(input));
+        b->b_count= j;
+        b->max_b_frames= s->max_b_frames;
+        b->p_lambda= p_lambda;
+        b->b_lambda= b_lambda;
+        b->lambda2= lambda2;
+    }
+
+    s->avctx->execute(s->avctx, estimate_b_count_thread, cand, NULL, nb_cand, sizeof(*cand));
+
+    for(j=0; j<nb_cand; j++){
+        if(cand[j].rd < best_rd){
+            best_rd= cand[j].rd;
+            best_b_count= j;
         }
     }
 
-    for(j=0; j<s->max_b_frames+1; j++){
-        int64_t rd=0;
-
-        if(!s->input_picture[j])
-            break;
-
-        c->error[0]= c->error[1]= c->error[2]= 0;
-
-        input[0].pict_type= AV_PICTURE_TYPE_I;
-        input[0].quality= 1 * FF_QP2LAMBDA;
-        out_size = avcodec_encode_video(c, outbuf, outbuf_size, &input[0]);
-//        rd += (out_size * lambda2) >> FF_LAMBDA_SHIFT;
-
-        for(i=0; i<s->max_b_frames+1; i++){
-            int is_p= i % (j+1) == j || i==s->max_b_frames;
-
-            input[i+1].pict_type= is_p ? AV_PICTURE_TYPE_P : AV_PICTURE_TYPE_B;
-            input[i+1].quality= is_p ? p_lambda : b_lambda;
-            out_size = avcodec_encode_video(c, outbuf, outbuf_size, &input[i+1]);
-            rd += (out_size * lambda2) >> (FF_LAMBDA_SHIFT - 3);
-        }
-
-        /* get the delayed frames */
-        while(out_size){
-            out_size = avcodec_encode_video(c, outbuf, outbuf_size, NULL);
-            rd += (out_size * lambda2) >> (FF_LAMBDA_SHIFT - 3);
-        }
-
-        rd += c->error[0] + c->error[1] + c->error[2];
-
-        if(rd < best_rd){
-            best_rd= rd;
-            best_b_count= j;
+end:
+    for(j=0; j<nb_cand; j++){
+        av_freep(&cand[j].outbuf);
+        if(cand[j].c){
+            avcodec_close(cand[j].c);
+            av_freep(&cand[j].c);
         }
     }
+    av_free(cand);
 
-    av_freep(&outbuf);
-    avcodec_close(c);
-    av_freep(&c);
-
-    for(i=0; i<s->max_b_frames+2; i++){
-        av_freep(&input[i].data[0]);
+    for(; i>0; i--){
+        av_freep(&input[i-1].data[0]);
     }
 
     return best_b_count;
@@ -1128,6 +1201,8 @@ static int select_input_picture(MpegEncContext *s){
                 }
             }else if(s->avctx->b_frame_strategy==2){
                 b_frames= estimate_best_b_count(s);
+                if(b_frames < 0)
+                    return -1;
             }else{
                 av_log(s->avctx, AV_LOG_ERROR, "illegal b frame strategy\n");
                 b_frames=0;
@@ -1221,19 +1296,66 @@ no_output_pic:
     return 0;
 }
 
+/**
+ * Move the boundaries between the slices of the threads so that each
+ * slice gets about the same share of the cost of the last coded picture.
+ * @return the cost of the last coded picture, 0 if there is none
+ */
+static int64_t balance_slices(MpegEncContext *s, int context_count){
+    int64_t total= 0, sum= 0;
+    int i, y;
+
+    for(y=0; y<s->mb_height; y++)
+        total+= s->row_cost[y];
+    if(!total)
+        return 0;
+
+    y= 0;
+    for(i=1; i<context_count; i++){
+        int64_t target= total*i/context_count;
+        int min_y= s->thread_context[i-1]->start_mb_y + 1;
+        int max_y= s->mb_height - (context_count - i);
+
+        while(y < max_y && (y < min_y || sum + s->row_cost[y]/2 < target))
+            sum+= s->row_cost[y++];
+        s->thread_context[i-1]->end_mb_y=
+        s->thread_context[i  ]->start_mb_y= y;
+    }
+    return total;
+}
+
+/**
+ * @return the offset in the output buffer of the slice starting at MB row y
+ */
+static int64_t slice_buffer_offset(MpegEncContext *s, int y, int64_t buf_size, int64_t total_cost){
+    int64_t cost= 0;
+    int i;
+
+    if(!total_cost)
+        return buf_size*y/s->mb_height;
+    /* half by rows and half by cost, so that no slice gets too little
+     * space when the content changes */
+    for(i=0; i<y; i++)
+        cost+= s->row_cost[i];
+    return (buf_size*y/s->mb_height + buf_size*cost/total_cost)/2;
+}
+
 int MPV_encode_picture(AVCodecContext *avctx,
                        unsigned char *buf, int buf_size, void *data)
 {
     MpegEncContext *s = avctx->priv_data;
     AVFrame *pic_arg = data;
     int i, stuffing_count, context_count = avctx->thread_count;
+    int64_t total_cost= 0;
+
+    if(context_count > 1 && (s->flags2 & CODEC_FLAG2_BALANCED_SLICES))
+        total_cost= balance_slices(s, context_count);
 
     for(i=0; i<context_count; i++){
         int start_y= s->thread_context[i]->start_mb_y;
         int   end_y= s->thread_context[i]->  end_mb_y;
-        int h= s->mb_height;
-        uint8_t *start= buf + (size_t)(((int64_t) buf_size)*start_y/h);
-        uint8_t *end  = buf + (size_t)(((int64_t) buf_size)*  end_y/h);
+        uint8_t *start= buf + (size_t)slice_buffer_offset(s, start_y, buf_size, total_cost);
+        uint8_t *end  = buf + (size_t)slice_buffer_offset(s,   end_y, buf_size, total_cost);
 
         init_put_bits(&s->thread_context[i]->pb, start, end - start);
     }
@@ -1992,13 +2114,19 @@ static int estimate_motion_thread(AVCodecContext *c, void *arg){
     return 0;
 }
 
-static int mb_var_thread(AVCodecContext *c, void *arg){
-    MpegEncContext *s= *(void**)arg;
-    int mb_x, mb_y;
+/**
+ * Compute the spatial complexity of MB row jobnr. The rows do not depend
+ * on each other, so they are handed out one by one to whichever thread is
+ * free and the sums are kept in the context of that thread.
+ */
+static int mb_var_thread(AVCodecContext *c, void *arg, int jobnr, int threadnr){
+    MpegEncContext *s= ((MpegEncContext**)arg)[threadnr];
+    const int mb_y= jobnr;
+    int mb_x;
 
     ff_check_alignment();
 
-    for(mb_y=s->start_mb_y; mb_y < s->end_mb_y; mb_y++) {
+    {
         for(mb_x=0; mb_x < s->mb_width; mb_x++) {
             int xx = mb_x * 16;
             int yy = mb_y * 16;
@@ -2016,6 +2144,14 @@ static int mb_var_thread(AVCodecContext *c, void *arg){
     return 0;
 }
 
+static int total_bits_count(MpegEncContext *s){
+    int bits= put_bits_count(&s->pb);
+
+    if(s->data_partitioning)
+        bits+= put_bits_count(&s->pb2) + put_bits_count(&s->tex_pb);
+    return bits;
+}
+
 static void write_slice_end(MpegEncContext *s){
     if(CONFIG_MPEG4_ENCODER && s->codec_id==CODEC_ID_MPEG4){
         if(s->partitioned_frame){
@@ -2094,6 +2230,7 @@ static int encode_thread(AVCodecContext *c, void *arg){
     s->first_slice_line = 1;
     s->ptr_lastgob = s->pb.buf;
     for(mb_y= s->start_mb_y; mb_y < s->end_mb_y; mb_y++) {
+        int row_start_bits= total_bits_count(s);
 //    printf("row %d at %X\n", s->mb_y, (int)s);
         s->mb_x=0;
         s->mb_y= mb_y;
@@ -2644,6 +2781,7 @@ static int encode_thread(AVCodecContext *c, void *arg){
             }
 //printf("MB %d %d bits\n", s->mb_x+s->mb_y*s->mb_stride, put_bits_count(&s->pb));
         }
+        s->row_cost[mb_y]= total_bits_count(s) - row_start_bits + s->mb_width*ROW_COST_PER_MB;
     }
 
     //not beautiful here but we must write it before flushing so it has to be here
@@ -2799,6 +2937,7 @@ static int encode_picture(MpegEncContext *s, int picture_number)
     }
 
     s->mb_intra=0; //for the rate distortion & bit compare functions
+    ff_me_presearch(s);
     for(i=1; i<context_count; i++){
         ff_update_duplicate_context(s->thread_context[i], s);
     }
@@ -2824,7 +2963,7 @@ static int encode_picture(MpegEncContext *s, int picture_number)
 
         if(!s->fixed_qscale){
             /* finding spatial complexity for I-frame rate control */
-            s->avctx->execute(s->avctx, mb_var_thread, &s->thread_context[0], NULL, context_count, sizeof(void*));
+            s->avctx->execute2(s->avctx, mb_var_thread, &s->thread_context[0], NULL, s->mb_height);
         }
     }
     for(i=1; i<context_count; i++){
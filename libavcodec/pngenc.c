@@ -22,6 +22,7 @@
 #include "bytestream.h"
 #include "dsputil.h"
 #include "png.h"
+#include "thread.h"
 
 /* TODO:
  * - add 2, 4 and 16 bit depth support
@@ -33,6 +34,22 @@
 
 #define IOBUF_SIZE 4096
 
+/* minimum number of rows of a slice */
+#define MIN_SLICE_ROWS 16
+
+/**
+ * Band of rows compressed on its own thread, as raw deflate data which
+ * ends on a byte boundary so that the slices can be concatenated.
+ */
+typedef struct PNGEncSlice {
+    z_stream zstream;
+    uint8_t *buf;
+    unsigned int buf_size;
+    int len;                    ///< size of the compressed data in buf
+    uint32_t adler;             ///< adler32 of the uncompressed data
+    int error;
+} PNGEncSlice;
+
 typedef struct PNGEncContext {
     DSPContext dsp;
 
@@ -45,6 +62,14 @@ typedef struct PNGEncContext {
 
     z_stream zstream;
     uint8_t buf[IOBUF_SIZE];
+
+    PNGEncSlice *slices;
+    int max_slices;
+    int nb_slices;              ///< number of slices of the current frame
+    int compression_level;
+    int color_type;
+    int bits_per_pixel;
+    int row_size;
 } PNGEncContext;
 
 static void png_get_interlaced_row(uint8_t *dst, int row_size,
@@ -85,33 +110,6 @@ static void png_get_interlaced_row(uint8_t *dst, int row_size,
     }
 }
 
-static void sub_png_paeth_prediction(uint8_t *dst, uint8_t *src, uint8_t *top, int w, int bpp)
-{
-    int i;
-    for(i = 0; i < w; i++) {
-        int a, b, c, p, pa, pb, pc;
-
-        a = src[i - bpp];
-        b = top[i];
-        c = top[i - bpp];
-
-        p = b - c;
-        pc = a - c;
-
-        pa = abs(p);
-        pb = abs(pc);
-        pc = abs(p + pc);
-
-        if (pa <= pb && pa <= pc)
-            p = a;
-        else if (pb <= pc)
-            p = b;
-        else
-            p = c;
-        dst[i] = src[i] - p;
-    }
-}
-
 static void png_filter_row(DSPContext *dsp, uint8_t *dst, int filter_type,
                            uint8_t *src, uint8_t *top, int size, int bpp)
 {
@@ -137,7 +135,7 @@ static void png_filter_row(DSPContext *dsp, uint8_t *dst, int filter_type,
     case PNG_FILTER_VALUE_PAETH:
         for(i = 0; i < bpp; i++)
             dst[i] = src[i] - top[i];
-        sub_png_paeth_prediction(dst+i, src+i, top+i, size-i, bpp);
+        dsp->sub_png_paeth_prediction(dst+i, src+i, top+i, size-i, bpp);
         break;
     }
 }
@@ -229,6 +227,171 @@ static int png_write_row(PNGEncContext *s, const uint8_t *data, int size)
     return 0;
 }
 
+/**
+ * Compress the data in the input of the zstream of the slice, growing the
+ * output buffer as needed.
+ */
+static int deflate_slice(PNGEncSlice *sl, int flush)
+{
+    int ret;
+
+    do {
+        uint8_t *buf = av_fast_realloc(sl->buf, &sl->buf_size, sl->len + IOBUF_SIZE);
+        if (!buf)
+            return -1;
+        sl->buf = buf;
+        sl->zstream.next_out  = sl->buf + sl->len;
+        sl->zstream.avail_out = sl->buf_size - sl->len;
+        ret = deflate(&sl->zstream, flush);
+        sl->len = sl->zstream.next_out - sl->buf;
+        if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR)
+            return -1;
+    } while (flush == Z_NO_FLUSH ? sl->zstream.avail_in :
+             flush == Z_FINISH   ? ret != Z_STREAM_END :
+                                   !sl->zstream.avail_out);
+    return 0;
+}
+
+static int encode_slice_rows(AVCodecContext *avctx, PNGEncSlice *sl, int jobnr,
+                             uint8_t *crow_buf, uint8_t *rgba_buf, uint8_t *top_buf,
+                             uint8_t *dict)
+{
+    PNGEncContext *s = avctx->priv_data;
+    AVFrame * const p = &s->picture;
+    int y_start = avctx->height *  jobnr      / s->nb_slices;
+    int y_end   = avctx->height * (jobnr + 1) / s->nb_slices;
+    int crow_size = s->row_size + 1;
+    int y, y0, dict_len = 0;
+    uint8_t *ptr, *top = NULL, *crow;
+
+    /* The rows just before the slice are filtered again and used as the
+     * dictionary, so that the slices compress nearly as well as a single
+     * stream. */
+    y0 = FFMAX(y_start - (32768 + crow_size - 1) / crow_size, 0);
+    for (y = FFMAX(y0 - 1, 0); y < y_end; y++) {
+        ptr = p->data[0] + y * p->linesize[0];
+        if (s->color_type == PNG_COLOR_TYPE_RGB_ALPHA) {
+            FFSWAP(uint8_t*, rgba_buf, top_buf);
+            convert_from_rgb32(rgba_buf, ptr, avctx->width);
+            ptr = rgba_buf;
+        }
+        if (y >= y0) {
+            crow = png_choose_filter(s, crow_buf, ptr, top, s->row_size, s->bits_per_pixel>>3);
+            if (y < y_start) {
+                memcpy(dict + dict_len, crow, crow_size);
+                dict_len += crow_size;
+                if (y == y_start - 1) {
+                    int size = FFMIN(dict_len, 32768);
+                    if (deflateSetDictionary(&sl->zstream, dict + dict_len - size, size) != Z_OK)
+                        return -1;
+                }
+            } else {
+                sl->adler = adler32(sl->adler, crow, crow_size);
+                sl->zstream.next_in  = crow;
+                sl->zstream.avail_in = crow_size;
+                if (deflate_slice(sl, Z_NO_FLUSH) < 0)
+                    return -1;
+            }
+        }
+        top = ptr;
+    }
+    return deflate_slice(sl, jobnr == s->nb_slices - 1 ? Z_FINISH : Z_SYNC_FLUSH);
+}
+
+static int encode_slice(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    PNGEncContext *s = avctx->priv_data;
+    PNGEncSlice *sl = s->slices + jobnr;
+    uint8_t *crow_base, *rgba_buf = NULL, *top_buf = NULL, *dict = NULL;
+    int crow_size = s->row_size + 1;
+
+    sl->error = -1;
+    sl->len   = 0;
+    sl->adler = adler32(0, Z_NULL, 0);
+    sl->zstream.zalloc = ff_png_zalloc;
+    sl->zstream.zfree  = ff_png_zfree;
+    sl->zstream.opaque = NULL;
+    if (deflateInit2(&sl->zstream, s->compression_level,
+                     Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return -1;
+
+    crow_base = av_malloc((s->row_size + 32) << (s->filter_type == PNG_FILTER_VALUE_MIXED));
+    dict      = av_malloc((32768 / crow_size + 1) * crow_size);
+    if (s->color_type == PNG_COLOR_TYPE_RGB_ALPHA) {
+        rgba_buf = av_malloc(crow_size);
+        top_buf  = av_malloc(crow_size);
+    }
+    if (crow_base && dict &&
+        (s->color_type != PNG_COLOR_TYPE_RGB_ALPHA || (rgba_buf && top_buf))) {
+        /* the first slice starts with the zlib header */
+        if (!jobnr) {
+            int level = s->compression_level == Z_DEFAULT_COMPRESSION ? 6 : s->compression_level;
+            int flevel = level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+            unsigned int header = (Z_DEFLATED + (7 << 4)) << 8 | flevel << 6;
+
+            uint8_t *buf;
+
+            header += 31 - header % 31;
+            buf = av_fast_realloc(sl->buf, &sl->buf_size, IOBUF_SIZE);
+            if (buf) {
+                sl->buf = buf;
+                AV_WB16(sl->buf, header);
+                sl->len = 2;
+            }
+        }
+        if (sl->len || jobnr)
+            sl->error = encode_slice_rows(avctx, sl, jobnr, crow_base + 15, rgba_buf, top_buf, dict);
+    }
+
+    av_free(crow_base);
+    av_free(dict);
+    av_free(rgba_buf);
+    av_free(top_buf);
+    deflateEnd(&sl->zstream);
+    return sl->error;
+}
+
+/**
+ * Write the image data compressed in parallel slices.
+ */
+static int encode_slices(AVCodecContext *avctx)
+{
+    PNGEncContext *s = avctx->priv_data;
+    PNGEncSlice *last = s->slices + s->nb_slices - 1;
+    uint32_t adler = adler32(0, Z_NULL, 0);
+    uint8_t *buf;
+    int i, pos;
+
+    avctx->execute2(avctx, encode_slice, NULL, NULL, s->nb_slices);
+
+    for (i = 0; i < s->nb_slices; i++) {
+        PNGEncSlice *sl = s->slices + i;
+        int rows = avctx->height * (i + 1) / s->nb_slices - avctx->height * i / s->nb_slices;
+
+        if (sl->error < 0)
+            return -1;
+        adler = adler32_combine(adler, sl->adler, rows * (s->row_size + 1));
+    }
+    if (!(buf = av_fast_realloc(last->buf, &last->buf_size, last->len + 4)))
+        return -1;
+    last->buf = buf;
+    AV_WB32(last->buf + last->len, adler);
+    last->len += 4;
+
+    for (i = 0; i < s->nb_slices; i++) {
+        PNGEncSlice *sl = s->slices + i;
+        for (pos = 0; pos < sl->len; pos += IOBUF_SIZE) {
+            int len = FFMIN(sl->len - pos, IOBUF_SIZE);
+            if (s->bytestream_end - s->bytestream < len + 12 + 100) {
+                av_log(avctx, AV_LOG_ERROR, "encoded frame too large\n");
+                return -1;
+            }
+            png_write_chunk(&s->bytestream, MKTAG('I', 'D', 'A', 'T'), sl->buf + pos, len);
+        }
+    }
+    return 0;
+}
+
 static int encode_frame(AVCodecContext *avctx, unsigned char *buf, int buf_size, void *data){
     PNGEncContext *s = avctx->priv_data;
     AVFrame *pict = data;
@@ -278,12 +441,18 @@ static int encode_frame(AVCodecContext *avctx, unsigned char *buf, int buf_size,
     bits_per_pixel = ff_png_get_nb_channels(color_type) * bit_depth;
     row_size = (avctx->width * bits_per_pixel + 7) >> 3;
 
+    s->color_type     = color_type;
+    s->bits_per_pixel = bits_per_pixel;
+    s->row_size       = row_size;
+    s->nb_slices      = is_progressive ? 1 : FFMIN(s->max_slices, avctx->height / MIN_SLICE_ROWS);
+
     s->zstream.zalloc = ff_png_zalloc;
     s->zstream.zfree = ff_png_zfree;
     s->zstream.opaque = NULL;
     compression_level = avctx->compression_level == FF_COMPRESSION_DEFAULT ?
                             Z_DEFAULT_COMPRESSION :
                             av_clip(avctx->compression_level, 0, 9);
+    s->compression_level = compression_level;
     ret = deflateInit2(&s->zstream, compression_level,
                        Z_DEFLATED, 15, 8, Z_DEFAULT_STRATEGY);
     if (ret != Z_OK)
@@ -348,6 +517,11 @@ static int encode_frame(AVCodecContext *avctx, unsigned char *buf, int buf_size,
     }
 
     /* now put each row */
+    if (s->nb_slices > 1) {
+        if (encode_slices(avctx) < 0)
+            goto fail;
+        goto write_end;
+    }
     s->zstream.avail_out = IOBUF_SIZE;
     s->zstream.next_out = s->buf;
     if (is_progressive) {
@@ -407,6 +581,7 @@ static int encode_frame(AVCodecContext *avctx, unsigned char *buf, int buf_size,
             goto fail;
         }
     }
+ write_end:
     png_write_chunk(&s->bytestream, MKTAG('I', 'E', 'N', 'D'), NULL, 0);
 
     ret = s->bytestream - s->bytestream_start;
@@ -433,6 +608,24 @@ static av_cold int png_enc_init(AVCodecContext *avctx){
     if(avctx->pix_fmt == PIX_FMT_MONOBLACK)
         s->filter_type = PNG_FILTER_VALUE_NONE;
 
+    s->max_slices = ff_thread_slice_count(avctx);
+    if (s->max_slices > 1) {
+        s->slices = av_mallocz(s->max_slices * sizeof(*s->slices));
+        if (!s->slices)
+            return AVERROR(ENOMEM);
+    }
+
+    return 0;
+}
+
+static av_cold int png_enc_close(AVCodecContext *avctx)
+{
+    PNGEncContext *s = avctx->priv_data;
+    int i;
+
+    for (i = 0; i < s->max_slices && s->slices; i++)
+        av_freep(&s->slices[i].buf);
+    av_freep(&s->slices);
     return 0;
 }
 
@@ -443,7 +636,8 @@ AVCodec ff_png_encoder = {
     sizeof(PNGEncContext),
     png_enc_init,
     encode_frame,
-    NULL, //encode_end,
+    png_enc_close,
+    .capabilities = CODEC_CAP_SLICE_THREADS | CODEC_CAP_FRAME_THREADS,
     .pix_fmts= (const enum PixelFormat[]){PIX_FMT_RGB24, PIX_FMT_RGB32, PIX_FMT_PAL8, PIX_FMT_GRAY8, PIX_FMT_MONOBLACK, PIX_FMT_NONE},
     .long_name= NULL_IF_CONFIG_SMALL("PNG image"),
 };
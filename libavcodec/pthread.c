@@ -29,16 +29,46 @@
  * @see doc/multithreading.txt
  */
 
+#include "config.h"
+
+#if HAVE_PTHREAD_ATTR_SETAFFINITY_NP
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#endif
 #include <pthread.h>
 
+#include "libavutil/threadpool.h"
 #include "avcodec.h"
+#include "internal.h"
+#include "dsputil.h"
 #include "thread.h"
 
 typedef int (action_func)(AVCodecContext *c, void *arg);
 typedef int (action_func2)(AVCodecContext *c, void *arg, int jobnr, int threadnr);
 
+typedef struct AVCodecThreadPool {
+    AVThreadPool *pool;
+} AVCodecThreadPool;
+
+/**
+ * The jobs of an execute() call which a worker has not started yet.
+ * The worker runs them in order; idle workers steal the second half.
+ */
+typedef struct JobRange {
+    pthread_mutex_t lock;
+    int next;                   ///< The next job to run.
+    int end;                    ///< One past the last job of the range.
+    uint8_t padding[64];        ///< Keeps the ranges of different workers in separate cache lines.
+} JobRange;
+
 typedef struct ThreadContext {
+    AVCodecContext *avctx;
+    int thread_count;
+    AVThreadPool *pool;         ///< Shared pool used instead of workers, or NULL.
     pthread_t *workers;
+    JobRange *ranges;           ///< The jobs left to each worker.
     action_func *func;
     action_func2 *func2;
     void *args;
@@ -50,7 +80,8 @@ typedef struct ThreadContext {
     pthread_cond_t last_job_cond;
     pthread_cond_t current_job_cond;
     pthread_mutex_t current_job_lock;
-    int current_job;
+    unsigned int current_execute; ///< Incremented for every execute() call.
+    int idle_threads;           ///< Number of workers which ran out of jobs.
     int done;
 } ThreadContext;
 
@@ -66,10 +97,11 @@ typedef struct PerThreadContext {
     pthread_t      thread;
     pthread_cond_t input_cond;      ///< Used to wait for a new packet from the main thread.
     pthread_cond_t progress_cond;   ///< Used by child threads to wait for progress to change.
+    pthread_cond_t row_cond;        ///< Used by ff_thread_await_progress() to wait for frame progress.
     pthread_cond_t output_cond;     ///< Used by the main thread to wait for frames to finish.
 
     pthread_mutex_t mutex;          ///< Mutex used to protect the contents of the PerThreadContext.
-    pthread_mutex_t progress_mutex; ///< Mutex used to protect frame progress values and progress_cond.
+    pthread_mutex_t progress_mutex; ///< Mutex used to protect frame progress values, progress_cond and row_cond.
 
     AVCodecContext *avctx;          ///< Context used to decode packets passed to this thread.
 
@@ -77,7 +109,11 @@ typedef struct PerThreadContext {
     int            allocated_buf_size; ///< Size allocated for avpkt.data
 
     AVFrame frame;                  ///< Output frame (for decoding) or input (for encoding).
-    int     got_frame;              ///< The output of got_picture_ptr from the last avcodec_decode_video() call.
+    AVPicture picture;              ///< Copy of the input picture (for encoding), referenced by frame.
+    int     got_frame;              /**<
+                                     * The output of got_picture_ptr from the last avcodec_decode_video() call,
+                                     * or set while the packet encoded by this thread is not returned yet.
+                                     */
     int     result;                 ///< The result of the last codec decode/encode() call.
 
     enum {
@@ -103,7 +139,16 @@ typedef struct PerThreadContext {
     int     progress[MAX_BUFFERS][2];
     uint8_t progress_used[MAX_BUFFERS];
 
+    /**
+     * Lowest progress value any thread is waiting for in ff_thread_await_progress(),
+     * for each entry in progress, or INT_MAX if nobody is waiting.
+     * row_cond is only signaled when progress reaches this value.
+     */
+    int     progress_wanted[MAX_BUFFERS][2];
+
     AVFrame *requested_frame;       ///< AVFrame the codec passed to get_buffer()
+
+    ThreadContext *slice_ctx;       ///< Slice threads used by this thread, or NULL.
 } PerThreadContext;
 
 /**
@@ -126,48 +171,162 @@ typedef struct FrameThreadContext {
     int die;                       ///< Set when threads should exit.
 } FrameThreadContext;
 
+/**
+ * Takes the next job of a worker, stealing from the others once its own
+ * range is empty.
+ *
+ * @return the job number, or -1 if all jobs have been started
+ */
+static int get_next_job(ThreadContext *c, int self_id)
+{
+    JobRange *own = &c->ranges[self_id];
+    int i, job = -1;
+
+    pthread_mutex_lock(&own->lock);
+    if (own->next < own->end)
+        job = own->next++;
+    pthread_mutex_unlock(&own->lock);
+    if (job >= 0)
+        return job;
+
+    for (i = 1; i < c->thread_count && job < 0; i++) {
+        JobRange *victim = &c->ranges[(self_id + i) % c->thread_count];
+        int end = 0;
+
+        pthread_mutex_lock(&victim->lock);
+        if (victim->next < victim->end) {
+            end = victim->end;
+            job = victim->end - ((victim->end - victim->next + 1) >> 1);
+            victim->end = job;
+        }
+        pthread_mutex_unlock(&victim->lock);
+
+        if (job >= 0) {
+            pthread_mutex_lock(&own->lock);
+            own->next = job + 1;
+            own->end  = end;
+            pthread_mutex_unlock(&own->lock);
+        }
+    }
+
+    return job;
+}
+
 static void* attribute_align_arg worker(void *v)
 {
-    AVCodecContext *avctx = v;
-    ThreadContext *c = avctx->thread_opaque;
-    int our_job = c->job_count;
-    int thread_count = avctx->thread_count;
-    int self_id;
+    ThreadContext *c = v;
+    AVCodecContext *avctx = c->avctx;
+    unsigned int last_execute = 0;
+    int self_id, job;
 
     pthread_mutex_lock(&c->current_job_lock);
-    self_id = c->current_job++;
+    self_id = c->idle_threads;
     for (;;){
-        while (our_job >= c->job_count) {
-            if (c->current_job == thread_count + c->job_count)
-                pthread_cond_signal(&c->last_job_cond);
+        if (++c->idle_threads == c->thread_count)
+            pthread_cond_signal(&c->last_job_cond);
 
+        while (last_execute == c->current_execute && !c->done)
             pthread_cond_wait(&c->current_job_cond, &c->current_job_lock);
-            our_job = self_id;
-
-            if (c->done) {
-                pthread_mutex_unlock(&c->current_job_lock);
-                return NULL;
-            }
-        }
+        if (c->done)
+            break;
+        last_execute = c->current_execute;
         pthread_mutex_unlock(&c->current_job_lock);
 
-        c->rets[our_job%c->rets_count] = c->func ? c->func(avctx, (char*)c->args + our_job*c->job_size):
-                                                   c->func2(avctx, c->args, our_job, self_id);
+        while ((job = get_next_job(c, self_id)) >= 0)
+            c->rets[job%c->rets_count] = c->func ? c->func(avctx, (char*)c->args + job*c->job_size):
+                                                   c->func2(avctx, c->args, job, self_id);
 
         pthread_mutex_lock(&c->current_job_lock);
-        our_job = c->current_job++;
     }
+    pthread_mutex_unlock(&c->current_job_lock);
+
+    return NULL;
 }
 
 static av_always_inline void avcodec_thread_park_workers(ThreadContext *c, int thread_count)
 {
-    pthread_cond_wait(&c->last_job_cond, &c->current_job_lock);
+    while (c->idle_threads < thread_count)
+        pthread_cond_wait(&c->last_job_cond, &c->current_job_lock);
     pthread_mutex_unlock(&c->current_job_lock);
 }
 
-static void thread_free(AVCodecContext *avctx)
+typedef struct PoolJobs {
+    AVCodecContext *avctx;
+    action_func *func;
+    action_func2 *func2;
+    void *args;
+    int job_size;
+} PoolJobs;
+
+static int pool_job(void *arg, int jobnr, int threadnr)
+{
+    PoolJobs *j = arg;
+
+    return j->func ? j->func(j->avctx, (char*)j->args + jobnr*j->job_size):
+                     j->func2(j->avctx, j->args, jobnr, threadnr);
+}
+
+/**
+ * Runs the jobs on the shared pool, with at most thread_count threads
+ * of the pool, the calling one included, working on them.
+ */
+static int pool_execute(ThreadContext *c, action_func *func, action_func2 *func2,
+                        void *arg, int *ret, int job_count, int job_size)
+{
+    PoolJobs j = { c->avctx, func, func2, arg, job_size };
+
+    return av_thread_pool_execute(c->pool, pool_job, &j, ret, job_count,
+                                  c->thread_count);
+}
+
+AVCodecThreadPool *avcodec_thread_pool_alloc(int thread_count)
+{
+    AVCodecThreadPool *pool;
+
+    if (thread_count < 1)
+        return NULL;
+
+    pool = av_mallocz(sizeof(AVCodecThreadPool));
+    if (!pool)
+        return NULL;
+
+    pool->pool = av_thread_pool_alloc(thread_count);
+    if (!pool->pool || !av_thread_pool_nb_threads(pool->pool)) {
+        avcodec_thread_pool_unref(&pool);
+        return NULL;
+    }
+
+    return pool;
+}
+
+void avcodec_thread_pool_unref(AVCodecThreadPool **ppool)
+{
+    if (!*ppool)
+        return;
+    av_thread_pool_unref(&(*ppool)->pool);
+    av_freep(ppool);
+}
+
+AVThreadPool *avcodec_thread_pool_get(AVCodecThreadPool *pool)
+{
+    return pool ? pool->pool : NULL;
+}
+
+/**
+ * Returns the slice thread pool used by execute() on this context.
+ * With frame threading, it belongs to the frame thread owning avctx.
+ */
+static ThreadContext *get_slice_context(AVCodecContext *avctx)
+{
+    if (avctx->active_thread_type&FF_THREAD_FRAME) {
+        PerThreadContext *p = avctx->thread_opaque;
+        return p->slice_ctx;
+    }
+    return avctx->thread_opaque;
+}
+
+static void slice_threads_free(ThreadContext *c)
 {
-    ThreadContext *c = avctx->thread_opaque;
     int i;
 
     pthread_mutex_lock(&c->current_job_lock);
@@ -175,30 +334,49 @@ static void thread_free(AVCodecContext *avctx)
     pthread_cond_broadcast(&c->current_job_cond);
     pthread_mutex_unlock(&c->current_job_lock);
 
-    for (i=0; i<avctx->thread_count; i++)
+    for (i=0; i<c->thread_count; i++)
          pthread_join(c->workers[i], NULL);
 
+    for (i=0; i<c->thread_count; i++)
+        pthread_mutex_destroy(&c->ranges[i].lock);
     pthread_mutex_destroy(&c->current_job_lock);
     pthread_cond_destroy(&c->current_job_cond);
     pthread_cond_destroy(&c->last_job_cond);
+    av_free(c->ranges);
     av_free(c->workers);
-    av_freep(&avctx->thread_opaque);
+    av_free(c);
+}
+
+static void thread_free(AVCodecContext *avctx)
+{
+    ThreadContext *c = avctx->thread_opaque;
+
+    if (c->pool) {
+        av_thread_pool_unref(&c->pool);
+        av_freep(&avctx->thread_opaque);
+        return;
+    }
+
+    slice_threads_free(c);
+    avctx->thread_opaque = NULL;
 }
 
 static int avcodec_thread_execute(AVCodecContext *avctx, action_func* func, void *arg, int *ret, int job_count, int job_size)
 {
-    ThreadContext *c= avctx->thread_opaque;
-    int dummy_ret;
+    ThreadContext *c= get_slice_context(avctx);
+    int dummy_ret, i;
 
-    if (!(avctx->active_thread_type&FF_THREAD_SLICE) || avctx->thread_count <= 1)
+    if (!(avctx->active_thread_type&FF_THREAD_SLICE) || !c || c->thread_count <= 1)
         return avcodec_default_execute(avctx, func, arg, ret, job_count, job_size);
 
+    if (c->pool)
+        return pool_execute(c, func, c->func2, arg, ret, job_count, job_size);
+
     if (job_count <= 0)
         return 0;
 
     pthread_mutex_lock(&c->current_job_lock);
 
-    c->current_job = avctx->thread_count;
     c->job_count = job_count;
     c->job_size = job_size;
     c->args = arg;
@@ -210,41 +388,192 @@ static int avcodec_thread_execute(AVCodecContext *avctx, action_func* func, void
         c->rets = &dummy_ret;
         c->rets_count = 1;
     }
+
+    /* All workers are idle, so the ranges can be set without their locks. */
+    for (i = 0; i < c->thread_count; i++) {
+        c->ranges[i].next = (int64_t)job_count *  i      / c->thread_count;
+        c->ranges[i].end  = (int64_t)job_count * (i + 1) / c->thread_count;
+    }
+    c->idle_threads = 0;
+    c->current_execute++;
     pthread_cond_broadcast(&c->current_job_cond);
 
-    avcodec_thread_park_workers(c, avctx->thread_count);
+    avcodec_thread_park_workers(c, c->thread_count);
 
     return 0;
 }
 
 static int avcodec_thread_execute2(AVCodecContext *avctx, action_func2* func2, void *arg, int *ret, int job_count)
 {
-    ThreadContext *c= avctx->thread_opaque;
+    ThreadContext *c= get_slice_context(avctx);
+
+    if (!(avctx->active_thread_type&FF_THREAD_SLICE) || !c || c->thread_count <= 1)
+        return avcodec_default_execute2(avctx, func2, arg, ret, job_count);
+
     c->func2 = func2;
     return avcodec_thread_execute(avctx, NULL, arg, ret, job_count, 0);
 }
 
-static int thread_init(AVCodecContext *avctx)
+#if HAVE_PTHREAD_ATTR_SETAFFINITY_NP
+/**
+ * Adds the CPUs of a list like "0-3,8" to set.
+ *
+ * @return 0 on success, -1 if the list is invalid
+ */
+static int parse_cpu_list(cpu_set_t *set, const char *list)
 {
-    int i;
-    ThreadContext *c;
-    int thread_count = avctx->thread_count;
+    while (*list) {
+        char *end;
+        long first, last;
+
+        first = last = strtol(list, &end, 10);
+        if (end == list || first < 0)
+            return -1;
+        if (*end == '-') {
+            list = end + 1;
+            last = strtol(list, &end, 10);
+            if (end == list || last < first)
+                return -1;
+        }
+        if (last >= CPU_SETSIZE)
+            return -1;
+        for (; first <= last; first++)
+            CPU_SET(first, set);
+
+        if (!*end || *end == '\n')
+            break;
+        if (*end != ',')
+            return -1;
+        list = end + 1;
+    }
+    return 0;
+}
 
-    if (thread_count <= 1)
+/**
+ * Gets the CPUs codec threads are restricted to by thread_affinity and
+ * thread_numa_node. Both restrictions apply if both are set.
+ *
+ * @return 1 if set is valid, 0 if the threads should not be restricted
+ */
+static int get_thread_cpus(AVCodecContext *avctx, cpu_set_t *set)
+{
+    CPU_ZERO(set);
+
+    if (avctx->thread_affinity && parse_cpu_list(set, avctx->thread_affinity) < 0) {
+        av_log(avctx, AV_LOG_ERROR, "Invalid thread affinity '%s'\n", avctx->thread_affinity);
+        return 0;
+    }
+
+    if (avctx->thread_numa_node >= 0) {
+        char path[64], list[1024];
+        cpu_set_t node_set;
+        FILE *f;
+
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist",
+                 avctx->thread_numa_node);
+        CPU_ZERO(&node_set);
+        if (!(f = fopen(path, "r")) ||
+            !fgets(list, sizeof(list), f) ||
+            parse_cpu_list(&node_set, list) < 0) {
+            av_log(avctx, AV_LOG_ERROR, "Cannot get the CPUs of NUMA node %d\n",
+                   avctx->thread_numa_node);
+            if (f)
+                fclose(f);
+            return 0;
+        }
+        fclose(f);
+
+        if (avctx->thread_affinity)
+            CPU_AND(set, set, &node_set);
+        else
+            *set = node_set;
+    }
+
+    if (!CPU_COUNT(set)) {
+        if (avctx->thread_affinity || avctx->thread_numa_node >= 0)
+            av_log(avctx, AV_LOG_WARNING, "No CPUs left to run threads on, not restricting them\n");
         return 0;
+    }
+    return 1;
+}
+#endif
+
+/**
+ * Initializes attr to start codec threads on the CPUs requested by
+ * thread_affinity and thread_numa_node, so that they never run and
+ * allocate memory anywhere else.
+ * Buffers are first written by the thread that allocates them, so with
+ * frame threading the default get_buffer() also allocates frame buffers
+ * on the node of the decoding thread.
+ *
+ * @return attr, which must be destroyed with pthread_attr_destroy(), or
+ *         NULL if the threads are not restricted
+ */
+static pthread_attr_t *thread_attr_init(AVCodecContext *avctx, pthread_attr_t *attr)
+{
+#if HAVE_PTHREAD_ATTR_SETAFFINITY_NP
+    cpu_set_t set;
+
+    if (!get_thread_cpus(avctx, &set))
+        return NULL;
+
+    pthread_attr_init(attr);
+    if (pthread_attr_setaffinity_np(attr, sizeof(set), &set)) {
+        av_log(avctx, AV_LOG_WARNING, "Cannot set thread affinity\n");
+        pthread_attr_destroy(attr);
+        return NULL;
+    }
+    return attr;
+#else
+    if (avctx->thread_affinity || avctx->thread_numa_node >= 0)
+        av_log(avctx, AV_LOG_WARNING, "Thread affinity is not supported on this platform\n");
+    return NULL;
+#endif
+}
+
+/**
+ * Starts a codec thread with the attributes from thread_attr_init(),
+ * falling back to unrestricted CPUs if the system refuses them.
+ */
+static int create_thread(AVCodecContext *avctx, pthread_t *thread, pthread_attr_t *attr,
+                         void *(*func)(void *), void *arg)
+{
+    if (attr) {
+        if (!pthread_create(thread, attr, func, arg))
+            return 0;
+        av_log(avctx, AV_LOG_WARNING, "Cannot set thread affinity\n");
+    }
+    return pthread_create(thread, NULL, func, arg);
+}
+
+/**
+ * Starts thread_count slice threads executing jobs for avctx.
+ *
+ * @return the new pool, or NULL on failure
+ */
+static ThreadContext *slice_threads_init(AVCodecContext *avctx, int thread_count)
+{
+    int i;
+    ThreadContext *c;
+    pthread_attr_t attr_buf, *attr;
 
     c = av_mallocz(sizeof(ThreadContext));
     if (!c)
-        return -1;
+        return NULL;
 
     c->workers = av_mallocz(sizeof(pthread_t)*thread_count);
-    if (!c->workers) {
+    c->ranges  = av_mallocz(sizeof(JobRange)*thread_count);
+    if (!c->workers || !c->ranges) {
+        av_free(c->workers);
+        av_free(c->ranges);
         av_free(c);
-        return -1;
+        return NULL;
     }
+    for (i=0; i<thread_count; i++)
+        pthread_mutex_init(&c->ranges[i].lock, NULL);
 
-    avctx->thread_opaque = c;
-    c->current_job = 0;
+    c->avctx = avctx;
+    c->thread_count = thread_count;
     c->job_count = 0;
     c->job_size = 0;
     c->done = 0;
@@ -252,17 +581,47 @@ static int thread_init(AVCodecContext *avctx)
     pthread_cond_init(&c->last_job_cond, NULL);
     pthread_mutex_init(&c->current_job_lock, NULL);
     pthread_mutex_lock(&c->current_job_lock);
+    attr = thread_attr_init(avctx, &attr_buf);
     for (i=0; i<thread_count; i++) {
-        if(pthread_create(&c->workers[i], NULL, worker, avctx)) {
-           avctx->thread_count = i;
+        if(create_thread(avctx, &c->workers[i], attr, worker, c)) {
+           c->thread_count = i;
            pthread_mutex_unlock(&c->current_job_lock);
-           ff_thread_free(avctx);
-           return -1;
+           slice_threads_free(c);
+           if (attr)
+               pthread_attr_destroy(attr);
+           return NULL;
         }
     }
+    if (attr)
+        pthread_attr_destroy(attr);
 
     avcodec_thread_park_workers(c, thread_count);
 
+    return c;
+}
+
+static int thread_init(AVCodecContext *avctx)
+{
+    ThreadContext *c;
+    int thread_count = avctx->thread_count;
+
+    if (thread_count <= 1)
+        return 0;
+
+    if (avctx->thread_pool) {
+        c = av_mallocz(sizeof(ThreadContext));
+        if (!c)
+            return -1;
+
+        c->avctx        = avctx;
+        c->thread_count = thread_count;
+        c->pool         = av_thread_pool_ref(avctx->thread_pool->pool);
+    } else
+        c = slice_threads_init(avctx, thread_count);
+    if (!c)
+        return -1;
+
+    avctx->thread_opaque = c;
     avctx->execute = avcodec_thread_execute;
     avctx->execute2 = avcodec_thread_execute2;
     return 0;
@@ -296,9 +655,18 @@ static attribute_align_arg void *frame_worker_thread(void *arg)
             ff_thread_finish_setup(avctx);
 
         pthread_mutex_lock(&p->mutex);
-        avcodec_get_frame_defaults(&p->frame);
-        p->got_frame = 0;
-        p->result = codec->decode(avctx, &p->frame, &p->got_frame, &p->avpkt);
+        if (codec->encode) {
+            FF_MEM_TAGGED(codec->name,
+                          p->result = codec->encode(avctx, p->avpkt.data,
+                                                    p->avpkt.size, &p->frame));
+            emms_c();
+        } else {
+            avcodec_get_frame_defaults(&p->frame);
+            p->got_frame = 0;
+            FF_MEM_TAGGED(codec->name,
+                          p->result = codec->decode(avctx, &p->frame,
+                                                    &p->got_frame, &p->avpkt));
+        }
 
         if (p->state == STATE_SETTING_UP) ff_thread_finish_setup(avctx);
 
@@ -394,12 +762,18 @@ static void update_context_from_user(AVCodecContext *dst, AVCodecContext *src)
 #undef copy_fields
 }
 
+/// Returns the index of the progress entry of a frame in its owner's progress array.
+static int progress_index(PerThreadContext *p, volatile int *progress)
+{
+    return (progress - p->progress[0]) / 2;
+}
+
 static void free_progress(AVFrame *f)
 {
     PerThreadContext *p = f->owner->thread_opaque;
     int *progress = f->thread_opaque;
 
-    p->progress_used[(progress - p->progress[0]) / 2] = 0;
+    p->progress_used[progress_index(p, progress)] = 0;
 }
 
 /// Releases the buffers that this decoding thread was the last user of.
@@ -535,7 +909,12 @@ int ff_thread_decode_frame(AVCodecContext *avctx,
 
         *picture = p->frame;
         *got_picture_ptr = p->got_frame;
-        picture->pkt_dts = p->avpkt.dts;
+        /*
+         * A frame flushed out by an empty packet gets the dts of the packet
+         * that returns it, as without threads, and not the one the empty
+         * packet was submitted with thread_count-1 calls earlier.
+         */
+        picture->pkt_dts = p->avpkt.size ? p->avpkt.dts : avpkt->dts;
 
         /*
          * A later call with avkpt->size == 0 may loop over all threads,
@@ -557,39 +936,155 @@ int ff_thread_decode_frame(AVCodecContext *avctx,
     return p->result;
 }
 
+/**
+ * Updates the user's AVCodecContext with the values an encoding thread
+ * sets in init() or with each packet.
+ */
+static void update_context_from_encoder(AVCodecContext *dst, AVCodecContext *src)
+{
+    dst->coded_frame           = src->coded_frame;
+    dst->bits_per_coded_sample = src->bits_per_coded_sample;
+}
+
+static int submit_frame(PerThreadContext *p, int buf_size, const AVFrame *pict)
+{
+    AVCodecContext *avctx = p->avctx;
+    uint8_t *buf = p->avpkt.data;
+    int i;
+
+    pthread_mutex_lock(&p->mutex);
+
+    if (!p->picture.data[0] &&
+        avpicture_alloc(&p->picture, avctx->pix_fmt, avctx->width, avctx->height) < 0) {
+        pthread_mutex_unlock(&p->mutex);
+        return AVERROR(ENOMEM);
+    }
+
+    av_fast_malloc(&buf, &p->allocated_buf_size, buf_size);
+    if (!buf) {
+        p->avpkt.data = NULL;
+        pthread_mutex_unlock(&p->mutex);
+        return AVERROR(ENOMEM);
+    }
+    p->avpkt.data = buf;
+    p->avpkt.size = buf_size;
+
+    /* the user may reuse the picture as soon as we return */
+    av_picture_copy(&p->picture, (const AVPicture*)pict, avctx->pix_fmt, avctx->width, avctx->height);
+    p->frame = *pict;
+    for (i = 0; i < 4; i++) {
+        p->frame.data[i]     = p->picture.data[i];
+        p->frame.linesize[i] = p->picture.linesize[i];
+    }
+    p->got_frame = 1;
+
+    p->state = STATE_SETTING_UP;
+    pthread_cond_signal(&p->input_cond);
+    pthread_mutex_unlock(&p->mutex);
+
+    return 0;
+}
+
+int ff_thread_encode_video(AVCodecContext *avctx, uint8_t *buf, int buf_size,
+                           const AVFrame *pict)
+{
+    FrameThreadContext *fctx = avctx->thread_opaque;
+    PerThreadContext *p;
+    int err;
+
+    /*
+     * Submit the picture to the next encoding thread. Packets are returned
+     * in order, so that thread has already returned its previous packet.
+     */
+
+    if (pict) {
+        p = &fctx->threads[fctx->next_decoding];
+        update_context_from_user(p->avctx, avctx);
+        err = submit_frame(p, buf_size, pict);
+        if (err) return err;
+
+        if (++fctx->next_decoding >= avctx->thread_count) fctx->next_decoding = 0;
+
+        if (fctx->delaying) {
+            if (fctx->next_decoding >= (avctx->thread_count-1)) fctx->delaying = 0;
+            return 0;
+        }
+    }
+
+    /*
+     * Return the packet of the oldest thread, or nothing once all
+     * pictures have been flushed.
+     */
+
+    p = &fctx->threads[fctx->next_finished];
+    if (!p->got_frame)
+        return 0;
+
+    if (p->state != STATE_INPUT_READY) {
+        pthread_mutex_lock(&p->progress_mutex);
+        while (p->state != STATE_INPUT_READY)
+            pthread_cond_wait(&p->output_cond, &p->progress_mutex);
+        pthread_mutex_unlock(&p->progress_mutex);
+    }
+    p->got_frame = 0;
+
+    if (++fctx->next_finished >= avctx->thread_count) fctx->next_finished = 0;
+
+    update_context_from_encoder(avctx, p->avctx);
+
+    if (p->result > buf_size) {
+        av_log(avctx, AV_LOG_ERROR, "output buffer too small\n");
+        return -1;
+    }
+    if (p->result > 0)
+        memcpy(buf, p->avpkt.data, p->result);
+
+    return p->result;
+}
+
 void ff_thread_report_progress(AVFrame *f, int n, int field)
 {
     PerThreadContext *p;
-    int *progress = f->thread_opaque;
+    int *progress = f->thread_opaque, *wanted;
 
     if (!progress || progress[field] >= n) return;
 
     p = f->owner->thread_opaque;
+    wanted = p->progress_wanted[progress_index(p, progress)];
 
     if (f->owner->debug&FF_DEBUG_THREADS)
         av_log(f->owner, AV_LOG_DEBUG, "%p finished %d field %d\n", progress, n, field);
 
     pthread_mutex_lock(&p->progress_mutex);
     progress[field] = n;
-    pthread_cond_broadcast(&p->progress_cond);
+    // Only wake the waiters once the lowest row one of them asked for is done.
+    if (wanted[field] <= n) {
+        wanted[field] = INT_MAX;
+        pthread_cond_broadcast(&p->row_cond);
+    }
     pthread_mutex_unlock(&p->progress_mutex);
 }
 
 void ff_thread_await_progress(AVFrame *f, int n, int field)
 {
     PerThreadContext *p;
-    int *progress = f->thread_opaque;
+    volatile int *progress = f->thread_opaque;
+    int *wanted;
 
     if (!progress || progress[field] >= n) return;
 
     p = f->owner->thread_opaque;
+    wanted = p->progress_wanted[progress_index(p, progress)];
 
     if (f->owner->debug&FF_DEBUG_THREADS)
         av_log(f->owner, AV_LOG_DEBUG, "thread awaiting %d field %d from %p\n", n, field, progress);
 
     pthread_mutex_lock(&p->progress_mutex);
-    while (progress[field] < n)
-        pthread_cond_wait(&p->progress_cond, &p->progress_mutex);
+    while (progress[field] < n) {
+        // Waking clears wanted, so every remaining waiter registers again.
+        wanted[field] = FFMIN(wanted[field], n);
+        pthread_cond_wait(&p->row_cond, &p->progress_mutex);
+    }
     pthread_mutex_unlock(&p->progress_mutex);
 }
 
@@ -625,6 +1120,7 @@ static void frame_thread_free(AVCodecContext *avctx, int thread_count)
 {
     FrameThreadContext *fctx = avctx->thread_opaque;
     AVCodec *codec = avctx->codec;
+    uint8_t *extradata;
     int i;
 
     park_frame_worker_threads(fctx, thread_count);
@@ -643,9 +1139,19 @@ static void frame_thread_free(AVCodecContext *avctx, int thread_count)
 
         pthread_join(p->thread, NULL);
 
-        if (codec->close)
+        extradata = p->avctx->extradata;
+        if (codec->close && p->avctx->priv_data)
             codec->close(p->avctx);
 
+        /* Encoder extradata is freed by avcodec_close(), which does not
+         * see the contexts of the threads. */
+        if (codec->encode) {
+            if (extradata && avctx->extradata == extradata) {
+                avctx->extradata      = NULL;
+                avctx->extradata_size = 0;
+            }
+            av_freep(&p->avctx->extradata);
+        }
         avctx->codec = NULL;
 
         release_delayed_buffers(p);
@@ -660,8 +1166,13 @@ static void frame_thread_free(AVCodecContext *avctx, int thread_count)
         pthread_mutex_destroy(&p->progress_mutex);
         pthread_cond_destroy(&p->input_cond);
         pthread_cond_destroy(&p->progress_cond);
+        pthread_cond_destroy(&p->row_cond);
         pthread_cond_destroy(&p->output_cond);
         av_freep(&p->avpkt.data);
+        avpicture_free(&p->picture);
+
+        if (p->slice_ctx)
+            slice_threads_free(p->slice_ctx);
 
         if (i)
             av_freep(&p->avctx->priv_data);
@@ -680,6 +1191,8 @@ static int frame_thread_init(AVCodecContext *avctx)
     AVCodec *codec = avctx->codec;
     AVCodecContext *src = avctx;
     FrameThreadContext *fctx;
+    pthread_attr_t attr_buf, *attr = NULL;
+    void *priv = NULL;
     int i, err = 0;
 
     if (thread_count <= 1) {
@@ -687,12 +1200,21 @@ static int frame_thread_init(AVCodecContext *avctx)
         return 0;
     }
 
+    /* every encoding thread is initialized from the options set by the user */
+    if (codec->encode && codec->priv_data_size) {
+        priv = av_malloc(codec->priv_data_size);
+        if (!priv)
+            return AVERROR(ENOMEM);
+        memcpy(priv, avctx->priv_data, codec->priv_data_size);
+    }
+
     avctx->thread_opaque = fctx = av_mallocz(sizeof(FrameThreadContext));
 
     fctx->threads = av_mallocz(sizeof(PerThreadContext) * thread_count);
     pthread_mutex_init(&fctx->buffer_mutex, NULL);
     fctx->delaying = 1;
 
+    attr = thread_attr_init(avctx, &attr_buf);
     for (i = 0; i < thread_count; i++) {
         AVCodecContext *copy = av_malloc(sizeof(AVCodecContext));
         PerThreadContext *p  = &fctx->threads[i];
@@ -701,6 +1223,7 @@ static int frame_thread_init(AVCodecContext *avctx)
         pthread_mutex_init(&p->progress_mutex, NULL);
         pthread_cond_init(&p->input_cond, NULL);
         pthread_cond_init(&p->progress_cond, NULL);
+        pthread_cond_init(&p->row_cond, NULL);
         pthread_cond_init(&p->output_cond, NULL);
 
         p->parent = fctx;
@@ -709,12 +1232,52 @@ static int frame_thread_init(AVCodecContext *avctx)
         *copy = *src;
         copy->thread_opaque = p;
         copy->pkt = &p->avpkt;
+        /* if this fails, the thread allocates its own buffers */
+        copy->internal_buffer = NULL;
+        ff_share_frame_pool(copy, avctx);
+        if (codec->encode) {
+            copy->thread_count   = avctx->active_thread_type&FF_THREAD_SLICE ?
+                                   avctx->slice_thread_count : 1;
+            copy->extradata      = NULL;
+            copy->extradata_size = 0;
+        }
+
+        if (avctx->active_thread_type&FF_THREAD_SLICE) {
+            p->slice_ctx = slice_threads_init(copy, avctx->slice_thread_count);
+            if (!p->slice_ctx) {
+                err = -1;
+                goto error;
+            }
+            copy->execute  = avcodec_thread_execute;
+            copy->execute2 = avcodec_thread_execute2;
+        }
+
+        if (codec->encode) {
+            /* frames are encoded independently, so each thread gets its own encoder */
+            if (i) {
+                copy->priv_data = av_malloc(codec->priv_data_size);
+                if (!copy->priv_data) {
+                    err = AVERROR(ENOMEM);
+                    goto error;
+                }
+                memcpy(copy->priv_data, priv, codec->priv_data_size);
+            }
 
-        if (!i) {
+            if (codec->init)
+                FF_MEM_TAGGED(codec->name, err = codec->init(copy));
+
+            if (!i && !err) {
+                update_context_from_encoder(avctx, copy);
+                if (copy->extradata) {
+                    avctx->extradata      = copy->extradata;
+                    avctx->extradata_size = copy->extradata_size;
+                }
+            }
+        } else if (!i) {
             src = copy;
 
             if (codec->init)
-                err = codec->init(copy);
+                FF_MEM_TAGGED(codec->name, err = codec->init(copy));
 
             update_context_from_thread(avctx, copy, 1);
         } else {
@@ -723,18 +1286,24 @@ static int frame_thread_init(AVCodecContext *avctx)
             memcpy(copy->priv_data, src->priv_data, codec->priv_data_size);
 
             if (codec->init_thread_copy)
-                err = codec->init_thread_copy(copy);
+                FF_MEM_TAGGED(codec->name, err = codec->init_thread_copy(copy));
         }
 
         if (err) goto error;
 
-        pthread_create(&p->thread, NULL, frame_worker_thread, p);
+        create_thread(avctx, &p->thread, attr, frame_worker_thread, p);
     }
+    if (attr)
+        pthread_attr_destroy(attr);
 
+    av_free(priv);
     return 0;
 
 error:
+    if (attr)
+        pthread_attr_destroy(attr);
     frame_thread_free(avctx, i+1);
+    av_free(priv);
 
     return err;
 }
@@ -750,6 +1319,13 @@ void ff_thread_flush(AVCodecContext *avctx)
     if (fctx->prev_thread)
         update_context_from_thread(fctx->threads->avctx, fctx->prev_thread->avctx, 0);
 
+    /* drop the packets of pictures which have not been returned yet */
+    if (avctx->codec->encode) {
+        int i;
+        for (i = 0; i < avctx->thread_count; i++)
+            fctx->threads[i].got_frame = 0;
+    }
+
     fctx->next_decoding = fctx->next_finished = 0;
     fctx->delaying = 1;
     fctx->prev_thread = NULL;
@@ -800,6 +1376,8 @@ int ff_thread_get_buffer(AVCodecContext *avctx, AVFrame *f)
 
     progress[0] =
     progress[1] = -1;
+    p->progress_wanted[progress_index(p, progress)][0] =
+    p->progress_wanted[progress_index(p, progress)][1] = INT_MAX;
 
     if (avctx->thread_safe_callbacks ||
         avctx->get_buffer == avcodec_default_get_buffer) {
@@ -855,28 +1433,88 @@ void ff_thread_release_buffer(AVCodecContext *avctx, AVFrame *f)
     memset(f->data, 0, sizeof(f->data));
 }
 
+/**
+ * Checks whether the encoder settings make every frame independent of the
+ * previous ones, so that the frames can be encoded by separate encoders.
+ */
+static int encoder_frames_independent(AVCodecContext *avctx)
+{
+    if (avctx->flags & (CODEC_FLAG_PASS1|CODEC_FLAG_PASS2))
+        return 0;
+
+    switch (avctx->codec_id) {
+    case CODEC_ID_MJPEG:
+        /* the rate controller picks the quantizer from the previous frames */
+        return avctx->flags & CODEC_FLAG_QSCALE;
+    case CODEC_ID_HUFFYUV:
+    case CODEC_ID_FFVHUFF:
+        return !avctx->context_model;
+    case CODEC_ID_FFV1:
+        return avctx->gop_size <= 1;
+    default:
+        return 1;
+    }
+}
+
 /**
  * Set the threading algorithms used.
  *
  * Threading requires more than one thread.
  * Frame threading requires entire frames to be passed to the codec,
  * and introduces extra decoding delay, so is incompatible with low_delay.
+ * Encoders can only use frame threading when all frames are coded independently.
+ * Slice threading is used inside frame threads if the codec supports
+ * both and slice_thread_count is set.
+ * Frame threads wait on each other, so they cannot run on a shared pool.
+ * If max_thread_delay limits the number of frame threads, the remaining
+ * threads are used as slice threads where possible.
  *
  * @param avctx The context.
  */
 static void validate_thread_parameters(AVCodecContext *avctx)
 {
     int frame_threading_supported = (avctx->codec->capabilities & CODEC_CAP_FRAME_THREADS)
+                                && !avctx->thread_pool
                                 && !(avctx->flags & CODEC_FLAG_TRUNCATED)
                                 && !(avctx->flags & CODEC_FLAG_LOW_DELAY)
-                                && !(avctx->flags2 & CODEC_FLAG2_CHUNKS);
+                                && !(avctx->flags2 & CODEC_FLAG2_CHUNKS)
+                                && (!avctx->codec->encode || encoder_frames_independent(avctx));
+    if (avctx->thread_count != 1 && avctx->thread_pool &&
+        avctx->codec->capabilities & CODEC_CAP_FRAME_THREADS &&
+        avctx->thread_type & FF_THREAD_FRAME)
+        av_log(avctx, AV_LOG_VERBOSE,
+               "frame threading is not used with a shared thread pool\n");
     if (avctx->thread_count == 1) {
         avctx->active_thread_type = 0;
     } else if (frame_threading_supported && (avctx->thread_type & FF_THREAD_FRAME)) {
         avctx->active_thread_type = FF_THREAD_FRAME;
+        if (avctx->max_thread_delay >= 0 &&
+            avctx->thread_count > avctx->max_thread_delay + 1) {
+            int frame_threads = avctx->max_thread_delay + 1;
+            int slice_threading_supported = avctx->codec->capabilities & CODEC_CAP_SLICE_THREADS &&
+                                            avctx->thread_type & FF_THREAD_SLICE;
+
+            if (frame_threads == 1) {
+                avctx->active_thread_type = slice_threading_supported ? FF_THREAD_SLICE : 0;
+                return;
+            }
+            if (slice_threading_supported && avctx->slice_thread_count <= 1)
+                avctx->slice_thread_count = avctx->thread_count / frame_threads;
+            avctx->thread_count = frame_threads;
+        }
+        if (avctx->slice_thread_count > 1 &&
+            avctx->codec->capabilities & CODEC_CAP_SLICE_THREADS &&
+            avctx->thread_type & FF_THREAD_SLICE)
+            avctx->active_thread_type |= FF_THREAD_SLICE;
     } else if (avctx->codec->capabilities & CODEC_CAP_SLICE_THREADS &&
                avctx->thread_type & FF_THREAD_SLICE) {
         avctx->active_thread_type = FF_THREAD_SLICE;
+    } else if (avctx->codec->encode &&
+               avctx->codec->capabilities & CODEC_CAP_FRAME_THREADS) {
+        /* the encoder only threads frames, and cannot with these settings */
+        av_log(avctx, AV_LOG_VERBOSE,
+               "frame threading not possible with these settings, using 1 thread\n");
+        avctx->thread_count = 1;
     }
 }
 
@@ -890,10 +1528,10 @@ int ff_thread_init(AVCodecContext *avctx)
     if (avctx->codec) {
         validate_thread_parameters(avctx);
 
-        if (avctx->active_thread_type&FF_THREAD_SLICE)
-            return thread_init(avctx);
-        else if (avctx->active_thread_type&FF_THREAD_FRAME)
+        if (avctx->active_thread_type&FF_THREAD_FRAME)
             return frame_thread_init(avctx);
+        else if (avctx->active_thread_type&FF_THREAD_SLICE)
+            return thread_init(avctx);
     }
 
     return 0;
@@ -39,13 +39,32 @@
 //#define ALT_BITSTREAM_WRITER
 //#define ALIGNED_BITSTREAM_WRITER
 
+/* BITSTREAM_WRITER_64 can be defined before including this header to
+ * accumulate the bits in 64 bits instead of 32 on 64-bit CPUs, which halves
+ * the number of flushes. The PutBitContext is the same, but all the code
+ * writing to one context must use the same writer. */
+#if defined(BITSTREAM_WRITER_64) && \
+    (!HAVE_FAST_64BIT || defined(ALT_BITSTREAM_WRITER) || defined(BITSTREAM_WRITER_LE))
+#   undef BITSTREAM_WRITER_64
+#endif
+
+#ifdef BITSTREAM_WRITER_64
+#   define BIT_BUF_SIZE 64
+#else
+#   define BIT_BUF_SIZE 32
+#endif
+
 /* buf and buf_end must be present and used by every alternative writer. */
 typedef struct PutBitContext {
 #ifdef ALT_BITSTREAM_WRITER
     uint8_t *buf, *buf_end;
     int index;
+#else
+#if HAVE_FAST_64BIT
+    uint64_t bit_buf;
 #else
     uint32_t bit_buf;
+#endif
     int bit_left;
     uint8_t *buf, *buf_ptr, *buf_end;
 #endif
@@ -74,7 +93,7 @@ static inline void init_put_bits(PutBitContext *s, uint8_t *buffer, int buffer_s
 //    memset(buffer, 0, buffer_size);
 #else
     s->buf_ptr = s->buf;
-    s->bit_left=32;
+    s->bit_left=BIT_BUF_SIZE;
     s->bit_buf=0;
 #endif
 }
@@ -87,7 +106,7 @@ static inline int put_bits_count(PutBitContext *s)
 #ifdef ALT_BITSTREAM_WRITER
     return s->index;
 #else
-    return (s->buf_ptr - s->buf) * 8 + 32 - s->bit_left;
+    return (s->buf_ptr - s->buf) * 8 + BIT_BUF_SIZE - s->bit_left;
 #endif
 }
 
@@ -98,6 +117,17 @@ static inline void flush_put_bits(PutBitContext *s)
 {
 #ifdef ALT_BITSTREAM_WRITER
     align_put_bits(s);
+#elif defined BITSTREAM_WRITER_64
+    if (s->bit_left < 64)
+        s->bit_buf <<= s->bit_left;
+    while (s->bit_left < 64) {
+        /* XXX: should test end of buffer */
+        *s->buf_ptr++ = s->bit_buf >> 56;
+        s->bit_buf <<= 8;
+        s->bit_left += 8;
+    }
+    s->bit_left = 64;
+    s->bit_buf  = 0;
 #else
 #ifndef BITSTREAM_WRITER_LE
     s->bit_buf<<= s->bit_left;
@@ -118,7 +148,8 @@ static inline void flush_put_bits(PutBitContext *s)
 #endif
 }
 
-#if defined(ALT_BITSTREAM_WRITER) || defined(BITSTREAM_WRITER_LE)
+#if defined(ALT_BITSTREAM_WRITER) || defined(BITSTREAM_WRITER_LE) || \
+    defined(BITSTREAM_WRITER_64)
 #define align_put_bits align_put_bits_unsupported_here
 #define ff_put_string ff_put_string_unsupported_here
 #define ff_copy_bits ff_copy_bits_unsupported_here
@@ -147,6 +178,15 @@ void ff_copy_bits(PutBitContext *pb, const uint8_t *src, int length);
  * Write up to 31 bits into a bitstream.
  * Use put_bits32 to write 32 bits.
  */
+#ifdef BITSTREAM_WRITER_64
+static inline void put_bits64(PutBitContext *s, int n, uint64_t value);
+
+static inline void put_bits(PutBitContext *s, int n, unsigned int value)
+{
+    assert(n <= 31 && value < (1U << n));
+    put_bits64(s, n, value);
+}
+#else
 static inline void put_bits(PutBitContext *s, int n, unsigned int value)
 #ifndef ALT_BITSTREAM_WRITER
 {
@@ -262,6 +302,7 @@ static inline void put_bits(PutBitContext *s, int n, unsigned int value)
 #    endif //!ALIGNED_BITSTREAM_WRITER
 }
 #endif
+#endif /* BITSTREAM_WRITER_64 */
 
 static inline void put_sbits(PutBitContext *pb, int n, int32_t value)
 {
@@ -270,11 +311,59 @@ static inline void put_sbits(PutBitContext *pb, int n, int32_t value)
     put_bits(pb, n, value & ((1<<n)-1));
 }
 
+/**
+ * Write up to 63 bits into a bitstream, e.g. several codes concatenated
+ * by the caller, in a single write with the 64-bit writer.
+ */
+static inline void put_bits64(PutBitContext *s, int n, uint64_t value)
+#ifdef BITSTREAM_WRITER_64
+{
+    uint64_t bit_buf = s->bit_buf;
+    int bit_left     = s->bit_left;
+
+    assert(n <= 63 && value < (1ULL << n));
+
+    if (n < bit_left) {
+        bit_buf = (bit_buf << n) | value;
+        bit_left -= n;
+    } else {
+        bit_buf <<= bit_left;
+        bit_buf  |= value >> (n - bit_left);
+        AV_WB64(s->buf_ptr, bit_buf);
+        s->buf_ptr += 8;
+        bit_left   += 64 - n;
+        bit_buf     = value;
+    }
+
+    s->bit_buf  = bit_buf;
+    s->bit_left = bit_left;
+}
+#else
+{
+    if (n < 32) {
+        put_bits(s, n, value);
+    } else {
+#ifdef BITSTREAM_WRITER_LE
+        put_bits(s, 16, value & 0xffff);
+        put_bits(s, 16, (value >> 16) & 0xffff);
+        put_bits(s, n - 32, value >> 32);
+#else
+        put_bits(s, n - 32, value >> 32);
+        put_bits(s, 16, (value >> 16) & 0xffff);
+        put_bits(s, 16, value & 0xffff);
+#endif
+    }
+}
+#endif
+
 /**
  * Write exactly 32 bits into a bitstream.
  */
 static void av_unused put_bits32(PutBitContext *s, uint32_t value)
 {
+#ifdef BITSTREAM_WRITER_64
+    put_bits64(s, 32, value);
+#else
     int lo = value & 0xffff;
     int hi = value >> 16;
 #ifdef BITSTREAM_WRITER_LE
@@ -284,6 +373,7 @@ static void av_unused put_bits32(PutBitContext *s, uint32_t value)
     put_bits(s, 16, hi);
     put_bits(s, 16, lo);
 #endif
+#endif
 }
 
 /**
@@ -310,7 +400,7 @@ static inline void skip_put_bytes(PutBitContext *s, int n)
         FIXME may need some cleaning of the buffer
         s->index += n<<3;
 #else
-        assert(s->bit_left==32);
+        assert(s->bit_left==BIT_BUF_SIZE);
         s->buf_ptr += n;
 #endif
 }
@@ -326,9 +416,14 @@ static inline void skip_put_bits(PutBitContext *s, int n)
     s->index += n;
 #else
     s->bit_left -= n;
+#ifdef BITSTREAM_WRITER_64
+    s->buf_ptr-= 8*(s->bit_left>>6);
+    s->bit_left &= 63;
+#else
     s->buf_ptr-= 4*(s->bit_left>>5);
     s->bit_left &= 31;
 #endif
+#endif
 }
 
 /**
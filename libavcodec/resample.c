@@ -26,6 +26,7 @@
 
 #include "avcodec.h"
 #include "audioconvert.h"
+#include "resampledsp.h"
 #include "libavutil/opt.h"
 #include "libavutil/samplefmt.h"
 
@@ -279,7 +280,7 @@ ReSampleContext *av_audio_resample_init(int output_channels, int input_channels,
 /* XXX: optimize it ! */
 int audio_resample(ReSampleContext *s, short *output, short *input, int nb_samples)
 {
-    int i, nb_samples1;
+    int i, nb_samples1, consumed;
     short *bufin[MAX_CHANNELS];
     short *bufout[MAX_CHANNELS];
     short *buftmp2[MAX_CHANNELS], *buftmp3[MAX_CHANNELS];
@@ -369,15 +370,12 @@ int audio_resample(ReSampleContext *s, short *output, short *input, int nb_sampl
 
     nb_samples += s->temp_len;
 
-    /* resample each channel */
-    nb_samples1 = 0; /* avoid warning */
+    /* resample all channels at once, they share the filter phases */
+    nb_samples1 = ff_resample_channels(s->resample_context, buftmp3, bufin,
+                                       s->filter_channels, &consumed,
+                                       nb_samples, lenout, 1);
+    s->temp_len = nb_samples - consumed;
     for (i = 0; i < s->filter_channels; i++) {
-        int consumed;
-        int is_last = i + 1 == s->filter_channels;
-
-        nb_samples1 = av_resample(s->resample_context, buftmp3[i], bufin[i],
-                                  &consumed, nb_samples, lenout, is_last);
-        s->temp_len = nb_samples - consumed;
         s->temp[i] = av_realloc(s->temp[i], s->temp_len * sizeof(short));
         memcpy(s->temp[i], bufin[i] + consumed, s->temp_len * sizeof(short));
     }
@@ -27,6 +27,7 @@
 
 #include "avcodec.h"
 #include "dsputil.h"
+#include "resampledsp.h"
 
 #ifndef CONFIG_RESAMPLE_HP
 #define FILTER_SHIFT 15
@@ -69,8 +70,31 @@ typedef struct AVResampleContext{
     int phase_shift;
     int phase_mask;
     int linear;
+    ResampleDSPContext dsp;
 }AVResampleContext;
 
+static void filter_int16_c(int32_t *dst, const int16_t * const *src,
+                           int nb_channels, int offset,
+                           const int16_t *filter, int len)
+{
+    int ch, i;
+
+    for (ch = 0; ch < nb_channels; ch++) {
+        const int16_t *p = src[ch] + offset;
+        int32_t val = 0;
+        for (i = 0; i < len; i++)
+            val += p[i] * (int32_t)filter[i];
+        dst[ch] = val;
+    }
+}
+
+void ff_resampledsp_init(ResampleDSPContext *c)
+{
+    c->filter_int16 = filter_int16_c;
+
+    if (HAVE_MMX) ff_resampledsp_init_mmx(c);
+}
+
 /**
  * 0th order modified bessel function of the first kind.
  */
@@ -197,6 +221,7 @@ AVResampleContext *av_resample_init(int out_rate, int in_rate, int filter_size,
     c->phase_shift= phase_shift;
     c->phase_mask= phase_count-1;
     c->linear= linear;
+    ff_resampledsp_init(&c->dsp);
 
     c->filter_length= FFMAX((int)ceil(filter_size/factor), 1);
     c->filter_bank= av_mallocz(c->filter_length*(phase_count+1)*sizeof(FELEM));
@@ -229,8 +254,30 @@ void av_resample_compensate(AVResampleContext *c, int sample_delta, int compensa
     c->dst_incr = c->ideal_dst_incr - c->ideal_dst_incr * (int64_t)sample_delta / compensation_distance;
 }
 
-int av_resample(AVResampleContext *c, short *dst, short *src, int *consumed, int src_size, int dst_size, int update_ctx){
-    int dst_index, i;
+/**
+ * Apply one filter phase to all channels.
+ */
+static void filter_channels(AVResampleContext *c, FELEM2 *val, short **src,
+                            int nb_channels, int sample_index, FELEM *filter)
+{
+#ifndef CONFIG_RESAMPLE_HP
+    c->dsp.filter_int16(val, (const int16_t * const *)src, nb_channels,
+                        sample_index, filter, c->filter_length);
+#else
+    int ch, i;
+
+    for (ch = 0; ch < nb_channels; ch++) {
+        val[ch] = 0;
+        for (i = 0; i < c->filter_length; i++)
+            val[ch] += src[ch][sample_index + i] * (FELEM2)filter[i];
+    }
+#endif
+}
+
+int ff_resample_channels(AVResampleContext *c, short **dst, short **src,
+                         int nb_channels, int *consumed, int src_size,
+                         int dst_size, int update_ctx){
+    int dst_index, i, ch;
     int index= c->index;
     int frac= c->frac;
     int dst_incr_frac= c->dst_incr % c->src_incr;
@@ -243,7 +290,8 @@ int av_resample(AVResampleContext *c, short *dst, short *src, int *consumed, int
         dst_size= FFMIN(dst_size, (src_size-1-index) * (int64_t)c->src_incr / c->dst_incr);
 
         for(dst_index=0; dst_index < dst_size; dst_index++){
-            dst[dst_index] = src[index2>>32];
+            for (ch = 0; ch < nb_channels; ch++)
+                dst[ch][dst_index] = src[ch][index2>>32];
             index2 += incr;
         }
         frac += dst_index * dst_incr_frac;
@@ -254,32 +302,37 @@ int av_resample(AVResampleContext *c, short *dst, short *src, int *consumed, int
     for(dst_index=0; dst_index < dst_size; dst_index++){
         FELEM *filter= c->filter_bank + c->filter_length*(index & c->phase_mask);
         int sample_index= index >> c->phase_shift;
-        FELEM2 val=0;
+        FELEM2 val[RESAMPLE_MAX_CHANNELS];
 
         if(sample_index < 0){
-            for(i=0; i<c->filter_length; i++)
-                val += src[FFABS(sample_index + i) % src_size] * filter[i];
+            for (ch = 0; ch < nb_channels; ch++) {
+                val[ch] = 0;
+                for(i=0; i<c->filter_length; i++)
+                    val[ch] += src[ch][FFABS(sample_index + i) % src_size] * filter[i];
+            }
         }else if(sample_index + c->filter_length > src_size){
             break;
         }else if(c->linear){
-            FELEM2 v2=0;
-            for(i=0; i<c->filter_length; i++){
-                val += src[sample_index + i] * (FELEM2)filter[i];
-                v2  += src[sample_index + i] * (FELEM2)filter[i + c->filter_length];
-            }
-            val+=(v2-val)*(FELEML)frac / c->src_incr;
+            FELEM2 v2[RESAMPLE_MAX_CHANNELS];
+
+            filter_channels(c, val, src, nb_channels, sample_index, filter);
+            filter_channels(c, v2,  src, nb_channels, sample_index,
+                            filter + c->filter_length);
+            for (ch = 0; ch < nb_channels; ch++)
+                val[ch] += (v2[ch] - val[ch]) * (FELEML)frac / c->src_incr;
         }else{
-            for(i=0; i<c->filter_length; i++){
-                val += src[sample_index + i] * (FELEM2)filter[i];
-            }
+            filter_channels(c, val, src, nb_channels, sample_index, filter);
         }
 
+        for (ch = 0; ch < nb_channels; ch++) {
+            FELEM2 v = val[ch];
 #ifdef CONFIG_RESAMPLE_AUDIOPHILE_KIDDY_MODE
-        dst[dst_index] = av_clip_int16(lrintf(val));
+            dst[ch][dst_index] = av_clip_int16(lrintf(v));
 #else
-        val = (val + (1<<(FILTER_SHIFT-1)))>>FILTER_SHIFT;
-        dst[dst_index] = (unsigned)(val + 32768) > 65535 ? (val>>31) ^ 32767 : val;
+            v = (v + (1<<(FILTER_SHIFT-1)))>>FILTER_SHIFT;
+            dst[ch][dst_index] = (unsigned)(v + 32768) > 65535 ? (v>>31) ^ 32767 : v;
 #endif
+        }
 
         frac += dst_incr_frac;
         index += dst_incr;
@@ -318,3 +371,8 @@ av_log(NULL, AV_LOG_DEBUG, "%d %d %d\n", c->dst_incr, c->ideal_dst_incr, c->comp
 
     return dst_index;
 }
+
+int av_resample(AVResampleContext *c, short *dst, short *src, int *consumed, int src_size, int dst_size, int update_ctx){
+    return ff_resample_channels(c, &dst, &src, 1, consumed, src_size,
+                                dst_size, update_ctx);
+}
@@ -0,0 +1,52 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_RESAMPLEDSP_H
+#define AVCODEC_RESAMPLEDSP_H
+
+#include <stdint.h>
+
+typedef struct ResampleDSPContext {
+    /**
+     * Apply one phase of the polyphase filter to several channels:
+     * dst[ch] = sum of src[ch][offset + i] * filter[i] for i < len,
+     * with 32-bit wraparound.
+     * The coefficients are loaded once for all channels.
+     */
+    void (*filter_int16)(int32_t *dst, const int16_t * const *src,
+                         int nb_channels, int offset,
+                         const int16_t *filter, int len);
+} ResampleDSPContext;
+
+void ff_resampledsp_init(ResampleDSPContext *c);
+void ff_resampledsp_init_mmx(ResampleDSPContext *c);
+
+#define RESAMPLE_MAX_CHANNELS 8
+
+struct AVResampleContext;
+
+/**
+ * Same as av_resample(), for up to RESAMPLE_MAX_CHANNELS channels at once.
+ * All channels must have the same number of samples, and are resampled
+ * with the same filter phases, which are computed once per output sample.
+ */
+int ff_resample_channels(struct AVResampleContext *c, short **dst, short **src,
+                         int nb_channels, int *consumed, int src_size,
+                         int dst_size, int update_ctx);
+
+#endif /* AVCODEC_RESAMPLEDSP_H */
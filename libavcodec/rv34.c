@@ -30,6 +30,7 @@
 #include "golomb.h"
 #include "mathops.h"
 #include "rectangle.h"
+#include "thread.h"
 
 #include "rv34vlc.h"
 #include "rv34data.h"
@@ -703,6 +704,13 @@ static inline void rv34_mc(RV34DecContext *r, const int block_type,
             uvmx = uvmy = 4;
     }
     dxy = ly*4 + lx;
+    if (HAVE_THREADS && (s->avctx->active_thread_type & FF_THREAD_FRAME)) {
+        /* wait for the lowest luma and chroma rows read by the subpel filters */
+        int mb_row = FFMAX(s->mb_y * 16 + yoff + my + (height << 3) + 3,
+                           (s->mb_y * 8 + (yoff >> 1) + umy + (height << 2) + 1) * 2) >> 4;
+        ff_thread_await_progress((AVFrame*)(dir ? s->next_picture_ptr : s->last_picture_ptr),
+                                 av_clip(mb_row, 0, s->mb_height - 1), 0);
+    }
     srcY = dir ? s->next_picture_ptr->data[0] : s->last_picture_ptr->data[0];
     srcU = dir ? s->next_picture_ptr->data[1] : s->last_picture_ptr->data[1];
     srcV = dir ? s->next_picture_ptr->data[2] : s->last_picture_ptr->data[2];
@@ -823,6 +831,7 @@ static int rv34_decode_mv(RV34DecContext *r, int block_type)
         }
     case RV34_MB_B_DIRECT:
         //surprisingly, it uses motion scheme from next reference frame
+        ff_thread_await_progress((AVFrame*)s->next_picture_ptr, s->mb_y, 0);
         next_bt = s->next_picture_ptr->mb_type[s->mb_x + s->mb_y * s->mb_stride];
         if(IS_INTRA(next_bt) || IS_SKIP(next_bt)){
             ZERO8x2(s->current_picture_ptr->motion_val[0][s->mb_x * 2 + s->mb_y * 2 * s->b8_stride], s->b8_stride);
@@ -1199,7 +1208,7 @@ static int rv34_decode_macroblock(RV34DecContext *r, int8_t *intra_types)
     r->cbp_chroma[mb_pos] = cbp >> 16;
     if(s->pict_type == AV_PICTURE_TYPE_I)
         r->deblock_coefs[mb_pos] = 0xFFFF;
-    else
+    else if(!r->deblock_deferred)
         r->deblock_coefs[mb_pos] = rv34_set_deblock_coef(r) | r->cbp_luma[mb_pos];
     s->current_picture_ptr->qscale_table[mb_pos] = s->qscale;
 
@@ -1267,48 +1276,60 @@ static inline int slice_compare(SliceInfo *si1, SliceInfo *si2)
            si1->pts    != si2->pts;
 }
 
-static int rv34_decode_slice(RV34DecContext *r, int end, const uint8_t* buf, int buf_size)
+static int rv34_decoder_realloc(RV34DecContext *r)
+{
+    r->intra_types_stride = r->s.mb_width*4 + 4;
+    r->intra_types_hist = av_realloc(r->intra_types_hist, r->intra_types_stride * 4 * 2 * sizeof(*r->intra_types_hist));
+    r->intra_types = r->intra_types_hist + r->intra_types_stride * 4;
+    r->mb_type = av_realloc(r->mb_type, r->s.mb_stride * r->s.mb_height * sizeof(*r->mb_type));
+    r->cbp_luma   = av_realloc(r->cbp_luma,   r->s.mb_stride * r->s.mb_height * sizeof(*r->cbp_luma));
+    r->cbp_chroma = av_realloc(r->cbp_chroma, r->s.mb_stride * r->s.mb_height * sizeof(*r->cbp_chroma));
+    r->deblock_coefs = av_realloc(r->deblock_coefs, r->s.mb_stride * r->s.mb_height * sizeof(*r->deblock_coefs));
+
+    if(!r->intra_types_hist || !r->mb_type || !r->cbp_luma || !r->cbp_chroma || !r->deblock_coefs)
+        return AVERROR(ENOMEM);
+    return 0;
+}
+
+/**
+ * Start a new frame described by the current slice header.
+ */
+static int rv34_frame_start(RV34DecContext *r)
 {
     MpegEncContext *s = &r->s;
-    GetBitContext *gb = &s->gb;
-    int mb_pos;
-    int res;
 
-    init_get_bits(&r->s.gb, buf, buf_size*8);
-    res = r->parse_slice_header(r, gb, &r->si);
-    if(res < 0){
-        av_log(s->avctx, AV_LOG_ERROR, "Incorrect or unknown slice header\n");
+    if(s->width != r->si.width || s->height != r->si.height){
+        av_log(s->avctx, AV_LOG_DEBUG, "Changing dimensions to %dx%d\n", r->si.width,r->si.height);
+        MPV_common_end(s);
+        s->width  = r->si.width;
+        s->height = r->si.height;
+        avcodec_set_dimensions(s->avctx, s->width, s->height);
+        if(MPV_common_init(s) < 0)
+            return -1;
+        if(rv34_decoder_realloc(r) < 0)
+            return -1;
+    }
+    s->pict_type = r->si.type ? r->si.type : AV_PICTURE_TYPE_I;
+    if(MPV_frame_start(s, s->avctx) < 0)
         return -1;
+    ff_er_frame_start(s);
+    r->cur_pts = r->si.pts;
+    if(s->pict_type != AV_PICTURE_TYPE_B){
+        r->last_pts = r->next_pts;
+        r->next_pts = r->cur_pts;
     }
+    s->mb_x = s->mb_y = 0;
+    ff_thread_finish_setup(s->avctx);
+    return 0;
+}
 
-    if ((s->mb_x == 0 && s->mb_y == 0) || s->current_picture_ptr==NULL) {
-        if(s->width != r->si.width || s->height != r->si.height){
-            av_log(s->avctx, AV_LOG_DEBUG, "Changing dimensions to %dx%d\n", r->si.width,r->si.height);
-            MPV_common_end(s);
-            s->width  = r->si.width;
-            s->height = r->si.height;
-            avcodec_set_dimensions(s->avctx, s->width, s->height);
-            if(MPV_common_init(s) < 0)
-                return -1;
-            r->intra_types_stride = s->mb_width*4 + 4;
-            r->intra_types_hist = av_realloc(r->intra_types_hist, r->intra_types_stride * 4 * 2 * sizeof(*r->intra_types_hist));
-            r->intra_types = r->intra_types_hist + r->intra_types_stride * 4;
-            r->mb_type = av_realloc(r->mb_type, r->s.mb_stride * r->s.mb_height * sizeof(*r->mb_type));
-            r->cbp_luma   = av_realloc(r->cbp_luma,   r->s.mb_stride * r->s.mb_height * sizeof(*r->cbp_luma));
-            r->cbp_chroma = av_realloc(r->cbp_chroma, r->s.mb_stride * r->s.mb_height * sizeof(*r->cbp_chroma));
-            r->deblock_coefs = av_realloc(r->deblock_coefs, r->s.mb_stride * r->s.mb_height * sizeof(*r->deblock_coefs));
-        }
-        s->pict_type = r->si.type ? r->si.type : AV_PICTURE_TYPE_I;
-        if(MPV_frame_start(s, s->avctx) < 0)
-            return -1;
-        ff_er_frame_start(s);
-        r->cur_pts = r->si.pts;
-        if(s->pict_type != AV_PICTURE_TYPE_B){
-            r->last_pts = r->next_pts;
-            r->next_pts = r->cur_pts;
-        }
-        s->mb_x = s->mb_y = 0;
-    }
+/**
+ * Decode the macroblocks of a slice whose header has already been parsed.
+ */
+static int rv34_decode_slice_mbs(RV34DecContext *r, int end, int buf_size)
+{
+    MpegEncContext *s = &r->s;
+    int mb_pos;
 
     r->si.end = end;
     s->qscale = r->si.quant;
@@ -1344,8 +1365,11 @@ static int rv34_decode_slice(RV34DecContext *r, int end, const uint8_t* buf, int
             memmove(r->intra_types_hist, r->intra_types, r->intra_types_stride * 4 * sizeof(*r->intra_types_hist));
             memset(r->intra_types, -1, r->intra_types_stride * 4 * sizeof(*r->intra_types_hist));
 
-            if(r->loop_filter && s->mb_y >= 2)
+            if(r->loop_filter && s->mb_y >= 2){
                 r->loop_filter(r, s->mb_y - 2);
+                /* filtering a row still modifies the bottom of the row above */
+                ff_thread_report_progress((AVFrame*)s->current_picture_ptr, s->mb_y - 3, 0);
+            }
         }
         if(s->mb_x == s->resync_mb_x)
             s->first_slice_line=0;
@@ -1356,6 +1380,199 @@ static int rv34_decode_slice(RV34DecContext *r, int end, const uint8_t* buf, int
     return s->mb_y == s->mb_height;
 }
 
+static int rv34_decode_slice(RV34DecContext *r, int end, const uint8_t* buf, int buf_size)
+{
+    MpegEncContext *s = &r->s;
+    GetBitContext *gb = &s->gb;
+    int res;
+
+    init_get_bits(&r->s.gb, buf, buf_size*8);
+    res = r->parse_slice_header(r, gb, &r->si);
+    if(res < 0){
+        av_log(s->avctx, AV_LOG_ERROR, "Incorrect or unknown slice header\n");
+        return -1;
+    }
+
+    if ((s->mb_x == 0 && s->mb_y == 0) || s->current_picture_ptr==NULL) {
+        if(rv34_frame_start(r) < 0)
+            return -1;
+    }
+
+    return rv34_decode_slice_mbs(r, end, buf_size);
+}
+
+static int get_slice_offset(AVCodecContext *avctx, const uint8_t *buf, int n)
+{
+    if(avctx->slice_count) return avctx->slice_offset[n];
+    else                   return AV_RL32(buf + n*8 - 4) == 1 ? AV_RL32(buf + n*8) :  AV_RB32(buf + n*8);
+}
+
+static void rv34_free_slice_ctx(RV34DecContext *r)
+{
+    int i;
+
+    if(!r->slice_ctx)
+        return;
+    for(i = 0; r->slice_ctx[i]; i++){
+        av_freep(&r->slice_ctx[i]->intra_types_hist);
+        av_freep(&r->slice_ctx[i]);
+    }
+    av_freep(&r->slice_ctx);
+}
+
+/** slice decoded by one of the slice threads */
+typedef struct RV34SliceJob {
+    const uint8_t *buf;
+    int size;
+    int start, end;      ///< first and one past the last macroblock of the slice
+    int stop;            ///< macroblock at which decoding of the slice stopped
+    int error_count, error_occurred;
+} RV34SliceJob;
+
+static int rv34_decode_slice_thread(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    RV34DecContext *r = avctx->priv_data;
+    RV34DecContext *t = r->slice_ctx[threadnr];
+    RV34SliceJob *job = (RV34SliceJob*)arg + jobnr;
+    MpegEncContext *dup = threadnr ? r->s.thread_context[threadnr] : &r->s;
+    int8_t *hist = t->intra_types_hist;
+    int hist_stride = t->intra_types_stride;
+
+    if(dup != &r->s)
+        ff_update_duplicate_context(dup, &r->s);
+    memcpy(t, r, sizeof(*t));
+    memcpy(&t->s, dup, sizeof(t->s));
+
+    if(!hist || hist_stride != r->intra_types_stride)
+        hist = av_realloc(hist, r->intra_types_stride * 4 * 2 * sizeof(*hist));
+    t->intra_types_hist = hist;
+    if(!hist){
+        t->intra_types_stride = 0;
+        job->error_count = INT_MAX;
+        return -1;
+    }
+    t->intra_types = hist + r->intra_types_stride * 4;
+    t->loop_filter = NULL;
+    t->deblock_deferred = 1;
+    t->s.error_count = 0;
+    t->s.error_occurred = 0;
+
+    init_get_bits(&t->s.gb, job->buf, job->size*8);
+    if(t->parse_slice_header(t, &t->s.gb, &t->si) < 0){
+        av_log(avctx, AV_LOG_ERROR, "Incorrect or unknown slice header\n");
+        job->error_count = INT_MAX;
+        return -1;
+    }
+    t->s.mb_x = t->si.start % t->s.mb_width;
+    t->s.mb_y = t->si.start / t->s.mb_width;
+    rv34_decode_slice_mbs(t, job->end, job->size);
+
+    job->stop           = t->s.mb_x + t->s.mb_y * t->s.mb_width;
+    job->error_count    = t->s.error_count;
+    job->error_occurred = t->s.error_occurred;
+    return 0;
+}
+
+/**
+ * Decode all slices of a frame in parallel and deblock the frame afterwards.
+ *
+ * @return 1 if the frame was started, -1 otherwise
+ */
+static int rv34_decode_slices_threaded(RV34DecContext *r, const uint8_t *buf, int buf_size,
+                                       const uint8_t *slices_hdr, int slice_count)
+{
+    MpegEncContext *s = &r->s;
+    AVCodecContext *avctx = s->avctx;
+    RV34SliceJob *jobs;
+    SliceInfo si;
+    int i, n, row, mb_pos;
+
+    if(!r->slice_ctx){
+        int threads = ff_thread_slice_count(avctx);
+        r->slice_ctx = av_mallocz((threads + 1) * sizeof(*r->slice_ctx));
+        if(!r->slice_ctx)
+            return -1;
+        for(i = 0; i < threads; i++){
+            r->slice_ctx[i] = av_mallocz(sizeof(**r->slice_ctx));
+            if(!r->slice_ctx[i]){
+                rv34_free_slice_ctx(r);
+                return -1;
+            }
+        }
+    }
+
+    init_get_bits(&s->gb, buf + get_slice_offset(avctx, slices_hdr, 0), (buf_size - get_slice_offset(avctx, slices_hdr, 0))*8);
+    if(r->parse_slice_header(r, &s->gb, &r->si) < 0 || rv34_frame_start(r) < 0)
+        return -1;
+
+    jobs = av_malloc(slice_count * sizeof(*jobs));
+    if(!jobs)
+        return -1;
+    for(n = 0; n < slice_count; n++){
+        int offset = get_slice_offset(avctx, slices_hdr, n);
+
+        if(offset > buf_size){
+            av_log(avctx, AV_LOG_ERROR, "Slice offset is greater than frame size\n");
+            break;
+        }
+        jobs[n].buf   = buf + offset;
+        jobs[n].start = n ? jobs[n-1].end : 0;
+        jobs[n].end   = s->mb_width * s->mb_height;
+        jobs[n].stop  = jobs[n].start;
+        jobs[n].error_count = jobs[n].error_occurred = 0;
+        if(n+1 == slice_count){
+            jobs[n].size = buf_size - offset;
+            n++;
+            break;
+        }
+        jobs[n].size = get_slice_offset(avctx, slices_hdr, n+1) - offset;
+        init_get_bits(&s->gb, buf+get_slice_offset(avctx, slices_hdr, n+1), (buf_size-get_slice_offset(avctx, slices_hdr, n+1))*8);
+        if(r->parse_slice_header(r, &s->gb, &si) < 0){
+            /* the next slice cannot be decoded, so this is the last one */
+            if(n+2 < slice_count)
+                jobs[n].size = get_slice_offset(avctx, slices_hdr, n+2) - offset;
+            else
+                jobs[n].size = buf_size - offset;
+            n++;
+            break;
+        }
+        jobs[n].end = si.start;
+    }
+
+    avctx->execute2(avctx, rv34_decode_slice_thread, jobs, NULL, n);
+
+    for(i = 0; i < n; i++){
+        if(s->error_count == INT_MAX || jobs[i].error_count == INT_MAX)
+            s->error_count = INT_MAX;
+        else
+            s->error_count += jobs[i].error_count;
+        s->error_occurred |= jobs[i].error_occurred;
+    }
+
+    /* deblock coefficients depend on motion vectors of neighbouring slices */
+    if(s->pict_type != AV_PICTURE_TYPE_I){
+        for(i = 0; i < n; i++){
+            for(mb_pos = jobs[i].start; mb_pos < jobs[i].stop; mb_pos++){
+                int xy;
+                s->mb_x = mb_pos % s->mb_width;
+                s->mb_y = mb_pos / s->mb_width;
+                s->first_slice_line = mb_pos < jobs[i].start + s->mb_width;
+                xy = s->mb_x + s->mb_y * s->mb_stride;
+                r->deblock_coefs[xy] = rv34_set_deblock_coef(r) | r->cbp_luma[xy];
+            }
+        }
+    }
+    av_free(jobs);
+
+    if(r->loop_filter){
+        for(row = 0; row < s->mb_height - 1; row++){
+            r->loop_filter(r, row);
+            ff_thread_report_progress((AVFrame*)s->current_picture_ptr, row - 1, 0);
+        }
+    }
+    return 1;
+}
+
 /** @} */ // recons group end
 
 /**
@@ -1402,12 +1619,6 @@ av_cold int ff_rv34_decode_init(AVCodecContext *avctx)
     return 0;
 }
 
-static int get_slice_offset(AVCodecContext *avctx, const uint8_t *buf, int n)
-{
-    if(avctx->slice_count) return avctx->slice_offset[n];
-    else                   return AV_RL32(buf + n*8 - 4) == 1 ? AV_RL32(buf + n*8) :  AV_RB32(buf + n*8);
-}
-
 int ff_rv34_decode_frame(AVCodecContext *avctx,
                             void *data, int *data_size,
                             AVPacket *avpkt)
@@ -1459,6 +1670,9 @@ int ff_rv34_decode_frame(AVCodecContext *avctx,
        ||  avctx->skip_frame >= AVDISCARD_ALL)
         return buf_size;
 
+    if(HAVE_THREADS && (avctx->active_thread_type & FF_THREAD_SLICE) && slice_count > 1)
+        last = rv34_decode_slices_threaded(r, buf, buf_size, slices_hdr, slice_count);
+    else
     for(i=0; i<slice_count; i++){
         int offset= get_slice_offset(avctx, slices_hdr, i);
         int size;
@@ -1505,10 +1719,76 @@ int ff_rv34_decode_frame(AVCodecContext *avctx,
             ff_print_debug_info(s, pict);
         }
         s->current_picture_ptr= NULL; //so we can detect if frame_end wasnt called (find some nicer solution...)
+    }else if(HAVE_THREADS && (avctx->active_thread_type & FF_THREAD_FRAME) && s->current_picture_ptr){
+        /* later frame threads wait for this picture, so it must be
+         * finished even though some of its slices are missing */
+        av_log(avctx, AV_LOG_ERROR, "Frame is incomplete\n");
+        if(r->loop_filter)
+            r->loop_filter(r, s->mb_height - 1);
+        ff_er_frame_end(s);
+        MPV_frame_end(s);
+        s->current_picture_ptr= NULL;
+        return -1;
     }
     return buf_size;
 }
 
+av_cold int ff_rv34_decode_init_thread_copy(AVCodecContext *avctx)
+{
+    RV34DecContext *r = avctx->priv_data;
+    MpegEncContext *s = &r->s;
+
+    if (!avctx->is_copy) return 0;
+
+    /* The tables are allocated once the first thread is set up; the
+     * MpegEncContext is copied from the previous thread in
+     * ff_mpeg_update_thread_context() before the first frame is decoded. */
+    r->intra_types_hist = r->intra_types = NULL;
+    r->mb_type          = NULL;
+    r->cbp_luma         = NULL;
+    r->cbp_chroma       = NULL;
+    r->deblock_coefs    = NULL;
+    r->slice_ctx        = NULL;
+    memset(s, 0, sizeof(*s));
+    s->avctx = avctx;
+
+    return 0;
+}
+
+int ff_rv34_decode_update_thread_context(AVCodecContext *dst, const AVCodecContext *src)
+{
+    RV34DecContext *r = dst->priv_data, *r1 = src->priv_data;
+    MpegEncContext * const s = &r->s, * const s1 = &r1->s;
+    int inited = s->context_initialized;
+    int err;
+
+    if (dst == src || !s1->context_initialized) return 0;
+
+    if (inited && (s->width != s1->width || s->height != s1->height)) {
+        MPV_common_end(s);
+        s->width  = s1->width;
+        s->height = s1->height;
+        if ((err = MPV_common_init(s)) < 0)
+            return err;
+        inited = 0;
+    }
+
+    if ((err = ff_mpeg_update_thread_context(dst, src)))
+        return err;
+
+    if (!inited && (err = rv34_decoder_realloc(r)) < 0)
+        return err;
+
+    r->cur_pts  = r1->cur_pts;
+    r->last_pts = r1->last_pts;
+    r->next_pts = r1->next_pts;
+
+    /* a new frame is started by the first slice of each packet */
+    s->current_picture_ptr = NULL;
+
+    return 0;
+}
+
 av_cold int ff_rv34_decode_end(AVCodecContext *avctx)
 {
     RV34DecContext *r = avctx->priv_data;
@@ -1521,6 +1801,7 @@ av_cold int ff_rv34_decode_end(AVCodecContext *avctx)
     av_freep(&r->cbp_luma);
     av_freep(&r->cbp_chroma);
     av_freep(&r->deblock_coefs);
+    rv34_free_slice_ctx(r);
 
     return 0;
 }
@@ -32,6 +32,7 @@
 #include <stdint.h>
 #include "fft.h"
 #include "aacps.h"
+#include "sbrdsp.h"
 
 /**
  * Spectral Band Replication header - spectrum parameters that invoke a reset if they differ from the previous header.
@@ -85,9 +86,9 @@ typedef struct {
     ///Chirp factors
     float              bw_array[5];
     ///QMF values of the original signal
-    float              W[2][32][32][2];
+    DECLARE_ALIGNED(16, float, W)[2][32][32][2];
     ///QMF output of the HF adjustor
-    float              Y[2][38][64][2];
+    DECLARE_ALIGNED(16, float, Y)[2][38][64][2];
     float              g_temp[42][48];
     float              q_temp[42][48];
     uint8_t            s_indexmapped[8][48];
@@ -155,9 +156,9 @@ typedef struct {
     uint8_t            patch_num_subbands[6];
     uint8_t            patch_start_subband[6];
     ///QMF low frequency input to the HF generator
-    float              X_low[32][40][2];
+    DECLARE_ALIGNED(16, float, X_low)[32][40][2];
     ///QMF output of the HF generator
-    float              X_high[64][40][2];
+    DECLARE_ALIGNED(16, float, X_high)[64][40][2];
     ///QMF values of the reconstructed signal
     DECLARE_ALIGNED(16, float, X)[2][2][38][64];
     ///Zeroth coefficient used to filter the subband signals
@@ -180,6 +181,7 @@ typedef struct {
     DECLARE_ALIGNED(16, float, qmf_filter_scratch)[5][64];
     FFTContext         mdct_ana;
     FFTContext         mdct;
+    SBRDSPContext      dsp;
 } SpectralBandReplication;
 
 #endif /* AVCODEC_SBR_H */
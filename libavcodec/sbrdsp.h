@@ -0,0 +1,62 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_SBRDSP_H
+#define AVCODEC_SBRDSP_H
+
+#include <stdint.h>
+
+/**
+ * Spectral Band Replication DSP functions.
+ * All QMF buffers passed to the SBR decoder functions are 16-byte aligned.
+ */
+typedef struct SBRDSPContext {
+    /** z[k] = z[k] + z[k+64] + z[k+128] + z[k+192] + z[k+256], 0 <= k < 64 */
+    void (*sum64x5)(float *z);
+    /** @return the energy of n complex samples, the samples need not be aligned */
+    float (*sum_square)(float (*x)[2], int n);
+    /** negate the odd elements of a 64 element vector */
+    void (*neg_odd_64)(float *x);
+    /** reorder the 64 summed analysis samples in z into z+64 for the IMDCT */
+    void (*qmf_pre_shuffle)(float *z);
+    /** turn the 64 IMDCT outputs in z into 32 complex subband samples */
+    void (*qmf_post_shuffle)(float W[32][2], const float *z);
+    /** v[n] = src[63-2n], v[63-n] = -src[62-2n], 0 <= n < 32 */
+    void (*qmf_deint_neg)(float *v, const float *src);
+    /** v[n] = src0[n] - src1[63-n], v[127-n] = src0[n] + src1[63-n], 0 <= n < 64 */
+    void (*qmf_deint_bfly)(float *v, const float *src0, const float *src1);
+    /** covariance of one lowband subband for lags 0, 1 and 2 */
+    void (*autocorrelate)(const float x[40][2], float phi[3][2][2]);
+    /**
+     * Generate the samples start..end-1 of one highband subband from one
+     * lowband subband, its prediction coefficients and its chirp factor.
+     */
+    void (*hf_gen)(float (*X_high)[2], const float (*X_low)[2],
+                   const float alpha0[2], const float alpha1[2],
+                   float bw, int start, int end);
+    /**
+     * Y[m] = X_high[m][ixh] * g_filt[m], 0 <= m < m_max
+     */
+    void (*hf_g_filt)(float (*Y)[2], const float (*X_high)[40][2],
+                      const float *g_filt, int m_max, intptr_t ixh);
+} SBRDSPContext;
+
+void ff_sbrdsp_init(SBRDSPContext *s);
+void ff_sbrdsp_init_mmx(SBRDSPContext *s);
+
+#endif /* AVCODEC_SBRDSP_H */
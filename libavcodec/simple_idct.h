@@ -36,6 +36,9 @@ void ff_simple_idct_add(uint8_t *dest, int line_size, DCTELEM *block);
 void ff_simple_idct_mmx(int16_t *block);
 void ff_simple_idct_add_mmx(uint8_t *dest, int line_size, int16_t *block);
 void ff_simple_idct_put_mmx(uint8_t *dest, int line_size, int16_t *block);
+void ff_simple_idct_sse2(int16_t *block);
+void ff_simple_idct_add_sse2(uint8_t *dest, int line_size, int16_t *block);
+void ff_simple_idct_put_sse2(uint8_t *dest, int line_size, int16_t *block);
 void ff_simple_idct(DCTELEM *block);
 
 void ff_simple_idct248_put(uint8_t *dest, int line_size, DCTELEM *block);
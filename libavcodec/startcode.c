@@ -0,0 +1,62 @@
+/*
+ * Start code search
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Start code search, shared by the parsers and the demuxers.
+ */
+
+#include "config.h"
+#include "libavutil/intreadwrite.h"
+#include "startcode.h"
+
+#if ARCH_X86
+#   include "x86/startcode.h"
+#endif
+
+int ff_startcode_find_zero_pair(const uint8_t *buf, int size)
+{
+    int i = 0;
+
+#ifdef find_zero_pair_simd
+    i = find_zero_pair_simd(buf, size);
+#endif
+#if HAVE_FAST_UNALIGNED
+    /* a byte of x | y is 0 iff the byte at the same position and the one
+     * after it are both 0 */
+#if HAVE_FAST_64BIT
+    for (; i + 9 <= size; i += 8) {
+        uint64_t x = AV_RN64(buf + i) | AV_RN64(buf + i + 1);
+        if ((x - 0x0101010101010101ULL) & ~x & 0x8080808080808080ULL)
+            break;
+    }
+#else
+    for (; i + 5 <= size; i += 4) {
+        uint32_t x = AV_RN32(buf + i) | AV_RN32(buf + i + 1);
+        if ((x - 0x01010101U) & ~x & 0x80808080U)
+            break;
+    }
+#endif
+#endif
+    for (; i + 1 < size; i++)
+        if (!(buf[i] | buf[i + 1]))
+            return i;
+    return size;
+}
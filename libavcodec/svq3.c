@@ -1056,7 +1056,7 @@ static int svq3_decode_frame(AVCodecContext *avctx,
                 mb_type += 4;
             }
             if ((unsigned)mb_type > 33 || svq3_decode_mb(svq3, mb_type)) {
-                av_log(h->s.avctx, AV_LOG_ERROR, "error while decoding MB %d %d\n", s->mb_x, s->mb_y);
+                av_log_ratelimited(h->s.avctx, AV_LOG_ERROR, "error while decoding MB %d %d\n", s->mb_x, s->mb_y);
                 return -1;
             }
 
@@ -33,5 +33,6 @@ typedef struct SynthFilterContext {
 
 void ff_synth_filter_init(SynthFilterContext *c);
 void ff_synth_filter_init_arm(SynthFilterContext *c);
+void ff_synth_filter_init_mmx(SynthFilterContext *c);
 
 #endif /* AVCODEC_SYNTH_FILTER_H */
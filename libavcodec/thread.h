@@ -48,6 +48,17 @@ void ff_thread_flush(AVCodecContext *avctx);
 int ff_thread_decode_frame(AVCodecContext *avctx, AVFrame *picture,
                            int *got_picture_ptr, AVPacket *avpkt);
 
+/**
+ * Submits a new picture to an encoding thread.
+ * Returns the packet of the oldest picture still being encoded; nothing
+ * is returned for the first thread_count-1 pictures. Once pict is NULL,
+ * the remaining packets are returned one per call.
+ *
+ * Parameters are the same as avcodec_encode_video().
+ */
+int ff_thread_encode_video(AVCodecContext *avctx, uint8_t *buf, int buf_size,
+                           const AVFrame *pict);
+
 /**
  * If the codec defines update_thread_context(), call this
  * when they are ready for the next thread to start decoding
@@ -108,6 +119,21 @@ int ff_thread_get_buffer(AVCodecContext *avctx, AVFrame *f);
  */
 void ff_thread_release_buffer(AVCodecContext *avctx, AVFrame *f);
 
+/**
+ * Returns the number of threads execute() and execute2() can run jobs on,
+ * which is the number of slice contexts a slice-threaded codec should set up.
+ *
+ * @param avctx The current context.
+ */
+static inline int ff_thread_slice_count(const AVCodecContext *avctx)
+{
+    if (!(avctx->active_thread_type&FF_THREAD_SLICE))
+        return 1;
+    if (avctx->active_thread_type&FF_THREAD_FRAME)
+        return avctx->slice_thread_count;
+    return avctx->thread_count;
+}
+
 int ff_thread_init(AVCodecContext *s);
 void ff_thread_free(AVCodecContext *s);
 
@@ -26,6 +26,7 @@
  */
 
 #include "libavutil/avstring.h"
+#include "libavutil/buffer.h"
 #include "libavutil/integer.h"
 #include "libavutil/crc.h"
 #include "libavutil/pixdesc.h"
@@ -43,6 +44,9 @@
 #include <stdarg.h>
 #include <limits.h>
 #include <float.h>
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
 
 static int volatile entangled_thread_counter=0;
 static int (*ff_lockmgr_cb)(void **mutex, enum AVLockOp op);
@@ -108,15 +112,199 @@ void avcodec_set_dimensions(AVCodecContext *s, int width, int height){
 
 typedef struct InternalBuffer{
     int last_pic_num;
+    AVBufferRef *buf[4];
     uint8_t *base[4];
     uint8_t *data[4];
     int linesize[4];
     int width, height;
     enum PixelFormat pix_fmt;
+    int size;                ///< size of the audio buffer
 }InternalBuffer;
 
 #define INTERNAL_BUFFER_SIZE (32+1)
 
+/**
+ * Pools the planes of the internal buffers are taken from. They are shared
+ * by a codec context and its frame threads, so that frames released by one
+ * thread are reused by the others.
+ */
+typedef struct FramePool {
+    AVBufferPool *pools[4];
+    int size[4];             ///< size of the buffers of each pool
+    int linesize[4];
+    int offset[4];           ///< offset of the picture in each plane, past the edges
+    int width, height;
+    enum PixelFormat pix_fmt;
+#if HAVE_PTHREADS
+    pthread_mutex_t lock;    ///< frame threads may get buffers concurrently
+#endif
+} FramePool;
+
+/* what AVCodecContext.internal_buffer points to */
+typedef struct InternalBufferList {
+    InternalBuffer buffer[INTERNAL_BUFFER_SIZE];
+    int picture_number;
+    AVBufferRef *pool;       ///< FramePool
+    uint8_t *audio_scratch;  ///< output of audio decoders without CODEC_CAP_AUDIO_FRAME
+} InternalBufferList;
+
+static void frame_pool_free(void *opaque, uint8_t *data)
+{
+    FramePool *pool = (FramePool *)data;
+    int i;
+
+    for (i = 0; i < 4; i++)
+        av_buffer_pool_uninit(&pool->pools[i]);
+#if HAVE_PTHREADS
+    pthread_mutex_destroy(&pool->lock);
+#endif
+    av_free(pool);
+}
+
+static int alloc_internal_buffers(AVCodecContext *s, AVBufferRef *pool_ref)
+{
+    InternalBufferList *list = av_mallocz(sizeof(*list));
+    FramePool *pool;
+
+    if (!list)
+        return AVERROR(ENOMEM);
+
+    if (pool_ref) {
+        if (!(list->pool = av_buffer_ref(pool_ref)))
+            goto fail;
+    } else {
+        if (!(pool = av_mallocz(sizeof(*pool))))
+            goto fail;
+        if (!(list->pool = av_buffer_create((uint8_t *)pool, sizeof(*pool),
+                                            frame_pool_free, NULL, 0))) {
+            av_free(pool);
+            goto fail;
+        }
+#if HAVE_PTHREADS
+        pthread_mutex_init(&pool->lock, NULL);
+#endif
+    }
+    s->internal_buffer = list;
+    return 0;
+fail:
+    av_free(list);
+    return AVERROR(ENOMEM);
+}
+
+int ff_share_frame_pool(AVCodecContext *dst, AVCodecContext *src)
+{
+    int ret;
+
+    if (!src->internal_buffer && (ret = alloc_internal_buffers(src, NULL)) < 0)
+        return ret;
+    return alloc_internal_buffers(dst, ((InternalBufferList *)src->internal_buffer)->pool);
+}
+
+/* new buffers are grey, like the pictures of a decoder that has no reference yet */
+static AVBufferRef *alloc_grey_buffer(int size)
+{
+    AVBufferRef *buf = av_buffer_alloc(size);
+    if (buf)
+        memset(buf->data, 128, size);
+    return buf;
+}
+
+/**
+ * Make the pools serve buffers for the current dimensions and pixel format
+ * of s. Must be called with the pool locked.
+ */
+static int update_frame_pool(AVCodecContext *s, FramePool *pool)
+{
+    int i;
+    int w= s->width;
+    int h= s->height;
+    int h_chroma_shift, v_chroma_shift;
+    int size[4] = {0};
+    int tmpsize;
+    int unaligned;
+    AVPicture picture;
+    int stride_align[4];
+    const int pixel_size = av_pix_fmt_descriptors[s->pix_fmt].comp[0].step_minus1+1;
+
+    if (pool->pools[0] && pool->width == s->width && pool->height == s->height &&
+        pool->pix_fmt == s->pix_fmt)
+        return 0;
+
+    if (pool->pools[0] && s->active_thread_type&FF_THREAD_FRAME) {
+        av_log_missing_feature(s, "Width/height changing with frame threads is", 0);
+        return -1;
+    }
+
+    avcodec_get_chroma_sub_sample(s->pix_fmt, &h_chroma_shift, &v_chroma_shift);
+
+    avcodec_align_dimensions2(s, &w, &h, stride_align);
+
+    if(!(s->flags&CODEC_FLAG_EMU_EDGE)){
+        w+= EDGE_WIDTH*2;
+        h+= EDGE_WIDTH*2;
+    }
+
+    do {
+        // NOTE: do not align linesizes individually, this breaks e.g. assumptions
+        // that linesize[0] == 2*linesize[1] in the MPEG-encoder for 4:2:2
+        av_image_fill_linesizes(picture.linesize, s->pix_fmt, w);
+        // increase alignment of w for next try (rhs gives the lowest bit set in w)
+        w += w & ~(w-1);
+
+        unaligned = 0;
+        for (i=0; i<4; i++){
+            unaligned |= picture.linesize[i] % stride_align[i];
+        }
+    } while (unaligned);
+
+    tmpsize = av_image_fill_pointers(picture.data, s->pix_fmt, h, NULL, picture.linesize);
+    if (tmpsize < 0)
+        return -1;
+
+    for (i=0; i<3 && picture.data[i+1]; i++)
+        size[i] = picture.data[i+1] - picture.data[i];
+    size[i] = tmpsize - (picture.data[i] - picture.data[0]);
+
+    for(i=0; i<4; i++){
+        const int h_shift= i==0 ? 0 : h_chroma_shift;
+        const int v_shift= i==0 ? 0 : v_chroma_shift;
+
+        /* the buffers in use keep the old pool alive until released */
+        if (pool->size[i] != size[i] + 16 || !size[i]) {
+            av_buffer_pool_uninit(&pool->pools[i]);
+            pool->size[i] = 0;
+        }
+        if (size[i] && !pool->pools[i]) {
+            pool->pools[i] = av_buffer_pool_init(size[i] + 16, alloc_grey_buffer); //FIXME 16
+            if (!pool->pools[i])
+                return AVERROR(ENOMEM);
+            pool->size[i] = size[i] + 16;
+        }
+        pool->linesize[i] = picture.linesize[i];
+
+        // no edge if EDGE EMU or not planar YUV
+        if((s->flags&CODEC_FLAG_EMU_EDGE) || !size[2])
+            pool->offset[i] = 0;
+        else
+            pool->offset[i] = FFALIGN((pool->linesize[i]*EDGE_WIDTH>>v_shift) + (pixel_size*EDGE_WIDTH>>h_shift), stride_align[i]);
+    }
+    pool->width  = s->width;
+    pool->height = s->height;
+    pool->pix_fmt= s->pix_fmt;
+    return 0;
+}
+
+static void unref_internal_buffer(InternalBuffer *buf)
+{
+    int i;
+
+    for(i=0; i<4; i++){
+        av_buffer_unref(&buf->buf[i]);
+        buf->base[i]= NULL;
+        buf->data[i]= NULL;
+    }
+}
+
 void avcodec_align_dimensions2(AVCodecContext *s, int *width, int *height, int linesize_align[4]){
     int w_align= 1;
     int h_align= 1;
@@ -219,12 +407,88 @@ void avcodec_align_dimensions(AVCodecContext *s, int *width, int *height){
     *width=FFALIGN(*width, align);
 }
 
+static int audio_get_buffer(AVCodecContext *s, AVFrame *frame)
+{
+    InternalBufferList *list;
+    InternalBuffer *buf;
+    FramePool *pool;
+    int bps    = av_get_bytes_per_sample(s->sample_fmt);
+    int planes = frame->planar ? s->channels : 1;
+    int linesize, size, i;
+
+    if (bps <= 0 || s->channels <= 0 || frame->nb_samples <= 0 ||
+        frame->nb_samples > (INT_MAX / s->channels - 64) / bps) {
+        av_log(s, AV_LOG_ERROR, "invalid audio buffer parameters\n");
+        return -1;
+    }
+    linesize = FFALIGN(frame->nb_samples * bps * (s->channels / planes), 32);
+    /* the plane pointers are stored after the samples, so that they stay
+       valid in copies of the frame and go away with the buffer */
+    size     = linesize * planes + planes * sizeof(*frame->extended_data);
+
+    if(s->internal_buffer==NULL && alloc_internal_buffers(s, NULL) < 0)
+        return -1;
+    list = s->internal_buffer;
+    pool = (FramePool *)list->pool->data;
+    buf  = &list->buffer[s->internal_buffer_count];
+
+    if (buf->base[0] && buf->size < size)
+        unref_internal_buffer(buf);
+
+    if (!buf->base[0]) {
+#if HAVE_PTHREADS
+        pthread_mutex_lock(&pool->lock);
+#endif
+        /* the pool only grows, so that all the frames of a stream share it */
+        if (pool->size[0] < size) {
+            av_buffer_pool_uninit(&pool->pools[0]);
+            if ((pool->pools[0] = av_buffer_pool_init(size, NULL)))
+                pool->size[0] = size;
+        }
+        if (pool->pools[0] && (buf->buf[0] = av_buffer_pool_get(pool->pools[0]))) {
+            buf->base[0] = buf->data[0] = buf->buf[0]->data;
+            buf->size    = pool->size[0];
+        }
+#if HAVE_PTHREADS
+        pthread_mutex_unlock(&pool->lock);
+#endif
+        if (!buf->base[0])
+            return AVERROR(ENOMEM);
+    }
+
+    frame->extended_data = (uint8_t **)(buf->data[0] + linesize * planes);
+    for (i = 0; i < planes; i++)
+        frame->extended_data[i] = buf->data[0] + i * linesize;
+    for (i = 0; i < FF_ARRAY_ELEMS(frame->data); i++)
+        frame->data[i] = i < planes ? frame->extended_data[i] : NULL;
+    frame->base[0]     = buf->base[0];
+    frame->linesize[0] = linesize;
+    frame->type        = FF_BUFFER_TYPE_INTERNAL;
+    frame->format      = s->sample_fmt;
+    s->internal_buffer_count++;
+
+    if (s->pkt) {
+        frame->pkt_pts = s->pkt->pts;
+        frame->pkt_pos = s->pkt->pos;
+    } else {
+        frame->pkt_pts = AV_NOPTS_VALUE;
+        frame->pkt_pos = -1;
+    }
+    frame->reordered_opaque = s->reordered_opaque;
+
+    if(s->debug&FF_DEBUG_BUFFERS)
+        av_log(s, AV_LOG_DEBUG, "default_get_buffer called on frame %p, %d buffers used\n", frame, s->internal_buffer_count);
+
+    return 0;
+}
+
 int avcodec_default_get_buffer(AVCodecContext *s, AVFrame *pic){
-    int i;
+    int i, ret;
     int w= s->width;
     int h= s->height;
+    InternalBufferList *list;
     InternalBuffer *buf;
-    int *picture_number;
+    FramePool *pool;
 
     if(pic->data[0]!=NULL) {
         av_log(s, AV_LOG_ERROR, "pic->data[0]!=NULL in avcodec_default_get_buffer\n");
@@ -235,100 +499,53 @@ int avcodec_default_get_buffer(AVCodecContext *s, AVFrame *pic){
         return -1;
     }
 
+    if (s->codec_type == AVMEDIA_TYPE_AUDIO)
+        return audio_get_buffer(s, pic);
+
     if(av_image_check_size(w, h, 0, s))
         return -1;
 
-    if(s->internal_buffer==NULL){
-        s->internal_buffer= av_mallocz((INTERNAL_BUFFER_SIZE+1)*sizeof(InternalBuffer));
-    }
-#if 0
-    s->internal_buffer= av_fast_realloc(
-        s->internal_buffer,
-        &s->internal_buffer_size,
-        sizeof(InternalBuffer)*FFMAX(99,  s->internal_buffer_count+1)/*FIXME*/
-        );
-#endif
+    if(s->internal_buffer==NULL && alloc_internal_buffers(s, NULL) < 0)
+        return -1;
+    list = s->internal_buffer;
+    pool = (FramePool *)list->pool->data;
 
-    buf= &((InternalBuffer*)s->internal_buffer)[s->internal_buffer_count];
-    picture_number= &(((InternalBuffer*)s->internal_buffer)[INTERNAL_BUFFER_SIZE]).last_pic_num; //FIXME ugly hack
-    (*picture_number)++;
+    buf= &list->buffer[s->internal_buffer_count];
+    list->picture_number++;
 
-    if(buf->base[0] && (buf->width != w || buf->height != h || buf->pix_fmt != s->pix_fmt)){
-        if(s->active_thread_type&FF_THREAD_FRAME) {
-            av_log_missing_feature(s, "Width/height changing with frame threads is", 0);
-            return -1;
-        }
-
-        for(i=0; i<4; i++){
-            av_freep(&buf->base[i]);
-            buf->data[i]= NULL;
-        }
-    }
+    if(buf->base[0] && (buf->width != w || buf->height != h || buf->pix_fmt != s->pix_fmt))
+        unref_internal_buffer(buf);
 
     if(buf->base[0]){
-        pic->age= *picture_number - buf->last_pic_num;
-        buf->last_pic_num= *picture_number;
+        pic->age= list->picture_number - buf->last_pic_num;
+        buf->last_pic_num= list->picture_number;
     }else{
-        int h_chroma_shift, v_chroma_shift;
-        int size[4] = {0};
-        int tmpsize;
-        int unaligned;
-        AVPicture picture;
-        int stride_align[4];
-        const int pixel_size = av_pix_fmt_descriptors[s->pix_fmt].comp[0].step_minus1+1;
-
-        avcodec_get_chroma_sub_sample(s->pix_fmt, &h_chroma_shift, &v_chroma_shift);
-
-        avcodec_align_dimensions2(s, &w, &h, stride_align);
-
-        if(!(s->flags&CODEC_FLAG_EMU_EDGE)){
-            w+= EDGE_WIDTH*2;
-            h+= EDGE_WIDTH*2;
-        }
-
-        do {
-            // NOTE: do not align linesizes individually, this breaks e.g. assumptions
-            // that linesize[0] == 2*linesize[1] in the MPEG-encoder for 4:2:2
-            av_image_fill_linesizes(picture.linesize, s->pix_fmt, w);
-            // increase alignment of w for next try (rhs gives the lowest bit set in w)
-            w += w & ~(w-1);
-
-            unaligned = 0;
-            for (i=0; i<4; i++){
-                unaligned |= picture.linesize[i] % stride_align[i];
+#if HAVE_PTHREADS
+        pthread_mutex_lock(&pool->lock);
+#endif
+        ret = update_frame_pool(s, pool);
+        for(i=0; i<4 && ret >= 0; i++){
+            buf->linesize[i]= pool->linesize[i];
+            if (!pool->pools[i])
+                continue;
+            if (!(buf->buf[i] = av_buffer_pool_get(pool->pools[i]))) {
+                ret = AVERROR(ENOMEM);
+                break;
             }
-        } while (unaligned);
-
-        tmpsize = av_image_fill_pointers(picture.data, s->pix_fmt, h, NULL, picture.linesize);
-        if (tmpsize < 0)
+            buf->base[i]= buf->buf[i]->data;
+            buf->data[i]= buf->base[i] + pool->offset[i];
+        }
+#if HAVE_PTHREADS
+        pthread_mutex_unlock(&pool->lock);
+#endif
+        if (ret < 0) {
+            unref_internal_buffer(buf);
             return -1;
-
-        for (i=0; i<3 && picture.data[i+1]; i++)
-            size[i] = picture.data[i+1] - picture.data[i];
-        size[i] = tmpsize - (picture.data[i] - picture.data[0]);
-
-        buf->last_pic_num= -256*256*256*64;
-        memset(buf->base, 0, sizeof(buf->base));
-        memset(buf->data, 0, sizeof(buf->data));
-
-        for(i=0; i<4 && size[i]; i++){
-            const int h_shift= i==0 ? 0 : h_chroma_shift;
-            const int v_shift= i==0 ? 0 : v_chroma_shift;
-
-            buf->linesize[i]= picture.linesize[i];
-
-            buf->base[i]= av_malloc(size[i]+16); //FIXME 16
-            if(buf->base[i]==NULL) return -1;
-            memset(buf->base[i], 128, size[i]);
-
-            // no edge if EDGE EMU or not planar YUV
-            if((s->flags&CODEC_FLAG_EMU_EDGE) || !size[2])
-                buf->data[i] = buf->base[i];
-            else
-                buf->data[i] = buf->base[i] + FFALIGN((buf->linesize[i]*EDGE_WIDTH>>v_shift) + (pixel_size*EDGE_WIDTH>>h_shift), stride_align[i]);
         }
-        if(size[1] && !size[2])
+
+        if(buf->data[1] && !buf->data[2])
             ff_set_systematic_pal2((uint32_t*)buf->data[1], s->pix_fmt);
+        buf->last_pic_num= -256*256*256*64;
         buf->width  = s->width;
         buf->height = s->height;
         buf->pix_fmt= s->pix_fmt;
@@ -370,23 +587,30 @@ void avcodec_default_release_buffer(AVCodecContext *s, AVFrame *pic){
     assert(s->internal_buffer_count);
 
     if(s->internal_buffer){
+    InternalBufferList *list = s->internal_buffer;
     buf = NULL; /* avoids warning */
     for(i=0; i<s->internal_buffer_count; i++){ //just 3-5 checks so is not worth to optimize
-        buf= &((InternalBuffer*)s->internal_buffer)[i];
+        buf= &list->buffer[i];
         if(buf->data[0] == pic->data[0])
             break;
     }
     assert(i < s->internal_buffer_count);
     s->internal_buffer_count--;
-    last = &((InternalBuffer*)s->internal_buffer)[s->internal_buffer_count];
+    last = &list->buffer[s->internal_buffer_count];
 
     FFSWAP(InternalBuffer, *buf, *last);
+
+    /* frame threads do not use the age of buffers, the planes go back to
+       the shared pool so that any thread can reuse them */
+    if (s->active_thread_type&FF_THREAD_FRAME)
+        unref_internal_buffer(last);
     }
 
     for(i=0; i<4; i++){
         pic->data[i]=NULL;
 //        pic->base[i]=NULL;
     }
+    pic->extended_data = NULL;
 //printf("R%X\n", pic->opaque);
 
     if(s->debug&FF_DEBUG_BUFFERS)
@@ -622,7 +846,7 @@ int attribute_align_arg avcodec_open(AVCodecContext *avctx, AVCodec *codec)
     avctx->pts_correction_last_dts = INT64_MIN;
 
     if(avctx->codec->init && !(avctx->active_thread_type&FF_THREAD_FRAME)){
-        ret = avctx->codec->init(avctx);
+        FF_MEM_TAGGED(avctx->codec->name, ret = avctx->codec->init(avctx));
         if (ret < 0) {
             goto free_and_end;
         }
@@ -651,7 +875,9 @@ int attribute_align_arg avcodec_encode_audio(AVCodecContext *avctx, uint8_t *buf
         return -1;
     }
     if((avctx->codec->capabilities & CODEC_CAP_DELAY) || samples){
-        int ret = avctx->codec->encode(avctx, buf, buf_size, samples);
+        int ret;
+        FF_MEM_TAGGED(avctx->codec->name,
+                      ret = avctx->codec->encode(avctx, buf, buf_size, samples));
         avctx->frame_number++;
         return ret;
     }else
@@ -667,8 +893,13 @@ int attribute_align_arg avcodec_encode_video(AVCodecContext *avctx, uint8_t *buf
     }
     if(av_image_check_size(avctx->width, avctx->height, 0, avctx))
         return -1;
-    if((avctx->codec->capabilities & CODEC_CAP_DELAY) || pict){
-        int ret = avctx->codec->encode(avctx, buf, buf_size, pict);
+    if((avctx->codec->capabilities & CODEC_CAP_DELAY) || pict || (avctx->active_thread_type&FF_THREAD_FRAME)){
+        int ret;
+        if (HAVE_PTHREADS && avctx->active_thread_type&FF_THREAD_FRAME)
+            ret = ff_thread_encode_video(avctx, buf, buf_size, pict);
+        else
+            FF_MEM_TAGGED(avctx->codec->name,
+                          ret = avctx->codec->encode(avctx, buf, buf_size, pict));
         avctx->frame_number++;
         emms_c(); //needed to avoid an emms_c() call before every return;
 
@@ -686,7 +917,8 @@ int avcodec_encode_subtitle(AVCodecContext *avctx, uint8_t *buf, int buf_size,
         return -1;
     }
 
-    ret = avctx->codec->encode(avctx, buf, buf_size, sub);
+    FF_MEM_TAGGED(avctx->codec->name,
+                  ret = avctx->codec->encode(avctx, buf, buf_size, sub));
     avctx->frame_number++;
     return ret;
 }
@@ -740,8 +972,9 @@ int attribute_align_arg avcodec_decode_video2(AVCodecContext *avctx, AVFrame *pi
              ret = ff_thread_decode_frame(avctx, picture, got_picture_ptr,
                                           avpkt);
         else {
-            ret = avctx->codec->decode(avctx, picture, got_picture_ptr,
-                              avpkt);
+            FF_MEM_TAGGED(avctx->codec->name,
+                          ret = avctx->codec->decode(avctx, picture,
+                                                     got_picture_ptr, avpkt));
             picture->pkt_dts= avpkt->dts;
 
             if(!avctx->has_b_frames){
@@ -773,6 +1006,60 @@ int attribute_align_arg avcodec_decode_video2(AVCodecContext *avctx, AVFrame *pi
     return ret;
 }
 
+#define INTERLEAVE(type)                                                    \
+    for (ch = 0; ch < channels; ch++)                                       \
+        for (i = 0; i < nb_samples; i++)                                    \
+            ((type *)dst)[i * channels + ch] = ((const type *)src[ch])[i];
+
+static void interleave_samples(uint8_t *dst, uint8_t **src, int channels,
+                               int nb_samples, int bps)
+{
+    int ch, i;
+
+    switch (bps) {
+    case 1:  INTERLEAVE(uint8_t);  break;
+    case 2:  INTERLEAVE(int16_t);  break;
+    case 4:  INTERLEAVE(int32_t);  break;
+    default: INTERLEAVE(uint64_t); break;
+    }
+}
+
+/**
+ * Decode with a decoder returning AVFrames into the buffer of
+ * avcodec_decode_audio3().
+ */
+static int decode_audio_frame_copy(AVCodecContext *avctx, uint8_t *samples,
+                                   int *frame_size_ptr, AVPacket *avpkt)
+{
+    AVFrame frame;
+    int got_frame = 0, ret, size;
+    int bps = av_get_bytes_per_sample(avctx->sample_fmt);
+
+    avcodec_get_frame_defaults(&frame);
+    FF_MEM_TAGGED(avctx->codec->name,
+                  ret = avctx->codec->decode(avctx, &frame, &got_frame, avpkt));
+    if (ret < 0 || !got_frame) {
+        *frame_size_ptr = 0;
+        return ret;
+    }
+
+    size = frame.nb_samples * avctx->channels * bps;
+    if (*frame_size_ptr < size) {
+        av_log(avctx, AV_LOG_ERROR, "output buffer size is too small for "
+               "the current frame (%d < %d)\n", *frame_size_ptr, size);
+        ret = AVERROR(EINVAL);
+        size = 0;
+    } else if (frame.planar && avctx->channels > 1)
+        interleave_samples(samples, frame.extended_data, avctx->channels,
+                           frame.nb_samples, bps);
+    else
+        memcpy(samples, frame.extended_data[0], size);
+    *frame_size_ptr = size;
+
+    avctx->release_buffer(avctx, &frame);
+    return ret;
+}
+
 int attribute_align_arg avcodec_decode_audio3(AVCodecContext *avctx, int16_t *samples,
                          int *frame_size_ptr,
                          AVPacket *avpkt)
@@ -793,7 +1080,12 @@ int attribute_align_arg avcodec_decode_audio3(AVCodecContext *avctx, int16_t *sa
             return -1;
         }
 
-        ret = avctx->codec->decode(avctx, samples, frame_size_ptr, avpkt);
+        if (avctx->codec->capabilities & CODEC_CAP_AUDIO_FRAME)
+            ret = decode_audio_frame_copy(avctx, (uint8_t *)samples, frame_size_ptr, avpkt);
+        else
+            FF_MEM_TAGGED(avctx->codec->name,
+                          ret = avctx->codec->decode(avctx, samples,
+                                                     frame_size_ptr, avpkt));
         avctx->frame_number++;
     }else{
         ret= 0;
@@ -802,6 +1094,73 @@ int attribute_align_arg avcodec_decode_audio3(AVCodecContext *avctx, int16_t *sa
     return ret;
 }
 
+int attribute_align_arg avcodec_decode_audio4(AVCodecContext *avctx, AVFrame *frame,
+                                              int *got_frame_ptr, AVPacket *avpkt)
+{
+    InternalBufferList *list;
+    uint8_t *buf;
+    int ret, err, size, bps;
+
+    avctx->pkt = avpkt;
+    *got_frame_ptr = 0;
+
+    if (!(avctx->codec->capabilities & CODEC_CAP_DELAY) && !avpkt->size)
+        return 0;
+
+    if (avctx->codec->capabilities & CODEC_CAP_AUDIO_FRAME) {
+        FF_MEM_TAGGED(avctx->codec->name,
+                      ret = avctx->codec->decode(avctx, frame, got_frame_ptr, avpkt));
+        avctx->frame_number++;
+        return ret;
+    }
+
+    /* other decoders need a buffer for the largest frame, they write to a
+       frame of that size once the layout of the samples is known */
+    bps = av_get_bytes_per_sample(avctx->sample_fmt);
+    if (avctx->channels > 0 && bps) {
+        frame->nb_samples = (AVCODEC_MAX_AUDIO_FRAME_SIZE + avctx->channels * bps - 1) /
+                            (avctx->channels * bps);
+        frame->planar     = 0;
+        if ((ret = avctx->get_buffer(avctx, frame)) < 0)
+            return ret;
+        buf = frame->extended_data[0];
+    } else {
+        if (!avctx->internal_buffer && alloc_internal_buffers(avctx, NULL) < 0)
+            return AVERROR(ENOMEM);
+        list = avctx->internal_buffer;
+        if (!list->audio_scratch &&
+            !(list->audio_scratch = av_malloc(AVCODEC_MAX_AUDIO_FRAME_SIZE)))
+            return AVERROR(ENOMEM);
+        buf = list->audio_scratch;
+    }
+
+    size = AVCODEC_MAX_AUDIO_FRAME_SIZE;
+    FF_MEM_TAGGED(avctx->codec->name,
+                  ret = avctx->codec->decode(avctx, buf, &size, avpkt));
+    avctx->frame_number++;
+
+    bps = av_get_bytes_per_sample(avctx->sample_fmt);
+    if (ret < 0 || size <= 0 || avctx->channels <= 0 || !bps) {
+        if (frame->data[0])
+            avctx->release_buffer(avctx, frame);
+        return ret < 0 || size <= 0 ? ret : AVERROR_INVALIDDATA;
+    }
+    if (!frame->data[0]) {
+        frame->nb_samples = size / (avctx->channels * bps);
+        frame->planar     = 0;
+        if ((err = avctx->get_buffer(avctx, frame)) < 0)
+            return err;
+        size = frame->nb_samples * avctx->channels * bps;
+        memcpy(frame->extended_data[0], buf, size);
+    }
+    /* the decoder may have changed the layout of the samples */
+    frame->nb_samples  = size / (avctx->channels * bps);
+    frame->linesize[0] = size;
+    frame->format      = avctx->sample_fmt;
+    *got_frame_ptr = 1;
+    return ret;
+}
+
 int avcodec_decode_subtitle2(AVCodecContext *avctx, AVSubtitle *sub,
                             int *got_sub_ptr,
                             AVPacket *avpkt)
@@ -811,7 +1170,8 @@ int avcodec_decode_subtitle2(AVCodecContext *avctx, AVSubtitle *sub,
     avctx->pkt = avpkt;
     *got_sub_ptr = 0;
     avcodec_get_subtitle_defaults(sub);
-    ret = avctx->codec->decode(avctx, sub, got_sub_ptr, avpkt);
+    FF_MEM_TAGGED(avctx->codec->name,
+                  ret = avctx->codec->decode(avctx, sub, got_sub_ptr, avpkt));
     if (*got_sub_ptr)
         avctx->frame_number++;
     return ret;
@@ -1138,19 +1498,17 @@ void avcodec_flush_buffers(AVCodecContext *avctx)
 }
 
 void avcodec_default_free_buffers(AVCodecContext *s){
-    int i, j;
+    InternalBufferList *list = s->internal_buffer;
+    int i;
 
     if(s->internal_buffer==NULL) return;
 
     if (s->internal_buffer_count)
         av_log(s, AV_LOG_WARNING, "Found %i unreleased buffers!\n", s->internal_buffer_count);
-    for(i=0; i<INTERNAL_BUFFER_SIZE; i++){
-        InternalBuffer *buf= &((InternalBuffer*)s->internal_buffer)[i];
-        for(j=0; j<4; j++){
-            av_freep(&buf->base[j]);
-            buf->data[j]= NULL;
-        }
-    }
+    for(i=0; i<INTERNAL_BUFFER_SIZE; i++)
+        unref_internal_buffer(&list->buffer[i]);
+    av_buffer_unref(&list->pool);
+    av_free(list->audio_scratch);
     av_freep(&s->internal_buffer);
 
     s->internal_buffer_count=0;
@@ -1342,6 +1700,21 @@ void ff_thread_await_progress(AVFrame *f, int progress, int field)
 {
 }
 
+struct AVCodecThreadPool *avcodec_thread_pool_alloc(int thread_count)
+{
+    return NULL;
+}
+
+void avcodec_thread_pool_unref(struct AVCodecThreadPool **pool)
+{
+    *pool = NULL;
+}
+
+struct AVThreadPool *avcodec_thread_pool_get(struct AVCodecThreadPool *pool)
+{
+    return NULL;
+}
+
 #endif
 
 #if FF_API_THREAD_INIT
@@ -38,6 +38,7 @@
 #include "simple_idct.h"
 #include "mathops.h"
 #include "vdpau_internal.h"
+#include "thread.h"
 
 #undef NDEBUG
 #include <assert.h>
@@ -398,6 +399,18 @@ static void vc1_smooth_overlap_filter_iblk(VC1Context *v)
     }
 }
 
+/**
+ * Wait until a reference picture has been decoded down to luma line y,
+ * when frame threading is in use.
+ */
+static av_always_inline void vc1_await_ref_line(VC1Context *v, Picture *ref, int y)
+{
+    MpegEncContext *s = &v->s;
+
+    if (HAVE_PTHREADS && (s->avctx->active_thread_type & FF_THREAD_FRAME))
+        ff_thread_await_progress((AVFrame*)ref, av_clip(y >> 4, 0, s->mb_height - 1), 0);
+}
+
 /** Do motion compensation over 1 macroblock
  * Mostly adapted hpel_motion and qpel_motion from mpegvideo.c
  */
@@ -453,6 +466,9 @@ static void vc1_mc_1mv(VC1Context *v, int dir)
         uvsrc_y = av_clip(uvsrc_y,  -8, s->avctx->coded_height >> 1);
     }
 
+    /* 16 lines plus the bicubic filter taps, chroma is never further down */
+    vc1_await_ref_line(v, dir ? s->next_picture_ptr : s->last_picture_ptr, src_y + 19);
+
     srcY += src_y * s->linesize + src_x;
     srcU += uvsrc_y * s->uvlinesize + uvsrc_x;
     srcV += uvsrc_y * s->uvlinesize + uvsrc_x;
@@ -578,6 +594,8 @@ static void vc1_mc_4mv_luma(VC1Context *v, int n)
         src_y   = av_clip(  src_y, -18, s->avctx->coded_height + 1);
     }
 
+    vc1_await_ref_line(v, s->last_picture_ptr, src_y + 11);
+
     srcY += src_y * s->linesize + src_x;
 
     if(v->rangeredfrm || (v->mv_mode == MV_PMODE_INTENSITY_COMP)
@@ -716,6 +734,8 @@ static void vc1_mc_4mv_chroma(VC1Context *v)
         uvsrc_y = av_clip(uvsrc_y,  -8, s->avctx->coded_height >> 1);
     }
 
+    vc1_await_ref_line(v, s->last_picture_ptr, (uvsrc_y + 9) * 2);
+
     srcU = s->last_picture.data[1] + uvsrc_y * s->uvlinesize + uvsrc_x;
     srcV = s->last_picture.data[2] + uvsrc_y * s->uvlinesize + uvsrc_x;
     if(v->rangeredfrm || (v->mv_mode == MV_PMODE_INTENSITY_COMP)
@@ -1042,6 +1062,9 @@ static void vc1_interp_mc(VC1Context *v)
         uvsrc_y = av_clip(uvsrc_y,  -8, s->avctx->coded_height >> 1);
     }
 
+    /* 16 lines plus the bicubic filter taps, chroma is never further down */
+    vc1_await_ref_line(v, s->next_picture_ptr, src_y + 19);
+
     srcY += src_y * s->linesize + src_x;
     srcU += uvsrc_y * s->uvlinesize + uvsrc_x;
     srcV += uvsrc_y * s->uvlinesize + uvsrc_x;
@@ -1192,6 +1215,7 @@ static inline void vc1_pred_b_mv(VC1Context *v, int dmv_x[2], int dmv_y[2], int
         s->current_picture.motion_val[1][xy][1] = 0;
         return;
     }
+    vc1_await_ref_line(v, s->next_picture_ptr, s->mb_y * 16);
     s->mv[0][0][0] = scale_mv(s->next_picture.motion_val[1][xy][0], v->bfraction, 0, s->quarter_sample);
     s->mv[0][0][1] = scale_mv(s->next_picture.motion_val[1][xy][1], v->bfraction, 0, s->quarter_sample);
     s->mv[1][0][0] = scale_mv(s->next_picture.motion_val[1][xy][0], v->bfraction, 1, s->quarter_sample);
@@ -2965,6 +2989,8 @@ static void vc1_decode_i_blocks(VC1Context *v)
             ff_draw_horiz_band(s, s->mb_y * 16, 16);
         else if (s->mb_y)
             ff_draw_horiz_band(s, (s->mb_y-1) * 16, 16);
+        /* the overlap and loop filters of the next row still touch this one */
+        ff_thread_report_progress((AVFrame*)s->current_picture_ptr, s->mb_y - 1, 0);
 
         s->first_slice_line = 0;
     }
@@ -3084,6 +3110,8 @@ static void vc1_decode_i_blocks_adv(VC1Context *v)
             ff_draw_horiz_band(s, s->mb_y * 16, 16);
         else if (s->mb_y)
             ff_draw_horiz_band(s, (s->mb_y-1) * 16, 16);
+        /* pixels are put one row and loop filtered two rows behind decoding */
+        ff_thread_report_progress((AVFrame*)s->current_picture_ptr, s->mb_y - 2, 0);
         s->first_slice_line = 0;
     }
 
@@ -3152,7 +3180,10 @@ static void vc1_decode_p_blocks(VC1Context *v)
         memmove(v->ttblk_base, v->ttblk, sizeof(v->ttblk_base[0])*s->mb_stride);
         memmove(v->is_intra_base, v->is_intra, sizeof(v->is_intra_base[0])*s->mb_stride);
         memmove(v->luma_mv_base, v->luma_mv, sizeof(v->luma_mv_base[0])*s->mb_stride);
-        if (s->mb_y != s->start_mb_y) ff_draw_horiz_band(s, (s->mb_y-1) * 16, 16);
+        if (s->mb_y != s->start_mb_y) {
+            ff_draw_horiz_band(s, (s->mb_y-1) * 16, 16);
+            ff_thread_report_progress((AVFrame*)s->current_picture_ptr, s->mb_y - 1, 0);
+        }
         s->first_slice_line = 0;
     }
     if (apply_loop_filter) {
@@ -3233,10 +3264,12 @@ static void vc1_decode_skip_blocks(VC1Context *v)
         s->mb_x = 0;
         ff_init_block_index(s);
         ff_update_block_index(s);
+        vc1_await_ref_line(v, s->last_picture_ptr, s->mb_y * 16 + 15);
         memcpy(s->dest[0], s->last_picture.data[0] + s->mb_y * 16 * s->linesize, s->linesize * 16);
         memcpy(s->dest[1], s->last_picture.data[1] + s->mb_y * 8 * s->uvlinesize, s->uvlinesize * 8);
         memcpy(s->dest[2], s->last_picture.data[2] + s->mb_y * 8 * s->uvlinesize, s->uvlinesize * 8);
         ff_draw_horiz_band(s, s->mb_y * 16, 16);
+        ff_thread_report_progress((AVFrame*)s->current_picture_ptr, s->mb_y, 0);
         s->first_slice_line = 0;
     }
     s->pict_type = AV_PICTURE_TYPE_P;
@@ -3389,6 +3422,38 @@ static void vc1_parse_sprites(VC1Context *v, GetBitContext* gb)
         av_log(v->s.avctx, AV_LOG_WARNING, "Buffer not fully read\n");
 }
 
+/** Allocate the per-context macroblock tables, sized from the MpegEncContext.
+ */
+static av_cold void vc1_alloc_tables(VC1Context *v)
+{
+    MpegEncContext *s = &v->s;
+
+    /* Allocate mb bitplanes */
+    v->mv_type_mb_plane = av_malloc(s->mb_stride * s->mb_height);
+    v->direct_mb_plane = av_malloc(s->mb_stride * s->mb_height);
+    v->acpred_plane = av_malloc(s->mb_stride * s->mb_height);
+    v->over_flags_plane = av_malloc(s->mb_stride * s->mb_height);
+
+    v->n_allocated_blks = s->mb_width + 2;
+    v->block = av_malloc(sizeof(*v->block) * v->n_allocated_blks);
+    v->cbp_base = av_malloc(sizeof(v->cbp_base[0]) * 2 * s->mb_stride);
+    v->cbp = v->cbp_base + s->mb_stride;
+    v->ttblk_base = av_malloc(sizeof(v->ttblk_base[0]) * 2 * s->mb_stride);
+    v->ttblk = v->ttblk_base + s->mb_stride;
+    v->is_intra_base = av_malloc(sizeof(v->is_intra_base[0]) * 2 * s->mb_stride);
+    v->is_intra = v->is_intra_base + s->mb_stride;
+    v->luma_mv_base = av_malloc(sizeof(v->luma_mv_base[0]) * 2 * s->mb_stride);
+    v->luma_mv = v->luma_mv_base + s->mb_stride;
+
+    /* allocate block type info in that way so it could be used with s->block_index[] */
+    v->mb_type_base = av_malloc(s->b8_stride * (s->mb_height * 2 + 1) + s->mb_stride * (s->mb_height + 1) * 2);
+    v->mb_type[0] = v->mb_type_base + s->b8_stride + 1;
+    v->mb_type[1] = v->mb_type_base + s->b8_stride * (s->mb_height * 2 + 1) + s->mb_stride + 1;
+    v->mb_type[2] = v->mb_type[1] + s->mb_stride * (s->mb_height + 1);
+
+    ff_intrax8_common_init(&v->x8,s);
+}
+
 /** Initialize a VC1/WMV3 decoder
  * @todo TODO: Handle VC-1 IDUs (Transport level?)
  * @todo TODO: Decypher remaining bits in extra_data
@@ -3530,29 +3595,6 @@ static av_cold int vc1_decode_init(AVCodecContext *avctx)
         v->top_blk_sh  = 0;
     }
 
-    /* Allocate mb bitplanes */
-    v->mv_type_mb_plane = av_malloc(s->mb_stride * s->mb_height);
-    v->direct_mb_plane = av_malloc(s->mb_stride * s->mb_height);
-    v->acpred_plane = av_malloc(s->mb_stride * s->mb_height);
-    v->over_flags_plane = av_malloc(s->mb_stride * s->mb_height);
-
-    v->n_allocated_blks = s->mb_width + 2;
-    v->block = av_malloc(sizeof(*v->block) * v->n_allocated_blks);
-    v->cbp_base = av_malloc(sizeof(v->cbp_base[0]) * 2 * s->mb_stride);
-    v->cbp = v->cbp_base + s->mb_stride;
-    v->ttblk_base = av_malloc(sizeof(v->ttblk_base[0]) * 2 * s->mb_stride);
-    v->ttblk = v->ttblk_base + s->mb_stride;
-    v->is_intra_base = av_malloc(sizeof(v->is_intra_base[0]) * 2 * s->mb_stride);
-    v->is_intra = v->is_intra_base + s->mb_stride;
-    v->luma_mv_base = av_malloc(sizeof(v->luma_mv_base[0]) * 2 * s->mb_stride);
-    v->luma_mv = v->luma_mv_base + s->mb_stride;
-
-    /* allocate block type info in that way so it could be used with s->block_index[] */
-    v->mb_type_base = av_malloc(s->b8_stride * (s->mb_height * 2 + 1) + s->mb_stride * (s->mb_height + 1) * 2);
-    v->mb_type[0] = v->mb_type_base + s->b8_stride + 1;
-    v->mb_type[1] = v->mb_type_base + s->b8_stride * (s->mb_height * 2 + 1) + s->mb_stride + 1;
-    v->mb_type[2] = v->mb_type[1] + s->mb_stride * (s->mb_height + 1);
-
     /* Init coded blocks info */
     if (v->profile == PROFILE_ADVANCED)
     {
@@ -3562,7 +3604,49 @@ static av_cold int vc1_decode_init(AVCodecContext *avctx)
 //            return -1;
     }
 
-    ff_intrax8_common_init(&v->x8,s);
+    vc1_alloc_tables(v);
+    return 0;
+}
+
+static av_cold int vc1_decode_init_thread_copy(AVCodecContext *avctx)
+{
+    VC1Context *v = avctx->priv_data;
+    MpegEncContext *s = &v->s;
+
+    if (!avctx->is_copy) return 0;
+
+    vc1_alloc_tables(v);
+
+    /* The MpegEncContext still points to the buffers of the first thread;
+     * it is set up again from the previous thread by
+     * ff_mpeg_update_thread_context() before the first frame is decoded. */
+    memset(s, 0, sizeof(*s));
+    s->avctx = avctx;
+
+    return 0;
+}
+
+static int vc1_update_thread_context(AVCodecContext *dst, const AVCodecContext *src)
+{
+    VC1Context *v = dst->priv_data, *v1 = src->priv_data;
+    int err;
+
+    if (dst == src || !v1->s.context_initialized) return 0;
+
+    err = ff_mpeg_update_thread_context(dst, src);
+    if (err) return err;
+
+    /* sequence header and entry point state, the rest is parsed for each frame */
+    memcpy(&v->res_sprite, &v1->res_sprite, (char*)&v1->mv_mode - (char*)&v1->res_sprite);
+    v->s.loop_filter      = v1->s.loop_filter;
+    v->hrd_num_leaky_buckets = v1->hrd_num_leaky_buckets;
+    v->range_mapy_flag    = v1->range_mapy_flag;
+    v->range_mapuv_flag   = v1->range_mapuv_flag;
+    v->range_mapy         = v1->range_mapy;
+    v->range_mapuv        = v1->range_mapuv;
+    v->broken_link        = v1->broken_link;
+    v->closed_entry       = v1->closed_entry;
+
     return 0;
 }
 
@@ -3736,6 +3820,8 @@ static int vc1_decode_frame(AVCodecContext *avctx,
     s->me.qpel_put= s->dsp.put_qpel_pixels_tab;
     s->me.qpel_avg= s->dsp.avg_qpel_pixels_tab;
 
+    ff_thread_finish_setup(avctx);
+
     if ((CONFIG_VC1_VDPAU_DECODER)
         &&s->avctx->codec->capabilities&CODEC_CAP_HWACCEL_VDPAU)
         ff_vdpau_vc1_decode_picture(s, buf_start, (buf + buf_size) - buf_start);
@@ -3838,11 +3924,13 @@ AVCodec ff_vc1_decoder = {
     NULL,
     vc1_decode_end,
     vc1_decode_frame,
-    CODEC_CAP_DR1 | CODEC_CAP_DELAY,
+    CODEC_CAP_DR1 | CODEC_CAP_DELAY | CODEC_CAP_FRAME_THREADS,
     NULL,
     .long_name = NULL_IF_CONFIG_SMALL("SMPTE VC-1"),
     .pix_fmts = ff_hwaccel_pixfmt_list_420,
-    .profiles = NULL_IF_CONFIG_SMALL(profiles)
+    .profiles = NULL_IF_CONFIG_SMALL(profiles),
+    .init_thread_copy = ONLY_IF_THREADS_ENABLED(vc1_decode_init_thread_copy),
+    .update_thread_context = ONLY_IF_THREADS_ENABLED(vc1_update_thread_context)
 };
 
 #if CONFIG_WMV3_DECODER
@@ -3855,11 +3943,13 @@ AVCodec ff_wmv3_decoder = {
     NULL,
     vc1_decode_end,
     vc1_decode_frame,
-    CODEC_CAP_DR1 | CODEC_CAP_DELAY,
+    CODEC_CAP_DR1 | CODEC_CAP_DELAY | CODEC_CAP_FRAME_THREADS,
     NULL,
     .long_name = NULL_IF_CONFIG_SMALL("Windows Media Video 9"),
     .pix_fmts = ff_hwaccel_pixfmt_list_420,
-    .profiles = NULL_IF_CONFIG_SMALL(profiles)
+    .profiles = NULL_IF_CONFIG_SMALL(profiles),
+    .init_thread_copy = ONLY_IF_THREADS_ENABLED(vc1_decode_init_thread_copy),
+    .update_thread_context = ONLY_IF_THREADS_ENABLED(vc1_update_thread_context)
 };
 #endif
 
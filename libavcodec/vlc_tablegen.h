@@ -0,0 +1,135 @@
+/*
+ * Helpers for the generators of hardcoded VLC tables
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_VLC_TABLEGEN_H
+#define AVCODEC_VLC_TABLEGEN_H
+
+/*
+ * Only to be included by the *_tablegen.c host programs: this builds the
+ * VLC code of bitstream.c into the generator, together with the few
+ * libavutil functions it needs, so that init_vlc() gives the same tables
+ * as at run time.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+
+void *av_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void *av_realloc(void *ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+void av_free(void *ptr)
+{
+    free(ptr);
+}
+
+void av_freep(void *arg)
+{
+    void **ptr = arg;
+    free(*ptr);
+    *ptr = NULL;
+}
+
+void av_log(void *avcl, int level, const char *fmt, ...)
+{
+    va_list vl;
+    va_start(vl, fmt);
+    vfprintf(stderr, fmt, vl);
+    va_end(vl);
+}
+
+#include "libavutil/mathematics.c"
+#include "bitstream.c"
+#include "tableprint.h"
+
+typedef VLC_TYPE vlc_entry[2];
+
+WRITE_1D_FUNC_ARGV(vlc_entry, 3, "{ %6d, %3d }", data[i][0], data[i][1])
+
+/**
+ * Print the VLC_TYPE table name[size][2].
+ */
+static void write_vlc_table(const char *prefix, const char *name,
+                            const VLC_TYPE (*table)[2], int size)
+{
+    printf("%s VLC_TYPE %s[%d][2] = {\n", prefix, name, size);
+    write_vlc_entry_array(table, size);
+    printf("};\n");
+}
+
+static void write_vlc_entry(const VLC *vlc, const char *table_name,
+                            const VLC_TYPE (*table)[2])
+{
+    printf("{ %d, (VLC_TYPE (*)[2])(%s + %d), %d, %d }",
+           vlc->bits, table_name, (int)(vlc->table - table),
+           vlc->table_size, vlc->table_allocated);
+}
+
+/**
+ * Print the VLC vlc, whose table points into table_name, as name.
+ */
+static void write_vlc(const char *prefix, const char *name, const VLC *vlc,
+                      const char *table_name, const VLC_TYPE (*table)[2])
+{
+    printf("%s VLC %s = ", prefix, name);
+    write_vlc_entry(vlc, table_name, table);
+    printf(";\n");
+}
+
+/**
+ * Print the array of VLCs vlc[nb], whose tables point into table_name,
+ * as name.
+ */
+static void write_vlc_array(const char *prefix, const char *name,
+                            const VLC *vlc, int nb,
+                            const char *table_name, const VLC_TYPE (*table)[2])
+{
+    int i;
+    printf("%s VLC %s[%d] = {\n", prefix, name, nb);
+    for (i = 0; i < nb; i++) {
+        printf("    ");
+        write_vlc_entry(&vlc[i], table_name, table);
+        printf(i == nb - 1 ? "\n" : ",\n");
+    }
+    printf("};\n");
+}
+
+#define WRITE_VLC_TABLE(prefix, name) \
+    write_vlc_table(prefix, #name, (const VLC_TYPE (*)[2])name, \
+                    sizeof(name) / sizeof(VLC_TYPE[2]))
+
+#define WRITE_VLC(prefix, name, table) \
+    write_vlc(prefix, #name, &name, #table, (const VLC_TYPE (*)[2])table)
+
+#define WRITE_VLC_ARRAY(prefix, name, table) \
+    write_vlc_array(prefix, #name, name, FF_ARRAY_ELEMS(name), \
+                    #table, (const VLC_TYPE (*)[2])table)
+
+#endif /* AVCODEC_VLC_TABLEGEN_H */
@@ -1382,17 +1382,23 @@ static av_always_inline int vorbis_residue_decode_internal(vorbis_context *vc,
                                 }
 
                             } else if (vr_type == 2) {
-                                voffs = voffset;
+                                unsigned voffs_div = voffset / ch;
+                                unsigned voffs_mod = voffset - voffs_div * ch;
 
                                 for (k = 0; k < step; ++k) {
                                     coffs = get_vlc2(gb, codebook.vlc.table, codebook.nb_bits, 3) * dim;
-                                    for (l = 0; l < dim; ++l, ++voffs) {
-                                        vec[voffs / ch + (voffs % ch) * vlen] += codebook.codevectors[coffs + l];  // FPMATH FIXME use if and counter instead of / and %
+                                    for (l = 0; l < dim; ++l) {
+                                        vec[voffs_div + voffs_mod * vlen] += codebook.codevectors[coffs + l];  // FPMATH
 
                                         av_dlog(NULL, " pass %d offs: %d curr: %f change: %f cv offs.: %d+%d  \n",
-                                                pass, voffset / ch + (voffs % ch) * vlen,
-                                                vec[voffset / ch + (voffs % ch) * vlen],
+                                                pass, voffs_div + voffs_mod * vlen,
+                                                vec[voffs_div + voffs_mod * vlen],
                                                 codebook.codevectors[coffs + l], coffs, l);
+
+                                        if (++voffs_mod == ch) {
+                                            voffs_div++;
+                                            voffs_mod = 0;
+                                        }
                                     }
                                 }
                             }
@@ -1449,12 +1455,99 @@ void vorbis_inverse_coupling(float *mag, float *ang, int blocksize)
     }
 }
 
+typedef struct {
+    vorbis_mapping *mapping;
+    const uint8_t  *res_chan;  ///< index of the residue vector of each channel
+    unsigned        blockflag;
+    unsigned        previous_window;
+    int             retlen;
+    int             nb_slices; ///< number of parts the inverse coupling is split in
+} vorbis_synth;
+
+/**
+ * Inverse coupling of all coupling steps, for one part of the spectrum:
+ * the same channel can be used by several steps, which must be done in
+ * order, but each coefficient is independent of the others.
+ */
+static int inverse_coupling_slice(AVCodecContext *avccontext, void *arg,
+                                  int jobnr, int threadnr)
+{
+    vorbis_context *vc    = avccontext->priv_data;
+    vorbis_synth   *synth = arg;
+    vorbis_mapping *mapping = synth->mapping;
+    unsigned blocksize = vc->blocksize[synth->blockflag];
+    unsigned start = (blocksize / 2 *  jobnr      / synth->nb_slices) & ~15;
+    unsigned end   = (blocksize / 2 * (jobnr + 1) / synth->nb_slices) & ~15;
+    int i;
+
+    for (i = mapping->coupling_steps - 1; i >= 0; --i) { //warning: i has to be signed
+        float *mag, *ang;
+
+        mag = vc->channel_residues+synth->res_chan[mapping->magnitude[i]] * blocksize / 2;
+        ang = vc->channel_residues+synth->res_chan[mapping->angle[i]]     * blocksize / 2;
+        vc->dsp.vorbis_inverse_coupling(mag + start, ang + start, end - start);
+    }
+    return 0;
+}
+
+/**
+ * Dotproduct and MDCT of one channel.
+ */
+static int imdct_channel(AVCodecContext *avccontext, void *arg,
+                         int j, int threadnr)
+{
+    vorbis_context *vc    = avccontext->priv_data;
+    vorbis_synth   *synth = arg;
+    FFTContext *mdct      = &vc->mdct[synth->blockflag];
+    unsigned blocksize    = vc->blocksize[synth->blockflag];
+    float *ch_floor_ptr   = vc->channel_floors   + j                  * blocksize / 2;
+    float *ch_res_ptr     = vc->channel_residues + synth->res_chan[j] * blocksize / 2;
+
+    vc->dsp.vector_fmul(ch_floor_ptr, ch_floor_ptr, ch_res_ptr, blocksize / 2);
+    mdct->imdct_half(mdct, ch_res_ptr, ch_floor_ptr);
+    return 0;
+}
+
+/**
+ * Overlap/add of one channel, save data for next overlapping  FPMATH
+ * The output overwrites the floors of the other channels, so this must
+ * only be done once all the MDCTs are done.
+ */
+static int overlap_add_channel(AVCodecContext *avccontext, void *arg,
+                               int j, int threadnr)
+{
+    vorbis_context *vc    = avccontext->priv_data;
+    vorbis_synth   *synth = arg;
+    unsigned blockflag       = synth->blockflag;
+    unsigned previous_window = synth->previous_window;
+    unsigned blocksize = vc->blocksize[blockflag];
+    unsigned bs0 = vc->blocksize[0];
+    unsigned bs1 = vc->blocksize[1];
+    float *residue    = vc->channel_residues + synth->res_chan[j] * blocksize / 2;
+    float *saved      = vc->saved + j * bs1 / 4;
+    float *ret        = vc->channel_floors + j * synth->retlen;
+    float *buf        = residue;
+    const float *win  = vc->win[blockflag & previous_window];
+
+    if (blockflag == previous_window) {
+        vc->dsp.vector_fmul_window(ret, saved, buf, win, blocksize / 4);
+    } else if (blockflag > previous_window) {
+        vc->dsp.vector_fmul_window(ret, saved, buf, win, bs0 / 4);
+        memcpy(ret+bs0/2, buf+bs0/4, ((bs1-bs0)/4) * sizeof(float));
+    } else {
+        memcpy(ret, saved, ((bs1 - bs0) / 4) * sizeof(float));
+        vc->dsp.vector_fmul_window(ret + (bs1 - bs0) / 4, saved + (bs1 - bs0) / 4, buf, win, bs0 / 4);
+    }
+    memcpy(saved, buf + blocksize / 4, blocksize / 4 * sizeof(float));
+    return 0;
+}
+
 // Decode the audio packet using the functions above
 
 static int vorbis_parse_audio_packet(vorbis_context *vc)
 {
     GetBitContext *gb = &vc->gb;
-    FFTContext *mdct;
+    vorbis_synth synth;
     unsigned previous_window = vc->previous_window;
     unsigned mode_number, blockflag, blocksize;
     int i, j;
@@ -1545,50 +1638,23 @@ static int vorbis_parse_audio_packet(vorbis_context *vc)
         ch_res_ptr += ch * blocksize / 2;
     }
 
-// Inverse coupling
-
-    for (i = mapping->coupling_steps - 1; i >= 0; --i) { //warning: i has to be signed
-        float *mag, *ang;
-
-        mag = vc->channel_residues+res_chan[mapping->magnitude[i]] * blocksize / 2;
-        ang = vc->channel_residues+res_chan[mapping->angle[i]]     * blocksize / 2;
-        vc->dsp.vorbis_inverse_coupling(mag, ang, blocksize / 2);
-    }
-
-// Dotproduct, MDCT
-
-    mdct = &vc->mdct[blockflag];
+// Inverse coupling, dotproduct, MDCT, overlap/add, spread over the threads
 
-    for (j = vc->audio_channels-1;j >= 0; j--) {
-        ch_floor_ptr = vc->channel_floors   + j           * blocksize / 2;
-        ch_res_ptr   = vc->channel_residues + res_chan[j] * blocksize / 2;
-        vc->dsp.vector_fmul(ch_floor_ptr, ch_floor_ptr, ch_res_ptr, blocksize / 2);
-        mdct->imdct_half(mdct, ch_res_ptr, ch_floor_ptr);
-    }
+    synth.mapping         = mapping;
+    synth.res_chan        = res_chan;
+    synth.blockflag       = blockflag;
+    synth.previous_window = previous_window;
+    synth.retlen          = (blocksize + vc->blocksize[previous_window]) / 4;
+    synth.nb_slices       = av_clip(vc->avccontext->thread_count, 1, blocksize / 64);
 
-// Overlap/add, save data for next overlapping  FPMATH
-
-    retlen = (blocksize + vc->blocksize[previous_window]) / 4;
-    for (j = 0; j < vc->audio_channels; j++) {
-        unsigned bs0 = vc->blocksize[0];
-        unsigned bs1 = vc->blocksize[1];
-        float *residue    = vc->channel_residues + res_chan[j] * blocksize / 2;
-        float *saved      = vc->saved + j * bs1 / 4;
-        float *ret        = vc->channel_floors + j * retlen;
-        float *buf        = residue;
-        const float *win  = vc->win[blockflag & previous_window];
-
-        if (blockflag == previous_window) {
-            vc->dsp.vector_fmul_window(ret, saved, buf, win, blocksize / 4);
-        } else if (blockflag > previous_window) {
-            vc->dsp.vector_fmul_window(ret, saved, buf, win, bs0 / 4);
-            memcpy(ret+bs0/2, buf+bs0/4, ((bs1-bs0)/4) * sizeof(float));
-        } else {
-            memcpy(ret, saved, ((bs1 - bs0) / 4) * sizeof(float));
-            vc->dsp.vector_fmul_window(ret + (bs1 - bs0) / 4, saved + (bs1 - bs0) / 4, buf, win, bs0 / 4);
-        }
-        memcpy(saved, buf + blocksize / 4, blocksize / 4 * sizeof(float));
-    }
+    if (mapping->coupling_steps)
+        vc->avccontext->execute2(vc->avccontext, inverse_coupling_slice, &synth,
+                                 NULL, synth.nb_slices);
+    vc->avccontext->execute2(vc->avccontext, imdct_channel, &synth,
+                             NULL, vc->audio_channels);
+    vc->avccontext->execute2(vc->avccontext, overlap_add_channel, &synth,
+                             NULL, vc->audio_channels);
+    retlen = synth.retlen;
 
     vc->previous_window = blockflag;
     return retlen;
@@ -1597,16 +1663,18 @@ static int vorbis_parse_audio_packet(vorbis_context *vc)
 // Return the decoded audio packet through the standard api
 
 static int vorbis_decode_frame(AVCodecContext *avccontext,
-                               void *data, int *data_size,
+                               void *data, int *got_frame_ptr,
                                AVPacket *avpkt)
 {
+    AVFrame *frame     = data;
     const uint8_t *buf = avpkt->data;
     int buf_size       = avpkt->size;
     vorbis_context *vc = avccontext->priv_data ;
     GetBitContext *gb = &(vc->gb);
     const float *channel_ptrs[255];
-    int i, len;
+    int i, len, ret;
 
+    *got_frame_ptr = 0;
     if (!buf_size)
         return 0;
 
@@ -1616,14 +1684,11 @@ static int vorbis_decode_frame(AVCodecContext *avccontext,
 
     len = vorbis_parse_audio_packet(vc);
 
-    if (len <= 0) {
-        *data_size = 0;
+    if (len <= 0)
         return buf_size;
-    }
 
     if (!vc->first_frame) {
         vc->first_frame = 1;
-        *data_size = 0;
         return buf_size ;
     }
 
@@ -1639,14 +1704,21 @@ static int vorbis_decode_frame(AVCodecContext *avccontext,
                               len * ff_vorbis_channel_layout_offsets[vc->audio_channels - 1][i];
     }
 
-    if (avccontext->sample_fmt == AV_SAMPLE_FMT_FLT)
-        vc->fmt_conv.float_interleave(data, channel_ptrs, len, vc->audio_channels);
-    else
-        vc->fmt_conv.float_to_int16_interleave(data, channel_ptrs, len,
-                                               vc->audio_channels);
+    frame->nb_samples = len;
+    frame->planar     = 1;
+    if ((ret = avccontext->get_buffer(avccontext, frame)) < 0) {
+        av_log(avccontext, AV_LOG_ERROR, "get_buffer() failed\n");
+        return ret;
+    }
 
-    *data_size = len * vc->audio_channels *
-                 av_get_bytes_per_sample(avccontext->sample_fmt);
+    for (i = 0; i < vc->audio_channels; i++) {
+        if (avccontext->sample_fmt == AV_SAMPLE_FMT_FLT)
+            memcpy(frame->extended_data[i], channel_ptrs[i], len * sizeof(float));
+        else
+            vc->fmt_conv.float_to_int16((int16_t *)frame->extended_data[i],
+                                        channel_ptrs[i], len);
+    }
+    *got_frame_ptr = 1;
 
     return buf_size ;
 }
@@ -1671,6 +1743,7 @@ AVCodec ff_vorbis_decoder = {
     NULL,
     vorbis_decode_close,
     vorbis_decode_frame,
+    .capabilities = CODEC_CAP_SLICE_THREADS | CODEC_CAP_AUDIO_FRAME,
     .long_name = NULL_IF_CONFIG_SMALL("Vorbis"),
     .channel_layouts = ff_vorbis_channel_layouts,
     .sample_fmts = (const enum AVSampleFormat[]) {
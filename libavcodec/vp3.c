@@ -42,6 +42,10 @@
 #include "xiph.h"
 #include "thread.h"
 
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
 #define FRAGMENT_PIXELS 8
 
 static av_cold int vp3_decode_end(AVCodecContext *avctx);
@@ -125,6 +129,16 @@ static const uint8_t hilbert_offset[16][2] = {
 
 #define MIN_DEQUANT_VAL 2
 
+/**
+ * Position of the reconstruction in the DCT token lists. The tokens are not
+ * modified while they are pulled, so that slices can be rendered from their
+ * own starting position.
+ */
+typedef struct Vp3TokenState {
+    int16_t *dct_tokens[3][64];     ///< next token of each plane and level
+    uint16_t eob_blocks[3][64];     ///< blocks of the EOB run at dct_tokens already ended
+} Vp3TokenState;
+
 typedef struct Vp3DecodeContext {
     AVCodecContext *avctx;
     int theora, theora_tables;
@@ -237,7 +251,18 @@ typedef struct Vp3DecodeContext {
      * is coded. */
     unsigned char *macroblock_coding;
 
-    uint8_t *edge_emu_buffer;
+    uint8_t *edge_emu_buffer;       ///< 9 lines for each slice thread
+
+    int num_slice_threads;
+    Vp3TokenState *slice_tokens;    ///< token position at the start of each slice
+#if HAVE_PTHREADS
+    int next_slice;                 ///< next slice handed out to a job
+    int drawn_slices;               ///< slices passed to vp3_draw_horiz_band() so far
+    volatile int *filter_progress;  ///< fragments of the last row filtered by each slice, per plane
+    int *filter_wanted;             ///< progress a thread waits for in filter_progress, INT_MAX if none
+    pthread_mutex_t slice_lock;
+    pthread_cond_t slice_cond;
+#endif
 
     /* Huffman decode */
     int hti;
@@ -1205,10 +1230,52 @@ static void reverse_dc_prediction(Vp3DecodeContext *s,
     }
 }
 
+/**
+ * Filter the edges of one fragment; dst points to its top left pixel.
+ */
+static av_always_inline void loop_filter_fragment(Vp3DecodeContext *s, uint8_t *dst,
+                                                  int stride, int fragment,
+                                                  int x, int y, int width, int height)
+{
+    int *bounding_values= s->bounding_values_array+127;
+
+    /* This code basically just deblocks on the edges of coded blocks.
+     * However, it has to be much more complicated because of the
+     * braindamaged deblock ordering used in VP3/Theora. Order matters
+     * because some pixels get filtered twice. */
+    if( s->all_fragments[fragment].coding_method != MODE_COPY )
+    {
+        /* do not perform left edge filter for left columns frags */
+        if (x > 0) {
+            s->dsp.vp3_h_loop_filter(dst, stride, bounding_values);
+        }
+
+        /* do not perform top edge filter for top row fragments */
+        if (y > 0) {
+            s->dsp.vp3_v_loop_filter(dst, stride, bounding_values);
+        }
+
+        /* do not perform right edge filter for right column
+         * fragments or if right fragment neighbor is also coded
+         * in this frame (it will be filtered in next iteration) */
+        if ((x < width - 1) &&
+            (s->all_fragments[fragment + 1].coding_method == MODE_COPY)) {
+            s->dsp.vp3_h_loop_filter(dst + 8, stride, bounding_values);
+        }
+
+        /* do not perform bottom edge filter for bottom row
+         * fragments or if bottom fragment neighbor is also coded
+         * in this frame (it will be filtered in the next row) */
+        if ((y < height - 1) &&
+            (s->all_fragments[fragment + width].coding_method == MODE_COPY)) {
+            s->dsp.vp3_v_loop_filter(dst + 8*stride, stride, bounding_values);
+        }
+    }
+}
+
 static void apply_loop_filter(Vp3DecodeContext *s, int plane, int ystart, int yend)
 {
     int x, y;
-    int *bounding_values= s->bounding_values_array+127;
 
     int width           = s->fragment_width[!!plane];
     int height          = s->fragment_height[!!plane];
@@ -1221,47 +1288,8 @@ static void apply_loop_filter(Vp3DecodeContext *s, int plane, int ystart, int ye
     for (y = ystart; y < yend; y++) {
 
         for (x = 0; x < width; x++) {
-            /* This code basically just deblocks on the edges of coded blocks.
-             * However, it has to be much more complicated because of the
-             * braindamaged deblock ordering used in VP3/Theora. Order matters
-             * because some pixels get filtered twice. */
-            if( s->all_fragments[fragment].coding_method != MODE_COPY )
-            {
-                /* do not perform left edge filter for left columns frags */
-                if (x > 0) {
-                    s->dsp.vp3_h_loop_filter(
-                        plane_data + 8*x,
-                        stride, bounding_values);
-                }
-
-                /* do not perform top edge filter for top row fragments */
-                if (y > 0) {
-                    s->dsp.vp3_v_loop_filter(
-                        plane_data + 8*x,
-                        stride, bounding_values);
-                }
-
-                /* do not perform right edge filter for right column
-                 * fragments or if right fragment neighbor is also coded
-                 * in this frame (it will be filtered in next iteration) */
-                if ((x < width - 1) &&
-                    (s->all_fragments[fragment + 1].coding_method == MODE_COPY)) {
-                    s->dsp.vp3_h_loop_filter(
-                        plane_data + 8*x + 8,
-                        stride, bounding_values);
-                }
-
-                /* do not perform bottom edge filter for bottom row
-                 * fragments or if bottom fragment neighbor is also coded
-                 * in this frame (it will be filtered in the next row) */
-                if ((y < height - 1) &&
-                    (s->all_fragments[fragment + width].coding_method == MODE_COPY)) {
-                    s->dsp.vp3_v_loop_filter(
-                        plane_data + 8*x + 8*stride,
-                        stride, bounding_values);
-                }
-            }
-
+            loop_filter_fragment(s, plane_data + 8*x, stride, fragment,
+                                 x, y, width, height);
             fragment++;
         }
         plane_data += 8*stride;
@@ -1272,31 +1300,34 @@ static void apply_loop_filter(Vp3DecodeContext *s, int plane, int ystart, int ye
  * Pull DCT tokens from the 64 levels to decode and dequant the coefficients
  * for the next block in coding order
  */
-static inline int vp3_dequant(Vp3DecodeContext *s, Vp3Fragment *frag,
-                              int plane, int inter, DCTELEM block[64])
+static inline int vp3_dequant(Vp3DecodeContext *s, Vp3TokenState *tokens,
+                              Vp3Fragment *frag, int plane, int inter,
+                              DCTELEM block[64])
 {
     int16_t *dequantizer = s->qmat[frag->qpi][inter][plane];
     uint8_t *perm = s->scantable.permutated;
+    int16_t **dct_tokens = tokens->dct_tokens[plane];
+    uint16_t *eob_blocks = tokens->eob_blocks[plane];
     int i = 0;
 
     do {
-        int token = *s->dct_tokens[plane][i];
+        int token = *dct_tokens[i];
         switch (token & 3) {
         case 0: // EOB
-            if (--token < 4) // 0-3 are token types, so the EOB run must now be 0
-                s->dct_tokens[plane][i]++;
-            else
-                *s->dct_tokens[plane][i] = token & ~3;
+            if (++eob_blocks[i] >= token >> 2) {
+                eob_blocks[i] = 0;
+                dct_tokens[i]++;
+            }
             goto end;
         case 1: // zero run
-            s->dct_tokens[plane][i]++;
+            dct_tokens[i]++;
             i += (token >> 2) & 0x7f;
             block[perm[i]] = (token >> 9) * dequantizer[perm[i]];
             i++;
             break;
         case 2: // coeff
             block[perm[i]] = (token >> 2) * dequantizer[perm[i]];
-            s->dct_tokens[plane][i++]++;
+            dct_tokens[i++]++;
             break;
         default: // shouldn't happen
             return i;
@@ -1368,11 +1399,23 @@ static void await_reference_row(Vp3DecodeContext *s, Vp3Fragment *fragment, int
     ff_thread_await_progress(ref_frame, ref_row, 0);
 }
 
+/**
+ * Report the rows of a slice which are final, i.e. all of them except those
+ * the loop filter of the next slice still changes.
+ */
+static void draw_slice(Vp3DecodeContext *s, int slice)
+{
+    vp3_draw_horiz_band(s, FFMIN((32 << s->chroma_y_shift) * (slice + 1) -16, s->height-16));
+}
+
 /*
  * Perform the final rendering for a particular slice of data.
  * The slice number ranges from 0..(c_superblock_height - 1).
+ * If sliced is set, the loop filter and the horizontal band are left to the
+ * caller, so that slices can be rendered in parallel.
  */
-static void render_slice(Vp3DecodeContext *s, int slice)
+static void render_slice(Vp3DecodeContext *s, Vp3TokenState *tokens,
+                         uint8_t *edge_emu_buffer, int slice, int sliced)
 {
     int x, y, i, j, fragment;
     LOCAL_ALIGNED_16(DCTELEM, block, [64]);
@@ -1458,7 +1501,7 @@ static void render_slice(Vp3DecodeContext *s, int slice)
                         motion_source += ((motion_y >> 1) * stride);
 
                         if(src_x<0 || src_y<0 || src_x + 9 >= plane_width || src_y + 9 >= plane_height){
-                            uint8_t *temp= s->edge_emu_buffer;
+                            uint8_t *temp= edge_emu_buffer;
                             if(stride<0) temp -= 8*stride;
 
                             s->dsp.emulated_edge_mc(temp, motion_source, stride, 9, 9, src_x, src_y, plane_width, plane_height);
@@ -1493,7 +1536,7 @@ static void render_slice(Vp3DecodeContext *s, int slice)
                     /* invert DCT and place (or add) in final output */
 
                     if (s->all_fragments[i].coding_method == MODE_INTRA) {
-                        vp3_dequant(s, s->all_fragments + i, plane, 0, block);
+                        vp3_dequant(s, tokens, s->all_fragments + i, plane, 0, block);
                         if(s->avctx->idct_algo!=FF_IDCT_VP3)
                             block[0] += 128<<3;
                         s->dsp.idct_put(
@@ -1501,7 +1544,7 @@ static void render_slice(Vp3DecodeContext *s, int slice)
                             stride,
                             block);
                     } else {
-                        if (vp3_dequant(s, s->all_fragments + i, plane, 1, block)) {
+                        if (vp3_dequant(s, tokens, s->all_fragments + i, plane, 1, block)) {
                         s->dsp.idct_add(
                             output_plane + first_pixel,
                             stride,
@@ -1523,7 +1566,7 @@ static void render_slice(Vp3DecodeContext *s, int slice)
             }
 
             // Filter up to the last row in the superblock row
-            if (!s->skip_loop_filter)
+            if (!s->skip_loop_filter && !sliced)
                 apply_loop_filter(s, plane, 4*sb_y - !!sb_y, FFMIN(4*sb_y+3, fragment_height-1));
         }
     }
@@ -1536,9 +1579,159 @@ static void render_slice(Vp3DecodeContext *s, int slice)
       *     dispatch (slice - 1);
       */
 
-    vp3_draw_horiz_band(s, FFMIN((32 << s->chroma_y_shift) * (slice + 1) -16, s->height-16));
+    if (!sliced)
+        draw_slice(s, slice);
+}
+
+#if HAVE_PTHREADS
+/**
+ * Find the token position at which each slice starts, by pulling the tokens
+ * of the fragments rendered before it.
+ */
+static void split_slice_tokens(Vp3DecodeContext *s)
+{
+    LOCAL_ALIGNED_16(DCTELEM, block, [64]);
+    Vp3TokenState tokens;
+    int plane, slice, sb, i, j;
+
+    memcpy(tokens.dct_tokens, s->dct_tokens, sizeof(tokens.dct_tokens));
+    memset(tokens.eob_blocks, 0, sizeof(tokens.eob_blocks));
+
+    for (plane = 0; plane < 3; plane++) {
+        int sb_start    = plane ? (plane == 1 ? s->u_superblock_start : s->v_superblock_start) : 0;
+        int sb_end      = sb_start + (plane ? s->c_superblock_count : s->y_superblock_count);
+        int slice_count = (plane ? s->c_superblock_width : s->y_superblock_width) << (!plane && s->chroma_y_shift);
+
+        for (slice = 0, sb = sb_start; slice < s->c_superblock_height; slice++) {
+            Vp3TokenState *t = &s->slice_tokens[slice];
+            int slice_end    = FFMIN(sb + slice_count, sb_end);
+
+            memcpy(t->dct_tokens[plane], tokens.dct_tokens[plane], sizeof(t->dct_tokens[plane]));
+            memcpy(t->eob_blocks[plane], tokens.eob_blocks[plane], sizeof(t->eob_blocks[plane]));
+
+            for (; sb < slice_end; sb++)
+                for (j = 0; j < 16; j++) {
+                    i = s->superblock_fragments[16*sb + j];
+                    if (i != -1 && s->all_fragments[i].coding_method != MODE_COPY)
+                        vp3_dequant(s, &tokens, s->all_fragments + i, plane, 0, block);
+                }
+        }
+    }
 }
 
+/**
+ * Wait until the loop filter of a slice is done with the first n fragments
+ * of the last row it filters in the given plane.
+ */
+static void await_filter_progress(Vp3DecodeContext *s, int slice, int plane, int n)
+{
+    int i = 3*slice + plane;
+
+    if (s->filter_progress[i] >= n)
+        return;
+
+    pthread_mutex_lock(&s->slice_lock);
+    while (s->filter_progress[i] < n) {
+        s->filter_wanted[i] = n;
+        pthread_cond_wait(&s->slice_cond, &s->slice_lock);
+    }
+    pthread_mutex_unlock(&s->slice_lock);
+}
+
+static void report_filter_progress(Vp3DecodeContext *s, int slice, int plane, int n)
+{
+    int i = 3*slice + plane;
+
+    pthread_mutex_lock(&s->slice_lock);
+    s->filter_progress[i] = n;
+    if (n >= s->filter_wanted[i]) {
+        s->filter_wanted[i] = INT_MAX;
+        pthread_cond_broadcast(&s->slice_cond);
+    }
+    pthread_mutex_unlock(&s->slice_lock);
+}
+
+/**
+ * Loop filter the same rows as render_slice() does, in a wavefront. The
+ * filter of a fragment only touches the pixels next to its edges, so it only
+ * depends on the fragments around it, and filtering fragment x of a row
+ * after fragment x+1 of the row above gives the result of the raster order.
+ * The first row is the last row of the previous slice, which must first be
+ * rendered and filtered up to there by that slice.
+ */
+static void filter_slice(Vp3DecodeContext *s, int slice)
+{
+    int plane, step, x, y;
+
+    for (plane = 0; plane < 3; plane++) {
+        int shift    = 2 + (!plane && s->chroma_y_shift);
+        int width    = s->fragment_width[!!plane];
+        int height   = s->fragment_height[!!plane];
+        int ystart   = (slice << shift) - !!slice;
+        int yend     = FFMIN(((slice + 1) << shift) - 1, height - 1);
+        int stride   = s->current_frame.linesize[plane];
+        uint8_t *plane_data = s->current_frame.data[plane] + s->data_offset[plane];
+
+        if (CONFIG_GRAY && plane && (s->avctx->flags & CODEC_FLAG_GRAY))
+            continue;
+        if (!s->flipped_image) stride = -stride;
+
+        for (step = 0; step < width + yend - ystart - 1; step++) {
+            for (y = FFMAX(ystart, ystart + step - width + 1); y <= ystart + step && y < yend; y++) {
+                x = step - (y - ystart);
+                if (y == ystart && slice)
+                    await_filter_progress(s, slice - 1, plane, FFMIN(x + 2, width));
+
+                loop_filter_fragment(s, plane_data + 8*y*stride + 8*x, stride,
+                                     s->fragment_start[plane] + y*width + x,
+                                     x, y, width, height);
+
+                if (y == yend - 1)
+                    report_filter_progress(s, slice, plane, x + 1);
+            }
+        }
+    }
+}
+
+/**
+ * Render the slices handed out in order by next_slice. A slice only waits
+ * for slices handed out before it, so this cannot deadlock however the jobs
+ * are scheduled.
+ */
+static int vp3_render_slices(AVCodecContext *avctx, void *arg, int jobnr, int threadnr)
+{
+    Vp3DecodeContext *s = avctx->priv_data;
+    uint8_t *edge_emu_buffer = s->edge_emu_buffer + threadnr*9*FFABS(s->current_frame.linesize[0]);
+    int slice;
+
+    for (;;) {
+        pthread_mutex_lock(&s->slice_lock);
+        slice = s->next_slice++;
+        pthread_mutex_unlock(&s->slice_lock);
+        if (slice >= s->c_superblock_height)
+            break;
+
+        render_slice(s, &s->slice_tokens[slice], edge_emu_buffer, slice, 1);
+        if (!s->skip_loop_filter)
+            filter_slice(s, slice);
+
+        // the bands are drawn in order
+        pthread_mutex_lock(&s->slice_lock);
+        while (s->drawn_slices < slice)
+            pthread_cond_wait(&s->slice_cond, &s->slice_lock);
+        pthread_mutex_unlock(&s->slice_lock);
+
+        draw_slice(s, slice);
+
+        pthread_mutex_lock(&s->slice_lock);
+        s->drawn_slices++;
+        pthread_cond_broadcast(&s->slice_cond);
+        pthread_mutex_unlock(&s->slice_lock);
+    }
+    return 0;
+}
+#endif
+
 /// Allocate tables for per-frame data in Vp3DecodeContext
 static av_cold int allocate_tables(AVCodecContext *avctx)
 {
@@ -1548,6 +1741,11 @@ static av_cold int allocate_tables(AVCodecContext *avctx)
     y_fragment_count = s->fragment_width[0] * s->fragment_height[0];
     c_fragment_count = s->fragment_width[1] * s->fragment_height[1];
 
+#if HAVE_PTHREADS
+    pthread_mutex_init(&s->slice_lock, NULL);
+    pthread_cond_init(&s->slice_cond, NULL);
+#endif
+
     s->superblock_coding = av_malloc(s->superblock_count);
     s->all_fragments = av_malloc(s->fragment_count * sizeof(Vp3Fragment));
     s->coded_fragment_list[0] = av_malloc(s->fragment_count * sizeof(int));
@@ -1566,6 +1764,19 @@ static av_cold int allocate_tables(AVCodecContext *avctx)
         return -1;
     }
 
+    s->num_slice_threads = HAVE_PTHREADS ? ff_thread_slice_count(avctx) : 1;
+#if HAVE_PTHREADS
+    if (s->num_slice_threads > 1) {
+        s->slice_tokens    = av_malloc(s->c_superblock_height * sizeof(*s->slice_tokens));
+        s->filter_progress = av_malloc(3*s->c_superblock_height * sizeof(*s->filter_progress));
+        s->filter_wanted   = av_malloc(3*s->c_superblock_height * sizeof(*s->filter_wanted));
+        if (!s->slice_tokens || !s->filter_progress || !s->filter_wanted) {
+            vp3_decode_end(avctx);
+            return -1;
+        }
+    }
+#endif
+
     init_block_mapping(s);
 
     return 0;
@@ -1883,7 +2094,7 @@ static int vp3_decode_frame(AVCodecContext *avctx,
     }
 
     if (!s->edge_emu_buffer)
-        s->edge_emu_buffer = av_malloc(9*FFABS(s->current_frame.linesize[0]));
+        s->edge_emu_buffer = av_malloc(s->num_slice_threads*9*FFABS(s->current_frame.linesize[0]));
 
     if (s->keyframe) {
         if (!s->theora)
@@ -1952,8 +2163,27 @@ static int vp3_decode_frame(AVCodecContext *avctx,
     }
 
     s->last_slice_end = 0;
-    for (i = 0; i < s->c_superblock_height; i++)
-        render_slice(s, i);
+#if HAVE_PTHREADS
+    if (s->num_slice_threads > 1 && s->c_superblock_height > 1) {
+        split_slice_tokens(s);
+        for (i = 0; i < 3*s->c_superblock_height; i++) {
+            s->filter_progress[i] = 0;
+            s->filter_wanted[i]   = INT_MAX;
+        }
+        s->next_slice   = 0;
+        s->drawn_slices = 0;
+        avctx->execute2(avctx, vp3_render_slices, NULL, NULL,
+                        FFMIN(s->num_slice_threads, s->c_superblock_height));
+    } else
+#endif
+    {
+        Vp3TokenState tokens;
+
+        memcpy(tokens.dct_tokens, s->dct_tokens, sizeof(tokens.dct_tokens));
+        memset(tokens.eob_blocks, 0, sizeof(tokens.eob_blocks));
+        for (i = 0; i < s->c_superblock_height; i++)
+            render_slice(s, &tokens, s->edge_emu_buffer, i, 0);
+    }
 
     // filter the last row
     for (i = 0; i < 3; i++) {
@@ -1999,6 +2229,13 @@ static av_cold int vp3_decode_end(AVCodecContext *avctx)
     av_free(s->motion_val[0]);
     av_free(s->motion_val[1]);
     av_free(s->edge_emu_buffer);
+    av_freep(&s->slice_tokens);
+#if HAVE_PTHREADS
+    av_freep(&s->filter_progress);
+    av_freep(&s->filter_wanted);
+    pthread_mutex_destroy(&s->slice_lock);
+    pthread_cond_destroy(&s->slice_cond);
+#endif
 
     if (avctx->is_copy) return 0;
 
@@ -2330,7 +2567,7 @@ AVCodec ff_theora_decoder = {
     NULL,
     vp3_decode_end,
     vp3_decode_frame,
-    CODEC_CAP_DR1 | CODEC_CAP_DRAW_HORIZ_BAND | CODEC_CAP_FRAME_THREADS,
+    CODEC_CAP_DR1 | CODEC_CAP_DRAW_HORIZ_BAND | CODEC_CAP_FRAME_THREADS | CODEC_CAP_SLICE_THREADS,
     NULL,
     .long_name = NULL_IF_CONFIG_SMALL("Theora"),
     .update_thread_context = ONLY_IF_THREADS_ENABLED(vp3_update_thread_context)
@@ -2346,7 +2583,7 @@ AVCodec ff_vp3_decoder = {
     NULL,
     vp3_decode_end,
     vp3_decode_frame,
-    CODEC_CAP_DR1 | CODEC_CAP_DRAW_HORIZ_BAND | CODEC_CAP_FRAME_THREADS,
+    CODEC_CAP_DR1 | CODEC_CAP_DRAW_HORIZ_BAND | CODEC_CAP_FRAME_THREADS | CODEC_CAP_SLICE_THREADS,
     NULL,
     .long_name = NULL_IF_CONFIG_SMALL("On2 VP3"),
     .update_thread_context = ONLY_IF_THREADS_ENABLED(vp3_update_thread_context)
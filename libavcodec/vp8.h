@@ -30,6 +30,10 @@
 #include "vp8dsp.h"
 #include "h264pred.h"
 
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
 #define VP8_MAX_QUANT 127
 
 enum dct_token {
@@ -79,15 +83,36 @@ typedef struct {
     uint8_t mode;
     uint8_t ref_frame;
     uint8_t partitioning;
+    uint8_t segment;
+    uint8_t chroma_pred_mode;   ///< 8x8c pred mode
+    uint8_t intra4x4_pred_mode_mb[16];
     VP56mv mv;
     VP56mv bmv[16];
 } VP8Macroblock;
 
+/**
+ * State of the macroblock row being reconstructed, one per slice thread.
+ */
+typedef struct {
+    DECLARE_ALIGNED(16, DCTELEM, block)[6][4][16];
+    DECLARE_ALIGNED(16, DCTELEM, block_dc)[16];
+
+    /**
+     * This is the index plus one of the last non-zero coeff
+     * for each of the blocks in the current macroblock.
+     * So, 0 -> no coeffs
+     *     1 -> dc-only (special transform)
+     *     2+-> full transform
+     */
+    DECLARE_ALIGNED(16, uint8_t, non_zero_count_cache)[6][4];
+    DECLARE_ALIGNED(8, uint8_t, left_nnz)[9];
+    uint8_t *edge_emu_buffer;
+} VP8ThreadData;
+
 typedef struct {
     AVCodecContext *avctx;
     AVFrame *framep[4];
     AVFrame *next_framep[4];
-    uint8_t *edge_emu_buffer;
 
     uint16_t mb_width;   /* number of horizontal MB */
     uint16_t mb_height;  /* number of vertical MB */
@@ -97,8 +122,6 @@ typedef struct {
     uint8_t keyframe;
     uint8_t deblock_filter;
     uint8_t mbskip_enabled;
-    uint8_t segment;             ///< segment of the current macroblock
-    uint8_t chroma_pred_mode;    ///< 8x8c pred mode of the current macroblock
     uint8_t profile;
     VP56mv mv_min;
     VP56mv mv_max;
@@ -181,20 +204,8 @@ typedef struct {
      * per macroblock. We keep the last row in top_nnz.
      */
     uint8_t (*top_nnz)[9];
-    DECLARE_ALIGNED(8, uint8_t, left_nnz)[9];
 
-    /**
-     * This is the index plus one of the last non-zero coeff
-     * for each of the blocks in the current macroblock.
-     * So, 0 -> no coeffs
-     *     1 -> dc-only (special transform)
-     *     2+-> full transform
-     */
-    DECLARE_ALIGNED(16, uint8_t, non_zero_count_cache)[6][4];
     VP56RangeCoder c;   ///< header context, includes mb modes and motion vectors
-    DECLARE_ALIGNED(16, DCTELEM, block)[6][4][16];
-    DECLARE_ALIGNED(16, DCTELEM, block_dc)[16];
-    uint8_t intra4x4_pred_mode_mb[16];
 
     /**
      * These are all of the updatable probabilities for binary decisions.
@@ -237,6 +248,22 @@ typedef struct {
     H264PredContext hpc;
     vp8_mc_func put_pixels_tab[3][3][3];
     AVFrame frames[5];
+
+    /**
+     * With slice threads, the macroblock modes of the whole frame are
+     * decoded first, then the rows are reconstructed concurrently, each
+     * row staying behind the one above it.
+     */
+    VP8ThreadData *thread_data;
+    int num_thread_data;    ///< number of entries in thread_data
+    int num_jobs;           ///< threads reconstructing the current frame, 1 if not sliced
+#if HAVE_PTHREADS
+    int next_row;           ///< next macroblock row to hand out to a thread
+    volatile int *row_progress; ///< macroblocks of each row reconstructed and filtered so far
+    int *row_wanted;        ///< progress a thread waits for on each row, INT_MAX if none
+    pthread_mutex_t row_lock;
+    pthread_cond_t row_cond;
+#endif
 } VP8Context;
 
 #endif /* AVCODEC_VP8_H */
@@ -0,0 +1,227 @@
+/*
+ * SSE optimized Parametric Stereo DSP functions
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+
+#include "libavutil/cpu.h"
+#include "libavutil/mem.h"
+#include "libavutil/x86_cpu.h"
+#include "libavcodec/aacpsdsp.h"
+
+/* All of these give the same results as the C versions. */
+
+DECLARE_ALIGNED(16, static const uint32_t, ps_neg_even)[4] =
+    { 0x80000000, 0, 0x80000000, 0 };
+
+static void ps_add_squares_sse(float *dst, const float (*src)[2], int n)
+{
+    x86_reg i = -4 * n;
+    __asm__ volatile(
+        "1:                             \n\t"
+        "movaps     (%2,%0,2), %%xmm0   \n\t"
+        "movaps   16(%2,%0,2), %%xmm1   \n\t"
+        "mulps   %%xmm0, %%xmm0         \n\t"
+        "mulps   %%xmm1, %%xmm1         \n\t"
+        "movaps  %%xmm0, %%xmm2         \n\t"
+        "shufps  $0x88, %%xmm1, %%xmm0  \n\t"
+        "shufps  $0xdd, %%xmm1, %%xmm2  \n\t"
+        "addps   %%xmm2, %%xmm0         \n\t"
+        "addps      (%1,%0), %%xmm0     \n\t"
+        "movaps  %%xmm0, (%1,%0)        \n\t"
+        "add     $16, %0                \n\t"
+        "jl      1b                     \n\t"
+        : "+r"(i)
+        : "r"(dst + n), "r"(src + n)
+        : "memory"
+          XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2")
+    );
+}
+
+static void ps_mul_pair_single_sse(float (*dst)[2], float (*src0)[2],
+                                   float *src1, int n)
+{
+    x86_reg i = -4 * n;
+    __asm__ volatile(
+        "1:                             \n\t"
+        "movaps     (%3,%0), %%xmm0     \n\t"
+        "movups     (%2,%0,2), %%xmm2   \n\t"
+        "movups   16(%2,%0,2), %%xmm3   \n\t"
+        "movaps  %%xmm0, %%xmm1         \n\t"
+        "unpcklps %%xmm0, %%xmm0        \n\t"
+        "unpckhps %%xmm1, %%xmm1        \n\t"
+        "mulps   %%xmm2, %%xmm0         \n\t"
+        "mulps   %%xmm3, %%xmm1         \n\t"
+        "movaps  %%xmm0,   (%1,%0,2)    \n\t"
+        "movaps  %%xmm1, 16(%1,%0,2)    \n\t"
+        "add     $16, %0                \n\t"
+        "jl      1b                     \n\t"
+        : "+r"(i)
+        : "r"(dst + n), "r"(src0 + n), "r"(src1 + n)
+        : "memory"
+          XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm3")
+    );
+}
+
+/* one tap pair of two filters, in0/in1 and f are byte offsets into in and
+ * filter */
+#define PS_HYBRID_TAP(in0, in1, f)               \
+    "movlps  " #in0 "(%0), %%xmm1       \n\t"    \
+    "movlps  " #in1 "(%0), %%xmm2       \n\t"    \
+    "movlhps %%xmm1, %%xmm1             \n\t"    \
+    "movlhps %%xmm2, %%xmm2             \n\t"    \
+    "movaps  %%xmm1, %%xmm3             \n\t"    \
+    "addps   %%xmm2, %%xmm1             \n\t"    \
+    "subps   %%xmm2, %%xmm3             \n\t"    \
+    "shufps  $0xb1, %%xmm3, %%xmm3      \n\t"    \
+    "movlps  " #f "(%1), %%xmm4         \n\t"    \
+    "movhps  " #f "+56(%1), %%xmm4      \n\t"    \
+    "movaps  %%xmm4, %%xmm5             \n\t"    \
+    "shufps  $0xa0, %%xmm4, %%xmm4      \n\t"    \
+    "shufps  $0xf5, %%xmm5, %%xmm5      \n\t"    \
+    "xorps   %%xmm6, %%xmm5             \n\t"    \
+    "mulps   %%xmm4, %%xmm1             \n\t"    \
+    "mulps   %%xmm5, %%xmm3             \n\t"    \
+    "addps   %%xmm3, %%xmm1             \n\t"    \
+    "addps   %%xmm1, %%xmm0             \n\t"
+
+static void ps_hybrid_analysis_sse(float (*out)[2], float (*in)[2],
+                                   const float (*filter)[7][2], int stride, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i += 2) {
+        __asm__ volatile(
+            "movaps  %4, %%xmm6                 \n\t"
+            "movlps   48(%0), %%xmm0            \n\t"
+            "movlps   48(%1), %%xmm4            \n\t"
+            "movhps  104(%1), %%xmm4            \n\t"
+            "movlhps %%xmm0, %%xmm0             \n\t"
+            "shufps  $0xa0, %%xmm4, %%xmm4      \n\t"
+            "mulps   %%xmm4, %%xmm0             \n\t"
+            PS_HYBRID_TAP( 0, 96,  0)
+            PS_HYBRID_TAP( 8, 88,  8)
+            PS_HYBRID_TAP(16, 80, 16)
+            PS_HYBRID_TAP(24, 72, 24)
+            PS_HYBRID_TAP(32, 64, 32)
+            PS_HYBRID_TAP(40, 56, 40)
+            "movlps  %%xmm0, (%2)               \n\t"
+            "movhps  %%xmm0, (%3)               \n\t"
+            :
+            : "r"(in), "r"(filter[i]), "r"(out[i * stride]),
+              "r"(out[(i + 1) * stride]), "m"(*ps_neg_even)
+            : "memory"
+              XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                             "%xmm4", "%xmm5", "%xmm6")
+        );
+    }
+}
+
+static void ps_stereo_interpolate_sse(float (*l)[2], float (*r)[2],
+                                      float h[2][4], float h_step[2][4], int len)
+{
+    x86_reg i = -8 * len;
+    __asm__ volatile(
+        "movups  (%3), %%xmm6           \n\t"
+        "movups  (%4), %%xmm7           \n\t"
+        "1:                             \n\t"
+        "addps   %%xmm7, %%xmm6         \n\t"
+        "movlps  (%1,%0), %%xmm0        \n\t"
+        "movlps  (%2,%0), %%xmm1        \n\t"
+        "movlhps %%xmm0, %%xmm0         \n\t"
+        "movlhps %%xmm1, %%xmm1         \n\t"
+        "movaps  %%xmm6, %%xmm2         \n\t"
+        "movaps  %%xmm6, %%xmm3         \n\t"
+        "shufps  $0x50, %%xmm2, %%xmm2  \n\t"
+        "shufps  $0xfa, %%xmm3, %%xmm3  \n\t"
+        "mulps   %%xmm2, %%xmm0         \n\t"
+        "mulps   %%xmm3, %%xmm1         \n\t"
+        "addps   %%xmm1, %%xmm0         \n\t"
+        "movlps  %%xmm0, (%1,%0)        \n\t"
+        "movhps  %%xmm0, (%2,%0)        \n\t"
+        "add     $8, %0                 \n\t"
+        "jl      1b                     \n\t"
+        : "+r"(i)
+        : "r"(l + len), "r"(r + len), "r"(h[0]), "r"(h_step[0])
+        : "memory"
+          XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                         "%xmm6", "%xmm7")
+    );
+}
+
+static void ps_stereo_interpolate_ipdopd_sse(float (*l)[2], float (*r)[2],
+                                             float h[2][4], float h_step[2][4],
+                                             int len)
+{
+    x86_reg i = -8 * len;
+    __asm__ volatile(
+        "movups   (%3), %%xmm4          \n\t"
+        "movups 16(%3), %%xmm5          \n\t"
+        "1:                             \n\t"
+        "movups   (%4), %%xmm0          \n\t"
+        "movups 16(%4), %%xmm1          \n\t"
+        "addps   %%xmm0, %%xmm4         \n\t"
+        "addps   %%xmm1, %%xmm5         \n\t"
+        "movlps  (%1,%0), %%xmm0        \n\t"
+        "movlps  (%2,%0), %%xmm1        \n\t"
+        "movlhps %%xmm0, %%xmm0         \n\t"
+        "movlhps %%xmm1, %%xmm1         \n\t"
+        "movaps  %%xmm4, %%xmm2         \n\t"
+        "movaps  %%xmm4, %%xmm3         \n\t"
+        "shufps  $0x50, %%xmm2, %%xmm2  \n\t"
+        "shufps  $0xfa, %%xmm3, %%xmm3  \n\t"
+        "mulps   %%xmm0, %%xmm2         \n\t"
+        "mulps   %%xmm1, %%xmm3         \n\t"
+        "addps   %%xmm3, %%xmm2         \n\t"
+        "shufps  $0xb1, %%xmm0, %%xmm0  \n\t"
+        "shufps  $0xb1, %%xmm1, %%xmm1  \n\t"
+        "movaps  %%xmm5, %%xmm3         \n\t"
+        "shufps  $0x50, %%xmm3, %%xmm3  \n\t"
+        "xorps   %5, %%xmm3             \n\t"
+        "mulps   %%xmm3, %%xmm0         \n\t"
+        "addps   %%xmm0, %%xmm2         \n\t"
+        "movaps  %%xmm5, %%xmm3         \n\t"
+        "shufps  $0xfa, %%xmm3, %%xmm3  \n\t"
+        "xorps   %5, %%xmm3             \n\t"
+        "mulps   %%xmm3, %%xmm1         \n\t"
+        "addps   %%xmm1, %%xmm2         \n\t"
+        "movlps  %%xmm2, (%1,%0)        \n\t"
+        "movhps  %%xmm2, (%2,%0)        \n\t"
+        "add     $8, %0                 \n\t"
+        "jl      1b                     \n\t"
+        : "+r"(i)
+        : "r"(l + len), "r"(r + len), "r"(h[0]), "r"(h_step[0]),
+          "m"(*ps_neg_even)
+        : "memory"
+          XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                         "%xmm4", "%xmm5")
+    );
+}
+
+void ff_psdsp_init_mmx(PSDSPContext *s)
+{
+    int mm_flags = av_get_cpu_flags();
+
+    if (mm_flags & AV_CPU_FLAG_SSE) {
+        s->add_squares           = ps_add_squares_sse;
+        s->mul_pair_single       = ps_mul_pair_single_sse;
+        s->hybrid_analysis       = ps_hybrid_analysis_sse;
+        s->stereo_interpolate[0] = ps_stereo_interpolate_sse;
+        s->stereo_interpolate[1] = ps_stereo_interpolate_ipdopd_sse;
+    }
+}
@@ -0,0 +1,275 @@
+/*
+ * SSE2 optimized audio sample format conversion
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/cpu.h"
+#include "libavutil/mem.h"
+#include "libavutil/x86_cpu.h"
+#include "libavcodec/audioconvert.h"
+
+/*
+ * These convert 8 samples per iteration and leave the rest to the generic
+ * code. They give the same results as the C versions, including for
+ * out of range values, NaN and infinities.
+ */
+
+#define V4(x) { x, x, x, x }
+
+DECLARE_ALIGNED(16, static const float, ps_1_15)[4]   = V4(1.0 / (1 << 15));
+DECLARE_ALIGNED(16, static const float, ps_1_31)[4]   = V4(1.0 / (1U << 31));
+DECLARE_ALIGNED(16, static const float, ps_2_15)[4]   = V4(1 << 15);
+DECLARE_ALIGNED(16, static const float, ps_2_31)[4]   = V4(1U << 31);
+DECLARE_ALIGNED(16, static const float, ps_m2_31)[4]  = V4(-2147483648.0);
+DECLARE_ALIGNED(16, static const float, ps_2_63)[4]   = V4(9223372036854775808.0);
+DECLARE_ALIGNED(16, static const float, ps_s16_min)[4] = V4(-32768.0);
+DECLARE_ALIGNED(16, static const float, ps_s16_max)[4] = V4( 32767.0);
+
+static int conv_s16_to_flt_sse2(uint8_t *out, const uint8_t *in, int len)
+{
+    x86_reg n = len >> 3;
+
+    if (!n)
+        return 0;
+    __asm__ volatile(
+        "movaps        %3, %%xmm4           \n\t"
+        "1:                                 \n\t"
+        "movdqu      (%1), %%xmm0           \n\t"
+        "movdqa    %%xmm0, %%xmm1           \n\t"
+        "punpcklwd %%xmm0, %%xmm0           \n\t"
+        "punpckhwd %%xmm1, %%xmm1           \n\t"
+        "psrad        $16, %%xmm0           \n\t"
+        "psrad        $16, %%xmm1           \n\t"
+        "cvtdq2ps  %%xmm0, %%xmm0           \n\t"
+        "cvtdq2ps  %%xmm1, %%xmm1           \n\t"
+        "mulps     %%xmm4, %%xmm0           \n\t"
+        "mulps     %%xmm4, %%xmm1           \n\t"
+        "movups    %%xmm0,   (%0)           \n\t"
+        "movups    %%xmm1, 16(%0)           \n\t"
+        "add          $32, %0               \n\t"
+        "add          $16, %1               \n\t"
+        "dec           %2                   \n\t"
+        "jnz 1b                             \n\t"
+        : "+r"(out), "+r"(in), "+r"(n)
+        : "m"(*ps_1_15)
+        : "memory"
+          XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm4")
+    );
+    return len & ~7;
+}
+
+static int conv_s32_to_flt_sse2(uint8_t *out, const uint8_t *in, int len)
+{
+    x86_reg n = len >> 3;
+
+    if (!n)
+        return 0;
+    __asm__ volatile(
+        "movaps        %3, %%xmm4           \n\t"
+        "1:                                 \n\t"
+        "movdqu      (%1), %%xmm0           \n\t"
+        "movdqu    16(%1), %%xmm1           \n\t"
+        "cvtdq2ps  %%xmm0, %%xmm0           \n\t"
+        "cvtdq2ps  %%xmm1, %%xmm1           \n\t"
+        "mulps     %%xmm4, %%xmm0           \n\t"
+        "mulps     %%xmm4, %%xmm1           \n\t"
+        "movups    %%xmm0,   (%0)           \n\t"
+        "movups    %%xmm1, 16(%0)           \n\t"
+        "add          $32, %0               \n\t"
+        "add          $32, %1               \n\t"
+        "dec           %2                   \n\t"
+        "jnz 1b                             \n\t"
+        : "+r"(out), "+r"(in), "+r"(n)
+        : "m"(*ps_1_31)
+        : "memory"
+          XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm4")
+    );
+    return len & ~7;
+}
+
+/* av_clip_int16() takes an int, so lrintf() results outside of the int
+ * range are truncated before being clipped: blocks with such values or
+ * with NaN are left to the generic code */
+#define S16_IN_RANGE(r, m, t)                   \
+    "movaps    %%xmm5, "t"              \n\t"   \
+    "cmpleps   "r", "t"                 \n\t"   \
+    "andps     "t", "m"                 \n\t"   \
+    "movaps    "r", "t"                 \n\t"   \
+    "cmpltps   %%xmm6, "t"              \n\t"   \
+    "andps     "t", "m"                 \n\t"
+
+static int conv_flt_to_s16_sse2(uint8_t *out, const uint8_t *in, int len)
+{
+    x86_reg n = len >> 3;
+    int mask;
+
+    if (!n)
+        return 0;
+    __asm__ volatile(
+        "movaps        %4, %%xmm4           \n\t"
+        "movaps        %5, %%xmm5           \n\t"
+        "movaps        %6, %%xmm6           \n\t"
+        "1:                                 \n\t"
+        "movups      (%1), %%xmm0           \n\t"
+        "movups    16(%1), %%xmm1           \n\t"
+        "mulps     %%xmm4, %%xmm0           \n\t"
+        "mulps     %%xmm4, %%xmm1           \n\t"
+        "pcmpeqd   %%xmm2, %%xmm2           \n\t"
+        S16_IN_RANGE("%%xmm0", "%%xmm2", "%%xmm3")
+        S16_IN_RANGE("%%xmm1", "%%xmm2", "%%xmm3")
+        "movmskps  %%xmm2, %3               \n\t"
+        "cmp          $15, %3               \n\t"
+        "jne 2f                             \n\t"
+        "maxps         %7, %%xmm0           \n\t"
+        "maxps         %7, %%xmm1           \n\t"
+        "minps         %8, %%xmm0           \n\t"
+        "minps         %8, %%xmm1           \n\t"
+        "cvtps2dq  %%xmm0, %%xmm0           \n\t"
+        "cvtps2dq  %%xmm1, %%xmm1           \n\t"
+        "packssdw  %%xmm1, %%xmm0           \n\t"
+        "movdqu    %%xmm0, (%0)             \n\t"
+        "add          $16, %0               \n\t"
+        "add          $32, %1               \n\t"
+        "dec           %2                   \n\t"
+        "jnz 1b                             \n\t"
+        "2:                                 \n\t"
+        : "+r"(out), "+r"(in), "+r"(n), "=&r"(mask)
+        : "m"(*ps_2_15), "m"(*ps_m2_31), "m"(*ps_2_31),
+          "m"(*ps_s16_min), "m"(*ps_s16_max)
+        : "memory"
+          XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                         "%xmm4", "%xmm5", "%xmm6")
+    );
+    return (len & ~7) - 8 * n;
+}
+
+/* cvtps2dq gives INT32_MIN out of range, like the clipped llrintf(), except
+ * from 2^31 to 2^63, where llrintf() is clipped to INT32_MAX */
+#define FLT_TO_S32(r, t, u)                     \
+    "mulps     %%xmm4, "r"              \n\t"   \
+    "movaps    %%xmm4, "t"              \n\t"   \
+    "cmpleps   "r", "t"                 \n\t"   \
+    "movaps    "r", "u"                 \n\t"   \
+    "cmpltps   %%xmm5, "u"              \n\t"   \
+    "andps     "u", "t"                 \n\t"   \
+    "cvtps2dq  "r", "r"                 \n\t"   \
+    "pxor      "t", "r"                 \n\t"
+
+static int conv_flt_to_s32_sse2(uint8_t *out, const uint8_t *in, int len)
+{
+    x86_reg n = len >> 3;
+
+    if (!n)
+        return 0;
+    __asm__ volatile(
+        "movaps        %3, %%xmm4           \n\t"
+        "movaps        %4, %%xmm5           \n\t"
+        "1:                                 \n\t"
+        "movups      (%1), %%xmm0           \n\t"
+        "movups    16(%1), %%xmm1           \n\t"
+        FLT_TO_S32("%%xmm0", "%%xmm2", "%%xmm3")
+        FLT_TO_S32("%%xmm1", "%%xmm6", "%%xmm7")
+        "movdqu    %%xmm0,   (%0)           \n\t"
+        "movdqu    %%xmm1, 16(%0)           \n\t"
+        "add          $32, %0               \n\t"
+        "add          $32, %1               \n\t"
+        "dec           %2                   \n\t"
+        "jnz 1b                             \n\t"
+        : "+r"(out), "+r"(in), "+r"(n)
+        : "m"(*ps_2_31), "m"(*ps_2_63)
+        : "memory"
+          XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                         "%xmm4", "%xmm5", "%xmm6", "%xmm7")
+    );
+    return len & ~7;
+}
+
+static int conv_s16_to_s32_sse2(uint8_t *out, const uint8_t *in, int len)
+{
+    x86_reg n = len >> 3;
+
+    if (!n)
+        return 0;
+    __asm__ volatile(
+        "1:                                 \n\t"
+        "movdqu      (%1), %%xmm2           \n\t"
+        "pxor      %%xmm0, %%xmm0           \n\t"
+        "pxor      %%xmm1, %%xmm1           \n\t"
+        "punpcklwd %%xmm2, %%xmm0           \n\t"
+        "punpckhwd %%xmm2, %%xmm1           \n\t"
+        "movdqu    %%xmm0,   (%0)           \n\t"
+        "movdqu    %%xmm1, 16(%0)           \n\t"
+        "add          $32, %0               \n\t"
+        "add          $16, %1               \n\t"
+        "dec           %2                   \n\t"
+        "jnz 1b                             \n\t"
+        : "+r"(out), "+r"(in), "+r"(n)
+        :: "memory"
+          XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2")
+    );
+    return len & ~7;
+}
+
+static int conv_s32_to_s16_sse2(uint8_t *out, const uint8_t *in, int len)
+{
+    x86_reg n = len >> 3;
+
+    if (!n)
+        return 0;
+    __asm__ volatile(
+        "1:                                 \n\t"
+        "movdqu      (%1), %%xmm0           \n\t"
+        "movdqu    16(%1), %%xmm1           \n\t"
+        "psrad        $16, %%xmm0           \n\t"
+        "psrad        $16, %%xmm1           \n\t"
+        "packssdw  %%xmm1, %%xmm0           \n\t"
+        "movdqu    %%xmm0, (%0)             \n\t"
+        "add          $16, %0               \n\t"
+        "add          $32, %1               \n\t"
+        "dec           %2                   \n\t"
+        "jnz 1b                             \n\t"
+        : "+r"(out), "+r"(in), "+r"(n)
+        :: "memory"
+          XMM_CLOBBERS(, "%xmm0", "%xmm1")
+    );
+    return len & ~7;
+}
+
+#define FMT_PAIR(out, in) ((out) + AV_SAMPLE_FMT_NB * (in))
+
+void ff_audio_convert_init_x86(AVAudioConvert *ctx)
+{
+    int mm_flags = av_get_cpu_flags();
+
+    if (mm_flags & AV_CPU_FLAG_SSE2) {
+        switch (ctx->fmt_pair) {
+        case FMT_PAIR(AV_SAMPLE_FMT_FLT, AV_SAMPLE_FMT_S16):
+            ctx->conv_contiguous = conv_s16_to_flt_sse2; break;
+        case FMT_PAIR(AV_SAMPLE_FMT_FLT, AV_SAMPLE_FMT_S32):
+            ctx->conv_contiguous = conv_s32_to_flt_sse2; break;
+        case FMT_PAIR(AV_SAMPLE_FMT_S16, AV_SAMPLE_FMT_FLT):
+            ctx->conv_contiguous = conv_flt_to_s16_sse2; break;
+        case FMT_PAIR(AV_SAMPLE_FMT_S32, AV_SAMPLE_FMT_FLT):
+            ctx->conv_contiguous = conv_flt_to_s32_sse2; break;
+        case FMT_PAIR(AV_SAMPLE_FMT_S32, AV_SAMPLE_FMT_S16):
+            ctx->conv_contiguous = conv_s16_to_s32_sse2; break;
+        case FMT_PAIR(AV_SAMPLE_FMT_S16, AV_SAMPLE_FMT_S32):
+            ctx->conv_contiguous = conv_s32_to_s16_sse2; break;
+        }
+    }
+}
@@ -26,6 +26,32 @@
 #include "libavutil/x86_cpu.h"
 #include "config.h"
 
+#ifdef BROKEN_RELOCATIONS
+/* With x86-64 PIC the tables can only be addressed relative to %rip, which
+ * does not combine with an index register, so their addresses are passed in
+ * registers: the TABLES_ARG operands, named by the last three arguments of
+ * BRANCHLESS_GET_CABAC. */
+#define TABLES_ARG , "r"(ff_h264_lps_range), "r"(ff_h264_norm_shift), \
+                     "r"(ff_h264_mlps_state + 128)
+#define LOAD_LPS_RANGE(ret, retq, range, rangeq, lps)                        \
+        "lea    ("retq", "rangeq", 2), "rangeq"                         \n\t"\
+        "movzbl ("lps", "rangeq"), "range"                              \n\t"
+#define LOAD_NORM_SHIFT(dst, idx, idxq, norm)                                \
+        "movzbl ("norm", "idxq"), "dst"                                 \n\t"
+/* the index may be negative */
+#define LOAD_MLPS_STATE(dst, ret, retq, mlps)                                \
+        "movslq "ret"       , "retq"                                    \n\t"\
+        "movzbl ("mlps", "retq"), "dst"                                 \n\t"
+#else
+#define TABLES_ARG
+#define LOAD_LPS_RANGE(ret, retq, range, rangeq, lps)                        \
+        "movzbl "MANGLE(ff_h264_lps_range)"("ret", "range", 2), "range" \n\t"
+#define LOAD_NORM_SHIFT(dst, idx, idxq, norm)                                \
+        "movzbl "MANGLE(ff_h264_norm_shift)"("idx"), "dst"              \n\t"
+#define LOAD_MLPS_STATE(dst, ret, retq, mlps)                                \
+        "movzbl "MANGLE(ff_h264_mlps_state)"+128("ret"), "dst"          \n\t"
+#endif /* BROKEN_RELOCATIONS */
+
 #if HAVE_FAST_CMOV
 #define BRANCHLESS_GET_CABAC_UPDATE(ret, cabac, statep, low, lowword, range, tmp)\
         "mov    "tmp"       , %%ecx     \n\t"\
@@ -51,17 +77,18 @@
         "xor    "tmp"       , "ret"     \n\t"
 #endif /* HAVE_FAST_CMOV */
 
-#define BRANCHLESS_GET_CABAC(ret, cabac, statep, low, lowword, range, tmp, tmpbyte, byte) \
+#define BRANCHLESS_GET_CABAC(ret, retq, cabac, statep, low, lowword, range, rangeq, \
+                             tmp, tmpbyte, byte, lps, norm, mlps)            \
         "movzbl "statep"    , "ret"                                     \n\t"\
         "mov    "range"     , "tmp"                                     \n\t"\
         "and    $0xC0       , "range"                                   \n\t"\
-        "movzbl "MANGLE(ff_h264_lps_range)"("ret", "range", 2), "range" \n\t"\
+        LOAD_LPS_RANGE(ret, retq, range, rangeq, lps)                        \
         "sub    "range"     , "tmp"                                     \n\t"\
         BRANCHLESS_GET_CABAC_UPDATE(ret, cabac, statep, low, lowword,        \
                                     range, tmp)                              \
-        "movzbl " MANGLE(ff_h264_norm_shift) "("range"), %%ecx          \n\t"\
+        LOAD_NORM_SHIFT("%%ecx", range, rangeq, norm)                        \
         "shl    %%cl        , "range"                                   \n\t"\
-        "movzbl "MANGLE(ff_h264_mlps_state)"+128("ret"), "tmp"          \n\t"\
+        LOAD_MLPS_STATE(tmp, ret, retq, mlps)                                \
         "mov    "tmpbyte"   , "statep"                                  \n\t"\
         "shl    %%cl        , "low"                                     \n\t"\
         "test   "lowword"   , "lowword"                                 \n\t"\
@@ -76,14 +103,14 @@
         "lea    -1("low")   , %%ecx                                     \n\t"\
         "xor    "low"       , %%ecx                                     \n\t"\
         "shr    $15         , %%ecx                                     \n\t"\
-        "movzbl " MANGLE(ff_h264_norm_shift) "(%%ecx), %%ecx            \n\t"\
+        LOAD_NORM_SHIFT("%%ecx", "%%ecx", "%%"REG_c, norm)                   \
         "neg    %%ecx                                                   \n\t"\
         "add    $7          , %%ecx                                     \n\t"\
         "shl    %%cl        , "tmp"                                     \n\t"\
         "add    "tmp"       , "low"                                     \n\t"\
         "1:                                                             \n\t"
 
-#if ARCH_X86 && HAVE_7REGS && !defined(BROKEN_RELOCATIONS)
+#if ARCH_X86 && HAVE_7REGS
 #define get_cabac_inline get_cabac_inline_x86
 static av_always_inline int get_cabac_inline_x86(CABACContext *c,
                                                  uint8_t *const state)
@@ -93,8 +120,8 @@ static av_always_inline int get_cabac_inline_x86(CABACContext *c,
     __asm__ volatile(
         "movl %a6(%5), %2               \n\t"
         "movl %a7(%5), %1               \n\t"
-        BRANCHLESS_GET_CABAC("%0", "%5", "(%4)", "%1", "%w1", "%2",
-                             "%3", "%b3", "%a8")
+        BRANCHLESS_GET_CABAC("%0", "%q0", "%5", "(%4)", "%1", "%w1", "%2", "%q2",
+                             "%3", "%b3", "%a8", "%9", "%10", "%11")
         "movl %2, %a6(%5)               \n\t"
         "movl %1, %a7(%5)               \n\t"
 
@@ -102,11 +129,12 @@ static av_always_inline int get_cabac_inline_x86(CABACContext *c,
         :"r"(state), "r"(c),
          "i"(offsetof(CABACContext, range)), "i"(offsetof(CABACContext, low)),
          "i"(offsetof(CABACContext, bytestream))
+         TABLES_ARG
         : "%"REG_c, "memory"
     );
     return bit & 1;
 }
-#endif /* ARCH_X86 && HAVE_7REGS && !defined(BROKEN_RELOCATIONS) */
+#endif /* ARCH_X86 && HAVE_7REGS */
 
 #define get_cabac_bypass_sign get_cabac_bypass_sign_x86
 static av_always_inline int get_cabac_bypass_sign_x86(CABACContext *c, int val)
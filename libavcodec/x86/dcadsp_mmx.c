@@ -0,0 +1,185 @@
+/*
+ * SSE optimized DCA DSP functions
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/cpu.h"
+#include "libavutil/mem.h"
+#include "libavutil/x86_cpu.h"
+#include "libavcodec/dsputil.h"
+#include "libavcodec/dcadsp.h"
+
+/* These give the same results as the C versions. */
+
+DECLARE_ALIGNED(16, static const uint32_t, dca_neg_03)[4] =
+    { 0x80000000, 0, 0, 0x80000000 };
+
+/* transpose the 4x4 matrix in a, b, c, d; the columns end up in a, c, t, b */
+#define TRANSPOSE4(a, b, c, d, t)       \
+    "movaps  "a", "t"           \n\t"   \
+    "unpcklps "b", "a"          \n\t"   \
+    "unpckhps "b", "t"          \n\t"   \
+    "movaps  "c", "b"           \n\t"   \
+    "unpcklps "d", "c"          \n\t"   \
+    "unpckhps "d", "b"          \n\t"   \
+    "movaps  "a", "d"           \n\t"   \
+    "movlhps "c", "a"           \n\t"   \
+    "movhlps "d", "c"           \n\t"   \
+    "movaps  "t", "d"           \n\t"   \
+    "movlhps "b", "t"           \n\t"   \
+    "movhlps "d", "b"           \n\t"
+
+/**
+ * Compute 4 outputs of the LFE interpolation filter.
+ * The coefficients of one output are read from consecutive rows of the
+ * coefficient table, stride bytes apart; for the mirrored half of the
+ * filter they are read backwards, which is what shuf (0x1b) does, and the
+ * coefficient pointer moves by step bytes for each 4 taps.
+ * The taps are summed in the same order as in the C version.
+ */
+#define LFE_FIR_4(out, in, coefs, stride, step, ntaps, scale, shuf)     \
+{                                                                       \
+    x86_reg c_ = (x86_reg)(coefs), i_ = (x86_reg)(in);                  \
+    x86_reg s_ = stride, n_ = (ntaps) >> 2;                             \
+    __asm__ volatile(                                                   \
+        "xorps       %%xmm6, %%xmm6         \n\t"                       \
+        "1:                                 \n\t"                       \
+        "lea         (%0,%2,2), %%"REG_d"   \n\t"                       \
+        "movaps      (%0), %%xmm0           \n\t"                       \
+        "movaps      (%0,%2), %%xmm1        \n\t"                       \
+        "movaps      (%%"REG_d"), %%xmm2    \n\t"                       \
+        "movaps      (%%"REG_d",%2), %%xmm3 \n\t"                       \
+        "shufps $"#shuf", %%xmm0, %%xmm0    \n\t"                       \
+        "shufps $"#shuf", %%xmm1, %%xmm1    \n\t"                       \
+        "shufps $"#shuf", %%xmm2, %%xmm2    \n\t"                       \
+        "shufps $"#shuf", %%xmm3, %%xmm3    \n\t"                       \
+        TRANSPOSE4("%%xmm0", "%%xmm1", "%%xmm2", "%%xmm3", "%%xmm4")    \
+        "movups    -12(%1), %%xmm5          \n\t"                       \
+        "shufps $0x1b, %%xmm5, %%xmm5       \n\t"                       \
+        "movaps      %%xmm5, %%xmm7         \n\t"                       \
+        "shufps $0x00, %%xmm7, %%xmm7       \n\t"                       \
+        "mulps       %%xmm0, %%xmm7         \n\t"                       \
+        "addps       %%xmm7, %%xmm6         \n\t"                       \
+        "movaps      %%xmm5, %%xmm7         \n\t"                       \
+        "shufps $0x55, %%xmm7, %%xmm7       \n\t"                       \
+        "mulps       %%xmm2, %%xmm7         \n\t"                       \
+        "addps       %%xmm7, %%xmm6         \n\t"                       \
+        "movaps      %%xmm5, %%xmm7         \n\t"                       \
+        "shufps $0xaa, %%xmm7, %%xmm7       \n\t"                       \
+        "mulps       %%xmm4, %%xmm7         \n\t"                       \
+        "addps       %%xmm7, %%xmm6         \n\t"                       \
+        "shufps $0xff, %%xmm5, %%xmm5       \n\t"                       \
+        "mulps       %%xmm1, %%xmm5         \n\t"                       \
+        "addps       %%xmm5, %%xmm6         \n\t"                       \
+        "add         %4, %0                 \n\t"                       \
+        "sub         $16, %1                \n\t"                       \
+        "dec         %3                     \n\t"                       \
+        "jnz 1b                             \n\t"                       \
+        "movss       %6, %%xmm7             \n\t"                       \
+        "shufps $0x00, %%xmm7, %%xmm7       \n\t"                       \
+        "mulps       %%xmm7, %%xmm6         \n\t"                       \
+        "movups      %%xmm6, (%5)           \n\t"                       \
+        : "+r"(c_), "+r"(i_), "+r"(s_), "+r"(n_)                        \
+        : "i"(step), "r"(out), "m"(scale)                               \
+        : "%"REG_d, "memory"                                            \
+          XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm3",            \
+                         "%xmm4", "%xmm5", "%xmm6", "%xmm7")            \
+    );                                                                  \
+}
+
+static void dca_lfe_fir_sse(float *out, const float *in, const float *coefs,
+                            int decifactor, float scale)
+{
+    int ntaps = 256 / decifactor;
+    int k;
+
+    for (k = 0; k < decifactor; k += 4) {
+        LFE_FIR_4(out + k,              in, coefs       + k * ntaps,
+                   ntaps * 4,  16, ntaps, scale, 0xe4);
+        LFE_FIR_4(out + decifactor + k, in, coefs + 252 - k * ntaps,
+                  -ntaps * 4, -16, ntaps, scale, 0x1b);
+    }
+}
+
+static void dca_qmf_32_subbands_sse(float samples_in[32][8], int sb_act,
+                                    SynthFilterContext *synth, FFTContext *imdct,
+                                    float synth_buf_ptr[512], int *synth_buf_offset,
+                                    float synth_buf2[32], const float window[512],
+                                    float *samples_out, float raXin[32], float scale)
+{
+    LOCAL_ALIGNED_16(float, buf, [8], [32]);
+    int i, subindex;
+
+    /* transpose the active subbands in blocks of 4x4 samples, flipping the
+     * sign of the subbands the C version flips */
+    for (i = 0; i < sb_act; i += 4) {
+        __asm__ volatile(
+            "movaps        (%0), %%xmm0     \n\t"
+            "movaps      32(%0), %%xmm1     \n\t"
+            "movaps      64(%0), %%xmm2     \n\t"
+            "movaps      96(%0), %%xmm3     \n\t"
+            TRANSPOSE4("%%xmm0", "%%xmm1", "%%xmm2", "%%xmm3", "%%xmm4")
+            "movaps        %2, %%xmm5       \n\t"
+            "xorps     %%xmm5, %%xmm0       \n\t"
+            "xorps     %%xmm5, %%xmm2       \n\t"
+            "xorps     %%xmm5, %%xmm4       \n\t"
+            "xorps     %%xmm5, %%xmm1       \n\t"
+            "movaps    %%xmm0,    (%1)      \n\t"
+            "movaps    %%xmm2, 128(%1)      \n\t"
+            "movaps    %%xmm4, 256(%1)      \n\t"
+            "movaps    %%xmm1, 384(%1)      \n\t"
+            "movaps      16(%0), %%xmm0     \n\t"
+            "movaps      48(%0), %%xmm1     \n\t"
+            "movaps      80(%0), %%xmm2     \n\t"
+            "movaps     112(%0), %%xmm3     \n\t"
+            TRANSPOSE4("%%xmm0", "%%xmm1", "%%xmm2", "%%xmm3", "%%xmm4")
+            "xorps     %%xmm5, %%xmm0       \n\t"
+            "xorps     %%xmm5, %%xmm2       \n\t"
+            "xorps     %%xmm5, %%xmm4       \n\t"
+            "xorps     %%xmm5, %%xmm1       \n\t"
+            "movaps    %%xmm0, 512(%1)      \n\t"
+            "movaps    %%xmm2, 640(%1)      \n\t"
+            "movaps    %%xmm4, 768(%1)      \n\t"
+            "movaps    %%xmm1, 896(%1)      \n\t"
+            :: "r"(samples_in[i]), "r"(&buf[0][i]), "m"(*dca_neg_03)
+            : "memory"
+              XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                             "%xmm4", "%xmm5")
+        );
+    }
+
+    for (subindex = 0; subindex < 8; subindex++) {
+        for (i = sb_act; i < 32; i++)
+            buf[subindex][i] = 0.0;
+
+        synth->synth_filter_float(imdct, synth_buf_ptr, synth_buf_offset,
+                                  synth_buf2, window, samples_out,
+                                  buf[subindex], scale);
+        samples_out += 32;
+    }
+}
+
+void ff_dcadsp_init_mmx(DCADSPContext *s)
+{
+    int mm_flags = av_get_cpu_flags();
+
+    if (mm_flags & AV_CPU_FLAG_SSE) {
+        s->lfe_fir         = dca_lfe_fir_sse;
+        s->qmf_32_subbands = dca_qmf_32_subbands_sse;
+    }
+}
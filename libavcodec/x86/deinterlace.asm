@@ -1,5 +1,5 @@
 ;******************************************************************************
-;* MMX optimized deinterlacing functions
+;* MMX and SSE2 optimized deinterlacing functions
 ;* Copyright (c) 2010 Vitor Sessak
 ;* Copyright (c) 2002 Michael Niedermayer
 ;*
@@ -29,55 +29,84 @@ cextern pw_4
 
 SECTION .text
 
-%macro DEINTERLACE 1
+;%1 = inplace or empty, %2 = movd or movh, loading 4 or mmsize/2 pixels
+%macro DEINTERLACE_PIXELS 2
+    %2    m0, [lum_m4q]
+    %2    m1, [lum_m3q]
+    %2    m2, [lum_m2q]
 %ifidn %1, inplace
-;void ff_deinterlace_line_inplace_mmx(const uint8_t *lum_m4, const uint8_t *lum_m3, const uint8_t *lum_m2, const uint8_t *lum_m1, const uint8_t *lum,  int size)
-cglobal deinterlace_line_inplace_mmx, 6,6,7,      lum_m4, lum_m3, lum_m2, lum_m1, lum, size
-%else
-;void ff_deinterlace_line_mmx(uint8_t *dst, const uint8_t *lum_m4, const uint8_t *lum_m3, const uint8_t *lum_m2, const uint8_t *lum_m1, const uint8_t *lum,  int size)
-cglobal deinterlace_line_mmx,         7,7,7, dst, lum_m4, lum_m3, lum_m2, lum_m1, lum, size
+    %2 [lum_m4q], m2
 %endif
-    pxor  mm7, mm7
-    movq  mm6, [pw_4]
-.nextrow
-    movd  mm0, [lum_m4q]
-    movd  mm1, [lum_m3q]
-    movd  mm2, [lum_m2q]
+    %2    m3, [lum_m1q]
+    %2    m4, [lumq]
+    punpcklbw m0, m7
+    punpcklbw m1, m7
+    punpcklbw m2, m7
+    punpcklbw m3, m7
+    punpcklbw m4, m7
+    paddw     m1, m3
+    psllw     m2, 1
+    paddw     m0, m4
+    psllw     m1, 2
+    paddw     m2, m6
+    paddw     m1, m2
+    psubusw   m1, m0
+    psrlw     m1, 3
+    packuswb  m1, m7
 %ifidn %1, inplace
-    movd [lum_m4q], mm2
+    %2 [lum_m2q], m1
+%else
+    %2   [dstq], m1
+%endif
+%endmacro
+
+%macro DEINTERLACE_ADVANCE 2
+%ifnidn %1, inplace
+    add       dstq, %2
 %endif
-    movd  mm3, [lum_m1q]
-    movd  mm4, [lumq]
-    punpcklbw mm0, mm7
-    punpcklbw mm1, mm7
-    punpcklbw mm2, mm7
-    punpcklbw mm3, mm7
-    punpcklbw mm4, mm7
-    paddw     mm1, mm3
-    psllw     mm2, 1
-    paddw     mm0, mm4
-    psllw     mm1, 2
-    paddw     mm2, mm6
-    paddw     mm1, mm2
-    psubusw   mm1, mm0
-    psrlw     mm1, 3
-    packuswb  mm1, mm7
+    add    lum_m4q, %2
+    add    lum_m3q, %2
+    add    lum_m2q, %2
+    add    lum_m1q, %2
+    add       lumq, %2
+%endmacro
+
+;%1 = inplace or empty, %2 = cpu name
+%macro DEINTERLACE 2
 %ifidn %1, inplace
-    movd [lum_m2q], mm1
+;void ff_deinterlace_line_inplace_%2(uint8_t *lum_m4, const uint8_t *lum_m3, uint8_t *lum_m2, const uint8_t *lum_m1, const uint8_t *lum,  int size)
+cglobal deinterlace_line_inplace_%2, 6,6,8,       lum_m4, lum_m3, lum_m2, lum_m1, lum, size
 %else
-    movd   [dstq], mm1
-    add       dstq, 4
+;void ff_deinterlace_line_%2(uint8_t *dst, const uint8_t *lum_m4, const uint8_t *lum_m3, const uint8_t *lum_m2, const uint8_t *lum_m1, const uint8_t *lum,  int size)
+cglobal deinterlace_line_%2,         7,7,8, dst, lum_m4, lum_m3, lum_m2, lum_m1, lum, size
 %endif
-    add    lum_m4q, 4
-    add    lum_m3q, 4
-    add    lum_m2q, 4
-    add    lum_m1q, 4
-    add       lumq, 4
-    sub      sized, 4
-    jg .nextrow
+    pxor   m7, m7
+    mova   m6, [pw_4]
+%if mmsize == 16
+    ; mmsize/2 pixels at a time, then the rest 4 by 4 like the MMX version
+    sub    sized, mmsize/2
+    jl .tail
+.nextrow:
+    DEINTERLACE_PIXELS %1, movh
+    DEINTERLACE_ADVANCE %1, mmsize/2
+    sub    sized, mmsize/2
+    jge .nextrow
+.tail:
+    add    sized, mmsize/2
+    jle .end
+%endif
+.next4:
+    DEINTERLACE_PIXELS %1, movd
+    DEINTERLACE_ADVANCE %1, 4
+    sub    sized, 4
+    jg .next4
+.end:
     REP_RET
 %endmacro
 
-DEINTERLACE ""
-
-DEINTERLACE inplace
+INIT_MMX
+DEINTERLACE "", mmx
+DEINTERLACE inplace, mmx
+INIT_XMM
+DEINTERLACE "", sse2
+DEINTERLACE inplace, sse2
@@ -580,6 +580,93 @@ static void add_bytes_mmx(uint8_t *dst, uint8_t *src, int w){
         dst[i+0] += src[i+0];
 }
 
+#define LAG_MEDIAN_STEP\
+        "movq      %%mm3, %%mm4         \n\t"\
+        "paddusb   %%mm0, %%mm4         \n\t"\
+        "psubusb   %%mm6, %%mm4         \n\t" /* clip(l + t - tl) */\
+        "movq      %%mm3, %%mm5         \n\t"\
+        "pmaxub    %%mm1, %%mm3         \n\t"\
+        "pminub    %%mm1, %%mm5         \n\t"\
+        "pminub    %%mm4, %%mm3         \n\t"\
+        "pmaxub    %%mm5, %%mm3         \n\t" /* median */\
+        "paddb     %%mm2, %%mm3         \n\t" /* + residual */
+
+#define LAG_MEDIAN_NEXT\
+        "movq      %%mm3, %%mm4         \n\t"\
+        "psrlq        $8, %%mm7         \n\t"\
+        "psllq       $56, %%mm4         \n\t"\
+        "por       %%mm4, %%mm7         \n\t"\
+        "psrlq        $8, %%mm0         \n\t"\
+        "psrlq        $8, %%mm1         \n\t"\
+        "psrlq        $8, %%mm2         \n\t"\
+        "psrlq        $8, %%mm6         \n\t"\
+        LAG_MEDIAN_STEP
+
+static void add_lag_median_prediction_mmx2(uint8_t *dst, const uint8_t *top, const uint8_t *diff, int w, int *left, int *left_top)
+{
+    x86_reg i = 0, w8 = w & ~7;
+    uint8_t l, lt;
+
+    /* The pixels depend on each other, so each of the 8 bytes of a word is
+     * predicted in turn, from the byte decoded just before. */
+    if (w8) {
+        __asm__ volatile(
+            "movq       (%2), %%mm0         \n\t"
+            "movd         %5, %%mm4         \n\t"
+            "movq      %%mm0, %%mm2         \n\t"
+            "psllq        $8, %%mm2         \n\t"
+            "movq      %%mm0, %%mm1         \n\t" // t
+            "por       %%mm2, %%mm4         \n\t" // tl
+            "movd         %4, %%mm3         \n\t" // l
+            "jmp 2f                         \n\t"
+            "1:                             \n\t"
+            "movq   (%2, %0), %%mm4         \n\t"
+            "movq      %%mm4, %%mm0         \n\t"
+            "psllq        $8, %%mm4         \n\t"
+            "por       %%mm1, %%mm4         \n\t" // tl
+            "movq      %%mm0, %%mm1         \n\t" // t
+            "2:                             \n\t"
+            "movq      %%mm4, %%mm6         \n\t"
+            "psubusb   %%mm4, %%mm0         \n\t" // max(t - tl, 0)
+            "psubusb   %%mm1, %%mm6         \n\t" // max(tl - t, 0)
+            "movq   (%3, %0), %%mm2         \n\t"
+            LAG_MEDIAN_STEP
+            "movq      %%mm3, %%mm7         \n\t"
+            "psllq       $56, %%mm7         \n\t"
+            LAG_MEDIAN_NEXT
+            LAG_MEDIAN_NEXT
+            LAG_MEDIAN_NEXT
+            LAG_MEDIAN_NEXT
+            LAG_MEDIAN_NEXT
+            LAG_MEDIAN_NEXT
+            LAG_MEDIAN_NEXT
+            "movq      %%mm3, %%mm4         \n\t"
+            "psrlq        $8, %%mm7         \n\t"
+            "psllq       $56, %%mm4         \n\t"
+            "por       %%mm4, %%mm7         \n\t"
+            "movq      %%mm7, (%1, %0)      \n\t"
+            "add          $8, %0            \n\t"
+            "cmp          %6, %0            \n\t"
+            " jl 1b                         \n\t"
+            : "+r" (i)
+            : "r"(dst), "r"(top), "r"(diff), "m"(*left), "m"(*left_top), "g"(w8)
+            : "memory"
+        );
+        *left     = dst[w8 - 1];
+        *left_top = top[w8 - 1];
+    }
+
+    l  = *left;
+    lt = *left_top;
+    for (i = w8; i < w; i++) {
+        l = mid_pred(l, top[i], l + top[i] - lt) + diff[i];
+        lt = top[i];
+        dst[i] = l;
+    }
+    *left     = l;
+    *left_top = lt;
+}
+
 #if HAVE_7REGS && HAVE_TEN_OPERANDS
 static void add_hfyu_median_prediction_cmov(uint8_t *dst, const uint8_t *top, const uint8_t *diff, int w, int *left, int *left_top) {
     x86_reg w2 = -w;
@@ -2295,6 +2382,313 @@ static void vector_clipf_sse(float *dst, const float *src, float min, float max,
     );
 }
 
+static void butterflies_float_sse(float *restrict v1, float *restrict v2,
+                                  int len)
+{
+    x86_reg i = (len-4)*4;
+    __asm__ volatile(
+        "1: \n\t"
+        "movaps    (%1,%0), %%xmm0 \n\t"
+        "movaps    (%2,%0), %%xmm1 \n\t"
+        "movaps     %%xmm0, %%xmm2 \n\t"
+        "subps      %%xmm1, %%xmm0 \n\t"
+        "addps      %%xmm1, %%xmm2 \n\t"
+        "movaps     %%xmm0, (%2,%0) \n\t"
+        "movaps     %%xmm2, (%1,%0) \n\t"
+        "sub  $16, %0 \n\t"
+        "jge 1b \n\t"
+        :"+r"(i)
+        :"r"(v1), "r"(v2)
+        :"memory"
+    );
+}
+
+#if HAVE_AVX
+/*
+ * The arrays are only guaranteed to be 16-byte aligned, so each function
+ * comes in a version with aligned moves (_a), used when all arrays are
+ * 32-byte aligned, and one with unaligned moves (_u). Lengths which are
+ * a multiple of 4 but not of 8 go to the SSE versions.
+ */
+#define ALIGNED_32(p) (!((intptr_t)(p) & 31))
+
+#define VECTOR_FMUL_AVX(suf, mov)                                             \
+static void vector_fmul_avx_##suf(float *dst, const float *src0,              \
+                                  const float *src1, int len)                 \
+{                                                                             \
+    x86_reg i = (len-8)*4;                                                    \
+    __asm__ volatile(                                                         \
+        "1: \n\t"                                                             \
+        mov"           (%2,%0), %%ymm0 \n\t"                                  \
+        "vmulps        (%3,%0), %%ymm0, %%ymm0 \n\t"                          \
+        mov"   %%ymm0,   (%1,%0) \n\t"                                        \
+        "sub  $32, %0 \n\t"                                                   \
+        "jge 1b \n\t"                                                         \
+        "vzeroupper \n\t"                                                     \
+        :"+r"(i)                                                              \
+        :"r"(dst), "r"(src0), "r"(src1)                                       \
+        :"memory"                                                             \
+         XMM_CLOBBERS(, "%xmm0")                                              \
+    );                                                                        \
+}
+
+#define VECTOR_FMUL_REVERSE_AVX(suf, mov)                                     \
+static void vector_fmul_reverse_avx_##suf(float *dst, const float *src0,      \
+                                          const float *src1, int len)         \
+{                                                                             \
+    x86_reg i = len*4-32;                                                     \
+    __asm__ volatile(                                                         \
+        "1: \n\t"                                                             \
+        mov"               (%1), %%ymm0 \n\t"                                 \
+        "vpermilps   $0x1b, %%ymm0, %%ymm0 \n\t"                              \
+        "vperm2f128  $0x01, %%ymm0, %%ymm0, %%ymm0 \n\t"                      \
+        "vmulps        (%3,%0), %%ymm0, %%ymm0 \n\t"                          \
+        mov"   %%ymm0,   (%2,%0) \n\t"                                        \
+        "add  $32, %1 \n\t"                                                   \
+        "sub  $32, %0 \n\t"                                                   \
+        "jge 1b \n\t"                                                         \
+        "vzeroupper \n\t"                                                     \
+        :"+r"(i), "+r"(src1)                                                  \
+        :"r"(dst), "r"(src0)                                                  \
+        :"memory"                                                             \
+         XMM_CLOBBERS(, "%xmm0")                                              \
+    );                                                                        \
+}
+
+#define VECTOR_FMUL_ADD_AVX(suf, mov)                                         \
+static void vector_fmul_add_avx_##suf(float *dst, const float *src0,          \
+                                      const float *src1, const float *src2,   \
+                                      int len)                                \
+{                                                                             \
+    x86_reg i = (len-8)*4;                                                    \
+    __asm__ volatile(                                                         \
+        "1: \n\t"                                                             \
+        mov"           (%2,%0), %%ymm0 \n\t"                                  \
+        "vmulps        (%3,%0), %%ymm0, %%ymm0 \n\t"                          \
+        "vaddps        (%4,%0), %%ymm0, %%ymm0 \n\t"                          \
+        mov"   %%ymm0,   (%1,%0) \n\t"                                        \
+        "sub  $32, %0 \n\t"                                                   \
+        "jge 1b \n\t"                                                         \
+        "vzeroupper \n\t"                                                     \
+        :"+r"(i)                                                              \
+        :"r"(dst), "r"(src0), "r"(src1), "r"(src2)                            \
+        :"memory"                                                             \
+         XMM_CLOBBERS(, "%xmm0")                                              \
+    );                                                                        \
+}
+
+/* reverse the 8 floats of a ymm register */
+#define REVERSE_YMM(r)                                                        \
+        "vpermilps   $0x1b, "r", "r" \n\t"                                    \
+        "vperm2f128  $0x01, "r", "r", "r" \n\t"
+
+#define VECTOR_FMUL_WINDOW_AVX(suf, mov)                                      \
+static void vector_fmul_window_avx_##suf(float *dst, const float *src0,       \
+                                         const float *src1, const float *win, \
+                                         int len)                             \
+{                                                                             \
+    x86_reg i = -len*4;                                                       \
+    x86_reg j = len*4-32;                                                     \
+    __asm__ volatile(                                                         \
+        "1: \n"                                                               \
+        mov"           (%5,%1), %%ymm1 \n"                                    \
+        mov"           (%5,%0), %%ymm0 \n"                                    \
+        mov"           (%4,%1), %%ymm5 \n"                                    \
+        mov"           (%3,%0), %%ymm4 \n"                                    \
+        REVERSE_YMM("%%ymm1")                                                 \
+        REVERSE_YMM("%%ymm5")                                                 \
+        "vmulps  %%ymm4, %%ymm0, %%ymm2 \n" /* src0[len+i]*win[len+i] */      \
+        "vmulps  %%ymm5, %%ymm1, %%ymm3 \n" /* src1[    j]*win[len+j] */      \
+        "vmulps  %%ymm4, %%ymm1, %%ymm1 \n" /* src0[len+i]*win[len+j] */      \
+        "vmulps  %%ymm5, %%ymm0, %%ymm0 \n" /* src1[    j]*win[len+i] */      \
+        "vaddps  %%ymm3, %%ymm2, %%ymm2 \n"                                   \
+        "vsubps  %%ymm0, %%ymm1, %%ymm1 \n"                                   \
+        REVERSE_YMM("%%ymm2")                                                 \
+        mov"   %%ymm1, (%2,%0) \n"                                            \
+        mov"   %%ymm2, (%2,%1) \n"                                            \
+        "sub $32, %1 \n"                                                      \
+        "add $32, %0 \n"                                                      \
+        "jl 1b \n"                                                            \
+        "vzeroupper \n"                                                       \
+        :"+r"(i), "+r"(j)                                                     \
+        :"r"(dst+len), "r"(src0+len), "r"(src1), "r"(win+len)                 \
+        :"memory"                                                             \
+         XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4", "%xmm5") \
+    );                                                                        \
+}
+
+#define VECTOR_CLIPF_AVX(suf, mov)                                            \
+static void vector_clipf_avx_##suf(float *dst, const float *src,              \
+                                   float min, float max, int len)             \
+{                                                                             \
+    x86_reg i = (len-16)*4;                                                   \
+    __asm__ volatile(                                                         \
+        "vbroadcastss  %3, %%ymm4 \n"                                         \
+        "vbroadcastss  %4, %%ymm5 \n"                                         \
+        "1: \n\t"                                                             \
+        mov"           (%2,%0), %%ymm0 \n\t"                                  \
+        mov"         32(%2,%0), %%ymm1 \n\t"                                  \
+        "vmaxps  %%ymm4, %%ymm0, %%ymm0 \n\t"                                 \
+        "vmaxps  %%ymm4, %%ymm1, %%ymm1 \n\t"                                 \
+        "vminps  %%ymm5, %%ymm0, %%ymm0 \n\t"                                 \
+        "vminps  %%ymm5, %%ymm1, %%ymm1 \n\t"                                 \
+        mov"   %%ymm0,   (%1,%0) \n\t"                                        \
+        mov"   %%ymm1, 32(%1,%0) \n\t"                                        \
+        "sub  $64, %0 \n\t"                                                   \
+        "jge 1b \n\t"                                                         \
+        "vzeroupper \n\t"                                                     \
+        :"+&r"(i)                                                             \
+        :"r"(dst), "r"(src), "m"(min), "m"(max)                               \
+        :"memory"                                                             \
+         XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm4", "%xmm5")                   \
+    );                                                                        \
+}
+
+#define BUTTERFLIES_FLOAT_AVX(suf, mov)                                       \
+static void butterflies_float_avx_##suf(float *restrict v1,                   \
+                                        float *restrict v2, int len)          \
+{                                                                             \
+    x86_reg i = (len-8)*4;                                                    \
+    __asm__ volatile(                                                         \
+        "1: \n\t"                                                             \
+        mov"           (%1,%0), %%ymm0 \n\t"                                  \
+        mov"           (%2,%0), %%ymm1 \n\t"                                  \
+        "vsubps  %%ymm1, %%ymm0, %%ymm2 \n\t"                                 \
+        "vaddps  %%ymm1, %%ymm0, %%ymm0 \n\t"                                 \
+        mov"   %%ymm2,   (%2,%0) \n\t"                                        \
+        mov"   %%ymm0,   (%1,%0) \n\t"                                        \
+        "sub  $32, %0 \n\t"                                                   \
+        "jge 1b \n\t"                                                         \
+        "vzeroupper \n\t"                                                     \
+        :"+r"(i)                                                              \
+        :"r"(v1), "r"(v2)                                                     \
+        :"memory"                                                             \
+         XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2")                            \
+    );                                                                        \
+}
+
+#define SCALARPRODUCT_FLOAT_AVX(suf, mov)                                     \
+static float scalarproduct_float_avx_##suf(const float *v1, const float *v2,  \
+                                           int len)                           \
+{                                                                             \
+    x86_reg i = (len-8)*4;                                                    \
+    float ret;                                                                \
+    __asm__ volatile(                                                         \
+        "vxorps  %%ymm1, %%ymm1, %%ymm1 \n\t"                                 \
+        "1: \n\t"                                                             \
+        mov"           (%2,%0), %%ymm0 \n\t"                                  \
+        "vmulps        (%3,%0), %%ymm0, %%ymm0 \n\t"                          \
+        "vaddps  %%ymm0, %%ymm1, %%ymm1 \n\t"                                 \
+        "sub  $32, %0 \n\t"                                                   \
+        "jge 1b \n\t"                                                         \
+        "vextractf128  $1, %%ymm1, %%xmm0 \n\t"                               \
+        "vaddps  %%xmm0, %%xmm1, %%xmm1 \n\t"                                 \
+        "vmovhlps %%xmm1, %%xmm1, %%xmm0 \n\t"                                \
+        "vaddps  %%xmm0, %%xmm1, %%xmm1 \n\t"                                 \
+        "vshufps $1, %%xmm1, %%xmm1, %%xmm0 \n\t"                             \
+        "vaddss  %%xmm0, %%xmm1, %%xmm1 \n\t"                                 \
+        "vmovss  %%xmm1, %1 \n\t"                                             \
+        "vzeroupper \n\t"                                                     \
+        :"+r"(i), "=m"(ret)                                                   \
+        :"r"(v1), "r"(v2)                                                     \
+        :"memory"                                                             \
+         XMM_CLOBBERS(, "%xmm0", "%xmm1")                                     \
+    );                                                                        \
+    return ret;                                                               \
+}
+
+#define FLOAT_DSP_AVX(suf, mov)                                               \
+    VECTOR_FMUL_AVX(suf, mov)                                                 \
+    VECTOR_FMUL_REVERSE_AVX(suf, mov)                                         \
+    VECTOR_FMUL_ADD_AVX(suf, mov)                                             \
+    VECTOR_FMUL_WINDOW_AVX(suf, mov)                                          \
+    VECTOR_CLIPF_AVX(suf, mov)                                                \
+    BUTTERFLIES_FLOAT_AVX(suf, mov)                                           \
+    SCALARPRODUCT_FLOAT_AVX(suf, mov)
+
+FLOAT_DSP_AVX(a, "vmovaps")
+FLOAT_DSP_AVX(u, "vmovups")
+
+static void vector_fmul_avx(float *dst, const float *src0, const float *src1,
+                            int len)
+{
+    if (ALIGNED_32((intptr_t)dst | (intptr_t)src0 | (intptr_t)src1))
+        vector_fmul_avx_a(dst, src0, src1, len);
+    else
+        vector_fmul_avx_u(dst, src0, src1, len);
+}
+
+static void vector_fmul_reverse_avx(float *dst, const float *src0,
+                                    const float *src1, int len)
+{
+    if (ALIGNED_32((intptr_t)dst | (intptr_t)src0 | (intptr_t)src1))
+        vector_fmul_reverse_avx_a(dst, src0, src1, len);
+    else
+        vector_fmul_reverse_avx_u(dst, src0, src1, len);
+}
+
+static void vector_fmul_add_avx(float *dst, const float *src0,
+                                const float *src1, const float *src2, int len)
+{
+    if (ALIGNED_32((intptr_t)dst | (intptr_t)src0 | (intptr_t)src1 |
+                   (intptr_t)src2))
+        vector_fmul_add_avx_a(dst, src0, src1, src2, len);
+    else
+        vector_fmul_add_avx_u(dst, src0, src1, src2, len);
+}
+
+#if HAVE_6REGS
+static void vector_fmul_window_avx(float *dst, const float *src0,
+                                   const float *src1, const float *win, int len)
+{
+    if (len & 7)
+        vector_fmul_window_sse(dst, src0, src1, win, len);
+    else if (ALIGNED_32((intptr_t)dst | (intptr_t)src0 | (intptr_t)src1 |
+                        (intptr_t)win))
+        vector_fmul_window_avx_a(dst, src0, src1, win, len);
+    else
+        vector_fmul_window_avx_u(dst, src0, src1, win, len);
+}
+#endif
+
+static void vector_clipf_avx(float *dst, const float *src, float min,
+                             float max, int len)
+{
+    if (ALIGNED_32((intptr_t)dst | (intptr_t)src))
+        vector_clipf_avx_a(dst, src, min, max, len);
+    else
+        vector_clipf_avx_u(dst, src, min, max, len);
+}
+
+static void butterflies_float_avx(float *restrict v1, float *restrict v2,
+                                  int len)
+{
+    if (len & 7)
+        butterflies_float_sse(v1, v2, len);
+    else if (ALIGNED_32((intptr_t)v1 | (intptr_t)v2))
+        butterflies_float_avx_a(v1, v2, len);
+    else
+        butterflies_float_avx_u(v1, v2, len);
+}
+
+static float scalarproduct_float_avx(const float *v1, const float *v2, int len)
+{
+    float p = 0;
+    if (len & 7) {
+        /* the last 4 are done in C, this is not a common case */
+        len -= 4;
+        p = v1[len  ] * v2[len  ] + v1[len+1] * v2[len+1] +
+            v1[len+2] * v2[len+2] + v1[len+3] * v2[len+3];
+        if (!len)
+            return p;
+    }
+    if (ALIGNED_32((intptr_t)v1 | (intptr_t)v2))
+        return p + scalarproduct_float_avx_a(v1, v2, len);
+    else
+        return p + scalarproduct_float_avx_u(v1, v2, len);
+}
+#endif /* HAVE_AVX */
+
 void ff_vp3_idct_mmx(int16_t *input_data);
 void ff_vp3_idct_put_mmx(uint8_t *dest, int line_size, DCTELEM *block);
 void ff_vp3_idct_add_mmx(uint8_t *dest, int line_size, DCTELEM *block);
@@ -2365,7 +2759,12 @@ void dsputil_init_mmx(DSPContext* c, AVCodecContext *avctx)
         const int idct_algo= avctx->idct_algo;
 
         if(avctx->lowres==0){
-            if(idct_algo==FF_IDCT_AUTO || idct_algo==FF_IDCT_SIMPLEMMX){
+            if(idct_algo==FF_IDCT_AUTO && (mm_flags & AV_CPU_FLAG_SSE2)){
+                c->idct_put= ff_simple_idct_put_sse2;
+                c->idct_add= ff_simple_idct_add_sse2;
+                c->idct    = ff_simple_idct_sse2;
+                c->idct_permutation_type= FF_TRANSPOSE_IDCT_PERM;
+            }else if(idct_algo==FF_IDCT_AUTO || idct_algo==FF_IDCT_SIMPLEMMX){
                 c->idct_put= ff_simple_idct_put_mmx;
                 c->idct_add= ff_simple_idct_add_mmx;
                 c->idct    = ff_simple_idct_mmx;
@@ -2581,6 +2980,7 @@ void dsputil_init_mmx(DSPContext* c, AVCodecContext *avctx)
             if( mm_flags&AV_CPU_FLAG_3DNOW )
                 c->add_hfyu_median_prediction = add_hfyu_median_prediction_cmov;
 #endif
+            c->add_lag_median_prediction = add_lag_median_prediction_mmx2;
 
         } else if (mm_flags & AV_CPU_FLAG_3DNOW) {
             c->prefetch = prefetch_3dnow;
@@ -2654,6 +3054,22 @@ void dsputil_init_mmx(DSPContext* c, AVCodecContext *avctx)
             c->put_h264_qpel_pixels_tab[1][x+y*4] = put_h264_qpel8_mc##x##y##_##CPU;\
             c->avg_h264_qpel_pixels_tab[0][x+y*4] = avg_h264_qpel16_mc##x##y##_##CPU;\
             c->avg_h264_qpel_pixels_tab[1][x+y*4] = avg_h264_qpel8_mc##x##y##_##CPU;
+#define H264_QPEL_FUNCS_10_XY(x, y, DEPTH)\
+            c->put_h264_qpel_pixels_tab[0][x+y*4] = put_h264_qpel16_mc##x##y##_##DEPTH##_sse2;\
+            c->put_h264_qpel_pixels_tab[1][x+y*4] = put_h264_qpel8_mc##x##y##_##DEPTH##_sse2;\
+            c->put_h264_qpel_pixels_tab[2][x+y*4] = put_h264_qpel4_mc##x##y##_##DEPTH##_sse2;\
+            c->avg_h264_qpel_pixels_tab[0][x+y*4] = avg_h264_qpel16_mc##x##y##_##DEPTH##_sse2;\
+            c->avg_h264_qpel_pixels_tab[1][x+y*4] = avg_h264_qpel8_mc##x##y##_##DEPTH##_sse2;\
+            c->avg_h264_qpel_pixels_tab[2][x+y*4] = avg_h264_qpel4_mc##x##y##_##DEPTH##_sse2;
+#define H264_QPEL_FUNCS_10(DEPTH)\
+                                               H264_QPEL_FUNCS_10_XY(1, 0, DEPTH)\
+            H264_QPEL_FUNCS_10_XY(2, 0, DEPTH) H264_QPEL_FUNCS_10_XY(3, 0, DEPTH)\
+            H264_QPEL_FUNCS_10_XY(0, 1, DEPTH) H264_QPEL_FUNCS_10_XY(1, 1, DEPTH)\
+            H264_QPEL_FUNCS_10_XY(2, 1, DEPTH) H264_QPEL_FUNCS_10_XY(3, 1, DEPTH)\
+            H264_QPEL_FUNCS_10_XY(0, 2, DEPTH) H264_QPEL_FUNCS_10_XY(1, 2, DEPTH)\
+            H264_QPEL_FUNCS_10_XY(2, 2, DEPTH) H264_QPEL_FUNCS_10_XY(3, 2, DEPTH)\
+            H264_QPEL_FUNCS_10_XY(0, 3, DEPTH) H264_QPEL_FUNCS_10_XY(1, 3, DEPTH)\
+            H264_QPEL_FUNCS_10_XY(2, 3, DEPTH) H264_QPEL_FUNCS_10_XY(3, 3, DEPTH)
         if((mm_flags & AV_CPU_FLAG_SSE2) && !(mm_flags & AV_CPU_FLAG_3DNOW)){
             // these functions are slower than mmx on AMD, but faster on Intel
             if (!high_bit_depth) {
@@ -2678,6 +3094,15 @@ void dsputil_init_mmx(DSPContext* c, AVCodecContext *avctx)
             H264_QPEL_FUNCS(3, 2, sse2);
             H264_QPEL_FUNCS(3, 3, sse2);
             }
+            if (bit_depth == 9) {
+                H264_QPEL_FUNCS_10(9);
+            } else if (bit_depth == 10) {
+                H264_QPEL_FUNCS_10(10);
+            }
+            if (bit_depth == 9 || bit_depth == 10) {
+                c->avg_h264_qpel_pixels_tab[0][0] = avg_h264_qpel16_mc00_10_sse2;
+                c->avg_h264_qpel_pixels_tab[1][0] = avg_h264_qpel8_mc00_10_sse2;
+            }
 #if HAVE_YASM
             if (bit_depth == 10) {
                 c->put_h264_chroma_pixels_tab[0]= ff_put_h264_chroma_mc8_10_sse2;
@@ -2746,6 +3171,7 @@ void dsputil_init_mmx(DSPContext* c, AVCodecContext *avctx)
             c->vector_fmul_window = vector_fmul_window_sse;
 #endif
             c->vector_clipf = vector_clipf_sse;
+            c->butterflies_float = butterflies_float_sse;
 #if HAVE_YASM
             c->scalarproduct_float = ff_scalarproduct_float_sse;
 #endif
@@ -2781,6 +3207,19 @@ void dsputil_init_mmx(DSPContext* c, AVCodecContext *avctx)
             }
 #endif
         }
+#if HAVE_AVX
+        if (mm_flags & AV_CPU_FLAG_AVX) {
+            c->vector_fmul = vector_fmul_avx;
+            c->vector_fmul_reverse = vector_fmul_reverse_avx;
+            c->vector_fmul_add = vector_fmul_add_avx;
+#if HAVE_6REGS
+            c->vector_fmul_window = vector_fmul_window_avx;
+#endif
+            c->vector_clipf = vector_clipf_avx;
+            c->butterflies_float = butterflies_float_avx;
+            c->scalarproduct_float = scalarproduct_float_avx;
+        }
+#endif
 #if HAVE_AVX && HAVE_YASM
         if (mm_flags & AV_CPU_FLAG_AVX) {
             if (bit_depth == 10) {
@@ -209,10 +209,22 @@ void ff_deinterlace_line_mmx(uint8_t *dst,
                              const uint8_t *lum,
                              int size);
 
-void ff_deinterlace_line_inplace_mmx(const uint8_t *lum_m4,
+void ff_deinterlace_line_sse2(uint8_t *dst,
+                              const uint8_t *lum_m4, const uint8_t *lum_m3,
+                              const uint8_t *lum_m2, const uint8_t *lum_m1,
+                              const uint8_t *lum,
+                              int size);
+
+void ff_deinterlace_line_inplace_mmx(uint8_t *lum_m4,
                                      const uint8_t *lum_m3,
-                                     const uint8_t *lum_m2,
+                                     uint8_t *lum_m2,
                                      const uint8_t *lum_m1,
                                      const uint8_t *lum, int size);
 
+void ff_deinterlace_line_inplace_sse2(uint8_t *lum_m4,
+                                      const uint8_t *lum_m3,
+                                      uint8_t *lum_m2,
+                                      const uint8_t *lum_m1,
+                                      const uint8_t *lum, int size);
+
 #endif /* AVCODEC_X86_DSPUTIL_MMX_H */
@@ -0,0 +1,177 @@
+/*
+ * DSP utils: 8x8 hadamard SATD, compiled for SSSE3, SSE4.1 and AVX2
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * The 8 rows of differences are transformed in xmm0-xmm7, transposed and
+ * transformed again, xmm8-xmm15 are temporaries. The last butterfly stage
+ * uses |a+b| + |a-b| = 2*max(|a|,|b|), and the coefficients are summed in
+ * 32 bits, so unlike the yasm versions the result is always identical to
+ * hadamard8_diff8x8_c().
+ *
+ * The 256-bit version transforms two horizontally adjacent 8x8 blocks, one
+ * per 128-bit lane, as all the unpacks used by the transpose stay in their
+ * lane.
+ */
+
+#undef R
+#undef OP
+#undef MOV
+#undef ABS
+#undef LOAD_DIFF
+#undef END_SATD
+
+#if COMPILE_TEMPLATE_AVX2
+#define R(n) "%%ymm"#n
+#define OP(op, src, dst) "v"op" "src", "dst", "dst" \n\t"
+#define MOV(src, dst) "vmovdqa "src", "dst" \n\t"
+#define ABS(r) "vpabsw "R(r)", "R(r)" \n\t"
+#define LOAD_DIFF(n, a, b)                                             \
+    "vpmovzxbw     "a", "R(n)"                                  \n\t" \
+    "vpmovzxbw     "b", %%ymm8                                  \n\t" \
+    "vpsubw        %%ymm8, "R(n)", "R(n)"                       \n\t"
+#define END_SATD                                                       \
+    "vextracti128  $1, %%ymm0, %%xmm1                           \n\t" \
+    "vpaddd        %%xmm1, %%xmm0, %%xmm0                       \n\t" \
+    "vzeroupper                                                 \n\t"
+#else
+#define R(n) "%%xmm"#n
+#define OP(op, src, dst) op" "src", "dst" \n\t"
+#define MOV(src, dst) "movdqa "src", "dst" \n\t"
+#define ABS(r) "pabsw "R(r)", "R(r)" \n\t"
+#if COMPILE_TEMPLATE_SSE4
+#define LOAD_DIFF(n, a, b)                                             \
+    "pmovzxbw      "a", "R(n)"                                  \n\t" \
+    "pmovzxbw      "b", %%xmm8                                  \n\t" \
+    "psubw         %%xmm8, "R(n)"                               \n\t"
+#else
+/* (a<<8|a) - (a<<8|b) = a - b */
+#define LOAD_DIFF(n, a, b)                                             \
+    "movq          "a", "R(n)"                                  \n\t" \
+    "movq          "b", %%xmm8                                  \n\t" \
+    "punpcklbw     "R(n)", %%xmm8                               \n\t" \
+    "punpcklbw     "R(n)", "R(n)"                               \n\t" \
+    "psubw         %%xmm8, "R(n)"                               \n\t"
+#endif
+#define END_SATD
+#endif
+
+/* a = a + b, b = b - a; negating the difference of a butterfly negates
+ * all the coefficients depending on it, which does not change their sum
+ * of absolute values */
+#define SUMSUB(a, b)                                                   \
+    OP("paddw", R(b), R(a))                                            \
+    OP("paddw", R(b), R(b))                                            \
+    OP("psubw", R(a), R(b))
+
+#define HADAMARD8_V                                                    \
+    SUMSUB(0, 1) SUMSUB(2, 3) SUMSUB(4, 5) SUMSUB(6, 7)                \
+    SUMSUB(0, 2) SUMSUB(1, 3) SUMSUB(4, 6) SUMSUB(5, 7)                \
+    SUMSUB(0, 4) SUMSUB(1, 5) SUMSUB(2, 6) SUMSUB(3, 7)
+
+/* leaves column 0-7 in registers 0, 2, 1, 6, 4, 8, 3, 5 */
+#define TRANSPOSE8x8W                                                  \
+    MOV(R(0), R(8))  OP("punpcklwd", R(1), R(0))  OP("punpckhwd", R(1), R(8))   \
+    MOV(R(2), R(9))  OP("punpcklwd", R(3), R(2))  OP("punpckhwd", R(3), R(9))   \
+    MOV(R(4), R(10)) OP("punpcklwd", R(5), R(4))  OP("punpckhwd", R(5), R(10))  \
+    MOV(R(6), R(11)) OP("punpcklwd", R(7), R(6))  OP("punpckhwd", R(7), R(11))  \
+    MOV(R(0), R(1))  OP("punpckldq", R(2), R(0))  OP("punpckhdq", R(2), R(1))   \
+    MOV(R(8), R(3))  OP("punpckldq", R(9), R(8))  OP("punpckhdq", R(9), R(3))   \
+    MOV(R(4), R(5))  OP("punpckldq", R(6), R(4))  OP("punpckhdq", R(6), R(5))   \
+    MOV(R(10), R(7)) OP("punpckldq", R(11), R(10)) OP("punpckhdq", R(11), R(7)) \
+    MOV(R(0), R(2))  OP("punpcklqdq", R(4), R(0))  OP("punpckhqdq", R(4), R(2)) \
+    MOV(R(1), R(6))  OP("punpcklqdq", R(5), R(1))  OP("punpckhqdq", R(5), R(6)) \
+    MOV(R(8), R(4))  OP("punpcklqdq", R(10), R(4)) OP("punpckhqdq", R(10), R(8))\
+    MOV(R(3), R(5))  OP("punpcklqdq", R(7), R(3))  OP("punpckhqdq", R(7), R(5))
+
+/* the coefficients are at most 8*8*255, the sum of the 4 maxima fits in
+ * a signed word */
+#define HADAMARD8_H_ABS_SUM                                            \
+    SUMSUB(0, 2) SUMSUB(1, 6) SUMSUB(4, 8) SUMSUB(3, 5)                \
+    SUMSUB(0, 1) SUMSUB(2, 6) SUMSUB(4, 3) SUMSUB(8, 5)                \
+    ABS(0) ABS(4) ABS(2) ABS(8) ABS(1) ABS(3) ABS(6) ABS(5)            \
+    OP("pmaxsw", R(4), R(0)) OP("pmaxsw", R(8), R(2))                  \
+    OP("pmaxsw", R(3), R(1)) OP("pmaxsw", R(5), R(6))                  \
+    OP("paddw", R(2), R(0)) OP("paddw", R(6), R(1))                    \
+    OP("paddw", R(1), R(0))                                            \
+    OP("pcmpeqw", R(9), R(9))                                          \
+    OP("psrlw", "$15", R(9))                                           \
+    OP("pmaddwd", R(9), R(0))
+
+/* 8x8 block (16x8 for AVX2) at src1 and src2 */
+static av_always_inline int DEF(hadamard8_satd)(uint8_t *src1, uint8_t *src2, int stride)
+{
+    x86_reg stride3 = 3*stride;
+    uint8_t *src1b = src1 + 4*stride, *src2b = src2 + 4*stride;
+    int sum;
+
+    __asm__ volatile(
+        LOAD_DIFF(0, "(%1)",       "(%2)")
+        LOAD_DIFF(1, "(%1, %5)",   "(%2, %5)")
+        LOAD_DIFF(2, "(%1, %5, 2)", "(%2, %5, 2)")
+        LOAD_DIFF(3, "(%1, %6)",   "(%2, %6)")
+        LOAD_DIFF(4, "(%3)",       "(%4)")
+        LOAD_DIFF(5, "(%3, %5)",   "(%4, %5)")
+        LOAD_DIFF(6, "(%3, %5, 2)", "(%4, %5, 2)")
+        LOAD_DIFF(7, "(%3, %6)",   "(%4, %6)")
+        HADAMARD8_V
+        TRANSPOSE8x8W
+        HADAMARD8_H_ABS_SUM
+        END_SATD
+        "pshufd        $0x4E, %%xmm0, %%xmm1                    \n\t"
+        "paddd         %%xmm1, %%xmm0                           \n\t"
+        "pshufd        $0xE1, %%xmm0, %%xmm1                    \n\t"
+        "paddd         %%xmm1, %%xmm0                           \n\t"
+        "movd          %%xmm0, %0                               \n\t"
+        : "=r"(sum)
+        : "r"(src1), "r"(src2), "r"(src1b), "r"(src2b),
+          "r"((x86_reg)stride), "r"(stride3)
+        XMM_CLOBBERS_ONLY("%xmm0", "%xmm1", "%xmm2",  "%xmm3",
+                          "%xmm4", "%xmm5", "%xmm6",  "%xmm7",
+                          "%xmm8", "%xmm9", "%xmm10", "%xmm11")
+    );
+    return 2*sum;
+}
+
+#if !COMPILE_TEMPLATE_AVX2
+static int DEF(hadamard8_diff)(void *s, uint8_t *src1, uint8_t *src2, int stride, int h)
+{
+    assert(h==8);
+    return DEF(hadamard8_satd)(src1, src2, stride);
+}
+#endif
+
+static int DEF(hadamard8_diff16)(void *s, uint8_t *src1, uint8_t *src2, int stride, int h)
+{
+#if COMPILE_TEMPLATE_AVX2
+    int sum = DEF(hadamard8_satd)(src1, src2, stride);
+    if (h == 16)
+        sum += DEF(hadamard8_satd)(src1 + 8*stride, src2 + 8*stride, stride);
+#else
+    int sum = DEF(hadamard8_satd)(src1,     src2,     stride)
+            + DEF(hadamard8_satd)(src1 + 8, src2 + 8, stride);
+    if (h == 16) {
+        src1 += 8*stride;
+        src2 += 8*stride;
+        sum += DEF(hadamard8_satd)(src1,     src2,     stride)
+             + DEF(hadamard8_satd)(src1 + 8, src2 + 8, stride);
+    }
+#endif
+    return sum;
+}
@@ -879,6 +879,211 @@ static void sub_hfyu_median_prediction_mmx2(uint8_t *dst, const uint8_t *src1, c
     *left    = src2[w-1];
 }
 
+static void diff_bytes_sse2(uint8_t *dst, uint8_t *src1, uint8_t *src2, int w){
+    x86_reg i=0;
+    if(w >= 32)
+    __asm__ volatile(
+        "1:                             \n\t"
+        "movdqu  (%2, %0), %%xmm0       \n\t"
+        "movdqu  (%1, %0), %%xmm1       \n\t"
+        "movdqu 16(%2, %0), %%xmm2      \n\t"
+        "movdqu 16(%1, %0), %%xmm3      \n\t"
+        "psubb %%xmm0, %%xmm1           \n\t"
+        "psubb %%xmm2, %%xmm3           \n\t"
+        "movdqu %%xmm1,   (%3, %0)      \n\t"
+        "movdqu %%xmm3, 16(%3, %0)      \n\t"
+        "add $32, %0                    \n\t"
+        "cmp %4, %0                     \n\t"
+        " jb 1b                         \n\t"
+        : "+r" (i)
+        : "r"(src1), "r"(src2), "r"(dst), "r"((x86_reg)w-31)
+        XMM_CLOBBERS_ONLY("%xmm0", "%xmm1", "%xmm2", "%xmm3")
+    );
+    for(; i<w; i++)
+        dst[i+0] = src1[i+0]-src2[i+0];
+}
+
+static void sub_hfyu_median_prediction_sse2(uint8_t *dst, const uint8_t *src1, const uint8_t *src2, int w, int *left, int *left_top){
+    x86_reg i=0;
+    uint8_t l, lt;
+
+    /* unlike the MMX2 version, this does not write past the end of dst */
+    if(w >= 16)
+    __asm__ volatile(
+        "1:                             \n\t"
+        "movdqu -1(%1, %0), %%xmm0      \n\t" // LT
+        "movdqu  (%1, %0), %%xmm1       \n\t" // T
+        "movdqu -1(%2, %0), %%xmm2      \n\t" // L
+        "movdqu  (%2, %0), %%xmm3       \n\t" // X
+        "movdqa %%xmm2, %%xmm4          \n\t" // L
+        "psubb %%xmm0, %%xmm2           \n\t"
+        "paddb %%xmm1, %%xmm2           \n\t" // L + T - LT
+        "movdqa %%xmm4, %%xmm5          \n\t" // L
+        "pmaxub %%xmm1, %%xmm4          \n\t" // max(T, L)
+        "pminub %%xmm5, %%xmm1          \n\t" // min(T, L)
+        "pminub %%xmm2, %%xmm4          \n\t"
+        "pmaxub %%xmm1, %%xmm4          \n\t"
+        "psubb %%xmm4, %%xmm3           \n\t" // dst - pred
+        "movdqu %%xmm3, (%3, %0)        \n\t"
+        "add $16, %0                    \n\t"
+        "cmp %4, %0                     \n\t"
+        " jb 1b                         \n\t"
+        : "+r" (i)
+        : "r"(src1), "r"(src2), "r"(dst), "r"((x86_reg)w-15)
+        XMM_CLOBBERS_ONLY("%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4", "%xmm5")
+    );
+    for(i=FFMAX(i, 1); i<w; i++)
+        dst[i]= src2[i] - mid_pred(src2[i-1], src1[i], (src2[i-1] + src1[i] - src1[i-1])&0xFF);
+
+    l= *left;
+    lt= *left_top;
+
+    dst[0]= src2[0] - mid_pred(l, src1[0], (l + src1[0] - lt)&0xFF);
+
+    *left_top= src1[w-1];
+    *left    = src2[w-1];
+}
+
+#define ABS_SSE2(a)\
+        "pxor %%xmm6, %%xmm6            \n\t"\
+        "psubw " #a ", %%xmm6           \n\t"\
+        "pmaxsw %%xmm6, " #a "          \n\t"
+
+static void sub_png_paeth_prediction_sse2(uint8_t *dst, uint8_t *src, uint8_t *top, int w, int bpp){
+    x86_reg i=0, j=-bpp;
+
+    if(w >= 8)
+    __asm__ volatile(
+        "pxor %%xmm7, %%xmm7            \n\t"
+        "1:                             \n\t"
+        "movq  (%3, %1), %%xmm0         \n\t" // a
+        "movq  (%4, %0), %%xmm1         \n\t" // b
+        "movq  (%4, %1), %%xmm2         \n\t" // c
+        "punpcklbw %%xmm7, %%xmm0       \n\t"
+        "punpcklbw %%xmm7, %%xmm1       \n\t"
+        "punpcklbw %%xmm7, %%xmm2       \n\t"
+        "movdqa %%xmm1, %%xmm3          \n\t"
+        "movdqa %%xmm0, %%xmm4          \n\t"
+        "psubw %%xmm2, %%xmm3           \n\t" // b - c
+        "psubw %%xmm2, %%xmm4           \n\t" // a - c
+        "movdqa %%xmm3, %%xmm5          \n\t"
+        "paddw %%xmm4, %%xmm5           \n\t" // a + b - 2c
+        ABS_SSE2(%%xmm3)                        // pa
+        ABS_SSE2(%%xmm4)                        // pb
+        ABS_SSE2(%%xmm5)                        // pc
+        "movdqa %%xmm4, %%xmm6          \n\t"
+        "pcmpgtw %%xmm5, %%xmm6         \n\t" // pb > pc
+        "pand %%xmm6, %%xmm2            \n\t"
+        "pandn %%xmm1, %%xmm6           \n\t"
+        "por %%xmm6, %%xmm2             \n\t" // pb <= pc ? b : c
+        "movdqa %%xmm3, %%xmm6          \n\t"
+        "pcmpgtw %%xmm4, %%xmm3         \n\t" // pa > pb
+        "pcmpgtw %%xmm5, %%xmm6         \n\t" // pa > pc
+        "por %%xmm6, %%xmm3             \n\t"
+        "pand %%xmm3, %%xmm2            \n\t"
+        "pandn %%xmm0, %%xmm3           \n\t"
+        "por %%xmm3, %%xmm2             \n\t" // pred
+        "packuswb %%xmm2, %%xmm2        \n\t"
+        "movq  (%3, %0), %%xmm0         \n\t"
+        "psubb %%xmm2, %%xmm0           \n\t" // src - pred
+        "movq %%xmm0, (%2, %0)          \n\t"
+        "add $8, %0                     \n\t"
+        "add $8, %1                     \n\t"
+        "cmp %5, %0                     \n\t"
+        " jb 1b                         \n\t"
+        : "+r" (i), "+r" (j)
+        : "r"(dst), "r"(src), "r"(top), "g"((x86_reg)w-7)
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                       "%xmm4", "%xmm5", "%xmm6", "%xmm7",) "memory"
+    );
+    for(; i<w; i++){
+        int a = src[i-bpp], b = top[i], c = top[i-bpp], p, pa, pb, pc;
+
+        pa = FFABS(b - c);
+        pb = FFABS(a - c);
+        pc = FFABS(a + b - 2*c);
+        if (pa <= pb && pa <= pc)
+            p = a;
+        else if (pb <= pc)
+            p = b;
+        else
+            p = c;
+        dst[i] = src[i] - p;
+    }
+}
+
+static const DECLARE_ALIGNED(16, uint32_t, abs_mask)[4] = {
+    0x7fffffff, 0x7fffffff, 0x7fffffff, 0x7fffffff
+};
+
+static void aac_abs_pow34_sse(float *out, const float *in, int size)
+{
+    x86_reg i = -4*size;
+
+    __asm__ volatile(
+        "movaps %3, %%xmm7              \n\t"
+        "1:                             \n\t"
+        "movups (%2, %0), %%xmm0        \n\t"
+        "andps %%xmm7, %%xmm0           \n\t"
+        "sqrtps %%xmm0, %%xmm1          \n\t"
+        "mulps %%xmm1, %%xmm0           \n\t"
+        "sqrtps %%xmm0, %%xmm0          \n\t"
+        "movups %%xmm0, (%1, %0)        \n\t"
+        "add $16, %0                    \n\t"
+        " jl 1b                         \n\t"
+        : "+r" (i)
+        : "r"(out + size), "r"(in + size), "m"(*abs_mask)
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm7",) "memory"
+    );
+}
+
+static void aac_quantize_bands_sse2(int *out, const float *in, const float *scaled,
+                                    int size, float Q34, int is_signed, int maxval)
+{
+    /* nothing is below -inf, so unsigned bands never get a sign mask */
+    const float  sign_limit = is_signed ? 0.0f : -INFINITY;
+    const double rounding   = 0.4054, maxval_d = maxval;
+    x86_reg i = -4*size;
+
+    /* The products are rounded to float and then rounded up in double
+     * precision, like the C version does. */
+    __asm__ volatile(
+        "movss %4, %%xmm7               \n\t"
+        "shufps $0, %%xmm7, %%xmm7      \n\t" // Q34
+        "movsd %5, %%xmm6               \n\t"
+        "unpcklpd %%xmm6, %%xmm6        \n\t" // 0.4054
+        "movsd %6, %%xmm5               \n\t"
+        "unpcklpd %%xmm5, %%xmm5        \n\t" // maxval
+        "movss %7, %%xmm4               \n\t"
+        "shufps $0, %%xmm4, %%xmm4      \n\t"
+        "1:                             \n\t"
+        "movups (%3, %0), %%xmm0        \n\t"
+        "movups (%2, %0), %%xmm2        \n\t"
+        "mulps %%xmm7, %%xmm0           \n\t"
+        "cmpltps %%xmm4, %%xmm2         \n\t" // sign mask
+        "movhlps %%xmm0, %%xmm1         \n\t"
+        "cvtps2pd %%xmm0, %%xmm0        \n\t"
+        "cvtps2pd %%xmm1, %%xmm1        \n\t"
+        "addpd %%xmm6, %%xmm0           \n\t"
+        "addpd %%xmm6, %%xmm1           \n\t"
+        "minpd %%xmm5, %%xmm0           \n\t"
+        "minpd %%xmm5, %%xmm1           \n\t"
+        "cvttpd2dq %%xmm0, %%xmm0       \n\t"
+        "cvttpd2dq %%xmm1, %%xmm1       \n\t"
+        "punpcklqdq %%xmm1, %%xmm0      \n\t"
+        "pxor %%xmm2, %%xmm0            \n\t"
+        "psubd %%xmm2, %%xmm0           \n\t"
+        "movdqu %%xmm0, (%1, %0)        \n\t"
+        "add $16, %0                    \n\t"
+        " jl 1b                         \n\t"
+        : "+r" (i)
+        : "r"(out + size), "r"(in + size), "r"(scaled + size),
+          "m"(Q34), "m"(rounding), "m"(maxval_d), "m"(sign_limit)
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm4",
+                       "%xmm5", "%xmm6", "%xmm7",) "memory"
+    );
+}
+
 #define MMABS_MMX(a,z)\
     "pxor " #z ", " #z "              \n\t"\
     "pcmpgtw " #a ", " #z "           \n\t"\
@@ -1094,6 +1299,37 @@ static int ssd_int8_vs_int16_mmx(const int8_t *pix1, const int16_t *pix2, int si
 #undef PHADDD
 #endif //HAVE_SSSE3
 
+/* the SATD templates need xmm8-xmm15 */
+#if ARCH_X86_64 && HAVE_SSSE3
+#define DEF(x) x ## _satd_ssse3
+#define COMPILE_TEMPLATE_SSE4 0
+#define COMPILE_TEMPLATE_AVX2 0
+#include "dsputilenc_hadamard_template.c"
+#undef DEF
+#undef COMPILE_TEMPLATE_SSE4
+#undef COMPILE_TEMPLATE_AVX2
+#endif
+
+#if ARCH_X86_64 && HAVE_SSE4
+#define DEF(x) x ## _satd_sse4
+#define COMPILE_TEMPLATE_SSE4 1
+#define COMPILE_TEMPLATE_AVX2 0
+#include "dsputilenc_hadamard_template.c"
+#undef DEF
+#undef COMPILE_TEMPLATE_SSE4
+#undef COMPILE_TEMPLATE_AVX2
+#endif
+
+#if ARCH_X86_64 && HAVE_AVX2
+#define DEF(x) x ## _satd_avx2
+#define COMPILE_TEMPLATE_SSE4 0
+#define COMPILE_TEMPLATE_AVX2 1
+#include "dsputilenc_hadamard_template.c"
+#undef DEF
+#undef COMPILE_TEMPLATE_SSE4
+#undef COMPILE_TEMPLATE_AVX2
+#endif
+
 
 void dsputilenc_init_mmx(DSPContext* c, AVCodecContext *avctx)
 {
@@ -1157,8 +1393,16 @@ void dsputilenc_init_mmx(DSPContext* c, AVCodecContext *avctx)
             c->sub_hfyu_median_prediction= sub_hfyu_median_prediction_mmx2;
         }
 
+        if(mm_flags & AV_CPU_FLAG_SSE){
+            c->aac_abs_pow34 = aac_abs_pow34_sse;
+        }
+
         if(mm_flags & AV_CPU_FLAG_SSE2){
             c->get_pixels = get_pixels_sse2;
+            c->diff_bytes = diff_bytes_sse2;
+            c->sub_hfyu_median_prediction = sub_hfyu_median_prediction_sse2;
+            c->sub_png_paeth_prediction = sub_png_paeth_prediction_sse2;
+            c->aac_quantize_bands = aac_quantize_bands_sse2;
             c->sum_abs_dctelem= sum_abs_dctelem_sse2;
 #if HAVE_YASM && HAVE_ALIGNED_STACK
             c->hadamard8_diff[0]= ff_hadamard8_diff16_sse2;
@@ -1177,6 +1421,23 @@ void dsputilenc_init_mmx(DSPContext* c, AVCodecContext *avctx)
             c->hadamard8_diff[0]= ff_hadamard8_diff16_ssse3;
             c->hadamard8_diff[1]= ff_hadamard8_diff_ssse3;
 #endif
+#if ARCH_X86_64
+            c->hadamard8_diff[0]= hadamard8_diff16_satd_ssse3;
+            c->hadamard8_diff[1]= hadamard8_diff_satd_ssse3;
+#endif
+        }
+#endif
+
+#if ARCH_X86_64 && HAVE_SSE4
+        if(mm_flags & AV_CPU_FLAG_SSE4){
+            c->hadamard8_diff[0]= hadamard8_diff16_satd_sse4;
+            c->hadamard8_diff[1]= hadamard8_diff_satd_sse4;
+        }
+#endif
+
+#if ARCH_X86_64 && HAVE_AVX2
+        if(mm_flags & AV_CPU_FLAG_AVX2){
+            c->hadamard8_diff[0]= hadamard8_diff16_satd_avx2;
         }
 #endif
 
@@ -0,0 +1,177 @@
+/*
+ * SSE2 optimized fixed-point FFT
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define CONFIG_FFT_FLOAT 0
+#include "libavutil/cpu.h"
+#include "libavutil/mem.h"
+#include "libavutil/x86_cpu.h"
+#include "libavcodec/fft.h"
+
+/*
+ * These give the same results as the C versions: the products and sums are
+ * done on 32-bit lanes, with the same roundings, and the results are
+ * truncated to 16 bits only where the C code stores them.
+ * Registers hold 4 complex values, one per 32-bit lane, as stored in memory
+ * (re in the low 16 bits, im in the high ones) or as separate re and im
+ * vectors sign-extended to 32 bits.
+ */
+
+DECLARE_ALIGNED(16, static const int16_t, sign_im)[8] = { 1, -1, 1, -1, 1, -1, 1, -1 };
+DECLARE_ALIGNED(16, static const int32_t, mask_lane0)[4] = { -1, 0, 0, 0 };
+
+/* split the complex values in re into re and im */
+#define SPLIT(re, im)                   \
+    "movdqa  "re", "im"         \n\t"   \
+    "pslld     $16, "re"        \n\t"   \
+    "psrad     $16, "re"        \n\t"   \
+    "psrad     $16, "im"        \n\t"
+
+/* truncate re and im to 16 bits and merge them into complex values in re */
+#define MERGE(re, im)                   \
+    "pslld     $16, "im"        \n\t"   \
+    "pslld     $16, "re"        \n\t"   \
+    "psrld     $16, "re"        \n\t"   \
+    "por     "im", "re"         \n\t"
+
+/* BF(d, s, b): d = (s - b) >> 1, s = (s + b) >> 1 */
+#define BF(d, s, b)                     \
+    "movdqa  "s", "d"           \n\t"   \
+    "psubd   "b", "d"           \n\t"   \
+    "paddd   "b", "s"           \n\t"   \
+    "psrad      $1, "d"         \n\t"   \
+    "psrad      $1, "s"         \n\t"
+
+/*
+ * t1..t6 of TRANSFORM() for z[o2] and z[o3] with the twiddles at wre[0..3]
+ * and wim[0..-3], into xmm4 (t1), xmm5 (t2), xmm6 (t5), xmm7 (t6).
+ */
+#define TWIDDLE                                 \
+    "movq         (%3), %%xmm0          \n\t"   \
+    "movq         (%4), %%xmm1          \n\t"   \
+    "pshuflw $0x1b, %%xmm1, %%xmm1      \n\t"   \
+    "punpcklwd  %%xmm1, %%xmm0          \n\t"   /* wre,  wim */ \
+    "pshuflw $0xb1, %%xmm0, %%xmm1      \n\t"   \
+    "pshufhw $0xb1, %%xmm1, %%xmm1      \n\t"   /* wim,  wre */ \
+    "movdqa     %%xmm0, %%xmm2          \n\t"   \
+    "pmullw         %5, %%xmm2          \n\t"   /* wre, -wim */ \
+    "pshuflw $0xb1, %%xmm2, %%xmm3      \n\t"   \
+    "pshufhw $0xb1, %%xmm3, %%xmm3      \n\t"   /* -wim, wre */ \
+    "movdqu  (%0,%1,2), %%xmm4          \n\t"   \
+    "movdqa     %%xmm4, %%xmm5          \n\t"   \
+    "pmaddwd    %%xmm0, %%xmm4          \n\t"   \
+    "pmaddwd    %%xmm3, %%xmm5          \n\t"   \
+    "movdqu       (%2), %%xmm6          \n\t"   \
+    "movdqa     %%xmm6, %%xmm7          \n\t"   \
+    "pmaddwd    %%xmm2, %%xmm6          \n\t"   \
+    "pmaddwd    %%xmm1, %%xmm7          \n\t"   \
+    "psrad         $15, %%xmm4          \n\t"   \
+    "psrad         $15, %%xmm5          \n\t"   \
+    "psrad         $15, %%xmm6          \n\t"   \
+    "psrad         $15, %%xmm7          \n\t"
+
+/* replace lane 0 of t1, t2 by z[o2] and of t5, t6 by z[o3], as in
+ * TRANSFORM_ZERO() */
+#define TWIDDLE_ZERO_LANE0(t_re, t_im, src)     \
+    "movdqu       "src", %%xmm0         \n\t"   \
+    SPLIT("%%xmm0", "%%xmm1")                   \
+    "pxor     "t_re", %%xmm0            \n\t"   \
+    "pxor     "t_im", %%xmm1            \n\t"   \
+    "pand           %6, %%xmm0          \n\t"   \
+    "pand           %6, %%xmm1          \n\t"   \
+    "pxor     %%xmm0, "t_re"            \n\t"   \
+    "pxor     %%xmm1, "t_im"            \n\t"
+
+/* BUTTERFLIES() of the 4 values, t1..t6 being in xmm4..xmm7 */
+#define BUTTERFLIES                             \
+    BF("%%xmm0", "%%xmm6", "%%xmm4")            /* t3, t5 */ \
+    BF("%%xmm1", "%%xmm5", "%%xmm7")            /* t4, t6 */ \
+    "movdqu       (%0), %%xmm2          \n\t"   \
+    SPLIT("%%xmm2", "%%xmm3")                   /* r0, i0 */ \
+    BF("%%xmm4", "%%xmm2", "%%xmm6")            /* a2.re, a0.re */ \
+    BF("%%xmm7", "%%xmm3", "%%xmm5")            /* a2.im, a0.im */ \
+    MERGE("%%xmm2", "%%xmm3")                   \
+    MERGE("%%xmm4", "%%xmm7")                   \
+    "movdqu     %%xmm2, (%0)            \n\t"   \
+    "movdqu     %%xmm4, (%0,%1,2)       \n\t"   \
+    "movdqu    (%0,%1), %%xmm2          \n\t"   \
+    SPLIT("%%xmm2", "%%xmm3")                   /* r1, i1 */ \
+    BF("%%xmm5", "%%xmm2", "%%xmm1")            /* a3.re, a1.re */ \
+    BF("%%xmm4", "%%xmm3", "%%xmm0")            /* a3.im, a1.im */ \
+    MERGE("%%xmm2", "%%xmm3")                   \
+    MERGE("%%xmm5", "%%xmm4")                   \
+    "movdqu     %%xmm2, (%0,%1)         \n\t"   \
+    "movdqu     %%xmm5, (%2)            \n\t"
+
+#define PASS_ASM(z, o1, wre, wim, code)                                 \
+    __asm__ volatile(                                                   \
+        code                                                            \
+        :: "r"(z), "r"((x86_reg)(o1) * sizeof(FFTComplex)),             \
+           "r"((z) + 3 * (o1)), "r"(wre), "r"((wim) - 3),               \
+           "m"(*sign_im), "m"(*mask_lane0)                              \
+        : "memory"                                                      \
+          XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm3",            \
+                         "%xmm4", "%xmm5", "%xmm6", "%xmm7")            \
+    )
+
+/**
+ * Same as pass() in fft.c, 4 values of each quarter at once.
+ * z[0...8n-1], w[1...2n-1], n must be even.
+ */
+static void pass_sse2(FFTComplex *z, const FFTSample *wre, unsigned int n)
+{
+    int o1 = 2 * n;
+    const FFTSample *wim = wre + o1;
+    unsigned int i;
+
+    PASS_ASM(z, o1, wre, wim,
+             TWIDDLE
+             TWIDDLE_ZERO_LANE0("%%xmm4", "%%xmm5", "(%0,%1,2)")
+             TWIDDLE_ZERO_LANE0("%%xmm6", "%%xmm7", "(%2)")
+             BUTTERFLIES);
+    for (i = 4; i < o1; i += 4)
+        PASS_ASM(z + i, o1, wre + i, wim - i, TWIDDLE BUTTERFLIES);
+}
+
+static void fft_fixed_sse2(FFTComplex *z, int nbits)
+{
+    int n = 1 << nbits;
+
+    if (nbits <= 4) {
+        ff_fft_fixed_small[nbits - 2](z);
+        return;
+    }
+    fft_fixed_sse2(z,             nbits - 1);
+    fft_fixed_sse2(z + n / 2,     nbits - 2);
+    fft_fixed_sse2(z + n / 4 * 3, nbits - 2);
+    pass_sse2(z, ff_cos_tabs_fixed[nbits], n / 8);
+}
+
+static void fft_fixed_calc_sse2(FFTContext *s, FFTComplex *z)
+{
+    fft_fixed_sse2(z, s->nbits);
+}
+
+av_cold void ff_fft_fixed_init_mmx(FFTContext *s)
+{
+    int mm_flags = av_get_cpu_flags();
+
+    if (mm_flags & AV_CPU_FLAG_SSE2 && s->nbits >= 5)
+        s->fft_calc = fft_fixed_calc_sse2;
+}
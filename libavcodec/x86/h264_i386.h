@@ -36,7 +36,7 @@
 
 //FIXME use some macros to avoid duplicating get_cabac (cannot be done yet
 //as that would make optimization work hard)
-#if ARCH_X86 && HAVE_7REGS && !defined(BROKEN_RELOCATIONS) && HAVE_TEN_OPERANDS
+#if ARCH_X86 && HAVE_7REGS && HAVE_TEN_OPERANDS
 static int decode_significance_x86(CABACContext *c, int max_coeff,
                                    uint8_t *significant_coeff_ctx_base,
                                    int *index, x86_reg last_off){
@@ -53,15 +53,17 @@ static int decode_significance_x86(CABACContext *c, int max_coeff,
 
         "2:                                     \n\t"
 
-        BRANCHLESS_GET_CABAC("%4", "%6", "(%1)", "%3",
-                             "%w3", "%5", "%k0", "%b0", "%a13")
+        BRANCHLESS_GET_CABAC("%4", "%q4", "%6", "(%1)", "%3", "%w3",
+                             "%5", "%q5", "%k0", "%b0", "%a13",
+                             "%14", "%15", "%16")
 
         "test $1, %4                            \n\t"
         " jz 3f                                 \n\t"
         "add  %10, %1                           \n\t"
 
-        BRANCHLESS_GET_CABAC("%4", "%6", "(%1)", "%3",
-                             "%w3", "%5", "%k0", "%b0", "%a13")
+        BRANCHLESS_GET_CABAC("%4", "%q4", "%6", "(%1)", "%3", "%w3",
+                             "%5", "%q5", "%k0", "%b0", "%a13",
+                             "%14", "%15", "%16")
 
         "sub  %10, %1                           \n\t"
         "mov  %2, %0                            \n\t"
@@ -94,6 +96,7 @@ static int decode_significance_x86(CABACContext *c, int max_coeff,
         :"r"(c), "m"(minusstart), "m"(end), "m"(minusindex), "m"(last_off),
          "i"(offsetof(CABACContext, range)), "i"(offsetof(CABACContext, low)),
          "i"(offsetof(CABACContext, bytestream))
+         TABLES_ARG
         : "%"REG_c, "memory"
     );
     return coeff_count;
@@ -120,19 +123,25 @@ static int decode_significance_8x8_x86(CABACContext *c,
         "movzbl (%0, %6), %k6                   \n\t"
         "add %9, %6                             \n\t"
 
-        BRANCHLESS_GET_CABAC("%4", "%7", "(%6)", "%3",
-                             "%w3", "%5", "%k0", "%b0", "%a14")
+        BRANCHLESS_GET_CABAC("%4", "%q4", "%7", "(%6)", "%3", "%w3",
+                             "%5", "%q5", "%k0", "%b0", "%a14",
+                             "%15", "%16", "%17")
 
         "mov %1, %k6                            \n\t"
         "test $1, %4                            \n\t"
         " jz 3f                                 \n\t"
 
+#ifdef BROKEN_RELOCATIONS
+        "movzbl (%18, %6), %k6                  \n\t"
+#else
         "movzbl "MANGLE(last_coeff_flag_offset_8x8)"(%k6), %k6\n\t"
+#endif
         "add %9, %6                             \n\t"
         "add %11, %6                            \n\t"
 
-        BRANCHLESS_GET_CABAC("%4", "%7", "(%6)", "%3",
-                             "%w3", "%5", "%k0", "%b0", "%a14")
+        BRANCHLESS_GET_CABAC("%4", "%q4", "%7", "(%6)", "%3", "%w3",
+                             "%5", "%q5", "%k0", "%b0", "%a14",
+                             "%15", "%16", "%17")
 
         "mov %2, %0                             \n\t"
         "mov %1, %k6                            \n\t"
@@ -162,10 +171,14 @@ static int decode_significance_8x8_x86(CABACContext *c,
         :"r"(c), "m"(minusindex), "m"(significant_coeff_ctx_base), "m"(sig_off), "m"(last_off),
          "i"(offsetof(CABACContext, range)), "i"(offsetof(CABACContext, low)),
          "i"(offsetof(CABACContext, bytestream))
+         TABLES_ARG
+#ifdef BROKEN_RELOCATIONS
+         , "r"(last_coeff_flag_offset_8x8)
+#endif
         : "%"REG_c, "memory"
     );
     return coeff_count;
 }
-#endif /* ARCH_X86 && HAVE_7REGS && !defined(BROKEN_RELOCATIONS) */
+#endif /* ARCH_X86 && HAVE_7REGS && HAVE_TEN_OPERANDS */
 
 #endif /* AVCODEC_X86_H264_I386_H */
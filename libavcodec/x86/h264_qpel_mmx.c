@@ -1199,3 +1199,341 @@ H264_MC_816(H264_MC_HV, sse2)
 H264_MC_816(H264_MC_H, ssse3)
 H264_MC_816(H264_MC_HV, ssse3)
 #endif
+
+/* 9 and 10 bit qpel
+ *
+ * The samples are words and the strides are in bytes, as in the C template.
+ * The 6-tap sums do not fit in signed words, so the h and v filters compute
+ * them modulo 1<<16 and bring them into range with an offset before the
+ * unsigned shift; the hv filter runs the vertical pass first, stores the
+ * sums with a -16384 bias and does the horizontal pass in dwords. */
+
+DECLARE_ALIGNED(16, static const xmm_reg, pw_20_10bit ) = {0x0014001400140014ULL, 0x0014001400140014ULL};
+DECLARE_ALIGNED(16, static const xmm_reg, pw_m5_10bit ) = {0xFFFBFFFBFFFBFFFBULL, 0xFFFBFFFBFFFBFFFBULL};
+DECLARE_ALIGNED(16, static const xmm_reg, pw_1_10bit  ) = {0x0001000100010001ULL, 0x0001000100010001ULL};
+/* 16 + 32*320: round, and make the sums of in-range samples positive */
+DECLARE_ALIGNED(16, static const xmm_reg, pw_10256    ) = {0x2810281028102810ULL, 0x2810281028102810ULL};
+DECLARE_ALIGNED(16, static const xmm_reg, pw_320      ) = {0x0140014001400140ULL, 0x0140014001400140ULL};
+DECLARE_ALIGNED(16, static const xmm_reg, pw_16384    ) = {0x4000400040004000ULL, 0x4000400040004000ULL};
+DECLARE_ALIGNED(16, static const xmm_reg, pw_512      ) = {0x0200020002000200ULL, 0x0200020002000200ULL};
+DECLARE_ALIGNED(16, static const xmm_reg, pd_512      ) = {0x0000020000000200ULL, 0x0000020000000200ULL};
+DECLARE_ALIGNED(16, static const xmm_reg, pw_pixel_max_9 ) = {0x01FF01FF01FF01FFULL, 0x01FF01FF01FF01FFULL};
+DECLARE_ALIGNED(16, static const xmm_reg, pw_pixel_max_10) = {0x03FF03FF03FF03FFULL, 0x03FF03FF03FF03FFULL};
+
+#define PUT_OP_10(MOV)
+#define AVG_OP_10(MOV)\
+        MOV"      (%0), %%xmm1              \n\t"\
+        "pavgw  %%xmm1, %%xmm0              \n\t"
+
+/* xmm0 = 20*xmm2 - 5*xmm1 + xmm0, modulo 1<<16 */
+#define QPEL10_TAPS \
+        "pmullw     %5, %%xmm2              \n\t"\
+        "pmullw     %6, %%xmm1              \n\t"\
+        "paddw  %%xmm2, %%xmm0              \n\t"\
+        "paddw  %%xmm1, %%xmm0              \n\t"
+
+#define QPEL10_ROUND_CLIP \
+        "paddw      %7, %%xmm0              \n\t"\
+        "psrlw      $5, %%xmm0              \n\t"\
+        "psubw      %8, %%xmm0              \n\t"\
+        "pmaxsw %%xmm7, %%xmm0              \n\t"\
+        "pminsw     %9, %%xmm0              \n\t"
+
+#define QPEL10_H_LOWPASS(OPNAME, OP, W, MOV)\
+static av_noinline void OPNAME ## h264_qpel10_h_lowpass_ ## W ## _sse2(uint8_t *dst, const uint8_t *src, int dstStride, int srcStride, int h, const xmm_reg *max)\
+{\
+    __asm__ volatile(\
+        "pxor   %%xmm7, %%xmm7              \n\t"\
+        "1:                                 \n\t"\
+        MOV"    -4(%1), %%xmm0              \n\t"\
+        MOV"     6(%1), %%xmm3              \n\t"\
+        MOV"    -2(%1), %%xmm1              \n\t"\
+        MOV"     4(%1), %%xmm4              \n\t"\
+        MOV"      (%1), %%xmm2              \n\t"\
+        MOV"     2(%1), %%xmm5              \n\t"\
+        "paddw  %%xmm3, %%xmm0              \n\t"\
+        "paddw  %%xmm4, %%xmm1              \n\t"\
+        "paddw  %%xmm5, %%xmm2              \n\t"\
+        QPEL10_TAPS\
+        QPEL10_ROUND_CLIP\
+        OP(MOV)\
+        MOV"    %%xmm0, (%0)                \n\t"\
+        "add        %4, %1                  \n\t"\
+        "add        %3, %0                  \n\t"\
+        "decl       %2                      \n\t"\
+        " jnz 1b                            \n\t"\
+        : "+r"(dst), "+r"(src), "+g"(h)\
+        : "r"((x86_reg)dstStride), "r"((x86_reg)srcStride),\
+          "m"(pw_20_10bit), "m"(pw_m5_10bit), "m"(pw_10256), "m"(pw_320), "m"(*max)\
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4", "%xmm5", "%xmm7",)\
+          "memory"\
+    );\
+}
+
+/* FINISH is QPEL10_ROUND_CLIP for the lowpass filter or the -16384 bias
+ * (in %7) for the first pass of the hv filter. */
+#define QPEL10_V(NAME, OP, FINISH, W, MOV)\
+static av_noinline void NAME ## _ ## W ## _sse2(uint8_t *dst, const uint8_t *src, int dstStride, int srcStride, int h,\
+                                                const xmm_reg *round, const xmm_reg *max)\
+{\
+    src -= 2*srcStride;\
+    __asm__ volatile(\
+        "pxor   %%xmm7, %%xmm7              \n\t"\
+        "1:                                 \n\t"\
+        MOV"      (%1), %%xmm0              \n\t"\
+        MOV"   (%1,%4), %%xmm1              \n\t"\
+        MOV" (%1,%4,2), %%xmm2              \n\t"\
+        MOV" (%1,%4,4), %%xmm4              \n\t"\
+        "add        %4, %1                  \n\t"\
+        MOV" (%1,%4,2), %%xmm5              \n\t"\
+        MOV" (%1,%4,4), %%xmm3              \n\t"\
+        "paddw  %%xmm4, %%xmm1              \n\t"\
+        "paddw  %%xmm5, %%xmm2              \n\t"\
+        "paddw  %%xmm3, %%xmm0              \n\t"\
+        QPEL10_TAPS\
+        FINISH\
+        OP(MOV)\
+        MOV"    %%xmm0, (%0)                \n\t"\
+        "add        %3, %0                  \n\t"\
+        "decl       %2                      \n\t"\
+        " jnz 1b                            \n\t"\
+        : "+r"(dst), "+r"(src), "+g"(h)\
+        : "r"((x86_reg)dstStride), "r"((x86_reg)srcStride),\
+          "m"(pw_20_10bit), "m"(pw_m5_10bit), "m"(*round), "m"(pw_320), "m"(*max)\
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4", "%xmm5", "%xmm7",)\
+          "memory"\
+    );\
+}
+
+#define QPEL10_HV_BIAS "psubw %7, %%xmm0 \n\t"
+
+/* second pass of the hv filter: horizontal 6-tap over the biased vertical
+ * sums in tmp, whose rows are 16 words and start 2 pixels left of dst */
+#define QPEL10_HV2(OPNAME, OP, W, MOV)\
+static av_noinline void OPNAME ## h264_qpel10_hv2_lowpass_ ## W ## _sse2(uint8_t *dst, const int16_t *tmp, int dstStride, int h, const xmm_reg *max)\
+{\
+    __asm__ volatile(\
+        "pxor   %%xmm7, %%xmm7              \n\t"\
+        "1:                                 \n\t"\
+        MOV"      (%1), %%xmm0              \n\t"\
+        MOV"    10(%1), %%xmm1              \n\t"\
+        "movdqa %%xmm0, %%xmm2              \n\t"\
+        "punpcklwd %%xmm1, %%xmm0           \n\t"\
+        "punpckhwd %%xmm1, %%xmm2           \n\t"\
+        "pmaddwd    %4, %%xmm0              \n\t"\
+        "pmaddwd    %4, %%xmm2              \n\t"\
+        MOV"     2(%1), %%xmm1              \n\t"\
+        MOV"     8(%1), %%xmm3              \n\t"\
+        "movdqa %%xmm1, %%xmm4              \n\t"\
+        "punpcklwd %%xmm3, %%xmm1           \n\t"\
+        "punpckhwd %%xmm3, %%xmm4           \n\t"\
+        "pmaddwd    %5, %%xmm1              \n\t"\
+        "pmaddwd    %5, %%xmm4              \n\t"\
+        "paddd  %%xmm1, %%xmm0              \n\t"\
+        "paddd  %%xmm4, %%xmm2              \n\t"\
+        MOV"     4(%1), %%xmm1              \n\t"\
+        MOV"     6(%1), %%xmm3              \n\t"\
+        "movdqa %%xmm1, %%xmm4              \n\t"\
+        "punpcklwd %%xmm3, %%xmm1           \n\t"\
+        "punpckhwd %%xmm3, %%xmm4           \n\t"\
+        "pmaddwd    %6, %%xmm1              \n\t"\
+        "pmaddwd    %6, %%xmm4              \n\t"\
+        "paddd  %%xmm1, %%xmm0              \n\t"\
+        "paddd  %%xmm4, %%xmm2              \n\t"\
+        "paddd      %7, %%xmm0              \n\t"\
+        "paddd      %7, %%xmm2              \n\t"\
+        "psrad     $10, %%xmm0              \n\t"\
+        "psrad     $10, %%xmm2              \n\t"\
+        "packssdw %%xmm2, %%xmm0            \n\t"\
+        "paddw      %8, %%xmm0              \n\t"\
+        "pmaxsw %%xmm7, %%xmm0              \n\t"\
+        "pminsw     %9, %%xmm0              \n\t"\
+        OP(MOV)\
+        MOV"    %%xmm0, (%0)                \n\t"\
+        "add       $32, %1                  \n\t"\
+        "add        %3, %0                  \n\t"\
+        "decl       %2                      \n\t"\
+        " jnz 1b                            \n\t"\
+        : "+r"(dst), "+r"(tmp), "+g"(h)\
+        : "r"((x86_reg)dstStride),\
+          "m"(pw_1_10bit), "m"(pw_m5_10bit), "m"(pw_20_10bit), "m"(pd_512), "m"(pw_512), "m"(*max)\
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4", "%xmm7",)\
+          "memory"\
+    );\
+}
+
+#define QPEL10_L2(OPNAME, OP, W, MOV)\
+static av_noinline void OPNAME ## pixels10_l2_ ## W ## _sse2(uint8_t *dst, const uint8_t *src1, const uint8_t *src2,\
+                                                           int dstStride, int src1Stride, int src2Stride, int h)\
+{\
+    __asm__ volatile(\
+        "1:                                 \n\t"\
+        MOV"      (%1), %%xmm0              \n\t"\
+        MOV"      (%2), %%xmm1              \n\t"\
+        "pavgw  %%xmm1, %%xmm0              \n\t"\
+        OP(MOV)\
+        MOV"    %%xmm0, (%0)                \n\t"\
+        "add        %5, %1                  \n\t"\
+        "add        %6, %2                  \n\t"\
+        "add        %4, %0                  \n\t"\
+        "decl       %3                      \n\t"\
+        " jnz 1b                            \n\t"\
+        : "+r"(dst), "+r"(src1), "+r"(src2), "+g"(h)\
+        : "r"((x86_reg)dstStride), "r"((x86_reg)src1Stride), "g"((x86_reg)src2Stride)\
+        : XMM_CLOBBERS("%xmm0", "%xmm1",)\
+          "memory"\
+    );\
+}
+
+#define QPEL10_KERNELS(OPNAME, OP, W, MOV)\
+QPEL10_H_LOWPASS(OPNAME, OP, W, MOV)\
+QPEL10_V(OPNAME ## h264_qpel10_v_lowpass, OP, QPEL10_ROUND_CLIP, W, MOV)\
+QPEL10_HV2(OPNAME, OP, W, MOV)\
+QPEL10_L2(OPNAME, OP, W, MOV)
+
+QPEL10_KERNELS(put_, PUT_OP_10, 4, "movq")
+QPEL10_KERNELS(avg_, AVG_OP_10, 4, "movq")
+QPEL10_KERNELS(put_, PUT_OP_10, 8, "movdqu")
+QPEL10_KERNELS(avg_, AVG_OP_10, 8, "movdqu")
+QPEL10_V(h264_qpel10_hv1_lowpass, PUT_OP_10, QPEL10_HV_BIAS, 4, "movq")
+QPEL10_V(h264_qpel10_hv1_lowpass, PUT_OP_10, QPEL10_HV_BIAS, 8, "movdqu")
+
+/* The blocks are processed in columns of 8 pixels (4 for the 4x4 blocks);
+ * each column of the hv filter needs the vertical sums of 5 more pixels. */
+#define QPEL10_COLUMNS(OPNAME)\
+static av_always_inline void OPNAME ## h264_qpel10_h_lowpass_sse2(uint8_t *dst, const uint8_t *src, int dstStride, int srcStride, int size, const xmm_reg *max)\
+{\
+    int x;\
+    if (size == 4)\
+        OPNAME ## h264_qpel10_h_lowpass_4_sse2(dst, src, dstStride, srcStride, 4, max);\
+    else for (x = 0; x < size; x += 8)\
+        OPNAME ## h264_qpel10_h_lowpass_8_sse2(dst + 2*x, src + 2*x, dstStride, srcStride, size, max);\
+}\
+\
+static av_always_inline void OPNAME ## h264_qpel10_v_lowpass_sse2(uint8_t *dst, const uint8_t *src, int dstStride, int srcStride, int size, const xmm_reg *max)\
+{\
+    int x;\
+    if (size == 4)\
+        OPNAME ## h264_qpel10_v_lowpass_4_sse2(dst, src, dstStride, srcStride, 4, &pw_10256, max);\
+    else for (x = 0; x < size; x += 8)\
+        OPNAME ## h264_qpel10_v_lowpass_8_sse2(dst + 2*x, src + 2*x, dstStride, srcStride, size, &pw_10256, max);\
+}\
+\
+static av_always_inline void OPNAME ## h264_qpel10_hv_lowpass_sse2(uint8_t *dst, int16_t *tmp, const uint8_t *src, int dstStride, int srcStride, int size, const xmm_reg *max)\
+{\
+    int x;\
+    if (size == 4) {\
+        h264_qpel10_hv1_lowpass_8_sse2((uint8_t*)tmp,      src - 4, 32, srcStride, 4, &pw_16384, max);\
+        h264_qpel10_hv1_lowpass_4_sse2((uint8_t*)tmp + 16, src + 12, 32, srcStride, 4, &pw_16384, max);\
+        OPNAME ## h264_qpel10_hv2_lowpass_4_sse2(dst, tmp, dstStride, 4, max);\
+    } else for (x = 0; x < size; x += 8) {\
+        h264_qpel10_hv1_lowpass_8_sse2((uint8_t*)tmp,      src + 2*x - 4, 32, srcStride, size, &pw_16384, max);\
+        h264_qpel10_hv1_lowpass_8_sse2((uint8_t*)tmp + 16, src + 2*x + 12, 32, srcStride, size, &pw_16384, max);\
+        OPNAME ## h264_qpel10_hv2_lowpass_8_sse2(dst + 2*x, tmp, dstStride, size, max);\
+    }\
+}\
+\
+static av_always_inline void OPNAME ## pixels10_l2_sse2(uint8_t *dst, const uint8_t *src1, const uint8_t *src2, int dstStride, int src1Stride, int src2Stride, int size)\
+{\
+    int x;\
+    if (size == 4)\
+        OPNAME ## pixels10_l2_4_sse2(dst, src1, src2, dstStride, src1Stride, src2Stride, 4);\
+    else for (x = 0; x < size; x += 8)\
+        OPNAME ## pixels10_l2_8_sse2(dst + 2*x, src1 + 2*x, src2 + 2*x, dstStride, src1Stride, src2Stride, size);\
+}
+
+QPEL10_COLUMNS(put_)
+QPEL10_COLUMNS(avg_)
+
+/* same composition of the half pel planes as the C version */
+#define H264_MC_10(OPNAME, SIZE, DEPTH)\
+static void OPNAME ## h264_qpel ## SIZE ## _mc10_ ## DEPTH ## _sse2(uint8_t *dst, uint8_t *src, int stride)\
+{\
+    DECLARE_ALIGNED(16, uint16_t, half)[SIZE*SIZE];\
+    put_h264_qpel10_h_lowpass_sse2((uint8_t*)half, src, SIZE*2, stride, SIZE, &pw_pixel_max_ ## DEPTH);\
+    OPNAME ## pixels10_l2_sse2(dst, src, (uint8_t*)half, stride, stride, SIZE*2, SIZE);\
+}\
+\
+static void OPNAME ## h264_qpel ## SIZE ## _mc20_ ## DEPTH ## _sse2(uint8_t *dst, uint8_t *src, int stride)\
+{\
+    OPNAME ## h264_qpel10_h_lowpass_sse2(dst, src, stride, stride, SIZE, &pw_pixel_max_ ## DEPTH);\
+}\
+\
+static void OPNAME ## h264_qpel ## SIZE ## _mc30_ ## DEPTH ## _sse2(uint8_t *dst, uint8_t *src, int stride)\
+{\
+    DECLARE_ALIGNED(16, uint16_t, half)[SIZE*SIZE];\
+    put_h264_qpel10_h_lowpass_sse2((uint8_t*)half, src, SIZE*2, stride, SIZE, &pw_pixel_max_ ## DEPTH);\
+    OPNAME ## pixels10_l2_sse2(dst, src + 2, (uint8_t*)half, stride, stride, SIZE*2, SIZE);\
+}\
+\
+static void OPNAME ## h264_qpel ## SIZE ## _mc01_ ## DEPTH ## _sse2(uint8_t *dst, uint8_t *src, int stride)\
+{\
+    DECLARE_ALIGNED(16, uint16_t, half)[SIZE*SIZE];\
+    put_h264_qpel10_v_lowpass_sse2((uint8_t*)half, src, SIZE*2, stride, SIZE, &pw_pixel_max_ ## DEPTH);\
+    OPNAME ## pixels10_l2_sse2(dst, src, (uint8_t*)half, stride, stride, SIZE*2, SIZE);\
+}\
+\
+static void OPNAME ## h264_qpel ## SIZE ## _mc02_ ## DEPTH ## _sse2(uint8_t *dst, uint8_t *src, int stride)\
+{\
+    OPNAME ## h264_qpel10_v_lowpass_sse2(dst, src, stride, stride, SIZE, &pw_pixel_max_ ## DEPTH);\
+}\
+\
+static void OPNAME ## h264_qpel ## SIZE ## _mc03_ ## DEPTH ## _sse2(uint8_t *dst, uint8_t *src, int stride)\
+{\
+    DECLARE_ALIGNED(16, uint16_t, half)[SIZE*SIZE];\
+    put_h264_qpel10_v_lowpass_sse2((uint8_t*)half, src, SIZE*2, stride, SIZE, &pw_pixel_max_ ## DEPTH);\
+    OPNAME ## pixels10_l2_sse2(dst, src + stride, (uint8_t*)half, stride, stride, SIZE*2, SIZE);\
+}\
+\
+static void OPNAME ## h264_qpel ## SIZE ## _mc22_ ## DEPTH ## _sse2(uint8_t *dst, uint8_t *src, int stride)\
+{\
+    DECLARE_ALIGNED(16, int16_t, tmp)[SIZE*16];\
+    OPNAME ## h264_qpel10_hv_lowpass_sse2(dst, tmp, src, stride, stride, SIZE, &pw_pixel_max_ ## DEPTH);\
+}\
+\
+H264_MC_10_HV_L2(OPNAME, SIZE, DEPTH, 11, h_lowpass, 0,      v_lowpass, 0)\
+H264_MC_10_HV_L2(OPNAME, SIZE, DEPTH, 31, h_lowpass, 0,      v_lowpass, 2)\
+H264_MC_10_HV_L2(OPNAME, SIZE, DEPTH, 13, h_lowpass, stride, v_lowpass, 0)\
+H264_MC_10_HV_L2(OPNAME, SIZE, DEPTH, 33, h_lowpass, stride, v_lowpass, 2)\
+H264_MC_10_HV_L2(OPNAME, SIZE, DEPTH, 21, h_lowpass, 0,      hv, 0)\
+H264_MC_10_HV_L2(OPNAME, SIZE, DEPTH, 23, h_lowpass, stride, hv, 0)\
+H264_MC_10_HV_L2(OPNAME, SIZE, DEPTH, 12, v_lowpass, 0,      hv, 0)\
+H264_MC_10_HV_L2(OPNAME, SIZE, DEPTH, 32, v_lowpass, 2,      hv, 0)
+
+#define H264_QPEL10_FILTER_v_lowpass(dst, src, stride, SIZE, max)\
+    put_h264_qpel10_v_lowpass_sse2(dst, src, SIZE*2, stride, SIZE, max)
+#define H264_QPEL10_FILTER_h_lowpass(dst, src, stride, SIZE, max)\
+    put_h264_qpel10_h_lowpass_sse2(dst, src, SIZE*2, stride, SIZE, max)
+#define H264_QPEL10_FILTER_hv(dst, src, stride, SIZE, max)\
+    put_h264_qpel10_hv_lowpass_sse2(dst, tmp, src, SIZE*2, stride, SIZE, max)
+
+/* average of the planes F1 of src + OFF1 and F2 of src + OFF2 */
+#define H264_MC_10_HV_L2(OPNAME, SIZE, DEPTH, XY, F1, OFF1, F2, OFF2)\
+static void OPNAME ## h264_qpel ## SIZE ## _mc ## XY ## _ ## DEPTH ## _sse2(uint8_t *dst, uint8_t *src, int stride)\
+{\
+    DECLARE_ALIGNED(16, uint16_t, half1)[SIZE*SIZE];\
+    DECLARE_ALIGNED(16, uint16_t, half2)[SIZE*SIZE];\
+    av_unused DECLARE_ALIGNED(16, int16_t, tmp)[SIZE*16];\
+    H264_QPEL10_FILTER_ ## F1((uint8_t*)half1, src + OFF1, stride, SIZE, &pw_pixel_max_ ## DEPTH);\
+    H264_QPEL10_FILTER_ ## F2((uint8_t*)half2, src + OFF2, stride, SIZE, &pw_pixel_max_ ## DEPTH);\
+    OPNAME ## pixels10_l2_sse2(dst, (uint8_t*)half1, (uint8_t*)half2, stride, SIZE*2, SIZE*2, SIZE);\
+}
+
+#define H264_MC_10_SIZES(OPNAME, DEPTH)\
+H264_MC_10(OPNAME, 4,  DEPTH)\
+H264_MC_10(OPNAME, 8,  DEPTH)\
+H264_MC_10(OPNAME, 16, DEPTH)
+
+/* the C copy is faster for put and for the 4x4 avg */
+#define H264_MC_10_00(SIZE)\
+static void avg_h264_qpel ## SIZE ## _mc00_10_sse2(uint8_t *dst, uint8_t *src, int stride)\
+{\
+    avg_pixels10_l2_sse2(dst, src, src, stride, stride, stride, SIZE);\
+}
+
+H264_MC_10_00(8)
+H264_MC_10_00(16)
+H264_MC_10_SIZES(put_, 9)
+H264_MC_10_SIZES(avg_, 9)
+H264_MC_10_SIZES(put_, 10)
+H264_MC_10_SIZES(avg_, 10)
@@ -0,0 +1,277 @@
+/*
+ * SSE optimized batched IMDCT
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/common.h"
+#include "libavutil/cpu.h"
+#include "libavutil/mem.h"
+#include "libavutil/x86_cpu.h"
+#include "libavcodec/fft.h"
+
+/*
+ * 4 blocks are transformed at once, each SSE lane doing the work of the C
+ * code for one block: the split-radix FFT below is the one of fft.c, on
+ * complex values holding one value of each block.
+ */
+
+/** one complex value of 4 blocks */
+typedef struct FFTComplex4 {
+    float re[4], im[4];
+} FFTComplex4;
+
+/* twiddles of the 8-point pass, as in fft8() */
+static const float cos_8[3] = { 1, M_SQRT1_2, 0 };
+
+/* BF(d, s, b): d = s - b, s = s + b */
+#define BF(d, s, b)                     \
+    "movaps  "s", "d"           \n\t"   \
+    "subps   "b", "d"           \n\t"   \
+    "addps   "b", "s"           \n\t"
+
+static void fft4_sse(FFTComplex4 *z)
+{
+    __asm__ volatile(
+        "movaps       (%0), %%xmm0      \n\t"
+        "movaps     32(%0), %%xmm1      \n\t"
+        BF("%%xmm2", "%%xmm0", "%%xmm1")        /* t3, t1 */
+        "movaps     96(%0), %%xmm1      \n\t"
+        "movaps     64(%0), %%xmm3      \n\t"
+        BF("%%xmm4", "%%xmm1", "%%xmm3")        /* t8, t6 */
+        BF("%%xmm3", "%%xmm0", "%%xmm1")
+        "movaps     %%xmm3, 64(%0)      \n\t"
+        "movaps     %%xmm0,   (%0)      \n\t"
+        "movaps     16(%0), %%xmm0      \n\t"
+        "movaps     48(%0), %%xmm1      \n\t"
+        BF("%%xmm3", "%%xmm0", "%%xmm1")        /* t4, t2 */
+        "movaps     80(%0), %%xmm1      \n\t"
+        "movaps    112(%0), %%xmm5      \n\t"
+        BF("%%xmm6", "%%xmm1", "%%xmm5")        /* t7, t5 */
+        BF("%%xmm5", "%%xmm3", "%%xmm4")
+        BF("%%xmm4", "%%xmm2", "%%xmm6")
+        BF("%%xmm6", "%%xmm0", "%%xmm1")
+        "movaps     %%xmm5, 112(%0)     \n\t"
+        "movaps     %%xmm3,  48(%0)     \n\t"
+        "movaps     %%xmm4,  96(%0)     \n\t"
+        "movaps     %%xmm2,  32(%0)     \n\t"
+        "movaps     %%xmm6,  80(%0)     \n\t"
+        "movaps     %%xmm0,  16(%0)     \n\t"
+        :: "r"(z)
+        : "memory"
+          XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                         "%xmm4", "%xmm5", "%xmm6")
+    );
+}
+
+/* 2-point FFTs of z[0], z[1] and of z[2], z[3] */
+static void fft2x2_sse(FFTComplex4 *z)
+{
+    __asm__ volatile(
+        "movaps       (%0), %%xmm0      \n\t"
+        "movaps     32(%0), %%xmm1      \n\t"
+        "movaps     16(%0), %%xmm2      \n\t"
+        "movaps     48(%0), %%xmm3      \n\t"
+        BF("%%xmm4", "%%xmm0", "%%xmm1")
+        BF("%%xmm5", "%%xmm2", "%%xmm3")
+        "movaps       64(%0), %%xmm1    \n\t"
+        "movaps       96(%0), %%xmm3    \n\t"
+        "movaps     %%xmm0,   (%0)      \n\t"
+        "movaps     %%xmm4, 32(%0)      \n\t"
+        "movaps     %%xmm2, 16(%0)      \n\t"
+        "movaps     %%xmm5, 48(%0)      \n\t"
+        "movaps       80(%0), %%xmm2    \n\t"
+        "movaps      112(%0), %%xmm0    \n\t"
+        BF("%%xmm4", "%%xmm1", "%%xmm3")
+        BF("%%xmm5", "%%xmm2", "%%xmm0")
+        "movaps     %%xmm1,  64(%0)     \n\t"
+        "movaps     %%xmm4,  96(%0)     \n\t"
+        "movaps     %%xmm2,  80(%0)     \n\t"
+        "movaps     %%xmm5, 112(%0)     \n\t"
+        :: "r"(z)
+        : "memory"
+          XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                         "%xmm4", "%xmm5")
+    );
+}
+
+/**
+ * Same as pass() in fft.c, z[0...8n-1], w[0...2n].
+ * TRANSFORM_ZERO() is done as a TRANSFORM() with the twiddle of index 0.
+ */
+static void pass_sse(FFTComplex4 *z, const float *wre, unsigned int n)
+{
+    int o1 = 2 * n;
+    const float *wim = wre + o1;
+    int i;
+
+    for (i = 0; i < o1; i++) {
+        __asm__ volatile(
+            "movss        (%3), %%xmm6          \n\t"
+            "movss        (%4), %%xmm7          \n\t"
+            "shufps $0, %%xmm6, %%xmm6          \n\t"
+            "shufps $0, %%xmm7, %%xmm7          \n\t"
+            "movaps  (%0,%1,2), %%xmm0          \n\t"
+            "movaps 16(%0,%1,2), %%xmm1         \n\t"
+            "movaps     %%xmm0, %%xmm2          \n\t"
+            "movaps     %%xmm1, %%xmm3          \n\t"
+            "mulps      %%xmm6, %%xmm2          \n\t"
+            "mulps      %%xmm7, %%xmm3          \n\t"
+            "mulps      %%xmm6, %%xmm1          \n\t"
+            "mulps      %%xmm7, %%xmm0          \n\t"
+            "addps      %%xmm3, %%xmm2          \n\t" /* t1 */
+            "subps      %%xmm0, %%xmm1          \n\t" /* t2 */
+            "movaps       (%2), %%xmm0          \n\t"
+            "movaps     16(%2), %%xmm3          \n\t"
+            "movaps     %%xmm0, %%xmm4          \n\t"
+            "movaps     %%xmm3, %%xmm5          \n\t"
+            "mulps      %%xmm6, %%xmm4          \n\t"
+            "mulps      %%xmm7, %%xmm5          \n\t"
+            "mulps      %%xmm7, %%xmm0          \n\t"
+            "mulps      %%xmm6, %%xmm3          \n\t"
+            "subps      %%xmm5, %%xmm4          \n\t" /* t5 */
+            "addps      %%xmm3, %%xmm0          \n\t" /* t6 */
+            BF("%%xmm3", "%%xmm4", "%%xmm2")          /* t3, t5 */
+            BF("%%xmm5", "%%xmm1", "%%xmm0")          /* t4, t6 */
+            "movaps       (%0), %%xmm0          \n\t"
+            BF("%%xmm2", "%%xmm0", "%%xmm4")
+            "movaps     %%xmm2, (%0,%1,2)       \n\t"
+            "movaps     %%xmm0, (%0)            \n\t"
+            "movaps   16(%0,%1), %%xmm0         \n\t"
+            BF("%%xmm2", "%%xmm0", "%%xmm3")
+            "movaps     %%xmm2, 16(%2)          \n\t"
+            "movaps     %%xmm0, 16(%0,%1)       \n\t"
+            "movaps    (%0,%1), %%xmm0          \n\t"
+            BF("%%xmm2", "%%xmm0", "%%xmm5")
+            "movaps     %%xmm2, (%2)            \n\t"
+            "movaps     %%xmm0, (%0,%1)         \n\t"
+            "movaps     16(%0), %%xmm0          \n\t"
+            BF("%%xmm2", "%%xmm0", "%%xmm1")
+            "movaps     %%xmm2, 16(%0,%1,2)     \n\t"
+            "movaps     %%xmm0, 16(%0)          \n\t"
+            :: "r"(z + i), "r"((x86_reg)o1 * sizeof(*z)), "r"(z + i + 3 * o1),
+               "r"(wre + i), "r"(wim - i)
+            : "memory"
+              XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                             "%xmm4", "%xmm5", "%xmm6", "%xmm7")
+        );
+    }
+}
+
+static void fft_sse(FFTComplex4 *z, int nbits)
+{
+    int n = 1 << nbits;
+
+    switch (nbits) {
+    case 2:
+        fft4_sse(z);
+        break;
+    case 3:
+        fft4_sse(z);
+        fft2x2_sse(z + 4);
+        pass_sse(z, cos_8, 1);
+        break;
+    default:
+        fft_sse(z,             nbits - 1);
+        fft_sse(z + n / 2,     nbits - 2);
+        fft_sse(z + n / 4 * 3, nbits - 2);
+        pass_sse(z, ff_cos_tabs[nbits], n / 8);
+    }
+}
+
+/**
+ * imdct_half() of nb_blocks <= 4 blocks; when there are less than 4, the
+ * last one is also transformed in the unused lanes.
+ */
+static void imdct_half4_sse(FFTContext *s, FFTSample *output, int out_stride,
+                            const FFTSample *input, int in_stride, int nb_blocks)
+{
+    FFTComplex4 *z = (FFTComplex4 *)s->batch_buf;
+    const uint16_t *revtab = s->revtab;
+    const float *tcos = s->tcos;
+    const float *tsin = s->tsin;
+    const float *in[4];
+    int swap_lsbs = s->fft_permutation == FF_FFT_PERM_SWAP_LSBS;
+    int n  = 1 << s->mdct_bits;
+    int n2 = n >> 1;
+    int n4 = n >> 2;
+    int n8 = n >> 3;
+    int b, k;
+
+    for (b = 0; b < 4; b++)
+        in[b] = input + FFMIN(b, nb_blocks - 1) * in_stride;
+
+    /* pre rotation, into the order of the C FFT */
+    for (k = 0; k < n4; k++) {
+        int j = revtab[k];
+        FFTComplex4 *d;
+        if (swap_lsbs)
+            j = (j & ~3) | ((j >> 1) & 1) | ((j << 1) & 2);
+        d = &z[j];
+        for (b = 0; b < 4; b++) {
+            float re = in[b][n2 - 1 - 2 * k];
+            float im = in[b][2 * k];
+            d->re[b] = re * tcos[k] - im * tsin[k];
+            d->im[b] = re * tsin[k] + im * tcos[k];
+        }
+    }
+
+    fft_sse(z, s->nbits);
+
+    /* post rotation + reordering */
+    for (b = 0; b < nb_blocks; b++) {
+        FFTComplex *o = (FFTComplex *)(output + b * out_stride);
+        for (k = 0; k < n8; k++) {
+            const FFTComplex4 *z0 = &z[n8 - k - 1];
+            const FFTComplex4 *z1 = &z[n8 + k];
+            float c0 = tcos[n8 - k - 1], s0 = tsin[n8 - k - 1];
+            float c1 = tcos[n8 + k],     s1 = tsin[n8 + k];
+            o[n8 - k - 1].re = z0->im[b] * s0 - z0->re[b] * c0;
+            o[n8 - k - 1].im = z1->im[b] * c1 + z1->re[b] * s1;
+            o[n8 + k    ].re = z1->im[b] * s1 - z1->re[b] * c1;
+            o[n8 + k    ].im = z0->im[b] * c0 + z0->re[b] * s0;
+        }
+    }
+}
+
+static void imdct_half_batch_sse(FFTContext *s, FFTSample *output, int out_stride,
+                                 const FFTSample *input, int in_stride, int count)
+{
+    if (count == 1) {
+        s->imdct_half(s, output, input);
+        return;
+    }
+    for (; count > 0; count -= 4) {
+        imdct_half4_sse(s, output, out_stride, input, in_stride, FFMIN(count, 4));
+        output += 4 * out_stride;
+        input  += 4 * in_stride;
+    }
+}
+
+av_cold void ff_mdct_init_mmx(FFTContext *s)
+{
+    int mm_flags = av_get_cpu_flags();
+
+    /* the AVX FFT permutation cannot be undone as simply as the SSE one */
+    if (mm_flags & AV_CPU_FLAG_SSE &&
+        s->fft_permutation  != FF_FFT_PERM_AVX &&
+        s->mdct_permutation == FF_MDCT_PERM_NONE) {
+        s->batch_buf = av_malloc(sizeof(FFTComplex4) << s->nbits);
+        if (s->batch_buf)
+            s->imdct_half_batch = imdct_half_batch_sse;
+    }
+}
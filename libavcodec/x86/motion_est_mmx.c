@@ -116,6 +116,170 @@ static int sad16_sse2(void *v, uint8_t *blk2, uint8_t *blk1, int stride, int h)
     return ret;
 }
 
+#if ARCH_X86_64
+/* The x4 versions score one block against 4 candidates, two rows per
+ * iteration, each source row is loaded once for all candidates.
+ * xmm0-xmm3 hold the two psadbw partial sums of each candidate. */
+#define SAD_X4_STORE(score)\
+        "movdqa     %%xmm0, %%xmm4      \n\t"\
+        "movdqa     %%xmm2, %%xmm5      \n\t"\
+        "punpcklqdq %%xmm1, %%xmm0      \n\t"\
+        "punpckhqdq %%xmm1, %%xmm4      \n\t"\
+        "punpcklqdq %%xmm3, %%xmm2      \n\t"\
+        "punpckhqdq %%xmm3, %%xmm5      \n\t"\
+        "paddd      %%xmm4, %%xmm0      \n\t"\
+        "paddd      %%xmm5, %%xmm2      \n\t"\
+        "shufps     $0x88, %%xmm2, %%xmm0 \n\t"\
+        "movdqu     %%xmm0, "score"     \n\t"
+
+#define SAD_X4_OPERANDS\
+        : [h]"+r"(h), [src]"+r"(blk2),\
+          [r0]"+r"(r0), [r1]"+r"(r1), [r2]"+r"(r2), [r3]"+r"(r3),\
+          [score]"=m"(*(xmm_reg*)score)\
+        : [stride]"r"((x86_reg)stride)\
+        XMM_CLOBBERS_ONLY("%xmm0", "%xmm1", "%xmm2", "%xmm3",\
+                          "%xmm4", "%xmm5", "%xmm6", "%xmm7")
+
+static void sad8_x4_sse2(void *v, uint8_t *blk2, uint8_t * const blk1[4], int stride, int h, int score[4])
+{
+    uint8_t *r0 = blk1[0], *r1 = blk1[1], *r2 = blk1[2], *r3 = blk1[3];
+
+    __asm__ volatile(
+        "pxor %%xmm0, %%xmm0            \n\t"
+        "pxor %%xmm1, %%xmm1            \n\t"
+        "pxor %%xmm2, %%xmm2            \n\t"
+        "pxor %%xmm3, %%xmm3            \n\t"
+        ".p2align 4                     \n\t"
+        "1:                             \n\t"
+        "movq   (%[src]), %%xmm4        \n\t"
+        "movhps (%[src], %[stride]), %%xmm4 \n\t"
+        "movq   (%[r0]), %%xmm5         \n\t"
+        "movhps (%[r0], %[stride]), %%xmm5  \n\t"
+        "movq   (%[r1]), %%xmm6         \n\t"
+        "movhps (%[r1], %[stride]), %%xmm6  \n\t"
+        "psadbw %%xmm4, %%xmm5          \n\t"
+        "psadbw %%xmm4, %%xmm6          \n\t"
+        "paddd  %%xmm5, %%xmm0          \n\t"
+        "paddd  %%xmm6, %%xmm1          \n\t"
+        "movq   (%[r2]), %%xmm5         \n\t"
+        "movhps (%[r2], %[stride]), %%xmm5  \n\t"
+        "movq   (%[r3]), %%xmm6         \n\t"
+        "movhps (%[r3], %[stride]), %%xmm6  \n\t"
+        "psadbw %%xmm4, %%xmm5          \n\t"
+        "psadbw %%xmm4, %%xmm6          \n\t"
+        "paddd  %%xmm5, %%xmm2          \n\t"
+        "paddd  %%xmm6, %%xmm3          \n\t"
+        "lea (%[src], %[stride], 2), %[src] \n\t"
+        "lea (%[r0], %[stride], 2), %[r0]   \n\t"
+        "lea (%[r1], %[stride], 2), %[r1]   \n\t"
+        "lea (%[r2], %[stride], 2), %[r2]   \n\t"
+        "lea (%[r3], %[stride], 2), %[r3]   \n\t"
+        "sub $2, %[h]                   \n\t"
+        " jg 1b                         \n\t"
+        SAD_X4_STORE("%[score]")
+        SAD_X4_OPERANDS
+    );
+}
+
+static void sad16_x4_sse2(void *v, uint8_t *blk2, uint8_t * const blk1[4], int stride, int h, int score[4])
+{
+    uint8_t *r0 = blk1[0], *r1 = blk1[1], *r2 = blk1[2], *r3 = blk1[3];
+
+    __asm__ volatile(
+        "pxor %%xmm0, %%xmm0            \n\t"
+        "pxor %%xmm1, %%xmm1            \n\t"
+        "pxor %%xmm2, %%xmm2            \n\t"
+        "pxor %%xmm3, %%xmm3            \n\t"
+        ".p2align 4                     \n\t"
+        "1:                             \n\t"
+        "movdqu (%[src]), %%xmm4        \n\t"
+        "movdqu (%[r0]), %%xmm5         \n\t"
+        "movdqu (%[r1]), %%xmm6         \n\t"
+        "movdqu (%[r2]), %%xmm7         \n\t"
+        "psadbw %%xmm4, %%xmm5          \n\t"
+        "psadbw %%xmm4, %%xmm6          \n\t"
+        "psadbw %%xmm4, %%xmm7          \n\t"
+        "paddd  %%xmm5, %%xmm0          \n\t"
+        "paddd  %%xmm6, %%xmm1          \n\t"
+        "paddd  %%xmm7, %%xmm2          \n\t"
+        "movdqu (%[r3]), %%xmm5         \n\t"
+        "psadbw %%xmm4, %%xmm5          \n\t"
+        "paddd  %%xmm5, %%xmm3          \n\t"
+        "movdqu (%[src], %[stride]), %%xmm4 \n\t"
+        "movdqu (%[r0], %[stride]), %%xmm5  \n\t"
+        "movdqu (%[r1], %[stride]), %%xmm6  \n\t"
+        "movdqu (%[r2], %[stride]), %%xmm7  \n\t"
+        "psadbw %%xmm4, %%xmm5          \n\t"
+        "psadbw %%xmm4, %%xmm6          \n\t"
+        "psadbw %%xmm4, %%xmm7          \n\t"
+        "paddd  %%xmm5, %%xmm0          \n\t"
+        "paddd  %%xmm6, %%xmm1          \n\t"
+        "paddd  %%xmm7, %%xmm2          \n\t"
+        "movdqu (%[r3], %[stride]), %%xmm5  \n\t"
+        "psadbw %%xmm4, %%xmm5          \n\t"
+        "paddd  %%xmm5, %%xmm3          \n\t"
+        "lea (%[src], %[stride], 2), %[src] \n\t"
+        "lea (%[r0], %[stride], 2), %[r0]   \n\t"
+        "lea (%[r1], %[stride], 2), %[r1]   \n\t"
+        "lea (%[r2], %[stride], 2), %[r2]   \n\t"
+        "lea (%[r3], %[stride], 2), %[r3]   \n\t"
+        "sub $2, %[h]                   \n\t"
+        " jg 1b                         \n\t"
+        SAD_X4_STORE("%[score]")
+        SAD_X4_OPERANDS
+    );
+}
+
+#if HAVE_AVX2
+/* two rows per ymm register, one in each lane; the lanes are reduced in
+ * place and added at the end */
+#define SAD16_X4_AVX2_REF(r, acc)\
+        "vmovdqu     (%["#r"]), %%xmm5                       \n\t"\
+        "vinserti128 $1, (%["#r"], %[stride]), %%ymm5, %%ymm5 \n\t"\
+        "vpsadbw     %%ymm4, %%ymm5, %%ymm5                  \n\t"\
+        "vpaddd      %%ymm5, "acc", "acc"                    \n\t"
+
+static void sad16_x4_avx2(void *v, uint8_t *blk2, uint8_t * const blk1[4], int stride, int h, int score[4])
+{
+    uint8_t *r0 = blk1[0], *r1 = blk1[1], *r2 = blk1[2], *r3 = blk1[3];
+
+    __asm__ volatile(
+        "vpxor %%ymm0, %%ymm0, %%ymm0   \n\t"
+        "vpxor %%ymm1, %%ymm1, %%ymm1   \n\t"
+        "vpxor %%ymm2, %%ymm2, %%ymm2   \n\t"
+        "vpxor %%ymm3, %%ymm3, %%ymm3   \n\t"
+        ".p2align 4                     \n\t"
+        "1:                             \n\t"
+        "vmovdqu     (%[src]), %%xmm4   \n\t"
+        "vinserti128 $1, (%[src], %[stride]), %%ymm4, %%ymm4 \n\t"
+        SAD16_X4_AVX2_REF(r0, "%%ymm0")
+        SAD16_X4_AVX2_REF(r1, "%%ymm1")
+        SAD16_X4_AVX2_REF(r2, "%%ymm2")
+        SAD16_X4_AVX2_REF(r3, "%%ymm3")
+        "lea (%[src], %[stride], 2), %[src] \n\t"
+        "lea (%[r0], %[stride], 2), %[r0]   \n\t"
+        "lea (%[r1], %[stride], 2), %[r1]   \n\t"
+        "lea (%[r2], %[stride], 2), %[r2]   \n\t"
+        "lea (%[r3], %[stride], 2), %[r3]   \n\t"
+        "sub $2, %[h]                   \n\t"
+        " jg 1b                         \n\t"
+        "vpunpcklqdq %%ymm1, %%ymm0, %%ymm4 \n\t"
+        "vpunpckhqdq %%ymm1, %%ymm0, %%ymm5 \n\t"
+        "vpunpcklqdq %%ymm3, %%ymm2, %%ymm6 \n\t"
+        "vpunpckhqdq %%ymm3, %%ymm2, %%ymm7 \n\t"
+        "vpaddd      %%ymm5, %%ymm4, %%ymm4 \n\t"
+        "vpaddd      %%ymm7, %%ymm6, %%ymm6 \n\t"
+        "vshufps     $0x88, %%ymm6, %%ymm4, %%ymm0 \n\t"
+        "vextracti128 $1, %%ymm0, %%xmm1    \n\t"
+        "vpaddd      %%xmm1, %%xmm0, %%xmm0 \n\t"
+        "vmovdqu     %%xmm0, %[score]   \n\t"
+        "vzeroupper                     \n\t"
+        SAD_X4_OPERANDS
+    );
+}
+#endif /* HAVE_AVX2 */
+#endif /* ARCH_X86_64 */
+
 static inline void sad8_x2a_mmx2(uint8_t *blk1, uint8_t *blk2, int stride, int h)
 {
     __asm__ volatile(
@@ -457,5 +621,15 @@ void dsputil_init_pix_mmx(DSPContext* c, AVCodecContext *avctx)
     }
     if ((mm_flags & AV_CPU_FLAG_SSE2) && !(mm_flags & AV_CPU_FLAG_3DNOW) && avctx->codec_id != CODEC_ID_SNOW) {
         c->sad[0]= sad16_sse2;
+#if ARCH_X86_64
+        c->sad_x4[0]= sad16_x4_sse2;
+        c->sad_x4[1]= sad8_x4_sse2;
+#endif
+    }
+#if ARCH_X86_64 && HAVE_AVX2
+    if ((mm_flags & AV_CPU_FLAG_AVX2) && avctx->codec_id != CODEC_ID_SNOW) {
+        c->sad_x4[0]= sad16_x4_avx2;
+        c->sad_x4[1]= sad8_x4_sse2;
     }
+#endif
 }
@@ -147,11 +147,340 @@ static void apply_window_mp3(float *in, float *win, int *unused, float *out,
     *out = sum;
 }
 
+/* transpose the 4x4 matrix in a, b, c, d; the columns end up in a, c, t, b */
+#define TRANSPOSE4(a, b, c, d, t)       \
+    "movaps  "a", "t"           \n\t"   \
+    "unpcklps "b", "a"          \n\t"   \
+    "unpckhps "b", "t"          \n\t"   \
+    "movaps  "c", "b"           \n\t"   \
+    "unpcklps "d", "c"          \n\t"   \
+    "unpckhps "d", "b"          \n\t"   \
+    "movaps  "a", "d"           \n\t"   \
+    "movlhps "c", "a"           \n\t"   \
+    "movhlps "d", "c"           \n\t"   \
+    "movaps  "t", "d"           \n\t"   \
+    "movlhps "b", "t"           \n\t"   \
+    "movhlps "d", "b"           \n\t"
+
+#define V4(x) { x, x, x, x }
+
+/* the multipliers of imdct36, with the MULH3 scale already applied */
+DECLARE_ALIGNED(16, static const float, imdct36_consts)[18][4] = {
+    V4( 0.5),
+    V4( 0.93969262078590838405), /*  2 * C2 */
+    V4(-0.17364817766693034885), /* -2 * C8 */
+    V4(-0.76604444311897803520), /* -2 * C4 */
+    V4(-0.86602540378443864676), /* -2 * C3 */
+    V4( 0.98480775301220805936), /*  2 * C1 */
+    V4(-0.34202014332566873304), /* -2 * C7 */
+    V4( 0.86602540378443864676), /*  2 * C3 */
+    V4(-0.64278760968653932632), /* -2 * C5 */
+    V4( 0.50190991877167369479), /*  2 * icos36h[0..4] */
+    V4( 0.51763809020504152469),
+    V4( 0.55168895948124587824),
+    V4( 0.61038729438072803416),
+    V4( 0.70710678118654752439),
+    V4( 5.73685662283492756461), /* icos36[8..5] */
+    V4( 1.93185165257813657349),
+    V4( 1.18310079157624925896),
+    V4( 0.87172339781054900991),
+};
+
+/* the windows of 4 consecutive subbands, interleaved, indexed by
+ * [switch_point][block_type] */
+DECLARE_ALIGNED(16, static float, mdct_win_sse)[2][4][36][4];
+
+#define IN(n, j)  "16*("#n"+"#j")(%1)"
+#define TMP(n, j) "16*(18+"#n"+"#j")(%1)"
+#define CST(n)    "16*"#n"(%2)"
+
+#define PSUM(i, k)                              \
+    "movaps "IN(i, 0)", %%xmm0          \n\t"   \
+    "addps  "IN(k, 0)", %%xmm0          \n\t"   \
+    "movaps %%xmm0, "IN(i, 0)"          \n\t"
+
+/* the 9 point DCT of the odd (j = 1) or even (j = 0) inputs */
+#define DCT9(j)                                 \
+    "movaps "IN(8, j)", %%xmm0          \n\t"   \
+    "addps  "IN(16, j)", %%xmm0         \n\t"   \
+    "subps  "IN(4, j)", %%xmm0          \n\t"   \
+    "movaps "IN(12, j)", %%xmm1         \n\t"   \
+    "mulps  "CST(0)", %%xmm1            \n\t"   \
+    "addps  "IN(0, j)", %%xmm1          \n\t"   \
+    "movaps "IN(0, j)", %%xmm2          \n\t"   \
+    "subps  "IN(12, j)", %%xmm2         \n\t"   \
+    "movaps %%xmm0, %%xmm3              \n\t"   \
+    "mulps  "CST(0)", %%xmm3            \n\t"   \
+    "movaps %%xmm2, %%xmm4              \n\t"   \
+    "subps  %%xmm3, %%xmm4              \n\t"   \
+    "movaps %%xmm4, "TMP(6, j)"         \n\t"   \
+    "addps  %%xmm0, %%xmm2              \n\t"   \
+    "movaps %%xmm2, "TMP(16, j)"        \n\t"   \
+    "movaps "IN(4, j)", %%xmm0          \n\t"   \
+    "addps  "IN(8, j)", %%xmm0          \n\t"   \
+    "mulps  "CST(1)", %%xmm0            \n\t"   \
+    "movaps "IN(8, j)", %%xmm2          \n\t"   \
+    "subps  "IN(16, j)", %%xmm2         \n\t"   \
+    "mulps  "CST(2)", %%xmm2            \n\t"   \
+    "movaps "IN(4, j)", %%xmm3          \n\t"   \
+    "addps  "IN(16, j)", %%xmm3         \n\t"   \
+    "mulps  "CST(3)", %%xmm3            \n\t"   \
+    "movaps %%xmm1, %%xmm4              \n\t"   \
+    "subps  %%xmm0, %%xmm4              \n\t"   \
+    "subps  %%xmm3, %%xmm4              \n\t"   \
+    "movaps %%xmm4, "TMP(10, j)"        \n\t"   \
+    "movaps %%xmm1, %%xmm4              \n\t"   \
+    "addps  %%xmm0, %%xmm4              \n\t"   \
+    "addps  %%xmm2, %%xmm4              \n\t"   \
+    "movaps %%xmm4, "TMP(2, j)"         \n\t"   \
+    "addps  %%xmm3, %%xmm1              \n\t"   \
+    "subps  %%xmm2, %%xmm1              \n\t"   \
+    "movaps %%xmm1, "TMP(14, j)"        \n\t"   \
+    "movaps "IN(10, j)", %%xmm0         \n\t"   \
+    "addps  "IN(14, j)", %%xmm0         \n\t"   \
+    "subps  "IN(2, j)", %%xmm0          \n\t"   \
+    "mulps  "CST(4)", %%xmm0            \n\t"   \
+    "movaps %%xmm0, "TMP(4, j)"         \n\t"   \
+    "movaps "IN(2, j)", %%xmm0          \n\t"   \
+    "addps  "IN(10, j)", %%xmm0         \n\t"   \
+    "mulps  "CST(5)", %%xmm0            \n\t"   \
+    "movaps "IN(10, j)", %%xmm1         \n\t"   \
+    "subps  "IN(14, j)", %%xmm1         \n\t"   \
+    "mulps  "CST(6)", %%xmm1            \n\t"   \
+    "movaps "IN(6, j)", %%xmm2          \n\t"   \
+    "mulps  "CST(7)", %%xmm2            \n\t"   \
+    "movaps "IN(2, j)", %%xmm3          \n\t"   \
+    "addps  "IN(14, j)", %%xmm3         \n\t"   \
+    "mulps  "CST(8)", %%xmm3            \n\t"   \
+    "movaps %%xmm0, %%xmm4              \n\t"   \
+    "addps  %%xmm1, %%xmm4              \n\t"   \
+    "addps  %%xmm2, %%xmm4              \n\t"   \
+    "movaps %%xmm4, "TMP(0, j)"         \n\t"   \
+    "addps  %%xmm3, %%xmm0              \n\t"   \
+    "subps  %%xmm2, %%xmm0              \n\t"   \
+    "movaps %%xmm0, "TMP(12, j)"        \n\t"   \
+    "subps  %%xmm3, %%xmm1              \n\t"   \
+    "subps  %%xmm2, %%xmm1              \n\t"   \
+    "movaps %%xmm1, "TMP(8, j)"         \n\t"
+
+#define T(e)   "16*(18+"e")(%0)"
+#define OUT(e) "128*("e")(%1)"
+#define BUF(e) "16*("e")(%2)"
+#define WIN(e) "16*("e")(%3)"
+#define K(e)   "16*("e")(%4)"
+
+/* window and overlap the outputs t1 (xmm0) and t0 (xmm4) into
+ * out[a], out[b], buf[a] and buf[b] */
+#define WINDOW_OVERLAP(a, b)                    \
+    "movaps %%xmm0, %%xmm5              \n\t"   \
+    "mulps  "WIN(a)", %%xmm5            \n\t"   \
+    "addps  "BUF(a)", %%xmm5            \n\t"   \
+    "movaps %%xmm5, "OUT(a)"            \n\t"   \
+    "mulps  "WIN(b)", %%xmm0            \n\t"   \
+    "addps  "BUF(b)", %%xmm0            \n\t"   \
+    "movaps %%xmm0, "OUT(b)"            \n\t"   \
+    "movaps %%xmm4, %%xmm5              \n\t"   \
+    "mulps  "WIN("18+"a)", %%xmm5       \n\t"   \
+    "movaps %%xmm5, "BUF(a)"            \n\t"   \
+    "mulps  "WIN("18+"b)", %%xmm4       \n\t"   \
+    "movaps %%xmm4, "BUF(b)"            \n\t"
+
+#define IMDCT36_OUT(j)                          \
+    "movaps "T("4*"#j"+2")", %%xmm0     \n\t"   \
+    "movaps %%xmm0, %%xmm2              \n\t"   \
+    "addps  "T("4*"#j)", %%xmm0         \n\t"   \
+    "subps  "T("4*"#j)", %%xmm2         \n\t"   \
+    "movaps "T("4*"#j"+3")", %%xmm1     \n\t"   \
+    "movaps %%xmm1, %%xmm3              \n\t"   \
+    "addps  "T("4*"#j"+1")", %%xmm1     \n\t"   \
+    "mulps  "K("9+"#j)", %%xmm1         \n\t"   \
+    "subps  "T("4*"#j"+1")", %%xmm3     \n\t"   \
+    "mulps  "K("14+"#j)", %%xmm3        \n\t"   \
+    "movaps %%xmm0, %%xmm4              \n\t"   \
+    "addps  %%xmm1, %%xmm4              \n\t"   \
+    "subps  %%xmm1, %%xmm0              \n\t"   \
+    WINDOW_OVERLAP("9+"#j, "8-"#j)              \
+    "movaps %%xmm2, %%xmm4              \n\t"   \
+    "addps  %%xmm3, %%xmm4              \n\t"   \
+    "subps  %%xmm3, %%xmm2              \n\t"   \
+    "movaps %%xmm2, %%xmm0              \n\t"   \
+    WINDOW_OVERLAP("17-"#j, #j)
+
+/**
+ * imdct36() of 4 consecutive subbands, one subband per element.
+ * out and buf must be 16-byte aligned, in need not be.
+ * The operations are done in the same order as in the C version, so the
+ * results are identical.
+ */
+static void imdct36_4_sse(float *out, float *buf, const float *in,
+                          const float *win)
+{
+    LOCAL_ALIGNED_16(float, tmp, [36], [4]);
+
+    __asm__ volatile(
+        /* transpose the 18 inputs of the 4 subbands */
+        "movups        (%0), %%xmm0     \n\t"
+        "movups      72(%0), %%xmm1     \n\t"
+        "movups     144(%0), %%xmm2     \n\t"
+        "movups     216(%0), %%xmm3     \n\t"
+        TRANSPOSE4("%%xmm0", "%%xmm1", "%%xmm2", "%%xmm3", "%%xmm4")
+        "movaps    %%xmm0,    (%1)      \n\t"
+        "movaps    %%xmm2,  16(%1)      \n\t"
+        "movaps    %%xmm4,  32(%1)      \n\t"
+        "movaps    %%xmm1,  48(%1)      \n\t"
+        "movups      16(%0), %%xmm0     \n\t"
+        "movups      88(%0), %%xmm1     \n\t"
+        "movups     160(%0), %%xmm2     \n\t"
+        "movups     232(%0), %%xmm3     \n\t"
+        TRANSPOSE4("%%xmm0", "%%xmm1", "%%xmm2", "%%xmm3", "%%xmm4")
+        "movaps    %%xmm0,  64(%1)      \n\t"
+        "movaps    %%xmm2,  80(%1)      \n\t"
+        "movaps    %%xmm4,  96(%1)      \n\t"
+        "movaps    %%xmm1, 112(%1)      \n\t"
+        "movups      32(%0), %%xmm0     \n\t"
+        "movups     104(%0), %%xmm1     \n\t"
+        "movups     176(%0), %%xmm2     \n\t"
+        "movups     248(%0), %%xmm3     \n\t"
+        TRANSPOSE4("%%xmm0", "%%xmm1", "%%xmm2", "%%xmm3", "%%xmm4")
+        "movaps    %%xmm0, 128(%1)      \n\t"
+        "movaps    %%xmm2, 144(%1)      \n\t"
+        "movaps    %%xmm4, 160(%1)      \n\t"
+        "movaps    %%xmm1, 176(%1)      \n\t"
+        "movups      48(%0), %%xmm0     \n\t"
+        "movups     120(%0), %%xmm1     \n\t"
+        "movups     192(%0), %%xmm2     \n\t"
+        "movups     264(%0), %%xmm3     \n\t"
+        TRANSPOSE4("%%xmm0", "%%xmm1", "%%xmm2", "%%xmm3", "%%xmm4")
+        "movaps    %%xmm0, 192(%1)      \n\t"
+        "movaps    %%xmm2, 208(%1)      \n\t"
+        "movaps    %%xmm4, 224(%1)      \n\t"
+        "movaps    %%xmm1, 240(%1)      \n\t"
+        "movlps      64(%0), %%xmm0     \n\t"
+        "movhps     136(%0), %%xmm0     \n\t"
+        "movlps     208(%0), %%xmm1     \n\t"
+        "movhps     280(%0), %%xmm1     \n\t"
+        "movaps    %%xmm0, %%xmm2       \n\t"
+        "shufps $0x88, %%xmm1, %%xmm0   \n\t"
+        "shufps $0xdd, %%xmm1, %%xmm2   \n\t"
+        "movaps    %%xmm0, 256(%1)      \n\t"
+        "movaps    %%xmm2, 272(%1)      \n\t"
+
+        PSUM(17, 16) PSUM(16, 15) PSUM(15, 14) PSUM(14, 13) PSUM(13, 12)
+        PSUM(12, 11) PSUM(11, 10) PSUM(10,  9) PSUM( 9,  8) PSUM( 8,  7)
+        PSUM( 7,  6) PSUM( 6,  5) PSUM( 5,  4) PSUM( 4,  3) PSUM( 3,  2)
+        PSUM( 2,  1) PSUM( 1,  0)
+        PSUM(17, 15) PSUM(15, 13) PSUM(13, 11) PSUM(11,  9) PSUM( 9,  7)
+        PSUM( 7,  5) PSUM( 5,  3) PSUM( 3,  1)
+
+        DCT9(0)
+        DCT9(1)
+        :: "r"(in), "r"(tmp), "r"(imdct36_consts)
+        : "memory"
+          XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4")
+    );
+
+    __asm__ volatile(
+        IMDCT36_OUT(0)
+        IMDCT36_OUT(1)
+        IMDCT36_OUT(2)
+        IMDCT36_OUT(3)
+        "movaps "T("17")", %%xmm1       \n\t"
+        "mulps  "K("13")", %%xmm1       \n\t"
+        "movaps "T("16")", %%xmm0       \n\t"
+        "movaps %%xmm0, %%xmm4          \n\t"
+        "addps  %%xmm1, %%xmm4          \n\t"
+        "subps  %%xmm1, %%xmm0          \n\t"
+        WINDOW_OVERLAP("13", "4")
+        :: "r"(tmp), "r"(out), "r"(buf), "r"(win), "r"(imdct36_consts)
+        : "memory"
+          XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4",
+                         "%xmm5")
+    );
+}
+
+static void imdct36_blocks_sse(float *out, float *buf, float *in,
+                               int count, int switch_point, int block_type)
+{
+    int j;
+
+    for (j = 0; j + 3 < count; j += 4)
+        imdct36_4_sse(out + j, buf + 18 * j, in + 18 * j,
+                      mdct_win_sse[switch_point && !j][block_type][0]);
+    if (j < count)
+        ff_imdct36_blocks_float(out + j, buf + 18 * j, in + 18 * j,
+                                count - j, switch_point && !j, block_type);
+}
+
+/* 8 butterflies of one subband boundary, 4 values of j at once */
+#define ANTIALIAS_4(lo, hi, c0, c1)                     \
+    "movups    "lo"(%0), %%xmm0             \n\t"       \
+    "shufps $0x1b, %%xmm0, %%xmm0           \n\t"       \
+    "movups    "hi"(%0), %%xmm1             \n\t"       \
+    "movaps    %%xmm0, %%xmm2               \n\t"       \
+    "movaps    %%xmm1, %%xmm3               \n\t"       \
+    "mulps     "c0", %%xmm0                 \n\t"       \
+    "mulps     "c1", %%xmm3                 \n\t"       \
+    "subps     %%xmm3, %%xmm0               \n\t"       \
+    "mulps     "c1", %%xmm2                 \n\t"       \
+    "mulps     "c0", %%xmm1                 \n\t"       \
+    "addps     %%xmm2, %%xmm1               \n\t"       \
+    "shufps $0x1b, %%xmm0, %%xmm0           \n\t"       \
+    "movups    %%xmm0, "lo"(%0)             \n\t"       \
+    "movups    %%xmm1, "hi"(%0)             \n\t"
+
+static void antialias_sse(float *ptr, int n, float csa_table[8][4])
+{
+    x86_reg count = n;
+
+    if (n <= 0)
+        return;
+
+    __asm__ volatile(
+        /* csa_table[j][0] and csa_table[j][1] of j = 0..3 and 4..7 */
+        "movups       (%2), %%xmm4          \n\t"
+        "movups     16(%2), %%xmm5          \n\t"
+        "movups     32(%2), %%xmm6          \n\t"
+        "movups     48(%2), %%xmm7          \n\t"
+        TRANSPOSE4("%%xmm4", "%%xmm5", "%%xmm6", "%%xmm7", "%%xmm0")
+        "movups     64(%2), %%xmm0          \n\t"
+        "movups     80(%2), %%xmm5          \n\t"
+        "movups     96(%2), %%xmm1          \n\t"
+        "movups    112(%2), %%xmm7          \n\t"
+        TRANSPOSE4("%%xmm0", "%%xmm5", "%%xmm1", "%%xmm7", "%%xmm2")
+        "movaps    %%xmm0, %%xmm5           \n\t"
+        "movaps    %%xmm1, %%xmm7           \n\t"
+        "1:                                 \n\t"
+        ANTIALIAS_4("-16", "0",  "%%xmm4", "%%xmm6")
+        ANTIALIAS_4("-32", "16", "%%xmm5", "%%xmm7")
+        "add          $72, %0               \n\t"
+        "dec           %1                   \n\t"
+        "jnz 1b                             \n\t"
+        : "+r"(ptr), "+r"(count)
+        : "r"(csa_table)
+        : "memory"
+          XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                         "%xmm4", "%xmm5", "%xmm6", "%xmm7")
+    );
+}
+
 void ff_mpadsp_init_mmx(MPADSPContext *s)
 {
     int mm_flags = av_get_cpu_flags();
+    int i, j, k;
 
     if (mm_flags & AV_CPU_FLAG_SSE2) {
         s->apply_window_float = apply_window_mp3;
     }
+    if (mm_flags & AV_CPU_FLAG_SSE) {
+        for (i = 0; i < 4; i++)
+            for (j = 0; j < 36; j++)
+                for (k = 0; k < 4; k++) {
+                    mdct_win_sse[0][i][j][k] =
+                        ff_mdct_win_float[i + 4 * (k & 1)][j];
+                    mdct_win_sse[1][i][j][k] =
+                        ff_mdct_win_float[(k < 2 ? 0 : i) + 4 * (k & 1)][j];
+                }
+        s->imdct36_blocks_float = imdct36_blocks_sse;
+        s->antialias_float      = antialias_sse;
+    }
 }
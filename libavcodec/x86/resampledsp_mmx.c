@@ -0,0 +1,91 @@
+/*
+ * SSE2 optimized audio resampling
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/cpu.h"
+#include "libavutil/x86_cpu.h"
+#include "libavcodec/resampledsp.h"
+
+/* add the 4 dwords of reg and store the sum in dst */
+#define HSUM_D(reg, tmp, dst)                   \
+    "pshufd $0x4e, "reg", "tmp"         \n\t"   \
+    "paddd   "tmp", "reg"               \n\t"   \
+    "pshufd $0xb1, "reg", "tmp"         \n\t"   \
+    "paddd   "tmp", "reg"               \n\t"   \
+    "movd    "reg", "dst"               \n\t"
+
+/**
+ * The taps are done 8 at a time, 2 channels per pass sharing the
+ * coefficient loads; the remaining taps are done in C. The sums wrap
+ * around like the C version, so the results are identical.
+ */
+static void filter_int16_sse2(int32_t *dst, const int16_t * const *src,
+                              int nb_channels, int offset,
+                              const int16_t *filter, int len)
+{
+    int len8 = len & ~7;
+    int ch, i;
+
+    for (ch = 0; ch < nb_channels; ch += 2) {
+        const int16_t *p0 = src[ch] + offset;
+        const int16_t *p1 = src[ch + (ch + 1 < nb_channels)] + offset;
+        x86_reg j = -2 * len8;
+        int32_t v0, v1;
+
+        __asm__ volatile(
+            "pxor      %%xmm0, %%xmm0       \n\t"
+            "pxor      %%xmm1, %%xmm1       \n\t"
+            "test         %2, %2            \n\t"
+            "jz 2f                          \n\t"
+            "1:                             \n\t"
+            "movdqu   (%5,%2), %%xmm2       \n\t"
+            "movdqu   (%3,%2), %%xmm3       \n\t"
+            "movdqu   (%4,%2), %%xmm4       \n\t"
+            "pmaddwd   %%xmm2, %%xmm3       \n\t"
+            "pmaddwd   %%xmm2, %%xmm4       \n\t"
+            "paddd     %%xmm3, %%xmm0       \n\t"
+            "paddd     %%xmm4, %%xmm1       \n\t"
+            "add          $16, %2           \n\t"
+            "js 1b                          \n\t"
+            "2:                             \n\t"
+            HSUM_D("%%xmm0", "%%xmm2", "%0")
+            HSUM_D("%%xmm1", "%%xmm3", "%1")
+            : "=r"(v0), "=r"(v1), "+r"(j)
+            : "r"(p0 + len8), "r"(p1 + len8), "r"(filter + len8)
+            : "memory"
+              XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4")
+        );
+
+        for (i = len8; i < len; i++) {
+            v0 += p0[i] * (int32_t)filter[i];
+            v1 += p1[i] * (int32_t)filter[i];
+        }
+        dst[ch] = v0;
+        if (ch + 1 < nb_channels)
+            dst[ch + 1] = v1;
+    }
+}
+
+void ff_resampledsp_init_mmx(ResampleDSPContext *c)
+{
+    int mm_flags = av_get_cpu_flags();
+
+    if (mm_flags & AV_CPU_FLAG_SSE2)
+        c->filter_int16 = filter_int16_sse2;
+}
@@ -0,0 +1,350 @@
+/*
+ * SSE optimized SBR DSP functions
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/cpu.h"
+#include "libavutil/mem.h"
+#include "libavutil/x86_cpu.h"
+#include "libavcodec/sbrdsp.h"
+#include "dsputil_mmx.h"
+
+/* Except for sum_square and autocorrelate, which sum in a different order,
+ * these give the same results as the C versions. */
+
+DECLARE_ALIGNED(16, static const uint32_t, ps_neg_odd)[4] =
+    { 0, 0x80000000, 0, 0x80000000 };
+
+static void sbr_sum64x5_sse(float *z)
+{
+    x86_reg i = -256;
+    __asm__ volatile(
+        "1:                             \n\t"
+        "movaps      (%1,%0), %%xmm0    \n\t"
+        "movaps    16(%1,%0), %%xmm1    \n\t"
+        "addps    256(%1,%0), %%xmm0    \n\t"
+        "addps    272(%1,%0), %%xmm1    \n\t"
+        "addps    512(%1,%0), %%xmm0    \n\t"
+        "addps    528(%1,%0), %%xmm1    \n\t"
+        "addps    768(%1,%0), %%xmm0    \n\t"
+        "addps    784(%1,%0), %%xmm1    \n\t"
+        "addps   1024(%1,%0), %%xmm0    \n\t"
+        "addps   1040(%1,%0), %%xmm1    \n\t"
+        "movaps  %%xmm0,   (%1,%0)      \n\t"
+        "movaps  %%xmm1, 16(%1,%0)      \n\t"
+        "add     $32, %0                \n\t"
+        "jl      1b                     \n\t"
+        : "+r"(i)
+        : "r"(z + 64)
+        : "memory"
+          XMM_CLOBBERS(, "%xmm0", "%xmm1")
+    );
+}
+
+static float sbr_sum_square_sse(float (*x)[2], int n)
+{
+    x86_reg i = -8 * (n & ~1);
+    float ret;
+
+    __asm__ volatile(
+        "xorps   %%xmm0, %%xmm0         \n\t"
+        "test    %0, %0                 \n\t"
+        "jz      2f                     \n\t"
+        "1:                             \n\t"
+        "movups  (%2,%0), %%xmm1        \n\t"
+        "mulps   %%xmm1, %%xmm1         \n\t"
+        "addps   %%xmm1, %%xmm0         \n\t"
+        "add     $16, %0                \n\t"
+        "jl      1b                     \n\t"
+        "2:                             \n\t"
+        "movhlps %%xmm0, %%xmm1         \n\t"
+        "addps   %%xmm1, %%xmm0         \n\t"
+        "movaps  %%xmm0, %%xmm1         \n\t"
+        "shufps  $1, %%xmm1, %%xmm1     \n\t"
+        "addss   %%xmm1, %%xmm0         \n\t"
+        "movss   %%xmm0, %1             \n\t"
+        : "+r"(i), "=m"(ret)
+        : "r"(x + (n & ~1))
+        XMM_CLOBBERS_ONLY("%xmm0", "%xmm1")
+    );
+    if (n & 1)
+        ret += x[n - 1][0] * x[n - 1][0] + x[n - 1][1] * x[n - 1][1];
+    return ret;
+}
+
+static void sbr_neg_odd_64_sse(float *x)
+{
+    x86_reg i = -256;
+    __asm__ volatile(
+        "movaps  %2, %%xmm2             \n\t"
+        "1:                             \n\t"
+        "movaps     (%1,%0), %%xmm0     \n\t"
+        "movaps   16(%1,%0), %%xmm1     \n\t"
+        "xorps   %%xmm2, %%xmm0         \n\t"
+        "xorps   %%xmm2, %%xmm1         \n\t"
+        "movaps  %%xmm0,   (%1,%0)      \n\t"
+        "movaps  %%xmm1, 16(%1,%0)      \n\t"
+        "add     $32, %0                \n\t"
+        "jl      1b                     \n\t"
+        : "+r"(i)
+        : "r"(x + 64), "m"(*ps_neg_odd)
+        : "memory"
+          XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2")
+    );
+}
+
+static void sbr_qmf_post_shuffle_sse(float W[32][2], const float *z)
+{
+    x86_reg i = 0;
+    __asm__ volatile(
+        "movaps  %3, %%xmm3             \n\t"
+        "1:                             \n\t"
+        "movaps  240(%1), %%xmm0        \n\t"
+        "movaps     (%1,%0), %%xmm1     \n\t"
+        "shufps  $0x1b, %%xmm0, %%xmm0  \n\t"
+        "xorps   %%xmm3, %%xmm0         \n\t"
+        "movaps  %%xmm0, %%xmm2         \n\t"
+        "unpcklps %%xmm1, %%xmm0        \n\t"
+        "unpckhps %%xmm1, %%xmm2        \n\t"
+        "movaps  %%xmm0,   (%2,%0)      \n\t"
+        "movaps  %%xmm2, 16(%2,%0)      \n\t"
+        "sub     $16, %1                \n\t"
+        "add     $32, %0                \n\t"
+        "cmp     $256, %0               \n\t"
+        "jl      1b                     \n\t"
+        : "+r"(i), "+r"(z)
+        : "r"(W), "m"(*ff_pdw_80000000)
+        : "memory"
+          XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm3")
+    );
+}
+
+static void sbr_qmf_deint_neg_sse(float *v, const float *src)
+{
+    x86_reg i = 0;
+    __asm__ volatile(
+        "movaps  %3, %%xmm4             \n\t"
+        "1:                             \n\t"
+        "movaps  224(%2), %%xmm0        \n\t"
+        "movaps  240(%2), %%xmm1        \n\t"
+        "movaps  %%xmm1, %%xmm2         \n\t"
+        "shufps  $0x77, %%xmm0, %%xmm2  \n\t"
+        "shufps  $0x88, %%xmm1, %%xmm0  \n\t"
+        "xorps   %%xmm4, %%xmm0         \n\t"
+        "movaps  %%xmm2,    (%1,%0)     \n\t"
+        "movaps  %%xmm0, 240(%1)        \n\t"
+        "sub     $32, %2                \n\t"
+        "sub     $16, %1                \n\t"
+        "add     $32, %0                \n\t"
+        "cmp     $256, %0               \n\t"
+        "jl      1b                     \n\t"
+        : "+r"(i), "+r"(v), "+r"(src)
+        : "m"(*ff_pdw_80000000)
+        : "memory"
+          XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm4")
+    );
+}
+
+static void sbr_qmf_deint_bfly_sse(float *v, const float *src0, const float *src1)
+{
+    x86_reg i = 0, j = 240;
+    __asm__ volatile(
+        "1:                             \n\t"
+        "movaps     (%3,%0), %%xmm0     \n\t"
+        "movaps     (%4,%1), %%xmm1     \n\t"
+        "movaps  %%xmm0, %%xmm2         \n\t"
+        "movaps  %%xmm1, %%xmm3         \n\t"
+        "shufps  $0x1b, %%xmm1, %%xmm1  \n\t"
+        "shufps  $0x1b, %%xmm2, %%xmm2  \n\t"
+        "subps   %%xmm1, %%xmm0         \n\t"
+        "addps   %%xmm3, %%xmm2         \n\t"
+        "movaps  %%xmm0,    (%2,%0)     \n\t"
+        "movaps  %%xmm2, 256(%2,%1)     \n\t"
+        "add     $16, %0                \n\t"
+        "sub     $16, %1                \n\t"
+        "jge     1b                     \n\t"
+        : "+r"(i), "+r"(j)
+        : "r"(v), "r"(src0), "r"(src1)
+        : "memory"
+          XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm3")
+    );
+}
+
+static void sbr_hf_gen_sse(float (*X_high)[2], const float (*X_low)[2],
+                           const float alpha0[2], const float alpha1[2],
+                           float bw, int start, int end)
+{
+    DECLARE_ALIGNED(16, float, alpha)[4][4];
+    int end2 = end - ((end - start) & 1);
+    x86_reg i = 8 * (start - end2);
+    float a0 = alpha1[0] * bw * bw;
+    float a1 = alpha1[1] * bw * bw;
+    float a2 = alpha0[0] * bw;
+    float a3 = alpha0[1] * bw;
+
+    /* the imaginary parts need the negated coefficients for the swapped
+     * real/imaginary pairs, matching the subtractions of the C version */
+    alpha[0][0] = alpha[0][1] = alpha[0][2] = alpha[0][3] =  a0;
+    alpha[1][0] = alpha[1][2] = -a1; alpha[1][1] = alpha[1][3] = a1;
+    alpha[2][0] = alpha[2][1] = alpha[2][2] = alpha[2][3] =  a2;
+    alpha[3][0] = alpha[3][2] = -a3; alpha[3][1] = alpha[3][3] = a3;
+
+    if (i < 0)
+    __asm__ volatile(
+        "movaps    (%3), %%xmm0         \n\t"
+        "movaps  16(%3), %%xmm1         \n\t"
+        "movaps  32(%3), %%xmm2         \n\t"
+        "movaps  48(%3), %%xmm3         \n\t"
+        "1:                             \n\t"
+        "movups  -16(%2,%0), %%xmm4     \n\t"
+        "movups   -8(%2,%0), %%xmm5     \n\t"
+        "movaps  %%xmm4, %%xmm6         \n\t"
+        "shufps  $0xb1, %%xmm6, %%xmm6  \n\t"
+        "mulps   %%xmm0, %%xmm4         \n\t"
+        "mulps   %%xmm1, %%xmm6         \n\t"
+        "addps   %%xmm6, %%xmm4         \n\t"
+        "movaps  %%xmm5, %%xmm6         \n\t"
+        "shufps  $0xb1, %%xmm6, %%xmm6  \n\t"
+        "mulps   %%xmm2, %%xmm5         \n\t"
+        "addps   %%xmm5, %%xmm4         \n\t"
+        "mulps   %%xmm3, %%xmm6         \n\t"
+        "addps   %%xmm6, %%xmm4         \n\t"
+        "movups     (%2,%0), %%xmm5     \n\t"
+        "addps   %%xmm5, %%xmm4         \n\t"
+        "movups  %%xmm4, (%1,%0)        \n\t"
+        "add     $16, %0                \n\t"
+        "jl      1b                     \n\t"
+        : "+r"(i)
+        : "r"(X_high + end2), "r"(X_low + end2), "r"(alpha)
+        : "memory"
+          XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                         "%xmm4", "%xmm5", "%xmm6")
+    );
+
+    if (end2 < end) {
+        X_high[end2][0] =
+            X_low[end2 - 2][0] * a0 -
+            X_low[end2 - 2][1] * a1 +
+            X_low[end2 - 1][0] * a2 -
+            X_low[end2 - 1][1] * a3 +
+            X_low[end2][0];
+        X_high[end2][1] =
+            X_low[end2 - 2][1] * a0 +
+            X_low[end2 - 2][0] * a1 +
+            X_low[end2 - 1][1] * a2 +
+            X_low[end2 - 1][0] * a3 +
+            X_low[end2][1];
+    }
+}
+
+static void sbr_hf_g_filt_sse(float (*Y)[2], const float (*X_high)[40][2],
+                              const float *g_filt, int m_max, intptr_t ixh)
+{
+    const float (*x)[2] = X_high[0] + ixh;
+    x86_reg i = -4 * (m_max & ~1);
+
+    if (i < 0)
+    __asm__ volatile(
+        "1:                             \n\t"
+        "movlps     (%1), %%xmm0        \n\t"
+        "movhps  320(%1), %%xmm0        \n\t"
+        "movlps  (%3,%0), %%xmm1        \n\t"
+        "unpcklps %%xmm1, %%xmm1        \n\t"
+        "mulps   %%xmm1, %%xmm0         \n\t"
+        "movups  %%xmm0, (%2,%0,2)      \n\t"
+        "add     $640, %1               \n\t"
+        "add     $8, %0                 \n\t"
+        "jl      1b                     \n\t"
+        : "+r"(i), "+r"(x)
+        : "r"(Y + (m_max & ~1)), "r"(g_filt + (m_max & ~1))
+        : "memory"
+          XMM_CLOBBERS(, "%xmm0", "%xmm1")
+    );
+    if (m_max & 1) {
+        Y[m_max - 1][0] = x[0][0] * g_filt[m_max - 1];
+        Y[m_max - 1][1] = x[0][1] * g_filt[m_max - 1];
+    }
+}
+
+static void sbr_autocorrelate_sse(const float x[40][2], float phi[3][2][2])
+{
+    DECLARE_ALIGNED(16, float, sums)[3][4];
+    float real_sum0, real_sum1, imag_sum1, real_sum2, imag_sum2;
+    x86_reg i = -37 * 8;
+
+    __asm__ volatile(
+        "xorps   %%xmm0, %%xmm0         \n\t"
+        "xorps   %%xmm1, %%xmm1         \n\t"
+        "xorps   %%xmm2, %%xmm2         \n\t"
+        "1:                             \n\t"
+        "movlps    (%1,%0), %%xmm3      \n\t"
+        "movups   8(%1,%0), %%xmm4      \n\t"
+        "movlhps %%xmm3, %%xmm3         \n\t"
+        "movaps  %%xmm3, %%xmm5         \n\t"
+        "mulps   %%xmm3, %%xmm5         \n\t"
+        "addps   %%xmm5, %%xmm0         \n\t"
+        "movaps  %%xmm4, %%xmm5         \n\t"
+        "shufps  $0xb1, %%xmm5, %%xmm5  \n\t"
+        "mulps   %%xmm3, %%xmm4         \n\t"
+        "mulps   %%xmm3, %%xmm5         \n\t"
+        "addps   %%xmm4, %%xmm1         \n\t"
+        "addps   %%xmm5, %%xmm2         \n\t"
+        "add     $8, %0                 \n\t"
+        "jl      1b                     \n\t"
+        "movaps  %%xmm0,   (%2)         \n\t"
+        "movaps  %%xmm1, 16(%2)         \n\t"
+        "movaps  %%xmm2, 32(%2)         \n\t"
+        : "+r"(i)
+        : "r"(x[38]), "r"(sums)
+        : "memory"
+          XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                         "%xmm4", "%xmm5")
+    );
+
+    real_sum0 = sums[0][0] + sums[0][1];
+    real_sum1 = sums[1][0] + sums[1][1];
+    imag_sum1 = sums[2][0] - sums[2][1];
+    real_sum2 = sums[1][2] + sums[1][3];
+    imag_sum2 = sums[2][2] - sums[2][3];
+
+    phi[2][1][0] = real_sum0 + x[ 0][0] * x[ 0][0] + x[ 0][1] * x[ 0][1];
+    phi[1][0][0] = real_sum0 + x[38][0] * x[38][0] + x[38][1] * x[38][1];
+    phi[1][1][0] = real_sum1 + x[ 0][0] * x[ 1][0] + x[ 0][1] * x[ 1][1];
+    phi[1][1][1] = imag_sum1 + x[ 0][0] * x[ 1][1] - x[ 0][1] * x[ 1][0];
+    phi[0][0][0] = real_sum1 + x[38][0] * x[39][0] + x[38][1] * x[39][1];
+    phi[0][0][1] = imag_sum1 + x[38][0] * x[39][1] - x[38][1] * x[39][0];
+    phi[0][1][0] = real_sum2 + x[ 0][0] * x[ 2][0] + x[ 0][1] * x[ 2][1];
+    phi[0][1][1] = imag_sum2 + x[ 0][0] * x[ 2][1] - x[ 0][1] * x[ 2][0];
+}
+
+void ff_sbrdsp_init_mmx(SBRDSPContext *s)
+{
+    int mm_flags = av_get_cpu_flags();
+
+    if (mm_flags & AV_CPU_FLAG_SSE) {
+        s->sum64x5          = sbr_sum64x5_sse;
+        s->sum_square       = sbr_sum_square_sse;
+        s->neg_odd_64       = sbr_neg_odd_64_sse;
+        s->qmf_post_shuffle = sbr_qmf_post_shuffle_sse;
+        s->qmf_deint_neg    = sbr_qmf_deint_neg_sse;
+        s->qmf_deint_bfly   = sbr_qmf_deint_bfly_sse;
+        s->autocorrelate    = sbr_autocorrelate_sse;
+        s->hf_gen           = sbr_hf_gen_sse;
+        s->hf_g_filt        = sbr_hf_g_filt_sse;
+    }
+}
@@ -0,0 +1,384 @@
+/*
+ * Simple IDCT SSE2
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * SSE2 version of the simple idct, bitexact with the C one.
+ *
+ * The input is transposed (FF_TRANSPOSE_IDCT_PERM), so that each register
+ * holds one coefficient of all 8 rows and the row pass works on 4 rows at
+ * a time in 32 bit precision. The row pass leaves the coefficient pairs
+ * (r, r + 4) of each column packed in one dword; transposing 4x4 dwords
+ * of those gives the inputs of the column pass for 4 columns.
+ * Rows with only a DC coefficient are special cased in the C version; this
+ * is reproduced by adding the DC coefficient of these rows to the rounder.
+ */
+
+#include "libavutil/common.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/x86_cpu.h"
+#include "libavcodec/dsputil.h"
+#include "libavcodec/simple_idct.h"
+#include "dsputil_mmx.h"
+
+#define W1 22725 //cos(i*M_PI/16)*sqrt(2)*(1<<14) + 0.5
+#define W2 21407 //cos(i*M_PI/16)*sqrt(2)*(1<<14) + 0.5
+#define W3 19266 //cos(i*M_PI/16)*sqrt(2)*(1<<14) + 0.5
+#define W4 16383 //cos(i*M_PI/16)*sqrt(2)*(1<<14) - 0.5
+#define W5 12873 //cos(i*M_PI/16)*sqrt(2)*(1<<14) + 0.5
+#define W6 8867  //cos(i*M_PI/16)*sqrt(2)*(1<<14) + 0.5
+#define W7 4520  //cos(i*M_PI/16)*sqrt(2)*(1<<14) + 0.5
+
+#define ROW_SHIFT 11
+#define COL_SHIFT 20
+
+#define PAIR(a, b) a, b, a, b, a, b, a, b
+#define X4(x)      x, x, x, x
+
+/* coefficients for the pairs (0, 4), (2, 6), (1, 5) and (3, 7) */
+DECLARE_ASM_CONST(16, int16_t, w4_w4)[]   = { PAIR( W4,  W4) };
+DECLARE_ASM_CONST(16, int16_t, w4_mw4)[]  = { PAIR( W4, -W4) };
+DECLARE_ASM_CONST(16, int16_t, w2_w6)[]   = { PAIR( W2,  W6) };
+DECLARE_ASM_CONST(16, int16_t, w6_mw2)[]  = { PAIR( W6, -W2) };
+DECLARE_ASM_CONST(16, int16_t, w1_w5)[]   = { PAIR( W1,  W5) };
+DECLARE_ASM_CONST(16, int16_t, w3_w7)[]   = { PAIR( W3,  W7) };
+DECLARE_ASM_CONST(16, int16_t, w3_mw1)[]  = { PAIR( W3, -W1) };
+DECLARE_ASM_CONST(16, int16_t, mw7_mw5)[] = { PAIR(-W7, -W5) };
+DECLARE_ASM_CONST(16, int16_t, w5_w7)[]   = { PAIR( W5,  W7) };
+DECLARE_ASM_CONST(16, int16_t, mw1_w3)[]  = { PAIR(-W1,  W3) };
+DECLARE_ASM_CONST(16, int16_t, w7_w3)[]   = { PAIR( W7,  W3) };
+DECLARE_ASM_CONST(16, int16_t, mw5_mw1)[] = { PAIR(-W5, -W1) };
+
+DECLARE_ASM_CONST(16, int32_t, row_rnd)[] = { X4(1 << (ROW_SHIFT - 1)) };
+/* same as W4 * (col[0] + ((1 << (COL_SHIFT - 1)) / W4)) in the C version */
+DECLARE_ASM_CONST(16, int32_t, col_rnd)[] = { X4(W4 * ((1 << (COL_SHIFT - 1)) / W4)) };
+DECLARE_ASM_CONST(16, uint32_t, hi_words)[] = { X4(0xFFFF0000) };
+
+/*
+ * %0 is the block, %1 a 16 byte aligned temporary of 80 coefficients:
+ * 8 rows of intermediate results followed by 2 rows of row pass rounders.
+ */
+
+/* rounders of the row pass for rows 0-3 and 4-7 */
+#define ROW_ROUNDERS                                                    \
+    "movdqa    16(%0), %%xmm0           \n\t"                           \
+    "por       32(%0), %%xmm0           \n\t"                           \
+    "por       48(%0), %%xmm0           \n\t"                           \
+    "por       64(%0), %%xmm0           \n\t"                           \
+    "por       80(%0), %%xmm0           \n\t"                           \
+    "por       96(%0), %%xmm0           \n\t"                           \
+    "por      112(%0), %%xmm0           \n\t"                           \
+    "pxor      %%xmm1, %%xmm1           \n\t"                           \
+    "pcmpeqw   %%xmm1, %%xmm0           \n\t" /* rows with only a DC */ \
+    "pand        (%0), %%xmm0           \n\t"                           \
+    "movdqa    %%xmm0, %%xmm1           \n\t"                           \
+    "punpcklwd %%xmm0, %%xmm0           \n\t"                           \
+    "punpckhwd %%xmm1, %%xmm1           \n\t"                           \
+    "psrad        $16, %%xmm0           \n\t"                           \
+    "psrad        $16, %%xmm1           \n\t"                           \
+    "paddd "MANGLE(row_rnd)", %%xmm0    \n\t"                           \
+    "paddd "MANGLE(row_rnd)", %%xmm1    \n\t"                           \
+    "movdqa    %%xmm0, 128(%1)          \n\t"                           \
+    "movdqa    %%xmm1, 144(%1)          \n\t"
+
+/*
+ * in:  xmm0 = pairs (0, 4), xmm1 = pairs (2, 6)
+ * out: xmm4 = a0, xmm0 = a1, xmm5 = a2, xmm6 = a3
+ */
+#define IDCT_EVEN(rnd)                                                  \
+    "movdqa    %%xmm0, %%xmm4           \n\t"                           \
+    "pmaddwd "MANGLE(w4_w4)", %%xmm4    \n\t"                           \
+    "pmaddwd "MANGLE(w4_mw4)", %%xmm0   \n\t"                           \
+    "paddd      " rnd ", %%xmm4         \n\t"                           \
+    "paddd      " rnd ", %%xmm0         \n\t"                           \
+    "movdqa    %%xmm1, %%xmm5           \n\t"                           \
+    "pmaddwd "MANGLE(w2_w6)", %%xmm5    \n\t"                           \
+    "pmaddwd "MANGLE(w6_mw2)", %%xmm1   \n\t"                           \
+    "movdqa    %%xmm4, %%xmm6           \n\t"                           \
+    "paddd     %%xmm5, %%xmm4           \n\t"                           \
+    "psubd     %%xmm5, %%xmm6           \n\t"                           \
+    "movdqa    %%xmm0, %%xmm5           \n\t"                           \
+    "paddd     %%xmm1, %%xmm0           \n\t"                           \
+    "psubd     %%xmm1, %%xmm5           \n\t"
+
+/*
+ * in:  xmm2 = pairs (1, 5), xmm3 = pairs (3, 7), a = ai
+ * out: a = ai + bi, xmm7 = ai - bi
+ */
+#define IDCT_ODD(a, c15, c37)                                           \
+    "movdqa    %%xmm2, %%xmm1           \n\t"                           \
+    "movdqa    %%xmm3, %%xmm7           \n\t"                           \
+    "pmaddwd "MANGLE(c15)", %%xmm1      \n\t"                           \
+    "pmaddwd "MANGLE(c37)", %%xmm7      \n\t"                           \
+    "paddd     %%xmm7, %%xmm1           \n\t"                           \
+    "movdqa      " a ", %%xmm7          \n\t"                           \
+    "paddd     %%xmm1, " a "            \n\t"                           \
+    "psubd     %%xmm1, %%xmm7           \n\t"
+
+#define IDCT_ODDS(store)                                                \
+    IDCT_ODD("%%xmm4", w1_w5,  w3_w7)   store("%%xmm4", 0)              \
+    IDCT_ODD("%%xmm0", w3_mw1, mw7_mw5) store("%%xmm0", 1)              \
+    IDCT_ODD("%%xmm5", w5_w7,  mw1_w3)  store("%%xmm5", 2)              \
+    IDCT_ODD("%%xmm6", w7_w3,  mw5_mw1) store("%%xmm6", 3)
+
+/* The results of the row pass are truncated to 16 bits like in C. Rows
+ * 0-3 go to the low, rows 4-7 to the high words of the dwords. */
+#define STORE_ROW_LO(reg, off)                                          \
+    "pslld         $5, " reg "          \n\t"                           \
+    "psrld        $16, " reg "          \n\t"                           \
+    "movdqa     " reg ", " #off "(%1)   \n\t"
+
+#define STORE_ROW_HI(reg, off)                                          \
+    "pslld         $5, " reg "          \n\t"                           \
+    "pand "MANGLE(hi_words)", " reg "   \n\t"                           \
+    "por     " #off "(%1), " reg "      \n\t"                           \
+    "movdqa     " reg ", " #off "(%1)   \n\t"
+
+#define STORE_ROWS_LO(reg, i)                                           \
+    STORE_ROW_LO(reg, 16 * i)                                           \
+    STORE_ROW_LO("%%xmm7", 16 * (7 - i))
+
+#define STORE_ROWS_HI(reg, i)                                           \
+    STORE_ROW_HI(reg, 16 * i)                                           \
+    STORE_ROW_HI("%%xmm7", 16 * (7 - i))
+
+#define ROW_IDCT(unpck, rnd, store)                                     \
+    "movdqa      (%0), %%xmm0           \n\t"                           \
+    "movdqa    32(%0), %%xmm1           \n\t"                           \
+    "movdqa    16(%0), %%xmm2           \n\t"                           \
+    "movdqa    48(%0), %%xmm3           \n\t"                           \
+    unpck "    64(%0), %%xmm0           \n\t"                           \
+    unpck "    96(%0), %%xmm1           \n\t"                           \
+    unpck "    80(%0), %%xmm2           \n\t"                           \
+    unpck "   112(%0), %%xmm3           \n\t"                           \
+    IDCT_EVEN(rnd)                                                      \
+    IDCT_ODDS(store)
+
+/* Column results: rows i and 7 - i of the 4 columns are stored together. */
+#define STORE_COLS(reg, i)                                              \
+    "psrad        $20, " reg "          \n\t"                           \
+    "psrad        $20, %%xmm7           \n\t"                           \
+    "packssdw  %%xmm7, " reg "          \n\t"                           \
+    "movdqa     " reg ", 16 * " #i "(%1)\n\t"
+
+#define STORE_COLS_LO(reg, i) STORE_COLS(reg, i)
+#define STORE_COLS_HI(reg, i) STORE_COLS(reg, (4 + i))
+
+#define COL_IDCT(off, store)                                            \
+    "movdqa    " #off "(%1), %%xmm0     \n\t"                           \
+    "movdqa    %%xmm0, %%xmm1           \n\t"                           \
+    "punpckldq 16+" #off "(%1), %%xmm0  \n\t"                           \
+    "punpckhdq 16+" #off "(%1), %%xmm1  \n\t"                           \
+    "movdqa    32+" #off "(%1), %%xmm4  \n\t"                           \
+    "movdqa    %%xmm4, %%xmm5           \n\t"                           \
+    "punpckldq 48+" #off "(%1), %%xmm4  \n\t"                           \
+    "punpckhdq 48+" #off "(%1), %%xmm5  \n\t"                           \
+    "movdqa    %%xmm0, %%xmm2           \n\t"                           \
+    "punpcklqdq %%xmm4, %%xmm0          \n\t"                           \
+    "punpckhqdq %%xmm4, %%xmm2          \n\t"                           \
+    "movdqa    %%xmm1, %%xmm3           \n\t"                           \
+    "punpcklqdq %%xmm5, %%xmm1          \n\t"                           \
+    "punpckhqdq %%xmm5, %%xmm3          \n\t"                           \
+    IDCT_EVEN(MANGLE(col_rnd))                                          \
+    IDCT_ODDS(store)
+
+#define IDCT                                                            \
+    ROW_ROUNDERS                                                        \
+    ROW_IDCT("punpcklwd", "128(%1)", STORE_ROWS_LO)                     \
+    ROW_IDCT("punpckhwd", "144(%1)", STORE_ROWS_HI)                     \
+    COL_IDCT( 0, STORE_COLS_LO)                                         \
+    COL_IDCT(64, STORE_COLS_HI)
+
+#define IDCT_CLOBBERS                                                   \
+    XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3",                    \
+                 "%xmm4", "%xmm5", "%xmm6", "%xmm7",) "memory"
+
+static av_always_inline void idct(int16_t *block, int16_t *temp)
+{
+    __asm__ volatile(
+        IDCT
+        :: "r"(block), "r"(temp)
+        : IDCT_CLOBBERS
+    );
+}
+
+/*
+ * The output is written from the outer rows inwards, %0 points to row i,
+ * %1 to row 7 - i, %2 is the temporary and %3 the line size.
+ * xmm0 = row i, xmm1 = row 7 - i
+ */
+#define LOAD_ROWS(i)                                                    \
+    "movdqa    16 * " #i "(%2), %%xmm0  \n\t"                           \
+    "movdqa    %%xmm0, %%xmm1           \n\t"                           \
+    "punpcklqdq 16 * (4 + " #i ")(%2), %%xmm0 \n\t"                     \
+    "punpckhqdq 16 * (4 + " #i ")(%2), %%xmm1 \n\t"
+
+#define NEXT_ROWS                                                       \
+    "add       %3, %0                   \n\t"                           \
+    "sub       %3, %1                   \n\t"
+
+#define STORE_BLOCK(i)                                                  \
+    LOAD_ROWS(i)                                                        \
+    "movdqa    %%xmm0, (%0)             \n\t"                           \
+    "movdqa    %%xmm1, (%1)             \n\t"                           \
+    NEXT_ROWS
+
+#define PUT_PIXELS(i)                                                   \
+    LOAD_ROWS(i)                                                        \
+    "packuswb  %%xmm1, %%xmm0           \n\t"                           \
+    "movq      %%xmm0, (%0)             \n\t"                           \
+    "movhps    %%xmm0, (%1)             \n\t"                           \
+    NEXT_ROWS
+
+#define ADD_PIXELS(i)                                                   \
+    LOAD_ROWS(i)                                                        \
+    "movq      (%0), %%xmm2             \n\t"                           \
+    "movq      (%1), %%xmm3             \n\t"                           \
+    "punpcklbw %%xmm7, %%xmm2           \n\t"                           \
+    "punpcklbw %%xmm7, %%xmm3           \n\t"                           \
+    "paddsw    %%xmm2, %%xmm0           \n\t"                           \
+    "paddsw    %%xmm3, %%xmm1           \n\t"                           \
+    "packuswb  %%xmm1, %%xmm0           \n\t"                           \
+    "movq      %%xmm0, (%0)             \n\t"                           \
+    "movhps    %%xmm0, (%1)             \n\t"                           \
+    NEXT_ROWS
+
+/* add xmm0 to 2 rows, %0 points to the first one and %1 is the line size */
+#define ADD_DC                                                          \
+    "movq      (%0), %%xmm1             \n\t"                           \
+    "movq      (%0, %1), %%xmm2         \n\t"                           \
+    "punpcklbw %%xmm7, %%xmm1           \n\t"                           \
+    "punpcklbw %%xmm7, %%xmm2           \n\t"                           \
+    "paddsw    %%xmm0, %%xmm1           \n\t"                           \
+    "paddsw    %%xmm0, %%xmm2           \n\t"                           \
+    "packuswb  %%xmm2, %%xmm1           \n\t"                           \
+    "movq      %%xmm1, (%0)             \n\t"                           \
+    "movhps    %%xmm1, (%0, %1)         \n\t"                           \
+    "lea       (%0, %1, 2), %0          \n\t"
+
+void ff_simple_idct_sse2(int16_t *block)
+{
+    LOCAL_ALIGNED_16(int16_t, temp, [80]);
+    int16_t *row = block, *row7 = block + 7 * 8;
+
+    idct(block, temp);
+    __asm__ volatile(
+        STORE_BLOCK(0)
+        STORE_BLOCK(1)
+        STORE_BLOCK(2)
+        STORE_BLOCK(3)
+        : "+r"(row), "+r"(row7)
+        : "r"(temp), "r"((x86_reg)16)
+        : XMM_CLOBBERS("%xmm0", "%xmm1",) "memory"
+    );
+}
+
+/**
+ * Check for blocks with only a DC coefficient, these are frequent in inter
+ * frames and result in 64 times the same value.
+ * @return the value of the output samples or INT_MIN
+ */
+static av_always_inline int dc_only(const int16_t *block)
+{
+    int mask;
+
+    __asm__ volatile(
+        "movdqa      (%1), %%xmm0           \n\t"
+        "psrldq        $2, %%xmm0           \n\t"
+        "por       16(%1), %%xmm0           \n\t"
+        "por       32(%1), %%xmm0           \n\t"
+        "por       48(%1), %%xmm0           \n\t"
+        "por       64(%1), %%xmm0           \n\t"
+        "por       80(%1), %%xmm0           \n\t"
+        "por       96(%1), %%xmm0           \n\t"
+        "por      112(%1), %%xmm0           \n\t"
+        "pxor      %%xmm1, %%xmm1           \n\t"
+        "pcmpeqb   %%xmm1, %%xmm0           \n\t"
+        "pmovmskb  %%xmm0, %0               \n\t"
+        : "=r"(mask)
+        : "r"(block)
+        : XMM_CLOBBERS("%xmm0", "%xmm1",) "memory"
+    );
+    if (mask != 0xFFFF)
+        return INT_MIN;
+    /* the row pass of the C version truncates the DC to 16 bits */
+    return (W4 * ((int16_t)(block[0] << 3) + (1 << (COL_SHIFT - 1)) / W4)) >> COL_SHIFT;
+}
+
+void ff_simple_idct_put_sse2(uint8_t *dest, int line_size, int16_t *block)
+{
+    LOCAL_ALIGNED_16(int16_t, temp, [80]);
+    uint8_t *dest7 = dest + 7 * line_size;
+    int dc = dc_only(block);
+
+    if (dc != INT_MIN) {
+        uint64_t v = 0x0101010101010101ULL * av_clip_uint8(dc);
+        int i;
+
+        for (i = 0; i < 8; i++)
+            AV_WN64A(dest + i * line_size, v);
+        return;
+    }
+    idct(block, temp);
+    __asm__ volatile(
+        PUT_PIXELS(0)
+        PUT_PIXELS(1)
+        PUT_PIXELS(2)
+        PUT_PIXELS(3)
+        : "+r"(dest), "+r"(dest7)
+        : "r"(temp), "r"((x86_reg)line_size)
+        : XMM_CLOBBERS("%xmm0", "%xmm1",) "memory"
+    );
+}
+
+void ff_simple_idct_add_sse2(uint8_t *dest, int line_size, int16_t *block)
+{
+    LOCAL_ALIGNED_16(int16_t, temp, [80]);
+    uint8_t *dest7 = dest + 7 * line_size;
+    int dc = dc_only(block);
+
+    if (dc != INT_MIN) {
+        __asm__ volatile(
+            "movd          %2, %%xmm0           \n\t"
+            "pshuflw   $0, %%xmm0, %%xmm0       \n\t"
+            "punpcklqdq %%xmm0, %%xmm0          \n\t"
+            "pxor      %%xmm7, %%xmm7           \n\t"
+            ADD_DC
+            ADD_DC
+            ADD_DC
+            ADD_DC
+            : "+r"(dest)
+            : "r"((x86_reg)line_size), "r"(dc)
+            : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm7",) "memory"
+        );
+        return;
+    }
+    idct(block, temp);
+    __asm__ volatile(
+        "pxor      %%xmm7, %%xmm7           \n\t"
+        ADD_PIXELS(0)
+        ADD_PIXELS(1)
+        ADD_PIXELS(2)
+        ADD_PIXELS(3)
+        : "+r"(dest), "+r"(dest7)
+        : "r"(temp), "r"((x86_reg)line_size)
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm7",) "memory"
+    );
+}
@@ -41,15 +41,13 @@ static void ff_snow_horizontal_compose97i_sse2(IDWTELEM *b, int width){
         // calculate b[0] correctly afterwards.
 
         i = 0;
-        __asm__ volatile(
-            "pcmpeqd   %%xmm7, %%xmm7         \n\t"
-            "pcmpeqd   %%xmm3, %%xmm3         \n\t"
-            "psllw         $1, %%xmm3         \n\t"
-            "paddw     %%xmm7, %%xmm3         \n\t"
-            "psllw        $13, %%xmm3         \n\t"
-        ::);
         for(; i<w_l-15; i+=16){
             __asm__ volatile(
+                "pcmpeqd %%xmm7, %%xmm7       \n\t"
+                "pcmpeqd %%xmm3, %%xmm3       \n\t"
+                "psllw      $1, %%xmm3        \n\t"
+                "paddw  %%xmm7, %%xmm3        \n\t"
+                "psllw     $13, %%xmm3        \n\t"
                 "movdqu   (%1), %%xmm1        \n\t"
                 "movdqu 16(%1), %%xmm5        \n\t"
                 "movdqu  2(%1), %%xmm2        \n\t"
@@ -105,14 +103,13 @@ static void ff_snow_horizontal_compose97i_sse2(IDWTELEM *b, int width){
         IDWTELEM b_0 = b[0];
 
         i = 0;
-        __asm__ volatile(
-            "psllw         $15, %%xmm7        \n\t"
-            "pcmpeqw    %%xmm6, %%xmm6        \n\t"
-            "psrlw         $13, %%xmm6        \n\t"
-            "paddw      %%xmm7, %%xmm6        \n\t"
-        ::);
         for(; i<w_l-15; i+=16){
             __asm__ volatile(
+                "pcmpeqw %%xmm7, %%xmm7       \n\t"
+                "psllw     $15, %%xmm7        \n\t"
+                "pcmpeqw %%xmm6, %%xmm6       \n\t"
+                "psrlw     $13, %%xmm6        \n\t"
+                "paddw  %%xmm7, %%xmm6        \n\t"
                 "movdqu   (%1), %%xmm0        \n\t"
                 "movdqu 16(%1), %%xmm4        \n\t"
                 "movdqu  2(%1), %%xmm1        \n\t"
@@ -142,7 +139,7 @@ static void ff_snow_horizontal_compose97i_sse2(IDWTELEM *b, int width){
             );
         }
         snow_horizontal_compose_liftS_lead_out(i, b, b, ref, width, w_l);
-        b[0] = b_0 + ((2 * ref[1] + W_BO-1 + 4 * b_0) >> W_BS);
+        b[0] = b_0 + ((2 * ref[1] + W_BO + 4 * b_0) >> W_BS);
     }
 
     { // Lift 3
@@ -150,9 +147,9 @@ static void ff_snow_horizontal_compose97i_sse2(IDWTELEM *b, int width){
 
         i = 0;
         for(; (((x86_reg)&temp[i]) & 0x1F) && i<w_r; i++){
-            temp[i] = src[i] - ((-W_AM*(b[i] + b[i+1]))>>W_AS);
+            temp[i] = src[i] - ((-W_AM*(b[i] + b[i+1]) + W_AO+1)>>W_AS);
         }
-        for(; i<w_r-7; i+=8){
+        for(; i<w_r-15; i+=16){
             __asm__ volatile(
                 "movdqu  2(%1), %%xmm2        \n\t"
                 "movdqu 18(%1), %%xmm6        \n\t"
@@ -454,10 +451,8 @@ static void ff_snow_vertical_compose97i_sse2(IDWTELEM *b0, IDWTELEM *b1, IDWTELE
          __asm__ volatile (
         "jmp 2f                                      \n\t"
         "1:                                          \n\t"
-        snow_vertical_compose_sse2_load("%4","xmm0","xmm2","xmm4","xmm6")
-        snow_vertical_compose_sse2_add("%6","xmm0","xmm2","xmm4","xmm6")
-
-
+        snow_vertical_compose_sse2_load("%4","xmm1","xmm3","xmm5","xmm7")
+        snow_vertical_compose_sse2_add("%6","xmm1","xmm3","xmm5","xmm7")
         "pcmpeqw    %%xmm0, %%xmm0                   \n\t"
         "pcmpeqw    %%xmm2, %%xmm2                   \n\t"
         "paddw      %%xmm2, %%xmm2                   \n\t"
@@ -478,14 +473,14 @@ static void ff_snow_vertical_compose97i_sse2(IDWTELEM *b0, IDWTELEM *b1, IDWTELE
         "psrlw $13, %%xmm5                           \n\t"
         "paddw %%xmm7, %%xmm5                        \n\t"
         snow_vertical_compose_r2r_add("xmm5","xmm5","xmm5","xmm5","xmm0","xmm2","xmm4","xmm6")
-        "movq   (%2,%%"REG_d"), %%xmm1        \n\t"
-        "movq  8(%2,%%"REG_d"), %%xmm3        \n\t"
+        "movdqa   (%2,%%"REG_d"), %%xmm1             \n\t"
+        "movdqa 16(%2,%%"REG_d"), %%xmm3             \n\t"
         "paddw %%xmm7, %%xmm1                        \n\t"
         "paddw %%xmm7, %%xmm3                        \n\t"
         "pavgw %%xmm1, %%xmm0                        \n\t"
         "pavgw %%xmm3, %%xmm2                        \n\t"
-        "movq 16(%2,%%"REG_d"), %%xmm1        \n\t"
-        "movq 24(%2,%%"REG_d"), %%xmm3        \n\t"
+        "movdqa 32(%2,%%"REG_d"), %%xmm1             \n\t"
+        "movdqa 48(%2,%%"REG_d"), %%xmm3             \n\t"
         "paddw %%xmm7, %%xmm1                        \n\t"
         "paddw %%xmm7, %%xmm3                        \n\t"
         "pavgw %%xmm1, %%xmm4                        \n\t"
@@ -696,42 +691,24 @@ snow_inner_add_yblock_sse2_accum_8("1", "128")
 snow_inner_add_yblock_sse2_accum_8("0", "136")
 
              "mov %0, %%"REG_d"              \n\t"
-             "movdqa (%%"REG_D"), %%xmm0     \n\t"
-             "movdqa %%xmm1, %%xmm2          \n\t"
-
-             "punpckhwd %%xmm7, %%xmm1       \n\t"
-             "punpcklwd %%xmm7, %%xmm2       \n\t"
-             "paddd %%xmm2, %%xmm0           \n\t"
-             "movdqa 16(%%"REG_D"), %%xmm2   \n\t"
-             "paddd %%xmm1, %%xmm2           \n\t"
-             "paddd %%xmm3, %%xmm0           \n\t"
-             "paddd %%xmm3, %%xmm2           \n\t"
+             "psrlw $4, %%xmm1               \n\t"
+             "psrlw $4, %%xmm5               \n\t"
+             "movdqu (%%"REG_D"), %%xmm0     \n\t"
+             "paddw %%xmm0, %%xmm1           \n\t"
 
              "mov %1, %%"REG_D"              \n\t"
              "mov "PTR_SIZE"(%%"REG_D"), %%"REG_D";\n\t"
              "add %3, %%"REG_D"              \n\t"
 
-             "movdqa (%%"REG_D"), %%xmm4     \n\t"
-             "movdqa %%xmm5, %%xmm6          \n\t"
-             "punpckhwd %%xmm7, %%xmm5       \n\t"
-             "punpcklwd %%xmm7, %%xmm6       \n\t"
-             "paddd %%xmm6, %%xmm4           \n\t"
-             "movdqa 16(%%"REG_D"), %%xmm6   \n\t"
-             "paddd %%xmm5, %%xmm6           \n\t"
-             "paddd %%xmm3, %%xmm4           \n\t"
-             "paddd %%xmm3, %%xmm6           \n\t"
-
-             "psrad $8, %%xmm0               \n\t" /* FRAC_BITS. */
-             "psrad $8, %%xmm2               \n\t" /* FRAC_BITS. */
-             "packssdw %%xmm2, %%xmm0        \n\t"
-             "packuswb %%xmm7, %%xmm0        \n\t"
-             "movq %%xmm0, (%%"REG_d")       \n\t"
-
-             "psrad $8, %%xmm4               \n\t" /* FRAC_BITS. */
-             "psrad $8, %%xmm6               \n\t" /* FRAC_BITS. */
-             "packssdw %%xmm6, %%xmm4        \n\t"
-             "packuswb %%xmm7, %%xmm4        \n\t"
-             "movq %%xmm4, (%%"REG_d",%%"REG_c");\n\t"
+             "movdqu (%%"REG_D"), %%xmm4     \n\t"
+             "paddw %%xmm4, %%xmm5           \n\t"
+             "paddw %%xmm3, %%xmm1           \n\t"
+             "paddw %%xmm3, %%xmm5           \n\t"
+             "psraw $4, %%xmm1               \n\t" /* FRAC_BITS. */
+             "psraw $4, %%xmm5               \n\t" /* FRAC_BITS. */
+             "packuswb %%xmm5, %%xmm1        \n\t"
+             "movq %%xmm1, (%%"REG_d")       \n\t"
+             "movhps %%xmm1, (%%"REG_d",%%"REG_c");\n\t"
 snow_inner_add_yblock_sse2_end_8
 }
 
@@ -759,6 +736,101 @@ snow_inner_add_yblock_sse2_accum_16("0", "528")
 snow_inner_add_yblock_sse2_end_16
 }
 
+#define snow_inner_add_yblock_sse2_any_init\
+             "pxor %%xmm7, %%xmm7            \n\t"\
+             "pcmpeqd %%xmm3, %%xmm3         \n\t"\
+             "psllw $15, %%xmm3              \n\t"\
+             "psrlw $12, %%xmm3              \n\t" /* FRAC_BITS >> 1 */
+
+#define snow_inner_add_yblock_sse2_any_mul(load, out_reg, idx)\
+             "mov "PTR_SIZE"*"idx"(%2), %1   \n\t"\
+             load" (%1, %0), %%"out_reg"     \n\t"\
+             "mov "PTR_SIZE"*("idx"+1)(%2), %1\n\t"\
+             load" (%1, %0), %%xmm0          \n\t"\
+             "punpcklbw %%xmm7, %%"out_reg"  \n\t"\
+             "punpcklbw %%xmm7, %%xmm0       \n\t"\
+             "pmullw %%xmm0, %%"out_reg"     \n\t"
+
+#define snow_inner_add_yblock_sse2_any_pixels(load, load_dst, store)\
+             snow_inner_add_yblock_sse2_any_mul(load, "xmm1", "0")\
+             snow_inner_add_yblock_sse2_any_mul(load, "xmm2", "2")\
+             "paddusw %%xmm2, %%xmm1         \n\t"\
+             snow_inner_add_yblock_sse2_any_mul(load, "xmm2", "4")\
+             "paddusw %%xmm2, %%xmm1         \n\t"\
+             snow_inner_add_yblock_sse2_any_mul(load, "xmm2", "6")\
+             "paddusw %%xmm2, %%xmm1         \n\t"\
+             "psrlw $4, %%xmm1               \n\t"\
+             load_dst" (%3, %0, 2), %%xmm0   \n\t"\
+             "paddw %%xmm0, %%xmm1           \n\t"\
+             "paddw %%xmm3, %%xmm1           \n\t"\
+             "psraw $4, %%xmm1               \n\t" /* FRAC_BITS. */\
+             "packuswb %%xmm1, %%xmm1        \n\t"\
+             store" %%xmm1, (%4, %0)         \n\t"
+
+/**
+ * Any block and OBMC window size: 8 pixels per iteration, then 4, the
+ * last few pixels in C.
+ */
+static void inner_add_yblock_any_sse2(const uint8_t *obmc, const int obmc_stride, uint8_t * * block, int b_w, int b_h,
+                      int src_x, int src_y, int src_stride, slice_buffer * sb, int add, uint8_t * dst8){
+    const int half= obmc_stride>>1;
+    const x86_reg w8= b_w & ~7;
+    int y;
+
+    for(y=0; y<b_h; y++){
+        const uint8_t *obmc1= obmc + y*obmc_stride;
+        const uint8_t *obmc3= obmc1 + obmc_stride*half;
+        const int offset= y*src_stride;
+        /* pairs of prediction and OBMC weights */
+        const uint8_t *src[8]= {
+            block[3] + offset, obmc1,
+            block[2] + offset, obmc1 + half,
+            block[1] + offset, obmc3,
+            block[0] + offset, obmc3 + half,
+        };
+        IDWTELEM *dst= slice_buffer_get_line(sb, src_y + y) + src_x;
+        x86_reg x= 0, tmp;
+
+        if(w8){
+            __asm__ volatile(
+                snow_inner_add_yblock_sse2_any_init
+                "1:                             \n\t"
+                snow_inner_add_yblock_sse2_any_pixels("movq", "movdqu", "movq")
+                "add $8, %0                     \n\t"
+                "cmp %5, %0                     \n\t"
+                "jl 1b                          \n\t"
+                :"+r"(x), "=&r"(tmp)
+                :"r"(src), "r"(dst), "r"(dst8), "rm"(w8)
+                :"memory");
+        }
+        if(b_w & 4){
+            __asm__ volatile(
+                snow_inner_add_yblock_sse2_any_init
+                snow_inner_add_yblock_sse2_any_pixels("movd", "movq", "movd")
+                :"+r"(x), "=&r"(tmp)
+                :"r"(src), "r"(dst), "r"(dst8)
+                :"memory");
+            x+= 4;
+        }
+        for(; x<b_w; x++){
+            int v=   obmc1[x] * src[0][x]
+                    +obmc1[x + half] * src[2][x]
+                    +obmc3[x] * src[4][x]
+                    +obmc3[x + half] * src[6][x];
+
+            v <<= 8 - LOG2_OBMC_MAX;
+            if(FRAC_BITS != 8){
+                v >>= 8 - FRAC_BITS;
+            }
+            v += dst[x];
+            v = (v + (1<<(FRAC_BITS-1))) >> FRAC_BITS;
+            if(v&(~255)) v= ~(v>>31);
+            dst8[x]= v;
+        }
+        dst8+= src_stride;
+    }
+}
+
 #define snow_inner_add_yblock_mmx_header \
     IDWTELEM * * dst_array = sb->line + src_y;\
     x86_reg tmp;\
@@ -859,8 +931,10 @@ static void ff_snow_inner_add_yblock_sse2(const uint8_t *obmc, const int obmc_st
             inner_add_yblock_bw_8_obmc_16_bh_even_sse2(obmc, obmc_stride, block, b_w, b_h, src_x,src_y, src_stride, sb, add, dst8);
         else
             inner_add_yblock_bw_8_obmc_16_mmx(obmc, obmc_stride, block, b_w, b_h, src_x,src_y, src_stride, sb, add, dst8);
-    } else
-         ff_snow_inner_add_yblock(obmc, obmc_stride, block, b_w, b_h, src_x,src_y, src_stride, sb, add, dst8);
+    } else if (add)
+        inner_add_yblock_any_sse2(obmc, obmc_stride, block, b_w, b_h, src_x,src_y, src_stride, sb, add, dst8);
+    else
+        ff_snow_inner_add_yblock(obmc, obmc_stride, block, b_w, b_h, src_x,src_y, src_stride, sb, add, dst8);
 }
 
 static void ff_snow_inner_add_yblock_mmx(const uint8_t *obmc, const int obmc_stride, uint8_t * * block, int b_w, int b_h,
@@ -878,7 +952,7 @@ void ff_dwt_init_x86(DWTContext *c)
     int mm_flags = av_get_cpu_flags();
 
     if (mm_flags & AV_CPU_FLAG_MMX) {
-        if(mm_flags & AV_CPU_FLAG_SSE2 & 0){
+        if(mm_flags & AV_CPU_FLAG_SSE2){
             c->horizontal_compose97i = ff_snow_horizontal_compose97i_sse2;
 #if HAVE_7REGS
             c->vertical_compose97i = ff_snow_vertical_compose97i_sse2;
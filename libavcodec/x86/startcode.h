@@ -0,0 +1,72 @@
+/*
+ * SSE2 start code search
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVCODEC_X86_STARTCODE_H
+#define AVCODEC_X86_STARTCODE_H
+
+#include "config.h"
+#include "libavutil/common.h"
+#include "libavutil/x86_cpu.h"
+
+/* SSE2 is always there on x86-64, no need for a run time check */
+#if ARCH_X86_64 && HAVE_SSE && HAVE_INLINE_ASM
+
+#define find_zero_pair_simd find_zero_pair_sse2
+/**
+ * Search 16 bytes at a time while there are more than 16 bytes left.
+ * @return the offset of the first zero pair, or the offset from which the
+ *         remaining bytes have not been searched
+ */
+static inline int find_zero_pair_sse2(const uint8_t *buf, int size)
+{
+    x86_reg i = 0;
+    int mask = 0;
+
+    if (size <= 16)
+        return 0;
+
+    __asm__ volatile(
+        "pxor           %%xmm2, %%xmm2      \n\t"
+        "1:                                 \n\t"
+        "movdqu       (%2,%0), %%xmm0       \n\t"
+        "movdqu      1(%2,%0), %%xmm1       \n\t"
+        "por            %%xmm1, %%xmm0      \n\t"
+        "pcmpeqb        %%xmm2, %%xmm0      \n\t"
+        "pmovmskb       %%xmm0, %1          \n\t"
+        "test               %1, %1          \n\t"
+        "jnz                2f              \n\t"
+        "add               $16, %0          \n\t"
+        "cmp                %3, %0          \n\t"
+        "jl                 1b              \n\t"
+        "2:                                 \n\t"
+        : "+r"(i), "=&r"(mask)
+        : "r"(buf), "r"((x86_reg)size - 16)
+        : "memory"
+          XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2")
+    );
+
+    if (mask)
+        return i + av_log2(mask & -mask);
+    return i;
+}
+
+#endif /* ARCH_X86_64 && HAVE_SSE && HAVE_INLINE_ASM */
+
+#endif /* AVCODEC_X86_STARTCODE_H */
@@ -0,0 +1,113 @@
+/*
+ * SSE optimized synthesis filter
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/cpu.h"
+#include "libavutil/x86_cpu.h"
+#include "libavcodec/synth_filter.h"
+
+/* one value of j for 4 values of i */
+#define SYNTH_TAPS(off)                         \
+    "movaps        (%5,%4), %%xmm4      \n\t"   \
+    "movaps "#off"(%6,%4), %%xmm5       \n\t"   \
+    "shufps $0x1b, %%xmm5, %%xmm5       \n\t"   \
+    "mulps       %%xmm5, %%xmm4         \n\t"   \
+    "subps       %%xmm4, %%xmm0         \n\t"   \
+    "movaps      64(%5,%4), %%xmm4      \n\t"   \
+    "movaps "#off"(%7,%4), %%xmm5       \n\t"   \
+    "mulps       %%xmm5, %%xmm4         \n\t"   \
+    "addps       %%xmm4, %%xmm1         \n\t"   \
+    "movaps     128(%5,%4), %%xmm4      \n\t"   \
+    "movaps "#off"+64(%7,%4), %%xmm5    \n\t"   \
+    "mulps       %%xmm5, %%xmm4         \n\t"   \
+    "addps       %%xmm4, %%xmm2         \n\t"   \
+    "movaps     192(%5,%4), %%xmm4      \n\t"   \
+    "movaps "#off"+64(%6,%4), %%xmm5    \n\t"   \
+    "shufps $0x1b, %%xmm5, %%xmm5       \n\t"   \
+    "mulps       %%xmm5, %%xmm4         \n\t"   \
+    "addps       %%xmm4, %%xmm3         \n\t"   \
+    "add          $256, %4              \n\t"
+
+/**
+ * Same as the C version, with 4 values of i computed at once; the sums are
+ * done in the same order, so the results are identical.
+ * window, synth_buf_ptr, synth_buf2 and out must be 16-byte aligned.
+ */
+static void synth_filter_float_sse(FFTContext *imdct,
+                                   float *synth_buf_ptr, int *synth_buf_offset,
+                                   float synth_buf2[32], const float window[512],
+                                   float out[32], const float in[32], float scale)
+{
+    float *synth_buf = synth_buf_ptr + *synth_buf_offset;
+    /* byte offset of the first j which wraps around the ring buffer */
+    x86_reg wrap = FFALIGN(512 - *synth_buf_offset, 64) * 4;
+    int i;
+
+    imdct->imdct_half(imdct, synth_buf, in);
+
+    for (i = 0; i < 16; i += 4) {
+        x86_reg j = 0;
+        __asm__ volatile(
+            "movaps          %0, %%xmm0         \n\t" /* a */
+            "movaps          %1, %%xmm1         \n\t" /* b */
+            "xorps       %%xmm2, %%xmm2         \n\t" /* c */
+            "xorps       %%xmm3, %%xmm3         \n\t" /* d */
+            /* j < 512 - *synth_buf_offset */
+            "1:                                 \n\t"
+            SYNTH_TAPS(0)
+            "cmp             %8, %4             \n\t"
+            "jl 1b                              \n\t"
+            /* the rest, wrapping around the start of the ring buffer */
+            "cmp          $2048, %4             \n\t"
+            "jge 3f                             \n\t"
+            "2:                                 \n\t"
+            SYNTH_TAPS(-2048)
+            "cmp          $2048, %4             \n\t"
+            "jl 2b                              \n\t"
+            "3:                                 \n\t"
+            "movss           %9, %%xmm4         \n\t"
+            "shufps $0x00, %%xmm4, %%xmm4       \n\t"
+            "mulps       %%xmm4, %%xmm0         \n\t"
+            "mulps       %%xmm4, %%xmm1         \n\t"
+            "movaps      %%xmm0, %2             \n\t"
+            "movaps      %%xmm1, %3             \n\t"
+            "movaps      %%xmm2, %0             \n\t"
+            "movaps      %%xmm3, %1             \n\t"
+            : "+m"(*(float (*)[4])(synth_buf2 + i)),
+              "+m"(*(float (*)[4])(synth_buf2 + i + 16)),
+              "=m"(*(float (*)[4])(out + i)),
+              "=m"(*(float (*)[4])(out + i + 16)),
+              "+r"(j)
+            : "r"(window + i), "r"(synth_buf + 12 - i), "r"(synth_buf + i),
+              "r"(wrap), "m"(scale)
+            : "memory"
+              XMM_CLOBBERS(, "%xmm0", "%xmm1", "%xmm2", "%xmm3",
+                             "%xmm4", "%xmm5")
+        );
+    }
+    *synth_buf_offset = (*synth_buf_offset - 32) & 511;
+}
+
+void ff_synth_filter_init_mmx(SynthFilterContext *c)
+{
+    int mm_flags = av_get_cpu_flags();
+
+    if (mm_flags & AV_CPU_FLAG_SSE)
+        c->synth_filter_float = synth_filter_float_sse;
+}
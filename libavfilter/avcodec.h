@@ -60,6 +60,10 @@ int avfilter_fill_frame_from_video_buffer_ref(AVFrame *frame,
 /**
  * Add frame data to buffer_src.
  *
+ * Frames of a hardware accelerated decoder are referenced instead of
+ * copied, so their surface must stay valid until the filter graph is done
+ * with it, see av_vsrc_buffer_add_video_buffer_ref().
+ *
  * @param buffer_src pointer to a buffer source context
  * @param flags a combination of AV_VSRC_BUF_FLAG_* flags
  * @return >= 0 in case of success, a negative AVERROR code in case of
@@ -26,6 +26,7 @@
 #include "libavutil/audioconvert.h"
 #include "libavutil/imgutils.h"
 #include "libavutil/avassert.h"
+#include "libavutil/timer.h"
 #include "avfilter.h"
 #include "internal.h"
 
@@ -70,32 +71,227 @@ AVFilterBufferRef *avfilter_ref_buffer(AVFilterBufferRef *ref, int pmask)
     return ret;
 }
 
-static void store_in_pool(AVFilterBufferRef *ref)
+#if HAVE_PTHREADS
+#define POOL_LOCK(pool)   pthread_mutex_lock(&(pool)->lock)
+#define POOL_UNLOCK(pool) pthread_mutex_unlock(&(pool)->lock)
+#else
+#define POOL_LOCK(pool)
+#define POOL_UNLOCK(pool)
+#endif
+
+AVFilterPool *ff_avfilter_pool_alloc(int max_count, int64_t max_size)
+{
+    AVFilterPool *pool = av_mallocz(sizeof(AVFilterPool));
+
+    if (!pool)
+        return NULL;
+    if (max_count) {
+        if (!(pool->pic = av_mallocz(sizeof(*pool->pic) * max_count))) {
+            av_free(pool);
+            return NULL;
+        }
+        pool->nb_slots = max_count;
+    }
+    pool->max_count = max_count;
+    pool->max_size  = max_size;
+    pool->refcount  = 1;
+#if HAVE_PTHREADS
+    pthread_mutex_init(&pool->lock, NULL);
+#endif
+
+    return pool;
+}
+
+static void free_pool(AVFilterPool *pool)
+{
+#if HAVE_PTHREADS
+    pthread_mutex_destroy(&pool->lock);
+#endif
+    av_free(pool->pic);
+    av_free(pool);
+}
+
+/* free buffer: picrefs stored in the pool are not
+ * supposed to contain a free callback */
+static void free_pool_buffer(AVFilterBufferRef *picref)
+{
+    av_freep(&picref->buf->data[0]);
+    av_freep(&picref->buf);
+    av_freep(&picref->audio);
+    av_freep(&picref->video);
+    av_free(picref);
+}
+
+static int pool_buffer_size(AVFilterBufferRef *picref)
+{
+    uint8_t *data[4];
+
+    return av_image_fill_pointers(data, picref->buf->format, picref->buf->h,
+                                  picref->buf->data[0], picref->buf->linesize);
+}
+
+/** Free the kept buffer in slot i. Must be called with the pool locked. */
+static void pool_free_slot(AVFilterPool *pool, int i)
+{
+    pool->size -= pool_buffer_size(pool->pic[i]);
+    free_pool_buffer(pool->pic[i]);
+    pool->pic[i] = NULL;
+    pool->count--;
+}
+
+AVFilterPool *ff_avfilter_pool_ref(AVFilterPool *pool)
 {
+    POOL_LOCK(pool);
+    pool->refcount++;
+    POOL_UNLOCK(pool);
+    return pool;
+}
+
+void ff_avfilter_pool_unref(AVFilterPool **poolp)
+{
+    AVFilterPool *pool = *poolp;
+    int i, unused;
+
+    if (!pool)
+        return;
+    *poolp = NULL;
+
+    POOL_LOCK(pool);
+    if (!--pool->refcount)
+        for (i = 0; i < pool->nb_slots; i++)
+            if (pool->pic[i])
+                pool_free_slot(pool, i);
+    unused = !pool->refcount && !pool->nb_out;
+    POOL_UNLOCK(pool);
+
+    if (unused)
+        free_pool(pool);
+}
+
+AVFilterBufferRef *ff_avfilter_pool_get_video_buffer(AVFilterPool *pool, int perms,
+                                                     int w, int h, enum PixelFormat format,
+                                                     AVFilterLinkStats *stats)
+{
+    AVFilterBufferRef *picref = NULL;
+    int linesize[4];
+    uint8_t *data[4];
     int i;
+
+    POOL_LOCK(pool);
+    pool->nb_out++;
+    for (i = 0; i < pool->nb_slots; i++) {
+        AVFilterBufferRef *ref = pool->pic[i];
+        if (ref && ref->buf->format == format && ref->buf->w == w && ref->buf->h == h) {
+            pool->size -= pool_buffer_size(ref);
+            pool->pic[i] = NULL;
+            pool->count--;
+            picref = ref;
+            break;
+        }
+    }
+    if (picref)
+        pool->hits++;
+    else
+        pool->misses++;
+    POOL_UNLOCK(pool);
+
+    if (stats) {
+        if (picref)
+            stats->pool_hits++;
+        else
+            stats->pool_misses++;
+    }
+
+    if (picref) {
+        AVFilterBuffer *pic = picref->buf;
+        picref->video->w = w;
+        picref->video->h = h;
+        picref->perms = perms | AV_PERM_READ;
+        picref->format = format;
+        pic->refcount = 1;
+        memcpy(picref->data,     pic->data,     sizeof(picref->data));
+        memcpy(picref->linesize, pic->linesize, sizeof(picref->linesize));
+        return picref;
+    }
+
+    // align: +2 is needed for swscaler, +16 to be SIMD-friendly
+    if ((i = av_image_alloc(data, linesize, w, h, format, 16)) < 0)
+        goto fail;
+
+    picref = avfilter_get_video_buffer_ref_from_arrays(data, linesize,
+                                                       perms, w, h, format);
+    if (!picref) {
+        av_free(data[0]);
+        goto fail;
+    }
+    memset(data[0], 128, i);
+
+    picref->buf->priv = pool;
+    picref->buf->free = NULL;
+
+    return picref;
+
+fail:
+    POOL_LOCK(pool);
+    pool->nb_out--;
+    POOL_UNLOCK(pool);
+    return NULL;
+}
+
+static void store_in_pool(AVFilterBufferRef *ref)
+{
+    int i, size, unused;
     AVFilterPool *pool= ref->buf->priv;
 
     av_assert0(ref->buf->data[0]);
 
-    if (pool->count == POOL_SIZE) {
+    POOL_LOCK(pool);
+    pool->nb_out--;
+
+    if (!pool->refcount) {
+        /* the links using the pool are gone */
+        free_pool_buffer(ref);
+        unused = !pool->nb_out;
+        POOL_UNLOCK(pool);
+        if (unused)
+            free_pool(pool);
+        return;
+    }
+
+    size = pool_buffer_size(ref);
+
+    if (pool->max_count && pool->count == pool->max_count) {
         AVFilterBufferRef *ref1 = pool->pic[0];
-        av_freep(&ref1->video);
-        av_freep(&ref1->audio);
-        av_freep(&ref1->buf->data[0]);
-        av_freep(&ref1->buf);
-        av_free(ref1);
-        memmove(&pool->pic[0], &pool->pic[1], sizeof(void*)*(POOL_SIZE-1));
+        pool->size -= pool_buffer_size(ref1);
+        free_pool_buffer(ref1);
+        memmove(&pool->pic[0], &pool->pic[1], sizeof(void*)*(pool->max_count-1));
         pool->count--;
-        pool->pic[POOL_SIZE-1] = NULL;
+        pool->pic[pool->max_count-1] = NULL;
     }
+    for (i = 0; pool->max_size && pool->size + size > pool->max_size && i < pool->nb_slots; i++)
+        if (pool->pic[i])
+            pool_free_slot(pool, i);
 
-    for (i = 0; i < POOL_SIZE; i++) {
-        if (!pool->pic[i]) {
-            pool->pic[i] = ref;
-            pool->count++;
+    for (i = 0; i < pool->nb_slots; i++)
+        if (!pool->pic[i])
             break;
+    if (i == pool->nb_slots && !pool->max_count) {
+        int nb_slots = FFMAX(2 * pool->nb_slots, 8);
+        AVFilterBufferRef **pic = av_realloc(pool->pic, sizeof(*pic) * nb_slots);
+        if (pic) {
+            memset(pic + pool->nb_slots, 0, sizeof(*pic) * (nb_slots - pool->nb_slots));
+            pool->pic      = pic;
+            pool->nb_slots = nb_slots;
         }
     }
+
+    if (i < pool->nb_slots && (!pool->max_size || size <= pool->max_size)) {
+        pool->pic[i] = ref;
+        pool->count++;
+        pool->size += size;
+    } else
+        free_pool_buffer(ref);
+    POOL_UNLOCK(pool);
 }
 
 void avfilter_unref_buffer(AVFilterBufferRef *ref)
@@ -170,24 +366,7 @@ void avfilter_link_free(AVFilterLink **link)
     if (!*link)
         return;
 
-    if ((*link)->pool) {
-        int i;
-        for (i = 0; i < POOL_SIZE; i++) {
-            if ((*link)->pool->pic[i]) {
-                AVFilterBufferRef *picref = (*link)->pool->pic[i];
-                /* free buffer: picrefs stored in the pool are not
-                 * supposed to contain a free callback */
-                av_freep(&picref->buf->data[0]);
-                av_freep(&picref->buf);
-
-                av_freep(&picref->audio);
-                av_freep(&picref->video);
-                av_freep(&(*link)->pool->pic[i]);
-            }
-        }
-        (*link)->pool->count = 0;
-//        av_freep(&(*link)->pool);
-    }
+    ff_avfilter_pool_unref(&(*link)->pool);
     av_freep(link);
 }
 
@@ -208,6 +387,10 @@ int avfilter_insert_filter(AVFilterLink *link, AVFilterContext *filt,
         return ret;
     }
 
+    /* the new link keeps using the buffers of the graph */
+    if (link->pool && link->pool->shared)
+        filt->outputs[filt_dstpad_idx]->pool = ff_avfilter_pool_ref(link->pool);
+
     /* re-hookup the link to the new destination filter we inserted */
     link->dst = filt;
     link->dstpad = &filt->input_pads[filt_srcpad_idx];
@@ -496,6 +679,89 @@ int avfilter_poll_frame(AVFilterLink *link)
     return min;
 }
 
+/**
+ * Timer of a filter callback. Callbacks call the callbacks of the next
+ * filters, so the running timers of a thread form a stack, and the time
+ * of a nested callback is subtracted from the time of the enclosing one.
+ */
+typedef struct StatsTimer {
+    uint64_t start;
+    uint64_t nested;            ///< time spent in nested callbacks
+    struct StatsTimer *parent;
+} StatsTimer;
+
+#ifdef AV_READ_TIME
+#define STATS_READ_TIME() AV_READ_TIME()
+#else
+#define STATS_READ_TIME() 0
+#endif
+
+#if HAVE_PTHREADS
+static pthread_once_t stats_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t  stats_key;
+
+static void stats_key_init(void)
+{
+    pthread_key_create(&stats_key, NULL);
+}
+
+static StatsTimer *get_stats_timer(void)
+{
+    pthread_once(&stats_key_once, stats_key_init);
+    return pthread_getspecific(stats_key);
+}
+
+static void set_stats_timer(StatsTimer *timer)
+{
+    pthread_setspecific(stats_key, timer);
+}
+#else
+static StatsTimer *stats_timer;
+
+static StatsTimer *get_stats_timer(void)       { return stats_timer; }
+static void set_stats_timer(StatsTimer *timer) { stats_timer = timer; }
+#endif
+
+static void stats_timer_start(StatsTimer *timer)
+{
+    timer->parent = get_stats_timer();
+    timer->nested = 0;
+    set_stats_timer(timer);
+    timer->start  = STATS_READ_TIME();
+}
+
+static void stats_timer_stop(StatsTimer *timer, AVFilterContext *filter)
+{
+    uint64_t elapsed = STATS_READ_TIME() - timer->start;
+
+    filter->stats.time += elapsed - timer->nested;
+    filter->stats.calls++;
+    if (timer->parent)
+        timer->parent->nested += elapsed;
+    set_stats_timer(timer->parent);
+}
+
+static uint64_t video_buffer_bytes(AVFilterLink *link, AVFilterBufferRef *picref)
+{
+    const AVPixFmtDescriptor *desc = &av_pix_fmt_descriptors[link->format];
+    uint64_t bytes = 0;
+    int i;
+
+    if (desc->flags & PIX_FMT_HWACCEL)
+        return 0;
+    for (i = 0; i < 4 && picref->data[i]; i++) {
+        int linesize = av_image_get_linesize(link->format, picref->video->w, i);
+        int h = picref->video->h;
+
+        if (linesize <= 0)
+            break;
+        if (i == 1 || i == 2)
+            h = -((-h) >> desc->log2_chroma_h);
+        bytes += (uint64_t)linesize * h;
+    }
+    return bytes;
+}
+
 /* XXX: should we do the duplicating of the picture ref here, instead of
  * forcing the source filter to do it? */
 void avfilter_start_frame(AVFilterLink *link, AVFilterBufferRef *picref)
@@ -511,8 +777,10 @@ void avfilter_start_frame(AVFilterLink *link, AVFilterBufferRef *picref)
 
     if (picref->linesize[0] < 0)
         perms |= AV_PERM_NEG_LINESIZES;
-    /* prepare to copy the picture if it has insufficient permissions */
-    if ((dst->min_perms & perms) != dst->min_perms || dst->rej_perms & perms) {
+    /* prepare to copy the picture if it has insufficient permissions, which
+     * is not possible for hardware surfaces */
+    if (((dst->min_perms & perms) != dst->min_perms || dst->rej_perms & perms) &&
+        !(av_pix_fmt_descriptors[link->format].flags & PIX_FMT_HWACCEL)) {
         av_log(link->dst, AV_LOG_DEBUG,
                 "frame copy needed (have perms %x, need %x, reject %x)\n",
                 picref->perms,
@@ -525,7 +793,15 @@ void avfilter_start_frame(AVFilterLink *link, AVFilterBufferRef *picref)
     else
         link->cur_buf = picref;
 
-    start_frame(link, link->cur_buf);
+    if (link->dst->enable_stats) {
+        StatsTimer timer;
+        link->stats.frames++;
+        link->stats.bytes += video_buffer_bytes(link, link->cur_buf);
+        stats_timer_start(&timer);
+        start_frame(link, link->cur_buf);
+        stats_timer_stop(&timer, link->dst);
+    } else
+        start_frame(link, link->cur_buf);
 }
 
 void avfilter_end_frame(AVFilterLink *link)
@@ -535,7 +811,13 @@ void avfilter_end_frame(AVFilterLink *link)
     if (!(end_frame = link->dstpad->end_frame))
         end_frame = avfilter_default_end_frame;
 
-    end_frame(link);
+    if (link->dst->enable_stats) {
+        StatsTimer timer;
+        stats_timer_start(&timer);
+        end_frame(link);
+        stats_timer_stop(&timer, link->dst);
+    } else
+        end_frame(link);
 
     /* unreference the source picture if we're feeding the destination filter
      * a copied version dues to permission issues */
@@ -583,7 +865,17 @@ void avfilter_draw_slice(AVFilterLink *link, int y, int h, int slice_dir)
 
     if (!(draw_slice = link->dstpad->draw_slice))
         draw_slice = avfilter_default_draw_slice;
-    draw_slice(link, y, h, slice_dir);
+    {
+        AV_PROFILE_START(draw_slice);
+        if (link->dst->enable_stats) {
+            StatsTimer timer;
+            stats_timer_start(&timer);
+            draw_slice(link, y, h, slice_dir);
+            stats_timer_stop(&timer, link->dst);
+        } else
+            draw_slice(link, y, h, slice_dir);
+        AV_PROFILE_STOP(draw_slice, "avfilter_draw_slice");
+    }
 }
 
 void avfilter_filter_samples(AVFilterLink *link, AVFilterBufferRef *samplesref)
@@ -621,7 +913,17 @@ void avfilter_filter_samples(AVFilterLink *link, AVFilterBufferRef *samplesref)
     } else
         link->cur_buf = samplesref;
 
-    filter_samples(link, link->cur_buf);
+    if (link->dst->enable_stats) {
+        StatsTimer timer;
+        link->stats.frames++;
+        link->stats.bytes += (uint64_t)link->cur_buf->audio->nb_samples *
+            av_get_channel_layout_nb_channels(link->cur_buf->audio->channel_layout) *
+            av_get_bytes_per_sample(link->cur_buf->format);
+        stats_timer_start(&timer);
+        filter_samples(link, link->cur_buf);
+        stats_timer_stop(&timer, link->dst);
+    } else
+        filter_samples(link, link->cur_buf);
 }
 
 #define MAX_REGISTERED_AVFILTERS_NB 64
@@ -696,6 +998,8 @@ int avfilter_open(AVFilterContext **filter_ctx, AVFilter *filter, const char *in
 
     ret->av_class = &avfilter_class;
     ret->filter   = filter;
+    ret->execute  = avfilter_default_execute;
+    ret->thread_count = 1;
     ret->name     = inst_name ? av_strdup(inst_name) : NULL;
     if (filter->priv_size) {
         ret->priv     = av_mallocz(filter->priv_size);
@@ -26,7 +26,7 @@
 #include "libavutil/samplefmt.h"
 
 #define LIBAVFILTER_VERSION_MAJOR  2
-#define LIBAVFILTER_VERSION_MINOR 24
+#define LIBAVFILTER_VERSION_MINOR 31
 #define LIBAVFILTER_VERSION_MICRO  0
 
 #define LIBAVFILTER_VERSION_INT AV_VERSION_INT(LIBAVFILTER_VERSION_MAJOR, \
@@ -482,6 +482,21 @@ void avfilter_set_common_channel_layouts(AVFilterContext *ctx, AVFilterFormats *
 /** Default handler for query_formats() */
 int avfilter_default_query_formats(AVFilterContext *ctx);
 
+/**
+ * Function run by AVFilterContext.execute() for each job.
+ *
+ * @param ctx    the filter context
+ * @param arg    the argument passed to execute()
+ * @param jobnr  the index of the job, from 0 to nb_jobs-1
+ * @param nb_jobs the total number of jobs
+ * @return the return value of this job, stored in the ret array of execute()
+ */
+typedef int (avfilter_action_func)(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs);
+
+/** Default handler for execute(), which runs all the jobs one after the other */
+int avfilter_default_execute(AVFilterContext *ctx, avfilter_action_func *func,
+                             void *arg, int *ret, int nb_jobs);
+
 /** start_frame() handler for filters which simply pass video along */
 void avfilter_null_start_frame(AVFilterLink *link, AVFilterBufferRef *picref);
 
@@ -545,8 +560,44 @@ typedef struct AVFilter {
      * NULL_IF_CONFIG_SMALL() macro to define it.
      */
     const char *description;
+
+    int flags;                  ///< combination of AVFILTER_FLAG_* flags
 } AVFilter;
 
+/**
+ * The filter passes the pictures along without accessing their data, so
+ * it also accepts hardware accelerated pixel formats, whose buffers only
+ * carry an opaque surface handle in data[3]. Only used by the default
+ * query_formats().
+ */
+#define AVFILTER_FLAG_HWACCEL 1
+
+/**
+ * Time spent in the callbacks of a filter instance, collected while
+ * AVFilterContext.enable_stats is set.
+ */
+typedef struct AVFilterStats {
+    uint64_t calls;             ///< number of start_frame, draw_slice, end_frame and filter_samples calls
+    /**
+     * Time spent in these calls, not counting the time spent in the
+     * callbacks of other filters they called. In units of the CPU
+     * timestamp counter like the profile counters of libavutil, 0 on
+     * platforms without one.
+     */
+    uint64_t time;
+} AVFilterStats;
+
+/**
+ * Data sent on a link, collected while AVFilterContext.enable_stats is set
+ * for the destination filter.
+ */
+typedef struct AVFilterLinkStats {
+    uint64_t frames;            ///< video frames or audio buffers sent
+    uint64_t bytes;             ///< bytes of picture data or audio samples sent
+    unsigned pool_hits;         ///< video buffers for the link reused from a pool
+    unsigned pool_misses;       ///< video buffers for the link which were allocated
+} AVFilterLinkStats;
+
 /** An instance of a filter */
 struct AVFilterContext {
     const AVClass *av_class;              ///< needed for av_log()
@@ -564,6 +615,38 @@ struct AVFilterContext {
     AVFilterLink **outputs;         ///< array of pointers to output links
 
     void *priv;                     ///< private data for use by the filter
+
+    /**
+     * Run func for nb_jobs jobs, possibly in parallel, and return when all
+     * of them are finished. Filters use this to process horizontal bands
+     * of a frame at the same time; the band of a job can be derived from
+     * jobnr and nb_jobs. func must not call execute() itself.
+     * Set to avfilter_default_execute() by avfilter_open(), and to a
+     * threaded implementation by avfilter_graph_config() if the graph
+     * has more than one thread.
+     *
+     * @param ret array of nb_jobs elements receiving the return values of
+     * func, or NULL
+     * @return 0
+     */
+    int (*execute)(AVFilterContext *ctx, avfilter_action_func *func,
+                   void *arg, int *ret, int nb_jobs);
+
+    /**
+     * Number of jobs execute() can run at the same time, which is the
+     * number of bands worth splitting a frame into.
+     */
+    int thread_count;
+
+    void *thread_opaque;            ///< AVThreadPool of the threaded execute()
+
+    /**
+     * Collect stats and the stats of the input links. Set for all the
+     * filters of a graph by avfilter_graph_enable_stats().
+     */
+    int enable_stats;
+
+    AVFilterStats stats;
 };
 
 /**
@@ -634,6 +717,8 @@ struct AVFilterLink {
     AVRational time_base;
 
     struct AVFilterPool *pool;
+
+    AVFilterLinkStats stats;    ///< collected while the destination filter has enable_stats set
 };
 
 /**
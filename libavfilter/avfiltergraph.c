@@ -23,6 +23,10 @@
 #include <ctype.h>
 #include <string.h>
 
+#include "config.h"
+#include "libavutil/avstring.h"
+#include "libavutil/pixdesc.h"
+#include "libavutil/samplefmt.h"
 #include "avfilter.h"
 #include "avfiltergraph.h"
 #include "internal.h"
@@ -38,6 +42,10 @@ void avfilter_graph_free(AVFilterGraph **graph)
         return;
     for (; (*graph)->filter_count > 0; (*graph)->filter_count--)
         avfilter_free((*graph)->filters[(*graph)->filter_count - 1]);
+#if HAVE_PTHREADS
+    ff_avfilter_graph_thread_free(*graph);
+#endif
+    ff_avfilter_pool_unref(&(*graph)->pool);
     av_freep(&(*graph)->scale_sws_opts);
     av_freep(&(*graph)->filters);
     av_freep(graph);
@@ -52,6 +60,7 @@ int avfilter_graph_add_filter(AVFilterGraph *graph, AVFilterContext *filter)
 
     graph->filters = filters;
     graph->filters[graph->filter_count++] = filter;
+    filter->enable_stats = graph->enable_stats;
 
     return 0;
 }
@@ -135,6 +144,26 @@ AVFilterContext *avfilter_graph_get_filter(AVFilterGraph *graph, char *name)
     return NULL;
 }
 
+static const char *format_name(enum AVMediaType type, int64_t format)
+{
+    const char *name = type == AVMEDIA_TYPE_VIDEO ? av_get_pix_fmt_name(format) :
+                                                    av_get_sample_fmt_name(format);
+    return name ? name : "unknown";
+}
+
+static void formats_to_string(char *buf, int buf_size,
+                              AVFilterFormats *formats, enum AVMediaType type)
+{
+    unsigned i;
+
+    buf[0] = 0;
+    if (!formats)
+        return;
+    for (i = 0; i < formats->format_count; i++)
+        av_strlcatf(buf, buf_size, "%s%s", i ? " " : "",
+                    format_name(type, formats->formats[i]));
+}
+
 static int query_formats(AVFilterGraph *graph, AVClass *log_ctx)
 {
     int i, j, ret;
@@ -159,10 +188,17 @@ static int query_formats(AVFilterGraph *graph, AVClass *log_ctx)
                 if (!avfilter_merge_formats(link->in_formats,
                                             link->out_formats)) {
                     AVFilterContext *scale;
-                    char scale_args[256];
+                    char scale_args[256], src_fmts[512], dst_fmts[512];
                     /* couldn't merge format lists. auto-insert scale filter */
                     snprintf(inst_name, sizeof(inst_name), "auto-inserted scaler %d",
                              scaler_count++);
+                    formats_to_string(src_fmts, sizeof(src_fmts), link->in_formats,  link->type);
+                    formats_to_string(dst_fmts, sizeof(dst_fmts), link->out_formats, link->type);
+                    av_log(log_ctx, AV_LOG_DEBUG,
+                           "Inserting '%s' between the filter '%s' and the filter '%s': "
+                           "no common format, '%s' outputs [%s], '%s' accepts [%s]\n",
+                           inst_name, link->src->name, link->dst->name,
+                           link->src->name, src_fmts, link->dst->name, dst_fmts);
                     snprintf(scale_args, sizeof(scale_args), "0:0:%s", graph->scale_sws_opts);
                     if ((ret = avfilter_graph_create_filter(&scale, avfilter_get_by_name("scale"),
                                                             inst_name, scale_args, NULL, graph)) < 0)
@@ -188,11 +224,112 @@ static int query_formats(AVFilterGraph *graph, AVClass *log_ctx)
     return 0;
 }
 
-static void pick_format(AVFilterLink *link)
+/* Weights of the conversion cost model. Losing information costs more
+ * than the work of any conversion which keeps it. */
+#define COST_LOSS_DEPTH   16    ///< per bit of depth lost
+#define COST_LOSS_CHROMA  16    ///< per halving of the chroma resolution
+#define COST_LOSS_COLOR   64    ///< the colors are dropped
+#define COST_LOSS_ALPHA   32    ///< the alpha channel is dropped
+#define COST_LOSS_PAL     48    ///< the colors are quantized to a palette
+#define COST_COLORSPACE    8    ///< conversion between RGB and YUV
+#define COST_HWACCEL  (1<<20)   ///< conversion from or to a hwaccel format
+
+static int pix_fmt_depth(const AVPixFmtDescriptor *desc)
+{
+    int i, depth = 0;
+
+    for (i = 0; i < desc->nb_components; i++)
+        depth = FFMAX(depth, desc->comp[i].depth_minus1 + 1);
+    return depth;
+}
+
+static int pix_fmt_is_rgb(const AVPixFmtDescriptor *desc)
+{
+    return desc->flags & PIX_FMT_PAL ||
+           (desc->nb_components >= 3 &&
+            !desc->log2_chroma_w && !desc->log2_chroma_h &&
+            !desc->comp[1].plane && !desc->comp[2].plane);
+}
+
+/**
+ * Estimate the cost of converting a frame from the format src to dst,
+ * as the information the conversion loses plus the bytes it touches
+ * per pixel.
+ */
+static int pix_fmt_conversion_cost(enum PixelFormat src, enum PixelFormat dst)
+{
+    const AVPixFmtDescriptor *s = &av_pix_fmt_descriptors[src];
+    const AVPixFmtDescriptor *d = &av_pix_fmt_descriptors[dst];
+    int s_color = s->nb_components >= 3 || s->flags & PIX_FMT_PAL;
+    int d_color = d->nb_components >= 3 || d->flags & PIX_FMT_PAL;
+    int cost;
+
+    if (src == dst)
+        return 0;
+    if ((s->flags | d->flags) & PIX_FMT_HWACCEL)
+        return COST_HWACCEL;
+
+    cost  = 1 + (av_get_bits_per_pixel(s) + av_get_bits_per_pixel(d) + 7) / 8;
+    cost += COST_LOSS_DEPTH * FFMAX(pix_fmt_depth(s) - pix_fmt_depth(d), 0);
+    if (s_color && !d_color)
+        cost += COST_LOSS_COLOR;
+    if (s_color && d_color) {
+        if (pix_fmt_is_rgb(s) != pix_fmt_is_rgb(d))
+            cost += COST_COLORSPACE;
+        cost += COST_LOSS_CHROMA * (FFMAX(d->log2_chroma_w - s->log2_chroma_w, 0) +
+                                    FFMAX(d->log2_chroma_h - s->log2_chroma_h, 0));
+    }
+    if (s->nb_components == 4 && d->nb_components != 4)
+        cost += COST_LOSS_ALPHA;
+    if (d->flags & PIX_FMT_PAL && !(s->flags & PIX_FMT_PAL))
+        cost += COST_LOSS_PAL;
+    return cost;
+}
+
+static int format_conversion_cost(enum AVMediaType type, int64_t src, int64_t dst)
+{
+    if (type == AVMEDIA_TYPE_VIDEO)
+        return pix_fmt_conversion_cost(src, dst);
+    return src != dst;
+}
+
+/**
+ * Compute the cost of the conversions a filter would do if format was
+ * used on link: the links on the other side of its source and destination
+ * filters which already have a format are compared with it.
+ *
+ * @return the number of such links
+ */
+static int link_format_cost(AVFilterLink *link, int64_t format, int *cost)
+{
+    int i, known = 0;
+
+    *cost = 0;
+    for (i = 0; i < link->src->input_count; i++) {
+        AVFilterLink *in = link->src->inputs[i];
+        if (in && in->type == link->type && !in->in_formats) {
+            *cost += format_conversion_cost(link->type, in->format, format);
+            known++;
+        }
+    }
+    for (i = 0; i < link->dst->output_count; i++) {
+        AVFilterLink *out = link->dst->outputs[i];
+        if (out && out->type == link->type && !out->in_formats) {
+            *cost += format_conversion_cost(link->type, format, out->format);
+            known++;
+        }
+    }
+    return known;
+}
+
+static void pick_format(AVFilterLink *link, int idx)
 {
     if (!link || !link->in_formats)
         return;
 
+    /* the list may be shared with other links, move the choice first so
+     * that they get the same format */
+    FFSWAP(int64_t, link->in_formats->formats[0], link->in_formats->formats[idx]);
     link->in_formats->format_count = 1;
     link->format = link->in_formats->formats[0];
     avfilter_formats_unref(&link->in_formats);
@@ -207,17 +344,83 @@ static void pick_format(AVFilterLink *link)
 
 }
 
-static void pick_formats(AVFilterGraph *graph)
+/**
+ * Pick the format of each link so that the filters of the graph do as
+ * little conversion work as possible.
+ *
+ * Links with a single possible format are fixed first. Then the link
+ * with a choice next to the most links with a known format gets the
+ * format which is the cheapest to convert from and to theirs, until all
+ * the links have a format. Links without any neighbour with a known
+ * format get the first one of their list.
+ */
+static void pick_formats(AVFilterGraph *graph, AVClass *log_ctx)
 {
     int i, j;
 
     for (i = 0; i < graph->filter_count; i++) {
         AVFilterContext *filter = graph->filters[i];
 
-        for (j = 0; j < filter->input_count; j++)
-            pick_format(filter->inputs[j]);
-        for (j = 0; j < filter->output_count; j++)
-            pick_format(filter->outputs[j]);
+        for (j = 0; j < filter->output_count; j++) {
+            AVFilterLink *link = filter->outputs[j];
+            if (link && link->in_formats && link->in_formats->format_count == 1)
+                pick_format(link, 0);
+        }
+    }
+
+    for (;;) {
+        AVFilterLink *best = NULL, *first = NULL;
+        int best_known = 0, best_idx = 0;
+
+        for (i = 0; i < graph->filter_count; i++) {
+            AVFilterContext *filter = graph->filters[i];
+
+            for (j = 0; j < filter->output_count; j++) {
+                AVFilterLink *link = filter->outputs[j];
+                unsigned k;
+                int known = 0, cost, min_cost = INT_MAX, min_idx = 0;
+
+                if (!link || !link->in_formats)
+                    continue;
+                if (!first)
+                    first = link;
+                for (k = 0; k < link->in_formats->format_count; k++) {
+                    known = link_format_cost(link, link->in_formats->formats[k], &cost);
+                    if (cost < min_cost) {
+                        min_cost = cost;
+                        min_idx  = k;
+                    }
+                }
+                if (known > best_known) {
+                    best       = link;
+                    best_known = known;
+                    best_idx   = min_idx;
+                }
+            }
+        }
+
+        if (best)
+            pick_format(best, best_idx);
+        else if (first)
+            pick_format(first, 0);
+        else
+            break;
+    }
+
+    for (i = 0; i < graph->filter_count; i++) {
+        AVFilterContext *filter = graph->filters[i];
+        AVFilterLink *in, *out;
+
+        if (filter->input_count != 1 || filter->output_count != 1 ||
+            strcmp(filter->filter->name, "scale"))
+            continue;
+        in  = filter->inputs[0];
+        out = filter->outputs[0];
+        if (in && out && in->type == AVMEDIA_TYPE_VIDEO && in->format != out->format)
+            av_log(log_ctx, AV_LOG_DEBUG, "'%s' converts %s to %s, cost %d\n",
+                   filter->name, format_name(in->type, in->format),
+                   format_name(out->type, out->format),
+                   pix_fmt_conversion_cost(in->format, out->format));
     }
 }
 
@@ -230,12 +433,129 @@ int ff_avfilter_graph_config_formats(AVFilterGraph *graph, AVClass *log_ctx)
         return ret;
 
     /* Once everything is merged, it's possible that we'll still have
-     * multiple valid media format choices. We pick the first one. */
-    pick_formats(graph);
+     * multiple valid media format choices. We pick the ones which need
+     * the fewest conversions. */
+    pick_formats(graph, log_ctx);
 
     return 0;
 }
 
+static int graph_config_pool(AVFilterGraph *graph)
+{
+    int i, j;
+
+    if (!graph->pool_max_size)
+        return 0;
+
+    if (!graph->pool) {
+        if (!(graph->pool = ff_avfilter_pool_alloc(0, graph->pool_max_size)))
+            return AVERROR(ENOMEM);
+        graph->pool->shared = 1;
+    }
+    graph->pool->max_size = graph->pool_max_size;
+
+    for (i = 0; i < graph->filter_count; i++) {
+        AVFilterContext *filt = graph->filters[i];
+        for (j = 0; j < filt->output_count; j++) {
+            AVFilterLink *link = filt->outputs[j];
+            if (link && link->type == AVMEDIA_TYPE_VIDEO && !link->pool)
+                link->pool = ff_avfilter_pool_ref(graph->pool);
+        }
+    }
+
+    return 0;
+}
+
+void avfilter_graph_get_pool_stats(AVFilterGraph *graph, unsigned *hits,
+                                   unsigned *misses, int64_t *size)
+{
+    AVFilterPool *pool = graph->pool;
+
+    *hits = *misses = *size = 0;
+    if (!pool)
+        return;
+#if HAVE_PTHREADS
+    pthread_mutex_lock(&pool->lock);
+#endif
+    *hits   = pool->hits;
+    *misses = pool->misses;
+    *size   = pool->size;
+#if HAVE_PTHREADS
+    pthread_mutex_unlock(&pool->lock);
+#endif
+}
+
+void avfilter_graph_enable_stats(AVFilterGraph *graph, int enable)
+{
+    int i;
+
+    graph->enable_stats = enable;
+    for (i = 0; i < graph->filter_count; i++)
+        graph->filters[i]->enable_stats = enable;
+}
+
+void avfilter_graph_reset_stats(AVFilterGraph *graph)
+{
+    int i, j;
+
+    for (i = 0; i < graph->filter_count; i++) {
+        AVFilterContext *filt = graph->filters[i];
+        memset(&filt->stats, 0, sizeof(filt->stats));
+        for (j = 0; j < filt->input_count; j++)
+            if (filt->inputs[j])
+                memset(&filt->inputs[j]->stats, 0, sizeof(filt->inputs[j]->stats));
+    }
+}
+
+void avfilter_graph_dump_stats(AVFilterGraph *graph, void *log_ctx, int level)
+{
+    uint64_t total = 0;
+    int i, j;
+
+    for (i = 0; i < graph->filter_count; i++)
+        total += graph->filters[i]->stats.time;
+
+    for (i = 0; i < graph->filter_count; i++) {
+        AVFilterContext *filt = graph->filters[i];
+        AVFilterLinkStats in = { 0 }, out = { 0 };
+
+        for (j = 0; j < filt->input_count; j++) {
+            if (!filt->inputs[j])
+                continue;
+            in.frames += filt->inputs[j]->stats.frames;
+            in.bytes  += filt->inputs[j]->stats.bytes;
+        }
+        for (j = 0; j < filt->output_count; j++) {
+            if (!filt->outputs[j])
+                continue;
+            out.frames += filt->outputs[j]->stats.frames;
+            out.bytes  += filt->outputs[j]->stats.bytes;
+        }
+        av_log(log_ctx, level,
+               "%-24s %-10s calls:%8"PRIu64" time:%14"PRIu64" (%5.1f%%) "
+               "in:%6"PRIu64" frames %12"PRIu64" bytes out:%6"PRIu64" frames %12"PRIu64" bytes\n",
+               filt->name ? filt->name : filt->filter->name, filt->filter->name,
+               filt->stats.calls, filt->stats.time,
+               total ? 100.0 * filt->stats.time / total : 0.0,
+               in.frames, in.bytes, out.frames, out.bytes);
+    }
+
+    for (i = 0; i < graph->filter_count; i++) {
+        AVFilterContext *filt = graph->filters[i];
+        for (j = 0; j < filt->output_count; j++) {
+            AVFilterLink *link = filt->outputs[j];
+            if (!link || !link->dst)
+                continue;
+            av_log(log_ctx, level,
+                   "  %s:%s -> %s:%s frames:%"PRIu64" bytes:%"PRIu64" pool hits:%u misses:%u\n",
+                   filt->name ? filt->name : filt->filter->name, link->srcpad->name,
+                   link->dst->name ? link->dst->name : link->dst->filter->name, link->dstpad->name,
+                   link->stats.frames, link->stats.bytes,
+                   link->stats.pool_hits, link->stats.pool_misses);
+        }
+    }
+}
+
 int avfilter_graph_config(AVFilterGraph *graphctx, void *log_ctx)
 {
     int ret;
@@ -244,6 +564,13 @@ int avfilter_graph_config(AVFilterGraph *graphctx, void *log_ctx)
         return ret;
     if ((ret = ff_avfilter_graph_config_formats(graphctx, log_ctx)))
         return ret;
+#if HAVE_PTHREADS
+    /* after format negotiation, so auto-inserted filters are threaded too */
+    if ((ret = ff_avfilter_graph_thread_init(graphctx)))
+        return ret;
+#endif
+    if ((ret = graph_config_pool(graphctx)) < 0)
+        return ret;
     if ((ret = ff_avfilter_graph_config_links(graphctx, log_ctx)))
         return ret;
 
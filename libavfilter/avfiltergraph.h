@@ -29,6 +29,40 @@ typedef struct AVFilterGraph {
     AVFilterContext **filters;
 
     char *scale_sws_opts; ///< sws options to use for the auto-inserted scale filters
+
+    /**
+     * Number of threads the filters of the graph may run execute() jobs
+     * on, including the calling thread. Set by the user before
+     * avfilter_graph_config(); 0 or 1 disable threading.
+     */
+    int thread_count;
+
+    void *thread_opaque;  ///< pool of threads the graph holds a reference to
+
+    /**
+     * Maximum number of bytes of unused video buffers kept by the graph.
+     * If set before avfilter_graph_config(), the links of the graph share
+     * one pool of buffers, so that a buffer released on a link may be
+     * reused on any other link with the same format and dimensions, also
+     * after the graph has been reconfigured. 0 gives each link its own
+     * small pool.
+     */
+    int64_t pool_max_size;
+
+    struct AVFilterPool *pool; ///< buffer pool shared by the links of the graph
+
+    int enable_stats;     ///< set by avfilter_graph_enable_stats(), also applied to filters added later
+
+    /**
+     * Pool of threads to run the execute() jobs of the filters on, which
+     * may be shared with other libraries, e.g. through
+     * avcodec_thread_pool_get(). At most thread_count threads of the pool
+     * work for the graph at once. If NULL, avfilter_graph_config() starts
+     * a pool of thread_count - 1 threads for the graph.
+     * Set by the user before avfilter_graph_config(), which takes a
+     * reference to it.
+     */
+    struct AVThreadPool *thread_pool;
 } AVFilterGraph;
 
 /**
@@ -71,6 +105,8 @@ int avfilter_graph_create_filter(AVFilterContext **filt_ctx, AVFilter *filt,
 
 /**
  * Check validity and configure all the links and formats in the graph.
+ * If thread_count is set, this also sets up the threads of the graph
+ * used by the execute() callback of its filters.
  *
  * @param graphctx the filter graph
  * @param log_ctx context used for logging
@@ -78,6 +114,37 @@ int avfilter_graph_create_filter(AVFilterContext **filt_ctx, AVFilter *filt,
  */
 int avfilter_graph_config(AVFilterGraph *graphctx, void *log_ctx);
 
+/**
+ * Get the statistics of the buffer pool shared by the links of graph.
+ * All the values are 0 if the graph has no such pool.
+ *
+ * @param hits   set to the number of buffer requests served by the pool
+ * @param misses set to the number of buffer requests which needed a new allocation
+ * @param size   set to the number of bytes of the unused buffers kept by the pool
+ */
+void avfilter_graph_get_pool_stats(AVFilterGraph *graph, unsigned *hits,
+                                   unsigned *misses, int64_t *size);
+
+/**
+ * Enable or disable the collection of the stats of the filters and links
+ * of graph, see AVFilterStats and AVFilterLinkStats. Collection is
+ * disabled by default; enabled, it costs two timestamp counter reads per
+ * filter callback.
+ */
+void avfilter_graph_enable_stats(AVFilterGraph *graph, int enable);
+
+/**
+ * Set the stats of the filters and links of graph back to 0.
+ */
+void avfilter_graph_reset_stats(AVFilterGraph *graph);
+
+/**
+ * Print the stats of the filters and links of graph with av_log(), one
+ * line per filter with its time and the data it received and sent, and
+ * one line per link.
+ */
+void avfilter_graph_dump_stats(AVFilterGraph *graph, void *log_ctx, int level);
+
 /**
  * Free a graph, destroy its links, and set *graph to NULL.
  * If *graph is NULL, do nothing.
@@ -21,6 +21,7 @@
 
 #include "libavutil/audioconvert.h"
 #include "libavutil/imgutils.h"
+#include "libavutil/pixdesc.h"
 #include "libavutil/samplefmt.h"
 #include "avfilter.h"
 #include "internal.h"
@@ -36,48 +37,17 @@ void ff_avfilter_default_free_buffer(AVFilterBuffer *ptr)
  * alloc & free cycle currently implemented. */
 AVFilterBufferRef *avfilter_default_get_video_buffer(AVFilterLink *link, int perms, int w, int h)
 {
-    int linesize[4];
-    uint8_t *data[4];
-    int i;
-    AVFilterBufferRef *picref = NULL;
-    AVFilterPool *pool = link->pool;
-
-    if (pool) {
-        for (i = 0; i < POOL_SIZE; i++) {
-            picref = pool->pic[i];
-            if (picref && picref->buf->format == link->format && picref->buf->w == w && picref->buf->h == h) {
-                AVFilterBuffer *pic = picref->buf;
-                pool->pic[i] = NULL;
-                pool->count--;
-                picref->video->w = w;
-                picref->video->h = h;
-                picref->perms = perms | AV_PERM_READ;
-                picref->format = link->format;
-                pic->refcount = 1;
-                memcpy(picref->data,     pic->data,     sizeof(picref->data));
-                memcpy(picref->linesize, pic->linesize, sizeof(picref->linesize));
-                return picref;
-            }
-        }
-    } else
-        pool = link->pool = av_mallocz(sizeof(AVFilterPool));
-
-    // align: +2 is needed for swscaler, +16 to be SIMD-friendly
-    if ((i = av_image_alloc(data, linesize, w, h, link->format, 16)) < 0)
-        return NULL;
-
-    picref = avfilter_get_video_buffer_ref_from_arrays(data, linesize,
-                                                       perms, w, h, link->format);
-    if (!picref) {
-        av_free(data[0]);
+    if (av_pix_fmt_descriptors[link->format].flags & PIX_FMT_HWACCEL) {
+        av_log(link->dst, AV_LOG_ERROR,
+               "Cannot allocate a %s picture, hardware surfaces must come from the source\n",
+               av_pix_fmt_descriptors[link->format].name);
         return NULL;
     }
-    memset(data[0], 128, i);
-
-    picref->buf->priv = pool;
-    picref->buf->free = NULL;
+    if (!link->pool && !(link->pool = ff_avfilter_pool_alloc(POOL_SIZE, 0)))
+        return NULL;
 
-    return picref;
+    return ff_avfilter_pool_get_video_buffer(link->pool, perms, w, h, link->format,
+                                             link->dst->enable_stats ? &link->stats : NULL);
 }
 
 AVFilterBufferRef *avfilter_default_get_audio_buffer(AVFilterLink *link, int perms,
@@ -114,11 +84,18 @@ void avfilter_default_start_frame(AVFilterLink *inlink, AVFilterBufferRef *picre
     if (inlink->dst->output_count)
         outlink = inlink->dst->outputs[0];
 
-    if (outlink) {
-        outlink->out_buf = avfilter_get_video_buffer(outlink, AV_PERM_WRITE, outlink->w, outlink->h);
-        avfilter_copy_buffer_ref_props(outlink->out_buf, picref);
-        avfilter_start_frame(outlink, avfilter_ref_buffer(outlink->out_buf, ~0));
+    if (!outlink)
+        return;
+
+    /* a hardware surface cannot be copied, pass it along */
+    if (av_pix_fmt_descriptors[outlink->format].flags & PIX_FMT_HWACCEL) {
+        avfilter_start_frame(outlink, avfilter_ref_buffer(picref, ~0));
+        return;
     }
+
+    outlink->out_buf = avfilter_get_video_buffer(outlink, AV_PERM_WRITE, outlink->w, outlink->h);
+    avfilter_copy_buffer_ref_props(outlink->out_buf, picref);
+    avfilter_start_frame(outlink, avfilter_ref_buffer(outlink->out_buf, ~0));
 }
 
 void avfilter_default_draw_slice(AVFilterLink *inlink, int y, int h, int slice_dir)
@@ -241,13 +218,34 @@ void avfilter_set_common_channel_layouts(AVFilterContext *ctx, AVFilterFormats *
 
 int avfilter_default_query_formats(AVFilterContext *ctx)
 {
-    avfilter_set_common_pixel_formats(ctx, avfilter_all_formats(AVMEDIA_TYPE_VIDEO));
+    AVFilterFormats *pix_fmts = avfilter_all_formats(AVMEDIA_TYPE_VIDEO);
+    enum PixelFormat pix_fmt;
+
+    if (ctx->filter->flags & AVFILTER_FLAG_HWACCEL)
+        for (pix_fmt = 0; pix_fmt < PIX_FMT_NB; pix_fmt++)
+            if (av_pix_fmt_descriptors[pix_fmt].flags & PIX_FMT_HWACCEL)
+                avfilter_add_format(&pix_fmts, pix_fmt);
+
+    avfilter_set_common_pixel_formats(ctx, pix_fmts);
     avfilter_set_common_sample_formats(ctx, avfilter_all_formats(AVMEDIA_TYPE_AUDIO));
     avfilter_set_common_channel_layouts(ctx, avfilter_all_channel_layouts());
 
     return 0;
 }
 
+int avfilter_default_execute(AVFilterContext *ctx, avfilter_action_func *func,
+                             void *arg, int *ret, int nb_jobs)
+{
+    int i;
+
+    for (i = 0; i < nb_jobs; i++) {
+        int r = func(ctx, arg, i, nb_jobs);
+        if (ret)
+            ret[i] = r;
+    }
+    return 0;
+}
+
 void avfilter_null_start_frame(AVFilterLink *link, AVFilterBufferRef *picref)
 {
     avfilter_start_frame(link->dst->outputs[0], picref);
@@ -115,3 +115,14 @@ void ff_copy_rectangle(uint8_t *dst[4], int dst_linesize[4],
         }
     }
 }
+
+/* exact division by 255 with rounding, for x in [0, 255*255] */
+#define FAST_DIV255(x) ((((x) + 128) * 257) >> 16)
+
+void ff_blend_row_c(uint8_t *dst, const uint8_t *src, const uint8_t *alpha, int width)
+{
+    int x;
+
+    for (x = 0; x < width; x++)
+        dst[x] = FAST_DIV255(dst[x] * (255 - alpha[x]) + src[x] * alpha[x]);
+}
@@ -40,4 +40,11 @@ void ff_copy_rectangle(uint8_t *dst[4], int dst_linesize[4],
                        uint8_t *src[4], int src_linesize[4], int pixelstep[4],
                        int hsub, int vsub, int x, int y, int y2, int w, int h);
 
+/**
+ * Blend a row of pixels of src into dst with the weights alpha:
+ * dst[x] = (dst[x] * (255 - alpha[x]) + src[x] * alpha[x]) / 255, rounded.
+ */
+void ff_blend_row_c   (uint8_t *dst, const uint8_t *src, const uint8_t *alpha, int width);
+void ff_blend_row_sse2(uint8_t *dst, const uint8_t *src, const uint8_t *alpha, int width);
+
 #endif /* AVFILTER_DRAWUTILS_H */
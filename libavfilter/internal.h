@@ -24,15 +24,65 @@
  * internal API functions
  */
 
+#include "config.h"
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
 #include "avfilter.h"
 #include "avfiltergraph.h"
 
 #define POOL_SIZE 32
+
+/**
+ * Video buffers kept for reuse, keyed on their format and dimensions.
+ * Each link has its own pool of at most POOL_SIZE buffers, unless the
+ * graph has a pool shared by all its links.
+ */
 typedef struct AVFilterPool {
-    AVFilterBufferRef *pic[POOL_SIZE];
-    int count;
+    AVFilterBufferRef **pic;    ///< buffers kept for reuse, with NULL for unused slots
+    int nb_slots;               ///< number of elements of pic
+    int count;                  ///< number of buffers in pic
+    int max_count;              ///< maximum number of buffers kept, 0 for no limit
+    int64_t size;               ///< bytes used by the buffers in pic
+    int64_t max_size;           ///< maximum number of bytes kept, 0 for no limit
+    int shared;                 ///< set for the pool of a graph, also used by the links inserted later
+    int refcount;               ///< number of links and graphs using the pool
+    int nb_out;                 ///< number of buffers from the pool which are in use
+    unsigned hits;              ///< requests served with a kept buffer
+    unsigned misses;            ///< requests which needed a new buffer
+#if HAVE_PTHREADS
+    pthread_mutex_t lock;       ///< filters may run on several threads
+#endif
 } AVFilterPool;
 
+/**
+ * Allocate a pool, referenced once by the caller.
+ *
+ * @param max_count maximum number of buffers kept, 0 for no limit
+ * @param max_size  maximum number of bytes kept, 0 for no limit
+ */
+AVFilterPool *ff_avfilter_pool_alloc(int max_count, int64_t max_size);
+
+/** Add a reference to pool and return it. */
+AVFilterPool *ff_avfilter_pool_ref(AVFilterPool *pool);
+
+/**
+ * Remove a reference to *pool and set it to NULL. Once no references
+ * are left the kept buffers are freed, and the pool itself is freed once
+ * all buffers taken from it are unreferenced.
+ */
+void ff_avfilter_pool_unref(AVFilterPool **pool);
+
+/**
+ * Get a video buffer from pool, reusing a kept buffer with the same
+ * format and dimensions if there is one.
+ *
+ * @param stats if not NULL, the hit or miss is also counted there
+ */
+AVFilterBufferRef *ff_avfilter_pool_get_video_buffer(AVFilterPool *pool, int perms,
+                                                     int w, int h, enum PixelFormat format,
+                                                     AVFilterLinkStats *stats);
+
 /**
  * Check for the validity of graph.
  *
@@ -55,6 +105,21 @@ int ff_avfilter_graph_config_links(AVFilterGraph *graphctx, AVClass *log_ctx);
  */
 int ff_avfilter_graph_config_formats(AVFilterGraph *graphctx, AVClass *log_ctx);
 
+/**
+ * Get the thread pool of graphctx, or start one, and make all its
+ * filters run their execute() jobs on it. Does nothing if
+ * graphctx->thread_count is lower than 2. If the graph already has a
+ * pool, filters added since are set up to use it too.
+ *
+ * @return 0 in case of success, a negative AVERROR code otherwise
+ */
+int ff_avfilter_graph_thread_init(AVFilterGraph *graphctx);
+
+/**
+ * Release the thread pool of graphctx.
+ */
+void ff_avfilter_graph_thread_free(AVFilterGraph *graphctx);
+
 /** default handler for freeing audio/video buffer when there are no references left */
 void ff_avfilter_default_free_buffer(AVFilterBuffer *buf);
 
@@ -0,0 +1,52 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_OVERLAY_H
+#define AVFILTER_OVERLAY_H
+
+#include "avfilter.h"
+
+/// Extent of the pixels of an overlay row which are not fully transparent.
+typedef struct {
+    int start, end;             ///< first and past the last non-transparent pixel
+    int opaque;                 ///< set if all the pixels of the extent are opaque
+} RowExtent;
+
+typedef struct {
+    int x, y;                   ///< position of overlayed picture
+
+    AVFilterBufferRef *overpicref;
+
+    int max_plane_step[4];      ///< steps per pixel for each plane
+    int hsub, vsub;             ///< chroma subsampling values
+
+    char x_expr[256], y_expr[256];
+
+    /* Computed once per overlay picture, so that a static overlay is only
+     * analyzed once; index 0 is for the luma plane, 1 for the chroma ones. */
+    const uint8_t *alpha[2];    ///< alpha of each pixel of the planes
+    int alpha_linesize[2];
+    int alpha_h[2];             ///< number of rows of the planes
+    uint8_t *alpha_uv;          ///< alpha averaged to the chroma resolution
+    RowExtent *extents[2];      ///< extents of the rows of the planes
+
+    /// DSP functions.
+    void (*blend_row)(uint8_t *dst, const uint8_t *src, const uint8_t *alpha, int width);
+} OverlayContext;
+
+#endif /* AVFILTER_OVERLAY_H */
@@ -0,0 +1,98 @@
+/*
+ * filter graph threads
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * threads of a filter graph, running the execute() jobs of its filters
+ * on an AVThreadPool
+ */
+
+#include "libavutil/common.h"
+#include "libavutil/threadpool.h"
+#include "avfilter.h"
+#include "avfiltergraph.h"
+#include "internal.h"
+
+typedef struct ExecuteJobs {
+    AVFilterContext *ctx;
+    avfilter_action_func *func;
+    void *arg;
+    int nb_jobs;
+} ExecuteJobs;
+
+static int execute_job(void *arg, int jobnr, int threadnr)
+{
+    ExecuteJobs *j = arg;
+
+    return j->func(j->ctx, j->arg, jobnr, j->nb_jobs);
+}
+
+static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
+                          void *arg, int *ret, int nb_jobs)
+{
+    ExecuteJobs j = { ctx, func, arg, nb_jobs };
+
+    /* Filters may run on several threads, e.g. around a tfifo filter, and
+     * the pool may be busy with other libraries; the calling thread runs
+     * the jobs no other thread picks up. */
+    return av_thread_pool_execute(ctx->thread_opaque, execute_job, &j, ret,
+                                  nb_jobs, ctx->thread_count);
+}
+
+int ff_avfilter_graph_thread_init(AVFilterGraph *graph)
+{
+    AVThreadPool *pool = graph->thread_opaque;
+    int i, thread_count;
+
+    if (graph->thread_count <= 1)
+        return 0;
+
+    if (!pool) {
+        if (graph->thread_pool)
+            pool = av_thread_pool_ref(graph->thread_pool);
+        else
+            pool = av_thread_pool_alloc(graph->thread_count - 1);
+        if (!pool)
+            return AVERROR(ENOMEM);
+        if (!av_thread_pool_nb_threads(pool)) {
+            av_thread_pool_unref(&pool);
+            return 0;
+        }
+        graph->thread_opaque = pool;
+    }
+    thread_count = FFMIN(graph->thread_count, av_thread_pool_nb_threads(pool) + 1);
+
+    for (i = 0; i < graph->filter_count; i++) {
+        AVFilterContext *filter = graph->filters[i];
+        filter->execute       = thread_execute;
+        filter->thread_count  = thread_count;
+        filter->thread_opaque = pool;
+    }
+
+    return 0;
+}
+
+void ff_avfilter_graph_thread_free(AVFilterGraph *graph)
+{
+    AVThreadPool *pool = graph->thread_opaque;
+
+    av_thread_pool_unref(&pool);
+    graph->thread_opaque = NULL;
+}
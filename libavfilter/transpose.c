@@ -0,0 +1,129 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * block transposition of image planes
+ */
+
+#include "libavutil/common.h"
+#include "libavutil/cpu.h"
+#include "libavutil/error.h"
+#include "libavutil/intreadwrite.h"
+#include "transpose.h"
+
+/* side of the square tiles, in pixels */
+#define TILE 64
+
+#define TRANSPOSE_FUNCS(bits, copy_pixel)                                     \
+static void transpose_block_##bits##_c(uint8_t *dst, int dst_linesize,        \
+                                       const uint8_t *src, int src_linesize,  \
+                                       int w, int h)                          \
+{                                                                             \
+    int x, y;                                                                 \
+                                                                              \
+    for (y = 0; y < h; y++) {                                                 \
+        const uint8_t *in = src + y * (bits / 8);                             \
+        for (x = 0; x < w; x++)                                               \
+            copy_pixel(dst + x * (bits / 8), in + x * src_linesize);          \
+        dst += dst_linesize;                                                  \
+    }                                                                         \
+}                                                                             \
+                                                                              \
+static void transpose_8x8_##bits##_c(uint8_t *dst, int dst_linesize,          \
+                                     const uint8_t *src, int src_linesize)    \
+{                                                                             \
+    transpose_block_##bits##_c(dst, dst_linesize, src, src_linesize, 8, 8);   \
+}
+
+#define COPY8(dst, src)  *(dst) = *(src)
+#define COPY16(dst, src) AV_WN16(dst, AV_RN16(src))
+#define COPY24(dst, src) AV_WB24(dst, AV_RB24(src))
+#define COPY32(dst, src) AV_WN32(dst, AV_RN32(src))
+
+TRANSPOSE_FUNCS( 8, COPY8)
+TRANSPOSE_FUNCS(16, COPY16)
+TRANSPOSE_FUNCS(24, COPY24)
+TRANSPOSE_FUNCS(32, COPY32)
+
+int ff_transpose_init(TransVtable *v, int pixstep)
+{
+    av_unused int cpu_flags = av_get_cpu_flags();
+
+    v->pixstep = pixstep;
+    switch (pixstep) {
+    case 1:
+        v->transpose_8x8   = transpose_8x8_8_c;
+        v->transpose_block = transpose_block_8_c;
+        if (HAVE_SSE && cpu_flags & AV_CPU_FLAG_SSE2)
+            v->transpose_8x8 = ff_transpose_8x8_8_sse2;
+        break;
+    case 2:
+        v->transpose_8x8   = transpose_8x8_16_c;
+        v->transpose_block = transpose_block_16_c;
+        if (HAVE_SSE && cpu_flags & AV_CPU_FLAG_SSE2)
+            v->transpose_8x8 = ff_transpose_8x8_16_sse2;
+        break;
+    case 3:
+        v->transpose_8x8   = transpose_8x8_24_c;
+        v->transpose_block = transpose_block_24_c;
+        break;
+    case 4:
+        v->transpose_8x8   = transpose_8x8_32_c;
+        v->transpose_block = transpose_block_32_c;
+        if (HAVE_SSE && cpu_flags & AV_CPU_FLAG_SSE2)
+            v->transpose_8x8 = ff_transpose_8x8_32_sse2;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+    return 0;
+}
+
+void ff_transpose_plane(const TransVtable *v, uint8_t *dst, int dst_linesize,
+                        const uint8_t *src, int src_linesize, int w, int h)
+{
+    int ps = v->pixstep;
+    int x, y, x0, y0;
+
+    for (y0 = 0; y0 < h; y0 += TILE) {
+        int th = FFMIN(TILE, h - y0);
+
+        for (x0 = 0; x0 < w; x0 += TILE) {
+            int tw = FFMIN(TILE, w - x0);
+
+            for (y = y0; y < y0 + th; y += 8) {
+                uint8_t       *out = dst + y * dst_linesize  + x0 * ps;
+                const uint8_t *in  = src + x0 * src_linesize + y  * ps;
+                int bh = FFMIN(8, y0 + th - y);
+
+                if (bh < 8) {
+                    v->transpose_block(out, dst_linesize, in, src_linesize, tw, bh);
+                    continue;
+                }
+                for (x = 0; x + 8 <= tw; x += 8) {
+                    v->transpose_8x8(out, dst_linesize, in, src_linesize);
+                    out += 8 * ps;
+                    in  += 8 * src_linesize;
+                }
+                if (x < tw)
+                    v->transpose_block(out, dst_linesize, in, src_linesize, tw - x, 8);
+            }
+        }
+    }
+}
@@ -0,0 +1,65 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_TRANSPOSE_H
+#define AVFILTER_TRANSPOSE_H
+
+/**
+ * @file
+ * block transposition of image planes
+ *
+ * The planes are transposed in tiles, so that both the rows read and the
+ * rows written by a tile stay in the cache, and each tile is transposed in
+ * blocks of 8x8 pixels. The linesizes may be negative to flip the source or
+ * the destination.
+ */
+
+#include <stdint.h>
+
+typedef struct {
+    int pixstep;    ///< size of a pixel in bytes
+
+    /// Transpose a block of 8x8 pixels: dst[y][x] = src[x][y].
+    void (*transpose_8x8)(uint8_t *dst, int dst_linesize,
+                          const uint8_t *src, int src_linesize);
+    /// Transpose a block of w columns and h rows of the destination.
+    void (*transpose_block)(uint8_t *dst, int dst_linesize,
+                            const uint8_t *src, int src_linesize, int w, int h);
+} TransVtable;
+
+/**
+ * Fill v with the fastest functions for pixels of pixstep bytes.
+ *
+ * @return 0 on success, a negative AVERROR code if pixstep is not supported
+ */
+int ff_transpose_init(TransVtable *v, int pixstep);
+
+/**
+ * Transpose a plane: dst[y][x] = src[x][y] for x < w and y < h.
+ *
+ * @param w width of the destination, height of the source
+ * @param h height of the destination, width of the source
+ */
+void ff_transpose_plane(const TransVtable *v, uint8_t *dst, int dst_linesize,
+                        const uint8_t *src, int src_linesize, int w, int h);
+
+void ff_transpose_8x8_8_sse2 (uint8_t *dst, int dst_linesize, const uint8_t *src, int src_linesize);
+void ff_transpose_8x8_16_sse2(uint8_t *dst, int dst_linesize, const uint8_t *src, int src_linesize);
+void ff_transpose_8x8_32_sse2(uint8_t *dst, int dst_linesize, const uint8_t *src, int src_linesize);
+
+#endif /* AVFILTER_TRANSPOSE_H */
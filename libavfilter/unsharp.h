@@ -0,0 +1,74 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_UNSHARP_H
+#define AVFILTER_UNSHARP_H
+
+#include "avfilter.h"
+
+typedef struct FilterParam {
+    int msize_x;                             ///< matrix width
+    int msize_y;                             ///< matrix height
+    int amount;                              ///< effect amount
+    int steps_x;                             ///< horizontal step count
+    int steps_y;                             ///< vertical step count
+    int scalebits;                           ///< bits to shift pixel
+    int32_t halfscale;                       ///< amount to add to pixel
+    uint32_t **sc;                           ///< finite state machine storage, 2 * steps_y rows per thread
+} FilterParam;
+
+typedef struct {
+    FilterParam luma;   ///< luma parameters (width, height, amount)
+    FilterParam chroma; ///< chroma parameters (width, height, amount)
+    uint32_t *line;     ///< one line of horizontal sums per thread
+    int line_size;      ///< number of elements of each line
+    /// DSP functions.
+    void (*add_pairs)(uint32_t *buf, int len);
+    void (*blur_v)   (uint32_t *buf, uint32_t **sc, int width, int steps);
+    void (*blend)    (uint8_t *dst, const uint8_t *src, const uint32_t *blur, int width,
+                      int amount, int halfscale, int scalebits);
+} UnsharpContext;
+
+/**
+ * Set buf[i] to buf[i] + buf[i+1] for i from 0 to len-1.
+ * The SIMD versions round len up to a multiple of 4, so buf must have
+ * len + 4 elements and be 16-byte aligned.
+ */
+void ff_unsharp_add_pairs_c(uint32_t *buf, int len);
+
+/**
+ * Run the 2 * steps vertical state machine stages on the horizontal sums
+ * of width pixels in buf, leaving the output of the last stage in buf.
+ * buf and the rows of sc must have FFALIGN(width, 4) elements and be
+ * 16-byte aligned.
+ */
+void ff_unsharp_blur_v_c(uint32_t *buf, uint32_t **sc, int width, int steps);
+
+/**
+ * Sharpen or blur a line of src by amount, blur being the unscaled
+ * blurred line.
+ */
+void ff_unsharp_blend_c(uint8_t *dst, const uint8_t *src, const uint32_t *blur, int width,
+                        int amount, int halfscale, int scalebits);
+
+void ff_unsharp_add_pairs_sse2(uint32_t *buf, int len);
+void ff_unsharp_blur_v_sse2(uint32_t *buf, uint32_t **sc, int width, int steps);
+void ff_unsharp_blend_sse2(uint8_t *dst, const uint8_t *src, const uint32_t *blur, int width,
+                           int amount, int halfscale, int scalebits);
+
+#endif /* AVFILTER_UNSHARP_H */
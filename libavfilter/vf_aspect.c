@@ -91,6 +91,7 @@ static int setdar_config_props(AVFilterLink *inlink)
 AVFilter avfilter_vf_setdar = {
     .name      = "setdar",
     .description = NULL_IF_CONFIG_SMALL("Set the frame display aspect ratio."),
+    .flags       = AVFILTER_FLAG_HWACCEL,
 
     .init      = init,
 
@@ -124,6 +125,7 @@ static int setsar_config_props(AVFilterLink *inlink)
 AVFilter avfilter_vf_setsar = {
     .name      = "setsar",
     .description = NULL_IF_CONFIG_SMALL("Set the pixel sample aspect ratio."),
+    .flags       = AVFILTER_FLAG_HWACCEL,
 
     .init      = init,
 
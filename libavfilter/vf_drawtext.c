@@ -30,6 +30,7 @@
 #include <time.h>
 
 #include "libavutil/colorspace.h"
+#include "libavutil/cpu.h"
 #include "libavutil/file.h"
 #include "libavutil/opt.h"
 #include "libavutil/parseutils.h"
@@ -45,6 +46,18 @@
 #include FT_FREETYPE_H
 #include FT_GLYPH_H
 
+/**
+ * Glyphs of the text prerendered as an alpha mask, blended on the frames
+ * with a constant color.
+ */
+typedef struct {
+    int x, y;                       ///< position in the picture, aligned to the chroma subsampling
+    int w[3], h[3];                 ///< size in bytes and rows of the area of each plane
+    uint8_t *alpha[3];              ///< alpha of each byte of the area, including the alpha of the color
+    int alpha_linesize[3];
+    uint8_t *color_line[3];         ///< a row of the area filled with the color
+} TextMask;
+
 typedef struct {
     const AVClass *class;
     uint8_t *fontfile;              ///< font to be used
@@ -81,6 +94,14 @@ typedef struct {
     int pixel_step[4];              ///< distance in bytes between the component of each pixel
     uint8_t rgba_map[4];            ///< map RGBA offsets to the positions in the packed RGBA format
     uint8_t *box_line[4];           ///< line used for filling the box background
+
+    char *rendered_text;            ///< text the masks were rendered from
+    int box_w, box_h;               ///< size of the box around the rendered text
+    TextMask text_mask;             ///< rendered text
+    TextMask shadow_mask;           ///< rendered shadow of the text
+
+    /// DSP functions.
+    void (*blend_row)(uint8_t *dst, const uint8_t *src, const uint8_t *alpha, int width);
 } DrawTextContext;
 
 #define OFFSET(x) offsetof(DrawTextContext, x)
@@ -221,6 +242,7 @@ static av_cold int init(AVFilterContext *ctx, const char *args, void *opaque)
     int err;
     DrawTextContext *dtext = ctx->priv;
     Glyph *glyph;
+    av_unused int cpu_flags = av_get_cpu_flags();
 
     dtext->class = &drawtext_class;
     av_opt_set_defaults2(dtext, 0, 0);
@@ -305,6 +327,10 @@ static av_cold int init(AVFilterContext *ctx, const char *args, void *opaque)
 
     dtext->use_kerning = FT_HAS_KERNING(dtext->face);
 
+    dtext->blend_row = ff_blend_row_c;
+    if (HAVE_SSE && cpu_flags & AV_CPU_FLAG_SSE2)
+        dtext->blend_row = ff_blend_row_sse2;
+
     /* load the fallback glyph with code 0 */
     load_glyph(ctx, NULL, 0);
 
@@ -338,6 +364,19 @@ static int query_formats(AVFilterContext *ctx)
     return 0;
 }
 
+static void free_mask(TextMask *mask)
+{
+    int i;
+
+    av_freep(&mask->alpha[0]);
+    av_freep(&mask->alpha[1]);
+    mask->alpha[2] = NULL; /* shared with alpha[1] */
+    for (i = 0; i < 3; i++) {
+        av_freep(&mask->color_line[i]);
+        mask->w[i] = mask->h[i] = 0;
+    }
+}
+
 static int glyph_enu_free(void *opaque, void *elem)
 {
     av_free(elem);
@@ -356,6 +395,9 @@ static av_cold void uninit(AVFilterContext *ctx)
     av_freep(&dtext->boxcolor_string);
     av_freep(&dtext->positions);
     av_freep(&dtext->shadowcolor_string);
+    av_freep(&dtext->rendered_text);
+    free_mask(&dtext->text_mask);
+    free_mask(&dtext->shadow_mask);
     av_tree_enumerate(dtext->glyphs, NULL, NULL, glyph_enu_free);
     av_tree_destroy(dtext->glyphs);
     dtext->glyphs = 0;
@@ -403,7 +445,7 @@ static int config_input(AVFilterLink *inlink)
 
 #define GET_BITMAP_VAL(r, c)                                            \
     bitmap->pixel_mode == FT_PIXEL_MODE_MONO ?                          \
-        (bitmap->buffer[(r) * bitmap->pitch + ((c)>>3)] & (0x80 >> ((c)&7))) * 255 : \
+        !!(bitmap->buffer[(r) * bitmap->pitch + ((c)>>3)] & (0x80 >> ((c)&7))) * 255 : \
          bitmap->buffer[(r) * bitmap->pitch +  (c)]
 
 #define SET_PIXEL_YUV(picref, yuva_color, val, x, y, hsub, vsub) {           \
@@ -418,33 +460,6 @@ static int config_input(AVFilterLink *inlink)
     }\
 }
 
-static inline int draw_glyph_yuv(AVFilterBufferRef *picref, FT_Bitmap *bitmap, unsigned int x,
-                                 unsigned int y, unsigned int width, unsigned int height,
-                                 const uint8_t yuva_color[4], int hsub, int vsub)
-{
-    int r, c, alpha;
-    unsigned int luma_pos, chroma_pos1, chroma_pos2;
-    uint8_t src_val, dst_pixel[4];
-
-    for (r = 0; r < bitmap->rows && r+y < height; r++) {
-        for (c = 0; c < bitmap->width && c+x < width; c++) {
-            /* get pixel in the picref (destination) */
-            dst_pixel[0] = picref->data[0][  c+x           +  (y+r)          * picref->linesize[0]];
-            dst_pixel[1] = picref->data[1][((c+x) >> hsub) + ((y+r) >> vsub) * picref->linesize[1]];
-            dst_pixel[2] = picref->data[2][((c+x) >> hsub) + ((y+r) >> vsub) * picref->linesize[2]];
-
-            /* get intensity value in the glyph bitmap (source) */
-            src_val = GET_BITMAP_VAL(r, c);
-            if (!src_val)
-                continue;
-
-            SET_PIXEL_YUV(picref, yuva_color, src_val, c+x, y+r, hsub, vsub);
-        }
-    }
-
-    return 0;
-}
-
 #define SET_PIXEL_RGB(picref, rgba_color, val, x, y, pixel_step, r_off, g_off, b_off, a_off) { \
     p   = picref->data[0] + (x) * pixel_step + ((y) * picref->linesize[0]); \
     alpha = rgba_color[3] * (val) * 129;                              \
@@ -453,38 +468,6 @@ static inline int draw_glyph_yuv(AVFilterBufferRef *picref, FT_Bitmap *bitmap, u
     *(p+b_off) = (alpha * rgba_color[2] + (255*255*129 - alpha) * *(p+b_off)) >> 23; \
 }
 
-static inline int draw_glyph_rgb(AVFilterBufferRef *picref, FT_Bitmap *bitmap,
-                                 unsigned int x, unsigned int y,
-                                 unsigned int width, unsigned int height, int pixel_step,
-                                 const uint8_t rgba_color[4], const uint8_t rgba_map[4])
-{
-    int r, c, alpha;
-    uint8_t *p;
-    uint8_t src_val, dst_pixel[4];
-
-    for (r = 0; r < bitmap->rows && r+y < height; r++) {
-        for (c = 0; c < bitmap->width && c+x < width; c++) {
-            /* get pixel in the picref (destination) */
-            dst_pixel[0] = picref->data[0][(c+x + rgba_map[0]) * pixel_step +
-                                           (y+r) * picref->linesize[0]];
-            dst_pixel[1] = picref->data[0][(c+x + rgba_map[1]) * pixel_step +
-                                           (y+r) * picref->linesize[0]];
-            dst_pixel[2] = picref->data[0][(c+x + rgba_map[2]) * pixel_step +
-                                           (y+r) * picref->linesize[0]];
-
-            /* get intensity value in the glyph bitmap (source) */
-            src_val = GET_BITMAP_VAL(r, c);
-            if (!src_val)
-                continue;
-
-            SET_PIXEL_RGB(picref, rgba_color, src_val, c+x, y+r, pixel_step,
-                          rgba_map[0], rgba_map[1], rgba_map[2], rgba_map[3]);
-        }
-    }
-
-    return 0;
-}
-
 static inline void drawbox(AVFilterBufferRef *picref, unsigned int x, unsigned int y,
                            unsigned int width, unsigned int height,
                            uint8_t *line[4], int pixel_step[4], uint8_t color[4],
@@ -517,17 +500,28 @@ static inline int is_newline(uint32_t c)
     return (c == '\n' || c == '\r' || c == '\f' || c == '\v');
 }
 
-static int draw_glyphs(DrawTextContext *dtext, AVFilterBufferRef *picref,
-                       int width, int height, const uint8_t rgbcolor[4], const uint8_t yuvcolor[4], int x, int y)
+/**
+ * Render the glyphs of text, at the positions computed by layout_text()
+ * moved by dx, dy, into an alpha mask for the given color.
+ */
+static int render_mask(DrawTextContext *dtext, TextMask *mask, const uint8_t *text,
+                       int dx, int dy, int width, int height,
+                       const uint8_t rgbcolor[4], const uint8_t yuvcolor[4])
 {
-    char *text = HAVE_LOCALTIME_R ? dtext->expanded_text : dtext->text;
+    int hsub = dtext->hsub, vsub = dtext->vsub;
+    int x0 = width, y0 = height, x1 = 0, y1 = 0;
+    int i, r, c, w, h, plane;
     uint32_t code = 0;
-    int i;
-    uint8_t *p;
-    Glyph *glyph = NULL;
+    const uint8_t *p;
+    uint8_t *cov;
+    Glyph *glyph;
 
+    free_mask(mask);
+
+    /* area of the picture covered by the glyphs */
     for (i = 0, p = text; *p; i++) {
         Glyph dummy = { 0 };
+        int gx, gy;
         GET_UTF8(code, *p++, continue;);
 
         /* skip new line chars, just go to new line */
@@ -541,60 +535,149 @@ static int draw_glyphs(DrawTextContext *dtext, AVFilterBufferRef *picref,
             glyph->bitmap.pixel_mode != FT_PIXEL_MODE_GRAY)
             return AVERROR(EINVAL);
 
-        if (dtext->is_packed_rgb) {
-            draw_glyph_rgb(picref, &glyph->bitmap,
-                           dtext->positions[i].x+x, dtext->positions[i].y+y, width, height,
-                           dtext->pixel_step[0], rgbcolor, dtext->rgba_map);
-        } else {
-            draw_glyph_yuv(picref, &glyph->bitmap,
-                           dtext->positions[i].x+x, dtext->positions[i].y+y, width, height,
-                           yuvcolor, dtext->hsub, dtext->vsub);
+        gx = dtext->positions[i].x + dx;
+        gy = dtext->positions[i].y + dy;
+        x0 = FFMIN(x0, FFMAX(gx, 0));
+        y0 = FFMIN(y0, FFMAX(gy, 0));
+        x1 = FFMAX(x1, FFMIN(gx + glyph->bitmap.width, width));
+        y1 = FFMAX(y1, FFMIN(gy + glyph->bitmap.rows,  height));
+    }
+    if (x0 >= x1 || y0 >= y1)
+        return 0;
+
+    /* the chroma samples are blended with the alpha of their top left luma sample */
+    x0 &= ~((1 << hsub) - 1);
+    y0 &= ~((1 << vsub) - 1);
+    w = x1 - x0;
+    h = y1 - y0;
+    mask->x = x0;
+    mask->y = y0;
+
+    if (!(cov = av_mallocz(w * h)))
+        return AVERROR(ENOMEM);
+
+    for (i = 0, p = text; *p; i++) {
+        Glyph dummy = { 0 };
+        FT_Bitmap *bitmap;
+        int gx, gy;
+        GET_UTF8(code, *p++, continue;);
+
+        if (code == '\n' || code == '\r' || code == '\t')
+            continue;
+
+        dummy.code = code;
+        glyph  = av_tree_find(dtext->glyphs, &dummy, (void *)glyph_cmp, NULL);
+        bitmap = &glyph->bitmap;
+        gx = dtext->positions[i].x + dx;
+        gy = dtext->positions[i].y + dy;
+
+        for (r = FFMAX(0, -gy); r < bitmap->rows && gy + r < height; r++) {
+            uint8_t *dst = cov + (gy + r - y0) * w + gx - x0;
+            for (c = FFMAX(0, -gx); c < bitmap->width && gx + c < width; c++) {
+                /* get intensity value in the glyph bitmap (source) */
+                int val = GET_BITMAP_VAL(r, c);
+                /* overlapping glyphs cover as much as if they were blended one after the other */
+                dst[c] += val - (dst[c] * val + 127) / 255;
+            }
+        }
+    }
+
+    if (rgbcolor[3] != 255)
+        for (i = 0; i < w * h; i++)
+            cov[i] = (cov[i] * rgbcolor[3] + 127) / 255;
+
+    if (dtext->is_packed_rgb) {
+        int step = dtext->pixel_step[0];
+        uint8_t *alpha;
+
+        mask->w[0] = w * step;
+        mask->h[0] = h;
+        mask->alpha_linesize[0] = w * step;
+        if (!(mask->alpha[0] = alpha = av_mallocz(w * step * h)) ||
+            !(mask->color_line[0] = av_mallocz(w * step))) {
+            av_free(cov);
+            free_mask(mask);
+            return AVERROR(ENOMEM);
+        }
+        /* the alpha component of the picture is left untouched */
+        for (i = 0; i < w * h; i++)
+            for (c = 0; c < 3; c++)
+                alpha[i * step + dtext->rgba_map[c]] = cov[i];
+        for (i = 0; i < w; i++)
+            for (c = 0; c < 3; c++)
+                mask->color_line[0][i * step + dtext->rgba_map[c]] = rgbcolor[c];
+        av_free(cov);
+    } else {
+        int cw = ((x1 - 1) >> hsub) - (x0 >> hsub) + 1;
+        int ch = ((y1 - 1) >> vsub) - (y0 >> vsub) + 1;
+
+        mask->alpha[0] = cov;
+        mask->alpha_linesize[0] = w;
+        mask->w[0] = w;
+        mask->h[0] = h;
+        if (!(mask->alpha[1] = av_malloc(cw * ch))) {
+            free_mask(mask);
+            return AVERROR(ENOMEM);
+        }
+        for (r = 0; r < ch; r++)
+            for (c = 0; c < cw; c++)
+                mask->alpha[1][r * cw + c] = cov[(r << vsub) * w + (c << hsub)];
+        mask->alpha[2] = mask->alpha[1];
+        mask->alpha_linesize[1] = mask->alpha_linesize[2] = cw;
+        mask->w[1] = mask->w[2] = cw;
+        mask->h[1] = mask->h[2] = ch;
+
+        for (plane = 0; plane < 3; plane++) {
+            if (!(mask->color_line[plane] = av_malloc(mask->w[plane]))) {
+                free_mask(mask);
+                return AVERROR(ENOMEM);
+            }
+            memset(mask->color_line[plane], yuvcolor[plane], mask->w[plane]);
         }
     }
 
     return 0;
 }
 
-static int draw_text(AVFilterContext *ctx, AVFilterBufferRef *picref,
-                     int width, int height)
+static void blend_mask(DrawTextContext *dtext, AVFilterBufferRef *picref, const TextMask *mask)
+{
+    int plane, y;
+
+    for (plane = 0; plane < 3 && mask->alpha[plane]; plane++) {
+        int hsub = plane ? dtext->hsub : 0;
+        int vsub = plane ? dtext->vsub : 0;
+        int step = dtext->is_packed_rgb ? dtext->pixel_step[0] : 1;
+        uint8_t *dst = picref->data[plane] + (mask->y >> vsub) * picref->linesize[plane] +
+                                             (mask->x >> hsub) * step;
+
+        for (y = 0; y < mask->h[plane]; y++) {
+            dtext->blend_row(dst, mask->color_line[plane],
+                             mask->alpha[plane] + y * mask->alpha_linesize[plane],
+                             mask->w[plane]);
+            dst += picref->linesize[plane];
+        }
+    }
+}
+
+/**
+ * Compute the position of the glyphs of text and the size of the box
+ * around it, and render the masks of the text and of its shadow.
+ */
+static int layout_text(AVFilterContext *ctx, const uint8_t *text, int width, int height)
 {
     DrawTextContext *dtext = ctx->priv;
     uint32_t code = 0, prev_code = 0;
     int x = 0, y = 0, i = 0, ret;
     int text_height, baseline;
-    char *text = dtext->text;
-    uint8_t *p;
+    const uint8_t *p;
     int str_w = 0, len;
     int y_min = 32000, y_max = -32000;
     FT_Vector delta;
     Glyph *glyph = NULL, *prev_glyph = NULL;
     Glyph dummy = { 0 };
 
-#if HAVE_LOCALTIME_R
-    time_t now = time(0);
-    struct tm ltime;
-    uint8_t *buf = dtext->expanded_text;
-    int buf_size = dtext->expanded_text_size;
+    av_freep(&dtext->rendered_text);
 
-    if (!buf) {
-        buf_size = 2*strlen(dtext->text)+1;
-        buf = av_malloc(buf_size);
-    }
-
-    localtime_r(&now, &ltime);
-
-    do {
-        *buf = 1;
-        if (strftime(buf, buf_size, dtext->text, &ltime) != 0 || *buf == 0)
-            break;
-        buf_size *= 2;
-    } while ((buf = av_realloc(buf, buf_size)));
-
-    if (!buf)
-        return AVERROR(ENOMEM);
-    text = dtext->expanded_text = buf;
-    dtext->expanded_text_size = buf_size;
-#endif
     if ((len = strlen(text)) > dtext->nb_positions) {
         if (!(dtext->positions =
               av_realloc(dtext->positions, len*sizeof(*dtext->positions))))
@@ -665,23 +748,74 @@ static int draw_text(AVFilterContext *ctx, AVFilterBufferRef *picref,
 
     str_w = FFMIN(width - dtext->x - 1, FFMAX(str_w, x - dtext->x));
     y     = FFMIN(y + text_height, height - 1);
-
-    /* draw box */
-    if (dtext->draw_box)
-        drawbox(picref, dtext->x, dtext->y, str_w, y-dtext->y,
-                dtext->box_line, dtext->pixel_step, dtext->boxcolor,
-                dtext->hsub, dtext->vsub, dtext->is_packed_rgb, dtext->rgba_map);
+    dtext->box_w = str_w;
+    dtext->box_h = y - dtext->y;
 
     if (dtext->shadowx || dtext->shadowy) {
-        if ((ret = draw_glyphs(dtext, picref, width, height, dtext->shadowcolor_rgba,
-                               dtext->shadowcolor, dtext->shadowx, dtext->shadowy)) < 0)
+        if ((ret = render_mask(dtext, &dtext->shadow_mask, text,
+                               dtext->shadowx, dtext->shadowy, width, height,
+                               dtext->shadowcolor_rgba, dtext->shadowcolor)) < 0)
             return ret;
     }
 
-    if ((ret = draw_glyphs(dtext, picref, width, height, dtext->fontcolor_rgba,
-                           dtext->fontcolor, 0, 0)) < 0)
+    if ((ret = render_mask(dtext, &dtext->text_mask, text, 0, 0, width, height,
+                           dtext->fontcolor_rgba, dtext->fontcolor)) < 0)
         return ret;
 
+    if (!(dtext->rendered_text = av_strdup(text)))
+        return AVERROR(ENOMEM);
+
+    return 0;
+}
+
+static int draw_text(AVFilterContext *ctx, AVFilterBufferRef *picref,
+                     int width, int height)
+{
+    DrawTextContext *dtext = ctx->priv;
+    char *text = dtext->text;
+    int ret;
+
+#if HAVE_LOCALTIME_R
+    time_t now = time(0);
+    struct tm ltime;
+    uint8_t *buf = dtext->expanded_text;
+    int buf_size = dtext->expanded_text_size;
+
+    if (!buf) {
+        buf_size = 2*strlen(dtext->text)+1;
+        buf = av_malloc(buf_size);
+    }
+
+    localtime_r(&now, &ltime);
+
+    do {
+        *buf = 1;
+        if (strftime(buf, buf_size, dtext->text, &ltime) != 0 || *buf == 0)
+            break;
+        buf_size *= 2;
+    } while ((buf = av_realloc(buf, buf_size)));
+
+    if (!buf)
+        return AVERROR(ENOMEM);
+    text = dtext->expanded_text = buf;
+    dtext->expanded_text_size = buf_size;
+#endif
+
+    /* the text is only laid out and rendered again when it changes */
+    if (!dtext->rendered_text || strcmp(text, dtext->rendered_text))
+        if ((ret = layout_text(ctx, text, width, height)) < 0)
+            return ret;
+
+    /* draw box */
+    if (dtext->draw_box)
+        drawbox(picref, dtext->x, dtext->y, dtext->box_w, dtext->box_h,
+                dtext->box_line, dtext->pixel_step, dtext->boxcolor,
+                dtext->hsub, dtext->vsub, dtext->is_packed_rgb, dtext->rgba_map);
+
+    if (dtext->shadowx || dtext->shadowy)
+        blend_mask(dtext, picref, &dtext->shadow_mask);
+    blend_mask(dtext, picref, &dtext->text_mask);
+
     return 0;
 }
 
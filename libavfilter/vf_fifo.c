@@ -98,6 +98,7 @@ static int request_frame(AVFilterLink *outlink)
 AVFilter avfilter_vf_fifo = {
     .name      = "fifo",
     .description = NULL_IF_CONFIG_SMALL("Buffer input images and send them when they are requested."),
+    .flags       = AVFILTER_FLAG_HWACCEL,
 
     .init      = init,
     .uninit    = uninit,
@@ -138,6 +138,10 @@ static av_cold int init(AVFilterContext *ctx, const char *args, void *opaque)
         gf->filter_line = ff_gradfun_filter_line_ssse3;
     if (HAVE_SSE && cpu_flags & AV_CPU_FLAG_SSE2)
         gf->blur_line = ff_gradfun_blur_line_sse2;
+    if (HAVE_NEON) {
+        gf->filter_line = ff_gradfun_filter_line_neon;
+        gf->blur_line   = ff_gradfun_blur_line_neon;
+    }
 
     av_log(ctx, AV_LOG_INFO, "threshold:%.2f radius:%d\n", thresh, gf->radius);
 
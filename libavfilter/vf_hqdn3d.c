@@ -30,11 +30,15 @@
 
 typedef struct {
     int Coefs[4][512*16];
-    unsigned int *Line;
+    unsigned int *Line[3];          ///< previous output line of each plane
     unsigned short *Frame[3];
     int hsub, vsub;
 } HQDN3DContext;
 
+typedef struct {
+    AVFilterBufferRef *in, *out;
+} ThreadData;
+
 static inline unsigned int LowPassMul(unsigned int PrevMul, unsigned int CurrMul, int *Coef)
 {
     //    int dMul= (PrevMul&0xFFFFFF)-(CurrMul&0xFFFFFF);
@@ -256,7 +260,9 @@ static void uninit(AVFilterContext *ctx)
 {
     HQDN3DContext *hqdn3d = ctx->priv;
 
-    av_freep(&hqdn3d->Line);
+    av_freep(&hqdn3d->Line[0]);
+    av_freep(&hqdn3d->Line[1]);
+    av_freep(&hqdn3d->Line[2]);
     av_freep(&hqdn3d->Frame[0]);
     av_freep(&hqdn3d->Frame[1]);
     av_freep(&hqdn3d->Frame[2]);
@@ -276,46 +282,58 @@ static int query_formats(AVFilterContext *ctx)
 static int config_input(AVFilterLink *inlink)
 {
     HQDN3DContext *hqdn3d = inlink->dst->priv;
+    int i;
 
     hqdn3d->hsub = av_pix_fmt_descriptors[inlink->format].log2_chroma_w;
     hqdn3d->vsub = av_pix_fmt_descriptors[inlink->format].log2_chroma_h;
 
-    hqdn3d->Line = av_malloc(inlink->w * sizeof(*hqdn3d->Line));
-    if (!hqdn3d->Line)
-        return AVERROR(ENOMEM);
+    /* each plane gets its own line so that the planes can be filtered
+     * at the same time */
+    for (i = 0; i < 3; i++) {
+        hqdn3d->Line[i] = av_malloc(inlink->w * sizeof(*hqdn3d->Line[i]));
+        if (!hqdn3d->Line[i])
+            return AVERROR(ENOMEM);
+    }
 
     return 0;
 }
 
 static void null_draw_slice(AVFilterLink *link, int y, int h, int slice_dir) { }
 
+/**
+ * Denoise the planes of a picture. The filter is recursive in both
+ * directions, so a plane cannot be split; the jobs get whole planes.
+ */
+static int filter_planes(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    HQDN3DContext *hqdn3d = ctx->priv;
+    ThreadData *td = arg;
+    AVFilterBufferRef *inpic = td->in, *outpic = td->out;
+    int plane;
+
+    for (plane = jobnr; plane < 3; plane += nb_jobs) {
+        int w = plane ? inpic->video->w >> hqdn3d->hsub : inpic->video->w;
+        int h = plane ? inpic->video->h >> hqdn3d->vsub : inpic->video->h;
+        int *spatial  = hqdn3d->Coefs[plane ? 2 : 0];
+        int *temporal = hqdn3d->Coefs[plane ? 3 : 1];
+
+        deNoise(inpic->data[plane], outpic->data[plane],
+                hqdn3d->Line[plane], &hqdn3d->Frame[plane], w, h,
+                inpic->linesize[plane], outpic->linesize[plane],
+                spatial, spatial, temporal);
+    }
+    return 0;
+}
+
 static void end_frame(AVFilterLink *inlink)
 {
-    HQDN3DContext *hqdn3d = inlink->dst->priv;
+    AVFilterContext *ctx = inlink->dst;
     AVFilterLink *outlink = inlink->dst->outputs[0];
     AVFilterBufferRef *inpic  = inlink ->cur_buf;
     AVFilterBufferRef *outpic = outlink->out_buf;
-    int cw = inpic->video->w >> hqdn3d->hsub;
-    int ch = inpic->video->h >> hqdn3d->vsub;
-
-    deNoise(inpic->data[0], outpic->data[0],
-            hqdn3d->Line, &hqdn3d->Frame[0], inpic->video->w, inpic->video->h,
-            inpic->linesize[0], outpic->linesize[0],
-            hqdn3d->Coefs[0],
-            hqdn3d->Coefs[0],
-            hqdn3d->Coefs[1]);
-    deNoise(inpic->data[1], outpic->data[1],
-            hqdn3d->Line, &hqdn3d->Frame[1], cw, ch,
-            inpic->linesize[1], outpic->linesize[1],
-            hqdn3d->Coefs[2],
-            hqdn3d->Coefs[2],
-            hqdn3d->Coefs[3]);
-    deNoise(inpic->data[2], outpic->data[2],
-            hqdn3d->Line, &hqdn3d->Frame[2], cw, ch,
-            inpic->linesize[2], outpic->linesize[2],
-            hqdn3d->Coefs[2],
-            hqdn3d->Coefs[2],
-            hqdn3d->Coefs[3]);
+    ThreadData td = { inpic, outpic };
+
+    ctx->execute(ctx, filter_planes, &td, NULL, FFMIN(3, ctx->thread_count));
 
     avfilter_draw_slice(outlink, 0, inpic->video->h, 1);
     avfilter_end_frame(outlink);
@@ -68,6 +68,8 @@ typedef struct {
     int rgba_map[4];
     int step;
     int negate_alpha; /* only used by negate */
+    int is_identity[4];   ///< set for the components whose lookup table changes no value
+    int passthrough;      ///< set if no component is changed, the frames are passed as they are
 } LutContext;
 
 #define Y 0
@@ -294,11 +296,85 @@ static int config_props(AVFilterLink *inlink)
             lut->lut[comp][val] = av_clip((int)res, min[comp], max[comp]);
             av_log(ctx, AV_LOG_DEBUG, "val[%d][%d] = %d\n", comp, val, lut->lut[comp][val]);
         }
+
+        lut->is_identity[comp] = 1;
+        for (val = 0; val < 256; val++)
+            if (lut->lut[comp][val] != val)
+                lut->is_identity[comp] = 0;
     }
 
+    lut->passthrough = 1;
+    for (comp = 0; comp < desc->nb_components; comp++)
+        lut->passthrough &= lut->is_identity[comp];
+    if (lut->passthrough)
+        av_log(ctx, AV_LOG_VERBOSE, "Identity lookup tables, passing the frames through\n");
+
     return 0;
 }
 
+static void start_frame(AVFilterLink *inlink, AVFilterBufferRef *picref)
+{
+    LutContext *lut = inlink->dst->priv;
+
+    if (lut->passthrough)
+        avfilter_null_start_frame(inlink, picref);
+    else
+        avfilter_default_start_frame(inlink, picref);
+}
+
+static void end_frame(AVFilterLink *inlink)
+{
+    LutContext *lut = inlink->dst->priv;
+
+    if (lut->passthrough)
+        avfilter_null_end_frame(inlink);
+    else
+        avfilter_default_end_frame(inlink);
+}
+
+/**
+ * Apply the lookup table lut to the samples of a row of a plane.
+ */
+static void lut_row_planar(uint8_t *dst, const uint8_t *src, int w, const uint8_t *lut)
+{
+    int x;
+
+    for (x = 0; x < w - 3; x += 4) {
+        dst[x  ] = lut[src[x  ]];
+        dst[x+1] = lut[src[x+1]];
+        dst[x+2] = lut[src[x+2]];
+        dst[x+3] = lut[src[x+3]];
+    }
+    for (; x < w; x++)
+        dst[x] = lut[src[x]];
+}
+
+/**
+ * Apply the lookup tables to a row of packed pixels, luts[k] being the
+ * table of the k-th byte of a pixel.
+ */
+static void lut_row_packed(uint8_t *dst, const uint8_t *src, int w, int step,
+                           const uint8_t * const luts[4])
+{
+    const uint8_t *lut0 = luts[0], *lut1 = luts[1], *lut2 = luts[2], *lut3 = luts[3];
+    int x;
+
+    if (step == 4) {
+        for (x = 0; x < w; x++, src += 4, dst += 4) {
+            dst[0] = lut0[src[0]];
+            dst[1] = lut1[src[1]];
+            dst[2] = lut2[src[2]];
+            dst[3] = lut3[src[3]];
+        }
+    } else {
+        for (x = 0; x < w; x++, src += 3, dst += 3) {
+            dst[0] = lut0[src[0]];
+            dst[1] = lut1[src[1]];
+            dst[2] = lut2[src[2]];
+        }
+    }
+}
+
 static void draw_slice(AVFilterLink *inlink, int y, int h, int slice_dir)
 {
     AVFilterContext *ctx = inlink->dst;
@@ -307,33 +383,42 @@ static void draw_slice(AVFilterLink *inlink, int y, int h, int slice_dir)
     AVFilterBufferRef *inpic  = inlink ->cur_buf;
     AVFilterBufferRef *outpic = outlink->out_buf;
     uint8_t *inrow, *outrow;
-    int i, j, k, plane;
+    int i, k, plane;
+
+    if (lut->passthrough) {
+        avfilter_draw_slice(outlink, y, h, slice_dir);
+        return;
+    }
 
     if (lut->is_rgb) {
         /* packed */
+        const uint8_t *luts[4];
+
+        for (k = 0; k < 4; k++)
+            luts[lut->rgba_map[k]] = lut->lut[k];
         inrow  = inpic ->data[0] + y * inpic ->linesize[0];
         outrow = outpic->data[0] + y * outpic->linesize[0];
 
         for (i = 0; i < h; i ++) {
-            for (j = 0; j < inlink->w; j++) {
-                for (k = 0; k < lut->step; k++)
-                    outrow[k] = lut->lut[lut->rgba_map[k]][inrow[k]];
-                outrow += lut->step;
-                inrow  += lut->step;
-            }
+            lut_row_packed(outrow, inrow, inlink->w, lut->step, luts);
+            inrow  += inpic ->linesize[0];
+            outrow += outpic->linesize[0];
         }
     } else {
         /* planar */
         for (plane = 0; inpic->data[plane]; plane++) {
             int vsub = plane == 1 || plane == 2 ? lut->vsub : 0;
             int hsub = plane == 1 || plane == 2 ? lut->hsub : 0;
+            int w = inlink->w >> hsub;
 
             inrow  = inpic ->data[plane] + (y>>vsub) * inpic ->linesize[plane];
             outrow = outpic->data[plane] + (y>>vsub) * outpic->linesize[plane];
 
             for (i = 0; i < h>>vsub; i ++) {
-                for (j = 0; j < inlink->w>>hsub; j++)
-                    outrow[j] = lut->lut[plane][inrow[j]];
+                if (lut->is_identity[plane])
+                    memcpy(outrow, inrow, w);
+                else
+                    lut_row_planar(outrow, inrow, w, lut->lut[plane]);
                 inrow  += inpic ->linesize[plane];
                 outrow += outpic->linesize[plane];
             }
@@ -355,7 +440,9 @@ static void draw_slice(AVFilterLink *inlink, int y, int h, int slice_dir)
                                                                         \
         .inputs    = (AVFilterPad[]) {{ .name            = "default",   \
                                         .type            = AVMEDIA_TYPE_VIDEO, \
+                                        .start_frame     = start_frame, \
                                         .draw_slice      = draw_slice,  \
+                                        .end_frame       = end_frame,   \
                                         .config_props    = config_props, \
                                         .min_perms       = AV_PERM_READ, }, \
                                       { .name = NULL}},                 \
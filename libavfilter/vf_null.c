@@ -26,6 +26,7 @@
 AVFilter avfilter_vf_null = {
     .name      = "null",
     .description = NULL_IF_CONFIG_SMALL("Pass the source unchanged to the output."),
+    .flags       = AVFILTER_FLAG_HWACCEL,
 
     .priv_size = 0,
 
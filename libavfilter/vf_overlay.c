@@ -26,11 +26,14 @@
  */
 
 #include "avfilter.h"
+#include "libavutil/cpu.h"
 #include "libavutil/eval.h"
 #include "libavutil/avstring.h"
 #include "libavutil/pixdesc.h"
 #include "libavutil/imgutils.h"
+#include "drawutils.h"
 #include "internal.h"
+#include "overlay.h"
 
 static const char *var_names[] = {
     "E",
@@ -57,20 +60,14 @@ enum var_name {
 #define MAIN    0
 #define OVERLAY 1
 
-typedef struct {
-    int x, y;                   ///< position of overlayed picture
-
-    AVFilterBufferRef *overpicref;
-
-    int max_plane_step[4];      ///< steps per pixel for each plane
-    int hsub, vsub;             ///< chroma subsampling values
-
-    char x_expr[256], y_expr[256];
-} OverlayContext;
-
 static av_cold int init(AVFilterContext *ctx, const char *args, void *opaque)
 {
     OverlayContext *over = ctx->priv;
+    av_unused int cpu_flags = av_get_cpu_flags();
+
+    over->blend_row = ff_blend_row_c;
+    if (HAVE_SSE && cpu_flags & AV_CPU_FLAG_SSE2)
+        over->blend_row = ff_blend_row_sse2;
 
     av_strlcpy(over->x_expr, "0", sizeof(over->x_expr));
     av_strlcpy(over->y_expr, "0", sizeof(over->y_expr));
@@ -87,6 +84,9 @@ static av_cold void uninit(AVFilterContext *ctx)
 
     if (over->overpicref)
         avfilter_unref_buffer(over->overpicref);
+    av_freep(&over->alpha_uv);
+    av_freep(&over->extents[0]);
+    av_freep(&over->extents[1]);
 }
 
 static int query_formats(AVFilterContext *ctx)
@@ -121,7 +121,7 @@ static int config_input_overlay(AVFilterLink *inlink)
     OverlayContext  *over = inlink->dst->priv;
     char *expr;
     double var_values[VAR_VARS_NB], res;
-    int ret;
+    int hsub, vsub, ret;
 
     /* Finish the configuration by evaluating the expressions
        now when both inputs are configured. */
@@ -167,6 +167,17 @@ static int config_input_overlay(AVFilterLink *inlink)
                (int)var_values[VAR_MAIN_W], (int)var_values[VAR_MAIN_H]);
         return AVERROR(EINVAL);
     }
+
+    hsub = av_pix_fmt_descriptors[inlink->format].log2_chroma_w;
+    vsub = av_pix_fmt_descriptors[inlink->format].log2_chroma_h;
+    over->alpha_h[0]         = inlink->h;
+    over->alpha_h[1]         = FFALIGN(inlink->h, 1 << vsub) >> vsub;
+    over->alpha_linesize[1]  = FFALIGN(inlink->w, 1 << hsub) >> hsub;
+    over->alpha_uv   = av_malloc(over->alpha_linesize[1] * over->alpha_h[1]);
+    over->extents[0] = av_malloc(over->alpha_h[0] * sizeof(RowExtent));
+    over->extents[1] = av_malloc(over->alpha_h[1] * sizeof(RowExtent));
+    if (!over->alpha_uv || !over->extents[0] || !over->extents[1])
+        return AVERROR(ENOMEM);
     return 0;
 
 fail:
@@ -229,6 +240,65 @@ static void start_frame(AVFilterLink *inlink, AVFilterBufferRef *inpicref)
     avfilter_start_frame(inlink->dst->outputs[0], outpicref);
 }
 
+/**
+ * Compute the alpha of the chroma planes and the extents of the rows, so
+ * that the transparent parts of the overlay are skipped and the opaque
+ * ones copied.
+ */
+static void analyze_alpha(OverlayContext *over, AVFilterBufferRef *picref)
+{
+    int hsub = av_pix_fmt_descriptors[picref->format].log2_chroma_w;
+    int vsub = av_pix_fmt_descriptors[picref->format].log2_chroma_h;
+    int w = picref->video->w;
+    int cw = over->alpha_linesize[1], ch = over->alpha_h[1];
+    int stride = picref->linesize[3];
+    int i, j, k;
+
+    over->alpha[0]          = picref->data[3];
+    over->alpha_linesize[0] = stride;
+    over->alpha[1]          = over->alpha_uv;
+
+    for (j = 0; j < ch; j++) {
+        const uint8_t *a = picref->data[3] + (j << vsub) * stride;
+        uint8_t *dst = over->alpha_uv + j * cw;
+        for (k = 0; k < cw; k++) {
+            // average alpha for color components, improve quality
+            int alpha_v, alpha_h, alpha;
+            if (hsub && vsub && j+1 < ch && k+1 < cw) {
+                alpha = (a[0] + a[stride] + a[1] + a[stride+1]) >> 2;
+            } else if (hsub || vsub) {
+                alpha_h = hsub && k+1 < cw ? (a[0] + a[1])      >> 1 : a[0];
+                alpha_v = vsub && j+1 < ch ? (a[0] + a[stride]) >> 1 : a[0];
+                alpha = (alpha_v + alpha_h) >> 1;
+            } else
+                alpha = a[0];
+            dst[k] = alpha;
+            a += 1 << hsub;
+        }
+    }
+
+    for (i = 0; i < 2; i++) {
+        int width = i ? cw : w;
+        for (j = 0; j < over->alpha_h[i]; j++) {
+            const uint8_t *a = over->alpha[i] + j * over->alpha_linesize[i];
+            RowExtent *e = &over->extents[i][j];
+            int start = 0, end = width;
+            while (start < end && !a[start])
+                start++;
+            while (end > start && !a[end-1])
+                end--;
+            e->start  = start;
+            e->end    = end;
+            e->opaque = 1;
+            for (k = start; k < end; k++)
+                if (a[k] != 255) {
+                    e->opaque = 0;
+                    break;
+                }
+        }
+    }
+}
+
 static void start_frame_overlay(AVFilterLink *inlink, AVFilterBufferRef *inpicref)
 {
     AVFilterContext *ctx = inlink->dst;
@@ -239,13 +309,20 @@ static void start_frame_overlay(AVFilterLink *inlink, AVFilterBufferRef *inpicre
                                          ctx->outputs[0]->time_base);
 }
 
+static void end_frame_overlay(AVFilterLink *inlink)
+{
+    OverlayContext *over = inlink->dst->priv;
+
+    analyze_alpha(over, over->overpicref);
+}
+
 static void blend_slice(AVFilterContext *ctx,
                         AVFilterBufferRef *dst, AVFilterBufferRef *src,
                         int x, int y, int w, int h,
                         int slice_y, int slice_w, int slice_h)
 {
     OverlayContext *over = ctx->priv;
-    int i, j, k;
+    int i, j;
     int width, height;
     int overlay_end_y = y+h;
     int slice_end_y = slice_y+slice_h;
@@ -279,39 +356,23 @@ static void blend_slice(AVFilterContext *ctx,
         for (i = 0; i < 3; i++) {
             int hsub = i ? over->hsub : 0;
             int vsub = i ? over->vsub : 0;
+            int p = !!i;
+            int src_y = (start_y - y) >> vsub;
+            int hp = FFMIN(FFALIGN(height, 1<<vsub) >> vsub, over->alpha_h[p] - src_y);
             uint8_t *dp = dst->data[i] + (x >> hsub) +
                 (start_y >> vsub) * dst->linesize[i];
-            uint8_t *sp = src->data[i];
-            uint8_t *ap = src->data[3];
-            int wp = FFALIGN(width, 1<<hsub) >> hsub;
-            int hp = FFALIGN(height, 1<<vsub) >> vsub;
-            if (slice_y > y) {
-                sp += ((slice_y - y) >> vsub) * src->linesize[i];
-                ap += (slice_y - y) * src->linesize[3];
-            }
-            for (j = 0; j < hp; j++) {
-                uint8_t *d = dp, *s = sp, *a = ap;
-                for (k = 0; k < wp; k++) {
-                    // average alpha for color components, improve quality
-                    int alpha_v, alpha_h, alpha;
-                    if (hsub && vsub && j+1 < hp && k+1 < wp) {
-                        alpha = (a[0] + a[src->linesize[3]] +
-                                 a[1] + a[src->linesize[3]+1]) >> 2;
-                    } else if (hsub || vsub) {
-                        alpha_h = hsub && k+1 < wp ?
-                            (a[0] + a[1]) >> 1 : a[0];
-                        alpha_v = vsub && j+1 < hp ?
-                            (a[0] + a[src->linesize[3]]) >> 1 : a[0];
-                        alpha = (alpha_v + alpha_h) >> 1;
-                    } else
-                        alpha = a[0];
-                    *d = (*d * (0xff - alpha) + *s++ * alpha + 128) >> 8;
-                    d++;
-                    a += 1 << hsub;
-                }
+            uint8_t *sp = src->data[i] + src_y * src->linesize[i];
+            const uint8_t *ap = over->alpha[p] + src_y * over->alpha_linesize[p];
+            const RowExtent *e = over->extents[p] + src_y;
+            for (j = 0; j < hp; j++, e++) {
+                if (e->opaque)
+                    memcpy(dp + e->start, sp + e->start, e->end - e->start);
+                else
+                    over->blend_row(dp + e->start, sp + e->start, ap + e->start,
+                                    e->end - e->start);
                 dp += dst->linesize[i];
                 sp += src->linesize[i];
-                ap += (1 << vsub) * src->linesize[3];
+                ap += over->alpha_linesize[p];
             }
         }
     }
@@ -342,8 +403,6 @@ static void end_frame(AVFilterLink *inlink)
 
 static void null_draw_slice(AVFilterLink *inlink, int y, int h, int slice_dir) { }
 
-static void null_end_frame(AVFilterLink *inlink) { }
-
 AVFilter avfilter_vf_overlay = {
     .name      = "overlay",
     .description = NULL_IF_CONFIG_SMALL("Overlay a video source on top of the input."),
@@ -369,7 +428,7 @@ AVFilter avfilter_vf_overlay = {
                                     .start_frame     = start_frame_overlay,
                                     .config_props    = config_input_overlay,
                                     .draw_slice      = null_draw_slice,
-                                    .end_frame       = null_end_frame,
+                                    .end_frame       = end_frame_overlay,
                                     .min_perms       = AV_PERM_READ,
                                     .rej_perms       = AV_PERM_REUSE2, },
                                   { .name = NULL}},
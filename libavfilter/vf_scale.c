@@ -26,6 +26,7 @@
 #include "avfilter.h"
 #include "libavutil/avstring.h"
 #include "libavutil/eval.h"
+#include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
 #include "libavutil/avassert.h"
 #include "libswscale/swscale.h"
@@ -232,6 +233,11 @@ static int config_props(AVFilterLink *outlink)
     if (!scale->sws)
         return AVERROR(EINVAL);
 
+    /* scale whole frames with as many threads as the graph, on its pool */
+    av_set_int(scale->sws, "threads", ctx->thread_count);
+    if (ctx->thread_count > 1)
+        sws_set_thread_pool(scale->sws, ctx->thread_opaque);
+
     return 0;
 
 fail:
@@ -330,6 +330,7 @@ static av_cold void uninit(AVFilterContext *ctx)
 AVFilter avfilter_vf_select = {
     .name      = "select",
     .description = NULL_IF_CONFIG_SMALL("Select frames to pass in output."),
+    .flags       = AVFILTER_FLAG_HWACCEL,
     .init      = init,
     .uninit    = uninit,
 
@@ -140,6 +140,7 @@ static av_cold void uninit(AVFilterContext *ctx)
 AVFilter avfilter_vf_setpts = {
     .name      = "setpts",
     .description = NULL_IF_CONFIG_SMALL("Set PTS for the output video frame."),
+    .flags       = AVFILTER_FLAG_HWACCEL,
     .init      = init,
     .uninit    = uninit,
 
@@ -123,6 +123,7 @@ static void start_frame(AVFilterLink *inlink, AVFilterBufferRef *picref)
 AVFilter avfilter_vf_settb = {
     .name      = "settb",
     .description = NULL_IF_CONFIG_SMALL("Set timebase for the output link."),
+    .flags       = AVFILTER_FLAG_HWACCEL,
     .init      = init,
 
     .priv_size = sizeof(SetTBContext),
@@ -50,6 +50,7 @@ static void end_frame(AVFilterLink *inlink)
 AVFilter avfilter_vf_split = {
     .name      = "split",
     .description = NULL_IF_CONFIG_SMALL("Pass on the input to two outputs."),
+    .flags       = AVFILTER_FLAG_HWACCEL,
 
     .inputs    = (AVFilterPad[]) {{ .name            = "default",
                                     .type            = AVMEDIA_TYPE_VIDEO,
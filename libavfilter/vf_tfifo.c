@@ -0,0 +1,328 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * threaded FIFO video filter
+ *
+ * A thread of the filter requests the next frames from the filters before
+ * it while the filters after it process the current frame, so that the
+ * two parts of the graph work on different frames at the same time.
+ *
+ * The thread only runs while request_frame() of this filter is executing,
+ * so the caller may feed the sources of the graph between two requests.
+ * Frames are copied into buffers belonging to no link before they are
+ * passed on, so that no buffer pool or reference count is shared between
+ * the two threads.
+ */
+
+#include <pthread.h>
+
+#include "libavutil/imgutils.h"
+#include "avfilter.h"
+#include "internal.h"
+
+#define DEFAULT_DEPTH 2
+
+typedef struct BufPic {
+    AVFilterBufferRef *picref;
+    struct BufPic     *next;
+} BufPic;
+
+typedef struct {
+    BufPic  root;
+    BufPic *last;           ///< last buffered picture
+    int count;              ///< number of buffered pictures
+    int depth;              ///< number of pictures the thread may buffer
+    int error;              ///< error which occurred while buffering a picture
+
+    int threaded;           ///< set if the thread is running
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int prefetching;        ///< set while the thread is requesting pictures
+    int done;               ///< set to make the thread exit
+} TFifoContext;
+
+static av_cold int init(AVFilterContext *ctx, const char *args, void *opaque)
+{
+    TFifoContext *tfifo = ctx->priv;
+
+    tfifo->last  = &tfifo->root;
+    tfifo->depth = DEFAULT_DEPTH;
+    pthread_mutex_init(&tfifo->lock, NULL);
+    pthread_cond_init(&tfifo->cond, NULL);
+
+    if (args && (sscanf(args, "%d", &tfifo->depth) != 1 || tfifo->depth < 0)) {
+        av_log(ctx, AV_LOG_ERROR, "Invalid depth '%s'\n", args);
+        return AVERROR(EINVAL);
+    }
+
+    return 0;
+}
+
+static av_cold void uninit(AVFilterContext *ctx)
+{
+    TFifoContext *tfifo = ctx->priv;
+    BufPic *pic, *tmp;
+
+    if (tfifo->threaded) {
+        pthread_mutex_lock(&tfifo->lock);
+        tfifo->done = 1;
+        pthread_cond_broadcast(&tfifo->cond);
+        pthread_mutex_unlock(&tfifo->lock);
+        pthread_join(tfifo->thread, NULL);
+    }
+    pthread_mutex_destroy(&tfifo->lock);
+    pthread_cond_destroy(&tfifo->cond);
+
+    for (pic = tfifo->root.next; pic; pic = tmp) {
+        tmp = pic->next;
+        avfilter_unref_buffer(pic->picref);
+        av_free(pic);
+    }
+}
+
+static void *prefetch_thread(void *arg)
+{
+    AVFilterContext *ctx = arg;
+    TFifoContext *tfifo  = ctx->priv;
+
+    pthread_mutex_lock(&tfifo->lock);
+    for (;;) {
+        while (!tfifo->prefetching && !tfifo->done)
+            pthread_cond_wait(&tfifo->cond, &tfifo->lock);
+        if (tfifo->done)
+            break;
+
+        while (tfifo->count < tfifo->depth && !tfifo->error) {
+            int ret;
+
+            pthread_mutex_unlock(&tfifo->lock);
+            ret = avfilter_poll_frame(ctx->inputs[0]) > 0 ?
+                  avfilter_request_frame(ctx->inputs[0]) : -1;
+            pthread_mutex_lock(&tfifo->lock);
+            if (ret < 0)
+                break;
+        }
+
+        tfifo->prefetching = 0;
+        pthread_cond_broadcast(&tfifo->cond);
+    }
+    pthread_mutex_unlock(&tfifo->lock);
+
+    return NULL;
+}
+
+/**
+ * Check that the filters before ctx can only be reached through it, so
+ * that its thread is the only one running them.
+ */
+static int inputs_are_private(AVFilterContext *ctx)
+{
+    int i;
+
+    for (i = 0; i < ctx->input_count; i++) {
+        AVFilterContext *src = ctx->inputs[i]->src;
+        if (src->output_count != 1 || !inputs_are_private(src))
+            return 0;
+    }
+    return 1;
+}
+
+static int config_output(AVFilterLink *outlink)
+{
+    AVFilterContext *ctx = outlink->src;
+    TFifoContext *tfifo  = ctx->priv;
+    int ret;
+
+    if ((ret = avfilter_default_config_output_link(outlink)) < 0)
+        return ret;
+
+    if (!tfifo->depth || tfifo->threaded)
+        return 0;
+
+    if (!inputs_are_private(ctx)) {
+        av_log(ctx, AV_LOG_WARNING,
+               "The input filters are shared with other parts of the graph, "
+               "not using a thread\n");
+        return 0;
+    }
+
+    if (pthread_create(&tfifo->thread, NULL, prefetch_thread, ctx)) {
+        av_log(ctx, AV_LOG_WARNING, "Cannot start the thread\n");
+        return 0;
+    }
+    tfifo->threaded = 1;
+
+    return 0;
+}
+
+static void start_frame(AVFilterLink *inlink, AVFilterBufferRef *picref) { }
+
+static void draw_slice(AVFilterLink *inlink, int y, int h, int slice_dir) { }
+
+/**
+ * Copy picref into a buffer which is freed by its last reference instead
+ * of being returned to the pool of a link.
+ */
+static AVFilterBufferRef *copy_picref(AVFilterBufferRef *picref)
+{
+    AVFilterBufferRef *copy;
+    uint8_t *data[4];
+    const uint8_t *src[4];
+    int linesize[4], i;
+    int w = picref->video->w, h = picref->video->h;
+
+    if (av_image_alloc(data, linesize, w, h, picref->format, 16) < 0)
+        return NULL;
+
+    copy = avfilter_get_video_buffer_ref_from_arrays(data, linesize,
+                                                     AV_PERM_READ | AV_PERM_WRITE | AV_PERM_PRESERVE |
+                                                     AV_PERM_REUSE | AV_PERM_REUSE2,
+                                                     w, h, picref->format);
+    if (!copy) {
+        av_free(data[0]);
+        return NULL;
+    }
+
+    for (i = 0; i < 4; i++)
+        src[i] = picref->data[i];
+    av_image_copy(copy->data, copy->linesize, src, picref->linesize,
+                  picref->format, w, h);
+    avfilter_copy_buffer_ref_props(copy, picref);
+
+    return copy;
+}
+
+static void end_frame(AVFilterLink *inlink)
+{
+    TFifoContext *tfifo = inlink->dst->priv;
+    AVFilterBufferRef *picref = inlink->cur_buf;
+    BufPic *pic;
+
+    if (tfifo->threaded) {
+        picref = copy_picref(inlink->cur_buf);
+        avfilter_unref_buffer(inlink->cur_buf);
+    }
+    inlink->cur_buf = NULL;
+
+    pthread_mutex_lock(&tfifo->lock);
+    if (!picref || !(pic = av_mallocz(sizeof(BufPic)))) {
+        avfilter_unref_buffer(picref);
+        tfifo->error = AVERROR(ENOMEM);
+    } else {
+        pic->picref = picref;
+        tfifo->last->next = pic;
+        tfifo->last = pic;
+        tfifo->count++;
+    }
+    pthread_mutex_unlock(&tfifo->lock);
+}
+
+/** Wait until the thread stopped requesting pictures. */
+static void wait_prefetch(TFifoContext *tfifo)
+{
+    pthread_mutex_lock(&tfifo->lock);
+    while (tfifo->prefetching)
+        pthread_cond_wait(&tfifo->cond, &tfifo->lock);
+    pthread_mutex_unlock(&tfifo->lock);
+}
+
+static int request_frame(AVFilterLink *outlink)
+{
+    TFifoContext *tfifo = outlink->src->priv;
+    AVFilterBufferRef *picref;
+    BufPic *pic;
+    int ret;
+
+    wait_prefetch(tfifo);
+
+    if (tfifo->error) {
+        ret = tfifo->error;
+        tfifo->error = 0;
+        return ret;
+    }
+    if (!tfifo->root.next) {
+        if ((ret = avfilter_request_frame(outlink->src->inputs[0])) < 0)
+            return ret;
+        if (!tfifo->root.next)
+            return tfifo->error ? tfifo->error : AVERROR(EINVAL);
+    }
+
+    pthread_mutex_lock(&tfifo->lock);
+    pic = tfifo->root.next;
+    tfifo->root.next = pic->next;
+    if (tfifo->last == pic)
+        tfifo->last = &tfifo->root;
+    tfifo->count--;
+    if (tfifo->threaded) {
+        tfifo->prefetching = 1;
+        pthread_cond_broadcast(&tfifo->cond);
+    }
+    pthread_mutex_unlock(&tfifo->lock);
+
+    picref = pic->picref;
+    av_free(pic);
+
+    /* the next pictures are requested while this one is processed by the
+     * following filters */
+    avfilter_start_frame(outlink, picref);
+    avfilter_draw_slice (outlink, 0, outlink->h, 1);
+    avfilter_end_frame  (outlink);
+
+    wait_prefetch(tfifo);
+
+    return 0;
+}
+
+static int poll_frame(AVFilterLink *outlink)
+{
+    TFifoContext *tfifo = outlink->src->priv;
+
+    wait_prefetch(tfifo);
+
+    if (tfifo->count)
+        return tfifo->count;
+    return avfilter_poll_frame(outlink->src->inputs[0]);
+}
+
+AVFilter avfilter_vf_tfifo = {
+    .name      = "tfifo",
+    .description = NULL_IF_CONFIG_SMALL("Buffer input images in a separate thread, processing them in parallel with the next filters."),
+
+    .init      = init,
+    .uninit    = uninit,
+
+    .priv_size = sizeof(TFifoContext),
+
+    .inputs    = (AVFilterPad[]) {{ .name            = "default",
+                                    .type            = AVMEDIA_TYPE_VIDEO,
+                                    .start_frame     = start_frame,
+                                    .draw_slice      = draw_slice,
+                                    .end_frame       = end_frame,
+                                    .min_perms       = AV_PERM_READ,
+                                    .rej_perms       = AV_PERM_REUSE2, },
+                                  { .name = NULL}},
+    .outputs   = (AVFilterPad[]) {{ .name            = "default",
+                                    .type            = AVMEDIA_TYPE_VIDEO,
+                                    .request_frame   = request_frame,
+                                    .poll_frame      = poll_frame,
+                                    .config_props    = config_output, },
+                                  { .name = NULL}},
+};
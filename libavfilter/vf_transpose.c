@@ -25,14 +25,15 @@
  * Based on MPlayer libmpcodecs/vf_rotate.c.
  */
 
-#include "libavutil/intreadwrite.h"
 #include "libavutil/pixdesc.h"
 #include "libavutil/imgutils.h"
 #include "avfilter.h"
+#include "transpose.h"
 
 typedef struct {
     int hsub, vsub;
     int pixsteps[4];
+    TransVtable vtables[4];
 
     /* 0    Rotate by 90 degrees counterclockwise and vflip. */
     /* 1    Rotate by 90 degrees clockwise.                  */
@@ -93,11 +94,15 @@ static int config_props_output(AVFilterLink *outlink)
     TransContext *trans = ctx->priv;
     AVFilterLink *inlink = ctx->inputs[0];
     const AVPixFmtDescriptor *pixdesc = &av_pix_fmt_descriptors[outlink->format];
+    int i, ret;
 
     trans->hsub = av_pix_fmt_descriptors[inlink->format].log2_chroma_w;
     trans->vsub = av_pix_fmt_descriptors[inlink->format].log2_chroma_h;
 
     av_image_fill_max_pixsteps(trans->pixsteps, NULL, pixdesc);
+    for (i = 0; i < 4; i++)
+        if (trans->pixsteps[i] && (ret = ff_transpose_init(&trans->vtables[i], trans->pixsteps[i])) < 0)
+            return ret;
 
     outlink->w = inlink->h;
     outlink->h = inlink->w;
@@ -143,13 +148,11 @@ static void end_frame(AVFilterLink *inlink)
     for (plane = 0; outpic->data[plane]; plane++) {
         int hsub = plane == 1 || plane == 2 ? trans->hsub : 0;
         int vsub = plane == 1 || plane == 2 ? trans->vsub : 0;
-        int pixstep = trans->pixsteps[plane];
         int inh  = inpic->video->h>>vsub;
         int outw = outpic->video->w>>hsub;
         int outh = outpic->video->h>>vsub;
         uint8_t *out, *in;
         int outlinesize, inlinesize;
-        int x, y;
 
         out = outpic->data[plane]; outlinesize = outpic->linesize[plane];
         in  = inpic ->data[plane]; inlinesize  = inpic ->linesize[plane];
@@ -164,29 +167,8 @@ static void end_frame(AVFilterLink *inlink)
             outlinesize *= -1;
         }
 
-        for (y = 0; y < outh; y++) {
-            switch (pixstep) {
-            case 1:
-                for (x = 0; x < outw; x++)
-                    out[x] = in[x*inlinesize + y];
-                break;
-            case 2:
-                for (x = 0; x < outw; x++)
-                    *((uint16_t *)(out + 2*x)) = *((uint16_t *)(in + x*inlinesize + y*2));
-                break;
-            case 3:
-                for (x = 0; x < outw; x++) {
-                    int32_t v = AV_RB24(in + x*inlinesize + y*3);
-                    AV_WB24(out + 3*x, v);
-                }
-                break;
-            case 4:
-                for (x = 0; x < outw; x++)
-                    *((uint32_t *)(out + 4*x)) = *((uint32_t *)(in + x*inlinesize + y*4));
-                break;
-            }
-            out += outlinesize;
-        }
+        ff_transpose_plane(&trans->vtables[plane], out, outlinesize,
+                           in, inlinesize, outw, outh);
     }
 
     avfilter_unref_buffer(inpic);
@@ -38,8 +38,10 @@
 
 #include "avfilter.h"
 #include "libavutil/common.h"
+#include "libavutil/cpu.h"
 #include "libavutil/mem.h"
 #include "libavutil/pixdesc.h"
+#include "unsharp.h"
 
 #define MIN_SIZE 3
 #define MAX_SIZE 13
@@ -47,66 +49,97 @@
 #define CHROMA_WIDTH(link)  -((-link->w) >> av_pix_fmt_descriptors[link->format].log2_chroma_w)
 #define CHROMA_HEIGHT(link) -((-link->h) >> av_pix_fmt_descriptors[link->format].log2_chroma_h)
 
-typedef struct FilterParam {
-    int msize_x;                             ///< matrix width
-    int msize_y;                             ///< matrix height
-    int amount;                              ///< effect amount
-    int steps_x;                             ///< horizontal step count
-    int steps_y;                             ///< vertical step count
-    int scalebits;                           ///< bits to shift pixel
-    int32_t halfscale;                       ///< amount to add to pixel
-    uint32_t *sc[(MAX_SIZE * MAX_SIZE) - 1]; ///< finite state machine storage
-} FilterParam;
-
 typedef struct {
-    FilterParam luma;   ///< luma parameters (width, height, amount)
-    FilterParam chroma; ///< chroma parameters (width, height, amount)
-} UnsharpContext;
+    AVFilterBufferRef *in, *out;
+    int w, h;
+    int chroma_w, chroma_h;
+} ThreadData;
+
+void ff_unsharp_add_pairs_c(uint32_t *buf, int len)
+{
+    int i;
+
+    for (i = 0; i < len; i++)
+        buf[i] += buf[i + 1];
+}
 
-static void unsharpen(uint8_t *dst, const uint8_t *src, int dst_stride, int src_stride, int width, int height, FilterParam *fp)
+void ff_unsharp_blur_v_c(uint32_t *buf, uint32_t **sc, int width, int steps)
 {
-    uint32_t **sc = fp->sc;
-    uint32_t sr[(MAX_SIZE * MAX_SIZE) - 1], tmp1, tmp2;
+    uint32_t tmp1, tmp2;
+    int x, z;
+
+    for (x = 0; x < width; x++) {
+        tmp1 = buf[x];
+        for (z = 0; z < steps * 2; z++) {
+            tmp2 = sc[z][x] + tmp1; sc[z][x] = tmp1;
+            tmp1 = tmp2;
+        }
+        buf[x] = tmp1;
+    }
+}
 
+void ff_unsharp_blend_c(uint8_t *dst, const uint8_t *src, const uint32_t *blur, int width,
+                        int amount, int halfscale, int scalebits)
+{
     int32_t res;
+    int x;
+
+    for (x = 0; x < width; x++) {
+        res = (int32_t)src[x] + ((((int32_t)src[x] - (int32_t)((blur[x] + halfscale) >> scalebits)) * amount) >> 16);
+        dst[x] = av_clip_uint8(res);
+    }
+}
+
+/**
+ * Filter the rows slice_start to slice_end-1 of a plane.
+ * Every output row only depends on the 2 * steps_y + 1 input rows around
+ * it, so the rows can be split into bands filtered independently.
+ *
+ * The matrix is separable: each input row is first blurred horizontally
+ * by 2 * steps_x passes adding neighbouring pixels, then goes through the
+ * vertical state machine, whose 2 * steps_y stages delay it by steps_y rows.
+ *
+ * @param sc   2 * steps_y state rows used by this band only
+ * @param line line of width + 2 * steps_x + 5 elements used by this band only
+ */
+static void unsharpen(UnsharpContext *unsharp, uint8_t *dst, const uint8_t *src, int dst_stride, int src_stride,
+                      int width, int height, int slice_start, int slice_end, FilterParam *fp, uint32_t **sc,
+                      uint32_t *line)
+{
     int x, y, z;
 
     if (!fp->amount) {
+        dst += slice_start * dst_stride;
+        src += slice_start * src_stride;
         if (dst_stride == src_stride)
-            memcpy(dst, src, src_stride * height);
+            memcpy(dst, src, src_stride * (slice_end - slice_start));
         else
-            for (y = 0; y < height; y++, dst += dst_stride, src += src_stride)
+            for (y = slice_start; y < slice_end; y++, dst += dst_stride, src += src_stride)
                 memcpy(dst, src, width);
         return;
     }
 
     for (y = 0; y < 2 * fp->steps_y; y++)
-        memset(sc[y], 0, sizeof(sc[y][0]) * (width + 2 * fp->steps_x));
-
-    for (y = -fp->steps_y; y < height + fp->steps_y; y++) {
-        memset(sr, 0, sizeof(sr[0]) * (2 * fp->steps_x - 1));
-        for (x = -fp->steps_x; x < width + fp->steps_x; x++) {
-            tmp1 = x <= 0 ? src[0] : x >= width ? src[width-1] : src[x];
-            for (z = 0; z < fp->steps_x * 2; z += 2) {
-                tmp2 = sr[z + 0] + tmp1; sr[z + 0] = tmp1;
-                tmp1 = sr[z + 1] + tmp2; sr[z + 1] = tmp2;
-            }
-            for (z = 0; z < fp->steps_y * 2; z += 2) {
-                tmp2 = sc[z + 0][x + fp->steps_x] + tmp1; sc[z + 0][x + fp->steps_x] = tmp1;
-                tmp1 = sc[z + 1][x + fp->steps_x] + tmp2; sc[z + 1][x + fp->steps_x] = tmp2;
-            }
-            if (x >= fp->steps_x && y >= fp->steps_y) {
-                const uint8_t* srx = src - fp->steps_y * src_stride + x - fp->steps_x;
-                uint8_t* dsx = dst - fp->steps_y * dst_stride + x - fp->steps_x;
-
-                res = (int32_t)*srx + ((((int32_t) * srx - (int32_t)((tmp1 + fp->halfscale) >> fp->scalebits)) * fp->amount) >> 16);
-                *dsx = av_clip_uint8(res);
-            }
-        }
-        if (y >= 0) {
-            dst += dst_stride;
-            src += src_stride;
+        memset(sc[y], 0, sizeof(sc[y][0]) * FFALIGN(width, 4));
+
+    for (y = slice_start - fp->steps_y; y < slice_end + fp->steps_y; y++) {
+        const uint8_t *srcy = src + av_clip(y, 0, height - 1) * src_stride;
+
+        for (x = 0; x < fp->steps_x; x++) {
+            line[x]                       = srcy[0];
+            line[width + fp->steps_x + x] = srcy[width - 1];
         }
+        for (x = 0; x < width; x++)
+            line[fp->steps_x + x] = srcy[x];
+        memset(line + width + 2 * fp->steps_x, 0, 5 * sizeof(*line));
+
+        for (z = 0; z < 2 * fp->steps_x; z++)
+            unsharp->add_pairs(line, width + 2 * fp->steps_x - 1 - z);
+        unsharp->blur_v(line, sc, width, fp->steps_y);
+
+        if (y >= slice_start + fp->steps_y)
+            unsharp->blend(dst + (y - fp->steps_y) * dst_stride, src + (y - fp->steps_y) * src_stride,
+                           line, width, fp->amount, fp->halfscale, fp->scalebits);
     }
 }
 
@@ -125,6 +158,7 @@ static void set_filter_param(FilterParam *fp, int msize_x, int msize_y, double a
 static av_cold int init(AVFilterContext *ctx, const char *args, void *opaque)
 {
     UnsharpContext *unsharp = ctx->priv;
+    av_unused int cpu_flags = av_get_cpu_flags();
     int lmsize_x = 5, cmsize_x = 0;
     int lmsize_y = 5, cmsize_y = 0;
     double lamount = 1.0f, camount = 0.0f;
@@ -144,6 +178,16 @@ static av_cold int init(AVFilterContext *ctx, const char *args, void *opaque)
     set_filter_param(&unsharp->luma,   lmsize_x, lmsize_y, lamount);
     set_filter_param(&unsharp->chroma, cmsize_x, cmsize_y, camount);
 
+    unsharp->add_pairs = ff_unsharp_add_pairs_c;
+    unsharp->blur_v    = ff_unsharp_blur_v_c;
+    unsharp->blend     = ff_unsharp_blend_c;
+
+    if (HAVE_SSE && cpu_flags & AV_CPU_FLAG_SSE2) {
+        unsharp->add_pairs = ff_unsharp_add_pairs_sse2;
+        unsharp->blur_v    = ff_unsharp_blur_v_sse2;
+        unsharp->blend     = ff_unsharp_blend_sse2;
+    }
+
     return 0;
 }
 
@@ -160,7 +204,7 @@ static int query_formats(AVFilterContext *ctx)
     return 0;
 }
 
-static void init_filter_param(AVFilterContext *ctx, FilterParam *fp, const char *effect_type, int width)
+static int init_filter_param(AVFilterContext *ctx, FilterParam *fp, const char *effect_type, int width)
 {
     int z;
     const char *effect;
@@ -170,45 +214,83 @@ static void init_filter_param(AVFilterContext *ctx, FilterParam *fp, const char
     av_log(ctx, AV_LOG_INFO, "effect:%s type:%s msize_x:%d msize_y:%d amount:%0.2f\n",
            effect, effect_type, fp->msize_x, fp->msize_y, fp->amount / 65535.0);
 
-    for (z = 0; z < 2 * fp->steps_y; z++)
-        fp->sc[z] = av_malloc(sizeof(*(fp->sc[z])) * (width + 2 * fp->steps_x));
+    fp->sc = av_mallocz(sizeof(*fp->sc) * 2 * fp->steps_y * ctx->thread_count);
+    if (!fp->sc)
+        return AVERROR(ENOMEM);
+    for (z = 0; z < 2 * fp->steps_y * ctx->thread_count; z++)
+        if (!(fp->sc[z] = av_malloc(sizeof(*(fp->sc[z])) * FFALIGN(width, 4))))
+            return AVERROR(ENOMEM);
+
+    return 0;
 }
 
 static int config_props(AVFilterLink *link)
 {
     UnsharpContext *unsharp = link->dst->priv;
+    int ret;
 
-    init_filter_param(link->dst, &unsharp->luma,   "luma",   link->w);
-    init_filter_param(link->dst, &unsharp->chroma, "chroma", CHROMA_WIDTH(link));
+    if ((ret = init_filter_param(link->dst, &unsharp->luma,   "luma",   link->w)) < 0 ||
+        (ret = init_filter_param(link->dst, &unsharp->chroma, "chroma", CHROMA_WIDTH(link))) < 0)
+        return ret;
+
+    unsharp->line_size = FFALIGN(link->w + 2 * FFMAX(unsharp->luma.steps_x, unsharp->chroma.steps_x) + 5, 4);
+    unsharp->line = av_malloc(sizeof(*unsharp->line) * unsharp->line_size * link->dst->thread_count);
+    if (!unsharp->line)
+        return AVERROR(ENOMEM);
 
     return 0;
 }
 
-static void free_filter_param(FilterParam *fp)
+static void free_filter_param(FilterParam *fp, int thread_count)
 {
     int z;
 
-    for (z = 0; z < 2 * fp->steps_y; z++)
+    if (!fp->sc)
+        return;
+    for (z = 0; z < 2 * fp->steps_y * thread_count; z++)
         av_free(fp->sc[z]);
+    av_freep(&fp->sc);
 }
 
 static av_cold void uninit(AVFilterContext *ctx)
 {
     UnsharpContext *unsharp = ctx->priv;
 
-    free_filter_param(&unsharp->luma);
-    free_filter_param(&unsharp->chroma);
+    free_filter_param(&unsharp->luma,   ctx->thread_count);
+    free_filter_param(&unsharp->chroma, ctx->thread_count);
+    av_freep(&unsharp->line);
+}
+
+static int filter_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    UnsharpContext *unsharp = ctx->priv;
+    ThreadData *td = arg;
+    AVFilterBufferRef *in = td->in, *out = td->out;
+    int plane;
+
+    for (plane = 0; plane < 3; plane++) {
+        FilterParam *fp = plane ? &unsharp->chroma : &unsharp->luma;
+        int width  = plane ? td->chroma_w : td->w;
+        int height = plane ? td->chroma_h : td->h;
+        int slice_start = (height *  jobnr   ) / nb_jobs;
+        int slice_end   = (height * (jobnr+1)) / nb_jobs;
+
+        if (slice_start < slice_end)
+            unsharpen(unsharp, out->data[plane], in->data[plane], out->linesize[plane], in->linesize[plane],
+                      width, height, slice_start, slice_end, fp, fp->sc + jobnr * 2 * fp->steps_y,
+                      unsharp->line + jobnr * unsharp->line_size);
+    }
+    return 0;
 }
 
 static void end_frame(AVFilterLink *link)
 {
-    UnsharpContext *unsharp = link->dst->priv;
+    AVFilterContext *ctx = link->dst;
     AVFilterBufferRef *in  = link->cur_buf;
     AVFilterBufferRef *out = link->dst->outputs[0]->out_buf;
+    ThreadData td = { in, out, link->w, link->h, CHROMA_WIDTH(link), CHROMA_HEIGHT(link) };
 
-    unsharpen(out->data[0], in->data[0], out->linesize[0], in->linesize[0], link->w,            link->h,             &unsharp->luma);
-    unsharpen(out->data[1], in->data[1], out->linesize[1], in->linesize[1], CHROMA_WIDTH(link), CHROMA_HEIGHT(link), &unsharp->chroma);
-    unsharpen(out->data[2], in->data[2], out->linesize[2], in->linesize[2], CHROMA_WIDTH(link), CHROMA_HEIGHT(link), &unsharp->chroma);
+    ctx->execute(ctx, filter_slice, &td, NULL, FFMIN(link->h, ctx->thread_count));
 
     avfilter_unref_buffer(in);
     avfilter_draw_slice(link->dst->outputs[0], 0, link->h, 1);
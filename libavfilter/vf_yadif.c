@@ -127,25 +127,39 @@ static void filter_line_c_16bit(uint16_t *dst,
     FILTER
 }
 
-static void filter(AVFilterContext *ctx, AVFilterBufferRef *dstpic,
-                   int parity, int tff)
+typedef struct {
+    AVFilterBufferRef *dstpic;
+    int parity, tff;
+} ThreadData;
+
+/**
+ * Filter a horizontal band of each plane. The output rows only depend on
+ * the input pictures, so the bands can be filtered at the same time.
+ */
+static int filter_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
     YADIFContext *yadif = ctx->priv;
+    ThreadData *td = arg;
+    AVFilterBufferRef *dstpic = td->dstpic;
+    int parity = td->parity, tff = td->tff;
     int y, i;
 
     for (i = 0; i < yadif->csp->nb_components; i++) {
         int w = dstpic->video->w;
         int h = dstpic->video->h;
         int refs = yadif->cur->linesize[i];
-        int df = (yadif->csp->comp[i].depth_minus1+1) / 8;
+        int df = (yadif->csp->comp[i].depth_minus1 + 8) / 8;
+        int slice_start, slice_end;
 
         if (i) {
         /* Why is this not part of the per-plane description thing? */
             w >>= yadif->csp->log2_chroma_w;
             h >>= yadif->csp->log2_chroma_h;
         }
+        slice_start = (h *  jobnr   ) / nb_jobs;
+        slice_end   = (h * (jobnr+1)) / nb_jobs;
 
-        for (y = 0; y < h; y++) {
+        for (y = slice_start; y < slice_end; y++) {
             if ((y ^ parity) & 1) {
                 uint8_t *prev = &yadif->prev->data[i][y*refs];
                 uint8_t *cur  = &yadif->cur ->data[i][y*refs];
@@ -162,6 +176,15 @@ static void filter(AVFilterContext *ctx, AVFilterBufferRef *dstpic,
 #if HAVE_MMX
     __asm__ volatile("emms \n\t" : : : "memory");
 #endif
+    return 0;
+}
+
+static void filter(AVFilterContext *ctx, AVFilterBufferRef *dstpic,
+                   int parity, int tff)
+{
+    ThreadData td = { dstpic, parity, tff };
+
+    ctx->execute(ctx, filter_slice, &td, NULL, FFMIN(dstpic->video->h, ctx->thread_count));
 }
 
 static AVFilterBufferRef *get_video_buffer(AVFilterLink *link, int perms, int w, int h)
@@ -199,11 +222,6 @@ static void return_frame(AVFilterContext *ctx, int is_second)
         yadif->out = avfilter_get_video_buffer(link, AV_PERM_WRITE | AV_PERM_PRESERVE |
                                                AV_PERM_REUSE, link->w, link->h);
 
-    if (!yadif->csp)
-        yadif->csp = &av_pix_fmt_descriptors[link->format];
-    if (yadif->csp->comp[0].depth_minus1 == 15)
-        yadif->filter_line = filter_line_c_16bit;
-
     filter(ctx, yadif->out, tff ^ !is_second, tff);
 
     if (is_second) {
@@ -329,6 +347,11 @@ static int query_formats(AVFilterContext *ctx)
         AV_NE( PIX_FMT_YUV420P16BE, PIX_FMT_YUV420P16LE ),
         AV_NE( PIX_FMT_YUV422P16BE, PIX_FMT_YUV422P16LE ),
         AV_NE( PIX_FMT_YUV444P16BE, PIX_FMT_YUV444P16LE ),
+        AV_NE( PIX_FMT_YUV420P9BE,  PIX_FMT_YUV420P9LE  ),
+        AV_NE( PIX_FMT_YUV444P9BE,  PIX_FMT_YUV444P9LE  ),
+        AV_NE( PIX_FMT_YUV420P10BE, PIX_FMT_YUV420P10LE ),
+        AV_NE( PIX_FMT_YUV422P10BE, PIX_FMT_YUV422P10LE ),
+        AV_NE( PIX_FMT_YUV444P10BE, PIX_FMT_YUV444P10LE ),
         PIX_FMT_NONE
     };
 
@@ -349,18 +372,42 @@ static av_cold int init(AVFilterContext *ctx, const char *args, void *opaque)
     if (args) sscanf(args, "%d:%d", &yadif->mode, &yadif->parity);
 
     yadif->filter_line = filter_line_c;
-    if (HAVE_SSSE3 && cpu_flags & AV_CPU_FLAG_SSSE3)
+    if (HAVE_AVX2 && cpu_flags & AV_CPU_FLAG_AVX2)
+        yadif->filter_line = ff_yadif_filter_line_avx2;
+    else if (HAVE_SSSE3 && cpu_flags & AV_CPU_FLAG_SSSE3)
         yadif->filter_line = ff_yadif_filter_line_ssse3;
     else if (HAVE_SSE && cpu_flags & AV_CPU_FLAG_SSE2)
         yadif->filter_line = ff_yadif_filter_line_sse2;
     else if (HAVE_MMX && cpu_flags & AV_CPU_FLAG_MMX)
         yadif->filter_line = ff_yadif_filter_line_mmx;
+    if (HAVE_NEON)
+        yadif->filter_line = ff_yadif_filter_line_neon;
 
     av_log(ctx, AV_LOG_INFO, "mode:%d parity:%d\n", yadif->mode, yadif->parity);
 
     return 0;
 }
 
+static int config_input(AVFilterLink *link)
+{
+    YADIFContext *yadif = link->dst->priv;
+    av_unused int cpu_flags = av_get_cpu_flags();
+
+    yadif->csp = &av_pix_fmt_descriptors[link->format];
+    if (yadif->csp->comp[0].depth_minus1 >= 8) {
+        yadif->filter_line = (void *)filter_line_c_16bit;
+        /* the SIMD versions compute in signed words */
+        if (yadif->csp->comp[0].depth_minus1 < 12) {
+            if (HAVE_AVX2 && cpu_flags & AV_CPU_FLAG_AVX2)
+                yadif->filter_line = ff_yadif_filter_line_16bit_avx2;
+            else if (HAVE_SSE && cpu_flags & AV_CPU_FLAG_SSE2)
+                yadif->filter_line = ff_yadif_filter_line_16bit_sse2;
+        }
+    }
+
+    return 0;
+}
+
 static void null_draw_slice(AVFilterLink *link, int y, int h, int slice_dir) { }
 
 AVFilter avfilter_vf_yadif = {
@@ -376,6 +423,7 @@ AVFilter avfilter_vf_yadif = {
                                     .type             = AVMEDIA_TYPE_VIDEO,
                                     .start_frame      = start_frame,
                                     .get_video_buffer = get_video_buffer,
+                                    .config_props     = config_input,
                                     .draw_slice       = null_draw_slice,
                                     .end_frame        = end_frame, },
                                   { .name = NULL}},
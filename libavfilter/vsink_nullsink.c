@@ -24,11 +24,14 @@ static void start_frame(AVFilterLink *link, AVFilterBufferRef *picref)
 
 static void end_frame(AVFilterLink *link)
 {
+    avfilter_unref_buffer(link->cur_buf);
+    link->cur_buf = NULL;
 }
 
 AVFilter avfilter_vsink_nullsink = {
     .name        = "nullsink",
     .description = NULL_IF_CONFIG_SMALL("Do absolutely nothing with the input video."),
+    .flags       = AVFILTER_FLAG_HWACCEL,
 
     .priv_size = 0,
 
@@ -66,6 +66,13 @@ int av_vsrc_buffer_add_video_buffer_ref(AVFilterContext *buffer_filter,
                c->w, c->h, av_pix_fmt_descriptors[c->pix_fmt].name,
                picref->video->w, picref->video->h, av_pix_fmt_descriptors[picref->format].name);
 
+        if ((av_pix_fmt_descriptors[c->pix_fmt       ].flags |
+             av_pix_fmt_descriptors[picref->format].flags) & PIX_FMT_HWACCEL) {
+            av_log(buffer_filter, AV_LOG_ERROR,
+                   "Hardware surfaces cannot be scaled, the filter graph must be reconfigured\n");
+            return AVERROR(EINVAL);
+        }
+
         if (!scale || strcmp(scale->filter->name, "scale")) {
             AVFilter *f = avfilter_get_by_name("scale");
 
@@ -101,6 +108,13 @@ int av_vsrc_buffer_add_video_buffer_ref(AVFilterContext *buffer_filter,
             return ret;
     }
 
+    /* hardware surfaces are only handles which cannot be copied */
+    if (flags & AV_VSRC_BUF_FLAG_NO_COPY ||
+        av_pix_fmt_descriptors[picref->format].flags & PIX_FMT_HWACCEL) {
+        c->picref = avfilter_ref_buffer(picref, ~0);
+        return 0;
+    }
+
     c->picref = avfilter_get_video_buffer(outlink, AV_PERM_WRITE,
                                           picref->video->w, picref->video->h);
     av_image_copy(c->picref->data, c->picref->linesize,
@@ -35,9 +35,23 @@
  */
 #define AV_VSRC_BUF_FLAG_OVERWRITE 1
 
+/**
+ * Tell av_vsrc_buffer_add_video_buffer_ref() to keep a new reference to
+ * picref instead of copying its data into a buffer of the filter graph.
+ * picref should not be writable by the filters if its owner still reads
+ * it, the filters requiring write permissions will copy it.
+ */
+#define AV_VSRC_BUF_FLAG_NO_COPY   2
+
 /**
  * Add video buffer data in picref to buffer_src.
  *
+ * Pictures in a hardware accelerated pixel format, which carry a surface
+ * handle in data[3], are always added as with AV_VSRC_BUF_FLAG_NO_COPY, so
+ * the surface must stay valid until the last reference to picref is
+ * released; the free() callback of picref->buf can be used to return it to
+ * the decoder. Their size and format cannot change.
+ *
  * @param buffer_src pointer to a buffer source context
  * @param flags a combination of AV_VSRC_BUF_FLAG_* flags
  * @return >= 0 in case of success, a negative AVERROR code in case of
@@ -0,0 +1,76 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/cpu.h"
+#include "libavutil/mem.h"
+#include "libavutil/x86_cpu.h"
+#include "libavfilter/drawutils.h"
+
+DECLARE_ALIGNED(16, static const uint16_t, pw_80)[8]  = {0x80,0x80,0x80,0x80,0x80,0x80,0x80,0x80};
+DECLARE_ALIGNED(16, static const uint16_t, pw_ff)[8]  = {0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF};
+DECLARE_ALIGNED(16, static const uint16_t, pw_101)[8] = {0x101,0x101,0x101,0x101,0x101,0x101,0x101,0x101};
+
+void ff_blend_row_sse2(uint8_t *dst, const uint8_t *src, const uint8_t *alpha, int width)
+{
+#if HAVE_SSE
+    intptr_t x = -(width & ~15);
+
+    if (x) {
+        __asm__ volatile(
+            "pxor       %%xmm7, %%xmm7 \n"
+            "1: \n"
+            "movdqu    (%1,%0), %%xmm0 \n"
+            "movdqu    (%2,%0), %%xmm1 \n"
+            "movdqu    (%3,%0), %%xmm2 \n"
+            "movdqa     %%xmm0, %%xmm3 \n"
+            "movdqa     %%xmm1, %%xmm4 \n"
+            "movdqa     %%xmm2, %%xmm5 \n"
+            "punpcklbw  %%xmm7, %%xmm0 \n"
+            "punpckhbw  %%xmm7, %%xmm3 \n"
+            "punpcklbw  %%xmm7, %%xmm1 \n"
+            "punpckhbw  %%xmm7, %%xmm4 \n"
+            "punpcklbw  %%xmm7, %%xmm2 \n"
+            "punpckhbw  %%xmm7, %%xmm5 \n"
+            "movdqa         %5, %%xmm6 \n"
+            "psubw      %%xmm2, %%xmm6 \n"
+            "pmullw     %%xmm6, %%xmm0 \n" // dst * (255 - alpha)
+            "pmullw     %%xmm2, %%xmm1 \n" // src * alpha
+            "paddw      %%xmm1, %%xmm0 \n"
+            "movdqa         %5, %%xmm6 \n"
+            "psubw      %%xmm5, %%xmm6 \n"
+            "pmullw     %%xmm6, %%xmm3 \n"
+            "pmullw     %%xmm5, %%xmm4 \n"
+            "paddw      %%xmm4, %%xmm3 \n"
+            "paddw          %4, %%xmm0 \n"
+            "paddw          %4, %%xmm3 \n"
+            "pmulhuw        %6, %%xmm0 \n" // (x + 128) * 257 >> 16 == x / 255
+            "pmulhuw        %6, %%xmm3 \n"
+            "packuswb   %%xmm3, %%xmm0 \n"
+            "movdqu     %%xmm0, (%1,%0) \n"
+            "add           $16, %0 \n"
+            "jl 1b \n"
+            :"+&r"(x)
+            :"r"(dst + (width & ~15)), "r"(src + (width & ~15)), "r"(alpha + (width & ~15)),
+             "m"(*pw_80), "m"(*pw_ff), "m"(*pw_101)
+            :"memory"
+        );
+    }
+    x = width & ~15;
+    ff_blend_row_c(dst + x, src + x, alpha + x, width - x);
+#endif
+}
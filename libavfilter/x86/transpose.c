@@ -0,0 +1,157 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/x86_cpu.h"
+#include "libavfilter/transpose.h"
+
+void ff_transpose_8x8_8_sse2(uint8_t *dst, int dst_linesize, const uint8_t *src, int src_linesize)
+{
+#if HAVE_SSE
+    x86_reg dls = dst_linesize, sls = src_linesize;
+
+    __asm__ volatile(
+        "movq          (%1), %%xmm0 \n"
+        "movq       (%1,%3), %%xmm1 \n"
+        "lea      (%1,%3,2), %1     \n"
+        "movq          (%1), %%xmm2 \n"
+        "movq       (%1,%3), %%xmm3 \n"
+        "lea      (%1,%3,2), %1     \n"
+        "movq          (%1), %%xmm4 \n"
+        "movq       (%1,%3), %%xmm5 \n"
+        "lea      (%1,%3,2), %1     \n"
+        "movq          (%1), %%xmm6 \n"
+        "movq       (%1,%3), %%xmm7 \n"
+        "punpcklbw   %%xmm1, %%xmm0 \n" // rows 0-1 interleaved
+        "punpcklbw   %%xmm3, %%xmm2 \n" // rows 2-3
+        "punpcklbw   %%xmm5, %%xmm4 \n" // rows 4-5
+        "punpcklbw   %%xmm7, %%xmm6 \n" // rows 6-7
+        "movdqa      %%xmm0, %%xmm1 \n"
+        "punpcklwd   %%xmm2, %%xmm0 \n" // rows 0-3, columns 0-3
+        "punpckhwd   %%xmm2, %%xmm1 \n" // rows 0-3, columns 4-7
+        "movdqa      %%xmm4, %%xmm3 \n"
+        "punpcklwd   %%xmm6, %%xmm4 \n" // rows 4-7, columns 0-3
+        "punpckhwd   %%xmm6, %%xmm3 \n" // rows 4-7, columns 4-7
+        "movdqa      %%xmm0, %%xmm2 \n"
+        "punpckldq   %%xmm4, %%xmm0 \n" // columns 0-1
+        "punpckhdq   %%xmm4, %%xmm2 \n" // columns 2-3
+        "movdqa      %%xmm1, %%xmm5 \n"
+        "punpckldq   %%xmm3, %%xmm1 \n" // columns 4-5
+        "punpckhdq   %%xmm3, %%xmm5 \n" // columns 6-7
+        "movq        %%xmm0, (%0)    \n"
+        "movhps      %%xmm0, (%0,%2) \n"
+        "lea      (%0,%2,2), %0      \n"
+        "movq        %%xmm2, (%0)    \n"
+        "movhps      %%xmm2, (%0,%2) \n"
+        "lea      (%0,%2,2), %0      \n"
+        "movq        %%xmm1, (%0)    \n"
+        "movhps      %%xmm1, (%0,%2) \n"
+        "lea      (%0,%2,2), %0      \n"
+        "movq        %%xmm5, (%0)    \n"
+        "movhps      %%xmm5, (%0,%2) \n"
+        :"+r"(dst), "+r"(src)
+        :"r"(dls), "r"(sls)
+        :"memory"
+    );
+#endif
+}
+
+#if HAVE_SSE
+/* Transpose 4x4 words; the 8x8 blocks of words and dwords are transposed
+ * as 4 blocks of 4x4 pixels. */
+static inline void transpose_4x4_16_sse2(uint8_t *dst, x86_reg dls,
+                                         const uint8_t *src, x86_reg sls)
+{
+    __asm__ volatile(
+        "movq          (%1), %%xmm0 \n"
+        "movq       (%1,%3), %%xmm1 \n"
+        "lea      (%1,%3,2), %1     \n"
+        "movq          (%1), %%xmm2 \n"
+        "movq       (%1,%3), %%xmm3 \n"
+        "punpcklwd   %%xmm1, %%xmm0 \n" // rows 0-1 interleaved
+        "punpcklwd   %%xmm3, %%xmm2 \n" // rows 2-3
+        "movdqa      %%xmm0, %%xmm1 \n"
+        "punpckldq   %%xmm2, %%xmm0 \n" // columns 0-1
+        "punpckhdq   %%xmm2, %%xmm1 \n" // columns 2-3
+        "movq        %%xmm0, (%0)    \n"
+        "movhps      %%xmm0, (%0,%2) \n"
+        "lea      (%0,%2,2), %0      \n"
+        "movq        %%xmm1, (%0)    \n"
+        "movhps      %%xmm1, (%0,%2) \n"
+        :"+r"(dst), "+r"(src)
+        :"r"(dls), "r"(sls)
+        :"memory"
+    );
+}
+
+/* Transpose 4x4 dwords. */
+static inline void transpose_4x4_32_sse2(uint8_t *dst, x86_reg dls,
+                                         const uint8_t *src, x86_reg sls)
+{
+    __asm__ volatile(
+        "movdqu        (%1), %%xmm0 \n"
+        "movdqu     (%1,%3), %%xmm1 \n"
+        "lea      (%1,%3,2), %1     \n"
+        "movdqu        (%1), %%xmm2 \n"
+        "movdqu     (%1,%3), %%xmm3 \n"
+        "movdqa      %%xmm0, %%xmm4 \n"
+        "punpckldq   %%xmm1, %%xmm0 \n" // rows 0-1, columns 0-1
+        "punpckhdq   %%xmm1, %%xmm4 \n" // rows 0-1, columns 2-3
+        "movdqa      %%xmm2, %%xmm5 \n"
+        "punpckldq   %%xmm3, %%xmm2 \n" // rows 2-3, columns 0-1
+        "punpckhdq   %%xmm3, %%xmm5 \n" // rows 2-3, columns 2-3
+        "movdqa      %%xmm0, %%xmm1 \n"
+        "punpcklqdq  %%xmm2, %%xmm0 \n" // column 0
+        "punpckhqdq  %%xmm2, %%xmm1 \n" // column 1
+        "movdqa      %%xmm4, %%xmm3 \n"
+        "punpcklqdq  %%xmm5, %%xmm4 \n" // column 2
+        "punpckhqdq  %%xmm5, %%xmm3 \n" // column 3
+        "movdqu      %%xmm0, (%0)    \n"
+        "movdqu      %%xmm1, (%0,%2) \n"
+        "lea      (%0,%2,2), %0      \n"
+        "movdqu      %%xmm4, (%0)    \n"
+        "movdqu      %%xmm3, (%0,%2) \n"
+        :"+r"(dst), "+r"(src)
+        :"r"(dls), "r"(sls)
+        :"memory"
+    );
+}
+#endif
+
+void ff_transpose_8x8_16_sse2(uint8_t *dst, int dst_linesize, const uint8_t *src, int src_linesize)
+{
+#if HAVE_SSE
+    x86_reg dls = dst_linesize, sls = src_linesize;
+
+    transpose_4x4_16_sse2(dst,                dls, src,                sls);
+    transpose_4x4_16_sse2(dst + 8,            dls, src + 4 * sls,      sls);
+    transpose_4x4_16_sse2(dst + 4 * dls,      dls, src + 8,            sls);
+    transpose_4x4_16_sse2(dst + 4 * dls + 8,  dls, src + 4 * sls + 8,  sls);
+#endif
+}
+
+void ff_transpose_8x8_32_sse2(uint8_t *dst, int dst_linesize, const uint8_t *src, int src_linesize)
+{
+#if HAVE_SSE
+    x86_reg dls = dst_linesize, sls = src_linesize;
+
+    transpose_4x4_32_sse2(dst,                dls, src,                sls);
+    transpose_4x4_32_sse2(dst + 16,           dls, src + 4 * sls,      sls);
+    transpose_4x4_32_sse2(dst + 4 * dls,      dls, src + 16,           sls);
+    transpose_4x4_32_sse2(dst + 4 * dls + 16, dls, src + 4 * sls + 16, sls);
+#endif
+}
@@ -0,0 +1,118 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/cpu.h"
+#include "libavutil/x86_cpu.h"
+#include "libavfilter/unsharp.h"
+
+void ff_unsharp_add_pairs_sse2(uint32_t *buf, int len)
+{
+#if HAVE_SSE
+    intptr_t x = -4 * FFALIGN(len, 4);
+
+    if (len <= 0)
+        return;
+    __asm__ volatile(
+        "1: \n"
+        "movdqu  4(%1,%0), %%xmm0 \n"
+        "paddd    (%1,%0), %%xmm0 \n"
+        "movdqa   %%xmm0, (%1,%0) \n" // buf[i] += buf[i+1]
+        "add         $16, %0 \n"
+        "jl 1b \n"
+        :"+&r"(x)
+        :"r"(buf + FFALIGN(len, 4))
+        :"memory"
+    );
+#endif
+}
+
+void ff_unsharp_blur_v_sse2(uint32_t *buf, uint32_t **sc, int width, int steps)
+{
+#if HAVE_SSE
+    int z;
+
+    for (z = 0; z < steps * 2; z++) {
+        intptr_t x = -4 * FFALIGN(width, 4);
+        __asm__ volatile(
+            "1: \n"
+            "movdqa  (%1,%0), %%xmm0 \n"
+            "movdqa  (%2,%0), %%xmm1 \n"
+            "movdqa   %%xmm0, (%2,%0) \n" // sc[z][x] = tmp
+            "paddd    %%xmm1, %%xmm0 \n"
+            "movdqa   %%xmm0, (%1,%0) \n" // tmp += old sc[z][x]
+            "add         $16, %0 \n"
+            "jl 1b \n"
+            :"+&r"(x)
+            :"r"(buf + FFALIGN(width, 4)), "r"(sc[z] + FFALIGN(width, 4))
+            :"memory"
+        );
+    }
+#endif
+}
+
+void ff_unsharp_blend_sse2(uint8_t *dst, const uint8_t *src, const uint32_t *blur, int width,
+                           int amount, int halfscale, int scalebits)
+{
+#if HAVE_SSE
+    intptr_t x;
+
+    if (width & 3) {
+        x = width & ~3;
+        ff_unsharp_blend_c(dst + x, src + x, blur + x, width - x, amount, halfscale, scalebits);
+        width = x;
+    }
+    if (!width)
+        return;
+    x = -width;
+    __asm__ volatile(
+        "movd           %4, %%xmm5 \n"
+        "movd           %5, %%xmm6 \n"
+        "movd           %6, %%xmm4 \n"
+        "pshufd $0, %%xmm5, %%xmm5 \n"
+        "pshufd $0, %%xmm6, %%xmm6 \n"
+        "pxor       %%xmm7, %%xmm7 \n"
+        "1: \n"
+        "movd      (%2,%0), %%xmm0 \n"
+        "movdqa (%3,%0,4), %%xmm1 \n"
+        "punpcklbw  %%xmm7, %%xmm0 \n"
+        "punpcklwd  %%xmm7, %%xmm0 \n"
+        "paddd      %%xmm6, %%xmm1 \n"
+        "psrld      %%xmm4, %%xmm1 \n" // blur = (blur + halfscale) >> scalebits
+        "movdqa     %%xmm0, %%xmm2 \n"
+        "psubd      %%xmm1, %%xmm2 \n" // d = pix - blur
+        "movdqa     %%xmm2, %%xmm3 \n"
+        "psrlq         $32, %%xmm3 \n"
+        "pmuludq    %%xmm5, %%xmm2 \n"
+        "pmuludq    %%xmm5, %%xmm3 \n"
+        "pshufd $8, %%xmm2, %%xmm2 \n"
+        "pshufd $8, %%xmm3, %%xmm3 \n"
+        "punpckldq  %%xmm3, %%xmm2 \n" // low 32 bits of d * amount
+        "psrad         $16, %%xmm2 \n"
+        "paddd      %%xmm2, %%xmm0 \n" // pix += d * amount >> 16
+        "packssdw   %%xmm0, %%xmm0 \n"
+        "packuswb   %%xmm0, %%xmm0 \n"
+        "movd       %%xmm0, (%1,%0) \n" // dst = clip(pix)
+        "add            $4, %0 \n"
+        "jl 1b \n"
+        :"+&r"(x)
+        :"r"(dst + width), "r"(src + width), "r"(blur + width),
+         "rm"(amount), "rm"(halfscale), "rm"(scalebits)
+        :"memory"
+    );
+#endif
+}
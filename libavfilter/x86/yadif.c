@@ -25,6 +25,37 @@
 
 DECLARE_ASM_CONST(16, const xmm_reg, pb_1) = {0x0101010101010101ULL, 0x0101010101010101ULL};
 DECLARE_ASM_CONST(16, const xmm_reg, pw_1) = {0x0001000100010001ULL, 0x0001000100010001ULL};
+DECLARE_ALIGNED(32, static const uint16_t, ymm_pw_1)[16] = {1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1};
+
+#if HAVE_SSE
+#define COMPILE_TEMPLATE_AVX2 0
+#define COMPILE_TEMPLATE_8BIT 0
+#undef RENAME
+#define RENAME(a) a ## _16bit_sse2
+#include "yadif_word_template.c"
+#undef COMPILE_TEMPLATE_AVX2
+#undef COMPILE_TEMPLATE_8BIT
+#endif
+
+#if HAVE_AVX2
+#define COMPILE_TEMPLATE_AVX2 1
+#define COMPILE_TEMPLATE_8BIT 1
+#define FILTER_LINE_TAIL ff_yadif_filter_line_ssse3
+#undef RENAME
+#define RENAME(a) a ## _avx2
+#include "yadif_word_template.c"
+#undef COMPILE_TEMPLATE_8BIT
+#undef FILTER_LINE_TAIL
+
+#define COMPILE_TEMPLATE_8BIT 0
+#define FILTER_LINE_TAIL ff_yadif_filter_line_16bit_sse2
+#undef RENAME
+#define RENAME(a) a ## _16bit_avx2
+#include "yadif_word_template.c"
+#undef COMPILE_TEMPLATE_AVX2
+#undef COMPILE_TEMPLATE_8BIT
+#undef FILTER_LINE_TAIL
+#endif
 
 #if HAVE_SSSE3
 #define COMPILE_TEMPLATE_SSE 1
@@ -0,0 +1,276 @@
+/*
+ * Copyright (C) 2006 Michael Niedermayer <michaelni@gmx.at>
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Same algorithm as yadif_template.c, but the samples are kept in 16-bit
+ * words all along: 8-bit samples are zero-extended when loaded, 16-bit
+ * ones are loaded as they are. The intermediate values must fit in signed
+ * words, which limits the 16-bit versions to samples of at most 12 bits.
+ *
+ * COMPILE_TEMPLATE_AVX2 selects 256-bit registers instead of 128-bit ones,
+ * COMPILE_TEMPLATE_8BIT 8-bit samples (only available with AVX2).
+ * FILTER_LINE_TAIL is the function filtering the pixels which do not fill
+ * a whole register, so that no more than 16 bytes are written past the end
+ * of the line, as with the other versions.
+ */
+
+#if COMPILE_TEMPLATE_AVX2
+#define MM "%%ymm"
+#define REGSIZE 32
+#define MOVA "vmovdqa"
+#define MOVU "vmovdqu"
+#define OP(op, src, dst) "v"op" "src", "dst", "dst" \n\t"
+#define PABS(tmp,dst) "vpabsw    "dst", "dst" \n\t"
+#else
+#define MM "%%xmm"
+#define REGSIZE 16
+#define MOVA "movdqa"
+#define MOVU "movdqu"
+#define OP(op, src, dst) op" "src", "dst" \n\t"
+#define PABS(tmp,dst) \
+            "pxor     "tmp", "tmp" \n\t"\
+            "psubw    "dst", "tmp" \n\t"\
+            "pmaxsw   "tmp", "dst" \n\t"
+#endif
+
+#if COMPILE_TEMPLATE_8BIT
+#define SAMPLE_SIZE 1
+#define LOAD(mem,dst) "vpmovzxbw "mem", "dst" \n\t"
+#define STORE(src) \
+            "vpackuswb "src", "src", "src" \n\t"\
+            "vpermq   $8, "src", "src" \n\t"\
+            "vmovdqu   %%xmm1, %[dst] \n\t"
+#else
+#define SAMPLE_SIZE 2
+#define LOAD(mem,dst) MOVU" "mem", "dst" \n\t"
+#define STORE(src) MOVU" "src", %[dst] \n\t"
+#endif
+#define PS AV_STRINGIFY(SAMPLE_SIZE)
+
+#define STEP (REGSIZE / 2)
+#define TMP(n) #n"*"AV_STRINGIFY(REGSIZE)"(%[tmpA])"
+
+#define CHECK(j) \
+            LOAD(PS"*"#j"-"PS"(%[cur],%[mrefs])", MM"2") /* cur[x-refs-1+j] */\
+            LOAD("-"PS"*"#j"-"PS"(%[cur],%[prefs])", MM"3") /* cur[x+refs-1-j] */\
+            OP("psubw", MM"3", MM"2")\
+            PABS(MM"4", MM"2")\
+            LOAD(PS"*"#j"(%[cur],%[mrefs])", MM"3") /* cur[x-refs+j] */\
+            LOAD("-"PS"*"#j"(%[cur],%[prefs])", MM"4") /* cur[x+refs-j] */\
+            MOVA"      "MM"3, "MM"5 \n\t"\
+            OP("paddw", MM"4", MM"5")\
+            OP("psrlw", "$1", MM"5") /* (cur[x-refs+j] + cur[x+refs-j])>>1 */\
+            OP("psubw", MM"4", MM"3")\
+            PABS(MM"4", MM"3")\
+            OP("paddw", MM"3", MM"2")\
+            LOAD(PS"*"#j"+"PS"(%[cur],%[mrefs])", MM"3") /* cur[x-refs+1+j] */\
+            LOAD("-"PS"*"#j"+"PS"(%[cur],%[prefs])", MM"4") /* cur[x+refs+1-j] */\
+            OP("psubw", MM"4", MM"3")\
+            PABS(MM"4", MM"3")\
+            OP("paddw", MM"3", MM"2") /* score */
+
+#define CHECK1 \
+            MOVA"      "MM"0, "MM"3 \n\t"\
+            OP("pcmpgtw", MM"2", MM"3") /* if(score < spatial_score) */\
+            OP("pminsw",  MM"2", MM"0") /* spatial_score= score; */\
+            MOVA"      "MM"3, "MM"6 \n\t"\
+            OP("pand",    MM"3", MM"5")\
+            OP("pandn",   MM"1", MM"3")\
+            OP("por",     MM"5", MM"3")\
+            MOVA"      "MM"3, "MM"1 \n\t" /* spatial_pred= (cur[x-refs+j] + cur[x+refs-j])>>1; */
+
+#define CHECK2 /* pretend not to have checked dir=2 if dir=1 was bad.\
+                  hurts both quality and speed, but matches the C version. */\
+            OP("paddw",   "%[pw_1]", MM"6")\
+            OP("psllw",   "$14",     MM"6")\
+            OP("paddsw",  MM"6", MM"2")\
+            MOVA"      "MM"0, "MM"3 \n\t"\
+            OP("pcmpgtw", MM"2", MM"3")\
+            OP("pminsw",  MM"2", MM"0")\
+            OP("pand",    MM"3", MM"5")\
+            OP("pandn",   MM"1", MM"3")\
+            OP("por",     MM"5", MM"3")\
+            MOVA"      "MM"3, "MM"1 \n\t"
+
+void RENAME(ff_yadif_filter_line)(uint8_t *dst,
+                                  uint8_t *prev, uint8_t *cur, uint8_t *next,
+                                  int w, int prefs, int mrefs, int parity, int mode)
+{
+    uint8_t tmp[5*REGSIZE];
+    uint8_t *tmpA= (uint8_t*)(((uintptr_t)(tmp+REGSIZE-1)) & ~(REGSIZE-1));
+    int x, end = COMPILE_TEMPLATE_AVX2 ? w & ~(STEP-1) : w;
+
+#define FILTER\
+    for(x=0; x<end; x+=STEP){\
+        __asm__ volatile(\
+            LOAD("(%[cur],%[mrefs])", MM"0") /* c = cur[x-refs] */\
+            LOAD("(%[cur],%[prefs])", MM"1") /* e = cur[x+refs] */\
+            LOAD("(%["prev2"])", MM"2") /* prev2[x] */\
+            LOAD("(%["next2"])", MM"3") /* next2[x] */\
+            MOVA"      "MM"3, "MM"4 \n\t"\
+            OP("paddw", MM"2", MM"3")\
+            OP("psrlw", "$1",  MM"3") /* d = (prev2[x] + next2[x])>>1 */\
+            MOVA"      "MM"0, "TMP(0)" \n\t" /* c */\
+            MOVA"      "MM"3, "TMP(1)" \n\t" /* d */\
+            MOVA"      "MM"1, "TMP(2)" \n\t" /* e */\
+            OP("psubw", MM"4", MM"2")\
+            PABS(       MM"4", MM"2") /* temporal_diff0 */\
+            LOAD("(%[prev],%[mrefs])", MM"3") /* prev[x-refs] */\
+            LOAD("(%[prev],%[prefs])", MM"4") /* prev[x+refs] */\
+            OP("psubw", MM"0", MM"3")\
+            OP("psubw", MM"1", MM"4")\
+            PABS(       MM"5", MM"3")\
+            PABS(       MM"5", MM"4")\
+            OP("paddw", MM"4", MM"3") /* temporal_diff1 */\
+            OP("psrlw", "$1",  MM"2")\
+            OP("psrlw", "$1",  MM"3")\
+            OP("pmaxsw", MM"3", MM"2")\
+            LOAD("(%[next],%[mrefs])", MM"3") /* next[x-refs] */\
+            LOAD("(%[next],%[prefs])", MM"4") /* next[x+refs] */\
+            OP("psubw", MM"0", MM"3")\
+            OP("psubw", MM"1", MM"4")\
+            PABS(       MM"5", MM"3")\
+            PABS(       MM"5", MM"4")\
+            OP("paddw", MM"4", MM"3") /* temporal_diff2 */\
+            OP("psrlw", "$1",  MM"3")\
+            OP("pmaxsw", MM"3", MM"2")\
+            MOVA"      "MM"2, "TMP(3)" \n\t" /* diff */\
+\
+            OP("paddw", MM"0", MM"1")\
+            OP("paddw", MM"0", MM"0")\
+            OP("psubw", MM"1", MM"0")\
+            OP("psrlw", "$1",  MM"1") /* spatial_pred */\
+            PABS(       MM"2", MM"0") /* ABS(c-e) */\
+\
+            LOAD("-"PS"(%[cur],%[mrefs])", MM"2") /* cur[x-refs-1] */\
+            LOAD("-"PS"(%[cur],%[prefs])", MM"3") /* cur[x+refs-1] */\
+            OP("psubw", MM"3", MM"2")\
+            PABS(       MM"3", MM"2") /* ABS(cur[x-refs-1] - cur[x+refs-1]) */\
+            OP("paddw", MM"2", MM"0")\
+            LOAD(PS"(%[cur],%[mrefs])", MM"2") /* cur[x-refs+1] */\
+            LOAD(PS"(%[cur],%[prefs])", MM"3") /* cur[x+refs+1] */\
+            OP("psubw", MM"3", MM"2")\
+            PABS(       MM"3", MM"2") /* ABS(cur[x-refs+1] - cur[x+refs+1]) */\
+            OP("paddw", MM"2", MM"0")\
+            OP("psubw", "%[pw_1]", MM"0") /* spatial_score */\
+\
+            CHECK(-1)\
+            CHECK1\
+            CHECK(-2)\
+            CHECK2\
+            CHECK(1)\
+            CHECK1\
+            CHECK(2)\
+            CHECK2\
+\
+            /* if(p->mode<2) ... */\
+            MOVA"    "TMP(3)", "MM"6 \n\t" /* diff */\
+            "cmpl      $2, %[mode] \n\t"\
+            "jge       1f \n\t"\
+            LOAD("(%["prev2"],%[mrefs],2)", MM"2") /* prev2[x-2*refs] */\
+            LOAD("(%["next2"],%[mrefs],2)", MM"4") /* next2[x-2*refs] */\
+            LOAD("(%["prev2"],%[prefs],2)", MM"3") /* prev2[x+2*refs] */\
+            LOAD("(%["next2"],%[prefs],2)", MM"5") /* next2[x+2*refs] */\
+            OP("paddw", MM"4", MM"2")\
+            OP("paddw", MM"5", MM"3")\
+            OP("psrlw", "$1",  MM"2") /* b */\
+            OP("psrlw", "$1",  MM"3") /* f */\
+            MOVA"    "TMP(0)", "MM"4 \n\t" /* c */\
+            MOVA"    "TMP(1)", "MM"5 \n\t" /* d */\
+            MOVA"    "TMP(2)", "MM"7 \n\t" /* e */\
+            OP("psubw", MM"4", MM"2") /* b-c */\
+            OP("psubw", MM"7", MM"3") /* f-e */\
+            MOVA"      "MM"5, "MM"0 \n\t"\
+            OP("psubw", MM"4", MM"5") /* d-c */\
+            OP("psubw", MM"7", MM"0") /* d-e */\
+            MOVA"      "MM"2, "MM"4 \n\t"\
+            OP("pminsw", MM"3", MM"2")\
+            OP("pmaxsw", MM"4", MM"3")\
+            OP("pmaxsw", MM"5", MM"2")\
+            OP("pminsw", MM"5", MM"3")\
+            OP("pmaxsw", MM"0", MM"2") /* max */\
+            OP("pminsw", MM"0", MM"3") /* min */\
+            OP("pxor",   MM"4", MM"4")\
+            OP("pmaxsw", MM"3", MM"6")\
+            OP("psubw",  MM"2", MM"4") /* -max */\
+            OP("pmaxsw", MM"4", MM"6") /* diff= MAX3(diff, min, -max); */\
+            "1: \n\t"\
+\
+            MOVA"    "TMP(1)", "MM"2 \n\t" /* d */\
+            MOVA"      "MM"2, "MM"3 \n\t"\
+            OP("psubw",  MM"6", MM"2") /* d-diff */\
+            OP("paddw",  MM"6", MM"3") /* d+diff */\
+            OP("pmaxsw", MM"2", MM"1")\
+            OP("pminsw", MM"3", MM"1") /* d = clip(spatial_pred, d-diff, d+diff); */\
+            STORE(MM"1")\
+\
+            :[dst]  "=m"(*dst)\
+            :[tmpA] "r"(tmpA),\
+             [prev] "r"(prev),\
+             [cur]  "r"(cur),\
+             [next] "r"(next),\
+             [prefs]"r"((x86_reg)prefs),\
+             [mrefs]"r"((x86_reg)mrefs),\
+             [mode] "g"(mode),\
+             [pw_1] "m"(*ymm_pw_1)\
+            :"memory"\
+        );\
+        dst += STEP * SAMPLE_SIZE;\
+        prev+= STEP * SAMPLE_SIZE;\
+        cur += STEP * SAMPLE_SIZE;\
+        next+= STEP * SAMPLE_SIZE;\
+    }
+
+    if (parity) {
+#define prev2 "prev"
+#define next2 "cur"
+        FILTER
+#undef prev2
+#undef next2
+    } else {
+#define prev2 "cur"
+#define next2 "next"
+        FILTER
+#undef prev2
+#undef next2
+    }
+
+#if COMPILE_TEMPLATE_AVX2
+    __asm__ volatile("vzeroupper \n\t");
+    if (end < w)
+        FILTER_LINE_TAIL(dst, prev, cur, next, w - end, prefs, mrefs, parity, mode);
+#endif
+}
+#undef MM
+#undef REGSIZE
+#undef MOVA
+#undef MOVU
+#undef OP
+#undef PABS
+#undef SAMPLE_SIZE
+#undef PS
+#undef LOAD
+#undef STORE
+#undef STEP
+#undef TMP
+#undef CHECK
+#undef CHECK1
+#undef CHECK2
+#undef FILTER
@@ -33,4 +33,21 @@ void ff_yadif_filter_line_ssse3(uint8_t *dst,
                                 uint8_t *prev, uint8_t *cur, uint8_t *next,
                                 int w, int prefs, int mrefs, int parity, int mode);
 
+void ff_yadif_filter_line_avx2(uint8_t *dst,
+                               uint8_t *prev, uint8_t *cur, uint8_t *next,
+                               int w, int prefs, int mrefs, int parity, int mode);
+
+/* versions for samples of 9 to 12 bits, stored in 16 bits */
+void ff_yadif_filter_line_16bit_sse2(uint8_t *dst,
+                                     uint8_t *prev, uint8_t *cur, uint8_t *next,
+                                     int w, int prefs, int mrefs, int parity, int mode);
+
+void ff_yadif_filter_line_16bit_avx2(uint8_t *dst,
+                                     uint8_t *prev, uint8_t *cur, uint8_t *next,
+                                     int w, int prefs, int mrefs, int parity, int mode);
+
+void ff_yadif_filter_line_neon(uint8_t *dst,
+                               uint8_t *prev, uint8_t *cur, uint8_t *next,
+                               int w, int prefs, int mrefs, int parity, int mode);
+
 #endif /* AVFILTER_YADIF_H */
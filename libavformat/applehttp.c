@@ -35,7 +35,12 @@
 #include "avio_internal.h"
 #include "url.h"
 
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
 #define INITIAL_BUFFER_SIZE 32768
+#define MAX_PREFETCH 16
 
 /*
  * An apple http stream consists of a playlist with media segment files,
@@ -62,6 +67,21 @@ struct segment {
     uint8_t iv[16];
 };
 
+/*
+ * A segment downloaded ahead into memory by the fetcher thread of its
+ * variant. The demuxer reads it while it is being downloaded.
+ */
+struct prefetch_job {
+    struct segment seg;
+    int seq_no;
+    uint8_t *data;
+    unsigned int size, alloc_size;
+    unsigned int read_pos;
+    int started, done, cancel;
+    int error;
+    int64_t fetch_time;
+};
+
 /*
  * Each variant has its own demuxer. If it currently is active,
  * it has an open AVIOContext too, and potentially an AVPacket
@@ -90,14 +110,33 @@ struct variant {
 
     char key_url[MAX_URL_SIZE];
     uint8_t key[16];
+
+    /* ring of the segments queued for prefetching, the first one being
+     * the one read, or to be read next, by the demuxer */
+    struct prefetch_job *jobs;
+    int n_jobs, first_job, nb_jobs;
+#if HAVE_PTHREADS
+    int fetching;               ///< job being downloaded, or -1
+    pthread_t fetch_thread;
+    int fetch_thread_started;
+    int fetch_abort;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    /* key cache of the fetcher thread */
+    char fetch_key_url[MAX_URL_SIZE];
+    uint8_t fetch_key[16];
+#endif
+    int download_bitrate;
 };
 
 typedef struct AppleHTTPContext {
+    const AVClass *class;
     int n_variants;
     struct variant **variants;
     int cur_seq_no;
     int end_of_segment;
     int first_packet;
+    int prefetch;
 } AppleHTTPContext;
 
 static int read_chomp_line(AVIOContext *s, char *buf, int maxlen)
@@ -117,11 +156,14 @@ static void free_segment_list(struct variant *var)
     var->n_segments = 0;
 }
 
+static void prefetch_close(struct variant *var);
+
 static void free_variant_list(AppleHTTPContext *c)
 {
     int i;
     for (i = 0; i < c->n_variants; i++) {
         struct variant *var = c->variants[i];
+        prefetch_close(var);
         free_segment_list(var);
         av_free_packet(&var->pkt);
         av_free(var->pb.buffer);
@@ -317,19 +359,22 @@ fail:
     return ret;
 }
 
-static int open_input(struct variant *var)
+/**
+ * Open the segment seg, using and updating the cache of the last key
+ * key_url/key.
+ */
+static int open_segment(URLContext **in, struct segment *seg,
+                        char *key_url, uint8_t *key)
 {
-    struct segment *seg = var->segments[var->cur_seq_no - var->start_seq_no];
     if (seg->key_type == KEY_NONE) {
-        return ffurl_open(&var->input, seg->url, AVIO_FLAG_READ);
+        return ffurl_open(in, seg->url, AVIO_FLAG_READ);
     } else if (seg->key_type == KEY_AES_128) {
-        char iv[33], key[33], url[MAX_URL_SIZE];
+        char iv[33], keystr[33], url[MAX_URL_SIZE];
         int ret;
-        if (strcmp(seg->key, var->key_url)) {
+        if (strcmp(seg->key, key_url)) {
             URLContext *uc;
             if (ffurl_open(&uc, seg->key, AVIO_FLAG_READ) == 0) {
-                if (ffurl_read_complete(uc, var->key, sizeof(var->key))
-                    != sizeof(var->key)) {
+                if (ffurl_read_complete(uc, key, 16) != 16) {
                     av_log(NULL, AV_LOG_ERROR, "Unable to read key file %s\n",
                            seg->key);
                 }
@@ -338,22 +383,22 @@ static int open_input(struct variant *var)
                 av_log(NULL, AV_LOG_ERROR, "Unable to open key file %s\n",
                        seg->key);
             }
-            av_strlcpy(var->key_url, seg->key, sizeof(var->key_url));
+            av_strlcpy(key_url, seg->key, MAX_URL_SIZE);
         }
         ff_data_to_hex(iv, seg->iv, sizeof(seg->iv), 0);
-        ff_data_to_hex(key, var->key, sizeof(var->key), 0);
-        iv[32] = key[32] = '\0';
+        ff_data_to_hex(keystr, key, 16, 0);
+        iv[32] = keystr[32] = '\0';
         if (strstr(seg->url, "://"))
             snprintf(url, sizeof(url), "crypto+%s", seg->url);
         else
             snprintf(url, sizeof(url), "crypto:%s", seg->url);
-        if ((ret = ffurl_alloc(&var->input, url, AVIO_FLAG_READ)) < 0)
+        if ((ret = ffurl_alloc(in, url, AVIO_FLAG_READ)) < 0)
             return ret;
-        av_set_string3(var->input->priv_data, "key", key, 0, NULL);
-        av_set_string3(var->input->priv_data, "iv", iv, 0, NULL);
-        if ((ret = ffurl_connect(var->input)) < 0) {
-            ffurl_close(var->input);
-            var->input = NULL;
+        av_set_string3((*in)->priv_data, "key", keystr, 0, NULL);
+        av_set_string3((*in)->priv_data, "iv", iv, 0, NULL);
+        if ((ret = ffurl_connect(*in)) < 0) {
+            ffurl_close(*in);
+            *in = NULL;
             return ret;
         }
         return 0;
@@ -361,14 +406,234 @@ static int open_input(struct variant *var)
     return AVERROR(ENOSYS);
 }
 
+static int open_input(struct variant *var)
+{
+    struct segment *seg = var->segments[var->cur_seq_no - var->start_seq_no];
+    return open_segment(&var->input, seg, var->key_url, var->key);
+}
+
+#if HAVE_PTHREADS
+static int job_append(struct prefetch_job *job, const uint8_t *buf, int size)
+{
+    uint8_t *data = av_fast_realloc(job->data, &job->alloc_size,
+                                    job->size + size);
+    if (!data)
+        return AVERROR(ENOMEM);
+    job->data = data;
+    memcpy(job->data + job->size, buf, size);
+    job->size += size;
+    return 0;
+}
+
+static void *fetch_thread(void *arg)
+{
+    struct variant *var = arg;
+    uint8_t buf[INITIAL_BUFFER_SIZE];
+
+    pthread_mutex_lock(&var->mutex);
+    while (!var->fetch_abort) {
+        struct prefetch_job *job = NULL;
+        URLContext *in = NULL;
+        int64_t start;
+        int i, ret;
+
+        /* the segments are downloaded in order */
+        for (i = 0; i < var->nb_jobs; i++) {
+            int idx = (var->first_job + i) % var->n_jobs;
+            if (!var->jobs[idx].started && !var->jobs[idx].cancel) {
+                job = &var->jobs[idx];
+                var->fetching = idx;
+                break;
+            }
+        }
+        if (!job) {
+            pthread_cond_wait(&var->cond, &var->mutex);
+            continue;
+        }
+        job->started = 1;
+        pthread_mutex_unlock(&var->mutex);
+
+        start = av_gettime();
+        ret = open_segment(&in, &job->seg, var->fetch_key_url, var->fetch_key);
+        while (ret >= 0) {
+            ret = ffurl_read(in, buf, sizeof(buf));
+            if (ret <= 0)
+                break;
+            pthread_mutex_lock(&var->mutex);
+            if (job->cancel) {
+                pthread_mutex_unlock(&var->mutex);
+                break;
+            }
+            ret = job_append(job, buf, ret);
+            pthread_cond_broadcast(&var->cond);
+            pthread_mutex_unlock(&var->mutex);
+        }
+        if (in)
+            ffurl_close(in);
+
+        pthread_mutex_lock(&var->mutex);
+        job->done       = 1;
+        job->error      = ret == AVERROR_EOF ? 0 : FFMIN(ret, 0);
+        job->fetch_time = av_gettime() - start;
+        var->fetching   = -1;
+        pthread_cond_broadcast(&var->cond);
+    }
+    pthread_mutex_unlock(&var->mutex);
+    return NULL;
+}
+
+static int prefetch_open(struct variant *var, int depth)
+{
+    var->jobs = av_mallocz(depth * sizeof(*var->jobs));
+    if (!var->jobs)
+        return AVERROR(ENOMEM);
+    var->n_jobs   = depth;
+    var->fetching = -1;
+    pthread_mutex_init(&var->mutex, NULL);
+    pthread_cond_init(&var->cond, NULL);
+    if (pthread_create(&var->fetch_thread, NULL, fetch_thread, var)) {
+        pthread_mutex_destroy(&var->mutex);
+        pthread_cond_destroy(&var->cond);
+        av_freep(&var->jobs);
+        return AVERROR(ENOMEM);
+    }
+    var->fetch_thread_started = 1;
+    return 0;
+}
+
+/** Drop the queued segments, waiting for the download in progress to stop. */
+static void prefetch_flush(struct variant *var)
+{
+    int i;
+
+    if (!var->jobs)
+        return;
+    pthread_mutex_lock(&var->mutex);
+    for (i = 0; i < var->n_jobs; i++)
+        var->jobs[i].cancel = 1;
+    while (var->fetching >= 0)
+        pthread_cond_wait(&var->cond, &var->mutex);
+    for (i = 0; i < var->n_jobs; i++) {
+        av_free(var->jobs[i].data);
+        memset(&var->jobs[i], 0, sizeof(var->jobs[i]));
+    }
+    var->first_job = var->nb_jobs = 0;
+    pthread_mutex_unlock(&var->mutex);
+}
+
+static void prefetch_close(struct variant *var)
+{
+    if (!var->jobs)
+        return;
+    prefetch_flush(var);
+    pthread_mutex_lock(&var->mutex);
+    var->fetch_abort = 1;
+    pthread_cond_broadcast(&var->cond);
+    pthread_mutex_unlock(&var->mutex);
+    pthread_join(var->fetch_thread, NULL);
+    pthread_mutex_destroy(&var->mutex);
+    pthread_cond_destroy(&var->cond);
+    av_freep(&var->jobs);
+}
+
+/** @return 1 if the segment cur_seq_no is queued first */
+static int prefetch_has_current(struct variant *var)
+{
+    return var->nb_jobs && var->jobs[var->first_job].seq_no == var->cur_seq_no;
+}
+
+/** Queue the segments from cur_seq_no on, which are in the playlist. */
+static void prefetch_queue(struct variant *var)
+{
+    int seq_no;
+
+    if (var->nb_jobs && !prefetch_has_current(var))
+        prefetch_flush(var);
+    pthread_mutex_lock(&var->mutex);
+    seq_no = var->cur_seq_no + var->nb_jobs;
+    while (var->nb_jobs < var->n_jobs && seq_no >= var->start_seq_no &&
+           seq_no < var->start_seq_no + var->n_segments) {
+        struct prefetch_job *job =
+            &var->jobs[(var->first_job + var->nb_jobs) % var->n_jobs];
+        job->seg    = *var->segments[seq_no - var->start_seq_no];
+        job->seq_no = seq_no++;
+        var->nb_jobs++;
+    }
+    pthread_cond_broadcast(&var->cond);
+    pthread_mutex_unlock(&var->mutex);
+}
+
+/**
+ * Read the segment queued first, waiting for it to be downloaded.
+ * @return AVERROR_EOF at its end
+ */
+static int prefetch_read(struct variant *var, uint8_t *buf, int buf_size)
+{
+    struct prefetch_job *job = &var->jobs[var->first_job];
+    int ret;
+
+    pthread_mutex_lock(&var->mutex);
+    while (job->read_pos == job->size && !job->done)
+        pthread_cond_wait(&var->cond, &var->mutex);
+    if (job->read_pos < job->size) {
+        ret = FFMIN(buf_size, job->size - job->read_pos);
+        memcpy(buf, job->data + job->read_pos, ret);
+        job->read_pos += ret;
+    } else {
+        ret = job->error ? job->error : AVERROR_EOF;
+    }
+    pthread_mutex_unlock(&var->mutex);
+    return ret;
+}
+
+/** Drop the segment queued first, once read, and measure its download. */
+static void prefetch_pop(struct variant *var)
+{
+    struct prefetch_job *job = &var->jobs[var->first_job];
+    AVFormatContext *s = var->parent;
+    char bitrate_str[20];
+    int i;
+
+    pthread_mutex_lock(&var->mutex);
+    if (job->fetch_time > 0)
+        var->download_bitrate = FFMIN(job->size * 8LL * 1000000 /
+                                      job->fetch_time, INT_MAX);
+    av_free(job->data);
+    memset(job, 0, sizeof(*job));
+    var->first_job = (var->first_job + 1) % var->n_jobs;
+    var->nb_jobs--;
+    pthread_mutex_unlock(&var->mutex);
+
+    /* exported for the variant selection by the caller */
+    snprintf(bitrate_str, sizeof(bitrate_str), "%d", var->download_bitrate);
+    if (var->ctx)
+        for (i = var->stream_offset;
+             i < var->stream_offset + var->ctx->nb_streams && i < s->nb_streams; i++)
+            av_dict_set(&s->streams[i]->metadata, "download_bitrate",
+                        bitrate_str, 0);
+}
+#else
+/* without threads, no segment is ever queued */
+static void prefetch_flush(struct variant *var) {}
+static void prefetch_close(struct variant *var) {}
+static int  prefetch_has_current(struct variant *var) { return 0; }
+static void prefetch_queue(struct variant *var) {}
+static int  prefetch_read(struct variant *var, uint8_t *buf, int buf_size)
+{
+    return AVERROR(ENOSYS);
+}
+static void prefetch_pop(struct variant *var) {}
+#endif
+
 static int read_data(void *opaque, uint8_t *buf, int buf_size)
 {
     struct variant *v = opaque;
     AppleHTTPContext *c = v->parent->priv_data;
-    int ret, i;
+    int ret, i, open;
 
 restart:
-    if (!v->input) {
+    open = v->jobs ? prefetch_has_current(v) : !!v->input;
+    if (!open) {
 reload:
         /* If this is a live stream and target_duration has elapsed since
          * the last playlist reload, reload the variant playlists now. */
@@ -395,17 +660,26 @@ reload:
             goto reload;
         }
 
-        ret = open_input(v);
-        if (ret < 0)
+        if (!v->jobs && (ret = open_input(v)) < 0)
             return ret;
     }
-    ret = ffurl_read(v->input, buf, buf_size);
+    if (v->jobs) {
+        /* keep the queue filled up as the segments are read */
+        prefetch_queue(v);
+        ret = prefetch_read(v, buf, buf_size);
+    } else {
+        ret = ffurl_read(v->input, buf, buf_size);
+    }
     if (ret > 0)
         return ret;
     if (ret < 0 && ret != AVERROR_EOF)
         return ret;
-    ffurl_close(v->input);
-    v->input = NULL;
+    if (v->jobs) {
+        prefetch_pop(v);
+    } else {
+        ffurl_close(v->input);
+        v->input = NULL;
+    }
     v->cur_seq_no++;
 
     c->end_of_segment = 1;
@@ -422,6 +696,7 @@ reload:
     if (!v->needed) {
         av_log(v->parent, AV_LOG_INFO, "No longer receiving variant %d\n",
                v->index);
+        prefetch_flush(v);
         return AVERROR_EOF;
     }
     goto restart;
@@ -488,6 +763,11 @@ static int applehttp_read_header(AVFormatContext *s, AVFormatParameters *ap)
         if (!v->finished && v->n_segments > 3)
             v->cur_seq_no = v->start_seq_no + v->n_segments - 3;
 
+#if HAVE_PTHREADS
+        if (c->prefetch > 0 && (ret = prefetch_open(v, c->prefetch)) < 0)
+            goto fail;
+#endif
+
         v->read_buffer = av_malloc(INITIAL_BUFFER_SIZE);
         ffio_init_context(&v->pb, v->read_buffer, INITIAL_BUFFER_SIZE, 0, v,
                           read_data, NULL, NULL);
@@ -552,6 +832,7 @@ static int recheck_discard_flags(AVFormatContext *s, int first)
             if (v->input)
                 ffurl_close(v->input);
             v->input = NULL;
+            prefetch_flush(v);
             v->needed = 0;
             changed = 1;
             av_log(s, AV_LOG_INFO, "No longer receiving variant %d\n", i);
@@ -635,6 +916,7 @@ static int applehttp_read_seek(AVFormatContext *s, int stream_index,
             ffurl_close(var->input);
             var->input = NULL;
         }
+        prefetch_flush(var);
         av_free_packet(&var->pkt);
         reset_packet(&var->pkt);
         var->pb.eof_reached = 0;
@@ -666,6 +948,19 @@ static int applehttp_probe(AVProbeData *p)
     return 0;
 }
 
+#define OFFSET(x) offsetof(AppleHTTPContext, x)
+static const AVOption options[] = {
+    {"prefetch", "number of segments downloaded ahead of the demuxer, in a background thread", OFFSET(prefetch), FF_OPT_TYPE_INT, {.dbl = 0}, 0, MAX_PREFETCH, AV_OPT_FLAG_DECODING_PARAM},
+    {NULL}
+};
+
+static const AVClass applehttp_class = {
+    .class_name = "applehttp demuxer",
+    .item_name  = av_default_item_name,
+    .option     = options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
 AVInputFormat ff_applehttp_demuxer = {
     "applehttp",
     NULL_IF_CONFIG_SMALL("Apple HTTP Live Streaming format"),
@@ -675,4 +970,5 @@ AVInputFormat ff_applehttp_demuxer = {
     applehttp_read_packet,
     applehttp_close,
     applehttp_read_seek,
+    .priv_class = &applehttp_class,
 };
@@ -1046,8 +1046,9 @@ static int ff_asf_parse_packet(AVFormatContext *s, AVIOContext *pb, AVPacket *pk
                     av_log(s, AV_LOG_ERROR, "pkt.size != ds_packet_size * ds_span (%d %d %d)\n", asf_st->pkt.size, asf_st->ds_packet_size, asf_st->ds_span);
               }else{
                 /* packet descrambling */
-                uint8_t *newdata = av_malloc(asf_st->pkt.size + FF_INPUT_BUFFER_PADDING_SIZE);
-                if (newdata) {
+                AVBufferRef *buf = av_buffer_alloc(asf_st->pkt.size + FF_INPUT_BUFFER_PADDING_SIZE);
+                if (buf) {
+                    uint8_t *newdata = buf->data;
                     int offset = 0;
                     memset(newdata + asf_st->pkt.size, 0, FF_INPUT_BUFFER_PADDING_SIZE);
                     while (offset < asf_st->pkt.size) {
@@ -1064,7 +1065,8 @@ static int ff_asf_parse_packet(AVFormatContext *s, AVIOContext *pb, AVPacket *pk
                                asf_st->ds_chunk_size);
                         offset += asf_st->ds_chunk_size;
                     }
-                    av_free(asf_st->pkt.data);
+                    av_buffer_unref(&asf_st->pkt.buf);
+                    asf_st->pkt.buf  = buf;
                     asf_st->pkt.data = newdata;
                 }
               }
@@ -0,0 +1,396 @@
+/*
+ * Asynchronous read-ahead and write-behind protocol
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Asynchronous read-ahead protocol: a thread reads the nested URL into a
+ * ring buffer ahead of the reader, so that the latency of the reads of
+ * network protocols does not stall the demuxer.
+ *
+ * Seeks to a position still in the ring are served from memory; any other
+ * seek is handed to the thread, which cancels the read-ahead once its
+ * current read returns, and restarts from the new position.
+ *
+ * When writing, the ring queues the data behind the muxer instead, and the
+ * thread writes it out in large chunks, so that the latency spikes of the
+ * storage do not stall the muxer until the ring is full. Seeks wait for
+ * the queued data to be written first.
+ */
+
+#include <pthread.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/opt.h"
+#include "avformat.h"
+#include "url.h"
+
+#define DEFAULT_BUFFER_SIZE (4 << 20)
+/** largest read of the nested URL, so that seeks are served quickly */
+#define READ_CHUNK_SIZE     65536
+/** largest write of the nested URL */
+#define WRITE_CHUNK_SIZE    (1 << 20)
+
+typedef struct {
+    const AVClass *class;
+    URLContext *inner;
+    int buffer_size;
+    int write;
+
+    uint8_t *ring;
+    /* the ring holds the bytes [ring_pos, fill_pos) of the file, the byte
+     * at pos being at ring[pos % buffer_size]; when writing, these are
+     * the bytes not written to the nested URL yet */
+    int64_t ring_pos;
+    int64_t fill_pos;
+    int64_t read_pos;
+    int eof;
+    int error;
+
+    /* seek request for the thread */
+    int seek_request;
+    int64_t seek_pos;
+    int seek_whence;
+    int64_t seek_ret;
+
+    int abort_request;
+    pthread_t thread;
+    int thread_started;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond_thread;     ///< signals the read-ahead thread
+    pthread_cond_t cond_reader;     ///< signals the reader
+} AsyncContext;
+
+#define OFFSET(x) offsetof(AsyncContext, x)
+static const AVOption options[] = {
+    {"buffer_size", "size of the read-ahead or write-behind buffer in bytes", OFFSET(buffer_size), FF_OPT_TYPE_INT, {.dbl = DEFAULT_BUFFER_SIZE}, 65536, INT_MAX / 2},
+    { NULL }
+};
+
+static const AVClass async_class = {
+    .class_name     = "async",
+    .item_name      = av_default_item_name,
+    .option         = options,
+    .version        = LIBAVUTIL_VERSION_INT,
+};
+
+static void do_seek(AsyncContext *c)
+{
+    int64_t ret;
+
+    pthread_mutex_unlock(&c->mutex);
+    ret = ffurl_seek(c->inner, c->seek_pos, c->seek_whence);
+    pthread_mutex_lock(&c->mutex);
+
+    if (ret >= 0 && c->seek_whence != AVSEEK_SIZE) {
+        c->ring_pos = c->fill_pos = c->read_pos = ret;
+        c->eof = 0;
+        /* a failed write is not undone by seeking */
+        if (!c->write)
+            c->error = 0;
+    }
+    c->seek_ret     = ret;
+    c->seek_request = 0;
+    pthread_cond_signal(&c->cond_reader);
+}
+
+/**
+ * Write the next chunk of the queued data.
+ * @return 0 if there was nothing to write
+ */
+static int write_chunk(AsyncContext *c)
+{
+    int offset, len, ret;
+
+    if (c->error || c->ring_pos == c->fill_pos)
+        return 0;
+    offset = c->ring_pos % c->buffer_size;
+    len    = FFMIN3(c->fill_pos - c->ring_pos, c->buffer_size - offset,
+                    WRITE_CHUNK_SIZE);
+
+    /* the writer only appends at fill_pos, so the chunk stays valid */
+    pthread_mutex_unlock(&c->mutex);
+    ret = ffurl_write(c->inner, c->ring + offset, len);
+    pthread_mutex_lock(&c->mutex);
+
+    if (ret < 0)
+        c->error = ret;
+    else
+        c->ring_pos += len;
+    pthread_cond_signal(&c->cond_reader);
+    return 1;
+}
+
+static void *async_thread(void *arg)
+{
+    AsyncContext *c = arg;
+
+    pthread_mutex_lock(&c->mutex);
+    while (!c->abort_request) {
+        int64_t keep_from, fill_pos;
+        int offset, len, ret;
+
+        /* queued data goes out before a seek */
+        if (c->write && write_chunk(c))
+            continue;
+        if (c->seek_request) {
+            do_seek(c);
+            continue;
+        }
+        if (c->write) {
+            pthread_cond_wait(&c->cond_thread, &c->mutex);
+            continue;
+        }
+        /* keep a quarter of the ring behind the reader for short backward
+         * seeks */
+        keep_from = FFMAX(c->ring_pos, c->read_pos - c->buffer_size / 4);
+        len = c->buffer_size - (c->fill_pos - keep_from);
+        if (c->eof || c->error || len <= 0) {
+            pthread_cond_wait(&c->cond_thread, &c->mutex);
+            continue;
+        }
+        fill_pos = c->fill_pos;
+        offset   = fill_pos % c->buffer_size;
+        len      = FFMIN3(len, c->buffer_size - offset, READ_CHUNK_SIZE);
+        /* drop the bytes which are about to be overwritten before reading,
+         * so that the reader cannot seek back into them meanwhile */
+        c->ring_pos = FFMAX(c->ring_pos, fill_pos + len - c->buffer_size);
+
+        pthread_mutex_unlock(&c->mutex);
+        ret = ffurl_read(c->inner, c->ring + offset, len);
+        pthread_mutex_lock(&c->mutex);
+
+        /* a seek may have restarted the ring while we were reading */
+        if (c->fill_pos != fill_pos || c->seek_request)
+            continue;
+        if (ret > 0)
+            c->fill_pos += ret;
+        else if (ret == 0 || ret == AVERROR_EOF)
+            c->eof = 1;
+        else
+            c->error = ret;
+        pthread_cond_signal(&c->cond_reader);
+    }
+    pthread_mutex_unlock(&c->mutex);
+    return NULL;
+}
+
+static int async_open(URLContext *h, const char *arg, int flags)
+{
+    AsyncContext *c = h->priv_data;
+    int own_inner = !c->inner;
+    int ret;
+
+    if ((flags & AVIO_FLAG_READ_WRITE) == AVIO_FLAG_READ_WRITE)
+        return AVERROR(ENOSYS);
+    c->write = !!(flags & AVIO_FLAG_WRITE);
+    av_strstart(arg, "async:", &arg);
+    if (own_inner && (ret = ffurl_open(&c->inner, arg, flags)) < 0)
+        return ret;
+    if (c->inner->max_packet_size) {
+        av_log(h, AV_LOG_ERROR, "Packetized protocols are not supported\n");
+        ret = AVERROR(ENOSYS);
+        goto fail;
+    }
+    h->is_streamed = c->inner->is_streamed;
+
+    c->ring = av_malloc(c->buffer_size);
+    if (!c->ring) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    c->ring_pos = c->fill_pos = c->read_pos = ffurl_seek(c->inner, 0, SEEK_CUR);
+    if (c->read_pos < 0)
+        c->ring_pos = c->fill_pos = c->read_pos = 0;
+
+    pthread_mutex_init(&c->mutex, NULL);
+    pthread_cond_init(&c->cond_thread, NULL);
+    pthread_cond_init(&c->cond_reader, NULL);
+    if (pthread_create(&c->thread, NULL, async_thread, c)) {
+        av_log(h, AV_LOG_ERROR, "Could not create the I/O thread\n");
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    c->thread_started = 1;
+    return 0;
+fail:
+    if (c->ring) {
+        pthread_mutex_destroy(&c->mutex);
+        pthread_cond_destroy(&c->cond_thread);
+        pthread_cond_destroy(&c->cond_reader);
+    }
+    av_freep(&c->ring);
+    /* an inner context given by ff_async_open() stays with the caller */
+    if (own_inner)
+        ffurl_close(c->inner);
+    c->inner = NULL;
+    return ret;
+}
+
+static int async_read(URLContext *h, unsigned char *buf, int size)
+{
+    AsyncContext *c = h->priv_data;
+    int ret, done = 0;
+
+    pthread_mutex_lock(&c->mutex);
+    while (c->read_pos == c->fill_pos && !c->eof && !c->error)
+        pthread_cond_wait(&c->cond_reader, &c->mutex);
+    while (done < size && c->read_pos < c->fill_pos) {
+        int offset = c->read_pos % c->buffer_size;
+        int len    = FFMIN3(size - done, c->fill_pos - c->read_pos,
+                            c->buffer_size - offset);
+        memcpy(buf + done, c->ring + offset, len);
+        c->read_pos += len;
+        done        += len;
+    }
+    ret = done ? done : c->error ? c->error : 0;
+    pthread_cond_signal(&c->cond_thread);
+    pthread_mutex_unlock(&c->mutex);
+    return ret;
+}
+
+static int async_write(URLContext *h, const unsigned char *buf, int size)
+{
+    AsyncContext *c = h->priv_data;
+    int done = 0, ret;
+
+    pthread_mutex_lock(&c->mutex);
+    while (done < size && !c->error) {
+        int space  = c->buffer_size - (c->fill_pos - c->ring_pos);
+        int offset = c->fill_pos % c->buffer_size;
+        int len    = FFMIN3(size - done, space, c->buffer_size - offset);
+        if (len <= 0) {
+            pthread_cond_wait(&c->cond_reader, &c->mutex);
+            continue;
+        }
+        memcpy(c->ring + offset, buf + done, len);
+        c->fill_pos += len;
+        c->read_pos  = c->fill_pos;
+        done        += len;
+        pthread_cond_signal(&c->cond_thread);
+    }
+    /* a write error of the thread is reported by the next write */
+    ret = c->error ? c->error : size;
+    pthread_mutex_unlock(&c->mutex);
+    return ret;
+}
+
+static int64_t async_seek(URLContext *h, int64_t pos, int whence)
+{
+    AsyncContext *c = h->priv_data;
+    int64_t ret;
+
+    pthread_mutex_lock(&c->mutex);
+    if (whence == SEEK_CUR) {
+        pos   += c->read_pos;
+        whence = SEEK_SET;
+    }
+    if (!c->write && whence == SEEK_SET && pos >= c->ring_pos && pos <= c->fill_pos) {
+        c->read_pos = pos;
+        pthread_cond_signal(&c->cond_thread);
+        pthread_mutex_unlock(&c->mutex);
+        return pos;
+    }
+    if (whence == SEEK_SET && h->is_streamed) {
+        pthread_mutex_unlock(&c->mutex);
+        return AVERROR(EPIPE);
+    }
+
+    c->seek_request = 1;
+    c->seek_pos     = pos;
+    c->seek_whence  = whence;
+    pthread_cond_signal(&c->cond_thread);
+    while (c->seek_request)
+        pthread_cond_wait(&c->cond_reader, &c->mutex);
+    ret = c->seek_ret;
+    pthread_mutex_unlock(&c->mutex);
+    return ret;
+}
+
+static int async_close(URLContext *h)
+{
+    AsyncContext *c = h->priv_data;
+
+    if (c->thread_started) {
+        pthread_mutex_lock(&c->mutex);
+        while (c->write && c->ring_pos < c->fill_pos && !c->error)
+            pthread_cond_wait(&c->cond_reader, &c->mutex);
+        if (c->error)
+            av_log(h, AV_LOG_ERROR, "Writing the queued data failed\n");
+        c->abort_request = 1;
+        pthread_cond_signal(&c->cond_thread);
+        pthread_mutex_unlock(&c->mutex);
+        pthread_join(c->thread, NULL);
+
+        pthread_mutex_destroy(&c->mutex);
+        pthread_cond_destroy(&c->cond_thread);
+        pthread_cond_destroy(&c->cond_reader);
+    }
+    av_freep(&c->ring);
+    if (c->inner)
+        ffurl_close(c->inner);
+    return 0;
+}
+
+static int async_get_file_handle(URLContext *h)
+{
+    AsyncContext *c = h->priv_data;
+    return ffurl_get_file_handle(c->inner);
+}
+
+URLProtocol ff_async_protocol = {
+    .name                = "async",
+    .url_open            = async_open,
+    .url_read            = async_read,
+    .url_write           = async_write,
+    .url_seek            = async_seek,
+    .url_close           = async_close,
+    .url_get_file_handle = async_get_file_handle,
+    .priv_data_size      = sizeof(AsyncContext),
+    .priv_data_class     = &async_class,
+    .flags               = URL_PROTOCOL_FLAG_NESTED_SCHEME,
+};
+
+int ff_async_open(URLContext **puc, URLContext *inner, int buffer_size)
+{
+    URLContext *h;
+    AsyncContext *c;
+    char *url;
+    int ret;
+
+    if (!(url = av_malloc(strlen(inner->filename) + 7)))
+        return AVERROR(ENOMEM);
+    strcpy(url, "async:");
+    strcpy(url + 6, inner->filename);
+    ret = ffurl_alloc(&h, url, inner->flags);
+    av_free(url);
+    if (ret < 0)
+        return ret;
+
+    c = h->priv_data;
+    c->inner = inner;
+    if (buffer_size > 0)
+        c->buffer_size = FFMAX(buffer_size, READ_CHUNK_SIZE);
+    if ((ret = ffurl_connect(h)) < 0) {
+        ffurl_close(h);
+        return ret;
+    }
+    *puc = h;
+    return 0;
+}
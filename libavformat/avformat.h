@@ -181,6 +181,9 @@ attribute_deprecated void av_metadata_free(AVDictionary **m);
 /**
  * Allocate and read the payload of a packet and initialize its
  * fields with default values.
+ * With AVFMT_FLAG_ZEROCOPY, the payload may be a reference to the
+ * buffer of s instead; it must then be made writable with
+ * av_packet_make_writable() before being modified.
  *
  * @param pkt packet
  * @param size desired payload size
@@ -595,7 +598,7 @@ typedef struct AVStream {
     int probe_packets;
 
     /**
-     * last packet in packet_buffer for this stream when muxing.
+     * last packet queued for interleaving for this stream when muxing.
      * used internally, NOT PART OF PUBLIC API, dont read or write from outside of libav*
      */
     struct AVPacketList *last_in_packet_buffer;
@@ -634,6 +637,13 @@ typedef struct AVStream {
      * NOT PART OF PUBLIC API
      */
     int request_probe;
+
+    /**
+     * first packet queued for interleaving for this stream when muxing,
+     * the queue ends with last_in_packet_buffer.
+     * NOT PART OF PUBLIC API
+     */
+    struct AVPacketList *first_in_packet_buffer;
 } AVStream;
 
 #define AV_PROGRAM_RUNNING 1
@@ -756,6 +766,10 @@ typedef struct AVFormatContext {
 #define AVFMT_FLAG_SORT_DTS    0x10000 ///< try to interleave outputted packets by dts (using this flag can slow demuxing down)
 #define AVFMT_FLAG_PRIV_OPT    0x20000 ///< Enable use of private options by delaying codec open (this could be made default once all code is converted)
 #define AVFMT_FLAG_KEEP_SIDE_DATA 0x40000 ///< Dont merge side data but keep it seperate.
+#define AVFMT_FLAG_MMAP        0x80000 ///< Read local input files through a memory mapping, see AVIO_FLAG_MMAP.
+#define AVFMT_FLAG_DIRECT     0x100000 ///< Write local output files bypassing the page cache, see AVIO_FLAG_DIRECT.
+#define AVFMT_FLAG_ZEROCOPY   0x200000 ///< Let the demuxers supporting it return packets referencing the I/O buffer instead of copies
+#define AVFMT_FLAG_FAST_INFO  0x400000 ///< Make av_find_stream_info() return as soon as the codec parameters of all streams are known, see av_find_stream_info().
 
     int loop_input;
 
@@ -860,6 +874,64 @@ typedef struct AVFormatContext {
      * This will be moved into demuxer private options. Thus no API/ABI compatibility
      */
     int ts_id;
+
+    /**
+     * Size in bytes of the buffer read ahead of the demuxer, or written
+     * behind the muxer, by a background thread, 0 for synchronous I/O.
+     * When muxing, it is applied to pb by avformat_write_header().
+     * - encoding: Set by user.
+     * - decoding: Set by user.
+     */
+    int async_buffer_size;
+
+    /**
+     * Number of streams with packets queued for interleaving when muxing,
+     * which is also the number of entries of interleave_heap.
+     * NOT PART OF PUBLIC API
+     */
+    int nb_interleaved_streams;
+
+    /**
+     * Maximum difference, in AV_TIME_BASE units, between the dts of the
+     * first and of the last packets queued for interleaving. Above it,
+     * packets are output without waiting for the streams that have none
+     * queued, so that a sparse stream does not hold the others back.
+     * 0 means no limit.
+     * - encoding: Set by user.
+     * - decoding: Unused.
+     */
+    int64_t max_interleave_delta;
+
+    /**
+     * URL of a file caching the index entries of the streams, loaded when
+     * the input is opened and after av_find_stream_info(), and updated
+     * when it is closed if new entries were found. Only used for seekable
+     * inputs, the cache is ignored if the input file changed.
+     * - encoding: Unused.
+     * - decoding: Set by user.
+     */
+    char *index_cache;
+
+    /**
+     * Number of streams and of index entries when the index cache was
+     * last loaded.
+     * NOT PART OF PUBLIC API
+     */
+    int index_cache_streams;
+    int index_cache_entries;
+
+    /**
+     * Interleaving queue when muxing: the packets of each stream are
+     * queued in AVStream.first_in_packet_buffer, and interleave_heap is a
+     * min-heap of the indices of the streams with queued packets, ordered
+     * by their first packet with interleave_compare().
+     * NOT PART OF PUBLIC API
+     */
+    int *interleave_heap;
+    int interleave_heap_size;           ///< allocated entries of interleave_heap
+    int (*interleave_compare)(struct AVFormatContext *, AVPacket *, AVPacket *);
+    struct AVPacketList *interleave_free_nodes; ///< list nodes kept for reuse
+    int64_t interleave_max_dts;         ///< largest queued dts in AV_TIME_BASE units, AV_NOPTS_VALUE if none is known
 } AVFormatContext;
 
 typedef struct AVPacketList {
@@ -1153,10 +1225,17 @@ int avformat_alloc_output_context2(AVFormatContext **ctx, AVOutputFormat *oforma
  * The logical file position is not changed by this function;
  * examined packets may be buffered for later processing.
  *
+ * Streams whose discard field is set to AVDISCARD_ALL before the call are
+ * not waited for and their packets are not decoded, so callers can limit
+ * probing to the streams they actually use.
+ *
+ * With AVFMT_FLAG_FAST_INFO set, probing stops as soon as the codec
+ * parameters of all other streams are known, without analyzing more frames
+ * to guess the frame rate. For formats without a header this also means
+ * that streams announced later in the file may be missed.
+ *
  * @param ic media file handle
  * @return >=0 if OK, AVERROR_xxx on error
- * @todo Let the user decide somehow what information is needed so that
- *       we do not waste time getting stuff the user does not need.
  */
 int av_find_stream_info(AVFormatContext *ic);
 
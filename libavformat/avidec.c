@@ -25,6 +25,7 @@
 #include "libavutil/opt.h"
 #include "libavutil/dict.h"
 #include "avformat.h"
+#include "avio_internal.h"
 #include "avi.h"
 #include "dv.h"
 #include "riff.h"
@@ -32,6 +33,16 @@
 #undef NDEBUG
 #include <assert.h>
 
+/**
+ * A standard index chunk listed in an OpenDML super index, read only once
+ * the timestamps it covers are needed.
+ */
+typedef struct AVIIndexChunk {
+    int64_t pos;        ///< position of the ix## chunk
+    int64_t start, end; ///< index timestamps covered, from the super index durations
+    int loaded;
+} AVIIndexChunk;
+
 typedef struct AVIStream {
     int64_t frame_offset; /* current frame (video) or byte (audio) counter
                          (used to compute the pts) */
@@ -55,6 +66,10 @@ typedef struct AVIStream {
     uint8_t *sub_buffer;
 
     int64_t seek_pos;
+
+    AVIIndexChunk *odml_chunks;
+    int nb_odml_chunks;
+    int odml_pending;                 ///< number of odml_chunks not loaded yet
 } AVIStream;
 
 typedef struct {
@@ -99,6 +114,7 @@ static const char avi_headers[][8] = {
 
 static int avi_load_index(AVFormatContext *s);
 static int guess_ni_flag(AVFormatContext *s);
+static void avi_load_odml_chunk(AVFormatContext *s, AVStream *st, int n);
 
 #define print_tag(str, tag, size)                       \
     av_dlog(NULL, "%s: tag=%c%c%c%c size=0x%x\n",       \
@@ -156,6 +172,7 @@ static int read_braindead_odml_indx(AVFormatContext *s, int frame_num){
     int i;
     int64_t last_pos= -1;
     int64_t filesize= avio_size(s->pb);
+    unsigned int size_chunks = 0;
 
     av_dlog(s, "longs_pre_entry:%d index_type:%d entries_in_use:%d chunk_id:%X base:%16"PRIX64"\n",
             longs_pre_entry,index_type, entries_in_use, chunk_id, base);
@@ -213,6 +230,25 @@ static int read_braindead_odml_indx(AVFormatContext *s, int frame_num){
             if(url_feof(pb))
                 return -1;
 
+            /* Standard indexes of streams with one index unit per chunk
+             * are only read when their time range is needed, their start
+             * timestamps follow from the super index durations. */
+            if(!avi->odml_depth && !ast->sample_size && !ast->dshow_block_align){
+                AVIIndexChunk *c = av_fast_realloc(ast->odml_chunks, &size_chunks,
+                                                   (ast->nb_odml_chunks + 1) * sizeof(*c));
+                if(!c)
+                    return AVERROR(ENOMEM);
+                ast->odml_chunks = c;
+                c += ast->nb_odml_chunks++;
+                c->pos    = offset;
+                c->start  = frame_num;
+                c->end    = frame_num + duration;
+                c->loaded = 0;
+                ast->odml_pending++;
+                frame_num += duration;
+                continue;
+            }
+
             pos = avio_tell(pb);
 
             if(avi->odml_depth > MAX_ODML_DEPTH){
@@ -233,6 +269,108 @@ static int read_braindead_odml_indx(AVFormatContext *s, int frame_num){
     return 0;
 }
 
+static void read_odml_chunk(AVFormatContext *s, AVStream *st, AVIIndexChunk *c)
+{
+    AVIContext *avi = s->priv_data;
+    AVIStream *ast = st->priv_data;
+    int64_t pos = avio_tell(s->pb);
+    int non_interleaved = avi->non_interleaved;
+
+    ast->cum_len = c->start;
+    if (avio_seek(s->pb, c->pos + 8, SEEK_SET) >= 0) {
+        avi->odml_depth++;
+        read_braindead_odml_indx(s, c->start);
+        avi->odml_depth--;
+    }
+    c->end    = ast->cum_len;
+    c->loaded = 1;
+    /* the interleaving mode was chosen from the header, do not switch it
+     * in the middle of the stream */
+    avi->non_interleaved = non_interleaved;
+    avio_seek(s->pb, pos, SEEK_SET);
+}
+
+static void avi_load_odml_chunk(AVFormatContext *s, AVStream *st, int n)
+{
+    AVIStream *ast = st->priv_data;
+    AVIIndexChunk *c = &ast->odml_chunks[n];
+    int64_t end = c->end;
+    int i;
+
+    if (c->loaded)
+        return;
+    read_odml_chunk(s, st, c);
+    ast->odml_pending--;
+    if (c->end == end)
+        return;
+
+    /* The super index durations do not match the entries, so the start of
+     * each chunk is only known after reading all preceding ones. */
+    av_log(s, AV_LOG_WARNING, "ODML super index durations are inconsistent, "
+                              "loading the complete index\n");
+    av_freep(&st->index_entries);
+    st->nb_index_entries = st->index_entries_allocated_size = 0;
+    for (i = 0; i < ast->nb_odml_chunks; i++) {
+        ast->odml_chunks[i].start = i ? ast->odml_chunks[i - 1].end : 0;
+        read_odml_chunk(s, st, &ast->odml_chunks[i]);
+    }
+    ast->odml_pending = 0;
+}
+
+static void avi_load_odml_index(AVFormatContext *s, AVStream *st)
+{
+    AVIStream *ast = st->priv_data;
+    int i;
+
+    for (i = 0; i < ast->nb_odml_chunks && ast->odml_pending; i++)
+        avi_load_odml_chunk(s, st, i);
+}
+
+/**
+ * Look up an index entry like av_index_search_timestamp(), first loading
+ * every deferred index chunk between the timestamp and the entry found.
+ */
+static int avi_index_search(AVFormatContext *s, AVStream *st,
+                            int64_t timestamp, int flags)
+{
+    AVIStream *ast = st->priv_data;
+
+    for (;;) {
+        int index = av_index_search_timestamp(st, timestamp, flags);
+        int64_t lo, hi, dist, best_dist = INT64_MAX;
+        int i, best = -1;
+
+        if (!ast->odml_pending)
+            return index;
+
+        if (index >= 0) {
+            lo = FFMIN(timestamp, st->index_entries[index].timestamp);
+            hi = FFMAX(timestamp, st->index_entries[index].timestamp);
+        } else if (flags & AVSEEK_FLAG_BACKWARD) {
+            lo = INT64_MIN;
+            hi = timestamp;
+        } else {
+            lo = timestamp;
+            hi = INT64_MAX;
+        }
+        /* load the pending chunk closest to the timestamp and retry */
+        for (i = 0; i < ast->nb_odml_chunks; i++) {
+            AVIIndexChunk *c = &ast->odml_chunks[i];
+            if (c->loaded || c->end <= lo || c->start > hi)
+                continue;
+            dist = c->start > timestamp ? c->start - timestamp :
+                   c->end  <= timestamp ? timestamp - c->end + 1 : 0;
+            if (dist < best_dist) {
+                best_dist = dist;
+                best      = i;
+            }
+        }
+        if (best < 0)
+            return index;
+        avi_load_odml_chunk(s, st, best);
+    }
+}
+
 static void clean_index(AVFormatContext *s){
     int i;
     int64_t j;
@@ -362,6 +500,9 @@ static int avi_read_header(AVFormatContext *s, AVFormatParameters *ap)
     uint64_t list_end = 0;
     int ret;
 
+    if (s->flags & AVFMT_FLAG_ZEROCOPY)
+        ffio_enable_lending(pb);
+
     avi->stream_index= -1;
 
     if (get_riff(s, pb) < 0)
@@ -746,6 +887,14 @@ static int avi_read_header(AVFormatContext *s, AVFormatParameters *ap)
     if(!avi->index_loaded && pb->seekable)
         avi_load_index(s);
     avi->index_loaded = 1;
+    /* the interleaving check needs the first and last index entries */
+    for(i=0; i<s->nb_streams; i++){
+        AVIStream *ast = s->streams[i]->priv_data;
+        if(ast->nb_odml_chunks){
+            avi_load_odml_chunk(s, s->streams[i], 0);
+            avi_load_odml_chunk(s, s->streams[i], ast->nb_odml_chunks - 1);
+        }
+    }
     avi->non_interleaved |= guess_ni_flag(s) | (s->flags & AVFMT_FLAG_SORT_DTS);
     for(i=0; i<s->nb_streams; i++){
         AVStream *st = s->streams[i];
@@ -763,6 +912,8 @@ static int avi_read_header(AVFormatContext *s, AVFormatParameters *ap)
 
     if(avi->non_interleaved) {
         av_log(s, AV_LOG_INFO, "non-interleaved AVI\n");
+        for(i=0; i<s->nb_streams; i++)
+            avi_load_odml_index(s, s->streams[i]);
         clean_index(s);
     }
 
@@ -970,10 +1121,12 @@ resync:
         }
 
         if (CONFIG_DV_DEMUXER && avi->dv_demux) {
+            AVBufferRef *dbuf = pkt->buf;
             dstr = pkt->destruct;
             size = dv_produce_packet(avi->dv_demux, pkt,
                                     pkt->data, pkt->size, pkt->pos);
             pkt->destruct = dstr;
+            pkt->buf      = dbuf;
             pkt->flags |= AV_PKT_FLAG_KEY;
             if (size < 0)
                 av_free_packet(pkt);
@@ -997,7 +1150,7 @@ resync:
                 int index;
                 assert(st->index_entries);
 
-                index= av_index_search_timestamp(st, ast->frame_offset, 0);
+                index= avi_index_search(s, st, ast->frame_offset, AVSEEK_FLAG_ANY);
                 e= &st->index_entries[index];
 
                 if(index >= 0 && e->timestamp == ast->frame_offset){
@@ -1309,7 +1462,7 @@ static int avi_read_seek(AVFormatContext *s, int stream_index, int64_t timestamp
 
     st = s->streams[stream_index];
     ast= st->priv_data;
-    index= av_index_search_timestamp(st, timestamp * FFMAX(ast->sample_size, 1), flags);
+    index= avi_index_search(s, st, timestamp * FFMAX(ast->sample_size, 1), flags);
     if(index<0)
         return -1;
 
@@ -1352,7 +1505,7 @@ static int avi_read_seek(AVFormatContext *s, int stream_index, int64_t timestamp
 
 //        assert(st2->codec->block_align);
         assert((int64_t)st2->time_base.num*ast2->rate == (int64_t)st2->time_base.den*ast2->scale);
-        index = av_index_search_timestamp(
+        index = avi_index_search(s,
                 st2,
                 av_rescale_q(timestamp, st->time_base, st2->time_base) * FFMAX(ast2->sample_size, 1),
                 flags | AVSEEK_FLAG_BACKWARD | (st2->codec->codec_type != AVMEDIA_TYPE_VIDEO ? AVSEEK_FLAG_ANY : 0));
@@ -1374,8 +1527,19 @@ static int avi_read_seek(AVFormatContext *s, int stream_index, int64_t timestamp
                 flags | AVSEEK_FLAG_BACKWARD | (st2->codec->codec_type != AVMEDIA_TYPE_VIDEO ? AVSEEK_FLAG_ANY : 0));
         if(index<0)
             index=0;
-        while(index>0 && st2->index_entries[index-1].pos >= pos_min)
-            index--;
+        for(;;){
+            int64_t ts;
+            while(index>0 && st2->index_entries[index-1].pos >= pos_min)
+                index--;
+            if(!ast2->odml_pending)
+                break;
+            /* the entry before may still be in a chunk that is not loaded */
+            ts = st2->index_entries[index].timestamp;
+            avi_index_search(s, st2, ts - 1, AVSEEK_FLAG_ANY | AVSEEK_FLAG_BACKWARD);
+            index = av_index_search_timestamp(st2, ts, AVSEEK_FLAG_ANY);
+            if(index<=0 || st2->index_entries[index-1].pos < pos_min)
+                break;
+        }
         ast2->frame_offset = st2->index_entries[index].timestamp;
     }
 
@@ -1400,6 +1564,7 @@ static int avi_read_close(AVFormatContext *s)
             }
             av_free(ast->sub_buffer);
             av_free_packet(&ast->sub_pkt);
+            av_freep(&ast->odml_chunks);
         }
     }
 
@@ -87,6 +87,11 @@ typedef struct {
      * A combination of AVIO_SEEKABLE_ flags or 0 when the stream is not seekable.
      */
     int seekable;
+    /**
+     * Reference to buffer while packets may borrow data from it, NULL
+     * otherwise. Set by libavformat, see AVFMT_FLAG_ZEROCOPY.
+     */
+    struct AVBufferRef *buffer_ref;
 } AVIOContext;
 
 /* unbuffered I/O */
@@ -541,6 +546,22 @@ int avio_get_str16be(AVIOContext *pb, int maxlen, char *buf, int buflen);
  */
 #define AVIO_FLAG_NONBLOCK 8
 
+/**
+ * Read through a memory mapping of the resource, instead of copying it
+ * with a system call per read. Supported by the file protocol for regular
+ * files, ignored otherwise.
+ * Data appended to the file after it was opened is not seen.
+ */
+#define AVIO_FLAG_MMAP 16
+
+/**
+ * Write with O_DIRECT, bypassing the page cache, through an aligned
+ * buffer. Supported by the file protocol for files opened write-only,
+ * ignored otherwise. Once the file is seeked, writes go through the page
+ * cache again.
+ */
+#define AVIO_FLAG_DIRECT 32
+
 /**
  * Create and initialize a AVIOContext for accessing the
  * resource indicated by url.
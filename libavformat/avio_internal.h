@@ -41,6 +41,48 @@ int ffio_init_context(AVIOContext *s,
  */
 int ffio_read_partial(AVIOContext *s, unsigned char *buf, int size);
 
+/**
+ * Read size bytes from AVIOContext, returning a pointer to them.
+ * The bytes are only copied into buf if they are not contiguous in the
+ * buffer of the AVIOContext.
+ * @note the data pointed at by *data is only valid until the next call
+ *       accessing s
+ * @return number of bytes read or AVERROR
+ */
+int ffio_read_indirect(AVIOContext *s, unsigned char *buf, int size,
+                       const unsigned char **data);
+
+/**
+ * Skip the bytes before the next occurrence of c within the next
+ * max_size bytes of s, leaving s positioned on it.
+ * @return number of bytes skipped, AVERROR_INVALIDDATA if c was not
+ *         found, or another negative AVERROR on EOF or error
+ */
+int ffio_skip_to_byte(AVIOContext *s, int c, int max_size);
+
+/**
+ * Let packets borrow data from the buffer of s with ffio_lend(). The
+ * buffer is reference-counted from then on, and replaced by a new one
+ * when it needs refilling while data in it is still referenced.
+ * @return 0 on success, a negative AVERROR on failure
+ */
+int ffio_enable_lending(AVIOContext *s);
+
+/**
+ * Read up to size bytes from s without copying them, by taking a
+ * reference to the buffer of s. The buffer is refilled first if it is
+ * empty. Only data ending the buffered data is lent, so that it is
+ * followed by FF_INPUT_BUFFER_PADDING_SIZE zeroed bytes.
+ * @param partial if 0, nothing is read unless exactly size bytes are
+ *                left in the buffer
+ * @param buf     set to the new reference to the buffer holding the data
+ * @param data    set to the data
+ * @return number of bytes read, 0 if nothing could be lent, in which case
+ *         the data must be read with avio_read(), or a negative AVERROR
+ */
+int ffio_lend(AVIOContext *s, int size, int partial,
+              struct AVBufferRef **buf, uint8_t **data);
+
 void ffio_fill(AVIOContext *s, int b, int count);
 
 static av_always_inline void ffio_wfourcc(AVIOContext *pb, const uint8_t *s)
@@ -67,6 +109,17 @@ uint64_t ffio_read_varlen(AVIOContext *bc);
 /** @warning must be called before any I/O */
 int ffio_set_buf_size(AVIOContext *s, int buf_size);
 
+/**
+ * Read the URLContext of s, opened with ffio_fdopen(), ahead in a
+ * background thread, into a buffer of buffer_size bytes. For a context
+ * opened for writing, the data is queued in the buffer and written behind
+ * by the thread instead.
+ * @warning must be called before any I/O when reading
+ * @return 0 on success, AVERROR(ENOSYS) if not supported by s or by the
+ *         build
+ */
+int ffio_enable_async(AVIOContext *s, int buffer_size);
+
 void ffio_init_checksum(AVIOContext *s,
                         unsigned long (*update_checksum)(unsigned long c, const uint8_t *p, unsigned int len),
                         unsigned long checksum);
@@ -19,6 +19,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include "libavutil/buffer.h"
 #include "libavutil/crc.h"
 #include "libavutil/intreadwrite.h"
 #include "avformat.h"
@@ -40,6 +41,18 @@
 static void fill_buffer(AVIOContext *s);
 static int url_resetbuf(AVIOContext *s, int flags);
 
+/**
+ * Free the buffer, through its reference if it is lent.
+ */
+static void free_buffer(AVIOContext *s)
+{
+    if (s->buffer_ref)
+        av_buffer_unref(&s->buffer_ref);
+    else
+        av_free(s->buffer);
+    s->buffer = NULL;
+}
+
 int ffio_init_context(AVIOContext *s,
                   unsigned char *buffer,
                   int buffer_size,
@@ -542,7 +555,9 @@ void put_tag(AVIOContext *s, const char *tag)
 
 static void fill_buffer(AVIOContext *s)
 {
-    uint8_t *dst= !s->max_packet_size && s->buf_end - s->buffer < s->buffer_size ? s->buf_end : s->buffer;
+    /* data lent to packets must not change, so a shared buffer is replaced */
+    int shared = s->buffer_ref && !av_buffer_is_writable(s->buffer_ref);
+    uint8_t *dst= !s->max_packet_size && s->buf_end - s->buffer < s->buffer_size && !shared ? s->buf_end : s->buffer;
     int len= s->buffer_size - (dst - s->buffer);
     int max_buffer_size = s->max_packet_size ? s->max_packet_size : IO_BUFFER_SIZE;
 
@@ -562,6 +577,13 @@ static void fill_buffer(AVIOContext *s)
 
         s->checksum_ptr = dst = s->buffer;
         len = s->buffer_size;
+    } else if (shared) {
+        if (ffio_set_buf_size(s, s->buffer_size) < 0) {
+            s->eof_reached = 1;
+            s->error = AVERROR(ENOMEM);
+            return;
+        }
+        s->checksum_ptr = dst = s->buffer;
     }
 
     if(s->read_packet)
@@ -578,6 +600,8 @@ static void fill_buffer(AVIOContext *s)
         s->pos += len;
         s->buf_ptr = dst;
         s->buf_end = dst + len;
+        if (s->buffer_ref)
+            memset(s->buf_end, 0, FF_INPUT_BUFFER_PADDING_SIZE);
     }
 }
 
@@ -673,6 +697,64 @@ int avio_read(AVIOContext *s, unsigned char *buf, int size)
     return size1 - size;
 }
 
+int ffio_read_indirect(AVIOContext *s, unsigned char *buf, int size,
+                       const unsigned char **data)
+{
+    if (s->buf_end - s->buf_ptr >= size && !s->write_flag) {
+        *data = s->buf_ptr;
+        s->buf_ptr += size;
+        return size;
+    }
+    *data = buf;
+    return avio_read(s, buf, size);
+}
+
+int ffio_lend(AVIOContext *s, int size, int partial,
+              AVBufferRef **buf, uint8_t **data)
+{
+    int len;
+
+    if (!s->buffer_ref || s->write_flag || size <= 0)
+        return 0;
+    /* larger reads bypass the buffer, see avio_read() */
+    if (s->buf_ptr == s->buf_end && size <= s->buffer_size)
+        fill_buffer(s);
+    len = s->buf_end - s->buf_ptr;
+    /* only the padding after the buffered data is zeroed, data followed
+     * by more buffered data would not be padded */
+    if (!len || len > size || (len < size && !partial))
+        return 0;
+    if (!(*buf = av_buffer_ref(s->buffer_ref)))
+        return AVERROR(ENOMEM);
+    *data = s->buf_ptr;
+    s->buf_ptr += len;
+    return len;
+}
+
+int ffio_skip_to_byte(AVIOContext *s, int c, int max_size)
+{
+    int skipped = 0;
+    uint8_t *p;
+
+    while (skipped < max_size) {
+        int len;
+        if (s->buf_ptr == s->buf_end) {
+            fill_buffer(s);
+            if (s->buf_ptr == s->buf_end)
+                return s->error ? s->error : AVERROR_EOF;
+        }
+        len = FFMIN(s->buf_end - s->buf_ptr, max_size - skipped);
+        if ((p = memchr(s->buf_ptr, c, len))) {
+            skipped += p - s->buf_ptr;
+            s->buf_ptr = p;
+            return skipped;
+        }
+        s->buf_ptr += len;
+        skipped    += len;
+    }
+    return AVERROR_INVALIDDATA;
+}
+
 int ffio_read_partial(AVIOContext *s, unsigned char *buf, int size)
 {
     int len;
@@ -874,19 +956,71 @@ int ffio_fdopen(AVIOContext **s, URLContext *h)
 
 int ffio_set_buf_size(AVIOContext *s, int buf_size)
 {
+    AVBufferRef *ref = NULL;
     uint8_t *buffer;
-    buffer = av_malloc(buf_size);
-    if (!buffer)
+
+    if (s->buffer_ref) {
+        if (!(ref = av_buffer_alloc(buf_size + FF_INPUT_BUFFER_PADDING_SIZE)))
+            return AVERROR(ENOMEM);
+        buffer = ref->data;
+    } else if (!(buffer = av_malloc(buf_size)))
         return AVERROR(ENOMEM);
 
-    av_free(s->buffer);
+    free_buffer(s);
     s->buffer = buffer;
+    s->buffer_ref = ref;
     s->buffer_size = buf_size;
     s->buf_ptr = buffer;
     url_resetbuf(s, s->write_flag ? AVIO_FLAG_WRITE : AVIO_FLAG_READ);
     return 0;
 }
 
+int ffio_enable_async(AVIOContext *s, int buffer_size)
+{
+#if CONFIG_ASYNC_PROTOCOL
+    URLContext *h = s->opaque;
+    int ret;
+
+    if (s->write_flag ? s->write_packet != (void*)ffurl_write :
+                        s->read_packet  != (void*)ffurl_read)
+        return AVERROR(ENOSYS);
+    if (s->write_flag)
+        avio_flush(s);
+    if ((ret = ff_async_open(&h, s->opaque, buffer_size)) < 0)
+        return ret;
+    s->opaque     = h;
+    s->read_pause = NULL;
+    s->read_seek  = NULL;
+    return 0;
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
+
+int ffio_enable_lending(AVIOContext *s)
+{
+    AVBufferRef *ref;
+    int len = s->buf_end - s->buffer;
+
+    if (s->write_flag)
+        return AVERROR(EINVAL);
+    if (s->buffer_ref)
+        return 0;
+    if (!(ref = av_buffer_alloc(s->buffer_size + FF_INPUT_BUFFER_PADDING_SIZE)))
+        return AVERROR(ENOMEM);
+    /* keep the buffered data, it may still be read or seeked back to */
+    memcpy(ref->data, s->buffer, len);
+    memset(ref->data + len, 0, FF_INPUT_BUFFER_PADDING_SIZE);
+    if (s->update_checksum)
+        s->checksum_ptr = ref->data + (s->checksum_ptr - s->buffer);
+    s->buf_ptr = ref->data + (s->buf_ptr - s->buffer);
+    s->buf_end = ref->data + len;
+    av_free(s->buffer);
+    s->buffer     = ref->data;
+    s->buffer_ref = ref;
+    return 0;
+}
+
 static int url_resetbuf(AVIOContext *s, int flags)
 {
     assert(flags == AVIO_FLAG_WRITE || flags == AVIO_FLAG_READ);
@@ -905,7 +1039,8 @@ int ffio_rewind_with_probe_data(AVIOContext *s, unsigned char *buf, int buf_size
 {
     int64_t buffer_start;
     int buffer_size;
-    int overlap, new_size, alloc_size;
+    int overlap, new_size, alloc_size, padding;
+    AVBufferRef *ref = NULL;
 
     if (s->write_flag)
         return AVERROR(EINVAL);
@@ -920,16 +1055,25 @@ int ffio_rewind_with_probe_data(AVIOContext *s, unsigned char *buf, int buf_size
     new_size = buf_size + buffer_size - overlap;
 
     alloc_size = FFMAX(s->buffer_size, new_size);
-    if (alloc_size > buf_size)
-        if (!(buf = av_realloc(buf, alloc_size)))
+    padding = s->buffer_ref ? FF_INPUT_BUFFER_PADDING_SIZE : 0;
+    if (alloc_size + padding > buf_size)
+        if (!(buf = av_realloc(buf, alloc_size + padding)))
             return AVERROR(ENOMEM);
+    if (padding &&
+        !(ref = av_buffer_create(buf, alloc_size + padding, NULL, NULL, 0))) {
+        av_free(buf);
+        return AVERROR(ENOMEM);
+    }
 
     if (new_size > buf_size) {
         memcpy(buf + buf_size, s->buffer + overlap, buffer_size - overlap);
         buf_size = new_size;
     }
+    if (padding)
+        memset(buf + buf_size, 0, padding);
 
-    av_free(s->buffer);
+    free_buffer(s);
+    s->buffer_ref = ref;
     s->buf_ptr = s->buffer = buf;
     s->buffer_size = alloc_size;
     s->pos = buf_size;
@@ -960,7 +1104,7 @@ int avio_close(AVIOContext *s)
 {
     URLContext *h = s->opaque;
 
-    av_free(s->buffer);
+    free_buffer(s);
     av_free(s);
     return ffurl_close(h);
 }
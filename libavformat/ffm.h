@@ -29,6 +29,8 @@
 /* The FFM file is made of blocks of fixed size */
 #define FFM_HEADER_SIZE 14
 #define FFM_PACKET_SIZE 4096
+/* the frame offset in the packet header is stored on 15 bits */
+#define FFM_MAX_PACKET_SIZE 32768
 #define PACKET_ID       0x666d
 
 /* each packet contains frames (which can span several packets */
@@ -53,7 +55,7 @@ typedef struct FFMContext {
     int frame_offset;
     int64_t dts;
     uint8_t *packet_ptr, *packet_end;
-    uint8_t packet[FFM_PACKET_SIZE];
+    uint8_t packet[FFM_MAX_PACKET_SIZE];
 } FFMContext;
 
 int64_t ffm_read_write_index(int fd);
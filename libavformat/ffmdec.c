@@ -77,7 +77,7 @@ static int ffm_is_avail_data(AVFormatContext *s, int size)
     } else if (pos < ffm->write_index) {
         avail_size = ffm->write_index - pos;
     } else {
-        avail_size = (ffm->file_size - pos) + (ffm->write_index - FFM_PACKET_SIZE);
+        avail_size = (ffm->file_size - pos) + (ffm->write_index - ffm->packet_size);
     }
     }
     avail_size = (avail_size / ffm->packet_size) * (ffm->packet_size - FFM_HEADER_SIZE) + len;
@@ -163,16 +163,16 @@ static int ffm_read_data(AVFormatContext *s,
     return size1 - size;
 }
 
-/* ensure that acutal seeking happens between FFM_PACKET_SIZE
-   and file_size - FFM_PACKET_SIZE */
+/* ensure that acutal seeking happens between the first data packet
+   and the last packet of the file */
 static void ffm_seek1(AVFormatContext *s, int64_t pos1)
 {
     FFMContext *ffm = s->priv_data;
     AVIOContext *pb = s->pb;
     int64_t pos;
 
-    pos = FFMIN(pos1, ffm->file_size - FFM_PACKET_SIZE);
-    pos = FFMAX(pos, FFM_PACKET_SIZE);
+    pos = FFMIN(pos1, ffm->file_size - ffm->packet_size);
+    pos = FFMAX(pos, ffm->packet_size);
     av_dlog(s, "seek to %"PRIx64" -> %"PRIx64"\n", pos1, pos);
     avio_seek(pb, pos, SEEK_SET);
 }
@@ -201,7 +201,7 @@ static void adjust_write_index(AVFormatContext *s)
 
 
     pos_min = 0;
-    pos_max = ffm->file_size - 2 * FFM_PACKET_SIZE;
+    pos_max = ffm->file_size - 2 * ffm->packet_size;
 
     pts_start = get_dts(s, pos_min);
 
@@ -210,7 +210,7 @@ static void adjust_write_index(AVFormatContext *s)
     if (pts - 100000 > pts_start)
         goto end;
 
-    ffm->write_index = FFM_PACKET_SIZE;
+    ffm->write_index = ffm->packet_size;
 
     pts_start = get_dts(s, pos_min);
 
@@ -221,7 +221,7 @@ static void adjust_write_index(AVFormatContext *s)
             int64_t newpos;
             int64_t newpts;
 
-            newpos = ((pos_max + pos_min) / (2 * FFM_PACKET_SIZE)) * FFM_PACKET_SIZE;
+            newpos = ((pos_max + pos_min) / (2 * ffm->packet_size)) * ffm->packet_size;
 
             if (newpos == pos_min)
                 break;
@@ -239,7 +239,7 @@ static void adjust_write_index(AVFormatContext *s)
     }
 
     //printf("Adjusted write index from %"PRId64" to %"PRId64": pts=%0.6f\n", orig_write_index, ffm->write_index, pts / 1000000.);
-    //printf("pts range %0.6f - %0.6f\n", get_dts(s, 0) / 1000000. , get_dts(s, ffm->file_size - 2 * FFM_PACKET_SIZE) / 1000000. );
+    //printf("pts range %0.6f - %0.6f\n", get_dts(s, 0) / 1000000. , get_dts(s, ffm->file_size - 2 * ffm->packet_size) / 1000000. );
 
  end:
     avio_seek(pb, ptr, SEEK_SET);
@@ -271,8 +271,10 @@ static int ffm_read_header(AVFormatContext *s, AVFormatParameters *ap)
     if (tag != MKTAG('F', 'F', 'M', '1'))
         goto fail;
     ffm->packet_size = avio_rb32(pb);
-    if (ffm->packet_size != FFM_PACKET_SIZE)
+    if (ffm->packet_size < FFM_PACKET_SIZE ||
+        ffm->packet_size > FFM_MAX_PACKET_SIZE)
         goto fail;
+    s->packet_size = ffm->packet_size;
     ffm->write_index = avio_rb64(pb);
     /* get also filesize */
     if (pb->seekable) {
@@ -461,15 +463,15 @@ static int ffm_seek(AVFormatContext *s, int stream_index, int64_t wanted_pts, in
     av_dlog(s, "wanted_pts=%0.6f\n", wanted_pts / 1000000.0);
     /* find the position using linear interpolation (better than
        dichotomy in typical cases) */
-    pos_min = FFM_PACKET_SIZE;
-    pos_max = ffm->file_size - FFM_PACKET_SIZE;
+    pos_min = ffm->packet_size;
+    pos_max = ffm->file_size - ffm->packet_size;
     while (pos_min <= pos_max) {
         pts_min = get_dts(s, pos_min);
         pts_max = get_dts(s, pos_max);
         /* linear interpolation */
         pos1 = (double)(pos_max - pos_min) * (double)(wanted_pts - pts_min) /
             (double)(pts_max - pts_min);
-        pos = (((int64_t)pos1) / FFM_PACKET_SIZE) * FFM_PACKET_SIZE;
+        pos = (((int64_t)pos1) / ffm->packet_size) * ffm->packet_size;
         if (pos <= pos_min)
             pos = pos_min;
         else if (pos >= pos_max)
@@ -479,9 +481,9 @@ static int ffm_seek(AVFormatContext *s, int stream_index, int64_t wanted_pts, in
         if (pts == wanted_pts) {
             goto found;
         } else if (pts > wanted_pts) {
-            pos_max = pos - FFM_PACKET_SIZE;
+            pos_max = pos - ffm->packet_size;
         } else {
-            pos_min = pos + FFM_PACKET_SIZE;
+            pos_min = pos + ffm->packet_size;
         }
     }
     pos = (flags & AVSEEK_FLAG_BACKWARD) ? pos_min : pos_max;
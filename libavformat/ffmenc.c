@@ -35,20 +35,21 @@ static void flush_packet(AVFormatContext *s)
     if (avio_tell(pb) % ffm->packet_size)
         av_abort();
 
-    /* put header */
-    avio_wb16(pb, PACKET_ID);
-    avio_wb16(pb, fill_size);
-    avio_wb64(pb, ffm->dts);
+    /* put header in front of the data, so that the whole packet goes
+       out in a single write */
+    AV_WB16(ffm->packet,     PACKET_ID);
+    AV_WB16(ffm->packet + 2, fill_size);
+    AV_WB64(ffm->packet + 4, ffm->dts);
     h = ffm->frame_offset;
     if (ffm->first_packet)
         h |= 0x8000;
-    avio_wb16(pb, h);
-    avio_write(pb, ffm->packet, ffm->packet_end - ffm->packet);
+    AV_WB16(ffm->packet + 12, h);
+    avio_write(pb, ffm->packet, ffm->packet_size);
     avio_flush(pb);
 
     /* prepare next packet */
     ffm->frame_offset = 0; /* no key frame */
-    ffm->packet_ptr = ffm->packet;
+    ffm->packet_ptr = ffm->packet + FFM_HEADER_SIZE;
     ffm->first_packet = 0;
 }
 
@@ -61,7 +62,7 @@ static void ffm_write_data(AVFormatContext *s,
     int len;
 
     if (header && ffm->frame_offset == 0) {
-        ffm->frame_offset = ffm->packet_ptr - ffm->packet + FFM_HEADER_SIZE;
+        ffm->frame_offset = ffm->packet_ptr - ffm->packet;
         ffm->dts = dts;
     }
 
@@ -88,7 +89,13 @@ static int ffm_write_header(AVFormatContext *s)
     AVCodecContext *codec;
     int bit_rate, i;
 
-    ffm->packet_size = FFM_PACKET_SIZE;
+    ffm->packet_size = s->packet_size ? s->packet_size : FFM_PACKET_SIZE;
+    if (ffm->packet_size < FFM_PACKET_SIZE ||
+        ffm->packet_size > FFM_MAX_PACKET_SIZE) {
+        av_log(s, AV_LOG_ERROR, "Packet size must be between %d and %d\n",
+               FFM_PACKET_SIZE, FFM_MAX_PACKET_SIZE);
+        return AVERROR(EINVAL);
+    }
 
     /* header */
     avio_wl32(pb, MKTAG('F', 'F', 'M', '1'));
@@ -190,9 +197,8 @@ static int ffm_write_header(AVFormatContext *s)
     avio_flush(pb);
 
     /* init packet mux */
-    ffm->packet_ptr = ffm->packet;
-    ffm->packet_end = ffm->packet + ffm->packet_size - FFM_HEADER_SIZE;
-    assert(ffm->packet_end >= ffm->packet);
+    ffm->packet_ptr = ffm->packet + FFM_HEADER_SIZE;
+    ffm->packet_end = ffm->packet + ffm->packet_size;
     ffm->frame_offset = 0;
     ffm->dts = 0;
     ffm->first_packet = 1;
@@ -232,7 +238,7 @@ static int ffm_write_trailer(AVFormatContext *s)
     FFMContext *ffm = s->priv_data;
 
     /* flush packets */
-    if (ffm->packet_ptr > ffm->packet)
+    if (ffm->packet_ptr > ffm->packet + FFM_HEADER_SIZE)
         flush_packet(s);
 
     avio_flush(pb);
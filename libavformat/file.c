@@ -19,8 +19,10 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#define _GNU_SOURCE     /* Needed for O_DIRECT with glibc */
 #include "libavutil/avstring.h"
 #include "avformat.h"
+#include <errno.h>
 #include <fcntl.h>
 #if HAVE_SETMODE
 #include <io.h>
@@ -28,27 +30,126 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include <stdlib.h>
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
 #include "os_support.h"
 #include "url.h"
 
 
 /* standard file protocol */
 
+typedef struct FileContext {
+    int fd;
+    /* mapping of the whole file, for AVIO_FLAG_MMAP */
+    uint8_t *map;
+    int64_t map_size;
+    int64_t map_pos;
+    /* aligned buffer of the O_DIRECT writes, for AVIO_FLAG_DIRECT */
+    uint8_t *direct_mem;
+    uint8_t *direct_buf;
+    int direct_fill;
+} FileContext;
+
+#define DIRECT_ALIGN    4096
+#define DIRECT_BUF_SIZE (1 << 20)
+
+static int write_all(int fd, const uint8_t *buf, int size)
+{
+    while (size > 0) {
+        int ret = write(fd, buf, size);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            return AVERROR(errno);
+        }
+        buf  += ret;
+        size -= ret;
+    }
+    return 0;
+}
+
+/**
+ * Write the buffered data and go on writing through the page cache.
+ * O_DIRECT writes must be whole blocks, so the tail is written after
+ * O_DIRECT has been cleared.
+ */
+static int direct_end(FileContext *c)
+{
+    int ret;
+
+    if (!c->direct_buf)
+        return 0;
+    ret = write(c->fd, c->direct_buf, c->direct_fill & ~(DIRECT_ALIGN - 1));
+    if (ret > 0) {
+        memmove(c->direct_buf, c->direct_buf + ret, c->direct_fill - ret);
+        c->direct_fill -= ret;
+    }
+#ifdef O_DIRECT
+    fcntl(c->fd, F_SETFL, fcntl(c->fd, F_GETFL) & ~O_DIRECT);
+#endif
+    ret = write_all(c->fd, c->direct_buf, c->direct_fill);
+    av_freep(&c->direct_mem);
+    c->direct_buf  = NULL;
+    c->direct_fill = 0;
+    return ret;
+}
+
+static int direct_write(FileContext *c, const unsigned char *buf, int size)
+{
+    int done = 0, ret;
+
+    while (c->direct_buf && done < size) {
+        int len = FFMIN(size - done, DIRECT_BUF_SIZE - c->direct_fill);
+        memcpy(c->direct_buf + c->direct_fill, buf + done, len);
+        c->direct_fill += len;
+        done           += len;
+        if (c->direct_fill == DIRECT_BUF_SIZE) {
+            ret = write(c->fd, c->direct_buf, DIRECT_BUF_SIZE);
+            if (ret == DIRECT_BUF_SIZE) {
+                c->direct_fill = 0;
+                continue;
+            }
+            /* refused or short write: leave direct mode */
+            if (ret > 0) {
+                memmove(c->direct_buf, c->direct_buf + ret, DIRECT_BUF_SIZE - ret);
+                c->direct_fill -= ret;
+            }
+            if ((ret = direct_end(c)) < 0)
+                return ret;
+        }
+    }
+    if (done < size) {
+        if ((ret = write_all(c->fd, buf + done, size - done)) < 0)
+            return ret;
+    }
+    return size;
+}
+
 static int file_read(URLContext *h, unsigned char *buf, int size)
 {
-    int fd = (intptr_t) h->priv_data;
-    return read(fd, buf, size);
+    FileContext *c = h->priv_data;
+    if (c->map) {
+        size = FFMIN(size, FFMAX(c->map_size - c->map_pos, 0));
+        memcpy(buf, c->map + c->map_pos, size);
+        c->map_pos += size;
+        return size;
+    }
+    return read(c->fd, buf, size);
 }
 
 static int file_write(URLContext *h, const unsigned char *buf, int size)
 {
-    int fd = (intptr_t) h->priv_data;
-    return write(fd, buf, size);
+    FileContext *c = h->priv_data;
+    if (c->direct_buf)
+        return direct_write(c, buf, size);
+    return write(c->fd, buf, size);
 }
 
 static int file_get_handle(URLContext *h)
 {
-    return (intptr_t) h->priv_data;
+    FileContext *c = h->priv_data;
+    return c->fd;
 }
 
 static int file_check(URLContext *h, int mask)
@@ -66,8 +167,34 @@ static int file_check(URLContext *h, int mask)
 
 #if CONFIG_FILE_PROTOCOL
 
+/**
+ * Map a regular file opened for reading, leaving c->map NULL when it
+ * cannot be mapped, in which case the file is read with read().
+ */
+static void file_map(FileContext *c)
+{
+#if HAVE_MMAP
+    struct stat st;
+    void *map;
+
+    if (fstat(c->fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 ||
+        st.st_size > SIZE_MAX)
+        return;
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, c->fd, 0);
+    if (map == MAP_FAILED)
+        return;
+#ifdef MADV_SEQUENTIAL
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+#endif
+    c->map      = map;
+    c->map_size = st.st_size;
+    c->map_pos  = 0;
+#endif
+}
+
 static int file_open(URLContext *h, const char *filename, int flags)
 {
+    FileContext *c = h->priv_data;
     int access;
     int fd;
 
@@ -83,29 +210,71 @@ static int file_open(URLContext *h, const char *filename, int flags)
 #ifdef O_BINARY
     access |= O_BINARY;
 #endif
-    fd = open(filename, access, 0666);
+    fd = -1;
+#ifdef O_DIRECT
+    if (flags & AVIO_FLAG_DIRECT && (flags & AVIO_FLAG_READ_WRITE) == AVIO_FLAG_WRITE) {
+        /* the filesystem may not support it, then fall back silently */
+        fd = open(filename, access | O_DIRECT, 0666);
+        if (fd != -1) {
+            c->direct_mem = av_malloc(DIRECT_BUF_SIZE + DIRECT_ALIGN);
+            if (c->direct_mem)
+                c->direct_buf = (uint8_t *)FFALIGN((uintptr_t)c->direct_mem, DIRECT_ALIGN);
+            else
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+        }
+    }
+#endif
+    if (fd == -1)
+        fd = open(filename, access, 0666);
     if (fd == -1)
         return AVERROR(errno);
-    h->priv_data = (void *) (intptr_t) fd;
+    c->fd = fd;
+    if (flags & AVIO_FLAG_MMAP && !(flags & AVIO_FLAG_WRITE))
+        file_map(c);
     return 0;
 }
 
 /* XXX: use llseek */
 static int64_t file_seek(URLContext *h, int64_t pos, int whence)
 {
-    int fd = (intptr_t) h->priv_data;
+    FileContext *c = h->priv_data;
+    if (c->map) {
+        switch (whence) {
+        case AVSEEK_SIZE: return c->map_size;
+        case SEEK_CUR:    pos += c->map_pos;  break;
+        case SEEK_END:    pos += c->map_size; break;
+        }
+        if (pos < 0)
+            return AVERROR(EINVAL);
+        return c->map_pos = pos;
+    }
+    if (c->direct_buf) {
+        /* seeks which do not move, like the one after opening, are not
+         * worth leaving direct mode */
+        int64_t cur = lseek(c->fd, 0, SEEK_CUR) + c->direct_fill;
+        int ret;
+        if ((whence == SEEK_SET && pos == cur) || (whence == SEEK_CUR && !pos))
+            return cur;
+        if ((ret = direct_end(c)) < 0)
+            return ret;
+    }
     if (whence == AVSEEK_SIZE) {
         struct stat st;
-        int ret = fstat(fd, &st);
+        int ret = fstat(c->fd, &st);
         return ret < 0 ? AVERROR(errno) : st.st_size;
     }
-    return lseek(fd, pos, whence);
+    return lseek(c->fd, pos, whence);
 }
 
 static int file_close(URLContext *h)
 {
-    int fd = (intptr_t) h->priv_data;
-    return close(fd);
+    FileContext *c = h->priv_data;
+#if HAVE_MMAP
+    if (c->map)
+        munmap(c->map, c->map_size);
+#endif
+    direct_end(c);
+    return close(c->fd);
 }
 
 URLProtocol ff_file_protocol = {
@@ -117,6 +286,7 @@ URLProtocol ff_file_protocol = {
     .url_close           = file_close,
     .url_get_file_handle = file_get_handle,
     .url_check           = file_check,
+    .priv_data_size      = sizeof(FileContext),
 };
 
 #endif /* CONFIG_FILE_PROTOCOL */
@@ -125,6 +295,7 @@ URLProtocol ff_file_protocol = {
 
 static int pipe_open(URLContext *h, const char *filename, int flags)
 {
+    FileContext *c = h->priv_data;
     int fd;
     char *final;
     av_strstart(filename, "pipe:", &filename);
@@ -140,7 +311,7 @@ static int pipe_open(URLContext *h, const char *filename, int flags)
 #if HAVE_SETMODE
     setmode(fd, O_BINARY);
 #endif
-    h->priv_data = (void *) (intptr_t) fd;
+    c->fd = fd;
     h->is_streamed = 1;
     return 0;
 }
@@ -152,6 +323,7 @@ URLProtocol ff_pipe_protocol = {
     .url_write           = file_write,
     .url_get_file_handle = file_get_handle,
     .url_check           = file_check,
+    .priv_data_size      = sizeof(FileContext),
 };
 
 #endif /* CONFIG_PIPE_PROTOCOL */
@@ -31,12 +31,23 @@
 #include "url.h"
 #include "libavutil/opt.h"
 
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
 /* XXX: POST protocol is not completely implemented because ffmpeg uses
    only a subset of it. */
 
 /* used for protocol handling */
 #define BUFFER_SIZE 1024
 #define MAX_REDIRECTS 8
+/** idle connections kept for reuse, for all hosts */
+#define POOL_SIZE 8
+/** time in microseconds after which an idle connection is not reused */
+#define POOL_IDLE_TIMEOUT 15000000
+/** most bytes read and discarded to reuse a connection, or to seek
+ *  forward on it */
+#define MAX_DRAIN_SIZE 65536
 
 typedef struct {
     const AVClass *class;
@@ -50,11 +61,17 @@ typedef struct {
     HTTPAuthState auth_state;
     unsigned char headers[BUFFER_SIZE];
     int willclose;          /**< Set if the server correctly handles Connection: close and will close the connection after feeding us the content. */
+    int keep_alive;
+    char hd_url[1024];      /**< URL hd was opened with, to reuse it */
+    int64_t content_length;
+    int64_t end_off;        /**< offset after the body if known, otherwise -1 */
+    int end_chunked;        /**< Set once the last chunk has been read. */
 } HTTPContext;
 
 #define OFFSET(x) offsetof(HTTPContext, x)
 static const AVOption options[] = {
 {"chunksize", "use chunked transfer-encoding for posts, -1 disables it, 0 enables it", OFFSET(chunksize), FF_OPT_TYPE_INT64, {.dbl = 0}, -1, 0 }, /* Default to 0, for chunked POSTs */
+{"keep_alive", "reuse the connections for the following requests", OFFSET(keep_alive), FF_OPT_TYPE_INT, {.dbl = 1}, 0, 1 },
 {NULL}
 };
 static const AVClass httpcontext_class = {
@@ -89,6 +106,107 @@ void ff_http_init_auth_state(URLContext *dest, const URLContext *src)
            &((HTTPContext*)src->priv_data)->auth_state, sizeof(HTTPAuthState));
 }
 
+/* connections kept open after their last response, shared by all the
+ * contexts */
+typedef struct {
+    char url[1024];
+    URLContext *hd;
+    int64_t idle_since;
+} PoolEntry;
+
+static PoolEntry pool[POOL_SIZE];
+#if HAVE_PTHREADS
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+#define POOL_LOCK()   pthread_mutex_lock(&pool_lock)
+#define POOL_UNLOCK() pthread_mutex_unlock(&pool_lock)
+#else
+#define POOL_LOCK()
+#define POOL_UNLOCK()
+#endif
+
+/**
+ * Take an idle connection opened with url out of the pool.
+ * @return NULL if there is none
+ */
+static URLContext *pool_get(const char *url)
+{
+    URLContext *hd = NULL, *stale[POOL_SIZE];
+    int64_t now = av_gettime();
+    int i, nb_stale = 0;
+
+    POOL_LOCK();
+    for (i = 0; i < POOL_SIZE; i++) {
+        if (!pool[i].hd)
+            continue;
+        if (now - pool[i].idle_since > POOL_IDLE_TIMEOUT) {
+            stale[nb_stale++] = pool[i].hd;
+            pool[i].hd = NULL;
+        } else if (!hd && !strcmp(pool[i].url, url)) {
+            hd = pool[i].hd;
+            pool[i].hd = NULL;
+        }
+    }
+    POOL_UNLOCK();
+    for (i = 0; i < nb_stale; i++)
+        ffurl_close(stale[i]);
+    return hd;
+}
+
+/** Give an idle connection to the pool, replacing the oldest one if full. */
+static void pool_put(const char *url, URLContext *hd)
+{
+    int i, slot = 0;
+
+    POOL_LOCK();
+    for (i = 0; i < POOL_SIZE; i++) {
+        if (!pool[i].hd) {
+            slot = i;
+            break;
+        }
+        if (pool[i].idle_since < pool[slot].idle_since)
+            slot = i;
+    }
+    FFSWAP(URLContext *, hd, pool[slot].hd);
+    av_strlcpy(pool[slot].url, url, sizeof(pool[slot].url));
+    pool[slot].idle_since = av_gettime();
+    POOL_UNLOCK();
+    if (hd)
+        ffurl_close(hd);
+}
+
+static int http_read(URLContext *h, uint8_t *buf, int size);
+
+/**
+ * Give up the connection, to the pool if its response can be read to the
+ * end cheaply and it is not going to be closed by the server.
+ */
+static void http_release_hd(URLContext *h)
+{
+    HTTPContext *s = h->priv_data;
+    uint8_t buf[4096];
+    int drained = 0, ret = 0;
+
+    if (!s->hd)
+        return;
+    if (s->keep_alive && !(h->flags & AVIO_FLAG_WRITE) && !s->willclose &&
+        (s->end_off >= 0 || s->chunksize >= 0)) {
+        while (!s->end_chunked && (s->end_off < 0 || s->off < s->end_off) &&
+               drained < MAX_DRAIN_SIZE) {
+            if ((ret = http_read(h, buf, sizeof(buf))) <= 0)
+                break;
+            drained += ret;
+        }
+        if (ret >= 0 && (s->end_chunked || s->off == s->end_off) &&
+            s->buf_ptr == s->buf_end) {
+            pool_put(s->hd_url, s->hd);
+            s->hd = NULL;
+            return;
+        }
+    }
+    ffurl_close(s->hd);
+    s->hd = NULL;
+}
+
 /* return non zero if error */
 static int http_open_cnx(URLContext *h)
 {
@@ -101,6 +219,7 @@ static int http_open_cnx(URLContext *h)
     HTTPAuthType cur_auth_type;
     HTTPContext *s = h->priv_data;
     URLContext *hd = NULL;
+    int reused;
 
     proxy_path = getenv("http_proxy");
     use_proxy = (proxy_path != NULL) && !getenv("no_proxy") &&
@@ -127,14 +246,28 @@ static int http_open_cnx(URLContext *h)
         port = 80;
 
     ff_url_join(buf, sizeof(buf), "tcp", NULL, hostname, port, NULL);
-    err = ffurl_open(&hd, buf, AVIO_FLAG_READ_WRITE);
-    if (err < 0)
-        goto fail;
+    hd = s->keep_alive ? pool_get(buf) : NULL;
+    reused = !!hd;
+ reconnect:
+    if (!hd) {
+        err = ffurl_open(&hd, buf, AVIO_FLAG_READ_WRITE);
+        if (err < 0)
+            goto fail;
+    }
 
     s->hd = hd;
+    av_strlcpy(s->hd_url, buf, sizeof(s->hd_url));
     cur_auth_type = s->auth_state.auth_type;
-    if (http_connect(h, path, hoststr, auth, &location_changed) < 0)
+    if (http_connect(h, path, hoststr, auth, &location_changed) < 0) {
+        /* the server may have closed the idle connection meanwhile */
+        if (reused && s->buf_end == s->buffer) {
+            ffurl_close(hd);
+            hd = NULL;
+            reused = 0;
+            goto reconnect;
+        }
         goto fail;
+    }
     if (s->http_code == 401) {
         if (cur_auth_type == HTTP_AUTH_NONE && s->auth_state.auth_type != HTTP_AUTH_NONE) {
             ffurl_close(hd);
@@ -223,6 +356,9 @@ static int process_line(URLContext *h, char *line, int line_count,
 
     p = line;
     if (line_count == 0) {
+        /* HTTP/1.0 connections are not persistent by default */
+        if (!strncmp(p, "HTTP/1.0", 8))
+            s->willclose = 1;
         while (!isspace(*p) && *p != '\0')
             p++;
         while (isspace(*p))
@@ -253,8 +389,10 @@ static int process_line(URLContext *h, char *line, int line_count,
         if (!strcasecmp(tag, "Location")) {
             strcpy(s->location, p);
             *new_location = 1;
-        } else if (!strcasecmp (tag, "Content-Length") && s->filesize == -1) {
-            s->filesize = atoll(p);
+        } else if (!strcasecmp (tag, "Content-Length")) {
+            s->content_length = atoll(p);
+            if (s->filesize == -1)
+                s->filesize = s->content_length;
         } else if (!strcasecmp (tag, "Content-Range")) {
             /* "bytes $from-$to/$document_size" */
             const char *slash;
@@ -273,8 +411,10 @@ static int process_line(URLContext *h, char *line, int line_count,
         } else if (!strcasecmp (tag, "Authentication-Info")) {
             ff_http_auth_handle_header(&s->auth_state, tag, p);
         } else if (!strcasecmp (tag, "Connection")) {
-            if (!strcmp(p, "close"))
+            if (!strcasecmp(p, "close"))
                 s->willclose = 1;
+            else if (!strcasecmp(p, "keep-alive"))
+                s->willclose = 0;
         }
     }
     return 1;
@@ -314,7 +454,8 @@ static int http_connect(URLContext *h, const char *path, const char *hoststr,
         len += av_strlcatf(headers + len, sizeof(headers) - len,
                            "Range: bytes=%"PRId64"-\r\n", s->off);
     if (!has_header(s->headers, "\r\nConnection: "))
-        len += av_strlcpy(headers + len, "Connection: close\r\n",
+        len += av_strlcpy(headers + len, s->keep_alive && !post ?
+                          "Connection: keep-alive\r\n" : "Connection: close\r\n",
                           sizeof(headers)-len);
     if (!has_header(s->headers, "\r\nHost: "))
         len += av_strlcatf(headers + len, sizeof(headers) - len,
@@ -346,6 +487,9 @@ static int http_connect(URLContext *h, const char *path, const char *hoststr,
     s->off = 0;
     s->filesize = -1;
     s->willclose = 0;
+    s->content_length = -1;
+    s->end_off = -1;
+    s->end_chunked = 0;
     if (post) {
         /* Pretend that it did work. We didn't read any header yet, since
          * we've still to send the POST data, but the code calling this
@@ -369,6 +513,8 @@ static int http_connect(URLContext *h, const char *path, const char *hoststr,
             break;
         s->line_count++;
     }
+    if (s->chunksize < 0 && s->content_length >= 0)
+        s->end_off = s->off + s->content_length;
 
     return (off == s->off) ? 0 : -1;
 }
@@ -379,26 +525,39 @@ static int http_read(URLContext *h, uint8_t *buf, int size)
     HTTPContext *s = h->priv_data;
     int len;
 
+    if (!s->hd)
+        return AVERROR_EOF;
     if (s->chunksize >= 0) {
         if (!s->chunksize) {
             char line[32];
 
-            for(;;) {
-                do {
-                    if (http_get_line(s, line, sizeof(line)) < 0)
-                        return AVERROR(EIO);
-                } while (!*line);    /* skip CR LF from last chunk */
+            if (s->end_chunked)
+                return 0;
+            do {
+                if (http_get_line(s, line, sizeof(line)) < 0)
+                    return AVERROR(EIO);
+            } while (!*line);    /* skip CR LF from last chunk */
 
-                s->chunksize = strtoll(line, NULL, 16);
+            s->chunksize = strtoll(line, NULL, 16);
 
-                av_dlog(NULL, "Chunked encoding data size: %"PRId64"'\n", s->chunksize);
+            av_dlog(NULL, "Chunked encoding data size: %"PRId64"'\n", s->chunksize);
 
-                if (!s->chunksize)
-                    return 0;
-                break;
+            if (!s->chunksize) {
+                /* skip the trailer, up to the empty line ending it */
+                do {
+                    if (http_get_line(s, line, sizeof(line)) < 0)
+                        return AVERROR(EIO);
+                } while (*line);
+                s->end_chunked = 1;
+                return 0;
             }
         }
         size = FFMIN(size, s->chunksize);
+    } else if (s->end_off >= 0) {
+        /* do not wait for more than the body on a persistent connection */
+        if (s->off >= s->end_off)
+            return 0;
+        size = FFMIN(size, s->end_off - s->off);
     }
     /* read bytes from input buffer first */
     len = s->buf_end - s->buf_ptr;
@@ -459,8 +618,7 @@ static int http_close(URLContext *h)
         ret = ret > 0 ? 0 : ret;
     }
 
-    if (s->hd)
-        ffurl_close(s->hd);
+    http_release_hd(h);
     return ret;
 }
 
@@ -468,7 +626,10 @@ static int64_t http_seek(URLContext *h, int64_t off, int whence)
 {
     HTTPContext *s = h->priv_data;
     URLContext *old_hd = s->hd;
-    int64_t old_off = s->off;
+    int64_t old_off = s->off, old_end_off = s->end_off;
+    int64_t old_chunksize = s->chunksize;
+    int old_willclose = s->willclose;
+    char old_hd_url[sizeof(s->hd_url)];
     uint8_t old_buf[BUFFER_SIZE];
     int old_buf_size;
 
@@ -477,14 +638,43 @@ static int64_t http_seek(URLContext *h, int64_t off, int whence)
     else if ((s->filesize == -1 && whence == SEEK_END) || h->is_streamed)
         return -1;
 
-    /* we save the old context in case the seek fails */
-    old_buf_size = s->buf_end - s->buf_ptr;
-    memcpy(old_buf, s->buf_ptr, old_buf_size);
-    s->hd = NULL;
     if (whence == SEEK_CUR)
         off += s->off;
     else if (whence == SEEK_END)
         off += s->filesize;
+
+    /* a short forward seek within the body is cheaper on the current
+     * response than with a new request */
+    if (s->hd && off >= s->off && off - s->off <= MAX_DRAIN_SIZE &&
+        (s->end_off < 0 || off < s->end_off)) {
+        uint8_t buf[4096];
+        int ret = 1;
+        while (s->off < off &&
+               (ret = http_read(h, buf, FFMIN(off - s->off, sizeof(buf)))) > 0);
+        if (s->off == off)
+            return off;
+        if (ret < 0)
+            return -1;
+    }
+
+    /* a connection which can be reused is, by the new request, so the seek
+     * cannot fall back to it */
+    if (s->keep_alive && s->hd && !s->willclose &&
+        (s->end_chunked || s->off == s->end_off)) {
+        http_release_hd(h);
+        s->off = off;
+        if (http_open_cnx(h) < 0) {
+            s->off = old_off;
+            return -1;
+        }
+        return off;
+    }
+
+    /* we save the old context in case the seek fails */
+    old_buf_size = s->buf_end - s->buf_ptr;
+    memcpy(old_buf, s->buf_ptr, old_buf_size);
+    av_strlcpy(old_hd_url, s->hd_url, sizeof(old_hd_url));
+    s->hd = NULL;
     s->off = off;
 
     /* if it fails, continue on old connection */
@@ -494,9 +684,15 @@ static int64_t http_seek(URLContext *h, int64_t off, int whence)
         s->buf_end = s->buffer + old_buf_size;
         s->hd = old_hd;
         s->off = old_off;
+        s->end_off   = old_end_off;
+        s->chunksize = old_chunksize;
+        s->willclose = old_willclose;
+        s->end_chunked = 0;
+        av_strlcpy(s->hd_url, old_hd_url, sizeof(s->hd_url));
         return -1;
     }
-    ffurl_close(old_hd);
+    if (old_hd)
+        ffurl_close(old_hd);
     return off;
 }
 
@@ -26,11 +26,24 @@
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
 #include "libavutil/parseutils.h"
+#include "libavutil/threadpool.h"
 #include "avformat.h"
 #include "avio_internal.h"
 #include "internal.h"
 #include <strings.h>
 
+/**
+ * A file of the sequence read ahead on a thread of the pool.
+ */
+typedef struct {
+    AVTaskGroup *group;     /**< runs the read, so that it can be waited for alone */
+    AVFormatContext *s1;
+    int number;             /**< image number */
+    AVPacket pkt;
+    int size;               /**< size of the first file */
+    int ret;
+} ImageSlot;
+
 typedef struct {
     const AVClass *class;  /**< Class for private options. */
     int img_first;
@@ -43,6 +56,13 @@ typedef struct {
     char *pixel_format;     /**< Set by a private option. */
     char *video_size;       /**< Set by a private option. */
     char *framerate;        /**< Set by a private option. */
+    int readahead;          /**< Set by a private option. */
+
+    AVThreadPool *pool;
+    ImageSlot *slots;       /**< readahead slots, used as a ring */
+    int slot_head;          /**< slot of the next image to return */
+    int nb_queued;          /**< number of slots being read or read */
+    int next_queued;        /**< number of the next image to queue, -1 at the end */
 } VideoData;
 
 typedef struct {
@@ -207,6 +227,8 @@ enum CodecID av_guess_image2_codec(const char *filename){
 }
 #endif
 
+static int read_close(AVFormatContext *s1);
+
 static int read_header(AVFormatContext *s1, AVFormatParameters *ap)
 {
     VideoData *s = s1->priv_data;
@@ -274,6 +296,19 @@ static int read_header(AVFormatContext *s1, AVFormatParameters *ap)
         /* compute duration */
         st->start_time = 0;
         st->duration = last_index - first_index + 1;
+
+        if (s->readahead) {
+            int i;
+            s->pool  = av_thread_pool_alloc(s->readahead);
+            s->slots = av_mallocz(s->readahead * sizeof(*s->slots));
+            if (!s->pool || !s->slots)
+                goto nomem;
+            for (i = 0; i < s->readahead; i++) {
+                if (!(s->slots[i].group = av_task_group_alloc(s->pool)))
+                    goto nomem;
+                s->slots[i].s1 = s1;
+            }
+        }
     }
 
     if(s1->video_codec_id){
@@ -292,15 +327,138 @@ static int read_header(AVFormatContext *s1, AVFormatParameters *ap)
         st->codec->pix_fmt = pix_fmt;
 
     return 0;
+nomem:
+    read_close(s1);
+    return AVERROR(ENOMEM);
 }
 
-static int read_packet(AVFormatContext *s1, AVPacket *pkt)
+/**
+ * Read image number of the sequence, made of 3 files if the planes are
+ * split, into pkt. May run on a thread of the read-ahead pool.
+ *
+ * @param size set to the size of the first file
+ */
+static int read_image(AVFormatContext *s1, int number, AVPacket *pkt, int *size)
 {
     VideoData *s = s1->priv_data;
     char filename[1024];
-    int i;
-    int size[3]={0}, ret[3]={0};
+    int i, n, ret = 0;
+    int sizes[3] = {0};
     AVIOContext *f[3];
+
+    if (av_get_frame_filename(filename, sizeof(filename),
+                              s->path, number) < 0 && number > 1)
+        return AVERROR(EIO);
+    for (n = 0; n < 3; n++) {
+        if (avio_open(&f[n], filename, AVIO_FLAG_READ) < 0) {
+            if (n == 1)
+                break;
+            av_log(s1, AV_LOG_ERROR, "Could not open file : %s\n", filename);
+            ret = AVERROR(EIO);
+            goto fail;
+        }
+        sizes[n] = avio_size(f[n]);
+
+        if (!s->split_planes) {
+            n++;
+            break;
+        }
+        filename[ strlen(filename) - 1 ]= 'U' + n;
+    }
+    *size = sizes[0];
+
+    if ((ret = av_new_packet(pkt, sizes[0] + sizes[1] + sizes[2])) < 0)
+        goto fail;
+    pkt->stream_index = 0;
+    pkt->flags |= AV_PKT_FLAG_KEY;
+
+    pkt->size = 0;
+    for (i = 0; i < n; i++) {
+        int len = sizes[i] ? avio_read(f[i], pkt->data + pkt->size, sizes[i]) : 0;
+        if (len < 0 || (!i && !len))
+            ret = AVERROR(EIO);
+        else
+            pkt->size += len;
+    }
+    if (ret < 0)
+        av_free_packet(pkt);
+
+fail:
+    for (i = 0; i < n; i++)
+        avio_close(f[i]);
+    return ret;
+}
+
+static int read_slot(void *arg)
+{
+    ImageSlot *slot = arg;
+
+    slot->ret = read_image(slot->s1, slot->number, &slot->pkt, &slot->size);
+    return 0;
+}
+
+/**
+ * Queue the reads of the next images until all the slots are busy.
+ */
+static void queue_reads(AVFormatContext *s1)
+{
+    VideoData *s = s1->priv_data;
+
+    while (s->nb_queued < s->readahead && s->next_queued >= 0) {
+        ImageSlot *slot = &s->slots[(s->slot_head + s->nb_queued) % s->readahead];
+
+        slot->number = s->next_queued;
+        if (av_task_group_submit(slot->group, read_slot, slot) < 0)
+            read_slot(slot);
+        s->nb_queued++;
+
+        s->next_queued++;
+        if (s->next_queued > s->img_last)
+            s->next_queued = s1->loop_input ? s->img_first : -1;
+    }
+}
+
+/**
+ * Return the image s->img_number read ahead, and queue the next reads.
+ */
+static int read_queued_image(AVFormatContext *s1, AVPacket *pkt, int *size)
+{
+    VideoData *s = s1->priv_data;
+    ImageSlot *slot;
+    int ret;
+
+    /* restart the read-ahead if the reader went elsewhere */
+    slot = &s->slots[s->slot_head];
+    if (!s->nb_queued || slot->number != s->img_number) {
+        for (; s->nb_queued; s->nb_queued--) {
+            slot = &s->slots[s->slot_head];
+            av_task_group_wait(slot->group);
+            av_free_packet(&slot->pkt);
+            s->slot_head = (s->slot_head + 1) % s->readahead;
+        }
+        s->next_queued = s->img_number;
+    }
+    queue_reads(s1);
+
+    slot = &s->slots[s->slot_head];
+    av_task_group_wait(slot->group);
+    *pkt  = slot->pkt;
+    *size = slot->size;
+    ret   = slot->ret;
+    av_init_packet(&slot->pkt);
+    slot->pkt.data = NULL;
+    slot->pkt.size = 0;
+    s->slot_head = (s->slot_head + 1) % s->readahead;
+    s->nb_queued--;
+
+    queue_reads(s1);
+    return ret;
+}
+
+static int read_packet(AVFormatContext *s1, AVPacket *pkt)
+{
+    VideoData *s = s1->priv_data;
+    int size, ret;
     AVCodecContext *codec= s1->streams[0]->codec;
 
     if (!s->is_pipe) {
@@ -310,55 +468,51 @@ static int read_packet(AVFormatContext *s1, AVPacket *pkt)
         }
         if (s->img_number > s->img_last)
             return AVERROR_EOF;
-        if (av_get_frame_filename(filename, sizeof(filename),
-                                  s->path, s->img_number)<0 && s->img_number > 1)
-            return AVERROR(EIO);
-        for(i=0; i<3; i++){
-            if (avio_open(&f[i], filename, AVIO_FLAG_READ) < 0) {
-                if(i==1)
-                    break;
-                av_log(s1, AV_LOG_ERROR, "Could not open file : %s\n",filename);
-                return AVERROR(EIO);
-            }
-            size[i]= avio_size(f[i]);
 
-            if(!s->split_planes)
-                break;
-            filename[ strlen(filename) - 1 ]= 'U' + i;
-        }
+        if (s->readahead)
+            ret = read_queued_image(s1, pkt, &size);
+        else
+            ret = read_image(s1, s->img_number, pkt, &size);
+        if (ret < 0)
+            return ret;
 
         if(codec->codec_id == CODEC_ID_RAWVIDEO && !codec->width)
-            infer_size(&codec->width, &codec->height, size[0]);
+            infer_size(&codec->width, &codec->height, size);
     } else {
-        f[0] = s1->pb;
-        if (url_feof(f[0]))
+        if (url_feof(s1->pb))
             return AVERROR(EIO);
-        size[0]= 4096;
-    }
 
-    av_new_packet(pkt, size[0] + size[1] + size[2]);
-    pkt->stream_index = 0;
-    pkt->flags |= AV_PKT_FLAG_KEY;
+        av_new_packet(pkt, 4096);
+        pkt->stream_index = 0;
+        pkt->flags |= AV_PKT_FLAG_KEY;
 
-    pkt->size= 0;
-    for(i=0; i<3; i++){
-        if(size[i]){
-            ret[i]= avio_read(f[i], pkt->data + pkt->size, size[i]);
-            if (!s->is_pipe)
-                avio_close(f[i]);
-            if(ret[i]>0)
-                pkt->size += ret[i];
+        ret = avio_read(s1->pb, pkt->data, 4096);
+        if (ret <= 0) {
+            av_free_packet(pkt);
+            return AVERROR(EIO); /* signal EOF */
         }
+        pkt->size = ret;
     }
 
-    if (ret[0] <= 0 || ret[1]<0 || ret[2]<0) {
-        av_free_packet(pkt);
-        return AVERROR(EIO); /* signal EOF */
-    } else {
-        s->img_count++;
-        s->img_number++;
-        return 0;
+    s->img_count++;
+    s->img_number++;
+    return 0;
+}
+
+static int read_close(AVFormatContext *s1)
+{
+    VideoData *s = s1->priv_data;
+    int i;
+
+    if (s->slots) {
+        for (i = 0; i < s->readahead; i++) {
+            av_task_group_free(&s->slots[i].group);
+            av_free_packet(&s->slots[i].pkt);
+        }
+        av_freep(&s->slots);
     }
+    av_thread_pool_unref(&s->pool);
+    return 0;
 }
 
 #if CONFIG_IMAGE2_MUXER || CONFIG_IMAGE2PIPE_MUXER
@@ -466,6 +620,7 @@ static const AVOption options[] = {
     { "pixel_format", "", OFFSET(pixel_format), FF_OPT_TYPE_STRING, {.str = NULL}, 0, 0, DEC },
     { "video_size",   "", OFFSET(video_size),   FF_OPT_TYPE_STRING, {.str = NULL}, 0, 0, DEC },
     { "framerate",    "", OFFSET(framerate),    FF_OPT_TYPE_STRING, {.str = "25"}, 0, 0, DEC },
+    { "readahead",    "number of files read ahead on background threads", OFFSET(readahead), FF_OPT_TYPE_INT, {.dbl = 0}, 0, 64, DEC },
     { NULL },
 };
 
@@ -485,6 +640,7 @@ AVInputFormat ff_image2_demuxer = {
     .read_probe     = read_probe,
     .read_header    = read_header,
     .read_packet    = read_packet,
+    .read_close     = read_close,
     .flags          = AVFMT_NOFILE,
     .priv_class     = &img2_class,
 };
@@ -496,6 +652,7 @@ AVInputFormat ff_image2pipe_demuxer = {
     .priv_data_size = sizeof(VideoData),
     .read_header    = read_header,
     .read_packet    = read_packet,
+    .read_close     = read_close,
     .priv_class     = &img2_class,
 };
 #endif
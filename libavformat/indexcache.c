@@ -0,0 +1,198 @@
+/*
+ * Persistent index cache
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Save the index entries found while demuxing a file to a sidecar file
+ * and load them back when the same file is opened again, so that seeking
+ * in files without an index does not start from scratch every time.
+ *
+ * The cache is only used when the input is seekable. The file is
+ * identified by its size and a CRC of its first bytes, the streams by
+ * their index, codec id and time base. All numbers are big-endian:
+ *
+ *   "FFIC" version:8 file_size:64 crc:32 format_name_len:8 format_name
+ *   nb_streams:32
+ *   for each stream:
+ *       codec_id:32 tb_num:32 tb_den:32 nb_entries:32
+ *       for each entry: pos:64 timestamp:64 size:32 min_distance:32 flags:8
+ */
+
+#include "libavutil/crc.h"
+#include "avformat.h"
+#include "internal.h"
+
+#define INDEX_CACHE_VERSION 1
+/** number of bytes at the start of the file covered by the CRC */
+#define IDENTITY_SIZE (64 * 1024)
+#define ENTRY_SIZE    (8 + 8 + 4 + 4 + 1)
+
+static int file_identity(AVFormatContext *s, int64_t *size, uint32_t *crc)
+{
+    int64_t pos = avio_tell(s->pb);
+    uint8_t *buf;
+    int len;
+
+    if ((*size = avio_size(s->pb)) <= 0)
+        return AVERROR(ENOSYS);
+    if (!(buf = av_malloc(IDENTITY_SIZE)))
+        return AVERROR(ENOMEM);
+    if (avio_seek(s->pb, 0, SEEK_SET) < 0) {
+        av_free(buf);
+        return AVERROR(EIO);
+    }
+    len  = avio_read(s->pb, buf, IDENTITY_SIZE);
+    *crc = len > 0 ? av_crc(av_crc_get_table(AV_CRC_32_IEEE), 0, buf, len) : 0;
+    av_free(buf);
+
+    if (avio_seek(s->pb, pos, SEEK_SET) < 0)
+        return AVERROR(EIO);
+    return len < 0 ? len : 0;
+}
+
+static int count_entries(AVFormatContext *s)
+{
+    int i, n = 0;
+
+    for (i = 0; i < s->nb_streams; i++)
+        n += s->streams[i]->nb_index_entries;
+    return n;
+}
+
+static int cache_usable(AVFormatContext *s)
+{
+    return s->index_cache && s->index_cache[0] && s->pb && s->pb->seekable &&
+           !(s->iformat->flags & AVFMT_NOFILE) && !(s->flags & AVFMT_FLAG_IGNIDX);
+}
+
+void ff_index_cache_load(AVFormatContext *s)
+{
+    AVIOContext *pb;
+    char name[256];
+    int64_t size, cached_size;
+    uint32_t crc;
+    int i, j, nb_streams, len, first = s->index_cache_streams, loaded = 0;
+
+    if (!cache_usable(s) || first >= s->nb_streams)
+        return;
+    s->index_cache_streams = s->nb_streams;
+    if (file_identity(s, &size, &crc) < 0 ||
+        avio_open(&pb, s->index_cache, AVIO_FLAG_READ) < 0)
+        return;
+
+    if (avio_rb32(pb) != MKBETAG('F','F','I','C') ||
+        avio_r8(pb)   != INDEX_CACHE_VERSION)
+        goto end;
+    cached_size = avio_rb64(pb);
+    if (cached_size != size || avio_rb32(pb) != crc)
+        goto end;
+    len = avio_r8(pb);
+    if (avio_read(pb, name, len) != len)
+        goto end;
+    name[len] = 0;
+    if (strcmp(name, s->iformat->name))
+        goto end;
+
+    nb_streams = avio_rb32(pb);
+    for (i = 0; i < nb_streams && i < s->nb_streams && !pb->eof_reached; i++) {
+        AVStream *st = s->streams[i];
+        enum CodecID codec_id = avio_rb32(pb);
+        AVRational tb;
+        unsigned nb_entries;
+
+        tb.num     = avio_rb32(pb);
+        tb.den     = avio_rb32(pb);
+        nb_entries = avio_rb32(pb);
+
+        if (i < first || codec_id != st->codec->codec_id ||
+            av_cmp_q(tb, st->time_base)) {
+            avio_skip(pb, (int64_t)nb_entries * ENTRY_SIZE);
+            continue;
+        }
+        for (j = 0; j < nb_entries && !pb->eof_reached; j++) {
+            int64_t pos       = avio_rb64(pb);
+            int64_t timestamp = avio_rb64(pb);
+            int entry_size    = avio_rb32(pb);
+            int distance      = avio_rb32(pb);
+            int flags         = avio_r8(pb);
+
+            if (pb->eof_reached)
+                break;
+            if (av_add_index_entry(st, pos, timestamp, entry_size, distance, flags) < 0)
+                break;
+            loaded++;
+        }
+        ff_reduce_index(s, i);
+    }
+    if (loaded)
+        av_log(s, AV_LOG_VERBOSE, "Loaded %d index entries from %s\n",
+               loaded, s->index_cache);
+
+end:
+    s->index_cache_entries = count_entries(s);
+    avio_close(pb);
+}
+
+void ff_index_cache_save(AVFormatContext *s)
+{
+    AVIOContext *pb;
+    int64_t size;
+    uint32_t crc;
+    int i, j, len;
+
+    /* nothing new was found since the cache was loaded */
+    if (!cache_usable(s) || count_entries(s) <= s->index_cache_entries)
+        return;
+    if (file_identity(s, &size, &crc) < 0)
+        return;
+    if (avio_open(&pb, s->index_cache, AVIO_FLAG_WRITE) < 0) {
+        av_log(s, AV_LOG_WARNING, "Could not write the index cache %s\n",
+               s->index_cache);
+        return;
+    }
+
+    len = FFMIN(strlen(s->iformat->name), 255);
+    avio_wb32(pb, MKBETAG('F','F','I','C'));
+    avio_w8  (pb, INDEX_CACHE_VERSION);
+    avio_wb64(pb, size);
+    avio_wb32(pb, crc);
+    avio_w8  (pb, len);
+    avio_write(pb, s->iformat->name, len);
+
+    avio_wb32(pb, s->nb_streams);
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+
+        avio_wb32(pb, st->codec->codec_id);
+        avio_wb32(pb, st->time_base.num);
+        avio_wb32(pb, st->time_base.den);
+        avio_wb32(pb, st->nb_index_entries);
+        for (j = 0; j < st->nb_index_entries; j++) {
+            const AVIndexEntry *ie = &st->index_entries[j];
+            avio_wb64(pb, ie->pos);
+            avio_wb64(pb, ie->timestamp);
+            avio_wb32(pb, ie->size);
+            avio_wb32(pb, ie->min_distance);
+            avio_w8  (pb, ie->flags);
+        }
+    }
+    avio_flush(pb);
+    avio_close(pb);
+}
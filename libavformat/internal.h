@@ -69,11 +69,21 @@ int ff_hex_to_data(uint8_t *data, const char *p);
 void ff_program_add_stream_index(AVFormatContext *ac, int progid, unsigned int idx);
 
 /**
- * Add packet to AVFormatContext->packet_buffer list, determining its
- * interleaved position using compare() function argument.
+ * Queue packet for interleaving, see ff_interleave_get_packet().
+ * The queued packets of each stream are kept in the order they were
+ * added, and compare() orders the packets of different streams; it must
+ * be the same for all the packets of a muxer.
+ * @return 0 on success, a negative AVERROR on failure
  */
-void ff_interleave_add_packet(AVFormatContext *s, AVPacket *pkt,
-                              int (*compare)(AVFormatContext *, AVPacket *, AVPacket *));
+int ff_interleave_add_packet(AVFormatContext *s, AVPacket *pkt,
+                             int (*compare)(AVFormatContext *, AVPacket *, AVPacket *));
+
+/**
+ * Take the first packet queued by ff_interleave_add_packet() in
+ * interleaved order.
+ * @return 1 if a packet was output, 0 if none is queued
+ */
+int ff_interleave_get_packet(AVFormatContext *s, AVPacket *out);
 
 void ff_read_frame_flush(AVFormatContext *s);
 
@@ -229,7 +239,7 @@ AVChapter *ff_new_chapter(AVFormatContext *s, int id, AVRational time_base,
 /**
  * Ensure the index uses less memory than the maximum specified in
  * AVFormatContext.max_index_size by discarding entries if it grows
- * too large.
+ * too large. The remaining entries are kept evenly spaced in time.
  */
 void ff_reduce_index(AVFormatContext *s, int stream_index);
 
@@ -246,4 +256,25 @@ void ff_make_absolute_url(char *buf, int size, const char *base,
 
 enum CodecID ff_guess_image2_codec(const char *filename);
 
+/**
+ * Add the entries of AVFormatContext.index_cache to the index of the
+ * streams created since the last call, if the cache matches the input.
+ */
+void ff_index_cache_load(AVFormatContext *s);
+
+/**
+ * Write the index of the streams to AVFormatContext.index_cache if it
+ * grew since it was loaded.
+ */
+void ff_index_cache_save(AVFormatContext *s);
+
+/**
+ * Allocate and read the payload of a packet like av_get_packet(), but
+ * return as soon as some data is available, like ffio_read_partial().
+ * The packet may borrow its data from s, see AVFMT_FLAG_ZEROCOPY.
+ *
+ * @return the size of the packet, or a negative AVERROR
+ */
+int ff_get_partial_packet(AVIOContext *s, AVPacket *pkt, int size);
+
 #endif /* AVFORMAT_INTERNAL_H */
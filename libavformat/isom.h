@@ -87,6 +87,22 @@ typedef struct {
     unsigned flags;
 } MOVTrackExt;
 
+/**
+ * Position of a sample in the sample tables of a track.
+ */
+typedef struct {
+    unsigned int sample;        ///< sample number
+    unsigned int chunk;         ///< chunk the sample is stored in
+    unsigned int chunk_samples; ///< samples left in the chunk, this one included
+    unsigned int stsc_index;
+    unsigned int stts_index;
+    unsigned int stts_sample;
+    unsigned int stss_index;
+    unsigned int stps_index;
+    int64_t pos;                ///< file offset of the sample
+    int64_t dts;                ///< decoding timestamp of the sample
+} MOVSampleCursor;
+
 typedef struct MOVStreamContext {
     AVIOContext *pb;
     int ffindex;          ///< AVStream index
@@ -125,6 +141,9 @@ typedef struct MOVStreamContext {
     int dts_shift;        ///< dts shift when ctts is negative
     uint32_t palette[256];
     int has_palette;
+    unsigned int index_samples; ///< samples looked up from the sample tables, 0 if st->index_entries is used
+    int64_t index_start_dts;    ///< dts of the first of those samples
+    MOVSampleCursor cursor;     ///< position of the last sample looked up
 } MOVStreamContext;
 
 typedef struct MOVContext {
@@ -85,6 +85,7 @@ typedef struct {
     int      size;
     uint8_t *data;
     int64_t  pos;
+    AVBufferRef *buf; ///< buffer data belongs to, only set for blocks
 } EbmlBin;
 
 typedef struct {
@@ -223,6 +224,11 @@ typedef struct {
     uint64_t length;
 } MatroskaLevel;
 
+typedef struct {
+    int64_t  pos;
+    uint64_t timecode;
+} MatroskaClusterPos;
+
 typedef struct {
     AVFormatContext *ctx;
 
@@ -255,6 +261,14 @@ typedef struct {
     /* What to skip before effectively reading a packet. */
     int skip_to_keyframe;
     uint64_t skip_to_timecode;
+
+    /* set when the cues are only to be read at the first seek */
+    int cues_parsing_deferred;
+
+    /* clusters parsed so far, in file order */
+    MatroskaClusterPos *clusters;
+    int num_clusters;
+    unsigned int clusters_size;
 } MatroskaDemuxContext;
 
 typedef struct {
@@ -682,9 +696,18 @@ static int ebml_read_ascii(AVIOContext *pb, int size, char **str)
  * Read the next element as binary data.
  * 0 is success, < 0 is failure.
  */
+static void ebml_free_binary(EbmlBin *bin)
+{
+    if (bin->buf) {
+        av_buffer_unref(&bin->buf);
+        bin->data = NULL;
+    } else
+        av_freep(&bin->data);
+}
+
 static int ebml_read_binary(AVIOContext *pb, int length, EbmlBin *bin)
 {
-    av_free(bin->data);
+    ebml_free_binary(bin);
     if (!(bin->data = av_malloc(length)))
         return AVERROR(ENOMEM);
 
@@ -698,6 +721,60 @@ static int ebml_read_binary(AVIOContext *pb, int length, EbmlBin *bin)
     return 0;
 }
 
+/*
+ * Read a Block or SimpleBlock as binary data, but only skip over its
+ * payload if it belongs to a track that is not demuxed.
+ * 0 is success, < 0 is failure.
+ */
+static int matroska_read_block(MatroskaDemuxContext *matroska, int length,
+                               EbmlBin *bin)
+{
+    MatroskaTrack *tracks = matroska->tracks.elem;
+    AVIOContext *pb = matroska->ctx->pb;
+    int64_t pos = avio_tell(pb);
+    uint8_t head[8];
+    uint64_t num;
+    int i, n, head_size;
+
+    head_size = avio_read(pb, head, FFMIN(length, sizeof(head)));
+    if (head_size != FFMIN(length, sizeof(head)))
+        return AVERROR(EIO);
+
+    /* track number, the rest is left to matroska_parse_block() */
+    if (head_size && head[0] && (n = 8 - ff_log2_tab[head[0]]) <= head_size) {
+        num = head[0] ^ (1 << ff_log2_tab[head[0]]);
+        for (i = 1; i < n; i++)
+            num = (num << 8) | head[i];
+        for (i = 0; i < matroska->tracks.nb_elem; i++)
+            if (tracks[i].num == num) {
+                if (tracks[i].stream &&
+                    tracks[i].stream->discard >= AVDISCARD_ALL) {
+                    ebml_free_binary(bin);
+                    bin->size = 0;
+                    return avio_skip(pb, length - head_size) < 0 ? AVERROR(EIO) : 0;
+                }
+                break;
+            }
+    }
+
+    /* laces are handed out as references to this buffer, so pad it */
+    ebml_free_binary(bin);
+    if (!(bin->buf = av_buffer_alloc(length + FF_INPUT_BUFFER_PADDING_SIZE)))
+        return AVERROR(ENOMEM);
+    memset(bin->buf->data + length, 0, FF_INPUT_BUFFER_PADDING_SIZE);
+
+    bin->data = bin->buf->data;
+    bin->size = length;
+    bin->pos  = pos;
+    memcpy(bin->data, head, head_size);
+    if (avio_read(pb, bin->data + head_size, length - head_size) != length - head_size) {
+        ebml_free_binary(bin);
+        return AVERROR(EIO);
+    }
+
+    return 0;
+}
+
 /*
  * Read the next element, but only the header. The contents
  * are supposed to be sub-elements which can be read separately.
@@ -853,7 +930,11 @@ static int ebml_parse_elem(MatroskaDemuxContext *matroska,
     case EBML_FLOAT: res = ebml_read_float (pb, length, data);  break;
     case EBML_STR:
     case EBML_UTF8:  res = ebml_read_ascii (pb, length, data);  break;
-    case EBML_BIN:   res = ebml_read_binary(pb, length, data);  break;
+    case EBML_BIN:   if (id == MATROSKA_ID_BLOCK || id == MATROSKA_ID_SIMPLEBLOCK)
+                         res = matroska_read_block(matroska, length, data);
+                     else
+                         res = ebml_read_binary(pb, length, data);
+                     break;
     case EBML_NEST:  if ((res=ebml_read_master(matroska, length)) < 0)
                          return res;
                      if (id == MATROSKA_ID_SEGMENT)
@@ -878,7 +959,7 @@ static void ebml_free(EbmlSyntax *syntax, void *data)
         switch (syntax[i].type) {
         case EBML_STR:
         case EBML_UTF8:  av_freep(data_off);                      break;
-        case EBML_BIN:   av_freep(&((EbmlBin *)data_off)->data);  break;
+        case EBML_BIN:   ebml_free_binary(data_off);              break;
         case EBML_NEST:
             if (syntax[i].list_elem_size) {
                 EbmlList *list = data_off;
@@ -1035,6 +1116,7 @@ static int matroska_decode_buffer(uint8_t** buf, int* buf_size,
 static void matroska_fix_ass_packet(MatroskaDemuxContext *matroska,
                                     AVPacket *pkt, uint64_t display_duration)
 {
+    AVBufferRef *buf;
     char *line, *layer, *ptr = pkt->data, *end = ptr+pkt->size;
     for (; *ptr!=',' && ptr<end-1; ptr++);
     if (*ptr == ',')
@@ -1058,7 +1140,12 @@ static void matroska_fix_ass_packet(MatroskaDemuxContext *matroska,
             return;
         snprintf(line,len,"Dialogue: %s,%d:%02d:%02d.%02d,%d:%02d:%02d.%02d,%s\r\n",
                  layer, sh, sm, ss, sc, eh, em, es, ec, ptr);
-        av_free(pkt->data);
+        if (!(buf = av_buffer_create(line, len, NULL, NULL, 0))) {
+            av_free(line);
+            return;
+        }
+        av_buffer_unref(&pkt->buf);
+        pkt->buf  = buf;
         pkt->data = line;
         pkt->size = strlen(line);
     }
@@ -1066,9 +1153,9 @@ static void matroska_fix_ass_packet(MatroskaDemuxContext *matroska,
 
 static void matroska_merge_packets(AVPacket *out, AVPacket *in)
 {
-    out->data = av_realloc(out->data, out->size+in->size);
-    memcpy(out->data+out->size, in->data, in->size);
-    out->size += in->size;
+    int size = out->size;
+    if (av_grow_packet(out, in->size) >= 0)
+        memcpy(out->data + size, in->data, in->size);
     av_destruct_packet(in);
     av_free(in);
 }
@@ -1139,14 +1226,64 @@ static void matroska_convert_tags(AVFormatContext *s)
     }
 }
 
-static void matroska_execute_seekhead(MatroskaDemuxContext *matroska)
+/*
+ * Parse the element a seekhead entry points to and return to the current
+ * position. Returns < 0 if the element cannot be parsed at all.
+ */
+static int matroska_parse_seekhead_entry(MatroskaDemuxContext *matroska, int idx)
 {
-    EbmlList *seekhead_list = &matroska->seekhead;
-    MatroskaSeekhead *seekhead = seekhead_list->elem;
+    MatroskaSeekhead *seekhead = matroska->seekhead.elem;
     uint32_t level_up = matroska->level_up;
     int64_t before_pos = avio_tell(matroska->ctx->pb);
     uint32_t saved_id = matroska->current_id;
+    int64_t offset = seekhead[idx].pos + matroska->segment_start;
     MatroskaLevel level;
+    int ret = 0;
+
+    if (seekhead[idx].id == MATROSKA_ID_SEEKHEAD
+        || seekhead[idx].id == MATROSKA_ID_CLUSTER)
+        return 0;
+
+    /* seek */
+    if (avio_seek(matroska->ctx->pb, offset, SEEK_SET) == offset) {
+        /* We don't want to lose our seekhead level, so we add
+         * a dummy. This is a crude hack. */
+        if (matroska->num_levels == EBML_MAX_DEPTH) {
+            av_log(matroska->ctx, AV_LOG_INFO,
+                   "Max EBML element depth (%d) reached, "
+                   "cannot parse further.\n", EBML_MAX_DEPTH);
+            ret = AVERROR_INVALIDDATA;
+        } else {
+            level.start = 0;
+            level.length = (uint64_t)-1;
+            matroska->levels[matroska->num_levels] = level;
+            matroska->num_levels++;
+            matroska->current_id = 0;
+
+            ebml_parse(matroska, matroska_segment, matroska);
+
+            /* remove dummy level */
+            while (matroska->num_levels) {
+                uint64_t length = matroska->levels[--matroska->num_levels].length;
+                if (length == (uint64_t)-1)
+                    break;
+            }
+        }
+    }
+
+    /* seek back */
+    avio_seek(matroska->ctx->pb, before_pos, SEEK_SET);
+    matroska->level_up = level_up;
+    matroska->current_id = saved_id;
+
+    return ret;
+}
+
+static void matroska_execute_seekhead(MatroskaDemuxContext *matroska)
+{
+    EbmlList *seekhead_list = &matroska->seekhead;
+    MatroskaSeekhead *seekhead = seekhead_list->elem;
+    int64_t before_pos = avio_tell(matroska->ctx->pb);
     int i;
 
     // we should not do any seeking in the streaming case
@@ -1155,46 +1292,62 @@ static void matroska_execute_seekhead(MatroskaDemuxContext *matroska)
         return;
 
     for (i=0; i<seekhead_list->nb_elem; i++) {
-        int64_t offset = seekhead[i].pos + matroska->segment_start;
-
-        if (seekhead[i].pos <= before_pos
-            || seekhead[i].id == MATROSKA_ID_SEEKHEAD
-            || seekhead[i].id == MATROSKA_ID_CLUSTER)
+        if (seekhead[i].pos <= before_pos)
             continue;
 
-        /* seek */
-        if (avio_seek(matroska->ctx->pb, offset, SEEK_SET) != offset)
+        /* the cues are usually at the end of the file and can be large,
+         * only read them when seeking needs them */
+        if (seekhead[i].id == MATROSKA_ID_CUES) {
+            matroska->cues_parsing_deferred = 1;
             continue;
-
-        /* We don't want to lose our seekhead level, so we add
-         * a dummy. This is a crude hack. */
-        if (matroska->num_levels == EBML_MAX_DEPTH) {
-            av_log(matroska->ctx, AV_LOG_INFO,
-                   "Max EBML element depth (%d) reached, "
-                   "cannot parse further.\n", EBML_MAX_DEPTH);
-            break;
         }
 
-        level.start = 0;
-        level.length = (uint64_t)-1;
-        matroska->levels[matroska->num_levels] = level;
-        matroska->num_levels++;
-        matroska->current_id = 0;
+        if (matroska_parse_seekhead_entry(matroska, i) < 0)
+            break;
+    }
+}
 
-        ebml_parse(matroska, matroska_segment, matroska);
+static void matroska_add_index_entries(MatroskaDemuxContext *matroska)
+{
+    EbmlList *index_list = &matroska->index;
+    MatroskaIndex *index = index_list->elem;
+    int index_scale = 1;
+    int i, j;
 
-        /* remove dummy level */
-        while (matroska->num_levels) {
-            uint64_t length = matroska->levels[--matroska->num_levels].length;
-            if (length == (uint64_t)-1)
-                break;
+    if (index_list->nb_elem
+        && index[0].time > 100000000000000/matroska->time_scale) {
+        av_log(matroska->ctx, AV_LOG_WARNING, "Working around broken index.\n");
+        index_scale = matroska->time_scale;
+    }
+    for (i=0; i<index_list->nb_elem; i++) {
+        EbmlList *pos_list = &index[i].pos;
+        MatroskaIndexPos *pos = pos_list->elem;
+        for (j=0; j<pos_list->nb_elem; j++) {
+            MatroskaTrack *track = matroska_find_track_by_num(matroska,
+                                                              pos[j].track);
+            if (track && track->stream)
+                av_add_index_entry(track->stream,
+                                   pos[j].pos + matroska->segment_start,
+                                   index[i].time/index_scale, 0, 0,
+                                   AVINDEX_KEYFRAME);
         }
     }
+}
 
-    /* seek back */
-    avio_seek(matroska->ctx->pb, before_pos, SEEK_SET);
-    matroska->level_up = level_up;
-    matroska->current_id = saved_id;
+static void matroska_parse_cues(MatroskaDemuxContext *matroska)
+{
+    EbmlList *seekhead_list = &matroska->seekhead;
+    MatroskaSeekhead *seekhead = seekhead_list->elem;
+    int i;
+
+    matroska->cues_parsing_deferred = 0;
+    for (i = 0; i < seekhead_list->nb_elem; i++)
+        if (seekhead[i].id == MATROSKA_ID_CUES &&
+            seekhead[i].pos != (uint64_t)-1) {
+            matroska_parse_seekhead_entry(matroska, i);
+            break;
+        }
+    matroska_add_index_entries(matroska);
 }
 
 static int matroska_aac_profile(char *codec_id)
@@ -1226,9 +1379,6 @@ static int matroska_read_header(AVFormatContext *s, AVFormatParameters *ap)
     EbmlList *chapters_list = &matroska->chapters;
     MatroskaChapter *chapters;
     MatroskaTrack *tracks;
-    EbmlList *index_list;
-    MatroskaIndex *index;
-    int index_scale = 1;
     uint64_t max_start = 0;
     Ebml ebml = { 0 };
     AVStream *st;
@@ -1587,26 +1737,7 @@ static int matroska_read_header(AVFormatContext *s, AVFormatParameters *ap)
             max_start = chapters[i].start;
         }
 
-    index_list = &matroska->index;
-    index = index_list->elem;
-    if (index_list->nb_elem
-        && index[0].time > 100000000000000/matroska->time_scale) {
-        av_log(matroska->ctx, AV_LOG_WARNING, "Working around broken index.\n");
-        index_scale = matroska->time_scale;
-    }
-    for (i=0; i<index_list->nb_elem; i++) {
-        EbmlList *pos_list = &index[i].pos;
-        MatroskaIndexPos *pos = pos_list->elem;
-        for (j=0; j<pos_list->nb_elem; j++) {
-            MatroskaTrack *track = matroska_find_track_by_num(matroska,
-                                                              pos[j].track);
-            if (track && track->stream)
-                av_add_index_entry(track->stream,
-                                   pos[j].pos + matroska->segment_start,
-                                   index[i].time/index_scale, 0, 0,
-                                   AVINDEX_KEYFRAME);
-        }
-    }
+    matroska_add_index_entries(matroska);
 
     matroska_convert_tags(s);
 
@@ -1655,7 +1786,8 @@ static void matroska_clear_queue(MatroskaDemuxContext *matroska)
     }
 }
 
-static int matroska_parse_block(MatroskaDemuxContext *matroska, uint8_t *data,
+static int matroska_parse_block(MatroskaDemuxContext *matroska, AVBufferRef *buf,
+                                uint8_t *data,
                                 int size, int64_t pos, uint64_t cluster_time,
                                 uint64_t duration, int is_keyframe,
                                 int64_t cluster_pos)
@@ -1852,18 +1984,49 @@ static int matroska_parse_block(MatroskaDemuxContext *matroska, uint8_t *data,
                 }
 
                 pkt = av_mallocz(sizeof(AVPacket));
-                /* XXX: prevent data copy... */
-                if (av_new_packet(pkt, pkt_size+offset) < 0) {
-                    av_free(pkt);
-                    res = AVERROR(ENOMEM);
-                    break;
-                }
-                if (offset)
-                    memcpy (pkt->data, encodings->compression.settings.data, offset);
-                memcpy (pkt->data+offset, pkt_data, pkt_size);
+                if (!offset && pkt_data == data && buf &&
+                    st->codec->codec_id != CODEC_ID_SSA) {
+                    /* reference the lace in the block, the SSA code below
+                     * edits the data in place so it gets its own copy */
+                    av_init_packet(pkt);
+                    if (!(pkt->buf = av_buffer_ref(buf))) {
+                        av_free(pkt);
+                        res = AVERROR(ENOMEM);
+                        break;
+                    }
+                    pkt->data     = pkt_data;
+                    pkt->size     = pkt_size;
+                    pkt->destruct = av_destruct_packet;
+                } else if (!offset && pkt_data != data) {
+                    /* take over the decompressed data */
+                    uint8_t *tmp = av_realloc(pkt_data, pkt_size + FF_INPUT_BUFFER_PADDING_SIZE);
+                    av_init_packet(pkt);
+                    if (tmp)
+                        pkt->buf = av_buffer_create(tmp, pkt_size + FF_INPUT_BUFFER_PADDING_SIZE,
+                                                    NULL, NULL, 0);
+                    if (!pkt->buf) {
+                        av_free(tmp ? tmp : pkt_data);
+                        av_free(pkt);
+                        res = AVERROR(ENOMEM);
+                        break;
+                    }
+                    memset(tmp + pkt_size, 0, FF_INPUT_BUFFER_PADDING_SIZE);
+                    pkt->data     = tmp;
+                    pkt->size     = pkt_size;
+                    pkt->destruct = av_destruct_packet;
+                } else {
+                    if (av_new_packet(pkt, pkt_size+offset) < 0) {
+                        av_free(pkt);
+                        res = AVERROR(ENOMEM);
+                        break;
+                    }
+                    if (offset)
+                        memcpy (pkt->data, encodings->compression.settings.data, offset);
+                    memcpy (pkt->data+offset, pkt_data, pkt_size);
 
-                if (pkt_data != data)
-                    av_free(pkt_data);
+                    if (pkt_data != data)
+                        av_free(pkt_data);
+                }
 
                 if (n == 0)
                     pkt->flags = is_keyframe;
@@ -1905,6 +2068,41 @@ static int matroska_parse_block(MatroskaDemuxContext *matroska, uint8_t *data,
     return res;
 }
 
+static void matroska_add_cluster(MatroskaDemuxContext *matroska, int64_t pos,
+                                 uint64_t timecode)
+{
+    MatroskaClusterPos *clusters;
+
+    if (matroska->num_clusters >= INT_MAX / sizeof(*clusters) - 1)
+        return;
+    clusters = av_fast_realloc(matroska->clusters, &matroska->clusters_size,
+                               (matroska->num_clusters + 1) * sizeof(*clusters));
+    if (!clusters)
+        return;
+    matroska->clusters = clusters;
+    clusters[matroska->num_clusters].pos      = pos;
+    clusters[matroska->num_clusters].timecode = timecode;
+    matroska->num_clusters++;
+}
+
+/*
+ * Find the last cluster already parsed that starts before timecode.
+ */
+static MatroskaClusterPos *matroska_find_cluster(MatroskaDemuxContext *matroska,
+                                                 uint64_t timecode)
+{
+    int a = -1, b = matroska->num_clusters;
+
+    while (b - a > 1) {
+        int m = (a + b) >> 1;
+        if (matroska->clusters[m].timecode <= timecode)
+            a = m;
+        else
+            b = m;
+    }
+    return a >= 0 ? &matroska->clusters[a] : NULL;
+}
+
 static int matroska_parse_cluster(MatroskaDemuxContext *matroska)
 {
     MatroskaCluster cluster = { 0 };
@@ -1918,10 +2116,13 @@ static int matroska_parse_cluster(MatroskaDemuxContext *matroska)
     res = ebml_parse(matroska, matroska_clusters, &cluster);
     blocks_list = &cluster.blocks;
     blocks = blocks_list->elem;
+    if (blocks_list->nb_elem &&
+        (!matroska->num_clusters || pos > matroska->clusters[matroska->num_clusters-1].pos))
+        matroska_add_cluster(matroska, pos, cluster.timecode);
     for (i=0; i<blocks_list->nb_elem; i++)
         if (blocks[i].bin.size > 0 && blocks[i].bin.data) {
             int is_keyframe = blocks[i].non_simple ? !blocks[i].reference : -1;
-            res=matroska_parse_block(matroska,
+            res=matroska_parse_block(matroska, blocks[i].bin.buf,
                                      blocks[i].bin.data, blocks[i].bin.size,
                                      blocks[i].bin.pos,  cluster.timecode,
                                      blocks[i].duration, is_keyframe,
@@ -1951,14 +2152,24 @@ static int matroska_read_seek(AVFormatContext *s, int stream_index,
     MatroskaDemuxContext *matroska = s->priv_data;
     MatroskaTrack *tracks = matroska->tracks.elem;
     AVStream *st = s->streams[stream_index];
+    MatroskaClusterPos *cluster;
     int i, index, index_sub, index_min;
 
+    /* read the cues if they were skipped in read_header */
+    if (matroska->cues_parsing_deferred)
+        matroska_parse_cues(matroska);
+
     if (!st->nb_index_entries)
         return 0;
     timestamp = FFMAX(timestamp, st->index_entries[0].timestamp);
 
     if ((index = av_index_search_timestamp(st, timestamp, flags)) < 0) {
-        avio_seek(s->pb, st->index_entries[st->nb_index_entries-1].pos, SEEK_SET);
+        int64_t pos = st->index_entries[st->nb_index_entries-1].pos;
+        /* do not parse again clusters that were already read */
+        cluster = matroska_find_cluster(matroska, timestamp);
+        if (cluster && cluster->pos > pos)
+            pos = cluster->pos;
+        avio_seek(s->pb, pos, SEEK_SET);
         while ((index = av_index_search_timestamp(st, timestamp, flags)) < 0) {
             matroska_clear_queue(matroska);
             if (matroska_parse_cluster(matroska) < 0)
@@ -2006,6 +2217,7 @@ static int matroska_read_close(AVFormatContext *s)
         if (tracks[n].type == MATROSKA_TRACK_TYPE_AUDIO)
             av_free(tracks[n].audio.buf);
     ebml_free(matroska_segment, matroska);
+    av_freep(&matroska->clusters);
 
     return 0;
 }
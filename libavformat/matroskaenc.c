@@ -31,6 +31,7 @@
 #include "libavutil/random_seed.h"
 #include "libavutil/lfg.h"
 #include "libavutil/dict.h"
+#include "libavutil/opt.h"
 #include "libavcodec/xiph.h"
 #include "libavcodec/mpeg4audio.h"
 #include <strings.h>
@@ -74,6 +75,7 @@ typedef struct {
 #define MODE_WEBM       0x02
 
 typedef struct MatroskaMuxContext {
+    const AVClass  *class;
     int             mode;
     AVIOContext   *dyn_bc;
     ebml_master     segment;
@@ -89,6 +91,9 @@ typedef struct MatroskaMuxContext {
 
     unsigned int    audio_buffer_size;
     AVPacket        cur_audio_pkt;
+
+    int             live;               ///< set by a private option
+    int             is_live;            ///< live option set or output not seekable
 } MatroskaMuxContext;
 
 
@@ -813,6 +818,10 @@ static int mkv_write_header(AVFormatContext *s)
     if (!strcmp(s->oformat->name, "webm")) mkv->mode = MODE_WEBM;
     else                                   mkv->mode = MODE_MATROSKAv2;
 
+    // nothing written before the current cluster is ever updated in
+    // live mode, so the output needs neither seeking nor a cue index
+    mkv->is_live = mkv->live || !s->pb->seekable;
+
     mkv->tracks = av_mallocz(s->nb_streams * sizeof(*mkv->tracks));
     if (!mkv->tracks)
         return AVERROR(ENOMEM);
@@ -877,8 +886,10 @@ static int mkv_write_header(AVFormatContext *s)
         if (ret < 0) return ret;
     }
 
-    if (!s->pb->seekable)
+    if (mkv->is_live) {
         mkv_write_seekhead(pb, mkv->main_seekhead);
+        mkv->main_seekhead = NULL;
+    }
 
     mkv->cues = mkv_start_cues(mkv->segment_offset);
     if (mkv->cues == NULL)
@@ -1053,7 +1064,7 @@ static int mkv_write_packet_internal(AVFormatContext *s, AVPacket *pkt)
         return AVERROR(EINVAL);
     }
 
-    if (!s->pb->seekable) {
+    if (mkv->is_live) {
         if (!mkv->dyn_bc)
             avio_open_dyn_buf(&mkv->dyn_bc);
         pb = mkv->dyn_bc;
@@ -1080,7 +1091,7 @@ static int mkv_write_packet_internal(AVFormatContext *s, AVPacket *pkt)
         end_ebml_master(pb, blockgroup);
     }
 
-    if (codec->codec_type == AVMEDIA_TYPE_VIDEO && keyframe) {
+    if (codec->codec_type == AVMEDIA_TYPE_VIDEO && keyframe && !mkv->is_live) {
         ret = mkv_add_cuepoint(mkv->cues, pkt->stream_index, ts, mkv->cluster_pos);
         if (ret < 0) return ret;
     }
@@ -1093,6 +1104,7 @@ static int mkv_copy_packet(MatroskaMuxContext *mkv, const AVPacket *pkt)
 {
     uint8_t *data           = mkv->cur_audio_pkt.data;
     mkv->cur_audio_pkt      = *pkt;
+    mkv->cur_audio_pkt.buf  = NULL;
     mkv->cur_audio_pkt.data = av_fast_realloc(data, &mkv->audio_buffer_size, pkt->size);
     if (!mkv->cur_audio_pkt.data)
         return AVERROR(ENOMEM);
@@ -1105,24 +1117,26 @@ static int mkv_copy_packet(MatroskaMuxContext *mkv, const AVPacket *pkt)
 static int mkv_write_packet(AVFormatContext *s, AVPacket *pkt)
 {
     MatroskaMuxContext *mkv = s->priv_data;
-    AVIOContext *pb = s->pb->seekable ? s->pb : mkv->dyn_bc;
+    AVIOContext *pb = mkv->is_live ? mkv->dyn_bc : s->pb;
     AVCodecContext *codec = s->streams[pkt->stream_index]->codec;
     int ret, keyframe = !!(pkt->flags & AV_PKT_FLAG_KEY);
     int64_t ts = mkv->tracks[pkt->stream_index].write_dts ? pkt->dts : pkt->pts;
-    int cluster_size = avio_tell(pb) - (s->pb->seekable ? mkv->cluster_pos : 0);
+    int cluster_size = avio_tell(pb) - (mkv->is_live ? 0 : mkv->cluster_pos);
 
     // start a new cluster every 5 MB or 5 sec, or 32k / 1 sec for streaming or
     // after 4k and on a keyframe
     if (mkv->cluster_pos &&
-        ((!s->pb->seekable && (cluster_size > 32*1024 || ts > mkv->cluster_pts + 1000))
+        ((mkv->is_live && (cluster_size > 32*1024 || ts > mkv->cluster_pts + 1000))
          ||                      cluster_size > 5*1024*1024 || ts > mkv->cluster_pts + 5000
          || (codec->codec_type == AVMEDIA_TYPE_VIDEO && keyframe && cluster_size > 4*1024))) {
         av_log(s, AV_LOG_DEBUG, "Starting new cluster at offset %" PRIu64
                " bytes, pts %" PRIu64 "\n", avio_tell(pb), ts);
         end_ebml_master(pb, mkv->cluster);
         mkv->cluster_pos = 0;
-        if (mkv->dyn_bc)
+        if (mkv->dyn_bc) {
             mkv_flush_dynbuf(s);
+            avio_flush(s->pb);
+        }
     }
 
     // check if we have an audio packet cached
@@ -1168,7 +1182,7 @@ static int mkv_write_trailer(AVFormatContext *s)
         end_ebml_master(pb, mkv->cluster);
     }
 
-    if (pb->seekable) {
+    if (!mkv->is_live) {
         if (mkv->cues->num_entries) {
             cuespos = mkv_write_cues(pb, mkv->cues, s->nb_streams);
 
@@ -1185,9 +1199,10 @@ static int mkv_write_trailer(AVFormatContext *s)
         put_ebml_float(pb, MATROSKA_ID_DURATION, mkv->duration);
 
         avio_seek(pb, currentpos, SEEK_SET);
+
+        end_ebml_master(pb, mkv->segment);
     }
 
-    end_ebml_master(pb, mkv->segment);
     av_free(mkv->tracks);
     av_freep(&mkv->cues->entries);
     av_freep(&mkv->cues);
@@ -1196,7 +1211,21 @@ static int mkv_write_trailer(AVFormatContext *s)
     return 0;
 }
 
+static const AVOption options[] = {
+    { "live", "Write a stream that never needs seeking back: unknown segment size, no cues", offsetof(MatroskaMuxContext, live), FF_OPT_TYPE_INT, {.dbl = 0}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM },
+    { NULL },
+};
+
+#define MKV_CLASS(flavor)\
+static const AVClass flavor ## _class = {\
+    .class_name = #flavor " muxer",\
+    .item_name  = av_default_item_name,\
+    .option     = options,\
+    .version    = LIBAVUTIL_VERSION_INT,\
+};
+
 #if CONFIG_MATROSKA_MUXER
+MKV_CLASS(matroska)
 AVOutputFormat ff_matroska_muxer = {
     "matroska",
     NULL_IF_CONFIG_SMALL("Matroska file format"),
@@ -1211,10 +1240,12 @@ AVOutputFormat ff_matroska_muxer = {
     .flags = AVFMT_GLOBALHEADER | AVFMT_VARIABLE_FPS,
     .codec_tag = (const AVCodecTag* const []){ff_codec_bmp_tags, ff_codec_wav_tags, 0},
     .subtitle_codec = CODEC_ID_TEXT,
+    .priv_class = &matroska_class,
 };
 #endif
 
 #if CONFIG_WEBM_MUXER
+MKV_CLASS(webm)
 AVOutputFormat ff_webm_muxer = {
     "webm",
     NULL_IF_CONFIG_SMALL("WebM file format"),
@@ -1227,10 +1258,12 @@ AVOutputFormat ff_webm_muxer = {
     mkv_write_packet,
     mkv_write_trailer,
     .flags = AVFMT_GLOBALHEADER | AVFMT_VARIABLE_FPS | AVFMT_TS_NONSTRICT,
+    .priv_class = &webm_class,
 };
 #endif
 
 #if CONFIG_MATROSKA_AUDIO_MUXER
+MKV_CLASS(mka)
 AVOutputFormat ff_matroska_audio_muxer = {
     "matroska",
     NULL_IF_CONFIG_SMALL("Matroska file format"),
@@ -1244,5 +1277,6 @@ AVOutputFormat ff_matroska_audio_muxer = {
     mkv_write_trailer,
     .flags = AVFMT_GLOBALHEADER,
     .codec_tag = (const AVCodecTag* const []){ff_codec_wav_tags, 0},
+    .priv_class = &mka_class,
 };
 #endif
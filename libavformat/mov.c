@@ -1523,6 +1523,321 @@ static int mov_read_ctts(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     return 0;
 }
 
+static unsigned int mov_sample_size(MOVStreamContext *sc, unsigned int sample)
+{
+    return sc->sample_size > 0 ? sc->sample_size : sc->sample_sizes[sample];
+}
+
+static int mov_key_off(MOVStreamContext *sc)
+{
+    return sc->keyframes && sc->keyframes[0] == 1;
+}
+
+/**
+ * Find the first entry of a sorted sync sample table not smaller than val.
+ * @return entry index, count if there is none
+ */
+static unsigned int mov_sync_lower_bound(const unsigned *tab, unsigned int count,
+                                         unsigned int val)
+{
+    unsigned int a = 0, b = count;
+
+    while (a < b) {
+        unsigned int m = (a + b) >> 1;
+        if (tab[m] < val)
+            a = m + 1;
+        else
+            b = m;
+    }
+    return a;
+}
+
+static int mov_cursor_keyframe(MOVStreamContext *sc, MOVSampleCursor *cur)
+{
+    unsigned int n = cur->sample + mov_key_off(sc);
+
+    return !sc->keyframe_count || n == (unsigned)sc->keyframes[cur->stss_index] ||
+           (sc->stps_count && n == sc->stps_data[cur->stps_index]);
+}
+
+/**
+ * Move the cursor to the sample following it, the same way mov_build_index()
+ * walks the sample tables.
+ */
+static void mov_cursor_next(MOVStreamContext *sc, MOVSampleCursor *cur)
+{
+    unsigned int n = cur->sample + mov_key_off(sc);
+
+    if (sc->keyframe_count) {
+        if (n == (unsigned)sc->keyframes[cur->stss_index]) {
+            if (cur->stss_index + 1 < sc->keyframe_count)
+                cur->stss_index++;
+        } else if (sc->stps_count && n == sc->stps_data[cur->stps_index]) {
+            if (cur->stps_index + 1 < sc->stps_count)
+                cur->stps_index++;
+        }
+    }
+
+    cur->pos += mov_sample_size(sc, cur->sample);
+    cur->dts += sc->stts_data[cur->stts_index].duration;
+    cur->stts_sample++;
+    if (cur->stts_index + 1 < sc->stts_count &&
+        cur->stts_sample == sc->stts_data[cur->stts_index].count) {
+        cur->stts_sample = 0;
+        cur->stts_index++;
+    }
+    cur->sample++;
+
+    if (--cur->chunk_samples)
+        return;
+    do {
+        if (++cur->chunk >= sc->chunk_count)
+            return;
+        while (cur->stsc_index + 1 < sc->stsc_count &&
+               cur->chunk + 1 == sc->stsc_data[cur->stsc_index + 1].first)
+            cur->stsc_index++;
+    } while (!sc->stsc_data[cur->stsc_index].count);
+    cur->chunk_samples = sc->stsc_data[cur->stsc_index].count;
+    cur->pos = sc->chunk_offsets[cur->chunk];
+}
+
+/**
+ * Position the cursor on an arbitrary sample.
+ * Only valid once mov_check_sample_tables() accepted the tables.
+ */
+static void mov_cursor_seek(MOVStreamContext *sc, MOVSampleCursor *cur, unsigned int sample)
+{
+    unsigned int i, first = 0, key_off = mov_key_off(sc);
+
+    cur->sample = sample;
+
+    cur->dts = sc->index_start_dts;
+    for (i = 0; i < sc->stts_count; i++) {
+        unsigned int count = sc->stts_data[i].count;
+        if (sample - first < count || i + 1 == sc->stts_count) {
+            cur->stts_index  = i;
+            cur->stts_sample = sample - first;
+            cur->dts += (int64_t)(sample - first) * sc->stts_data[i].duration;
+            break;
+        }
+        cur->dts += (int64_t)count * sc->stts_data[i].duration;
+        first += count;
+    }
+
+    first = 0;
+    for (i = 0; i < sc->stsc_count; i++) {
+        unsigned int count = sc->stsc_data[i].count;
+        unsigned int next  = i + 1 < sc->stsc_count ? sc->stsc_data[i + 1].first - 1 :
+                                                      sc->chunk_count;
+        uint64_t samples = (uint64_t)(next - (sc->stsc_data[i].first - 1)) * count;
+        if (sample - first < samples) {
+            unsigned int j, skip = (sample - first) % count;
+            cur->stsc_index    = i;
+            cur->chunk         = sc->stsc_data[i].first - 1 + (sample - first) / count;
+            cur->chunk_samples = count - skip;
+            cur->pos           = sc->chunk_offsets[cur->chunk];
+            if (sc->sample_size > 0)
+                cur->pos += (int64_t)skip * sc->sample_size;
+            else
+                for (j = sample - skip; j < sample; j++)
+                    cur->pos += sc->sample_sizes[j];
+            break;
+        }
+        first += samples;
+    }
+
+    cur->stss_index = FFMIN(mov_sync_lower_bound((const unsigned *)sc->keyframes, sc->keyframe_count,
+                                                 sample + key_off),
+                            FFMAX(sc->keyframe_count, 1) - 1);
+    cur->stps_index = FFMIN(mov_sync_lower_bound(sc->stps_data, sc->stps_count,
+                                                 sample + key_off),
+                            FFMAX(sc->stps_count, 1) - 1);
+}
+
+/**
+ * Check that samples can be looked up directly from the sample tables,
+ * i.e. that walking them sample by sample gives the same result as the
+ * random access done by mov_cursor_seek().
+ * @return number of samples, 0 if the tables are not suitable
+ */
+static unsigned int mov_check_sample_tables(MOVStreamContext *sc)
+{
+    uint64_t samples = 0;
+    unsigned int i;
+
+    if (!sc->chunk_count || !sc->stsc_count || !sc->stts_count ||
+        (!sc->sample_size && !sc->sample_sizes) ||
+        sc->stsc_data[0].first != 1)
+        return 0;
+    for (i = 0; i < sc->stsc_count; i++) {
+        if (sc->stsc_data[i].first > sc->chunk_count ||
+            (i && sc->stsc_data[i].first <= sc->stsc_data[i - 1].first) ||
+            (sc->pseudo_stream_id != -1 &&
+             sc->stsc_data[i].id - 1 != sc->pseudo_stream_id))
+            return 0;
+        samples += (uint64_t)((i + 1 < sc->stsc_count ? sc->stsc_data[i + 1].first - 1 :
+                                                        sc->chunk_count) -
+                              (sc->stsc_data[i].first - 1)) * sc->stsc_data[i].count;
+    }
+    for (i = 0; i < sc->stts_count; i++)
+        if (sc->stts_data[i].count <= 0 || sc->stts_data[i].duration <= 0)
+            return 0;
+    for (i = 1; i < sc->keyframe_count; i++)
+        if ((unsigned)sc->keyframes[i] <= (unsigned)sc->keyframes[i - 1])
+            return 0;
+    for (i = 1; i < sc->stps_count; i++)
+        if (sc->stps_data[i] <= sc->stps_data[i - 1])
+            return 0;
+    /* the walk gets stuck on partial sync samples it cannot match */
+    if (sc->keyframe_count && sc->stps_count) {
+        unsigned int k = 0, p = 0;
+        if (sc->stps_data[0] < mov_key_off(sc))
+            return 0;
+        while (k < sc->keyframe_count && p < sc->stps_count) {
+            if ((unsigned)sc->keyframes[k] == sc->stps_data[p])
+                return 0;
+            if ((unsigned)sc->keyframes[k] < sc->stps_data[p])
+                k++;
+            else
+                p++;
+        }
+    }
+    return FFMIN(samples, sc->sample_count);
+}
+
+/**
+ * Get the current sample of a stream.
+ * @return 0 on success, -1 if there are no samples left
+ */
+static int mov_current_sample(AVStream *st, AVIndexEntry *sample)
+{
+    MOVStreamContext *sc = st->priv_data;
+    MOVSampleCursor *cur = &sc->cursor;
+
+    if (!sc->index_samples) {
+        if (sc->current_sample >= st->nb_index_entries)
+            return -1;
+        *sample = st->index_entries[sc->current_sample];
+        return 0;
+    }
+
+    if ((unsigned)sc->current_sample >= sc->index_samples)
+        return -1;
+    if (cur->sample + 1 == sc->current_sample)
+        mov_cursor_next(sc, cur);
+    else if (cur->sample != sc->current_sample)
+        mov_cursor_seek(sc, cur, sc->current_sample);
+    sample->pos          = cur->pos;
+    sample->timestamp    = cur->dts;
+    sample->size         = mov_sample_size(sc, cur->sample);
+    sample->min_distance = 0;
+    sample->flags        = mov_cursor_keyframe(sc, cur) ? AVINDEX_KEYFRAME : 0;
+    return 0;
+}
+
+/**
+ * Search the sample tables for a timestamp, with the semantics of
+ * av_index_search_timestamp().
+ */
+static int mov_search_sample(MOVStreamContext *sc, int64_t timestamp, int flags)
+{
+    unsigned int i, first = 0, n = sc->index_samples;
+    int64_t dts = sc->index_start_dts;
+    int a = n - 1, b = n, m;
+
+    for (i = 0; i < sc->stts_count && first < n; i++) {
+        unsigned int count = i + 1 < sc->stts_count ?
+                             FFMIN(sc->stts_data[i].count, n - first) : n - first;
+        int duration = sc->stts_data[i].duration;
+        if (timestamp < dts) {
+            a = first - 1;
+            b = first;
+            break;
+        }
+        if (timestamp <= dts + (int64_t)(count - 1) * duration) {
+            int64_t k = (timestamp - dts) / duration;
+            a = first + k;
+            b = dts + k * duration == timestamp ? a : a + 1;
+            break;
+        }
+        dts   += (int64_t)count * duration;
+        first += count;
+    }
+
+    m = flags & AVSEEK_FLAG_BACKWARD ? a : b;
+    if (!(flags & AVSEEK_FLAG_ANY) && sc->keyframe_count && m >= 0 && m < n) {
+        unsigned int key_off = mov_key_off(sc), k, p;
+        k = mov_sync_lower_bound((const unsigned *)sc->keyframes, sc->keyframe_count, m + key_off);
+        p = mov_sync_lower_bound(sc->stps_data, sc->stps_count, m + key_off);
+        if (flags & AVSEEK_FLAG_BACKWARD) {
+            int64_t key = -1;
+            if (k < sc->keyframe_count && (unsigned)sc->keyframes[k] == m + key_off)
+                k++;
+            if (p < sc->stps_count && sc->stps_data[p] == m + key_off)
+                p++;
+            if (k)
+                key = FFMAX(key, (int64_t)(unsigned)sc->keyframes[k - 1] - key_off);
+            if (p)
+                key = FFMAX(key, (int64_t)sc->stps_data[p - 1] - key_off);
+            m = key;
+        } else {
+            int64_t key = n;
+            if (k < sc->keyframe_count)
+                key = FFMIN(key, (int64_t)(unsigned)sc->keyframes[k] - key_off);
+            if (p < sc->stps_count)
+                key = FFMIN(key, (int64_t)sc->stps_data[p] - key_off);
+            m = key;
+        }
+    }
+    if (m == n)
+        return -1;
+    return m;
+}
+
+/**
+ * Turn the sample tables of a stream into index entries, for the code that
+ * needs st->index_entries, like fragment parsing.
+ */
+static int mov_build_index_entries(AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+    MOVSampleCursor cur;
+    unsigned int i, distance = 0;
+
+    if (!sc->index_samples)
+        return 0;
+    if (sc->index_samples >= UINT_MAX / sizeof(*st->index_entries))
+        return AVERROR(ENOMEM);
+    st->index_entries = av_malloc(sc->index_samples*sizeof(*st->index_entries));
+    if (!st->index_entries)
+        return AVERROR(ENOMEM);
+    st->index_entries_allocated_size = sc->index_samples*sizeof(*st->index_entries);
+
+    mov_cursor_seek(sc, &cur, 0);
+    for (i = 0; i < sc->index_samples; i++) {
+        AVIndexEntry *e = &st->index_entries[i];
+        int keyframe = mov_cursor_keyframe(sc, &cur);
+        if (keyframe)
+            distance = 0;
+        e->pos          = cur.pos;
+        e->timestamp    = cur.dts;
+        e->size         = mov_sample_size(sc, i);
+        e->min_distance = distance++;
+        e->flags        = keyframe ? AVINDEX_KEYFRAME : 0;
+        mov_cursor_next(sc, &cur);
+    }
+    st->nb_index_entries = sc->index_samples;
+    sc->index_samples = 0;
+
+    av_freep(&sc->chunk_offsets);
+    av_freep(&sc->stsc_data);
+    av_freep(&sc->sample_sizes);
+    av_freep(&sc->keyframes);
+    av_freep(&sc->stts_data);
+    av_freep(&sc->stps_data);
+    return 0;
+}
+
 static void mov_build_index(MOVContext *mov, AVStream *st)
 {
     MOVStreamContext *sc = st->priv_data;
@@ -1560,6 +1875,21 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
 
         current_dts -= sc->dts_shift;
 
+        /* look samples up from the sample tables instead of keeping an
+           index entry per sample when the tables allow it */
+        if ((sc->index_samples = mov_check_sample_tables(sc))) {
+            sc->index_start_dts = current_dts;
+            mov_cursor_seek(sc, &sc->cursor, 0);
+            if (sc->sample_size > 0)
+                stream_size = (uint64_t)sc->index_samples * sc->sample_size;
+            else
+                for (i = 0; i < sc->index_samples; i++)
+                    stream_size += sc->sample_sizes[i];
+            if (st->duration > 0)
+                st->codec->bit_rate = stream_size*8*sc->time_scale/st->duration;
+            return;
+        }
+
         if (sc->sample_count >= UINT_MAX / sizeof(*st->index_entries))
             return;
         st->index_entries = av_malloc(sc->sample_count*sizeof(*st->index_entries));
@@ -1834,7 +2164,9 @@ static int mov_read_trak(MOVContext *c, AVIOContext *pb, MOVAtom atom)
         break;
     }
 
-    /* Do not need those anymore. */
+    /* Do not need those anymore, unless samples are looked up from them. */
+    if (sc->index_samples)
+        return 0;
     av_freep(&sc->chunk_offsets);
     av_freep(&sc->stsc_data);
     av_freep(&sc->sample_sizes);
@@ -2027,7 +2359,7 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     int64_t dts;
     int data_offset = 0;
     unsigned entries, first_sample_flags = frag->flags;
-    int flags, distance, i;
+    int flags, distance, i, ret;
 
     for (i = 0; i < c->fc->nb_streams; i++) {
         if (c->fc->streams[i]->id == frag->track_id) {
@@ -2042,6 +2374,8 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     sc = st->priv_data;
     if (sc->pseudo_stream_id+1 != frag->stsd_id)
         return 0;
+    if ((ret = mov_build_index_entries(st)) < 0)
+        return ret;
     avio_r8(pb); /* version */
     flags = avio_rb24(pb);
     entries = avio_rb32(pb);
@@ -2351,6 +2685,8 @@ static void mov_read_chapters(AVFormatContext *s)
 
     st->discard = AVDISCARD_ALL;
     sc = st->priv_data;
+    if (mov_build_index_entries(st) < 0)
+        return;
     cur_pos = avio_tell(sc->pb);
 
     for (i = 0; i < st->nb_index_entries; i++) {
@@ -2401,6 +2737,8 @@ static int mov_read_header(AVFormatContext *s, AVFormatParameters *ap)
     MOVAtom atom = { AV_RL32("root") };
 
     mov->fc = s;
+    if (s->flags & AVFMT_FLAG_ZEROCOPY)
+        ffio_enable_lending(pb);
     /* .mov and .mp4 aren't streamable anyway (only progressive download if moov is before mdat) */
     if(pb->seekable)
         atom.size = avio_size(pb);
@@ -2424,42 +2762,41 @@ static int mov_read_header(AVFormatContext *s, AVFormatParameters *ap)
     return 0;
 }
 
-static AVIndexEntry *mov_find_next_sample(AVFormatContext *s, AVStream **st)
+static int mov_find_next_sample(AVFormatContext *s, AVStream **st, AVIndexEntry *sample)
 {
-    AVIndexEntry *sample = NULL;
+    AVIndexEntry current_sample;
     int64_t best_dts = INT64_MAX;
-    int i;
+    int i, found = 0;
     for (i = 0; i < s->nb_streams; i++) {
         AVStream *avst = s->streams[i];
         MOVStreamContext *msc = avst->priv_data;
-        if (msc->pb && msc->current_sample < avst->nb_index_entries) {
-            AVIndexEntry *current_sample = &avst->index_entries[msc->current_sample];
-            int64_t dts = av_rescale(current_sample->timestamp, AV_TIME_BASE, msc->time_scale);
+        if (msc->pb && !mov_current_sample(avst, &current_sample)) {
+            int64_t dts = av_rescale(current_sample.timestamp, AV_TIME_BASE, msc->time_scale);
             av_dlog(s, "stream %d, sample %d, dts %"PRId64"\n", i, msc->current_sample, dts);
-            if (!sample || (!s->pb->seekable && current_sample->pos < sample->pos) ||
+            if (!found || (!s->pb->seekable && current_sample.pos < sample->pos) ||
                 (s->pb->seekable &&
                  ((msc->pb != s->pb && dts < best_dts) || (msc->pb == s->pb &&
-                 ((FFABS(best_dts - dts) <= AV_TIME_BASE && current_sample->pos < sample->pos) ||
+                 ((FFABS(best_dts - dts) <= AV_TIME_BASE && current_sample.pos < sample->pos) ||
                   (FFABS(best_dts - dts) > AV_TIME_BASE && dts < best_dts)))))) {
-                sample = current_sample;
+                *sample = current_sample;
+                found = 1;
                 best_dts = dts;
                 *st = avst;
             }
         }
     }
-    return sample;
+    return found ? 0 : -1;
 }
 
 static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
 {
     MOVContext *mov = s->priv_data;
     MOVStreamContext *sc;
-    AVIndexEntry *sample;
+    AVIndexEntry sample, next;
     AVStream *st = NULL;
     int ret;
  retry:
-    sample = mov_find_next_sample(s, &st);
-    if (!sample) {
+    if (mov_find_next_sample(s, &st, &sample) < 0) {
         mov->found_mdat = 0;
         if (s->pb->seekable||
             mov_read_default(mov, s->pb, (MOVAtom){ AV_RL32("root"), INT64_MAX }) < 0 ||
@@ -2473,12 +2810,12 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
     sc->current_sample++;
 
     if (st->discard != AVDISCARD_ALL) {
-        if (avio_seek(sc->pb, sample->pos, SEEK_SET) != sample->pos) {
+        if (avio_seek(sc->pb, sample.pos, SEEK_SET) != sample.pos) {
             av_log(mov->fc, AV_LOG_ERROR, "stream %d, offset 0x%"PRIx64": partial file\n",
-                   sc->ffindex, sample->pos);
+                   sc->ffindex, sample.pos);
             return -1;
         }
-        ret = av_get_packet(sc->pb, pkt, sample->size);
+        ret = av_get_packet(sc->pb, pkt, sample.size);
         if (ret < 0)
             return ret;
         if (sc->has_palette) {
@@ -2494,8 +2831,9 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
         }
 #if CONFIG_DV_DEMUXER
         if (mov->dv_demux && sc->dv_audio_container) {
-            dv_produce_packet(mov->dv_demux, pkt, pkt->data, pkt->size, pkt->pos);
-            av_free(pkt->data);
+            AVPacket dv_pkt = *pkt;
+            dv_produce_packet(mov->dv_demux, pkt, dv_pkt.data, dv_pkt.size, dv_pkt.pos);
+            av_free_packet(&dv_pkt);
             pkt->size = 0;
             ret = dv_get_packet(mov->dv_demux, pkt);
             if (ret < 0)
@@ -2505,7 +2843,7 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
     }
 
     pkt->stream_index = sc->ffindex;
-    pkt->dts = sample->timestamp;
+    pkt->dts = sample.timestamp;
     if (sc->ctts_data) {
         pkt->pts = pkt->dts + sc->dts_shift + sc->ctts_data[sc->ctts_index].duration;
         /* update ctts context */
@@ -2518,15 +2856,14 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
         if (sc->wrong_dts)
             pkt->dts = AV_NOPTS_VALUE;
     } else {
-        int64_t next_dts = (sc->current_sample < st->nb_index_entries) ?
-            st->index_entries[sc->current_sample].timestamp : st->duration;
+        int64_t next_dts = !mov_current_sample(st, &next) ? next.timestamp : st->duration;
         pkt->duration = next_dts - pkt->dts;
         pkt->pts = pkt->dts;
     }
     if (st->discard == AVDISCARD_ALL)
         goto retry;
-    pkt->flags |= sample->flags & AVINDEX_KEYFRAME ? AV_PKT_FLAG_KEY : 0;
-    pkt->pos = sample->pos;
+    pkt->flags |= sample.flags & AVINDEX_KEYFRAME ? AV_PKT_FLAG_KEY : 0;
+    pkt->pos = sample.pos;
     av_dlog(s, "stream %d, pts %"PRId64", dts %"PRId64", pos 0x%"PRIx64", duration %d\n",
             pkt->stream_index, pkt->pts, pkt->dts, pkt->pos, pkt->duration);
     return 0;
@@ -2538,10 +2875,16 @@ static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp,
     int sample, time_sample;
     int i;
 
-    sample = av_index_search_timestamp(st, timestamp, flags);
+    if (sc->index_samples) {
+        sample = mov_search_sample(sc, timestamp, flags);
+        if (sample < 0 && timestamp < sc->index_start_dts)
+            sample = 0;
+    } else {
+        sample = av_index_search_timestamp(st, timestamp, flags);
+        if (sample < 0 && st->nb_index_entries && timestamp < st->index_entries[0].timestamp)
+            sample = 0;
+    }
     av_dlog(s, "stream %d, timestamp %"PRId64", sample %d\n", st->index, timestamp, sample);
-    if (sample < 0 && st->nb_index_entries && timestamp < st->index_entries[0].timestamp)
-        sample = 0;
     if (sample < 0) /* not sure what to do */
         return -1;
     sc->current_sample = sample;
@@ -2565,6 +2908,7 @@ static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp,
 static int mov_read_seek(AVFormatContext *s, int stream_index, int64_t sample_time, int flags)
 {
     AVStream *st;
+    AVIndexEntry e;
     int64_t seek_timestamp, timestamp;
     int sample;
     int i;
@@ -2580,7 +2924,9 @@ static int mov_read_seek(AVFormatContext *s, int stream_index, int64_t sample_ti
         return -1;
 
     /* adjust seek timestamp to found sample timestamp */
-    seek_timestamp = st->index_entries[sample].timestamp;
+    if (mov_current_sample(st, &e) < 0)
+        return -1;
+    seek_timestamp = e.timestamp;
 
     for (i = 0; i < s->nb_streams; i++) {
         st = s->streams[i];
@@ -2603,6 +2949,12 @@ static int mov_read_close(AVFormatContext *s)
         MOVStreamContext *sc = st->priv_data;
 
         av_freep(&sc->ctts_data);
+        av_freep(&sc->chunk_offsets);
+        av_freep(&sc->stsc_data);
+        av_freep(&sc->sample_sizes);
+        av_freep(&sc->keyframes);
+        av_freep(&sc->stts_data);
+        av_freep(&sc->stps_data);
         for (j = 0; j < sc->drefs_count; j++) {
             av_freep(&sc->drefs[j].path);
             av_freep(&sc->drefs[j].dir);
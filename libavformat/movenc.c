@@ -42,7 +42,11 @@
 static const AVOption options[] = {
     { "movflags", "MOV muxer flags", offsetof(MOVMuxContext, flags), FF_OPT_TYPE_FLAGS, {.dbl = 0}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "rtphint", "Add RTP hint tracks", 0, FF_OPT_TYPE_CONST, {.dbl = FF_MOV_FLAG_RTP_HINT}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
+    { "frag_keyframe", "Write fragments starting at video keyframes", 0, FF_OPT_TYPE_CONST, {.dbl = FF_MOV_FLAG_FRAG_KEYFRAME}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
+    { "frag_mfra", "Write a random access index for fragmented output", 0, FF_OPT_TYPE_CONST, {.dbl = FF_MOV_FLAG_FRAG_MFRA}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     FF_RTP_FLAG_OPTS(MOVMuxContext, rtp_flags),
+    { "frag_duration", "Maximum fragment duration in microseconds", offsetof(MOVMuxContext, max_fragment_duration), FF_OPT_TYPE_INT, {.dbl = 0}, 0, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM },
+    { "moov_size", "Bytes to reserve for the moov atom at the start of the file", offsetof(MOVMuxContext, reserved_moov_size), FF_OPT_TYPE_INT, {.dbl = 0}, 0, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM },
     { NULL },
 };
 
@@ -106,7 +110,7 @@ static int mov_write_stsz_tag(AVIOContext *pb, MOVTrack *track)
         oldtst = tst;
         entries += track->cluster[i].entries;
     }
-    if (equalChunks) {
+    if (equalChunks && track->entry) {
         int sSize = track->cluster[0].size/track->cluster[0].entries;
         sSize = FFMAX(1, sSize); // adpcm mono case could make sSize == 0
         avio_wb32(pb, sSize); // sample size
@@ -268,6 +272,8 @@ static unsigned compute_avg_bitrate(MOVTrack *track)
 {
     uint64_t size = 0;
     int i;
+    if (!track->trackDuration)
+        return 0;
     for (i = 0; i < track->entry; i++)
         size += track->cluster[i].size;
     return size * 8 * track->timescale / track->trackDuration;
@@ -1390,7 +1396,8 @@ static int mov_write_trak_tag(AVIOContext *pb, MOVTrack *track, AVStream *st)
     avio_wb32(pb, 0); /* size */
     ffio_wfourcc(pb, "trak");
     mov_write_tkhd_tag(pb, track, st);
-    if (track->mode == MODE_PSP || track->flags & MOV_TRACK_CTTS || track->cluster[0].dts)
+    if (track->entry &&
+        (track->mode == MODE_PSP || track->flags & MOV_TRACK_CTTS || track->cluster[0].dts))
         mov_write_edts_tag(pb, track);  // PSP Movies require edts box
     if (track->tref_tag)
         mov_write_tref_tag(pb, track);
@@ -1437,9 +1444,9 @@ static int mov_write_mvhd_tag(AVIOContext *pb, MOVMuxContext *mov)
                                              AV_ROUND_UP);
             if(maxTrackLen < maxTrackLenTemp)
                 maxTrackLen = maxTrackLenTemp;
-            if(maxTrackID < mov->tracks[i].trackID)
-                maxTrackID = mov->tracks[i].trackID;
         }
+        if(maxTrackID < mov->tracks[i].trackID)
+            maxTrackID = mov->tracks[i].trackID;
     }
 
     version = maxTrackLen < UINT32_MAX ? 0 : 1;
@@ -1800,6 +1807,31 @@ static int mov_write_uuidusmt_tag(AVIOContext *pb, AVFormatContext *s)
     return 0;
 }
 
+static int mov_write_trex_tag(AVIOContext *pb, MOVTrack *track)
+{
+    avio_wb32(pb, 0x20); /* size */
+    ffio_wfourcc(pb, "trex");
+    avio_wb32(pb, 0); /* version & flags */
+    avio_wb32(pb, track->trackID);
+    avio_wb32(pb, 1); /* default sample description index */
+    avio_wb32(pb, 0); /* default sample duration */
+    avio_wb32(pb, 0); /* default sample size */
+    avio_wb32(pb, 0); /* default sample flags */
+    return 0x20;
+}
+
+static int mov_write_mvex_tag(AVIOContext *pb, MOVMuxContext *mov)
+{
+    int64_t pos = avio_tell(pb);
+    int i;
+
+    avio_wb32(pb, 0); /* size */
+    ffio_wfourcc(pb, "mvex");
+    for (i = 0; i < mov->nb_streams; i++)
+        mov_write_trex_tag(pb, &mov->tracks[i]);
+    return updateSize(pb, pos);
+}
+
 static int mov_write_moov_tag(AVIOContext *pb, MOVMuxContext *mov,
                               AVFormatContext *s)
 {
@@ -1809,7 +1841,7 @@ static int mov_write_moov_tag(AVIOContext *pb, MOVMuxContext *mov,
     ffio_wfourcc(pb, "moov");
 
     for (i=0; i<mov->nb_streams; i++) {
-        if(mov->tracks[i].entry <= 0) continue;
+        if(mov->tracks[i].entry <= 0 && !(mov->flags & FF_MOV_FLAG_FRAGMENT)) continue;
 
         mov->tracks[i].time = mov->time;
         mov->tracks[i].trackID = i+1;
@@ -1831,10 +1863,12 @@ static int mov_write_moov_tag(AVIOContext *pb, MOVMuxContext *mov,
     mov_write_mvhd_tag(pb, mov);
     //mov_write_iods_tag(pb, mov);
     for (i=0; i<mov->nb_streams; i++) {
-        if(mov->tracks[i].entry > 0) {
+        if(mov->tracks[i].entry > 0 || mov->flags & FF_MOV_FLAG_FRAGMENT) {
             mov_write_trak_tag(pb, &(mov->tracks[i]), i < s->nb_streams ? s->streams[i] : NULL);
         }
     }
+    if (mov->flags & FF_MOV_FLAG_FRAGMENT)
+        mov_write_mvex_tag(pb, mov);
 
     if (mov->mode == MODE_PSP)
         mov_write_uuidusmt_tag(pb, s);
@@ -1855,6 +1889,177 @@ static int mov_write_mdat_tag(AVIOContext *pb, MOVMuxContext *mov)
     return 0;
 }
 
+static int mov_write_trun_tag(AVIOContext *pb, MOVTrack *track)
+{
+    int flags = 0x001 | 0x100 | 0x200 | 0x400; /* data offset, sample duration, size and flags */
+    int i;
+
+    if (track->flags & MOV_TRACK_CTTS)
+        flags |= 0x800; /* sample composition time offsets */
+
+    avio_wb32(pb, 20 + track->entry * (flags & 0x800 ? 16 : 12)); /* size */
+    ffio_wfourcc(pb, "trun");
+    avio_w8(pb, 0); /* version */
+    avio_wb24(pb, flags);
+    avio_wb32(pb, track->entry); /* sample count */
+    track->data_offset_pos = avio_tell(pb);
+    avio_wb32(pb, 0); /* data offset, filled in once the moof size is known */
+    for (i = 0; i < track->entry; i++) {
+        int64_t duration = i + 1 == track->entry ?
+            track->start_dts + track->trackDuration - track->cluster[i].dts :
+            track->cluster[i+1].dts - track->cluster[i].dts;
+        avio_wb32(pb, duration);
+        avio_wb32(pb, track->cluster[i].size);
+        avio_wb32(pb, track->cluster[i].flags & MOV_SYNC_SAMPLE ?
+                      0x02000000 : 0x01010000); /* depends on others, non sync */
+        if (flags & 0x800)
+            avio_wb32(pb, track->cluster[i].cts);
+    }
+    return 0;
+}
+
+static int mov_write_traf_tag(AVIOContext *pb, MOVMuxContext *mov,
+                              MOVTrack *track, int64_t moof_pos, int traf)
+{
+    int64_t pos = avio_tell(pb);
+    int i;
+
+    if (mov->flags & FF_MOV_FLAG_FRAG_MFRA) {
+        for (i = 0; i < track->entry; i++)
+            if (track->cluster[i].flags & MOV_SYNC_SAMPLE)
+                break;
+        if (i < track->entry) {
+            MOVFragmentInfo *info = av_realloc(track->frag_info,
+                                               (track->nb_frag_info + 1) * sizeof(*info));
+            if (!info)
+                return AVERROR(ENOMEM);
+            track->frag_info = info;
+            info += track->nb_frag_info++;
+            info->offset = moof_pos;
+            info->time   = track->cluster[i].dts - track->start_dts;
+            info->traf   = traf;
+            info->sample = i + 1;
+        }
+    }
+
+    avio_wb32(pb, 0); /* size */
+    ffio_wfourcc(pb, "traf");
+
+    avio_wb32(pb, 24); /* size */
+    ffio_wfourcc(pb, "tfhd");
+    avio_w8(pb, 0); /* version */
+    avio_wb24(pb, 0x01); /* base data offset present */
+    avio_wb32(pb, track->trackID);
+    avio_wb64(pb, moof_pos);
+
+    mov_write_trun_tag(pb, track);
+    return updateSize(pb, pos);
+}
+
+/**
+ * Write the samples collected since the last call as a moof and an mdat
+ * box, the samples of each track being stored contiguously in the mdat.
+ */
+static int mov_flush_fragment(AVFormatContext *s)
+{
+    MOVMuxContext *mov = s->priv_data;
+    AVIOContext *moof;
+    int64_t moof_pos = avio_tell(s->pb), mdat_size = 0, offset;
+    uint8_t *buf;
+    int i, size, ret, traf = 0;
+
+    for (i = 0; i < mov->nb_streams; i++)
+        if (mov->tracks[i].entry)
+            mdat_size += avio_tell(mov->tracks[i].mdat_buf);
+    if (!mdat_size)
+        return 0;
+
+    if ((ret = avio_open_dyn_buf(&moof)) < 0)
+        return ret;
+    avio_wb32(moof, 0); /* size */
+    ffio_wfourcc(moof, "moof");
+    avio_wb32(moof, 16); /* size */
+    ffio_wfourcc(moof, "mfhd");
+    avio_wb32(moof, 0); /* version & flags */
+    avio_wb32(moof, ++mov->fragments); /* sequence number */
+    for (i = 0; i < mov->nb_streams; i++) {
+        if (mov->tracks[i].entry &&
+            (ret = mov_write_traf_tag(moof, mov, &mov->tracks[i], moof_pos, ++traf)) < 0) {
+            avio_close_dyn_buf(moof, &buf);
+            av_free(buf);
+            return ret;
+        }
+    }
+    updateSize(moof, 0);
+
+    /* point each trun at its track's data behind the mdat header */
+    size   = avio_tell(moof);
+    offset = size + 8;
+    for (i = 0; i < mov->nb_streams; i++) {
+        MOVTrack *track = &mov->tracks[i];
+        if (!track->entry)
+            continue;
+        avio_seek(moof, track->data_offset_pos, SEEK_SET);
+        avio_wb32(moof, offset);
+        offset += avio_tell(track->mdat_buf);
+    }
+    avio_seek(moof, size, SEEK_SET);
+    size = avio_close_dyn_buf(moof, &buf);
+    avio_write(s->pb, buf, size);
+    av_free(buf);
+
+    avio_wb32(s->pb, mdat_size + 8);
+    ffio_wfourcc(s->pb, "mdat");
+    for (i = 0; i < mov->nb_streams; i++) {
+        MOVTrack *track = &mov->tracks[i];
+        if (!track->entry)
+            continue;
+        size = avio_close_dyn_buf(track->mdat_buf, &buf);
+        avio_write(s->pb, buf, size);
+        av_free(buf);
+        track->mdat_buf = NULL;
+        track->entry    = 0;
+    }
+    avio_flush(s->pb);
+    return 0;
+}
+
+static void mov_write_mfra_tag(AVIOContext *pb, MOVMuxContext *mov)
+{
+    int64_t size = 8 + 16;
+    int i, j;
+
+    for (i = 0; i < mov->nb_streams; i++)
+        if (mov->tracks[i].nb_frag_info)
+            size += 24 + 28 * mov->tracks[i].nb_frag_info;
+
+    avio_wb32(pb, size);
+    ffio_wfourcc(pb, "mfra");
+    for (i = 0; i < mov->nb_streams; i++) {
+        MOVTrack *track = &mov->tracks[i];
+        if (!track->nb_frag_info)
+            continue;
+        avio_wb32(pb, 24 + 28 * track->nb_frag_info); /* size */
+        ffio_wfourcc(pb, "tfra");
+        avio_w8(pb, 1); /* version, 64 bit time and offset */
+        avio_wb24(pb, 0);
+        avio_wb32(pb, track->trackID);
+        avio_wb32(pb, 0x3f); /* 4 byte traf, trun and sample numbers */
+        avio_wb32(pb, track->nb_frag_info);
+        for (j = 0; j < track->nb_frag_info; j++) {
+            avio_wb64(pb, track->frag_info[j].time);
+            avio_wb64(pb, track->frag_info[j].offset);
+            avio_wb32(pb, track->frag_info[j].traf);
+            avio_wb32(pb, 1); /* trun number */
+            avio_wb32(pb, track->frag_info[j].sample);
+        }
+    }
+    avio_wb32(pb, 16); /* size */
+    ffio_wfourcc(pb, "mfro");
+    avio_wb32(pb, 0); /* version & flags */
+    avio_wb32(pb, size);
+}
+
 /* TODO: This needs to be more general */
 static int mov_write_ftyp_tag(AVIOContext *pb, AVFormatContext *s)
 {
@@ -2002,10 +2207,36 @@ int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt)
     AVCodecContext *enc = trk->enc;
     unsigned int samplesInChunk = 0;
     int size= pkt->size;
+    int ret;
 
-    if (!s->pb->seekable) return 0; /* Can't handle that */
+    if (!s->pb->seekable && !(mov->flags & FF_MOV_FLAG_FRAGMENT))
+        return 0; /* Can't handle that */
     if (!size) return 0; /* Discard 0 sized packets */
 
+    if (mov->flags & FF_MOV_FLAG_FRAGMENT && trk->entry) {
+        int64_t duration = av_rescale(pkt->dts - trk->cluster[0].dts,
+                                      AV_TIME_BASE, trk->timescale);
+        int duration_reached = mov->max_fragment_duration &&
+                               duration >= mov->max_fragment_duration;
+        int flush;
+
+        /* with both limits set, cut at the first keyframe past the duration */
+        if (mov->flags & FF_MOV_FLAG_FRAG_KEYFRAME)
+            flush = enc->codec_type == AVMEDIA_TYPE_VIDEO &&
+                    pkt->flags & AV_PKT_FLAG_KEY &&
+                    (!mov->max_fragment_duration || duration_reached);
+        else
+            flush = duration_reached;
+        if (flush && (ret = mov_flush_fragment(s)) < 0)
+            return ret;
+    }
+    if (mov->flags & FF_MOV_FLAG_FRAGMENT) {
+        /* samples are kept until their moof has been written */
+        if (!trk->mdat_buf && (ret = avio_open_dyn_buf(&trk->mdat_buf)) < 0)
+            return ret;
+        pb = trk->mdat_buf;
+    }
+
     if (enc->codec_id == CODEC_ID_AMR_NB) {
         /* We must find out how many AMR blocks there are in one packet */
         static uint16_t packed_size[16] =
@@ -2068,7 +2299,9 @@ int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt)
     trk->cluster[trk->entry].size = size;
     trk->cluster[trk->entry].entries = samplesInChunk;
     trk->cluster[trk->entry].dts = pkt->dts;
-    trk->trackDuration = pkt->dts - trk->cluster[0].dts + pkt->duration;
+    if (trk->start_dts == AV_NOPTS_VALUE)
+        trk->start_dts = pkt->dts;
+    trk->trackDuration = pkt->dts - trk->start_dts + pkt->duration;
 
     if (pkt->pts == AV_NOPTS_VALUE) {
         av_log(s, AV_LOG_WARNING, "pts has no value\n");
@@ -2094,7 +2327,7 @@ int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt)
     trk->sampleCount += samplesInChunk;
     mov->mdat_size += size;
 
-    avio_flush(pb);
+    avio_flush(s->pb);
 
     if (trk->hint_track >= 0 && trk->hint_track < mov->nb_streams)
         ff_mov_add_hinted_packet(s, pkt, trk->hint_track, trk->entry);
@@ -2142,7 +2375,10 @@ static int mov_write_header(AVFormatContext *s)
     MOVMuxContext *mov = s->priv_data;
     int i, hint_track = 0;
 
-    if (!s->pb->seekable) {
+    if (mov->max_fragment_duration || mov->flags & FF_MOV_FLAG_FRAG_KEYFRAME)
+        mov->flags |= FF_MOV_FLAG_FRAGMENT;
+
+    if (!s->pb->seekable && !(mov->flags & FF_MOV_FLAG_FRAGMENT)) {
         av_log(s, AV_LOG_ERROR, "muxer does not support non seekable output\n");
         return -1;
     }
@@ -2168,7 +2404,8 @@ static int mov_write_header(AVFormatContext *s)
     }
 
     mov->nb_streams = s->nb_streams;
-    if (mov->mode & (MODE_MOV|MODE_IPOD) && s->nb_chapters)
+    if (mov->mode & (MODE_MOV|MODE_IPOD) && s->nb_chapters &&
+        !(mov->flags & FF_MOV_FLAG_FRAGMENT))
         mov->chapter_track = mov->nb_streams++;
 
 #if FF_API_FLAG_RTP_HINT
@@ -2179,6 +2416,10 @@ static int mov_write_header(AVFormatContext *s)
         mov->flags |= FF_MOV_FLAG_RTP_HINT;
     }
 #endif
+    if (mov->flags & FF_MOV_FLAG_RTP_HINT && mov->flags & FF_MOV_FLAG_FRAGMENT) {
+        av_log(s, AV_LOG_ERROR, "RTP hint tracks cannot be written in fragments\n");
+        return AVERROR(EINVAL);
+    }
     if (mov->flags & FF_MOV_FLAG_RTP_HINT) {
         /* Add hint tracks for each audio and video stream */
         hint_track = mov->nb_streams;
@@ -2214,6 +2455,7 @@ static int mov_write_header(AVFormatContext *s)
         /* If hinting of this track is enabled by a later hint track,
          * this is updated. */
         track->hint_track = -1;
+        track->start_dts  = AV_NOPTS_VALUE;
         if(st->codec->codec_type == AVMEDIA_TYPE_VIDEO){
             if (track->tag == MKTAG('m','x','3','p') || track->tag == MKTAG('m','x','3','n') ||
                 track->tag == MKTAG('m','x','4','p') || track->tag == MKTAG('m','x','4','n') ||
@@ -2269,8 +2511,48 @@ static int mov_write_header(AVFormatContext *s)
         av_set_pts_info(st, 64, 1, track->timescale);
     }
 
-    mov_write_mdat_tag(pb, mov);
     mov->time = s->timestamp + 0x7C25B080; //1970 based -> 1904 based
+    if (mov->flags & FF_MOV_FLAG_FRAGMENT) {
+        /* all samples go into fragments, the moov only describes the tracks */
+        AVIOContext *moov;
+        uint8_t *buf;
+        int size;
+
+        for (i = 0; i < s->nb_streams; i++) {
+            MOVTrack *track = &mov->tracks[i];
+            if (track->enc->codec_id == CODEC_ID_AC3 ||
+                track->enc->codec_id == CODEC_ID_DNXHD) {
+                av_log(s, AV_LOG_ERROR, "track %d: fragmented output does not support "
+                       "codecs described from their first frame\n", i);
+                goto error;
+            }
+            if (track->enc->extradata_size > 0) {
+                track->vosLen  = track->enc->extradata_size;
+                track->vosData = av_malloc(track->vosLen);
+                if (!track->vosData)
+                    goto error;
+                memcpy(track->vosData, track->enc->extradata, track->vosLen);
+            }
+        }
+        if (avio_open_dyn_buf(&moov) < 0)
+            goto error;
+        mov_write_moov_tag(moov, mov, s);
+        size = avio_close_dyn_buf(moov, &buf);
+        avio_write(pb, buf, size);
+        av_free(buf);
+    } else {
+        if (mov->reserved_moov_size) {
+            if (mov->reserved_moov_size < 8) {
+                av_log(s, AV_LOG_ERROR, "moov_size must be at least 8 bytes\n");
+                goto error;
+            }
+            mov->reserved_moov_pos = avio_tell(pb);
+            avio_wb32(pb, mov->reserved_moov_size);
+            ffio_wfourcc(pb, "free");
+            ffio_fill(pb, 0, mov->reserved_moov_size - 8);
+        }
+        mov_write_mdat_tag(pb, mov);
+    }
 
     if (mov->chapter_track)
         mov_create_chapter_track(s, mov->chapter_track);
@@ -2291,6 +2573,8 @@ static int mov_write_header(AVFormatContext *s)
 
     return 0;
  error:
+    for (i = 0; i < mov->nb_streams; i++)
+        av_freep(&mov->tracks[i].vosData);
     av_freep(&mov->tracks);
     return -1;
 }
@@ -2304,6 +2588,13 @@ static int mov_write_trailer(AVFormatContext *s)
 
     int64_t moov_pos = avio_tell(pb);
 
+    if (mov->flags & FF_MOV_FLAG_FRAGMENT) {
+        res = mov_flush_fragment(s);
+        if (mov->flags & FF_MOV_FLAG_FRAG_MFRA)
+            mov_write_mfra_tag(pb, mov);
+        goto end;
+    }
+
     /* Write size of mdat tag */
     if (mov->mdat_size+8 <= UINT32_MAX) {
         avio_seek(pb, mov->mdat_pos, SEEK_SET);
@@ -2317,8 +2608,34 @@ static int mov_write_trailer(AVFormatContext *s)
     }
     avio_seek(pb, moov_pos, SEEK_SET);
 
-    mov_write_moov_tag(pb, mov, s);
+    if (mov->reserved_moov_size) {
+        AVIOContext *moov;
+        uint8_t *buf;
+        int size;
+
+        if ((res = avio_open_dyn_buf(&moov)) < 0)
+            goto end;
+        mov_write_moov_tag(moov, mov, s);
+        size = avio_close_dyn_buf(moov, &buf);
+        /* the remainder of the reserved area must hold a free atom */
+        if (size == mov->reserved_moov_size || size + 8 <= mov->reserved_moov_size) {
+            avio_seek(pb, mov->reserved_moov_pos, SEEK_SET);
+            avio_write(pb, buf, size);
+            if (size < mov->reserved_moov_size) {
+                avio_wb32(pb, mov->reserved_moov_size - size);
+                ffio_wfourcc(pb, "free");
+            }
+        } else {
+            av_log(s, AV_LOG_WARNING, "moov atom needs %d bytes, more than the "
+                   "%d reserved, writing it at the end of the file\n",
+                   size, mov->reserved_moov_size);
+            avio_write(pb, buf, size);
+        }
+        av_free(buf);
+    } else
+        mov_write_moov_tag(pb, mov, s);
 
+end:
     if (mov->chapter_track)
         av_freep(&mov->tracks[mov->chapter_track].enc);
 
@@ -2326,6 +2643,7 @@ static int mov_write_trailer(AVFormatContext *s)
         if (mov->tracks[i].tag == MKTAG('r','t','p',' '))
             ff_mov_close_hinting(&mov->tracks[i]);
         av_freep(&mov->tracks[i].cluster);
+        av_freep(&mov->tracks[i].frag_info);
 
         if(mov->tracks[i].vosLen) av_free(mov->tracks[i].vosData);
 
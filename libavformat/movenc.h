@@ -51,6 +51,14 @@ typedef struct MOVIentry {
     uint32_t     flags;
 } MOVIentry;
 
+/** position of the first sync sample of a fragment, for the mfra index */
+typedef struct MOVFragmentInfo {
+    int64_t offset; ///< file offset of the moof
+    int64_t time;   ///< decode time of the sample
+    int     traf;   ///< 1-based traf number in the moof
+    int     sample; ///< 1-based sample number in the trun
+} MOVFragmentInfo;
+
 typedef struct HintSample {
     uint8_t *data;
     int size;
@@ -98,6 +106,12 @@ typedef struct MOVIndex {
     uint32_t    max_packet_size;
 
     HintSampleQueue sample_queue;
+
+    int64_t     start_dts;      ///< dts of the first sample of the track
+    AVIOContext *mdat_buf;      ///< sample data of the current fragment
+    int64_t     data_offset_pos; ///< position of the trun data offset in the moof
+    MOVFragmentInfo *frag_info;
+    int         nb_frag_info;
 } MOVTrack;
 
 typedef struct MOVMuxContext {
@@ -112,9 +126,17 @@ typedef struct MOVMuxContext {
 
     int flags;
     int rtp_flags;
+    int max_fragment_duration; ///< in AV_TIME_BASE units, 0 for no limit
+    int fragments;             ///< number of fragments written so far
+
+    int reserved_moov_size;    ///< bytes reserved for the moov at the start, 0 for none
+    int64_t reserved_moov_pos;
 } MOVMuxContext;
 
-#define FF_MOV_FLAG_RTP_HINT 1
+#define FF_MOV_FLAG_RTP_HINT      1
+#define FF_MOV_FLAG_FRAG_KEYFRAME 2
+#define FF_MOV_FLAG_FRAG_MFRA     4
+#define FF_MOV_FLAG_FRAGMENT      8 ///< set internally when writing fragments
 
 int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt);
 
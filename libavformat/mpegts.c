@@ -21,6 +21,7 @@
 
 //#define USE_SYNCPOINT_SEARCH
 
+#include "libavutil/buffer.h"
 #include "libavutil/crc.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/log.h"
@@ -40,6 +41,8 @@
 #define MAX_RESYNC_SIZE 65536
 
 #define MAX_PES_PAYLOAD 200*1024
+/** initial buffer size for the PES packets of unbounded size */
+#define MIN_PES_BUFFER_SIZE 4096
 
 enum MpegTSFilterType {
     MPEGTS_PES,
@@ -122,6 +125,13 @@ struct MpegTSContext {
 
     /** filters for various streams specified by PMT + for the PAT and PMT */
     MpegTSFilter *pids[NB_PID_MAX];
+
+    /** 1 for the pids to discard, valid while discard_valid is set */
+    uint8_t discard[NB_PID_MAX];
+    int discard_valid;
+    /** discard of the programs of the AVFormatContext the table was built for */
+    enum AVDiscard *prg_discard;
+    unsigned int nb_prg_discard;
 };
 
 static const AVOption options[] = {
@@ -169,7 +179,8 @@ typedef struct PESContext {
     int64_t pts, dts;
     int64_t ts_packet_pos; /**< position of first TS packet of this PES packet */
     uint8_t header[MAX_PES_HEADER_SIZE];
-    uint8_t *buffer;
+    AVBufferRef *buffer; /**< payload, padded, handed to the output packet */
+    int last_size;       /**< payload size of the previous PES packet */
 } PESContext;
 
 extern AVInputFormat ff_mpegts_demuxer;
@@ -181,12 +192,14 @@ static void clear_program(MpegTSContext *ts, unsigned int programid)
     for(i=0; i<ts->nb_prg; i++)
         if(ts->prg[i].id == programid)
             ts->prg[i].nb_pids = 0;
+    ts->discard_valid = 0;
 }
 
 static void clear_programs(MpegTSContext *ts)
 {
     av_freep(&ts->prg);
     ts->nb_prg=0;
+    ts->discard_valid = 0;
 }
 
 static void add_pat_entry(MpegTSContext *ts, unsigned int programid)
@@ -200,6 +213,7 @@ static void add_pat_entry(MpegTSContext *ts, unsigned int programid)
     p->id = programid;
     p->nb_pids = 0;
     ts->nb_prg++;
+    ts->discard_valid = 0;
 }
 
 static void add_pid_to_pmt(MpegTSContext *ts, unsigned int programid, unsigned int pid)
@@ -218,6 +232,7 @@ static void add_pid_to_pmt(MpegTSContext *ts, unsigned int programid, unsigned i
     if(p->nb_pids >= MAX_PIDS_PER_PROGRAM)
         return;
     p->pids[p->nb_pids++] = pid;
+    ts->discard_valid = 0;
 }
 
 static void set_pcr_pid(AVFormatContext *s, unsigned int programid, unsigned int pid)
@@ -232,36 +247,65 @@ static void set_pcr_pid(AVFormatContext *s, unsigned int programid, unsigned int
 }
 
 /**
- * @brief discard_pid() decides if the pid is to be discarded according
- *                      to caller's programs selection
- * @param ts    : - TS context
- * @param pid   : - pid
- * @return 1 if the pid is only comprised in programs that have .discard=AVDISCARD_ALL
- *         0 otherwise
+ * Invalidate the discard table if the caller changed the discard of the
+ * programs since it was built.
  */
-static int discard_pid(MpegTSContext *ts, unsigned int pid)
+static void check_program_discard(MpegTSContext *ts)
 {
-    int i, j, k;
-    int used = 0, discarded = 0;
+    AVFormatContext *s = ts->stream;
+    int i;
+
+    if (ts->discard_valid && ts->nb_prg_discard == s->nb_programs) {
+        for (i = 0; i < s->nb_programs; i++)
+            if (ts->prg_discard[i] != s->programs[i]->discard)
+                break;
+        if (i == s->nb_programs)
+            return;
+    }
+    ts->discard_valid = 0;
+}
+
+/**
+ * Fill the table of discarded pids, so that packets are dispatched
+ * without scanning the programs. A pid is discarded if it is only
+ * comprised in programs that have .discard=AVDISCARD_ALL, according to
+ * the caller's programs selection.
+ */
+static void update_discard_table(MpegTSContext *ts)
+{
+    AVFormatContext *s = ts->stream;
+    int i, j, k, discard;
     struct Program *p;
-    for(i=0; i<ts->nb_prg; i++) {
-        p = &ts->prg[i];
-        for(j=0; j<p->nb_pids; j++) {
-            if(p->pids[j] != pid)
-                continue;
-            //is program with id p->id set to be discarded?
-            for(k=0; k<ts->stream->nb_programs; k++) {
-                if(ts->stream->programs[k]->id == p->id) {
-                    if(ts->stream->programs[k]->discard == AVDISCARD_ALL)
-                        discarded++;
-                    else
-                        used++;
-                }
+
+    memset(ts->discard, 0, sizeof(ts->discard));
+    /* mark the pids of the discarded programs, then unmark those which
+     * are also part of a used program */
+    for (discard = 1; discard >= 0; discard--) {
+        for (i = 0; i < ts->nb_prg; i++) {
+            p = &ts->prg[i];
+            for (k = 0; k < s->nb_programs; k++) {
+                if (s->programs[k]->id != p->id ||
+                    (s->programs[k]->discard == AVDISCARD_ALL) != discard)
+                    continue;
+                for (j = 0; j < p->nb_pids; j++)
+                    ts->discard[p->pids[j]] = discard;
             }
         }
     }
+    /* the PAT is always needed */
+    ts->discard[0] = 0;
 
-    return !used && discarded;
+    if (ts->nb_prg_discard != s->nb_programs) {
+        void *tmp = av_realloc(ts->prg_discard,
+                               s->nb_programs * sizeof(*ts->prg_discard));
+        if (!tmp && s->nb_programs)
+            return;
+        ts->prg_discard    = tmp;
+        ts->nb_prg_discard = s->nb_programs;
+    }
+    for (i = 0; i < s->nb_programs; i++)
+        ts->prg_discard[i] = s->programs[i]->discard;
+    ts->discard_valid = 1;
 }
 
 /**
@@ -368,7 +412,7 @@ static void mpegts_close_filter(MpegTSContext *ts, MpegTSFilter *filter)
         av_freep(&filter->u.section_filter.section_buf);
     else if (filter->type == MPEGTS_PES) {
         PESContext *pes = filter->u.pes_filter.opaque;
-        av_freep(&pes->buffer);
+        av_buffer_unref(&pes->buffer);
         /* referenced private data will be freed later in
          * av_close_input_stream */
         if (!((PESContext *)filter->u.pes_filter.opaque)->st) {
@@ -628,14 +672,30 @@ static int mpegts_set_stream_info(AVStream *st, PESContext *pes,
     return 0;
 }
 
+/**
+ * Allocate the buffer of a new PES packet. Unbounded packets start with
+ * the size of the previous one, and the buffer grows as needed.
+ */
+static int alloc_pes_buffer(PESContext *pes)
+{
+    int size = pes->total_size;
+
+    if (size == MAX_PES_PAYLOAD)
+        size = av_clip(pes->last_size, MIN_PES_BUFFER_SIZE, MAX_PES_PAYLOAD);
+    pes->buffer = av_buffer_alloc(size + FF_INPUT_BUFFER_PADDING_SIZE);
+    return pes->buffer ? 0 : AVERROR(ENOMEM);
+}
+
 static void new_pes_packet(PESContext *pes, AVPacket *pkt)
 {
     av_init_packet(pkt);
 
     pkt->destruct = av_destruct_packet;
-    pkt->data = pes->buffer;
+    pkt->buf  = pes->buffer;
+    pkt->data = pes->buffer->data;
     pkt->size = pes->data_index;
     memset(pkt->data+pkt->size, 0, FF_INPUT_BUFFER_PADDING_SIZE);
+    pes->last_size = pkt->size;
 
     // Separate out the AC3 substream from an HDMV combined TrueHD/AC3 PID
     if (pes->sub_st && pes->stream_type == 0x83 && pes->extended_stream_id == 0x76)
@@ -662,7 +722,7 @@ static int mpegts_push_data(MpegTSFilter *filter,
     PESContext *pes = filter->u.pes_filter.opaque;
     MpegTSContext *ts = pes->ts;
     const uint8_t *p;
-    int len, code;
+    int len, code, ret;
 
     if(!ts->pkt)
         return 0;
@@ -715,9 +775,8 @@ static int mpegts_push_data(MpegTSFilter *filter,
                         pes->total_size = MAX_PES_PAYLOAD;
 
                     /* allocate pes buffer */
-                    pes->buffer = av_malloc(pes->total_size+FF_INPUT_BUFFER_PADDING_SIZE);
-                    if (!pes->buffer)
-                        return AVERROR(ENOMEM);
+                    if ((ret = alloc_pes_buffer(pes)) < 0)
+                        return ret;
 
                     if (code != 0x1bc && code != 0x1bf && /* program_stream_map, private_stream_2 */
                         code != 0x1f0 && code != 0x1f1 && /* ECM, EMM */
@@ -811,16 +870,21 @@ static int mpegts_push_data(MpegTSFilter *filter,
                 if (pes->data_index > 0 && pes->data_index+buf_size > pes->total_size) {
                     new_pes_packet(pes, ts->pkt);
                     pes->total_size = MAX_PES_PAYLOAD;
-                    pes->buffer = av_malloc(pes->total_size+FF_INPUT_BUFFER_PADDING_SIZE);
-                    if (!pes->buffer)
-                        return AVERROR(ENOMEM);
+                    if ((ret = alloc_pes_buffer(pes)) < 0)
+                        return ret;
                     ts->stop_parse = 1;
                 } else if (pes->data_index == 0 && buf_size > pes->total_size) {
                     // pes packet size is < ts size packet and pes data is padded with 0xff
                     // not sure if this is legal in ts but see issue #2392
                     buf_size = pes->total_size;
                 }
-                memcpy(pes->buffer+pes->data_index, p, buf_size);
+                if (pes->data_index + buf_size + FF_INPUT_BUFFER_PADDING_SIZE > pes->buffer->size) {
+                    int size = FFMIN(FFMAX(2 * pes->buffer->size, pes->data_index + buf_size),
+                                     pes->total_size);
+                    if ((ret = av_buffer_realloc(&pes->buffer, size + FF_INPUT_BUFFER_PADDING_SIZE)) < 0)
+                        return ret;
+                }
+                memcpy(pes->buffer->data+pes->data_index, p, buf_size);
                 pes->data_index += buf_size;
             }
             buf_size = 0;
@@ -1263,17 +1327,22 @@ static void sdt_cb(MpegTSFilter *filter, const uint8_t *section, int section_len
     }
 }
 
-/* handle one TS packet */
-static int handle_packet(MpegTSContext *ts, const uint8_t *packet)
+/**
+ * Handle one TS packet.
+ * @param pos position in the stream of the end of the packet, including
+ *            any FEC or timestamp bytes
+ */
+static int handle_packet(MpegTSContext *ts, const uint8_t *packet, int64_t pos)
 {
     AVFormatContext *s = ts->stream;
     MpegTSFilter *tss;
     int len, pid, cc, cc_ok, afc, is_start;
     const uint8_t *p, *p_end;
-    int64_t pos;
 
     pid = AV_RB16(packet + 1) & 0x1fff;
-    if(pid && discard_pid(ts, pid))
+    if (!ts->discard_valid)
+        update_discard_table(ts);
+    if (ts->discard[pid])
         return 0;
     is_start = packet[1] & 0x40;
     tss = ts->pids[pid];
@@ -1305,7 +1374,6 @@ static int handle_packet(MpegTSContext *ts, const uint8_t *packet)
     if (p >= p_end)
         return 0;
 
-    pos = avio_tell(ts->stream->pb);
     ts->pos47= pos % ts->raw_packet_size;
 
     if (tss->type == MPEGTS_SECTION) {
@@ -1348,45 +1416,41 @@ static int handle_packet(MpegTSContext *ts, const uint8_t *packet)
    get_packet_size() ?) */
 static int mpegts_resync(AVFormatContext *s)
 {
-    AVIOContext *pb = s->pb;
-    int c, i;
+    int ret = ffio_skip_to_byte(s->pb, 0x47, MAX_RESYNC_SIZE);
 
-    for(i = 0;i < MAX_RESYNC_SIZE; i++) {
-        c = avio_r8(pb);
-        if (url_feof(pb))
-            return -1;
-        if (c == 0x47) {
-            avio_seek(pb, -1, SEEK_CUR);
-            return 0;
-        }
-    }
-    av_log(s, AV_LOG_ERROR, "max resync size reached, could not find sync byte\n");
+    if (ret == AVERROR_INVALIDDATA)
+        av_log(s, AV_LOG_ERROR, "max resync size reached, could not find sync byte\n");
     /* no sync found */
-    return -1;
+    return ret < 0 ? -1 : 0;
 }
 
 /* return -1 if error or EOF. Return 0 if OK. */
-static int read_packet(AVFormatContext *s, uint8_t *buf, int raw_packet_size)
+/**
+ * Read a raw TS packet, including any FEC or timestamp bytes after it,
+ * into buf only if it is not contiguous in the buffer of the AVIOContext:
+ * *data points to the packet until the next access to the AVIOContext.
+ * buf must hold raw_packet_size bytes.
+ */
+static int read_packet(AVFormatContext *s, uint8_t *buf, int raw_packet_size,
+                       const uint8_t **data)
 {
     AVIOContext *pb = s->pb;
-    int skip, len;
+    int len;
 
     for(;;) {
-        len = avio_read(pb, buf, TS_PACKET_SIZE);
-        if (len != TS_PACKET_SIZE)
+        len = ffio_read_indirect(pb, buf, raw_packet_size, data);
+        /* the bytes after the last packet may be missing */
+        if (len < TS_PACKET_SIZE)
             return len < 0 ? len : AVERROR_EOF;
         /* check paquet sync byte */
-        if (buf[0] != 0x47) {
+        if ((*data)[0] != 0x47) {
             /* find a new packet start */
-            avio_seek(pb, -TS_PACKET_SIZE, SEEK_CUR);
+            avio_seek(pb, -len, SEEK_CUR);
             if (mpegts_resync(s) < 0)
                 return AVERROR(EAGAIN);
             else
                 continue;
         } else {
-            skip = raw_packet_size - TS_PACKET_SIZE;
-            if (skip > 0)
-                avio_skip(pb, skip);
             break;
         }
     }
@@ -1396,9 +1460,11 @@ static int read_packet(AVFormatContext *s, uint8_t *buf, int raw_packet_size)
 static int handle_packets(MpegTSContext *ts, int nb_packets)
 {
     AVFormatContext *s = ts->stream;
-    uint8_t packet[TS_PACKET_SIZE];
+    uint8_t packet[TS_MAX_PACKET_SIZE];
+    const uint8_t *data;
     int packet_num, ret;
 
+    check_program_discard(ts);
     ts->stop_parse = 0;
     packet_num = 0;
     for(;;) {
@@ -1407,10 +1473,10 @@ static int handle_packets(MpegTSContext *ts, int nb_packets)
         packet_num++;
         if (nb_packets != 0 && packet_num >= nb_packets)
             break;
-        ret = read_packet(s, packet, ts->raw_packet_size);
+        ret = read_packet(s, packet, ts->raw_packet_size, &data);
         if (ret != 0)
             return ret;
-        ret = handle_packet(ts, packet);
+        ret = handle_packet(ts, data, avio_tell(s->pb));
         if (ret != 0)
             return ret;
     }
@@ -1533,7 +1599,8 @@ static int mpegts_read_header(AVFormatContext *s,
         int pcr_pid, pid, nb_packets, nb_pcrs, ret, pcr_l;
         int64_t pcrs[2], pcr_h;
         int packet_count[2];
-        uint8_t packet[TS_PACKET_SIZE];
+        uint8_t packet[TS_MAX_PACKET_SIZE];
+        const uint8_t *data;
 
         /* only read packets */
 
@@ -1549,12 +1616,12 @@ static int mpegts_read_header(AVFormatContext *s,
         nb_pcrs = 0;
         nb_packets = 0;
         for(;;) {
-            ret = read_packet(s, packet, ts->raw_packet_size);
+            ret = read_packet(s, packet, ts->raw_packet_size, &data);
             if (ret < 0)
                 return -1;
-            pid = AV_RB16(packet + 1) & 0x1fff;
+            pid = AV_RB16(data + 1) & 0x1fff;
             if ((pcr_pid == -1 || pcr_pid == pid) &&
-                parse_pcr(&pcr_h, &pcr_l, packet) == 0) {
+                parse_pcr(&pcr_h, &pcr_l, data) == 0) {
                 pcr_pid = pid;
                 packet_count[nb_pcrs] = nb_packets;
                 pcrs[nb_pcrs] = pcr_h * 300 + pcr_l;
@@ -1592,15 +1659,18 @@ static int mpegts_raw_read_packet(AVFormatContext *s,
     int64_t pcr_h, next_pcr_h, pos;
     int pcr_l, next_pcr_l;
     uint8_t pcr_buf[12];
+    uint8_t packet[TS_MAX_PACKET_SIZE];
+    const uint8_t *data;
 
     if (av_new_packet(pkt, TS_PACKET_SIZE) < 0)
         return AVERROR(ENOMEM);
     pkt->pos= avio_tell(s->pb);
-    ret = read_packet(s, pkt->data, ts->raw_packet_size);
+    ret = read_packet(s, packet, ts->raw_packet_size, &data);
     if (ret < 0) {
         av_free_packet(pkt);
         return ret;
     }
+    memcpy(pkt->data, data, TS_PACKET_SIZE);
     if (ts->mpeg2ts_compute_pcr) {
         /* compute exact PCR for each packet */
         if (parse_pcr(&pcr_h, &pcr_l, pkt->data) == 0) {
@@ -1639,7 +1709,7 @@ static int mpegts_read_packet(AVFormatContext *s,
         for (i = 0; i < NB_PID_MAX; i++) {
             if (ts->pids[i] && ts->pids[i]->type == MPEGTS_PES) {
                 PESContext *pes = ts->pids[i]->u.pes_filter.opaque;
-                av_freep(&pes->buffer);
+                av_buffer_unref(&pes->buffer);
                 pes->data_index = 0;
                 pes->state = MPEGTS_SKIP; /* skip until pes header */
             }
@@ -1674,6 +1744,7 @@ static int mpegts_read_close(AVFormatContext *s)
     int i;
 
     clear_programs(ts);
+    av_freep(&ts->prg_discard);
 
     for(i=0;i<NB_PID_MAX;i++)
         if (ts->pids[i]) mpegts_close_filter(ts, ts->pids[i]);
@@ -1867,7 +1938,7 @@ int ff_mpegts_parse_packet(MpegTSContext *ts, AVPacket *pkt,
             buf++;
             len--;
         } else {
-            handle_packet(ts, buf);
+            handle_packet(ts, buf, avio_tell(ts->stream->pb));
             buf += TS_PACKET_SIZE;
             len -= TS_PACKET_SIZE;
         }
@@ -1881,6 +1952,7 @@ void ff_mpegts_parse_close(MpegTSContext *ts)
 
     for(i=0;i<NB_PID_MAX;i++)
         av_free(ts->pids[i]);
+    av_free(ts->prg_discard);
     av_free(ts);
 }
 
@@ -67,6 +67,7 @@ typedef struct MpegTSWrite {
     int tsid;
     int64_t first_pcr;
     int mux_rate; ///< set to 1 when VBR
+    int datagram_size; ///< TS packets per output datagram times TS_PACKET_SIZE, 0 if not packetized
 
     int transport_stream_id;
     int original_network_id;
@@ -432,10 +433,21 @@ static MpegTSService *mpegts_add_service(MpegTSWrite *ts,
     return service;
 }
 
+/* Write one TS packet, flushing first if it would straddle two datagrams */
+static void write_ts_packet(AVFormatContext *s, const uint8_t *packet)
+{
+    MpegTSWrite *ts = s->priv_data;
+
+    if (ts->datagram_size &&
+        s->pb->buf_ptr - s->pb->buffer + TS_PACKET_SIZE > ts->datagram_size)
+        avio_flush(s->pb);
+    avio_write(s->pb, packet, TS_PACKET_SIZE);
+}
+
 static void section_write_packet(MpegTSSection *s, const uint8_t *packet)
 {
     AVFormatContext *ctx = s->opaque;
-    avio_write(ctx->pb, packet, TS_PACKET_SIZE);
+    write_ts_packet(ctx, packet);
 }
 
 static int mpegts_write_header(AVFormatContext *s)
@@ -452,6 +464,8 @@ static int mpegts_write_header(AVFormatContext *s)
 
     ts->tsid = ts->transport_stream_id;
     ts->onid = ts->original_network_id;
+    /* send whole TS packets in each datagram of packetized outputs (UDP) */
+    ts->datagram_size = s->pb->max_packet_size / TS_PACKET_SIZE * TS_PACKET_SIZE;
     /* allocate a single DVB service */
     title = av_dict_get(s->metadata, "service_name", NULL, 0);
     if (!title)
@@ -646,7 +660,7 @@ static void mpegts_insert_null_packet(AVFormatContext *s)
     *q++ = 0xff;
     *q++ = 0x10;
     memset(q, 0x0FF, TS_PACKET_SIZE - (q - buf));
-    avio_write(s->pb, buf, TS_PACKET_SIZE);
+    write_ts_packet(s, buf);
 }
 
 /* Write a single transport stream packet with a PCR and no payload */
@@ -671,7 +685,7 @@ static void mpegts_insert_pcr_only(AVFormatContext *s, AVStream *st)
 
     /* stuffing bytes */
     memset(q, 0xFF, TS_PACKET_SIZE - (q - buf));
-    avio_write(s->pb, buf, TS_PACKET_SIZE);
+    write_ts_packet(s, buf);
 }
 
 static void write_pts(uint8_t *q, int fourbits, int64_t pts)
@@ -866,9 +880,11 @@ static void mpegts_write_pes(AVFormatContext *s, AVStream *st,
         memcpy(buf + TS_PACKET_SIZE - len, payload, len);
         payload += len;
         payload_size -= len;
-        avio_write(s->pb, buf, TS_PACKET_SIZE);
+        write_ts_packet(s, buf);
     }
-    avio_flush(s->pb);
+    /* packetized output is sent as soon as a datagram is full */
+    if (!ts->datagram_size)
+        avio_flush(s->pb);
 }
 
 static int mpegts_write_packet(AVFormatContext *s, AVPacket *pkt)
@@ -35,10 +35,12 @@
 #include <math.h>
 #include <time.h>
 
+#include "libavutil/opt.h"
 #include "libavutil/random_seed.h"
 #include "libavcodec/bytestream.h"
 #include "audiointerleave.h"
 #include "avformat.h"
+#include "internal.h"
 #include "mxf.h"
 
 static const int NTSC_samples_per_frame[] = { 1602, 1601, 1602, 1601, 1602, 0 };
@@ -170,6 +172,7 @@ static const MXFContainerEssenceEntry mxf_essence_container_uls[] = {
 };
 
 typedef struct MXFContext {
+    const AVClass *class;
     int64_t footer_partition_offset;
     int essence_container_count;
     AVRational time_base;
@@ -191,6 +194,7 @@ typedef struct MXFContext {
     uint64_t body_offset;
     uint32_t instance_number;
     uint8_t umid[16];        ///< unique material identifier
+    int edit_units_per_body; ///< minimum number of edit units between body partitions
 } MXFContext;
 
 static const uint8_t uuid_base[]            = { 0xAD,0xAB,0x44,0x24,0x2f,0x25,0x4d,0xc7,0x92,0xff,0x29,0xbd };
@@ -1665,9 +1669,9 @@ static int mxf_write_packet(AVFormatContext *s, AVPacket *pkt)
     MXFStreamContext *sc = st->priv_data;
     MXFIndexEntry ie = {0};
 
-    if (!mxf->edit_unit_byte_count && !(mxf->edit_units_count % EDIT_UNITS_PER_BODY)) {
+    if (!mxf->edit_unit_byte_count && !(mxf->edit_units_count % mxf->edit_units_per_body)) {
         mxf->index_entries = av_realloc(mxf->index_entries,
-            (mxf->edit_units_count + EDIT_UNITS_PER_BODY)*sizeof(*mxf->index_entries));
+            (mxf->edit_units_count + mxf->edit_units_per_body)*sizeof(*mxf->index_entries));
         if (!mxf->index_entries) {
             av_log(s, AV_LOG_ERROR, "could not allocate index entries\n");
             return -1;
@@ -1694,7 +1698,7 @@ static int mxf_write_packet(AVFormatContext *s, AVPacket *pkt)
 
     if (st->index == 0) {
         if (!mxf->edit_unit_byte_count &&
-            (!mxf->edit_units_count || mxf->edit_units_count > EDIT_UNITS_PER_BODY) &&
+            (!mxf->edit_units_count || mxf->edit_units_count > mxf->edit_units_per_body) &&
             !(ie.flags & 0x33)) { // I frame, Gop start
             mxf_write_klv_fill(s);
             mxf_write_partition(s, 1, 2, body_partition_key, 0);
@@ -1809,68 +1813,51 @@ static int mxf_write_footer(AVFormatContext *s)
     return 0;
 }
 
-static int mxf_interleave_get_packet(AVFormatContext *s, AVPacket *out, AVPacket *pkt, int flush)
+static int mxf_compare_timestamps(AVFormatContext *s, AVPacket *next, AVPacket *pkt)
 {
-    int i, stream_count = 0;
+    MXFStreamContext *sc  = s->streams[pkt ->stream_index]->priv_data;
+    MXFStreamContext *sc2 = s->streams[next->stream_index]->priv_data;
 
-    for (i = 0; i < s->nb_streams; i++)
-        stream_count += !!s->streams[i]->last_in_packet_buffer;
+    return next->dts > pkt->dts ||
+        (next->dts == pkt->dts && sc->order < sc2->order);
+}
+
+static int mxf_interleave_get_packet(AVFormatContext *s, AVPacket *out, AVPacket *pkt, int flush)
+{
+    int stream_count = s->nb_interleaved_streams;
 
     if (stream_count && (s->nb_streams == stream_count || flush)) {
-        AVPacketList *pktl = s->packet_buffer;
         if (s->nb_streams != stream_count) {
-            AVPacketList *last = NULL;
-            // find last packet in edit unit
-            while (pktl) {
-                if (!stream_count || pktl->pkt.stream_index == 0)
-                    break;
-                last = pktl;
-                pktl = pktl->next;
-                stream_count--;
-            }
-            // purge packet queue
-            while (pktl) {
-                AVPacketList *next = pktl->next;
-
-                if(s->streams[pktl->pkt.stream_index]->last_in_packet_buffer == pktl)
-                    s->streams[pktl->pkt.stream_index]->last_in_packet_buffer= NULL;
-                av_free_packet(&pktl->pkt);
-                av_freep(&pktl);
-                pktl = next;
+            // keep the packets of the last edit unit, up to the next one of stream 0
+            AVPacket *kept = av_malloc(stream_count * sizeof(*kept));
+            AVPacket p;
+            int i, nb_kept = 0, purge = 0, ret = 0;
+
+            if (!kept)
+                return AVERROR(ENOMEM);
+            while (ff_interleave_get_packet(s, &p)) {
+                if (purge || nb_kept == stream_count || p.stream_index == 0) {
+                    purge = 1;
+                    av_free_packet(&p);
+                } else
+                    kept[nb_kept++] = p;
             }
-            if (last)
-                last->next = NULL;
-            else {
-                s->packet_buffer = NULL;
-                s->packet_buffer_end= NULL;
-                goto out;
+            for (i = 0; i < nb_kept; i++) {
+                if (!ret)
+                    ret = ff_interleave_add_packet(s, &kept[i], mxf_compare_timestamps);
+                if (ret < 0)
+                    av_free_packet(&kept[i]);
             }
-            pktl = s->packet_buffer;
+            av_free(kept);
+            if (ret < 0)
+                return ret;
         }
 
-        *out = pktl->pkt;
-        //av_log(s, AV_LOG_DEBUG, "out st:%d dts:%lld\n", (*out).stream_index, (*out).dts);
-        s->packet_buffer = pktl->next;
-        if(s->streams[pktl->pkt.stream_index]->last_in_packet_buffer == pktl)
-            s->streams[pktl->pkt.stream_index]->last_in_packet_buffer= NULL;
-        if(!s->packet_buffer)
-            s->packet_buffer_end= NULL;
-        av_freep(&pktl);
-        return 1;
-    } else {
-    out:
-        av_init_packet(out);
-        return 0;
+        if (ff_interleave_get_packet(s, out))
+            return 1;
     }
-}
-
-static int mxf_compare_timestamps(AVFormatContext *s, AVPacket *next, AVPacket *pkt)
-{
-    MXFStreamContext *sc  = s->streams[pkt ->stream_index]->priv_data;
-    MXFStreamContext *sc2 = s->streams[next->stream_index]->priv_data;
-
-    return next->dts > pkt->dts ||
-        (next->dts == pkt->dts && sc->order < sc2->order);
+    av_init_packet(out);
+    return 0;
 }
 
 static int mxf_interleave(AVFormatContext *s, AVPacket *out, AVPacket *pkt, int flush)
@@ -1879,6 +1866,21 @@ static int mxf_interleave(AVFormatContext *s, AVPacket *out, AVPacket *pkt, int
                                mxf_interleave_get_packet, mxf_compare_timestamps);
 }
 
+static const AVOption options[] = {
+    { "edit_units_per_body", "minimum number of edit units between body partitions and their index table segments",
+      offsetof(MXFContext, edit_units_per_body), FF_OPT_TYPE_INT, {.dbl = EDIT_UNITS_PER_BODY}, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM },
+    { NULL },
+};
+
+#define MXF_CLASS(flavor)\
+static const AVClass flavor ## _muxer_class = {\
+    .class_name = #flavor " muxer",\
+    .item_name  = av_default_item_name,\
+    .option     = options,\
+    .version    = LIBAVUTIL_VERSION_INT,\
+};
+
+MXF_CLASS(mxf)
 AVOutputFormat ff_mxf_muxer = {
     "mxf",
     NULL_IF_CONFIG_SMALL("Material eXchange Format"),
@@ -1893,8 +1895,10 @@ AVOutputFormat ff_mxf_muxer = {
     AVFMT_NOTIMESTAMPS,
     NULL,
     mxf_interleave,
+    .priv_class = &mxf_muxer_class,
 };
 
+MXF_CLASS(mxf_d10)
 AVOutputFormat ff_mxf_d10_muxer = {
     "mxf_d10",
     NULL_IF_CONFIG_SMALL("Material eXchange Format, D-10 Mapping"),
@@ -1909,4 +1913,5 @@ AVOutputFormat ff_mxf_d10_muxer = {
     AVFMT_NOTIMESTAMPS,
     NULL,
     mxf_interleave,
+    .priv_class = &mxf_d10_muxer_class,
 };
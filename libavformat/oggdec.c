@@ -31,8 +31,10 @@
 
 
 #include <stdio.h>
+#include "libavutil/opt.h"
 #include "oggdec.h"
 #include "avformat.h"
+#include "internal.h"
 #include "vorbiscomment.h"
 
 #define MAX_PAGE_SIZE 65307
@@ -452,7 +454,7 @@ static int ogg_get_length(AVFormatContext *s)
     int i;
     int64_t size, end;
 
-    if(!s->pb->seekable)
+    if(!s->pb->seekable || !ogg->scan_length)
         return 0;
 
 // already set
@@ -607,8 +609,10 @@ static int64_t ogg_read_timestamp(AVFormatContext *s, int stream_index,
     struct ogg *ogg = s->priv_data;
     struct ogg_stream *os = ogg->streams + stream_index;
     AVIOContext *bc = s->pb;
+    AVStream *st = s->streams[stream_index];
     int64_t pts = AV_NOPTS_VALUE;
-    int i;
+    int64_t start = *pos_arg;
+    int i, key = 0;
     avio_seek(bc, *pos_arg, SEEK_SET);
     ogg_reset(ogg);
 
@@ -617,11 +621,28 @@ static int64_t ogg_read_timestamp(AVFormatContext *s, int stream_index,
             pts = ogg_calc_pts(s, i, NULL);
             if (os->keyframe_seek && !(os->pflags & AV_PKT_FLAG_KEY))
                 pts = AV_NOPTS_VALUE;
+            key = st->codec->codec_type != AVMEDIA_TYPE_VIDEO ||
+                  os->pflags & AV_PKT_FLAG_KEY;
         }
         if (pts != AV_NOPTS_VALUE)
             break;
     }
     ogg_reset(ogg);
+
+    /* Remember every keyframe found while bisecting, so later seeks start
+     * from a narrow range. If the scan began right after the previous
+     * known keyframe, nothing lies in between and min_distance lets
+     * av_seek_frame_binary() skip searching that gap again. */
+    if (pts != AV_NOPTS_VALUE && key) {
+        int index, distance = 0;
+
+        ff_reduce_index(s, stream_index);
+        index = av_index_search_timestamp(st, pts - 1, AVSEEK_FLAG_ANY | AVSEEK_FLAG_BACKWARD);
+        if (index >= 0 && st->index_entries[index].pos < *pos_arg &&
+            start <= st->index_entries[index].pos + 1)
+            distance = *pos_arg - st->index_entries[index].pos;
+        av_add_index_entry(st, *pos_arg, pts, 0, distance, AVINDEX_KEYFRAME);
+    }
     return pts;
 }
 
@@ -644,6 +665,18 @@ static int ogg_read_seek(AVFormatContext *s, int stream_index,
     return ret;
 }
 
+static const AVOption options[] = {
+    { "scan_length", "read the end of the file to find the duration", offsetof(struct ogg, scan_length), FF_OPT_TYPE_INT, {.dbl = 1}, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    { NULL },
+};
+
+static const AVClass ogg_demuxer_class = {
+    "Ogg demuxer",
+    av_default_item_name,
+    options,
+    LIBAVUTIL_VERSION_INT,
+};
+
 static int ogg_probe(AVProbeData *p)
 {
     if (!memcmp("OggS", p->buf, 5) && p->buf[5] <= 0x7)
@@ -663,4 +696,5 @@ AVInputFormat ff_ogg_demuxer = {
     .read_timestamp = ogg_read_timestamp,
     .extensions     = "ogg",
     .flags          = AVFMT_GENERIC_INDEX,
+    .priv_class     = &ogg_demuxer_class,
 };
@@ -87,11 +87,13 @@ struct ogg_state {
 };
 
 struct ogg {
+    const AVClass *class;
     struct ogg_stream *streams;
     int nstreams;
     int headers;
     int curidx;
     struct ogg_state *state;
+    int scan_length;            ///< read the last pages on open to find the duration
 };
 
 #define OGG_FLAG_CONT 1
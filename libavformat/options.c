@@ -81,6 +81,10 @@ static const AVOption options[]={
 #endif
 {"sortdts", "try to interleave outputted packets by dts", 0, FF_OPT_TYPE_CONST, {.dbl = AVFMT_FLAG_SORT_DTS }, INT_MIN, INT_MAX, D, "fflags"},
 {"keepside", "dont merge side data", 0, FF_OPT_TYPE_CONST, {.dbl = AVFMT_FLAG_KEEP_SIDE_DATA }, INT_MIN, INT_MAX, D, "fflags"},
+{"mmap", "read local files through a memory mapping", 0, FF_OPT_TYPE_CONST, {.dbl = AVFMT_FLAG_MMAP }, INT_MIN, INT_MAX, D, "fflags"},
+{"zerocopy", "let packets reference the input buffer instead of copying it", 0, FF_OPT_TYPE_CONST, {.dbl = AVFMT_FLAG_ZEROCOPY }, INT_MIN, INT_MAX, D, "fflags"},
+{"fastinfo", "stop probing as soon as the codec parameters are known", 0, FF_OPT_TYPE_CONST, {.dbl = AVFMT_FLAG_FAST_INFO }, INT_MIN, INT_MAX, D, "fflags"},
+{"direct", "write local files bypassing the page cache", 0, FF_OPT_TYPE_CONST, {.dbl = AVFMT_FLAG_DIRECT }, INT_MIN, INT_MAX, E, "fflags"},
 {"latm", "enable RTP MP4A-LATM payload", 0, FF_OPT_TYPE_CONST, {.dbl = AVFMT_FLAG_MP4A_LATM }, INT_MIN, INT_MAX, E, "fflags"},
 {"analyzeduration", "how many microseconds are analyzed to estimate duration", OFFSET(max_analyze_duration), FF_OPT_TYPE_INT, {.dbl = 5*AV_TIME_BASE }, 0, INT_MAX, D},
 {"cryptokey", "decryption key", OFFSET(key), FF_OPT_TYPE_BINARY, {.dbl = 0}, 0, 0, D},
@@ -90,6 +94,9 @@ static const AVOption options[]={
 {"ts", NULL, 0, FF_OPT_TYPE_CONST, {.dbl = FF_FDEBUG_TS }, INT_MIN, INT_MAX, E|D, "fdebug"},
 {"max_delay", "maximum muxing or demuxing delay in microseconds", OFFSET(max_delay), FF_OPT_TYPE_INT, {.dbl = DEFAULT }, 0, INT_MAX, E|D},
 {"fpsprobesize", "number of frames used to probe fps", OFFSET(fps_probe_size), FF_OPT_TYPE_INT, {.dbl = -1}, -1, INT_MAX-1, D},
+{"async_buffer_size", "size of the buffer read ahead or written behind in a background thread", OFFSET(async_buffer_size), FF_OPT_TYPE_INT, {.dbl = DEFAULT }, 0, INT_MAX / 2, D|E},
+{"index_cache", "file caching the index entries of the input", OFFSET(index_cache), FF_OPT_TYPE_STRING, {.str = NULL}, 0, 0, D},
+{"max_interleave_delta", "maximum buffering duration for interleaving, in microseconds", OFFSET(max_interleave_delta), FF_OPT_TYPE_INT64, {.dbl = 10000000 }, 0, INT64_MAX, E},
 {NULL},
 };
 
@@ -22,6 +22,7 @@
 
 #include "avformat.h"
 #include "avio_internal.h"
+#include "internal.h"
 #include "rawdec.h"
 #include "libavutil/opt.h"
 #include "libavutil/parseutils.h"
@@ -37,6 +38,8 @@ int ff_raw_read_header(AVFormatContext *s, AVFormatParameters *ap)
     if (!st)
         return AVERROR(ENOMEM);
 
+        if (s->flags & AVFMT_FLAG_ZEROCOPY)
+            ffio_enable_lending(s->pb);
         id = s->iformat->value;
         if (id == CODEC_ID_RAWVIDEO) {
             st->codec->codec_type = AVMEDIA_TYPE_VIDEO;
@@ -114,21 +117,9 @@ fail:
 
 int ff_raw_read_partial_packet(AVFormatContext *s, AVPacket *pkt)
 {
-    int ret, size;
+    int ret = ff_get_partial_packet(s->pb, pkt, RAW_PACKET_SIZE);
 
-    size = RAW_PACKET_SIZE;
-
-    if (av_new_packet(pkt, size) < 0)
-        return AVERROR(ENOMEM);
-
-    pkt->pos= avio_tell(s->pb);
     pkt->stream_index = 0;
-    ret = ffio_read_partial(s->pb, pkt->data, size);
-    if (ret < 0) {
-        av_free_packet(pkt);
-        return ret;
-    }
-    pkt->size = ret;
     return ret;
 }
 
@@ -143,6 +134,8 @@ int ff_raw_audio_read_header(AVFormatContext *s,
     st->need_parsing = AVSTREAM_PARSE_FULL;
     st->start_time = 0;
     /* the parameters will be extracted from the compressed bitstream */
+    if (s->flags & AVFMT_FLAG_ZEROCOPY)
+        ffio_enable_lending(s->pb);
 
     return 0;
 }
@@ -166,6 +159,8 @@ int ff_raw_video_read_header(AVFormatContext *s,
     st->codec->codec_type = AVMEDIA_TYPE_VIDEO;
     st->codec->codec_id = s->iformat->value;
     st->need_parsing = AVSTREAM_PARSE_FULL;
+    if (s->flags & AVFMT_FLAG_ZEROCOPY)
+        ffio_enable_lending(s->pb);
 
     if ((ret = av_parse_video_rate(&framerate, s1->framerate)) < 0) {
         av_log(s, AV_LOG_ERROR, "Could not parse framerate: %s.\n", s1->framerate);
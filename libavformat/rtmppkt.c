@@ -71,7 +71,9 @@ void ff_amf_write_object_end(uint8_t **dst)
 }
 
 int ff_rtmp_packet_read(URLContext *h, RTMPPacket *p,
-                        int chunk_size, RTMPPacket *prev_pkt)
+                        int chunk_size, RTMPPacket *prev_pkt,
+                        uint8_t **buf_ptr, unsigned int *buf_size,
+                        int headroom, int tailroom)
 {
     uint8_t hdr, t, buf[16];
     int channel_id, timestamp, data_size, offset = 0;
@@ -128,9 +130,16 @@ int ff_rtmp_packet_read(URLContext *h, RTMPPacket *p,
     if (hdr != RTMP_PS_TWELVEBYTES)
         timestamp += prev_pkt[channel_id].timestamp;
 
-    if (ff_rtmp_packet_create(p, channel_id, type, timestamp, data_size))
-        return -1;
-    p->extra = extra;
+    av_fast_malloc(buf_ptr, buf_size, headroom + data_size + tailroom);
+    if (!*buf_ptr)
+        return AVERROR(ENOMEM);
+    p->data       = *buf_ptr + headroom;
+    p->data_size  = data_size;
+    p->channel_id = channel_id;
+    p->type       = type;
+    p->timestamp  = timestamp;
+    p->extra      = extra;
+    p->ts_delta   = 0;
     // save history
     prev_pkt[channel_id].channel_id = channel_id;
     prev_pkt[channel_id].type       = type;
@@ -140,10 +149,8 @@ int ff_rtmp_packet_read(URLContext *h, RTMPPacket *p,
     prev_pkt[channel_id].extra      = extra;
     while (data_size > 0) {
         int toread = FFMIN(data_size, chunk_size);
-        if (ffurl_read_complete(h, p->data + offset, toread) != toread) {
-            ff_rtmp_packet_destroy(p);
+        if (ffurl_read_complete(h, p->data + offset, toread) != toread)
             return AVERROR(EIO);
-        }
         data_size -= chunk_size;
         offset    += chunk_size;
         size      += chunk_size;
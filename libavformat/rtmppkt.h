@@ -105,16 +105,24 @@ void ff_rtmp_packet_destroy(RTMPPacket *pkt);
 
 /**
  * Read RTMP packet sent by the server.
+ * The chunks of the packet are reassembled in a buffer reused from packet
+ * to packet, which must not be freed with ff_rtmp_packet_destroy().
  *
  * @param h          reader context
- * @param p          packet
+ * @param p          packet, its data points into *buf_ptr
  * @param chunk_size current chunk size
  * @param prev_pkt   previously read packet headers for all channels
  *                   (may be needed for restoring incomplete packet header)
+ * @param buf_ptr    reassembly buffer, grown with av_fast_malloc()
+ * @param buf_size   allocated size of *buf_ptr
+ * @param headroom   number of bytes to leave free before the packet data
+ * @param tailroom   number of bytes to leave free after the packet data
  * @return number of bytes read on success, negative value otherwise
  */
 int ff_rtmp_packet_read(URLContext *h, RTMPPacket *p,
-                        int chunk_size, RTMPPacket *prev_pkt);
+                        int chunk_size, RTMPPacket *prev_pkt,
+                        uint8_t **buf_ptr, unsigned int *buf_size,
+                        int headroom, int tailroom);
 
 /**
  * Send RTMP packet to the server.
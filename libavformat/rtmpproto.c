@@ -64,6 +64,8 @@ typedef struct RTMPContext {
     ClientState   state;                      ///< current state
     int           main_channel_id;            ///< an additional channel ID which is used for some invocations
     uint8_t*      flv_data;                   ///< buffer with data for demuxer
+    uint8_t*      read_buf;                   ///< buffer the packets from the server are read into
+    unsigned int  read_buf_size;              ///< allocated size of read_buf
     int           flv_size;                   ///< current buffer size
     int           flv_off;                    ///< number of bytes read from current buffer
     RTMPPacket    out_pkt;                    ///< rtmp packet, created from flv a/v or metadata (for output)
@@ -72,6 +74,8 @@ typedef struct RTMPContext {
     uint32_t      last_bytes_read;            ///< number of bytes read last reported to server
 } RTMPContext;
 
+#define FLV_TAG_HEADER_SIZE 11        ///< size of the header of a FLV tag, before its data
+
 #define PLAYER_KEY_OPEN_PART_LEN 30   ///< length of partial key used for first client digest signing
 /** Client key used for digest signing */
 static const uint8_t rtmp_player_key[] = {
@@ -684,8 +688,11 @@ static int get_packet(URLContext *s, int for_header)
 
     for (;;) {
         RTMPPacket rpkt = { 0 };
+        /* leave room around the data to make a FLV tag of it in place */
         if ((ret = ff_rtmp_packet_read(rt->stream, &rpkt,
-                                       rt->chunk_size, rt->prev_pkt[0])) <= 0) {
+                                       rt->chunk_size, rt->prev_pkt[0],
+                                       &rt->read_buf, &rt->read_buf_size,
+                                       FLV_TAG_HEADER_SIZE, 4)) <= 0) {
             if (ret == 0) {
                 return AVERROR(EAGAIN);
             } else {
@@ -700,44 +707,35 @@ static int get_packet(URLContext *s, int for_header)
         }
 
         ret = rtmp_parse_result(s, rt, &rpkt);
-        if (ret < 0) {//serious error in current packet
-            ff_rtmp_packet_destroy(&rpkt);
+        if (ret < 0) //serious error in current packet
             return -1;
-        }
-        if (rt->state == STATE_STOPPED) {
-            ff_rtmp_packet_destroy(&rpkt);
+        if (rt->state == STATE_STOPPED)
             return AVERROR_EOF;
-        }
-        if (for_header && (rt->state == STATE_PLAYING || rt->state == STATE_PUBLISHING)) {
-            ff_rtmp_packet_destroy(&rpkt);
+        if (for_header && (rt->state == STATE_PLAYING || rt->state == STATE_PUBLISHING))
             return 0;
-        }
-        if (!rpkt.data_size || !rt->is_input) {
-            ff_rtmp_packet_destroy(&rpkt);
+        if (!rpkt.data_size || !rt->is_input)
             continue;
-        }
         if (rpkt.type == RTMP_PT_VIDEO || rpkt.type == RTMP_PT_AUDIO ||
            (rpkt.type == RTMP_PT_NOTIFY && !memcmp("\002\000\012onMetaData", rpkt.data, 13))) {
             ts = rpkt.timestamp;
 
-            // generate packet header and put data into buffer for FLV demuxer
+            // generate packet header around the data for FLV demuxer
             rt->flv_off  = 0;
-            rt->flv_size = rpkt.data_size + 15;
-            rt->flv_data = p = av_realloc(rt->flv_data, rt->flv_size);
+            rt->flv_size = rpkt.data_size + FLV_TAG_HEADER_SIZE + 4;
+            rt->flv_data = p = rpkt.data - FLV_TAG_HEADER_SIZE;
             bytestream_put_byte(&p, rpkt.type);
             bytestream_put_be24(&p, rpkt.data_size);
             bytestream_put_be24(&p, ts);
             bytestream_put_byte(&p, ts >> 24);
             bytestream_put_be24(&p, 0);
-            bytestream_put_buffer(&p, rpkt.data, rpkt.data_size);
+            p += rpkt.data_size;
             bytestream_put_be32(&p, 0);
-            ff_rtmp_packet_destroy(&rpkt);
             return 0;
         } else if (rpkt.type == RTMP_PT_METADATA) {
             // we got raw FLV data, make it available for FLV demuxer
             rt->flv_off  = 0;
             rt->flv_size = rpkt.data_size;
-            rt->flv_data = av_realloc(rt->flv_data, rt->flv_size);
+            rt->flv_data = rpkt.data;
             /* rewrite timestamps */
             next = rpkt.data;
             ts = rpkt.timestamp;
@@ -755,11 +753,8 @@ static int get_packet(URLContext *s, int for_header)
                 bytestream_put_byte(&p, ts >> 24);
                 next += data_size + 3 + 4;
             }
-            memcpy(rt->flv_data, rpkt.data, rpkt.data_size);
-            ff_rtmp_packet_destroy(&rpkt);
             return 0;
         }
-        ff_rtmp_packet_destroy(&rpkt);
     }
     return 0;
 }
@@ -778,7 +773,7 @@ static int rtmp_close(URLContext *h)
     if (rt->state > STATE_HANDSHAKED)
         gen_delete_stream(h, rt);
 
-    av_freep(&rt->flv_data);
+    av_freep(&rt->read_buf);
     ffurl_close(rt->stream);
     av_free(rt);
     return 0;
@@ -872,7 +867,10 @@ static int rtmp_open(URLContext *s, const char *uri, int flags)
     if (rt->is_input) {
         // generate FLV header for demuxer
         rt->flv_size = 13;
-        rt->flv_data = av_realloc(rt->flv_data, rt->flv_size);
+        av_fast_malloc(&rt->read_buf, &rt->read_buf_size, rt->flv_size);
+        if (!rt->read_buf)
+            goto fail;
+        rt->flv_data = rt->read_buf;
         rt->flv_off  = 0;
         memcpy(rt->flv_data, "FLV\1\5\0\0\0\011\0\0\0\0", rt->flv_size);
     } else {
@@ -386,7 +386,22 @@ RTPDemuxContext *rtp_parse_open(AVFormatContext *s1, AVStream *st, URLContext *r
     s->first_rtcp_ntp_time = AV_NOPTS_VALUE;
     s->ic = s1;
     s->st = st;
-    s->queue_size = queue_size;
+    if (queue_size > 1) {
+        /* leave room for gaps in the sequence numbers of the queued packets */
+        int slots = 256;
+        while (slots < 4 * queue_size)
+            slots <<= 1;
+        s->queue     = av_mallocz(slots * sizeof(*s->queue));
+        s->free_bufs = av_malloc((queue_size + 1) * sizeof(*s->free_bufs));
+        if (!s->queue || !s->free_bufs) {
+            av_free(s->queue);
+            av_free(s->free_bufs);
+            av_free(s);
+            return NULL;
+        }
+        s->queue_mask = slots - 1;
+        s->queue_size = queue_size;
+    }
     rtp_init_statistics(&s->statistics, 0); // do we know the initial sequence from sdp?
     if (!strcmp(ff_rtp_enc_name(payload_type), "MP2T")) {
         s->ts = ff_mpegts_parse_open(s->ic);
@@ -578,77 +593,129 @@ static int rtp_parse_packet_internal(RTPDemuxContext *s, AVPacket *pkt,
     return rv;
 }
 
+/**
+ * Keep the buffer of a returned packet, to give it back to the caller in
+ * exchange for the buffer of the next queued packet.
+ */
+static void release_buf(RTPDemuxContext *s, uint8_t *buf)
+{
+    if (s->nb_free_bufs <= s->queue_size)
+        s->free_bufs[s->nb_free_bufs++] = buf;
+    else
+        av_free(buf);
+}
+
 void ff_rtp_reset_packet_queue(RTPDemuxContext *s)
 {
-    while (s->queue) {
-        RTPPacket *next = s->queue->next;
-        av_free(s->queue->buf);
-        av_free(s->queue);
-        s->queue = next;
+    int i;
+
+    for (i = 0; i < s->queue_mask + 1 && s->queue_len; i++) {
+        if (s->queue[i].buf) {
+            release_buf(s, s->queue[i].buf);
+            s->queue[i].buf = NULL;
+            s->queue_len--;
+        }
+    }
+    if (s->pending.buf) {
+        release_buf(s, s->pending.buf);
+        s->pending.buf = NULL;
     }
     s->seq       = 0;
     s->queue_len = 0;
     s->prev_ret  = 0;
 }
 
-static void enqueue_packet(RTPDemuxContext *s, uint8_t *buf, int len)
+/**
+ * Check that the queued packets would still span fewer sequence numbers
+ * than there are slots with this packet added, so that they all have
+ * their own slot.
+ */
+static int fits_in_queue(RTPDemuxContext *s, const uint8_t *buf)
 {
     uint16_t seq = AV_RB16(buf + 2);
-    RTPPacket *cur = s->queue, *prev = NULL, *packet;
+    uint16_t head = (int16_t)(seq - s->queue_head) < 0 ? seq : s->queue_head;
+    uint16_t tail = (int16_t)(seq - s->queue_tail) > 0 ? seq : s->queue_tail;
 
-    /* Find the correct place in the queue to insert the packet */
-    while (cur) {
-        int16_t diff = seq - cur->seq;
-        if (diff < 0)
-            break;
-        prev = cur;
-        cur = cur->next;
-    }
+    return !s->queue_len || (uint16_t)(tail - head) <= s->queue_mask;
+}
 
-    packet = av_mallocz(sizeof(*packet));
-    if (!packet)
+/**
+ * Store a packet in its slot of the queue, see fits_in_queue().
+ */
+static void queue_packet(RTPDemuxContext *s, const RTPPacket *packet)
+{
+    uint16_t seq = AV_RB16(packet->buf + 2);
+    RTPPacket *slot = &s->queue[seq & s->queue_mask];
+
+    if (slot->buf) {
+        av_log(s->st ? s->st->codec : NULL, AV_LOG_WARNING,
+               "RTP: dropping duplicate packet\n");
+        release_buf(s, packet->buf);
         return;
-    packet->recvtime = av_gettime();
-    packet->seq = seq;
-    packet->len = len;
-    packet->buf = buf;
-    packet->next = cur;
-    if (prev)
-        prev->next = packet;
-    else
-        s->queue = packet;
+    }
+    *slot = *packet;
+    if (!s->queue_len || (int16_t)(seq - s->queue_head) < 0)
+        s->queue_head = seq;
+    if (!s->queue_len || (int16_t)(seq - s->queue_tail) > 0)
+        s->queue_tail = seq;
     s->queue_len++;
 }
 
+/**
+ * Take over the buffer of a packet, replacing it with a free one if any.
+ */
+static void enqueue_packet(RTPDemuxContext *s, uint8_t **bufptr, int len)
+{
+    RTPPacket packet = { *bufptr, len, av_gettime() };
+
+    *bufptr = s->nb_free_bufs ? s->free_bufs[--s->nb_free_bufs] : NULL;
+    if (fits_in_queue(s, packet.buf)) {
+        queue_packet(s, &packet);
+    } else if (!s->pending.buf) {
+        /* Too far ahead, wait until enough of the queue has been returned */
+        s->pending = packet;
+    } else {
+        av_log(s->st ? s->st->codec : NULL, AV_LOG_WARNING,
+               "RTP: dropping packet, reordering queue overflow\n");
+        release_buf(s, packet.buf);
+    }
+}
+
 static int has_next_packet(RTPDemuxContext *s)
 {
-    return s->queue && s->queue->seq == (uint16_t) (s->seq + 1);
+    return s->pending.buf ||
+           (s->queue_len && s->queue_head == (uint16_t) (s->seq + 1));
 }
 
 int64_t ff_rtp_queued_packet_time(RTPDemuxContext *s)
 {
-    return s->queue ? s->queue->recvtime : 0;
+    return s->queue_len ? s->queue[s->queue_head & s->queue_mask].recvtime : 0;
 }
 
 static int rtp_parse_queued_packet(RTPDemuxContext *s, AVPacket *pkt)
 {
     int rv;
-    RTPPacket *next;
+    RTPPacket *slot;
 
     if (s->queue_len <= 0)
         return -1;
 
-    if (!has_next_packet(s))
+    if (s->queue_head != (uint16_t) (s->seq + 1))
         av_log(s->st ? s->st->codec : NULL, AV_LOG_WARNING,
-               "RTP: missed %d packets\n", s->queue->seq - s->seq - 1);
+               "RTP: missed %d packets\n", (uint16_t) (s->queue_head - s->seq - 1));
 
     /* Parse the first packet in the queue, and dequeue it */
-    rv = rtp_parse_packet_internal(s, pkt, s->queue->buf, s->queue->len);
-    next = s->queue->next;
-    av_free(s->queue->buf);
-    av_free(s->queue);
-    s->queue = next;
-    s->queue_len--;
+    slot = &s->queue[s->queue_head & s->queue_mask];
+    rv = rtp_parse_packet_internal(s, pkt, slot->buf, slot->len);
+    release_buf(s, slot->buf);
+    slot->buf = NULL;
+    if (--s->queue_len)
+        while (!s->queue[++s->queue_head & s->queue_mask].buf);
+
+    if (s->pending.buf && fits_in_queue(s, s->pending.buf)) {
+        queue_packet(s, &s->pending);
+        s->pending.buf = NULL;
+    }
     return rv;
 }
 
@@ -700,7 +767,7 @@ static int rtp_parse_one_packet(RTPDemuxContext *s, AVPacket *pkt,
         return rtcp_parse_packet(s, buf, len);
     }
 
-    if ((s->seq == 0 && !s->queue) || s->queue_size <= 1) {
+    if ((s->seq == 0 && !s->queue_len) || s->queue_size <= 1) {
         /* First packet, or no reordering */
         return rtp_parse_packet_internal(s, pkt, buf, len);
     } else {
@@ -715,13 +782,18 @@ static int rtp_parse_one_packet(RTPDemuxContext *s, AVPacket *pkt,
             /* Correct packet */
             rv = rtp_parse_packet_internal(s, pkt, buf, len);
             return rv;
+        } else if ((int16_t)(seq - s->queue_head) < 0 && !fits_in_queue(s, buf)) {
+            /* Older than all the queued packets, but too far from them to
+             * be queued: return it right away, even if we're missing
+             * something */
+            return rtp_parse_packet_internal(s, pkt, buf, len);
         } else {
             /* Still missing some packet, enqueue this one. */
-            enqueue_packet(s, buf, len);
-            *bufptr = NULL;
-            /* Return the first enqueued packet if the queue is full,
-             * even if we're missing something */
-            if (s->queue_len >= s->queue_size)
+            enqueue_packet(s, bufptr, len);
+            /* Return the first enqueued packet if the queue is full or
+             * the packet is too far ahead for it, even if we're missing
+             * something */
+            if (s->queue_len >= s->queue_size || s->pending.buf)
                 return rtp_parse_queued_packet(s, pkt);
             return -1;
         }
@@ -732,7 +804,9 @@ static int rtp_parse_one_packet(RTPDemuxContext *s, AVPacket *pkt,
  * Parse an RTP or RTCP packet directly sent as a buffer.
  * @param s RTP parse context.
  * @param pkt returned packet
- * @param bufptr pointer to the input buffer or NULL to read the next packets
+ * @param bufptr pointer to the input buffer or NULL to read the next packets;
+ *               a buffer kept for reordering is replaced by the buffer of an
+ *               earlier packet of the same size, or by NULL
  * @param len buffer len
  * @return 0 if a packet is returned, 1 if a packet is returned and more can follow
  * (use buf as NULL to read the next). -1 if no packet (error or no more packet).
@@ -750,6 +824,10 @@ int rtp_parse_packet(RTPDemuxContext *s, AVPacket *pkt,
 void rtp_parse_close(RTPDemuxContext *s)
 {
     ff_rtp_reset_packet_queue(s);
+    while (s->nb_free_bufs)
+        av_free(s->free_bufs[--s->nb_free_bufs]);
+    av_free(s->free_bufs);
+    av_free(s->queue);
     if (!strcmp(ff_rtp_enc_name(s->payload_type), "MP2T")) {
         ff_mpegts_parse_close(s->ts);
     }
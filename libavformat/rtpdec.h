@@ -134,11 +134,9 @@ struct RTPDynamicProtocolHandler_s {
 };
 
 typedef struct RTPPacket {
-    uint16_t seq;
     uint8_t *buf;
     int len;
     int64_t recvtime;
-    struct RTPPacket *next;
 } RTPPacket;
 
 // moved out of rtp.c, because the h264 decoder needs to know about this structure..
@@ -164,9 +162,15 @@ struct RTPDemuxContext {
 
     /** Fields for packet reordering @{ */
     int prev_ret;     ///< The return value of the actual parsing of the previous packet
-    RTPPacket* queue; ///< A sorted queue of buffered packets not yet returned
+    RTPPacket* queue; ///< Ring of buffered packets not yet returned, indexed by sequence number
+    int queue_mask;   ///< The number of slots in queue minus one
+    uint16_t queue_head; ///< The sequence number of the first packet in queue
+    uint16_t queue_tail; ///< The sequence number of the last packet in queue
     int queue_len;    ///< The number of packets in queue
     int queue_size;   ///< The size of queue, or 0 if reordering is disabled
+    RTPPacket pending; ///< A packet too far ahead to fit in queue until it drains
+    uint8_t **free_bufs; ///< Buffers of returned packets, handed back to the caller
+    int nb_free_bufs;
     /*@}*/
 
     /* rtcp sender statistics receive */
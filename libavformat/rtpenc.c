@@ -23,6 +23,7 @@
 #include "mpegts.h"
 #include "internal.h"
 #include "libavutil/random_seed.h"
+#include "libavutil/intreadwrite.h"
 #include "libavutil/opt.h"
 
 #include "rtpenc.h"
@@ -370,14 +371,11 @@ static void rtp_send_mpegts_raw(AVFormatContext *s1,
     }
 }
 
-static int rtp_write_packet(AVFormatContext *s1, AVPacket *pkt)
+/* send a sender report if the first packet or enough data went out */
+static void rtcp_send_sr_if_due(AVFormatContext *s1)
 {
     RTPMuxContext *s = s1->priv_data;
-    AVStream *st = s1->streams[0];
     int rtcp_bytes;
-    int size= pkt->size;
-
-    av_dlog(s1, "%d: write len=%d\n", pkt->stream_index, size);
 
     rtcp_bytes = ((s->octet_count - s->last_octet_count) * RTCP_TX_RATIO_NUM) /
         RTCP_TX_RATIO_DEN;
@@ -387,6 +385,49 @@ static int rtp_write_packet(AVFormatContext *s1, AVPacket *pkt)
         s->last_octet_count = s->octet_count;
         s->first_packet = 0;
     }
+}
+
+void ff_rtp_send_packetized(AVFormatContext *s1, const uint8_t *buf, int size,
+                            uint32_t base_timestamp)
+{
+    RTPMuxContext *s = s1->priv_data;
+    const uint8_t *end = buf + size;
+
+    rtcp_send_sr_if_due(s1);
+
+    while (end - buf >= 4) {
+        int len = AV_RB32(buf);
+        buf += 4;
+        if (len < 12 || len > end - buf)
+            break;
+        /* RTCP packets of the other muxer are dropped, we send our own */
+        if (buf[1] < RTCP_SR || buf[1] > RTCP_APP) {
+            s->timestamp = AV_RB32(buf + 4) - base_timestamp + s->base_timestamp;
+            avio_w8(s1->pb, buf[0]);
+            avio_w8(s1->pb, (buf[1] & 0x80) | (s->payload_type & 0x7f));
+            avio_wb16(s1->pb, s->seq);
+            avio_wb32(s1->pb, s->timestamp);
+            avio_wb32(s1->pb, s->ssrc);
+            avio_write(s1->pb, buf + 12, len - 12);
+            avio_flush(s1->pb);
+
+            s->seq++;
+            s->octet_count += len - 12;
+            s->packet_count++;
+        }
+        buf += len;
+    }
+}
+
+static int rtp_write_packet(AVFormatContext *s1, AVPacket *pkt)
+{
+    RTPMuxContext *s = s1->priv_data;
+    AVStream *st = s1->streams[0];
+    int size= pkt->size;
+
+    av_dlog(s1, "%d: write len=%d\n", pkt->stream_index, size);
+
+    rtcp_send_sr_if_due(s1);
     s->cur_timestamp = s->base_timestamp + pkt->pts;
 
     switch(st->codec->codec_id) {
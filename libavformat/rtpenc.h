@@ -71,6 +71,19 @@ typedef struct RTPMuxContext RTPMuxContext;
 
 void ff_rtp_send_data(AVFormatContext *s1, const uint8_t *buf1, int len, int m);
 
+/**
+ * Send packets produced by another RTP muxer for the same stream, so that
+ * a stream is packetized once for any number of receivers. The sequence
+ * number, timestamp and SSRC of every packet are replaced by the ones of
+ * this muxer, which also sends its own sender reports.
+ *
+ * @param buf RTP packets, each preceded by its size on 4 bytes, as output
+ *            by a dynamic packet buffer; RTCP packets in it are skipped
+ * @param base_timestamp base timestamp of the muxer that produced buf
+ */
+void ff_rtp_send_packetized(AVFormatContext *s1, const uint8_t *buf, int size,
+                            uint32_t base_timestamp);
+
 void ff_rtp_send_h264(AVFormatContext *s1, const uint8_t *buf1, int size);
 void ff_rtp_send_h263(AVFormatContext *s1, const uint8_t *buf1, int size);
 void ff_rtp_send_aac(AVFormatContext *s1, const uint8_t *buff, int size);
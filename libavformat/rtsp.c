@@ -54,6 +54,9 @@
 #define MAX_TIMEOUTS READ_PACKET_TIMEOUT_S * 1000 / POLL_TIMEOUT_MS
 #define SDP_MAX_SIZE 16384
 #define RECVBUF_SIZE 10 * RTP_MAX_PACKET_LENGTH
+/* large enough for a complete interleaved frame ('$', id, 16-bit length
+ * and payload) plus the data read ahead of it */
+#define RTSP_TCP_BUF_SIZE (1 << 17)
 
 static void get_word_until_chars(char *buf, int buf_size,
                                  const char *sep, const char **pp)
@@ -815,30 +818,81 @@ void ff_rtsp_parse_line(RTSPMessageHeader *reply, const char *buf,
     }
 }
 
+/**
+ * Make sure at least size bytes of the RTSP connection are available
+ * contiguously in the receive buffer, reading as much as fits each time.
+ * @return 0 on success, a negative value on error or end of stream
+ */
+static int rtsp_fill_buf(RTSPState *rt, int size)
+{
+    int ret;
+
+    if (!rt->tcp_buf) {
+        rt->tcp_buf = av_malloc(RTSP_TCP_BUF_SIZE);
+        if (!rt->tcp_buf)
+            return AVERROR(ENOMEM);
+        rt->tcp_buf_ptr = rt->tcp_buf_end = rt->tcp_buf;
+    }
+    if (rt->tcp_buf_ptr + size > rt->tcp_buf + RTSP_TCP_BUF_SIZE) {
+        memmove(rt->tcp_buf, rt->tcp_buf_ptr, rt->tcp_buf_end - rt->tcp_buf_ptr);
+        rt->tcp_buf_end -= rt->tcp_buf_ptr - rt->tcp_buf;
+        rt->tcp_buf_ptr  = rt->tcp_buf;
+    }
+    while (rt->tcp_buf_end - rt->tcp_buf_ptr < size) {
+        ret = ffurl_read(rt->rtsp_hd, rt->tcp_buf_end,
+                         rt->tcp_buf + RTSP_TCP_BUF_SIZE - rt->tcp_buf_end);
+        if (ret <= 0)
+            return ret < 0 ? ret : AVERROR_EOF;
+        rt->tcp_buf_end += ret;
+    }
+    return 0;
+}
+
+uint8_t *ff_rtsp_read_inplace(RTSPState *rt, int size)
+{
+    uint8_t *data;
+
+    if (size > RTSP_TCP_BUF_SIZE || rtsp_fill_buf(rt, size) < 0)
+        return NULL;
+    data = rt->tcp_buf_ptr;
+    rt->tcp_buf_ptr += size;
+    return data;
+}
+
+/**
+ * Read size bytes from the RTSP connection into buf.
+ * @return the number of bytes read, less than size only at end of stream
+ */
+static int rtsp_read(RTSPState *rt, uint8_t *buf, int size)
+{
+    int len = 0, len1;
+
+    while (len < size) {
+        if (rt->tcp_buf_ptr == rt->tcp_buf_end && rtsp_fill_buf(rt, 1) < 0)
+            break;
+        len1 = FFMIN(rt->tcp_buf_end - rt->tcp_buf_ptr, size - len);
+        memcpy(buf + len, rt->tcp_buf_ptr, len1);
+        rt->tcp_buf_ptr += len1;
+        len += len1;
+    }
+    return len;
+}
+
 /* skip a RTP/TCP interleaved packet */
 void ff_rtsp_skip_packet(AVFormatContext *s)
 {
     RTSPState *rt = s->priv_data;
-    int ret, len, len1;
-    uint8_t buf[1024];
+    uint8_t *hdr;
+    int len;
 
-    ret = ffurl_read_complete(rt->rtsp_hd, buf, 3);
-    if (ret != 3)
+    if (!(hdr = ff_rtsp_read_inplace(rt, 3)))
         return;
-    len = AV_RB16(buf + 1);
+    len = AV_RB16(hdr + 1);
 
     av_dlog(s, "skipping RTP packet len=%d\n", len);
 
     /* skip payload */
-    while (len > 0) {
-        len1 = len;
-        if (len1 > sizeof(buf))
-            len1 = sizeof(buf);
-        ret = ffurl_read_complete(rt->rtsp_hd, buf, len1);
-        if (ret != len1)
-            return;
-        len -= len1;
-    }
+    ff_rtsp_read_inplace(rt, len);
 }
 
 int ff_rtsp_read_reply(AVFormatContext *s, RTSPMessageHeader *reply,
@@ -854,12 +908,12 @@ int ff_rtsp_read_reply(AVFormatContext *s, RTSPMessageHeader *reply,
 
     memset(reply, 0, sizeof(*reply));
 
-    /* parse reply (XXX: use buffers) */
+    /* parse reply */
     rt->last_reply[0] = '\0';
     for (;;) {
         q = buf;
         for (;;) {
-            ret = ffurl_read_complete(rt->rtsp_hd, &ch, 1);
+            ret = rtsp_read(rt, &ch, 1);
             av_dlog(s, "ret=%d c=%02x [%c]\n", ret, ch, ch);
             if (ret != 1)
                 return AVERROR_EOF;
@@ -905,7 +959,7 @@ int ff_rtsp_read_reply(AVFormatContext *s, RTSPMessageHeader *reply,
     if (content_length > 0) {
         /* leave some room for a trailing '\0' (useful for simple parsing) */
         content = av_malloc(content_length + 1);
-        ffurl_read_complete(rt->rtsp_hd, content, content_length);
+        rtsp_read(rt, content, content_length);
         content[content_length] = '\0';
     }
     if (content_ptr)
@@ -1302,6 +1356,8 @@ void ff_rtsp_close_connections(AVFormatContext *s)
     if (rt->rtsp_hd_out != rt->rtsp_hd) ffurl_close(rt->rtsp_hd_out);
     ffurl_close(rt->rtsp_hd);
     rt->rtsp_hd = rt->rtsp_hd_out = NULL;
+    av_freep(&rt->tcp_buf);
+    rt->tcp_buf_ptr = rt->tcp_buf_end = NULL;
 }
 
 int ff_rtsp_connect(AVFormatContext *s)
@@ -1588,7 +1644,14 @@ static int udp_read_packet(AVFormatContext *s, RTSPStream **prtsp_st,
                 p[max_p++].events = POLLIN;
             }
         }
-        n = poll(p, max_p, POLL_TIMEOUT_MS);
+        /* data already buffered from the RTSP connection must not wait
+         * for the socket to become readable again */
+        if (tcp_fd != -1 && rt->tcp_buf_ptr != rt->tcp_buf_end) {
+            n = 1;
+            memset(p, 0, max_p * sizeof(*p));
+            p[0].revents = POLLIN;
+        } else
+            n = poll(p, max_p, POLL_TIMEOUT_MS);
         if (n > 0) {
             int j = 1 - (tcp_fd == -1);
             timeout_cnt = 0;
@@ -1630,6 +1693,7 @@ int ff_rtsp_fetch_packet(AVFormatContext *s, AVPacket *pkt)
     int ret, len;
     RTSPStream *rtsp_st, *first_queue_st = NULL;
     int64_t wait_end = 0;
+    uint8_t *tcp_data, **bufptr = &rt->recvbuf;
 
     if (rt->nb_byes == rt->nb_rtsp_streams)
         return AVERROR_EOF;
@@ -1680,7 +1744,11 @@ int ff_rtsp_fetch_packet(AVFormatContext *s, AVPacket *pkt)
     default:
 #if CONFIG_RTSP_DEMUXER
     case RTSP_LOWER_TRANSPORT_TCP:
-        len = ff_rtsp_tcp_read_packet(s, &rtsp_st, rt->recvbuf, RECVBUF_SIZE);
+        /* parse interleaved packets straight out of the receive buffer;
+         * the RTP reordering queue, which would take the buffer over,
+         * is not used for TCP */
+        len = ff_rtsp_tcp_read_packet(s, &rtsp_st, &tcp_data);
+        bufptr = &tcp_data;
         break;
 #endif
     case RTSP_LOWER_TRANSPORT_UDP:
@@ -1701,9 +1769,9 @@ int ff_rtsp_fetch_packet(AVFormatContext *s, AVPacket *pkt)
     if (len == 0)
         return AVERROR_EOF;
     if (rt->transport == RTSP_TRANSPORT_RDT) {
-        ret = ff_rdt_parse_packet(rtsp_st->transport_priv, pkt, &rt->recvbuf, len);
+        ret = ff_rdt_parse_packet(rtsp_st->transport_priv, pkt, bufptr, len);
     } else {
-        ret = rtp_parse_packet(rtsp_st->transport_priv, pkt, &rt->recvbuf, len);
+        ret = rtp_parse_packet(rtsp_st->transport_priv, pkt, bufptr, len);
         if (ret < 0) {
             /* Either bad packet, or a RTCP packet. Check if the
              * first_rtcp_ntp_time field was initialized. */
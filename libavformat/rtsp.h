@@ -316,6 +316,10 @@ typedef struct RTSPState {
     /** Reusable buffer for receiving packets */
     uint8_t* recvbuf;
 
+    /** Buffer for the data read from rtsp_hd; replies are parsed and
+     * interleaved packets handed out directly from it. */
+    uint8_t *tcp_buf, *tcp_buf_ptr, *tcp_buf_end;
+
     /** Filter incoming UDP packets - receive packets only from the right
      * source address and port. */
     int filter_source;
@@ -462,6 +466,14 @@ int ff_rtsp_read_reply(AVFormatContext *s, RTSPMessageHeader *reply,
                        unsigned char **content_ptr,
                        int return_on_interleaved_data, const char *method);
 
+/**
+ * Read size bytes from the RTSP connection through its receive buffer.
+ *
+ * @return a pointer to the data, which stays valid until the next read
+ *         from the connection, or NULL on error or end of stream
+ */
+uint8_t *ff_rtsp_read_inplace(RTSPState *rt, int size);
+
 /**
  * Skip a RTP/TCP interleaved packet.
  */
@@ -512,9 +524,12 @@ int ff_sdp_parse(AVFormatContext *s, const char *content);
 
 /**
  * Receive one RTP packet from an TCP interleaved RTSP stream.
+ *
+ * @param pbuf set to the packet data, which points into the receive buffer
+ *             of the connection and is only valid until the next read
  */
 int ff_rtsp_tcp_read_packet(AVFormatContext *s, RTSPStream **prtsp_st,
-                            uint8_t *buf, int buf_size);
+                            uint8_t **pbuf);
 
 /**
  * Receive one packet from the RTSPStreams set up in the AVFormatContext
@@ -182,10 +182,11 @@ static int rtsp_read_header(AVFormatContext *s,
 }
 
 int ff_rtsp_tcp_read_packet(AVFormatContext *s, RTSPStream **prtsp_st,
-                            uint8_t *buf, int buf_size)
+                            uint8_t **pbuf)
 {
     RTSPState *rt = s->priv_data;
     int id, len, i, ret;
+    uint8_t *buf;
     RTSPStream *rtsp_st;
 
     av_dlog(s, "tcp_read_packet:\n");
@@ -202,18 +203,16 @@ redo:
         if (rt->state != RTSP_STATE_STREAMING)
             return 0;
     }
-    ret = ffurl_read_complete(rt->rtsp_hd, buf, 3);
-    if (ret != 3)
+    if (!(buf = ff_rtsp_read_inplace(rt, 3)))
         return -1;
     id  = buf[0];
     len = AV_RB16(buf + 1);
     av_dlog(s, "id=%d len=%d\n", id, len);
-    if (len > buf_size || len < 12)
-        goto redo;
     /* get the data */
-    ret = ffurl_read_complete(rt->rtsp_hd, buf, len);
-    if (ret != len)
+    if (!(buf = ff_rtsp_read_inplace(rt, len)))
         return -1;
+    if (len < 12)
+        goto redo;
     if (rt->transport == RTSP_TRANSPORT_RDT &&
         ff_rdt_parse_header(buf, len, &id, NULL, NULL, NULL, NULL) < 0)
         return -1;
@@ -228,6 +227,7 @@ redo:
     goto redo;
 found:
     *prtsp_st = rtsp_st;
+    *pbuf     = buf;
     return len;
 }
 
@@ -192,7 +192,12 @@ static int rtsp_write_packet(AVFormatContext *s, AVPacket *pkt)
     int ret;
 
     while (1) {
-        n = poll(&p, 1, 0);
+        /* replies already buffered from the connection count as readable */
+        if (rt->tcp_buf_ptr != rt->tcp_buf_end) {
+            n = 1;
+            p.revents = POLLIN;
+        } else
+            n = poll(&p, 1, 0);
         if (n <= 0)
             break;
         if (p.revents & POLLIN) {
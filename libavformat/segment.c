@@ -0,0 +1,313 @@
+/*
+ * Generic segmenter
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Segmenting muxer: splits the output into files of about the same
+ * duration, cut on keyframes, using another muxer for each of them and
+ * optionally keeping an M3U8 playlist of the segments up to date.
+ */
+
+#include <float.h>
+
+#include "avformat.h"
+#include "internal.h"
+#include "libavutil/avstring.h"
+#include "libavutil/mathematics.h"
+#include "libavutil/opt.h"
+
+typedef struct SegmentListEntry {
+    char   *filename;
+    int64_t duration;       ///< in AV_TIME_BASE units
+} SegmentListEntry;
+
+typedef struct {
+    const AVClass *class;   /**< Class for private options. */
+    int number;             ///< number of the next segment
+    AVFormatContext *avf;   ///< context of the muxer writing the segments
+    char *format;           /**< Set by a private option. */
+    char *list;             /**< Set by a private option. */
+    float time;             /**< Set by a private option. */
+    int list_size;          /**< Set by a private option. */
+    int64_t recording_time; ///< segment duration in AV_TIME_BASE units
+    int64_t offset_time;    ///< timestamp of the first packet
+    int64_t start_time;     ///< timestamp of the first packet of the segment
+    int64_t last_time;      ///< end timestamp of the last packet written
+    int reference_stream;   ///< stream whose keyframes start segments, -1 for any
+    SegmentListEntry *entries;
+    int nb_entries;
+    int first_entry;        ///< media sequence number of entries[0]
+} SegmentContext;
+
+static int segment_start(AVFormatContext *s)
+{
+    SegmentContext *seg = s->priv_data;
+    AVFormatContext *oc = seg->avf;
+    int err;
+
+    if (av_get_frame_filename(oc->filename, sizeof(oc->filename),
+                              s->filename, seg->number++) < 0) {
+        av_log(s, AV_LOG_ERROR, "Invalid segment filename template '%s'\n",
+               s->filename);
+        return AVERROR(EINVAL);
+    }
+
+    if ((err = avio_open(&oc->pb, oc->filename, AVIO_FLAG_WRITE)) < 0) {
+        av_log(s, AV_LOG_ERROR, "Could not open '%s'\n", oc->filename);
+        return err;
+    }
+
+    /* the segment muxer state is recreated from scratch for every file */
+    if ((err = avformat_write_header(oc, NULL)) < 0) {
+        avio_close(oc->pb);
+        oc->pb = NULL;
+    }
+    return err;
+}
+
+static int segment_list_write(AVFormatContext *s, int last)
+{
+    SegmentContext *seg = s->priv_data;
+    AVIOContext *pb;
+    int64_t target = 0;
+    int i, err;
+
+    if ((err = avio_open(&pb, seg->list, AVIO_FLAG_WRITE)) < 0) {
+        av_log(s, AV_LOG_ERROR, "Could not open '%s'\n", seg->list);
+        return err;
+    }
+
+    for (i = 0; i < seg->nb_entries; i++)
+        target = FFMAX(target, seg->entries[i].duration);
+
+    avio_printf(pb, "#EXTM3U\n");
+    avio_printf(pb, "#EXT-X-TARGETDURATION:%"PRId64"\n",
+                (target + AV_TIME_BASE - 1) / AV_TIME_BASE);
+    avio_printf(pb, "#EXT-X-MEDIA-SEQUENCE:%d\n", seg->first_entry);
+    for (i = 0; i < seg->nb_entries; i++)
+        avio_printf(pb, "#EXTINF:%d,\n%s\n",
+                    (int)((seg->entries[i].duration + AV_TIME_BASE / 2) / AV_TIME_BASE),
+                    seg->entries[i].filename);
+    if (last)
+        avio_printf(pb, "#EXT-X-ENDLIST\n");
+
+    avio_flush(pb);
+    avio_close(pb);
+    return 0;
+}
+
+static int segment_end(AVFormatContext *s, int last)
+{
+    SegmentContext *seg = s->priv_data;
+    AVFormatContext *oc = seg->avf;
+    int err;
+
+    err = av_write_trailer(oc);
+    avio_flush(oc->pb);
+    avio_close(oc->pb);
+    oc->pb = NULL;
+    if (err < 0)
+        av_log(s, AV_LOG_ERROR, "Failure finishing segment '%s'\n",
+               oc->filename);
+
+    if (!seg->list)
+        return err;
+
+    if (seg->list_size && seg->nb_entries == seg->list_size) {
+        av_free(seg->entries[0].filename);
+        memmove(seg->entries, seg->entries + 1,
+                (seg->nb_entries - 1) * sizeof(*seg->entries));
+        seg->nb_entries--;
+        seg->first_entry++;
+    } else {
+        SegmentListEntry *entries = av_realloc(seg->entries,
+                                    (seg->nb_entries + 1) * sizeof(*entries));
+        if (!entries)
+            return AVERROR(ENOMEM);
+        seg->entries = entries;
+    }
+    seg->entries[seg->nb_entries].filename = av_strdup(oc->filename);
+    if (!seg->entries[seg->nb_entries].filename)
+        return AVERROR(ENOMEM);
+    seg->entries[seg->nb_entries++].duration = seg->last_time - seg->start_time;
+
+    if (err >= 0)
+        err = segment_list_write(s, last);
+    return err;
+}
+
+static void segment_free(AVFormatContext *s)
+{
+    SegmentContext *seg = s->priv_data;
+    int i;
+
+    if (seg->avf) {
+        if (seg->avf->pb)
+            avio_close(seg->avf->pb);
+        avformat_free_context(seg->avf);
+        seg->avf = NULL;
+    }
+    for (i = 0; i < seg->nb_entries; i++)
+        av_free(seg->entries[i].filename);
+    av_freep(&seg->entries);
+    av_freep(&seg->format);
+    av_freep(&seg->list);
+}
+
+static int seg_write_header(AVFormatContext *s)
+{
+    SegmentContext *seg = s->priv_data;
+    AVFormatContext *oc;
+    int ret, i;
+
+    seg->number           = 0;
+    seg->offset_time      = AV_NOPTS_VALUE;
+    seg->recording_time   = seg->time * AV_TIME_BASE;
+    seg->reference_stream = -1;
+
+    if (seg->recording_time <= 0) {
+        av_log(s, AV_LOG_ERROR, "Invalid segment duration %f\n", seg->time);
+        return AVERROR(EINVAL);
+    }
+
+    /* cut on keyframes of the first video stream, if there is one */
+    for (i = 0; i < s->nb_streams; i++)
+        if (s->streams[i]->codec->codec_type == AVMEDIA_TYPE_VIDEO) {
+            seg->reference_stream = i;
+            break;
+        }
+
+    oc = avformat_alloc_context();
+    if (!oc)
+        return AVERROR(ENOMEM);
+    seg->avf = oc;
+
+    oc->oformat = av_guess_format(seg->format, s->filename, NULL);
+    if (!oc->oformat) {
+        av_log(s, AV_LOG_ERROR, "Could not find a format for the segments\n");
+        ret = AVERROR_MUXER_NOT_FOUND;
+        goto fail;
+    }
+    if (oc->oformat->flags & AVFMT_NOFILE) {
+        av_log(s, AV_LOG_ERROR, "Format '%s' cannot be used for segments\n",
+               oc->oformat->name);
+        ret = AVERROR(EINVAL);
+        goto fail;
+    }
+
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st;
+        if (!(st = av_new_stream(oc, 0))) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        avcodec_copy_context(st->codec, s->streams[i]->codec);
+        /* let the segment muxer pick its own tags */
+        st->codec->codec_tag    = 0;
+        st->sample_aspect_ratio = s->streams[i]->sample_aspect_ratio;
+    }
+    oc->max_delay = s->max_delay;
+    av_dict_copy(&oc->metadata, s->metadata, 0);
+
+    if ((ret = segment_start(s)) < 0)
+        goto fail;
+
+    /* packets reach us in the time bases the segment muxer asked for */
+    for (i = 0; i < s->nb_streams; i++)
+        av_set_pts_info(s->streams[i], 64, oc->streams[i]->time_base.num,
+                        oc->streams[i]->time_base.den);
+
+    return 0;
+
+fail:
+    segment_free(s);
+    return ret;
+}
+
+static int seg_write_packet(AVFormatContext *s, AVPacket *pkt)
+{
+    SegmentContext *seg = s->priv_data;
+    AVStream *st = s->streams[pkt->stream_index];
+    int64_t time, end;
+    int ret;
+
+    if (pkt->dts == AV_NOPTS_VALUE)
+        return av_write_frame(seg->avf, pkt);
+
+    time = av_rescale_q(pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts,
+                        st->time_base, AV_TIME_BASE_Q);
+    if (seg->offset_time == AV_NOPTS_VALUE)
+        seg->offset_time = seg->start_time = seg->last_time = time;
+
+    /* segment boundaries follow a fixed grid so durations do not drift */
+    end = seg->offset_time + seg->recording_time * seg->number;
+    if (time >= end &&
+        (seg->reference_stream < 0 ||
+         (pkt->stream_index == seg->reference_stream &&
+          pkt->flags & AV_PKT_FLAG_KEY))) {
+        seg->last_time = time;
+        if ((ret = segment_end(s, 0)) < 0 ||
+            (ret = segment_start(s)) < 0)
+            return ret;
+        seg->start_time = time;
+    }
+
+    if (pkt->duration > 0)
+        time += av_rescale_q(pkt->duration, st->time_base, AV_TIME_BASE_Q);
+    seg->last_time = FFMAX(seg->last_time, time);
+
+    return av_write_frame(seg->avf, pkt);
+}
+
+static int seg_write_trailer(AVFormatContext *s)
+{
+    int ret = segment_end(s, 1);
+
+    segment_free(s);
+    return ret;
+}
+
+#define OFFSET(x) offsetof(SegmentContext, x)
+#define E AV_OPT_FLAG_ENCODING_PARAM
+static const AVOption options[] = {
+    { "segment_format",    "container format used for the segments",  OFFSET(format),    FF_OPT_TYPE_STRING, {.str = NULL}, 0, 0,       E },
+    { "segment_time",      "segment duration in seconds",             OFFSET(time),      FF_OPT_TYPE_FLOAT,  {.dbl = 2},    0, FLT_MAX, E },
+    { "segment_list",      "write an M3U8 playlist of the segments",  OFFSET(list),      FF_OPT_TYPE_STRING, {.str = NULL}, 0, 0,       E },
+    { "segment_list_size", "number of segments kept in the playlist, 0 for all", OFFSET(list_size), FF_OPT_TYPE_INT, {.dbl = 0}, 0, INT_MAX, E },
+    { NULL },
+};
+
+static const AVClass seg_class = {
+    .class_name = "segment muxer",
+    .item_name  = av_default_item_name,
+    .option     = options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
+AVOutputFormat ff_segment_muxer = {
+    .name           = "segment",
+    .long_name      = NULL_IF_CONFIG_SMALL("segment muxer"),
+    .priv_data_size = sizeof(SegmentContext),
+    .flags          = AVFMT_NOFILE,
+    .write_header   = seg_write_header,
+    .write_packet   = seg_write_packet,
+    .write_trailer  = seg_write_trailer,
+    .priv_class     = &seg_class,
+};
@@ -32,20 +32,179 @@
 
 typedef struct TCPContext {
     int fd;
+    int64_t first_byte_deadline;    ///< 0 once a byte has been received
 } TCPContext;
 
+/** most addresses of a host tried, and connections raced */
+#define MAX_ADDRESSES 16
+
+/** options of the connections */
+typedef struct TCPOptions {
+    int timeout;            ///< per address, in 1/10 s
+    int attempt_delay;      ///< in ms before racing the next address
+    int nodelay;
+    int send_buffer_size;
+    int recv_buffer_size;
+} TCPOptions;
+
+static void tcp_set_options(URLContext *h, int fd, const TCPOptions *o)
+{
+    /* the receive buffer has to be set before connecting for the TCP
+     * window scaling to take it into account */
+    if (o->recv_buffer_size > 0 &&
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &o->recv_buffer_size,
+                   sizeof(o->recv_buffer_size)) < 0)
+        av_log(h, AV_LOG_WARNING, "setsockopt(SO_RCVBUF): %s\n", strerror(errno));
+    if (o->send_buffer_size > 0 &&
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &o->send_buffer_size,
+                   sizeof(o->send_buffer_size)) < 0)
+        av_log(h, AV_LOG_WARNING, "setsockopt(SO_SNDBUF): %s\n", strerror(errno));
+#ifdef TCP_NODELAY
+    if (o->nodelay &&
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &o->nodelay,
+                   sizeof(o->nodelay)) < 0)
+        av_log(h, AV_LOG_WARNING, "setsockopt(TCP_NODELAY): %s\n", strerror(errno));
+#endif
+}
+
+/**
+ * Connect to one of the addresses of ai. The connection to the next
+ * address is started when the previous ones have not succeeded within
+ * attempt_delay, or have failed, and the first one established wins.
+ * The address families are alternated, so that a host whose IPv6 or
+ * IPv4 connectivity is broken still connects quickly.
+ *
+ * @return the connected socket, or an AVERROR
+ */
+static int tcp_connect_race(URLContext *h, struct addrinfo *ai,
+                            const char *hostname, int port,
+                            const TCPOptions *o)
+{
+    struct addrinfo *addrs[MAX_ADDRESSES], *cur_ai;
+    struct pollfd pfds[MAX_ADDRESSES];
+    int64_t deadlines[MAX_ADDRESSES], next_attempt = 0;
+    int nb_addrs = 0, next = 0, active = 0, fd = -1, i, j, ret;
+    int ret_fail = AVERROR(EIO);
+
+    /* interleave the address families, keeping the order of the resolver
+     * within each of them */
+    for (cur_ai = ai; cur_ai && nb_addrs < MAX_ADDRESSES; cur_ai = cur_ai->ai_next)
+        if (cur_ai->ai_family == ai->ai_family)
+            addrs[nb_addrs++] = cur_ai;
+    for (i = 1, cur_ai = ai; cur_ai && nb_addrs < MAX_ADDRESSES; cur_ai = cur_ai->ai_next) {
+        if (cur_ai->ai_family == ai->ai_family)
+            continue;
+        memmove(&addrs[i + 1], &addrs[i], (nb_addrs - i) * sizeof(*addrs));
+        addrs[i] = cur_ai;
+        nb_addrs++;
+        i = FFMIN(i + 2, nb_addrs);
+    }
+
+    while (fd < 0) {
+        int64_t now = av_gettime();
+        int wait = 100;
+
+        if (next < nb_addrs && (!active || now >= next_attempt)) {
+            cur_ai = addrs[next++];
+            next_attempt = now + o->attempt_delay * 1000LL;
+            fd = socket(cur_ai->ai_family, cur_ai->ai_socktype,
+                        cur_ai->ai_protocol);
+            if (fd < 0) {
+                ret_fail = ff_neterrno();
+                continue;
+            }
+            tcp_set_options(h, fd, o);
+            ff_socket_nonblock(fd, 1);
+            do {
+                ret = connect(fd, cur_ai->ai_addr, cur_ai->ai_addrlen);
+                ret = ret < 0 ? ff_neterrno() : 0;
+            } while (ret == AVERROR(EINTR) && !url_interrupt_cb());
+            if (!ret)
+                break;
+            if (ret != AVERROR(EINPROGRESS) && ret != AVERROR(EAGAIN)) {
+                closesocket(fd);
+                fd = -1;
+                ret_fail = ret;
+                /* try the next address right away */
+                next_attempt = now;
+                continue;
+            }
+            pfds[active].fd      = fd;
+            pfds[active].events  = POLLOUT;
+            pfds[active].revents = 0;
+            deadlines[active++]  = now + o->timeout * 100000LL;
+            fd = -1;
+        }
+
+        if (!active) {
+            if (next < nb_addrs)
+                continue;
+            ret = ret_fail;
+            goto fail;
+        }
+        if (url_interrupt_cb()) {
+            ret = AVERROR_EXIT;
+            goto fail;
+        }
+        if (next < nb_addrs)
+            wait = av_clip((next_attempt - now) / 1000, 0, wait);
+        ret = poll(pfds, active, wait);
+        if (ret < 0 && ff_neterrno() != AVERROR(EINTR)) {
+            ret = ff_neterrno();
+            goto fail;
+        }
+
+        now = av_gettime();
+        for (i = 0; i < active; i++) {
+            if (pfds[i].revents) {
+                socklen_t optlen = sizeof(ret);
+                ret = 0;
+                getsockopt(pfds[i].fd, SOL_SOCKET, SO_ERROR, &ret, &optlen);
+                if (!ret) {
+                    fd = pfds[i].fd;
+                    pfds[i].fd = -1;
+                    break;
+                }
+                /* not an error as long as another address may succeed */
+                av_log(h, next < nb_addrs || active > 1 ? AV_LOG_VERBOSE : AV_LOG_ERROR,
+                       "TCP connection to %s:%d failed: %s\n",
+                       hostname, port, strerror(ret));
+                ret_fail = AVERROR(ret);
+            } else if (now < deadlines[i]) {
+                continue;
+            } else {
+                ret_fail = AVERROR(ETIMEDOUT);
+            }
+            closesocket(pfds[i].fd);
+            for (j = i + 1; j < active; j++) {
+                pfds[j - 1]      = pfds[j];
+                deadlines[j - 1] = deadlines[j];
+            }
+            active--;
+            i--;
+            next_attempt = now;
+        }
+    }
+    ret = fd;
+
+ fail:
+    for (i = 0; i < active; i++)
+        if (pfds[i].fd >= 0)
+            closesocket(pfds[i].fd);
+    return ret;
+}
+
 /* return non zero if error */
 static int tcp_open(URLContext *h, const char *uri, int flags)
 {
-    struct addrinfo hints, *ai, *cur_ai;
+    struct addrinfo hints, *ai;
     int port, fd = -1;
     TCPContext *s = NULL;
-    int listen_socket = 0;
+    TCPOptions o = { .timeout = 50, .attempt_delay = 250 };
+    int listen_socket = 0, first_byte_timeout = 0;
     const char *p;
     char buf[256];
     int ret;
-    socklen_t optlen;
-    int timeout = 50;
     char hostname[1024],proto[1024],path[1024];
     char portstr[10];
 
@@ -59,8 +218,18 @@ static int tcp_open(URLContext *h, const char *uri, int flags)
         if (av_find_info_tag(buf, sizeof(buf), "listen", p))
             listen_socket = 1;
         if (av_find_info_tag(buf, sizeof(buf), "timeout", p)) {
-            timeout = strtol(buf, NULL, 10);
+            o.timeout = strtol(buf, NULL, 10);
         }
+        if (av_find_info_tag(buf, sizeof(buf), "attempt_delay", p))
+            o.attempt_delay = strtol(buf, NULL, 10);
+        if (av_find_info_tag(buf, sizeof(buf), "first_byte_timeout", p))
+            first_byte_timeout = strtol(buf, NULL, 10);
+        if (av_find_info_tag(buf, sizeof(buf), "tcp_nodelay", p))
+            o.nodelay = strtol(buf, NULL, 10);
+        if (av_find_info_tag(buf, sizeof(buf), "send_buffer_size", p))
+            o.send_buffer_size = strtol(buf, NULL, 10);
+        if (av_find_info_tag(buf, sizeof(buf), "recv_buffer_size", p))
+            o.recv_buffer_size = strtol(buf, NULL, 10);
     }
     memset(&hints, 0, sizeof(hints));
     hints.ai_family = AF_UNSPEC;
@@ -74,89 +243,47 @@ static int tcp_open(URLContext *h, const char *uri, int flags)
         return AVERROR(EIO);
     }
 
-    cur_ai = ai;
-
- restart:
-    ret = AVERROR(EIO);
-    fd = socket(cur_ai->ai_family, cur_ai->ai_socktype, cur_ai->ai_protocol);
-    if (fd < 0)
-        goto fail;
-
     if (listen_socket) {
         int fd1;
-        ret = bind(fd, cur_ai->ai_addr, cur_ai->ai_addrlen);
+        ret = AVERROR(EIO);
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0)
+            goto fail;
+        tcp_set_options(h, fd, &o);
+        if (bind(fd, ai->ai_addr, ai->ai_addrlen) < 0) {
+            ret = ff_neterrno();
+            closesocket(fd);
+            goto fail;
+        }
         listen(fd, 1);
         fd1 = accept(fd, NULL, NULL);
         closesocket(fd);
         fd = fd1;
+        if (fd < 0)
+            goto fail;
         ff_socket_nonblock(fd, 1);
     } else {
- redo:
-        ff_socket_nonblock(fd, 1);
-        ret = connect(fd, cur_ai->ai_addr, cur_ai->ai_addrlen);
-    }
-
-    if (ret < 0) {
-        struct pollfd p = {fd, POLLOUT, 0};
-        ret = ff_neterrno();
-        if (ret == AVERROR(EINTR)) {
-            if (url_interrupt_cb()) {
-                ret = AVERROR_EXIT;
-                goto fail1;
-            }
-            goto redo;
-        }
-        if (ret != AVERROR(EINPROGRESS) &&
-            ret != AVERROR(EAGAIN))
-            goto fail;
-
-        /* wait until we are connected or until abort */
-        while(timeout--) {
-            if (url_interrupt_cb()) {
-                ret = AVERROR_EXIT;
-                goto fail1;
-            }
-            ret = poll(&p, 1, 100);
-            if (ret > 0)
-                break;
-        }
-        if (ret <= 0) {
-            ret = AVERROR(ETIMEDOUT);
-            goto fail;
-        }
-        /* test error */
-        optlen = sizeof(ret);
-        getsockopt (fd, SOL_SOCKET, SO_ERROR, &ret, &optlen);
-        if (ret != 0) {
-            av_log(h, AV_LOG_ERROR,
-                   "TCP connection to %s:%d failed: %s\n",
-                   hostname, port, strerror(ret));
-            ret = AVERROR(ret);
+        fd = tcp_connect_race(h, ai, hostname, port, &o);
+        if (fd < 0) {
+            ret = fd;
             goto fail;
         }
     }
-    s = av_malloc(sizeof(TCPContext));
+    s = av_mallocz(sizeof(TCPContext));
     if (!s) {
+        closesocket(fd);
         freeaddrinfo(ai);
         return AVERROR(ENOMEM);
     }
     h->priv_data = s;
     h->is_streamed = 1;
     s->fd = fd;
+    if (first_byte_timeout > 0)
+        s->first_byte_deadline = av_gettime() + first_byte_timeout * 1000LL;
     freeaddrinfo(ai);
     return 0;
 
  fail:
-    if (cur_ai->ai_next) {
-        /* Retry with the next sockaddr */
-        cur_ai = cur_ai->ai_next;
-        if (fd >= 0)
-            closesocket(fd);
-        goto restart;
-    }
- fail1:
-    if (fd >= 0)
-        closesocket(fd);
     freeaddrinfo(ai);
     return ret;
 }
@@ -169,10 +296,21 @@ static int tcp_read(URLContext *h, uint8_t *buf, int size)
     if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
         ret = ff_network_wait_fd(s->fd, 0);
         if (ret < 0)
-            return ret;
+            goto fail;
     }
     ret = recv(s->fd, buf, size, 0);
-    return ret < 0 ? ff_neterrno() : ret;
+    if (ret > 0)
+        s->first_byte_deadline = 0;
+    if (ret >= 0)
+        return ret;
+    ret = ff_neterrno();
+ fail:
+    if (ret == AVERROR(EAGAIN) && s->first_byte_deadline &&
+        av_gettime() > s->first_byte_deadline) {
+        av_log(h, AV_LOG_ERROR, "No data received in time\n");
+        return AVERROR(ETIMEDOUT);
+    }
+    return ret;
 }
 
 static int tcp_write(URLContext *h, const uint8_t *buf, int size)
@@ -25,11 +25,11 @@
  */
 
 #define _BSD_SOURCE     /* Needed for using struct ip_mreq with recent glibc */
+#define _GNU_SOURCE     /* Needed for recvmmsg and sendmmsg with glibc */
 
 #include "avformat.h"
 #include "avio_internal.h"
 #include "libavutil/parseutils.h"
-#include "libavutil/fifo.h"
 #include <unistd.h>
 #include "internal.h"
 #include "network.h"
@@ -58,17 +58,61 @@ typedef struct {
     int dest_addr_len;
     int is_connected;
 
+    /* datagrams queued by udp_write, sent together once batch_size of
+     * them are queued, and no faster than bitrate if it is set */
+    int batch_size;
+    int64_t bitrate;
+    uint8_t *tx_buf;
+    int *tx_len;
+    int tx_count;
+    int64_t pace_start;     ///< time the pacing was (re)started at
+    int64_t pace_bytes;     ///< bytes sent since pace_start
+
     /* Circular Buffer variables for use in UDP receive code */
     int circular_buffer_size;
-    AVFifoBuffer *fifo;
-    int circular_buffer_error;
+    /* single producer, single consumer ring of nb_slots packets of up to
+     * slot_size bytes each; the thread only writes head, the reader only
+     * writes tail, the ring is empty when they are equal */
+    uint8_t *ring;
+    int *ring_len;
+    int nb_slots;
+    int slot_size;
+    volatile int ring_head;
+    volatile int ring_tail;
+    int read_offset;    ///< bytes of the slot at tail already read
+    volatile int circular_buffer_error;
+    int dropped;        ///< packets dropped in the current overrun
+    int truncated;
 #if HAVE_PTHREADS
     pthread_t circular_buffer_thread;
+    int thread_started;
+    volatile int abort_request;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
 #endif
 } UDPContext;
 
 #define UDP_TX_BUF_SIZE 32768
+#define UDP_RX_BUF_SIZE (4 << 20)
 #define UDP_MAX_PKT_SIZE 65536
+/** most packets received by one call of the circular buffer thread */
+#define UDP_BATCH_SIZE 32
+/** lateness in microseconds after which the pacing is restarted instead
+ *  of catching up with a burst */
+#define UDP_PACE_MAX_LATE 10000
+
+#if HAVE_SYNC_VAL_COMPARE_AND_SWAP
+#define memory_barrier() __sync_synchronize()
+#elif HAVE_PTHREADS
+static pthread_mutex_t barrier_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* locking a mutex orders the memory accesses on both sides of it */
+static void memory_barrier(void)
+{
+    pthread_mutex_lock(&barrier_lock);
+    pthread_mutex_unlock(&barrier_lock);
+}
+#endif
 
 static int udp_set_multicast_ttl(int sockfd, int mcastTTL,
                                  struct sockaddr *addr)
@@ -241,6 +285,88 @@ static int udp_port(struct sockaddr_storage *addr, int addr_len)
 }
 
 
+static int udp_send_one(UDPContext *s, const uint8_t *buf, int size)
+{
+    int ret;
+
+    if (!s->is_connected) {
+        ret = sendto (s->udp_fd, buf, size, 0,
+                      (struct sockaddr *) &s->dest_addr,
+                      s->dest_addr_len);
+    } else
+        ret = send(s->udp_fd, buf, size, 0);
+
+    return ret < 0 ? ff_neterrno() : ret;
+}
+
+/**
+ * Send the datagrams queued by udp_write, once the pacing allows it.
+ * The datagrams not sent because of an error are dropped.
+ */
+static int udp_send_queued(URLContext *h)
+{
+    UDPContext *s = h->priv_data;
+    int i, sent = 0, ret = 0;
+
+    if (!s->tx_count)
+        return 0;
+
+    if (s->bitrate) {
+        int64_t now = av_gettime();
+        int64_t due = s->pace_start + s->pace_bytes * 8 * 1000000 / s->bitrate;
+        if (!s->pace_start || now - due > UDP_PACE_MAX_LATE) {
+            s->pace_start = now;
+            s->pace_bytes = 0;
+        } else if (due > now) {
+            usleep(due - now);
+        }
+        for (i = 0; i < s->tx_count; i++)
+            s->pace_bytes += s->tx_len[i];
+    }
+
+    while (sent < s->tx_count) {
+#if HAVE_SENDMMSG
+        struct mmsghdr msgs[UDP_BATCH_SIZE];
+        struct iovec iov[UDP_BATCH_SIZE];
+        int nb = s->tx_count - sent;
+#endif
+
+        ret = ff_network_wait_fd(s->udp_fd, 1);
+        if (ret == AVERROR(EAGAIN) && !url_interrupt_cb())
+            continue;
+        if (ret < 0)
+            break;
+#if HAVE_SENDMMSG
+        for (i = 0; i < nb; i++) {
+            iov[i].iov_base = s->tx_buf + (sent + i) * h->max_packet_size;
+            iov[i].iov_len  = s->tx_len[sent + i];
+            memset(&msgs[i], 0, sizeof(msgs[i]));
+            msgs[i].msg_hdr.msg_iov    = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            if (!s->is_connected) {
+                msgs[i].msg_hdr.msg_name    = &s->dest_addr;
+                msgs[i].msg_hdr.msg_namelen = s->dest_addr_len;
+            }
+        }
+        ret = sendmmsg(s->udp_fd, msgs, nb, 0);
+        if (ret < 0)
+            ret = ff_neterrno();
+#else
+        ret = udp_send_one(s, s->tx_buf + sent * h->max_packet_size,
+                           s->tx_len[sent]);
+        if (ret >= 0)
+            ret = 1;
+#endif
+        if (ret == AVERROR(EINTR) || ret == AVERROR(EAGAIN))
+            continue;
+        if (ret < 0)
+            break;
+        sent += ret;
+    }
+    s->tx_count = 0;
+    return ret < 0 ? ret : 0;
+}
+
 /**
  * If no filename is given to av_open_input_file because you want to
  * get the local port first, then you must call this function to set
@@ -251,6 +377,8 @@ static int udp_port(struct sockaddr_storage *addr, int addr_len)
  *         'localport=n' : set the local port
  *         'pkt_size=n'  : set max packet size
  *         'reuse=1'     : enable reusing the socket
+ *         'batch=n'     : send the datagrams n at a time
+ *         'bitrate=n'   : pace the datagrams at n bits per second
  *
  * @param h media file context
  * @param uri of the remote server
@@ -265,6 +393,9 @@ int ff_udp_set_remote_url(URLContext *h, const char *uri)
 
     av_url_split(NULL, 0, NULL, 0, hostname, sizeof(hostname), &port, NULL, 0, uri);
 
+    /* the queued datagrams are for the old address */
+    udp_send_queued(h);
+
     /* set the destination address */
     s->dest_addr_len = udp_set_url(&s->dest_addr, hostname, port);
     if (s->dest_addr_len < 0) {
@@ -312,65 +443,125 @@ static int udp_get_file_handle(URLContext *h)
     return s->udp_fd;
 }
 
+#if HAVE_PTHREADS
+static int ring_free_slots(UDPContext *s)
+{
+    int used = s->ring_head - s->ring_tail;
+    if (used < 0)
+        used += s->nb_slots;
+    return s->nb_slots - 1 - used;
+}
+
+/**
+ * Receive up to nb packets into the slots starting at first, or all into
+ * the same slot if discard is set.
+ * @return the number of packets received, or an AVERROR
+ */
+static int udp_recv_batch(UDPContext *s, int first, int nb, int discard)
+{
+    int i, ret;
+#if HAVE_RECVMMSG
+    struct mmsghdr msgs[UDP_BATCH_SIZE];
+    struct iovec iov[UDP_BATCH_SIZE];
+
+    for (i = 0; i < nb; i++) {
+        iov[i].iov_base = s->ring + (discard ? first : first + i) * s->slot_size;
+        iov[i].iov_len  = s->slot_size;
+        memset(&msgs[i], 0, sizeof(msgs[i]));
+        msgs[i].msg_hdr.msg_iov    = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    ret = recvmmsg(s->udp_fd, msgs, nb, 0, NULL);
+    if (ret < 0)
+        return ff_neterrno();
+    for (i = 0; i < ret && !discard; i++) {
+        s->ring_len[first + i] = msgs[i].msg_len;
+        if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC)
+            s->truncated++;
+    }
+#else
+    for (i = 0; i < nb; i++) {
+        int slot = discard ? first : first + i;
+        ret = recv(s->udp_fd, s->ring + slot * s->slot_size, s->slot_size, 0);
+        if (ret < 0) {
+            ret = ff_neterrno();
+            if (i && ret == AVERROR(EAGAIN))
+                break;
+            return ret;
+        }
+        s->ring_len[slot] = ret;
+    }
+    ret = i;
+#endif
+    return ret;
+}
+
 static void *circular_buffer_task( void *_URLContext)
 {
     URLContext *h = _URLContext;
     UDPContext *s = h->priv_data;
-    fd_set rfds;
-    struct timeval tv;
+    int error = 0, truncation_logged = 0;
 
-    for(;;) {
-        int left;
+    while (!s->abort_request) {
+        int head = s->ring_head;
+        int free = ring_free_slots(s);
         int ret;
-        int len;
 
         if (url_interrupt_cb()) {
-            s->circular_buffer_error = EINTR;
-            return NULL;
+            error = EINTR;
+            break;
         }
 
-        FD_ZERO(&rfds);
-        FD_SET(s->udp_fd, &rfds);
-        tv.tv_sec = 1;
-        tv.tv_usec = 0;
-        ret = select(s->udp_fd + 1, &rfds, NULL, NULL, &tv);
+        /* when the ring is full, receive into the spare slot past its end
+         * and drop the packets, the kernel would drop them otherwise */
+        if (free)
+            ret = udp_recv_batch(s, head, FFMIN3(free, s->nb_slots - head,
+                                                 UDP_BATCH_SIZE), 0);
+        else
+            ret = udp_recv_batch(s, s->nb_slots, UDP_BATCH_SIZE, 1);
+
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR(EINTR)) {
+            ret = ff_network_wait_fd(s->udp_fd, 0);
+            if (ret < 0 && ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR)) {
+                error = EIO;
+                break;
+            }
+            continue;
+        }
         if (ret < 0) {
-            if (ff_neterrno() == AVERROR(EINTR))
-                continue;
-            s->circular_buffer_error = EIO;
-            return NULL;
+            error = EIO;
+            break;
         }
-
-        if (!(ret > 0 && FD_ISSET(s->udp_fd, &rfds)))
+        if (!free) {
+            s->dropped += ret;
             continue;
-
-        /* How much do we have left to the end of the buffer */
-        /* Whats the minimum we can read so that we dont comletely fill the buffer */
-        left = av_fifo_space(s->fifo);
-        left = FFMIN(left, s->fifo->end - s->fifo->wptr);
-
-        /* No Space left, error, what do we do now */
-        if( !left) {
-            av_log(h, AV_LOG_ERROR, "circular_buffer: OVERRUN\n");
-            s->circular_buffer_error = EIO;
-            return NULL;
         }
-
-        len = recv(s->udp_fd, s->fifo->wptr, left, 0);
-        if (len < 0) {
-            if (ff_neterrno() != AVERROR(EAGAIN) && ff_neterrno() != AVERROR(EINTR)) {
-                s->circular_buffer_error = EIO;
-                return NULL;
-            }
+        if (s->dropped) {
+            av_log(h, AV_LOG_WARNING,
+                   "circular_buffer: overrun, %d packets dropped\n", s->dropped);
+            s->dropped = 0;
+        }
+        if (s->truncated && !truncation_logged) {
+            av_log(h, AV_LOG_WARNING,
+                   "Packets larger than pkt_size=%d are truncated\n", s->slot_size);
+            truncation_logged = 1;
         }
-        s->fifo->wptr += len;
-        if (s->fifo->wptr >= s->fifo->end)
-            s->fifo->wptr = s->fifo->buffer;
-        s->fifo->wndx += len;
+
+        /* publish the packets after they have been written */
+        memory_barrier();
+        pthread_mutex_lock(&s->mutex);
+        s->ring_head = (head + ret) % s->nb_slots;
+        pthread_cond_signal(&s->cond);
+        pthread_mutex_unlock(&s->mutex);
     }
 
+    pthread_mutex_lock(&s->mutex);
+    s->circular_buffer_error = error;
+    pthread_cond_signal(&s->cond);
+    pthread_mutex_unlock(&s->mutex);
     return NULL;
 }
+#endif
 
 /* put it in UDP context */
 /* return non zero if error */
@@ -384,7 +575,7 @@ static int udp_open(URLContext *h, const char *uri, int flags)
     char buf[256];
     struct sockaddr_storage my_addr;
     int len;
-    int reuse_specified = 0;
+    int reuse_specified = 0, buffer_size_specified = 0;
 
     h->is_streamed = 1;
     h->max_packet_size = 1472;
@@ -397,7 +588,7 @@ static int udp_open(URLContext *h, const char *uri, int flags)
 
     h->priv_data = s;
     s->ttl = 16;
-    s->buffer_size = is_output ? UDP_TX_BUF_SIZE : UDP_MAX_PKT_SIZE;
+    s->buffer_size = is_output ? UDP_TX_BUF_SIZE : UDP_RX_BUF_SIZE;
 
     s->circular_buffer_size = 7*188*4096;
 
@@ -422,6 +613,7 @@ static int udp_open(URLContext *h, const char *uri, int flags)
         }
         if (av_find_info_tag(buf, sizeof(buf), "buffer_size", p)) {
             s->buffer_size = strtol(buf, NULL, 10);
+            buffer_size_specified = 1;
         }
         if (av_find_info_tag(buf, sizeof(buf), "connect", p)) {
             s->is_connected = strtol(buf, NULL, 10);
@@ -429,6 +621,12 @@ static int udp_open(URLContext *h, const char *uri, int flags)
         if (av_find_info_tag(buf, sizeof(buf), "buf_size", p)) {
             s->circular_buffer_size = strtol(buf, NULL, 10)*188;
         }
+        if (av_find_info_tag(buf, sizeof(buf), "batch", p)) {
+            s->batch_size = av_clip(strtol(buf, NULL, 10), 1, UDP_BATCH_SIZE);
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "bitrate", p)) {
+            s->bitrate = strtoll(buf, NULL, 10);
+        }
     }
 
     /* fill the dest addr */
@@ -493,11 +691,19 @@ static int udp_open(URLContext *h, const char *uri, int flags)
             goto fail;
         }
     } else {
-        /* set udp recv buffer size to the largest possible udp packet size to
-         * avoid losing data on OSes that set this too low by default. */
+        /* set a large udp recv buffer to absorb the bursts and the
+         * scheduling latency of the reader, the OS defaults are too low
+         * for high bitrates. */
+        socklen_t optlen = sizeof(tmp);
         tmp = s->buffer_size;
         if (setsockopt(udp_fd, SOL_SOCKET, SO_RCVBUF, &tmp, sizeof(tmp)) < 0) {
             av_log(h, AV_LOG_WARNING, "setsockopt(SO_RECVBUF): %s\n", strerror(errno));
+        } else if (!getsockopt(udp_fd, SOL_SOCKET, SO_RCVBUF, &tmp, &optlen) &&
+                   tmp < s->buffer_size) {
+            /* the OS silently limits it, e.g. to net.core.rmem_max on Linux */
+            av_log(h, buffer_size_specified ? AV_LOG_WARNING : AV_LOG_VERBOSE,
+                   "UDP receive buffer limited to %d bytes instead of %d\n",
+                   tmp, s->buffer_size);
         }
         /* make the socket non-blocking */
         ff_socket_nonblock(udp_fd, 1);
@@ -511,14 +717,35 @@ static int udp_open(URLContext *h, const char *uri, int flags)
 
     s->udp_fd = udp_fd;
 
+    if (is_output && (s->batch_size > 1 || s->bitrate > 0) &&
+        !(flags & AVIO_FLAG_NONBLOCK)) {
+        s->batch_size = FFMAX(s->batch_size, 1);
+        s->tx_buf = av_malloc(s->batch_size * h->max_packet_size);
+        s->tx_len = av_malloc(s->batch_size * sizeof(*s->tx_len));
+        if (!s->tx_buf || !s->tx_len)
+            goto fail;
+    }
+
 #if HAVE_PTHREADS
     if (!is_output && s->circular_buffer_size) {
+        /* one spare slot past the end receives the dropped packets */
+        s->slot_size = h->max_packet_size;
+        s->nb_slots  = FFMAX(s->circular_buffer_size / s->slot_size,
+                             2 * UDP_BATCH_SIZE);
+        s->ring      = av_malloc((s->nb_slots + 1) * s->slot_size);
+        s->ring_len  = av_malloc((s->nb_slots + 1) * sizeof(*s->ring_len));
+        if (!s->ring || !s->ring_len)
+            goto fail;
+        pthread_mutex_init(&s->mutex, NULL);
+        pthread_cond_init(&s->cond, NULL);
         /* start the task going */
-        s->fifo = av_fifo_alloc(s->circular_buffer_size);
         if (pthread_create(&s->circular_buffer_thread, NULL, circular_buffer_task, h)) {
             av_log(h, AV_LOG_ERROR, "pthread_create failed\n");
+            pthread_mutex_destroy(&s->mutex);
+            pthread_cond_destroy(&s->cond);
             goto fail;
         }
+        s->thread_started = 1;
     }
 #endif
 
@@ -526,7 +753,10 @@ static int udp_open(URLContext *h, const char *uri, int flags)
  fail:
     if (udp_fd >= 0)
         closesocket(udp_fd);
-    av_fifo_free(s->fifo);
+    av_free(s->ring);
+    av_free(s->ring_len);
+    av_free(s->tx_buf);
+    av_free(s->tx_len);
     av_free(s);
     return AVERROR(EIO);
 }
@@ -536,31 +766,39 @@ static int udp_read(URLContext *h, uint8_t *buf, int size)
     UDPContext *s = h->priv_data;
     int ret;
     int avail;
-    fd_set rfds;
-    struct timeval tv;
-
-    if (s->fifo) {
 
-        do {
-            avail = av_fifo_size(s->fifo);
-            if (avail) { // >=size) {
+#if HAVE_PTHREADS
+    if (s->ring) {
+        int tail = s->ring_tail;
+
+        if (tail == s->ring_head) {
+            if (h->flags & AVIO_FLAG_NONBLOCK && !s->circular_buffer_error)
+                return AVERROR(EAGAIN);
+            pthread_mutex_lock(&s->mutex);
+            while (tail == s->ring_head && !s->circular_buffer_error)
+                pthread_cond_wait(&s->cond, &s->mutex);
+            ret = s->circular_buffer_error;
+            pthread_mutex_unlock(&s->mutex);
+            /* the packets received before an error are still returned */
+            if (tail == s->ring_head)
+                return ret ? AVERROR(ret) : AVERROR(EIO);
+        }
+        memory_barrier();
 
-                // Maximum amount available
-                size = FFMIN( avail, size);
-                av_fifo_generic_read(s->fifo, buf, size, NULL);
-                return size;
-            }
-            else {
-                FD_ZERO(&rfds);
-                FD_SET(s->udp_fd, &rfds);
-                tv.tv_sec = 1;
-                tv.tv_usec = 0;
-                ret = select(s->udp_fd + 1, &rfds, NULL, NULL, &tv);
-                if (ret<0)
-                    return ret;
-            }
-        } while( 1);
+        avail = s->ring_len[tail] - s->read_offset;
+        size  = FFMIN(avail, size);
+        memcpy(buf, s->ring + tail * s->slot_size + s->read_offset, size);
+        if (size < avail) {
+            s->read_offset += size;
+        } else {
+            s->read_offset = 0;
+            /* release the slot after it has been read */
+            memory_barrier();
+            s->ring_tail = (tail + 1) % s->nb_slots;
+        }
+        return size;
     }
+#endif
 
     if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
         ret = ff_network_wait_fd(s->udp_fd, 0);
@@ -577,30 +815,46 @@ static int udp_write(URLContext *h, const uint8_t *buf, int size)
     UDPContext *s = h->priv_data;
     int ret;
 
+    if (s->tx_buf && size <= h->max_packet_size) {
+        memcpy(s->tx_buf + s->tx_count * h->max_packet_size, buf, size);
+        s->tx_len[s->tx_count++] = size;
+        if (s->tx_count == s->batch_size && (ret = udp_send_queued(h)) < 0)
+            return ret;
+        return size;
+    }
+    /* keep the datagrams in order */
+    if ((ret = udp_send_queued(h)) < 0)
+        return ret;
+
     if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
         ret = ff_network_wait_fd(s->udp_fd, 1);
         if (ret < 0)
             return ret;
     }
 
-    if (!s->is_connected) {
-        ret = sendto (s->udp_fd, buf, size, 0,
-                      (struct sockaddr *) &s->dest_addr,
-                      s->dest_addr_len);
-    } else
-        ret = send(s->udp_fd, buf, size, 0);
-
-    return ret < 0 ? ff_neterrno() : ret;
+    return udp_send_one(s, buf, size);
 }
 
 static int udp_close(URLContext *h)
 {
     UDPContext *s = h->priv_data;
 
+    udp_send_queued(h);
     if (s->is_multicast && (h->flags & AVIO_FLAG_READ))
         udp_leave_multicast_group(s->udp_fd, (struct sockaddr *)&s->dest_addr);
+#if HAVE_PTHREADS
+    if (s->thread_started) {
+        s->abort_request = 1;
+        pthread_join(s->circular_buffer_thread, NULL);
+        pthread_mutex_destroy(&s->mutex);
+        pthread_cond_destroy(&s->cond);
+    }
+#endif
     closesocket(s->udp_fd);
-    av_fifo_free(s->fifo);
+    av_free(s->ring);
+    av_free(s->ring_len);
+    av_free(s->tx_buf);
+    av_free(s->tx_len);
     av_free(s);
     return 0;
 }
@@ -173,4 +173,14 @@ int ffurl_register_protocol(URLProtocol *protocol, int size);
 int ff_udp_set_remote_url(URLContext *h, const char *uri);
 int ff_udp_get_local_port(URLContext *h);
 
+/**
+ * Create a context reading inner ahead, or writing it behind, in a
+ * background thread.
+ * On success, inner is owned by the returned context and closed with it.
+ *
+ * @param buffer_size size of the read-ahead buffer in bytes, 0 for the
+ *                    default
+ */
+int ff_async_open(URLContext **puc, URLContext *inner, int buffer_size);
+
 #endif /* AVFORMAT_URL_H */
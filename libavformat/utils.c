@@ -32,6 +32,7 @@
 #include "metadata.h"
 #include "id3v2.h"
 #include "libavutil/avstring.h"
+#include "libavutil/timer.h"
 #include "riff.h"
 #include "audiointerleave.h"
 #include "url.h"
@@ -264,10 +265,36 @@ AVInputFormat *av_find_input_format(const char *short_name)
 }
 
 
+/**
+ * Make pkt borrow up to size bytes from the buffer of s, see ffio_lend().
+ * @return the packet size, 0 if nothing was lent, or a negative AVERROR
+ */
+static int lend_packet(AVIOContext *s, AVPacket *pkt, int size, int partial)
+{
+    AVBufferRef *buf;
+    uint8_t *data;
+    int64_t pos = avio_tell(s);
+    int ret = ffio_lend(s, size, partial, &buf, &data);
+
+    if (ret <= 0)
+        return ret;
+    av_init_packet(pkt);
+    pkt->buf      = buf;
+    pkt->data     = data;
+    pkt->size     = ret;
+    pkt->pos      = pos;
+    pkt->destruct = av_destruct_packet;
+    return ret;
+}
+
 int av_get_packet(AVIOContext *s, AVPacket *pkt, int size)
 {
-    int ret= av_new_packet(pkt, size);
+    int ret;
+
+    if (s->buffer_ref && (ret = lend_packet(s, pkt, size, 0)))
+        return ret;
 
+    ret= av_new_packet(pkt, size);
     if(ret<0)
         return ret;
 
@@ -282,6 +309,27 @@ int av_get_packet(AVIOContext *s, AVPacket *pkt, int size)
     return ret;
 }
 
+int ff_get_partial_packet(AVIOContext *s, AVPacket *pkt, int size)
+{
+    int ret;
+
+    if (s->buffer_ref && (ret = lend_packet(s, pkt, size, 1)))
+        return ret;
+
+    if ((ret = av_new_packet(pkt, size)) < 0)
+        return ret;
+
+    pkt->pos = avio_tell(s);
+
+    ret = ffio_read_partial(s, pkt->data, size);
+    if (ret < 0) {
+        av_free_packet(pkt);
+        return ret;
+    }
+    av_shrink_packet(pkt, ret);
+    return ret;
+}
+
 int av_append_packet(AVIOContext *s, AVPacket *pkt, int size)
 {
     int ret;
@@ -304,11 +352,16 @@ int av_filename_number_test(const char *filename)
     return filename && (av_get_frame_filename(buf, sizeof(buf), filename, 1)>=0);
 }
 
+/** maximum number of demuxers probed ahead because of a matching extension */
+#define MAX_EXT_CANDIDATES 8
+
 AVInputFormat *av_probe_input_format3(AVProbeData *pd, int is_opened, int *score_ret)
 {
     AVProbeData lpd = *pd;
     AVInputFormat *fmt1 = NULL, *fmt;
-    int score, score_max=0;
+    AVInputFormat *ext_fmt[MAX_EXT_CANDIDATES];
+    int ext_score[MAX_EXT_CANDIDATES];
+    int score, score_max=0, nb_ext = 0, i;
 
     if (lpd.buf_size > 10 && ff_id3v2_match(lpd.buf, ID3v2_DEFAULT_MAGIC)) {
         int id3len = ff_id3v2_tag_len(lpd.buf);
@@ -318,12 +371,35 @@ AVInputFormat *av_probe_input_format3(AVProbeData *pd, int is_opened, int *score
         }
     }
 
+    /* Demuxers whose extension matches the filename are the likely
+     * candidates, so run them first; a certain detection by one of them
+     * ends the search without probing every other registered demuxer. */
+    if (is_opened && lpd.filename && strrchr(lpd.filename, '.')) {
+        while (nb_ext < MAX_EXT_CANDIDATES && (fmt1 = av_iformat_next(fmt1))) {
+            if ((fmt1->flags & AVFMT_NOFILE) || !fmt1->read_probe ||
+                !fmt1->extensions || !av_match_ext(lpd.filename, fmt1->extensions))
+                continue;
+            score = fmt1->read_probe(&lpd);
+            if (score >= AVPROBE_SCORE_MAX) {
+                *score_ret = score;
+                return fmt1;
+            }
+            ext_fmt  [nb_ext] = fmt1;
+            ext_score[nb_ext] = score ? score : 1;
+            nb_ext++;
+        }
+        fmt1 = NULL;
+    }
+
     fmt = NULL;
     while ((fmt1 = av_iformat_next(fmt1))) {
         if (!is_opened == !(fmt1->flags & AVFMT_NOFILE))
             continue;
         score = 0;
-        if (fmt1->read_probe) {
+        for (i = 0; i < nb_ext && ext_fmt[i] != fmt1; i++);
+        if (i < nb_ext) {
+            score = ext_score[i];
+        } else if (fmt1->read_probe) {
             score = fmt1->read_probe(&lpd);
             if(!score && fmt1->extensions && av_match_ext(lpd.filename, fmt1->extensions))
                 score = 1;
@@ -478,7 +554,7 @@ int av_demuxer_open(AVFormatContext *ic, AVFormatParameters *ap){
     int err;
 
     if (ic->iformat->read_header) {
-        err = ic->iformat->read_header(ic, ap);
+        FF_MEM_TAGGED(ic->iformat->name, err = ic->iformat->read_header(ic, ap));
         if (err < 0)
             return err;
     }
@@ -500,7 +576,7 @@ int av_probe_input_buffer(AVIOContext *pb, AVInputFormat **fmt,
 {
     AVProbeData pd = { filename ? filename : "", NULL, -offset };
     unsigned char *buf = NULL;
-    int ret = 0, probe_size;
+    int ret = 0, probe_size, eof = 0;
 
     if (!max_probe_size) {
         max_probe_size = PROBE_BUF_MAX;
@@ -514,7 +590,7 @@ int av_probe_input_buffer(AVIOContext *pb, AVInputFormat **fmt,
         return AVERROR(EINVAL);
     }
 
-    for(probe_size= PROBE_BUF_MIN; probe_size<=max_probe_size && !*fmt && ret >= 0;
+    for(probe_size= PROBE_BUF_MIN; probe_size<=max_probe_size && !*fmt && !eof;
         probe_size = FFMIN(probe_size<<1, FFMAX(max_probe_size, probe_size+1))) {
         int ret, score = probe_size < max_probe_size ? AVPROBE_SCORE_MAX/4 : 0;
         int buf_offset = (probe_size == PROBE_BUF_MIN) ? 0 : probe_size>>1;
@@ -531,9 +607,14 @@ int av_probe_input_buffer(AVIOContext *pb, AVInputFormat **fmt,
                 av_free(buf);
                 return ret;
             }
-            score = 0;
             ret = 0;            /* error was end of file, nothing read */
         }
+        /* a short read means the whole stream is in the buffer, so take
+         * the best guess now, a larger probe size cannot change it */
+        if (ret < probe_size - buf_offset) {
+            score = 0;
+            eof   = 1;
+        }
         pd.buf_size += ret;
         pd.buf = &buf[offset];
 
@@ -600,8 +681,12 @@ static int init_input(AVFormatContext *s, const char *filename)
         (!s->iformat && (s->iformat = av_probe_input_format(&pd, 0))))
         return 0;
 
-    if ((ret = avio_open(&s->pb, filename, AVIO_FLAG_READ)) < 0)
+    if ((ret = avio_open(&s->pb, filename, AVIO_FLAG_READ |
+                         (s->flags & AVFMT_FLAG_MMAP ? AVIO_FLAG_MMAP : 0))) < 0)
        return ret;
+    if (s->async_buffer_size > 0 &&
+        (ret = ffio_enable_async(s->pb, s->async_buffer_size)) < 0)
+        av_log(s, AV_LOG_WARNING, "Could not enable asynchronous reading\n");
     if (s->iformat)
         return 0;
     return av_probe_input_buffer(s->pb, &s->iformat, filename, s, 0, 0);
@@ -657,15 +742,19 @@ int avformat_open_input(AVFormatContext **ps, const char *filename, AVInputForma
     if (s->pb)
         ff_id3v2_read(s, ID3v2_DEFAULT_MAGIC);
 
-    if (!(s->flags&AVFMT_FLAG_PRIV_OPT) && s->iformat->read_header)
-        if ((ret = s->iformat->read_header(s, &ap)) < 0)
+    if (!(s->flags&AVFMT_FLAG_PRIV_OPT) && s->iformat->read_header) {
+        FF_MEM_TAGGED(s->iformat->name, ret = s->iformat->read_header(s, &ap));
+        if (ret < 0)
             goto fail;
+    }
 
     if (!(s->flags&AVFMT_FLAG_PRIV_OPT) && s->pb && !s->data_offset)
         s->data_offset = avio_tell(s->pb);
 
     s->raw_packet_buffer_remaining_size = RAW_PACKET_BUFFER_SIZE;
 
+    ff_index_cache_load(s);
+
     if (options) {
         av_dict_free(options);
         *options = tmp;
@@ -720,7 +809,7 @@ int av_read_packet(AVFormatContext *s, AVPacket *pkt)
         }
 
         av_init_packet(pkt);
-        ret= s->iformat->read_packet(s, pkt);
+        FF_MEM_TAGGED(s->iformat->name, ret = s->iformat->read_packet(s, pkt));
         if (ret < 0) {
             if (!pktl || ret == AVERROR(EAGAIN))
                 return ret;
@@ -1153,6 +1242,7 @@ static int av_read_frame_internal(AVFormatContext *s, AVPacket *pkt)
                     if(pkt->data == st->cur_pkt.data && pkt->size == st->cur_pkt.size){
                         s->cur_st = NULL;
                         pkt->destruct= st->cur_pkt.destruct;
+                        pkt->buf     = st->cur_pkt.buf;
                         st->cur_pkt.destruct= NULL;
                         st->cur_pkt.data    = NULL;
                         assert(st->cur_len == 0);
@@ -1250,7 +1340,7 @@ static int av_read_frame_internal(AVFormatContext *s, AVPacket *pkt)
     return 0;
 }
 
-int av_read_frame(AVFormatContext *s, AVPacket *pkt)
+static int read_frame(AVFormatContext *s, AVPacket *pkt)
 {
     AVPacketList *pktl;
     int eof=0;
@@ -1304,6 +1394,15 @@ int av_read_frame(AVFormatContext *s, AVPacket *pkt)
     }
 }
 
+int av_read_frame(AVFormatContext *s, AVPacket *pkt)
+{
+    int ret;
+    AV_PROFILE_START(read_frame);
+    ret = read_frame(s, pkt);
+    AV_PROFILE_STOP(read_frame, "av_read_frame");
+    return ret;
+}
+
 /* XXX: suppress the packet queue */
 static void flush_packet_queue(AVFormatContext *s)
 {
@@ -1403,10 +1502,34 @@ void ff_reduce_index(AVFormatContext *s, int stream_index)
     unsigned int max_entries= s->max_index_size / sizeof(AVIndexEntry);
 
     if((unsigned)st->nb_index_entries >= max_entries){
-        int i;
-        for(i=0; 2*i<st->nb_index_entries; i++)
-            st->index_entries[i]= st->index_entries[2*i];
-        st->nb_index_entries= i;
+        AVIndexEntry *entries= st->index_entries;
+        int n= st->nb_index_entries;
+        int i, j;
+
+        if(max_entries < 4){
+            for(i=0; 2*i<n; i++)
+                entries[i]= entries[2*i];
+            st->nb_index_entries= i;
+            return;
+        }
+
+        /* Keep the first and last entries and thin out the ones in between
+         * to an even spacing in time, so that entries added since the last
+         * reduction do not end up denser than older ones. This leaves at
+         * most max_entries/2 + 1 entries. */
+        {
+            int64_t step= (entries[n-1].timestamp - entries[0].timestamp) / (max_entries/2) + 1;
+            int64_t last= entries[0].timestamp;
+
+            for(i=j=1; i<n-1; i++){
+                if(entries[i].timestamp - last >= step){
+                    entries[j++]= entries[i];
+                    last= entries[i].timestamp;
+                }
+            }
+            entries[j++]= entries[n-1];
+            st->nb_index_entries= j;
+        }
     }
 }
 
@@ -1416,21 +1539,30 @@ int ff_add_index_entry(AVIndexEntry **index_entries,
                        int64_t pos, int64_t timestamp, int size, int distance, int flags)
 {
     AVIndexEntry *entries, *ie;
+    unsigned int min_entries;
     int index;
 
     if((unsigned)*nb_index_entries + 1 >= UINT_MAX / sizeof(AVIndexEntry))
         return -1;
 
+    /* grow geometrically, the index of a long file is built one entry at a time */
+    min_entries= *nb_index_entries + 1;
+    if(min_entries * sizeof(AVIndexEntry) >= *index_entries_allocated_size)
+        min_entries= FFMIN(min_entries + min_entries/2,
+                           UINT_MAX / sizeof(AVIndexEntry) - 1);
     entries = av_fast_realloc(*index_entries,
                               index_entries_allocated_size,
-                              (*nb_index_entries + 1) *
-                              sizeof(AVIndexEntry));
+                              min_entries * sizeof(AVIndexEntry));
     if(!entries)
         return -1;
 
     *index_entries= entries;
 
-    index= ff_index_search_timestamp(*index_entries, *nb_index_entries, timestamp, AVSEEK_FLAG_ANY);
+    /* entries are usually added in timestamp order, append without searching */
+    if(!*nb_index_entries || entries[*nb_index_entries-1].timestamp < timestamp)
+        index= -1;
+    else
+        index= ff_index_search_timestamp(*index_entries, *nb_index_entries, timestamp, AVSEEK_FLAG_ANY);
 
     if(index<0){
         index= (*nb_index_entries)++;
@@ -2305,8 +2437,16 @@ int av_find_stream_info(AVFormatContext *ic)
             int fps_analyze_framecount = 20;
 
             st = ic->streams[i];
+            if (st->discard >= AVDISCARD_ALL)
+                continue;
             if (!has_codec_parameters(st->codec))
                 break;
+            /* extradata is still needed for global headers */
+            if (ic->flags & AVFMT_FLAG_FAST_INFO) {
+                if (st->parser && st->parser->parser->split && !st->codec->extradata)
+                    break;
+                continue;
+            }
             /* if the timebase is coarse (like the usual millisecond precision
                of mkv), we need to analyze more frames to reliably arrive at
                the correct fps */
@@ -2328,7 +2468,8 @@ int av_find_stream_info(AVFormatContext *ic)
             /* NOTE: if the format has no header, then we need to read
                some packets to get most of the streams, so we cannot
                stop here */
-            if (!(ic->ctx_flags & AVFMTCTX_NOHEADER)) {
+            if (!(ic->ctx_flags & AVFMTCTX_NOHEADER) ||
+                ((ic->flags & AVFMT_FLAG_FAST_INFO) && ic->nb_streams)) {
                 /* if we found the info for all the codecs, we can stop */
                 ret = count;
                 av_log(ic, AV_LOG_DEBUG, "All info found\n");
@@ -2350,6 +2491,8 @@ int av_find_stream_info(AVFormatContext *ic)
             ret = -1; /* we could not have all the codec parameters before EOF */
             for(i=0;i<ic->nb_streams;i++) {
                 st = ic->streams[i];
+                if (st->discard >= AVDISCARD_ALL)
+                    continue;
                 if (!has_codec_parameters(st->codec)){
                     char buf[256];
                     avcodec_string(buf, sizeof(buf), st->codec, 0);
@@ -2418,7 +2561,8 @@ int av_find_stream_info(AVFormatContext *ic)
            decompress the frame. We try to avoid that in most cases as
            it takes longer and uses more memory. For MPEG-4, we need to
            decompress for QuickTime. */
-        if (!has_codec_parameters(st->codec) || !has_decode_delay_been_guessed(st))
+        if (st->discard < AVDISCARD_ALL &&
+            (!has_codec_parameters(st->codec) || !has_decode_delay_been_guessed(st)))
             try_decode_frame(st, pkt);
 
         st->codec_info_nb_frames++;
@@ -2504,6 +2648,8 @@ int av_find_stream_info(AVFormatContext *ic)
 
     compute_chapters_end(ic);
 
+    ff_index_cache_load(ic);
+
 #if 0
     /* correct DTS for B-frame streams with no timestamps */
     for(i=0;i<ic->nb_streams;i++) {
@@ -2622,11 +2768,39 @@ int av_read_pause(AVFormatContext *s)
 void av_close_input_stream(AVFormatContext *s)
 {
     flush_packet_queue(s);
+    ff_index_cache_save(s);
     if (s->iformat->read_close)
         s->iformat->read_close(s);
     avformat_free_context(s);
 }
 
+/**
+ * Free the packets queued for interleaving and the interleaver state.
+ */
+static void free_interleave_queue(AVFormatContext *s)
+{
+    AVPacketList *pktl, *next;
+    int i;
+
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+        for (pktl = st->first_in_packet_buffer; pktl; pktl = next) {
+            next = pktl->next;
+            av_free_packet(&pktl->pkt);
+            av_free(pktl);
+        }
+        st->first_in_packet_buffer = st->last_in_packet_buffer = NULL;
+    }
+    for (pktl = s->interleave_free_nodes; pktl; pktl = next) {
+        next = pktl->next;
+        av_free(pktl);
+    }
+    s->interleave_free_nodes  = NULL;
+    s->nb_interleaved_streams = 0;
+    s->interleave_heap_size   = 0;
+    av_freep(&s->interleave_heap);
+}
+
 void avformat_free_context(AVFormatContext *s)
 {
     int i;
@@ -2636,6 +2810,7 @@ void avformat_free_context(AVFormatContext *s)
     if (s->iformat && s->iformat->priv_class && s->priv_data)
         av_opt_free(s->priv_data);
 
+    free_interleave_queue(s);
     for(i=0;i<s->nb_streams;i++) {
         /* free all data in a stream component */
         st = s->streams[i];
@@ -2994,6 +3169,10 @@ int avformat_write_header(AVFormatContext *s, AVDictionary **options)
         av_dict_set(&s->metadata, "encoder", LIBAVFORMAT_IDENT, 0);
     }
 
+    if (s->async_buffer_size > 0 && s->pb && !(s->oformat->flags & AVFMT_NOFILE) &&
+        ffio_enable_async(s->pb, s->async_buffer_size) < 0)
+        av_log(s, AV_LOG_WARNING, "Could not enable asynchronous writing\n");
+
     if(s->oformat->write_header){
         ret = s->oformat->write_header(s);
         if (ret < 0)
@@ -3123,40 +3302,114 @@ int av_write_frame(AVFormatContext *s, AVPacket *pkt)
     return ret;
 }
 
-void ff_interleave_add_packet(AVFormatContext *s, AVPacket *pkt,
-                              int (*compare)(AVFormatContext *, AVPacket *, AVPacket *))
+static AVPacket *interleave_head(AVFormatContext *s, int i)
+{
+    return &s->streams[s->interleave_heap[i]]->first_in_packet_buffer->pkt;
+}
+
+/* whether the first packet of the stream at heap entry a goes before the
+ * one of the stream at entry b */
+static int interleave_before(AVFormatContext *s, int a, int b)
+{
+    return s->interleave_compare(s, interleave_head(s, b), interleave_head(s, a));
+}
+
+static void interleave_heap_swap(AVFormatContext *s, int a, int b)
+{
+    FFSWAP(int, s->interleave_heap[a], s->interleave_heap[b]);
+}
+
+static void interleave_heap_up(AVFormatContext *s, int i)
+{
+    while (i > 0 && interleave_before(s, i, (i - 1) >> 1)) {
+        interleave_heap_swap(s, i, (i - 1) >> 1);
+        i = (i - 1) >> 1;
+    }
+}
+
+static void interleave_heap_down(AVFormatContext *s, int i)
+{
+    int n = s->nb_interleaved_streams;
+
+    for (;;) {
+        int first = i, child = 2*i + 1;
+        if (child < n && interleave_before(s, child, first))
+            first = child;
+        if (child + 1 < n && interleave_before(s, child + 1, first))
+            first = child + 1;
+        if (first == i)
+            break;
+        interleave_heap_swap(s, i, first);
+        i = first;
+    }
+}
+
+int ff_interleave_add_packet(AVFormatContext *s, AVPacket *pkt,
+                             int (*compare)(AVFormatContext *, AVPacket *, AVPacket *))
 {
-    AVPacketList **next_point, *this_pktl;
+    AVStream *st = s->streams[pkt->stream_index];
+    AVPacketList *this_pktl;
 
-    this_pktl = av_mallocz(sizeof(AVPacketList));
-    this_pktl->pkt= *pkt;
+    if (!st->last_in_packet_buffer && s->interleave_heap_size < s->nb_streams) {
+        int *heap = av_realloc(s->interleave_heap, s->nb_streams * sizeof(*heap));
+        if (!heap)
+            return AVERROR(ENOMEM);
+        s->interleave_heap      = heap;
+        s->interleave_heap_size = s->nb_streams;
+    }
+
+    if ((this_pktl = s->interleave_free_nodes))
+        s->interleave_free_nodes = this_pktl->next;
+    else if (!(this_pktl = av_malloc(sizeof(AVPacketList))))
+        return AVERROR(ENOMEM);
+    this_pktl->pkt = *pkt;
+    this_pktl->next = NULL;
     pkt->destruct= NULL;             // do not free original but only the copy
     av_dup_packet(&this_pktl->pkt);  // duplicate the packet if it uses non-alloced memory
 
-    if(s->streams[pkt->stream_index]->last_in_packet_buffer){
-        next_point = &(s->streams[pkt->stream_index]->last_in_packet_buffer->next);
-    }else
-        next_point = &s->packet_buffer;
+    if (!s->nb_interleaved_streams)
+        s->interleave_max_dts = AV_NOPTS_VALUE;
+    if (pkt->dts != AV_NOPTS_VALUE) {
+        int64_t dts = av_rescale_q(pkt->dts, st->time_base, AV_TIME_BASE_Q);
+        if (s->interleave_max_dts == AV_NOPTS_VALUE || dts > s->interleave_max_dts)
+            s->interleave_max_dts = dts;
+    }
+    s->interleave_compare = compare;
 
-    if(*next_point){
-        if(compare(s, &s->packet_buffer_end->pkt, pkt)){
-            while(!compare(s, &(*next_point)->pkt, pkt)){
-                next_point= &(*next_point)->next;
-            }
-            goto next_non_null;
-        }else{
-            next_point = &(s->packet_buffer_end->next);
-        }
+    /* the packets of a stream stay in their order, so only a stream
+     * which had none queued changes its position in the heap */
+    if (st->last_in_packet_buffer) {
+        st->last_in_packet_buffer->next = this_pktl;
+    } else {
+        st->first_in_packet_buffer = this_pktl;
+        s->interleave_heap[s->nb_interleaved_streams] = pkt->stream_index;
+        interleave_heap_up(s, s->nb_interleaved_streams++);
     }
-    assert(!*next_point);
+    st->last_in_packet_buffer = this_pktl;
+    return 0;
+}
+
+int ff_interleave_get_packet(AVFormatContext *s, AVPacket *out)
+{
+    AVStream *st;
+    AVPacketList *pktl;
 
-    s->packet_buffer_end= this_pktl;
-next_non_null:
+    if (!s->nb_interleaved_streams)
+        return 0;
+
+    st   = s->streams[s->interleave_heap[0]];
+    pktl = st->first_in_packet_buffer;
+    *out = pktl->pkt;
 
-    this_pktl->next= *next_point;
+    if (!(st->first_in_packet_buffer = pktl->next)) {
+        st->last_in_packet_buffer = NULL;
+        s->interleave_heap[0] = s->interleave_heap[--s->nb_interleaved_streams];
+    }
+    interleave_heap_down(s, 0);
 
-    s->streams[pkt->stream_index]->last_in_packet_buffer=
-    *next_point= this_pktl;
+    pktl->next = s->interleave_free_nodes;
+    s->interleave_free_nodes = pktl;
+    return 1;
 }
 
 static int ff_interleave_compare_dts(AVFormatContext *s, AVPacket *next, AVPacket *pkt)
@@ -3172,33 +3425,38 @@ static int ff_interleave_compare_dts(AVFormatContext *s, AVPacket *next, AVPacke
 }
 
 int av_interleave_packet_per_dts(AVFormatContext *s, AVPacket *out, AVPacket *pkt, int flush){
-    AVPacketList *pktl;
-    int stream_count=0;
-    int i;
+    int stream_count, ret;
 
     if(pkt){
-        ff_interleave_add_packet(s, pkt, ff_interleave_compare_dts);
+        if ((ret = ff_interleave_add_packet(s, pkt, ff_interleave_compare_dts)) < 0)
+            return ret;
     }
 
-    for(i=0; i < s->nb_streams; i++)
-        stream_count+= !!s->streams[i]->last_in_packet_buffer;
+    stream_count= s->nb_interleaved_streams;
 
-    if(stream_count && (s->nb_streams == stream_count || flush)){
-        pktl= s->packet_buffer;
-        *out= pktl->pkt;
+    if(s->max_interleave_delta > 0 && stream_count && stream_count < s->nb_streams && !flush &&
+       s->interleave_max_dts != AV_NOPTS_VALUE){
+        AVPacket *top_pkt= interleave_head(s, 0);
 
-        s->packet_buffer= pktl->next;
-        if(!s->packet_buffer)
-            s->packet_buffer_end= NULL;
+        if(top_pkt->dts != AV_NOPTS_VALUE){
+            int64_t top_dts= av_rescale_q(top_pkt->dts, s->streams[top_pkt->stream_index]->time_base,
+                                          AV_TIME_BASE_Q);
+            int64_t delta_dts= s->interleave_max_dts - top_dts;
 
-        if(s->streams[out->stream_index]->last_in_packet_buffer == pktl)
-            s->streams[out->stream_index]->last_in_packet_buffer= NULL;
-        av_freep(&pktl);
-        return 1;
-    }else{
-        av_init_packet(out);
-        return 0;
+            if(delta_dts > s->max_interleave_delta){
+                av_log(s, AV_LOG_DEBUG,
+                       "Delay between the first and the last queued packets is %"PRId64" > %"PRId64": forcing output\n",
+                       delta_dts, s->max_interleave_delta);
+                flush= 1;
+            }
+        }
     }
+
+    if(stream_count && (s->nb_streams == stream_count || flush))
+        return ff_interleave_get_packet(s, out);
+
+    av_init_packet(out);
+    return 0;
 }
 
 /**
@@ -3278,6 +3536,7 @@ int av_write_trailer(AVFormatContext *s)
 fail:
     if(ret == 0)
        ret=url_ferror(s->pb);
+    free_interleave_queue(s);
     for(i=0;i<s->nb_streams;i++) {
         av_freep(&s->streams[i]->priv_data);
         av_freep(&s->streams[i]->index_entries);
@@ -22,6 +22,7 @@
 
 #include "common.h"
 #include "aes.h"
+#include "cpu.h"
 
 typedef union {
     uint64_t u64[2];
@@ -36,6 +37,7 @@ typedef struct AVAES{
     av_aes_block round_key[15];
     av_aes_block state[2];
     int rounds;
+    void (*crypt)(struct AVAES *a, uint8_t *dst, const uint8_t *src, int count, uint8_t *iv, int decrypt);
 }AVAES;
 
 const int av_aes_size= sizeof(AVAES);
@@ -95,7 +97,7 @@ static inline void crypt(AVAES *a, int s, const uint8_t *sbox, uint32_t multbl[]
     subshift(&a->state[0], s, sbox);
 }
 
-void av_aes_crypt(AVAES *a, uint8_t *dst_, const uint8_t *src_, int count, uint8_t *iv_, int decrypt){
+static void aes_crypt_c(AVAES *a, uint8_t *dst_, const uint8_t *src_, int count, uint8_t *iv_, int decrypt){
     av_aes_block *dst = (av_aes_block *)dst_;
     const av_aes_block *src = (const av_aes_block *)src_;
     av_aes_block *iv = (av_aes_block *)iv_;
@@ -119,6 +121,14 @@ void av_aes_crypt(AVAES *a, uint8_t *dst_, const uint8_t *src_, int count, uint8
     }
 }
 
+#if ARCH_X86
+#include "x86/aes.h"
+#endif
+
+void av_aes_crypt(AVAES *a, uint8_t *dst, const uint8_t *src, int count, uint8_t *iv, int decrypt){
+    a->crypt(a, dst, src, count, iv, decrypt);
+}
+
 static void init_multbl2(uint8_t tbl[1024], const int c[4], const uint8_t *log8, const uint8_t *alog8, const uint8_t *sbox){
     int i, j;
     for(i=0; i<1024; i++){
@@ -166,6 +176,12 @@ int av_aes_init(AVAES *a, const uint8_t *key, int key_bits, int decrypt) {
 
     a->rounds= rounds;
 
+    a->crypt = aes_crypt_c;
+#if HAVE_AES_CRYPT_AESNI
+    if (av_get_cpu_flags() & AV_CPU_FLAG_AESNI)
+        a->crypt = aes_crypt_aesni;
+#endif
+
     memcpy(tk, key, KC*4);
 
     for(t= 0; t < (rounds+1)*16;) {
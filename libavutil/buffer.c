@@ -0,0 +1,339 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "config.h"
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
+#include "buffer.h"
+#include "common.h"
+#include "error.h"
+#include "mem.h"
+
+/* the data was allocated by av_buffer_alloc() and may be av_realloc()ed */
+#define BUFFER_FLAG_REALLOCATABLE (1 << 16)
+/* the AVBuffer is part of a BufferPoolEntry and is not freed on its own */
+#define BUFFER_FLAG_POOLED        (1 << 17)
+
+struct AVBuffer {
+    uint8_t *data;
+    int      size;
+    volatile int refcount;
+    void   (*free)(void *opaque, uint8_t *data);
+    void    *opaque;
+    int      flags;
+};
+
+#if HAVE_SYNC_VAL_COMPARE_AND_SWAP
+#define REFCOUNT_ADD(b, n) __sync_add_and_fetch(&(b)->refcount, n)
+#elif HAVE_PTHREADS
+static pthread_mutex_t refcount_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int refcount_add(AVBuffer *b, int n)
+{
+    int ret;
+    pthread_mutex_lock(&refcount_lock);
+    ret = b->refcount += n;
+    pthread_mutex_unlock(&refcount_lock);
+    return ret;
+}
+#define REFCOUNT_ADD(b, n) refcount_add(b, n)
+#else
+#define REFCOUNT_ADD(b, n) ((b)->refcount += (n))
+#endif
+
+typedef struct BufferPoolEntry {
+    AVBuffer     buffer;
+    AVBufferRef  ref;           ///< returned by av_buffer_pool_get(), so that no reference is allocated
+    AVBufferRef *orig;          ///< buffer allocated for the pool, owns the data
+    AVBufferPool *pool;
+    struct BufferPoolEntry *next;
+} BufferPoolEntry;
+
+struct AVBufferPool {
+    BufferPoolEntry *free_list; ///< buffers returned to the pool
+    int size;
+    int refcount;               ///< 1 until av_buffer_pool_uninit(), plus 1 per buffer in use
+    AVBufferRef* (*alloc)(int size);
+#if HAVE_PTHREADS
+    pthread_mutex_t lock;
+#endif
+};
+
+#if HAVE_PTHREADS
+#define POOL_LOCK(pool)   pthread_mutex_lock(&(pool)->lock)
+#define POOL_UNLOCK(pool) pthread_mutex_unlock(&(pool)->lock)
+#else
+#define POOL_LOCK(pool)
+#define POOL_UNLOCK(pool)
+#endif
+
+void av_buffer_default_free(void *opaque, uint8_t *data)
+{
+    av_free(data);
+}
+
+AVBufferRef *av_buffer_create(uint8_t *data, int size,
+                              void (*free)(void *opaque, uint8_t *data),
+                              void *opaque, int flags)
+{
+    AVBufferRef *ref;
+    AVBuffer *buf = av_mallocz(sizeof(*buf));
+    if (!buf)
+        return NULL;
+
+    buf->data     = data;
+    buf->size     = size;
+    buf->free     = free ? free : av_buffer_default_free;
+    buf->opaque   = opaque;
+    buf->flags    = flags;
+    buf->refcount = 1;
+
+    ref = av_mallocz(sizeof(*ref));
+    if (!ref) {
+        av_free(buf);
+        return NULL;
+    }
+    ref->buffer = buf;
+    ref->data   = data;
+    ref->size   = size;
+    return ref;
+}
+
+AVBufferRef *av_buffer_alloc(int size)
+{
+    AVBufferRef *ref;
+    uint8_t *data = av_malloc(size);
+    if (!data)
+        return NULL;
+
+    ref = av_buffer_create(data, size, av_buffer_default_free, NULL,
+                           BUFFER_FLAG_REALLOCATABLE);
+    if (!ref)
+        av_free(data);
+    return ref;
+}
+
+AVBufferRef *av_buffer_allocz(int size)
+{
+    AVBufferRef *ref = av_buffer_alloc(size);
+    if (ref)
+        memset(ref->data, 0, size);
+    return ref;
+}
+
+AVBufferRef *av_buffer_ref(AVBufferRef *buf)
+{
+    AVBufferRef *ref = av_malloc(sizeof(*ref));
+    if (!ref)
+        return NULL;
+
+    *ref = *buf;
+    REFCOUNT_ADD(buf->buffer, 1);
+    return ref;
+}
+
+void av_buffer_unref(AVBufferRef **buf)
+{
+    AVBuffer *b;
+    int pooled;
+
+    if (!buf || !*buf)
+        return;
+    b = (*buf)->buffer;
+    pooled = b->flags & BUFFER_FLAG_POOLED;
+    if (!pooled || *buf != &((BufferPoolEntry *)b->opaque)->ref)
+        av_free(*buf);
+    *buf = NULL;
+
+    if (!REFCOUNT_ADD(b, -1)) {
+        /* a pooled buffer may be reused as soon as it is back in the pool */
+        b->free(b->opaque, b->data);
+        if (!pooled)
+            av_free(b);
+    }
+}
+
+int av_buffer_is_writable(const AVBufferRef *buf)
+{
+    if (buf->buffer->flags & AV_BUFFER_FLAG_READONLY)
+        return 0;
+    return REFCOUNT_ADD(buf->buffer, 0) == 1;
+}
+
+int av_buffer_make_writable(AVBufferRef **pbuf)
+{
+    AVBufferRef *newbuf, *buf = *pbuf;
+
+    if (av_buffer_is_writable(buf))
+        return 0;
+
+    newbuf = av_buffer_alloc(buf->size);
+    if (!newbuf)
+        return AVERROR(ENOMEM);
+    memcpy(newbuf->data, buf->data, buf->size);
+
+    av_buffer_unref(pbuf);
+    *pbuf = newbuf;
+    return 0;
+}
+
+int av_buffer_realloc(AVBufferRef **pbuf, int size)
+{
+    AVBufferRef *buf = *pbuf;
+    uint8_t *tmp;
+
+    if (!buf) {
+        if (!(buf = av_buffer_alloc(size)))
+            return AVERROR(ENOMEM);
+        *pbuf = buf;
+        return 0;
+    } else if (buf->size == size)
+        return 0;
+
+    if (!(buf->buffer->flags & BUFFER_FLAG_REALLOCATABLE) ||
+        !av_buffer_is_writable(buf) || buf->data != buf->buffer->data) {
+        /* cannot realloc, allocate a new buffer and copy the data */
+        AVBufferRef *newbuf = av_buffer_alloc(size);
+        if (!newbuf)
+            return AVERROR(ENOMEM);
+        memcpy(newbuf->data, buf->data, FFMIN(size, buf->size));
+
+        av_buffer_unref(pbuf);
+        *pbuf = newbuf;
+        return 0;
+    }
+
+    tmp = av_realloc(buf->buffer->data, size);
+    if (!tmp)
+        return AVERROR(ENOMEM);
+
+    buf->buffer->data = buf->data = tmp;
+    buf->buffer->size = buf->size = size;
+    return 0;
+}
+
+static void pool_free_entries(BufferPoolEntry *entry)
+{
+    while (entry) {
+        BufferPoolEntry *next = entry->next;
+        av_buffer_unref(&entry->orig);
+        av_free(entry);
+        entry = next;
+    }
+}
+
+static void pool_free(AVBufferPool *pool)
+{
+    pool_free_entries(pool->free_list);
+#if HAVE_PTHREADS
+    pthread_mutex_destroy(&pool->lock);
+#endif
+    av_free(pool);
+}
+
+AVBufferPool *av_buffer_pool_init(int size, AVBufferRef* (*alloc)(int size))
+{
+    AVBufferPool *pool = av_mallocz(sizeof(*pool));
+    if (!pool)
+        return NULL;
+
+    pool->size     = size;
+    pool->alloc    = alloc ? alloc : av_buffer_alloc;
+    pool->refcount = 1;
+#if HAVE_PTHREADS
+    pthread_mutex_init(&pool->lock, NULL);
+#endif
+    return pool;
+}
+
+/* free callback of the pooled buffers: put the buffer back in the pool */
+static void pool_release_buffer(void *opaque, uint8_t *data)
+{
+    BufferPoolEntry *entry = opaque;
+    AVBufferPool *pool = entry->pool;
+    int unused;
+
+    POOL_LOCK(pool);
+    entry->next     = pool->free_list;
+    pool->free_list = entry;
+    unused = !--pool->refcount;
+    POOL_UNLOCK(pool);
+
+    if (unused)
+        pool_free(pool);
+}
+
+AVBufferRef *av_buffer_pool_get(AVBufferPool *pool)
+{
+    BufferPoolEntry *entry;
+
+    POOL_LOCK(pool);
+    if ((entry = pool->free_list))
+        pool->free_list = entry->next;
+    pool->refcount++;
+    POOL_UNLOCK(pool);
+
+    if (!entry) {
+        if (!(entry = av_mallocz(sizeof(*entry))) ||
+            !(entry->orig = pool->alloc(pool->size))) {
+            av_free(entry);
+            POOL_LOCK(pool);
+            pool->refcount--;
+            POOL_UNLOCK(pool);
+            return NULL;
+        }
+        entry->buffer.data   = entry->orig->data;
+        entry->buffer.size   = pool->size;
+        entry->buffer.free   = pool_release_buffer;
+        entry->buffer.opaque = entry;
+        entry->buffer.flags  = BUFFER_FLAG_POOLED;
+        entry->pool          = pool;
+    }
+
+    entry->buffer.refcount = 1;
+    entry->ref.buffer = &entry->buffer;
+    entry->ref.data   = entry->buffer.data;
+    entry->ref.size   = entry->buffer.size;
+    return &entry->ref;
+}
+
+void av_buffer_pool_uninit(AVBufferPool **ppool)
+{
+    AVBufferPool *pool = *ppool;
+    BufferPoolEntry *free_list;
+    int unused;
+
+    if (!pool)
+        return;
+    *ppool = NULL;
+
+    /* the buffers in use are freed when they come back */
+    POOL_LOCK(pool);
+    free_list       = pool->free_list;
+    pool->free_list = NULL;
+    unused = !--pool->refcount;
+    POOL_UNLOCK(pool);
+
+    pool_free_entries(free_list);
+    if (unused)
+        pool_free(pool);
+}
@@ -0,0 +1,160 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * reference-counted data buffers
+ *
+ * An AVBuffer is a block of memory shared by any number of AVBufferRef
+ * references. The memory is freed when the last reference is dropped.
+ * A buffer is writable through a reference only while this reference is
+ * the only one, so shared data is read-only and gets copied on write with
+ * av_buffer_make_writable().
+ */
+
+#ifndef AVUTIL_BUFFER_H
+#define AVUTIL_BUFFER_H
+
+#include <stdint.h>
+
+/**
+ * The shared part of a buffer, opaque to the user.
+ */
+typedef struct AVBuffer AVBuffer;
+
+/**
+ * A reference to an AVBuffer.
+ */
+typedef struct AVBufferRef {
+    AVBuffer *buffer;
+
+    /**
+     * The data of the buffer. Only writable if av_buffer_is_writable()
+     * returns 1.
+     */
+    uint8_t *data;
+    /**
+     * Size of data in bytes.
+     */
+    int      size;
+} AVBufferRef;
+
+/**
+ * Never consider the buffer writable, even with a single reference.
+ */
+#define AV_BUFFER_FLAG_READONLY (1 << 0)
+
+/**
+ * Allocate a buffer of the given size with av_malloc().
+ *
+ * @return a reference to the new buffer or NULL on failure
+ */
+AVBufferRef *av_buffer_alloc(int size);
+
+/**
+ * Same as av_buffer_alloc(), with the data zeroed.
+ */
+AVBufferRef *av_buffer_allocz(int size);
+
+/**
+ * Create a buffer from existing data. The buffer takes ownership of the
+ * data: it is released with free() once the last reference is dropped.
+ *
+ * @param free   called with opaque and data to release the data, or
+ *               NULL to use av_buffer_default_free()
+ * @param flags  a combination of AV_BUFFER_FLAG_*
+ * @return a reference to the new buffer or NULL on failure, in which case
+ *         the data is still owned by the caller
+ */
+AVBufferRef *av_buffer_create(uint8_t *data, int size,
+                              void (*free)(void *opaque, uint8_t *data),
+                              void *opaque, int flags);
+
+/**
+ * Release data with av_free(). This is the default for av_buffer_create().
+ */
+void av_buffer_default_free(void *opaque, uint8_t *data);
+
+/**
+ * Create a new reference to the buffer buf refers to.
+ *
+ * @return the new reference or NULL on failure
+ */
+AVBufferRef *av_buffer_ref(AVBufferRef *buf);
+
+/**
+ * Drop a reference and set *buf to NULL. The buffer is freed if this was
+ * its last reference.
+ */
+void av_buffer_unref(AVBufferRef **buf);
+
+/**
+ * @return 1 if the buffer may be written through buf, 0 otherwise
+ */
+int av_buffer_is_writable(const AVBufferRef *buf);
+
+/**
+ * Make *buf writable, by copying its data into a new buffer if it is
+ * shared or read-only. The old reference is dropped in that case.
+ *
+ * @return 0 on success, a negative AVERROR on failure
+ */
+int av_buffer_make_writable(AVBufferRef **buf);
+
+/**
+ * Change the size of a buffer. If *buf is NULL, a new buffer is allocated.
+ * The buffer is reallocated in place if it is writable and was allocated
+ * by av_buffer_alloc() or av_buffer_realloc(), and copied otherwise.
+ *
+ * @return 0 on success, a negative AVERROR on failure, in which case *buf
+ *         is left untouched
+ */
+int av_buffer_realloc(AVBufferRef **buf, int size);
+
+/**
+ * A pool of buffers of the same size. The buffers returned by
+ * av_buffer_pool_get() go back to the pool instead of being freed when
+ * their last reference is dropped, so that a steady stream of buffers
+ * does not allocate memory. The pool may be used from several threads.
+ */
+typedef struct AVBufferPool AVBufferPool;
+
+/**
+ * Allocate a pool.
+ *
+ * @param size  size of the buffers of the pool
+ * @param alloc allocates a new buffer of the given size for the pool, or
+ *              NULL to use av_buffer_alloc()
+ * @return the new pool or NULL on failure
+ */
+AVBufferPool *av_buffer_pool_init(int size, AVBufferRef* (*alloc)(int size));
+
+/**
+ * Get a buffer from the pool, reusing a returned buffer if there is one.
+ *
+ * @return a reference to the buffer or NULL on failure
+ */
+AVBufferRef *av_buffer_pool_get(AVBufferPool *pool);
+
+/**
+ * Release the pool and set *pool to NULL. The pool is freed once all the
+ * buffers taken from it are unreferenced.
+ */
+void av_buffer_pool_uninit(AVBufferPool **pool);
+
+#endif /* AVUTIL_BUFFER_H */
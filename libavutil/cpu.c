@@ -16,9 +16,23 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
-#include "cpu.h"
 #include "config.h"
 
+/* must come before any system header */
+#if HAVE_SCHED_GETAFFINITY
+#define _GNU_SOURCE
+#include <sched.h>
+#endif
+#if HAVE_GETPROCESSAFFINITYMASK
+#include <windows.h>
+#endif
+#if HAVE_SYSCONF
+#include <unistd.h>
+#endif
+
+#include "cpu.h"
+#include "common.h"
+
 static int flags, checked;
 
 void av_force_cpu_flags(int arg){
@@ -39,6 +53,26 @@ int av_get_cpu_flags(void)
     return flags;
 }
 
+int av_cpu_count(void)
+{
+    int nb_cpus = 1;
+#if HAVE_SCHED_GETAFFINITY && defined(CPU_COUNT)
+    cpu_set_t cpuset;
+
+    CPU_ZERO(&cpuset);
+    if (!sched_getaffinity(0, sizeof(cpuset), &cpuset))
+        nb_cpus = CPU_COUNT(&cpuset);
+#elif HAVE_GETPROCESSAFFINITYMASK
+    DWORD_PTR proc_aff, sys_aff;
+
+    if (GetProcessAffinityMask(GetCurrentProcess(), &proc_aff, &sys_aff))
+        nb_cpus = av_popcount(proc_aff) + av_popcount((uint64_t)proc_aff >> 32);
+#elif HAVE_SYSCONF && defined(_SC_NPROCESSORS_ONLN)
+    nb_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return FFMAX(nb_cpus, 1);
+}
+
 #ifdef TEST
 
 #undef printf
@@ -49,7 +83,8 @@ int main(void)
     int cpu_flags = av_get_cpu_flags();
 
     printf("cpu_flags = 0x%08X\n", cpu_flags);
-    printf("cpu_flags = %s%s%s%s%s%s%s%s%s%s%s%s%s\n",
+    printf("cpu_count = %d\n", av_cpu_count());
+    printf("cpu_flags = %s%s%s%s%s%s%s%s%s%s%s%s%s%s%s%s\n",
 #if   ARCH_ARM
            cpu_flags & AV_CPU_FLAG_IWMMXT   ? "IWMMXT "     : "",
 #elif ARCH_PPC
@@ -67,6 +102,8 @@ int main(void)
            cpu_flags & AV_CPU_FLAG_SSE4     ? "SSE4.1 "     : "",
            cpu_flags & AV_CPU_FLAG_SSE42    ? "SSE4.2 "     : "",
            cpu_flags & AV_CPU_FLAG_AVX      ? "AVX "        : "",
+           cpu_flags & AV_CPU_FLAG_AVX2     ? "AVX2 "       : "",
+           cpu_flags & AV_CPU_FLAG_AESNI    ? "AESNI "      : "",
            cpu_flags & AV_CPU_FLAG_3DNOW    ? "3DNow "      : "",
            cpu_flags & AV_CPU_FLAG_3DNOWEXT ? "3DNowExt "   : "");
 #endif
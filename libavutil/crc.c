@@ -23,6 +23,12 @@
 #include "bswap.h"
 #include "crc.h"
 
+/* The slice-by-8 tables are the byte table, a marker and 7 more tables,
+ * the j-th giving the CRC of a byte followed by j zero bytes. The marker
+ * tells them apart from the single table (1) and the 4 tables (0). */
+#define CRC_SLICE8_SIZE (257 + 7*256)
+#define CRC_SLICE8(ctx, j) ((ctx) + ((j) ? 1 + 256*(j) : 0))
+
 #if CONFIG_HARDCODED_TABLES
 #include "crc_data.h"
 #else
@@ -37,12 +43,17 @@ static struct {
     [AV_CRC_32_IEEE]    = { 0, 32, 0x04C11DB7 },
     [AV_CRC_32_IEEE_LE] = { 1, 32, 0xEDB88320 },
 };
+#if CONFIG_SMALL
 static AVCRC av_crc_table[AV_CRC_MAX][257];
+#else
+static AVCRC av_crc_table[AV_CRC_MAX][CRC_SLICE8_SIZE];
+#endif
 #endif
 
 /**
  * Initialize a CRC table.
- * @param ctx must be an array of size sizeof(AVCRC)*257 or sizeof(AVCRC)*1024
+ * @param ctx must be an array of size sizeof(AVCRC)*257, sizeof(AVCRC)*1024
+ *            or sizeof(AVCRC)*2049; the larger ones make av_crc() faster
  * @param le If 1, the lowest bit represents the coefficient for the highest
  *           exponent of the corresponding polynomial (both for poly and
  *           actual CRC).
@@ -62,7 +73,8 @@ int av_crc_init(AVCRC *ctx, int le, int bits, uint32_t poly, int ctx_size){
 
     if (bits < 8 || bits > 32 || poly >= (1LL<<bits))
         return -1;
-    if (ctx_size != sizeof(AVCRC)*257 && ctx_size != sizeof(AVCRC)*1024)
+    if (ctx_size != sizeof(AVCRC)*257 && ctx_size != sizeof(AVCRC)*1024 &&
+        ctx_size != sizeof(AVCRC)*CRC_SLICE8_SIZE)
         return -1;
 
     for (i = 0; i < 256; i++) {
@@ -78,7 +90,15 @@ int av_crc_init(AVCRC *ctx, int le, int bits, uint32_t poly, int ctx_size){
     }
     ctx[256]=1;
 #if !CONFIG_SMALL
-    if(ctx_size >= sizeof(AVCRC)*1024)
+    if (ctx_size == sizeof(AVCRC)*CRC_SLICE8_SIZE) {
+        ctx[256] = 2;
+        for (j = 1; j < 8; j++) {
+            const AVCRC *prev = CRC_SLICE8(ctx, j - 1);
+            AVCRC *cur        = CRC_SLICE8(ctx, j);
+            for (i = 0; i < 256; i++)
+                cur[i] = (prev[i] >> 8) ^ ctx[prev[i] & 0xFF];
+        }
+    } else if(ctx_size >= sizeof(AVCRC)*1024)
         for (i = 0; i < 256; i++)
             for(j=0; j<3; j++)
                 ctx[256*(j+1) + i]= (ctx[256*j + i]>>8) ^ ctx[ ctx[256*j + i]&0xFF ];
@@ -116,7 +136,23 @@ uint32_t av_crc(const AVCRC *ctx, uint32_t crc, const uint8_t *buffer, size_t le
     const uint8_t *end= buffer+length;
 
 #if !CONFIG_SMALL
-    if(!ctx[256]) {
+    if (ctx[256] == 2) {
+        const AVCRC *t1 = CRC_SLICE8(ctx, 1), *t2 = CRC_SLICE8(ctx, 2),
+                    *t3 = CRC_SLICE8(ctx, 3), *t4 = CRC_SLICE8(ctx, 4),
+                    *t5 = CRC_SLICE8(ctx, 5), *t6 = CRC_SLICE8(ctx, 6),
+                    *t7 = CRC_SLICE8(ctx, 7);
+
+        while (((intptr_t) buffer & 3) && buffer < end)
+            crc = ctx[((uint8_t)crc) ^ *buffer++] ^ (crc >> 8);
+
+        while (end - buffer >= 8) {
+            uint32_t a = crc ^ av_le2ne32(*(const uint32_t*)buffer);
+            uint32_t b =       av_le2ne32(*(const uint32_t*)(buffer + 4));
+            buffer += 8;
+            crc = t7[a & 0xFF] ^ t6[(a >> 8) & 0xFF] ^ t5[(a >> 16) & 0xFF] ^ t4[a >> 24] ^
+                  t3[b & 0xFF] ^ t2[(b >> 8) & 0xFF] ^ t1[(b >> 16) & 0xFF] ^ ctx[b >> 24];
+        }
+    } else if(!ctx[256]) {
         while(((intptr_t) buffer & 3) && buffer < end)
             crc = ctx[((uint8_t)crc) ^ *buffer++] ^ (crc >> 8);
 
@@ -24,6 +24,84 @@
 #include "internal.h"
 #include "mem.h"
 
+/* Past INDEX_THRESHOLD entries, lookups of a whole key go through a hash
+ * index with linear probing. Its slots hold the position of an entry plus
+ * 1, 0 for an empty slot or INDEX_DELETED. */
+#define INDEX_THRESHOLD 16
+#define INDEX_DELETED   -1
+
+static unsigned int key_hash(const char *key)
+{
+    unsigned int h = 2166136261U;
+
+    while (*key)
+        h = (h ^ toupper(*key++)) * 16777619U;
+    return h;
+}
+
+static int key_equal(const char *a, const char *b, int flags)
+{
+    if (flags & AV_DICT_MATCH_CASE)
+        return !strcmp(a, b);
+    for (; toupper(*a) == toupper(*b) && *b; a++, b++);
+    return !*a && !*b;
+}
+
+/* the slot pointing to entry i */
+static int *index_find(AVDictionary *m, int i)
+{
+    unsigned int mask = m->index_size - 1;
+    unsigned int h    = key_hash(m->elems[i].key) & mask;
+
+    while (m->index[h] != i + 1)
+        h = (h + 1) & mask;
+    return &m->index[h];
+}
+
+static void index_add(AVDictionary *m, int i)
+{
+    unsigned int mask = m->index_size - 1;
+    unsigned int h    = key_hash(m->elems[i].key) & mask;
+
+    while (m->index[h] > 0)
+        h = (h + 1) & mask;
+    if (!m->index[h])
+        m->index_used++;
+    m->index[h] = i + 1;
+}
+
+/* rebuild the index with room for twice the entries; without memory, the
+ * dictionary goes back to linear lookups */
+static void index_build(AVDictionary *m)
+{
+    int i, size = 2 * INDEX_THRESHOLD;
+
+    while (size < 2 * m->count)
+        size *= 2;
+    av_freep(&m->index);
+    m->index_size = size;
+    m->index_used = 0;
+    if (!(m->index = av_mallocz(size * sizeof(*m->index))))
+        return;
+    for (i = 0; i < m->count; i++)
+        index_add(m, i);
+}
+
+/* the first entry matching key, as the linear search would find it */
+static AVDictionaryEntry *index_get(AVDictionary *m, const char *key, int flags)
+{
+    unsigned int mask = m->index_size - 1;
+    unsigned int h    = key_hash(key) & mask;
+    int best = INT_MAX;
+
+    for (; m->index[h]; h = (h + 1) & mask) {
+        int i = m->index[h] - 1;
+        if (i >= 0 && i < best && key_equal(m->elems[i].key, key, flags))
+            best = i;
+    }
+    return best < m->count ? &m->elems[best] : NULL;
+}
+
 AVDictionaryEntry *
 av_dict_get(AVDictionary *m, const char *key, const AVDictionaryEntry *prev, int flags)
 {
@@ -32,6 +110,13 @@ av_dict_get(AVDictionary *m, const char *key, const AVDictionaryEntry *prev, int
     if(!m)
         return NULL;
 
+    if (!prev && !(flags & AV_DICT_IGNORE_SUFFIX) && m->count >= INDEX_THRESHOLD) {
+        if (!m->index)
+            index_build(m);
+        if (m->index)
+            return index_get(m, key, flags);
+    }
+
     if(prev) i= prev - m->elems + 1;
     else     i= 0;
 
@@ -64,12 +149,25 @@ int av_dict_set(AVDictionary **pm, const char *key, const char *value, int flags
             oldval = tag->value;
         else
             av_free(tag->value);
+        if (m->index) {
+            int i = tag - m->elems;
+            *index_find(m, i) = INDEX_DELETED;
+            if (i != m->count - 1)
+                *index_find(m, m->count - 1) = i + 1;
+        }
         av_free(tag->key);
         *tag = m->elems[--m->count];
-    } else {
-        AVDictionaryEntry *tmp = av_realloc(m->elems, (m->count+1) * sizeof(*m->elems));
+    } else if (m->count >= m->allocated) {
+        /* grow geometrically, the entries are added one at a time */
+        int allocated = FFMAX(2 * m->allocated, 4);
+        AVDictionaryEntry *tmp;
+
+        if (allocated > INT_MAX / sizeof(*m->elems))
+            return AVERROR(ENOMEM);
+        tmp = av_realloc(m->elems, allocated * sizeof(*m->elems));
         if(tmp) {
-            m->elems = tmp;
+            m->elems     = tmp;
+            m->allocated = allocated;
         } else
             return AVERROR(ENOMEM);
     }
@@ -88,10 +186,18 @@ int av_dict_set(AVDictionary **pm, const char *key, const char *value, int flags
             m->elems[m->count].value = oldval;
         } else
             m->elems[m->count].value = av_strdup(value);
-        m->count++;
+        if (m->index) {
+            if (4 * (m->index_used + 1) > 3 * m->index_size) {
+                m->count++;
+                index_build(m);
+            } else
+                index_add(m, m->count++);
+        } else
+            m->count++;
     }
     if (!m->count) {
         av_free(m->elems);
+        av_free(m->index);
         av_freep(pm);
     }
 
@@ -108,6 +214,7 @@ void av_dict_free(AVDictionary **pm)
             av_free(m->elems[m->count].value);
         }
         av_free(m->elems);
+        av_free(m->index);
     }
     av_freep(pm);
 }
@@ -126,6 +126,7 @@ struct AVExpr {
         e_pow, e_mul, e_div, e_add,
         e_last, e_st, e_while, e_floor, e_ceil, e_trunc,
         e_sqrt, e_not,
+        e_jz, e_jmp, e_pop, // only in programs
     } type;
     double value; // is sign in other types
     union {
@@ -133,10 +134,26 @@ struct AVExpr {
         double (*func0)(double);
         double (*func1)(void *, double);
         double (*func2)(void *, double, double);
+        int target;         // of jumps, index of the next instruction
     } a;
     struct AVExpr *param[2];
+    struct ExprProgram *program;    // set on the root only
 };
 
+/**
+ * An expression compiled to postfix order: each instruction is a node of
+ * the tree without its parameters, and takes them from a stack of values.
+ * "while" is turned into jumps.
+ */
+typedef struct ExprProgram {
+    struct AVExpr *code;
+    int nb_code;
+    int stack_size;
+} ExprProgram;
+
+/* deeper programs are evaluated on the tree */
+#define MAX_STACK 64
+
 static double eval_expr(Parser *p, AVExpr *e)
 {
     switch (e->type) {
@@ -189,6 +206,10 @@ void av_expr_free(AVExpr *e)
     if (!e) return;
     av_expr_free(e->param[0]);
     av_expr_free(e->param[1]);
+    if (e->program) {
+        av_free(e->program->code);
+        av_free(e->program);
+    }
     av_freep(&e);
 }
 
@@ -465,6 +486,177 @@ static int verify_expr(AVExpr *e)
     }
 }
 
+/**
+ * Replace the subtrees which do not depend on the constant values, the
+ * user functions or the variables by their value.
+ * @return 1 if e is a value afterwards
+ */
+static int fold_expr(AVExpr *e)
+{
+    Parser p = { 0 };
+    int folded;
+
+    if (!e) return 1;
+    folded = fold_expr(e->param[0]) & fold_expr(e->param[1]);
+    switch (e->type) {
+        case e_value: return 1;
+        case e_const:
+        case e_func1:
+        case e_func2:
+        case e_ld:
+        case e_st:
+        case e_while: return 0;
+    }
+    if (!folded)
+        return 0;
+
+    e->value = eval_expr(&p, e);
+    e->type  = e_value;
+    av_expr_free(e->param[0]);
+    av_expr_free(e->param[1]);
+    e->param[0] = e->param[1] = NULL;
+    return 1;
+}
+
+static int count_nodes(AVExpr *e)
+{
+    return e ? 1 + count_nodes(e->param[0]) + count_nodes(e->param[1]) : 0;
+}
+
+/**
+ * Append the instructions evaluating e to the program.
+ * @param depth number of values on the stack before e is evaluated
+ */
+static void emit_expr(ExprProgram *prog, AVExpr *e, int depth)
+{
+    AVExpr *op;
+    int binary;
+
+    if (e->type == e_while) {
+        int start, jz;
+
+        /* the value of the last iteration, NAN without any */
+        op = &prog->code[prog->nb_code++];
+        op->type  = e_value;
+        op->value = NAN;
+        start = prog->nb_code;
+        emit_expr(prog, e->param[0], depth + 1);
+        jz = prog->nb_code++;
+        prog->code[jz].type = e_jz;
+        prog->code[prog->nb_code++].type = e_pop;
+        emit_expr(prog, e->param[1], depth);
+        op = &prog->code[prog->nb_code++];
+        op->type     = e_jmp;
+        op->a.target = start;
+        prog->code[jz].a.target = prog->nb_code;
+        return;
+    }
+
+    /* the second parameter of the unary functions is parsed but ignored */
+    switch (e->type) {
+        case e_value:
+        case e_const:
+            binary = 0;
+            break;
+        case e_func0:
+        case e_func1:
+        case e_squish:
+        case e_ld:
+        case e_gauss:
+        case e_isnan:
+        case e_floor:
+        case e_ceil:
+        case e_trunc:
+        case e_sqrt:
+        case e_not:
+            emit_expr(prog, e->param[0], depth);
+            binary = 0;
+            break;
+        default:
+            emit_expr(prog, e->param[0], depth);
+            emit_expr(prog, e->param[1], depth + 1);
+            binary = 1;
+    }
+    prog->stack_size = FFMAX(prog->stack_size, depth + 1 + binary);
+
+    op = &prog->code[prog->nb_code++];
+    *op = *e;
+    op->param[0] = op->param[1] = NULL;
+}
+
+/* compile the tree into e->program; the tree is used if this fails */
+static void compile_expr(AVExpr *e)
+{
+    /* a while node takes 4 instructions more than other nodes */
+    int max_code = 5 * count_nodes(e);
+    ExprProgram *prog = av_mallocz(sizeof(*prog));
+
+    if (!prog)
+        return;
+    if (!(prog->code = av_mallocz(max_code * sizeof(*prog->code)))) {
+        av_free(prog);
+        return;
+    }
+    emit_expr(prog, e, 0);
+    if (prog->stack_size > MAX_STACK) {
+        av_free(prog->code);
+        av_free(prog);
+        return;
+    }
+    e->program = prog;
+}
+
+static double eval_program(const ExprProgram *prog, const double *const_values, void *opaque)
+{
+    double stack[MAX_STACK], var[VARS] = { 0 };
+    double *sp = stack - 1, d, d2;
+    const AVExpr *code = prog->code, *op;
+
+    for (op = code; op < code + prog->nb_code; op++) {
+        switch (op->type) {
+        case e_value:  *++sp = op->value;                                          break;
+        case e_const:  *++sp = op->value * const_values[op->a.const_index];        break;
+        case e_func0:  *sp = op->value * op->a.func0(*sp);                         break;
+        case e_func1:  *sp = op->value * op->a.func1(opaque, *sp);                 break;
+        case e_func2:  sp--; *sp = op->value * op->a.func2(opaque, sp[0], sp[1]);  break;
+        case e_squish: *sp = 1/(1+exp(4**sp));                                     break;
+        case e_gauss:  d = *sp; *sp = exp(-d*d/2)/sqrt(2*M_PI);                    break;
+        case e_ld:     *sp = op->value * var[av_clip(*sp, 0, VARS-1)];             break;
+        case e_isnan:  *sp = op->value * !!isnan(*sp);                             break;
+        case e_floor:  *sp = op->value * floor(*sp);                               break;
+        case e_ceil :  *sp = op->value * ceil (*sp);                               break;
+        case e_trunc:  *sp = op->value * trunc(*sp);                               break;
+        case e_sqrt:   *sp = op->value * sqrt (*sp);                               break;
+        case e_not:    *sp = op->value * *sp == 0;                                 break;
+        case e_pop:    sp--;                                                       break;
+        case e_jmp:    op = code + op->a.target - 1;                               break;
+        case e_jz:
+            if (!*sp--)
+                op = code + op->a.target - 1;
+            break;
+        default:
+            d  = sp[-1];
+            d2 = sp[0];
+            sp--;
+            switch (op->type) {
+            case e_mod: *sp = op->value * (d - floor(d/d2)*d2);     break;
+            case e_max: *sp = op->value * (d >  d2 ?   d : d2);     break;
+            case e_min: *sp = op->value * (d <  d2 ?   d : d2);     break;
+            case e_eq:  *sp = op->value * (d == d2 ? 1.0 : 0.0);    break;
+            case e_gt:  *sp = op->value * (d >  d2 ? 1.0 : 0.0);    break;
+            case e_gte: *sp = op->value * (d >= d2 ? 1.0 : 0.0);    break;
+            case e_pow: *sp = op->value * pow(d, d2);               break;
+            case e_mul: *sp = op->value * (d * d2);                 break;
+            case e_div: *sp = op->value * (d / d2);                 break;
+            case e_add: *sp = op->value * (d + d2);                 break;
+            case e_last:*sp = op->value * d2;                       break;
+            case e_st : *sp = op->value * (var[av_clip(d, 0, VARS-1)]= d2); break;
+            }
+        }
+    }
+    return *sp;
+}
+
 int av_expr_parse(AVExpr **expr, const char *s,
                   const char * const *const_names,
                   const char * const *func1_names, double (* const *funcs1)(void *, double),
@@ -508,6 +700,8 @@ int av_expr_parse(AVExpr **expr, const char *s,
         ret = AVERROR(EINVAL);
         goto end;
     }
+    fold_expr(e);
+    compile_expr(e);
     *expr = e;
 end:
     av_free(w);
@@ -518,6 +712,10 @@ double av_expr_eval(AVExpr *e, const double *const_values, void *opaque)
 {
     Parser p;
 
+    if (e->program)
+        return eval_program(e->program, const_values, opaque);
+
+    memset(p.var, 0, sizeof(p.var));
     p.const_values = const_values;
     p.opaque     = opaque;
     return eval_expr(&p, e);
@@ -21,10 +21,18 @@
  * misc image utilities
  */
 
+#include "cpu.h"
 #include "imgutils.h"
 #include "internal.h"
 #include "pixdesc.h"
 
+#if ARCH_X86
+#include "x86/imgutils.h"
+#endif
+
+/* planes at least this big are copied without going through the cache */
+#define NT_COPY_THRESHOLD (4 << 20)
+
 void av_image_fill_max_pixsteps(int max_pixsteps[4], int max_pixstep_comps[4],
                                 const AVPixFmtDescriptor *pixdesc)
 {
@@ -125,7 +133,7 @@ int av_image_fill_pointers(uint8_t *data[4], enum PixelFormat pix_fmt, int heigh
         has_plane[desc->comp[i].plane] = 1;
 
     total_size = size[0];
-    for (i = 1; has_plane[i] && i < 4; i++) {
+    for (i = 1; i < 4 && has_plane[i]; i++) {
         int h, s = (i == 1 || i == 2) ? desc->log2_chroma_h : 0;
         data[i] = data[i-1] + size[i-1];
         h = (height + (1 << s) - 1) >> s;
@@ -234,6 +242,14 @@ void av_image_copy_plane(uint8_t       *dst, int dst_linesize,
 {
     if (!dst || !src)
         return;
+#if HAVE_IMAGE_COPY_PLANE_NT_SSE2
+    if ((int64_t)bytewidth * height >= NT_COPY_THRESHOLD &&
+        av_get_cpu_flags() & AV_CPU_FLAG_SSE2) {
+        image_copy_plane_nt_sse2(dst, dst_linesize, src, src_linesize,
+                                 bytewidth, height);
+        return;
+    }
+#endif
     for (;height > 0; height--) {
         memcpy(dst, src, bytewidth);
         dst += dst_linesize;
@@ -241,9 +257,25 @@ void av_image_copy_plane(uint8_t       *dst, int dst_linesize,
     }
 }
 
-void av_image_copy(uint8_t *dst_data[4], int dst_linesizes[4],
-                   const uint8_t *src_data[4], const int src_linesizes[4],
-                   enum PixelFormat pix_fmt, int width, int height)
+static void image_copy_plane_uc_from(uint8_t       *dst, int dst_linesize,
+                                     const uint8_t *src, int src_linesize,
+                                     int bytewidth, int height)
+{
+#if HAVE_IMAGE_COPY_PLANE_UC_SSE4
+    if (dst && src && av_get_cpu_flags() & AV_CPU_FLAG_SSE4) {
+        image_copy_plane_uc_sse4(dst, dst_linesize, src, src_linesize,
+                                 bytewidth, height);
+        return;
+    }
+#endif
+    av_image_copy_plane(dst, dst_linesize, src, src_linesize, bytewidth, height);
+}
+
+static void image_copy(uint8_t *dst_data[4], int dst_linesizes[4],
+                       const uint8_t *src_data[4], const int src_linesizes[4],
+                       enum PixelFormat pix_fmt, int width, int height,
+                       void (*copy_plane)(uint8_t *, int, const uint8_t *, int,
+                                          int, int))
 {
     const AVPixFmtDescriptor *desc = &av_pix_fmt_descriptors[pix_fmt];
 
@@ -251,9 +283,9 @@ void av_image_copy(uint8_t *dst_data[4], int dst_linesizes[4],
         return;
 
     if (desc->flags & PIX_FMT_PAL) {
-        av_image_copy_plane(dst_data[0], dst_linesizes[0],
-                            src_data[0], src_linesizes[0],
-                            width, height);
+        copy_plane(dst_data[0], dst_linesizes[0],
+                   src_data[0], src_linesizes[0],
+                   width, height);
         /* copy the palette */
         memcpy(dst_data[1], src_data[1], 4*256);
     } else {
@@ -268,9 +300,25 @@ void av_image_copy(uint8_t *dst_data[4], int dst_linesizes[4],
             if (i == 1 || i == 2) {
                 h= -((-height)>>desc->log2_chroma_h);
             }
-            av_image_copy_plane(dst_data[i], dst_linesizes[i],
-                                src_data[i], src_linesizes[i],
-                                bwidth, h);
+            copy_plane(dst_data[i], dst_linesizes[i],
+                       src_data[i], src_linesizes[i],
+                       bwidth, h);
         }
     }
 }
+
+void av_image_copy(uint8_t *dst_data[4], int dst_linesizes[4],
+                   const uint8_t *src_data[4], const int src_linesizes[4],
+                   enum PixelFormat pix_fmt, int width, int height)
+{
+    image_copy(dst_data, dst_linesizes, src_data, src_linesizes,
+               pix_fmt, width, height, av_image_copy_plane);
+}
+
+void av_image_copy_uc_from(uint8_t *dst_data[4], int dst_linesizes[4],
+                           const uint8_t *src_data[4], const int src_linesizes[4],
+                           enum PixelFormat pix_fmt, int width, int height)
+{
+    image_copy(dst_data, dst_linesizes, src_data, src_linesizes,
+               pix_fmt, width, height, image_copy_plane_uc_from);
+}
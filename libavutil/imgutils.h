@@ -113,6 +113,17 @@ void av_image_copy(uint8_t *dst_data[4], int dst_linesizes[4],
                    const uint8_t *src_data[4], const int src_linesizes[4],
                    enum PixelFormat pix_fmt, int width, int height);
 
+/**
+ * Copy image in src_data to dst_data, like av_image_copy(), reading src_data
+ * in a way suited to uncacheable or write-combining memory, such as video
+ * surfaces of the GPU mapped for a hardware accelerated decoder.
+ *
+ * This is much slower than av_image_copy() for ordinary memory.
+ */
+void av_image_copy_uc_from(uint8_t *dst_data[4], int dst_linesizes[4],
+                           const uint8_t *src_data[4], const int src_linesizes[4],
+                           enum PixelFormat pix_fmt, int width, int height);
+
 /**
  * Check if the given dimension of an image is valid, meaning that all
  * bytes of the image can be addressed with a signed int.
@@ -39,10 +39,15 @@
 #include "timer.h"
 #include "cpu.h"
 #include "dict.h"
+#include "mem.h"
 
 struct AVDictionary {
     int count;
     AVDictionaryEntry *elems;
+    int allocated;      ///< number of entries allocated in elems
+    int *index;         ///< hash index of elems for exact key lookups, or NULL
+    int index_size;     ///< number of slots in index, a power of 2
+    int index_used;     ///< number of slots in index which are not empty
 };
 
 #ifndef attribute_align_arg
@@ -175,6 +180,21 @@ struct AVDictionary {
     }\
 }
 
+/**
+ * Run the statement(s) with the allocations of the calling thread
+ * accounted to the tag name, see av_mem_set_tag().
+ */
+#if CONFIG_MEMORY_ACCOUNTING
+#define FF_MEM_TAGGED(name, ...)\
+do {\
+    const char *ff_mem_prev_tag = av_mem_set_tag(name);\
+    __VA_ARGS__;\
+    av_mem_set_tag(ff_mem_prev_tag);\
+} while (0)
+#else
+#define FF_MEM_TAGGED(name, ...) do { __VA_ARGS__; } while (0)
+#endif
+
 #include "libm.h"
 
 /**
@@ -26,11 +26,21 @@
 
 #include <unistd.h>
 #include <stdlib.h>
+#include <time.h>
+#include "config.h"
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
 #include "avutil.h"
+#include "error.h"
 #include "log.h"
+#include "ring.h"
+
+#define LINE_SIZE 1024
 
 static int av_log_level = AV_LOG_INFO;
 static int flags;
+static int print_prefix = 1;
 
 #if defined(_WIN32) && !defined(__MINGW32CE__)
 #include <windows.h>
@@ -87,37 +97,36 @@ static void sanitize(uint8_t *line){
     }
 }
 
-void av_log_default_callback(void* ptr, int level, const char* fmt, va_list vl)
+static void format_line(void *ptr, const char *fmt, va_list vl, char *line)
 {
-    static int print_prefix=1;
-    static int count;
-    static char prev[1024];
-    char line[1024];
-    static int is_atty;
     AVClass* avc= ptr ? *(AVClass**)ptr : NULL;
-    if(level>av_log_level)
-        return;
     line[0]=0;
-#undef fprintf
     if(print_prefix && avc) {
         if (avc->parent_log_context_offset) {
             AVClass** parent= *(AVClass***)(((uint8_t*)ptr) + avc->parent_log_context_offset);
             if(parent && *parent){
-                snprintf(line, sizeof(line), "[%s @ %p] ", (*parent)->item_name(parent), parent);
+                snprintf(line, LINE_SIZE, "[%s @ %p] ", (*parent)->item_name(parent), parent);
             }
         }
-        snprintf(line + strlen(line), sizeof(line) - strlen(line), "[%s @ %p] ", avc->item_name(ptr), ptr);
+        snprintf(line + strlen(line), LINE_SIZE - strlen(line), "[%s @ %p] ", avc->item_name(ptr), ptr);
     }
 
-    vsnprintf(line + strlen(line), sizeof(line) - strlen(line), fmt, vl);
+    vsnprintf(line + strlen(line), LINE_SIZE - strlen(line), fmt, vl);
 
     print_prefix = strlen(line) && line[strlen(line)-1] == '\n';
+}
+
+static void print_line(int level, char *line, int ends_line)
+{
+    static int count;
+    static char prev[LINE_SIZE];
+    static int is_atty;
 
 #if HAVE_ISATTY
     if(!is_atty) is_atty= isatty(2) ? 1 : -1;
 #endif
 
-    if(print_prefix && (flags & AV_LOG_SKIP_REPEATED) && !strcmp(line, prev)){
+    if(ends_line && (flags & AV_LOG_SKIP_REPEATED) && !strcmp(line, prev)){
         count++;
         if(is_atty==1)
             fprintf(stderr, "    Last message repeated %d times\r", count);
@@ -132,19 +141,196 @@ void av_log_default_callback(void* ptr, int level, const char* fmt, va_list vl)
     colored_fputs(av_clip(level>>3, 0, 6), line);
 }
 
+#if HAVE_PTHREADS
+/* queued messages are the level and print_prefix after the message as two
+ * ints, followed by the formatted line */
+#define ASYNC_HEADER    (2 * sizeof(int))
+#define ASYNC_RING_SIZE (64 << 10)
+
+static pthread_mutex_t async_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  async_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t async_thread;
+static AVRing *async_ring;          ///< set while messages are queued
+static int async_stop;
+static int async_dropped;
+
+static void *async_print(void *arg)
+{
+    AVRing *ring = arg;
+    char line[LINE_SIZE];
+
+    pthread_mutex_lock(&async_lock);
+    for (;;) {
+        const uint8_t *msg;
+        int size, dropped;
+
+        while (!av_ring_size(ring) && !async_dropped && !async_stop)
+            pthread_cond_wait(&async_cond, &async_lock);
+        if (!av_ring_size(ring) && !async_dropped)
+            break;
+        dropped       = async_dropped;
+        async_dropped = 0;
+        pthread_mutex_unlock(&async_lock);
+
+        /* only this thread reads the ring, it needs no lock */
+        while ((msg = av_ring_read_peek(ring, &size))) {
+            const int *header = (const int *)msg;
+            memcpy(line, msg + ASYNC_HEADER, size - ASYNC_HEADER);
+            print_line(header[0], line, header[1]);
+            av_ring_read_commit(ring, 0);
+        }
+        if (dropped) {
+            snprintf(line, sizeof(line), "%d log messages dropped\n", dropped);
+            print_line(AV_LOG_WARNING, line, 1);
+        }
+
+        pthread_mutex_lock(&async_lock);
+    }
+    pthread_mutex_unlock(&async_lock);
+
+    return NULL;
+}
+
+/**
+ * Queue a message for the printing thread.
+ * @return 0 if messages are not queued
+ */
+static int log_async(int level, void *ptr, const char *fmt, va_list vl)
+{
+    uint8_t *msg;
+    int size, ret = 0;
+
+    pthread_mutex_lock(&async_lock);
+    if (async_ring) {
+        ret = 1;
+        msg = av_ring_write_peek(async_ring, ASYNC_HEADER + LINE_SIZE, &size);
+        if (msg) {
+            int *header = (int *)msg;
+            char *line  = (char *)msg + ASYNC_HEADER;
+            format_line(ptr, fmt, vl, line);
+            header[0] = level;
+            header[1] = print_prefix;
+            av_ring_write_commit(async_ring, ASYNC_HEADER + strlen(line) + 1);
+        } else
+            async_dropped++;
+        pthread_cond_signal(&async_cond);
+    }
+    pthread_mutex_unlock(&async_lock);
+
+    return ret;
+}
+#endif
+
+int av_log_async_start(void)
+{
+#if HAVE_PTHREADS
+    AVRing *ring;
+
+    pthread_mutex_lock(&async_lock);
+    if (async_ring) {
+        pthread_mutex_unlock(&async_lock);
+        return 0;
+    }
+    if (!(ring = av_ring_alloc(ASYNC_RING_SIZE, AV_RING_FLAG_MESSAGES))) {
+        pthread_mutex_unlock(&async_lock);
+        return AVERROR(ENOMEM);
+    }
+    async_stop = 0;
+    if (pthread_create(&async_thread, NULL, async_print, ring)) {
+        pthread_mutex_unlock(&async_lock);
+        av_ring_free(&ring);
+        return AVERROR(EAGAIN);
+    }
+    async_ring = ring;
+    pthread_mutex_unlock(&async_lock);
+    return 0;
+#else
+    return AVERROR(ENOSYS);
+#endif
+}
+
+void av_log_async_stop(void)
+{
+#if HAVE_PTHREADS
+    AVRing *ring;
+
+    pthread_mutex_lock(&async_lock);
+    ring       = async_ring;
+    async_ring = NULL;
+    async_stop = 1;
+    pthread_cond_signal(&async_cond);
+    pthread_mutex_unlock(&async_lock);
+
+    if (!ring)
+        return;
+    /* the thread prints all the queued messages before exiting */
+    pthread_join(async_thread, NULL);
+    av_ring_free(&ring);
+#endif
+}
+
+void av_log_default_callback(void* ptr, int level, const char* fmt, va_list vl)
+{
+    char line[LINE_SIZE];
+
+    if(level>av_log_level)
+        return;
+#if HAVE_PTHREADS
+    if (async_ring && log_async(level, ptr, fmt, vl))
+        return;
+#endif
+    format_line(ptr, fmt, vl, line);
+    print_line(level, line, print_prefix);
+}
+
 static void (*av_log_callback)(void*, int, const char*, va_list) = av_log_default_callback;
 
-void av_log(void* avcl, int level, const char *fmt, ...)
+static int context_level(void *avcl, int level)
 {
     AVClass* avc= avcl ? *(AVClass**)avcl : NULL;
-    va_list vl;
-    va_start(vl, fmt);
     if(avc && avc->version >= (50<<16 | 15<<8 | 2) && avc->log_level_offset_offset && level>=AV_LOG_FATAL)
         level += *(int*)(((uint8_t*)avcl) + avc->log_level_offset_offset);
-    av_vlog(avcl, level, fmt, vl);
+    return level;
+}
+
+void av_log(void* avcl, int level, const char *fmt, ...)
+{
+    va_list vl;
+    va_start(vl, fmt);
+    av_vlog(avcl, context_level(avcl, level), fmt, vl);
     va_end(vl);
 }
 
+int av_log_check_level(void *avcl, int level)
+{
+    return av_log_callback != av_log_default_callback ||
+           context_level(avcl, level) <= av_log_level;
+}
+
+#undef time
+int av_log_ratelimit(AVLogRateLimit *rl, void *avcl, int level)
+{
+    int64_t now;
+
+    if (!av_log_check_level(avcl, level))
+        return 0;
+
+    now = time(NULL);
+    if (now != rl->second) {
+        if (rl->suppressed)
+            av_log(avcl, level, "%d similar messages suppressed\n", rl->suppressed);
+        rl->second     = now;
+        rl->count      = 0;
+        rl->suppressed = 0;
+    }
+    if (rl->count < AV_LOG_RATELIMIT_BURST) {
+        rl->count++;
+        return 1;
+    }
+    rl->suppressed++;
+    return 0;
+}
+
 void av_vlog(void* avcl, int level, const char *fmt, va_list vl)
 {
     av_log_callback(avcl, level, fmt, vl);
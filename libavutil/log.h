@@ -139,6 +139,78 @@ void av_log_set_callback(void (*)(void*, int, const char*, va_list));
 void av_log_default_callback(void* ptr, int level, const char* fmt, va_list vl);
 const char* av_default_item_name(void* ctx);
 
+/**
+ * Check whether a message of the given level would be logged, taking the
+ * log level offset of avcl into account. Always true with a callback other
+ * than av_log_default_callback(), which may not honor the log level.
+ *
+ * Use it to skip computing the arguments of messages in speed critical
+ * code.
+ */
+int av_log_check_level(void *avcl, int level);
+
+/**
+ * Log with av_log() only if av_log_check_level() allows it, without
+ * evaluating the arguments otherwise.
+ */
+#define av_log_checked(avcl, level, ...)                                    \
+    do {                                                                    \
+        if (av_log_check_level(avcl, level))                                \
+            av_log(avcl, level, __VA_ARGS__);                               \
+    } while (0)
+
+/**
+ * State of a log call site limited with av_log_ratelimited().
+ */
+typedef struct AVLogRateLimit {
+    int64_t second;             ///< time in seconds of the current period
+    int count;                  ///< messages logged during the period
+    int suppressed;             ///< messages suppressed during the period
+} AVLogRateLimit;
+
+/**
+ * Maximum number of messages logged per second and call site by
+ * av_log_ratelimited().
+ */
+#define AV_LOG_RATELIMIT_BURST 10
+
+/**
+ * Count a message of a rate limited call site.
+ *
+ * @return nonzero if the message should be logged; the number of messages
+ *         suppressed by the limit is logged first when needed
+ */
+int av_log_ratelimit(AVLogRateLimit *rl, void *avcl, int level);
+
+/**
+ * Log with av_log(), but at most AV_LOG_RATELIMIT_BURST times per second
+ * for this call site, for messages which may repeat for every packet or
+ * block of damaged input. The limit is shared by all the contexts logging
+ * from the call site.
+ */
+#define av_log_ratelimited(avcl, level, ...)                                \
+    do {                                                                    \
+        static AVLogRateLimit av_log_rl;                                    \
+        if (av_log_ratelimit(&av_log_rl, avcl, level))                      \
+            av_log(avcl, level, __VA_ARGS__);                               \
+    } while (0)
+
+/**
+ * Make av_log_default_callback() queue the messages and print them from a
+ * background thread, so that logging never waits for the output. Messages
+ * are dropped, and their number logged, when the queue is full.
+ *
+ * @return 0 on success, a negative AVERROR on failure or if threads are
+ *         not supported
+ */
+int av_log_async_start(void);
+
+/**
+ * Print the queued messages and make av_log_default_callback() print from
+ * the calling thread again.
+ */
+void av_log_async_stop(void);
+
 /**
  * av_dlog macros
  * Useful to print debug messages that shouldn't get compiled in normally.
@@ -21,6 +21,7 @@
 
 #include "avutil.h"
 #include "common.h"
+#include "intreadwrite.h"
 //! Avoid e.g. MPlayers fast_memcpy, it slows things down here.
 #undef memcpy
 #include <string.h>
@@ -97,11 +98,12 @@ static inline void copy(LZOContext *c, int cnt) {
         c->error |= AV_LZO_OUTPUT_FULL;
     }
 #if defined(INBUF_PADDED) && defined(OUTBUF_PADDED)
-    COPY4(dst, src);
-    src += 4;
-    dst += 4;
-    cnt -= 4;
-    if (cnt > 0)
+    /* most literal runs are short, longer ones go to the vectorized memcpy */
+    if (cnt <= 8) {
+        COPY4(dst, src);
+        if (cnt > 4)
+            COPY4(dst + 4, src + 4);
+    } else
 #endif
         memcpy(dst, src, cnt);
     c->in = src + cnt;
@@ -139,6 +141,17 @@ static inline void memcpy_backptr(uint8_t *dst, int back, int cnt) {
         memset(dst, *src, cnt);
     } else {
 #ifdef OUTBUF_PADDED
+        /* short matches without overlap within a word are copied 8 bytes
+         * at a time, which may write up to 7 bytes too many */
+        if (back >= 8 && cnt <= 32) {
+            do {
+                AV_WN64(dst, AV_RN64(src));
+                src += 8;
+                dst += 8;
+                cnt -= 8;
+            } while (cnt > 0);
+            return;
+        }
         COPY2(dst, src);
         COPY2(dst + 2, src + 2);
         src += 4;
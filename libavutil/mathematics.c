@@ -93,13 +93,21 @@ int64_t av_rescale_rnd(int64_t a, int64_t b, int64_t c, enum AVRounding rnd){
             return a/c*b + (a%c*b + r)/c;
     }else{
 #if 1
-        uint64_t a0= a&0xFFFFFFFF;
-        uint64_t a1= a>>32;
-        uint64_t b0= b&0xFFFFFFFF;
-        uint64_t b1= b>>32;
-        uint64_t t1= a0*b1 + a1*b0;
-        uint64_t t1a= t1<<32;
+        uint64_t a0, a1, b0, b1, t1, t1a;
         int i;
+#ifdef __SIZEOF_INT128__
+        /* the quotient fits in 64 bits when the high half of the dividend
+         * is below c, as the loop below requires for an exact result */
+        unsigned __int128 p= (unsigned __int128)(uint64_t)a * b + r;
+        if(a >= 0 && (uint64_t)(p>>64) < c)
+            return p / c;
+#endif
+        a0= a&0xFFFFFFFF;
+        a1= a>>32;
+        b0= b&0xFFFFFFFF;
+        b1= b>>32;
+        t1= a0*b1 + a1*b0;
+        t1a= t1<<32;
 
         a0 = a0*b0 + t1a;
         a1 = a1*b1 + (t1>>32) + (a0<t1a);
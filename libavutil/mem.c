@@ -28,14 +28,22 @@
 
 #include "config.h"
 
+#include <inttypes.h>
 #include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 #if HAVE_MALLOC_H
 #include <malloc.h>
 #endif
+#if CONFIG_MEMORY_ACCOUNTING && HAVE_PTHREADS
+#include <pthread.h>
+#endif
 
+#include "avstring.h"
 #include "avutil.h"
+#include "common.h"
+#include "error.h"
+#include "log.h"
 #include "mem.h"
 
 /* here we can use OS-dependent allocation functions */
@@ -67,7 +75,7 @@ void  free(void *ptr);
 
 #define MAX_MALLOC_SIZE INT_MAX
 
-void *av_malloc(size_t size)
+static void *block_malloc(size_t size)
 {
     void *ptr = NULL;
 #if CONFIG_MEMALIGN_HACK
@@ -119,11 +127,11 @@ void *av_malloc(size_t size)
     ptr = malloc(size);
 #endif
     if(!ptr && !size)
-        ptr= av_malloc(1);
+        ptr= block_malloc(1);
     return ptr;
 }
 
-void *av_realloc(void *ptr, size_t size)
+static void *block_realloc(void *ptr, size_t size)
 {
 #if CONFIG_MEMALIGN_HACK
     int diff;
@@ -135,7 +143,7 @@ void *av_realloc(void *ptr, size_t size)
 
 #if CONFIG_MEMALIGN_HACK
     //FIXME this isn't aligned correctly, though it probably isn't needed
-    if(!ptr) return av_malloc(size);
+    if(!ptr) return block_malloc(size);
     diff= ((char*)ptr)[-1];
     return (char*)realloc((char*)ptr - diff, size + diff) + diff;
 #else
@@ -143,7 +151,7 @@ void *av_realloc(void *ptr, size_t size)
 #endif
 }
 
-void av_free(void *ptr)
+static void block_free(void *ptr)
 {
 #if CONFIG_MEMALIGN_HACK
     if (ptr)
@@ -153,6 +161,236 @@ void av_free(void *ptr)
 #endif
 }
 
+#define MAX_TAGS 64
+
+#if CONFIG_MEMORY_ACCOUNTING
+/* Each block starts with a header of ALIGN bytes holding its size and tag,
+   which keeps the data aligned and lets av_free() find what to account. */
+
+typedef struct BlockHeader {
+    size_t size;
+    int tag;
+} BlockHeader;
+
+typedef struct MemTag {
+    char name[32];
+    const char *key;    ///< last string registered under this name
+    int64_t live, peak, blocks;
+    uint64_t allocs, frees, bytes;
+} MemTag;
+
+/* tags[0] is the total of all tags, tags[1] the untagged allocations */
+static MemTag tags[MAX_TAGS + 2] = { { "total" }, { "untagged" } };
+static int nb_tags = 2;
+
+#if HAVE_PTHREADS
+static pthread_mutex_t mem_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t  key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t   tag_key;
+
+#define LOCK()   pthread_mutex_lock(&mem_lock)
+#define UNLOCK() pthread_mutex_unlock(&mem_lock)
+
+static void key_init(void)
+{
+    pthread_key_create(&tag_key, NULL);
+}
+
+static int get_thread_tag(void)
+{
+    pthread_once(&key_once, key_init);
+    return FFMAX((intptr_t)pthread_getspecific(tag_key), 1);
+}
+
+static void set_thread_tag(int tag)
+{
+    pthread_setspecific(tag_key, (void *)(intptr_t)tag);
+}
+#else
+#define LOCK()
+#define UNLOCK()
+
+static int thread_tag = 1;
+
+static int get_thread_tag(void)
+{
+    return thread_tag;
+}
+
+static void set_thread_tag(int tag)
+{
+    thread_tag = tag;
+}
+#endif
+
+static void account(MemTag *t, int64_t size, int blocks)
+{
+    t->live   += size;
+    t->blocks += blocks;
+    if (size > 0) {
+        t->bytes += size;
+        t->peak   = FFMAX(t->peak, t->live);
+    }
+    if (blocks > 0)
+        t->allocs++;
+    else if (blocks < 0)
+        t->frees++;
+}
+
+static void account_block(int tag, int64_t size, int blocks)
+{
+    LOCK();
+    account(&tags[0],   size, blocks);
+    account(&tags[tag], size, blocks);
+    UNLOCK();
+}
+
+void *av_malloc(size_t size)
+{
+    BlockHeader *h;
+
+    if (size > MAX_MALLOC_SIZE - 32 - ALIGN ||
+        !(h = block_malloc(size + ALIGN)))
+        return NULL;
+    h->size = size;
+    h->tag  = get_thread_tag();
+    account_block(h->tag, size, 1);
+    return (char *)h + ALIGN;
+}
+
+void *av_realloc(void *ptr, size_t size)
+{
+    BlockHeader *h;
+    size_t old_size;
+
+    if (!ptr)
+        return av_malloc(size);
+    if (size > MAX_MALLOC_SIZE - 32 - ALIGN)
+        return NULL;
+    h        = (BlockHeader *)((char *)ptr - ALIGN);
+    old_size = h->size;
+    if (!(h = block_realloc(h, size + ALIGN)))
+        return NULL;
+    h->size = size;
+    /* a reallocation counts as an allocation, but not as a new block */
+    LOCK();
+    account(&tags[0],      (int64_t)size - old_size, 0);
+    account(&tags[h->tag], (int64_t)size - old_size, 0);
+    tags[0].allocs++;
+    tags[h->tag].allocs++;
+    UNLOCK();
+    return (char *)h + ALIGN;
+}
+
+void av_free(void *ptr)
+{
+    BlockHeader *h;
+
+    if (!ptr)
+        return;
+    h = (BlockHeader *)((char *)ptr - ALIGN);
+    account_block(h->tag, -(int64_t)h->size, -1);
+    block_free(h);
+}
+
+const char *av_mem_set_tag(const char *name)
+{
+    int i, tag = 1, prev = get_thread_tag();
+
+    if (name) {
+        LOCK();
+        for (i = 2; i < nb_tags; i++)
+            if (tags[i].key == name || !strcmp(tags[i].name, name))
+                break;
+        if (i < nb_tags || nb_tags < MAX_TAGS + 2) {
+            if (i == nb_tags) {
+                av_strlcpy(tags[i].name, name, sizeof(tags[i].name));
+                nb_tags++;
+            }
+            tags[i].key = name;
+            tag = i;
+        }
+        UNLOCK();
+    }
+    set_thread_tag(tag);
+    return prev > 1 ? tags[prev].key : NULL;
+}
+
+int av_mem_get_stats(AVMemStats *stats, int max_stats)
+{
+    int i, n;
+
+    LOCK();
+    n = nb_tags;
+    for (i = 0; i < FFMIN(n, max_stats); i++) {
+        stats[i].tag    = tags[i].name;
+        stats[i].live   = tags[i].live;
+        stats[i].peak   = tags[i].peak;
+        stats[i].blocks = tags[i].blocks;
+        stats[i].allocs = tags[i].allocs;
+        stats[i].frees  = tags[i].frees;
+        stats[i].bytes  = tags[i].bytes;
+    }
+    UNLOCK();
+    return n;
+}
+
+void av_mem_reset_peak(void)
+{
+    int i;
+
+    LOCK();
+    for (i = 0; i < nb_tags; i++)
+        tags[i].peak = tags[i].live;
+    UNLOCK();
+}
+#else
+void *av_malloc(size_t size)
+{
+    return block_malloc(size);
+}
+
+void *av_realloc(void *ptr, size_t size)
+{
+    return block_realloc(ptr, size);
+}
+
+void av_free(void *ptr)
+{
+    block_free(ptr);
+}
+
+const char *av_mem_set_tag(const char *name)
+{
+    return NULL;
+}
+
+int av_mem_get_stats(AVMemStats *stats, int max_stats)
+{
+    return AVERROR(ENOSYS);
+}
+
+void av_mem_reset_peak(void)
+{
+}
+#endif /* CONFIG_MEMORY_ACCOUNTING */
+
+void av_mem_dump(void *log_ctx, int level)
+{
+    AVMemStats stats[MAX_TAGS + 2];
+    int i, n = av_mem_get_stats(stats, MAX_TAGS + 2);
+
+    for (i = 0; i < n; i++) {
+        const AVMemStats *s = &stats[i];
+        if (!s->allocs)
+            continue;
+        av_log(log_ctx, level,
+               "mem: %-24s %12"PRId64" live %12"PRId64" peak %10"PRId64" blocks "
+               "%10"PRIu64" allocs %10"PRIu64" frees %14"PRIu64" bytes\n",
+               s->tag, s->live, s->peak, s->blocks, s->allocs, s->frees, s->bytes);
+    }
+}
+
 void av_freep(void *arg)
 {
     void **ptr= (void**)arg;
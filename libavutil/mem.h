@@ -26,6 +26,8 @@
 #ifndef AVUTIL_MEM_H
 #define AVUTIL_MEM_H
 
+#include <stdint.h>
+
 #include "attributes.h"
 #include "avutil.h"
 
@@ -132,4 +134,56 @@ void av_freep(void *ptr);
  */
 void av_dynarray_add(void *tab_ptr, int *nb_ptr, void *elem);
 
+/**
+ * Statistics of the blocks allocated under one tag, see av_mem_set_tag().
+ * They are only collected when FFmpeg is configured with
+ * --enable-memory-accounting. The allocation rates can be derived from
+ * the difference of allocs and bytes between two calls to
+ * av_mem_get_stats().
+ */
+typedef struct AVMemStats {
+    const char *tag;
+    int64_t  live;      ///< size of the blocks currently allocated, in bytes
+    int64_t  peak;      ///< highest value of live since the last reset
+    int64_t  blocks;    ///< number of blocks currently allocated
+    uint64_t allocs;    ///< number of allocations and reallocations
+    uint64_t frees;     ///< number of blocks freed
+    uint64_t bytes;     ///< bytes allocated, including the growth of reallocated blocks
+} AVMemStats;
+
+/**
+ * Account the blocks allocated by the calling thread from now on to a tag.
+ * Blocks stay accounted to the tag they were allocated under when they are
+ * reallocated or freed. The libraries tag the allocations of the codecs and
+ * demuxers with their names.
+ *
+ * @param name name of the tag, NULL for untagged allocations
+ * @return the previous tag of the thread, to be restored by passing it
+ *         to av_mem_set_tag() again; always NULL without memory accounting
+ */
+const char *av_mem_set_tag(const char *name);
+
+/**
+ * Get the allocation statistics.
+ *
+ * @param stats      array filled with the statistics; the first element is
+ *                   the total over all tags, followed by the untagged
+ *                   allocations and the tags in the order they were first
+ *                   set
+ * @param max_stats  number of elements of stats
+ * @return the number of statistics available, which may be more than
+ *         max_stats, AVERROR(ENOSYS) without memory accounting
+ */
+int av_mem_get_stats(AVMemStats *stats, int max_stats);
+
+/**
+ * Set the peak of each tag to its current live size.
+ */
+void av_mem_reset_peak(void);
+
+/**
+ * Print the allocation statistics with av_log().
+ */
+void av_mem_dump(void *log_ctx, int level);
+
 #endif /* AVUTIL_MEM_H */
@@ -0,0 +1,228 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * named counters of the time spent in parts of the code
+ */
+
+#include <inttypes.h>
+#include <string.h>
+
+#include "config.h"
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
+#include "avstring.h"
+#include "common.h"
+#include "log.h"
+#include "mem.h"
+#include "profile.h"
+
+#define MAX_COUNTERS 256
+
+struct AVProfileCounter {
+    char name[64];
+    int index;
+};
+
+typedef struct ProfileSlot {
+    uint64_t count, total, min, max;
+} ProfileSlot;
+
+/**
+ * Copy of the counters of one thread.
+ */
+typedef struct ProfileThread {
+    ProfileSlot slots[MAX_COUNTERS];
+    struct ProfileThread *next;
+} ProfileThread;
+
+int ff_profile_enabled;
+
+static AVProfileCounter counters[MAX_COUNTERS];
+static int nb_counters;
+
+/* the counters of the threads which have exited */
+static ProfileThread retired;
+
+#if HAVE_PTHREADS
+static pthread_mutex_t profile_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t  key_once     = PTHREAD_ONCE_INIT;
+static pthread_key_t   thread_key;
+static ProfileThread  *threads;
+
+#define LOCK()   pthread_mutex_lock(&profile_lock)
+#define UNLOCK() pthread_mutex_unlock(&profile_lock)
+
+static void add_slots(ProfileSlot *dst, const ProfileSlot *src, int n)
+{
+    int i;
+    for (i = 0; i < n; i++) {
+        if (!src[i].count)
+            continue;
+        if (!dst[i].count || src[i].min < dst[i].min)
+            dst[i].min = src[i].min;
+        dst[i].max    = FFMAX(dst[i].max, src[i].max);
+        dst[i].count += src[i].count;
+        dst[i].total += src[i].total;
+    }
+}
+
+static void thread_exit(void *arg)
+{
+    ProfileThread *t = arg, **p;
+
+    LOCK();
+    for (p = &threads; *p != t; p = &(*p)->next);
+    *p = t->next;
+    add_slots(retired.slots, t->slots, MAX_COUNTERS);
+    UNLOCK();
+    av_free(t);
+}
+
+static void key_init(void)
+{
+    pthread_key_create(&thread_key, thread_exit);
+}
+
+static ProfileThread *get_thread(void)
+{
+    ProfileThread *t;
+
+    pthread_once(&key_once, key_init);
+    if ((t = pthread_getspecific(thread_key)))
+        return t;
+    if (!(t = av_mallocz(sizeof(*t))))
+        return NULL;
+    LOCK();
+    t->next = threads;
+    threads = t;
+    UNLOCK();
+    pthread_setspecific(thread_key, t);
+    return t;
+}
+#else
+#define LOCK()
+#define UNLOCK()
+
+static ProfileThread *get_thread(void)
+{
+    return &retired;
+}
+#endif
+
+void av_profile_enable(int enable)
+{
+    ff_profile_enabled = enable;
+}
+
+AVProfileCounter *av_profile_counter_register(const char *name)
+{
+    AVProfileCounter *c = NULL;
+    int i;
+
+    LOCK();
+    for (i = 0; i < nb_counters; i++) {
+        if (!strcmp(counters[i].name, name)) {
+            c = &counters[i];
+            break;
+        }
+    }
+    if (!c && nb_counters < MAX_COUNTERS) {
+        c = &counters[nb_counters];
+        av_strlcpy(c->name, name, sizeof(c->name));
+        c->index = nb_counters++;
+    }
+    UNLOCK();
+    return c;
+}
+
+void av_profile_counter_add(AVProfileCounter *counter, uint64_t time)
+{
+    ProfileThread *t;
+    ProfileSlot *s;
+
+    if (!counter || !(t = get_thread()))
+        return;
+    s = &t->slots[counter->index];
+    if (!s->count || time < s->min)
+        s->min = time;
+    if (time > s->max)
+        s->max = time;
+    s->count++;
+    s->total += time;
+}
+
+int av_profile_get_stats(AVProfileStats *stats, int max_stats)
+{
+    ProfileSlot sum[MAX_COUNTERS];
+    int i, n;
+
+    LOCK();
+    n = nb_counters;
+    memcpy(sum, retired.slots, n * sizeof(*sum));
+#if HAVE_PTHREADS
+    {
+        ProfileThread *t;
+        for (t = threads; t; t = t->next)
+            add_slots(sum, t->slots, n);
+    }
+#endif
+    UNLOCK();
+
+    for (i = 0; i < FFMIN(n, max_stats); i++) {
+        stats[i].name  = counters[i].name;
+        stats[i].count = sum[i].count;
+        stats[i].total = sum[i].total;
+        stats[i].min   = sum[i].min;
+        stats[i].max   = sum[i].max;
+    }
+    return n;
+}
+
+void av_profile_reset(void)
+{
+    LOCK();
+    memset(retired.slots, 0, sizeof(retired.slots));
+#if HAVE_PTHREADS
+    {
+        ProfileThread *t;
+        for (t = threads; t; t = t->next)
+            memset(t->slots, 0, sizeof(t->slots));
+    }
+#endif
+    UNLOCK();
+}
+
+void av_profile_dump(void *log_ctx, int level)
+{
+    AVProfileStats stats[MAX_COUNTERS];
+    int i, n = av_profile_get_stats(stats, MAX_COUNTERS);
+
+    for (i = 0; i < n; i++) {
+        const AVProfileStats *s = &stats[i];
+        if (!s->count)
+            continue;
+        av_log(log_ctx, level,
+               "profile: %-24s %10"PRIu64" runs %14"PRIu64" total %10"PRIu64" avg "
+               "%10"PRIu64" min %10"PRIu64" max\n",
+               s->name, s->count, s->total, s->total / s->count, s->min, s->max);
+    }
+}
@@ -0,0 +1,90 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVUTIL_PROFILE_H
+#define AVUTIL_PROFILE_H
+
+/**
+ * @file
+ * named counters of the time spent in parts of the code
+ *
+ * The libraries time some of their hot paths (slice decoding, scaling,
+ * filtering, demuxing) into named counters while profiling is enabled with
+ * av_profile_enable(). Each thread accumulates into its own copy of the
+ * counters, which av_profile_get_stats() sums up.
+ *
+ * The times are in units of the CPU timestamp counter where one is
+ * available (cycles on x86); there are no counters on other platforms.
+ */
+
+#include <stdint.h>
+
+typedef struct AVProfileCounter AVProfileCounter;
+
+typedef struct AVProfileStats {
+    const char *name;
+    uint64_t count;     ///< number of timed runs
+    uint64_t total;     ///< sum of the times of the runs
+    uint64_t min;       ///< time of the shortest run
+    uint64_t max;       ///< time of the longest run
+} AVProfileStats;
+
+/**
+ * Enable or disable the timing of the instrumented code.
+ * Profiling is disabled by default, which costs only a test per timed
+ * section.
+ */
+void av_profile_enable(int enable);
+
+/**
+ * Register a counter, or return the existing one with the same name.
+ *
+ * @param name name of the counter, copied
+ * @return the counter, NULL if there is no space left for a new one
+ */
+AVProfileCounter *av_profile_counter_register(const char *name);
+
+/**
+ * Add a timed run to a counter, in the copy of the calling thread.
+ */
+void av_profile_counter_add(AVProfileCounter *counter, uint64_t time);
+
+/**
+ * Get the statistics of the registered counters, summed over all threads.
+ * Counters which have not been run are included with a count of 0.
+ *
+ * @param stats      array filled with the statistics of the counters,
+ *                   in the order they were registered
+ * @param max_stats  number of elements of stats
+ * @return the number of registered counters, which may be more than
+ *         max_stats
+ */
+int av_profile_get_stats(AVProfileStats *stats, int max_stats);
+
+/**
+ * Set all the counters back to 0.
+ * The timed code should not be running while the counters are reset.
+ */
+void av_profile_reset(void);
+
+/**
+ * Print the statistics of the counters which have been run with av_log().
+ */
+void av_profile_dump(void *log_ctx, int level);
+
+#endif /* AVUTIL_PROFILE_H */
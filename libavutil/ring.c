@@ -0,0 +1,250 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "config.h"
+#if !HAVE_SYNC_VAL_COMPARE_AND_SWAP && HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
+#include "common.h"
+#include "error.h"
+#include "mem.h"
+#include "ring.h"
+
+/* messages are stored as a header with their size followed by the data,
+ * padded to MSG_ALIGN; a header of MSG_WRAP means the next message starts
+ * at the beginning of the ring */
+#define MSG_ALIGN  8
+#define MSG_HEADER MSG_ALIGN
+#define MSG_WRAP   UINT32_MAX
+
+/* head and tail count the bytes written and read since the allocation and
+ * wrap around with unsigned arithmetic, the ring is empty when they are
+ * equal; only the producer writes head and only the consumer writes tail */
+struct AVRing {
+    uint8_t *buffer;
+    unsigned int size;
+    unsigned int mask;
+    int flags;
+
+    /* producer side */
+    volatile unsigned int head;
+    unsigned int write_skip;    ///< bytes left unused at the end by the last write peek
+    uint8_t pad[64];            ///< keep the two sides on separate cache lines
+
+    /* consumer side */
+    volatile unsigned int tail;
+    unsigned int read_size;     ///< size of the message returned by the last read peek
+};
+
+#if HAVE_SYNC_VAL_COMPARE_AND_SWAP
+#define memory_barrier() __sync_synchronize()
+#elif HAVE_PTHREADS
+static pthread_mutex_t barrier_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* locking a mutex orders the memory accesses on both sides of it */
+static void memory_barrier(void)
+{
+    pthread_mutex_lock(&barrier_lock);
+    pthread_mutex_unlock(&barrier_lock);
+}
+#else
+#define memory_barrier()
+#endif
+
+AVRing *av_ring_alloc(unsigned int size, int flags)
+{
+    AVRing *ring;
+
+    if (size > INT_MAX / 2)
+        return NULL;
+    size = FFMAX(size, 2 * MSG_ALIGN);
+    while (size & (size - 1))
+        size += size & -size;
+
+    if (!(ring = av_mallocz(sizeof(*ring))))
+        return NULL;
+    if (!(ring->buffer = av_malloc(size))) {
+        av_free(ring);
+        return NULL;
+    }
+    ring->size  = size;
+    ring->mask  = size - 1;
+    ring->flags = flags;
+    return ring;
+}
+
+void av_ring_free(AVRing **ring)
+{
+    if (!*ring)
+        return;
+    av_free((*ring)->buffer);
+    av_freep(ring);
+}
+
+int av_ring_size(const AVRing *ring)
+{
+    return ring->head - ring->tail;
+}
+
+int av_ring_space(const AVRing *ring)
+{
+    return ring->size - (ring->head - ring->tail);
+}
+
+uint8_t *av_ring_write_peek(AVRing *ring, int min_size, int *size)
+{
+    unsigned int head  = ring->head;
+    unsigned int pos   = head & ring->mask;
+    unsigned int free  = ring->size - (head - ring->tail);
+    unsigned int to_end = ring->size - pos;
+
+    /* the consumer must be done with the space before it is reused */
+    memory_barrier();
+
+    if (!(ring->flags & AV_RING_FLAG_MESSAGES)) {
+        unsigned int avail = FFMIN(free, to_end);
+        if (min_size < 0 || avail < (unsigned int)min_size)
+            return NULL;
+        *size = avail;
+        return ring->buffer + pos;
+    } else {
+        unsigned int need = MSG_HEADER + FFALIGN(FFMAX(min_size, 0), MSG_ALIGN);
+
+        if (min_size < 0 || min_size > ring->size - MSG_HEADER)
+            return NULL;
+        if (to_end >= need && free >= need) {
+            ring->write_skip = 0;
+            *size = FFMIN(free, to_end) - MSG_HEADER;
+            return ring->buffer + pos + MSG_HEADER;
+        }
+        if (to_end < need && free >= to_end + need) {
+            /* not published until the commit */
+            *(uint32_t *)(ring->buffer + pos) = MSG_WRAP;
+            ring->write_skip = to_end;
+            *size = free - to_end - MSG_HEADER;
+            return ring->buffer + MSG_HEADER;
+        }
+        return NULL;
+    }
+}
+
+void av_ring_write_commit(AVRing *ring, int size)
+{
+    unsigned int head = ring->head;
+
+    if (ring->flags & AV_RING_FLAG_MESSAGES) {
+        head += ring->write_skip;
+        *(uint32_t *)(ring->buffer + (head & ring->mask)) = size;
+        size = MSG_HEADER + FFALIGN(size, MSG_ALIGN);
+        ring->write_skip = 0;
+    }
+
+    /* publish the data after it has been written */
+    memory_barrier();
+    ring->head = head + size;
+}
+
+int av_ring_write(AVRing *ring, const uint8_t *src, int size)
+{
+    uint8_t *dst;
+    int avail, len, written = 0;
+
+    if (ring->flags & AV_RING_FLAG_MESSAGES) {
+        if (!(dst = av_ring_write_peek(ring, size, &avail)))
+            return size > ring->size - MSG_HEADER ? AVERROR(EINVAL) : AVERROR(EAGAIN);
+        memcpy(dst, src, size);
+        av_ring_write_commit(ring, size);
+        return size;
+    }
+
+    /* at most two regions, before and after the end of the buffer */
+    while (written < size && (dst = av_ring_write_peek(ring, 1, &avail))) {
+        len = FFMIN(avail, size - written);
+        memcpy(dst, src + written, len);
+        av_ring_write_commit(ring, len);
+        written += len;
+    }
+    return written;
+}
+
+const uint8_t *av_ring_read_peek(AVRing *ring, int *size)
+{
+    unsigned int tail = ring->tail;
+    unsigned int head = ring->head;
+    unsigned int pos  = tail & ring->mask;
+    uint32_t len;
+
+    if (head == tail)
+        return NULL;
+    /* read the data only after seeing it published */
+    memory_barrier();
+
+    if (!(ring->flags & AV_RING_FLAG_MESSAGES)) {
+        *size = FFMIN(head - tail, ring->size - pos);
+        return ring->buffer + pos;
+    }
+
+    len = *(uint32_t *)(ring->buffer + pos);
+    if (len == MSG_WRAP) {
+        /* the space at the end is released with the message */
+        ring->read_size = ring->size - pos;
+        len = *(uint32_t *)ring->buffer;
+        ring->read_size += MSG_HEADER + FFALIGN(len, MSG_ALIGN);
+        *size = len;
+        return ring->buffer + MSG_HEADER;
+    }
+    ring->read_size = MSG_HEADER + FFALIGN(len, MSG_ALIGN);
+    *size = len;
+    return ring->buffer + pos + MSG_HEADER;
+}
+
+void av_ring_read_commit(AVRing *ring, int size)
+{
+    if (ring->flags & AV_RING_FLAG_MESSAGES)
+        size = ring->read_size;
+
+    /* release the space after it has been read */
+    memory_barrier();
+    ring->tail += size;
+}
+
+int av_ring_read(AVRing *ring, uint8_t *dst, int size)
+{
+    const uint8_t *src;
+    int avail, len, read = 0;
+
+    if (ring->flags & AV_RING_FLAG_MESSAGES) {
+        if (!(src = av_ring_read_peek(ring, &avail)))
+            return 0;
+        len = FFMIN(avail, size);
+        memcpy(dst, src, len);
+        av_ring_read_commit(ring, 0);
+        return len;
+    }
+
+    while (read < size && (src = av_ring_read_peek(ring, &avail))) {
+        len = FFMIN(avail, size - read);
+        memcpy(dst + read, src, len);
+        av_ring_read_commit(ring, len);
+        read += len;
+    }
+    return read;
+}
@@ -0,0 +1,129 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * lock-free single producer, single consumer ring buffer
+ *
+ * Unlike AVFifoBuffer, an AVRing may be written by one thread while
+ * another thread reads it, without any locking. Only one thread may write
+ * and only one thread may read at a time. The ring never blocks: the
+ * threads wait for data or space by their own means, a condition variable
+ * for instance.
+ *
+ * Data is written and read in place: the producer gets a contiguous
+ * region with av_ring_write_peek(), fills it and publishes it with
+ * av_ring_write_commit(); the consumer does the same with
+ * av_ring_read_peek() and av_ring_read_commit().
+ *
+ * In message mode, the ring keeps the boundaries of what was written:
+ * every commit of the producer is one message, and every peek of the
+ * consumer returns one whole message.
+ */
+
+#ifndef AVUTIL_RING_H
+#define AVUTIL_RING_H
+
+#include <stdint.h>
+
+typedef struct AVRing AVRing;
+
+/**
+ * Keep the boundaries of the committed writes, see av_ring_alloc().
+ */
+#define AV_RING_FLAG_MESSAGES (1 << 0)
+
+/**
+ * Allocate a ring.
+ *
+ * @param size  size of the ring in bytes, rounded up to a power of 2
+ * @param flags a combination of AV_RING_FLAG_*
+ * @return the new ring or NULL on failure
+ */
+AVRing *av_ring_alloc(unsigned int size, int flags);
+
+/**
+ * Free a ring and set *ring to NULL.
+ */
+void av_ring_free(AVRing **ring);
+
+/**
+ * Return the number of bytes which may be read. In message mode, this
+ * includes the framing of the messages.
+ */
+int av_ring_size(const AVRing *ring);
+
+/**
+ * Return the number of bytes which may be written. In message mode, this
+ * includes the framing of the messages.
+ */
+int av_ring_space(const AVRing *ring);
+
+/**
+ * Get a contiguous region of the ring to write into. Only the producer
+ * may call this.
+ *
+ * @param min_size the smallest region the caller can use
+ * @param size     set to the size of the region, at least min_size
+ * @return the region, or NULL if there is not enough contiguous space yet
+ */
+uint8_t *av_ring_write_peek(AVRing *ring, int min_size, int *size);
+
+/**
+ * Make the first size bytes of the region returned by the last
+ * av_ring_write_peek() available to the consumer. In message mode, they
+ * form one message.
+ */
+void av_ring_write_commit(AVRing *ring, int size);
+
+/**
+ * Copy data into the ring.
+ *
+ * @return the number of bytes written, which may be less than size in
+ *         byte mode; in message mode, size or AVERROR(EAGAIN) if the
+ *         message does not fit yet
+ */
+int av_ring_write(AVRing *ring, const uint8_t *src, int size);
+
+/**
+ * Get a contiguous region of the ring to read from. Only the consumer may
+ * call this.
+ *
+ * @param size set to the size of the region, or of the message in message
+ *             mode
+ * @return the region, or NULL if the ring is empty
+ */
+const uint8_t *av_ring_read_peek(AVRing *ring, int *size);
+
+/**
+ * Release the first size bytes of the region returned by the last
+ * av_ring_read_peek(). In message mode, the whole message is released and
+ * size is ignored.
+ */
+void av_ring_read_commit(AVRing *ring, int size);
+
+/**
+ * Copy data out of the ring.
+ *
+ * @return the number of bytes read, 0 if the ring is empty; in message
+ *         mode one message is read and the part which does not fit in
+ *         size bytes is dropped
+ */
+int av_ring_read(AVRing *ring, uint8_t *dst, int size);
+
+#endif /* AVUTIL_RING_H */
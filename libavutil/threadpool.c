@@ -0,0 +1,346 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
+#include "common.h"
+#include "cpu.h"
+#include "error.h"
+#include "mem.h"
+#include "threadpool.h"
+
+/**
+ * The jobs of an av_thread_pool_execute() call, or a submitted task.
+ */
+typedef struct ThreadBatch {
+    int (*func)(void *arg, int jobnr, int threadnr);
+    int (*task)(void *arg);
+    void *arg;
+    int *rets;
+    int job_count;
+    int max_slots;              ///< Maximum number of threads running the batch.
+
+    int next_job;               ///< The next job to hand out.
+    int nb_slots;               ///< Number of threads which joined, used as threadnr.
+    int running;                ///< Number of threads still running jobs of the batch.
+    int queued;                 ///< Set while other threads may join the batch.
+    AVTaskGroup *group;         ///< Group of a task, which is freed once run.
+    struct ThreadBatch *next;
+} ThreadBatch;
+
+struct AVThreadPool {
+#if HAVE_PTHREADS
+    pthread_t *workers;
+    pthread_mutex_t lock;       ///< Protects all fields of the pool, its batches and groups.
+    pthread_cond_t work_cond;   ///< Used by workers to wait for new batches.
+    pthread_cond_t done_cond;   ///< Used to wait for batches to finish.
+#endif
+    int nb_threads;
+    int refcount;
+    int die;
+
+    ThreadBatch *batches;       ///< Batches which still accept threads.
+    ThreadBatch *last_batch;
+};
+
+struct AVTaskGroup {
+    AVThreadPool *pool;
+    int pending;                ///< Number of tasks not finished.
+    int error;
+};
+
+/* Workers are only implemented with pthreads. Otherwise, including with
+ * w32threads, the pool has no workers: the waiting threads run everything
+ * serially and never wait. */
+#if HAVE_PTHREADS
+#define POOL_LOCK(pool)            pthread_mutex_lock(&(pool)->lock)
+#define POOL_UNLOCK(pool)          pthread_mutex_unlock(&(pool)->lock)
+#define POOL_WAIT(pool, cond)      pthread_cond_wait(&(pool)->cond, &(pool)->lock)
+#define POOL_BROADCAST(pool, cond) pthread_cond_broadcast(&(pool)->cond)
+#else
+#define POOL_LOCK(pool)
+#define POOL_UNLOCK(pool)
+#define POOL_WAIT(pool, cond)
+#define POOL_BROADCAST(pool, cond)
+#endif
+
+/// Called with the pool lock held, as are all the functions below.
+static void queue_batch(AVThreadPool *pool, ThreadBatch *b)
+{
+    b->next = NULL;
+    if (pool->batches)
+        pool->last_batch->next = b;
+    else
+        pool->batches = b;
+    pool->last_batch = b;
+    b->queued = 1;
+    POOL_BROADCAST(pool, work_cond);
+}
+
+/// Stops other threads from joining the batch.
+static void unqueue_batch(AVThreadPool *pool, ThreadBatch *b)
+{
+    ThreadBatch **p = &pool->batches, *prev = NULL;
+
+    if (!b->queued)
+        return;
+    while (*p != b) {
+        prev = *p;
+        p    = &prev->next;
+    }
+    *p = b->next;
+    if (pool->last_batch == b)
+        pool->last_batch = prev;
+    b->queued = 0;
+}
+
+/// @return the threadnr of the joining thread
+static int join_batch(AVThreadPool *pool, ThreadBatch *b)
+{
+    int slot = b->nb_slots++;
+
+    b->running++;
+    if (b->nb_slots >= b->max_slots)
+        unqueue_batch(pool, b);
+    return slot;
+}
+
+/// Runs jobs of a batch until none are left.
+static void run_batch(AVThreadPool *pool, ThreadBatch *b, int slot)
+{
+    while (b->next_job < b->job_count) {
+        int job = b->next_job++;
+        int ret;
+
+        if (b->next_job == b->job_count)
+            unqueue_batch(pool, b);
+        POOL_UNLOCK(pool);
+
+        ret = b->task ? b->task(b->arg) : b->func(b->arg, job, slot);
+
+        POOL_LOCK(pool);
+        if (b->rets)
+            b->rets[job] = ret;
+        if (b->group && ret < 0 && !b->group->error)
+            b->group->error = ret;
+    }
+
+    if (!--b->running) {
+        if (b->group) {
+            b->group->pending--;
+            av_free(b);
+        }
+        POOL_BROADCAST(pool, done_cond);
+    }
+}
+
+#if HAVE_PTHREADS
+static void * attribute_align_arg worker(void *v)
+{
+    AVThreadPool *pool = v;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        ThreadBatch *b;
+
+        while (!pool->batches && !pool->die)
+            pthread_cond_wait(&pool->work_cond, &pool->lock);
+        if (pool->die)
+            break;
+
+        b = pool->batches;
+        run_batch(pool, b, join_batch(pool, b));
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+#endif
+
+AVThreadPool *av_thread_pool_alloc(int nb_threads)
+{
+    AVThreadPool *pool;
+
+    if (nb_threads < 0)
+        return NULL;
+    if (!nb_threads)
+        nb_threads = av_cpu_count();
+
+    pool = av_mallocz(sizeof(*pool));
+    if (!pool)
+        return NULL;
+    pool->refcount = 1;
+
+#if HAVE_PTHREADS
+    pool->workers = av_mallocz(nb_threads * sizeof(*pool->workers));
+    if (!pool->workers) {
+        av_free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+
+    for (; pool->nb_threads < nb_threads; pool->nb_threads++)
+        if (pthread_create(&pool->workers[pool->nb_threads], NULL, worker, pool))
+            break;
+#endif
+
+    return pool;
+}
+
+AVThreadPool *av_thread_pool_ref(AVThreadPool *pool)
+{
+    POOL_LOCK(pool);
+    pool->refcount++;
+    POOL_UNLOCK(pool);
+    return pool;
+}
+
+void av_thread_pool_unref(AVThreadPool **ppool)
+{
+    AVThreadPool *pool = *ppool;
+    int last;
+
+    if (!pool)
+        return;
+    *ppool = NULL;
+
+    POOL_LOCK(pool);
+    last = !--pool->refcount;
+    if (last) {
+        pool->die = 1;
+        POOL_BROADCAST(pool, work_cond);
+    }
+    POOL_UNLOCK(pool);
+
+    if (!last)
+        return;
+
+#if HAVE_PTHREADS
+    {
+        int i;
+        for (i = 0; i < pool->nb_threads; i++)
+            pthread_join(pool->workers[i], NULL);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work_cond);
+    pthread_cond_destroy(&pool->done_cond);
+    av_free(pool->workers);
+#endif
+    av_free(pool);
+}
+
+int av_thread_pool_nb_threads(const AVThreadPool *pool)
+{
+    return pool->nb_threads;
+}
+
+int av_thread_pool_execute(AVThreadPool *pool,
+                           int (*func)(void *arg, int jobnr, int threadnr),
+                           void *arg, int *ret, int nb_jobs, int max_threads)
+{
+    ThreadBatch b = { 0 };
+
+    if (nb_jobs <= 0)
+        return 0;
+
+    b.func      = func;
+    b.arg       = arg;
+    b.rets      = ret;
+    b.job_count = nb_jobs;
+    b.max_slots = max_threads > 0 ? max_threads : INT_MAX;
+    b.nb_slots  = 1;
+    b.running   = 1;
+
+    POOL_LOCK(pool);
+    if (nb_jobs > 1 && b.max_slots > 1)
+        queue_batch(pool, &b);
+
+    run_batch(pool, &b, 0);
+
+    while (b.running)
+        POOL_WAIT(pool, done_cond);
+    POOL_UNLOCK(pool);
+
+    return 0;
+}
+
+AVTaskGroup *av_task_group_alloc(AVThreadPool *pool)
+{
+    AVTaskGroup *group = av_mallocz(sizeof(*group));
+
+    if (group)
+        group->pool = pool;
+    return group;
+}
+
+void av_task_group_free(AVTaskGroup **group)
+{
+    if (!*group)
+        return;
+    av_task_group_wait(*group);
+    av_freep(group);
+}
+
+int av_task_group_submit(AVTaskGroup *group, int (*func)(void *arg), void *arg)
+{
+    AVThreadPool *pool = group->pool;
+    ThreadBatch *b = av_mallocz(sizeof(*b));
+
+    if (!b)
+        return AVERROR(ENOMEM);
+    b->task      = func;
+    b->arg       = arg;
+    b->job_count = 1;
+    b->max_slots = 1;
+    b->group     = group;
+
+    POOL_LOCK(pool);
+    group->pending++;
+    queue_batch(pool, b);
+    POOL_UNLOCK(pool);
+
+    return 0;
+}
+
+int av_task_group_wait(AVTaskGroup *group)
+{
+    AVThreadPool *pool = group->pool;
+    int ret;
+
+    POOL_LOCK(pool);
+    while (group->pending) {
+        ThreadBatch *b = pool->batches;
+
+        while (b && b->group != group)
+            b = b->next;
+        if (b)
+            run_batch(pool, b, join_batch(pool, b));
+        else
+            POOL_WAIT(pool, done_cond);
+    }
+    ret = group->error;
+    group->error = 0;
+    POOL_UNLOCK(pool);
+
+    return ret;
+}
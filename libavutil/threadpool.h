@@ -0,0 +1,115 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * pool of worker threads shared between libraries
+ *
+ * An AVThreadPool runs two kinds of work:
+ * - parallel loops, with av_thread_pool_execute(), which returns once
+ *   all the iterations have run;
+ * - independent tasks, submitted to an AVTaskGroup and waited for with
+ *   av_task_group_wait().
+ *
+ * Threads waiting for their work run it too, so work always progresses
+ * even when all the workers are busy elsewhere, or when the pool has no
+ * worker at all because threads are not supported.
+ */
+
+#ifndef AVUTIL_THREADPOOL_H
+#define AVUTIL_THREADPOOL_H
+
+typedef struct AVThreadPool AVThreadPool;
+typedef struct AVTaskGroup AVTaskGroup;
+
+/**
+ * Allocate a thread pool and start its workers.
+ * Workers are only started with pthreads; with w32threads or without
+ * thread support, the pool has none and all the work runs serially on
+ * the threads waiting for it.
+ *
+ * @param nb_threads maximum number of worker threads, 0 for one per CPU
+ * @return the pool with one reference owned by the caller, or NULL on
+ *         failure
+ */
+AVThreadPool *av_thread_pool_alloc(int nb_threads);
+
+/**
+ * Add a reference to a pool.
+ *
+ * @return pool
+ */
+AVThreadPool *av_thread_pool_ref(AVThreadPool *pool);
+
+/**
+ * Release a reference to a pool and set *pool to NULL. The workers are
+ * stopped when the last reference is released, all the task groups of
+ * the pool must have been freed by then.
+ */
+void av_thread_pool_unref(AVThreadPool **pool);
+
+/**
+ * Return the number of worker threads of a pool, which may be 0.
+ */
+int av_thread_pool_nb_threads(const AVThreadPool *pool);
+
+/**
+ * Run func for every job number from 0 to nb_jobs - 1 and wait for all
+ * of them to return. The calling thread runs jobs as well.
+ *
+ * @param func        the job; threadnr is in the range [0, max_threads)
+ *                    and identifies the thread running the job among those
+ *                    running this call, 0 being the calling thread
+ * @param ret         array of nb_jobs return values of func, may be NULL
+ * @param max_threads maximum number of threads running the jobs, including
+ *                    the calling thread; 0 for no limit
+ * @return 0
+ */
+int av_thread_pool_execute(AVThreadPool *pool,
+                           int (*func)(void *arg, int jobnr, int threadnr),
+                           void *arg, int *ret, int nb_jobs, int max_threads);
+
+/**
+ * Allocate a group of tasks to run on a pool.
+ *
+ * @return the group or NULL on failure
+ */
+AVTaskGroup *av_task_group_alloc(AVThreadPool *pool);
+
+/**
+ * Wait for the tasks of a group, then free it and set *group to NULL.
+ */
+void av_task_group_free(AVTaskGroup **group);
+
+/**
+ * Queue a task on the pool of a group. It may start running at once.
+ *
+ * @return 0 on success, a negative AVERROR on failure
+ */
+int av_task_group_submit(AVTaskGroup *group, int (*func)(void *arg), void *arg);
+
+/**
+ * Wait for all the tasks submitted to a group. The calling thread runs the
+ * tasks which have not started yet.
+ *
+ * @return the first negative value returned by a task since the previous
+ *         call, or 0
+ */
+int av_task_group_wait(AVTaskGroup *group);
+
+#endif /* AVUTIL_THREADPOOL_H */
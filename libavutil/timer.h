@@ -27,6 +27,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include "config.h"
+#include "profile.h"
 
 #if   ARCH_ARM
 #   include "arm/timer.h"
@@ -63,9 +64,30 @@ tend= AV_READ_TIME();\
                tsum*10/tcount, id, tcount, tskip_count);\
     }\
 }
+
+extern int ff_profile_enabled;
+
+/**
+ * Time the code between AV_PROFILE_START(id) and AV_PROFILE_STOP(id, name)
+ * into the counter name, while profiling is enabled.
+ * AV_PROFILE_START declares a variable, id makes its name unique.
+ */
+#define AV_PROFILE_START(id) \
+uint64_t av_profile_tstart_##id = ff_profile_enabled ? AV_READ_TIME() : 0
+
+#define AV_PROFILE_STOP(id, name) \
+if (av_profile_tstart_##id) {\
+    static AVProfileCounter *av_profile_counter_##id;\
+    uint64_t av_profile_time_##id = AV_READ_TIME() - av_profile_tstart_##id;\
+    if (!av_profile_counter_##id)\
+        av_profile_counter_##id = av_profile_counter_register(name);\
+    av_profile_counter_add(av_profile_counter_##id, av_profile_time_##id);\
+}
 #else
 #define START_TIMER
 #define STOP_TIMER(id) {}
+#define AV_PROFILE_START(id)
+#define AV_PROFILE_STOP(id, name) {}
 #endif
 
 #endif /* AVUTIL_TIMER_H */
@@ -0,0 +1,159 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * AES-NI version of av_aes_crypt(), included by aes.c
+ *
+ * The round keys of AVAES are in the order and form the AES instructions
+ * expect: round_key[rounds] is applied first and round_key[0] last, and
+ * the decryption keys are already transformed for the equivalent inverse
+ * cipher.
+ */
+
+#ifndef AVUTIL_X86_AES_H
+#define AVUTIL_X86_AES_H
+
+#include "config.h"
+#include "libavutil/x86_cpu.h"
+
+#if HAVE_AESNI && HAVE_INLINE_ASM
+
+#define HAVE_AES_CRYPT_AESNI 1
+
+/* key points to round_key[rounds], rounds is the number of middle rounds */
+#define AESNI_CRYPT1(op)                                                    \
+static void aesni_ ## op ## 1(const av_aes_block *key, x86_reg rounds,      \
+                              av_aes_block *dst, const av_aes_block *src)   \
+{                                                                           \
+    __asm__ volatile(                                                       \
+        "movdqu     (%2), %%xmm0        \n\t"                               \
+        "movdqu     (%0), %%xmm1        \n\t"                               \
+        "pxor       %%xmm1, %%xmm0      \n\t"                               \
+        "1:                             \n\t"                               \
+        "sub        $16, %0             \n\t"                               \
+        "movdqu     (%0), %%xmm1        \n\t"                               \
+        #op "       %%xmm1, %%xmm0      \n\t"                               \
+        "dec        %1                  \n\t"                               \
+        "jnz        1b                  \n\t"                               \
+        "movdqu  -16(%0), %%xmm1        \n\t"                               \
+        #op "last   %%xmm1, %%xmm0      \n\t"                               \
+        "movdqu     %%xmm0, (%3)        \n\t"                               \
+        : "+r"(key), "+r"(rounds)                                           \
+        : "r"(src), "r"(dst)                                                \
+        : XMM_CLOBBERS("xmm0", "xmm1",) "memory"                            \
+    );                                                                      \
+}
+
+/* 4 independent blocks, interleaved to hide the latency of the rounds */
+#define AESNI_CRYPT4(op)                                                    \
+static void aesni_ ## op ## 4(const av_aes_block *key, x86_reg rounds,      \
+                              av_aes_block *dst, const av_aes_block *src)   \
+{                                                                           \
+    __asm__ volatile(                                                       \
+        "movdqu     (%0), %%xmm4        \n\t"                               \
+        "movdqu   0(%2), %%xmm0         \n\t"                               \
+        "movdqu  16(%2), %%xmm1         \n\t"                               \
+        "movdqu  32(%2), %%xmm2         \n\t"                               \
+        "movdqu  48(%2), %%xmm3         \n\t"                               \
+        "pxor       %%xmm4, %%xmm0      \n\t"                               \
+        "pxor       %%xmm4, %%xmm1      \n\t"                               \
+        "pxor       %%xmm4, %%xmm2      \n\t"                               \
+        "pxor       %%xmm4, %%xmm3      \n\t"                               \
+        "1:                             \n\t"                               \
+        "sub        $16, %0             \n\t"                               \
+        "movdqu     (%0), %%xmm4        \n\t"                               \
+        #op "       %%xmm4, %%xmm0      \n\t"                               \
+        #op "       %%xmm4, %%xmm1      \n\t"                               \
+        #op "       %%xmm4, %%xmm2      \n\t"                               \
+        #op "       %%xmm4, %%xmm3      \n\t"                               \
+        "dec        %1                  \n\t"                               \
+        "jnz        1b                  \n\t"                               \
+        "movdqu  -16(%0), %%xmm4        \n\t"                               \
+        #op "last   %%xmm4, %%xmm0      \n\t"                               \
+        #op "last   %%xmm4, %%xmm1      \n\t"                               \
+        #op "last   %%xmm4, %%xmm2      \n\t"                               \
+        #op "last   %%xmm4, %%xmm3      \n\t"                               \
+        "movdqu     %%xmm0,   (%3)      \n\t"                               \
+        "movdqu     %%xmm1, 16(%3)      \n\t"                               \
+        "movdqu     %%xmm2, 32(%3)      \n\t"                               \
+        "movdqu     %%xmm3, 48(%3)      \n\t"                               \
+        : "+r"(key), "+r"(rounds)                                           \
+        : "r"(src), "r"(dst)                                                \
+        : XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3", "xmm4",) "memory"    \
+    );                                                                      \
+}
+
+AESNI_CRYPT1(aesenc)
+AESNI_CRYPT1(aesdec)
+AESNI_CRYPT4(aesenc)
+AESNI_CRYPT4(aesdec)
+
+static void aes_crypt_aesni(AVAES *a, uint8_t *dst_, const uint8_t *src_,
+                            int count, uint8_t *iv_, int decrypt)
+{
+    av_aes_block *dst = (av_aes_block *)dst_;
+    const av_aes_block *src = (const av_aes_block *)src_;
+    av_aes_block *iv = (av_aes_block *)iv_;
+    const av_aes_block *key = &a->round_key[a->rounds];
+    x86_reg rounds = a->rounds - 1;
+
+    if (decrypt) {
+        /* CBC decryption does not depend on the previous output, so it
+         * runs 4 blocks at a time like ECB */
+        for (; count >= 4; count -= 4, src += 4, dst += 4) {
+            if (iv) {
+                av_aes_block tmp[4];
+                memcpy(tmp, src, sizeof(tmp));
+                aesni_aesdec4(key, rounds, dst, tmp);
+                addkey(&dst[0], &dst[0], iv);
+                addkey(&dst[1], &dst[1], &tmp[0]);
+                addkey(&dst[2], &dst[2], &tmp[1]);
+                addkey(&dst[3], &dst[3], &tmp[2]);
+                memcpy(iv, &tmp[3], 16);
+            } else
+                aesni_aesdec4(key, rounds, dst, src);
+        }
+        for (; count > 0; count--, src++, dst++) {
+            if (iv) {
+                av_aes_block tmp = *src;
+                aesni_aesdec1(key, rounds, dst, &tmp);
+                addkey(dst, dst, iv);
+                memcpy(iv, &tmp, 16);
+            } else
+                aesni_aesdec1(key, rounds, dst, src);
+        }
+    } else {
+        if (!iv)
+            for (; count >= 4; count -= 4, src += 4, dst += 4)
+                aesni_aesenc4(key, rounds, dst, src);
+        for (; count > 0; count--, src++, dst++) {
+            if (iv) {
+                av_aes_block tmp;
+                addkey(&tmp, src, iv);
+                aesni_aesenc1(key, rounds, dst, &tmp);
+                memcpy(iv, dst, 16);
+            } else
+                aesni_aesenc1(key, rounds, dst, src);
+        }
+    }
+}
+
+#endif /* HAVE_AESNI && HAVE_INLINE_ASM */
+
+#endif /* AVUTIL_X86_AES_H */
@@ -35,6 +35,16 @@
            "=c" (ecx), "=d" (edx)\
          : "0" (index));
 
+/* same as cpuid, for the leaves which take a subleaf in ecx */
+#define cpuid_count(index,count,eax,ebx,ecx,edx)\
+    __asm__ volatile\
+        ("mov %%"REG_b", %%"REG_S"\n\t"\
+         "cpuid\n\t"\
+         "xchg %%"REG_b", %%"REG_S\
+         : "=a" (eax), "=S" (ebx),\
+           "=c" (ecx), "=d" (edx)\
+         : "0" (index), "2" (count));
+
 #define xgetbv(index,eax,edx)                                   \
     __asm__ (".byte 0x0f, 0x01, 0xd0" : "=a"(eax), "=d"(edx) : "c" (index))
 
@@ -96,6 +106,10 @@ int ff_get_cpu_flags_x86(void)
             rval |= AV_CPU_FLAG_SSE4;
         if (ecx & 0x00100000 )
             rval |= AV_CPU_FLAG_SSE42;
+#if HAVE_AESNI
+        if (ecx & 0x02000000 )
+            rval |= AV_CPU_FLAG_AESNI;
+#endif
 #if HAVE_AVX
         /* Check OXSAVE and AVX bits */
         if ((ecx & 0x18000000) == 0x18000000) {
@@ -104,6 +118,14 @@ int ff_get_cpu_flags_x86(void)
             if ((eax & 0x6) == 0x6)
                 rval |= AV_CPU_FLAG_AVX;
         }
+#if HAVE_AVX2
+        /* AVX2 needs the same OS support as AVX */
+        if (max_std_level >= 7 && rval & AV_CPU_FLAG_AVX) {
+            cpuid_count(7, 0, eax, ebx, ecx, edx);
+            if (ebx & 0x00000020)
+                rval |= AV_CPU_FLAG_AVX2;
+        }
+#endif
 #endif
 #endif
                   ;
@@ -0,0 +1,139 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * streaming image plane copies, included by imgutils.c
+ *
+ * Lines are copied in 64 byte chunks, with the unaligned start and the
+ * remainder of each line copied with memcpy().
+ */
+
+#ifndef AVUTIL_X86_IMGUTILS_H
+#define AVUTIL_X86_IMGUTILS_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "config.h"
+#include "libavutil/x86_cpu.h"
+
+#if HAVE_INLINE_ASM
+
+#if HAVE_SSE
+#define HAVE_IMAGE_COPY_PLANE_NT_SSE2 1
+
+/* dst is 16 byte aligned, size is a multiple of 64 */
+static void copy_line_nt_sse2(uint8_t *dst, const uint8_t *src, x86_reg size)
+{
+    __asm__ volatile(
+        "1:                             \n\t"
+        "movdqu       (%1), %%xmm0      \n\t"
+        "movdqu     16(%1), %%xmm1      \n\t"
+        "movdqu     32(%1), %%xmm2      \n\t"
+        "movdqu     48(%1), %%xmm3      \n\t"
+        "movntdq    %%xmm0,   (%0)      \n\t"
+        "movntdq    %%xmm1, 16(%0)      \n\t"
+        "movntdq    %%xmm2, 32(%0)      \n\t"
+        "movntdq    %%xmm3, 48(%0)      \n\t"
+        "add        $64, %1             \n\t"
+        "add        $64, %0             \n\t"
+        "sub        $64, %2             \n\t"
+        "jg         1b                  \n\t"
+        : "+r"(dst), "+r"(src), "+r"(size)
+        :
+        : XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3",) "memory"
+    );
+}
+
+/**
+ * Copy a plane with non-temporal stores, which bypass the cache instead
+ * of evicting the data of the caller for a destination it does not read
+ * soon.
+ */
+static void image_copy_plane_nt_sse2(uint8_t       *dst, int dst_linesize,
+                                     const uint8_t *src, int src_linesize,
+                                     int bytewidth, int height)
+{
+    for (; height > 0; height--) {
+        int head = FFMIN(-(intptr_t)dst & 15, bytewidth);
+        int body = (bytewidth - head) & ~63;
+
+        memcpy(dst, src, head);
+        if (body)
+            copy_line_nt_sse2(dst + head, src + head, body);
+        memcpy(dst + head + body, src + head + body, bytewidth - head - body);
+        dst += dst_linesize;
+        src += src_linesize;
+    }
+    /* make the stores visible to other threads like ordinary ones */
+    __asm__ volatile("sfence" ::: "memory");
+}
+#endif /* HAVE_SSE */
+
+#if HAVE_SSE4
+#define HAVE_IMAGE_COPY_PLANE_UC_SSE4 1
+
+/* src is 16 byte aligned, size is a multiple of 64 */
+static void copy_line_uc_sse4(uint8_t *dst, const uint8_t *src, x86_reg size)
+{
+    __asm__ volatile(
+        "1:                             \n\t"
+        "movntdqa     (%1), %%xmm0      \n\t"
+        "movntdqa   16(%1), %%xmm1      \n\t"
+        "movntdqa   32(%1), %%xmm2      \n\t"
+        "movntdqa   48(%1), %%xmm3      \n\t"
+        "movdqu     %%xmm0,   (%0)      \n\t"
+        "movdqu     %%xmm1, 16(%0)      \n\t"
+        "movdqu     %%xmm2, 32(%0)      \n\t"
+        "movdqu     %%xmm3, 48(%0)      \n\t"
+        "add        $64, %1             \n\t"
+        "add        $64, %0             \n\t"
+        "sub        $64, %2             \n\t"
+        "jg         1b                  \n\t"
+        : "+r"(dst), "+r"(src), "+r"(size)
+        :
+        : XMM_CLOBBERS("xmm0", "xmm1", "xmm2", "xmm3",) "memory"
+    );
+}
+
+/**
+ * Copy a plane with streaming loads, which read whole cache lines of
+ * write-combining memory at once instead of one uncached access per load.
+ */
+static void image_copy_plane_uc_sse4(uint8_t       *dst, int dst_linesize,
+                                     const uint8_t *src, int src_linesize,
+                                     int bytewidth, int height)
+{
+    for (; height > 0; height--) {
+        int head = FFMIN(-(intptr_t)src & 15, bytewidth);
+        int body = (bytewidth - head) & ~63;
+
+        memcpy(dst, src, head);
+        if (body)
+            copy_line_uc_sse4(dst + head, src + head, body);
+        memcpy(dst + head + body, src + head + body, bytewidth - head - body);
+        dst += dst_linesize;
+        src += src_linesize;
+    }
+}
+#endif /* HAVE_SSE4 */
+
+#endif /* HAVE_INLINE_ASM */
+
+#endif /* AVUTIL_X86_IMGUTILS_H */
@@ -955,6 +955,203 @@ static void reallocBuffers(PPContext *c, int width, int height, int stride, int
     reallocAlign((void **)&c->forcedQPTable, 8, mbWidth*sizeof(QP_STORE_T));
 }
 
+/* rows of the neighbouring bands filtered with a band, a multiple of 16 so
+ * that the bands start on a row of QPs */
+#define BAND_OVERLAP 32
+
+/**
+ * Arguments of the jobs filtering the bands of a plane.
+ */
+typedef struct PPBandJob{
+    const uint8_t *src;
+    int srcStride;
+    uint8_t *dst;
+    int dstStride;
+    int width;
+    int height;
+    int bandHeight;
+    const QP_STORE_T *QPs;
+    int QPStride;
+    int isColor;
+    PPMode *mode;
+    PPContext *c;
+} PPBandJob;
+
+static int bandHeight(int height, int nbBands){
+    return FFALIGN((height + nbBands - 1) / nbBands, 16);
+}
+
+static void freeBands(PPContext *c){
+    int i;
+
+    if(!c->bands) return;
+    for(i=0; i<c->nbBands; i++){
+        PPContext *b= c->bands[i];
+        if(!b) continue;
+        av_free(b->tempBlocks);
+        av_free(b->yHistogram);
+        av_free(b->tempDst);
+        av_free(b->tempSrc);
+        av_free(b->deintTemp);
+        av_free(b->bandDst);
+        av_free(b);
+    }
+    av_freep(&c->bands);
+}
+
+/**
+ * Allocate the contexts of the bands for the current stride of c.
+ * @return 0 on success, a negative AVERROR on failure
+ */
+static int allocBands(PPContext *c, int height){
+    int size= c->stride * (bandHeight(height, c->nbBands) + 2*BAND_OVERLAP + 9);
+    int i;
+
+    if(!c->bands && !(c->bands= av_mallocz(c->nbBands * sizeof(*c->bands))))
+        return AVERROR(ENOMEM);
+
+    for(i=0; i<c->nbBands; i++){
+        PPContext *b= c->bands[i];
+        if(!b && !(b= c->bands[i]= av_mallocz(sizeof(PPContext))))
+            return AVERROR(ENOMEM);
+        if(b->stride == c->stride && b->bandDstSize >= size)
+            continue;
+
+        b->stride= c->stride;
+        reallocAlign((void **)&b->tempDst, 8, c->stride*24);
+        reallocAlign((void **)&b->tempSrc, 8, c->stride*24);
+        reallocAlign((void **)&b->tempBlocks, 8, 2*16*8);
+        reallocAlign((void **)&b->yHistogram, 8, 256*sizeof(uint64_t));
+        reallocAlign((void **)&b->deintTemp, 8, 2*c->stride+32);
+        reallocAlign((void **)&b->bandDst, 8, size);
+        b->bandDstSize= size;
+        if(!b->tempDst || !b->tempSrc || !b->tempBlocks || !b->yHistogram ||
+           !b->deintTemp || !b->bandDst){
+            b->bandDstSize= 0;
+            return AVERROR(ENOMEM);
+        }
+    }
+    return 0;
+}
+
+/**
+ * Filter the rows of a band and the overlapping rows of its neighbours
+ * into the buffer of the band, then copy the rows of the band to dst.
+ */
+static int postProcessBand(void *arg, int jobnr, int threadnr){
+    PPBandJob *j= arg;
+    PPContext *c= j->c;
+    PPContext *b= c->bands[jobnr];
+    PPContext own= *b;
+    const int qpVShift= j->isColor ? 4-c->vChromaSubSample : 4;
+    const int stride= FFABS(j->dstStride); // same layout as dst for reads past the line ends
+    const int y0= jobnr*j->bandHeight;
+    const int y1= FFMIN(y0 + j->bandHeight, j->height);
+    const int p0= FFMAX(y0 - BAND_OVERLAP, 0);
+    const int p1= FFMIN(y1 + BAND_OVERLAP, j->height);
+    uint8_t *bandDst= own.bandDst + stride; // postProcess() may read the line above
+    int y;
+
+    /* the state of c with the temporary buffers of the band */
+    *b= *c;
+    b->tempBlocks = own.tempBlocks;
+    b->yHistogram = own.yHistogram;
+    b->tempDst    = own.tempDst;
+    b->tempSrc    = own.tempSrc;
+    b->deintTemp  = own.deintTemp;
+    b->bandDst    = own.bandDst;
+    b->bandDstSize= own.bandDstSize;
+    b->bands      = NULL;
+    b->pool       = NULL;
+    b->nonBQPTable= c->nonBQPTable + (p0>>qpVShift)*FFABS(j->QPStride);
+    if(!j->isColor){
+        memcpy(b->yHistogram, c->yHistogram, 256*sizeof(uint64_t));
+        b->frameNum= 1; // counted in c, only needed to skip the first frame fix
+    }
+
+    postProcess(j->src + p0*j->srcStride, j->srcStride, bandDst, stride,
+                j->width, p1 - p0, j->QPs + (p0>>qpVShift)*j->QPStride, j->QPStride,
+                j->isColor, j->mode, b);
+
+    for(y=y0; y<y1; y++)
+        memcpy(j->dst + y*j->dstStride, bandDst + (y-p0)*stride, j->width);
+
+    /* the luma samples of the overlapping rows are counted by the
+     * neighbouring bands, remove them as postProcess() took them */
+    if(!j->isColor){
+        for(y=p0; y<p1; y+=BLOCK_SIZE){
+            const uint8_t *line= j->src + FFMIN(y + 12, p1 - 1)*j->srcStride + 4;
+            int x;
+            if(y >= y0 && y < y1) continue;
+            for(x=0; x<j->width; x+=BLOCK_SIZE)
+                b->yHistogram[line[x]]--;
+        }
+    }
+
+    return 0;
+}
+
+static void postProcessPlane(const uint8_t src[], int srcStride, uint8_t dst[], int dstStride, int width, int height,
+        const QP_STORE_T QPs[], int QPStride, int isColor, PPMode *mode, PPContext *c)
+{
+    const int planeMode= isColor ? mode->chromMode : mode->lumMode;
+    PPBandJob j;
+    int i, b, nbBands;
+
+    if(!c->bands || (planeMode & TEMP_NOISE_FILTER)){
+        postProcess(src, srcStride, dst, dstStride, width, height, QPs, QPStride, isColor, mode, c);
+        return;
+    }
+
+    j.bandHeight= bandHeight(height, c->nbBands);
+    nbBands= (height + j.bandHeight - 1) / j.bandHeight;
+    if(nbBands < 2){
+        postProcess(src, srcStride, dst, dstStride, width, height, QPs, QPStride, isColor, mode, c);
+        return;
+    }
+
+    j.src      = src;
+    j.srcStride= srcStride;
+    j.dst      = dst;
+    j.dstStride= dstStride;
+    j.width    = width;
+    j.height   = height;
+    j.QPs      = QPs;
+    j.QPStride = QPStride;
+    j.isColor  = isColor;
+    j.mode     = mode;
+    j.c        = c;
+
+    /* what postProcess() does to the luma statistics before using them */
+    if(!isColor){
+        c->frameNum++;
+        if(c->frameNum == 1) c->yHistogram[0]= width*height/64*15/256;
+    }
+
+    av_thread_pool_execute(c->pool, postProcessBand, &j, NULL, nbBands, 0);
+
+    if(!isColor){
+        for(i=0; i<256; i++){
+            uint64_t sum= c->yHistogram[i];
+            for(b=0; b<nbBands; b++)
+                sum+= c->bands[b]->yHistogram[i] - c->yHistogram[i];
+            c->yHistogram[i]= sum;
+        }
+    }
+}
+
+void pp_set_thread_pool(pp_context *vc, AVThreadPool *pool, int nb_bands){
+    PPContext *c= (PPContext*)vc;
+
+    freeBands(c);
+    av_thread_pool_unref(&c->pool);
+    if(!pool)
+        return;
+
+    c->pool= av_thread_pool_ref(pool);
+    c->nbBands= nb_bands > 0 ? nb_bands : av_thread_pool_nb_threads(pool) + 1;
+}
+
 static const char * context_to_name(void * ptr) {
     return "postproc";
 }
@@ -1000,6 +1197,9 @@ void pp_free_context(void *vc){
     av_free(c->nonBQPTable);
     av_free(c->forcedQPTable);
 
+    freeBands(c);
+    av_thread_pool_unref(&c->pool);
+
     memset(c, 0, sizeof(PPContext));
 
     av_free(c);
@@ -1024,6 +1224,10 @@ void  pp_postprocess(const uint8_t * src[3], const int srcStride[3],
                        FFMAX(minStride, c->stride),
                        FFMAX(c->qpStride, absQPStride));
 
+    /* filter whole planes if the bands cannot be allocated */
+    if(c->pool && c->nbBands > 1 && allocBands(c, height) < 0)
+        freeBands(c);
+
     if(QP_store==NULL || (mode->lumMode & FORCE_QUANT)){
         int i;
         QP_store= c->forcedQPTable;
@@ -1081,17 +1285,17 @@ void  pp_postprocess(const uint8_t * src[3], const int srcStride[3],
     av_log(c, AV_LOG_DEBUG, "using npp filters 0x%X/0x%X\n",
            mode->lumMode, mode->chromMode);
 
-    postProcess(src[0], srcStride[0], dst[0], dstStride[0],
-                width, height, QP_store, QPStride, 0, mode, c);
+    postProcessPlane(src[0], srcStride[0], dst[0], dstStride[0],
+                     width, height, QP_store, QPStride, 0, mode, c);
 
     width  = (width )>>c->hChromaSubSample;
     height = (height)>>c->vChromaSubSample;
 
     if(mode->chromMode){
-        postProcess(src[1], srcStride[1], dst[1], dstStride[1],
-                    width, height, QP_store, QPStride, 1, mode, c);
-        postProcess(src[2], srcStride[2], dst[2], dstStride[2],
-                    width, height, QP_store, QPStride, 2, mode, c);
+        postProcessPlane(src[1], srcStride[1], dst[1], dstStride[1],
+                         width, height, QP_store, QPStride, 1, mode, c);
+        postProcessPlane(src[2], srcStride[2], dst[2], dstStride[2],
+                         width, height, QP_store, QPStride, 2, mode, c);
     }
     else if(srcStride[1] == dstStride[1] && srcStride[2] == dstStride[2]){
         linecpy(dst[1], src[1], height, srcStride[1]);
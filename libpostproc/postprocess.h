@@ -28,9 +28,10 @@
  */
 
 #include "libavutil/avutil.h"
+#include "libavutil/threadpool.h"
 
 #define LIBPOSTPROC_VERSION_MAJOR 51
-#define LIBPOSTPROC_VERSION_MINOR  2
+#define LIBPOSTPROC_VERSION_MINOR  3
 #define LIBPOSTPROC_VERSION_MICRO  0
 
 #define LIBPOSTPROC_VERSION_INT AV_VERSION_INT(LIBPOSTPROC_VERSION_MAJOR, \
@@ -93,6 +94,21 @@ void pp_free_mode(pp_mode *mode);
 pp_context *pp_get_context(int width, int height, int flags);
 void pp_free_context(pp_context *ppContext);
 
+/**
+ * Make pp_postprocess() split the planes in horizontal bands filtered in
+ * parallel on the threads of a pool. Each band is filtered together with
+ * some rows of its neighbours, which are then dropped, so the output is the
+ * one of whole planes, except for a few pixels on the left and right edges
+ * where the deringing filter reads past the ends of the lines.
+ * Planes filtered with the temporal noise reducer are not split.
+ *
+ * @param pool     the pool, of which a reference is kept, or NULL to filter
+ *                 whole planes on the calling thread again
+ * @param nb_bands maximum number of bands per plane, 0 for one more than
+ *                 the number of threads of the pool
+ */
+void pp_set_thread_pool(pp_context *ppContext, AVThreadPool *pool, int nb_bands);
+
 #define PP_CPU_CAPS_MMX   0x80000000
 #define PP_CPU_CAPS_MMX2  0x20000000
 #define PP_CPU_CAPS_3DNOW 0x40000000
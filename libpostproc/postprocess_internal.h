@@ -164,6 +164,13 @@ typedef struct PPContext{
     int vChromaSubSample;
 
     PPMode ppMode;
+
+    AVThreadPool *pool;       ///< pool filtering the bands, NULL to filter whole planes
+    int nbBands;              ///< maximum number of bands of a plane
+    struct PPContext **bands; ///< contexts filtering the bands, with their own temporary buffers
+
+    uint8_t *bandDst;         ///< output of a band, including the overlapping rows
+    int bandDstSize;
 } PPContext;
 
 
@@ -0,0 +1,193 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdint.h>
+
+#include "config.h"
+#include "libavutil/attributes.h"
+#include "libswscale/rgb2rgb.h"
+
+/* The NEON functions convert n blocks of 8 pixels (16 bytes for the byte
+ * (de)interleaving), the remaining pixels are converted here. */
+void ff_shuffle_bytes_2103_neon(const uint8_t *src, uint8_t *dst, int n);
+void ff_shuffle_bytes_0321_neon(const uint8_t *src, uint8_t *dst, int n);
+void ff_shuffle_bytes_1230_neon(const uint8_t *src, uint8_t *dst, int n);
+void ff_shuffle_bytes_3012_neon(const uint8_t *src, uint8_t *dst, int n);
+void ff_shuffle_bytes_3210_neon(const uint8_t *src, uint8_t *dst, int n);
+void ff_rgb32to24_neon(const uint8_t *src, uint8_t *dst, int n);
+void ff_rgb32tobgr24_neon(const uint8_t *src, uint8_t *dst, int n);
+void ff_rgb24to32_neon(const uint8_t *src, uint8_t *dst, int n);
+void ff_rgb24tobgr32_neon(const uint8_t *src, uint8_t *dst, int n);
+void ff_rgb24tobgr24_neon(const uint8_t *src, uint8_t *dst, int n);
+void ff_interleave_bytes_neon(const uint8_t *src1, const uint8_t *src2,
+                              uint8_t *dst, int n);
+void ff_deinterleave_bytes_neon(const uint8_t *src, uint8_t *dst1,
+                                uint8_t *dst2, int n);
+
+#define SHUFFLE_BYTES_NEON(a, b, c, d)                                        \
+static void shuffle_bytes_##a##b##c##d##_neon(const uint8_t *src, uint8_t *dst, \
+                                              int src_size)                   \
+{                                                                             \
+    int i = src_size & ~31;                                                   \
+                                                                              \
+    if (i)                                                                    \
+        ff_shuffle_bytes_##a##b##c##d##_neon(src, dst, src_size >> 5);        \
+    for (; i < src_size; i += 4) {                                            \
+        uint8_t p0 = src[i + 0], p1 = src[i + 1], p2 = src[i + 2], p3 = src[i + 3]; \
+        dst[i + 0] = a == 0 ? p0 : a == 1 ? p1 : a == 2 ? p2 : p3;            \
+        dst[i + 1] = b == 0 ? p0 : b == 1 ? p1 : b == 2 ? p2 : p3;            \
+        dst[i + 2] = c == 0 ? p0 : c == 1 ? p1 : c == 2 ? p2 : p3;            \
+        dst[i + 3] = d == 0 ? p0 : d == 1 ? p1 : d == 2 ? p2 : p3;            \
+    }                                                                         \
+}
+
+SHUFFLE_BYTES_NEON(2, 1, 0, 3)
+SHUFFLE_BYTES_NEON(0, 3, 2, 1)
+SHUFFLE_BYTES_NEON(1, 2, 3, 0)
+SHUFFLE_BYTES_NEON(3, 0, 1, 2)
+SHUFFLE_BYTES_NEON(3, 2, 1, 0)
+
+static void rgb32to24_neon(const uint8_t *src, uint8_t *dst, int src_size)
+{
+    int n = src_size >> 5, i;
+
+    if (n)
+        ff_rgb32to24_neon(src, dst, n);
+    for (i = 8 * n; i < src_size / 4; i++) {
+        dst[3 * i + 0] = src[4 * i + 2];
+        dst[3 * i + 1] = src[4 * i + 1];
+        dst[3 * i + 2] = src[4 * i + 0];
+    }
+}
+
+static void rgb32tobgr24_neon(const uint8_t *src, uint8_t *dst, int src_size)
+{
+    int n = src_size >> 5, i;
+
+    if (n)
+        ff_rgb32tobgr24_neon(src, dst, n);
+    for (i = 8 * n; i < src_size / 4; i++) {
+        dst[3 * i + 0] = src[4 * i + 0];
+        dst[3 * i + 1] = src[4 * i + 1];
+        dst[3 * i + 2] = src[4 * i + 2];
+    }
+}
+
+static void rgb24to32_neon(const uint8_t *src, uint8_t *dst, int src_size)
+{
+    int n = src_size / 24, i;
+
+    if (n)
+        ff_rgb24to32_neon(src, dst, n);
+    for (i = 8 * n; i < src_size / 3; i++) {
+        dst[4 * i + 0] = src[3 * i + 2];
+        dst[4 * i + 1] = src[3 * i + 1];
+        dst[4 * i + 2] = src[3 * i + 0];
+        dst[4 * i + 3] = 255;
+    }
+}
+
+static void rgb24tobgr32_neon(const uint8_t *src, uint8_t *dst, int src_size)
+{
+    int n = src_size / 24, i;
+
+    if (n)
+        ff_rgb24tobgr32_neon(src, dst, n);
+    for (i = 8 * n; i < src_size / 3; i++) {
+        dst[4 * i + 0] = src[3 * i + 0];
+        dst[4 * i + 1] = src[3 * i + 1];
+        dst[4 * i + 2] = src[3 * i + 2];
+        dst[4 * i + 3] = 255;
+    }
+}
+
+static void rgb24tobgr24_neon(const uint8_t *src, uint8_t *dst, int src_size)
+{
+    int n = src_size / 24, i;
+
+    if (n)
+        ff_rgb24tobgr24_neon(src, dst, n);
+    for (i = 24 * n; i < src_size; i += 3) {
+        uint8_t x  = src[i + 2];
+        dst[i + 1] = src[i + 1];
+        dst[i + 2] = src[i + 0];
+        dst[i + 0] = x;
+    }
+}
+
+static void interleaveBytes_neon(const uint8_t *src1, const uint8_t *src2,
+                                 uint8_t *dest, int width, int height,
+                                 int src1Stride, int src2Stride, int dstStride)
+{
+    int h;
+
+    for (h = 0; h < height; h++) {
+        int w = width & ~15;
+
+        if (w)
+            ff_interleave_bytes_neon(src1, src2, dest, width >> 4);
+        for (; w < width; w++) {
+            dest[2*w+0] = src1[w];
+            dest[2*w+1] = src2[w];
+        }
+        dest += dstStride;
+        src1 += src1Stride;
+        src2 += src2Stride;
+    }
+}
+
+static void deinterleaveBytes_neon(const uint8_t *src, uint8_t *dst1, uint8_t *dst2,
+                                   int width, int height, int srcStride,
+                                   int dst1Stride, int dst2Stride)
+{
+    int h;
+
+    for (h = 0; h < height; h++) {
+        int w = width & ~15;
+
+        if (w)
+            ff_deinterleave_bytes_neon(src, dst1, dst2, width >> 4);
+        for (; w < width; w++) {
+            dst1[w] = src[2*w+0];
+            dst2[w] = src[2*w+1];
+        }
+        src  += srcStride;
+        dst1 += dst1Stride;
+        dst2 += dst2Stride;
+    }
+}
+
+av_cold void rgb2rgb_init_arm(void)
+{
+    /* the NEON code assumes little-endian byte order */
+    if (!HAVE_NEON || HAVE_BIGENDIAN)
+        return;
+
+    shuffle_bytes_2103 = shuffle_bytes_2103_neon;
+    shuffle_bytes_0321 = shuffle_bytes_0321_neon;
+    shuffle_bytes_1230 = shuffle_bytes_1230_neon;
+    shuffle_bytes_3012 = shuffle_bytes_3012_neon;
+    shuffle_bytes_3210 = shuffle_bytes_3210_neon;
+    rgb32to24          = rgb32to24_neon;
+    rgb32tobgr24       = rgb32tobgr24_neon;
+    rgb24to32          = rgb24to32_neon;
+    rgb24tobgr32       = rgb24tobgr32_neon;
+    rgb24tobgr24       = rgb24tobgr24_neon;
+    interleaveBytes    = interleaveBytes_neon;
+    deinterleaveBytes  = deinterleaveBytes_neon;
+}
@@ -0,0 +1,107 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <inttypes.h>
+
+#include "config.h"
+#include "libavutil/attributes.h"
+#include "libswscale/swscale.h"
+#include "libswscale/swscale_internal.h"
+
+/* filterSize must be a multiple of 4 */
+void ff_hscale_neon(int16_t *dst, int dstW, const uint8_t *src,
+                    const int16_t *filter, const int16_t *filterPos,
+                    int filterSize);
+/* These write dstW rounded up to a multiple of 8 pixels and take the dither
+ * values of the first 8 pixels. */
+void ff_yuv2planeX_neon(const int16_t *filter, int filterSize,
+                        const int16_t **src, uint8_t *dest, int dstW,
+                        const uint8_t *dither);
+void ff_yuv2plane1_neon(const int16_t *src, uint8_t *dest, int dstW,
+                        const uint8_t *dither);
+
+/* V is dithered with the chroma dither pattern rotated by 3 */
+static void rotate_dither(uint8_t *dst, const uint8_t *dither)
+{
+    int i;
+
+    for (i = 0; i < 8; i++)
+        dst[i] = dither[(i + 3) & 7];
+}
+
+static void yuv2yuvX_neon(SwsContext *c, const int16_t *lumFilter,
+                          const int16_t **lumSrc, int lumFilterSize,
+                          const int16_t *chrFilter, const int16_t **chrUSrc,
+                          const int16_t **chrVSrc,
+                          int chrFilterSize, const int16_t **alpSrc,
+                          uint8_t *dest, uint8_t *uDest, uint8_t *vDest,
+                          uint8_t *aDest, int dstW, int chrDstW,
+                          const uint8_t *lumDither, const uint8_t *chrDither)
+{
+    ff_yuv2planeX_neon(lumFilter, lumFilterSize, lumSrc, dest, dstW, lumDither);
+
+    if (uDest) {
+        uint8_t vDither[8];
+
+        rotate_dither(vDither, chrDither);
+        ff_yuv2planeX_neon(chrFilter, chrFilterSize, chrUSrc, uDest, chrDstW, chrDither);
+        ff_yuv2planeX_neon(chrFilter, chrFilterSize, chrVSrc, vDest, chrDstW, vDither);
+    }
+
+    if (CONFIG_SWSCALE_ALPHA && aDest)
+        ff_yuv2planeX_neon(lumFilter, lumFilterSize, alpSrc, aDest, dstW, lumDither);
+}
+
+static void yuv2yuv1_neon(SwsContext *c, const int16_t *lumSrc,
+                          const int16_t *chrUSrc, const int16_t *chrVSrc,
+                          const int16_t *alpSrc,
+                          uint8_t *dest, uint8_t *uDest, uint8_t *vDest,
+                          uint8_t *aDest, int dstW, int chrDstW,
+                          const uint8_t *lumDither, const uint8_t *chrDither)
+{
+    ff_yuv2plane1_neon(lumSrc, dest, dstW, lumDither);
+
+    if (uDest) {
+        uint8_t vDither[8];
+
+        rotate_dither(vDither, chrDither);
+        ff_yuv2plane1_neon(chrUSrc, uDest, chrDstW, chrDither);
+        ff_yuv2plane1_neon(chrVSrc, vDest, chrDstW, vDither);
+    }
+
+    if (CONFIG_SWSCALE_ALPHA && aDest)
+        ff_yuv2plane1_neon(alpSrc, aDest, dstW, lumDither);
+}
+
+av_cold void ff_sws_init_swScale_neon(SwsContext *c)
+{
+    enum PixelFormat dstFormat = c->dstFormat;
+
+    /* the NEON code assumes little-endian byte order */
+    if (HAVE_BIGENDIAN)
+        return;
+
+    /* the horizontal filters are padded to a multiple of 4 taps */
+    c->hScale = ff_hscale_neon;
+
+    if (!is16BPS(dstFormat) && !is9_OR_10BPS(dstFormat) &&
+        dstFormat != PIX_FMT_NV12 && dstFormat != PIX_FMT_NV21) {
+        c->yuv2yuv1 = yuv2yuv1_neon;
+        c->yuv2yuvX = yuv2yuvX_neon;
+    }
+}
@@ -82,6 +82,10 @@ int main(int argc, char **argv)
             FUNC(4, 2, rgb32tobgr16),
             FUNC(4, 3, rgb32tobgr24),
             FUNC(4, 4, shuffle_bytes_2103), /* rgb32tobgr32 */
+            FUNC(4, 4, shuffle_bytes_0321),
+            FUNC(4, 4, shuffle_bytes_1230),
+            FUNC(4, 4, shuffle_bytes_3012),
+            FUNC(4, 4, shuffle_bytes_3210),
             FUNC(0, 0, NULL)
         };
         int width;
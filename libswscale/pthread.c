@@ -0,0 +1,172 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * threaded scaling of whole frames, each thread scaling a horizontal band
+ * of the output
+ */
+
+#include <string.h>
+
+#include "libavutil/avutil.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/mem.h"
+#include "libavutil/threadpool.h"
+#include "swscale.h"
+#include "swscale_internal.h"
+
+/* minimum number of output lines of a band */
+#define MIN_BAND_H 16
+
+/** The frame of an ff_sws_thread_scale() call. */
+typedef struct ScaleFrame {
+    SwsContext *c;
+    const uint8_t **src;
+    int *srcStride;
+    uint8_t **dst;
+    int *dstStride;
+} ScaleFrame;
+
+static int scale_band(void *arg, int band, int threadnr)
+{
+    ScaleFrame *f = arg;
+    SwsContext *s = f->c->slice_ctx[band];
+    /* swScale() modifies the pointers and strides */
+    const uint8_t *src[4] = { f->src[0], f->src[1], f->src[2], f->src[3] };
+    uint8_t       *dst[4] = { f->dst[0], f->dst[1], f->dst[2], f->dst[3] };
+    int srcStride[4], dstStride[4];
+
+    memcpy(srcStride, f->srcStride, sizeof(srcStride));
+    memcpy(dstStride, f->dstStride, sizeof(dstStride));
+    return s->swScale(s, src, srcStride, 0, s->srcH, dst, dstStride);
+}
+
+static void free_band_context(SwsContext *s)
+{
+    ff_sws_free_pix_bufs(s);
+    av_free(s->formatConvBuffer);
+    av_free(s);
+}
+
+static SwsContext *alloc_band_context(SwsContext *c, int y_start, int y_end)
+{
+    SwsContext *s = av_malloc(sizeof(SwsContext));
+
+    if (!s)
+        return NULL;
+    memcpy(s, c, sizeof(SwsContext));
+    s->lumPixBuf        = NULL;
+    s->chrUPixBuf       = NULL;
+    s->chrVPixBuf       = NULL;
+    s->alpPixBuf        = NULL;
+    s->formatConvBuffer = NULL;
+    s->threads          = 1;
+    s->slice_ctx        = NULL;
+    s->nb_slice_ctx     = 0;
+    s->thread_pool      = NULL;
+    s->dstYStart        = y_start;
+    s->dstYEnd          = y_end;
+
+    s->formatConvBuffer = av_malloc(FFALIGN(c->srcW*2+78, 16) * 2);
+    if (!s->formatConvBuffer || ff_sws_alloc_pix_bufs(s) < 0) {
+        free_band_context(s);
+        return NULL;
+    }
+    return s;
+}
+
+int ff_sws_thread_init(SwsContext *c)
+{
+    int i, nb_bands, align = 1 << c->chrDstVSubSample;
+
+    if (c->nb_slice_ctx)
+        return 0;
+
+    /* Only the generic scaler can start in the middle of the output and
+     * has ring buffers to duplicate; unscaled special converters and
+     * small outputs are left to the calling thread. */
+    nb_bands = FFMIN(c->threads, c->dstH / MIN_BAND_H);
+    if (!c->lumPixBuf || nb_bands < 2)
+        goto fail;
+
+    if (!c->thread_pool && !(c->thread_pool = av_thread_pool_alloc(nb_bands - 1)))
+        goto fail;
+    if (!av_thread_pool_nb_threads(c->thread_pool))
+        goto fail;
+    nb_bands = FFMIN(nb_bands, av_thread_pool_nb_threads(c->thread_pool) + 1);
+
+    c->slice_ctx = av_mallocz(sizeof(*c->slice_ctx) * nb_bands);
+    if (!c->slice_ctx)
+        goto fail;
+    /* the bands start on a chroma line */
+    for (i = 0; i < nb_bands; i++) {
+        int y_start = (c->dstH *  i      / nb_bands) & ~(align - 1);
+        int y_end   = i == nb_bands - 1 ? c->dstH :
+                      (c->dstH * (i + 1) / nb_bands) & ~(align - 1);
+
+        if (!(c->slice_ctx[i] = alloc_band_context(c, y_start, y_end)))
+            goto fail;
+        c->nb_slice_ctx++;
+    }
+
+    av_log(c, AV_LOG_DEBUG, "scaling frames in %d bands on a pool of %d threads\n",
+           nb_bands, av_thread_pool_nb_threads(c->thread_pool));
+    return 0;
+
+fail:
+    ff_sws_thread_free(c);
+    /* do not try again for every frame */
+    c->threads = 1;
+    return -1;
+}
+
+int ff_sws_thread_scale(SwsContext *c, const uint8_t *src[], int srcStride[],
+                        uint8_t *dst[], int dstStride[])
+{
+    ScaleFrame f = { c, src, srcStride, dst, dstStride };
+    int i;
+
+    /* The SIMD code writes up to 16 pixels past the end of the lines, which
+     * must not reach the first line of the next band. */
+    for (i = 0; i < 4 && dst[i]; i++)
+        if (FFABS(dstStride[i]) < av_image_get_linesize(c->dstFormat, FFALIGN(c->dstW, 16), i))
+            return -1;
+
+    /* the palette is converted by sws_scale() for each frame */
+    for (i = 0; i < c->nb_slice_ctx; i++) {
+        memcpy(c->slice_ctx[i]->pal_yuv, c->pal_yuv, sizeof(c->pal_yuv));
+        memcpy(c->slice_ctx[i]->pal_rgb, c->pal_rgb, sizeof(c->pal_rgb));
+    }
+
+    av_thread_pool_execute(c->thread_pool, scale_band, &f, NULL,
+                           c->nb_slice_ctx, c->nb_slice_ctx);
+
+    c->dstY = c->dstH;
+    return c->dstH;
+}
+
+void ff_sws_thread_free(SwsContext *c)
+{
+    int i;
+
+    for (i = 0; i < c->nb_slice_ctx; i++)
+        free_band_context(c->slice_ctx[i]);
+    av_freep(&c->slice_ctx);
+    c->nb_slice_ctx = 0;
+}
@@ -45,6 +45,12 @@ void (*rgb24tobgr24)(const uint8_t *src, uint8_t *dst, int src_size);
 void (*rgb24to16)(const uint8_t *src, uint8_t *dst, int src_size);
 void (*rgb24to15)(const uint8_t *src, uint8_t *dst, int src_size);
 void (*shuffle_bytes_2103)(const uint8_t *src, uint8_t *dst, int src_size);
+void (*shuffle_bytes_0321)(const uint8_t *src, uint8_t *dst, int src_size);
+void (*shuffle_bytes_1230)(const uint8_t *src, uint8_t *dst, int src_size);
+void (*shuffle_bytes_3012)(const uint8_t *src, uint8_t *dst, int src_size);
+void (*shuffle_bytes_3210)(const uint8_t *src, uint8_t *dst, int src_size);
+void (*rgb24to32)(const uint8_t *src, uint8_t *dst, int src_size);
+void (*rgb32to24)(const uint8_t *src, uint8_t *dst, int src_size);
 void (*rgb32tobgr16)(const uint8_t *src, uint8_t *dst, int src_size);
 void (*rgb32tobgr15)(const uint8_t *src, uint8_t *dst, int src_size);
 
@@ -71,6 +77,9 @@ void (*planar2x)(const uint8_t *src, uint8_t *dst, int width, int height,
 void (*interleaveBytes)(const uint8_t *src1, const uint8_t *src2, uint8_t *dst,
                         int width, int height, int src1Stride,
                         int src2Stride, int dstStride);
+void (*deinterleaveBytes)(const uint8_t *src, uint8_t *dst1, uint8_t *dst2,
+                          int width, int height, int srcStride,
+                          int dst1Stride, int dst2Stride);
 void (*vu9_to_vu12)(const uint8_t *src1, const uint8_t *src2,
                     uint8_t *dst1, uint8_t *dst2,
                     int width, int height,
@@ -121,6 +130,8 @@ void sws_rgb2rgb_init(void)
     rgb2rgb_init_c();
     if (HAVE_MMX)
         rgb2rgb_init_x86();
+    if (HAVE_NEON)
+        rgb2rgb_init_arm();
 }
 
 #if LIBSWSCALE_VERSION_MAJOR < 1
@@ -151,43 +162,6 @@ void palette8tobgr16(const uint8_t *src, uint8_t *dst, long num_pixels, const ui
 }
 #endif
 
-void rgb32to24(const uint8_t *src, uint8_t *dst, int src_size)
-{
-    int i;
-    int num_pixels = src_size >> 2;
-    for (i=0; i<num_pixels; i++) {
-#if HAVE_BIGENDIAN
-        /* RGB32 (= A,B,G,R) -> BGR24 (= B,G,R) */
-        dst[3*i + 0] = src[4*i + 1];
-        dst[3*i + 1] = src[4*i + 2];
-        dst[3*i + 2] = src[4*i + 3];
-#else
-        dst[3*i + 0] = src[4*i + 2];
-        dst[3*i + 1] = src[4*i + 1];
-        dst[3*i + 2] = src[4*i + 0];
-#endif
-    }
-}
-
-void rgb24to32(const uint8_t *src, uint8_t *dst, int src_size)
-{
-    int i;
-    for (i=0; 3*i<src_size; i++) {
-#if HAVE_BIGENDIAN
-        /* RGB24 (= R,G,B) -> BGR32 (= A,R,G,B) */
-        dst[4*i + 0] = 255;
-        dst[4*i + 1] = src[3*i + 0];
-        dst[4*i + 2] = src[3*i + 1];
-        dst[4*i + 3] = src[3*i + 2];
-#else
-        dst[4*i + 0] = src[3*i + 2];
-        dst[4*i + 1] = src[3*i + 1];
-        dst[4*i + 2] = src[3*i + 0];
-        dst[4*i + 3] = 255;
-#endif
-    }
-}
-
 void rgb16tobgr32(const uint8_t *src, uint8_t *dst, int src_size)
 {
     const uint16_t *end;
@@ -325,21 +299,4 @@ void bgr8torgb8(const uint8_t *src, uint8_t *dst, int src_size)
     }
 }
 
-#define DEFINE_SHUFFLE_BYTES(a, b, c, d)                                \
-void shuffle_bytes_##a##b##c##d(const uint8_t *src, uint8_t *dst, int src_size) \
-{                                                                       \
-    int i;                                                             \
-                                                                        \
-    for (i = 0; i < src_size; i+=4) {                                   \
-        dst[i + 0] = src[i + a];                                        \
-        dst[i + 1] = src[i + b];                                        \
-        dst[i + 2] = src[i + c];                                        \
-        dst[i + 3] = src[i + d];                                        \
-    }                                                                   \
-}
-
-DEFINE_SHUFFLE_BYTES(0, 3, 2, 1);
-DEFINE_SHUFFLE_BYTES(1, 2, 3, 0);
-DEFINE_SHUFFLE_BYTES(3, 0, 1, 2);
-DEFINE_SHUFFLE_BYTES(3, 2, 1, 0);
 
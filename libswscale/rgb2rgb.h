@@ -48,11 +48,15 @@ extern void (*rgb24tobgr24)(const uint8_t *src, uint8_t *dst, int src_size);
 extern void (*rgb24to16)   (const uint8_t *src, uint8_t *dst, int src_size);
 extern void (*rgb24to15)   (const uint8_t *src, uint8_t *dst, int src_size);
 extern void (*shuffle_bytes_2103)(const uint8_t *src, uint8_t *dst, int src_size);
+extern void (*shuffle_bytes_0321)(const uint8_t *src, uint8_t *dst, int src_size);
+extern void (*shuffle_bytes_1230)(const uint8_t *src, uint8_t *dst, int src_size);
+extern void (*shuffle_bytes_3012)(const uint8_t *src, uint8_t *dst, int src_size);
+extern void (*shuffle_bytes_3210)(const uint8_t *src, uint8_t *dst, int src_size);
+extern void (*rgb24to32)   (const uint8_t *src, uint8_t *dst, int src_size);
+extern void (*rgb32to24)   (const uint8_t *src, uint8_t *dst, int src_size);
 extern void (*rgb32tobgr16)(const uint8_t *src, uint8_t *dst, int src_size);
 extern void (*rgb32tobgr15)(const uint8_t *src, uint8_t *dst, int src_size);
 
-void rgb24to32   (const uint8_t *src, uint8_t *dst, int src_size);
-void rgb32to24   (const uint8_t *src, uint8_t *dst, int src_size);
 void rgb16tobgr32(const uint8_t *src, uint8_t *dst, int src_size);
 void rgb16to24   (const uint8_t *src, uint8_t *dst, int src_size);
 void rgb16tobgr16(const uint8_t *src, uint8_t *dst, int src_size);
@@ -63,11 +67,6 @@ void rgb15tobgr16(const uint8_t *src, uint8_t *dst, int src_size);
 void rgb15tobgr15(const uint8_t *src, uint8_t *dst, int src_size);
 void bgr8torgb8  (const uint8_t *src, uint8_t *dst, int src_size);
 
-void shuffle_bytes_0321(const uint8_t *src, uint8_t *dst, int src_size);
-void shuffle_bytes_1230(const uint8_t *src, uint8_t *dst, int src_size);
-void shuffle_bytes_3012(const uint8_t *src, uint8_t *dst, int src_size);
-void shuffle_bytes_3210(const uint8_t *src, uint8_t *dst, int src_size);
-
 #if LIBSWSCALE_VERSION_MAJOR < 1
 /* deprecated, use the public versions in swscale.h */
 attribute_deprecated void palette8topacked32(const uint8_t *src, uint8_t *dst, long num_pixels, const uint8_t *palette);
@@ -137,6 +136,15 @@ extern void (*interleaveBytes)(const uint8_t *src1, const uint8_t *src2, uint8_t
                                int width, int height, int src1Stride,
                                int src2Stride, int dstStride);
 
+/**
+ * Split the interleaved bytes of src into dst1 (even bytes) and dst2 (odd
+ * bytes), e.g. the chroma plane of NV12 into the U and V planes.
+ * width is the number of bytes written to each destination line.
+ */
+extern void (*deinterleaveBytes)(const uint8_t *src, uint8_t *dst1, uint8_t *dst2,
+                                 int width, int height, int srcStride,
+                                 int dst1Stride, int dst2Stride);
+
 extern void (*vu9_to_vu12)(const uint8_t *src1, const uint8_t *src2,
                            uint8_t *dst1, uint8_t *dst2,
                            int width, int height,
@@ -166,5 +174,6 @@ extern void (*yuyvtoyuv422)(uint8_t *ydst, uint8_t *udst, uint8_t *vdst, const u
 void sws_rgb2rgb_init(void);
 
 void rgb2rgb_init_x86(void);
+void rgb2rgb_init_arm(void);
 
 #endif /* SWSCALE_RGB2RGB_H */
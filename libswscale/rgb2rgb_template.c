@@ -336,6 +336,63 @@ static inline void shuffle_bytes_2103_c(const uint8_t *src, uint8_t *dst, int sr
     }
 }
 
+#define DEFINE_SHUFFLE_BYTES(a, b, c, d)                                \
+static inline void shuffle_bytes_##a##b##c##d##_c(const uint8_t *src,   \
+                                                  uint8_t *dst,         \
+                                                  int src_size)         \
+{                                                                       \
+    int i;                                                             \
+                                                                        \
+    for (i = 0; i < src_size; i+=4) {                                   \
+        dst[i + 0] = src[i + a];                                        \
+        dst[i + 1] = src[i + b];                                        \
+        dst[i + 2] = src[i + c];                                        \
+        dst[i + 3] = src[i + d];                                        \
+    }                                                                   \
+}
+
+DEFINE_SHUFFLE_BYTES(0, 3, 2, 1);
+DEFINE_SHUFFLE_BYTES(1, 2, 3, 0);
+DEFINE_SHUFFLE_BYTES(3, 0, 1, 2);
+DEFINE_SHUFFLE_BYTES(3, 2, 1, 0);
+
+static inline void rgb32to24_c(const uint8_t *src, uint8_t *dst, int src_size)
+{
+    int i;
+    int num_pixels = src_size >> 2;
+    for (i=0; i<num_pixels; i++) {
+#if HAVE_BIGENDIAN
+        /* RGB32 (= A,B,G,R) -> BGR24 (= B,G,R) */
+        dst[3*i + 0] = src[4*i + 1];
+        dst[3*i + 1] = src[4*i + 2];
+        dst[3*i + 2] = src[4*i + 3];
+#else
+        dst[3*i + 0] = src[4*i + 2];
+        dst[3*i + 1] = src[4*i + 1];
+        dst[3*i + 2] = src[4*i + 0];
+#endif
+    }
+}
+
+static inline void rgb24to32_c(const uint8_t *src, uint8_t *dst, int src_size)
+{
+    int i;
+    for (i=0; 3*i<src_size; i++) {
+#if HAVE_BIGENDIAN
+        /* RGB24 (= R,G,B) -> BGR32 (= A,R,G,B) */
+        dst[4*i + 0] = 255;
+        dst[4*i + 1] = src[3*i + 0];
+        dst[4*i + 2] = src[3*i + 1];
+        dst[4*i + 3] = src[3*i + 2];
+#else
+        dst[4*i + 0] = src[3*i + 2];
+        dst[4*i + 1] = src[3*i + 1];
+        dst[4*i + 2] = src[3*i + 0];
+        dst[4*i + 3] = 255;
+#endif
+    }
+}
+
 static inline void rgb24tobgr24_c(const uint8_t *src, uint8_t *dst, int src_size)
 {
     unsigned i;
@@ -364,9 +421,9 @@ static inline void yuvPlanartoyuy2_c(const uint8_t *ysrc, const uint8_t *usrc,
         for (i = 0; i < chromWidth; i += 2) {
             uint64_t k, l;
             k = yc[0] + (uc[0] << 8) +
-                (yc[1] << 16) + (vc[0] << 24);
+                (yc[1] << 16) + ((unsigned)vc[0] << 24);
             l = yc[2] + (uc[1] << 8) +
-                (yc[3] << 16) + (vc[1] << 24);
+                (yc[3] << 16) + ((unsigned)vc[1] << 24);
             *ldst++ = k + (l << 32);
             yc += 4;
             uc += 2;
@@ -382,7 +439,7 @@ static inline void yuvPlanartoyuy2_c(const uint8_t *ysrc, const uint8_t *usrc,
                 (yc[1] << 8) + (vc[0] << 0);
 #else
             *idst++ = yc[0] + (uc[0] << 8) +
-                (yc[1] << 16) + (vc[0] << 24);
+                (yc[1] << 16) + ((unsigned)vc[0] << 24);
 #endif
             yc += 2;
             uc++;
@@ -429,9 +486,9 @@ static inline void yuvPlanartouyvy_c(const uint8_t *ysrc, const uint8_t *usrc,
         for (i = 0; i < chromWidth; i += 2) {
             uint64_t k, l;
             k = uc[0] + (yc[0] << 8) +
-                (vc[0] << 16) + (yc[1] << 24);
+                (vc[0] << 16) + ((unsigned)yc[1] << 24);
             l = uc[1] + (yc[2] << 8) +
-                (vc[1] << 16) + (yc[3] << 24);
+                (vc[1] << 16) + ((unsigned)yc[3] << 24);
             *ldst++ = k + (l << 32);
             yc += 4;
             uc += 2;
@@ -703,6 +760,24 @@ static void interleaveBytes_c(const uint8_t *src1, const uint8_t *src2,
     }
 }
 
+static void deinterleaveBytes_c(const uint8_t *src, uint8_t *dst1, uint8_t *dst2,
+                                int width, int height, int srcStride,
+                                int dst1Stride, int dst2Stride)
+{
+    int h;
+
+    for (h=0; h < height; h++) {
+        int w;
+        for (w=0; w < width; w++) {
+            dst1[w] = src[2*w+0];
+            dst2[w] = src[2*w+1];
+        }
+        src  += srcStride;
+        dst1 += dst1Stride;
+        dst2 += dst2Stride;
+    }
+}
+
 static inline void vu9_to_vu12_c(const uint8_t *src1, const uint8_t *src2,
                                  uint8_t *dst1, uint8_t *dst2,
                                  int width, int height,
@@ -922,6 +997,12 @@ static inline void rgb2rgb_init_c(void)
     rgb24to16          = rgb24to16_c;
     rgb24tobgr24       = rgb24tobgr24_c;
     shuffle_bytes_2103 = shuffle_bytes_2103_c;
+    shuffle_bytes_0321 = shuffle_bytes_0321_c;
+    shuffle_bytes_1230 = shuffle_bytes_1230_c;
+    shuffle_bytes_3012 = shuffle_bytes_3012_c;
+    shuffle_bytes_3210 = shuffle_bytes_3210_c;
+    rgb24to32          = rgb24to32_c;
+    rgb32to24          = rgb32to24_c;
     rgb32tobgr16       = rgb32tobgr16_c;
     rgb32tobgr15       = rgb32tobgr15_c;
     yv12toyuy2         = yv12toyuy2_c;
@@ -932,6 +1013,7 @@ static inline void rgb2rgb_init_c(void)
     planar2x           = planar2x_c;
     rgb24toyv12        = rgb24toyv12_c;
     interleaveBytes    = interleaveBytes_c;
+    deinterleaveBytes  = deinterleaveBytes_c;
     vu9_to_vu12        = vu9_to_vu12_c;
     yvu9_to_yuy2       = yvu9_to_yuy2_c;
 
@@ -67,6 +67,7 @@ untested special converters
 #include "libavutil/mathematics.h"
 #include "libavutil/bswap.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/timer.h"
 
 
 #define RGB2YUV_SHIFT 15
@@ -2186,6 +2187,7 @@ static int swScale(SwsContext *c, const uint8_t* src[],
     const int srcW= c->srcW;
     const int dstW= c->dstW;
     const int dstH= c->dstH;
+    const int dstYEnd= c->dstYEnd;
     const int chrDstW= c->chrDstW;
     const int chrSrcW= c->chrSrcW;
     const int lumXInc= c->lumXInc;
@@ -2231,6 +2233,7 @@ static int swScale(SwsContext *c, const uint8_t* src[],
     int chrBufIndex= c->chrBufIndex;
     int lastInLumBuf= c->lastInLumBuf;
     int lastInChrBuf= c->lastInChrBuf;
+    AV_PROFILE_START(swscale);
 
     if (isPacked(c->srcFormat)) {
         src[0]=
@@ -2268,14 +2271,14 @@ static int swScale(SwsContext *c, const uint8_t* src[],
     if (srcSliceY ==0) {
         lumBufIndex=-1;
         chrBufIndex=-1;
-        dstY=0;
+        dstY=c->dstYStart;
         lastInLumBuf= -1;
         lastInChrBuf= -1;
     }
 
     lastDstY= dstY;
 
-    for (;dstY < dstH; dstY++) {
+    for (;dstY < dstYEnd; dstY++) {
         unsigned char *dest =dst[0]+dstStride[0]*dstY;
         const int chrDstY= dstY>>c->chrDstVSubSample;
         unsigned char *uDest=dst[1]+dstStride[1]*chrDstY;
@@ -2438,6 +2441,7 @@ static int swScale(SwsContext *c, const uint8_t* src[],
     c->lastInLumBuf= lastInLumBuf;
     c->lastInChrBuf= lastInChrBuf;
 
+    AV_PROFILE_STOP(swscale, "swScale");
     return dstY - lastDstY;
 }
 
@@ -2601,6 +2605,8 @@ SwsFunc ff_getSwsFunc(SwsContext *c)
         ff_sws_init_swScale_mmx(c);
     if (HAVE_ALTIVEC)
         ff_sws_init_swScale_altivec(c);
+    if (HAVE_NEON)
+        ff_sws_init_swScale_neon(c);
 
     return swScale;
 }
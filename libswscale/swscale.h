@@ -28,9 +28,10 @@
  */
 
 #include "libavutil/avutil.h"
+#include "libavutil/threadpool.h"
 
 #define LIBSWSCALE_VERSION_MAJOR 2
-#define LIBSWSCALE_VERSION_MINOR 0
+#define LIBSWSCALE_VERSION_MINOR 2
 #define LIBSWSCALE_VERSION_MICRO 0
 
 #define LIBSWSCALE_VERSION_INT  AV_VERSION_INT(LIBSWSCALE_VERSION_MAJOR, \
@@ -184,6 +185,17 @@ int sws_init_context(struct SwsContext *sws_context, SwsFilter *srcFilter, SwsFi
  */
 void sws_freeContext(struct SwsContext *swsContext);
 
+/**
+ * Make the threads of a pool, which may be shared with other libraries,
+ * scale the bands of whole frames when the "threads" option is greater
+ * than 1. Without a pool, the context starts its own when it first
+ * scales a whole frame.
+ *
+ * @param pool the pool, of which the context keeps a reference, or NULL
+ *             to let the context start its own pool again
+ */
+void sws_set_thread_pool(struct SwsContext *swsContext, AVThreadPool *pool);
+
 #if FF_API_SWS_GETCONTEXT
 /**
  * Allocates and returns a SwsContext. You need it to perform
@@ -28,6 +28,7 @@
 #endif
 
 #include "libavutil/avutil.h"
+#include "libavutil/threadpool.h"
 
 #define STR(s)         AV_TOSTRING(s) //AV_STRINGIFY is too long
 
@@ -180,6 +181,10 @@ typedef struct SwsContext {
     int      hChrFilterSize;      ///< Horizontal filter size for chroma     pixels.
     int      vLumFilterSize;      ///< Vertical   filter size for luma/alpha pixels.
     int      vChrFilterSize;      ///< Vertical   filter size for chroma     pixels.
+    struct SwsFilterCacheEntry *hLumFilterEntry; ///< Shared storage of hLumFilter, hLumFilterPos and lumMmx2FilterCode.
+    struct SwsFilterCacheEntry *hChrFilterEntry; ///< Shared storage of hChrFilter, hChrFilterPos and chrMmx2FilterCode.
+    struct SwsFilterCacheEntry *vLumFilterEntry; ///< Shared storage of vLumFilter and vLumFilterPos.
+    struct SwsFilterCacheEntry *vChrFilterEntry; ///< Shared storage of vChrFilter and vChrFilterPos.
     //@}
 
     int lumMmx2FilterCodeSize;    ///< Runtime-generated MMX2 horizontal fast bilinear scaler code size for luma/alpha planes.
@@ -190,6 +195,8 @@ typedef struct SwsContext {
     int canMMX2BeUsed;
 
     int dstY;                     ///< Last destination vertical line output from last slice.
+    int dstYStart;                ///< First destination line output by this context, not 0 only for the bands of a threaded scaler.
+    int dstYEnd;                  ///< Destination line after the last one output by this context.
     int flags;                    ///< Flags passed by the user to select scaler algorithm, optimizations, subsampling, etc...
     void * yuvTable;            // pointer to the yuv->rgb table start so it can be freed()
     uint8_t * table_rV[256];
@@ -325,6 +332,18 @@ typedef struct SwsContext {
 
     int needs_hcscale; ///< Set if there are chroma planes to be converted.
 
+    /**
+     * @name Threaded scaling of whole frames.
+     * Each thread scales a band of the output with its own context. The
+     * band contexts are copies of the main one which share its filters and
+     * tables, and have their own ring buffers and temporary buffers.
+     */
+    //@{
+    int threads;                  ///< Number of threads to use, set by the user.
+    struct SwsContext **slice_ctx; ///< Contexts of the bands of the output.
+    int nb_slice_ctx;             ///< Number of bands of the output.
+    AVThreadPool *thread_pool;    ///< Pool scaling the bands, set by sws_set_thread_pool() or started by ff_sws_thread_init().
+    //@}
 } SwsContext;
 //FIXME check init (where 0)
 
@@ -525,7 +544,33 @@ void ff_swscale_get_unscaled_altivec(SwsContext *c);
  */
 SwsFunc ff_getSwsFunc(SwsContext *c);
 
+int ff_sws_alloc_pix_bufs(SwsContext *c);
+void ff_sws_free_pix_bufs(SwsContext *c);
+
+/**
+ * Set up the band contexts and the thread pool of c, if not done yet.
+ *
+ * @return 0 if whole frames can be scaled with ff_sws_thread_scale(),
+ * a negative value otherwise
+ */
+int ff_sws_thread_init(SwsContext *c);
+
+/**
+ * Scale a whole frame, with each thread scaling a band of the output.
+ *
+ * @return the height of the output, or a negative value if the lines of
+ * dst are not padded enough to be written by several threads
+ */
+int ff_sws_thread_scale(SwsContext *c, const uint8_t *src[], int srcStride[],
+                        uint8_t *dst[], int dstStride[]);
+
+/**
+ * Free the band contexts of c. The thread pool is kept until c is freed.
+ */
+void ff_sws_thread_free(SwsContext *c);
+
 void ff_sws_init_swScale_altivec(SwsContext *c);
 void ff_sws_init_swScale_mmx(SwsContext *c);
+void ff_sws_init_swScale_neon(SwsContext *c);
 
 #endif /* SWSCALE_SWSCALE_INTERNAL_H */
@@ -76,14 +76,36 @@ static int planarToNv12Wrapper(SwsContext *c, const uint8_t* src[], int srcStrid
                                int srcSliceH, uint8_t* dstParam[], int dstStride[])
 {
     uint8_t *dst = dstParam[1] + dstStride[1]*srcSliceY/2;
+    int chrW = -((-c->srcW) >> 1), chrH = -((-srcSliceH) >> 1);
 
     copyPlane(src[0], srcStride[0], srcSliceY, srcSliceH, c->srcW,
               dstParam[0], dstStride[0]);
 
     if (c->dstFormat == PIX_FMT_NV12)
-        interleaveBytes(src[1], src[2], dst, c->srcW/2, srcSliceH/2, srcStride[1], srcStride[2], dstStride[0]);
+        interleaveBytes(src[1], src[2], dst, chrW, chrH, srcStride[1], srcStride[2], dstStride[1]);
     else
-        interleaveBytes(src[2], src[1], dst, c->srcW/2, srcSliceH/2, srcStride[2], srcStride[1], dstStride[0]);
+        interleaveBytes(src[2], src[1], dst, chrW, chrH, srcStride[2], srcStride[1], dstStride[1]);
+
+    return srcSliceH;
+}
+
+static int nv12ToPlanarWrapper(SwsContext *c, const uint8_t* src[], int srcStride[], int srcSliceY,
+                               int srcSliceH, uint8_t* dstParam[], int dstStride[])
+{
+    uint8_t *udst = dstParam[1] + dstStride[1]*srcSliceY/2;
+    uint8_t *vdst = dstParam[2] + dstStride[2]*srcSliceY/2;
+    int chrW = -((-c->srcW) >> 1), chrH = -((-srcSliceH) >> 1);
+
+    copyPlane(src[0], srcStride[0], srcSliceY, srcSliceH, c->srcW,
+              dstParam[0], dstStride[0]);
+
+    if (c->srcFormat == PIX_FMT_NV12)
+        deinterleaveBytes(src[1], udst, vdst, chrW, chrH, srcStride[1], dstStride[1], dstStride[2]);
+    else
+        deinterleaveBytes(src[1], vdst, udst, chrW, chrH, srcStride[1], dstStride[2], dstStride[1]);
+
+    if (dstParam[3])
+        fillPlane(dstParam[3], dstStride[3], c->srcW, srcSliceH, srcSliceY, 255);
 
     return srcSliceH;
 }
@@ -413,22 +435,25 @@ static int packedCopyWrapper(SwsContext *c, const uint8_t* src[], int srcStride[
 }
 
 #define DITHER_COPY(dst, dstStride, src, srcStride, bswap, dbswap)\
-    uint16_t scale= dither_scale[dst_depth-1][src_depth-1];\
+    unsigned scale= dither_scale[dst_depth-1][src_depth-1];\
     int shift= src_depth-dst_depth + dither_scale[src_depth-2][dst_depth-1];\
+    /* the dither pushes the brightest input past the output range, and\
+     * the product past INT_MAX for 16-bit input */\
+    const int max= (1<<dst_depth)-1;\
     for (i = 0; i < height; i++) {\
         const uint8_t *dither= dithers[src_depth-9][i&7];\
         for (j = 0; j < length-7; j+=8){\
-            dst[j+0] = dbswap((bswap(src[j+0]) + dither[0])*scale>>shift);\
-            dst[j+1] = dbswap((bswap(src[j+1]) + dither[1])*scale>>shift);\
-            dst[j+2] = dbswap((bswap(src[j+2]) + dither[2])*scale>>shift);\
-            dst[j+3] = dbswap((bswap(src[j+3]) + dither[3])*scale>>shift);\
-            dst[j+4] = dbswap((bswap(src[j+4]) + dither[4])*scale>>shift);\
-            dst[j+5] = dbswap((bswap(src[j+5]) + dither[5])*scale>>shift);\
-            dst[j+6] = dbswap((bswap(src[j+6]) + dither[6])*scale>>shift);\
-            dst[j+7] = dbswap((bswap(src[j+7]) + dither[7])*scale>>shift);\
+            dst[j+0] = dbswap(FFMIN((bswap(src[j+0]) + dither[0])*scale>>shift, max));\
+            dst[j+1] = dbswap(FFMIN((bswap(src[j+1]) + dither[1])*scale>>shift, max));\
+            dst[j+2] = dbswap(FFMIN((bswap(src[j+2]) + dither[2])*scale>>shift, max));\
+            dst[j+3] = dbswap(FFMIN((bswap(src[j+3]) + dither[3])*scale>>shift, max));\
+            dst[j+4] = dbswap(FFMIN((bswap(src[j+4]) + dither[4])*scale>>shift, max));\
+            dst[j+5] = dbswap(FFMIN((bswap(src[j+5]) + dither[5])*scale>>shift, max));\
+            dst[j+6] = dbswap(FFMIN((bswap(src[j+6]) + dither[6])*scale>>shift, max));\
+            dst[j+7] = dbswap(FFMIN((bswap(src[j+7]) + dither[7])*scale>>shift, max));\
         }\
         for (; j < length; j++)\
-            dst[j] = dbswap((bswap(src[j]) + dither[j&7])*scale>>shift);\
+            dst[j] = dbswap(FFMIN((bswap(src[j]) + dither[j&7])*scale>>shift, max));\
         dst += dstStride;\
         src += srcStride;\
     }
@@ -481,6 +506,26 @@ static int planarCopyWrapper(SwsContext *c, const uint8_t* src[], int srcStride[
                         dstPtr2 += dstStride[plane]/2;
                         srcPtr  += srcStride[plane];
                     }
+                } else if (src_depth <= dst_depth &&
+                           isBE(c->srcFormat) == HAVE_BIGENDIAN &&
+                           isBE(c->dstFormat) == HAVE_BIGENDIAN) {
+                    /* shift 4 native samples at once, masking the bits which
+                     * cross into the neighbouring sample */
+                    const int lshift = dst_depth - src_depth, rshift = 2*src_depth - dst_depth;
+                    const uint64_t lmask = 0x0001000100010001ULL * (0xFFFF & (0xFFFF << lshift));
+                    const uint64_t rmask = 0x0001000100010001ULL * (0xFFFF >> rshift);
+                    for (i = 0; i < height; i++) {
+                        for (j = 0; j < length - 3; j += 4) {
+                            uint64_t v = AV_RN64(&srcPtr2[j]);
+                            AV_WN64(&dstPtr2[j], ((v << lshift) & lmask) | ((v >> rshift) & rmask));
+                        }
+                        for (; j < length; j++) {
+                            unsigned int v = srcPtr2[j];
+                            dstPtr2[j] = (v << lshift) | (v >> rshift);
+                        }
+                        dstPtr2 += dstStride[plane]/2;
+                        srcPtr2 += srcStride[plane]/2;
+                    }
                 } else if (src_depth <= dst_depth) {
                     for (i = 0; i < height; i++) {
 #define COPY_UP(r,w) \
@@ -524,7 +569,12 @@ static int planarCopyWrapper(SwsContext *c, const uint8_t* src[], int srcStride[
                   && isBE(c->srcFormat) != isBE(c->dstFormat)) {
 
                 for (i=0; i<height; i++) {
-                    for (j=0; j<length; j++)
+                    for (j=0; j<length-3; j+=4) {
+                        uint64_t v = AV_RN64(&((const uint16_t*)srcPtr)[j]);
+                        AV_WN64(&((uint16_t*)dstPtr)[j], ((v & 0x00FF00FF00FF00FFULL) << 8) |
+                                                         ((v >> 8) & 0x00FF00FF00FF00FFULL));
+                    }
+                    for (; j<length; j++)
                         ((uint16_t*)dstPtr)[j] = av_bswap16(((const uint16_t*)srcPtr)[j]);
                     srcPtr+= srcStride[plane];
                     dstPtr+= dstStride[plane];
@@ -563,6 +613,10 @@ void ff_get_unscaled_swscale(SwsContext *c)
     if ((srcFormat == PIX_FMT_YUV420P || srcFormat == PIX_FMT_YUVA420P) && (dstFormat == PIX_FMT_NV12 || dstFormat == PIX_FMT_NV21)) {
         c->swScale= planarToNv12Wrapper;
     }
+    /* nv12_to_yv12 */
+    if ((srcFormat == PIX_FMT_NV12 || srcFormat == PIX_FMT_NV21) && (dstFormat == PIX_FMT_YUV420P || dstFormat == PIX_FMT_YUVA420P)) {
+        c->swScale= nv12ToPlanarWrapper;
+    }
     /* yuv2bgr */
     if ((srcFormat==PIX_FMT_YUV420P || srcFormat==PIX_FMT_YUV422P || srcFormat==PIX_FMT_YUVA420P) && isAnyRGB(dstFormat)
         && !(flags & SWS_ACCURATE_RND) && !(dstH&1)) {
@@ -689,7 +743,7 @@ static int check_image_pointers(uint8_t *data[4], enum PixelFormat pix_fmt,
 int sws_scale(SwsContext *c, const uint8_t* const src[], const int srcStride[], int srcSliceY,
               int srcSliceH, uint8_t* const dst[], const int dstStride[])
 {
-    int i;
+    int i, av_unused ret;
     const uint8_t* src2[4]= {src[0], src[1], src[2], src[3]};
     uint8_t* dst2[4]= {dst[0], dst[1], dst[2], dst[3]};
 
@@ -790,6 +844,11 @@ int sws_scale(SwsContext *c, const uint8_t* const src[], const int srcStride[],
         if (srcSliceY + srcSliceH == c->srcH)
             c->sliceDir = 0;
 
+#if HAVE_PTHREADS
+        if (c->threads > 1 && srcSliceH == c->srcH && !ff_sws_thread_init(c) &&
+            (ret = ff_sws_thread_scale(c, src2, srcStride2, dst2, dstStride2)) >= 0)
+            return ret;
+#endif
         return c->swScale(c, src2, srcStride2, srcSliceY, srcSliceH, dst2, dstStride2);
     } else {
         // slices go from bottom to top => we flip the image internally
@@ -813,6 +872,11 @@ int sws_scale(SwsContext *c, const uint8_t* const src[], const int srcStride[],
         if (!srcSliceY)
             c->sliceDir = 0;
 
+#if HAVE_PTHREADS
+        if (c->threads > 1 && srcSliceH == c->srcH && !ff_sws_thread_init(c) &&
+            (ret = ff_sws_thread_scale(c, src2, srcStride2, dst2, dstStride2)) >= 0)
+            return ret;
+#endif
         return c->swScale(c, src2, srcStride2, c->srcH-srcSliceY-srcSliceH, srcSliceH, dst2, dstStride2);
     }
 }
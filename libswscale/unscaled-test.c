@@ -0,0 +1,246 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Check the unscaled special converters against the generic scaler, and
+ * their SIMD versions against the C ones.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#undef HAVE_AV_CONFIG_H
+#include "libavutil/cpu.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/lfg.h"
+#include "libavutil/mem.h"
+#include "libavutil/pixdesc.h"
+#include "swscale.h"
+#include "rgb2rgb.h"
+
+static const struct {
+    enum PixelFormat src, dst;
+    int max_diff;               ///< allowed difference to the generic scaler
+} tests[] = {
+    { PIX_FMT_NV12,        PIX_FMT_YUV420P,     0 },
+    { PIX_FMT_NV21,        PIX_FMT_YUV420P,     0 },
+    { PIX_FMT_NV12,        PIX_FMT_YUVA420P,    0 },
+    { PIX_FMT_YUV420P,     PIX_FMT_NV12,        0 },
+    { PIX_FMT_YUV420P,     PIX_FMT_NV21,        0 },
+    { PIX_FMT_YUV422P,     PIX_FMT_YUYV422,     0 },
+    { PIX_FMT_YUV422P,     PIX_FMT_UYVY422,     0 },
+    { PIX_FMT_YUYV422,     PIX_FMT_YUV422P,     0 },
+    { PIX_FMT_UYVY422,     PIX_FMT_YUV422P,     0 },
+    { PIX_FMT_GRAY8,       PIX_FMT_YUV420P,     1 },
+    { PIX_FMT_YUV420P,     PIX_FMT_GRAY8,       0 },
+    { PIX_FMT_YUV420P10LE, PIX_FMT_YUV420P16LE, 64 },
+    { PIX_FMT_YUV420P10BE, PIX_FMT_YUV420P16LE, 64 },
+    { PIX_FMT_YUV444P9LE,  PIX_FMT_YUV444P16LE, 128 },
+    { PIX_FMT_YUV420P16LE, PIX_FMT_YUV420P16BE, 1 },
+    { PIX_FMT_YUV420P16LE, PIX_FMT_YUV420P10LE, 2 },
+};
+
+static const int sizes[][2] = { { 96, 96 }, { 318, 46 }, { 33, 17 } };
+
+static int is_high_depth(enum PixelFormat fmt)
+{
+    return av_pix_fmt_descriptors[fmt].comp[0].depth_minus1 >= 8;
+}
+
+static int plane_height(enum PixelFormat fmt, int plane, int h)
+{
+    return plane == 1 || plane == 2 ?
+           -((-h) >> av_pix_fmt_descriptors[fmt].log2_chroma_h) : h;
+}
+
+static int alloc_image(uint8_t *data[4], int linesize[4], enum PixelFormat fmt,
+                       int w, int h)
+{
+    int p;
+
+    /* some converters write up to 16 bytes past the lines */
+    av_image_fill_linesizes(linesize, fmt, FFALIGN(w, 16) + 16);
+    for (p = 0; p < 4; p++) {
+        data[p] = NULL;
+        if (linesize[p] && !(data[p] = av_mallocz(linesize[p] * h + 16)))
+            return -1;
+    }
+    return 0;
+}
+
+static void free_image(uint8_t *data[4])
+{
+    int p;
+
+    for (p = 0; p < 4; p++)
+        av_freep(&data[p]);
+}
+
+static void fill_image(uint8_t *data[4], int linesize[4], enum PixelFormat fmt,
+                       int w, int h, AVLFG *rnd)
+{
+    const AVPixFmtDescriptor *desc = &av_pix_fmt_descriptors[fmt];
+    int p, x, y;
+
+    for (p = 0; p < 4 && data[p]; p++) {
+        int bytes = av_image_get_linesize(fmt, w, p);
+
+        for (y = 0; y < plane_height(fmt, p, h); y++) {
+            uint8_t *line = data[p] + y * linesize[p];
+
+            if (is_high_depth(fmt)) {
+                int mask = (1 << (desc->comp[0].depth_minus1 + 1)) - 1;
+                for (x = 0; x < bytes; x += 2) {
+                    if (desc->flags & PIX_FMT_BE)
+                        AV_WB16(line + x, av_lfg_get(rnd) & mask);
+                    else
+                        AV_WL16(line + x, av_lfg_get(rnd) & mask);
+                }
+            } else {
+                for (x = 0; x < bytes; x++)
+                    line[x] = av_lfg_get(rnd);
+            }
+        }
+    }
+}
+
+/**
+ * @return the largest difference between the samples of a and b
+ */
+static int compare_images(uint8_t *a[4], int a_linesize[4],
+                          uint8_t *b[4], int b_linesize[4],
+                          enum PixelFormat fmt, int w, int h)
+{
+    const AVPixFmtDescriptor *desc = &av_pix_fmt_descriptors[fmt];
+    int p, x, y, max_diff = 0;
+
+    for (p = 0; p < 4 && a[p]; p++) {
+        int bytes = av_image_get_linesize(fmt, w, p);
+
+        /* the palette of GRAY8 is not part of the image */
+        if (p == 1 && desc->flags & PIX_FMT_PAL)
+            break;
+        for (y = 0; y < plane_height(fmt, p, h); y++) {
+            const uint8_t *la = a[p] + y * a_linesize[p];
+            const uint8_t *lb = b[p] + y * b_linesize[p];
+
+            if (is_high_depth(fmt)) {
+                for (x = 0; x < bytes; x += 2) {
+                    int va = desc->flags & PIX_FMT_BE ? AV_RB16(la + x) : AV_RL16(la + x);
+                    int vb = desc->flags & PIX_FMT_BE ? AV_RB16(lb + x) : AV_RL16(lb + x);
+                    max_diff = FFMAX(max_diff, FFABS(va - vb));
+                }
+            } else {
+                for (x = 0; x < bytes; x++)
+                    max_diff = FFMAX(max_diff, FFABS(la[x] - lb[x]));
+            }
+        }
+    }
+    return max_diff;
+}
+
+/**
+ * Convert src to dst, with the unscaled special converter if generic is 0
+ * or with the generic scaler otherwise.
+ */
+static int convert(uint8_t *src[4], int src_linesize[4], enum PixelFormat src_fmt,
+                   uint8_t *dst[4], int dst_linesize[4], enum PixelFormat dst_fmt,
+                   int w, int h, int generic)
+{
+    struct SwsContext *sws;
+    SwsFilter filter = { 0 };
+    SwsVector *identity = NULL;
+
+    /* a horizontal filter, even an identity one, disables the special
+     * converters */
+    if (generic) {
+        if (!(identity = sws_getConstVec(0.0, 3)))
+            return -1;
+        identity->coeff[1] = 1.0;
+        filter.lumH = identity;
+    }
+    sws = sws_getContext(w, h, src_fmt, w, h, dst_fmt, SWS_POINT | SWS_BITEXACT,
+                         generic ? &filter : NULL, NULL, NULL);
+    sws_freeVec(identity);
+    if (!sws)
+        return -1;
+    sws_scale(sws, (const uint8_t * const *)src, src_linesize, 0, h, dst, dst_linesize);
+    sws_freeContext(sws);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int cpu_flags = av_get_cpu_flags();
+    int i, s, ret = 0;
+    AVLFG rnd;
+
+    av_lfg_init(&rnd, 1);
+
+    for (i = 0; i < FF_ARRAY_ELEMS(tests); i++) {
+        for (s = 0; s < FF_ARRAY_ELEMS(sizes); s++) {
+            enum PixelFormat src_fmt = tests[i].src, dst_fmt = tests[i].dst;
+            int w = sizes[s][0], h = sizes[s][1];
+            uint8_t *src[4], *fast[4], *fast_c[4], *ref[4];
+            int src_linesize[4], fast_linesize[4], fast_c_linesize[4], ref_linesize[4];
+            int diff_ref, diff_c;
+
+            if (alloc_image(src,    src_linesize,    src_fmt, w, h) < 0 ||
+                alloc_image(fast,   fast_linesize,   dst_fmt, w, h) < 0 ||
+                alloc_image(fast_c, fast_c_linesize, dst_fmt, w, h) < 0 ||
+                alloc_image(ref,    ref_linesize,    dst_fmt, w, h) < 0) {
+                fprintf(stderr, "out of memory\n");
+                return 1;
+            }
+            fill_image(src, src_linesize, src_fmt, w, h, &rnd);
+
+            av_force_cpu_flags(0);
+            sws_rgb2rgb_init();
+            if (convert(src, src_linesize, src_fmt, fast_c, fast_c_linesize, dst_fmt, w, h, 0) < 0 ||
+                convert(src, src_linesize, src_fmt, ref,    ref_linesize,    dst_fmt, w, h, 1) < 0) {
+                fprintf(stderr, "cannot convert %s to %s\n",
+                        av_get_pix_fmt_name(src_fmt), av_get_pix_fmt_name(dst_fmt));
+                return 1;
+            }
+            av_force_cpu_flags(cpu_flags);
+            sws_rgb2rgb_init();
+            convert(src, src_linesize, src_fmt, fast, fast_linesize, dst_fmt, w, h, 0);
+
+            diff_c   = compare_images(fast, fast_linesize, fast_c, fast_c_linesize, dst_fmt, w, h);
+            diff_ref = compare_images(fast, fast_linesize, ref,    ref_linesize,    dst_fmt, w, h);
+            printf("%s -> %s %dx%d: ", av_get_pix_fmt_name(src_fmt),
+                   av_get_pix_fmt_name(dst_fmt), w, h);
+            if (diff_c || diff_ref > tests[i].max_diff) {
+                printf("FAIL (SIMD/C difference %d, generic difference %d)\n",
+                       diff_c, diff_ref);
+                ret = 1;
+            } else {
+                printf("OK\n");
+            }
+
+            free_image(src);
+            free_image(fast);
+            free_image(fast_c);
+            free_image(ref);
+        }
+    }
+    return ret;
+}
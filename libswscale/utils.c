@@ -25,6 +25,9 @@
 #include <math.h>
 #include <stdio.h>
 #include "config.h"
+#if HAVE_PTHREADS
+#include <pthread.h>
+#endif
 #include <assert.h>
 #if HAVE_SYS_MMAN_H
 #include <sys/mman.h>
@@ -702,6 +705,223 @@ static int initMMX2HScaler(int dstW, int xInc, uint8_t *filterCode, int16_t *fil
 }
 #endif /* HAVE_MMX2 */
 
+/**
+ * Filter coefficients, or generated MMX2 scaler code, shared by all the
+ * contexts which need them, so that creating a context for an already seen
+ * geometry does not compute them again.
+ */
+typedef struct SwsFilterCacheEntry {
+    struct SwsFilterCacheEntry *next;
+    int refcount;
+    int cached;                 ///< the entry is in the cache list
+
+    /* key */
+    int mmx2;                   ///< generated MMX2 code rather than an initFilter() result
+    int xInc, srcW, dstW, filterAlign, one, flags, cpu_flags;
+    double param[2];
+
+    int16_t *filter;
+    int16_t *filterPos;
+    int filterSize;
+    uint8_t *code;
+    int codeSize;
+} SwsFilterCacheEntry;
+
+/* Number of unreferenced entries kept for contexts created later, the
+ * least recently released ones are freed first. */
+#define MAX_UNUSED_FILTERS 64
+
+/* Without a lock the contexts do not share their filters. */
+#define USE_FILTER_CACHE HAVE_PTHREADS
+
+#if USE_FILTER_CACHE
+static pthread_mutex_t filter_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static SwsFilterCacheEntry *filter_cache;
+static int filter_cache_unused;
+#endif
+
+static void free_filter_entry(SwsFilterCacheEntry *e)
+{
+    av_free(e->filter);
+    av_free(e->filterPos);
+#if HAVE_MMX
+    if (e->code) {
+#ifdef MAP_ANONYMOUS
+        munmap(e->code, e->codeSize);
+#elif HAVE_VIRTUALALLOC
+        VirtualFree(e->code, 0, MEM_RELEASE);
+#else
+        av_free(e->code);
+#endif
+    }
+#endif /* HAVE_MMX */
+    av_free(e);
+}
+
+static int same_filter_key(const SwsFilterCacheEntry *a, const SwsFilterCacheEntry *b)
+{
+    return a->mmx2        == b->mmx2        && a->xInc     == b->xInc     &&
+           a->srcW        == b->srcW        && a->dstW     == b->dstW     &&
+           a->filterAlign == b->filterAlign && a->one      == b->one      &&
+           a->flags       == b->flags       && a->cpu_flags == b->cpu_flags &&
+           a->param[0]    == b->param[0]    && a->param[1] == b->param[1];
+}
+
+/**
+ * Return a new reference to the cached entry with the key of key, or NULL.
+ */
+static SwsFilterCacheEntry *find_filter_entry(const SwsFilterCacheEntry *key)
+{
+    SwsFilterCacheEntry *e = NULL;
+#if USE_FILTER_CACHE
+    pthread_mutex_lock(&filter_cache_lock);
+    for (e = filter_cache; e; e = e->next)
+        if (same_filter_key(e, key)) {
+            if (!e->refcount++)
+                filter_cache_unused--;
+            break;
+        }
+    pthread_mutex_unlock(&filter_cache_lock);
+#endif
+    return e;
+}
+
+static void add_filter_entry(SwsFilterCacheEntry *e)
+{
+#if USE_FILTER_CACHE
+    pthread_mutex_lock(&filter_cache_lock);
+    e->cached    = 1;
+    e->next      = filter_cache;
+    filter_cache = e;
+    pthread_mutex_unlock(&filter_cache_lock);
+#endif
+}
+
+static void release_filter_entry(SwsFilterCacheEntry **entry)
+{
+    SwsFilterCacheEntry *e = *entry;
+
+    *entry = NULL;
+    if (!e)
+        return;
+#if USE_FILTER_CACHE
+    if (e->cached) {
+        SwsFilterCacheEntry **p, **last_unused = NULL, *unused = NULL;
+
+        pthread_mutex_lock(&filter_cache_lock);
+        if (!--e->refcount) {
+            /* move it to the front, the tail holds the oldest ones */
+            for (p = &filter_cache; *p != e; p = &(*p)->next);
+            *p           = e->next;
+            e->next      = filter_cache;
+            filter_cache = e;
+            if (++filter_cache_unused > MAX_UNUSED_FILTERS) {
+                for (p = &filter_cache; *p; p = &(*p)->next)
+                    if (!(*p)->refcount)
+                        last_unused = p;
+                unused       = *last_unused;
+                *last_unused = unused->next;
+                filter_cache_unused--;
+            }
+        }
+        pthread_mutex_unlock(&filter_cache_lock);
+        if (unused)
+            free_filter_entry(unused);
+        return;
+    }
+#endif
+    free_filter_entry(e);
+}
+
+/**
+ * Same as initFilter(), but share the result with the other contexts
+ * through *entry, which must be released with release_filter_entry().
+ * Filters including user vectors are not shared.
+ */
+static int getFilter(SwsFilterCacheEntry **entry,
+                     int16_t **outFilter, int16_t **filterPos, int *outFilterSize, int xInc,
+                     int srcW, int dstW, int filterAlign, int one, int flags, int cpu_flags,
+                     SwsVector *srcFilter, SwsVector *dstFilter, double param[2])
+{
+    SwsFilterCacheEntry key = {
+        .xInc = xInc, .srcW = srcW, .dstW = dstW, .filterAlign = filterAlign,
+        .one = one, .flags = flags, .cpu_flags = cpu_flags,
+        .param = { param[0], param[1] },
+    };
+    SwsFilterCacheEntry *e = NULL;
+    int shared = !srcFilter && !dstFilter;
+
+    if (!shared || !(e = find_filter_entry(&key))) {
+        if (!(e = av_malloc(sizeof(*e))))
+            return AVERROR(ENOMEM);
+        *e = key;
+        e->refcount = 1;
+        if (initFilter(&e->filter, &e->filterPos, &e->filterSize, xInc, srcW, dstW,
+                       filterAlign, one, flags, cpu_flags, srcFilter, dstFilter, param) < 0) {
+            free_filter_entry(e);
+            return -1;
+        }
+        if (shared)
+            add_filter_entry(e);
+    }
+    *entry         = e;
+    *outFilter     = e->filter;
+    *filterPos     = e->filterPos;
+    *outFilterSize = e->filterSize;
+    return 0;
+}
+
+#if HAVE_MMX2
+/**
+ * Generate the MMX2 fast bilinear scaler for dstW and xInc, or take it
+ * from the cache; see getFilter().
+ */
+static int getMMX2HScaler(SwsFilterCacheEntry **entry, uint8_t **code, int *codeSize,
+                          int16_t **filter, int16_t **filterPos,
+                          int dstW, int xInc, int numSplits)
+{
+    SwsFilterCacheEntry key = { .mmx2 = 1, .xInc = xInc, .dstW = dstW,
+                                .filterAlign = numSplits };
+    SwsFilterCacheEntry *e;
+
+    if (!(e = find_filter_entry(&key))) {
+        if (!(e = av_malloc(sizeof(*e))))
+            return AVERROR(ENOMEM);
+        *e = key;
+        e->refcount = 1;
+        e->codeSize = initMMX2HScaler(dstW, xInc, NULL, NULL, NULL, numSplits);
+#ifdef MAP_ANONYMOUS
+        e->code = mmap(NULL, e->codeSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (e->code == MAP_FAILED)
+            e->code = NULL;
+#elif HAVE_VIRTUALALLOC
+        e->code = VirtualAlloc(NULL, e->codeSize, MEM_COMMIT, PAGE_EXECUTE_READWRITE);
+#else
+        e->code = av_malloc(e->codeSize);
+#endif
+        e->filter    = av_mallocz((dstW  /numSplits+8)*sizeof(int16_t));
+        e->filterPos = av_mallocz((dstW/2/numSplits+8)*sizeof(int32_t));
+        if (!e->code || !e->filter || !e->filterPos) {
+            free_filter_entry(e);
+            return AVERROR(ENOMEM);
+        }
+
+        initMMX2HScaler(dstW, xInc, e->code, e->filter, (int32_t *)e->filterPos, numSplits);
+
+#ifdef MAP_ANONYMOUS
+        mprotect(e->code, e->codeSize, PROT_EXEC | PROT_READ);
+#endif
+        add_filter_entry(e);
+    }
+    *entry     = e;
+    *code      = e->code;
+    *codeSize  = e->codeSize;
+    *filter    = e->filter;
+    *filterPos = e->filterPos;
+    return 0;
+}
+#endif /* HAVE_MMX2 */
+
 static void getSubSampleFactors(int *h, int *v, enum PixelFormat format)
 {
     *h = av_pix_fmt_descriptors[format].log2_chroma_w;
@@ -710,6 +930,11 @@ static void getSubSampleFactors(int *h, int *v, enum PixelFormat format)
 
 int sws_setColorspaceDetails(SwsContext *c, const int inv_table[4], int srcRange, const int table[4], int dstRange, int brightness, int contrast, int saturation)
 {
+#if HAVE_PTHREADS
+    /* the band contexts share the tables, they are set up again with the
+     * new ones by the next sws_scale() call */
+    ff_sws_thread_free(c);
+#endif
     memcpy(c->srcColorspaceTable, inv_table, sizeof(int)*4);
     memcpy(c->dstColorspaceTable,     table, sizeof(int)*4);
 
@@ -767,6 +992,70 @@ SwsContext *sws_alloc_context(void)
     return c;
 }
 
+int ff_sws_alloc_pix_bufs(SwsContext *c)
+{
+    int i;
+    int dst_stride = FFALIGN(c->dstW * sizeof(int16_t)+66, 16), dst_stride_px = dst_stride >> 1;
+
+    // allocate pixbufs (we use dynamic allocation because otherwise we would need to
+    // allocate several megabytes to handle all possible cases)
+    FF_ALLOCZ_OR_GOTO(c, c->lumPixBuf, c->vLumBufSize*2*sizeof(int16_t*), fail);
+    FF_ALLOCZ_OR_GOTO(c, c->chrUPixBuf, c->vChrBufSize*2*sizeof(int16_t*), fail);
+    FF_ALLOCZ_OR_GOTO(c, c->chrVPixBuf, c->vChrBufSize*2*sizeof(int16_t*), fail);
+    if (CONFIG_SWSCALE_ALPHA && isALPHA(c->srcFormat) && isALPHA(c->dstFormat))
+        FF_ALLOCZ_OR_GOTO(c, c->alpPixBuf, c->vLumBufSize*2*sizeof(int16_t*), fail);
+    //Note we need at least one pixel more at the end because of the MMX code (just in case someone wanna replace the 4000/8000)
+    /* align at 16 bytes for AltiVec */
+    for (i=0; i<c->vLumBufSize; i++) {
+        FF_ALLOCZ_OR_GOTO(c, c->lumPixBuf[i+c->vLumBufSize], dst_stride+1, fail);
+        c->lumPixBuf[i] = c->lumPixBuf[i+c->vLumBufSize];
+    }
+    c->uv_off = dst_stride_px;
+    c->uv_offx2 = dst_stride;
+    for (i=0; i<c->vChrBufSize; i++) {
+        FF_ALLOC_OR_GOTO(c, c->chrUPixBuf[i+c->vChrBufSize], dst_stride*2+1, fail);
+        c->chrUPixBuf[i] = c->chrUPixBuf[i+c->vChrBufSize];
+        c->chrVPixBuf[i] = c->chrVPixBuf[i+c->vChrBufSize] = c->chrUPixBuf[i] + dst_stride_px;
+    }
+    if (CONFIG_SWSCALE_ALPHA && c->alpPixBuf)
+        for (i=0; i<c->vLumBufSize; i++) {
+            FF_ALLOCZ_OR_GOTO(c, c->alpPixBuf[i+c->vLumBufSize], dst_stride+1, fail);
+            c->alpPixBuf[i] = c->alpPixBuf[i+c->vLumBufSize];
+        }
+
+    //try to avoid drawing green stuff between the right end and the stride end
+    for (i=0; i<c->vChrBufSize; i++)
+        memset(c->chrUPixBuf[i], 64, dst_stride*2+1);
+
+    return 0;
+fail:
+    return AVERROR(ENOMEM);
+}
+
+void ff_sws_free_pix_bufs(SwsContext *c)
+{
+    int i;
+
+    if (c->lumPixBuf) {
+        for (i=0; i<c->vLumBufSize; i++)
+            av_freep(&c->lumPixBuf[i]);
+        av_freep(&c->lumPixBuf);
+    }
+
+    if (c->chrUPixBuf) {
+        for (i=0; i<c->vChrBufSize; i++)
+            av_freep(&c->chrUPixBuf[i]);
+        av_freep(&c->chrUPixBuf);
+        av_freep(&c->chrVPixBuf);
+    }
+
+    if (CONFIG_SWSCALE_ALPHA && c->alpPixBuf) {
+        for (i=0; i<c->vLumBufSize; i++)
+            av_freep(&c->alpPixBuf[i]);
+        av_freep(&c->alpPixBuf);
+    }
+}
+
 int sws_init_context(SwsContext *c, SwsFilter *srcFilter, SwsFilter *dstFilter)
 {
     int i;
@@ -777,7 +1066,6 @@ int sws_init_context(SwsContext *c, SwsFilter *srcFilter, SwsFilter *dstFilter)
     int srcH= c->srcH;
     int dstW= c->dstW;
     int dstH= c->dstH;
-    int dst_stride = FFALIGN(dstW * sizeof(int16_t)+66, 16), dst_stride_px = dst_stride >> 1;
     int flags, cpu_flags;
     enum PixelFormat srcFormat= c->srcFormat;
     enum PixelFormat dstFormat= c->dstFormat;
@@ -828,6 +1116,7 @@ int sws_init_context(SwsContext *c, SwsFilter *srcFilter, SwsFilter *dstFilter)
     c->dstFormatBpp = av_get_bits_per_pixel(&av_pix_fmt_descriptors[dstFormat]);
     c->srcFormatBpp = av_get_bits_per_pixel(&av_pix_fmt_descriptors[srcFormat]);
     c->vRounder= 4* 0x0001000100010001ULL;
+    c->dstYEnd= dstH;
 
     usesVFilter = (srcFilter->lumV && srcFilter->lumV->length>1) ||
                   (srcFilter->chrV && srcFilter->chrV->length>1) ||
@@ -912,52 +1201,26 @@ int sws_init_context(SwsContext *c, SwsFilter *srcFilter, SwsFilter *dstFilter)
 #if HAVE_MMX2
 // can't downscale !!!
         if (c->canMMX2BeUsed && (flags & SWS_FAST_BILINEAR)) {
-            c->lumMmx2FilterCodeSize = initMMX2HScaler(      dstW, c->lumXInc, NULL, NULL, NULL, 8);
-            c->chrMmx2FilterCodeSize = initMMX2HScaler(c->chrDstW, c->chrXInc, NULL, NULL, NULL, 4);
-
-#ifdef MAP_ANONYMOUS
-            c->lumMmx2FilterCode = mmap(NULL, c->lumMmx2FilterCodeSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-            c->chrMmx2FilterCode = mmap(NULL, c->chrMmx2FilterCodeSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-#elif HAVE_VIRTUALALLOC
-            c->lumMmx2FilterCode = VirtualAlloc(NULL, c->lumMmx2FilterCodeSize, MEM_COMMIT, PAGE_EXECUTE_READWRITE);
-            c->chrMmx2FilterCode = VirtualAlloc(NULL, c->chrMmx2FilterCodeSize, MEM_COMMIT, PAGE_EXECUTE_READWRITE);
-#else
-            c->lumMmx2FilterCode = av_malloc(c->lumMmx2FilterCodeSize);
-            c->chrMmx2FilterCode = av_malloc(c->chrMmx2FilterCodeSize);
-#endif
-
-#ifdef MAP_ANONYMOUS
-            if (c->lumMmx2FilterCode == MAP_FAILED || c->chrMmx2FilterCode == MAP_FAILED)
-#else
-            if (!c->lumMmx2FilterCode || !c->chrMmx2FilterCode)
-#endif
-                return AVERROR(ENOMEM);
-            FF_ALLOCZ_OR_GOTO(c, c->hLumFilter   , (dstW        /8+8)*sizeof(int16_t), fail);
-            FF_ALLOCZ_OR_GOTO(c, c->hChrFilter   , (c->chrDstW  /4+8)*sizeof(int16_t), fail);
-            FF_ALLOCZ_OR_GOTO(c, c->hLumFilterPos, (dstW      /2/8+8)*sizeof(int32_t), fail);
-            FF_ALLOCZ_OR_GOTO(c, c->hChrFilterPos, (c->chrDstW/2/4+8)*sizeof(int32_t), fail);
-
-            initMMX2HScaler(      dstW, c->lumXInc, c->lumMmx2FilterCode, c->hLumFilter, c->hLumFilterPos, 8);
-            initMMX2HScaler(c->chrDstW, c->chrXInc, c->chrMmx2FilterCode, c->hChrFilter, c->hChrFilterPos, 4);
-
-#ifdef MAP_ANONYMOUS
-            mprotect(c->lumMmx2FilterCode, c->lumMmx2FilterCodeSize, PROT_EXEC | PROT_READ);
-            mprotect(c->chrMmx2FilterCode, c->chrMmx2FilterCodeSize, PROT_EXEC | PROT_READ);
-#endif
+            if (getMMX2HScaler(&c->hLumFilterEntry, &c->lumMmx2FilterCode, &c->lumMmx2FilterCodeSize,
+                               &c->hLumFilter, &c->hLumFilterPos,       dstW, c->lumXInc, 8) < 0 ||
+                getMMX2HScaler(&c->hChrFilterEntry, &c->chrMmx2FilterCode, &c->chrMmx2FilterCodeSize,
+                               &c->hChrFilter, &c->hChrFilterPos, c->chrDstW, c->chrXInc, 4) < 0)
+                goto fail;
         } else
 #endif /* HAVE_MMX2 */
         {
             const int filterAlign=
                 (HAVE_MMX     && cpu_flags & AV_CPU_FLAG_MMX) ? 4 :
                 (HAVE_ALTIVEC && cpu_flags & AV_CPU_FLAG_ALTIVEC) ? 8 :
+                HAVE_NEON ? 4 :
                 1;
 
-            if (initFilter(&c->hLumFilter, &c->hLumFilterPos, &c->hLumFilterSize, c->lumXInc,
+            if (getFilter(&c->hLumFilterEntry, &c->hLumFilter, &c->hLumFilterPos, &c->hLumFilterSize, c->lumXInc,
                            srcW      ,       dstW, filterAlign, 1<<14,
                            (flags&SWS_BICUBLIN) ? (flags|SWS_BICUBIC)  : flags, cpu_flags,
                            srcFilter->lumH, dstFilter->lumH, c->param) < 0)
                 goto fail;
-            if (initFilter(&c->hChrFilter, &c->hChrFilterPos, &c->hChrFilterSize, c->chrXInc,
+            if (getFilter(&c->hChrFilterEntry, &c->hChrFilter, &c->hChrFilterPos, &c->hChrFilterSize, c->chrXInc,
                            c->chrSrcW, c->chrDstW, filterAlign, 1<<14,
                            (flags&SWS_BICUBLIN) ? (flags|SWS_BILINEAR) : flags, cpu_flags,
                            srcFilter->chrH, dstFilter->chrH, c->param) < 0)
@@ -972,12 +1235,12 @@ int sws_init_context(SwsContext *c, SwsFilter *srcFilter, SwsFilter *dstFilter)
             (HAVE_ALTIVEC && cpu_flags & AV_CPU_FLAG_ALTIVEC) ? 8 :
             1;
 
-        if (initFilter(&c->vLumFilter, &c->vLumFilterPos, &c->vLumFilterSize, c->lumYInc,
+        if (getFilter(&c->vLumFilterEntry, &c->vLumFilter, &c->vLumFilterPos, &c->vLumFilterSize, c->lumYInc,
                        srcH      ,        dstH, filterAlign, (1<<12),
                        (flags&SWS_BICUBLIN) ? (flags|SWS_BICUBIC)  : flags, cpu_flags,
                        srcFilter->lumV, dstFilter->lumV, c->param) < 0)
             goto fail;
-        if (initFilter(&c->vChrFilter, &c->vChrFilterPos, &c->vChrFilterSize, c->chrYInc,
+        if (getFilter(&c->vChrFilterEntry, &c->vChrFilter, &c->vChrFilterPos, &c->vChrFilterSize, c->chrYInc,
                        c->chrSrcH, c->chrDstH, filterAlign, (1<<12),
                        (flags&SWS_BICUBLIN) ? (flags|SWS_BILINEAR) : flags, cpu_flags,
                        srcFilter->chrV, dstFilter->chrV, c->param) < 0)
@@ -1019,35 +1282,8 @@ int sws_init_context(SwsContext *c, SwsFilter *srcFilter, SwsFilter *dstFilter)
             c->vChrBufSize= (nextSlice>>c->chrSrcVSubSample) - c->vChrFilterPos[chrI];
     }
 
-    // allocate pixbufs (we use dynamic allocation because otherwise we would need to
-    // allocate several megabytes to handle all possible cases)
-    FF_ALLOC_OR_GOTO(c, c->lumPixBuf, c->vLumBufSize*2*sizeof(int16_t*), fail);
-    FF_ALLOC_OR_GOTO(c, c->chrUPixBuf, c->vChrBufSize*2*sizeof(int16_t*), fail);
-    FF_ALLOC_OR_GOTO(c, c->chrVPixBuf, c->vChrBufSize*2*sizeof(int16_t*), fail);
-    if (CONFIG_SWSCALE_ALPHA && isALPHA(c->srcFormat) && isALPHA(c->dstFormat))
-        FF_ALLOCZ_OR_GOTO(c, c->alpPixBuf, c->vLumBufSize*2*sizeof(int16_t*), fail);
-    //Note we need at least one pixel more at the end because of the MMX code (just in case someone wanna replace the 4000/8000)
-    /* align at 16 bytes for AltiVec */
-    for (i=0; i<c->vLumBufSize; i++) {
-        FF_ALLOCZ_OR_GOTO(c, c->lumPixBuf[i+c->vLumBufSize], dst_stride+1, fail);
-        c->lumPixBuf[i] = c->lumPixBuf[i+c->vLumBufSize];
-    }
-    c->uv_off = dst_stride_px;
-    c->uv_offx2 = dst_stride;
-    for (i=0; i<c->vChrBufSize; i++) {
-        FF_ALLOC_OR_GOTO(c, c->chrUPixBuf[i+c->vChrBufSize], dst_stride*2+1, fail);
-        c->chrUPixBuf[i] = c->chrUPixBuf[i+c->vChrBufSize];
-        c->chrVPixBuf[i] = c->chrVPixBuf[i+c->vChrBufSize] = c->chrUPixBuf[i] + dst_stride_px;
-    }
-    if (CONFIG_SWSCALE_ALPHA && c->alpPixBuf)
-        for (i=0; i<c->vLumBufSize; i++) {
-            FF_ALLOCZ_OR_GOTO(c, c->alpPixBuf[i+c->vLumBufSize], dst_stride+1, fail);
-            c->alpPixBuf[i] = c->alpPixBuf[i+c->vLumBufSize];
-        }
-
-    //try to avoid drawing green stuff between the right end and the stride end
-    for (i=0; i<c->vChrBufSize; i++)
-        memset(c->chrUPixBuf[i], 64, dst_stride*2+1);
+    if (ff_sws_alloc_pix_bufs(c) < 0)
+        goto fail;
 
     assert(c->chrDstH <= dstH);
 
@@ -1080,6 +1316,7 @@ int sws_init_context(SwsContext *c, SwsFilter *srcFilter, SwsFilter *dstFilter)
         else if (HAVE_AMD3DNOW && cpu_flags & AV_CPU_FLAG_3DNOW)   av_log(c, AV_LOG_INFO, "using 3DNOW\n");
         else if (HAVE_MMX      && cpu_flags & AV_CPU_FLAG_MMX)     av_log(c, AV_LOG_INFO, "using MMX\n");
         else if (HAVE_ALTIVEC  && cpu_flags & AV_CPU_FLAG_ALTIVEC) av_log(c, AV_LOG_INFO, "using AltiVec\n");
+        else if (HAVE_NEON)                                        av_log(c, AV_LOG_INFO, "using NEON\n");
         else                                   av_log(c, AV_LOG_INFO, "using C\n");
 
         if (HAVE_MMX && cpu_flags & AV_CPU_FLAG_MMX) {
@@ -1494,59 +1731,36 @@ void sws_freeFilter(SwsFilter *filter)
     av_free(filter);
 }
 
+void sws_set_thread_pool(SwsContext *c, AVThreadPool *pool)
+{
+#if HAVE_PTHREADS
+    /* the bands are split again for the threads of the new pool */
+    ff_sws_thread_free(c);
+#endif
+    av_thread_pool_unref(&c->thread_pool);
+    if (pool)
+        c->thread_pool = av_thread_pool_ref(pool);
+}
+
 void sws_freeContext(SwsContext *c)
 {
-    int i;
     if (!c) return;
 
-    if (c->lumPixBuf) {
-        for (i=0; i<c->vLumBufSize; i++)
-            av_freep(&c->lumPixBuf[i]);
-        av_freep(&c->lumPixBuf);
-    }
-
-    if (c->chrUPixBuf) {
-        for (i=0; i<c->vChrBufSize; i++)
-            av_freep(&c->chrUPixBuf[i]);
-        av_freep(&c->chrUPixBuf);
-        av_freep(&c->chrVPixBuf);
-    }
-
-    if (CONFIG_SWSCALE_ALPHA && c->alpPixBuf) {
-        for (i=0; i<c->vLumBufSize; i++)
-            av_freep(&c->alpPixBuf[i]);
-        av_freep(&c->alpPixBuf);
-    }
+#if HAVE_PTHREADS
+    ff_sws_thread_free(c);
+#endif
+    av_thread_pool_unref(&c->thread_pool);
+    ff_sws_free_pix_bufs(c);
 
-    av_freep(&c->vLumFilter);
-    av_freep(&c->vChrFilter);
-    av_freep(&c->hLumFilter);
-    av_freep(&c->hChrFilter);
+    release_filter_entry(&c->vLumFilterEntry);
+    release_filter_entry(&c->vChrFilterEntry);
+    release_filter_entry(&c->hLumFilterEntry);
+    release_filter_entry(&c->hChrFilterEntry);
 #if HAVE_ALTIVEC
     av_freep(&c->vYCoeffsBank);
     av_freep(&c->vCCoeffsBank);
 #endif
 
-    av_freep(&c->vLumFilterPos);
-    av_freep(&c->vChrFilterPos);
-    av_freep(&c->hLumFilterPos);
-    av_freep(&c->hChrFilterPos);
-
-#if HAVE_MMX
-#ifdef MAP_ANONYMOUS
-    if (c->lumMmx2FilterCode) munmap(c->lumMmx2FilterCode, c->lumMmx2FilterCodeSize);
-    if (c->chrMmx2FilterCode) munmap(c->chrMmx2FilterCode, c->chrMmx2FilterCodeSize);
-#elif HAVE_VIRTUALALLOC
-    if (c->lumMmx2FilterCode) VirtualFree(c->lumMmx2FilterCode, 0, MEM_RELEASE);
-    if (c->chrMmx2FilterCode) VirtualFree(c->chrMmx2FilterCode, 0, MEM_RELEASE);
-#else
-    av_free(c->lumMmx2FilterCode);
-    av_free(c->chrMmx2FilterCode);
-#endif
-    c->lumMmx2FilterCode=NULL;
-    c->chrMmx2FilterCode=NULL;
-#endif /* HAVE_MMX */
-
     av_freep(&c->yuvTable);
     av_freep(&c->formatConvBuffer);
 
@@ -116,6 +116,159 @@ DECLARE_ASM_CONST(8, uint64_t, blue_15mask)  = 0x0000001f0000001fULL;
 #define RENAME(a) a ## _3DNOW
 #include "rgb2rgb_template.c"
 
+#if HAVE_SSSE3
+/* pshufb masks, -1 (0x80) clears the byte */
+#define SHUFFLE_MASK(a, b, c, d) \
+    { a, b, c, d, 4 + a, 4 + b, 4 + c, 4 + d, 8 + a, 8 + b, 8 + c, 8 + d, \
+      12 + a, 12 + b, 12 + c, 12 + d }
+DECLARE_ALIGNED(16, static const uint8_t, mask_2103)[16] = SHUFFLE_MASK(2, 1, 0, 3);
+DECLARE_ALIGNED(16, static const uint8_t, mask_0321)[16] = SHUFFLE_MASK(0, 3, 2, 1);
+DECLARE_ALIGNED(16, static const uint8_t, mask_1230)[16] = SHUFFLE_MASK(1, 2, 3, 0);
+DECLARE_ALIGNED(16, static const uint8_t, mask_3012)[16] = SHUFFLE_MASK(3, 0, 1, 2);
+DECLARE_ALIGNED(16, static const uint8_t, mask_3210)[16] = SHUFFLE_MASK(3, 2, 1, 0);
+DECLARE_ALIGNED(16, static const uint8_t, mask_32to24)[16]    = { 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1 };
+DECLARE_ALIGNED(16, static const uint8_t, mask_32tobgr24)[16] = { 0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1 };
+DECLARE_ALIGNED(16, static const uint8_t, mask_24to32)[16]    = { 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1 };
+DECLARE_ALIGNED(16, static const uint8_t, mask_24tobgr32)[16] = { 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1 };
+DECLARE_ALIGNED(16, static const uint8_t, mask_24tobgr24)[16] = { 2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15 };
+DECLARE_ALIGNED(16, static const uint64_t, alpha_32)[2] = { 0xFF000000FF000000ULL, 0xFF000000FF000000ULL };
+DECLARE_ALIGNED(16, static const uint64_t, alpha_none)[2] = { 0 };
+
+/**
+ * Permute count blocks of 16 bytes with pshufb, or them with alpha and
+ * advance by src_step and dst_step bytes after each one. The last
+ * 16 - dst_step bytes of each store are overwritten by the next one.
+ */
+static av_always_inline void shuffle_ssse3(const uint8_t *src, uint8_t *dst, int count,
+                                           const uint8_t *mask, const uint64_t *alpha,
+                                           x86_reg src_step, x86_reg dst_step)
+{
+    x86_reg n = count;
+
+    if (!n)
+        return;
+    __asm__ volatile(
+        "movdqa               %5, %%xmm7    \n\t"
+        "movdqa               %6, %%xmm6    \n\t"
+        ".p2align              4            \n\t"
+        "1:                                 \n\t"
+        "movdqu             (%0), %%xmm0    \n\t"
+        "pshufb           %%xmm7, %%xmm0    \n\t"
+        "por              %%xmm6, %%xmm0    \n\t"
+        "movdqu           %%xmm0, (%1)      \n\t"
+        "add                  %3, %0        \n\t"
+        "add                  %4, %1        \n\t"
+        "dec                  %2            \n\t"
+        " jnz                 1b            \n\t"
+        : "+r" (src), "+r" (dst), "+r" (n)
+        : "r" (src_step), "r" (dst_step), "m" (*mask), "m" (*alpha)
+        : XMM_CLOBBERS("%xmm0", "%xmm6", "%xmm7",) "memory"
+    );
+}
+
+#define SHUFFLE_BYTES_SSSE3(a, b, c, d)                                       \
+static void shuffle_bytes_##a##b##c##d##_ssse3(const uint8_t *src, uint8_t *dst, \
+                                               int src_size)                  \
+{                                                                             \
+    int i = src_size & ~15;                                                   \
+                                                                              \
+    shuffle_ssse3(src, dst, src_size >> 4, mask_##a##b##c##d, alpha_none, 16, 16); \
+    for (; i < src_size; i += 4) {                                            \
+        uint8_t p0 = src[i + 0], p1 = src[i + 1], p2 = src[i + 2], p3 = src[i + 3]; \
+        dst[i + 0] = a == 0 ? p0 : a == 1 ? p1 : a == 2 ? p2 : p3;            \
+        dst[i + 1] = b == 0 ? p0 : b == 1 ? p1 : b == 2 ? p2 : p3;            \
+        dst[i + 2] = c == 0 ? p0 : c == 1 ? p1 : c == 2 ? p2 : p3;            \
+        dst[i + 3] = d == 0 ? p0 : d == 1 ? p1 : d == 2 ? p2 : p3;            \
+    }                                                                         \
+}
+
+SHUFFLE_BYTES_SSSE3(2, 1, 0, 3)
+SHUFFLE_BYTES_SSSE3(0, 3, 2, 1)
+SHUFFLE_BYTES_SSSE3(1, 2, 3, 0)
+SHUFFLE_BYTES_SSSE3(3, 0, 1, 2)
+SHUFFLE_BYTES_SSSE3(3, 2, 1, 0)
+
+/* number of 16-byte stores advancing by step which fit in size bytes */
+#define NB_BLOCKS(size, step) ((size) >= 16 ? ((size) - 16) / (step) + 1 : 0)
+
+static void rgb32to24_ssse3(const uint8_t *src, uint8_t *dst, int src_size)
+{
+    int n = NB_BLOCKS(src_size / 4 * 3, 12), i;
+
+    shuffle_ssse3(src, dst, n, mask_32to24, alpha_none, 16, 12);
+    for (i = 4 * n; i < src_size / 4; i++) {
+        dst[3 * i + 0] = src[4 * i + 2];
+        dst[3 * i + 1] = src[4 * i + 1];
+        dst[3 * i + 2] = src[4 * i + 0];
+    }
+}
+
+static void rgb32tobgr24_ssse3(const uint8_t *src, uint8_t *dst, int src_size)
+{
+    int n = NB_BLOCKS(src_size / 4 * 3, 12), i;
+
+    shuffle_ssse3(src, dst, n, mask_32tobgr24, alpha_none, 16, 12);
+    for (i = 4 * n; i < src_size / 4; i++) {
+        dst[3 * i + 0] = src[4 * i + 0];
+        dst[3 * i + 1] = src[4 * i + 1];
+        dst[3 * i + 2] = src[4 * i + 2];
+    }
+}
+
+static void rgb24to32_ssse3(const uint8_t *src, uint8_t *dst, int src_size)
+{
+    int n = NB_BLOCKS(src_size, 12), i;
+
+    shuffle_ssse3(src, dst, n, mask_24to32, alpha_32, 12, 16);
+    for (i = 4 * n; i < src_size / 3; i++) {
+        dst[4 * i + 0] = src[3 * i + 2];
+        dst[4 * i + 1] = src[3 * i + 1];
+        dst[4 * i + 2] = src[3 * i + 0];
+        dst[4 * i + 3] = 255;
+    }
+}
+
+static void rgb24tobgr32_ssse3(const uint8_t *src, uint8_t *dst, int src_size)
+{
+    int n = NB_BLOCKS(src_size, 12), i;
+
+    shuffle_ssse3(src, dst, n, mask_24tobgr32, alpha_32, 12, 16);
+    for (i = 4 * n; i < src_size / 3; i++) {
+        dst[4 * i + 0] = src[3 * i + 0];
+        dst[4 * i + 1] = src[3 * i + 1];
+        dst[4 * i + 2] = src[3 * i + 2];
+        dst[4 * i + 3] = 255;
+    }
+}
+
+static void rgb24tobgr24_ssse3(const uint8_t *src, uint8_t *dst, int src_size)
+{
+    int n = NB_BLOCKS(src_size, 15), i;
+
+    shuffle_ssse3(src, dst, n, mask_24tobgr24, alpha_none, 15, 15);
+    for (i = 15 * n; i < src_size; i += 3) {
+        uint8_t x  = src[i + 2];
+        dst[i + 1] = src[i + 1];
+        dst[i + 2] = src[i + 0];
+        dst[i + 0] = x;
+    }
+}
+
+static av_cold void rgb2rgb_init_SSSE3(void)
+{
+    shuffle_bytes_2103 = shuffle_bytes_2103_ssse3;
+    shuffle_bytes_0321 = shuffle_bytes_0321_ssse3;
+    shuffle_bytes_1230 = shuffle_bytes_1230_ssse3;
+    shuffle_bytes_3012 = shuffle_bytes_3012_ssse3;
+    shuffle_bytes_3210 = shuffle_bytes_3210_ssse3;
+    rgb32to24          = rgb32to24_ssse3;
+    rgb32tobgr24       = rgb32tobgr24_ssse3;
+    rgb24to32          = rgb24to32_ssse3;
+    rgb24tobgr32       = rgb24tobgr32_ssse3;
+    rgb24tobgr24       = rgb24tobgr24_ssse3;
+}
+#endif /* HAVE_SSSE3 */
+
 /*
  RGB15->RGB16 original by Strepto/Astral
  ported to gcc & bugfixed : A'rpi
@@ -135,4 +288,8 @@ void rgb2rgb_init_x86(void)
         rgb2rgb_init_MMX2();
     if (HAVE_SSE      && cpu_flags & AV_CPU_FLAG_SSE2)
         rgb2rgb_init_SSE2();
+#if HAVE_SSSE3
+    if (cpu_flags & AV_CPU_FLAG_SSSE3)
+        rgb2rgb_init_SSSE3();
+#endif
 }
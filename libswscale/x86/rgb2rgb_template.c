@@ -1971,19 +1971,21 @@ static void RENAME(interleaveBytes)(const uint8_t *src1, const uint8_t *src2, ui
     for (h=0; h < height; h++) {
         int w;
 
+        /* the loop below writes at least 16 pixels */
+        if (width >= 16)
 #if COMPILE_TEMPLATE_SSE2
         __asm__(
             "xor              %%"REG_a", %%"REG_a"  \n\t"
             "1:                                     \n\t"
             PREFETCH" 64(%1, %%"REG_a")             \n\t"
             PREFETCH" 64(%2, %%"REG_a")             \n\t"
-            "movdqa     (%1, %%"REG_a"), %%xmm0     \n\t"
-            "movdqa     (%1, %%"REG_a"), %%xmm1     \n\t"
-            "movdqa     (%2, %%"REG_a"), %%xmm2     \n\t"
+            "movdqu     (%1, %%"REG_a"), %%xmm0     \n\t"
+            "movdqa              %%xmm0, %%xmm1     \n\t"
+            "movdqu     (%2, %%"REG_a"), %%xmm2     \n\t"
             "punpcklbw           %%xmm2, %%xmm0     \n\t"
             "punpckhbw           %%xmm2, %%xmm1     \n\t"
-            "movntdq             %%xmm0,   (%0, %%"REG_a", 2)   \n\t"
-            "movntdq             %%xmm1, 16(%0, %%"REG_a", 2)   \n\t"
+            "movdqu              %%xmm0,   (%0, %%"REG_a", 2)   \n\t"
+            "movdqu              %%xmm1, 16(%0, %%"REG_a", 2)   \n\t"
             "add                    $16, %%"REG_a"  \n\t"
             "cmp                     %3, %%"REG_a"  \n\t"
             " jb                     1b             \n\t"
@@ -2031,6 +2033,85 @@ static void RENAME(interleaveBytes)(const uint8_t *src1, const uint8_t *src2, ui
             ::: "memory"
             );
 }
+
+static void RENAME(deinterleaveBytes)(const uint8_t *src, uint8_t *dst1, uint8_t *dst2,
+                                      int width, int height, int srcStride,
+                                      int dst1Stride, int dst2Stride)
+{
+    int h;
+
+    for (h=0; h < height; h++) {
+        int w;
+
+#if COMPILE_TEMPLATE_SSE2
+        if (width >= 16)
+        __asm__(
+            "pcmpeqw             %%xmm7, %%xmm7     \n\t"
+            "psrlw                   $8, %%xmm7     \n\t" // 0x00FF words
+            "xor              %%"REG_a", %%"REG_a"  \n\t"
+            "1:                                     \n\t"
+            PREFETCH" 128(%0, %%"REG_a", 2)         \n\t"
+            "movdqu   (%0, %%"REG_a", 2), %%xmm0    \n\t"
+            "movdqu 16(%0, %%"REG_a", 2), %%xmm1    \n\t"
+            "movdqa              %%xmm0, %%xmm2     \n\t"
+            "movdqa              %%xmm1, %%xmm3     \n\t"
+            "pand                %%xmm7, %%xmm0     \n\t"
+            "pand                %%xmm7, %%xmm1     \n\t"
+            "psrlw                   $8, %%xmm2     \n\t"
+            "psrlw                   $8, %%xmm3     \n\t"
+            "packuswb            %%xmm1, %%xmm0     \n\t"
+            "packuswb            %%xmm3, %%xmm2     \n\t"
+            "movdqu              %%xmm0, (%1, %%"REG_a")    \n\t"
+            "movdqu              %%xmm2, (%2, %%"REG_a")    \n\t"
+            "add                    $16, %%"REG_a"  \n\t"
+            "cmp                     %3, %%"REG_a"  \n\t"
+            " jb                     1b             \n\t"
+            ::"r"(src), "r"(dst1), "r"(dst2), "r" ((x86_reg)width-15)
+            : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm7",)
+              "memory", "%"REG_a
+        );
+        for (w= (width&(~15)); w < width; w++) {
+#else
+        if (width >= 8)
+        __asm__(
+            "pcmpeqw              %%mm7, %%mm7      \n\t"
+            "psrlw                   $8, %%mm7      \n\t" // 0x00FF words
+            "xor              %%"REG_a", %%"REG_a"  \n\t"
+            "1:                                     \n\t"
+            PREFETCH" 128(%0, %%"REG_a", 2)         \n\t"
+            "movq     (%0, %%"REG_a", 2), %%mm0     \n\t"
+            "movq    8(%0, %%"REG_a", 2), %%mm1     \n\t"
+            "movq                 %%mm0, %%mm2      \n\t"
+            "movq                 %%mm1, %%mm3      \n\t"
+            "pand                 %%mm7, %%mm0      \n\t"
+            "pand                 %%mm7, %%mm1      \n\t"
+            "psrlw                   $8, %%mm2      \n\t"
+            "psrlw                   $8, %%mm3      \n\t"
+            "packuswb             %%mm1, %%mm0      \n\t"
+            "packuswb             %%mm3, %%mm2      \n\t"
+            MOVNTQ"               %%mm0, (%1, %%"REG_a")    \n\t"
+            MOVNTQ"               %%mm2, (%2, %%"REG_a")    \n\t"
+            "add                     $8, %%"REG_a"  \n\t"
+            "cmp                     %3, %%"REG_a"  \n\t"
+            " jb                     1b             \n\t"
+            ::"r"(src), "r"(dst1), "r"(dst2), "r" ((x86_reg)width-7)
+            : "memory", "%"REG_a
+        );
+        for (w= (width&(~7)); w < width; w++) {
+#endif
+            dst1[w] = src[2*w+0];
+            dst2[w] = src[2*w+1];
+        }
+        src  += srcStride;
+        dst1 += dst1Stride;
+        dst2 += dst2Stride;
+    }
+    __asm__(
+            EMMS"       \n\t"
+            SFENCE"     \n\t"
+            ::: "memory"
+            );
+}
 #endif /* !COMPILE_TEMPLATE_AMD3DNOW */
 
 #if !COMPILE_TEMPLATE_SSE2
@@ -2603,5 +2684,6 @@ static inline void RENAME(rgb2rgb_init)(void)
 
 #if !COMPILE_TEMPLATE_AMD3DNOW
     interleaveBytes    = RENAME(interleaveBytes);
+    deinterleaveBytes  = RENAME(deinterleaveBytes);
 #endif /* !COMPILE_TEMPLATE_AMD3DNOW */
 }
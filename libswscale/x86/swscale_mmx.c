@@ -98,6 +98,571 @@ DECLARE_ASM_CONST(8, uint64_t, ff_bgr24toUVOffset)= 0x0040010000400100ULL;
 #include "swscale_template.c"
 #endif
 
+#if HAVE_SSE
+/* SSE2 versions of the vertical scalers, processing 16 pixels per iteration.
+ * The filter tables are the ones built for MMX by updateMMXDitherTables();
+ * their 4 coefficient words are duplicated into the upper half of xmm. */
+#define YSCALEYUV2YV12X_SSE2(offset, dest, end, pos) \
+    __asm__ volatile(\
+        "movdqu                "DITHER16"+0(%0), %%xmm3     \n\t"\
+        "movdqa                          %%xmm3, %%xmm4     \n\t"\
+        "lea                     " offset "(%0), %%"REG_d"  \n\t"\
+        "mov                        (%%"REG_d"), %%"REG_S"  \n\t"\
+        ".p2align                             4             \n\t"\
+        "1:                                                 \n\t"\
+        "movq                      8(%%"REG_d"), %%xmm0     \n\t" /* filterCoeff */\
+        "movdqa              (%%"REG_S", %3, 2), %%xmm2     \n\t" /* srcData */\
+        "movdqa            16(%%"REG_S", %3, 2), %%xmm5     \n\t" /* srcData */\
+        "punpcklqdq                      %%xmm0, %%xmm0     \n\t"\
+        "add                                $16, %%"REG_d"  \n\t"\
+        "mov                        (%%"REG_d"), %%"REG_S"  \n\t"\
+        "test                         %%"REG_S", %%"REG_S"  \n\t"\
+        "pmulhw                          %%xmm0, %%xmm2     \n\t"\
+        "pmulhw                          %%xmm0, %%xmm5     \n\t"\
+        "paddw                           %%xmm2, %%xmm3     \n\t"\
+        "paddw                           %%xmm5, %%xmm4     \n\t"\
+        " jnz                                1b             \n\t"\
+        "psraw                               $3, %%xmm3     \n\t"\
+        "psraw                               $3, %%xmm4     \n\t"\
+        "packuswb                        %%xmm4, %%xmm3     \n\t"\
+        "movdqu                          %%xmm3, (%1, %3)   \n\t"\
+        "add                                $16, %3         \n\t"\
+        "cmp                                 %2, %3         \n\t"\
+        "movdqu                "DITHER16"+0(%0), %%xmm3     \n\t"\
+        "movdqa                          %%xmm3, %%xmm4     \n\t"\
+        "lea                     " offset "(%0), %%"REG_d"  \n\t"\
+        "mov                        (%%"REG_d"), %%"REG_S"  \n\t"\
+        "jb                                  1b             \n\t"\
+        :: "r" (&c->redDither),\
+           "r" (dest), "g" ((x86_reg)(end)), "r"((x86_reg)(pos))\
+        : XMM_CLOBBERS("%xmm0", "%xmm2", "%xmm3", "%xmm4", "%xmm5",)\
+          "%"REG_d, "%"REG_S\
+    );
+
+static void yuv2yuvX_sse2(SwsContext *c, const int16_t *lumFilter,
+                          const int16_t **lumSrc, int lumFilterSize,
+                          const int16_t *chrFilter, const int16_t **chrUSrc,
+                          const int16_t **chrVSrc,
+                          int chrFilterSize, const int16_t **alpSrc,
+                          uint8_t *dest, uint8_t *uDest, uint8_t *vDest,
+                          uint8_t *aDest, int dstW, int chrDstW,
+                          const uint8_t *lumDither, const uint8_t *chrDither)
+{
+    int i;
+    if (uDest) {
+        x86_reg uv_off = c->uv_off;
+        for(i=0; i<8; i++) c->dither16[i] = chrDither[i]>>4;
+        YSCALEYUV2YV12X_SSE2(CHR_MMX_FILTER_OFFSET, uDest, chrDstW, 0)
+        for(i=0; i<8; i++) c->dither16[i] = chrDither[(i+3)&7]>>4;
+        YSCALEYUV2YV12X_SSE2(CHR_MMX_FILTER_OFFSET, vDest - uv_off, chrDstW + uv_off, uv_off)
+    }
+    for(i=0; i<8; i++) c->dither16[i] = lumDither[i]>>4;
+    if (CONFIG_SWSCALE_ALPHA && aDest) {
+        YSCALEYUV2YV12X_SSE2(ALP_MMX_FILTER_OFFSET, aDest, dstW, 0)
+    }
+
+    YSCALEYUV2YV12X_SSE2(LUM_MMX_FILTER_OFFSET, dest, dstW, 0)
+}
+
+/* Unlike the MMX version, the dither is also added to the first 8 pixels
+ * of each line, which makes the output identical to the C code. */
+#define YSCALEYUV2YV12X_ACCURATE_SSE2(offset, dest, end, pos) \
+    __asm__ volatile(\
+        "lea                     " offset "(%0), %%"REG_d"  \n\t"\
+        "movdqu                "DITHER32"+0(%0), %%xmm4     \n\t"\
+        "movdqu               "DITHER32"+16(%0), %%xmm5     \n\t"\
+        "movdqa                          %%xmm4, %%xmm6     \n\t"\
+        "movdqa                          %%xmm5, %%xmm7     \n\t"\
+        "mov                        (%%"REG_d"), %%"REG_S"  \n\t"\
+        ".p2align                             4             \n\t"\
+        "1:                                                 \n\t"\
+        "movdqa              (%%"REG_S", %3, 2), %%xmm0     \n\t" /* srcData */\
+        "movdqa            16(%%"REG_S", %3, 2), %%xmm2     \n\t" /* srcData */\
+        "mov        "STR(APCK_PTR2)"(%%"REG_d"), %%"REG_S"  \n\t"\
+        "movdqa              (%%"REG_S", %3, 2), %%xmm1     \n\t" /* srcData */\
+        "movdqa                          %%xmm0, %%xmm3     \n\t"\
+        "punpcklwd                       %%xmm1, %%xmm0     \n\t"\
+        "punpckhwd                       %%xmm1, %%xmm3     \n\t"\
+        "movq       "STR(APCK_COEF)"(%%"REG_d"), %%xmm1     \n\t" /* filterCoeff */\
+        "punpcklqdq                      %%xmm1, %%xmm1     \n\t"\
+        "pmaddwd                         %%xmm1, %%xmm0     \n\t"\
+        "pmaddwd                         %%xmm1, %%xmm3     \n\t"\
+        "paddd                           %%xmm0, %%xmm4     \n\t"\
+        "paddd                           %%xmm3, %%xmm5     \n\t"\
+        "movdqa            16(%%"REG_S", %3, 2), %%xmm3     \n\t" /* srcData */\
+        "mov        "STR(APCK_SIZE)"(%%"REG_d"), %%"REG_S"  \n\t"\
+        "add                  $"STR(APCK_SIZE)", %%"REG_d"  \n\t"\
+        "test                         %%"REG_S", %%"REG_S"  \n\t"\
+        "movdqa                          %%xmm2, %%xmm0     \n\t"\
+        "punpcklwd                       %%xmm3, %%xmm2     \n\t"\
+        "punpckhwd                       %%xmm3, %%xmm0     \n\t"\
+        "pmaddwd                         %%xmm1, %%xmm2     \n\t"\
+        "pmaddwd                         %%xmm1, %%xmm0     \n\t"\
+        "paddd                           %%xmm2, %%xmm6     \n\t"\
+        "paddd                           %%xmm0, %%xmm7     \n\t"\
+        " jnz                                1b             \n\t"\
+        "psrad                              $19, %%xmm4     \n\t"\
+        "psrad                              $19, %%xmm5     \n\t"\
+        "psrad                              $19, %%xmm6     \n\t"\
+        "psrad                              $19, %%xmm7     \n\t"\
+        "packssdw                        %%xmm5, %%xmm4     \n\t"\
+        "packssdw                        %%xmm7, %%xmm6     \n\t"\
+        "packuswb                        %%xmm6, %%xmm4     \n\t"\
+        "movdqu                          %%xmm4, (%1, %3)   \n\t"\
+        "add                                $16, %3         \n\t"\
+        "cmp                                 %2, %3         \n\t"\
+        "lea                     " offset "(%0), %%"REG_d"  \n\t"\
+        "movdqu                "DITHER32"+0(%0), %%xmm4     \n\t"\
+        "movdqu               "DITHER32"+16(%0), %%xmm5     \n\t"\
+        "movdqa                          %%xmm4, %%xmm6     \n\t"\
+        "movdqa                          %%xmm5, %%xmm7     \n\t"\
+        "mov                        (%%"REG_d"), %%"REG_S"  \n\t"\
+        "jb                                  1b             \n\t"\
+        :: "r" (&c->redDither),\
+        "r" (dest), "g" ((x86_reg)(end)), "r"((x86_reg)(pos))\
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3",\
+                       "%xmm4", "%xmm5", "%xmm6", "%xmm7",)\
+          "%"REG_d, "%"REG_S\
+    );
+
+static void yuv2yuvX_ar_sse2(SwsContext *c, const int16_t *lumFilter,
+                             const int16_t **lumSrc, int lumFilterSize,
+                             const int16_t *chrFilter, const int16_t **chrUSrc,
+                             const int16_t **chrVSrc,
+                             int chrFilterSize, const int16_t **alpSrc,
+                             uint8_t *dest, uint8_t *uDest, uint8_t *vDest,
+                             uint8_t *aDest, int dstW, int chrDstW,
+                             const uint8_t *lumDither, const uint8_t *chrDither)
+{
+    int i;
+    if (uDest) {
+        x86_reg uv_off = c->uv_off;
+        for(i=0; i<8; i++) c->dither32[i] = chrDither[i]<<12;
+        YSCALEYUV2YV12X_ACCURATE_SSE2(CHR_MMX_FILTER_OFFSET, uDest, chrDstW, 0)
+        for(i=0; i<8; i++) c->dither32[i] = chrDither[(i+3)&7]<<12;
+        YSCALEYUV2YV12X_ACCURATE_SSE2(CHR_MMX_FILTER_OFFSET, vDest - uv_off, chrDstW + uv_off, uv_off)
+    }
+    for(i=0; i<8; i++) c->dither32[i] = lumDither[i]<<12;
+    if (CONFIG_SWSCALE_ALPHA && aDest) {
+        YSCALEYUV2YV12X_ACCURATE_SSE2(ALP_MMX_FILTER_OFFSET, aDest, dstW, 0)
+    }
+
+    YSCALEYUV2YV12X_ACCURATE_SSE2(LUM_MMX_FILTER_OFFSET, dest, dstW, 0)
+}
+
+static void yuv2yuv1_sse2(SwsContext *c, const int16_t *lumSrc,
+                          const int16_t *chrUSrc, const int16_t *chrVSrc,
+                          const int16_t *alpSrc,
+                          uint8_t *dest, uint8_t *uDest, uint8_t *vDest,
+                          uint8_t *aDest, int dstW, int chrDstW,
+                          const uint8_t *lumDither, const uint8_t *chrDither)
+{
+    int p= 4;
+    const int16_t *src[4]= { alpSrc + dstW, lumSrc + dstW, chrUSrc + chrDstW, chrVSrc + chrDstW };
+    uint8_t *dst[4]= { aDest, dest, uDest, vDest };
+    x86_reg counter[4]= { dstW, dstW, chrDstW, chrDstW };
+
+    while (p--) {
+        if (dst[p]) {
+            __asm__ volatile(
+                "mov %2, %%"REG_a"                      \n\t"
+                ".p2align                4              \n\t"
+                "1:                                     \n\t"
+                "movdqu   (%0, %%"REG_a", 2), %%xmm0    \n\t"
+                "movdqu 16(%0, %%"REG_a", 2), %%xmm1    \n\t"
+                "psraw                  $7, %%xmm0      \n\t"
+                "psraw                  $7, %%xmm1      \n\t"
+                "packuswb           %%xmm1, %%xmm0      \n\t"
+                "movdqu             %%xmm0, (%1, %%"REG_a") \n\t"
+                "add                   $16, %%"REG_a"   \n\t"
+                "jnc                    1b              \n\t"
+                :: "r" (src[p]), "r" (dst[p] + counter[p]),
+                   "g" (-counter[p])
+                : XMM_CLOBBERS("%xmm0", "%xmm1",) "%"REG_a
+            );
+        }
+    }
+}
+
+static void yuv2yuv1_ar_sse2(SwsContext *c, const int16_t *lumSrc,
+                             const int16_t *chrUSrc, const int16_t *chrVSrc,
+                             const int16_t *alpSrc,
+                             uint8_t *dest, uint8_t *uDest, uint8_t *vDest,
+                             uint8_t *aDest, int dstW, int chrDstW,
+                             const uint8_t *lumDither, const uint8_t *chrDither)
+{
+    int p= 4;
+    const int16_t *src[4]= { alpSrc + dstW, lumSrc + dstW, chrUSrc + chrDstW, chrVSrc + chrDstW };
+    uint8_t *dst[4]= { aDest, dest, uDest, vDest };
+    x86_reg counter[4]= { dstW, dstW, chrDstW, chrDstW };
+
+    while (p--) {
+        if (dst[p]) {
+            int i;
+            for(i=0; i<8; i++) c->dither16[i] = i<2 ? lumDither[i] : chrDither[i];
+            __asm__ volatile(
+                "mov %2, %%"REG_a"                      \n\t"
+                "movdqu                (%3), %%xmm6     \n\t"
+                ".p2align                4              \n\t"
+                "1:                                     \n\t"
+                "movdqu   (%0, %%"REG_a", 2), %%xmm0    \n\t"
+                "movdqu 16(%0, %%"REG_a", 2), %%xmm1    \n\t"
+                "paddsw             %%xmm6, %%xmm0      \n\t"
+                "paddsw             %%xmm6, %%xmm1      \n\t"
+                "psraw                  $7, %%xmm0      \n\t"
+                "psraw                  $7, %%xmm1      \n\t"
+                "packuswb           %%xmm1, %%xmm0      \n\t"
+                "movdqu             %%xmm0, (%1, %%"REG_a") \n\t"
+                "add                   $16, %%"REG_a"   \n\t"
+                "jnc                    1b              \n\t"
+                :: "r" (src[p]), "r" (dst[p] + counter[p]),
+                   "g" (-counter[p]), "r"(c->dither16)
+                : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm6",) "%"REG_a
+            );
+        }
+    }
+}
+#endif /* HAVE_SSE */
+
+#if HAVE_SSE && ARCH_X86_64
+DECLARE_ASM_CONST(16, uint64_t, w8000)[2] = { 0x8000800080008000ULL, 0x8000800080008000ULL };
+
+/* Source fixups for the SSE2 16-bit horizontal scalers: byteswap the
+ * samples of big-endian input and, for full 16-bit input, make them signed
+ * for pmaddwd. The bias of -0x8000 per sample is removed from the sums by
+ * subtracting pmaddwd(filter, 0x8000), which keeps the output identical to
+ * the C code. */
+#define HSCALE16_NONE(reg)
+#define HSCALE16_SWAP(reg) \
+    "movdqa                 "reg", %%xmm5     \n\t"\
+    "psllw                     $8, "reg"      \n\t"\
+    "psrlw                     $8, %%xmm5     \n\t"\
+    "por                   %%xmm5, "reg"      \n\t"
+#define HSCALE16_BIAS(reg) \
+    "pxor                  %%xmm6, "reg"      \n\t"
+#define HSCALE16_SWAP_BIAS(reg) HSCALE16_SWAP(reg) HSCALE16_BIAS(reg)
+#define HSCALE16_SUM_NONE(sum, filt)
+#define HSCALE16_SUM_BIAS(sum, filt) \
+    "pmaddwd               %%xmm6, "filt"     \n\t"\
+    "psubd                 "filt", "sum"      \n\t"
+
+/**
+ * Define name4, name8 and nameX, which scale the first pixels of a line
+ * with filters of 4, 8 and any multiple of 4 taps. They return the number
+ * of pixels done; the caller scales the remaining ones.
+ */
+#define HSCALE16_FUNCS(name, FIX_SRC, FIX_SUM)                          \
+static int name ## 4(int16_t *dst, int dstW, const uint16_t *src,      \
+                     const int16_t *filter, const int16_t *filterPos,   \
+                     int shift)                                         \
+{                                                                       \
+    int n = dstW & ~3;                                                  \
+    x86_reg counter = -2 * n, pos;                                      \
+                                                                        \
+    if (!n)                                                             \
+        return 0;                                                       \
+    __asm__ volatile(                                                   \
+        "movd                      %6, %%xmm7     \n\t"                 \
+        "movdqa                    %7, %%xmm6     \n\t"                 \
+        ".p2align                  4              \n\t"                 \
+        "1:                                       \n\t"                 \
+        "movzwl              (%2, %0), %k1        \n\t"                 \
+        "movq            (%3, %1, 2), %%xmm0     \n\t"                 \
+        "movzwl             2(%2, %0), %k1        \n\t"                 \
+        "movhps          (%3, %1, 2), %%xmm0     \n\t"                 \
+        "movzwl             4(%2, %0), %k1        \n\t"                 \
+        "movq            (%3, %1, 2), %%xmm1     \n\t"                 \
+        "movzwl             6(%2, %0), %k1        \n\t"                 \
+        "movhps          (%3, %1, 2), %%xmm1     \n\t"                 \
+        "movdqu          (%4, %0, 4), %%xmm2     \n\t"                 \
+        "movdqu        16(%4, %0, 4), %%xmm3     \n\t"                 \
+        FIX_SRC("%%xmm0")                                               \
+        FIX_SRC("%%xmm1")                                               \
+        "pmaddwd               %%xmm2, %%xmm0     \n\t"                 \
+        "pmaddwd               %%xmm3, %%xmm1     \n\t"                 \
+        FIX_SUM("%%xmm0", "%%xmm2")                                     \
+        FIX_SUM("%%xmm1", "%%xmm3")                                     \
+        "pshufd          $0xD8, %%xmm0, %%xmm0    \n\t"                 \
+        "pshufd          $0xD8, %%xmm1, %%xmm1    \n\t"                 \
+        "movdqa                %%xmm0, %%xmm2     \n\t"                 \
+        "punpcklqdq            %%xmm1, %%xmm0     \n\t"                 \
+        "punpckhqdq            %%xmm1, %%xmm2     \n\t"                 \
+        "paddd                 %%xmm2, %%xmm0     \n\t"                 \
+        "psrad                 %%xmm7, %%xmm0     \n\t"                 \
+        "packssdw              %%xmm0, %%xmm0     \n\t"                 \
+        "movq                  %%xmm0, (%5, %0)   \n\t"                 \
+        "add                       $8, %0         \n\t"                 \
+        " jnc                      1b             \n\t"                 \
+        : "+r" (counter), "=&r" (pos)                                   \
+        : "r" (filterPos + n), "r" (src), "r" (filter + 4 * n),         \
+          "r" (dst + n), "r" (shift), "m" (w8000[0])                    \
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3",              \
+                       "%xmm5", "%xmm6", "%xmm7",) "memory"             \
+    );                                                                  \
+    return n;                                                           \
+}                                                                       \
+                                                                        \
+static int name ## 8(int16_t *dst, int dstW, const uint16_t *src,      \
+                     const int16_t *filter, const int16_t *filterPos,   \
+                     int shift)                                         \
+{                                                                       \
+    int n = dstW & ~3;                                                  \
+    x86_reg counter = -2 * n, pos;                                      \
+                                                                        \
+    if (!n)                                                             \
+        return 0;                                                       \
+    __asm__ volatile(                                                   \
+        "movd                      %6, %%xmm7     \n\t"                 \
+        "movdqa                    %7, %%xmm6     \n\t"                 \
+        ".p2align                  4              \n\t"                 \
+        "1:                                       \n\t"                 \
+        "movzwl              (%2, %0), %k1        \n\t"                 \
+        "movdqu          (%3, %1, 2), %%xmm0     \n\t"                 \
+        "movzwl             2(%2, %0), %k1        \n\t"                 \
+        "movdqu          (%3, %1, 2), %%xmm1     \n\t"                 \
+        "movzwl             4(%2, %0), %k1        \n\t"                 \
+        "movdqu          (%3, %1, 2), %%xmm2     \n\t"                 \
+        "movzwl             6(%2, %0), %k1        \n\t"                 \
+        "movdqu          (%3, %1, 2), %%xmm3     \n\t"                 \
+        FIX_SRC("%%xmm0")                                               \
+        FIX_SRC("%%xmm1")                                               \
+        FIX_SRC("%%xmm2")                                               \
+        FIX_SRC("%%xmm3")                                               \
+        "movdqu          (%4, %0, 8), %%xmm4     \n\t"                 \
+        "pmaddwd               %%xmm4, %%xmm0     \n\t"                 \
+        FIX_SUM("%%xmm0", "%%xmm4")                                     \
+        "movdqu        16(%4, %0, 8), %%xmm4     \n\t"                 \
+        "pmaddwd               %%xmm4, %%xmm1     \n\t"                 \
+        FIX_SUM("%%xmm1", "%%xmm4")                                     \
+        "movdqu        32(%4, %0, 8), %%xmm4     \n\t"                 \
+        "pmaddwd               %%xmm4, %%xmm2     \n\t"                 \
+        FIX_SUM("%%xmm2", "%%xmm4")                                     \
+        "movdqu        48(%4, %0, 8), %%xmm4     \n\t"                 \
+        "pmaddwd               %%xmm4, %%xmm3     \n\t"                 \
+        FIX_SUM("%%xmm3", "%%xmm4")                                     \
+        "movdqa                %%xmm0, %%xmm4     \n\t"                 \
+        "punpckldq             %%xmm1, %%xmm0     \n\t"                 \
+        "punpckhdq             %%xmm1, %%xmm4     \n\t"                 \
+        "paddd                 %%xmm4, %%xmm0     \n\t"                 \
+        "movdqa                %%xmm2, %%xmm4     \n\t"                 \
+        "punpckldq             %%xmm3, %%xmm2     \n\t"                 \
+        "punpckhdq             %%xmm3, %%xmm4     \n\t"                 \
+        "paddd                 %%xmm4, %%xmm2     \n\t"                 \
+        "movdqa                %%xmm0, %%xmm1     \n\t"                 \
+        "punpcklqdq            %%xmm2, %%xmm0     \n\t"                 \
+        "punpckhqdq            %%xmm2, %%xmm1     \n\t"                 \
+        "paddd                 %%xmm1, %%xmm0     \n\t"                 \
+        "psrad                 %%xmm7, %%xmm0     \n\t"                 \
+        "packssdw              %%xmm0, %%xmm0     \n\t"                 \
+        "movq                  %%xmm0, (%5, %0)   \n\t"                 \
+        "add                       $8, %0         \n\t"                 \
+        " jnc                      1b             \n\t"                 \
+        : "+r" (counter), "=&r" (pos)                                   \
+        : "r" (filterPos + n), "r" (src), "r" (filter + 8 * n),         \
+          "r" (dst + n), "r" (shift), "m" (w8000[0])                    \
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4",     \
+                       "%xmm5", "%xmm6", "%xmm7",) "memory"             \
+    );                                                                  \
+    return n;                                                           \
+}                                                                       \
+                                                                        \
+static int name ## X(int16_t *dst, int dstW, const uint16_t *src,      \
+                     const int16_t *filter, const int16_t *filterPos,   \
+                     int filterSize, int shift)                         \
+{                                                                       \
+    int i;                                                              \
+                                                                        \
+    /* two pixels at a time, 8 taps per step and 4 for the remainder */ \
+    for (i = 0; i + 2 <= dstW; i += 2) {                                \
+        const uint16_t *src0 = src + filterPos[i]     + filterSize;     \
+        const uint16_t *src1 = src + filterPos[i + 1] + filterSize;     \
+        const int16_t  *f0   = filter + filterSize * i + filterSize;    \
+        const int16_t  *f1   = f0 + filterSize;                         \
+        x86_reg j = -2 * filterSize;                                    \
+                                                                        \
+        __asm__ volatile(                                               \
+            "movd                  %6, %%xmm7     \n\t"                 \
+            "movdqa                %7, %%xmm6     \n\t"                 \
+            "pxor              %%xmm2, %%xmm2     \n\t"                 \
+            "pxor              %%xmm3, %%xmm3     \n\t"                 \
+            "test                  $8, %0         \n\t"                 \
+            " jz                   1f             \n\t"                 \
+            "movq            (%1, %0), %%xmm0     \n\t"                 \
+            "movq            (%2, %0), %%xmm1     \n\t"                 \
+            "movq            (%3, %0), %%xmm4     \n\t"                 \
+            FIX_SRC("%%xmm0")                                           \
+            FIX_SRC("%%xmm1")                                           \
+            "pmaddwd           %%xmm4, %%xmm0     \n\t"                 \
+            FIX_SUM("%%xmm0", "%%xmm4")                                 \
+            "movq            (%4, %0), %%xmm4     \n\t"                 \
+            "pmaddwd           %%xmm4, %%xmm1     \n\t"                 \
+            FIX_SUM("%%xmm1", "%%xmm4")                                 \
+            "paddd             %%xmm0, %%xmm2     \n\t"                 \
+            "paddd             %%xmm1, %%xmm3     \n\t"                 \
+            "add                   $8, %0         \n\t"                 \
+            " jz                   2f             \n\t"                 \
+            ".p2align              4              \n\t"                 \
+            "1:                                   \n\t"                 \
+            "movdqu          (%1, %0), %%xmm0     \n\t"                 \
+            "movdqu          (%2, %0), %%xmm1     \n\t"                 \
+            "movdqu          (%3, %0), %%xmm4     \n\t"                 \
+            FIX_SRC("%%xmm0")                                           \
+            FIX_SRC("%%xmm1")                                           \
+            "pmaddwd           %%xmm4, %%xmm0     \n\t"                 \
+            FIX_SUM("%%xmm0", "%%xmm4")                                 \
+            "movdqu          (%4, %0), %%xmm4     \n\t"                 \
+            "pmaddwd           %%xmm4, %%xmm1     \n\t"                 \
+            FIX_SUM("%%xmm1", "%%xmm4")                                 \
+            "paddd             %%xmm0, %%xmm2     \n\t"                 \
+            "paddd             %%xmm1, %%xmm3     \n\t"                 \
+            "add                  $16, %0         \n\t"                 \
+            " jnz                  1b             \n\t"                 \
+            "2:                                   \n\t"                 \
+            "movdqa            %%xmm2, %%xmm0     \n\t"                 \
+            "punpckldq         %%xmm3, %%xmm2     \n\t"                 \
+            "punpckhdq         %%xmm3, %%xmm0     \n\t"                 \
+            "paddd             %%xmm0, %%xmm2     \n\t"                 \
+            "pshufd      $0x4E, %%xmm2, %%xmm0    \n\t"                 \
+            "paddd             %%xmm0, %%xmm2     \n\t"                 \
+            "psrad             %%xmm7, %%xmm2     \n\t"                 \
+            "packssdw          %%xmm2, %%xmm2     \n\t"                 \
+            "movd              %%xmm2, (%5)       \n\t"                 \
+            : "+r" (j)                                                  \
+            : "r" (src0), "r" (src1), "r" (f0), "r" (f1),               \
+              "r" (dst + i), "r" (shift), "m" (w8000[0])                \
+            : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4", \
+                           "%xmm5", "%xmm6", "%xmm7",) "memory"         \
+        );                                                              \
+    }                                                                   \
+    return i;                                                           \
+}
+
+HSCALE16_FUNCS(hscale16_sse2_,           HSCALE16_NONE,      HSCALE16_SUM_NONE)
+HSCALE16_FUNCS(hscale16_sse2_bias_,      HSCALE16_BIAS,      HSCALE16_SUM_BIAS)
+HSCALE16_FUNCS(hscale16_sse2_swap_,      HSCALE16_SWAP,      HSCALE16_SUM_NONE)
+HSCALE16_FUNCS(hscale16_sse2_swap_bias_, HSCALE16_SWAP_BIAS, HSCALE16_SUM_BIAS)
+
+#define HSCALE16(name, READ)                                                    \
+static void name(int16_t *dst, int dstW, const uint16_t *src, int srcW,         \
+                 int xInc, const int16_t *filter, const int16_t *filterPos,     \
+                 long filterSize, int shift)                                    \
+{                                                                               \
+    int i = 0, j;                                                               \
+                                                                                \
+    if (filterSize == 4)                                                        \
+        i = shift < 15 ? name ## _4     (dst, dstW, src, filter, filterPos, shift) \
+                       : name ## _bias_4(dst, dstW, src, filter, filterPos, shift);\
+    else if (filterSize == 8)                                                   \
+        i = shift < 15 ? name ## _8     (dst, dstW, src, filter, filterPos, shift) \
+                       : name ## _bias_8(dst, dstW, src, filter, filterPos, shift);\
+    else if (!(filterSize & 3))                                                 \
+        i = shift < 15 ? name ## _X     (dst, dstW, src, filter, filterPos, filterSize, shift) \
+                       : name ## _bias_X(dst, dstW, src, filter, filterPos, filterSize, shift);\
+                                                                                \
+    for (; i < dstW; i++) {                                                     \
+        int srcPos = filterPos[i];                                              \
+        int val = 0;                                                            \
+        for (j = 0; j < filterSize; j++)                                        \
+            val += ((int)READ(src + srcPos + j)) * filter[filterSize * i + j];  \
+        dst[i] = FFMIN(val >> shift, (1 << 15) - 1);                            \
+    }                                                                           \
+}
+
+HSCALE16(hscale16_sse2,      AV_RL16)
+HSCALE16(hscale16_sse2_swap, AV_RB16)
+
+/* One output pixel of the SSE2 fast bilinear scaler: insert the two source
+ * pixels at xpos>>16 into word n of xmm0. */
+#define FAST_BILINEAR_LOAD(n) \
+    "mov                      %0, %%eax       \n\t"\
+    "shr                     $16, %%eax       \n\t"\
+    "movzwl   (%2, %%"REG_a"), %%eax          \n\t"\
+    "pinsrw                $"#n", %%eax, %%xmm0 \n\t"\
+    "add                      %5, %0          \n\t"
+
+/**
+ * Scale dstWidth & ~7 pixels of src like hyscale_fast_c(), without the
+ * generated code of the MMX2 scaler, so for any widths and downscaling too.
+ * @return the next output pixel
+ */
+static av_always_inline int fast_bilinear_sse2(int16_t *dst, int dstWidth,
+                                               const uint8_t *src, int xInc)
+{
+    DECLARE_ALIGNED(16, uint16_t, frac)[8];
+    DECLARE_ALIGNED(16, uint16_t, step)[8];
+    x86_reg i   = 0;
+    x86_reg end = (dstWidth & ~7) * 2;
+    unsigned int xpos = 0;
+    int k;
+
+    if (!end)
+        return 0;
+    /* the fractional positions of 8 pixels, advanced with wrapping word adds */
+    for (k = 0; k < 8; k++) {
+        frac[k] = k * xInc;
+        step[k] = 8 * xInc;
+    }
+    __asm__ volatile(
+        "movdqa                   %6, %%xmm6      \n\t"
+        "movdqa                   %7, %%xmm7      \n\t"
+        "pcmpeqw             %%xmm5, %%xmm5       \n\t"
+        "psrlw                    $8, %%xmm5      \n\t"
+        ".p2align                  4              \n\t"
+        "1:                                       \n\t"
+        FAST_BILINEAR_LOAD(0)
+        FAST_BILINEAR_LOAD(1)
+        FAST_BILINEAR_LOAD(2)
+        FAST_BILINEAR_LOAD(3)
+        FAST_BILINEAR_LOAD(4)
+        FAST_BILINEAR_LOAD(5)
+        FAST_BILINEAR_LOAD(6)
+        FAST_BILINEAR_LOAD(7)
+        "movdqa              %%xmm0, %%xmm1       \n\t"
+        "pand                %%xmm5, %%xmm0       \n\t" // src[xx]
+        "psrlw                    $8, %%xmm1      \n\t" // src[xx+1]
+        "psubw               %%xmm0, %%xmm1       \n\t"
+        "movdqa              %%xmm6, %%xmm2       \n\t"
+        "psrlw                    $9, %%xmm2      \n\t" // xalpha
+        "pmullw              %%xmm2, %%xmm1       \n\t"
+        "psllw                    $7, %%xmm0      \n\t"
+        "paddw               %%xmm1, %%xmm0       \n\t"
+        "movdqu              %%xmm0, (%3, %1)     \n\t"
+        "paddw               %%xmm7, %%xmm6       \n\t"
+        "add                     $16, %1          \n\t"
+        "cmp                      %4, %1          \n\t"
+        " jb                      1b              \n\t"
+        : "+r" (xpos), "+r" (i)
+        : "r" (src), "r" (dst), "r" (end), "r" (xInc), "m" (*frac), "m" (*step)
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm5", "%xmm6", "%xmm7",)
+          "%"REG_a, "memory"
+    );
+    return dstWidth & ~7;
+}
+
+static void hyscale_fast_sse2(SwsContext *c, int16_t *dst, int dstWidth,
+                              const uint8_t *src, int srcW, int xInc)
+{
+    int i = fast_bilinear_sse2(dst, dstWidth, src, xInc);
+
+    for (; i < dstWidth; i++) {
+        unsigned int xpos   = i * xInc;
+        unsigned int xx     = xpos >> 16;
+        unsigned int xalpha = (xpos & 0xFFFF) >> 9;
+        dst[i] = (src[xx] << 7) + (src[xx + 1] - src[xx]) * xalpha;
+    }
+    for (i = dstWidth - 1; (i * xInc) >> 16 >= srcW - 1; i--)
+        dst[i] = src[srcW - 1] * 128;
+}
+
+static void hcscale_fast_sse2(SwsContext *c, int16_t *dst1, int16_t *dst2,
+                              int dstWidth, const uint8_t *src1,
+                              const uint8_t *src2, int srcW, int xInc)
+{
+    hyscale_fast_sse2(c, dst1, dstWidth, src1, srcW, xInc);
+    hyscale_fast_sse2(c, dst2, dstWidth, src2, srcW, xInc);
+}
+#endif /* HAVE_SSE && ARCH_X86_64 */
+
 void updateMMXDitherTables(SwsContext *c, int dstY, int lumBufIndex, int chrBufIndex,
                            int lastInLumBuf, int lastInChrBuf)
 {
@@ -186,4 +751,41 @@ void ff_sws_init_swScale_mmx(SwsContext *c)
     if (cpu_flags & AV_CPU_FLAG_MMX2)
         sws_init_swScale_MMX2(c);
 #endif
+#if HAVE_SSE
+    /* replace the MMX vertical scalers where the template selected them */
+    if (cpu_flags & AV_CPU_FLAG_SSE2) {
+#if HAVE_MMX2
+#define REPLACE(field, name)                                              \
+        if (c->field == name ## _MMX || c->field == name ## _MMX2)        \
+            c->field = name ## _sse2;
+#else
+#define REPLACE(field, name)                                              \
+        if (c->field == name ## _MMX)                                     \
+            c->field = name ## _sse2;
+#endif
+        REPLACE(yuv2yuvX, yuv2yuvX)
+        REPLACE(yuv2yuvX, yuv2yuvX_ar)
+        REPLACE(yuv2yuv1, yuv2yuv1)
+        REPLACE(yuv2yuv1, yuv2yuv1_ar)
+#undef REPLACE
+    }
+#endif
+#if HAVE_SSE && ARCH_X86_64
+    if (cpu_flags & AV_CPU_FLAG_SSE2 && c->hScale16) {
+        enum PixelFormat srcFormat = c->srcFormat;
+
+        /* the C code reads these formats with hScale16X_c */
+        if ((is16BPS(srcFormat) || is9_OR_10BPS(srcFormat)) && !isAnyRGB(srcFormat) &&
+            av_pix_fmt_descriptors[srcFormat].flags & PIX_FMT_BE)
+            c->hScale16 = hscale16_sse2_swap;
+        else
+            c->hScale16 = hscale16_sse2;
+    }
+    /* the MMX2 scaler only upscales to multiples of 32 pixels */
+    if (cpu_flags & AV_CPU_FLAG_SSE2 && c->flags & SWS_FAST_BILINEAR &&
+        !c->canMMX2BeUsed && !c->hScale16) {
+        c->hyscale_fast = hyscale_fast_sse2;
+        c->hcscale_fast = hcscale_fast_sse2;
+    }
+#endif
 }
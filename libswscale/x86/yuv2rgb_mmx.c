@@ -26,6 +26,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <inttypes.h>
 #include <assert.h>
 
@@ -64,6 +65,65 @@ DECLARE_ASM_CONST(8, uint64_t, pb_07) = 0x0707070707070707ULL;
 #include "yuv2rgb_template.c"
 #endif /* HAVE_MMX2 */
 
+#if HAVE_SSSE3
+DECLARE_ALIGNED(32, static const uint64_t, pb_f8_sse)[4] = { 0xf8f8f8f8f8f8f8f8ULL, 0xf8f8f8f8f8f8f8f8ULL, 0xf8f8f8f8f8f8f8f8ULL, 0xf8f8f8f8f8f8f8f8ULL };
+DECLARE_ALIGNED(32, static const uint64_t, pb_e0_sse)[4] = { 0xe0e0e0e0e0e0e0e0ULL, 0xe0e0e0e0e0e0e0e0ULL, 0xe0e0e0e0e0e0e0e0ULL, 0xe0e0e0e0e0e0e0e0ULL };
+DECLARE_ALIGNED(32, static const uint64_t, pb_03_sse)[4] = { 0x0303030303030303ULL, 0x0303030303030303ULL, 0x0303030303030303ULL, 0x0303030303030303ULL };
+DECLARE_ALIGNED(32, static const uint64_t, pb_07_sse)[4] = { 0x0707070707070707ULL, 0x0707070707070707ULL, 0x0707070707070707ULL, 0x0707070707070707ULL };
+
+/* pshufb masks picking component c of the 16 pixels in a register into
+ * bytes 16 * i to 16 * i + 15 of packed 24-bit pixels, -1 clears the byte */
+#define M24(i, c, j) ((16 * (i) + (j)) % 3 == (c) ? (16 * (i) + (j)) / 3 : -1)
+#define M24_LANE(i, c) \
+    M24(i, c,  0), M24(i, c,  1), M24(i, c,  2), M24(i, c,  3), \
+    M24(i, c,  4), M24(i, c,  5), M24(i, c,  6), M24(i, c,  7), \
+    M24(i, c,  8), M24(i, c,  9), M24(i, c, 10), M24(i, c, 11), \
+    M24(i, c, 12), M24(i, c, 13), M24(i, c, 14), M24(i, c, 15)
+#define M24_MASKS(i) { { M24_LANE(i, 0), M24_LANE(i, 0) }, \
+                       { M24_LANE(i, 1), M24_LANE(i, 1) }, \
+                       { M24_LANE(i, 2), M24_LANE(i, 2) } }
+DECLARE_ALIGNED(32, static const uint8_t, rgb24_masks)[3][3][32] = {
+    M24_MASKS(0), M24_MASKS(1), M24_MASKS(2)
+};
+
+/**
+ * Copy the dithers, coefficients and offsets following c->redDither into
+ * k, each one repeated to fill 32 bytes.
+ */
+static av_always_inline void load_coeffs(SwsContext *c, uint64_t (*k)[4])
+{
+    const uint64_t *coeffs = &c->redDither;
+    int i;
+
+    for (i = 0; i < 11; i++)
+        k[i][0] = k[i][1] = k[i][2] = k[i][3] = coeffs[i];
+}
+
+static av_always_inline void set_dither(uint64_t (*k)[4], uint64_t red,
+                                        uint64_t green, uint64_t blue)
+{
+    k[0][0] = k[0][1] = k[0][2] = k[0][3] = red;
+    k[1][0] = k[1][1] = k[1][2] = k[1][3] = green;
+    k[2][0] = k[2][1] = k[2][2] = k[2][3] = blue;
+}
+
+//SSSE3 versions
+#undef RENAME
+#define COMPILE_TEMPLATE_AVX2 0
+#define RENAME(a) a ## _ssse3
+#include "yuv2rgb_sse_template.c"
+#undef COMPILE_TEMPLATE_AVX2
+#endif /* HAVE_SSSE3 */
+
+//AVX2 versions
+#if HAVE_AVX2
+#undef RENAME
+#define COMPILE_TEMPLATE_AVX2 1
+#define RENAME(a) a ## _avx2
+#include "yuv2rgb_sse_template.c"
+#undef COMPILE_TEMPLATE_AVX2
+#endif /* HAVE_AVX2 */
+
 SwsFunc ff_yuv2rgb_init_mmx(SwsContext *c)
 {
     int cpu_flags = av_get_cpu_flags();
@@ -72,6 +132,64 @@ SwsFunc ff_yuv2rgb_init_mmx(SwsContext *c)
         c->srcFormat != PIX_FMT_YUVA420P)
         return NULL;
 
+#if HAVE_AVX2
+    if (cpu_flags & AV_CPU_FLAG_AVX2) {
+        switch (c->dstFormat) {
+        case PIX_FMT_RGB32:
+            if (c->srcFormat == PIX_FMT_YUVA420P) {
+#if HAVE_7REGS && CONFIG_SWSCALE_ALPHA
+                return yuva420_rgb32_avx2;
+#endif
+                break;
+            } else return yuv420_rgb32_avx2;
+        case PIX_FMT_BGR32:
+            if (c->srcFormat == PIX_FMT_YUVA420P) {
+#if HAVE_7REGS && CONFIG_SWSCALE_ALPHA
+                return yuva420_bgr32_avx2;
+#endif
+                break;
+            } else return yuv420_bgr32_avx2;
+        case PIX_FMT_RGB24:    return yuv420_rgb24_avx2;
+        case PIX_FMT_BGR24:    return yuv420_bgr24_avx2;
+        case PIX_FMT_RGB48BE:
+        case PIX_FMT_RGB48LE:  return yuv420_rgb48_avx2;
+        case PIX_FMT_BGR48BE:
+        case PIX_FMT_BGR48LE:  return yuv420_bgr48_avx2;
+        case PIX_FMT_RGB565:   return yuv420_rgb16_avx2;
+        case PIX_FMT_RGB555:   return yuv420_rgb15_avx2;
+        }
+    }
+#endif
+
+#if HAVE_SSSE3
+    if (cpu_flags & AV_CPU_FLAG_SSSE3) {
+        switch (c->dstFormat) {
+        case PIX_FMT_RGB32:
+            if (c->srcFormat == PIX_FMT_YUVA420P) {
+#if HAVE_7REGS && CONFIG_SWSCALE_ALPHA
+                return yuva420_rgb32_ssse3;
+#endif
+                break;
+            } else return yuv420_rgb32_ssse3;
+        case PIX_FMT_BGR32:
+            if (c->srcFormat == PIX_FMT_YUVA420P) {
+#if HAVE_7REGS && CONFIG_SWSCALE_ALPHA
+                return yuva420_bgr32_ssse3;
+#endif
+                break;
+            } else return yuv420_bgr32_ssse3;
+        case PIX_FMT_RGB24:    return yuv420_rgb24_ssse3;
+        case PIX_FMT_BGR24:    return yuv420_bgr24_ssse3;
+        case PIX_FMT_RGB48BE:
+        case PIX_FMT_RGB48LE:  return yuv420_rgb48_ssse3;
+        case PIX_FMT_BGR48BE:
+        case PIX_FMT_BGR48LE:  return yuv420_bgr48_ssse3;
+        case PIX_FMT_RGB565:   return yuv420_rgb16_ssse3;
+        case PIX_FMT_RGB555:   return yuv420_rgb15_ssse3;
+        }
+    }
+#endif
+
 #if HAVE_MMX2
     if (cpu_flags & AV_CPU_FLAG_MMX2) {
         switch (c->dstFormat) {
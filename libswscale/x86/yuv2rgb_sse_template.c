@@ -0,0 +1,400 @@
+/*
+ * software YUV to RGB converter, SSSE3 and AVX2 versions
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Same arithmetic as yuv2rgb_template.c, on 16 (SSSE3) or 32 (AVX2) pixels
+ * at a time, so that the output is identical to the MMX versions.
+ *
+ * The 256-bit versions work on two independent 16 pixel halves, one per
+ * 128-bit lane: the chroma is zero-extended across lanes when loaded and
+ * the stores put the halves of each result back in pixel order.
+ *
+ * A line is converted in whole blocks, and a last block overlapping the
+ * previous one when its width is not a multiple of the block size. Lines
+ * narrower than a block go through a temporary buffer.
+ */
+
+#undef MM
+#undef REGSIZE
+#undef R
+#undef OP
+#undef MOV
+#undef MOVU
+#undef LOAD_UV
+#undef STORE_ONE
+#undef STORE_PAIR
+#undef INIT_BLOCKS
+#undef END_BLOCKS
+
+#if COMPILE_TEMPLATE_AVX2
+#define MM "%%ymm"
+#define REGSIZE 32
+#define OP(op, src, dst) "v"op"  "src", "dst", "dst" \n\t"
+#define MOV(src, dst) "vmovdqa "src", "dst" \n\t"
+#define MOVU "vmovdqu"
+#define LOAD_UV(mem, dst) "vpmovzxbw "mem", "dst" \n\t"
+/* the lower lane of r holds the pixels at off, the upper one the pixels
+ * 16 further */
+#define STORE_ONE(r, off, depth)                                       \
+    "vmovdqu       %%xmm"#r", "#off"(%[image])                  \n\t" \
+    "vextracti128  $1, %%ymm"#r", "#off"+16*"#depth"(%[image])   \n\t"
+#define STORE_PAIR(a, b, t0, t1, off, depth)                           \
+    "vperm2i128    $0x20, "R(b)", "R(a)", "R(t0)"               \n\t" \
+    "vperm2i128    $0x31, "R(b)", "R(a)", "R(t1)"               \n\t" \
+    "vmovdqu       "R(t0)", "#off"(%[image])                    \n\t" \
+    "vmovdqu       "R(t1)", "#off"+16*"#depth"(%[image])         \n\t"
+#define INIT_BLOCKS
+#define END_BLOCKS "vzeroupper \n\t"
+#else
+#define MM "%%xmm"
+#define REGSIZE 16
+#define OP(op, src, dst) op"  "src", "dst" \n\t"
+#define MOV(src, dst) "movdqa "src", "dst" \n\t"
+#define MOVU "movdqu"
+#define LOAD_UV(mem, dst)                                              \
+    "movq          "mem", "dst"                                 \n\t" \
+    "punpcklbw     %%xmm4, "dst"                                \n\t"
+#define STORE_ONE(r, off, depth)                                       \
+    "movdqu        "R(r)", "#off"(%[image])                     \n\t"
+#define STORE_PAIR(a, b, t0, t1, off, depth)                           \
+    "movdqu        "R(a)", "#off"(%[image])                     \n\t" \
+    "movdqu        "R(b)", "#off"+16(%[image])                  \n\t"
+#define INIT_BLOCKS "pxor %%xmm4, %%xmm4 \n\t"
+#define END_BLOCKS
+#endif
+
+#define R(n) MM #n
+
+/* offsets of the coefficients in the table filled by load_coeffs() */
+#define K(i) #i"*32(%[k])"
+
+/* Y' U' V' as in YUV2RGB of yuv2rgb_template.c,
+ * output: 1 - R, 2 - G, 0 - B (in pixel order) */
+#define YUV2RGB_SSE                                                    \
+    MOVU"          (%[py]), "R(6)"                              \n\t" \
+    LOAD_UV("(%[pu])", R(0))                                           \
+    LOAD_UV("(%[pv])", R(1))                                           \
+    MOV(R(6), R(7))                                                    \
+    OP("psllw",    "$8", R(6))                                         \
+    OP("psrlw",    "$5", R(6))                                         \
+    OP("psrlw",    "$8", R(7))                                         \
+    OP("psllw",    "$3", R(7))                                         \
+    OP("psllw",    "$3", R(0))                                         \
+    OP("psllw",    "$3", R(1))                                         \
+    OP("psubsw",   K(9),  R(0))                                        \
+    OP("psubsw",   K(10), R(1))                                        \
+    OP("psubw",    K(8),  R(6))                                        \
+    OP("psubw",    K(8),  R(7))                                        \
+    MOV(R(0), R(2))                                                    \
+    MOV(R(1), R(3))                                                    \
+    OP("pmulhw",   K(7), R(2))                                         \
+    OP("pmulhw",   K(6), R(3))                                         \
+    OP("pmulhw",   K(3), R(6))                                         \
+    OP("pmulhw",   K(3), R(7))                                         \
+    OP("pmulhw",   K(5), R(0))                                         \
+    OP("pmulhw",   K(4), R(1))                                         \
+    OP("paddsw",   R(3), R(2))                                         \
+    MOV(R(7), R(3))                                                    \
+    MOV(R(7), R(5))                                                    \
+    OP("paddsw",   R(0), R(3))                                         \
+    OP("paddsw",   R(1), R(5))                                         \
+    OP("paddsw",   R(2), R(7))                                         \
+    OP("paddsw",   R(6), R(0))                                         \
+    OP("paddsw",   R(6), R(1))                                         \
+    OP("paddsw",   R(6), R(2))                                         \
+    /* pack and interleave even/odd pixels */                          \
+    OP("packuswb", R(1), R(0))                                         \
+    OP("packuswb", R(5), R(3))                                         \
+    OP("packuswb", R(2), R(2))                                         \
+    MOV(R(0), R(1))                                                    \
+    OP("packuswb", R(7), R(7))                                         \
+    OP("punpcklbw", R(3), R(0))                                        \
+    OP("punpckhbw", R(3), R(1))                                        \
+    OP("punpcklbw", R(7), R(2))
+
+#define DITHER_RGB_SSE                                                 \
+    OP("paddusb",  K(2), R(0))                                         \
+    OP("paddusb",  K(1), R(2))                                         \
+    OP("paddusb",  K(0), R(1))
+
+#define RGB_PACK16_SSE(is15)                                           \
+    OP("pand",     "%[redmask]", R(0))                                 \
+    OP("pand",     "%[redmask]", R(1))                                 \
+    MOV(R(2), R(3))                                                    \
+    OP("psllw",    "$"AV_STRINGIFY(3-is15), R(2))                      \
+    OP("psrlw",    "$"AV_STRINGIFY(5+is15), R(3))                      \
+    OP("psrlw",    "$3", R(0))                                         \
+    IF##is15(OP("psrlw", "$1", R(1)))                                  \
+    OP("pand",     "%[pb_e0]", R(2))                                   \
+    OP("pand",     "%[grnmask]", R(3))                                 \
+    OP("por",      R(2), R(0))                                         \
+    OP("por",      R(3), R(1))                                         \
+    MOV(R(0), R(2))                                                    \
+    OP("punpcklbw", R(1), R(0))                                        \
+    OP("punpckhbw", R(1), R(2))                                        \
+    STORE_PAIR(0, 2, 1, 3, 0, 2)
+
+/* out = first, second and third components of 16 pixels picked by the
+ * masks of block i, into 16 packed bytes */
+#define RGB_PICK24_SSE(first, third, i, out)                           \
+    MOV(R(first), R(out))                                              \
+    OP("pshufb",   "%[m"#i"0]", R(out))                                \
+    MOV(R(2), R(5))                                                    \
+    OP("pshufb",   "%[m"#i"1]", R(5))                                  \
+    OP("por",      R(5), R(out))                                       \
+    MOV(R(third), R(5))                                                \
+    OP("pshufb",   "%[m"#i"2]", R(5))                                  \
+    OP("por",      R(5), R(out))
+
+#define RGB_PACK24_SSE(first, third)                                   \
+    RGB_PICK24_SSE(first, third, 0, 3)                                 \
+    RGB_PICK24_SSE(first, third, 1, 6)                                 \
+    OP("pshufb",   "%[m20]", R(first))                                 \
+    OP("pshufb",   "%[m21]", R(2))                                     \
+    OP("por",      R(2), R(first))                                     \
+    OP("pshufb",   "%[m22]", R(third))                                 \
+    OP("por",      R(third), R(first))
+
+/* 48-bit pixels are the 24-bit ones with every byte repeated */
+#define RGB_WIDEN48_SSE(r, t, off)                                     \
+    MOV(R(r), R(t))                                                    \
+    OP("punpcklbw", R(r), R(r))                                        \
+    OP("punpckhbw", R(t), R(t))                                        \
+    STORE_PAIR(r, t, 5, 7, off, 6)
+
+#define RGB_PACK32_SSE(red, green, blue, alpha)                        \
+    MOV(R(blue), R(5))                                                 \
+    MOV(R(red),  R(6))                                                 \
+    OP("punpckhbw", R(green), R(5))                                    \
+    OP("punpcklbw", R(green), R(blue))                                 \
+    OP("punpckhbw", R(alpha), R(6))                                    \
+    OP("punpcklbw", R(alpha), R(red))                                  \
+    MOV(R(blue), R(green))                                             \
+    MOV(R(5),    R(alpha))                                             \
+    OP("punpcklwd", R(red), R(blue))                                   \
+    OP("punpckhwd", R(red), R(green))                                  \
+    OP("punpcklwd", R(6),   R(5))                                      \
+    OP("punpckhwd", R(6),   R(alpha))                                  \
+    STORE_PAIR(blue, green, red, 6, 0, 4)                              \
+    STORE_PAIR(5,    alpha, red, 6, 32, 4)
+
+#define BLOCKS_BEGIN(depth)                                            \
+    __asm__ volatile (                                                 \
+        INIT_BLOCKS                                                    \
+        ".p2align      4                                        \n\t" \
+        "1:                                                     \n\t"
+
+#define BLOCKS_END(depth)                                              \
+        "add           $"AV_STRINGIFY(REGSIZE*depth)", %[image]  \n\t" \
+        "add           $"AV_STRINGIFY(REGSIZE)", %[py]           \n\t" \
+        "add           $"AV_STRINGIFY(REGSIZE/2)", %[pu]         \n\t" \
+        "add           $"AV_STRINGIFY(REGSIZE/2)", %[pv]         \n\t" \
+        "dec           %[n]                                     \n\t" \
+        "jnz           1b                                       \n\t" \
+        END_BLOCKS
+
+#define BLOCKS_OPERANDS(...)                                           \
+        : [py] "+r" (py), [pu] "+r" (pu), [pv] "+r" (pv),             \
+          [image] "+r" (image), [n] "+r" (n) __VA_ARGS__              \
+        : [k] "r" (k)
+
+#define BLOCKS_CLOBBERS                                                \
+        : XMM_CLOBBERS("%xmm0", "%xmm1", "%xmm2", "%xmm3",            \
+                       "%xmm4", "%xmm5", "%xmm6", "%xmm7",)           \
+          "memory"                                                     \
+    );
+
+#define PACK24_OPERANDS                                                \
+        , [m00] "m" (rgb24_masks[0][0]), [m01] "m" (rgb24_masks[0][1]), \
+          [m02] "m" (rgb24_masks[0][2]), [m10] "m" (rgb24_masks[1][0]), \
+          [m11] "m" (rgb24_masks[1][1]), [m12] "m" (rgb24_masks[1][2]), \
+          [m20] "m" (rgb24_masks[2][0]), [m21] "m" (rgb24_masks[2][1]), \
+          [m22] "m" (rgb24_masks[2][2])
+
+#define PACK16_OPERANDS(gmask)                                         \
+        , [redmask] "m" (pb_f8_sse), [pb_e0] "m" (pb_e0_sse),         \
+          [grnmask] "m" (gmask)
+
+static av_always_inline void RENAME(rgb15_blocks)(const uint8_t *py, const uint8_t *pu,
+                                                  const uint8_t *pv, const uint8_t *pa,
+                                                  uint8_t *image, x86_reg n,
+                                                  uint64_t (*k)[4])
+{
+    BLOCKS_BEGIN(2)
+        YUV2RGB_SSE
+        DITHER_RGB_SSE
+        RGB_PACK16_SSE(1)
+    BLOCKS_END(2)
+    BLOCKS_OPERANDS() PACK16_OPERANDS(pb_03_sse)
+    BLOCKS_CLOBBERS
+}
+
+static av_always_inline void RENAME(rgb16_blocks)(const uint8_t *py, const uint8_t *pu,
+                                                  const uint8_t *pv, const uint8_t *pa,
+                                                  uint8_t *image, x86_reg n,
+                                                  uint64_t (*k)[4])
+{
+    BLOCKS_BEGIN(2)
+        YUV2RGB_SSE
+        DITHER_RGB_SSE
+        RGB_PACK16_SSE(0)
+    BLOCKS_END(2)
+    BLOCKS_OPERANDS() PACK16_OPERANDS(pb_07_sse)
+    BLOCKS_CLOBBERS
+}
+
+#define RGB24_BLOCKS(name, first, third)                                        \
+static av_always_inline void RENAME(name ## _blocks)(const uint8_t *py, const uint8_t *pu, \
+                                                     const uint8_t *pv, const uint8_t *pa, \
+                                                     uint8_t *image, x86_reg n, \
+                                                     uint64_t (*k)[4])          \
+{                                                                               \
+    BLOCKS_BEGIN(3)                                                             \
+        YUV2RGB_SSE                                                             \
+        RGB_PACK24_SSE(first, third)                                            \
+        STORE_PAIR(3, 6, 2, 5, 0, 3)                                            \
+        STORE_ONE(first, 32, 3)                                                 \
+    BLOCKS_END(3)                                                               \
+    BLOCKS_OPERANDS() PACK24_OPERANDS                                             \
+    BLOCKS_CLOBBERS                                                             \
+}
+
+RGB24_BLOCKS(rgb24, 1, 0)
+RGB24_BLOCKS(bgr24, 0, 1)
+
+#define RGB48_BLOCKS(name, first, third)                                        \
+static av_always_inline void RENAME(name ## _blocks)(const uint8_t *py, const uint8_t *pu, \
+                                                     const uint8_t *pv, const uint8_t *pa, \
+                                                     uint8_t *image, x86_reg n, \
+                                                     uint64_t (*k)[4])          \
+{                                                                               \
+    BLOCKS_BEGIN(6)                                                             \
+        YUV2RGB_SSE                                                             \
+        RGB_PACK24_SSE(first, third)                                            \
+        RGB_WIDEN48_SSE(3, 2, 0)                                                \
+        RGB_WIDEN48_SSE(6, 2, 32)                                               \
+        RGB_WIDEN48_SSE(first, 2, 64)                                           \
+    BLOCKS_END(6)                                                               \
+    BLOCKS_OPERANDS() PACK24_OPERANDS                                             \
+    BLOCKS_CLOBBERS                                                             \
+}
+
+RGB48_BLOCKS(rgb48, 1, 0)
+RGB48_BLOCKS(bgr48, 0, 1)
+
+#define RGB32_BLOCKS(name, red, blue)                                           \
+static av_always_inline void RENAME(name ## _blocks)(const uint8_t *py, const uint8_t *pu, \
+                                                     const uint8_t *pv, const uint8_t *pa, \
+                                                     uint8_t *image, x86_reg n, \
+                                                     uint64_t (*k)[4])          \
+{                                                                               \
+    BLOCKS_BEGIN(4)                                                             \
+        YUV2RGB_SSE                                                             \
+        OP("pcmpeqd", R(3), R(3))                                               \
+        RGB_PACK32_SSE(red, 2, blue, 3)                                         \
+    BLOCKS_END(4)                                                               \
+    BLOCKS_OPERANDS()                                                           \
+    BLOCKS_CLOBBERS                                                             \
+}
+
+RGB32_BLOCKS(rgb32, 1, 0)
+RGB32_BLOCKS(bgr32, 0, 1)
+
+#if HAVE_7REGS && CONFIG_SWSCALE_ALPHA
+#define RGBA32_BLOCKS(name, red, blue)                                          \
+static av_always_inline void RENAME(name ## _blocks)(const uint8_t *py, const uint8_t *pu, \
+                                                     const uint8_t *pv, const uint8_t *pa, \
+                                                     uint8_t *image, x86_reg n, \
+                                                     uint64_t (*k)[4])          \
+{                                                                               \
+    BLOCKS_BEGIN(4)                                                             \
+        YUV2RGB_SSE                                                             \
+        MOVU"          (%[pa]), "R(3)"                                  \n\t"   \
+        RGB_PACK32_SSE(red, 2, blue, 3)                                         \
+        "add           $"AV_STRINGIFY(REGSIZE)", %[pa]                  \n\t"   \
+    BLOCKS_END(4)                                                               \
+    BLOCKS_OPERANDS(, [pa] "+r" (pa))                                           \
+    BLOCKS_CLOBBERS                                                             \
+}
+
+RGBA32_BLOCKS(rgba32, 1, 0)
+RGBA32_BLOCKS(bgra32, 0, 1)
+#endif
+
+#define YUV2RGB_FUNC_SSE(name, blocks, depth, alpha, set_dither)                \
+static int RENAME(name)(SwsContext *c, const uint8_t *src[], int srcStride[],   \
+                        int srcSliceY, int srcSliceH,                           \
+                        uint8_t *dst[], int dstStride[])                        \
+{                                                                               \
+    DECLARE_ALIGNED(32, uint64_t, k)[11][4];                                    \
+    DECLARE_ALIGNED(32, uint8_t, tmp)[REGSIZE * (6 + 3)];                       \
+    uint8_t *tmp_y = tmp + REGSIZE * 6, *tmp_a = tmp_y + REGSIZE;               \
+    uint8_t *tmp_u = tmp_a + REGSIZE,   *tmp_v = tmp_u + REGSIZE / 2;           \
+    int y, x, h_size = (c->dstW + 7) & ~7;                                      \
+    int vshift = c->srcFormat != PIX_FMT_YUV422P;                               \
+                                                                                \
+    if (h_size * depth > FFABS(dstStride[0]))                                   \
+        h_size -= 8;                                                            \
+    x = h_size - REGSIZE;                                                       \
+    if (x < 0)                                                                  \
+        memset(tmp, 0, sizeof(tmp));                                            \
+                                                                                \
+    load_coeffs(c, k);                                                          \
+    for (y = 0; y < srcSliceH; y++) {                                           \
+        uint8_t *image    = dst[0] + (y + srcSliceY) * dstStride[0];            \
+        const uint8_t *py = src[0] +               y * srcStride[0];            \
+        const uint8_t *pu = src[1] +   (y >> vshift) * srcStride[1];            \
+        const uint8_t *pv = src[2] +   (y >> vshift) * srcStride[2];            \
+        const uint8_t *pa = alpha ? src[3] + y * srcStride[3] : NULL;           \
+                                                                                \
+        set_dither                                                              \
+        if (x < 0) {                                                            \
+            memcpy(tmp_y, py, h_size);                                          \
+            if (alpha)                                                          \
+                memcpy(tmp_a, pa, h_size);                                      \
+            memcpy(tmp_u, pu, h_size / 2);                                      \
+            memcpy(tmp_v, pv, h_size / 2);                                      \
+            RENAME(blocks ## _blocks)(tmp_y, tmp_u, tmp_v, tmp_a, tmp, 1, k);   \
+            memcpy(image, tmp, h_size * depth);                                 \
+            continue;                                                           \
+        }                                                                       \
+        RENAME(blocks ## _blocks)(py, pu, pv, pa, image, h_size / REGSIZE, k);  \
+        if (h_size % REGSIZE)                                                   \
+            RENAME(blocks ## _blocks)(py + x, pu + x / 2, pv + x / 2,           \
+                                      alpha ? pa + x : NULL,                    \
+                                      image + x * depth, 1, k);                 \
+    }                                                                           \
+    return srcSliceH;                                                           \
+}
+
+YUV2RGB_FUNC_SSE(yuv420_rgb15, rgb15, 2, 0,
+                 set_dither(k, ff_dither8[(y + 1) & 1], ff_dither8[y & 1], ff_dither8[y & 1]);)
+YUV2RGB_FUNC_SSE(yuv420_rgb16, rgb16, 2, 0,
+                 set_dither(k, ff_dither8[(y + 1) & 1], ff_dither4[y & 1], ff_dither8[y & 1]);)
+YUV2RGB_FUNC_SSE(yuv420_rgb24, rgb24, 3, 0, )
+YUV2RGB_FUNC_SSE(yuv420_bgr24, bgr24, 3, 0, )
+YUV2RGB_FUNC_SSE(yuv420_rgb48, rgb48, 6, 0, )
+YUV2RGB_FUNC_SSE(yuv420_bgr48, bgr48, 6, 0, )
+YUV2RGB_FUNC_SSE(yuv420_rgb32, rgb32, 4, 0, )
+YUV2RGB_FUNC_SSE(yuv420_bgr32, bgr32, 4, 0, )
+#if HAVE_7REGS && CONFIG_SWSCALE_ALPHA
+YUV2RGB_FUNC_SSE(yuva420_rgb32, rgba32, 4, 1, )
+YUV2RGB_FUNC_SSE(yuva420_bgr32, bgra32, 4, 1, )
+#endif
@@ -52,6 +52,9 @@ if [ -n "$do_mpeg2thread" ] ; then
 do_video_encoding mpeg2thread.mpg "-qscale 10 -vcodec mpeg2video -f mpeg1video -bf 2 -flags +ildct+ilme -threads 2"
 do_video_decoding
 
+# mpeg2 decoding with frame threads, keeping the timestamps
+do_video_decoding "-threads 3" "-vsync 1"
+
 # mpeg2 encoding interlaced using intra vlc
 do_video_encoding mpeg2threadivlc.mpg "-qscale 10 -vcodec mpeg2video -f mpeg1video -bf 2 -flags +ildct+ilme -flags2 +ivlc -threads 2"
 do_video_decoding
@@ -0,0 +1,78 @@
+#! /bin/sh
+#
+# Collect the timings written by "make fate BENCH=<runs>" and compare them
+# with a baseline recorded on the same host.
+#
+# usage: fate-bench.sh save    <resultdir> <baseline>
+#        fate-bench.sh compare <resultdir> <baseline> [cpu%] [wall%] [min_time]
+#
+# Lines have the form test:runs:wall:cpu:frames:fps, times are the median
+# of all runs in seconds. A test regresses when its cpu or wall time grows
+# by more than the given percentage (default 10 and 20). Tests faster than
+# min_time seconds (default 0.05) in the baseline are too noisy to judge.
+
+export LC_ALL=C
+
+mode=$1
+resultdir=$2
+baseline=$3
+cpu_threshold=${4:-10}
+wall_threshold=${5:-20}
+min_time=${6:-0.05}
+
+results(){
+    cat "$resultdir"/*.bench 2>/dev/null | sort
+}
+
+if [ -z "$(results)" ]; then
+    echo "no benchmark results in $resultdir, run 'make fate BENCH=<runs>' first"
+    exit 1
+fi
+
+case $mode in
+    save)
+        mkdir -p "$(dirname "$baseline")"
+        results >"$baseline"
+        echo "saved $(wc -l <"$baseline") results to $baseline"
+        ;;
+    compare)
+        if [ ! -f "$baseline" ]; then
+            echo "baseline '$baseline' not found, create it with 'make fate-bench-baseline'"
+            exit 1
+        fi
+        results | awk -F: -v cpu_t=$cpu_threshold -v wall_t=$wall_threshold \
+                          -v min_time=$min_time -v baseline="$baseline" '
+            BEGIN {
+                while ((getline line < baseline) > 0) {
+                    split(line, f, ":")
+                    bwall[f[1]] = f[3]
+                    bcpu[f[1]]  = f[4]
+                }
+                printf "%-40s %10s %10s %8s %10s %10s %8s\n", "test",
+                       "base cpu", "cpu", "diff", "base wall", "wall", "diff"
+            }
+            !($1 in bcpu) { printf "%-40s %10s\n", $1, "new"; next }
+            {
+                dcpu  = bcpu[$1]  > 0 ? ($4 / bcpu[$1]  - 1) * 100 : 0
+                dwall = bwall[$1] > 0 ? ($3 / bwall[$1] - 1) * 100 : 0
+                flag  = ""
+                if (bcpu[$1] >= min_time && dcpu > cpu_t ||
+                    bwall[$1] >= min_time && dwall > wall_t) {
+                    flag = "  REGRESSION"
+                    regressions++
+                }
+                printf "%-40s %10.3f %10.3f %+7.1f%% %10.3f %10.3f %+7.1f%%%s\n",
+                       $1, bcpu[$1], $4, dcpu, bwall[$1], $3, dwall, flag
+            }
+            END {
+                if (regressions) {
+                    printf "%d tests slower than the baseline\n", regressions
+                    exit 1
+                }
+            }'
+        ;;
+    *)
+        echo "usage: $0 save|compare <resultdir> <baseline> [cpu%] [wall%] [min_time]"
+        exit 1
+        ;;
+esac
@@ -17,12 +17,14 @@ ref=${7:-"${base}/ref/fate/${test}"}
 fuzz=$8
 threads=${9:-1}
 thread_type=${10:-3}
+bench=${11:-0}
 
 outdir="tests/data/fate"
 outfile="${outdir}/${test}"
 errfile="${outdir}/${test}.err"
 cmpfile="${outdir}/${test}.diff"
 repfile="${outdir}/${test}.rep"
+benchfile="${outdir}/${test}.bench"
 
 do_tiny_psnr(){
     psnr=$(tests/tiny_psnr "$1" "$2" 2 0 0)
@@ -107,7 +109,53 @@ seektest(){
     $target_exec $target_path/tests/seek_test $target_path/$file
 }
 
+now(){
+    t=$(date +%s.%N)
+    case $t in
+        *N) date +%s ;;
+        *)  echo $t ;;
+    esac
+}
+
+median(){
+    sort -n | awk '{ v[NR] = $1 }
+        END { print NR % 2 ? v[(NR + 1) / 2] : (v[NR / 2] + v[NR / 2 + 1]) / 2 }'
+}
+
+# user + system time of all the children of this shell so far
+# times must not run in a subshell, or it only sees the subshell's children
+cputime(){
+    awk 'NR == 2 { split($1, u, /[ms]/); split($2, s, /[ms]/);
+                   print u[1] * 60 + u[2] + s[1] * 60 + s[2] }' "$1"
+}
+
+# run the test command $bench more times and record the median wall and
+# cpu time and the frame rate in the form test:runs:wall:cpu:frames:fps
+benchmark(){
+    frames=$(grep -c '^ *[0-9][0-9]*, ' "$outfile")
+    tfile="${benchfile}.t"
+    : >"${benchfile}.wall"
+    : >"${benchfile}.cpu"
+    i=0
+    while [ $i -lt $bench ]; do
+        times >"$tfile"; cpu0=$(cputime "$tfile")
+        wall0=$(now)
+        $command >/dev/null 2>&1
+        wall1=$(now)
+        times >"$tfile"; cpu1=$(cputime "$tfile")
+        echo $wall0 $wall1 | awk '{ print $2 - $1 }' >>"${benchfile}.wall"
+        echo $cpu0  $cpu1  | awk '{ print $2 - $1 }' >>"${benchfile}.cpu"
+        i=$((i + 1))
+    done
+    wall=$(median <"${benchfile}.wall")
+    cpu=$(median <"${benchfile}.cpu")
+    fps=$(echo $frames $wall | awk '{ printf "%.2f", ($2 > 0 ? $1 / $2 : 0) }')
+    echo "${test}:${bench}:${wall}:${cpu}:${frames}:${fps}" >"$benchfile"
+    rm -f "$tfile" "${benchfile}.wall" "${benchfile}.cpu"
+}
+
 mkdir -p "$outdir"
+rm -f "$benchfile"
 
 exec 3>&2
 $command > "$outfile" 2>$errfile
@@ -134,5 +182,7 @@ fi
 
 echo "${test}:${sig:-$err}:$($base64 <$cmpfile):$($base64 <$errfile)" >$repfile
 
+test $err = 0 && test "$bench" -gt 0 && benchmark
+
 test $err = 0 && rm -f $outfile $errfile $cmpfile $cleanfiles
 exit $err
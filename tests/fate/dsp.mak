@@ -0,0 +1,4 @@
+FATE_TESTS += fate-dsp
+fate-dsp: libavcodec/dsp-test$(EXESUF)
+fate-dsp: CMD = run libavcodec/dsp-test
+fate-dsp: REF = /dev/null
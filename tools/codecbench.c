@@ -0,0 +1,407 @@
+/*
+ * Codec throughput benchmark
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Measure the throughput of a video decoder or encoder without demuxing or
+ * I/O getting in the way: the packets of the input are read into memory
+ * first (and decoded once when benchmarking an encoder), then the codec is
+ * run over them for every thread count and threading type it supports.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "libavformat/avformat.h"
+#include "libavutil/cpu.h"
+#include "libavutil/opt.h"
+
+static AVPacket *packets;
+static unsigned int packets_size;
+static int nb_packets;
+static AVPicture *pictures;
+static int nb_pictures;
+static AVCodecContext *input;
+static AVRational time_base;
+
+static int64_t *frame_times;
+static int max_frame_times;
+
+static int usage(int ret)
+{
+    fprintf(stderr, "Benchmark the video decoder of a file, or an encoder fed with its decoded frames.\n");
+    fprintf(stderr, "codecbench [-e encoder] [-o options] [-t max_threads] [-r runs] [-n max_frames] file\n");
+    fprintf(stderr, "-e\tbenchmark this encoder instead of the decoder\n");
+    fprintf(stderr, "-o\tcodec options, e.g. b=2000000:g=12\n");
+    fprintf(stderr, "-t\tlargest thread count to test (default: number of cpus)\n");
+    fprintf(stderr, "-r\truns per configuration (default 3)\n");
+    fprintf(stderr, "-n\tframes to load (default: all packets, 250 frames for encoding)\n");
+    return ret;
+}
+
+static int cmp_time(const void *a, const void *b)
+{
+    int64_t va = *(const int64_t *)a, vb = *(const int64_t *)b;
+    return (va > vb) - (va < vb);
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double va = *(const double *)a, vb = *(const double *)b;
+    return (va > vb) - (va < vb);
+}
+
+static AVCodecContext *open_codec(AVCodec *codec, const char *opts,
+                                  int type, int threads)
+{
+    AVCodecContext *avctx = avcodec_alloc_context3(codec->decode ? NULL : codec);
+
+    if (!avctx)
+        return NULL;
+    if (codec->decode) {
+        if (avcodec_copy_context(avctx, input) < 0) {
+            av_free(avctx);
+            return NULL;
+        }
+    } else {
+        avctx->width     = input->width;
+        avctx->height    = input->height;
+        avctx->pix_fmt   = input->pix_fmt;
+        avctx->time_base = time_base;
+        avctx->sample_aspect_ratio = input->sample_aspect_ratio;
+    }
+    avctx->thread_count = threads;
+    if (type)
+        avctx->thread_type = type;
+    if (opts && av_set_options_string(avctx, opts, "=", ":") < 0) {
+        fprintf(stderr, "invalid codec options '%s'\n", opts);
+        av_free(avctx);
+        return NULL;
+    }
+    if (avcodec_open(avctx, codec) < 0) {
+        av_free(avctx);
+        return NULL;
+    }
+    return avctx;
+}
+
+static void add_frame_time(int *nb_frames, int64_t *last)
+{
+    int64_t now = av_gettime();
+
+    if (*nb_frames < max_frame_times)
+        frame_times[(*nb_frames)++] = now - *last;
+    *last = now;
+}
+
+/**
+ * Run the decoder once over all packets.
+ * @return the number of decoded frames, or a negative value on error
+ */
+static int run_decoder(AVCodecContext *avctx, int64_t *time, int *delay)
+{
+    AVFrame frame;
+    AVPacket pkt;
+    int64_t start, last;
+    int i, got, n = 0;
+
+    *delay = -1;
+    start = last = av_gettime();
+    for (i = 0; i <= nb_packets; i++) {
+        if (i < nb_packets) {
+            pkt = packets[i];
+        } else {
+            av_init_packet(&pkt);
+            pkt.data = NULL;
+            pkt.size = 0;
+        }
+        /* video decoders consume whole packets, like in ffmpeg.c */
+        do {
+            avcodec_get_frame_defaults(&frame);
+            if (avcodec_decode_video2(avctx, &frame, &got, &pkt) < 0)
+                break;
+            if (got) {
+                add_frame_time(&n, &last);
+                if (*delay < 0)
+                    *delay = i;
+            }
+        } while (i == nb_packets && got);
+    }
+    *time = av_gettime() - start;
+    return n;
+}
+
+/**
+ * Run the encoder once over all decoded pictures.
+ * @return the number of encoded frames, or a negative value on error
+ */
+static int run_encoder(AVCodecContext *avctx, int64_t *time, int *delay)
+{
+    int size = FFMAX(1024 * 256, 6 * avctx->width * avctx->height + 200);
+    uint8_t *buf = av_malloc(size);
+    AVFrame frame;
+    int64_t start, last;
+    int i, ret, n = 0;
+
+    if (!buf)
+        return AVERROR(ENOMEM);
+    *delay = -1;
+    start = last = av_gettime();
+    for (i = 0; i <= nb_pictures; i++) {
+        do {
+            AVFrame *pic = NULL;
+
+            if (i < nb_pictures) {
+                avcodec_get_frame_defaults(&frame);
+                memcpy(frame.data,     pictures[i].data,     sizeof(frame.data));
+                memcpy(frame.linesize, pictures[i].linesize, sizeof(frame.linesize));
+                frame.pts = i;
+                pic = &frame;
+            }
+            ret = avcodec_encode_video(avctx, buf, size, pic);
+            if (ret < 0) {
+                av_free(buf);
+                return ret;
+            }
+            if (ret > 0) {
+                add_frame_time(&n, &last);
+                if (*delay < 0)
+                    *delay = i;
+            }
+        } while (i == nb_pictures && ret > 0);
+    }
+    *time = av_gettime() - start;
+    av_free(buf);
+    return n;
+}
+
+static int load_packets(AVFormatContext *fctx, int stream, int max_frames)
+{
+    AVPacket pkt;
+
+    while ((!max_frames || nb_packets < max_frames) &&
+           av_read_frame(fctx, &pkt) >= 0) {
+        if (pkt.stream_index != stream) {
+            av_free_packet(&pkt);
+            continue;
+        }
+        if (av_dup_packet(&pkt) < 0 ||
+            !(packets = av_fast_realloc(packets, &packets_size,
+                                        (nb_packets + 1) * sizeof(*packets)))) {
+            fprintf(stderr, "out of memory\n");
+            return AVERROR(ENOMEM);
+        }
+        packets[nb_packets++] = pkt;
+    }
+    return nb_packets ? 0 : AVERROR(EINVAL);
+}
+
+static int decode_pictures(AVCodec *decoder, int max_frames)
+{
+    AVCodecContext *avctx = open_codec(decoder, NULL, 0, 1);
+    AVFrame frame;
+    AVPacket pkt;
+    int i, got;
+
+    if (!avctx)
+        return AVERROR(EINVAL);
+    if (!(pictures = av_mallocz(max_frames * sizeof(*pictures))))
+        return AVERROR(ENOMEM);
+    for (i = 0; i <= nb_packets && nb_pictures < max_frames; i++) {
+        if (i < nb_packets) {
+            pkt = packets[i];
+        } else {
+            av_init_packet(&pkt);
+            pkt.data = NULL;
+            pkt.size = 0;
+        }
+        do {
+            avcodec_get_frame_defaults(&frame);
+            if (avcodec_decode_video2(avctx, &frame, &got, &pkt) < 0 || !got)
+                break;
+            if (avpicture_alloc(&pictures[nb_pictures], avctx->pix_fmt,
+                                avctx->width, avctx->height) < 0)
+                return AVERROR(ENOMEM);
+            av_picture_copy(&pictures[nb_pictures++], (AVPicture *)&frame,
+                            avctx->pix_fmt, avctx->width, avctx->height);
+        } while (i == nb_packets && nb_pictures < max_frames);
+    }
+    input->width   = avctx->width;
+    input->height  = avctx->height;
+    input->pix_fmt = avctx->pix_fmt;
+    avcodec_close(avctx);
+    av_free(avctx);
+    return nb_pictures ? 0 : AVERROR(EINVAL);
+}
+
+static void bench(AVCodec *codec, const char *opts, const char *name, int type,
+                  int max_threads, int runs)
+{
+    double base_fps = 0;
+    int threads = 1;
+
+    printf("%-6s %7s %9s %9s %9s %9s %9s %6s %8s\n", name, "threads", "fps",
+           "p50 ms", "p90 ms", "p99 ms", "max ms", "delay", "scaling");
+
+    while (threads <= max_threads) {
+        double fps[64];
+        const char *failed = NULL;
+        int r, n = 0, nb_times = 0, delay = 0;
+        int64_t *times = av_malloc(runs * max_frame_times * sizeof(*times));
+
+        if (!times)
+            return;
+        for (r = 0; r < runs && r < FF_ARRAY_ELEMS(fps); r++) {
+            AVCodecContext *avctx = open_codec(codec, opts, type, threads);
+            int64_t time;
+
+            if (!avctx) {
+                failed = "failed";
+                break;
+            }
+            if (type && threads > 1 && !(avctx->active_thread_type & type)) {
+                /* the codec fell back to another kind of threading */
+                avcodec_close(avctx);
+                av_free(avctx);
+                failed = "unsupported";
+                break;
+            }
+            n = codec->decode ? run_decoder(avctx, &time, &delay) :
+                                run_encoder(avctx, &time, &delay);
+            avcodec_close(avctx);
+            av_free(avctx);
+            if (n <= 0) {
+                failed = "failed";
+                break;
+            }
+            fps[r] = n * 1000000.0 / FFMAX(time, 1);
+            memcpy(times + nb_times, frame_times, FFMIN(n, max_frame_times) * sizeof(*times));
+            nb_times += FFMIN(n, max_frame_times);
+        }
+        if (failed) {
+            printf("%-6s %7d %9s\n", "", threads, failed);
+        } else {
+            double median;
+
+            qsort(fps, r, sizeof(*fps), cmp_double);
+            qsort(times, nb_times, sizeof(*times), cmp_time);
+            median = fps[r / 2];
+            if (threads == 1)
+                base_fps = median;
+            printf("%-6s %7d %9.2f %9.3f %9.3f %9.3f %9.3f %6d %7.1f%%\n", "",
+                   threads, median,
+                   times[nb_times * 50 / 100] / 1000.0,
+                   times[nb_times * 90 / 100] / 1000.0,
+                   times[nb_times * 99 / 100] / 1000.0,
+                   times[nb_times - 1]        / 1000.0,
+                   delay, base_fps ? 100 * median / (threads * base_fps) : 0);
+        }
+        av_free(times);
+
+        if (threads < max_threads && threads * 2 > max_threads)
+            threads = max_threads;
+        else
+            threads *= 2;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    AVFormatContext *fctx = NULL;
+    AVCodec *decoder, *codec;
+    const char *encoder = NULL, *opts = NULL;
+    int max_threads = av_cpu_count(), runs = 3, max_frames = 0;
+    int stream, opt, ret;
+
+    while ((opt = getopt(argc, argv, "e:o:t:r:n:h")) != -1) {
+        switch (opt) {
+        case 'e': encoder     = optarg;                    break;
+        case 'o': opts        = optarg;                    break;
+        case 't': max_threads = FFMAX(atoi(optarg), 1);    break;
+        case 'r': runs        = av_clip(atoi(optarg), 1, 64); break;
+        case 'n': max_frames  = FFMAX(atoi(optarg), 0);    break;
+        default:  return usage(opt != 'h');
+        }
+    }
+    if (optind != argc - 1)
+        return usage(1);
+    if (encoder && !max_frames)
+        max_frames = 250;
+
+    av_register_all();
+
+    if ((ret = avformat_open_input(&fctx, argv[optind], NULL, NULL)) < 0) {
+        fprintf(stderr, "could not open %s: error %d\n", argv[optind], ret);
+        return 1;
+    }
+    if ((ret = av_find_stream_info(fctx)) < 0) {
+        fprintf(stderr, "av_find_stream_info: error %d\n", ret);
+        return 1;
+    }
+    stream = av_find_best_stream(fctx, AVMEDIA_TYPE_VIDEO, -1, -1, &decoder, 0);
+    if (stream < 0) {
+        fprintf(stderr, "no decodable video stream in %s\n", argv[optind]);
+        return 1;
+    }
+    input = fctx->streams[stream]->codec;
+    time_base = (AVRational){ 1, 25 };
+    if (fctx->streams[stream]->r_frame_rate.num && fctx->streams[stream]->r_frame_rate.den)
+        time_base = (AVRational){ fctx->streams[stream]->r_frame_rate.den,
+                                  fctx->streams[stream]->r_frame_rate.num };
+
+    if (load_packets(fctx, stream, encoder ? 0 : max_frames) < 0) {
+        fprintf(stderr, "could not read any packet\n");
+        return 1;
+    }
+
+    codec = decoder;
+    if (encoder) {
+        if (!(codec = avcodec_find_encoder_by_name(encoder)) ||
+            codec->type != AVMEDIA_TYPE_VIDEO) {
+            fprintf(stderr, "unknown video encoder '%s'\n", encoder);
+            return 1;
+        }
+        if (decode_pictures(decoder, max_frames) < 0) {
+            fprintf(stderr, "could not decode the input\n");
+            return 1;
+        }
+    }
+
+    max_frame_times = (encoder ? nb_pictures : 2 * nb_packets) + 16;
+    if (!(frame_times = av_malloc(max_frame_times * sizeof(*frame_times))))
+        return 1;
+
+    printf("%s %s, %dx%d, %d %s, %d runs\n", codec->name,
+           encoder ? "encoder" : "decoder", input->width, input->height,
+           encoder ? nb_pictures : nb_packets, encoder ? "frames" : "packets",
+           runs);
+    printf("frame times are the wall clock time between two output frames\n\n");
+
+    if (codec->capabilities & CODEC_CAP_SLICE_THREADS)
+        bench(codec, opts, "slice", FF_THREAD_SLICE, max_threads, runs);
+    if (codec->capabilities & CODEC_CAP_FRAME_THREADS)
+        bench(codec, opts, "frame", FF_THREAD_FRAME, max_threads, runs);
+    if (!(codec->capabilities & (CODEC_CAP_SLICE_THREADS | CODEC_CAP_FRAME_THREADS)))
+        bench(codec, opts, "codec", 0, max_threads, runs);
+
+    av_close_input_file(fctx);
+    return 0;
+}